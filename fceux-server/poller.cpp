@@ -0,0 +1,250 @@
+/* FCE Ultra Network Play Server
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2004 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "poller.h"
+
+#if !defined(USE_POLL) && defined(__linux__)
+#define USE_EPOLL
+#elif !defined(USE_POLL) && (defined(__APPLE__) || defined(BSD))
+#define USE_KQUEUE
+#elif !defined(USE_POLL)
+#define USE_POLL
+#endif
+
+#if defined(USE_EPOLL)
+
+#include <sys/epoll.h>
+
+static int epfd = -1;
+
+int PollerInit(void)
+{
+	epfd = epoll_create(64);
+	return(epfd != -1);
+}
+
+int PollerAdd(int fd, void *data)
+{
+	struct epoll_event ev;
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = data;
+	return(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == 0);
+}
+
+int PollerWantWrite(int fd, void *data, int on)
+{
+	struct epoll_event ev;
+
+	ev.events = EPOLLIN | (on ? EPOLLOUT : 0);
+	ev.data.ptr = data;
+	return(epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == 0);
+}
+
+void PollerRemove(int fd)
+{
+	struct epoll_event ev;	/* older kernels want one, even unused */
+
+	epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+int PollerWait(POLLEVENT *ev, int max, int timeout)
+{
+	struct epoll_event evs[256];
+	int n, x;
+
+	if(max > 256)
+		max = 256;
+
+	n = epoll_wait(epfd, evs, max, timeout);
+	if(n == -1)
+		return(errno == EINTR ? 0 : -1);
+
+	for(x=0; x<n; x++)
+	{
+		ev[x].data = evs[x].data.ptr;
+		ev[x].events = 0;
+		if(evs[x].events & EPOLLIN)
+			ev[x].events |= POLLER_READ;
+		if(evs[x].events & EPOLLOUT)
+			ev[x].events |= POLLER_WRITE;
+		if(evs[x].events & (EPOLLERR | EPOLLHUP))
+			ev[x].events |= POLLER_ERROR;
+	}
+	return(n);
+}
+
+#elif defined(USE_KQUEUE)
+
+#include <sys/event.h>
+#include <sys/time.h>
+
+static int kq = -1;
+
+int PollerInit(void)
+{
+	kq = kqueue();
+	return(kq != -1);
+}
+
+int PollerAdd(int fd, void *data)
+{
+	struct kevent kev;
+
+	EV_SET(&kev, fd, EVFILT_READ, EV_ADD, 0, 0, data);
+	return(kevent(kq, &kev, 1, 0, 0, 0) == 0);
+}
+
+int PollerWantWrite(int fd, void *data, int on)
+{
+	struct kevent kev;
+
+	EV_SET(&kev, fd, EVFILT_WRITE, on ? EV_ADD : EV_DELETE, 0, 0, data);
+	return(kevent(kq, &kev, 1, 0, 0, 0) == 0 || !on);
+}
+
+void PollerRemove(int fd)
+{
+	struct kevent kev[2];
+
+	/* The write filter may not be there, that's fine. */
+	EV_SET(&kev[0], fd, EVFILT_READ, EV_DELETE, 0, 0, 0);
+	EV_SET(&kev[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, 0);
+	kevent(kq, &kev[0], 1, 0, 0, 0);
+	kevent(kq, &kev[1], 1, 0, 0, 0);
+}
+
+int PollerWait(POLLEVENT *ev, int max, int timeout)
+{
+	struct kevent kevs[256];
+	struct timespec ts;
+	int n, x;
+
+	if(max > 256)
+		max = 256;
+
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000;
+
+	n = kevent(kq, 0, 0, kevs, max, timeout < 0 ? 0 : &ts);
+	if(n == -1)
+		return(errno == EINTR ? 0 : -1);
+
+	/* A socket that is both readable and writable comes as two events. */
+	for(x=0; x<n; x++)
+	{
+		ev[x].data = kevs[x].udata;
+		ev[x].events = (kevs[x].filter == EVFILT_WRITE) ? POLLER_WRITE : POLLER_READ;
+		if(kevs[x].flags & (EV_EOF | EV_ERROR))
+			ev[x].events |= POLLER_ERROR;
+	}
+	return(n);
+}
+
+#else
+
+#include <poll.h>
+#include <vector>
+
+static std::vector<struct pollfd> pfds;
+static std::vector<void *> pdata;
+static std::vector<int> slotof;	/* by fd, the index in pfds or -1 */
+
+int PollerInit(void)
+{
+	return(1);
+}
+
+int PollerAdd(int fd, void *data)
+{
+	struct pollfd p;
+
+	if(fd >= (int)slotof.size())
+		slotof.resize(fd + 1, -1);
+
+	p.fd = fd;
+	p.events = POLLIN;
+	p.revents = 0;
+	slotof[fd] = pfds.size();
+	pfds.push_back(p);
+	pdata.push_back(data);
+	return(1);
+}
+
+int PollerWantWrite(int fd, void *data, int on)
+{
+	if(fd >= (int)slotof.size() || slotof[fd] == -1)
+		return(0);
+
+	pfds[slotof[fd]].events = POLLIN | (on ? POLLOUT : 0);
+	return(1);
+}
+
+void PollerRemove(int fd)
+{
+	if(fd >= (int)slotof.size() || slotof[fd] == -1)
+		return;
+
+	int slot = slotof[fd];
+
+	/* The last one takes its place. */
+	pfds[slot] = pfds.back();
+	pdata[slot] = pdata.back();
+	slotof[pfds[slot].fd] = slot;
+	pfds.pop_back();
+	pdata.pop_back();
+	slotof[fd] = -1;
+}
+
+int PollerWait(POLLEVENT *ev, int max, int timeout)
+{
+	int n, x, o;
+
+	n = poll(pfds.empty() ? 0 : &pfds[0], pfds.size(), timeout);
+	if(n == -1)
+		return(errno == EINTR ? 0 : -1);
+
+	for(x=0, o=0; x<(int)pfds.size() && o<max && n; x++)
+	{
+		short re = pfds[x].revents;
+
+		if(!re)
+			continue;
+		n--;
+
+		ev[o].data = pdata[x];
+		ev[o].events = 0;
+		if(re & POLLIN)
+			ev[o].events |= POLLER_READ;
+		if(re & POLLOUT)
+			ev[o].events |= POLLER_WRITE;
+		if(re & (POLLERR | POLLHUP | POLLNVAL))
+			ev[o].events |= POLLER_ERROR;
+		o++;
+	}
+	return(o);
+}
+
+#endif
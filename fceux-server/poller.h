@@ -0,0 +1,49 @@
+/* FCE Ultra Network Play Server
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2004 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+
+#ifndef __FCEU_POLLER
+#define __FCEU_POLLER
+
+/* Waits on many sockets at once: epoll on Linux, kqueue on the BSDs and
+   OS X, poll() anywhere else (or when built with -DUSE_POLL).  Every socket
+   is watched for reading; writing only while asked for, when a send could
+   not go out in full.
+*/
+
+#define POLLER_READ	0x1
+#define POLLER_WRITE	0x2
+#define POLLER_ERROR	0x4	/* hung up or failed, a read will say which */
+
+typedef struct
+{
+	void *data;	/* what the socket was added with */
+	int events;	/* POLLER_* */
+} POLLEVENT;
+
+int PollerInit(void);
+int PollerAdd(int fd, void *data);
+int PollerWantWrite(int fd, void *data, int on);
+void PollerRemove(int fd);
+
+/* Returns the number of events put in ev, at most max, after waiting no
+   longer than timeout milliseconds. -1 on error. */
+int PollerWait(POLLEVENT *ev, int max, int timeout);
+
+#endif
@@ -35,26 +35,43 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdarg.h>
+#include <signal.h>
+#include <sys/uio.h>
 
+#include <algorithm>
+#include <deque>
 #include <exception>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "types.h"
 #include "md5.h"
 #include "throttle.h"
+#include "poller.h"
 
-#define VERSION "0.0.5"
+#define VERSION "0.0.6"
 #define DEFAULT_PORT 4046
 #define DEFAULT_MAX 100
 #define DEFAULT_TIMEOUT 5
 #define DEFAULT_FRAMEDIVISOR 1
 #define DEFAULT_CONFIG "/etc/fceux-server.conf"
 
-// MSG_NOSIGNAL and SOL_TCP have been depreciated on osx
+// SOL_TCP has been depreciated on osx
 #if defined (__APPLE__) || defined(BSD)
-#define MSG_NOSIGNAL SO_NOSIGPIPE
 #define SOL_TCP IPPROTO_TCP
 #endif
 
+/* A piece of output.  Something sent to a whole game is built once and
+   queued to each of its clients.
+*/
+typedef struct
+{
+	int refs;
+	uint32 len;
+	uint8 data[1];
+} OutBuf;
+
 typedef struct {
 	uint32 id; /* mainly for faster referencing when pointed to from the Games
 	              entries.
@@ -70,6 +87,15 @@ typedef struct {
 	uint8 *nbtcp;
 	uint32 nbtcphas, nbtcplen;
 	uint32 nbtcptype;
+
+	/* Output the socket hasn't taken yet, oldest first.  The first outofs
+	   bytes of the first buffer have already gone out.
+	*/
+	std::deque<OutBuf *> outq;
+	uint32 outofs, outbytes;
+	int wantwrite;      /* The poller is watching for room to write. */
+	int flushing;       /* On FlushList. */
+	int dead;           /* Disconnected once the current events are handled. */
 } ClientEntry;
 
 typedef struct
@@ -85,6 +111,7 @@ typedef struct
 	uint8 ExtraInfo[64];     /* Expansion information to be used in future versions
 	                            of FCE Ultra.
 	                         */
+	int number;              /* For the log. */
 } GameEntry;
 
 typedef struct
@@ -156,8 +183,13 @@ int LoadConfigFile(const char *fn)
 	return(1);
 }
 
-static ClientEntry *Clients;
-static GameEntry *Games;
+static std::vector<ClientEntry *> Clients;  /* By id, NULL for a free slot. */
+static std::vector<uint32> FreeIds;
+static std::map<std::string, GameEntry *> Games;  /* By game id. */
+static int NextGameNumber;
+
+static std::vector<ClientEntry *> FlushList;  /* Clients with output queued. */
+static std::vector<ClientEntry *> DeadList;
 
 static void en32(uint8 *buf, uint32 morp)
 {
@@ -174,10 +206,10 @@ static uint32 de32(uint8 *morp)
 
 static char *CleanNick(char *nick);
 static int NickUnique(ClientEntry *client);
-static void AddClientToGame(ClientEntry *client, uint8 id[16], uint8 extra[64]) throw();
-static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len) throw();
-static void BroadcastText(GameEntry *game, const char *fmt, ...) throw();
-static void TextToClient(ClientEntry *client, const char *fmt, ...) throw();
+static void AddClientToGame(ClientEntry *client, uint8 id[16], uint8 extra[64]);
+static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len);
+static void BroadcastText(GameEntry *game, const char *fmt, ...);
+static void TextToClient(ClientEntry *client, const char *fmt, ...);
 static void KillClient(ClientEntry *client);
 
 #define NBTCP_LOGINLEN      0x100
@@ -187,6 +219,9 @@ static void KillClient(ClientEntry *client);
 
 #define NBTCP_UPDATEDATA    0x800
 
+/* A client that lets this much output pile up is dropped. */
+#define OUTQ_MAX            (1024 * 1024)
+
 static void StartNBTCPReceive(ClientEntry *client, uint32 type, uint32 len)
 {
 	client->nbtcp = (uint8 *)malloc(len);
@@ -232,208 +267,228 @@ static uint8 *MakeMPS(ClientEntry *client)
 	return(buf);
 }
 
-/* Returns 1 if we are back to normal game mode, 0 if more data is yet to arrive. */
-static int CheckNBTCPReceive(ClientEntry *client) throw()
+/* Acts on a packet once it has all arrived. */
+static void HandleNBTCP(ClientEntry *client)
 {
-	if(!client->nbtcplen)
-		throw(1); /* Should not happen. */
-
-	int l;
+	uint32 len;
 
-	while(l = recv(client->TCPSocket, client->nbtcp + client->nbtcphas, client->nbtcplen  - client->nbtcphas, MSG_NOSIGNAL))
+	switch(client->nbtcptype & 0xF00)
 	{
-		if(l == -1)
+	case NBTCP_UPDATEDATA:
 		{
-			if(errno == EAGAIN || errno == EWOULDBLOCK)
-				break;
-			throw(1); /* Die now.  NOW. */
+			GameEntry *game = (GameEntry *)client->game;
+			int x, wx;
+			if(client->nbtcp[0] == 0xFF)
+			{
+				EndNBTCPReceive(client);
+				StartNBTCPReceive(client, NBTCP_COMMANDLEN, 5);
+				return;
+			}
+			for(x=0,wx=0; x < 4; x++)
+			{
+				if(game->Players[x] == client)
+				{
+					game->joybuf[x] = client->nbtcp[wx];
+					wx++;
+				}
+			}
+			RedoNBTCPReceive(client);
 		}
-		client->nbtcphas += l;
+		return;
+	case NBTCP_COMMANDLEN:
+		{
+			uint8 cmd = client->nbtcp[4];
+			len = de32(client->nbtcp);
+			if(len > 200000) /* Sanity check. */
+				throw(1);
 
-		//printf("Read: %d, %04x, %d, %d\n",l,client->nbtcptype,client->nbtcphas, client->nbtcplen);
+			//printf("%02x, %d\n",cmd,len);
+			if(!len && !(cmd&0x80))
+			{
+				SendToAll((GameEntry*)client->game, client->nbtcp[4], 0, 0);
+				EndNBTCPReceive(client);
+				StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
+			}
+			else if(client->nbtcp[4]&0x80)
+			{
+				EndNBTCPReceive(client);
+				if(len)
+				{
+					StartNBTCPReceive(client,NBTCP_COMMAND | cmd,len);
+				}
+				else
+				{
+					/* Woops.  Client probably tried to send a text message of 0 length.
+					   Or maybe a 0-length cheat file?  Better be safe! */
+					StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
+				}
+			}
+			else throw(1);
+			return;
+		}
+	case NBTCP_COMMAND:
+		{
+			len = client->nbtcplen;
+			uint32 tocmd = client->nbtcptype & 0xFF;
 
-		/* We're all full.  Yippie. */
-		if(client->nbtcphas == client->nbtcplen)
+			if(tocmd == 0x90) /* Text */
+			{
+				char *ma, *ma2;
+
+				ma = (char *) malloc(len + 1);
+				memcpy(ma, client->nbtcp, len);
+				ma[len] = 0;
+				asprintf(&ma2, "<%s> %s",client->nickname,ma);
+				free(ma);
+				ma = ma2;
+				len=strlen(ma);
+				SendToAll((GameEntry*)client->game, tocmd, (uint8 *)ma, len);
+				free(ma);
+			}
+			else
+			{
+				SendToAll((GameEntry*)client->game, tocmd, client->nbtcp, len);
+			}
+			EndNBTCPReceive(client);
+			StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
+			return;
+		}
+	case NBTCP_LOGINLEN:
+		len = de32(client->nbtcp);
+		if(len > 1024 || len < (16 + 16 + 64 + 1))
+		throw(1);
+		EndNBTCPReceive(client);
+		StartNBTCPReceive(client,NBTCP_LOGIN,len);
+		return;
+	case NBTCP_LOGIN:
 		{
 			uint32 len;
+			uint8 gameid[16];
+			uint8 *sexybuf;
+			uint8 extra[64];
 
-			switch(client->nbtcptype & 0xF00)
+			len = client->nbtcplen;
+			sexybuf = client->nbtcp;
+
+			/* Game ID(MD5'd game MD5 and password on client side). */
+			memcpy(gameid, sexybuf, 16);
+			sexybuf += 16;
+			len -= 16;
+
+			if(ServerConfig.Password)
+			if(memcmp(ServerConfig.Password,sexybuf,16))
 			{
-			case NBTCP_UPDATEDATA:
+				TextToClient(client,"Invalid server password.");
+				throw(1);
+			}
+			sexybuf += 16;
+			len -= 16;
+
+			memcpy(extra, sexybuf, 64);
+			sexybuf += 64;
+			len -= 64;
+
+			client->localplayers = *sexybuf;
+			if(client->localplayers < 1 || client->localplayers > 4)
+			{
+				TextToClient(client,"Invalid number(%d) of local players!",client->localplayers);
+				throw(1);
+			}
+			sexybuf++;
+			len -= 1;
+
+			AddClientToGame(client, gameid, extra);
+			/* Get the nickname */
+			if(len)
+			{
+				client->nickname = (char *)malloc(len + 1);
+				memcpy(client->nickname, sexybuf, len);
+				client->nickname[len] = 0;
+				if((client->nickname = CleanNick(client->nickname)))
+				if(!NickUnique(client)) /* Nickname already exists */
 				{
-					GameEntry *game = (GameEntry *)client->game;
-					int x, wx;
-					if(client->nbtcp[0] == 0xFF)
-					{
-						EndNBTCPReceive(client);
-						StartNBTCPReceive(client, NBTCP_COMMANDLEN, 5);
-						return(1);
-					}
-					for(x=0,wx=0; x < 4; x++)
-					{
-						if(game->Players[x] == client)
-						{
-							game->joybuf[x] = client->nbtcp[wx];
-							wx++;
-						}
-					}
-					RedoNBTCPReceive(client);
+					free(client->nickname);
+					client->nickname = 0;
 				}
-				return(1);
-			case NBTCP_COMMANDLEN:
-				{
-					uint8 cmd = client->nbtcp[4];
-					len = de32(client->nbtcp);
-					if(len > 200000) /* Sanity check. */
-						throw(1);
+			}
+			uint8 *mps = MakeMPS(client);
 
-					//printf("%02x, %d\n",cmd,len);
-					if(!len && !(cmd&0x80))
-					{
-						SendToAll((GameEntry*)client->game, client->nbtcp[4], 0, 0);
-						EndNBTCPReceive(client);
-						StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
-					}
-					else if(client->nbtcp[4]&0x80)
-					{
-						EndNBTCPReceive(client);
-						if(len)
-						{
-							StartNBTCPReceive(client,NBTCP_COMMAND | cmd,len);
-						}
-						else
-						{
-							/* Woops.  Client probably tried to send a text message of 0 length.
-							   Or maybe a 0-length cheat file?  Better be safe! */
-							StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
-						}
-					}
-					else throw(1);
-					return(1);
-				}
-			case NBTCP_COMMAND:
-				{
-					len = client->nbtcplen;
-					uint32 tocmd = client->nbtcptype & 0xFF;
+			if(!client->nickname)
+				asprintf(&client->nickname,"*Player %s",mps);
+
+			printf("Client %d assigned to game %d as player %s <%s>\n",client->id,((GameEntry*)client->game)->number,mps, client->nickname);
+
+			int x;
+			GameEntry *tg=(GameEntry *)client->game;
 
-					if(tocmd == 0x90) /* Text */
+			for(x=0; x<tg->MaxPlayers; x++)
+			{
+				if(tg->Players[x] && tg->IsUnique[x])
+				{
+					if(tg->Players[x] != client)
 					{
-						char *ma, *ma2;
-
-						ma = (char *) malloc(len + 1);
-						memcpy(ma, client->nbtcp, len);
-						ma[len] = 0;
-						asprintf(&ma2, "<%s> %s",client->nickname,ma);
-						free(ma);
-						ma = ma2;
-						len=strlen(ma);
-						SendToAll((GameEntry*)client->game, tocmd, (uint8 *)ma, len);
-						free(ma);
+						TextToClient(tg->Players[x], "* Player %s has just connected as: %s",MakeMPS(client),client->nickname);
+						TextToClient(client, "* Player %s is already connected as: %s",MakeMPS(tg->Players[x]),tg->Players[x]->nickname);
 					}
 					else
-					{
-						SendToAll((GameEntry*)client->game, tocmd, client->nbtcp, len);
-					}
-					EndNBTCPReceive(client);
-					StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
-					return(1);
+						TextToClient(client, "* You(Player %s) have just connected as: %s",MakeMPS(client),client->nickname);
 				}
-			case NBTCP_LOGINLEN:
-				len = de32(client->nbtcp);
-				if(len > 1024 || len < (16 + 16 + 64 + 1))
-				throw(1);
-				EndNBTCPReceive(client);
-				StartNBTCPReceive(client,NBTCP_LOGIN,len);
-				return(1);
-			case NBTCP_LOGIN:
-				{
-					uint32 len;
-					uint8 gameid[16];
-					uint8 *sexybuf;
-					uint8 extra[64];
-
-					len = client->nbtcplen;
-					sexybuf = client->nbtcp;
+			}
+		}
+		EndNBTCPReceive(client);
+		StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
+		return;
+	}
+}
 
-					/* Game ID(MD5'd game MD5 and password on client side). */
-					memcpy(gameid, sexybuf, 16);
-					sexybuf += 16;
-					len -= 16;
+/* Takes whatever has arrived, a packet at a time. */
+static void ReadClient(ClientEntry *client)
+{
+	uint8 buf[4096];
 
-					if(ServerConfig.Password)
-					if(memcmp(ServerConfig.Password,sexybuf,16))
-					{
-						TextToClient(client,"Invalid server password.");
-						throw(1);
-					}
-					sexybuf += 16;
-					len -= 16;
+	if(!client->nbtcplen)
+		throw(1); /* Should not happen. */
 
-					memcpy(extra, sexybuf, 64);
-					sexybuf += 64;
-					len -= 64;
+	for(;;)
+	{
+		int l = recv(client->TCPSocket, buf, sizeof(buf), 0);
 
-					client->localplayers = *sexybuf;
-					if(client->localplayers < 1 || client->localplayers > 4)
-					{
-						TextToClient(client,"Invalid number(%d) of local players!",client->localplayers);
-						throw(1);
-					}
-					sexybuf++;
-					len -= 1;
+		if(!l)
+			throw(1); /* Hung up. */
+		if(l == -1)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+			throw(1); /* Die now.  NOW. */
+		}
 
-					AddClientToGame(client, gameid, extra);
-					/* Get the nickname */
-					if(len)
-					{
-						client->nickname = (char *)malloc(len + 1);
-						memcpy(client->nickname, sexybuf, len);
-						client->nickname[len] = 0;
-						if((client->nickname = CleanNick(client->nickname)))
-						if(!NickUnique(client)) /* Nickname already exists */
-						{
-							free(client->nickname);
-							client->nickname = 0;
-						}
-					}
-					uint8 *mps = MakeMPS(client);
+		uint8 *bp = buf;
+		uint32 left = l;
 
-					if(!client->nickname)
-						asprintf(&client->nickname,"*Player %s",mps);
+		while(left)
+		{
+			uint32 n = client->nbtcplen - client->nbtcphas;
 
-					printf("Client %d assigned to game %d as player %s <%s>\n",client->id,(GameEntry*)client->game - Games,mps, client->nickname);
+			if(n > left)
+				n = left;
+			memcpy(client->nbtcp + client->nbtcphas, bp, n);
+			client->nbtcphas += n;
+			bp += n;
+			left -= n;
 
-					int x;
-					GameEntry *tg=(GameEntry *)client->game;
+			//printf("Read: %d, %04x, %d, %d\n",n,client->nbtcptype,client->nbtcphas, client->nbtcplen);
 
-					for(x=0; x<tg->MaxPlayers; x++)
-					{
-						if(tg->Players[x] && tg->IsUnique[x])
-						{
-							if(tg->Players[x] != client)
-							{
-								try
-								{
-									TextToClient(tg->Players[x], "* Player %s has just connected as: %s",MakeMPS(client),client->nickname);
-								}
-								catch(int i)
-								{
-									KillClient(tg->Players[x]);
-								}
-								TextToClient(client, "* Player %s is already connected as: %s",MakeMPS(tg->Players[x]),tg->Players[x]->nickname);
-							}
-							else
-								TextToClient(client, "* You(Player %s) have just connected as: %s",MakeMPS(client),client->nickname);
-						}
-					}
-				}
-				EndNBTCPReceive(client);
-				StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
-				return(1);
-			}
+			/* We're all full.  Yippie. */
+			if(client->nbtcphas == client->nbtcplen)
+				HandleNBTCP(client);
 		}
+
+		/* Short of the buffer, so that was all of it. */
+		if(l < (int)sizeof(buf))
+			return;
 	}
-	return(0);
 }
 
 int ListenSocket;
@@ -469,44 +524,150 @@ static int NickUnique(ClientEntry *client)
 	return(1);
 }
 
-static int MakeSendTCP(ClientEntry *client, uint8 *data, uint32 len) throw()
+static OutBuf *NewOutBuf(const uint8 *data, uint32 len)
 {
-	if(send(client->TCPSocket, data, len, MSG_NOSIGNAL) != len)
-		throw(1);
+	OutBuf *ob = (OutBuf *)malloc(sizeof(OutBuf) + len);
 
-	return(1);
+	ob->refs = 1;
+	ob->len = len;
+	memcpy(ob->data, data, len);
+	return(ob);
 }
 
-static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len) throw()
+static void DropOutBuf(OutBuf *ob)
 {
-	uint8 poo[5];
-	int x;
+	if(!--ob->refs)
+		free(ob);
+}
 
-	poo[4] = cmd;
+/* Output goes out from FlushClients(), all of a client's in one writev(). */
+static void QueueOutBuf(ClientEntry *client, OutBuf *ob)
+{
+	if(client->dead)
+		return;
 
-	for(x=0;x<game->MaxPlayers;x++)
+	ob->refs++;
+	client->outq.push_back(ob);
+	client->outbytes += ob->len;
+
+	if(client->outbytes > OUTQ_MAX)
 	{
-		if(!game->Players[x] || !game->IsUnique[x]) continue;
+		printf("Client %d isn't keeping up, dropping it.\n", client->id);
+		KillClient(client);
+		return;
+	}
+	if(!client->flushing)
+	{
+		client->flushing = 1;
+		FlushList.push_back(client);
+	}
+}
+
+static void MakeSendTCP(ClientEntry *client, uint8 *data, uint32 len)
+{
+	OutBuf *ob = NewOutBuf(data, len);
 
-		try
+	QueueOutBuf(client, ob);
+	DropOutBuf(ob);
+}
+
+static void FlushClient(ClientEntry *client)
+{
+	while(!client->outq.empty())
+	{
+		struct iovec iov[64];
+		int n = 0;
+
+		for(std::deque<OutBuf *>::iterator it = client->outq.begin(); it != client->outq.end() && n < 64; it++, n++)
 		{
-			if(cmd & 0x80)
-				en32(poo, len);
-			MakeSendTCP(game->Players[x],poo,5);
+			uint32 skip = n ? 0 : client->outofs;
+
+			iov[n].iov_base = (*it)->data + skip;
+			iov[n].iov_len = (*it)->len - skip;
+		}
+
+		ssize_t l = writev(client->TCPSocket, iov, n);
 
-			if(cmd & 0x80)
+		if(l == -1)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
 			{
-				MakeSendTCP(game->Players[x], data, len);
+				/* Finish up once the socket has room. */
+				if(!client->wantwrite && PollerWantWrite(client->TCPSocket, client, 1))
+					client->wantwrite = 1;
+				return;
 			}
+			KillClient(client);
+			return;
 		}
-		catch(int i)
+
+		client->outbytes -= l;
+		while(l)
 		{
-			KillClient(game->Players[x]);
+			OutBuf *ob = client->outq.front();
+			uint32 rest = ob->len - client->outofs;
+
+			if((uint32)l < rest)
+			{
+				client->outofs += l;
+				break;
+			}
+			l -= rest;
+			client->outofs = 0;
+			client->outq.pop_front();
+			DropOutBuf(ob);
 		}
 	}
+
+	if(client->wantwrite)
+	{
+		PollerWantWrite(client->TCPSocket, client, 0);
+		client->wantwrite = 0;
+	}
+}
+
+static void FlushClients(void)
+{
+	/* A client dropped while flushing is only marked, so the list holds. */
+	for(size_t x = 0; x < FlushList.size(); x++)
+	{
+		FlushList[x]->flushing = 0;
+		FlushClient(FlushList[x]);
+	}
+	FlushList.clear();
 }
 
-static void TextToClient(ClientEntry *client, const char *fmt, ...) throw()
+static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len)
+{
+	uint8 poo[5] = { 0 };
+	OutBuf *head, *body = 0;
+	int x;
+
+	poo[4] = cmd;
+	if(cmd & 0x80)
+	{
+		en32(poo, len);
+		body = NewOutBuf(data, len);
+	}
+	head = NewOutBuf(poo, 5);
+
+	for(x=0;x<game->MaxPlayers;x++)
+	{
+		if(!game->Players[x] || !game->IsUnique[x]) continue;
+
+		QueueOutBuf(game->Players[x], head);
+		if(body)
+			QueueOutBuf(game->Players[x], body);
+	}
+
+	DropOutBuf(head);
+	if(body)
+		DropOutBuf(body);
+}
+
+static void TextToClient(ClientEntry *client, const char *fmt, ...)
 {
 	char *moo;
 	va_list ap;
@@ -528,7 +689,7 @@ static void TextToClient(ClientEntry *client, const char *fmt, ...) throw()
 	free(moo);
 }
 
-static void BroadcastText(GameEntry *game, const char *fmt, ...) throw()
+static void BroadcastText(GameEntry *game, const char *fmt, ...)
 {
 	char *moo;
 	va_list ap;
@@ -541,11 +702,26 @@ static void BroadcastText(GameEntry *game, const char *fmt, ...) throw()
 	free(moo);
 }
 
+/* Only marks the client, ReapClients() disconnects it once nothing is
+   looking at it any more.
+*/
 static void KillClient(ClientEntry *client)
+{
+	if(client->dead)
+		return;
+
+	client->dead = 1;
+	DeadList.push_back(client);
+}
+
+static void ReapClient(ClientEntry *client)
 {
 	GameEntry *game;
-	uint8 *mps;
-	char *bmsg;
+	char *bmsg = 0;
+
+	/* Whatever it was last told, like why it's being dropped. */
+	if(client->TCPSocket != -1)
+		FlushClient(client);
 
 	game = (GameEntry *)client->game;
 	if(game)
@@ -562,14 +738,15 @@ static void KillClient(ClientEntry *client)
 					game->Players[w] = NULL;
 
 		time_t curtime = time(0);
-		printf("Player <%s> disconnected from game %d on %s",client->nickname,game-Games,ctime(&curtime));
+		printf("Player <%s> disconnected from game %d on %s",client->nickname,game->number,ctime(&curtime));
 		asprintf(&bmsg, "* Player %s <%s> left.",MakeMPS(client),client->nickname);
 		if(tc == client->localplayers) /* If total players for this game = total local
 		                                  players for this client, destroy the game.
 		                               */
 		{
-			printf("Game %d destroyed.\n",game-Games);
-			memset(game, 0, sizeof(GameEntry));
+			printf("Game %d destroyed.\n",game->number);
+			Games.erase(std::string((char *)game->id, 16));
+			delete game;
 			game = 0;
 		}
 	}
@@ -586,71 +763,66 @@ static void KillClient(ClientEntry *client)
 		free(client->nickname);
 
 	if(client->TCPSocket != -1)
+	{
+		PollerRemove(client->TCPSocket);
 		close(client->TCPSocket);
+	}
+
+	while(!client->outq.empty())
+	{
+		DropOutBuf(client->outq.front());
+		client->outq.pop_front();
+	}
+
+	if(client->flushing)
+		FlushList.erase(std::find(FlushList.begin(), FlushList.end(), client));
 
-	memset(client, 0, sizeof(ClientEntry));
-	client->TCPSocket = -1;
+	Clients[client->id] = NULL;
+	FreeIds.push_back(client->id);
+	delete client;
 
 	if(game)
 		BroadcastText(game,"%s",bmsg);
+	free(bmsg);
 }
 
-static void AddClientToGame(ClientEntry *client, uint8 id[16], uint8 extra[64]) throw()
+static void ReapClients(void)
 {
-	int wg;
-	GameEntry *game,*fegame;
-
-retry:
-
-	game = NULL;
-	fegame = NULL;
+	/* Telling a game someone left can drop another, it goes on the end. */
+	for(size_t x = 0; x < DeadList.size(); x++)
+		ReapClient(DeadList[x]);
+	DeadList.clear();
+}
 
-	/* First, find an available game. */
-	for(wg=0; wg<ServerConfig.MaxClients; wg++)
-	{
-		if(!Games[wg].MaxPlayers && !fegame)
-		{
-			if(!fegame)
-				fegame=&Games[wg];
-		}
-		else if(!memcmp(Games[wg].id,id,16)) /* A match was found! */
-		{
-			game = &Games[wg];
-			break;
-		}
-	}
+static void AddClientToGame(ClientEntry *client, uint8 id[16], uint8 extra[64])
+{
+	GameEntry *game;
+	std::string key((char *)id, 16);
+	std::map<std::string, GameEntry *>::iterator it = Games.find(key);
 
-	if(!game) /* Hmm, no game found.  Guess we'll have to create one. */
+	if(it != Games.end()) /* A match was found! */
+		game = it->second;
+	else /* Hmm, no game found.  Guess we'll have to create one. */
 	{
-		game=fegame;
-		printf("Game %d added\n",game-Games);
-		memset(game, 0, sizeof(GameEntry));
+		game = new GameEntry();
+		game->number = NextGameNumber++;
+		printf("Game %d added\n",game->number);
 		game->MaxPlayers = 4;
 		memcpy(game->id, id, 16);
 		memcpy(game->ExtraInfo, extra, 64);
+		Games[key] = game;
 	}
 
+	/* Ask one of the players already there for the state of the game.  One
+	   that is on its way out may still be listed, it gets skipped. */
 	int n;
 	for(n = 0; n < game->MaxPlayers; n++)
-	if(game->Players[n])
+	if(game->Players[n] && !game->Players[n]->dead)
 	{
-		try
-		{
-			uint8 b[5];
-			b[4] = 0x81;
-			MakeSendTCP(game->Players[n], b, 5);
-			break;
-		}
-		catch(int i)
-		{
-			KillClient(game->Players[n]);
-			/* All right, now the client we sent the request to is killed.  I HOPE YOU'RE HAPPY! */
-			/* Since killing a client can destroy a game, we'll need to see if the game was trashed.
-			   If it was, then "goto retry", and try again.  Ugly, yes.  I LIKE UGLY.
-			*/
-			if(!game->MaxPlayers)
-				goto retry;
-		}
+		uint8 b[5] = { 0 };
+		b[4] = 0x81;
+		MakeSendTCP(game->Players[n], b, 5);
+		break;
 	}
 
 	int instancecount = client->localplayers;
@@ -683,8 +855,90 @@ retry:
 	client->game = (void *)game;
 }
 
+static void AcceptClients(void)
+{
+	for(;;)
+	{
+		struct sockaddr_in sockin;
+		socklen_t sockin_len = sizeof(sockin);
+		int fd = accept(ListenSocket, (struct sockaddr *)&sockin, &sockin_len);
+
+		if(fd == -1)
+		{
+			if(errno == EINTR)
+				continue;
+			return;
+		}
+
+		if(FreeIds.empty())
+		{
+			printf("Server full, turned away %s\n",inet_ntoa(sockin.sin_addr));
+			close(fd);
+			continue;
+		}
+
+		/* We have a new client.  Yippie. */
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+		int tcpopt = 1;
+		setsockopt(fd, SOL_TCP, TCP_NODELAY, &tcpopt, sizeof(int));
+
+		ClientEntry *client = new ClientEntry();
+		int n = FreeIds.back();
+
+		FreeIds.pop_back();
+		Clients[n] = client;
+		client->TCPSocket = fd;
+		client->timeconnect = time(0);
+		client->id = n;
+		printf("Client %d connecting from %s on %s",n,inet_ntoa(sockin.sin_addr),ctime(&client->timeconnect));
+
+		if(!PollerAdd(fd, client))
+		{
+			client->TCPSocket = -1;
+			close(fd);
+			KillClient(client);
+			continue;
+		}
+		{
+			uint8 buf[1];
+
+			buf[0] = ServerConfig.FrameDivisor;
+			MakeSendTCP(client,buf,1);
+		}
+		StartNBTCPReceive(client, NBTCP_LOGINLEN, 4);
+	}
+}
+
+/* The players' input, to every game at once. */
+static void SendUpdates(void)
+{
+	for(std::map<std::string, GameEntry *>::iterator it = Games.begin(); it != Games.end(); it++)
+	{
+		GameEntry *game = it->second;
+		OutBuf *ob = NewOutBuf(game->joybuf, 5);
+		int n;
+
+		for(n = 0; n < game->MaxPlayers; n++)
+		{
+			if(!game->Players[n] || !game->IsUnique[n]) continue;
+			QueueOutBuf(game->Players[n], ob);
+		}
+		DropOutBuf(ob);
+	}
+}
 
+/* Drops users still in the login process(not yet assigned a game). BOING */
+static void CheckLoginTimeouts(time_t curtime)
+{
+	for(size_t n = 0; n < Clients.size(); n++)
+	{
+		ClientEntry *client = Clients[n];
 
+		if(client && !client->game && (client->timeconnect + ServerConfig.ConnectTimeout) < curtime)
+			KillClient(client);
+	}
+}
 
 int main(int argc, char *argv[])
 {
@@ -807,18 +1061,20 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	Games = (GameEntry *)malloc(sizeof(GameEntry) * ServerConfig.MaxClients);
-	Clients = (ClientEntry *)malloc(sizeof(ClientEntry) * ServerConfig.MaxClients);
+	Clients.resize(ServerConfig.MaxClients, NULL);
+	for(i=ServerConfig.MaxClients; i>0; i--)
+		FreeIds.push_back(i - 1);
+
+	RefreshThrottleFPS(ServerConfig.FrameDivisor);
 
-	memset(Games,0,sizeof(GameEntry) * ServerConfig.MaxClients);
-	memset(Clients,0,sizeof(ClientEntry) * ServerConfig.MaxClients);
+	/* A client gone away shows up as a failed write, not a signal. */
+	signal(SIGPIPE, SIG_IGN);
 
+	if(!PollerInit())
 	{
-		int x;
-		for(x=0; x<ServerConfig.MaxClients; x++)
-			Clients[x].TCPSocket = -1;
+		printf("Error: %s\n",strerror(errno));
+		exit(-1);
 	}
-	RefreshThrottleFPS(ServerConfig.FrameDivisor);
 
 	/* First, we need to create a socket to listen on. */
 	ListenSocket = socket(AF_INET, SOCK_STREAM, 0);
@@ -849,7 +1105,7 @@ int main(int argc, char *argv[])
 	}
 	puts("Ok");
 	printf("Listening on socket... ");
-	if(listen(ListenSocket, 8))
+	if(listen(ListenSocket, 128))
 	{
 		printf("Error: %s",strerror(errno));
 		exit(-1);
@@ -858,90 +1114,69 @@ int main(int argc, char *argv[])
 
 	/* We don't want to block on accept() */
 	fcntl(ListenSocket, F_SETFL, fcntl(ListenSocket, F_GETFL) | O_NONBLOCK);
+	PollerAdd(ListenSocket, &ListenSocket);
 
-	/* Now for the BIG LOOP. */
+	time_t lastcheck = 0;
+
+	/* Now for the BIG LOOP.  It sleeps until a socket wants something or
+	   the next update is due.
+	*/
 	while(1)
 	{
-		int n;
+		POLLEVENT ev[256];
+		int timeout = (ThrottleTimeLeft() + 999) / 1000;
 
-		for(n=0; n<ServerConfig.MaxClients; n++)
+		/* With no games there are no updates, only logins to time out. */
+		if(Games.empty())
+			timeout = 1000;
+		int n = PollerWait(ev, 256, timeout);
+
+		if(n == -1)
 		{
-			if(Clients[n].TCPSocket != -1) continue;
-			if((Clients[n].TCPSocket = accept(ListenSocket, (struct sockaddr *)&sockin, &sockin_len)) != -1)
-			{
-				struct sockaddr_in usockin;
-				/* We have a new client.  Yippie. */
+			printf("Error: %s\n",strerror(errno));
+			exit(-1);
+		}
 
-				fcntl(Clients[n].TCPSocket, F_SETFL, fcntl(Clients[n].TCPSocket, F_GETFL) | O_NONBLOCK);
+		for(i = 0; i < n; i++)
+		{
+			if(ev[i].data == &ListenSocket)
+			{
+				AcceptClients();
+				continue;
+			}
 
-				Clients[n].timeconnect = time(0);
-				Clients[n].id = n;
-				printf("Client %d connecting from %s on %s",n,inet_ntoa(sockin.sin_addr),ctime(&Clients[n].timeconnect));
-				{
-					uint8 buf[1];
+			ClientEntry *client = (ClientEntry *)ev[i].data;
+			if(client->dead) continue;
 
-					buf[0] = ServerConfig.FrameDivisor;
-					send(Clients[n].TCPSocket,buf,1,MSG_NOSIGNAL);
-				}
-				StartNBTCPReceive(&Clients[n], NBTCP_LOGINLEN, 4);
+			try
+			{
+				if(ev[i].events & (POLLER_READ | POLLER_ERROR))
+					ReadClient(client);
+				if(!client->dead && (ev[i].events & POLLER_WRITE))
+					FlushClient(client);
 			}
-		}
-
-		/* Check for users still in the login process(not yet assigned a game). BOING */
-		time_t curtime = time(0);
-		for(n = 0; n < ServerConfig.MaxClients; n++)
-		try
-		{
-			if(Clients[n].TCPSocket != -1 && !Clients[n].game)
+			catch(int i)
 			{
-				if((Clients[n].timeconnect + ServerConfig.ConnectTimeout) < curtime)
-				{
-					KillClient(&Clients[n]);
-				}
-				else
-					while(CheckNBTCPReceive(&Clients[n])) {};
+				KillClient(client);
 			}
 		}
-		catch(int i)
+
+		/* Now we send the data to all the clients. */
+		if(!ThrottleTimeLeft())
 		{
-			KillClient(&Clients[n]);
+			ThrottleAdvance();
+			SendUpdates();
 		}
 
-		int whichgame;
-		for(whichgame = 0; whichgame < ServerConfig.MaxClients; whichgame ++)
+		time_t curtime = time(0);
+		if(curtime != lastcheck)
 		{
-			/* Now, the loop to get data from each client.  Meep. */
-			for(n = 0; n < Games[whichgame].MaxPlayers; n++)
-			{
-				try
-				{
-					ClientEntry *client = Games[whichgame].Players[n];
-					if(!client || !Games[whichgame].IsUnique[n]) continue;
-					int localplayers = client->localplayers;
-
-					while(CheckNBTCPReceive(client)) {};
-				} // catch
-				catch(int i)
-				{
-					KillClient(Games[whichgame].Players[n]);
-				}
-			} // A games clients
-
-			/* Now we send the data to all the clients. */
-			for(n = 0; n < Games[whichgame].MaxPlayers; n++)
-			{
-				if(!Games[whichgame].Players[n] || !Games[whichgame].IsUnique[n]) continue;
-				try
-				{
-					MakeSendTCP(Games[whichgame].Players[n], Games[whichgame].joybuf, 5);
-				}
-				catch(int i)
-				{
-					KillClient(Games[whichgame].Players[n]);
-				}
-			} // A game's clients
-		} // Games
+			lastcheck = curtime;
+			CheckLoginTimeouts(curtime);
+		}
 
-		SpeedThrottle();
+		FlushClients();
+		ReapClients();
+		FlushClients();
 	} // while(1)
 }
@@ -21,6 +21,7 @@
 
 
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 #include "types.h"
 #include "throttle.h"
@@ -74,29 +75,36 @@ void RefreshThrottleFPS(int divooder)
 static uint64 GetCurTime(void)
 {
  uint64 ret;
- struct timeval tv;
+ struct timespec ts;
 
- gettimeofday(&tv,0);
- ret=(uint64)tv.tv_sec*1000000;
- ret+=tv.tv_usec;
+ /* Not the wall clock, so setting the date doesn't stall the games. */
+ clock_gettime(CLOCK_MONOTONIC,&ts);
+ ret=(uint64)ts.tv_sec*1000000;
+ ret+=ts.tv_nsec/1000;
  return(ret);
 }
 
-void SpeedThrottle(void)
-{
- static uint64 ttime,ltime;
+static uint64 ltime;
 
- waiter:
- ttime=GetCurTime();
+/* Returns how many microseconds are left until the next update is due,
+   0 if it is due now. */
+uint64 ThrottleTimeLeft(void)
+{
+ uint64 ttime=GetCurTime();
 
  if( (ttime-ltime) < (tfreq/desiredfps) )
- {
-  usleep(1000);
-  goto waiter;
- }
+  return(ltime+tfreq/desiredfps-ttime);
+ return(0);
+}
+
+/* Call when an update has gone out.  Up to 4 late updates are caught up
+   on, past that the schedule starts over from now. */
+void ThrottleAdvance(void)
+{
+ uint64 ttime=GetCurTime();
+
  if( (ttime-ltime) >= (tfreq*4/desiredfps))
   ltime=ttime;
  else
   ltime+=tfreq/desiredfps;
 }
-
@@ -20,4 +20,5 @@
 
 
 void RefreshThrottleFPS(int divooder);
-void SpeedThrottle(void);
+uint64 ThrottleTimeLeft(void);
+void ThrottleAdvance(void);
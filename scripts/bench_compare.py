@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+#
+# Compares two fceux-bench reports (see src/drivers/headless/fceux_bench.cpp).
+#
+#   bench_compare.py base.json new.json [--threshold 5]
+#
+# Prints the change of every case both reports ran and exits with status 1
+# when any case got slower by more than --threshold percent, allocates more
+# per frame than before, or ends with a different RAM hash or different
+# emulation work counters, which means the two builds did not emulate the
+# same thing.
+
+import argparse
+import json
+
+# Work counters that depend only on the input, not on the speed of the build
+EMULATION_COUNTERS = ("instructions", "lines_rendered", "lines_skipped", "sound_samples")
+
+
+def load(path):
+    with open(path) as f:
+        report = json.load(f)
+    return report, {c["name"]: c for c in report["cases"] if c.get("status") == "ok"}
+
+
+def speed(case):
+    """Higher is better for every number compared."""
+    if case["mode"] == "savestate":
+        return case["loads_per_sec"], "loads/s"
+    return case["fps"], "fps"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two fceux-bench reports")
+    parser.add_argument("base")
+    parser.add_argument("new")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="percent a case may get slower, default 5")
+    args = parser.parse_args()
+
+    base_report, base = load(args.base)
+    new_report, new = load(args.new)
+    print("base: %s %s" % (base_report.get("version", "?"), base_report.get("git_rev", "")))
+    print("new:  %s %s" % (new_report.get("version", "?"), new_report.get("git_rev", "")))
+    if base_report.get("schema", 1) != new_report.get("schema", 1):
+        print("report schemas differ (%d and %d), comparing the fields both have"
+              % (base_report.get("schema", 1), new_report.get("schema", 1)))
+
+    regressions = 0
+    for name in [n for n in base if n in new]:
+        b, n = base[name], new[name]
+        b_speed, unit = speed(b)
+        n_speed, _ = speed(n)
+        change = (n_speed / b_speed - 1.0) * 100.0 if b_speed else 0.0
+        notes = []
+
+        if change < -args.threshold:
+            notes.append("SLOWER")
+        if b.get("ram_hash") != n.get("ram_hash"):
+            notes.append("RAM HASH DIFFERS")
+        if b["mode"] == "run" and n["allocations"] * b["frames"] > b["allocations"] * n["frames"]:
+            notes.append("MORE ALLOCATIONS (%d -> %d)" % (b["allocations"], n["allocations"]))
+        if b["mode"] == "run" and "counters" in b and "counters" in n:
+            differ = [k for k in EMULATION_COUNTERS if b["counters"].get(k) != n["counters"].get(k)]
+            if differ:
+                notes.append("COUNTERS DIFFER (%s)" % ", ".join(differ))
+        if notes:
+            regressions += 1
+
+        print("%-24s %10.1f -> %10.1f %-8s %+6.1f%%  %s"
+              % (name, b_speed, n_speed, unit, change, " ".join(notes)))
+
+    for name in sorted(set(base) ^ set(new)):
+        print("%-24s only in %s" % (name, args.base if name in base else args.new))
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+#
+# Converts an FCEUX indexed capture (see src/capture.h) to a video file.
+#
+#   fcap2mp4.py run.fcap run.mp4 [--scale N] [--ffmpeg-args "..."]
+#   fcap2mp4.py run.fcap --raw frames.rgb [--wav sound.wav]
+#
+# Frames are rendered to RGB24 with the palette stored in the capture and fed
+# to ffmpeg on stdin; the sound is written to a temporary WAV file and muxed
+# in. --raw skips ffmpeg and writes the RGB24 frames as they are.
+
+import argparse
+import os
+import struct
+import subprocess
+import tempfile
+import wave
+import zlib
+
+MAGIC = b"FCEUCAP1"
+
+
+def read_capture(path):
+    """Yields ('header', dict), ('palette', bytes), ('frame', bytes pix, bytes
+    deemph) and ('audio', bytes) in file order."""
+    with open(path, "rb") as f:
+        if f.read(8) != MAGIC:
+            raise SystemExit("%s: not an FCEUX indexed capture" % path)
+        width, height, fps, rate = struct.unpack("<4I", f.read(16))
+        yield "header", {"width": width, "height": height,
+                         "fps": fps / 16777216.0, "rate": rate}
+
+        plane = width * height
+        prev = bytearray(plane * 2)
+
+        while True:
+            hdr = f.read(8)
+            if len(hdr) < 8:
+                break
+            cid, length = hdr[:4], struct.unpack("<I", hdr[4:])[0]
+            data = f.read(length)
+            if len(data) < length:
+                break  # truncated by a crash, keep what is complete
+
+            if cid == b"PALT":
+                yield "palette", data
+            elif cid == b"FRAM":
+                flags, mask = data[0], data[1:1 + height * 2 // 8]
+                lines = zlib.decompress(data[1 + len(mask):])
+                pos = 0
+                for row in range(height * 2):
+                    if not mask[row >> 3] & (1 << (row & 7)):
+                        continue
+                    line = lines[pos:pos + width]
+                    pos += width
+                    ofs = row * width
+                    if not flags & 1:
+                        n = int.from_bytes(line, "little") ^ int.from_bytes(prev[ofs:ofs + width], "little")
+                        line = n.to_bytes(width, "little")
+                    prev[ofs:ofs + width] = line
+                yield "frame", bytes(prev[:plane]), bytes(prev[plane:])
+            elif cid == b"AUDO":
+                yield "audio", data
+
+
+def build_lut(palette):
+    # index (deemph << 8) | pixel -> rgb, same mapping the blitters use
+    lut = []
+    for d in range(8):
+        for p in range(256):
+            e = ((p & 0x3F) + d * 64) * 3
+            lut.append(palette[e:e + 3])
+    return lut
+
+
+def render(lut, pix, deemph, scale):
+    rows = []
+    width = 256
+    for y in range(len(pix) // width):
+        row = b"".join(lut[(deemph[i] << 8) | pix[i]] * scale
+                       for i in range(y * width, (y + 1) * width))
+        rows.append(row * scale)
+    return b"".join(rows)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Convert an FCEUX indexed capture to video")
+    ap.add_argument("capture")
+    ap.add_argument("output", nargs="?")
+    ap.add_argument("--scale", type=int, default=1)
+    ap.add_argument("--raw", help="write RGB24 frames here instead of running ffmpeg")
+    ap.add_argument("--wav", help="write the sound here")
+    ap.add_argument("--ffmpeg-args", default="-c:v libx264 -pix_fmt yuv420p -crf 18")
+    args = ap.parse_args()
+
+    if not args.output and not args.raw:
+        ap.error("need an output file or --raw")
+
+    chunks = read_capture(args.capture)
+    _, info = next(chunks)
+    w, h = info["width"] * args.scale, info["height"] * args.scale
+
+    wavpath = args.wav
+    if not wavpath and not args.raw and info["rate"]:
+        fd, wavpath = tempfile.mkstemp(suffix=".wav")
+        os.close(fd)
+    wav = None
+    if wavpath and info["rate"]:
+        wav = wave.open(wavpath, "wb")
+        wav.setnchannels(1)
+        wav.setsampwidth(2)
+        wav.setframerate(info["rate"])
+
+    if args.raw:
+        out, proc = open(args.raw, "wb"), None
+    else:
+        # sound is muxed in a second pass once the WAV is complete
+        vidpath = args.output + ".video.mkv" if wav else args.output
+        cmd = ["ffmpeg", "-y", "-loglevel", "error",
+               "-f", "rawvideo", "-pix_fmt", "rgb24", "-s", "%dx%d" % (w, h),
+               "-r", "%.6f" % info["fps"], "-i", "-"] + args.ffmpeg_args.split() + [vidpath]
+        proc = subprocess.Popen(cmd, stdin=subprocess.PIPE)
+        out = proc.stdin
+
+    lut = None
+    frames = 0
+    for chunk in chunks:
+        if chunk[0] == "palette":
+            lut = build_lut(chunk[1])
+        elif chunk[0] == "frame":
+            out.write(render(lut, chunk[1], chunk[2], args.scale))
+            frames += 1
+        elif chunk[0] == "audio" and wav:
+            wav.writeframes(chunk[1])
+
+    out.close()
+    if wav:
+        wav.close()
+    if proc:
+        if proc.wait():
+            raise SystemExit("ffmpeg failed")
+        if wav:
+            subprocess.check_call(["ffmpeg", "-y", "-loglevel", "error", "-i", vidpath,
+                                   "-i", wavpath, "-c:v", "copy", "-c:a", "aac",
+                                   "-shortest", args.output])
+            os.remove(vidpath)
+            if not args.wav:
+                os.remove(wavpath)
+
+    print("%d frames, %dx%d at %.4f fps" % (frames, w, h, info["fps"]))
+
+
+if __name__ == "__main__":
+    main()
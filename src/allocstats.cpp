@@ -0,0 +1,194 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// allocstats.cpp
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+#include "types.h"
+#include "fceu.h"
+#include "movie.h"
+#include "allocstats.h"
+
+//*****************************************************************
+// Counting operator new
+//*****************************************************************
+static std::atomic<uint64_t> allocCount(0);
+static std::atomic<uint64_t> allocBytes(0);
+static thread_local uint64_t threadAllocCount = 0;
+
+static inline void CountAlloc(size_t size)
+{
+	allocCount.fetch_add( 1, std::memory_order_relaxed );
+	allocBytes.fetch_add( size, std::memory_order_relaxed );
+	threadAllocCount++;
+}
+
+void *operator new(size_t size)
+{
+	CountAlloc(size);
+
+	void *p = malloc( size ? size : 1 );
+
+	if (p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	CountAlloc(size);
+
+	return malloc( size ? size : 1 );
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+uint64_t FCEU_AllocCount(void)
+{
+	return allocCount.load( std::memory_order_relaxed );
+}
+
+uint64_t FCEU_AllocBytes(void)
+{
+	return allocBytes.load( std::memory_order_relaxed );
+}
+
+uint64_t FCEU_ThreadAllocCount(void)
+{
+	return threadAllocCount;
+}
+
+//*****************************************************************
+// Per frame check
+//*****************************************************************
+// written by the emulating thread only, atomics so readers never tear
+static std::atomic<int>      warmupLeft( FCEU_ALLOC_WARMUP_FRAMES );
+static std::atomic<uint64_t> framesCounted(0);
+static std::atomic<uint64_t> framesAllocating(0);
+static std::atomic<uint64_t> frameAllocations(0);
+static std::atomic<uint64_t> maxPerFrame(0);
+static std::atomic<int>      lastFrame(-1);
+
+FCEU_FrameAllocScope::~FCEU_FrameAllocScope(void)
+{
+	uint64_t n = FCEU_ThreadAllocCount() - start;
+	int warmup = warmupLeft.load( std::memory_order_relaxed );
+
+	if (warmup > 0)
+	{
+		warmupLeft.store( warmup - 1, std::memory_order_relaxed );
+		return;
+	}
+	framesCounted.fetch_add( 1, std::memory_order_relaxed );
+
+	if (n == 0)
+	{
+		return;
+	}
+	framesAllocating.fetch_add( 1, std::memory_order_relaxed );
+	frameAllocations.fetch_add( n, std::memory_order_relaxed );
+	lastFrame.store( currFrameCounter, std::memory_order_relaxed );
+
+	if (n > maxPerFrame.load( std::memory_order_relaxed ))
+	{
+		maxPerFrame.store( n, std::memory_order_relaxed );
+	}
+#ifdef __FCEU_ALLOC_CHECK__
+	// the first ones and then one in a thousand, a leak every frame would flood the console
+	uint64_t seen = framesAllocating.load( std::memory_order_relaxed );
+
+	if ( (seen <= 16) || ((seen % 1000) == 0) )
+	{
+		FCEU_printf("Frame %d made %llu heap allocations after warm-up (%llu such frames)\n",
+			currFrameCounter, (unsigned long long)n, (unsigned long long)seen);
+	}
+#endif
+}
+
+void FCEU_GetFrameAllocStats(FCEU_FrameAllocStats *stats)
+{
+	stats->frames           = framesCounted.load( std::memory_order_relaxed );
+	stats->framesAllocating = framesAllocating.load( std::memory_order_relaxed );
+	stats->allocations      = frameAllocations.load( std::memory_order_relaxed );
+	stats->maxPerFrame      = maxPerFrame.load( std::memory_order_relaxed );
+	stats->lastFrame        = lastFrame.load( std::memory_order_relaxed );
+}
+
+void FCEU_FrameAllocReset(void)
+{
+	warmupLeft.store( FCEU_ALLOC_WARMUP_FRAMES, std::memory_order_relaxed );
+}
+
+//*****************************************************************
+// Resident memory
+//*****************************************************************
+bool FCEU_GetMemoryUsage(FCEU_MemoryUsage *usage)
+{
+	usage->resident = usage->residentAnon = usage->residentPeak = 0;
+
+#ifdef __linux__
+	FILE *fp = fopen( "/proc/self/status", "r" );
+	char line[256];
+	unsigned long long kb;
+
+	if (fp == nullptr)
+	{
+		return false;
+	}
+	while ( fgets( line, sizeof(line), fp ) )
+	{
+		if ( sscanf( line, "VmRSS: %llu kB", &kb ) == 1 )
+		{
+			usage->resident = kb * 1024;
+		}
+		else if ( sscanf( line, "RssAnon: %llu kB", &kb ) == 1 )
+		{
+			usage->residentAnon = kb * 1024;
+		}
+		else if ( sscanf( line, "VmHWM: %llu kB", &kb ) == 1 )
+		{
+			usage->residentPeak = kb * 1024;
+		}
+	}
+	fclose(fp);
+
+	return usage->resident != 0;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,85 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// allocstats.h
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ *  Heap allocation counters. allocstats.cpp replaces the operator new of the
+ *  process with one that counts, for the process and for each thread.
+ *
+ *  FCEUI_Emulate() counts what every frame allocates on the emulating thread.
+ *  Once the core has warmed up a frame must not allocate at all: a malloc
+ *  that has to go to the system now and then is a frame time spike. Builds
+ *  with __FCEU_ALLOC_CHECK__ (Debug) print each frame that does.
+ *
+ *  Recording a movie appends to it every frame and is not covered.
+ */
+
+uint64_t FCEU_AllocCount(void);        // whole process
+uint64_t FCEU_AllocBytes(void);
+uint64_t FCEU_ThreadAllocCount(void);  // calling thread only
+
+// Frames after a game load or FCEU_FrameAllocReset() that may still allocate
+#define FCEU_ALLOC_WARMUP_FRAMES 300
+
+struct FCEU_FrameAllocStats
+{
+	uint64_t frames;            // frames counted, warm-up excluded
+	uint64_t framesAllocating;  // of those, frames that allocated
+	uint64_t allocations;       // made in those frames
+	uint64_t maxPerFrame;
+	int      lastFrame;         // frame counter of the last one, -1 for none
+};
+
+void FCEU_GetFrameAllocStats(FCEU_FrameAllocStats *stats);
+
+// Starts a new warm-up, for settings that size buffers on their first frame
+void FCEU_FrameAllocReset(void);
+
+// What the process holds in RAM. The anonymous part (heap, stacks, written
+// data) is what one more instance of the same program costs; the rest is
+// code and files shared with the others. Buffers are only counted once
+// written to, so large ones allocated up front cost nothing until used.
+struct FCEU_MemoryUsage
+{
+	uint64_t resident;          // bytes
+	uint64_t residentAnon;
+	uint64_t residentPeak;
+};
+
+// False, with everything 0, where the platform does not tell (only Linux does)
+bool FCEU_GetMemoryUsage(FCEU_MemoryUsage *usage);
+
+// Counts the allocations of the calling thread during one frame
+class FCEU_FrameAllocScope
+{
+	public:
+	FCEU_FrameAllocScope(void) : start( FCEU_ThreadAllocCount() ) {}
+	~FCEU_FrameAllocScope(void);
+
+	FCEU_FrameAllocScope(const FCEU_FrameAllocScope &) = delete;
+	FCEU_FrameAllocScope& operator = (const FCEU_FrameAllocScope &) = delete;
+
+	private:
+	uint64_t start;
+};
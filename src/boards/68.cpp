@@ -57,6 +57,7 @@ static void M68NTfix(void) {
 			vnapage[0] = vnapage[1] = vnapage[2] = vnapage[3] = CHRptr[0] + (((nt2 | 128) & CHRmask1[0]) << 10);
 			break;
 		}
+		FCEUPPU_PagesChanged();
 	} else
 		switch (mirr & 3) {
 		case 0: setmirror(MI_V); break;
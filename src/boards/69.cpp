@@ -74,7 +74,11 @@ static DECLFW(M69Write0) {
 	cmdreg = V & 0xF;
 }
 
+static void M69IRQDeadline(void);
+
 static DECLFW(M69Write1) {
+	if (cmdreg >= 0xD)
+		X6502_FlushMapIRQ();
 	switch (cmdreg) {
 	case 0x0: creg[0] = V; Sync(); break;
 	case 0x1: creg[1] = V; Sync(); break;
@@ -93,6 +97,8 @@ static DECLFW(M69Write1) {
 	case 0xE: IRQCount &= 0xFF00; IRQCount |= V; break;
 	case 0xF: IRQCount &= 0x00FF; IRQCount |= V << 8; break;
 	}
+	if (cmdreg >= 0xD)
+		M69IRQDeadline();
 }
 
 // SUNSOFT-5/FME-7 Sound
@@ -174,10 +180,16 @@ static void DoAYSQHQ(int x) {
 	amp += amp >> 1;
 
 	if (!(sreg[0x7] & (1 << x))) {
-		for (V = CAYBC[x]; V < SOUNDTS; V++) {
+		for (V = CAYBC[x]; V < SOUNDTS; ) {
+			int32 run = SOUNDTS - V;
+			if (vcount[x] <= 0)
+				run = 1;
+			else if (vcount[x] < run)
+				run = vcount[x];
 			if (dcount[x])
-				WaveHi[V] += amp;
-			vcount[x]--;
+				WaveHiAddRun(&WaveHi[V], run, amp);
+			V += run;
+			vcount[x] -= run;
 			if (vcount[x] <= 0) {
 				dcount[x] ^= 1;
 				vcount[x] = freq;
@@ -241,6 +253,13 @@ static void M69Close(void) {
 	WRAM = NULL;
 }
 
+static void M69IRQDeadline(void) {
+	if (IRQa)
+		X6502_SetMapIRQDeadline(IRQCount > 0 ? IRQCount : 0);
+	else
+		X6502_SetMapIRQDeadline(0x7FFFFFFF);
+}
+
 static void M69IRQHook(int a) {
 	if (IRQa) {
 		IRQCount -= a;
@@ -248,6 +267,7 @@ static void M69IRQHook(int a) {
 			X6502_IRQBegin(FCEU_IQEXT); IRQa = 0; IRQCount = 0xFFFF;
 		}
 	}
+	M69IRQDeadline();
 }
 
 static void StateRestore(int version) {
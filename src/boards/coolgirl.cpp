@@ -470,6 +470,7 @@ static void COOLGIRL_Sync_Mirroring(void) {
 		vnapage[1] = UNIFchrrama + 0x3F400;
 		vnapage[2] = UNIFchrrama + 0x3F800;
 		vnapage[3] = UNIFchrrama + 0x3FC00;
+		FCEUPPU_PagesChanged();
 	}
 }
 
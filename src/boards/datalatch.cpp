@@ -488,6 +488,7 @@ void Mapper218_Init(CartInfo *info)
 	};
 	for(int i=0;i<8;i++)
 		VPageR[i] = &NTARAM[mapping[info->mirrorAs2Bits*8+i]];
+	FCEUPPU_PagesChanged();
 
 	PPUCHRRAM = 0xFF;
 }
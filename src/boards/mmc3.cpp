@@ -176,14 +176,18 @@ DECLFW(MMC3_CMDWrite) {
 	}
 }
 
+static void MMC3IRQDeadline(void);
+
 DECLFW(MMC3_IRQWrite) {
 //	FCEU_printf("%04x:%04x\n",A,V);
+	FCEUPPU_FlushHBIRQ();
 	switch (A & 0xE001) {
 	case 0xC000: IRQLatch = V; break;
 	case 0xC001: IRQReload = 1; break;
 	case 0xE000: X6502_IRQEnd(FCEU_IQEXT); IRQa = 0; break;
 	case 0xE001: IRQa = 1; break;
 	}
+	MMC3IRQDeadline();
 }
 
 // KT-008 boards hack 2-in-1, TODO assign to new ines mapper, most dump of KT-boards on the net are mapper 4, so need database or goodnes fix support
@@ -220,6 +224,25 @@ static void ClockMMC3Counter(void) {
 
 static void MMC3_hb(void) {
 	ClockMMC3Counter();
+	MMC3IRQDeadline();
+}
+
+// Clocks that pass before the one raising the IRQ, all of them while disabled
+static void MMC3IRQDeadline(void) {
+	int next;
+	if (GameHBIRQHook != MMC3_hb)	// boards with their own hook or the timing hacks
+		return;
+	if (!IRQa) {
+		FCEUPPU_SetHBIRQDeadline(0x1000);
+		return;
+	}
+	next = (!IRQCount || IRQReload) ? IRQLatch : IRQCount - 1;
+	if (next)
+		FCEUPPU_SetHBIRQDeadline(next);
+	else if (!IRQCount && !isRevB)
+		FCEUPPU_SetHBIRQDeadline(0x1000);	// reloads 0 over and over
+	else
+		FCEUPPU_SetHBIRQDeadline(0);
 }
 
 static void MMC3_hb_KickMasterHack(void) {
@@ -148,6 +148,15 @@ uint8* MMC5BGVRAMADR(uint32 A)
 	} else return &BBANKS[(A) >> 10][(A)];
 }
 
+//the bank set MMC5BGVRAMADR picks for the old PPU, which draws each part of a
+//line at once and so can look it up once for all of its tiles
+uint8** MMC5BGVBanks(void)
+{
+	if (!Sprite16 && mmc5ABMode == 0)
+		return ABANKS;
+	return BBANKS;
+}
+
 static void mmc5_PPUWrite(uint32 A, uint8 V) {
 	uint32 tmp = A;
 	extern uint8 PALRAM[0x20];
@@ -164,8 +173,10 @@ static void mmc5_PPUWrite(uint32 A, uint8 V) {
 		} else
 			PALRAM[tmp & 0x1F] = V & 0x3F;
 	} else if (tmp < 0x2000) {
-		if (PPUCHRRAM & (1 << (tmp >> 10)))
+		if (PPUCHRRAM & (1 << (tmp >> 10))) {
 			VPage[tmp >> 10][tmp] = V;
+			CHRPageVersion[tmp >> 10]++;
+		}
 	} else {
 		if (PPUNTARAM & (1 << ((tmp & 0xF00) >> 10)))
 			vnapage[((tmp & 0xF00) >> 10)][tmp & 0x3FF] = V;
@@ -518,6 +529,7 @@ static DECLFW(Mapper5_write) {
 				case 3: PPUNTARAM &= ~(1 << x); vnapage[x] = MMC5fill; break;
 				}
 			}
+			FCEUPPU_PagesChanged();
 			NTAMirroring = V;
 			break;
 		}
@@ -631,6 +643,7 @@ void MMC5Synco(void) {
 		case 3: PPUNTARAM &= ~(1 << x); vnapage[x] = MMC5fill; break;
 		}
 	}
+	FCEUPPU_PagesChanged();
 	MMC5WRAM(0x6000, WRAMPage & (MMC5WRAMMAX-1));
 	if (!mmc5ABMode) {
 		MMC5CHRB();
@@ -725,10 +738,9 @@ static void Do5PCM() {
 }
 
 static void Do5PCMHQ() {
-	uint32 V;
-	if (!(MMC5Sound.rawcontrol & 0x40) && MMC5Sound.raw)
-		for (V = MMC5Sound.BC[2]; V < SOUNDTS; V++)
-			WaveHi[V] += MMC5Sound.raw << 5;
+	int32 V = MMC5Sound.BC[2];
+	if (!(MMC5Sound.rawcontrol & 0x40) && MMC5Sound.raw && V < (int32)SOUNDTS)
+		WaveHiAddRun(&WaveHi[V], SOUNDTS - V, MMC5Sound.raw << 5);
 	MMC5Sound.BC[2] = SOUNDTS;
 }
 
@@ -822,10 +834,16 @@ static void Do5SQHQ(int P) {
 
 		dc = MMC5Sound.dcount[P];
 		vc = MMC5Sound.vcount[P];
-		for (V = MMC5Sound.BC[P]; V < SOUNDTS; V++) {
+		for (V = MMC5Sound.BC[P]; V < SOUNDTS; ) {
+			int32 run = SOUNDTS - V;
+			if (vc <= 0)
+				run = 1;
+			else if (vc < run)
+				run = vc;
 			if (dc < rthresh)
-				WaveHi[V] += amp;
-			vc--;
+				WaveHiAddRun(&WaveHi[V], run, amp);
+			V += run;
+			vc -= run;
 			if (vc <= 0) { /* Less than zero when first started. */
 				vc = wl;
 				dc = (dc + 1) & 7;
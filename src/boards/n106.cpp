@@ -81,6 +81,13 @@ static void SyncPRG(void) {
 	setprg8(0xe000, 0x3F);
 }
 
+static void NamcoIRQDeadline(void) {
+	if (IRQa)
+		X6502_SetMapIRQDeadline(IRQCount < 0x7FFF ? 0x7FFF - IRQCount : 0);
+	else
+		X6502_SetMapIRQDeadline(0x7FFFFFFF);
+}
+
 static void NamcoIRQHook(int a) {
 	if (IRQa) {
 		IRQCount += a;
@@ -90,6 +97,7 @@ static void NamcoIRQHook(int a) {
 			IRQCount = 0x7FFF; //7FFF;
 		}
 	}
+	NamcoIRQDeadline();
 }
 
 static DECLFR(Namco_Read4800) {
@@ -104,10 +112,14 @@ static DECLFR(Namco_Read4800) {
 }
 
 static DECLFR(Namco_Read5000) {
+	X6502_FlushMapIRQ();
+	NamcoIRQDeadline();
 	return(IRQCount);
 }
 
 static DECLFR(Namco_Read5800) {
+	X6502_FlushMapIRQ();
+	NamcoIRQDeadline();
 	return(IRQCount >> 8);
 }
 
@@ -189,11 +201,16 @@ static DECLFW(Mapper19_write) {
 		case 0xf800:
 			dopol = V; break;
 		case 0x5000:
-			IRQCount &= 0xFF00; IRQCount |= V; X6502_IRQEnd(FCEU_IQEXT); break;
+			X6502_FlushMapIRQ();
+			IRQCount &= 0xFF00; IRQCount |= V; X6502_IRQEnd(FCEU_IQEXT);
+			NamcoIRQDeadline();
+			break;
 		case 0x5800:
+			X6502_FlushMapIRQ();
 			IRQCount &= 0x00ff; IRQCount |= (V & 0x7F) << 8;
 			IRQa = V & 0x80;
 			X6502_IRQEnd(FCEU_IQEXT);
+			NamcoIRQDeadline();
 			break;
 		case 0xE000:
 			PRG[0] = V & 0x3F;
@@ -284,15 +301,21 @@ static void DoNamcoSoundHQ(void) {
 			lengo = LengthCache[P];
 
 			duff2 = FetchDuff(P, envelope);
-			for (V = CVBC << 1; V < (int)SOUNDTS << 1; V++) {
-				WaveHi[V >> 1] += duff2;
-				if (!vco) {
+			for (V = CVBC << 1; V < (int)SOUNDTS << 1; ) {
+				// half cycles up to and including the one that steps
+				int32 run = ((int)SOUNDTS << 1) - V;
+				if (vco >= 0 && vco < run)
+					run = vco + 1;
+				for (int32 i = 0; i < run; i++)
+					WaveHi[(V + i) >> 1] += duff2;
+				V += run;
+				vco -= run;
+				if (vco == -1) {
 					PlayIndex[P] += freq;
 					while ((PlayIndex[P] >> TOINDEX) >= lengo) PlayIndex[P] -= lengo << TOINDEX;
 					duff2 = FetchDuff(P, envelope);
-					vco = cyclesuck;
+					vco = cyclesuck - 1;
 				}
-				vco--;
 			}
 			vcount[P] = vco;
 		}
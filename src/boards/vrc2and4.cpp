@@ -74,6 +74,8 @@ static void Sync(void) {
 	}
 }
 
+static void VRC24IRQDeadline(void);
+
 static DECLFW(VRC24Write) {
 	A = A & 0xF000 | !!(A & reg2mask) << 1 | !!(A & reg1mask);
 	if ((A >= 0xB000) && (A <= 0xE003)) {
@@ -87,6 +89,15 @@ static DECLFW(VRC24Write) {
 				chrhi[i] = (V & 0x10) << 4;						// another one many in one feature from pirate carts
 		}
 		Sync();
+	} else if ((A & 0xF000) == 0xF000) {
+		X6502_FlushMapIRQ();
+		switch (A & 0xF003) {
+		case 0xF000: X6502_IRQEnd(FCEU_IQEXT); IRQLatch &= 0xF0; IRQLatch |= V & 0xF; break;
+		case 0xF001: X6502_IRQEnd(FCEU_IQEXT); IRQLatch &= 0x0F; IRQLatch |= V << 4; break;
+		case 0xF002: X6502_IRQEnd(FCEU_IQEXT); acount = 0; IRQCount = IRQLatch; IRQMode = V & 4; IRQa = V & 2; irqcmd = V & 1; break;
+		case 0xF003: X6502_IRQEnd(FCEU_IQEXT); IRQa = irqcmd; break;
+		}
+		VRC24IRQDeadline();
 	} else
 		switch (A & 0xF003) {
 		case 0x8000:
@@ -114,10 +125,6 @@ static DECLFW(VRC24Write) {
 		case 0x9001: if (V != 0xFF) mirr = V; Sync(); break;
 		case 0x9002:
 		case 0x9003: regcmd = V; Sync(); break;
-		case 0xF000: X6502_IRQEnd(FCEU_IQEXT); IRQLatch &= 0xF0; IRQLatch |= V & 0xF; break;
-		case 0xF001: X6502_IRQEnd(FCEU_IQEXT); IRQLatch &= 0x0F; IRQLatch |= V << 4; break;
-		case 0xF002: X6502_IRQEnd(FCEU_IQEXT); acount = 0; IRQCount = IRQLatch; IRQMode = V & 4; IRQa = V & 2; irqcmd = V & 1; break;
-		case 0xF003: X6502_IRQEnd(FCEU_IQEXT); IRQa = irqcmd; break;
 		}
 }
 
@@ -134,8 +141,29 @@ static void VRC24Power(void) {
 	SetWriteHandler(0x8000, 0xFFFF, VRC24Write);
 }
 
+#define LCYCS 341
+
+//cycles until the counter next overflows, the hook handles any batch up
+//to that the same as one call per instruction. Scanline mode is capped so
+//acount += a * 3 stays within 16 bits.
+static void VRC24IRQDeadline(void) {
+	int32 cycles = 0x7FFFFFFF;
+	if (IRQa) {
+		int32 steps = 0x100 - (IRQCount & 0xFF);
+		if (IRQMode)
+			cycles = steps - acount;
+		else {
+			cycles = (steps * LCYCS - acount + 2) / 3;
+			if (cycles > 0x2000)
+				cycles = 0x2000;
+		}
+		if (cycles < 0)
+			cycles = 0;
+	}
+	X6502_SetMapIRQDeadline(cycles);
+}
+
 void VRC24IRQHook(int a) {
-	#define LCYCS 341
 	if (IRQa) {
 		if (IRQMode) {
 			acount += a;
@@ -161,6 +189,7 @@ void VRC24IRQHook(int a) {
 			}
 		}
 	}
+	VRC24IRQDeadline();
 }
 
 static void StateRestore(int version) {
@@ -264,10 +264,16 @@ static INLINE void DoSQVHQ(int x) {
 				WaveHi[V] += amp;
 		} else {
 			int32 thresh = (vpsg1[x << 2] >> 4) & 7;
-			for (V = cvbc[x]; V < (int)SOUNDTS; V++) {
+			for (V = cvbc[x]; V < (int)SOUNDTS; ) {
+				int32 run = (int)SOUNDTS - V;
+				if (vcount[x] <= 0)
+					run = 1;
+				else if (vcount[x] < run)
+					run = vcount[x];
 				if (dcount[x] > thresh)
-					WaveHi[V] += amp;
-				vcount[x]--;
+					WaveHiAddRun(&WaveHi[V], run, amp);
+				V += run;
+				vcount[x] -= run;
 				if (vcount[x] <= 0) {
 					vcount[x] = (vpsg1[(x << 2) | 0x1] | ((vpsg1[(x << 2) | 0x2] & 15) << 8)) + 1;
 					dcount[x] = (dcount[x] + 1) & 15;
@@ -292,9 +298,15 @@ static void DoSawVHQ(void) {
 	int32 V;
 
 	if (vpsg2[2] & 0x80) {
-		for (V = cvbc[2]; V < (int)SOUNDTS; V++) {
-			WaveHi[V] += (((phaseacc >> 3) & 0x1f) << 8) * 6 / 8;
-			vcount[2]--;
+		for (V = cvbc[2]; V < (int)SOUNDTS; ) {
+			int32 run = (int)SOUNDTS - V;
+			if (vcount[2] <= 0)
+				run = 1;
+			else if (vcount[2] < run)
+				run = vcount[2];
+			WaveHiAddRun(&WaveHi[V], run, (((phaseacc >> 3) & 0x1f) << 8) * 6 / 8);
+			V += run;
+			vcount[2] -= run;
 			if (vcount[2] <= 0) {
 				vcount[2] = (vpsg2[1] + ((vpsg2[2] & 15) << 8) + 1) << 1;
 				phaseacc += vpsg2[0] & 0x3f;
@@ -0,0 +1,357 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// bootcache.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "cheat.h"
+#include "driver.h"
+#include "emufile.h"
+#include "file.h"
+#include "framehash.h"
+#include "git.h"
+#include "input.h"
+#include "movie.h"
+#include "netplay.h"
+#include "state.h"
+#include "version.h"
+#include "video.h"
+#include "x6502.h"
+#include "utils/endian.h"
+#include "bootcache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <direct.h>
+#endif
+
+#include <zlib.h>
+
+#ifdef __FCEU_QNETWORK_ENABLE__
+extern bool NetPlayActive(void);
+#endif
+
+#define BOOTCACHE_MAGIC   "FCEUBC01"
+
+// the picture kept with an entry, XBuf then XDBuf
+#define BOOTCACHE_PICTURE (256*256*2)
+
+static bool cacheEnabled = false;
+
+// the last entry loaded or stored
+static std::string lastPath;
+static std::vector<uint8> lastEntry;
+
+void FCEUI_SetBootCache(bool enable)
+{
+	cacheEnabled = enable;
+	if (!enable)
+	{
+		lastPath.clear();
+		lastEntry.clear();
+	}
+}
+
+bool FCEUI_GetBootCache(void)
+{
+	return cacheEnabled;
+}
+
+static std::string CacheDir(void)
+{
+	return std::string(FCEUI_GetBaseDirectory()) + PSS "bootcache";
+}
+
+static bool MakeCacheDir(void)
+{
+	std::string dir = CacheDir();
+	struct stat st;
+
+	if (stat(dir.c_str(), &st) == 0)
+		return (st.st_mode & S_IFDIR) != 0;
+#ifdef WIN32
+	return _mkdir(dir.c_str()) == 0;
+#else
+	return mkdir(dir.c_str(), S_IRWXU) == 0;
+#endif
+}
+
+// Why this boot can not be cached, "" when it can. Its frames could run
+// differently the next time, or something other than the input decides them.
+static const char *Unrepeatable(void)
+{
+	if (RAMInitOption == 3)
+		return "random RAM init";
+	if (!globalCheatDisabled)
+	{
+		int status = 0;
+		for (uint32 i = 0; FCEUI_GetCheat(i, NULL, NULL, NULL, NULL, &status, NULL); i++)
+		{
+			if (status)
+				return "cheats are active";
+		}
+	}
+	if (X6502_NeedsInstrumentation())
+		return "the debugger, tracer or profiler is active";
+	return "";
+}
+
+// The key of the entry: everything that decides what the prefix frames do.
+// powerOn is the console as it powered on, with its battery backed memory
+// (and the FDS disk writes) in it.
+static void BootKey(const std::vector<uint32> &prefix, EMUFILE_MEMORY &powerOn, uint64 &name, uint64 &check)
+{
+	EMUFILE_MEMORY key;
+
+	key.fwrite(BOOTCACHE_MAGIC, 8);
+	key.write32le((u32)FCEU_VERSION_NUMERIC);
+	key.fwrite(FCEU_VERSION_STRING, strlen(FCEU_VERSION_STRING));
+	key.fwrite(GameInfo->MD5.data, sizeof(GameInfo->MD5.data));
+	key.write32le((u32)GameInfo->type);
+	key.write32le((u32)powerOn.size());
+	key.write64le(FCEU_XXH64(powerOn.buf(), powerOn.size(), 0));
+
+	key.write32le((u32)PAL);
+	key.write32le((u32)dendy);
+	key.write32le((u32)newppu);
+	key.write32le((u32)RAMInitOption);
+	key.write32le((u32)overclock_enabled);
+	key.write32le((u32)skip_7bit_overclocking);
+	key.write32le((u32)postrenderscanlines);
+	key.write32le((u32)vblankscanlines);
+	key.write32le((u32)FSettings.GameGenie);
+	key.write32le((u32)joyports[0].type);
+	key.write32le((u32)joyports[1].type);
+	key.write32le((u32)portFC.type);
+	key.write32le((u32)FCEUI_GetInputFourscore());
+
+	key.write32le((u32)prefix.size());
+	for (size_t i = 0; i < prefix.size(); i++)
+		key.write32le(prefix[i]);
+
+	name = FCEU_XXH64(key.buf(), key.size(), 0);
+	check = FCEU_XXH64(key.buf(), key.size(), 1);
+}
+
+// An entry: the magic, the check hash of its key, the frames, the size of
+// the savestate, the savestate and the picture
+static bool ReadEntry(const std::string &path, uint64 check, std::vector<uint8> &entry)
+{
+	if (path != lastPath || lastEntry.empty())
+	{
+		EMUFILE_FILE is(path, "rb");
+		if (is.fail())
+			return false;
+		entry.resize(is.size());
+		if (entry.empty() || is.fread(&entry[0], entry.size()) != entry.size())
+			return false;
+	}
+	else
+		entry = lastEntry;
+
+	EMUFILE_SPAN es((const void *)entry.data(), entry.size());
+	char magic[8];
+	u64 keyCheck;
+	u32 frames, stateSize;
+	if (es.fread(magic, 8) != 8 || memcmp(magic, BOOTCACHE_MAGIC, 8) != 0)
+		return false;
+	if (es.read64le(&keyCheck) != 1 || keyCheck != check)
+		return false;
+	if (es.read32le(&frames) != 1 || es.read32le(&stateSize) != 1)
+		return false;
+	return entry.size() - es.ftell() == (size_t)stateSize + BOOTCACHE_PICTURE;
+}
+
+static bool WriteEntry(const std::string &path, const std::vector<uint8> &entry)
+{
+	if (!MakeCacheDir())
+		return false;
+
+	// written aside and renamed, so another process never reads half of it
+	std::string temp = path + ".tmp";
+	{
+		EMUFILE_FILE os(temp, "wb");
+		if (os.fail())
+			return false;
+		os.fwrite(entry.data(), entry.size());
+		if (os.fail())
+		{
+			remove(temp.c_str());
+			return false;
+		}
+	}
+	remove(path.c_str());
+	if (rename(temp.c_str(), path.c_str()) != 0)
+	{
+		remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+static bool LoadEntry(std::vector<uint8> &entry)
+{
+	size_t pos = 8 + 8 + 4;
+	u32 stateSize = FCEU_de32lsb(&entry[pos]);
+	pos += 4;
+
+	EMUFILE_SPAN is((const void *)&entry[pos], stateSize);
+	if (!FCEUSS_LoadFP(&is, SSLOADPARAM_NOBACKUP))
+		return false;
+	pos += stateSize;
+
+	memcpy(XBuf, &entry[pos], 256*256);
+	memcpy(XDBuf, &entry[pos + 256*256], 256*256);
+	return true;
+}
+
+static void RunPrefix(const std::vector<uint32> &prefix)
+{
+	uint32 joy = 0;
+	void *realPads[2] = { joyports[0].ptr, joyports[1].ptr };
+
+	// the other devices read their own data through ptr
+	for (int i = 0; i < 2; i++)
+	{
+		if (joyports[i].type == SI_GAMEPAD)
+			joyports[i].ptr = &joy;
+	}
+	for (size_t i = 0; i < prefix.size(); i++)
+	{
+		joy = prefix[i];
+		FCEUI_EmulateOffscreen();
+	}
+	joyports[0].ptr = realPads[0];
+	joyports[1].ptr = realPads[1];
+}
+
+bool FCEUI_BootFastForward(const std::vector<uint32> &prefix, FCEU_BootCacheStats &stats)
+{
+	stats = FCEU_BootCacheStats();
+
+	// the frames are run off screen like the ones of an input search, only a
+	// fresh console can be put through them and nothing may see them go by
+	if (!GameInfo || GameInfo->type == GIT_NSF)
+		stats.error = "no game loaded";
+	else if (timestampbase != 0 || timestamp != 0)
+		stats.error = "the console has run since power on";
+	else if (!FCEUMOV_Mode(MOVIEMODE_INACTIVE))
+		stats.error = "a movie is active";
+	else if (FCEUnetplay)
+		stats.error = "netplay is active";
+#ifdef __FCEU_QNETWORK_ENABLE__
+	else if (NetPlayActive())
+		stats.error = "netplay is active";
+#endif
+	else if (!prefix.empty() && joyports[0].type != SI_GAMEPAD && joyports[1].type != SI_GAMEPAD)
+		stats.error = "no gamepad is plugged in";
+	if (!stats.error.empty())
+		return false;
+
+	if (cacheEnabled)
+		stats.uncached = Unrepeatable();
+	bool cache = cacheEnabled && stats.uncached.empty();
+	uint64 name = 0, check = 0;
+	if (cache)
+	{
+		EMUFILE_MEMORY powerOn;
+		if (!FCEUSS_SaveMS(&powerOn, Z_NO_COMPRESSION))
+		{
+			stats.error = "cannot save the state";
+			return false;
+		}
+		BootKey(prefix, powerOn, name, check);
+
+		char file[32];
+		snprintf(file, sizeof(file), "%016llx.fcs", (unsigned long long)name);
+		stats.path = CacheDir() + PSS + file;
+
+		std::vector<uint8> entry;
+		if (ReadEntry(stats.path, check, entry) && LoadEntry(entry))
+		{
+			lastPath = stats.path;
+			lastEntry.swap(entry);
+			currFrameCounter += (int)prefix.size();
+			stats.hit = true;
+			return true;
+		}
+	}
+
+	RunPrefix(prefix);
+	currFrameCounter += (int)prefix.size();
+	stats.frames = (int)prefix.size();
+	if (!cache)
+		return true;
+
+	EMUFILE_MEMORY state;
+	if (!FCEUSS_SaveMS(&state, Z_NO_COMPRESSION))
+		return true;
+
+	EMUFILE_MEMORY os;
+	os.fwrite(BOOTCACHE_MAGIC, 8);
+	os.write64le(check);
+	os.write32le((u32)prefix.size());
+	os.write32le((u32)state.size());
+	os.fwrite(state.buf(), state.size());
+	os.fwrite(XBuf, 256*256);
+	os.fwrite(XDBuf, 256*256);
+
+	std::vector<uint8> entry(os.buf(), os.buf() + os.size());
+	if (WriteEntry(stats.path, entry))
+	{
+		lastPath = stats.path;
+		lastEntry.swap(entry);
+	}
+	return true;
+}
+
+bool FCEUI_BootPrefixFromMovie(const char *path, int frames, std::vector<uint32> &prefix)
+{
+	prefix.clear();
+
+	FCEUFILE *fp = FCEU_fopen(path, 0, "rb", 0);
+	if (!fp)
+		return false;
+	MovieData md;
+	bool isMovie = LoadFM2(md, fp->stream, fp->size, false);
+	delete fp;
+	if (!isMovie)
+		return false;
+
+	int count = frames < 0 ? md.getNumRecords() : frames;
+	if (count > md.getNumRecords())
+		return false;
+
+	prefix.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		MovieRecord &mr = md.records[i];
+		if (mr.commands)
+		{
+			prefix.clear();
+			return false;
+		}
+		prefix[i] = mr.joysticks[0] | (mr.joysticks[1] << 8) | (mr.joysticks[2] << 16) | ((uint32)mr.joysticks[3] << 24);
+	}
+	return true;
+}
@@ -0,0 +1,84 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// bootcache.h
+
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+/*
+ *  Boot snapshot cache, for batch jobs that load a ROM and then sit through
+ *  the same BIOS, logo and title frames before every run. Off by default,
+ *  see FCEUI_SetBootCache().
+ *
+ *  FCEUI_BootFastForward() is called right after the ROM is loaded or the
+ *  console powered on, with the input of the frames to get through (a pad
+ *  state per frame, as many frames as the intro lasts). The first time it
+ *  runs them off screen and saves the console as they left it; after that
+ *  it loads the saved state instead, which takes about as long as loading
+ *  a savestate however many frames the prefix is.
+ *
+ *  An entry is keyed on the hash of everything that decides what those
+ *  frames do:
+ *
+ *    - the MD5 of the ROM and the battery backed memory it powered on with;
+ *    - region, PPU, RAM init option, overclocking, game genie, the
+ *      controllers plugged in and four score;
+ *    - the prefix input itself;
+ *    - the FCEUX version and the size of the savestate of the ROM, which
+ *      changes when a build adds to or drops from it.
+ *
+ *  so changing any of them makes a new entry rather than loading a stale
+ *  one. Boots that can not repeat are not cached: random RAM init, active
+ *  cheats, a movie, netplay, or the debugger or tracer running.
+ *
+ *  Entries are <base>/bootcache/<key>.fcs: a short header, an uncompressed
+ *  savestate and the picture of the last frame. They are never removed;
+ *  deleting the directory is always safe. The last entry used is also kept
+ *  in memory, so a worker booting the same ROM over and over reads it once.
+ */
+
+struct FCEU_BootCacheStats
+{
+	bool hit;              // loaded from the cache rather than run
+	int  frames;           // frames of the prefix run, 0 on a hit
+	std::string path;      // of the entry
+	std::string uncached;  // why the prefix was run but not stored, "" otherwise
+	std::string error;     // why nothing was done, "" otherwise
+
+	FCEU_BootCacheStats() : hit(false), frames(0) {}
+};
+
+void FCEUI_SetBootCache(bool enable);
+bool FCEUI_GetBootCache(void);
+
+// Gets the console through the prefix, one pad state per frame laid out as
+// the gamepad data is (pad 1 in the low byte), from the cache or by running
+// it. Only right after power on: false with stats.error set otherwise, and
+// when the cache is off frames are run and nothing is stored.
+bool FCEUI_BootFastForward(const std::vector<uint32> &prefix, FCEU_BootCacheStats &stats);
+
+// The pad states of the first frames of an fm2 movie, for a prefix: all of
+// them when frames is negative. False when the movie can not be read or
+// one of those frames has a command (reset, power, disk or coin).
+bool FCEUI_BootPrefixFromMovie(const char *path, int frames, std::vector<uint32> &prefix);
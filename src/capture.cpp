@@ -0,0 +1,393 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// capture.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "palette.h"
+#include "capture.h"
+#include "zlib.h"
+
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CAPTURE_WIDTH     256
+#define CAPTURE_HEIGHT    240
+#define CAPTURE_PLANE     (CAPTURE_WIDTH * CAPTURE_HEIGHT)
+#define CAPTURE_ROWS      (CAPTURE_HEIGHT * 2)	// pixel lines then deemph lines
+#define CAPTURE_PALETTE   512
+
+// A key frame every ten seconds or so bounds how far a reader has to go back
+#define CAPTURE_KEY_INTERVAL  600
+
+// The instant replay ring keeps a key frame every second, the oldest
+// second goes as a whole when the ring is full
+#define REPLAY_KEY_INTERVAL   60
+
+// Turns frames into the chunks of a capture. The file capture and the
+// instant replay ring each have one.
+struct CaptureEncoder
+{
+	int keyInterval;
+	int framesSinceKey;
+	std::vector<uint8> prevPlanes;   // pixel plane then deemph plane of the last frame
+	std::vector<uint8> deltaPlanes;
+	std::vector<uint8> packBuf;
+	uint8 lastPalette[CAPTURE_PALETTE * 3];
+
+	CaptureEncoder() : keyInterval(CAPTURE_KEY_INTERVAL), framesSinceKey(0) {}
+
+	void begin(int interval)
+	{
+		keyInterval = interval;
+		prevPlanes.assign(CAPTURE_PLANE * 2, 0);
+		deltaPlanes.resize(CAPTURE_PLANE * 2);
+		packBuf.resize(compressBound(CAPTURE_PLANE * 2));
+		framesSinceKey = keyInterval;
+		memset(lastPalette, 0, sizeof(lastPalette));
+	}
+
+	void release(void)
+	{
+		std::vector<uint8>().swap(prevPlanes);
+		std::vector<uint8>().swap(deltaPlanes);
+		std::vector<uint8>().swap(packBuf);
+	}
+
+	bool nextIsKey(void) const
+	{
+		return framesSinceKey >= keyInterval;
+	}
+
+	void palette(std::vector<uint8> &out, bool force);
+	bool frame(std::vector<uint8> &out, const uint8 *pix, const uint8 *deemph);
+};
+
+static FILE *capfp = NULL;
+static CaptureEncoder capEncoder;
+static std::vector<uint8> capChunks;
+
+static std::deque< std::vector<uint8> > replaySegments;	// a key frame and the frames after it each
+static std::deque<int> replaySegmentFrames;
+static CaptureEncoder replayEncoder;
+static int replayMaxFrames = 0;
+static int replayFrames = 0;
+static size_t replayBytes = 0;
+
+static std::thread replayWriter;
+static std::atomic<int> replayWriteState(0);	// 0 idle, 1 writing, 2 written, 3 failed
+static std::string replayWritePath;
+
+static void put32(std::vector<uint8> &out, uint32 v)
+{
+	uint8 b[4] = { (uint8)v, (uint8)(v >> 8), (uint8)(v >> 16), (uint8)(v >> 24) };
+	out.insert(out.end(), b, b + 4);
+}
+
+static void putChunkHeader(std::vector<uint8> &out, const char *id, uint32 len)
+{
+	out.insert(out.end(), id, id + 4);
+	put32(out, len);
+}
+
+void CaptureEncoder::palette(std::vector<uint8> &out, bool force)
+{
+	uint8 cur[CAPTURE_PALETTE * 3];
+
+	if (palo == NULL)
+		return;
+
+	for (int i = 0; i < CAPTURE_PALETTE; i++)
+	{
+		cur[i*3  ] = palo[i].r;
+		cur[i*3+1] = palo[i].g;
+		cur[i*3+2] = palo[i].b;
+	}
+
+	if (!force && !memcmp(cur, lastPalette, sizeof(cur)))
+		return;
+
+	memcpy(lastPalette, cur, sizeof(cur));
+	putChunkHeader(out, "PALT", sizeof(cur));
+	out.insert(out.end(), cur, cur + sizeof(cur));
+}
+
+bool CaptureEncoder::frame(std::vector<uint8> &out, const uint8 *pix, const uint8 *deemph)
+{
+	bool key = nextIsKey();
+	uint8 rowMask[CAPTURE_ROWS / 8];
+	uint8 *prev = &prevPlanes[0];
+	uint8 *delta = &deltaPlanes[0];
+	int deltaLen = 0;
+
+	// Only changed lines go to zlib, most frames leave most lines alone
+	memset(rowMask, 0, sizeof(rowMask));
+	for (int row = 0; row < CAPTURE_ROWS; row++)
+	{
+		const uint8 *cur = (row < CAPTURE_HEIGHT) ? pix + row * CAPTURE_WIDTH : deemph + (row - CAPTURE_HEIGHT) * CAPTURE_WIDTH;
+		uint8 *old = prev + row * CAPTURE_WIDTH;
+
+		if (!key && !memcmp(cur, old, CAPTURE_WIDTH))
+			continue;
+
+		rowMask[row >> 3] |= 1 << (row & 7);
+		for (int x = 0; x < CAPTURE_WIDTH; x++)
+			delta[deltaLen + x] = key ? cur[x] : cur[x] ^ old[x];
+		memcpy(old, cur, CAPTURE_WIDTH);
+		deltaLen += CAPTURE_WIDTH;
+	}
+
+	uLongf packLen = packBuf.size();
+	if (compress2(&packBuf[0], &packLen, delta, deltaLen, Z_BEST_SPEED) != Z_OK)
+		return false;
+
+	uint8 flags = key ? 1 : 0;
+	putChunkHeader(out, "FRAM", 1 + sizeof(rowMask) + packLen);
+	out.push_back(flags);
+	out.insert(out.end(), rowMask, rowMask + sizeof(rowMask));
+	out.insert(out.end(), packBuf.begin(), packBuf.begin() + packLen);
+	framesSinceKey = key ? 1 : framesSinceKey + 1;
+	return true;
+}
+
+static void putSound(std::vector<uint8> &out, const int32 *sound, int soundCount)
+{
+	if (!sound || soundCount <= 0)
+		return;
+
+	// little endian, like the wave writer
+	putChunkHeader(out, "AUDO", soundCount * 2);
+	for (int i = 0; i < soundCount; i++)
+	{
+		uint16 s = (uint16)(int16)sound[i];
+		out.push_back(s & 0xFF);
+		out.push_back(s >> 8);
+	}
+}
+
+static void putFileHeader(std::vector<uint8> &out)
+{
+	static const char magic[] = "FCEUCAP1";
+	out.insert(out.end(), magic, magic + 8);
+	put32(out, CAPTURE_WIDTH);
+	put32(out, CAPTURE_HEIGHT);
+	put32(out, FCEUI_GetDesiredFPS());
+	put32(out, FSettings.SndRate);
+}
+
+bool FCEUI_BeginIndexedCapture(const char *fn)
+{
+	FCEUI_EndIndexedCapture();
+
+	if (!(capfp = FCEUD_UTF8fopen(fn, "wb")))
+		return false;
+
+	capEncoder.begin(CAPTURE_KEY_INTERVAL);
+	capChunks.clear();
+	putFileHeader(capChunks);
+	capEncoder.palette(capChunks, true);
+	fwrite(&capChunks[0], 1, capChunks.size(), capfp);
+	return true;
+}
+
+bool FCEUI_IndexedCaptureRunning(void)
+{
+	return capfp != NULL;
+}
+
+void FCEUI_EndIndexedCapture(void)
+{
+	if (!capfp)
+		return;
+
+	fclose(capfp);
+	capfp = NULL;
+
+	// give the frame buffers back, a capture holds about 400KB
+	capEncoder.release();
+	std::vector<uint8>().swap(capChunks);
+}
+
+void FCEU_WriteIndexedCapture(const uint8 *pix, const uint8 *deemph, const int32 *sound, int soundCount)
+{
+	if (!capfp)
+		return;
+
+	capChunks.clear();
+	capEncoder.palette(capChunks, false);
+	if (!capEncoder.frame(capChunks, pix, deemph))
+	{
+		FCEU_PrintError("Indexed capture: frame compression failed, capture stopped.");
+		FCEUI_EndIndexedCapture();
+		return;
+	}
+	putSound(capChunks, sound, soundCount);
+	fwrite(&capChunks[0], 1, capChunks.size(), capfp);
+}
+
+//----------------------------------------------------------------------------
+// Instant replay
+
+static void ClearInstantReplay(void)
+{
+	std::deque< std::vector<uint8> >().swap(replaySegments);
+	std::deque<int>().swap(replaySegmentFrames);
+	replayFrames = 0;
+	replayBytes = 0;
+	replayEncoder.release();
+}
+
+static void JoinReplayWriter(void)
+{
+	if (replayWriter.joinable())
+		replayWriter.join();
+}
+
+void FCEUI_SetInstantReplay(int seconds)
+{
+	int frames = seconds > 0 ? seconds * REPLAY_KEY_INTERVAL : 0;
+
+	if (frames == replayMaxFrames)
+		return;
+
+	ClearInstantReplay();
+	replayMaxFrames = frames;
+}
+
+int FCEUI_GetInstantReplay(void)
+{
+	return replayMaxFrames / REPLAY_KEY_INTERVAL;
+}
+
+int FCEUI_InstantReplayFrames(void)
+{
+	return replayFrames;
+}
+
+size_t FCEUI_InstantReplayBytes(void)
+{
+	return replayBytes;
+}
+
+void FCEU_ResetInstantReplay(void)
+{
+	ClearInstantReplay();
+}
+
+bool FCEUI_SaveInstantReplay(const char *fn)
+{
+	if (replaySegments.empty() || replayWriteState == 1)
+		return false;
+	JoinReplayWriter();
+
+	// the ring goes on recording while the copy is written
+	std::vector<uint8> clip;
+	clip.reserve(replayBytes + 24);
+	putFileHeader(clip);
+	for (size_t i = 0; i < replaySegments.size(); i++)
+		clip.insert(clip.end(), replaySegments[i].begin(), replaySegments[i].end());
+
+	replayWritePath = fn;
+	replayWriteState = 1;
+	std::string path(fn);
+	replayWriter = std::thread([path](std::vector<uint8> data)
+	{
+		FILE *fp = FCEUD_UTF8fopen(path.c_str(), "wb");
+		bool ok = fp != NULL;
+		if (fp)
+		{
+			ok = fwrite(&data[0], 1, data.size(), fp) == data.size();
+			ok = (fclose(fp) == 0) && ok;
+			if (!ok)
+				remove(path.c_str());
+		}
+		replayWriteState = ok ? 2 : 3;
+	}, std::move(clip));
+	return true;
+}
+
+bool FCEUI_InstantReplaySaving(void)
+{
+	return replayWriteState == 1;
+}
+
+void FCEU_StopInstantReplay(void)
+{
+	JoinReplayWriter();
+	replayWriteState = 0;
+}
+
+void FCEU_WriteInstantReplay(const uint8 *pix, const uint8 *deemph, const int32 *sound, int soundCount)
+{
+	// tell about the clip written since the last frame
+	int state = replayWriteState;
+	if (state >= 2)
+	{
+		JoinReplayWriter();
+		replayWriteState = 0;
+		if (state == 2)
+			FCEU_DispMessage("Instant replay saved to %s", 0, replayWritePath.c_str());
+		else
+			FCEU_PrintError("Instant replay: could not write %s", replayWritePath.c_str());
+	}
+
+	if (replayMaxFrames <= 0)
+		return;
+
+	if (replayEncoder.prevPlanes.empty())
+		replayEncoder.begin(REPLAY_KEY_INTERVAL);
+
+	// a segment starts on each key frame, with the palette so it stands alone
+	// once the ones before it are gone
+	bool key = replayEncoder.nextIsKey();
+	if (key)
+	{
+		replaySegments.push_back(std::vector<uint8>());
+		replaySegmentFrames.push_back(0);
+	}
+	std::vector<uint8> &segment = replaySegments.back();
+	size_t before = segment.size();
+
+	replayEncoder.palette(segment, key);
+	if (!replayEncoder.frame(segment, pix, deemph))
+	{
+		FCEU_PrintError("Instant replay: frame compression failed, replay buffer cleared.");
+		ClearInstantReplay();
+		return;
+	}
+	putSound(segment, sound, soundCount);
+	replaySegmentFrames.back()++;
+	replayFrames++;
+	replayBytes += segment.size() - before;
+
+	while (replayFrames - replaySegmentFrames.front() >= replayMaxFrames)
+	{
+		replayFrames -= replaySegmentFrames.front();
+		replayBytes -= replaySegments.front().size();
+		replaySegments.pop_front();
+		replaySegmentFrames.pop_front();
+	}
+}
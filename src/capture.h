@@ -0,0 +1,96 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// capture.h
+
+#pragma once
+
+#include "types.h"
+
+/*
+ *  Indexed frame capture.
+ *
+ *  Records the emulator's own output instead of encoded RGB video: for every
+ *  frame the 8-bit palette index plane (XBuf) and the deemphasis plane (XDBuf)
+ *  are stored losslessly, taken before the HUD and Lua overlays are drawn, so
+ *  two captures of the same run compare equal byte for byte. The sound of the
+ *  frame is stored next to it as 16-bit mono samples.
+ *
+ *  File layout, all values little endian:
+ *
+ *      char    magic[8]       "FCEUCAP1"
+ *      uint32  width          256
+ *      uint32  height         240
+ *      uint32  fps            8.24 fixed point, FCEUI_GetDesiredFPS()
+ *      uint32  soundRate      0 when sound is off
+ *
+ *  followed by chunks of  uint32 id, uint32 length, uint8 payload[length]:
+ *
+ *      'PALT'  512 RGB triplets. A pixel p with deemph value d is shown as
+ *              entry (p & 0x3F) + d*64. Written before the first frame and
+ *              again whenever the palette changes.
+ *      'FRAM'  uint8 flags (bit 0 set on key frames), a 60 byte mask of the
+ *              480 lines that follow (the 240 pixel lines, then the 240
+ *              deemph lines, bit n&7 of byte n>>3 set for line n), then one
+ *              zlib stream holding the 256 bytes of each line in the mask.
+ *              Key frames store every line as is; other frames store only
+ *              the changed lines, XORed with the previous frame.
+ *      'AUDO'  int16 samples, for the frame written just before.
+ *
+ *  scripts/fcap2mp4.py converts a capture to MP4 through ffmpeg.
+ */
+
+bool FCEUI_BeginIndexedCapture(const char *fn);
+bool FCEUI_IndexedCaptureRunning(void);
+void FCEUI_EndIndexedCapture(void);
+
+// called once per emulated frame by FCEUI_Emulate
+void FCEU_WriteIndexedCapture(const uint8 *pix, const uint8 *deemph, const int32 *sound, int soundCount);
+
+/*
+ *  Instant replay.
+ *
+ *  Keeps the last seconds of play in memory, encoded as above with a key
+ *  frame every second, so "save the last 30 seconds" costs no recording in
+ *  advance. Thirty seconds take a few MB, most of it sound. Saving writes
+ *  the ring as an indexed capture on a background thread while play goes
+ *  on; scripts/fcap2mp4.py turns it into a video.
+ */
+
+// seconds kept, 0 (the default) for none
+void FCEUI_SetInstantReplay(int seconds);
+int FCEUI_GetInstantReplay(void);
+
+// frames and bytes in the ring
+int FCEUI_InstantReplayFrames(void);
+size_t FCEUI_InstantReplayBytes(void);
+
+// false when the ring is empty or the last clip is still being written
+bool FCEUI_SaveInstantReplay(const char *fn);
+bool FCEUI_InstantReplaySaving(void);
+
+// once per frame after FCEU_WriteIndexedCapture; also shows how the last
+// save went
+void FCEU_WriteInstantReplay(const uint8 *pix, const uint8 *deemph, const int32 *sound, int soundCount);
+
+// empties the ring, when the game closes
+void FCEU_ResetInstantReplay(void);
+
+// waits for the clip being written, at exit
+void FCEU_StopInstantReplay(void);
@@ -46,6 +46,34 @@ uint8 *MMC5BGVPage[8];
 
 static uint8 PRGIsRAM[32];  /* This page is/is not PRG RAM. */
 
+/* Direct read pointers, one per 4K of CPU address space, indexed like Page[]
+   (ReadPage[A >> 12][A]). Set only where every address is read by CartBR or
+   CartBROB and both 2K halves are mapped contiguously, so the CPU core can
+   load the byte without calling the ARead[] handler. */
+uint8 *ReadPage[16];
+static uint8 ReadIsPlain[16];
+
+/* The same for stores: set where every address is written by CartBW and both
+   2K halves are PRG RAM mapped contiguously, so WRAM is stored to directly. */
+uint8 *WritePage[16];
+static uint8 WriteIsPlain[16];
+
+/* Where ReadPage[] points into PRG ROM chip 0 (read only), the 2K bank of the
+   chip mapped at the start of the 4K page, -1 elsewhere. The CPU core keeps
+   the instructions it decoded per bank, see X6502_Run. PRGCodeVersion is
+   bumped whenever chip 0 is set up again. */
+int32 PRGCodeBank[16];
+uint32 PRGCodeVersion = 0;
+
+/* Bit n is set whenever Page[n], or a PRG chip it may point into, was changed.
+   The debugger caches a PRG offset per page for the code/data logger and
+   clears the bits of the pages it has refreshed. */
+uint32 PRGPageChanged = 0xFFFFFFFF;
+
+/* Bumped whenever VPage[n] is pointed elsewhere or the CHR RAM behind it is
+   written, so tiles decoded from the page can be kept until it changes. */
+uint32 CHRPageVersion[8];
+
 /* 16 are (sort of) reserved for UNIF/iNES and 16 to map other stuff. */
 uint8 CHRram[32];
 uint8 PRGram[32];
@@ -78,6 +106,69 @@ uint32 genieaddr[3];
 
 CartInfo *currCartInfo;
 
+static INLINE void UpdateReadPage(int block) {
+	uint8 *p = Page[block << 1];
+	ReadPage[block] = (ReadIsPlain[block] && p && p == Page[(block << 1) + 1]) ? p : 0;
+	WritePage[block] = (WriteIsPlain[block] && p && p == Page[(block << 1) + 1] &&
+		PRGIsRAM[block << 1] && PRGIsRAM[(block << 1) + 1]) ? p : 0;
+
+	PRGCodeBank[block] = -1;
+	if (ReadPage[block] && PRGptr[0] && !PRGram[0] && !PRGIsRAM[block << 1] && !PRGIsRAM[(block << 1) + 1]) {
+		uintptr_t start = (uintptr_t)(ReadPage[block] + (block << 12));
+		uintptr_t rom = (uintptr_t)PRGptr[0];
+
+		if (start >= rom && start + 0x1000 <= rom + PRGsize[0] && !((start - rom) & 0x7FF))
+			PRGCodeBank[block] = (int32)((start - rom) >> 11);
+	}
+}
+
+/* For CHR memory changed other than through the PPU: state loads, editors. */
+void FCEU_CHRPagesChanged(void) {
+	int x;
+
+	for (x = 0; x < 8; x++)
+		CHRPageVersion[x]++;
+	FCEUPPU_PagesChanged();
+}
+
+static INLINE void setvpageptr(int n, uint8 *p) {
+	if (VPageR[n] != p) {
+		VPageR[n] = p;
+		CHRPageVersion[n]++;
+		FCEUPPU_PagesChanged();
+	}
+}
+
+/* Called whenever ARead[start..end] changed. */
+void UpdateCartReadPages(int32 start, int32 end) {
+	int block, x;
+
+	for (block = start >> 12; block <= (end >> 12); block++) {
+		ReadIsPlain[block] = 1;
+		for (x = block << 12; x < ((block + 1) << 12); x++)
+			if (ARead[x] != CartBR && ARead[x] != CartBROB) {
+				ReadIsPlain[block] = 0;
+				break;
+			}
+		UpdateReadPage(block);
+	}
+}
+
+/* Called whenever BWrite[start..end] changed. */
+void UpdateCartWritePages(int32 start, int32 end) {
+	int block, x;
+
+	for (block = start >> 12; block <= (end >> 12); block++) {
+		WriteIsPlain[block] = 1;
+		for (x = block << 12; x < ((block + 1) << 12); x++)
+			if (BWrite[x] != CartBW) {
+				WriteIsPlain[block] = 0;
+				break;
+			}
+		UpdateReadPage(block);
+	}
+}
+
 static INLINE void setpageptr(int s, uint32 A, uint8 *p, int ram) {
 	uint32 AB = A >> 11;
 	int x;
@@ -92,6 +183,9 @@ static INLINE void setpageptr(int s, uint32 A, uint8 *p, int ram) {
 			PRGIsRAM[AB + x] = 0;
 			Page[AB + x] = 0;
 		}
+	PRGPageChanged |= ((1u << (s >> 1)) - 1) << AB;
+	for (x = AB >> 1; x <= (int)((AB + (s >> 1) - 1) >> 1); x++)
+		UpdateReadPage(x);
 }
 
 static uint8 nothing[8192];
@@ -105,14 +199,19 @@ void ResetCartMapping(void) {
 		PRGptr[x] = CHRptr[x] = 0;
 		PRGsize[x] = CHRsize[x] = 0;
 	}
+	PRGPageChanged = 0xFFFFFFFF;
+	for (x = 0; x < 16; x++)
+		UpdateReadPage(x);
 	for (x = 0; x < 8; x++) {
 		MMC5SPRVPage[x] = MMC5BGVPage[x] = VPageR[x] = nothing - 0x400 * x;
 	}
+	FCEU_CHRPagesChanged();
 }
 
 void SetupCartPRGMapping(int chip, uint8 *p, uint32 size, int ram) {
 	PRGptr[chip] = p;
 	PRGsize[chip] = size;
+	PRGPageChanged = 0xFFFFFFFF;
 
 	PRGmask2[chip] = (size >> 11) - 1;
 	PRGmask4[chip] = (size >> 12) - 1;
@@ -121,6 +220,14 @@ void SetupCartPRGMapping(int chip, uint8 *p, uint32 size, int ram) {
 	PRGmask32[chip] = (size >> 15) - 1;
 
 	PRGram[chip] = ram ? 1 : 0;
+
+	if (chip == 0) {
+		int x;
+
+		PRGCodeVersion++;
+		for (x = 0; x < 16; x++)
+			UpdateReadPage(x);
+	}
 }
 
 void SetupCartCHRMapping(int chip, uint8 *p, uint32 size, int ram) {
@@ -233,14 +340,15 @@ void setchr1r(int r, uint32 A, uint32 V) {
 		PPUCHRRAM |= (1 << (A >> 10));
 	else
 		PPUCHRRAM &= ~(1 << (A >> 10));
-	VPageR[(A) >> 10] = &CHRptr[r][(V) << 10] - (A);
+	setvpageptr(A >> 10, &CHRptr[r][(V) << 10] - (A));
 }
 
 void setchr2r(int r, uint32 A, uint32 V) {
 	if (!CHRptr[r]) return;
 	FCEUPPU_LineUpdate();
 	V &= CHRmask2[r];
-	VPageR[(A) >> 10] = VPageR[((A) >> 10) + 1] = &CHRptr[r][(V) << 11] - (A);
+	setvpageptr(A >> 10, &CHRptr[r][(V) << 11] - (A));
+	setvpageptr((A >> 10) + 1, &CHRptr[r][(V) << 11] - (A));
 	if (CHRram[r])
 		PPUCHRRAM |= (3 << (A >> 10));
 	else
@@ -251,8 +359,8 @@ void setchr4r(int r, unsigned int A, unsigned int V) {
 	if (!CHRptr[r]) return;
 	FCEUPPU_LineUpdate();
 	V &= CHRmask4[r];
-	VPageR[(A) >> 10] = VPageR[((A) >> 10) + 1] =
-							VPageR[((A) >> 10) + 2] = VPageR[((A) >> 10) + 3] = &CHRptr[r][(V) << 12] - (A);
+	for (int x = 0; x < 4; x++)
+		setvpageptr((A >> 10) + x, &CHRptr[r][(V) << 12] - (A));
 	if (CHRram[r])
 		PPUCHRRAM |= (15 << (A >> 10));
 	else
@@ -266,7 +374,7 @@ void setchr8r(int r, uint32 V) {
 	FCEUPPU_LineUpdate();
 	V &= CHRmask8[r];
 	for (x = 7; x >= 0; x--)
-		VPageR[x] = &CHRptr[r][V << 13];
+		setvpageptr(x, &CHRptr[r][V << 13]);
 	if (CHRram[r])
 		PPUCHRRAM |= (255);
 	else
@@ -294,6 +402,7 @@ void setchr8(uint32 V) {
 void setntamem(uint8 *p, int ram, uint32 b) {
 	FCEUPPU_LineUpdate();
 	vnapage[b] = p;
+	FCEUPPU_PagesChanged();
 	PPUNTARAM &= ~(1 << b);
 	if (ram)
 		PPUNTARAM |= 1 << b;
@@ -306,6 +415,7 @@ void setmirrorw(int a, int b, int c, int d) {
 	vnapage[1] = NTARAM + b * 0x400;
 	vnapage[2] = NTARAM + c * 0x400;
 	vnapage[3] = NTARAM + d * 0x400;
+	FCEUPPU_PagesChanged();
 }
 
 void setmirror(int t) {
@@ -326,6 +436,7 @@ void setmirror(int t) {
 			break;
 		}
 		PPUNTARAM = 0xF;
+		FCEUPPU_PagesChanged();
 	}
 }
 
@@ -339,6 +450,7 @@ void SetupCartMirroring(int m, int hard, uint8 *extra) {
 		vnapage[2] = extra;
 		vnapage[3] = extra + 0x400;
 		PPUNTARAM = 0xF;
+		FCEUPPU_PagesChanged();
 	}
 	mirrorhard = hard;
 }
@@ -497,6 +609,7 @@ void FixGenieMap(void) {
 
 	for (x = 0; x < 8; x++)
 		VPage[x] = VPageG[x];
+	FCEU_CHRPagesChanged();
 
 	VPageR = VPage;
 	FlushGenieRW();
@@ -528,6 +641,7 @@ void FCEU_GeniePower(void) {
 
 	for (x = 0; x < 8; x++)
 		VPage[x] = GENIEROM + 4096 - 0x400 * x;
+	FCEU_CHRPagesChanged();
 
 	if (AllocGenieRW())
 		VPageR = VPageG;
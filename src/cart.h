@@ -87,11 +87,21 @@ void FCEU_LoadGameSave(CartInfo *LocalHWInfo);
 void FCEU_ClearGameSave(CartInfo *LocalHWInfo);
 
 extern uint8 *Page[32], *VPage[8], *MMC5SPRVPage[8], *MMC5BGVPage[8];
+extern uint8 *ReadPage[16];
+extern uint8 *WritePage[16];
+extern int32 PRGCodeBank[16];
+extern uint32 PRGCodeVersion;
+extern uint32 PRGPageChanged;
+extern uint32 CHRPageVersion[8];
+
+void FCEU_CHRPagesChanged(void);
 
 void ResetCartMapping(void);
 void SetupCartPRGMapping(int chip, uint8 *p, uint32 size, int ram);
 void SetupCartCHRMapping(int chip, uint8 *p, uint32 size, int ram);
 void SetupCartMirroring(int m, int hard, uint8 *extra);
+void UpdateCartReadPages(int32 start, int32 end);
+void UpdateCartWritePages(int32 start, int32 end);
 
 DECLFR(CartBROB);
 DECLFR(CartBR);
@@ -27,12 +27,14 @@
 #include "cart.h"
 #include "driver.h"
 #include "utils/memory.h"
+#include "drivers/common/ram_search.h"
 
 #include <string>
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
 #include <cctype>
+#include <vector>
 
 using namespace std;
 
@@ -41,12 +43,23 @@ static uint8 *CheatRPtrs[64];
 vector<uint16> FrozenAddresses;			//List of addresses that are currently frozen
 unsigned int FrozenAddressCount = 0;		//Keeps up with the Frozen address count, necessary for using in other dialogs (such as hex editor)
 
+// Periodic (type 0) cheats resolved to their RAM byte, written every frame
+struct CHEATF_PERIODIC
+{
+	uint8 *ptr;
+	uint8 val;
+};
+
+static std::vector<CHEATF_PERIODIC> PeriodicCheats;
+static bool periodicCheatsDirty = true;
+
 void FCEU_CheatResetRAM(void)
 {
 	int x;
 
 	for(x=0;x<64;x++)
 		CheatRPtrs[x]=0;
+	periodicCheatsDirty = true;
 }
 
 void FCEU_CheatAddRAM(int s, uint32 A, uint8 *p)
@@ -56,6 +69,7 @@ void FCEU_CheatAddRAM(int s, uint32 A, uint8 *p)
 
 	for(x=s-1;x>=0;x--)
 		CheatRPtrs[AB+x]=p-A;
+	periodicCheatsDirty = true;
 }
 
 // Cheat change event callback. Called whenever cheat map is changed or recalculated.
@@ -68,44 +82,39 @@ void FCEU_SetCheatChangeEventCallback( void (*func)(void*), void* userData )
 	cheatsChangeEventUserData = userData;
 }
 
-CHEATF_SUBFAST SubCheats[256];
+CHEATF_SUBFAST SubCheats[MAX_SUBCHEATS];
 uint32 numsubcheats = 0;
+static uint16 SubCheatSlot[0x10000];	// SubCheats index + 1 of each hooked address, 0 if none
 int globalCheatDisabled = 0;
 int disableAutoLSCheats = 0;
 bool disableShowGG = 0;
 static _8BYTECHEATMAP* cheatMap = NULL;
 struct CHEATF *cheats = 0, *cheatsl = 0;
 
-
-#define CHEATC_NONE     0x8000
-#define CHEATC_EXCLUDED 0x4000
-#define CHEATC_NOSHOW   0xC000
-
-static uint16 *CheatComp = 0;
+// Classic cheat search, the values recorded by FCEUI_CheatSearchBegin()
+// are the engine's stored values and the candidates are the addresses
+// not excluded yet
+static RamSearchEngine *CheatSearch = 0;
+static std::vector<uint8> CheatSearchMem;
 int savecheats = 0;
 
 static DECLFR(SubCheatsRead)
 {
-	CHEATF_SUBFAST *s = SubCheats;
-	int x=numsubcheats;
+	uint32 slot = SubCheatSlot[A & 0xFFFF];
+
+	if(!slot)
+		return(0);	/* We should never get here. */
 
-	do
+	const CHEATF_SUBFAST *s = &SubCheats[slot - 1];
+	if(s->compare>=0)
 	{
-		if(s->addr==A)
-		{
-			if(s->compare>=0)
-			{
-				uint8 pv=s->PrevRead(A);
+		uint8 pv=s->PrevRead(A);
 
-				if(pv==s->compare)
-					return(s->val);
-				else return(pv);
-			}
-			else return(s->val);
-		}
-		s++;
-	} while(--x);
-	return(0);	/* We should never get here. */
+		if(pv==s->compare)
+			return(s->val);
+		else return(pv);
+	}
+	return(s->val);
 }
 
 void RebuildSubCheats(void)
@@ -115,15 +124,17 @@ void RebuildSubCheats(void)
 	for (x = 0; x < numsubcheats; x++)
 	{
 		SetReadHandler(SubCheats[x].addr, SubCheats[x].addr, SubCheats[x].PrevRead);
+		SubCheatSlot[SubCheats[x].addr] = 0;
 		if (cheatMap)
 			FCEUI_SetCheatMapByte(SubCheats[x].addr, false);
 	}
 
 	numsubcheats = 0;
+	periodicCheatsDirty = true;
 
 	if (!globalCheatDisabled)
 	{
-		while(c)
+		while(c && numsubcheats < MAX_SUBCHEATS)
 		{
 			if(c->type == 1 && c->status && GetReadHandler(c->addr) != SubCheatsRead)
 			{
@@ -132,6 +143,7 @@ void RebuildSubCheats(void)
 				SubCheats[numsubcheats].val = c->val;
 				SubCheats[numsubcheats].compare = c->compare;
 				SetReadHandler(c->addr, c->addr, SubCheatsRead);
+				SubCheatSlot[c->addr] = numsubcheats + 1;
 				if (cheatMap)
 					FCEUI_SetCheatMapByte(SubCheats[numsubcheats].addr, true);
 				numsubcheats++;
@@ -151,6 +163,7 @@ void RebuildSubCheats(void)
 void FCEU_PowerCheats()
 {
 	numsubcheats = 0;	/* Quick hack to prevent setting of ancient read addresses. */
+	memset(SubCheatSlot, 0, sizeof(SubCheatSlot));
 	if (cheatMap)
 		FCEUI_RefreshCheatMap();
 	RebuildSubCheats();
@@ -167,10 +180,6 @@ int FCEU_CalcCheatAffectedBytes(uint32 address, uint32 size) {
 }
 
 static void AddCheatEntry(const char *name, uint32 addr, uint8 val, int compare, int status, int type);
-static void CheatMemErr(void)
-{
-	FCEUD_PrintError("Error allocating memory for cheat data.");
-}
 
 static void AddCheatEntry(const char *name, uint32 addr, uint8 val, int compare, int status, int type)
 {
@@ -183,6 +192,7 @@ static void AddCheatEntry(const char *name, uint32 addr, uint8 val, int compare,
 	temp->compare = compare;
 	temp->type = type;
 	temp->next = nullptr;
+	periodicCheatsDirty = true;
 
 	if(cheats)
 	{
@@ -325,10 +335,10 @@ void FCEU_SaveGameCheats(FILE* fp, int release)
 
 void FCEU_FlushGameCheats(FILE *override, int nosave)
 {
-	if(CheatComp)
+	if(CheatSearch)
 	{
-		free(CheatComp);
-		CheatComp=0;
+		delete CheatSearch;
+		CheatSearch=0;
 	}
 	if((!savecheats || nosave) && !override)	/* Always save cheats if we're being overridden. */
 	{
@@ -438,21 +448,32 @@ int FCEUI_DelCheat(uint32 which)
 	return(1);
 }
 
-void FCEU_ApplyPeriodicCheats(void)
+// Resolve the enabled periodic cheats once, instead of walking the list every frame
+static void RebuildPeriodicCheats(void)
 {
-	struct CHEATF *cur=cheats;
-	if(!cur) return;
+	PeriodicCheats.clear();
 
-	for(;;)
+	for(struct CHEATF *cur=cheats; cur; cur=cur->next)
 	{
-		if(cur->status && !(cur->type))
-			if(CheatRPtrs[cur->addr>>10])
-				CheatRPtrs[cur->addr>>10][cur->addr]=cur->val;
-		if(cur->next)
-			cur=cur->next;
-		else
-			break;
+		if(cur->status && !(cur->type) && CheatRPtrs[cur->addr>>10])
+		{
+			CHEATF_PERIODIC p;
+			p.ptr = &CheatRPtrs[cur->addr>>10][cur->addr];
+			p.val = cur->val;
+			PeriodicCheats.push_back(p);
+		}
 	}
+	periodicCheatsDirty = false;
+}
+
+void FCEU_ApplyPeriodicCheats(void)
+{
+	if(periodicCheatsDirty)
+		RebuildPeriodicCheats();
+
+	const CHEATF_PERIODIC *p = PeriodicCheats.data();
+	for(size_t n = PeriodicCheats.size(); n; n--, p++)
+		*p->ptr = p->val;
 }
 
 
@@ -667,198 +688,164 @@ int FCEUI_GlobalToggleCheat(int global_enabled)
 	return _numsubcheats != numsubcheats;
 }
 
-static int InitCheatComp(void)
+// Memory the searches compare, pages without cheat RAM read as 0
+static const uint8 *CheatSearchSnapshot(void)
 {
-	uint32 x;
+	CheatSearchMem.resize(0x10000);
 
-	CheatComp=(uint16*)FCEU_dmalloc(65536*sizeof(uint16));
-	if(!CheatComp)
+	for(int page=0;page<64;page++)
 	{
-		CheatMemErr();
-		return(0);
-	}
-	for(x=0;x<65536;x++)
-		CheatComp[x]=CHEATC_NONE;
+		uint8 *dst = &CheatSearchMem[page << 10];
 
-	return(1);
+		if(CheatRPtrs[page])
+			memcpy(dst, CheatRPtrs[page] + (page << 10), 1024);
+		else
+			memset(dst, 0, 1024);
+	}
+	return CheatSearchMem.data();
 }
 
-void FCEUI_CheatSearchSetCurrentAsOriginal(void)
+// Every address backed by cheat RAM becomes a candidate
+static void CheatSearchAllCandidates(void)
 {
-	uint32 x;
+	int start[64], end[64];
+	int regions = 0;
 
-	if(!CheatComp)
+	for(int page=0;page<64;page++)
 	{
-		if(InitCheatComp())
+		if(!CheatRPtrs[page])
+			continue;
+		if(regions && end[regions-1] == (page << 10))
+			end[regions-1] += 1024;
+		else
 		{
-			CheatMemErr();
-			return;
+			start[regions] = page << 10;
+			end[regions] = (page + 1) << 10;
+			regions++;
 		}
 	}
-	for(x=0x000;x<0x10000;x++)
-		if(!(CheatComp[x]&CHEATC_NOSHOW))
-		{
-			if(CheatRPtrs[x>>10])
-				CheatComp[x]=CheatRPtrs[x>>10][x];
-			else
-				CheatComp[x]|=CHEATC_NONE;
-		}
+	CheatSearch->setCandidates(start, end, regions, 1);
 }
 
-void FCEUI_CheatSearchShowExcluded(void)
+static void InitCheatComp(void)
 {
-	uint32 x;
-
-	for(x=0x000;x<0x10000;x++)
-		CheatComp[x]&=~CHEATC_EXCLUDED;
+	if(!CheatSearch)
+	{
+		CheatSearch = new RamSearchEngine();
+		CheatSearch->setFormat(1, false, RamSearchEngine::memSize);
+		CheatSearch->reset(CheatSearchSnapshot());
+	}
 }
 
+void FCEUI_CheatSearchSetCurrentAsOriginal(void)
+{
+	InitCheatComp();
+	CheatSearch->update(CheatSearchSnapshot());
+	CheatSearch->storeCurrent();
+}
 
-int32 FCEUI_CheatSearchGetCount(void)
+void FCEUI_CheatSearchShowExcluded(void)
 {
-	uint32 x,c=0;
+	if(CheatSearch)
+		CheatSearchAllCandidates();
+}
 
-	if(CheatComp)
-	{
-		for(x=0x0000;x<0x10000;x++)
-			if(!(CheatComp[x]&CHEATC_NOSHOW) && CheatRPtrs[x>>10])
-				c++;
-	}
 
-	return c;
+int32 FCEUI_CheatSearchGetCount(void)
+{
+	return CheatSearch ? (int32)CheatSearch->size() : 0;
 }
 /* This function will give the initial value of the search and the current value at a location. */
 
 void FCEUI_CheatSearchGet(int (*callb)(uint32 a, uint8 last, uint8 current, void *data),void *data)
 {
-	uint32 x;
-
-	if(!CheatComp)
+	if(!CheatSearch)
 	{
-		if(!InitCheatComp())
-			CheatMemErr();
+		InitCheatComp();
 		return;
 	}
 
-	for(x=0;x<0x10000;x++)
-		if(!(CheatComp[x]&CHEATC_NOSHOW) && CheatRPtrs[x>>10])
-			if(!callb(x,CheatComp[x],CheatRPtrs[x>>10][x],data))
+	for(size_t i=0;i<CheatSearch->size();i++)
+	{
+		uint32 x=CheatSearch->address(i);
+
+		if(CheatRPtrs[x>>10])
+			if(!callb(x,(uint8)CheatSearch->previous(x),CheatRPtrs[x>>10][x],data))
 				break;
+	}
 }
 
 void FCEUI_CheatSearchGetRange(uint32 first, uint32 last, int (*callb)(uint32 a, uint8 last, uint8 current))
 {
-	uint32 x;
 	uint32 in = 0;
 
-	if(!CheatComp)
+	if(!CheatSearch)
 	{
-		if(!InitCheatComp())
-			CheatMemErr();
+		InitCheatComp();
 		return;
 	}
 
-	for(x = 0; x < 0x10000; x++)
-		if(!(CheatComp[x] & CHEATC_NOSHOW) && CheatRPtrs[x >> 10])
+	for(size_t i = 0; i < CheatSearch->size(); i++)
+	{
+		uint32 x = CheatSearch->address(i);
+
+		if(CheatRPtrs[x >> 10])
 		{
 			if(in >= first)
-				if(!callb(x, CheatComp[x], CheatRPtrs[x >> 10][x]))
+				if(!callb(x, (uint8)CheatSearch->previous(x), CheatRPtrs[x >> 10][x]))
 					break;
 			in++;
 			if(in > last)
 				return;
 		}
-}
-
-void FCEUI_CheatSearchBegin(void)
-{
-	uint32 x;
-
-	if(!CheatComp)
-	{
-		if(!InitCheatComp())
-		{
-			CheatMemErr();
-			return;
-		}
-	}
-	for(x=0;x<0x10000;x++)
-	{
-		if(CheatRPtrs[x>>10])
-			CheatComp[x]=CheatRPtrs[x>>10][x];
-		else
-			CheatComp[x]=CHEATC_NONE;
 	}
 }
 
-
-static int INLINE CAbs(int x)
+void FCEUI_CheatSearchBegin(void)
 {
-	if(x<0)
-		return(0-x);
-	return x;
+	InitCheatComp();
+	CheatSearch->reset(CheatSearchSnapshot());
+	CheatSearchAllCandidates();
 }
 
 void FCEUI_CheatSearchEnd(int type, uint8 v1, uint8 v2)
 {
-	uint32 x;
+	InitCheatComp();
 
-	if(!CheatComp)
-	{
-		if(!InitCheatComp())
-		{
-			CheatMemErr();
-			return;
-		}
-	}
+	// "original" is the stored value, "current" the memory now
+	CheatSearch->update(CheatSearchSnapshot());
 
 	switch (type)
 	{
 		default:
 		case FCEU_SEARCH_SPECIFIC_CHANGE: // Change to a specific value
-			for (x = 0; x < 0x10000; ++x)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && (CheatComp[x] != v1 || CheatRPtrs[x >> 10][x] != v2))
-					CheatComp[x] |= CHEATC_EXCLUDED;
+			CheatSearch->search(RamSearchEngine::STORED_VALUE, '=', v1, 0, false);
+			CheatSearch->search(RamSearchEngine::SPECIFIC_VALUE, '=', v2, 0, false);
 			break;
 		case FCEU_SEARCH_RELATIVE_CHANGE: // Search for relative change (between values).
-			for (x = 0; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && (CheatComp[x] != v1 || CAbs(CheatComp[x] - CheatRPtrs[x >> 10][x]) != v2))
-					CheatComp[x] |= CHEATC_EXCLUDED;
+			CheatSearch->search(RamSearchEngine::STORED_VALUE, '=', v1, 0, false);
+			CheatSearch->search(RamSearchEngine::PREVIOUS_VALUE, 'd', 0, v2, false);
 			break;
 		case FCEU_SEARCH_PUERLY_RELATIVE_CHANGE: // Purely relative change.
-			for (x = 0x000; x<0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && CAbs(CheatComp[x] - CheatRPtrs[x >> 10][x]) != v2)
-					CheatComp[x] |= CHEATC_EXCLUDED;
+			CheatSearch->search(RamSearchEngine::PREVIOUS_VALUE, 'd', 0, v2, false);
 			break;
 		case FCEU_SEARCH_ANY_CHANGE: // Any change.
-			for (x = 0x000; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && CheatComp[x] == CheatRPtrs[x >> 10][x])
-					CheatComp[x] |= CHEATC_EXCLUDED;
+			CheatSearch->search(RamSearchEngine::PREVIOUS_VALUE, '!', 0, 0, false);
 			break;
 		case FCEU_SEARCH_NEWVAL_KNOWN: // new value = known
-			for (x = 0x000; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && CheatRPtrs[x >> 10][x] != v1)
-					CheatComp[x] |= CHEATC_EXCLUDED;
+			CheatSearch->search(RamSearchEngine::SPECIFIC_VALUE, '=', v1, 0, false);
 			break;
 		case FCEU_SEARCH_NEWVAL_GT: // new value greater than
-			for (x = 0x000; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && CheatComp[x] >= CheatRPtrs[x >> 10][x])
-					CheatComp[x] |= CHEATC_EXCLUDED;
+			CheatSearch->search(RamSearchEngine::PREVIOUS_VALUE, '>', 0, 0, false);
 			break;
 		case FCEU_SEARCH_NEWVAL_LT: // new value less than
-			for (x = 0x000; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && CheatComp[x] <= CheatRPtrs[x >> 10][x])
-					CheatComp[x] |= CHEATC_EXCLUDED;
+			CheatSearch->search(RamSearchEngine::PREVIOUS_VALUE, '<', 0, 0, false);
 			break;
 		case FCEU_SEARCH_NEWVAL_GT_KNOWN: // new value greater than by known value
-			for (x = 0x000; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && CheatRPtrs[x >> 10][x] - CheatComp[x] != v2)
-					CheatComp[x] |= CHEATC_EXCLUDED;
+			CheatSearch->search(RamSearchEngine::PREVIOUS_VALUE, '+', 0, v2, false);
 			break;
 		case FCEU_SEARCH_NEWVAL_LT_KNOWN: // new value less than by known value
-			for (x = 0x000; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && (CheatComp[x] - CheatRPtrs[x >> 10][x]) != v2)
-					CheatComp[x] |= CHEATC_EXCLUDED;
+			CheatSearch->search(RamSearchEngine::PREVIOUS_VALUE, '+', 0, -(int64_t)v2, false);
 			break;
 	}
 
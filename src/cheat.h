@@ -35,6 +35,9 @@ int FCEU_DeleteAllCheats(void);
 
 void FCEU_SetCheatChangeEventCallback( void (*func)(void*) = nullptr, void* userData = nullptr );
 
+// Substitute cheats hooked at once, one per address
+#define MAX_SUBCHEATS 1024
+
 struct CHEATF_SUBFAST
 {
 	uint16 addr;
@@ -511,6 +511,186 @@ static Condition* Connect(const char** str)
 	return InfixOperator(str, Compare, ConnectOperators);
 }
 
+static void emit(std::vector<CondInstr>& program, uint8 code, int value = 0, uint8 op = OP_NO)
+{
+	CondInstr in;
+
+	in.code = code;
+	in.op = op;
+	in.target = 0;
+	in.value = value;
+
+	program.push_back(in);
+}
+
+// True when everything from start on is a single constant
+static bool isConstant(const std::vector<CondInstr>& program, size_t start)
+{
+	return (program.size() == start + 1) && (program[start].code == COND_NUM);
+}
+
+static void compileNode(std::vector<CondInstr>& program, const Condition* c);
+
+// One side of a node, mirroring what evaluate() does with type and value
+static void compileOperand(std::vector<CondInstr>& program, const Condition* sub, unsigned int type, unsigned int value, bool right)
+{
+	size_t start = program.size();
+
+	switch (type)
+	{
+		case TYPE_PC_BANK: emit(program, COND_PC_BANK); return;
+		case TYPE_DATA_BANK: emit(program, COND_DATA_BANK); return;
+		case TYPE_VALUE_READ: emit(program, COND_VALUE_READ); return;
+		case TYPE_VALUE_WRITE: emit(program, COND_VALUE_WRITE); return;
+	}
+
+	if (sub)
+	{
+		compileNode(program, sub);
+	}
+	else if ((type == TYPE_NUM) || (type == TYPE_ADDR))
+	{
+		emit(program, COND_NUM, value);
+	}
+	else if (right)
+	{
+		// the interpreter looks up the type rather than the value on the
+		// right side, which is never a register name, so this reads 0
+		emit(program, COND_NUM, 0);
+	}
+	else
+	{
+		emit(program, COND_REG, value);
+	}
+
+	if (type == TYPE_ADDR)
+	{
+		if (isConstant(program, start))
+		{
+			program[start].code = COND_MEM;
+		}
+		else
+		{
+			emit(program, COND_LOAD);
+		}
+	}
+}
+
+static void compileNode(std::vector<CondInstr>& program, const Condition* c)
+{
+	size_t start = program.size();
+
+	compileOperand(program, c->lhs, c->type1, c->value1, false);
+
+	if (c->op == OP_NO)
+	{
+		return;
+	}
+	bool lhsConstant = isConstant(program, start);
+
+	if ((c->op == OP_AND) || (c->op == OP_OR))
+	{
+		size_t jump = program.size();
+
+		if (lhsConstant)
+		{
+			bool lhs = program[start].value != 0;
+
+			program.pop_back();
+
+			// a constant on the left either decides the result or drops out
+			if (lhs == (c->op == OP_OR))
+			{
+				emit(program, COND_NUM, lhs);
+				return;
+			}
+		}
+		else
+		{
+			emit(program, (c->op == OP_AND) ? COND_AND : COND_OR);
+		}
+		size_t mid = program.size();
+
+		compileOperand(program, c->rhs, c->type2, c->value2, true);
+
+		if (isConstant(program, mid))
+		{
+			program[mid].value = program[mid].value != 0;
+		}
+		else
+		{
+			emit(program, COND_BOOL);
+		}
+		if (!lhsConstant)
+		{
+			program[jump].target = program.size();
+		}
+		return;
+	}
+	size_t mid = program.size();
+
+	compileOperand(program, c->rhs, c->type2, c->value2, true);
+
+	if (isConstant(program, mid))
+	{
+		int rhs = program[mid].value;
+
+		program.pop_back();
+
+		if (lhsConstant)
+		{
+			program[start].value = conditionOperator(c->op, program[start].value, rhs);
+		}
+		else
+		{
+			emit(program, COND_OP_NUM, rhs, c->op);
+		}
+	}
+	else
+	{
+		emit(program, COND_OP, 0, c->op);
+	}
+}
+
+void compileCondition(Condition* c)
+{
+	std::vector<CondInstr>& program = c->program;
+	int depth = 0, maxDepth = 0;
+
+	program.clear();
+	compileNode(program, c);
+
+	// Stack use along the path that skips no jumps, which is the deepest
+	for (size_t i = 0; i < program.size(); i++)
+	{
+		switch (program[i].code)
+		{
+			case COND_NUM:
+			case COND_REG:
+			case COND_MEM:
+			case COND_PC_BANK:
+			case COND_DATA_BANK:
+			case COND_VALUE_READ:
+			case COND_VALUE_WRITE:
+				depth++;
+				break;
+			case COND_OP:
+			case COND_AND:
+			case COND_OR:
+				depth--;
+				break;
+		}
+		if (depth > maxDepth)
+		{
+			maxDepth = depth;
+		}
+	}
+	if ((maxDepth > COND_MAX_STACK) || (program.size() > 0xFFFF))
+	{
+		program.clear();
+	}
+}
+
 /* Root of the parser generator */
 Condition* generateCondition(const char* str)
 {
@@ -524,5 +704,8 @@ Condition* generateCondition(const char* str)
 		if (c) delete c;
 		return 0;
 	}
-	else return c;
+
+	compileCondition(c);
+
+	return c;
 }
@@ -21,6 +21,8 @@
 #ifndef CONDDEBUG_H
 #define CONDDEBUG_H
 
+#include <vector>
+
 #define TYPE_NO 0
 #define TYPE_REG 1
 #define TYPE_FLAG 2
@@ -45,9 +47,61 @@
 #define OP_OR 11
 #define OP_AND 12
 
+// Instructions of a compiled condition. The program works on a stack of
+// ints: the operand instructions push a value, COND_LOAD replaces the top
+// with the byte at that address, the operators combine the top two (or the
+// top and their constant). COND_AND and COND_OR jump to target when the top
+// already decides the result, otherwise they drop it.
+#define COND_NUM 0        // push value
+#define COND_REG 1        // push register or flag value
+#define COND_MEM 2        // push byte at address value
+#define COND_LOAD 3
+#define COND_PC_BANK 4
+#define COND_DATA_BANK 5
+#define COND_VALUE_READ 6
+#define COND_VALUE_WRITE 7
+#define COND_OP 8         // op on the top two
+#define COND_OP_NUM 9     // op on the top and value
+#define COND_AND 10
+#define COND_OR 11
+#define COND_BOOL 12      // top = top != 0
+
+// deepest stack a compiled condition may use, deeper ones are interpreted
+#define COND_MAX_STACK 32
+
 extern uint16 debugLastAddress;
 extern uint8 debugLastOpcode;
 
+struct CondInstr
+{
+	uint8 code;
+	uint8 op;       // OP_* for COND_OP and COND_OP_NUM
+	uint16 target;  // COND_AND and COND_OR
+	int value;
+};
+
+// Applies a binary operator the way conditions always have: comparisons
+// and && / || give 0 or 1, division by zero gives 0.
+static inline int conditionOperator(unsigned int op, int value1, int value2)
+{
+	switch (op)
+	{
+		case OP_EQ: return value1 == value2;
+		case OP_NE: return value1 != value2;
+		case OP_GE: return value1 >= value2;
+		case OP_LE: return value1 <= value2;
+		case OP_G: return value1 > value2;
+		case OP_L: return value1 < value2;
+		case OP_MULT: return value1 * value2;
+		case OP_DIV: return (value2==0) ? 0 : (value1 / value2);
+		case OP_PLUS: return value1 + value2;
+		case OP_MINUS: return value1 - value2;
+		case OP_OR: return value1 || value2;
+		case OP_AND: return value1 && value2;
+	}
+	return value1;
+}
+
 //mbg merge 7/18/06 turned into sane c++
 struct Condition
 {
@@ -62,6 +116,11 @@ struct Condition
 	unsigned int type2;
 	unsigned int value2;
 
+	// Only filled on the root, by generateCondition(): the whole tree as one
+	// flat program with the constant parts folded. Empty when the tree is
+	// too deep for COND_MAX_STACK, then the tree itself is evaluated.
+	std::vector<CondInstr> program;
+
 	Condition(void)
 	{
 		op = 0;
@@ -85,4 +144,7 @@ struct Condition
 
 Condition* generateCondition(const char* str);
 
+// Builds c->program from the tree under c.
+void compileCondition(Condition* c);
+
 #endif
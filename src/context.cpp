@@ -0,0 +1,183 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// context.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "state.h"
+#include "movie.h"
+#include "input.h"
+#include "context.h"
+#include "zlib.h"
+
+namespace FCEU
+{
+
+Context *Context::active = nullptr;
+unsigned int Context::nextId = 1;
+// Bumped each time a game is closed, a context is only good for the serial
+// it was captured under.
+unsigned int Context::gameSerial = 0;
+
+// Core cycle counter at the time the active context was last synchronized.
+// Any emulation or state load done outside of the context API moves it.
+static uint64 activeTimestamp = 0;
+
+//-----------------------------------------------------
+Context::Context(void)
+	: state( static_cast<size_t>(0) )
+{
+	stateLen     = 0;
+	frameCounter = 0;
+	lagFrames    = 0;
+	valid        = false;
+	contextId    = nextId++;
+	gameId       = 0;
+}
+
+Context::~Context(void)
+{
+	if (active == this)
+	{
+		active = nullptr;
+	}
+}
+
+std::recursive_mutex &Context::coreLock(void)
+{
+	static std::recursive_mutex coreMutex;
+
+	return coreMutex;
+}
+
+Context *Context::current(void)
+{
+	return active;
+}
+
+void Context::invalidateCurrent(void)
+{
+	active = nullptr;
+}
+
+void Context::gameClosed(void)
+{
+	std::lock_guard<std::recursive_mutex> lock( coreLock() );
+
+	active = nullptr;
+	gameSerial++;
+}
+
+void Context::reset(void)
+{
+	std::lock_guard<std::recursive_mutex> lock( coreLock() );
+
+	if (active == this)
+	{
+		active = nullptr;
+	}
+	state.set_len(0);
+	stateLen = 0;
+	frameCounter = 0;
+	lagFrames = 0;
+	valid = false;
+}
+
+bool Context::capture(void)
+{
+	// the core globals are read, a Scope of another thread may be running
+	std::lock_guard<std::recursive_mutex> lock( coreLock() );
+
+	if (GameInfo == nullptr)
+	{
+		return false;
+	}
+	// Reuse the vector that backs the memory stream, after the first capture
+	// this does not allocate unless the state grows.
+	state.set_len(0);
+	state.unfail();
+
+	if (!FCEUSS_SaveMS( &state, Z_NO_COMPRESSION ))
+	{
+		valid = false;
+		return false;
+	}
+	stateLen     = state.size();
+	frameCounter = currFrameCounter;
+	lagFrames    = lagCounter;
+	gameId       = gameSerial;
+	valid        = true;
+
+	active = this;
+	activeTimestamp = timestampbase;
+
+	return true;
+}
+
+bool Context::activate(void)
+{
+	std::lock_guard<std::recursive_mutex> lock( coreLock() );
+
+	if (!valid || (gameId != gameSerial) || (GameInfo == nullptr))
+	{
+		// never captured, or captured from a game since closed
+		return false;
+	}
+	if ( (active == this) && (activeTimestamp == timestampbase) )
+	{
+		// Core already holds this context's state.
+		return true;
+	}
+	state.fseek(0, SEEK_SET);
+
+	if (!FCEUSS_LoadFP( &state, SSLOADPARAM_NOBACKUP ))
+	{
+		active = nullptr;
+		return false;
+	}
+	currFrameCounter = frameCounter;
+	lagCounter       = lagFrames;
+
+	active = this;
+	activeTimestamp = timestampbase;
+
+	return true;
+}
+
+//-----------------------------------------------------
+// Scoped Activation
+//-----------------------------------------------------
+Context::Scope::Scope( Context &c )
+{
+	ctx = &c;
+	coreLock().lock();
+	success = ctx->activate();
+}
+
+Context::Scope::~Scope(void)
+{
+	if (success)
+	{
+		ctx->capture();
+	}
+	coreLock().unlock();
+}
+
+} // namespace FCEU
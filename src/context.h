@@ -0,0 +1,134 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// context.h
+
+#pragma once
+
+/*
+ *  Same-ROM state-swapping contexts: several consoles of the one loaded game,
+ *  taking turns on the single core.
+ *
+ *  The core keeps its machine state in globals (X, RAM, PPU and APU registers, mapper
+ *  registers, ...). A context does not own a copy of those globals; it holds a complete
+ *  uncompressed snapshot of them (the same chunks the savestate system writes) and
+ *  swaps it in and out of the globals on activation.
+ *
+ *  So this is not N independent consoles running in parallel:
+ *   - all contexts share the loaded GameInfo and ROM image, a context is only valid
+ *     for the game that was loaded when it was captured: once that game is closed,
+ *     activate() fails until the context is captured again;
+ *   - only one context runs at a time. capture(), activate() and Scope all take the
+ *     core lock, so worker threads using contexts run one after the other, each
+ *     paying for a state load and save on every switch.
+ *
+ *  That suits many runs of the same ROM from one thread or a few (regression farms,
+ *  RL environments, search bots):
+ *
+ *      FCEU::Context ctx;
+ *      ctx.capture();            // fork from the running console
+ *      ...
+ *      {
+ *          FCEU::Context::Scope scope(ctx);
+ *          FCEUI_Emulate(&gfx, &sound, &ssize, 2);
+ *      }                         // state is captured back into ctx here
+ *
+ *  The core lock only orders users of this API; code that drives the core without
+ *  it (the frontend's emulation loop) must hold its own emulator lock around them.
+ */
+
+#include <stddef.h>
+
+#include <mutex>
+
+#include "types.h"
+#include "emufile.h"
+
+namespace FCEU
+{
+	class Context
+	{
+		public:
+			Context(void);
+			~Context(void);
+
+			// Copy the state of the running console into this context, under
+			// the core lock.
+			bool capture(void);
+
+			// Load this context's state into the core. This is a no-op when
+			// the context is already the active one and nothing else ran since.
+			bool activate(void);
+
+			// Drop any stored state, the context must be captured again before use.
+			void reset(void);
+
+			bool   isValid(void) const { return valid && (gameId == gameSerial); }
+			bool   isActive(void) const { return active == this; }
+			size_t stateSize(void) const { return stateLen; }
+			int    frameCount(void) const { return frameCounter; }
+			unsigned int lagCount(void) const { return lagFrames; }
+			unsigned int id(void) const { return contextId; }
+
+			// Context whose state currently lives in the core globals, or nullptr.
+			static Context *current(void);
+
+			// Forget the active context, e.g. after a savestate load or game
+			// change from outside the context API.
+			static void invalidateCurrent(void);
+
+			// Called when the loaded game is closed: every context captured
+			// so far is left invalid.
+			static void gameClosed(void);
+
+			// Lock held while a context owns the core, recursive so that a
+			// Scope can capture and activate under it.
+			static std::recursive_mutex &coreLock(void);
+
+			// Activates a context for the lifetime of the object and writes the
+			// resulting machine state back into it on destruction.
+			class Scope
+			{
+				public:
+					Scope( Context &ctx );
+					~Scope(void);
+
+					bool ok(void) const { return success; }
+				private:
+					Context *ctx;
+					bool success;
+			};
+
+		private:
+			Context(const Context&) = delete;
+			Context& operator=(const Context&) = delete;
+
+			EMUFILE_MEMORY state;
+			size_t stateLen;
+			int    frameCounter;
+			unsigned int lagFrames;
+			unsigned int contextId;
+			unsigned int gameId;
+			bool   valid;
+
+			static Context *active;
+			static unsigned int nextId;
+			static unsigned int gameSerial;
+	};
+};
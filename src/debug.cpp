@@ -9,6 +9,7 @@
 #include "debugsymboltable.h"
 #include "driver.h"
 #include "ppu.h"
+#include "reversedebug.h"
 
 #include "x6502abbrev.h"
 
@@ -18,14 +19,32 @@
 unsigned int debuggerPageSize = 14;
 int vblankScanLines = 0;	//Used to calculate scanlines 240-261 (vblank)
 int vblankPixel = 0;		//Used to calculate the pixels in vblank
+int debugNMIStack = -1;
 
 
 struct TraceInstructionCallback
 {
 	void (*func)(uint8 *opcode, int size) = nullptr;
 	TraceInstructionCallback* next = nullptr;
+
+	// FCEUI_TraceInstructionSetFilter()
+	TraceFilter* filter = nullptr;
+	Condition* startCond = nullptr;
+	Condition* stopCond = nullptr;
+	bool tracing = true;    // between the start and stop conditions
+	unsigned int sampleCount = 0;
+
+	~TraceInstructionCallback(void)
+	{
+		delete filter;
+		delete startCond;
+		delete stopCond;
+	}
 };
 static TraceInstructionCallback* traceInstructionCB = nullptr;
+#ifdef __WIN_DRIVER__
+extern volatile int logging;	// drivers/win/tracer.cpp, checked by FCEUD_TraceInstruction()
+#endif
 
 int offsetStringToInt(unsigned int type, const char* offsetBuffer, bool *conversionOk)
 {
@@ -250,6 +269,9 @@ unsigned int NewBreak(const char* name, int start, int end, unsigned int type, c
 		watchpoint[num].flags|=BT_R;
 	}
 
+	watchpoint[num].hitCount = 0;
+	watchpoint[num].evalCount = 0;
+
 	if (watchpoint[num].desc)
 		free(watchpoint[num].desc);
 
@@ -259,7 +281,7 @@ unsigned int NewBreak(const char* name, int start, int end, unsigned int type, c
 	return checkCondition(condition, num);
 }
 
-int GetPRGAddress(int A){
+static int GetPRGAddressSlow(int A){
 	int result;
 	if(A > 0xFFFF)
 		return -1;
@@ -286,6 +308,63 @@ int GetPRGAddress(int A){
 	}
 }
 
+// PRG offset of each 2K page of CPU address space, as GetPRGAddress() would
+// compute it for the first address of the page, so that the code/data logger
+// does not redo the pointer math on every access. PRG_PAGE_NONE when none of
+// the page is PRG, PRG_PAGE_SPLIT when only some of it is. cart.cpp flags the
+// pages it remaps in PRGPageChanged, and all of them when a game is loaded.
+#define PRG_PAGE_NONE   -1
+#define PRG_PAGE_SPLIT  -2
+
+static int prgPageOffset[32];
+
+static void UpdatePRGPageOffsets(void)
+{
+	bool fds = GameInfo && (GameInfo->type == GIT_FDS);
+	uint32 changed = PRGPageChanged;
+
+	PRGPageChanged = 0;
+
+	for (int i = 0; i < 32; i++)
+	{
+		if (!(changed & (1u << i)))
+			continue;
+
+		int A = i << 11;
+		int chip = (fds && (A < 0xE000)) ? 1 : 0;
+		int lo = &Page[i][A] - PRGptr[chip];
+		int hi = lo + 0x7FF;
+		int size = (int)PRGsize[chip];
+
+		if ((lo >= 0) && (hi <= size))
+			prgPageOffset[i] = (fds && !chip) ? lo + PRGsize[1] : lo;
+		else if ((hi < 0) || (lo > size))
+			prgPageOffset[i] = PRG_PAGE_NONE;
+		else
+			prgPageOffset[i] = PRG_PAGE_SPLIT;
+	}
+}
+
+static INLINE int PRGPageAddress(uint16 A){
+	int ofs;
+	if (PRGPageChanged)
+		UpdatePRGPageOffsets();
+
+	ofs = prgPageOffset[A >> 11];
+
+	if (ofs >= 0)
+		return ofs + (A & 0x7FF);
+	if (ofs == PRG_PAGE_NONE)
+		return -1;
+	return GetPRGAddressSlow(A);
+}
+
+int GetPRGAddress(int A){
+	if ((unsigned int)A > 0xFFFF)
+		return -1;
+	return PRGPageAddress(A);
+}
+
 /**
 * Returns the bank for a given offset.
 * Technically speaking this function does not calculate the actual bank
@@ -407,6 +486,51 @@ uint8 evaluateWrite(uint8 opcode, uint16 address)
 	return 0;
 }
 
+// Runs the program compileCondition() made of a condition
+static int runCondition(const std::vector<CondInstr>& program)
+{
+	int stack[COND_MAX_STACK];
+	int sp = -1;
+	size_t pc = 0;
+	const size_t size = program.size();
+
+	while (pc < size)
+	{
+		const CondInstr& in = program[pc++];
+
+		switch (in.code)
+		{
+			case COND_NUM: stack[++sp] = in.value; break;
+			case COND_REG: stack[++sp] = getValue(in.value); break;
+			case COND_MEM: stack[++sp] = GetMem(in.value); break;
+			case COND_LOAD: stack[sp] = GetMem(stack[sp]); break;
+			case COND_PC_BANK: stack[++sp] = getBank(_PC); break;
+			case COND_DATA_BANK: stack[++sp] = getBank(debugLastAddress); break;
+			case COND_VALUE_READ: stack[++sp] = GetMem(debugLastAddress); break;
+			case COND_VALUE_WRITE: stack[++sp] = evaluateWrite(debugLastOpcode, debugLastAddress); break;
+			case COND_OP: sp--; stack[sp] = conditionOperator(in.op, stack[sp], stack[sp+1]); break;
+			case COND_OP_NUM: stack[sp] = conditionOperator(in.op, stack[sp], in.value); break;
+			case COND_AND:
+				if (stack[sp] == 0)
+					pc = in.target;
+				else
+					sp--;
+				break;
+			case COND_OR:
+				if (stack[sp] != 0)
+				{
+					stack[sp] = 1;
+					pc = in.target;
+				}
+				else
+					sp--;
+				break;
+			case COND_BOOL: stack[sp] = stack[sp] != 0; break;
+		}
+	}
+	return stack[0];
+}
+
 // Evaluates a condition
 int evaluate(Condition* c)
 {
@@ -414,6 +538,11 @@ int evaluate(Condition* c)
 
 	int value1, value2;
 
+	if (!c->program.empty())
+	{
+		return runCondition(c->program);
+	}
+
 	if (c->lhs)
 	{
 		value1 = evaluate(c->lhs);
@@ -486,7 +615,12 @@ int evaluate(Condition* c)
 
 int condition(watchpointinfo* wp)
 {
-	return wp->cond == 0 || evaluate(wp->cond);
+	if (wp->cond == 0)
+		return 1;
+
+	wp->evalCount++;
+
+	return evaluate(wp->cond);
 }
 
 
@@ -502,7 +636,7 @@ int debug_loggingCD = 0;
 //called by the cpu to perform logging if CDLogging is enabled
 void LogCDVectors(int which){
 	int j;
-	j = GetPRGAddress(which);
+	j = PRGPageAddress(which);
 	if(j == -1) return;
 
 	if(!(cdloggerdata[j] & 2)){
@@ -528,7 +662,7 @@ void LogCDData(uint8 *opcode, uint16 A, int size)
 	uint8 memop = 0;
 	bool newCodeHit = false, newDataHit = false;
 
-	if ((j = GetPRGAddress(_PC)) != -1)
+	if ((j = PRGPageAddress(_PC)) != -1)
 	{
 		for (i = 0; i < size; i++)
 		{
@@ -554,7 +688,7 @@ void LogCDData(uint8 *opcode, uint16 A, int size)
 		case 4: memop = 0x20; break;
 	}
 
-	if (((j = GetPRGAddress(A)) != -1) && (opcode[0] != 0x4C) && (opcode[0] != 0x6C))
+	if (((j = PRGPageAddress(A)) != -1) && (opcode[0] != 0x4C) && (opcode[0] != 0x6C))
 	{
 		if (opwrite[opcode[0]] == 0)
 		{
@@ -635,6 +769,9 @@ void ResetCyclesCounter()
 void ResetInstructionsCounter()
 {
 	total_instructions = delta_instructions = 0;
+
+	// it is what the reverse debugger finds its way back by
+	FCEU_ReverseDebugReset();
 }
 void ResetDebugStatisticsDeltaCounters()
 {
@@ -647,6 +784,33 @@ void IncrementInstructionsCounters()
 	delta_instructions++;
 }
 
+static void UpdateBreakIndex();
+
+// returns true if DebugCycle() has anything to do, otherwise the CPU core may skip calling it
+bool DebugCycleNeeded()
+{
+	// called before every run of the CPU core, which is also when changes
+	// the frontends made to watchpoint[] are picked up
+	if (numWPs)
+		UpdateBreakIndex();
+
+	// frames the reverse debugger runs again on the way to an earlier one
+	if (fceuReverseDebugFastForward)
+		return false;
+
+	if (numWPs || dbgstate.step || dbgstate.runline || dbgstate.stepout || watchpoint[64].flags || dbgstate.badopbreak || break_on_cycles || break_on_instructions || break_asap || fceuReverseDebugTarget)
+		return true;
+
+	if (debug_loggingCD)
+		return true;
+
+#ifdef __WIN_DRIVER__
+	return logging != 0;
+#else
+	return traceInstructionCB != nullptr;
+#endif
+}
+
 bool CondForbidTest(int bp_num) {
 	if (bp_num >= 0 && !condition(&watchpoint[bp_num]))
 	{
@@ -675,18 +839,148 @@ bool CondForbidTest(int bp_num) {
 	return true;
 }
 
+// Which instructions can possibly hit a watchpoint, so that breakpoint() only
+// scans watchpoint[] for those. It is a superset: the scan below still
+// decides, with the access type and conditions, whether a break happens.
+// The frontends edit watchpoint[] directly, so the index keeps a copy of
+// what it was built from and is rebuilt when that no longer matches, see
+// UpdateBreakIndex().
+static struct
+{
+	uint8  rw[0x10000 / 8];   // CPU addresses of R/W watchpoints
+	uint8  x[0x10000 / 8];    // CPU addresses of X watchpoints
+	bool   ppu;               // any PPU or sprite watchpoint
+	bool   stack;             // any CPU watchpoint without X, see the stack checks
+	int    numRom;
+	uint32 rom[64];           // ROM file offsets of single address X watchpoints
+
+	int    numWPs;
+	uint32 address[64];
+	uint32 endaddress[64];
+	uint16 flags[64];
+} breakIndex = { {0}, {0}, false, false, 0, {0}, -1 };
+
+static void markBreakIndex(uint8 *map, uint32 start, uint32 end)
+{
+	if (end > 0xFFFF)
+	{
+		end = 0xFFFF;
+	}
+	for (uint32 a = start; a <= end; a++)
+	{
+		map[a >> 3] |= 1 << (a & 7);
+	}
+}
+
+static void UpdateBreakIndex()
+{
+	int n = numWPs;
+
+	if (n > 64)
+	{
+		n = 64;
+	}
+	if (n == breakIndex.numWPs)
+	{
+		int i;
+
+		for (i = 0; i < n; i++)
+		{
+			if ((watchpoint[i].address != breakIndex.address[i]) ||
+				(watchpoint[i].endaddress != breakIndex.endaddress[i]) ||
+				(watchpoint[i].flags != breakIndex.flags[i]))
+				break;
+		}
+		if (i == n)
+			return;
+	}
+
+	memset(breakIndex.rw, 0, sizeof(breakIndex.rw));
+	memset(breakIndex.x, 0, sizeof(breakIndex.x));
+	breakIndex.ppu = false;
+	breakIndex.stack = false;
+	breakIndex.numRom = 0;
+
+	for (int i = 0; i < n; i++)
+	{
+		const watchpointinfo &wp = watchpoint[i];
+
+		breakIndex.address[i] = wp.address;
+		breakIndex.endaddress[i] = wp.endaddress;
+		breakIndex.flags[i] = wp.flags;
+
+		if (!(wp.flags & WP_E))
+			continue;
+
+		if (wp.flags & (BT_P | BT_S))
+		{
+			breakIndex.ppu = true;
+			continue;
+		}
+		if (!(wp.flags & WP_X))
+		{
+			breakIndex.stack = true;
+		}
+		if (!wp.endaddress && (wp.flags & BT_R))
+		{
+			if (wp.flags & WP_X)
+				breakIndex.rom[breakIndex.numRom++] = wp.address;
+			continue;
+		}
+		uint32 end = wp.endaddress ? wp.endaddress : wp.address;
+
+		if (wp.flags & (WP_R | WP_W))
+			markBreakIndex(breakIndex.rw, wp.address, end);
+		if (wp.flags & WP_X)
+			markBreakIndex(breakIndex.x, wp.address, end);
+	}
+	breakIndex.numWPs = n;
+}
+
 void BreakHit(int bp_num)
 {
+	if (!FCEU_ReverseDebugBreakFilter(bp_num))
+		return;
+
 	FCEUI_SetEmulationPaused(EMULATIONPAUSED_PAUSED); //mbg merge 7/19/06 changed to use EmulationPaused()
 
 //#ifdef WIN32
 	FCEUD_DebugBreakpoint(bp_num);
 //#endif
+
+	// the frontend may have edited the breakpoints while we were stopped here
+	UpdateBreakIndex();
 }
 
 int StackAddrBackup;
 uint16 StackNextIgnorePC = 0xFFFF;
 
+// False when no watchpoint can match this instruction, so the scan in
+// breakpoint() would find nothing.
+static bool BreakIndexMayHit(uint16 A, uint8 stackop)
+{
+	if ((breakIndex.rw[A >> 3] >> (A & 7)) & 1)
+		return true;
+	if ((breakIndex.x[_PC >> 3] >> (_PC & 7)) & 1)
+		return true;
+	if (breakIndex.ppu && (((A >= 0x2000) && (A < 0x4000)) || (A == 0x4014)))
+		return true;
+	// the stack checks also clear StackNextIgnorePC, so they must run then
+	if (breakIndex.stack && (stackop || (StackNextIgnorePC == _PC) || (X.S != StackAddrBackup)))
+		return true;
+	if (breakIndex.numRom)
+	{
+		const uint32 romAddrPC = GetNesFileAddress(_PC);
+
+		for (int i = 0; i < breakIndex.numRom; i++)
+		{
+			if (breakIndex.rom[i] == romAddrPC)
+				return true;
+		}
+	}
+	return false;
+}
+
 ///fires a breakpoint
 static void breakpoint(uint8 *opcode, uint16 A, int size) {
 	int i, romAddrPC;
@@ -698,6 +992,10 @@ static void breakpoint(uint8 *opcode, uint16 A, int size) {
 	debugLastAddress = A;
 	debugLastOpcode = opcode[0];
 
+	// the instruction reverse debugging went back to
+	if (fceuReverseDebugTarget && FCEU_ReverseDebugCycle())
+		return;
+
 	if (break_asap)
 	{
 		break_asap = false;
@@ -755,8 +1053,6 @@ static void breakpoint(uint8 *opcode, uint16 A, int size) {
 		return;
 	}
 
-	romAddrPC = GetNesFileAddress(_PC);
-
 	brk_type = opbrktype[opcode[0]] | WP_X;
 
 	switch (opcode[0]) {
@@ -775,6 +1071,13 @@ static void breakpoint(uint8 *opcode, uint16 A, int size) {
 		default: break;
 	}
 
+	if (!BreakIndexMayHit(A, stackop))
+	{
+		StackAddrBackup = X.S;
+		return;
+	}
+	romAddrPC = GetNesFileAddress(_PC);
+
 #define BREAKHIT(x) { if (CondForbidTest(x)) { breakHit = (x); goto STOPCHECKING; } }
 	int breakHit = -1;
 	for (i = 0; i < numWPs; i++)
@@ -934,13 +1237,69 @@ STOPCHECKING:
 	StackAddrBackup = X.S;
 
 	if(breakHit != -1)
+	{
+		watchpoint[breakHit].hitCount++;
 		BreakHit(i);
+	}
 
 	////Update the stack address with the current one, now that changes have registered.
 	//StackAddrBackup = X.S;
 }
 //bbit edited: this is the end of the inserted code
 
+// Same as GetMem() for the opcode fetch, loading straight from ReadPage[]
+// where the cart maps plain memory, as the CPU core does.
+static INLINE uint8 DebugFetch(uint16 A)
+{
+	uint8 *page = ReadPage[A >> 12];
+	return page ? page[A] : GetMem(A);
+}
+
+#ifndef __WIN_DRIVER__
+static bool TraceFilterPass(TraceInstructionCallback* cb, uint8* opcode, uint16 A, bool newCode)
+{
+	const TraceFilter& f = *cb->filter;
+
+	// the triggers see every instruction, whatever else leaves them out
+	if (cb->startCond || cb->stopCond)
+	{
+		debugLastAddress = A;
+		debugLastOpcode = opcode[0];
+
+		if (!cb->tracing)
+		{
+			if (cb->startCond == nullptr || !evaluate(cb->startCond))
+				return false;
+			cb->tracing = true;
+		}
+		if (cb->stopCond && evaluate(cb->stopCond))
+			cb->tracing = false;
+	}
+
+	if (f.pcEnd >= 0 && (_PC < f.pcStart || _PC > f.pcEnd))
+		return false;
+
+	if (f.bankEnd >= 0)
+	{
+		int bank = getBank(_PC);
+
+		if (bank < f.bankStart || bank > f.bankEnd)
+			return false;
+	}
+
+	if (f.skipNMI && debugNMIStack >= 0)
+		return false;
+
+	if (f.newCodeOnly && !newCode && GetPRGAddress(_PC) != -1)
+		return false;
+
+	if (f.sampleEvery > 1 && (cb->sampleCount++ % f.sampleEvery) != 0)
+		return false;
+
+	return true;
+}
+#endif
+
 void DebugCycle()
 {
 	uint8 opcode[3] = {0};
@@ -962,19 +1321,19 @@ void DebugCycle()
 		if ((_PC >= 0x3801) && (_PC <= 0x3824)) return;
 	}
 
-	opcode[0] = GetMem(_PC);
+	opcode[0] = DebugFetch(_PC);
 	size = opsize[opcode[0]];
 	switch (size)
 	{
 		default:
 		case 1: break;
 		case 2:
-			opcode[1] = GetMem(_PC + 1);
+			opcode[1] = DebugFetch(_PC + 1);
 			break;
 		case 0: // illegal instructions may have operands
 		case 3:
-			opcode[1] = GetMem(_PC + 1);
-			opcode[2] = GetMem(_PC + 2);
+			opcode[1] = DebugFetch(_PC + 1);
+			opcode[2] = DebugFetch(_PC + 2);
 			break;
 	}
 
@@ -996,9 +1355,15 @@ void DebugCycle()
 		case 8: A = opcode[1] + _Y; break;
 	}
 
-	if (numWPs || dbgstate.step || dbgstate.runline || dbgstate.stepout || watchpoint[64].flags || dbgstate.badopbreak || break_on_cycles || break_on_instructions || break_asap)
+	if (numWPs || dbgstate.step || dbgstate.runline || dbgstate.stepout || watchpoint[64].flags || dbgstate.badopbreak || break_on_cycles || break_on_instructions || break_asap || fceuReverseDebugTarget)
 		breakpoint(opcode, A, size);
 
+	// set by the NMI, the handler ends where the stack unwinds past that
+	if (debugNMIStack >= 0 && _S > debugNMIStack)
+		debugNMIStack = -1;
+
+	int prevCodeCount = codecount;
+
 	if(debug_loggingCD)
 		LogCDData(opcode, A, size);
 
@@ -1009,10 +1374,13 @@ void DebugCycle()
 	// of calling a function for every instruction when we aren't tracing.
 	if (traceInstructionCB != nullptr)
 	{
+		bool newCode = codecount != prevCodeCount;
+
 		auto* cb = traceInstructionCB;
 		while (cb != nullptr)
 		{
-			cb->func(opcode, size);
+			if (cb->filter == nullptr || TraceFilterPass(cb, opcode, A, newCode))
+				cb->func(opcode, size);
 			cb = cb->next;
 		}
 	}
@@ -1052,6 +1420,55 @@ void* FCEUI_TraceInstructionRegister( void (*func)(uint8*,int) )
 	return cb;
 }
 
+bool FCEUI_TraceInstructionSetFilter( void* handle, const TraceFilter* filter )
+{
+	TraceInstructionCallback* cb = traceInstructionCB;
+
+	while (cb != nullptr && cb != handle)
+	{
+		cb = cb->next;
+	}
+	if (cb == nullptr)
+	{
+		return false;
+	}
+
+	Condition* startCond = nullptr;
+	Condition* stopCond = nullptr;
+
+	if (filter && !filter->startCondition.empty())
+	{
+		startCond = generateCondition(filter->startCondition.c_str());
+
+		if (startCond == nullptr)
+		{
+			return false;
+		}
+	}
+	if (filter && !filter->stopCondition.empty())
+	{
+		stopCond = generateCondition(filter->stopCondition.c_str());
+
+		if (stopCond == nullptr)
+		{
+			delete startCond;
+			return false;
+		}
+	}
+
+	delete cb->filter;
+	delete cb->startCond;
+	delete cb->stopCond;
+
+	cb->filter = filter ? new TraceFilter(*filter) : nullptr;
+	cb->startCond = startCond;
+	cb->stopCond = stopCond;
+	cb->tracing = (startCond == nullptr);
+	cb->sampleCount = 0;
+
+	return true;
+}
+
 bool FCEUI_TraceInstructionUnregisterHandle( void* handle )
 {
 	TraceInstructionCallback* cb, *cb_prev, *cb_handle;
@@ -1066,7 +1483,7 @@ bool FCEUI_TraceInstructionUnregisterHandle( void* handle )
 		{	// Match we are going to remove from list and delete
 			if (cb_prev != nullptr)
 			{
-				cb_prev = cb->next;
+				cb_prev->next = cb->next;
 			}
 			else
 			{
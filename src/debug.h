@@ -1,6 +1,8 @@
 #ifndef _DEBUG_H_
 #define _DEBUG_H_
 
+#include <string>
+
 #include "conddebug.h"
 #include "git.h"
 #include "nsf.h"
@@ -57,6 +59,11 @@ typedef struct {
 	char* condText;
 	char* desc;
 
+	// times the breakpoint stopped emulation and its condition was
+	// evaluated, reset by NewBreak()
+	uint32 hitCount;
+	uint32 evalCount;
+
 } watchpointinfo;
 
 //mbg merge 7/18/06 had to make this extern
@@ -98,6 +105,7 @@ extern int iaPC;
 extern uint32 iapoffset; //mbg merge 7/18/06 changed from int
 void DebugCycle();
 bool CondForbidTest(int bp_num);
+int evaluate(Condition* c);
 void BreakHit(int bp_num);
 
 extern bool break_asap;
@@ -116,6 +124,7 @@ extern void ResetCyclesCounter();
 extern void ResetInstructionsCounter();
 extern void ResetDebugStatisticsDeltaCounters();
 extern void IncrementInstructionsCounters();
+extern bool DebugCycleNeeded();
 //-------------
 
 //internal variables that debuggers will want access to
@@ -178,4 +187,29 @@ unsigned int NewBreak(const char* name, int start, int end, unsigned int type, c
 void* FCEUI_TraceInstructionRegister( void (*func)(uint8*,int) );
 bool FCEUI_TraceInstructionUnregisterHandle( void* handle );
 
+///which instructions a trace callback is given; the rest are left out before
+///the callback is called, so a narrow trace costs little more than none
+struct TraceFilter
+{
+	int pcStart, pcEnd;          ///< CPU address range, pcEnd < 0 for any
+	int bankStart, bankEnd;      ///< ROM bank range, bankEnd < 0 for any
+	bool skipNMI;                ///< leave out the NMI handler
+	bool newCodeOnly;            ///< only code the code/data logger has just seen run for the first time (code outside of PRG ROM always passes)
+	unsigned int sampleEvery;    ///< one in this many of what passes the rest, 0 or 1 for all
+	std::string startCondition;  ///< breakpoint condition, tracing starts at the instruction it is true for
+	std::string stopCondition;   ///< and stops after the one this is true for; empty for none
+
+	TraceFilter(void)
+		: pcStart(0), pcEnd(-1), bankStart(0), bankEnd(-1), skipNMI(false), newCodeOnly(false), sampleEvery(0)
+	{
+	}
+};
+
+///filters what the callback registered as handle is given, NULL to give it everything again.
+///Fails, keeping the filter it had, when a condition does not parse.
+bool FCEUI_TraceInstructionSetFilter( void* handle, const TraceFilter* filter );
+
+///S as the NMI handler was entered, -1 outside of it
+extern int debugNMIStack;
+
 #endif
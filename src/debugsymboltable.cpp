@@ -1,6 +1,8 @@
 /// \file
 /// \brief Implements debug symbol table (from .nl files)
 
+#include <algorithm>
+
 #include "debugsymboltable.h"
 
 #include "types.h"
@@ -120,16 +122,24 @@ debugSymbolPage_t::debugSymbolPage_t(int page)
 //--------------------------------------------------------------
 debugSymbolPage_t::~debugSymbolPage_t(void)
 {
-	for (auto it=symMap.begin(); it!=symMap.end(); it++)
+	for (auto it=symList.begin(); it!=symList.end(); it++)
 	{
-		delete it->second;
+		delete *it;
 	}
 }
 //--------------------------------------------------------------
+std::vector <debugSymbol_t*>::iterator debugSymbolPage_t::findOffset( int ofs )
+{
+	return std::lower_bound( symList.begin(), symList.end(), ofs,
+			[]( debugSymbol_t *sym, int o ){ return sym->ofs < o; } );
+}
+//--------------------------------------------------------------
 int debugSymbolPage_t::addSymbol( debugSymbol_t*sym )
 {
+	auto it = findOffset( sym->offset() );
+
 	// Check if symbol already is loaded by that name or offset
-	if ( symMap.count( sym->offset() ) )
+	if ( (it != symList.end()) && ((*it)->offset() == sym->offset()) )
 	{
 		snprintf( dbgSymTblErrMsg, sizeof(dbgSymTblErrMsg), "Error: symbol offset 0x%04X already has an entry on %s page\n", sym->offset(), _pageName );
 		return -1;
@@ -140,7 +150,7 @@ int debugSymbolPage_t::addSymbol( debugSymbol_t*sym )
 		return -1;
 	}
 
-	symMap[ sym->offset() ] = sym;
+	symList.insert( it, sym );
 
 	sym->page = this;
 
@@ -155,8 +165,8 @@ int debugSymbolPage_t::addSymbol( debugSymbol_t*sym )
 //--------------------------------------------------------------
 debugSymbol_t *debugSymbolPage_t::getSymbolAtOffset( int ofs )
 {
-	auto it = symMap.find( ofs );
-	return it != symMap.end() ? it->second : nullptr;
+	auto it = findOffset( ofs );
+	return (it != symList.end()) && ((*it)->offset() == ofs) ? *it : nullptr;
 }
 //--------------------------------------------------------------
 debugSymbol_t *debugSymbolPage_t::getSymbol( const std::string &name )
@@ -167,11 +177,11 @@ debugSymbol_t *debugSymbolPage_t::getSymbol( const std::string &name )
 //--------------------------------------------------------------
 int debugSymbolPage_t::deleteSymbolAtOffset( int ofs )
 {
-	auto it = symMap.find( ofs );
+	auto it = findOffset( ofs );
 
-	if ( it != symMap.end() )
+	if ( (it != symList.end()) && ((*it)->offset() == ofs) )
 	{
-		auto sym = it->second;
+		auto sym = *it;
 
 		if ( sym->name().size() > 0 )
 		{
@@ -182,7 +192,7 @@ int debugSymbolPage_t::deleteSymbolAtOffset( int ofs )
 				symNameMap.erase(itName);
 			}
 		}
-		symMap.erase(it);
+		symList.erase(it);
 		delete sym;
 
 		return 0;
@@ -216,9 +226,9 @@ int debugSymbolPage_t::updateSymbol(debugSymbol_t *sym)
 	}
 
 	// Sanity Check
-	auto it = symMap.find( sym->offset() );
+	auto it = findOffset( sym->offset() );
 
-	if ( it == symMap.end() )
+	if ( (it == symList.end()) || ((*it)->offset() != sym->offset()) )
 	{	// This shouldn't happen
 		return -1;
 	}
@@ -229,13 +239,13 @@ int debugSymbolPage_t::save(void)
 {
 	FILE *fp;
 	debugSymbol_t *sym;
-	std::map <int, debugSymbol_t*>::iterator it;
+	std::vector <debugSymbol_t*>::iterator it;
 	const char *romFile;
 	std::string filename;
 	char stmp[512];
 	int i,j;
 
-	if ( symMap.size() == 0 )
+	if ( symList.size() == 0 )
 	{
 		//printf("Skipping Empty Debug Page Save\n");
 		return 0;
@@ -288,11 +298,11 @@ int debugSymbolPage_t::save(void)
 		return -1;
 	}
 
-	for (it=symMap.begin(); it!=symMap.end(); it++)
+	for (it=symList.begin(); it!=symList.end(); it++)
 	{
 		const char *c;
 
-		sym = it->second;
+		sym = *it;
 
 		i=0; j=0; c = sym->_comment.c_str();
 
@@ -340,15 +350,15 @@ void debugSymbolPage_t::print(void)
 {
 	FILE *fp;
 	debugSymbol_t *sym;
-	std::map <int, debugSymbol_t*>::iterator it;
+	std::vector <debugSymbol_t*>::iterator it;
 
 	fp = stdout;
 
 	fprintf( fp, "Page: %X \n", _pageNum );
 
-	for (it=symMap.begin(); it!=symMap.end(); it++)
+	for (it=symList.begin(); it!=symList.end(); it++)
 	{
-		sym = it->second;
+		sym = *it;
 
 		fprintf( fp, "   Sym: $%04X '%s' \n", sym->ofs, sym->name().c_str() );
 	}
@@ -359,6 +369,7 @@ void debugSymbolPage_t::print(void)
 debugSymbolTable_t::debugSymbolTable_t(void)
 {
 	cs = new FCEU::mutex();
+	_serial = 0;
 
 	dbgSymTblErrMsg[0] = 0;
 }
@@ -384,6 +395,7 @@ void debugSymbolTable_t::clear(void)
 		delete it->second;
 	}
 	pageMap.clear();
+	_serial++;
 }
 //--------------------------------------------------------------
 int debugSymbolTable_t::numSymbols(void)
@@ -488,6 +500,7 @@ int debugSymbolTable_t::loadFileNL( int bank )
 	page = new debugSymbolPage_t(bank);
 
 	pageMap[ page->pageNum() ] = page;
+	_serial++;
 
 	while ( fgets( line, sizeof(line), fp ) != 0 )
 	{
@@ -748,6 +761,7 @@ int debugSymbolTable_t::loadRegisterMap(void)
 	page->addSymbol( new debugSymbol_t( 0x4017, "JOY2_FRAME" ) );
 
 	pageMap[ page->pageNum() ] = page;
+	_serial++;
 
 	return 0;
 }
@@ -819,6 +833,7 @@ int debugSymbolTable_t::addSymbolAtBankOffset( int bank, int ofs, debugSymbol_t
 		page = it->second;
 	}
 	result = page->addSymbol( sym );
+	_serial++;
 
 	return result;
 }
@@ -839,6 +854,7 @@ int debugSymbolTable_t::deleteSymbolAtBankOffset( int bank, int ofs )
 	{
 		page = it->second;
 	}
+	_serial++;
 
 	return page->deleteSymbolAtOffset( ofs );
 }
@@ -851,6 +867,8 @@ int debugSymbolTable_t::updateSymbol(debugSymbol_t *sym)
 	{
 		return -1;
 	}
+	_serial++;
+
 	return sym->page->updateSymbol(sym);
 }
 //--------------------------------------------------------------
@@ -996,6 +1014,7 @@ int debugSymbolTable_t::ld65LoadDebugFile( const char *dbgFilePath )
 	FCEU::autoScopedLock alock(cs);
 
 	db.iterateSymbols( this, ld65_iterate_cb );
+	_serial++;
 
 	return 0;
 }
@@ -3,6 +3,8 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <unordered_map>
 
 #include "utils/mutex.h"
 #include "ld65dbg.h"
@@ -92,7 +94,7 @@ class debugSymbolPage_t
 
 	int  save(void);
 	void print(void);
-	int size(void){ return static_cast<int>(symMap.size()); }
+	int size(void){ return static_cast<int>(symList.size()); }
 
 	int addSymbol( debugSymbol_t *sym );
 
@@ -117,8 +119,12 @@ class debugSymbolPage_t
 	private:
 	int _pageNum;
 	char _pageName[8];
-	std::map <int, debugSymbol_t*> symMap;
-	std::map <std::string, debugSymbol_t*> symNameMap;
+	// Kept sorted by offset, the disassembly looks a symbol up for
+	// every line it shows
+	std::vector <debugSymbol_t*> symList;
+	std::unordered_map <std::string, debugSymbol_t*> symNameMap;
+
+	std::vector <debugSymbol_t*>::iterator findOffset( int ofs );
 
 	friend class debugSymbolTable_t;
 };
@@ -160,9 +166,14 @@ class debugSymbolTable_t
 
 		void ld65_SymbolLoad( ld65::sym *s );
 
+		// Changes whenever symbols are added, removed or changed, for
+		// those that keep text made from them
+		unsigned int serial(void){ return _serial; }
+
 	private:
 		std::map <int, debugSymbolPage_t*> pageMap;
 		FCEU::mutex *cs;
+		unsigned int _serial;
 };
 
 extern  debugSymbolTable_t  debugSymbolTable;
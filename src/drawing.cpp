@@ -5,6 +5,9 @@
 #include "movie.h"
 #include "driver.h"
 
+#include <string>
+#include <vector>
+
 static uint8 Font6x7[792] =
 {
 	6,  0,  0,  0,  0,  0,  0,  0,	// 0x20 - Spacebar
@@ -400,18 +403,36 @@ static int FixJoedChar(uint8 ch)
 //	return Font6x7[FixJoedChar(ch)*8];
 //}
 
-char target[64][256];
+static char target[64][256];
+
+// A string laid out with its border, as the offsets into a 256 wide screen
+// of the pixels it sets. The message, FPS and counter overlays draw the
+// same text frame after frame, so the newest strings are kept and only
+// changed text is laid out again.
+struct TextBitmap
+{
+	std::string text;
+	int border;
+	uint32 lastUse;
+	std::vector<uint16> fg;      // the glyphs
+	std::vector<uint16> shadow;  // next to them, darker over what is under
+	std::vector<uint16> faint;   // the outer edge
+};
+
+static TextBitmap textCache[16];
+static uint32 textCacheClock = 0;
+
+static void LayoutText(TextBitmap &bm, int width, uint8 *textmsg, int border)
 
-void DrawTextTransWH(uint8 *dest, int width, uint8 *textmsg, uint8 fgcolor, int max_w, int max_h, int border)
 {
 	int beginx=2, x=beginx;
 	int y=2;
 
 	memset(target, 0, 64 * 256);
 
-	assert(width==256);
-	if (max_w > 256) max_w = 256;
-	if (max_h >  64) max_h =  64;
+	bm.fg.clear();
+	bm.shadow.clear();
+	bm.faint.clear();
 
 	int ch = 0, wid = 0, nx = 0, ny = 0, max_x = x, offs = 0;
 	int pixel_color;
@@ -469,7 +490,7 @@ textoverflow:
 	if (max_y > 62)
 		max_y = 62;
 
-	// draw target buffer to screen buffer
+	// sort the pixels of the target buffer
 	for (y = 0; y < max_y; ++y)
 	{
 		for (x = 0; x < max_x; ++x)
@@ -503,22 +524,55 @@ textoverflow:
 			}
 
 			if(pixel_color >= 200)
-				dest[offs] = fgcolor;
+				bm.fg.push_back(offs);
 			else if(pixel_color >= 10)
-			{
-				if(dest[offs] < 0xA0)
-					dest[offs] = 0xC1;
-				else
-					dest[offs] = 0xD1;
-			}
+				bm.shadow.push_back(offs);
 			else if(pixel_color > 0)
-			{
-				dest[offs] = 0xCF;
-			}
+				bm.faint.push_back(offs);
+		}
+	}
+}
+
+void DrawTextTransWH(uint8 *dest, int width, uint8 *textmsg, uint8 fgcolor, int max_w, int max_h, int border)
+{
+	assert(width==256);
+	if (max_w > 256) max_w = 256;
+	if (max_h >  64) max_h =  64;
+
+	// the string if it is cached, else the least recently drawn one
+	TextBitmap *bm = &textCache[0];
+	for (int i = 0; i < (int)(sizeof(textCache) / sizeof(textCache[0])); i++)
+	{
+		TextBitmap &entry = textCache[i];
+		if (entry.border == border && entry.lastUse && entry.text == (const char *)textmsg)
+		{
+			bm = &entry;
+			break;
 		}
+		if (entry.lastUse < bm->lastUse)
+			bm = &entry;
+	}
+	if (!(bm->lastUse && bm->border == border && bm->text == (const char *)textmsg))
+	{
+		bm->text = (const char *)textmsg;
+		bm->border = border;
+		LayoutText(*bm, width, textmsg, border);
 	}
+	bm->lastUse = ++textCacheClock;
+
+	size_t i;
+	for (i = 0; i < bm->fg.size(); i++)
+		dest[bm->fg[i]] = fgcolor;
+	for (i = 0; i < bm->shadow.size(); i++)
+	{
+		uint8 &d = dest[bm->shadow[i]];
+		d = (d < 0xA0) ? 0xC1 : 0xD1;
+	}
+	for (i = 0; i < bm->faint.size(); i++)
+		dest[bm->faint[i]] = 0xCF;
 }
 
+
 void DrawTextTrans(uint8 *dest, uint32 width, uint8 *textmsg, uint8 fgcolor)
 {
 	DrawTextTransWH(dest, width, textmsg, fgcolor, 256, 16, 2);
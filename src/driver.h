@@ -62,8 +62,21 @@ void FCEUD_NetworkClose(void);
 bool FCEUI_BeginWaveRecord(const char *fn);
 int FCEUI_EndWaveRecord(void);
 
+//when a sound recording is flushed to disk: never, when it ends, or after
+//each batch the writer thread writes
+enum { FCEU_WAVE_SYNC_NONE = 0, FCEU_WAVE_SYNC_CLOSE, FCEU_WAVE_SYNC_BATCH };
+//size of the ring buffer the samples wait in and of the batches then
+//written, in KB; applies from the next recording on
+void FCEUI_SetWaveRecordBuffering(int bufferKB, int batchKB, int sync);
+
 void FCEUI_ResetNES(void);
 void FCEUI_PowerNES(void);
+//Puts the machine back the way loading the current game left it, in the time
+//it takes to restore a savestate. Battery backed memory is kept, like a power
+//cycle, and RAM gets the contents it had after the load, not a new pattern.
+//Returns false, doing nothing, for NSF, FDS and VS System games and while a
+//movie, netplay or the game genie is active; use FCEUI_PowerNES() then.
+bool FCEUI_HotPowerNES(void);
 
 void FCEUI_NTSCSELHUE(void);
 void FCEUI_NTSCSELTINT(void);
@@ -75,6 +88,14 @@ void FCEUI_SetNTSCTH(bool en, int tint, int hue);
 void FCEUI_SetInput(int port, ESI type, void *ptr, int attrib);
 void FCEUI_SetInputFC(ESIFC type, void *ptr, int attrib);
 
+//Lets the driver refresh the data given to FCEUI_SetInput right before the core takes
+//it: at the start of each frame and, in live play, once more on the game's first
+//strobe of $4016 in the frame, so gamepad buttons pressed while the frame was being
+//emulated up to then still count. Movies, the TAS Editor, netplay, VS Unisystem games
+//and run-ahead keep the one sample per frame. Runs on the emulation thread, NULL
+//turns it off.
+void FCEUI_SetInputSampler(void (*sampler)(void));
+
 //tells the emulator whether a fourscore is attached
 void FCEUI_SetInputFourscore(bool attachFourscore);
 //tells whether a fourscore is attached
@@ -97,6 +118,32 @@ void FCEUI_DisableSpriteLimitation(int a);
 void FCEUI_SetRenderPlanes(bool sprites, bool bg);
 void FCEUI_GetRenderPlanes(bool& sprites, bool& bg);
 
+//Compute-only mode for unthrottled batch runs (search bots, regression farms).
+//CPU, PPU and APU timing stay exact, but pixel post-processing, the screen overlays
+//and sound synthesis/filtering are skipped. FCEUI_Emulate returns no video or sound.
+//Devices that read the picture back (zapper) will not see anything in this mode.
+void FCEUI_SetComputeOnly(bool enable);
+bool FCEUI_GetComputeOnly(void);
+
+//Fast-forward for turbo and unthrottled play. The sound synthesis is suspended as in
+//compute-only mode, nobody can listen at that rate anyway. Frames the driver is not
+//going to show should be emulated with skip set: the HUD is not drawn on them, only
+//its frame counters move on, and no picture is handed back.
+void FCEUI_SetFastForward(bool enable);
+bool FCEUI_GetFastForward(void);
+
+//Idle loop skipping. Short loops that only wait on RAM or $2002 are detected and
+//their passes up to the next interrupt, mapper or APU event are counted instead of
+//run. The results stay cycle exact. Off by default; not used while debugging.
+void FCEUI_SetIdleSkip(bool enable);
+bool FCEUI_GetIdleSkip(void);
+
+//Decoded code cache. Instructions in PRG ROM are decoded once and run from blocks
+//without being fetched again; RAM and anything read through handlers is run as
+//before. Cycle exact. Off by default; not used while debugging.
+void FCEUI_SetCodeCache(bool enable);
+bool FCEUI_GetCodeCache(void);
+
 //name=path and file to load.  returns null if it failed
 FCEUGI *FCEUI_LoadGame(const char *name, int OverwriteVidMode, bool silent = false);
 
@@ -110,6 +157,24 @@ bool FCEUI_Initialize();
 //Emulates a frame.
 void FCEUI_Emulate(uint8 **, int32 **, int32 *, int);
 
+//Emulates a frame the user does not get to see, for tools that rebuild states ahead
+//of the visible one (TAS Editor's Greenzone lookahead). The console runs exactly as
+//in FCEUI_Emulate: movie input, periodic cheats, picture, APU and lag counter, so
+//savestates taken afterwards are identical. The frontend side is left out: no Lua
+//frame callbacks, autofire, autosave, rewind recording, capture or HUD, and the sound
+//is discarded. lagFlag tells whether the frame lagged. XBuf and XDBuf are
+//overwritten, callers that keep showing another frame must save them.
+void FCEUI_EmulateOffscreen(void);
+
+//Run-ahead hides the game's own input lag: after each frame FCEUI_Emulate runs this
+//many more with the same input, hands back the last picture and rolls the console
+//back, so sound, movie, lag counter and RAM stay with the real frame. Skipped frames,
+//movies, the TAS Editor, netplay, debugger or Lua memory hooks and wave recording
+//turn it off for as long as they last. 0 disables it.
+#define FCEU_RUNAHEAD_MAX 4
+void FCEUI_SetRunAhead(int frames);
+int FCEUI_GetRunAhead(void);
+
 //Closes currently loaded game
 void FCEUI_CloseGame(void);
 
@@ -286,6 +351,8 @@ void FCEUD_OnCloseGame(void);
 
 void FCEUI_FrameAdvance(void);
 void FCEUI_FrameAdvanceEnd(void);
+//true while the frame advance key is held
+bool FCEUI_FrameAdvanceRequested(void);
 
 //AVI Output
 int FCEUI_AviBegin(const char* fname);
@@ -58,6 +58,7 @@
 extern "C"
 {
 #include "libavutil/opt.h"
+#include "libavutil/hwcontext.h"
 #include "libavutil/pixdesc.h"
 #include "libavformat/avformat.h"
 #include "libavcodec/avcodec.h"
@@ -87,6 +88,14 @@ static std::atomic<int> abufHead(0);
 static std::atomic<int> abufTail(0);
 static constexpr int    abufSize = 256 * 1024;
 static uint32_t *rawVideoBuf = NULL;
+// Frame accounting for the video ring. The producer waits, or drops the frame
+// when aviDropFrames is set, once vbufMaxFrames frames are waiting for the
+// disk thread.
+static std::atomic<unsigned int> vframesQueued(0);
+static std::atomic<unsigned int> vframesEncoded(0);
+static std::atomic<unsigned int> vframesDropped(0);
+static int       vbufMaxFrames = 0;
+static bool      aviDropFrames = false;
 static int16_t  *rawAudioBuf = NULL;
 static int       aviDriver = 0;
 static int       videoFormat = AVI_RGB24;
@@ -775,6 +784,8 @@ struct OutputStream
 	AVPacket *pkt;
 	struct SwsContext *sws_ctx;
 	struct SwrContext *swr_ctx;
+	AVFrame *hw_frame;
+	AVBufferRef *hwDevice;
 	int64_t next_pts;
 	int      bytesPerSample;
 	int      frameSize;
@@ -784,6 +795,9 @@ struct OutputStream
 	int      chanLayout;
 	bool     isAudio;
 	bool     writeError;
+	bool     hwEncoder;
+	uint64_t framesEncoded;
+	double   encodeCpu;
 	std::string selEnc;
 
 	OutputStream(void)
@@ -794,10 +808,15 @@ struct OutputStream
 		pkt = NULL;
 		sws_ctx = NULL;
 		swr_ctx = NULL;
+		hw_frame = NULL;
+		hwDevice = NULL;
 		bytesPerSample = 0;
 		frameSize = 0;
 		next_pts = 0;
 		writeError = false;
+		hwEncoder = false;
+		framesEncoded = 0;
+		encodeCpu = 0.0;
 		isAudio = false;
 		pixelFormat = -1;
 		sampleFormat = -1;
@@ -814,6 +833,23 @@ struct OutputStream
 				       isAudio ? "Audio" : "Video", AV_LOG_FILE_NAME);
 			FCEUD_PrintError(msg);
 		}
+		closeEncoder();
+
+		if ( swr_ctx != NULL )
+		{
+			swr_free(&swr_ctx); swr_ctx = NULL;
+		}
+		st = NULL;
+		writeError = false;
+		bytesPerSample = 0;
+		next_pts = 0;
+		framesEncoded = 0;
+		encodeCpu = 0.0;
+	}
+
+	/* Frees what opening an encoder allocates, so that another can be tried. */
+	void closeEncoder(void)
+	{
 		if ( enc != NULL )
 		{
 			avcodec_free_context(&enc); enc = NULL;
@@ -830,22 +866,26 @@ struct OutputStream
 		{
 			av_frame_free(&tmp_frame); tmp_frame = NULL;
 		}
+		if ( hw_frame != NULL )
+		{
+			av_frame_free(&hw_frame); hw_frame = NULL;
+		}
 		if ( sws_ctx != NULL )
 		{
 			sws_freeContext(sws_ctx); sws_ctx = NULL;
 		}
-		if ( swr_ctx != NULL )
+		if ( hwDevice != NULL )
 		{
-			swr_free(&swr_ctx); swr_ctx = NULL;
+			av_buffer_unref(&hwDevice); hwDevice = NULL;
 		}
-		st = NULL;
-		writeError = false;
-		bytesPerSample = 0;
-		next_pts = 0;
+		hwEncoder = false;
 	}
 };
 static  OutputStream  video_st;
 static  OutputStream  audio_st;
+static  bool          hwVideoEncode = false;
+static  std::string   hwVideoDevice;
+static  double        recordCpuStart = 0.0;
 
 static void log_callback( void *avcl, int level, const char *fmt, va_list vl)
 {
@@ -1107,38 +1147,101 @@ static AVFrame *alloc_picture(enum AVPixelFormat pix_fmt, int width, int height)
 	return picture;
 }
 
-static int initVideoStream( const char *codec_name, OutputStream *ost )
+static bool isHwPixelFormat( enum AVPixelFormat fmt )
 {
-	int ret;
-	const AVCodec *codec;
-	AVCodecContext *c;
-	double fps;
-	int fps1000;
-	unsigned int usec;
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
 
-	fps = getBaseFrameRate();
+	return (desc != NULL) && (desc->flags & AV_PIX_FMT_FLAG_HWACCEL);
+}
 
-	usec = (unsigned int)((1.0e6 / fps)+0.50);
+static bool isHwEncoder( const AVCodec *codec )
+{
+	return (codec->capabilities & (AV_CODEC_CAP_HARDWARE | AV_CODEC_CAP_HYBRID)) != 0;
+}
 
-	fps1000 = (int)(fps * 1000.0);
+/* Encoders that only take frames in video memory (the VAAPI ones, say)
+ * need a device and a pool of its frames to upload each picture to. */
+static int initHwFrames( const AVCodec *codec, OutputStream *ost, enum AVPixelFormat swFormat )
+{
+	int i, ret;
+	const AVCodecHWConfig *cfg;
+	AVCodecContext *c = ost->enc;
+	AVBufferRef *framesRef;
+	AVHWFramesContext *frames;
 
-	/* find the video encoder */
-	codec = avcodec_find_encoder_by_name(codec_name);
+	for (i=0; (cfg = avcodec_get_hw_config(codec, i)) != NULL; i++)
+	{
+		if ( cfg->methods & AV_CODEC_HW_CONFIG_METHOD_HW_FRAMES_CTX )
+		{
+			break;
+		}
+	}
+	if ( cfg == NULL )
+	{
+		fprintf( avLogFp, "Error: Video codec %s takes no hardware frames\n", codec->name);
+		return -1;
+	}
 
-	if (codec == NULL)
+	ret = av_hwdevice_ctx_create( &ost->hwDevice, cfg->device_type,
+			hwVideoDevice.size() ? hwVideoDevice.c_str() : NULL, NULL, 0 );
+
+	if ( ret < 0 )
 	{
-		fprintf( avLogFp, "Video codec not found: %s\n", codec_name);
+		fprintf( avLogFp, "Error: Could not open %s device for video codec %s\n",
+				av_hwdevice_get_type_name(cfg->device_type), codec->name);
 		return -1;
 	}
-	//printf("CODEC: %s\n", codec->name );
 
-	ost->st = avformat_new_stream(oc, NULL);
+	framesRef = av_hwframe_ctx_alloc( ost->hwDevice );
 
-	if (ost->st == NULL)
+	if ( framesRef == NULL )
 	{
-		fprintf( avLogFp, "Error: Could not alloc video stream\n");
+		fprintf( avLogFp, "Error: Could not alloc hardware frames for video codec %s\n", codec->name);
 		return -1;
 	}
+	frames = (AVHWFramesContext*)framesRef->data;
+	frames->format    = cfg->pix_fmt;
+	frames->sw_format = swFormat;
+	frames->width     = c->width;
+	frames->height    = c->height;
+	frames->initial_pool_size = 20;
+
+	ret = av_hwframe_ctx_init( framesRef );
+
+	if ( ret < 0 )
+	{
+		fprintf( avLogFp, "Error: Could not init hardware frames for video codec %s\n", codec->name);
+		av_buffer_unref( &framesRef );
+		return -1;
+	}
+	/* The codec context owns the frames reference from here on. */
+	c->pix_fmt       = cfg->pix_fmt;
+	c->hw_frames_ctx = framesRef;
+
+	ost->hw_frame = av_frame_alloc();
+
+	if ( ost->hw_frame == NULL )
+	{
+		fprintf( avLogFp, "Error: Could not alloc hardware frame\n");
+		return -1;
+	}
+	return 0;
+}
+
+static int openVideoEncoder( const AVCodec *codec, OutputStream *ost )
+{
+	AVCodecContext *c;
+	enum AVPixelFormat swFormat;
+	std::vector <enum AVPixelFormat> swFormats;
+	double fps;
+	int fps1000;
+	unsigned int usec;
+
+	fps = getBaseFrameRate();
+
+	usec = (unsigned int)((1.0e6 / fps)+0.50);
+
+	fps1000 = (int)(fps * 1000.0);
 
 	c = avcodec_alloc_context3(codec);
 
@@ -1151,7 +1254,11 @@ static int initVideoStream( const char *codec_name, OutputStream *ost )
 	c->bit_rate = 400000;
 	c->gop_size = 12; /* emit one intra frame every twelve frames at most */
 
-	loadCodecConfig( 0, codec_name, c );
+	/* Let the codec pick its own thread count, saved codec options can override this. */
+	c->thread_count = 0;
+	c->thread_type  = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+	loadCodecConfig( 0, codec->name, c );
 
 	ost->enc = c;
 
@@ -1189,18 +1296,32 @@ static int initVideoStream( const char *codec_name, OutputStream *ost )
 	//printf("TAG:0x%08X\n", c->codec_tag);
 
 	if ( codec->pix_fmts )
+	{
+		// Frames are converted in system memory, leave the formats
+		// of hardware surfaces out.
+		for (int i=0; codec->pix_fmts[i] != AV_PIX_FMT_NONE; i++)
+		{
+			if ( !isHwPixelFormat( codec->pix_fmts[i] ) )
+			{
+				swFormats.push_back( codec->pix_fmts[i] );
+			}
+		}
+		swFormats.push_back( AV_PIX_FMT_NONE );
+	}
+
+	if ( swFormats.size() > 1 )
 	{
 		if ( ost->pixelFormat == -1 )
 		{
 			// Auto select least lossy format to comvert to.
-			c->pix_fmt = avcodec_find_best_pix_fmt_of_list( codec->pix_fmts, AV_PIX_FMT_BGRA, 0, NULL);
+			c->pix_fmt = avcodec_find_best_pix_fmt_of_list( swFormats.data(), AV_PIX_FMT_BGRA, 0, NULL);
 		}
 
 		int i=0, formatOk=0;
-		while (codec->pix_fmts[i] != -1)
+		while (swFormats[i] != -1)
 		{
-			//printf("Codec PIX_FMT: %i\n", codec->pix_fmts[i]);
-			if ( codec->pix_fmts[i] == c->pix_fmt )
+			//printf("Codec PIX_FMT: %i\n", swFormats[i]);
+			if ( swFormats[i] == c->pix_fmt )
 			{
 				printf("CODEC Supports PIX_FMT:%i\n", c->pix_fmt );
 				formatOk = 1;
@@ -1211,11 +1332,17 @@ static int initVideoStream( const char *codec_name, OutputStream *ost )
 		{
 			printf("CODEC Does Not Support PIX_FMT:%i\n", c->pix_fmt);
 
-			c->pix_fmt = avcodec_find_best_pix_fmt_of_list( codec->pix_fmts, AV_PIX_FMT_BGRA, 0, NULL);
+			c->pix_fmt = avcodec_find_best_pix_fmt_of_list( swFormats.data(), AV_PIX_FMT_BGRA, 0, NULL);
 
 			printf("Changing to:%i\n", c->pix_fmt);
 		}
 	}
+	else if ( codec->pix_fmts )
+	{
+		// Hardware surfaces only, the frames are uploaded as NV12,
+		// which all of these encoders take.
+		c->pix_fmt = AV_PIX_FMT_NV12;
+	}
 	else
 	{
 		if ( ost->pixelFormat == -1 )
@@ -1223,6 +1350,15 @@ static int initVideoStream( const char *codec_name, OutputStream *ost )
 			c->pix_fmt = AV_PIX_FMT_YUV420P; // Every video encoder seems to accept this
 		}
 	}
+	swFormat = c->pix_fmt;
+
+	if ( codec->pix_fmts && (swFormats.size() <= 1) )
+	{
+		if ( initHwFrames( codec, ost, swFormat ) )
+		{
+			return -1;
+		}
+	}
 
 	//printf("PIX_FMT:%i\n", c->pix_fmt );
 
@@ -1247,7 +1383,7 @@ static int initVideoStream( const char *codec_name, OutputStream *ost )
 	/* open the codec */
 	if (avcodec_open2(c, NULL, NULL) < 0)
 	{
-		fprintf( avLogFp, "Error: Could not open codec: %s\n", codec_name);
+		fprintf( avLogFp, "Error: Could not open codec: %s\n", codec->name);
 		return -1;
 	}
 
@@ -1259,8 +1395,9 @@ static int initVideoStream( const char *codec_name, OutputStream *ost )
 	    return -1;
 	}
 
-	/* Allocate the encoded raw picture. */
-	ost->frame = alloc_picture(c->pix_fmt, c->width, c->height);
+	/* Allocate the encoded raw picture, in system memory; for hardware
+	 * frames it is uploaded to hw_frame before encoding. */
+	ost->frame = alloc_picture(swFormat, c->width, c->height);
 
 	if (!ost->frame)
 	{
@@ -1282,7 +1419,7 @@ static int initVideoStream( const char *codec_name, OutputStream *ost )
 	ost->sws_ctx = sws_getContext(c->width, c->height,
 					AV_PIX_FMT_BGRA,
 					c->width, c->height,
-					c->pix_fmt,
+					swFormat,
 					SWS_BICUBIC, NULL, NULL, NULL);
 
 	if ( ost->sws_ctx == NULL )
@@ -1290,9 +1427,92 @@ static int initVideoStream( const char *codec_name, OutputStream *ost )
 		fprintf( avLogFp, "Error: Video sws_getContext Failed. Video conversion not possible\n");
 		return -1;
 	}
+	ost->hwEncoder = isHwEncoder(codec);
+
+	return 0;
+}
+
+/* With SDL.AviFFmpegHwEncode set, the hardware encoders (NVENC, VAAPI,
+ * VideoToolbox, QSV, ...) of the selected codec are tried first, and the
+ * first one that opens is used. When none does, or the selected encoder is
+ * itself a hardware one that will not open, a software encoder of the same
+ * codec is used instead. */
+static int initVideoStream( const char *codec_name, OutputStream *ost )
+{
+	int ret;
+	const AVCodec *codec, *alt;
+	void *it;
+
+	/* find the video encoder */
+	codec = avcodec_find_encoder_by_name(codec_name);
+
+	if (codec == NULL)
+	{
+		fprintf( avLogFp, "Video codec not found: %s\n", codec_name);
+		return -1;
+	}
+	//printf("CODEC: %s\n", codec->name );
+
+	ost->st = avformat_new_stream(oc, NULL);
+
+	if (ost->st == NULL)
+	{
+		fprintf( avLogFp, "Error: Could not alloc video stream\n");
+		return -1;
+	}
+
+	if ( hwVideoEncode && !isHwEncoder(codec) )
+	{
+		it = NULL;
+
+		while ( (alt = av_codec_iterate( &it )) != NULL )
+		{
+			if ( !av_codec_is_encoder(alt) || (alt->id != codec->id) || !isHwEncoder(alt) )
+			{
+				continue;
+			}
+			if ( openVideoEncoder( alt, ost ) == 0 )
+			{
+				break;
+			}
+			fprintf( avLogFp, "Hardware video codec %s could not be opened, trying the next one\n", alt->name);
+			ost->closeEncoder();
+		}
+	}
+
+	if ( (ost->enc == NULL) && openVideoEncoder( codec, ost ) )
+	{
+		ost->closeEncoder();
+
+		if ( isHwEncoder(codec) )
+		{
+			it = NULL;
+
+			while ( (alt = av_codec_iterate( &it )) != NULL )
+			{
+				if ( !av_codec_is_encoder(alt) || (alt->id != codec->id) || isHwEncoder(alt) )
+				{
+					continue;
+				}
+				fprintf( avLogFp, "Falling back to software video codec %s\n", alt->name);
+
+				if ( openVideoEncoder( alt, ost ) == 0 )
+				{
+					break;
+				}
+				ost->closeEncoder();
+			}
+		}
+	}
+
+	if ( ost->enc == NULL )
+	{
+		return -1;
+	}
+	printf("AVI Video Encoder: %s (%s)\n", ost->enc->codec->name, ost->hwEncoder ? "hardware" : "software");
 
 	/* copy the stream parameters to the muxer */
-	ret = avcodec_parameters_from_context(ost->st->codecpar, c);
+	ret = avcodec_parameters_from_context(ost->st->codecpar, ost->enc);
 
 	if (ret < 0)
 	{
@@ -1691,6 +1911,11 @@ static int setCodecFromConfig(void)
 	g_config->getOption("SDL.AviFFmpegAudioSmpRate"   , &audio_st.sampleRate);	
 	g_config->getOption("SDL.AviFFmpegAudioChanLayout", &audio_st.chanLayout);	
 
+	int hw = 0;
+	g_config->getOption("SDL.AviFFmpegHwEncode", &hw);
+	g_config->getOption("SDL.AviFFmpegHwDevice", &hwVideoDevice);
+	hwVideoEncode = (hw != 0);
+
 	return 0;
 }
 
@@ -1735,6 +1960,8 @@ static int initMedia( const char *filename )
 
 	setCodecFromConfig();
 
+	recordCpuStart = fceu_process_cpu_seconds();
+
 	if ( initVideoStream( video_st.selEnc.c_str(), &video_st ) )
 	{
 		fprintf( avLogFp, "Video Stream Init Failed\n");
@@ -1991,12 +2218,16 @@ static int encode_video_frame( unsigned char *inBuf )
 	int ret, y, ofs, inLineSize;
 	OutputStream *ost = &video_st;
 	AVCodecContext *c = video_st.enc;
+	AVFrame *inFrame;
 	unsigned char *outBuf;
+	double cpuStart;
 
 	if ( ost->writeError )
 	{
 		return -1;
 	}
+	cpuStart = fceu_thread_cpu_seconds();
+
 	ret = av_frame_make_writable( video_st.frame );
 
 	if ( ret < 0 )
@@ -2022,9 +2253,32 @@ static int encode_video_frame( unsigned char *inBuf )
 			ost->frame->linesize);
 
 	video_st.frame->pts = video_st.next_pts++;
+
+	inFrame = video_st.frame;
+
+	if ( ost->hw_frame != NULL )
+	{
+		av_frame_unref( ost->hw_frame );
+
+		ret = av_hwframe_get_buffer( c->hw_frames_ctx, ost->hw_frame, 0 );
+
+		if ( ret >= 0 )
+		{
+			ret = av_hwframe_transfer_data( ost->hw_frame, video_st.frame, 0 );
+		}
+		if ( ret < 0 )
+		{
+			fprintf( avLogFp, "Error uploading a video frame to the hardware encoder\n");
+			ost->writeError = true;
+			return -1;
+		}
+		ost->hw_frame->pts = video_st.frame->pts;
+
+		inFrame = ost->hw_frame;
+	}
 	
 	/* encode the image */
-	ret = avcodec_send_frame(c, video_st.frame);
+	ret = avcodec_send_frame(c, inFrame);
 	if (ret < 0)
 	{
 		fprintf( avLogFp, "Error submitting a video frame for encoding\n");
@@ -2063,9 +2317,43 @@ static int encode_video_frame( unsigned char *inBuf )
 		}
 	}
 
+	if ( cpuStart >= 0.0 )
+	{
+		ost->encodeCpu += fceu_thread_cpu_seconds() - cpuStart;
+	}
+	ost->framesEncoded++;
+
 	return ret == AVERROR_EOF;
 }
 
+/* The CPU the recording took: on the thread that converts and submits the
+ * frames (the encoder's own threads are not in it), and for the whole
+ * process, emulation included, since the file was opened. */
+static void reportCpuUse(void)
+{
+	char msg[512];
+	double procCpu, frames;
+
+	if ( (video_st.enc == NULL) || (video_st.framesEncoded == 0) )
+	{
+		return;
+	}
+	frames  = (double)video_st.framesEncoded;
+	procCpu = fceu_process_cpu_seconds() - recordCpuStart;
+
+	snprintf( msg, sizeof(msg), "AVI Video Encoder %s (%s): %llu frames, %.3f ms CPU per frame on the recording thread, %.3f ms per frame for the process\n",
+			video_st.enc->codec->name, video_st.hwEncoder ? "hardware" : "software",
+			(unsigned long long)video_st.framesEncoded,
+			(video_st.encodeCpu * 1000.0) / frames, (procCpu * 1000.0) / frames );
+
+	printf( "%s", msg );
+
+	if ( avLogFp != NULL )
+	{
+		fputs( msg, avLogFp );
+	}
+}
+
 static int close(void)
 {
 	encode_audio_frame( NULL, 0 );
@@ -2076,6 +2364,8 @@ static int close(void)
 	 * av_codec_close(). */
 	av_write_trailer(oc);
 
+	reportCpuUse();
+
 	video_st.close();
 	audio_st.close();
 
@@ -2163,6 +2453,8 @@ int aviRecordOpenFile( const char *filepath )
 		return -1;
 	}
 	g_config->getOption("SDL.AviRecordAudio", &recordAudio);
+	g_config->getOption("SDL.AviDropFrames", &aviDropFrames);
+	g_config->getOption("SDL.AviQueueFrames", &vbufMaxFrames);
 
 	if ( filepath != NULL )
 	{
@@ -2350,6 +2642,17 @@ int aviRecordOpenFile( const char *filepath )
 	abufHead = 0;
 	abufTail = 0;
 
+	// Keep one frame of slack so a full ring never looks empty
+	int ringFrames = (vbufSize / (nes_shm->video.ncol * nes_shm->video.nrow)) - 1;
+
+	if ( (vbufMaxFrames <= 0) || (vbufMaxFrames > ringFrames) )
+	{
+		vbufMaxFrames = ringFrames;
+	}
+	vframesQueued  = 0;
+	vframesEncoded = 0;
+	vframesDropped = 0;
+
 	recordEnable = true;
 	return 0;
 }
@@ -2366,40 +2669,45 @@ int aviRecordAddFrame( void )
 		return 0;
 	}
 
-	int i, head, numPixels, availSize;
+	int head, numPixels, run;
 
 	numPixels  = nes_shm->video.ncol * nes_shm->video.nrow;
 
 	head = vbufHead;
 
-	auto calcAvailSize = [&]()
+	auto queueFull = [&]()
 	{
-		availSize = (vbufTail - head);
-		if ( availSize <= 0 )
-		{
-			availSize += vbufSize;
-		}
+		return (int)(vframesQueued - vframesEncoded) >= vbufMaxFrames;
 	};
 
-	calcAvailSize();
-
-	while ( numPixels > availSize )
+	if ( queueFull() )
 	{
-		//printf("Video Unavail %i \n", availSize );
-		msleep(1);
+		if ( aviDropFrames )
+		{
+			// The encoder is behind, keep the emulator at speed and lose this frame
+			vframesDropped++;
+			return 0;
+		}
 
-		calcAvailSize();
+		while ( queueFull() && recordEnable )
+		{
+			//printf("Video Unavail\n");
+			msleep(1);
+		}
 	}
 
-	i = 0;
+	// Copy in at most two runs, the second one after the ring wraps
+	run = vbufSize - head;
 
-	while ( i < numPixels )
+	if ( run > numPixels )
 	{
-		rawVideoBuf[ head ] = nes_shm->avibuf[i]; i++;
-
-		head = (head + 1) % vbufSize;
+		run = numPixels;
 	}
-	vbufHead = head;
+	memcpy( &rawVideoBuf[ head ], nes_shm->avibuf, run * sizeof(uint32_t) );
+	memcpy( &rawVideoBuf[ 0 ], &nes_shm->avibuf[ run ], (numPixels - run) * sizeof(uint32_t) );
+
+	vbufHead = (head + numPixels) % vbufSize;
+	vframesQueued++;
 
 	return 0;
 }
@@ -2462,6 +2770,30 @@ int aviRecordClose(void)
 	return 0;
 }
 //**************************************************************************************
+void aviRecordGetQueueStats( int *queued, int *dropped )
+{
+	if ( queued != NULL )
+	{
+		*queued = (int)(vframesQueued - vframesEncoded);
+	}
+	if ( dropped != NULL )
+	{
+		*dropped = (int)vframesDropped;
+	}
+}
+//**************************************************************************************
+bool aviGetDropFramesEnable(void)
+{
+	return aviDropFrames;
+}
+//**************************************************************************************
+void aviSetDropFramesEnable(bool val)
+{
+	aviDropFrames = val;
+
+	g_config->setOption("SDL.AviDropFrames", val);
+}
+//**************************************************************************************
 bool aviGetAudioEnable(void)
 {
 	return recordAudio;
@@ -2626,6 +2958,10 @@ void AviRecordDiskThread_t::run(void)
 
 	setPriority( QThread::HighestPriority );
 
+	// The x264/x265 encoder threads started below inherit it. libav opened its
+	// codec threads with the file, on the thread that started the recording.
+	fceuWrapperSetThreadAffinity( "SDL.AviThreadCpus" );
+
 	fps = getBaseFrameRate();
 
 	avgAudioPerFrame = ( audioSampleRate / fps) + 1;
@@ -2688,7 +3024,7 @@ void AviRecordDiskThread_t::run(void)
 #endif
 
 	audioOut = (int16_t *)malloc(96000);
-	videoOut = (uint32_t*)malloc(1048576);
+	videoOut = (uint32_t*)malloc( numPixels * sizeof(uint32_t) );
 
 	// Main Disk Record Loop
 	while ( !isInterruptionRequested() )
@@ -2699,11 +3035,19 @@ void AviRecordDiskThread_t::run(void)
 			int vhead = vbufHead;
 			int vtail = vbufTail;
 
+			// Copy contiguous runs up to where the ring wraps
 			while ( (numPixelsReady < numPixels) && (vtail != vhead) )
 			{
-				videoOut[ numPixelsReady ] = rawVideoBuf[ vtail ]; numPixelsReady++;
+				int run = ((vhead > vtail) ? vhead : vbufSize) - vtail;
 
-				vtail = (vtail + 1) % vbufSize;
+				if ( run > (numPixels - numPixelsReady) )
+				{
+					run = numPixels - numPixelsReady;
+				}
+				memcpy( &videoOut[ numPixelsReady ], &rawVideoBuf[ vtail ], run * sizeof(uint32_t) );
+
+				numPixelsReady += run;
+				vtail = (vtail + run) % vbufSize;
 			}
 			vbufTail = vtail;
 		}
@@ -2758,6 +3102,7 @@ void AviRecordDiskThread_t::run(void)
 			}
 
 			numPixelsReady = 0;
+			vframesEncoded++;
 
 			// Get current buffer index values from atomic variables and store in stack variables
 			// Do loop processing with stack variables and then update atomics when finished
@@ -2950,6 +3295,10 @@ LibavOptionsPage::LibavOptionsPage(QWidget *parent)
 	grid->addWidget( videoPixfmt, 1, 1);
 	videoConfBtn = new QPushButton( tr("Options...") );
 	grid->addWidget( videoConfBtn, 2, 1);
+	videoHwEnc = new QCheckBox( tr("Use Hardware Encoder When Available") );
+	videoHwEnc->setChecked( LIBAV::hwVideoEncode );
+	videoHwEnc->setToolTip( tr("Try the NVENC, VAAPI, VideoToolbox or QSV encoder of the selected codec first, falling back to it when none opens") );
+	grid->addWidget( videoHwEnc, 3, 0, 1, 2);
 
 	vbox = new QVBoxLayout();
 	audioGbox->setLayout(vbox);
@@ -2984,6 +3333,7 @@ LibavOptionsPage::LibavOptionsPage(QWidget *parent)
 	connect(audioChanLayout, SIGNAL(currentIndexChanged(int)), this, SLOT(audioChannelLayoutChanged(int)));
 
 	connect(videoConfBtn, SIGNAL(clicked(void)), this, SLOT(openVideoCodecOptions(void)));
+	connect(videoHwEnc  , SIGNAL(toggled(bool)), this, SLOT(videoHwEncoderChanged(bool)));
 	connect(audioConfBtn, SIGNAL(clicked(void)), this, SLOT(openAudioCodecOptions(void)));
 
 	//connect(audioGbox, SIGNAL(clicked(bool)), this, SLOT(includeAudioChanged(bool)));
@@ -3356,6 +3706,13 @@ void LibavOptionsPage::videoPixelFormatChanged(int idx)
 	g_config->setOption("SDL.AviFFmpegVideoPixFmt", LIBAV::video_st.pixelFormat);	
 }
 //-----------------------------------------------------
+void LibavOptionsPage::videoHwEncoderChanged(bool checked)
+{
+	LIBAV::hwVideoEncode = checked;
+
+	g_config->setOption("SDL.AviFFmpegHwEncode", checked);	
+}
+//-----------------------------------------------------
 void LibavOptionsPage::audioSampleFormatChanged(int idx)
 {
 	LIBAV::audio_st.sampleFormat = audioSamplefmt->itemData(idx).toInt();
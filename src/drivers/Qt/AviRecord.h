@@ -63,6 +63,12 @@ int aviRecordClose(void);
 
 bool aviRecordRunning(void);
 
+void aviRecordGetQueueStats( int *queued, int *dropped );
+
+bool aviGetDropFramesEnable(void);
+
+void aviSetDropFramesEnable(bool val);
+
 bool aviGetAudioEnable(void);
 
 void aviSetAudioEnable(bool val);
@@ -192,6 +198,7 @@ class  LibavOptionsPage : public QWidget
 		QComboBox  *audioSamplefmt;
 		QComboBox  *audioSampleRate;
 		QComboBox  *audioChanLayout;
+		QCheckBox  *videoHwEnc;
 		QGroupBox  *videoGbox;
 		QGroupBox  *audioGbox;
 		QTimer     *updateTimer;
@@ -210,6 +217,7 @@ class  LibavOptionsPage : public QWidget
 		void videoCodecChanged(int idx);
 		void audioCodecChanged(int idx);
 		void videoPixelFormatChanged(int idx);
+		void videoHwEncoderChanged(bool checked);
 		void audioSampleFormatChanged(int idx);
 		void audioSampleRateChanged(int idx);
 		void audioChannelLayoutChanged(int idx);
@@ -71,963 +71,901 @@ static const char *riff_info_conv[] = {
      NULL , NULL        ,
 };
 //----------------------------------------------------------------------------
-static int riffWalkCallback( int type, long long int fpos, const char *fourcc, size_t size, void *userData )
+enum riffFieldKind
 {
-	int ret = 0;
+	FIELD_FCC,   // four characters
+	FIELD_CODE,  // four characters when printable, else hex
+	FIELD_U32,
+	FIELD_X32,
+	FIELD_I32,
+	FIELD_U16,
+};
 
-	if ( userData )
-	{
-		ret = static_cast <AviRiffViewerDialog*>(userData)->riffWalkCallback( type, fpos, fourcc, size );
-	}
-	return ret;
-}
-//----------------------------------------------------------------------------
-//--- AVI RIFF Viewer Dialog
-//----------------------------------------------------------------------------
-AviRiffViewerDialog::AviRiffViewerDialog(QWidget *parent)
-	: QDialog(parent)
+// offsets count from the chunk header, as the old tree showed them
+struct riffField
 {
-	QMenuBar    *menuBar;
-	QVBoxLayout *mainLayout;
-	QHBoxLayout *hbox;
-	QPushButton *closeButton;
-	QTreeWidgetItem *item;
-
-	avi = NULL;
-	lastChunk = NULL;
-	riffSize = 0;
-	progressDialog = NULL;
-	memset( strhType, 0, sizeof(strhType) );
-
-	setWindowTitle("AVI RIFF Viewer");
-
-	resize(512, 512);
-
-	menuBar = buildMenuBar();
-	mainLayout = new QVBoxLayout();
-	setLayout(mainLayout);
-	mainLayout->setMenuBar( menuBar );
-
-	tabs     = new QTabWidget();
-	riffTree = new AviRiffTree();
-
-	tabs->addTab( riffTree, tr("RIFF TREE") );
-
-	riffTree->setColumnCount(4);
-	riffTree->setSelectionMode( QAbstractItemView::SingleSelection );
-	riffTree->setAlternatingRowColors(true);
-
-	item = new QTreeWidgetItem();
-	item->setText(0, QString::fromStdString("Block"));
-	item->setText(1, QString::fromStdString("FCC"));
-	item->setText(2, QString::fromStdString("Size"));
-	item->setText(3, QString::fromStdString("FilePos"));
-	item->setTextAlignment(0, Qt::AlignLeft);
-	item->setTextAlignment(1, Qt::AlignLeft);
-	item->setTextAlignment(2, Qt::AlignLeft);
-	item->setTextAlignment(3, Qt::AlignLeft);
-
-	riffTree->setHeaderItem(item);
-
-	riffTree->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+	int         ofs;
+	int         kind;
+	const char *name;
+};
 
-	//connect( riffTree, SIGNAL(itemActivated(QTreeWidgetItem*,int)), this, SLOT(hotKeyActivated(QTreeWidgetItem*,int) ) );
+static const riffField avihFields[] =
+{
+	{  0, FIELD_FCC , "fcc" },
+	{  4, FIELD_U32 , "cb" },
+	{  8, FIELD_U32 , "dwMicroSecPerFrame" },
+	{ 12, FIELD_U32 , "dwMaxBytesPerSec" },
+	{ 16, FIELD_U32 , "dwPaddingGranularity" },
+	{ 20, FIELD_X32 , "dwFlags" },
+	{ 24, FIELD_U32 , "dwTotalFrames" },
+	{ 28, FIELD_U32 , "dwInitialFrames" },
+	{ 32, FIELD_U32 , "dwStreams" },
+	{ 36, FIELD_U32 , "dwSuggestedBufferSize" },
+	{ 40, FIELD_U32 , "dwWidth" },
+	{ 44, FIELD_U32 , "dwHeight" },
+	{ 48, FIELD_U32 , "dwScale" },
+	{ 52, FIELD_U32 , "dwRate" },
+	{ 56, FIELD_U32 , "dwStart" },
+	{ 60, FIELD_U32 , "dwLength" },
+	{ -1, 0, NULL }
+};
 
-	mainLayout->addWidget(tabs);
+static const riffField strhFields[] =
+{
+	{  0, FIELD_FCC , "fcc" },
+	{  4, FIELD_U32 , "cb" },
+	{  8, FIELD_FCC , "fccType" },
+	{ 12, FIELD_CODE, "fccHandler" },
+	{ 16, FIELD_X32 , "dwFlags" },
+	{ 20, FIELD_U16 , "wPriority" },
+	{ 22, FIELD_U16 , "wLanguage" },
+	{ 24, FIELD_U32 , "dwInitialFrames" },
+	{ 28, FIELD_U32 , "dwScale" },
+	{ 32, FIELD_U32 , "dwRate" },
+	{ 36, FIELD_U32 , "dwStart" },
+	{ 40, FIELD_U32 , "dwLength" },
+	{ 44, FIELD_U32 , "dwSuggestedBufferSize" },
+	{ 48, FIELD_I32 , "dwQuality" },
+	{ 52, FIELD_U32 , "dwSampleSize" },
+	{ 56, FIELD_U16 , "rcFrame.left" },
+	{ 58, FIELD_U16 , "rcFrame.top" },
+	{ 60, FIELD_U16 , "rcFrame.right" },
+	{ 62, FIELD_U16 , "rcFrame.bottom" },
+	{ -1, 0, NULL }
+};
 
-	closeButton = new QPushButton( tr("Close") );
-	closeButton->setIcon(style()->standardIcon(QStyle::SP_DialogCloseButton));
-	connect(closeButton, SIGNAL(clicked(void)), this, SLOT(closeWindow(void)));
+static const riffField strfVidsFields[] =
+{
+	{  0, FIELD_FCC , "fcc" },
+	{  4, FIELD_U32 , "cb" },
+	{  8, FIELD_U32 , "biSize" },
+	{ 12, FIELD_I32 , "biWidth" },
+	{ 16, FIELD_I32 , "biHeight" },
+	{ 20, FIELD_U16 , "biPlanes" },
+	{ 22, FIELD_U16 , "biBitCount" },
+	{ 24, FIELD_CODE, "biCompression" },
+	{ 28, FIELD_U32 , "biSizeImage" },
+	{ 32, FIELD_I32 , "biXPelsPerMeter" },
+	{ 36, FIELD_I32 , "biYPelsPerMeter" },
+	{ 40, FIELD_U32 , "biClrUsed" },
+	{ 44, FIELD_U32 , "biClrImportant" },
+	{ -1, 0, NULL }
+};
 
-	hbox = new QHBoxLayout();
-	hbox->addStretch(5);
-	hbox->addWidget( closeButton, 1 );
-	mainLayout->addLayout( hbox );
+static const riffField strfAudsFields[] =
+{
+	{  0, FIELD_FCC , "fcc" },
+	{  4, FIELD_U32 , "cb" },
+	{  8, FIELD_U16 , "wFormatTag" },
+	{ 10, FIELD_U16 , "nChannels" },
+	{ 12, FIELD_U32 , "nSamplesPerSec" },
+	{ 16, FIELD_U32 , "nAvgBytesPerSec" },
+	{ 20, FIELD_U16 , "nBlockAlign" },
+	{ 22, FIELD_U16 , "nBitsPerSample" },
+	{ -1, 0, NULL }
+};
 
-}
+static const riffField riffTagFields[] =
+{
+	{  0, FIELD_FCC , "fcc" },
+	{  4, FIELD_U32 , "cb" },
+	{ -1, 0, NULL }
+};
 //----------------------------------------------------------------------------
-AviRiffViewerDialog::~AviRiffViewerDialog(void)
+static bool isRiffTag( const char *fcc, int *matchIdx )
 {
-	//printf("Destroy AVI RIFF Viewer Window\n");
+	int i=0;
 
-	if ( avi )
+	while ( riff_tags[i] != NULL )
 	{
-		delete avi; avi = NULL;
+		if ( strcmp( fcc, riff_tags[i] ) == 0 )
+		{
+			if ( matchIdx )
+			{
+				*matchIdx = i;
+			}
+			return true;
+		}
+		i++;
 	}
+	return false;
 }
 //----------------------------------------------------------------------------
-void AviRiffViewerDialog::closeEvent(QCloseEvent *event)
+static uint16_t readU16( const uchar *p )
 {
-	//printf("AVI RIFF Viewer Window Event\n");
-	done(0);
-	deleteLater();
-	event->accept();
+	return p[0] | (p[1] << 8);
 }
 //----------------------------------------------------------------------------
-void AviRiffViewerDialog::closeWindow(void)
+static uint32_t readU32( const uchar *p )
 {
-	//printf("Close Window\n");
-	done(0);
-	deleteLater();
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 //----------------------------------------------------------------------------
-QMenuBar *AviRiffViewerDialog::buildMenuBar(void)
+static void readFourcc( const uchar *p, char *fcc )
 {
-	QMenu       *fileMenu;
-	//QActionGroup *actGroup;
-	QAction     *act;
-	int useNativeMenuBar=0;
-
-	QMenuBar *menuBar = new QMenuBar(this);
-
-	// This is needed for menu bar to show up on MacOS
-	g_config->getOption( "SDL.UseNativeMenuBar", &useNativeMenuBar );
-
-	menuBar->setNativeMenuBar( useNativeMenuBar ? true : false );
-
-	//-----------------------------------------------------------------------
-	// Menu Start
-	//-----------------------------------------------------------------------
-	// File
-	fileMenu = menuBar->addMenu(tr("&File"));
-
-	// File -> Open
-	act = new QAction(tr("&Open AVI File"), this);
-	act->setShortcut(QKeySequence::Open);
-	act->setStatusTip(tr("Open AVI File"));
-	act->setIcon( style()->standardIcon( QStyle::SP_FileDialogStart ) );
-	connect(act, SIGNAL(triggered()), this, SLOT(openAviFileDialog(void)) );
-
-	fileMenu->addAction(act);
-
-	// File -> Close
-	act = new QAction(tr("&Close AVI File"), this);
-	act->setShortcut(QKeySequence(tr("Ctrl+C")));
-	act->setStatusTip(tr("Close AVI File"));
-	//act->setIcon( style()->standardIcon( QStyle::SP_BrowserStop ) );
-	connect(act, SIGNAL(triggered()), this, SLOT(closeFile(void)) );
-
-	fileMenu->addAction(act);
-
-	fileMenu->addSeparator();
-
-	// File -> Quit
-	act = new QAction(tr("&Quit Window"), this);
-	act->setShortcut(QKeySequence::Close);
-	act->setStatusTip(tr("Close Window"));
-	act->setIcon(style()->standardIcon(QStyle::SP_DialogCloseButton));
-	connect(act, SIGNAL(triggered()), this, SLOT(closeWindow(void)) );
-
-	fileMenu->addAction(act);
-
-	return menuBar;
+	memcpy( fcc, p, 4 );
+	fcc[4] = 0;
 }
 //----------------------------------------------------------------------------
-void AviRiffViewerDialog::openAviFileDialog(void)
+//--- AVI RIFF Tree Model
+//----------------------------------------------------------------------------
+AviRiffNode::AviRiffNode(void)
+	: type(gwavi_t::CHUNK_START), size(0), fpos(0), parent(nullptr), row(0), nextChild(-1)
 {
-	std::string last;
-	int ret, useNativeFileDialogVal;
-	QString filename;
-	std::string lastPath;
-	//char dir[512];
-	const char *base;
-	QFileDialog  dialog(this, tr("Open AVI Movie for Inspection") );
-	QList<QUrl> urls;
-	QDir d;
-
-	dialog.setFileMode(QFileDialog::ExistingFile);
-
-	dialog.setNameFilter(tr("AVI Movies (*.avi) ;; All files (*)"));
-
-	dialog.setViewMode(QFileDialog::List);
-	dialog.setFilter( QDir::AllEntries | QDir::AllDirs | QDir::Hidden );
-	dialog.setLabelText( QFileDialog::Accept, tr("Open") );
-
-	base = FCEUI_GetBaseDirectory();
-
-	urls << QUrl::fromLocalFile( QDir::rootPath() );
-	urls << QUrl::fromLocalFile(QStandardPaths::standardLocations(QStandardPaths::HomeLocation).first());
-	urls << QUrl::fromLocalFile(QStandardPaths::standardLocations(QStandardPaths::DesktopLocation).first());
-	urls << QUrl::fromLocalFile(QStandardPaths::standardLocations(QStandardPaths::DownloadLocation).first());
-
-	if ( base )
+	memset( fourcc, 0, sizeof(fourcc) );
+}
+//----------------------------------------------------------------------------
+AviRiffNode::~AviRiffNode(void)
+{
+	for (size_t i=0; i<children.size(); i++)
 	{
-		urls << QUrl::fromLocalFile( QDir( base ).absolutePath() );
-
-		d.setPath( QString(base) + "/avi");
+		delete children[i];
+	}
+}
+//----------------------------------------------------------------------------
+AviRiffModel::AviRiffModel(QObject *parent)
+	: QAbstractItemModel(parent)
+{
+	map = nullptr;
+	mapSize = 0;
+}
+//----------------------------------------------------------------------------
+AviRiffModel::~AviRiffModel(void)
+{
+	closeFile();
+}
+//----------------------------------------------------------------------------
+int AviRiffModel::openFile( const char *filepath )
+{
+	closeFile();
 
-		if ( d.exists() )
-		{
-			urls << QUrl::fromLocalFile( d.absolutePath() );
-		}
+	file.setFileName( QString::fromLocal8Bit(filepath) );
 
-		dialog.setDirectory( d.absolutePath() );
+	if ( !file.open( QIODevice::ReadOnly ) )
+	{
+		return -1;
 	}
-	dialog.setDefaultSuffix( tr(".avi") );
+	mapSize = file.size();
+	map = (mapSize > 0) ? file.map( 0, mapSize ) : nullptr;
 
-	g_config->getOption ("SDL.AviFilePath", &lastPath);
-	if ( lastPath.size() > 0 )
+	if ( map == nullptr )
 	{
-		dialog.setDirectory( QString::fromStdString(lastPath) );
+		closeFile();
+		return -1;
 	}
 
-	// Check config option to use native file dialog or not
-	g_config->getOption ("SDL.UseNativeFileDialog", &useNativeFileDialogVal);
+	if ( (mapSize < 12) || (memcmp( map, "RIFF", 4 ) != 0) )
+	{
+		closeFile();
+		return -2;
+	}
 
-	dialog.setOption(QFileDialog::DontUseNativeDialog, !useNativeFileDialogVal);
-	dialog.setSidebarUrls(urls);
+	// an OpenDML capture goes on in more RIFF (AVIX) lists after the first
+	std::vector <AviRiffNode*> top;
 
-	ret = dialog.exec();
+	beginResetModel();
+	root.nextChild = 0;
+	indexChildren( &root, top, -1 );
+	root.children.swap( top );
+	endResetModel();
 
-	if ( ret )
+	return 0;
+}
+//----------------------------------------------------------------------------
+void AviRiffModel::closeFile(void)
+{
+	beginResetModel();
+	for (size_t i=0; i<root.children.size(); i++)
 	{
-		QStringList fileList;
-		fileList = dialog.selectedFiles();
-
-		if ( fileList.size() > 0 )
-		{
-			filename = fileList[0];
-		}
+		delete root.children[i];
 	}
+	root.children.clear();
+	root.nextChild = -1;
+	endResetModel();
 
-	if ( filename.isNull() )
+	if ( map )
 	{
-	   return;
+		file.unmap( const_cast<uchar*>(map) );
+		map = nullptr;
 	}
-	//qDebug() << "selected file path : " << filename.toLocal8Bit();
-
-	printf( "AVI Debug movie %s\n", filename.toLocal8Bit().constData() );
-
-	lastPath = QFileInfo(filename).absolutePath().toLocal8Bit().constData();
-
-	if ( lastPath.size() > 0 )
+	mapSize = 0;
+	file.close();
+}
+//----------------------------------------------------------------------------
+AviRiffNode *AviRiffModel::nodeOf( const QModelIndex &index ) const
+{
+	if ( !index.isValid() )
 	{
-		g_config->setOption ("SDL.AviFilePath", lastPath);
+		return const_cast<AviRiffNode*>(&root);
 	}
-
-	openFile( filename.toLocal8Bit().constData() );
+	return static_cast<AviRiffNode*>(index.internalPointer());
 }
 //----------------------------------------------------------------------------
-int AviRiffViewerDialog::openFile( const char *filepath )
+long long AviRiffModel::endOf( const AviRiffNode *node ) const
 {
-	int ret;
-
-	if ( avi )
+	if ( node == &root )
 	{
-		closeFile();
+		return mapSize;
 	}
+	long long end = node->fpos + 8 + node->size;
 
-	avi = new gwavi_t();
-
-	if ( avi->openIn( filepath ) )
+	// sizes of a capture cut short run past its end
+	if ( end > mapSize )
 	{
-		return -1;
+		end = mapSize;
 	}
+	if ( (node->parent != nullptr) && (end > endOf(node->parent)) )
+	{
+		end = endOf(node->parent);
+	}
+	return end;
+}
+//----------------------------------------------------------------------------
+void AviRiffModel::strhTypeOf( const AviRiffNode *node, char *fccType ) const
+{
+	fccType[0] = 0;
 
-	progressDialog = new QProgressDialog( tr("Loading AVI File"), tr("Cancel"), 0, 1000, this );
-	progressDialog->setWindowModality(Qt::WindowModal);
-
-	itemStack.clear();
-	lastChunk = NULL;
-	memset( strhType, 0, sizeof(strhType) );
-
-	riffSize = 0;
-	avi->setRiffWalkCallback( ::riffWalkCallback, this );
-	ret = avi->riffwalk();
-
-	if ( ret )
+	// the strh before a strf in the same strl says what the format is
+	if ( node->parent == nullptr )
 	{
-		if ( progressDialog->wasCanceled() )
-		{
-			QMessageBox::information( this, tr("AVI Load Canceled"), tr("AVI Load Canceled By User.") );
-		}
-		else
+		return;
+	}
+	for (int i=node->row-1; i>=0; i--)
+	{
+		const AviRiffNode *s = node->parent->children[i];
+
+		if ( (strcmp( s->fourcc, "strh" ) == 0) && (s->fpos + 12 <= endOf(s)) )
 		{
-			progressDialog->reset();
-			QMessageBox::critical( this, tr("AVI Load Error"), tr("AVI format errors detected. Unable to load file.") );
+			readFourcc( map + s->fpos + 8, fccType );
+			return;
 		}
-		closeFile();
 	}
-	delete progressDialog; progressDialog = NULL;
-
-	return 0;
 }
 //----------------------------------------------------------------------------
-void AviRiffViewerDialog::closeFile(void)
+bool AviRiffModel::isDecodable( const AviRiffNode *node ) const
 {
-	if ( avi )
+	char fccType[8];
+
+	if ( node->type != gwavi_t::CHUNK_START )
+	{
+		return false;
+	}
+	if ( (strcmp( node->fourcc, "avih" ) == 0) || (strcmp( node->fourcc, "strh" ) == 0) )
 	{
-		delete avi; avi = NULL;
+		return true;
 	}
-	riffTree->clear();
-	itemStack.clear();
+	if ( strcmp( node->fourcc, "strf" ) == 0 )
+	{
+		strhTypeOf( node, fccType );
+
+		return (strcmp( fccType, "vids" ) == 0) || (strcmp( fccType, "auds" ) == 0);
+	}
+	return isRiffTag( node->fourcc, nullptr );
 }
 //----------------------------------------------------------------------------
-int AviRiffViewerDialog::riffWalkCallback( int type, long long int fpos, const char *fourcc, size_t size )
+void AviRiffModel::indexChildren( AviRiffNode *node, std::vector <AviRiffNode*> &out, int maxCount )
 {
-	AviRiffTreeItem *item, *groupItem;
+	long long end = endOf( node );
+	long long fpos = node->nextChild;
+	int count = 0;
 
-	if ( riffSize > 0 )
+	while ( (fpos >= 0) && (fpos + 8 <= end) && ((maxCount < 0) || (count < maxCount)) )
 	{
-		int prog;
+		AviRiffNode *child = new AviRiffNode();
+		char fcc[8];
 
-		prog = (1000llu * fpos) / riffSize;
+		readFourcc( map + fpos, fcc );
 
-		if ( prog > 1000 )
-		{
-			prog = 1000;
-		}
-		if ( progressDialog )
+		child->fpos   = fpos;
+		child->size   = readU32( map + fpos + 4 );
+		child->parent = node;
+		child->row    = static_cast<int>(node->children.size() + out.size());
+
+		if ( (strcmp( fcc, "RIFF" ) == 0) || (strcmp( fcc, "LIST" ) == 0) )
 		{
-			if (progressDialog->wasCanceled())
+			child->type = (fcc[0] == 'R') ? gwavi_t::RIFF_START : gwavi_t::LIST_START;
+
+			if ( fpos + 12 <= end )
 			{
-				return -1;
+				readFourcc( map + fpos + 8, child->fourcc );
 			}
-			progressDialog->setValue( prog );
+			child->nextChild = fpos + 12;
 		}
-	}
-	switch ( type )
-	{
-		case gwavi_t::RIFF_START:
-		{
-			item = new AviRiffTreeItem(type, fpos, fourcc, size);
-
-			riffSize = size;
-
-			itemStack.push_back(item);
-
-			riffTree->addTopLevelItem(item);
-		}
-		break;
-		case gwavi_t::RIFF_END:
+		else
 		{
-			groupItem = itemStack.back();
-			groupItem->setExpanded(true);
-			itemStack.pop_back();
+			child->type = gwavi_t::CHUNK_START;
+			strcpy( child->fourcc, fcc );
 		}
-		break;
-		case gwavi_t::LIST_START:
-		{
-			item = new AviRiffTreeItem(type, fpos, fourcc, size);
+		out.push_back( child );
+		count++;
 
-			groupItem = itemStack.back();
+		fpos += 8 + (long long)child->size + (child->size % gwavi_t::WORD_SIZE);
+	}
+	node->nextChild = (fpos + 8 <= end) ? fpos : -1;
+}
+//----------------------------------------------------------------------------
+void AviRiffModel::decodeChunk( AviRiffNode *node, std::vector <AviRiffNode*> &out )
+{
+	const riffField *fields = nullptr;
+	char fccType[8], stmp[256];
+	const char *tagName = nullptr;
+	long long end = endOf( node );
+	const uchar *p = map + node->fpos;
 
-			itemStack.push_back(item);
+	node->nextChild = -1;
 
-			groupItem->addChild(item);
-		}
-		break;
-		case gwavi_t::LIST_END:
+	if ( strcmp( node->fourcc, "avih" ) == 0 )
+	{
+		fields = avihFields;
+	}
+	else if ( strcmp( node->fourcc, "strh" ) == 0 )
+	{
+		fields = strhFields;
+	}
+	else if ( strcmp( node->fourcc, "strf" ) == 0 )
+	{
+		strhTypeOf( node, fccType );
+
+		if ( strcmp( fccType, "vids" ) == 0 )
 		{
-			itemStack.pop_back();
+			fields = strfVidsFields;
 		}
-		break;
-		case gwavi_t::CHUNK_START:
+		else if ( strcmp( fccType, "auds" ) == 0 )
 		{
-			item = new AviRiffTreeItem(type, fpos, fourcc, size);
-
-			groupItem = itemStack.back();
-
-			groupItem->addChild(item);
-
-			lastChunk = item;
-
-			processChunk(lastChunk);
+			fields = strfAudsFields;
 		}
-		break;
-		default:
-			// UnHandled Type
-		break;
 	}
+	else if ( isRiffTag( node->fourcc, nullptr ) )
+	{
+		int j=0;
 
-	return 0;
-}
-//----------------------------------------------------------------------------
-static bool isRiffTag( const char *fcc, int *matchIdx )
-{
-	int i=0;
+		fields  = riffTagFields;
+		tagName = "MetaData";
 
-	while ( riff_tags[i] != NULL )
-	{
-		if ( strcmp( fcc, riff_tags[i] ) == 0 )
+		while ( riff_info_conv[j] != NULL )
 		{
-			if ( matchIdx )
+			if ( strcmp( node->fourcc, riff_info_conv[j] ) == 0 )
 			{
-				*matchIdx = i;
+				tagName = riff_info_conv[j+1]; break;
 			}
-			return true;
+			j += 2;
 		}
-		i++;
 	}
-	return false;
-}
-//----------------------------------------------------------------------------
-int  AviRiffViewerDialog::processChunk( AviRiffTreeItem *item )
-{
-	int i, riffIdx;
-	QTreeWidgetItem *twi;
-	char stmp[256];
-	gwavi_dataBuffer data;
-
-	if ( strcmp( item->getFourcc(), "avih" ) == 0 )
+	if ( fields == nullptr )
 	{
-		data.malloc( item->getSize()+8 );
-
-		avi->getChunkData( item->filePos(), data.buf, item->getSize()+8 );
-
-		snprintf( stmp, sizeof(stmp), "%c%c%c%c", data.buf[0], data.buf[1], data.buf[2], data.buf[3] );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("fcc") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(4) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("cb") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(8) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwMicroSecPerFrame") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(12) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwMaxBytesPerSec") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(16) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwPaddingGranularity") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "0x%X", data.readU32(20) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwFlags") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(24) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwTotalFrames") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(28) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwInitialFrames") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(32) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwStreams") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(36) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwSuggestedBufferSize") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(40) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwWidth") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(44) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwHeight") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(48) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwScale") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(52) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwRate") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(56) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwStart") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(60) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwLength") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
+		return;
 	}
-	else if ( strcmp( item->getFourcc(), "strh" ) == 0 )
-	{
-		data.malloc( item->getSize()+8 );
-
-		avi->getChunkData( item->filePos(), data.buf, item->getSize()+8 );
-
-		snprintf( stmp, sizeof(stmp), "%c%c%c%c", data.buf[0], data.buf[1], data.buf[2], data.buf[3] );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("fcc") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
 
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(4) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("cb") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
+	for (int i=0; fields[i].name != NULL; i++)
+	{
+		const riffField &f = fields[i];
+		int len = (f.kind == FIELD_U16) ? 2 : 4;
+		const uchar *v = p + f.ofs;
 
-		snprintf( stmp, sizeof(stmp), "%c%c%c%c", data.buf[8], data.buf[9], data.buf[10], data.buf[11] );
-		strcpy( strhType, stmp );
+		if ( node->fpos + f.ofs + len > end )
+		{	// a chunk too short for the rest
+			break;
+		}
+		AviRiffNode *field = new AviRiffNode();
 
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("fccType") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
+		field->type   = AviRiffNode::FIELD;
+		field->fpos   = node->fpos + f.ofs;
+		field->parent = node;
+		field->row    = static_cast<int>(out.size());
 
-		if ( isalnum(data.buf[12]) )
+		switch ( f.kind )
 		{
-			snprintf( stmp, sizeof(stmp), "%c%c%c%c", data.buf[12], data.buf[13], data.buf[14], data.buf[15] );
+			case FIELD_CODE:
+				if ( !isalnum(v[0]) )
+				{
+					snprintf( stmp, sizeof(stmp), "0x%X", readU32(v) );
+					break;
+				}
+				// fall through
+			case FIELD_FCC:
+				snprintf( stmp, sizeof(stmp), "%c%c%c%c", v[0], v[1], v[2], v[3] );
+			break;
+			case FIELD_X32:
+				snprintf( stmp, sizeof(stmp), "0x%X", readU32(v) );
+			break;
+			case FIELD_I32:
+				snprintf( stmp, sizeof(stmp), "%i", (int32_t)readU32(v) );
+			break;
+			case FIELD_U16:
+				snprintf( stmp, sizeof(stmp), "%u", readU16(v) );
+			break;
+			default:
+			case FIELD_U32:
+				snprintf( stmp, sizeof(stmp), "%u", readU32(v) );
+			break;
 		}
-		else
+		field->text[0] = tr(f.name);
+		field->text[1] = QString(stmp);
+
+		if ( (fields == strhFields) && (f.ofs == 32) && (memcmp( p + 8, "vids", 4 ) == 0) )
 		{
-			snprintf( stmp, sizeof(stmp), "0x%X", data.readU32(12) );
+			snprintf( stmp, sizeof(stmp), "(%13.10f Hz)", (double)readU32(p + 32) / (double)readU32(p + 28) );
+			field->text[2] = QString(stmp);
 		}
+		out.push_back( field );
+	}
 
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("fccHandler") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "0x%X", data.readU32(16) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwFlags") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU16(20) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("wPriority") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU16(22) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("wLanguage") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(24) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwInitialFrames") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(28) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwScale") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(32) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwRate") );
-		twi->setText( 2, tr(stmp) );
+	if ( tagName != nullptr )
+	{
+		long long textEnd = node->fpos + 8 + node->size;
+		int i;
 
-		if ( strcmp( strhType, "vids" ) == 0 )
+		if ( textEnd > end )
 		{
-			snprintf( stmp, sizeof(stmp), "(%13.10f Hz)", (double)data.readU32(32) / (double)data.readU32(28) );
-			twi->setText( 3, tr(stmp) );
+			textEnd = end;
 		}
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(36) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwStart") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(40) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwLength") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(44) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwSuggestedBufferSize") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%i", data.readI32(48) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwQuality") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
-
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(52) );
-
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("dwSampleSize") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
+		for (i=0; node->fpos + 8 + i < textEnd; i++)
+		{
+			if ( i >= (static_cast<int>(sizeof(stmp))-1 ) )
+			{
+				break;
+			}
+			stmp[i] = p[i+8];
+		}
+		stmp[i] = 0;
 
-		snprintf( stmp, sizeof(stmp), "%u", data.readU16(56) );
+		AviRiffNode *field = new AviRiffNode();
 
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("rcFrame.left") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
+		field->type    = AviRiffNode::FIELD;
+		field->fpos    = node->fpos + 8;
+		field->parent  = node;
+		field->row     = static_cast<int>(out.size());
+		field->text[0] = tr(tagName);
+		field->text[1] = QString(stmp);
 
-		snprintf( stmp, sizeof(stmp), "%u", data.readU16(58) );
+		out.push_back( field );
+	}
+}
+//----------------------------------------------------------------------------
+QModelIndex AviRiffModel::index(int row, int column, const QModelIndex &parent) const
+{
+	AviRiffNode *node = nodeOf( parent );
 
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("rcFrame.top") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
+	if ( (row < 0) || (static_cast<size_t>(row) >= node->children.size()) || (column < 0) || (column >= 4) )
+	{
+		return QModelIndex();
+	}
+	return createIndex( row, column, node->children[row] );
+}
+//----------------------------------------------------------------------------
+QModelIndex AviRiffModel::parent(const QModelIndex &index) const
+{
+	if ( !index.isValid() )
+	{
+		return QModelIndex();
+	}
+	AviRiffNode *node = nodeOf( index )->parent;
 
-		snprintf( stmp, sizeof(stmp), "%u", data.readU16(60) );
+	if ( (node == nullptr) || (node == &root) )
+	{
+		return QModelIndex();
+	}
+	return createIndex( node->row, 0, node );
+}
+//----------------------------------------------------------------------------
+int AviRiffModel::rowCount(const QModelIndex &parent) const
+{
+	if ( parent.column() > 0 )
+	{
+		return 0;
+	}
+	return static_cast<int>(nodeOf( parent )->children.size());
+}
+//----------------------------------------------------------------------------
+int AviRiffModel::columnCount(const QModelIndex &parent) const
+{
+	return 4;
+}
+//----------------------------------------------------------------------------
+bool AviRiffModel::hasChildren(const QModelIndex &parent) const
+{
+	AviRiffNode *node = nodeOf( parent );
 
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("rcFrame.right") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
+	if ( parent.column() > 0 )
+	{
+		return false;
+	}
+	if ( !node->children.empty() )
+	{
+		return true;
+	}
+	if ( node->type == gwavi_t::CHUNK_START )
+	{
+		return isDecodable( node );
+	}
+	return node->nextChild >= 0;
+}
+//----------------------------------------------------------------------------
+bool AviRiffModel::canFetchMore(const QModelIndex &parent) const
+{
+	AviRiffNode *node = nodeOf( parent );
 
-		snprintf( stmp, sizeof(stmp), "%u", data.readU16(62) );
+	if ( (map == nullptr) || (node == &root) )
+	{
+		return false;
+	}
+	if ( node->type == gwavi_t::CHUNK_START )
+	{
+		return node->children.empty() && isDecodable( node );
+	}
+	return node->nextChild >= 0;
+}
+//----------------------------------------------------------------------------
+void AviRiffModel::fetchMore(const QModelIndex &parent)
+{
+	AviRiffNode *node = nodeOf( parent );
+	std::vector <AviRiffNode*> more;
 
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("rcFrame.bottom") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
+	if ( !canFetchMore( parent ) )
+	{
+		return;
 	}
-	else if ( strcmp( item->getFourcc(), "strf" ) == 0 )
+	if ( node->type == gwavi_t::CHUNK_START )
 	{
-		if ( strcmp( strhType, "vids" ) == 0 )
-		{
-			data.malloc( item->getSize()+8 );
+		decodeChunk( node, more );
+	}
+	else
+	{
+		indexChildren( node, more, fetchBatch );
+	}
 
-			avi->getChunkData( item->filePos(), data.buf, item->getSize()+8 );
+	if ( more.empty() )
+	{
+		return;
+	}
+	int first = static_cast<int>(node->children.size());
 
-			snprintf( stmp, sizeof(stmp), "%c%c%c%c", data.buf[0], data.buf[1], data.buf[2], data.buf[3] );
+	beginInsertRows( parent, first, first + static_cast<int>(more.size()) - 1 );
+	node->children.insert( node->children.end(), more.begin(), more.end() );
+	endInsertRows();
+}
+//----------------------------------------------------------------------------
+QVariant AviRiffModel::data(const QModelIndex &index, int role) const
+{
+	char stmp[64];
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("fcc") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	if ( !index.isValid() || (role != Qt::DisplayRole) )
+	{
+		return QVariant();
+	}
+	AviRiffNode *node = nodeOf( index );
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU32(4) );
+	if ( node->type == AviRiffNode::FIELD )
+	{
+		switch ( index.column() )
+		{
+			case 0:  return node->text[0];
+			case 2:  return node->text[1];
+			case 3:  return node->text[2];
+			default: return QVariant();
+		}
+	}
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("cb") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	switch ( index.column() )
+	{
+		case 0:
+			switch ( node->type )
+			{
+				case gwavi_t::RIFF_START:
+					return QString("<RIFF>");
+				case gwavi_t::LIST_START:
+					return QString("<LIST>");
+				default:
+					return QString("<CHUNK>");
+			}
+		break;
+		case 1:
+			return QString( node->fourcc );
+		case 2:
+			if ( showSizeHex )
+			{
+				snprintf( stmp, sizeof(stmp), "0x%08lX", (unsigned long)node->size );
+			}
+			else
+			{
+				snprintf( stmp, sizeof(stmp), "%u", node->size );
+			}
+			return QString( stmp );
+		case 3:
+			snprintf( stmp, sizeof(stmp), "0x%08llX", node->fpos );
+			return QString( stmp );
+		default:
+		break;
+	}
+	return QVariant();
+}
+//----------------------------------------------------------------------------
+QVariant AviRiffModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	static const char *headers[] = { "Block", "FCC", "Size", "FilePos" };
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU32(8) );
+	if ( (orientation != Qt::Horizontal) || (role != Qt::DisplayRole) || (section < 0) || (section >= 4) )
+	{
+		return QVariant();
+	}
+	return tr( headers[section] );
+}
+//----------------------------------------------------------------------------
+//--- AVI RIFF Viewer Dialog
+//----------------------------------------------------------------------------
+AviRiffViewerDialog::AviRiffViewerDialog(QWidget *parent)
+	: QDialog(parent)
+{
+	QMenuBar    *menuBar;
+	QVBoxLayout *mainLayout;
+	QHBoxLayout *hbox;
+	QPushButton *closeButton;
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("biSize") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	setWindowTitle("AVI RIFF Viewer");
 
-			snprintf( stmp, sizeof(stmp), "%i", data.readI32(12) );
+	resize(512, 512);
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("biWidth") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	menuBar = buildMenuBar();
+	mainLayout = new QVBoxLayout();
+	setLayout(mainLayout);
+	mainLayout->setMenuBar( menuBar );
 
-			snprintf( stmp, sizeof(stmp), "%i", data.readI32(16) );
+	tabs      = new QTabWidget();
+	riffTree  = new AviRiffTree();
+	riffModel = new AviRiffModel(this);
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("biHeight") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	tabs->addTab( riffTree, tr("RIFF TREE") );
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU16(20) );
+	riffTree->setModel( riffModel );
+	riffTree->setSelectionMode( QAbstractItemView::SingleSelection );
+	riffTree->setAlternatingRowColors(true);
+	riffTree->setUniformRowHeights(true);
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("biPlanes") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	// sized to the rows in view when a list opens, not to every row of a movi list
+	riffTree->header()->setSectionResizeMode(QHeaderView::Interactive);
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU16(22) );
+	connect( riffTree, SIGNAL(expanded(const QModelIndex&)), this, SLOT(itemExpanded(const QModelIndex&)) );
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("biBitCount") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	mainLayout->addWidget(tabs);
 
-			if ( isalnum(data.buf[24]) )
-			{
-				snprintf( stmp, sizeof(stmp), "%c%c%c%c", data.buf[24], data.buf[25], data.buf[26], data.buf[27] );
-			}
-			else
-			{
-				snprintf( stmp, sizeof(stmp), "0x%X", data.readU32(24) );
-			}
+	closeButton = new QPushButton( tr("Close") );
+	closeButton->setIcon(style()->standardIcon(QStyle::SP_DialogCloseButton));
+	connect(closeButton, SIGNAL(clicked(void)), this, SLOT(closeWindow(void)));
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("biCompression") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	hbox = new QHBoxLayout();
+	hbox->addStretch(5);
+	hbox->addWidget( closeButton, 1 );
+	mainLayout->addLayout( hbox );
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU32(28) );
+}
+//----------------------------------------------------------------------------
+AviRiffViewerDialog::~AviRiffViewerDialog(void)
+{
+	//printf("Destroy AVI RIFF Viewer Window\n");
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("biSizeImage") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	riffTree->setModel( nullptr );
+}
+//----------------------------------------------------------------------------
+void AviRiffViewerDialog::closeEvent(QCloseEvent *event)
+{
+	//printf("AVI RIFF Viewer Window Event\n");
+	done(0);
+	deleteLater();
+	event->accept();
+}
+//----------------------------------------------------------------------------
+void AviRiffViewerDialog::closeWindow(void)
+{
+	//printf("Close Window\n");
+	done(0);
+	deleteLater();
+}
+//----------------------------------------------------------------------------
+QMenuBar *AviRiffViewerDialog::buildMenuBar(void)
+{
+	QMenu       *fileMenu;
+	//QActionGroup *actGroup;
+	QAction     *act;
+	int useNativeMenuBar=0;
 
-			snprintf( stmp, sizeof(stmp), "%i", data.readI32(32) );
+	QMenuBar *menuBar = new QMenuBar(this);
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("biXPelsPerMeter") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	// This is needed for menu bar to show up on MacOS
+	g_config->getOption( "SDL.UseNativeMenuBar", &useNativeMenuBar );
 
-			snprintf( stmp, sizeof(stmp), "%i", data.readI32(36) );
+	menuBar->setNativeMenuBar( useNativeMenuBar ? true : false );
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("biYPelsPerMeter") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	//-----------------------------------------------------------------------
+	// Menu Start
+	//-----------------------------------------------------------------------
+	// File
+	fileMenu = menuBar->addMenu(tr("&File"));
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU32(40) );
+	// File -> Open
+	act = new QAction(tr("&Open AVI File"), this);
+	act->setShortcut(QKeySequence::Open);
+	act->setStatusTip(tr("Open AVI File"));
+	act->setIcon( style()->standardIcon( QStyle::SP_FileDialogStart ) );
+	connect(act, SIGNAL(triggered()), this, SLOT(openAviFileDialog(void)) );
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("biClrUsed") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	fileMenu->addAction(act);
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU32(44) );
+	// File -> Close
+	act = new QAction(tr("&Close AVI File"), this);
+	act->setShortcut(QKeySequence(tr("Ctrl+C")));
+	act->setStatusTip(tr("Close AVI File"));
+	//act->setIcon( style()->standardIcon( QStyle::SP_BrowserStop ) );
+	connect(act, SIGNAL(triggered()), this, SLOT(closeFile(void)) );
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("biClrImportant") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
-		}
-		else if ( strcmp( strhType, "auds" ) == 0 )
-		{
-			size_t dataSize = item->getSize()+8;
+	fileMenu->addAction(act);
 
-			data.malloc( dataSize );
+	fileMenu->addSeparator();
 
-			avi->getChunkData( item->filePos(), data.buf, dataSize );
+	// File -> Quit
+	act = new QAction(tr("&Quit Window"), this);
+	act->setShortcut(QKeySequence::Close);
+	act->setStatusTip(tr("Close Window"));
+	act->setIcon(style()->standardIcon(QStyle::SP_DialogCloseButton));
+	connect(act, SIGNAL(triggered()), this, SLOT(closeWindow(void)) );
 
-			snprintf( stmp, sizeof(stmp), "%c%c%c%c", data.buf[0], data.buf[1], data.buf[2], data.buf[3] );
+	fileMenu->addAction(act);
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("fcc") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	return menuBar;
+}
+//----------------------------------------------------------------------------
+void AviRiffViewerDialog::openAviFileDialog(void)
+{
+	std::string last;
+	int ret, useNativeFileDialogVal;
+	QString filename;
+	std::string lastPath;
+	//char dir[512];
+	const char *base;
+	QFileDialog  dialog(this, tr("Open AVI Movie for Inspection") );
+	QList<QUrl> urls;
+	QDir d;
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU32(4) );
+	dialog.setFileMode(QFileDialog::ExistingFile);
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("cb") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	dialog.setNameFilter(tr("AVI Movies (*.avi) ;; All files (*)"));
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU16(8) );
+	dialog.setViewMode(QFileDialog::List);
+	dialog.setFilter( QDir::AllEntries | QDir::AllDirs | QDir::Hidden );
+	dialog.setLabelText( QFileDialog::Accept, tr("Open") );
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("wFormatTag") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	base = FCEUI_GetBaseDirectory();
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU16(10) );
+	urls << QUrl::fromLocalFile( QDir::rootPath() );
+	urls << QUrl::fromLocalFile(QStandardPaths::standardLocations(QStandardPaths::HomeLocation).first());
+	urls << QUrl::fromLocalFile(QStandardPaths::standardLocations(QStandardPaths::DesktopLocation).first());
+	urls << QUrl::fromLocalFile(QStandardPaths::standardLocations(QStandardPaths::DownloadLocation).first());
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("nChannels") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	if ( base )
+	{
+		urls << QUrl::fromLocalFile( QDir( base ).absolutePath() );
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU32(12) );
+		d.setPath( QString(base) + "/avi");
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("nSamplesPerSec") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+		if ( d.exists() )
+		{
+			urls << QUrl::fromLocalFile( d.absolutePath() );
+		}
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU32(16) );
+		dialog.setDirectory( d.absolutePath() );
+	}
+	dialog.setDefaultSuffix( tr(".avi") );
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("nAvgBytesPerSec") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	g_config->getOption ("SDL.AviFilePath", &lastPath);
+	if ( lastPath.size() > 0 )
+	{
+		dialog.setDirectory( QString::fromStdString(lastPath) );
+	}
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU16(20) );
+	// Check config option to use native file dialog or not
+	g_config->getOption ("SDL.UseNativeFileDialog", &useNativeFileDialogVal);
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("nBlockAlign") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
+	dialog.setOption(QFileDialog::DontUseNativeDialog, !useNativeFileDialogVal);
+	dialog.setSidebarUrls(urls);
 
-			snprintf( stmp, sizeof(stmp), "%u", data.readU16(22) );
+	ret = dialog.exec();
 
-			twi = new QTreeWidgetItem();
-			twi->setText( 0, tr("nBitsPerSample") );
-			twi->setText( 2, tr(stmp) );
-			item->addChild(twi);
-		}
-	}
-	else if ( isRiffTag( item->getFourcc(), &riffIdx ) )
+	if ( ret )
 	{
-		int j=0;
-		const char *name = "MetaData";
+		QStringList fileList;
+		fileList = dialog.selectedFiles();
 
-		while ( riff_info_conv[j] != NULL )
+		if ( fileList.size() > 0 )
 		{
-			if ( strcmp( item->getFourcc(), riff_info_conv[j] ) == 0 )
-			{
-				name = riff_info_conv[j+1]; break;
-			}
-			j += 2;
+			filename = fileList[0];
 		}
+	}
 
-		data.malloc( item->getSize()+8 );
-
-		avi->getChunkData( item->filePos(), data.buf, item->getSize()+8 );
+	if ( filename.isNull() )
+	{
+	   return;
+	}
+	//qDebug() << "selected file path : " << filename.toLocal8Bit();
 
-		snprintf( stmp, sizeof(stmp), "%c%c%c%c", data.buf[0], data.buf[1], data.buf[2], data.buf[3] );
+	printf( "AVI Debug movie %s\n", filename.toLocal8Bit().constData() );
 
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("fcc") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
+	lastPath = QFileInfo(filename).absolutePath().toLocal8Bit().constData();
 
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(4) );
+	if ( lastPath.size() > 0 )
+	{
+		g_config->setOption ("SDL.AviFilePath", lastPath);
+	}
 
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr("cb") );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
+	openFile( filename.toLocal8Bit().constData() );
+}
+//----------------------------------------------------------------------------
+int AviRiffViewerDialog::openFile( const char *filepath )
+{
+	int ret;
 
-		snprintf( stmp, sizeof(stmp), "%u", data.readU32(8) );
+	ret = riffModel->openFile( filepath );
 
-		for (i=0; i < static_cast<int>(item->getSize()); i++)
-		{
-			if ( i >= (static_cast<int>(sizeof(stmp))-1 ) )
-			{
-				i = sizeof(stmp)-1; break;
-			}
-			stmp[i] = data.buf[i+8];
-		}
-		stmp[i] = 0;
+	if ( ret == -1 )
+	{
+		QMessageBox::critical( this, tr("AVI Load Error"), tr("Unable to open file.") );
+		return -1;
+	}
+	else if ( ret )
+	{
+		QMessageBox::critical( this, tr("AVI Load Error"), tr("AVI format errors detected. Unable to load file.") );
+		return -1;
+	}
 
-		twi = new QTreeWidgetItem();
-		twi->setText( 0, tr(name) );
-		twi->setText( 2, tr(stmp) );
-		item->addChild(twi);
+	if ( riffModel->rowCount() > 0 )
+	{
+		riffTree->expand( riffModel->index(0, 0) );
 	}
+	itemExpanded( QModelIndex() );
 
 	return 0;
 }
 //----------------------------------------------------------------------------
-//--- AVI RIFF Tree View
-//----------------------------------------------------------------------------
-AviRiffTree::AviRiffTree(QWidget *parent)
-	: QTreeWidget(parent)
+void AviRiffViewerDialog::closeFile(void)
 {
-
+	riffModel->closeFile();
 }
 //----------------------------------------------------------------------------
-AviRiffTree::~AviRiffTree(void)
+void AviRiffViewerDialog::itemExpanded(const QModelIndex &index)
 {
-
+	for (int i=0; i<riffModel->columnCount(); i++)
+	{
+		riffTree->resizeColumnToContents(i);
+	}
 }
 //----------------------------------------------------------------------------
+//--- AVI RIFF Tree View
 //----------------------------------------------------------------------------
-//--- AVI RIFF Viewer Dialog
-//----------------------------------------------------------------------------
-AviRiffTreeItem::AviRiffTreeItem(int typeIn, long long int fposIn, const char *fourccIn, size_t sizeIn, QTreeWidgetItem *parent)
-	: QTreeWidgetItem(parent,1)
+AviRiffTree::AviRiffTree(QWidget *parent)
+	: QTreeView(parent)
 {
-	char stmp[64];
-
-	type = typeIn;
-	fpos = fposIn;
-	size = sizeIn;
-
-	strcpy( fourcc, fourccIn );
-
-	//snprintf( stmp, sizeof(stmp), "0x%08llX", fposIn );
-	
-	switch ( type )
-	{
-		case gwavi_t::RIFF_START:
-		case gwavi_t::RIFF_END:
-			setText( 0, QString("<RIFF>") );
-		break;
-		case gwavi_t::LIST_START:
-		case gwavi_t::LIST_END:
-			setText( 0, QString("<LIST>") );
-		break;
-		default:
-		case gwavi_t::CHUNK_START:
-			setText( 0, QString("<CHUNK>") );
-		break;
-	}
-
-	setText( 1, QString(fourcc) );
-
-	if ( showSizeHex )
-	{
-		snprintf( stmp, sizeof(stmp), "0x%08lX", (unsigned long)size );
-	}
-	else
-	{
-		snprintf( stmp, sizeof(stmp), "%zu", size );
-	}
-
-	setText( 2, QString(stmp) );
 
-	snprintf( stmp, sizeof(stmp), "0x%08llX", fposIn );
-
-	setText( 3, QString(stmp) );
 }
 //----------------------------------------------------------------------------
-AviRiffTreeItem::~AviRiffTreeItem(void)
+AviRiffTree::~AviRiffTree(void)
 {
 
 }
@@ -3,9 +3,12 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 
 #include <QWidget>
 #include <QDialog>
@@ -18,9 +21,11 @@
 #include <QLabel>
 #include <QFrame>
 #include <QGroupBox>
+#include <QFile>
 #include <QTreeView>
 #include <QTreeWidget>
 #include <QTreeWidgetItem>
+#include <QAbstractItemModel>
 #include <QProgressDialog>
 #include <QTabWidget>
 #include <QMenuBar>
@@ -28,26 +33,72 @@
 
 #include "Qt/avi/gwavi.h"
 
-class AviRiffTreeItem : public QTreeWidgetItem
+// One row of the tree. RIFF, LIST and chunk rows are read from their header
+// in the mapped file, a chunk's decoded fields hang below it as FIELD rows.
+struct AviRiffNode
 {
-	//Q_OBJECT
+	enum { FIELD = gwavi_t::CHUNK_START + 1 };
 
-	public:
-		AviRiffTreeItem(int type, long long int fpos, const char *fourcc, size_t size, QTreeWidgetItem *parent = nullptr);
-		~AviRiffTreeItem(void);
+	AviRiffNode(void);
+	~AviRiffNode(void);
+
+	int          type;    // gwavi_t::RIFF_START, LIST_START, CHUNK_START or FIELD
+	char         fourcc[8];
+	uint32_t     size;
+	long long    fpos;    // of the header
+	AviRiffNode *parent;
+	int          row;
+
+	std::vector <AviRiffNode*> children;
+
+	// where the next child header is, -1 once all children are known
+	long long    nextChild;
+
+	QString      text[3]; // FIELD rows: name, value and note
+};
+
+// Indexes the chunk headers of a list only when it is expanded, and a list
+// of many chunks (movi) a batch at a time as the view scrolls to its end, so
+// opening a capture reads a few headers whatever the size of the file.
+class AviRiffModel : public QAbstractItemModel
+{
+	Q_OBJECT
 
-		size_t filePos(void){ return fpos; }
-		size_t getSize(void){ return size; }
-		const char *getFourcc(void){ return fourcc; }
+	public:
+		AviRiffModel(QObject *parent = nullptr);
+		~AviRiffModel(void);
+
+		// 0 when opened, -1 when the file could not be mapped, -2 when it is not RIFF
+		int  openFile( const char *filepath );
+		void closeFile(void);
+
+		QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+		QModelIndex parent(const QModelIndex &index) const override;
+		int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+		int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+		QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+		QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+		bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+		bool canFetchMore(const QModelIndex &parent) const override;
+		void fetchMore(const QModelIndex &parent) override;
 
 	private:
-		int type;
-		char fourcc[8];
-		size_t size;
-		long long int fpos;
+		AviRiffNode *nodeOf( const QModelIndex &index ) const;
+		long long    endOf( const AviRiffNode *node ) const;
+		bool         isDecodable( const AviRiffNode *node ) const;
+		void         indexChildren( AviRiffNode *node, std::vector <AviRiffNode*> &out, int maxCount );
+		void         decodeChunk( AviRiffNode *node, std::vector <AviRiffNode*> &out );
+		void         strhTypeOf( const AviRiffNode *node, char *fccType ) const;
+
+		QFile        file;
+		const uchar *map;
+		long long    mapSize;
+		AviRiffNode  root;
+
+		static const int fetchBatch = 4096;
 };
 
-class AviRiffTree : public QTreeWidget
+class AviRiffTree : public QTreeView
 {
 	Q_OBJECT
 
@@ -66,25 +117,17 @@ public:
 	AviRiffViewerDialog(QWidget *parent = 0);
 	~AviRiffViewerDialog(void);
 
-	int riffWalkCallback( int type, long long int fpos, const char *fourcc, size_t size );
-
 protected:
 	void closeEvent(QCloseEvent *event);
 
 	QMenuBar *buildMenuBar(void);
 
 	int  openFile( const char *filepath );
-	int  processChunk( AviRiffTreeItem *item );
 
-	gwavi_t     *avi;
-	AviRiffTree *riffTree;
-	AviRiffTreeItem *lastChunk;
-	std::list <AviRiffTreeItem*> itemStack;
-	char strhType[8];
-	size_t       riffSize;
+	AviRiffModel *riffModel;
+	AviRiffTree  *riffTree;
 
 	QTabWidget *tabs;
-	QProgressDialog *progressDialog;
 
 private:
 public slots:
@@ -92,5 +135,5 @@ public slots:
 private slots:
 	void closeFile(void);
 	void openAviFileDialog(void);
-	//void ItemActivated(QTreeWidgetItem *item, int column);
+	void itemExpanded(const QModelIndex &index);
 };
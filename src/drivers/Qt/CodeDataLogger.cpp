@@ -38,6 +38,7 @@
 #include "../../nsf.h"
 
 #include "Qt/ConsoleUtilities.h"
+#include "Qt/FrameDispatcher.h"
 #include "Qt/CodeDataLogger.h"
 #include "Qt/main.h"
 #include "Qt/dface.h"
@@ -87,10 +88,6 @@ CodeDataLoggerDialog_t::CodeDataLoggerDialog_t(QWidget *parent)
 	QAction *act;
 	int useNativeMenuBar;
 
-	updateTimer = new QTimer(this);
-
-	connect(updateTimer, &QTimer::timeout, this, &CodeDataLoggerDialog_t::updatePeriodic);
-
 	setWindowTitle(tr("Code Data Logger"));
 
 	menuBar = new QMenuBar(this);
@@ -275,7 +272,7 @@ CodeDataLoggerDialog_t::CodeDataLoggerDialog_t(QWidget *parent)
 
 	setLayout(mainLayout);
 
-	updateTimer->start(200); // 5hz
+	FrameDispatcher::instance()->addView( this, 200, [this]{ updatePeriodic(); } ); // 5hz
 
 	if (autoLoadCDL)
 	{
@@ -289,7 +286,7 @@ CodeDataLoggerDialog_t::CodeDataLoggerDialog_t(QWidget *parent)
 //----------------------------------------------------
 CodeDataLoggerDialog_t::~CodeDataLoggerDialog_t(void)
 {
-	updateTimer->stop();
+	FrameDispatcher::instance()->removeView( this );
 
 	//printf("Code Data Logger Window Deleted\n");
 	cdlWin = NULL;
@@ -25,7 +25,6 @@ public:
 	~CodeDataLoggerDialog_t(void);
 
 protected:
-	QTimer *updateTimer;
 	QLabel *prgLoggedCodeLabel;
 	QLabel *prgLoggedDataLabel;
 	QLabel *prgUnloggedLabel;
@@ -67,6 +67,8 @@
 #include "../../asm.h"
 #include "../../ppu.h"
 #include "../../x6502.h"
+#include "../../guestprof.h"
+#include "../../reversedebug.h"
 #include "common/os_utils.h"
 #include "common/configSys.h"
 
@@ -214,6 +216,7 @@ ConsoleDebugger::ConsoleDebugger(QWidget *parent)
 	g_config->getOption("SDL.DebugAutoStartTraceLogger", &autoStartTraceLogger);
 
 	startedTraceLogger = false;
+	revCanStep = false;
 
 	if (autoStartTraceLogger)
 	{
@@ -262,6 +265,10 @@ ConsoleDebugger::~ConsoleDebugger(void)
 		break_on_unlogged_code = false;
 		break_on_unlogged_data = false;
 		FCEUI_Debugger().badopbreak = false;
+
+		FCEU_WRAPPER_LOCK();
+		FCEUI_SetReverseDebug(false);
+		FCEU_WRAPPER_UNLOCK();
 	}
 }
 //----------------------------------------------------------------------------
@@ -726,6 +733,26 @@ QMenuBar *ConsoleDebugger::buildMenuBar(void)
 
 	debugMenu->addAction(act);
 
+	// Debug -> Reverse Step
+	revStepAct = act = new QAction(tr("Reverse S&tep"), this);
+	act->setShortcut(QKeySequence( tr("Shift+F9") ) );
+	act->setStatusTip(tr("Go Back to the Previous Instruction"));
+	act->setIcon( style()->standardIcon( QStyle::SP_MediaSkipBackward ) );
+	act->setEnabled(false);
+	connect( act, SIGNAL(triggered()), this, SLOT(debugReverseStepCB(void)) );
+
+	debugMenu->addAction(act);
+
+	// Debug -> Reverse Continue
+	revContAct = act = new QAction(tr("Reverse &Continue"), this);
+	act->setShortcut(QKeySequence( tr("Shift+F5") ) );
+	act->setStatusTip(tr("Go Back to the Previous Breakpoint Hit"));
+	act->setIcon( style()->standardIcon( QStyle::SP_MediaSeekBackward ) );
+	act->setEnabled(false);
+	connect( act, SIGNAL(triggered()), this, SLOT(debugReverseContinueCB(void)) );
+
+	debugMenu->addAction(act);
+
 	// Debug -> Run to Selected Line
 	act = new QAction(tr("Run to S&elected Line"), this);
 	act->setShortcut(QKeySequence( tr("F1") ) );
@@ -813,6 +840,44 @@ QMenuBar *ConsoleDebugger::buildMenuBar(void)
 
 	subMenu->addAction(act);
 
+	subMenu = debugMenu->addMenu(tr("Re&verse Debugging"));
+
+	// Debug -> Reverse Debugging -> Record History
+	{
+		int enable = 0, interval = 30, budgetMB = 64;
+
+		g_config->getOption("SDL.DebuggerReverseDebug", &enable );
+		g_config->getOption("SDL.DebuggerReverseInterval", &interval );
+		g_config->getOption("SDL.DebuggerReverseBudgetMB", &budgetMB );
+
+		FCEU_WRAPPER_LOCK();
+		FCEUI_SetReverseDebugInterval( interval );
+		FCEUI_SetReverseDebugBudget( (size_t)budgetMB << 20 );
+		FCEUI_SetReverseDebug( enable );
+		FCEU_WRAPPER_UNLOCK();
+	}
+	act = new QAction(tr("&Record History"), this);
+	act->setStatusTip(tr("Keep Snapshots and Input to Step Back with"));
+	act->setCheckable(true);
+	act->setChecked( FCEUI_GetReverseDebug() );
+	connect( act, SIGNAL(triggered(bool)), this, SLOT(reverseDebugEnableCB(bool)) );
+
+	subMenu->addAction(act);
+
+	// Debug -> Reverse Debugging -> Snapshot Interval
+	act = new QAction(tr("Snapshot &Interval..."), this);
+	act->setStatusTip(tr("Frames Between Snapshots"));
+	connect( act, SIGNAL(triggered(void)), this, SLOT(reverseDebugIntervalCB(void)) );
+
+	subMenu->addAction(act);
+
+	// Debug -> Reverse Debugging -> Memory Budget
+	act = new QAction(tr("Memory &Budget..."), this);
+	act->setStatusTip(tr("Memory the History May Use"));
+	connect( act, SIGNAL(triggered(void)), this, SLOT(reverseDebugBudgetCB(void)) );
+
+	subMenu->addAction(act);
+
 	debugMenu->addSeparator();
 
 	// Debug -> Reset Counters
@@ -825,6 +890,13 @@ QMenuBar *ConsoleDebugger::buildMenuBar(void)
 
 	debugMenu->addAction(act);
 
+	// Debug -> Guest Profiler
+	act = new QAction(tr("Guest &Profiler..."), this);
+	act->setStatusTip(tr("Count the CPU cycles of each routine"));
+	connect( act, SIGNAL(triggered(void)), this, SLOT(openGuestProfilerCB(void)) );
+
+	debugMenu->addAction(act);
+
 	// Options
 	optMenu = menuBar->addMenu(tr("&Options"));
 
@@ -1051,6 +1123,7 @@ void ConsoleDebugger::buildAsmViewDisplay(void)
 	hbar       = new QScrollBar( Qt::Horizontal, this );
 	asmLineSelLbl = new QLabel( tr("Line Select") );
 	emuStatLbl    = new QLabel( tr("Emulator is Running") );
+	revStatLbl    = new QLabel();
 
 	asmLineSelLbl->setWordWrap( true );
 
@@ -1070,6 +1143,7 @@ void ConsoleDebugger::buildAsmViewDisplay(void)
 	asmDpyVbox->addLayout( grid, 100 );
 	asmDpyVbox->addWidget( asmLineSelLbl, 1 );
 	asmDpyVbox->addWidget( emuStatLbl   , 1 );
+	asmDpyVbox->addWidget( revStatLbl   , 1 );
 	
 	asmViewContainerWidget = new QWidget();
 	asmViewContainerWidget->setLayout( asmDpyVbox );
@@ -2350,6 +2424,8 @@ void ConsoleDebugger::openDebugSymbolEditWindow( int addr )
 	if ( ret == QDialog::Accepted )
 	{
 		FCEU_WRAPPER_LOCK();
+		// the dialog may have changed the symbol in place
+		asmView->invalidateAsmCache();
 		asmView->updateAssemblyView();
 		FCEU_WRAPPER_UNLOCK();
 	}
@@ -2453,6 +2529,17 @@ void ConsoleDebugger::bpListUpdate( bool reset )
 		item->setTextAlignment( 1, Qt::AlignLeft);
 		item->setTextAlignment( 2, Qt::AlignLeft);
 		item->setTextAlignment( 3, Qt::AlignLeft);
+
+		QString stats = tr("Hits: %1").arg( watchpoint[i].hitCount );
+
+		if ( watchpoint[i].cond )
+		{
+			stats += tr("\nCondition evaluations: %1").arg( watchpoint[i].evalCount );
+		}
+		for (int j=0; j<4; j++)
+		{
+			item->setToolTip( j, stats );
+		}
 	}
 
 	bpTree->viewport()->update();
@@ -2652,6 +2739,8 @@ static void DeleteBreak(int sel)
 		watchpoint[i].condText = watchpoint[i+1].condText;
 		watchpoint[i].desc = watchpoint[i+1].desc;
 // ################################## End of SP CODE ###########################
+		watchpoint[i].hitCount = watchpoint[i+1].hitCount;
+		watchpoint[i].evalCount = watchpoint[i+1].evalCount;
 	}
 	// erase last BP item
 	watchpoint[numWPs].address = 0;
@@ -2660,6 +2749,8 @@ static void DeleteBreak(int sel)
 	watchpoint[numWPs].cond = 0;
 	watchpoint[numWPs].condText = 0;
 	watchpoint[numWPs].desc = 0;
+	watchpoint[numWPs].hitCount = 0;
+	watchpoint[numWPs].evalCount = 0;
 	numWPs--;
 
 	FCEU_WRAPPER_UNLOCK();
@@ -2697,6 +2788,8 @@ void debuggerClearAllBreakpoints(void)
 	   watchpoint[i].cond = 0;
 	   watchpoint[i].condText = 0;
 	   watchpoint[i].desc = 0;
+	   watchpoint[i].hitCount = 0;
+	   watchpoint[i].evalCount = 0;
 	}
 	numWPs = 0;
 
@@ -3105,6 +3198,26 @@ void ConsoleDebugger::debugStepBackCB(void)
 	}
 }
 //----------------------------------------------------------------------------
+void ConsoleDebugger::debugReverseStepCB(void)
+{
+	if (FCEUI_EmulationPaused())
+	{
+		FCEU_WRAPPER_LOCK();
+		FCEUI_ReverseStep();
+		FCEU_WRAPPER_UNLOCK();
+	}
+}
+//----------------------------------------------------------------------------
+void ConsoleDebugger::debugReverseContinueCB(void)
+{
+	if (FCEUI_EmulationPaused())
+	{
+		FCEU_WRAPPER_LOCK();
+		FCEUI_ReverseContinue();
+		FCEU_WRAPPER_UNLOCK();
+	}
+}
+//----------------------------------------------------------------------------
 void ConsoleDebugger::debugRunToCursorCB(void)
 {
 	asmView->setBreakpointAtSelectedLine();
@@ -3414,6 +3527,58 @@ void ConsoleDebugger::resetCountersCB (void)
 	updateRegisterView();
 }
 //----------------------------------------------------------------------------
+void ConsoleDebugger::reverseDebugEnableCB(bool value)
+{
+	FCEU_WRAPPER_LOCK();
+	FCEUI_SetReverseDebug( value );
+	FCEU_WRAPPER_UNLOCK();
+
+	g_config->setOption("SDL.DebuggerReverseDebug", value );
+}
+//----------------------------------------------------------------------------
+void ConsoleDebugger::reverseDebugIntervalCB(void)
+{
+	bool ok = false;
+	int frames = QInputDialog::getInt( this, tr("Reverse Debugging"),
+			tr("Frames between snapshots, the fewer the faster a step back:"),
+			FCEUI_GetReverseDebugInterval(), 1, 3600, 1, &ok );
+
+	if ( !ok )
+	{
+		return;
+	}
+	FCEU_WRAPPER_LOCK();
+	FCEUI_SetReverseDebugInterval( frames );
+	FCEU_WRAPPER_UNLOCK();
+
+	g_config->setOption("SDL.DebuggerReverseInterval", frames );
+}
+//----------------------------------------------------------------------------
+void ConsoleDebugger::reverseDebugBudgetCB(void)
+{
+	bool ok = false;
+	int budgetMB = QInputDialog::getInt( this, tr("Reverse Debugging"),
+			tr("Memory for snapshots and input, in MB:"),
+			(int)(FCEUI_GetReverseDebugBudget() >> 20), 1, 65536, 1, &ok );
+
+	if ( !ok )
+	{
+		return;
+	}
+	FCEU_WRAPPER_LOCK();
+	FCEUI_SetReverseDebugBudget( (size_t)budgetMB << 20 );
+	FCEU_WRAPPER_UNLOCK();
+
+	g_config->setOption("SDL.DebuggerReverseBudgetMB", budgetMB );
+}
+//----------------------------------------------------------------------------
+void ConsoleDebugger::openGuestProfilerCB(void)
+{
+	GuestProfilerDialog *win = new GuestProfilerDialog(this);
+
+	win->show();
+}
+//----------------------------------------------------------------------------
 void ConsoleDebugger::asmViewCtxMenuRunToCursor(void)
 {
 	FCEU_WRAPPER_LOCK();
@@ -3824,7 +3989,9 @@ static int InstructionUp(int from)
 void  QAsmView::updateAssemblyView(void)
 {
 	int starting_address, start_address_lp, addr, size;
-	int instruction_addr, asmFlags = 0;
+	int instruction_addr, asmFlags = 0, cacheMode;
+	size_t textStart;
+	bool useCache;
 	std::string line;
 	char chr[64];
 	uint8 opcode[3];
@@ -3874,6 +4041,19 @@ void  QAsmView::updateAssemblyView(void)
 		asmFlags |= ASM_DEBUG_TRACES;
 	}
 
+	// Lines are only decoded again where the bytes changed, or a bank switch
+	// put others there. Trace data shows live registers and memory, so with
+	// it on every line is.
+	useCache = !showTraceData;
+	cacheMode = asmFlags | (showByteCodes ? 0x10000 : 0) | (displayROMoffsets ? 0x20000 : 0);
+
+	if ( (cacheMode != asmCacheMode) || (debugSymbolTable.serial() != asmCacheSymSerial) )
+	{
+		asmCache.clear();
+		asmCacheMode = cacheMode;
+		asmCacheSymSerial = debugSymbolTable.serial();
+	}
+
 	for (int i=0; i < 0xFFFF; i++)
 	{
 		line.clear();
@@ -3881,7 +4061,7 @@ void  QAsmView::updateAssemblyView(void)
 		// PC pointer
 		if (addr > 0xFFFF) break;
 
-		a = new dbg_asm_entry_t;
+		a = asmAlloc();
 
 		if (cdloggerdataSize)
 		{
@@ -3958,51 +4138,108 @@ void  QAsmView::updateAssemblyView(void)
 		{
 			snprintf(chr, sizeof(chr), "  :%04X: ", addr);
 		}
-		line.append(chr);
 
-		a->size = size = opsize[GetMem(addr)];
+		const asmCacheEntry_t *ce = NULL;
+		uint32_t cacheKey = ((a->bank + 1) << 16) | addr;
 
-		if (size == 0)
+		if ( useCache )
 		{
-			snprintf(chr, sizeof(chr), "%02X        UNDEFINED", GetMem(addr++));
-			line.append(chr);
+			auto it = asmCache.find( cacheKey );
+
+			if ( it != asmCache.end() )
+			{
+				ce = &it->second;
+
+				for (int j=0; j<ce->memLen; j++)
+				{
+					if ( GetMem(addr+j) != ce->mem[j] )
+					{
+						ce = NULL; break;
+					}
+				}
+			}
+		}
+		textStart = line.size();
+
+		if ( ce != NULL )
+		{
+			line.append( ce->text );
+
+			a->size = ce->size;
+			a->sym  = ce->sym;
+
+			for (int j=0; j<3; j++)
+			{
+				a->opcode[j] = ce->opcode[j];
+			}
+			addr += ce->memLen;
 		}
 		else
 		{
-			if ((addr + size) > 0xFFFF)
+			line.append(chr);
+
+			a->size = size = opsize[GetMem(addr)];
+
+			if (size == 0)
+			{
+				snprintf(chr, sizeof(chr), "%02X        UNDEFINED", GetMem(addr++));
+				line.append(chr);
+			}
+			else
 			{
-				while (addr < 0xFFFF)
+				if ((addr + size) > 0xFFFF)
 				{
-					snprintf(chr, sizeof(chr), "%02X        OVERFLOW\n", GetMem(addr++));
-					line.append(chr);
+					while (addr < 0xFFFF)
+					{
+						snprintf(chr, sizeof(chr), "%02X        OVERFLOW\n", GetMem(addr++));
+						line.append(chr);
+					}
+					asmEntryPool.push_back(a);
+					break;
 				}
-				delete a;
-				break;
+				for (int j = 0; j < size; j++)
+				{
+					snprintf(chr, sizeof(chr), "%02X ", opcode[j] = GetMem(addr++));
+					if ( showByteCodes ) line.append(chr);
+				}
+				while (size < 3)
+				{
+					if ( showByteCodes ) line.append("   ");  //pad output to align ASM
+					size++;
+				}
+
+				DisassembleWithDebug(addr, opcode, asmFlags, asmTxt, &a->sym);
+
+				line.append( asmTxt );
 			}
-			for (int j = 0; j < size; j++)
+			for (int j=0; j<size; j++)
 			{
-				snprintf(chr, sizeof(chr), "%02X ", opcode[j] = GetMem(addr++));
-				if ( showByteCodes ) line.append(chr);
+				a->opcode[j] = opcode[j];
 			}
-			while (size < 3)
+
+			// special case: an RTS opcode
+			if (GetMem(instruction_addr) == 0x60)
 			{
-				if ( showByteCodes ) line.append("   ");  //pad output to align ASM
-				size++;
+				line.append(" -------------------------");
 			}
 
-			DisassembleWithDebug(addr, opcode, asmFlags, asmTxt, &a->sym);
-
-			line.append( asmTxt );
-		}
-		for (int j=0; j<size; j++)
-		{
-			a->opcode[j] = opcode[j];
-		}
+			if ( useCache )
+			{
+				asmCacheEntry_t &e = asmCache[ cacheKey ];
 
-		// special case: an RTS opcode
-		if (GetMem(instruction_addr) == 0x60)
-		{
-			line.append(" -------------------------");
+				e.memLen = addr - instruction_addr;
+				for (int j=0; j<e.memLen; j++)
+				{
+					e.mem[j] = GetMem(instruction_addr+j);
+				}
+				e.size = a->size;
+				for (int j=0; j<3; j++)
+				{
+					e.opcode[j] = a->opcode[j];
+				}
+				e.text.assign( line, textStart, std::string::npos );
+				e.sym = a->sym;
+			}
 		}
 
 		if ( symbolicDebugEnable )
@@ -4020,7 +4257,7 @@ void  QAsmView::updateAssemblyView(void)
 
 				if ( dbgSym->name().size() > 0 )
 				{
-					d = new dbg_asm_entry_t();
+					d = asmAlloc();
 
 					*d = *a;
 					d->type = dbg_asm_entry_t::SYMBOL_NAME;
@@ -4042,7 +4279,7 @@ void  QAsmView::updateAssemblyView(void)
 						{
 							stmp[j] = 0;
 
-							d = new dbg_asm_entry_t();
+							d = asmAlloc();
 
 							*d = *a;
 							d->type = dbg_asm_entry_t::SYMBOL_COMMENT;
@@ -4071,7 +4308,7 @@ void  QAsmView::updateAssemblyView(void)
 
 				if ( j > 0 )
 				{
-					d = new dbg_asm_entry_t();
+					d = asmAlloc();
 
 					*d = *a;
 					d->type = dbg_asm_entry_t::SYMBOL_COMMENT;
@@ -4463,6 +4700,35 @@ void ConsoleDebugger::updatePeriodic(void)
 		stepBackToolAct->setEnabled(false);
 	}
 
+	if ( FCEUI_GetReverseDebug() )
+	{
+		// the emulator thread is only waited on for as long as it is free
+		if ( FCEU_WRAPPER_TRYLOCK(0) )
+		{
+			FCEU_ReverseDebugStats rs;
+			char stmp[256];
+
+			FCEUI_ReverseDebugGetStats( rs );
+			revCanStep = FCEUI_ReverseDebugCanStep();
+			FCEU_WRAPPER_UNLOCK();
+
+			snprintf( stmp, sizeof(stmp), " History: %llu frames, %i snapshots, %.1f of %.0f MB  Replays: %llu, last %.1f ms, %.1f ms total",
+					(unsigned long long)rs.historyFrames, rs.snapshots,
+					(double)rs.memoryUsed / (1024.0 * 1024.0), (double)rs.memoryBudget / (1024.0 * 1024.0),
+					(unsigned long long)rs.replays, rs.lastReplayMs, rs.totalReplayMs );
+
+			revStatLbl->setText( tr(stmp) );
+		}
+		revStatLbl->setVisible(true);
+	}
+	else
+	{
+		revCanStep = false;
+		revStatLbl->setVisible(false);
+	}
+	revStepAct->setEnabled( revCanStep && FCEUI_EmulationPaused() );
+	revContAct->setEnabled( revCanStep && FCEUI_EmulationPaused() );
+
 	if ( waitingAtBp && (lastBpIdx == BREAK_TYPE_CYCLES_EXCEED) )
 	{
 		cpuCyclesLbl1->setStyleSheet("background-color: blue; color: white;");
@@ -8283,3 +8549,205 @@ void DebugBreakOnDialog::updateLabel(void)
 
 }
 //----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+//--- Guest Profiler
+//----------------------------------------------------------------------------
+GuestProfilerDialog::GuestProfilerDialog(QWidget *parent)
+	: QDialog(parent)
+{
+	QVBoxLayout *mainLayout;
+	QHBoxLayout *hbox;
+	QPushButton *btn;
+	QTabWidget  *tabs;
+	QTreeWidgetItem *hdr;
+
+	setWindowTitle( tr("Guest Profiler") );
+	resize( 640, 480 );
+
+	mainLayout = new QVBoxLayout();
+	hbox       = new QHBoxLayout();
+
+	enableBox = new QCheckBox( tr("Profile") );
+	FCEU_WRAPPER_LOCK();
+	enableBox->setChecked( FCEUI_GetGuestProfiler() );
+	FCEU_WRAPPER_UNLOCK();
+	hbox->addWidget( enableBox );
+
+	totalLbl = new QLabel();
+	hbox->addWidget( totalLbl, 1 );
+
+	btn = new QPushButton( tr("Reset") );
+	hbox->addWidget( btn );
+	connect( btn, SIGNAL(clicked(void)), this, SLOT(resetProfile(void)) );
+
+	btn = new QPushButton( tr("Export...") );
+	btn->setToolTip( tr("Save the call stacks in the collapsed format of flame graph tools") );
+	hbox->addWidget( btn );
+	connect( btn, SIGNAL(clicked(void)), this, SLOT(exportCollapsed(void)) );
+
+	mainLayout->addLayout( hbox );
+
+	routineTree = new QTreeWidget();
+	routineTree->setColumnCount(5);
+	routineTree->setRootIsDecorated(false);
+
+	hdr = new QTreeWidgetItem();
+	hdr->setText( 0, tr("Routine") );
+	hdr->setText( 1, tr("Inclusive") );
+	hdr->setText( 2, tr("%") );
+	hdr->setText( 3, tr("Self") );
+	hdr->setText( 4, tr("Calls") );
+	routineTree->setHeaderItem( hdr );
+
+	instrTree = new QTreeWidget();
+	instrTree->setColumnCount(3);
+	instrTree->setRootIsDecorated(false);
+
+	hdr = new QTreeWidgetItem();
+	hdr->setText( 0, tr("Address") );
+	hdr->setText( 1, tr("Cycles") );
+	hdr->setText( 2, tr("%") );
+	instrTree->setHeaderItem( hdr );
+
+	tabs = new QTabWidget();
+	tabs->addTab( routineTree, tr("Routines") );
+	tabs->addTab( instrTree, tr("Instructions") );
+	mainLayout->addWidget( tabs );
+
+	btn = new QPushButton( tr("Close") );
+	btn->setIcon( style()->standardIcon( QStyle::SP_DialogCloseButton ) );
+	connect( btn, SIGNAL(clicked(void)), this, SLOT(closeWindow(void)) );
+
+	hbox = new QHBoxLayout();
+	hbox->addStretch(5);
+	hbox->addWidget( btn, 1 );
+	mainLayout->addLayout( hbox );
+
+	setLayout( mainLayout );
+
+	connect( enableBox, SIGNAL(stateChanged(int)), this, SLOT(enableChanged(int)) );
+
+	updateTimer = new QTimer( this );
+	connect( updateTimer, &QTimer::timeout, this, &GuestProfilerDialog::updatePeriodic );
+	updateTimer->start( 500 );
+
+	updatePeriodic();
+}
+//----------------------------------------------------------------------------
+GuestProfilerDialog::~GuestProfilerDialog(void)
+{
+	updateTimer->stop();
+}
+//----------------------------------------------------------------------------
+void GuestProfilerDialog::closeEvent(QCloseEvent *event)
+{
+	done(0);
+	deleteLater();
+	event->accept();
+}
+//----------------------------------------------------------------------------
+void GuestProfilerDialog::closeWindow(void)
+{
+	done(0);
+	deleteLater();
+}
+//----------------------------------------------------------------------------
+void GuestProfilerDialog::enableChanged(int state)
+{
+	FCEU_WRAPPER_LOCK();
+	FCEUI_SetGuestProfiler( state != Qt::Unchecked );
+	FCEU_WRAPPER_UNLOCK();
+}
+//----------------------------------------------------------------------------
+void GuestProfilerDialog::resetProfile(void)
+{
+	FCEU_WRAPPER_LOCK();
+	FCEUI_ResetGuestProfile();
+	FCEU_WRAPPER_UNLOCK();
+
+	updatePeriodic();
+}
+//----------------------------------------------------------------------------
+void GuestProfilerDialog::exportCollapsed(void)
+{
+	QString filename;
+	bool ok;
+
+	filename = QFileDialog::getSaveFileName( this, tr("Export Call Stacks"), QString(),
+			tr("Collapsed Stacks (*.folded *.txt);;All files (*)") );
+
+	if ( filename.isEmpty() )
+	{
+		return;
+	}
+	FCEU_WRAPPER_LOCK();
+	ok = FCEU_GuestProfileWriteCollapsed( filename.toLocal8Bit().constData() );
+	FCEU_WRAPPER_UNLOCK();
+
+	if ( !ok )
+	{
+		QMessageBox::critical( this, tr("Guest Profiler"), tr("Could not write ") + filename );
+	}
+}
+//----------------------------------------------------------------------------
+void GuestProfilerDialog::updatePeriodic(void)
+{
+	std::vector <FCEU_GuestProfileEntry> routines, instrs;
+	uint64 total;
+	char stmp[64];
+
+	if ( !isVisible() )
+	{
+		return;
+	}
+	FCEU_WRAPPER_LOCK();
+	total = FCEU_GuestProfileTotal();
+	FCEU_GuestProfileRoutines( routines, 200 );
+	FCEU_GuestProfileInstructions( instrs, 200 );
+	FCEU_WRAPPER_UNLOCK();
+
+	snprintf( stmp, sizeof(stmp), "%llu cycles", (unsigned long long)total );
+	totalLbl->setText( tr(stmp) );
+
+	if ( total == 0 )
+	{
+		total = 1;
+	}
+
+	routineTree->clear();
+
+	for (size_t i=0; i<routines.size(); i++)
+	{
+		QTreeWidgetItem *item = new QTreeWidgetItem();
+		FCEU_GuestProfileEntry &e = routines[i];
+
+		item->setText( 0, QString::fromStdString(e.name) );
+		item->setText( 1, QString::number( (qulonglong)e.inclusive ) );
+		item->setText( 2, QString::number( 100.0 * e.inclusive / total, 'f', 1 ) );
+		item->setText( 3, QString::number( (qulonglong)e.cycles ) );
+		item->setText( 4, QString::number( (qulonglong)e.calls ) );
+
+		for (int j=1; j<5; j++)
+		{
+			item->setTextAlignment( j, Qt::AlignRight );
+		}
+		routineTree->addTopLevelItem( item );
+	}
+
+	instrTree->clear();
+
+	for (size_t i=0; i<instrs.size(); i++)
+	{
+		QTreeWidgetItem *item = new QTreeWidgetItem();
+		FCEU_GuestProfileEntry &e = instrs[i];
+
+		item->setText( 0, QString::fromStdString(e.name) );
+		item->setText( 1, QString::number( (qulonglong)e.cycles ) );
+		item->setText( 2, QString::number( 100.0 * e.cycles / total, 'f', 1 ) );
+
+		item->setTextAlignment( 1, Qt::AlignRight );
+		item->setTextAlignment( 2, Qt::AlignRight );
+		instrTree->addTopLevelItem( item );
+	}
+}
+//----------------------------------------------------------------------------
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <unordered_map>
 #include <QWidget>
 #include <QDialog>
 #include <QVBoxLayout>
@@ -70,6 +71,21 @@ struct dbg_asm_entry_t
 			opcode[i] = 0;
 		}
 	}
+
+	// as constructed, keeping the text buffer for reuse
+	void clear(void)
+	{
+		addr = 0; bank = -1; rom = -1;
+		size = 0; line =  0; type = ASM_TEXT;
+		bpNum = -1;
+
+		for (int i=0; i<3; i++)
+		{
+			opcode[i] = 0;
+		}
+		text.clear();
+		sym = debugSymbol_t();
+	}
 };
 
 struct dbg_nav_entry_t
@@ -127,6 +143,7 @@ class QAsmView : public QWidget
 		void setScrollBars( QScrollBar *h, QScrollBar *v );
 		void updateAssemblyView(void);
 		void asmClear(void);
+		void invalidateAsmCache(void);
 		int  getAsmLineFromAddr(int addr);
 		int  getAsmAddrFromLine(int line);
 		void setLine(int lineNum);
@@ -263,6 +280,23 @@ class QAsmView : public QWidget
 		bool  showTraceData;
 		bool  isPopUp;
 
+		dbg_asm_entry_t *asmAlloc(void);
+
+		// What the instruction at a bank and address came out as, reused
+		// while the bytes there and the display settings stay the same
+		struct asmCacheEntry_t
+		{
+			uint8  mem[3];  // the bytes it was decoded from
+			int    memLen;
+			int    size;
+			uint8  opcode[3];
+			std::string  text; // from the address on
+			debugSymbol_t  sym;
+		};
+		std::unordered_map <uint32_t, asmCacheEntry_t> asmCache;
+		std::vector <dbg_asm_entry_t*> asmEntryPool;
+		int  asmCacheMode;
+		unsigned int asmCacheSymSerial;
 };
 
 class DebuggerStackDisplay : public QPlainTextEdit
@@ -467,6 +501,31 @@ class DebuggerBreakpointEditor : public QDialog
 		void conditionTextChanged( const QString &text );
 };
 
+class GuestProfilerDialog : public QDialog
+{
+   Q_OBJECT
+
+	public:
+		GuestProfilerDialog(QWidget *parent = 0);
+		~GuestProfilerDialog(void);
+
+	protected:
+		void closeEvent(QCloseEvent *event) override;
+
+		QCheckBox   *enableBox;
+		QLabel      *totalLbl;
+		QTreeWidget *routineTree;
+		QTreeWidget *instrTree;
+		QTimer      *updateTimer;
+
+	private slots:
+		void closeWindow(void);
+		void updatePeriodic(void);
+		void enableChanged(int state);
+		void resetProfile(void);
+		void exportCollapsed(void);
+};
+
 class ConsoleDebugger : public QDialog
 {
    Q_OBJECT
@@ -551,6 +610,8 @@ class ConsoleDebugger : public QDialog
 		QAction   *brkOnInstrExcAct;
 		QAction   *stepBackMenuAct;
 		QAction   *stepBackToolAct;
+		QAction   *revStepAct;
+		QAction   *revContAct;
 
 		DebuggerTabWidget *tabView[2][4];
 		QWidget   *asmViewContainerWidget;
@@ -558,6 +619,7 @@ class ConsoleDebugger : public QDialog
 		QWidget   *bmTreeContainerWidget;
 		QWidget   *ppuStatContainerWidget;
 		QLabel    *emuStatLbl;
+		QLabel    *revStatLbl;
 		QLabel    *cpuCyclesLbl1;
 		QLabel    *cpuInstrsLbl1;
 		QTimer    *periodicTimer;
@@ -580,6 +642,7 @@ class ConsoleDebugger : public QDialog
 		enum QAsmView::UpdateType windowUpdateReq;
 
 		bool  startedTraceLogger;
+		bool  revCanStep;
 
 	private:
 		void setRegsFromEntry(void);
@@ -615,6 +678,8 @@ class ConsoleDebugger : public QDialog
 		void debugStepOutCB(void);
 		void debugStepOverCB(void);
 		void debugStepBackCB(void);
+		void debugReverseStepCB(void);
+		void debugReverseContinueCB(void);
 		void debugRunToCursorCB(void);
 		void debugRunLineCB(void);
 		void debugRunLine128CB(void);
@@ -631,6 +696,10 @@ class ConsoleDebugger : public QDialog
 		void setLayoutOption(int layout);
 		void resizeToMinimumSizeHint(void);
 		void resetCountersCB (void);
+		void openGuestProfilerCB(void);
+		void reverseDebugEnableCB(bool value);
+		void reverseDebugIntervalCB(void);
+		void reverseDebugBudgetCB(void);
 		void reloadSymbolsCB(void);
 		void saveSymbolsCB(void);
 		void displayByteCodesCB(bool value);
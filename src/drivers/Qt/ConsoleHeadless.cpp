@@ -0,0 +1,197 @@
+// ConsoleHeadless.cpp
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <csignal>
+
+#include <QCoreApplication>
+
+#include "Qt/nes_shm.h"
+#include "Qt/ConsoleHeadless.h"
+#include "Qt/ConsoleWindow.h"
+#include "Qt/fceuWrapper.h"
+#ifdef __FCEU_REST_API_ENABLE__
+#include "Qt/RestApi/FceuxApiServer.h"
+#endif
+#include "../../fceu.h"
+
+static ConsoleHeadless_t  *headless = nullptr;
+static std::atomic<bool>   quitRequested(false);
+
+// Only an atomic store is safe in a signal handler, the quit timer does the rest
+static void quitSignalHandler( int sig )
+{
+	(void)sig;
+	quitRequested.store( true );
+}
+
+//----------------------------------------------------------------------------
+bool ConsoleHeadless_t::requested( int argc, char *argv[] )
+{
+	// Takes a value like every other option, the config parser sees it again
+	for (int i=1; i<argc-1; i++)
+	{
+		if ( strcmp(argv[i], "--headless") == 0 )
+		{
+			return atoi(argv[i+1]) != 0;
+		}
+	}
+	return false;
+}
+//----------------------------------------------------------------------------
+void ConsoleHeadless_t::start(void)
+{
+	if ( headless != nullptr )
+	{
+		return;
+	}
+	headless = new ConsoleHeadless_t();
+
+	std::signal( SIGINT , quitSignalHandler );
+	std::signal( SIGTERM, quitSignalHandler );
+}
+//----------------------------------------------------------------------------
+void ConsoleHeadless_t::stop(void)
+{
+	if ( headless == nullptr )
+	{
+		return;
+	}
+	delete headless; headless = nullptr;
+}
+//----------------------------------------------------------------------------
+bool ConsoleHeadless_t::active(void)
+{
+	return headless != nullptr;
+}
+//----------------------------------------------------------------------------
+FCEU::mutex *ConsoleHeadless_t::emulatorMutex(void)
+{
+	return headless ? &headless->mutex : nullptr;
+}
+//----------------------------------------------------------------------------
+emulatorThread_t *ConsoleHeadless_t::emulatorThread(void)
+{
+	return headless ? headless->emuThread : nullptr;
+}
+//----------------------------------------------------------------------------
+void ConsoleHeadless_t::requestQuit(void)
+{
+	quitRequested.store( true );
+}
+//----------------------------------------------------------------------------
+ConsoleHeadless_t::ConsoleHeadless_t(void)
+	: QObject(nullptr)
+{
+	emuThread = new emulatorThread_t(this);
+
+	connect(emuThread, SIGNAL(loadRomRequest(QString)), this, SLOT(loadRomRequestCB(QString)) );
+
+	// frameFinished is left unconnected, there is no viewer to wake
+	emuThread->start();
+
+	quitTimer = new QTimer(this);
+
+	connect( quitTimer, &QTimer::timeout, this, &ConsoleHeadless_t::checkQuit );
+
+	quitTimer->start( 100 );
+
+#ifdef __FCEU_REST_API_ENABLE__
+	apiServer = nullptr;
+
+	bool restApiEnabled = false;
+	g_config->getOption("SDL.RestApiEnabled", &restApiEnabled);
+
+	if ( restApiEnabled )
+	{
+		apiServer = new FceuxApiServer(this);
+
+		connect(apiServer, &RestApiServer::errorOccurred, this, [](const QString& error)
+		{
+			// Nothing else controls a headless fceux, so it does not keep running without the server
+			fprintf(stderr, "REST API Error: %s\n", error.toLocal8Bit().constData());
+			quitRequested.store( true );
+		});
+
+		apiServer->setConfig( consoleWin_t::loadRestApiConfig() );
+
+		if ( apiServer->start() )
+		{
+			RestApiConfig config = apiServer->getConfig();
+
+			FCEU_printf("REST API server started on %s:%d\n",
+				config.bindAddress.toLocal8Bit().constData(), config.port);
+		}
+		else
+		{
+			quitRequested.store( true );
+		}
+	}
+	else
+	{
+		FCEU_printf("Headless: the REST API server is disabled (SDL.RestApiEnabled)\n");
+	}
+#endif
+}
+//----------------------------------------------------------------------------
+ConsoleHeadless_t::~ConsoleHeadless_t(void)
+{
+	quitTimer->stop();
+
+	if ( emuThread->isRunning() )
+	{
+		closeApp();
+	}
+}
+//----------------------------------------------------------------------------
+void ConsoleHeadless_t::closeApp(void)
+{
+	quitTimer->stop();
+
+#ifdef __FCEU_REST_API_ENABLE__
+	// Requests in flight still get the emulator thread to answer them
+	if ( apiServer )
+	{
+		apiServer->stop();
+		delete apiServer; apiServer = nullptr;
+	}
+#endif
+
+	nes_shm->runEmulator = 0;
+
+	emuThread->quit();
+	emuThread->wait( 1000 );
+
+	FCEU_WRAPPER_LOCK();
+	fceuWrapperClose();
+	FCEU_WRAPPER_UNLOCK();
+
+	// LoadGame() checks for an IP and if it finds one begins a network session
+	// clear the NetworkIP field so this doesn't happen unintentionally
+	g_config->setOption ("SDL.NetworkIP", "");
+	g_config->save ();
+}
+//----------------------------------------------------------------------------
+void ConsoleHeadless_t::loadRomRequestCB( QString s )
+{
+	printf("Load ROM Req: '%s'\n", s.toLocal8Bit().constData() );
+	FCEU_WRAPPER_LOCK();
+	CloseGame ();
+	LoadGame ( s.toLocal8Bit().constData() );
+	FCEU_WRAPPER_UNLOCK();
+}
+//----------------------------------------------------------------------------
+void ConsoleHeadless_t::checkQuit(void)
+{
+	if ( !quitRequested.load() )
+	{
+		return;
+	}
+	closeApp();
+
+	QCoreApplication::quit();
+}
+//----------------------------------------------------------------------------
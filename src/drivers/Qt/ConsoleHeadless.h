@@ -0,0 +1,60 @@
+// ConsoleHeadless.h
+//
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include "utils/mutex.h"
+
+// Headless console (--headless 1): only a QCoreApplication, the emulator
+// thread and the REST API server. No console window, viewer, menus, dialogs
+// or GL context are made, so no display server is needed. The emulator
+// thread runs as it does under the console window, the picture stays in
+// XBuf where the REST screenshot and frame hash commands read it, and the
+// viewer's blit is skipped since nothing shows it. The throttle stays on,
+// --computeonly 1 runs unthrottled. SIGINT and SIGTERM close the game and
+// quit as File -> Quit would.
+class emulatorThread_t;
+class FceuxApiServer;
+
+class ConsoleHeadless_t : public QObject
+{
+	Q_OBJECT
+
+	public:
+		// Before the application object is made, --headless on the command line
+		static bool requested( int argc, char *argv[] );
+
+		// After fceuWrapperInit, on the main thread
+		static void start(void);
+		static void stop(void);
+
+		static bool active(void);
+
+		// What the console window provides otherwise, nullptr when not active
+		static FCEU::mutex *emulatorMutex(void);
+		static emulatorThread_t *emulatorThread(void);
+
+		// Any thread
+		static void requestQuit(void);
+
+	protected:
+		ConsoleHeadless_t(void);
+		~ConsoleHeadless_t(void);
+
+		void closeApp(void);
+
+		FCEU::mutex       mutex;
+		emulatorThread_t *emuThread;
+		QTimer           *quitTimer;
+#ifdef __FCEU_REST_API_ENABLE__
+		FceuxApiServer   *apiServer;
+#endif
+
+	private slots:
+		void loadRomRequestCB( QString s );
+		void checkQuit(void);
+};
@@ -0,0 +1,395 @@
+// ConsoleKiosk.cpp
+//
+#include <stdio.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include <QCoreApplication>
+#include <QOpenGLFunctions>
+#include <QSurfaceFormat>
+
+#include "Qt/nes_shm.h"
+#include "Qt/throttle.h"
+#include "Qt/keyscan.h"
+#include "Qt/ConsoleKiosk.h"
+#include "Qt/ConsoleWindow.h"
+#include "Qt/fceuWrapper.h"
+
+static ConsoleKiosk_t    *kiosk = nullptr;
+static std::atomic<bool>  kioskActive(false);
+
+// The handoff from the emulator thread, the render thread sleeps on it
+static std::mutex              frameMutex;
+static std::condition_variable frameCond;
+static bool                    framePending = false;
+
+// Plain GLSL ES 1.0, so the same program runs on desktop GL and on the GLES
+// of an eglfs board. The picture is BGRA, uploaded as RGBA and swizzled back
+// here, as GLES has no BGRA upload.
+static const char *kioskVertSrc =
+	"attribute vec2 pos;\n"
+	"attribute vec2 uv;\n"
+	"varying vec2 texCoord;\n"
+	"void main()\n"
+	"{\n"
+	"	texCoord = uv;\n"
+	"	gl_Position = vec4( pos, 0.0, 1.0 );\n"
+	"}\n";
+
+static const char *kioskFragSrc =
+	"#ifdef GL_ES\n"
+	"precision mediump float;\n"
+	"#endif\n"
+	"uniform sampler2D frame;\n"
+	"varying vec2 texCoord;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = vec4( texture2D( frame, texCoord ).bgr, 1.0 );\n"
+	"}\n";
+
+//----------------------------------------------------------------------------
+bool ConsoleKiosk_t::start( QScreen *screen )
+{
+	int swapInterval = 1;
+
+	if ( kiosk != nullptr )
+	{
+		return true;
+	}
+	g_config->getOption("SDL.KioskSwapInterval", &swapInterval);
+
+	kiosk = new ConsoleKiosk_t( screen );
+
+	QSurfaceFormat fmt = QSurfaceFormat::defaultFormat();
+
+	fmt.setSwapInterval( swapInterval );
+	fmt.setSwapBehavior( QSurfaceFormat::DoubleBuffer );
+
+	kiosk->setFormat( fmt );
+	kiosk->create();
+
+	QOpenGLContext *context = new QOpenGLContext();
+
+	context->setFormat( kiosk->requestedFormat() );
+	context->setScreen( screen );
+
+	if ( !context->create() )
+	{
+		fprintf(stderr, "Kiosk: cannot create an OpenGL context, using the console window\n");
+		delete context;
+		delete kiosk; kiosk = nullptr;
+		return false;
+	}
+	kiosk->render = new ConsoleKioskRender_t( kiosk, context );
+
+	// made current on the render thread only
+	context->moveToThread( kiosk->render );
+
+	kioskActive = true;
+
+	kiosk->setCursor( Qt::BlankCursor );
+	kiosk->showFullScreen();
+
+	printf("Kiosk: presenting on %s, swap interval %i\n",
+			screen->name().toLocal8Bit().constData(), swapInterval );
+	return true;
+}
+//----------------------------------------------------------------------------
+void ConsoleKiosk_t::stop(void)
+{
+	if ( kiosk == nullptr )
+	{
+		return;
+	}
+	kioskActive = false;
+
+	kiosk->render->requestQuit();
+	kiosk->render->wait();
+
+	delete kiosk; kiosk = nullptr;
+}
+//----------------------------------------------------------------------------
+bool ConsoleKiosk_t::active(void)
+{
+	return kioskActive.load( std::memory_order_relaxed );
+}
+//----------------------------------------------------------------------------
+void ConsoleKiosk_t::frameReady(void)
+{
+	if ( kioskActive.load( std::memory_order_relaxed ) )
+	{
+		ConsoleKioskRender_t::frameReady();
+	}
+}
+//----------------------------------------------------------------------------
+ConsoleKiosk_t::ConsoleKiosk_t( QScreen *screen )
+	: QWindow( screen ), render(nullptr)
+{
+	setSurfaceType( QWindow::OpenGLSurface );
+	setTitle( QString("FCEUX") );
+}
+//----------------------------------------------------------------------------
+ConsoleKiosk_t::~ConsoleKiosk_t(void)
+{
+	if ( render )
+	{
+		delete render; render = nullptr;
+	}
+}
+//----------------------------------------------------------------------------
+void ConsoleKiosk_t::keyPressEvent(QKeyEvent *event)
+{
+	pushKeyEvent( event, 1 );
+
+	event->accept();
+}
+//----------------------------------------------------------------------------
+void ConsoleKiosk_t::keyReleaseEvent(QKeyEvent *event)
+{
+	pushKeyEvent( event, 0 );
+
+	event->accept();
+}
+//----------------------------------------------------------------------------
+void ConsoleKiosk_t::exposeEvent(QExposeEvent *event)
+{
+	if ( !isExposed() || (render == nullptr) )
+	{
+		return;
+	}
+	render->setViewSize( width() * devicePixelRatio(), height() * devicePixelRatio() );
+
+	// swapping to a window that is not on screen yet is undefined
+	if ( !render->isRunning() && !render->isFinished() )
+	{
+		render->start( QThread::HighestPriority );
+	}
+}
+//----------------------------------------------------------------------------
+void ConsoleKiosk_t::resizeEvent(QResizeEvent *event)
+{
+	if ( render )
+	{
+		render->setViewSize( width() * devicePixelRatio(), height() * devicePixelRatio() );
+	}
+}
+//----------------------------------------------------------------------------
+bool ConsoleKiosk_t::event(QEvent *event)
+{
+	if ( event->type() == QEvent::Close )
+	{
+		// the window goes with the application
+		if ( consoleWindow )
+		{
+			consoleWindow->requestClose();
+		}
+		event->ignore();
+		return true;
+	}
+	return QWindow::event(event);
+}
+//----------------------------------------------------------------------------
+ConsoleKioskRender_t::ConsoleKioskRender_t( ConsoleKiosk_t *win, QOpenGLContext *ctx )
+	: window(win), context(ctx), prog(nullptr), texture(0), texWidth(0), texHeight(0),
+	  picWidth(0), picHeight(0), linearFilter(false), quit(false), redraw(true),
+	  viewWidth(0), viewHeight(0)
+{
+	setObjectName( QString("KioskRender") );
+
+	g_config->getOption("SDL.OpenGLip", &linearFilter);
+}
+//----------------------------------------------------------------------------
+ConsoleKioskRender_t::~ConsoleKioskRender_t(void)
+{
+	delete context;
+}
+//----------------------------------------------------------------------------
+void ConsoleKioskRender_t::frameReady(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(frameMutex);
+
+		framePending = true;
+	}
+	frameCond.notify_one();
+}
+//----------------------------------------------------------------------------
+void ConsoleKioskRender_t::requestQuit(void)
+{
+	quit = true;
+
+	frameReady();
+}
+//----------------------------------------------------------------------------
+void ConsoleKioskRender_t::run(void)
+{
+	if ( !context->makeCurrent( window ) )
+	{
+		fprintf(stderr, "Kiosk: cannot make the OpenGL context current\n");
+		return;
+	}
+	QOpenGLFunctions *gl = context->functions();
+
+	prog = new QOpenGLShaderProgram();
+
+	if ( !prog->addShaderFromSourceCode( QOpenGLShader::Vertex, kioskVertSrc ) ||
+	     !prog->addShaderFromSourceCode( QOpenGLShader::Fragment, kioskFragSrc ) ||
+	     !prog->link() )
+	{
+		fprintf(stderr, "Kiosk: shader failed to build: %s\n",
+				prog->log().toLocal8Bit().constData() );
+		quit = true;
+	}
+	gl->glGenTextures( 1, &texture );
+	gl->glBindTexture( GL_TEXTURE_2D, texture );
+
+	gl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, linearFilter ? GL_LINEAR : GL_NEAREST );
+	gl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, linearFilter ? GL_LINEAR : GL_NEAREST );
+	gl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	gl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+	while ( !quit )
+	{
+		{
+			std::unique_lock<std::mutex> lock(frameMutex);
+
+			// the timeout only picks up redraws of a paused picture
+			frameCond.wait_for( lock, std::chrono::milliseconds(50), []{ return framePending; } );
+			framePending = false;
+		}
+		if ( quit )
+		{
+			break;
+		}
+		bool newFrame = uploadFrame();
+
+		if ( !redraw.exchange(false) && !newFrame )
+		{
+			continue;
+		}
+		double start = getHighPrecTimeStamp();
+
+		drawFrame();
+
+		context->swapBuffers( window );
+
+		// The swap is only queued. Waiting for it to complete keeps no frame
+		// queued behind it, and makes the swap mark the time of the flip.
+		gl->glFinish();
+
+		videoBufferSwapMark();
+
+		recordFrameStage( FRAME_STAGE_PRESENT, getHighPrecTimeStamp() - start );
+	}
+	gl->glDeleteTextures( 1, &texture ); texture = 0;
+
+	delete prog; prog = nullptr;
+
+	context->doneCurrent();
+
+	// handed back, so the GUI thread can delete it
+	context->moveToThread( QCoreApplication::instance()->thread() );
+}
+//----------------------------------------------------------------------------
+bool ConsoleKioskRender_t::uploadFrame(void)
+{
+	QOpenGLFunctions *gl = context->functions();
+	FCEU::autoScopedLock lock(consoleWindow->videoBufferMutex);
+
+	if ( !nes_shm->blitUpdated )
+	{
+		return false;
+	}
+	nes_shm->blitUpdated = 0;
+
+	inputTransferMark();
+
+	int w = nes_shm->video.ncol;
+	int h = nes_shm->video.nrow;
+	int bufIdx = nes_shm->pixBufIdx - 1;
+
+	if ( (w <= 0) || (h <= 0) || ((w * h) > 1048576) )
+	{
+		return false;
+	}
+	if ( bufIdx < 0 )
+	{
+		bufIdx = NES_VIDEO_BUFLEN-1;
+	}
+	gl->glBindTexture( GL_TEXTURE_2D, texture );
+
+	// Copies out of pixbuf before it returns, so the lock covers the upload only
+	if ( (w != texWidth) || (h != texHeight) )
+	{
+		gl->glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, nes_shm->pixbuf[bufIdx] );
+		texWidth  = w;
+		texHeight = h;
+	}
+	else
+	{
+		gl->glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, w, h,
+				GL_RGBA, GL_UNSIGNED_BYTE, nes_shm->pixbuf[bufIdx] );
+	}
+
+	// the prescalers scale both ways alike, the picture keeps its proportions
+	picWidth  = w;
+	picHeight = h;
+
+	return true;
+}
+//----------------------------------------------------------------------------
+void ConsoleKioskRender_t::drawFrame(void)
+{
+	static const GLfloat pos[] = { -1.0f, -1.0f,   1.0f, -1.0f,   -1.0f, 1.0f,   1.0f, 1.0f };
+	static const GLfloat uv[]  = {  0.0f,  1.0f,   1.0f,  1.0f,    0.0f, 0.0f,   1.0f, 0.0f };
+
+	QOpenGLFunctions *gl = context->functions();
+	int vw = viewWidth.load();
+	int vh = viewHeight.load();
+
+	gl->glViewport( 0, 0, vw, vh );
+	gl->glClearColor( 0.0f, 0.0f, 0.0f, 1.0f );
+	gl->glClear( GL_COLOR_BUFFER_BIT );
+
+	if ( (picWidth <= 0) || (picHeight <= 0) || (prog == nullptr) )
+	{
+		return;
+	}
+	// Fit the screen, centred
+	double scale = (double)vw / (double)picWidth;
+
+	if ( (picHeight * scale) > vh )
+	{
+		scale = (double)vh / (double)picHeight;
+	}
+	int rw = (int)(picWidth  * scale);
+	int rh = (int)(picHeight * scale);
+
+	gl->glViewport( (vw - rw) / 2, (vh - rh) / 2, rw, rh );
+
+	gl->glActiveTexture( GL_TEXTURE0 );
+	gl->glBindTexture( GL_TEXTURE_2D, texture );
+
+	prog->bind();
+	prog->setUniformValue( "frame", 0 );
+
+	int posLoc = prog->attributeLocation( "pos" );
+	int uvLoc  = prog->attributeLocation( "uv" );
+
+	prog->enableAttributeArray( posLoc );
+	prog->enableAttributeArray( uvLoc );
+	prog->setAttributeArray( posLoc, GL_FLOAT, pos, 2 );
+	prog->setAttributeArray( uvLoc,  GL_FLOAT, uv,  2 );
+
+	gl->glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+
+	prog->disableAttributeArray( posLoc );
+	prog->disableAttributeArray( uvLoc );
+	prog->release();
+
+	nes_shm->render_count++;
+}
+//----------------------------------------------------------------------------
@@ -0,0 +1,88 @@
+// ConsoleKiosk.h
+//
+
+#pragma once
+
+#include <atomic>
+
+#include <QWindow>
+#include <QThread>
+#include <QScreen>
+#include <QKeyEvent>
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+
+// Kiosk presentation: the picture goes to a fullscreen OpenGL window of its
+// own instead of the console window's viewer. A render thread waits on the
+// emulator thread's frame handoff, uploads the newest picture straight out
+// of nes_shm, swaps with the configured swap interval and waits for the swap
+// to complete, so the throttle's display sync is fed the time of the flip
+// and a busy GUI thread never holds a frame back. Run on the eglfs platform
+// (-platform eglfs) Qt puts this window on a DRM/KMS plane with no
+// compositor in between; on a desktop it is a plain fullscreen surface,
+// which most compositors unredirect.
+class ConsoleKioskRender_t;
+
+class ConsoleKiosk_t : public QWindow
+{
+	Q_OBJECT
+
+	public:
+		// GUI thread. False when the window or its context could not be made,
+		// the console window's viewer is used then.
+		static bool start( QScreen *screen );
+		static void stop(void);
+
+		// The kiosk takes the frames the console viewer would get otherwise
+		static bool active(void);
+
+		// Emulator thread, once a picture has been handed to nes_shm
+		static void frameReady(void);
+
+	protected:
+		ConsoleKiosk_t( QScreen *screen );
+		~ConsoleKiosk_t(void);
+
+		void keyPressEvent(QKeyEvent *event) override;
+		void keyReleaseEvent(QKeyEvent *event) override;
+		void exposeEvent(QExposeEvent *event) override;
+		void resizeEvent(QResizeEvent *event) override;
+		bool event(QEvent *event) override;
+
+		ConsoleKioskRender_t *render;
+};
+
+class ConsoleKioskRender_t : public QThread
+{
+	public:
+		ConsoleKioskRender_t( ConsoleKiosk_t *window, QOpenGLContext *context );
+		~ConsoleKioskRender_t(void);
+
+		void requestQuit(void);
+		void requestRedraw(void){ redraw = true; frameReady(); };
+		void setViewSize( int w, int h ){ viewWidth = w; viewHeight = h; requestRedraw(); };
+
+		static void frameReady(void);
+
+	protected:
+		void run(void) override;
+
+		bool uploadFrame(void);
+		void drawFrame(void);
+
+		ConsoleKiosk_t *window;
+		QOpenGLContext *context;
+		QOpenGLShaderProgram *prog;
+
+		unsigned int texture;
+		int  texWidth;
+		int  texHeight;
+		int  picWidth;
+		int  picHeight;
+		bool linearFilter;
+
+		std::atomic<bool> quit;
+		std::atomic<bool> redraw;
+		std::atomic<int>  viewWidth;
+		std::atomic<int>  viewHeight;
+};
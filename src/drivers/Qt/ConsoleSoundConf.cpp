@@ -138,6 +138,28 @@ ConsoleSndConfDialog_t::ConsoleSndConfDialog_t(QWidget *parent)
 
 	connect(bufSizeSlider, SIGNAL(valueChanged(int)), this, SLOT(bufSizeChanged(int)));
 
+	// Latency Target Select
+	//
+	hbox2 = new QHBoxLayout();
+
+	lbl = new QLabel(tr("Latency Target (in ms):"));
+	lbl->setToolTip( tr("Buffer fill the sample rate is adjusted to hold, by at most 0.5%.\n\nLower is tighter audio to video sync, too low starves the audio sink.") );
+
+	latencyLabel = new QLabel("20");
+	latencySlider = new QSlider(Qt::Horizontal);
+
+	latencySlider->setMinimum(5);
+	latencySlider->setMaximum(200);
+	setSliderFromProperty(latencySlider, latencyLabel, "SDL.Sound.Latency");
+
+	hbox2->addWidget(lbl);
+	hbox2->addWidget(latencyLabel);
+
+	vbox1->addLayout(hbox2);
+	vbox1->addWidget(latencySlider);
+
+	connect(latencySlider, SIGNAL(valueChanged(int)), this, SLOT(latencyChanged(int)));
+
 	bufUsage = new QProgressBar();
 	bufUsage->setToolTip( tr("% use of audio samples FIFO buffer.\n\nThe emulation thread fills the buffer and the audio thread drains it.") );
 	bufUsage->setOrientation( Qt::Horizontal );
@@ -272,9 +294,13 @@ ConsoleSndConfDialog_t::ConsoleSndConfDialog_t(QWidget *parent)
 	resetCountBtn->setIcon(style()->standardIcon(QStyle::SP_DialogResetButton));
 	connect(resetCountBtn, SIGNAL(clicked(void)), this, SLOT(resetCounters(void)));
 
+	latencyLbl = new QLabel( tr("Latency:") );
+	latencyLbl->setToolTip( tr("Time from the emulator writing a sample to the audio device playing it, which is how far sound lags the picture, and the current resampling adjustment.") );
+
 	hbox = new QHBoxLayout();
 	hbox->addWidget(resetCountBtn, 1);
 	hbox->addWidget(starveLbl,1);
+	hbox->addWidget(latencyLbl,1);
 	hbox->addStretch(5);
 	hbox->addWidget( closeButton, 1 );
 
@@ -336,6 +362,14 @@ void ConsoleSndConfDialog_t::periodicUpdate(void)
 
 	starveLbl->setText( tr(stmp) );
 
+	struct soundLatencyStat_t latency;
+
+	GetSoundLatencyStats( &latency );
+
+	snprintf( stmp, sizeof(stmp), "Latency: %.1f ms  Rate: %+.2f%%", latency.average * 1e3, (latency.rateRatio - 1.0) * 100.0 );
+
+	latencyLbl->setText( tr(stmp) );
+
 	if ( FCEUD_SoundIsMuted() != muteChkbox->isChecked() )
 	{
 		muteChkbox->setChecked( FCEUD_SoundIsMuted() );
@@ -418,6 +452,24 @@ void ConsoleSndConfDialog_t::bufSizeChanged(int value)
 	}
 }
 //----------------------------------------------------
+void ConsoleSndConfDialog_t::latencyChanged(int value)
+{
+	char stmp[32];
+
+	snprintf(stmp, sizeof(stmp), "%i", value);
+
+	latencyLabel->setText(stmp);
+
+	g_config->setOption("SDL.Sound.Latency", value);
+	// reset sound subsystem for changes to take effect
+	if (FCEU_WRAPPER_TRYLOCK(1000))
+	{
+		KillSound();
+		InitSound();
+		FCEU_WRAPPER_UNLOCK();
+	}
+}
+//----------------------------------------------------
 void ConsoleSndConfDialog_t::volumeChanged(int value)
 {
 	char stmp[32];
@@ -39,6 +39,8 @@ protected:
 	QComboBox *rateSelect;
 	QSlider *bufSizeSlider;
 	QLabel *bufSizeLabel;
+	QSlider *latencySlider;
+	QLabel *latencyLabel;
 	QLabel *volLbl;
 	QLabel *triLbl;
 	QLabel *sqr1Lbl;
@@ -46,6 +48,7 @@ protected:
 	QLabel *nseLbl;
 	QLabel *pcmLbl;
 	QLabel *starveLbl;
+	QLabel *latencyLbl;
 	QSlider *sqr2Slider;
 	QSlider *nseSlider;
 	QSlider *pcmSlider;
@@ -62,6 +65,7 @@ private slots:
 	void resetCounters(void);
 	void periodicUpdate(void);
 	void bufSizeChanged(int value);
+	void latencyChanged(int value);
 	void volumeChanged(int value);
 	void triangleChanged(int value);
 	void square1Changed(int value);
@@ -26,8 +26,12 @@
 #include <QWindow>
 #include <QScreen>
 #include <QToolTip>
+#include <QDir>
 #include <QFileInfo>
+#include <QDateTime>
 #include <QApplication>
+#include <QMessageBox>
+#include <QFontDatabase>
 
 #if WIN32
 #include <Windows.h>
@@ -44,7 +48,9 @@
 #endif
 
 #include "../../fceu.h"
+#include "../../driver.h"
 #include "../../x6502.h"
+#include "../../writejournal.h"
 #include "Qt/fceuWrapper.h"
 #include "Qt/ConsoleUtilities.h"
 
@@ -113,6 +119,43 @@ const char *getRomFile( void )
 	return nullptr;
 }
 //---------------------------------------------------------------------------
+std::string fceuInstantReplayFileName(void)
+{
+	const char *romFile = getRomFile();
+	const char *baseDir = FCEUI_GetBaseDirectory();
+	char base[512];
+
+	if ( (romFile == nullptr) || (baseDir == nullptr) )
+	{
+		return "";
+	}
+	getFileBaseName( romFile, base );
+
+	QString dir = QString(baseDir) + "/replays";
+
+	QDir().mkpath( dir );
+
+	QString name = QString("%1/%2-%3.fcap").arg( dir, QString(base),
+			QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") );
+
+	return name.toLocal8Bit().constData();
+}
+//---------------------------------------------------------------------------
+void fceuShowLastWriters( QWidget *parent, int addr )
+{
+	std::string report;
+
+	FCEU_WRAPPER_LOCK();
+	report = FCEU_WriteJournalReport( addr, 16 );
+	FCEU_WRAPPER_UNLOCK();
+
+	QMessageBox msgBox( QMessageBox::Information, QObject::tr("Last Writers"),
+			QString::fromStdString(report), QMessageBox::Ok, parent );
+
+	msgBox.setFont( QFontDatabase::systemFont(QFontDatabase::FixedFont) );
+	msgBox.exec();
+}
+//---------------------------------------------------------------------------
 // Return file base name stripping out preceding path and trailing suffix.
 int getFileBaseName( const char *filepath, char *base, char *suffix )
 {
@@ -428,6 +471,59 @@ void fceuCustomToolTip::hideTimerExpired(void)
 	hideTipImmediately();
 }
 //---------------------------------------------------------------------------
+fceuHiddenTimerPause::fceuHiddenTimerPause( QWidget *w, QTimer *t )
+	: QObject(t)
+{
+	window = w;
+	timer  = t;
+	paused = false;
+
+	window->installEventFilter(this);
+}
+//---------------------------------------------------------------------------
+bool fceuHiddenTimerPause::eventFilter(QObject *obj, QEvent *event)
+{
+	bool hidden;
+
+	switch ( event->type() )
+	{
+		case QEvent::Hide:
+			hidden = true;
+		break;
+		case QEvent::Show:
+			hidden = window->isMinimized();
+		break;
+		case QEvent::WindowStateChange:
+			hidden = window->isMinimized() || !window->isVisible();
+		break;
+		default:
+			return QObject::eventFilter(obj, event);
+	}
+
+	if ( hidden )
+	{
+		if ( timer->isActive() )
+		{
+			//printf("Pause Timer: %s\n", window->windowTitle().toLocal8Bit().constData() );
+			timer->stop();
+			paused = true;
+		}
+	}
+	else if ( paused )
+	{
+		// stop() keeps the interval
+		timer->start();
+		paused = false;
+	}
+	return QObject::eventFilter(obj, event);
+}
+//---------------------------------------------------------------------------
+void fceuPauseTimerWhileHidden( QWidget *window, QTimer *timer )
+{
+	// owned by the timer, goes with it
+	new fceuHiddenTimerPause( window, timer );
+}
+//---------------------------------------------------------------------------
 bool fceuCustomToolTip::eventFilter( QObject *obj, QEvent *event)
 {
 	//printf("Event:%i   %p\n", event->type(), obj);
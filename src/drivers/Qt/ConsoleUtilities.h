@@ -22,6 +22,13 @@ int parseFilepath( const char *filepath, std::string *dir, std::string *base = n
 
 const char *fceuExecutablePath(void);
 
+// <base dir>/replays/<rom>-<date>-<time>.fcap for a saved instant replay,
+// the directory made if need be; "" when no game is loaded
+std::string fceuInstantReplayFileName(void);
+
+// Shows the last writes to addr kept in the write journal (--writejournal)
+void fceuShowLastWriters( QWidget *parent, int addr );
+
 int fceuLoadConfigColor( const char *confName, QColor *color );
 
 class fceuDecIntValidtor : public QValidator
@@ -91,6 +98,24 @@ class QCheckBoxRO : public QCheckBox
 
 };
 
+// Stops a window's periodic update timer while the window is hidden or
+// minimized, and starts it again when the window shows
+class fceuHiddenTimerPause : public QObject
+{
+	public:
+		fceuHiddenTimerPause( QWidget *window, QTimer *timer );
+
+	protected:
+		bool eventFilter(QObject *obj, QEvent *event) override;
+
+	private:
+		QWidget *window;
+		QTimer  *timer;
+		bool     paused;
+};
+
+void fceuPauseTimerWhileHidden( QWidget *window, QTimer *timer );
+
 QString fceuGetOpcodeToolTip( uint8_t *opcode, int size );
 
 QDialog *fceuCustomToolTipShow( const QPoint &globalPos, QDialog *popup );
@@ -115,6 +115,8 @@ ConsoleVideoConfDialog_t::ConsoleVideoConfDialog_t(QWidget *parent)
 	scalerSelect->addItem( tr("Prescale 3x"), 7 );
 	scalerSelect->addItem( tr("Prescale 4x"), 8 );
 	scalerSelect->addItem( tr("PAL 3x"), 9 );
+	scalerSelect->addItem( tr("scale2x (OpenGL)"), 10 );
+	scalerSelect->addItem( tr("scale3x (OpenGL)"), 11 );
 	
 	hbox1 = new QHBoxLayout();
 
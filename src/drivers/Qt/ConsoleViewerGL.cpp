@@ -47,6 +47,73 @@
 extern unsigned int gui_draw_area_width;
 extern unsigned int gui_draw_area_height;
 
+// scale2x / scale3x (AdvanceMAME) as a fragment shader, drawn with the same
+// textured quad as the plain path. Each fragment finds the source texel it
+// falls in and which cell of the 2x2 or 3x3 block it covers, then applies
+// the rules of drivers/common/scale2x.cpp / scale3x.cpp to that cell.
+// Neighbors are clamped to the image. On index data that reproduces scale2x
+// exactly, and scale3x everywhere but its special-cased first and last
+// columns. The shader compares palette colors rather than indices, which
+// only differs where two indices share a color.
+static const char *scalerVertSrc =
+	"varying vec2 texCoord;\n"
+	"void main()\n"
+	"{\n"
+	"	texCoord = gl_MultiTexCoord0.xy;\n"
+	"	gl_Position = ftransform();\n"
+	"}\n";
+
+static const char *scalerFragSrc =
+	"#ifdef RECT_TEXTURE\n"
+	"#extension GL_ARB_texture_rectangle : enable\n"
+	"uniform sampler2DRect frame;\n"
+	"#define SAMPLE(p) texture2DRect(frame, p)\n"
+	"#else\n"
+	"uniform sampler2D frame;\n"
+	"#define SAMPLE(p) texture2D(frame, (p) / texScale)\n"
+	"#endif\n"
+	"uniform vec2  texScale;\n"  // texel units per texture coordinate unit
+	"uniform vec2  imgSize;\n"   // frame size in texels
+	"uniform float scale;\n"
+	"varying vec2 texCoord;\n"
+	"vec3 texel( vec2 p )\n"
+	"{\n"
+	"	p = clamp( p, vec2(0.5), imgSize - vec2(0.5) );\n"
+	"	return SAMPLE(p).rgb;\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 pos  = texCoord * texScale;\n"
+	"	vec2 c    = floor(pos) + vec2(0.5);\n"
+	"	vec2 cell = floor( fract(pos) * scale );\n"
+	"	vec3 A = texel( c + vec2(-1.0,-1.0) );\n"
+	"	vec3 B = texel( c + vec2( 0.0,-1.0) );\n"
+	"	vec3 C = texel( c + vec2( 1.0,-1.0) );\n"
+	"	vec3 D = texel( c + vec2(-1.0, 0.0) );\n"
+	"	vec3 E = texel( c );\n"
+	"	vec3 F = texel( c + vec2( 1.0, 0.0) );\n"
+	"	vec3 G = texel( c + vec2(-1.0, 1.0) );\n"
+	"	vec3 H = texel( c + vec2( 0.0, 1.0) );\n"
+	"	vec3 I = texel( c + vec2( 1.0, 1.0) );\n"
+	"	vec3 col = E;\n"
+	"	if ( (B != H) && (D != F) )\n"
+	"	{\n"
+	"		bool left   = (cell.x < 0.5);\n"
+	"		bool top    = (cell.y < 0.5);\n"
+	"		bool right  = (cell.x > scale - 1.5);\n"
+	"		bool bottom = (cell.y > scale - 1.5);\n"
+	"		if ( top && left ) { if (D == B) col = D; }\n"
+	"		else if ( top && right ) { if (B == F) col = F; }\n"
+	"		else if ( bottom && left ) { if (D == H) col = D; }\n"
+	"		else if ( bottom && right ) { if (H == F) col = F; }\n"
+	"		else if ( top ) { if (((D == B) && (E != C)) || ((B == F) && (E != A))) col = B; }\n"
+	"		else if ( bottom ) { if (((D == H) && (E != I)) || ((H == F) && (E != G))) col = H; }\n"
+	"		else if ( left ) { if (((D == B) && (E != G)) || ((D == H) && (E != A))) col = D; }\n"
+	"		else if ( right ) { if (((B == F) && (E != I)) || ((H == F) && (E != C))) col = F; }\n"
+	"	}\n"
+	"	gl_FragColor = vec4( col, 1.0 );\n"
+	"}\n";
+
 ConsoleViewGL_t::ConsoleViewGL_t(QWidget *parent)
 	: QOpenGLWidget( parent )
 {
@@ -56,6 +123,7 @@ ConsoleViewGL_t::ConsoleViewGL_t(QWidget *parent)
 	view_height = 224;
 	gltexture   = 0;
 	devPixRatio = 1.0f;
+	paintStartTime = 0.0;
 	aspectRatio = 1.0f;
 	aspectX     = 1.0f;
 	aspectY     = 1.0f;
@@ -71,11 +139,22 @@ ConsoleViewGL_t::ConsoleViewGL_t(QWidget *parent)
 	txtHeight = 0;
 	mouseButtonMask = 0;
 	reqPwr2 = true;
+	pixelBufExtn = false;
+	pixelBufIdx = 0;
+	pixelBufFilled = false;
+	scalerProg = NULL;
+	guiOverlay = NULL;
+	guiTexture = 0;
 	textureType = GL_TEXTURE_2D;
 	//textureType = GL_TEXTURE_RECTANGLE;
 
 	bgColor = NULL;
 
+	for (int i=0; i<NUM_PIXEL_BUFS; i++)
+	{
+		pixelBuf[i] = NULL;
+	}
+
 	if ( win )
 	{
 		bgColor = win->getVideoBgColorPtr();
@@ -150,6 +229,10 @@ ConsoleViewGL_t::~ConsoleViewGL_t(void)
 	{
 		free( localBuf ); localBuf = NULL;
 	}
+	if ( guiOverlay )
+	{
+		delete guiOverlay; guiOverlay = NULL;
+	}
 }
 
 void ConsoleViewGL_t::screenChanged( QScreen *screen )
@@ -289,6 +372,75 @@ void ConsoleViewGL_t::buildTextures(void)
 	//printf("Texture Built: %ix%i\n", w, h);
 }
 
+void ConsoleViewGL_t::buildPixelBuffers(void)
+{
+	destroyPixelBuffers();
+
+	if ( !pixelBufExtn )
+	{
+		return;
+	}
+
+	for (int i=0; i<NUM_PIXEL_BUFS; i++)
+	{
+		pixelBuf[i] = new QOpenGLBuffer( QOpenGLBuffer::PixelUnpackBuffer );
+
+		pixelBuf[i]->setUsagePattern( QOpenGLBuffer::StreamDraw );
+
+		if ( !pixelBuf[i]->create() )
+		{
+			destroyPixelBuffers();
+			return;
+		}
+		// Sized for the largest prescaled frame, like localBuf
+		pixelBuf[i]->bind();
+		pixelBuf[i]->allocate( localBufSize );
+		pixelBuf[i]->release();
+	}
+	pixelBufIdx = 0;
+	pixelBufFilled = false;
+}
+
+void ConsoleViewGL_t::destroyPixelBuffers(void)
+{
+	for (int i=0; i<NUM_PIXEL_BUFS; i++)
+	{
+		if ( pixelBuf[i] )
+		{
+			pixelBuf[i]->destroy();
+			delete pixelBuf[i]; pixelBuf[i] = NULL;
+		}
+	}
+	pixelBufFilled = false;
+}
+
+void ConsoleViewGL_t::buildScalerProgram(void)
+{
+	QByteArray fragSrc;
+
+	if ( scalerProg )
+	{
+		delete scalerProg; scalerProg = NULL;
+	}
+	if ( textureType == GL_TEXTURE_RECTANGLE )
+	{
+		fragSrc.append( "#define RECT_TEXTURE\n" );
+	}
+	fragSrc.append( scalerFragSrc );
+
+	scalerProg = new QOpenGLShaderProgram(this);
+
+	if ( !scalerProg->addShaderFromSourceCode( QOpenGLShader::Vertex, scalerVertSrc ) ||
+	     !scalerProg->addShaderFromSourceCode( QOpenGLShader::Fragment, fragSrc ) ||
+	     !scalerProg->link() )
+	{
+		printf("GL scale2x/scale3x shader unavailable, those scalers will draw at 1x:\n%s\n",
+				scalerProg->log().toLocal8Bit().constData() );
+
+		delete scalerProg; scalerProg = NULL;
+	}
+}
+
 void ConsoleViewGL_t::chkExtnsGL(void)
 {
 
@@ -346,6 +498,11 @@ void ConsoleViewGL_t::chkExtnsGL(void)
 					//printf("GL Has: %s\n", extName );
 					reqPwr2 = false;
 				}
+				else if ( strcmp( extName, "GL_ARB_pixel_buffer_object" ) == 0 )
+				{
+					//printf("GL Has: %s\n", extName );
+					pixelBufExtn = true;
+				}
 			}
 			while ( isspace(c[i]) ) i++;
 
@@ -368,6 +525,12 @@ void ConsoleViewGL_t::initializeGL(void)
 
 	 buildTextures();
 
+	 buildPixelBuffers();
+
+	 buildScalerProgram();
+
+	 nes_shm->gui.composite = 1;
+
 	 connect(context(), &QOpenGLContext::aboutToBeDestroyed, this, &ConsoleViewGL_t::cleanupGL);
 }
 
@@ -385,6 +548,18 @@ void ConsoleViewGL_t::cleanupGL(void)
 	 	glDeleteTextures(1, &gltexture);
 	 	gltexture=0;
 	 }
+	 destroyPixelBuffers();
+
+	 if ( scalerProg )
+	 {
+	 	delete scalerProg; scalerProg = NULL;
+	 }
+	 if ( guiTexture )
+	 {
+	 	glDeleteTextures(1, &guiTexture);
+	 	guiTexture=0;
+	 }
+	 nes_shm->gui.composite = 0;
 
 	 doneCurrent();
 }
@@ -477,11 +652,50 @@ double ConsoleViewGL_t::getAspectRatio(void)
 }
 
 void ConsoleViewGL_t::transfer2LocalBuffer(void)
+{
+	copyGuiOverlay();
+
+	if ( pixelBuf[0] != NULL )
+	{
+		int next = (pixelBufIdx + 1) % NUM_PIXEL_BUFS;
+		uint8_t *dest;
+
+		makeCurrent();
+
+		pixelBuf[next]->bind();
+		// Orphan the old storage, so mapping does not wait for its upload to finish
+		pixelBuf[next]->allocate( localBufSize );
+
+		dest = (uint8_t*)pixelBuf[next]->map( QOpenGLBuffer::WriteOnly );
+
+		if ( dest != NULL )
+		{
+			copyFrame( dest, localBufSize );
+
+			pixelBuf[next]->unmap();
+			pixelBuf[next]->release();
+
+			pixelBufIdx = next;
+			pixelBufFilled = true;
+
+			doneCurrent();
+			return;
+		}
+		// Mapping is not supported after all, stay on localBuf from now on
+		pixelBuf[next]->release();
+		destroyPixelBuffers();
+
+		doneCurrent();
+	}
+	copyFrame( (uint8_t*)localBuf, localBufSize );
+}
+
+void ConsoleViewGL_t::copyFrame( uint8_t *dest, unsigned int destSize )
 {
 	int i=0, hq = 0, bufIdx;
 	int numPixels = nes_shm->video.ncol * nes_shm->video.nrow;
 	unsigned int cpSize = numPixels * 4;
- 	uint8_t *src, *dest;
+ 	uint8_t *src;
 
 	bufIdx = nes_shm->pixBufIdx-1;
 
@@ -489,12 +703,12 @@ void ConsoleViewGL_t::transfer2LocalBuffer(void)
 	{
 		bufIdx = NES_VIDEO_BUFLEN-1;
 	}
-	if ( cpSize > localBufSize )
+	if ( cpSize > destSize )
 	{
-		cpSize = localBufSize;
+		cpSize = destSize;
+		numPixels = cpSize / 4;
 	}
 	src  = (uint8_t*)nes_shm->pixbuf[bufIdx];
-	dest = (uint8_t*)localBuf;
 
 	hq = (nes_shm->video.preScaler == 1) || (nes_shm->video.preScaler == 4); // hq2x and hq3x
 
@@ -516,6 +730,150 @@ void ConsoleViewGL_t::transfer2LocalBuffer(void)
 	}
 }
 
+void ConsoleViewGL_t::copyGuiOverlay(void)
+{
+	const nes_shm_t::guiOverlay_t &src = nes_shm->gui;
+
+	if ( guiOverlay == NULL )
+	{
+		if ( !src.active )
+		{
+			return;
+		}
+		guiOverlay = new nes_shm_t::guiOverlay_t;
+	}
+	guiOverlay->active = src.active;
+
+	if ( !src.active )
+	{
+		return;
+	}
+	guiOverlay->x0 = src.x0;
+	guiOverlay->y0 = src.y0;
+	guiOverlay->width  = src.width;
+	guiOverlay->height = src.height;
+	guiOverlay->ncmd   = src.ncmd;
+	guiOverlay->layerUsed = src.layerUsed;
+
+	memcpy( guiOverlay->cmd, src.cmd, src.ncmd * sizeof(src.cmd[0]) );
+
+	if ( src.layerUsed )
+	{
+		memcpy( guiOverlay->layer, src.layer, sizeof(src.layer) );
+	}
+}
+
+void ConsoleViewGL_t::drawGuiOverlay(void)
+{
+	if ( (guiOverlay == NULL) || !guiOverlay->active ||
+	     (guiOverlay->width <= 0) || (guiOverlay->height <= 0) )
+	{
+		return;
+	}
+	const nes_shm_t::guiOverlay_t *g = guiOverlay;
+
+	// output pixels per NES pixel, NES y grows downwards
+	float px = (float)rw / (float)g->width;
+	float py = (float)rh / (float)g->height;
+
+#define  GUI_X(x)  ( ((x) - g->x0) * px )
+#define  GUI_Y(y)  ( rh - ((y) - g->y0) * py )
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_TEXTURE_RECTANGLE);
+
+	// The commands in order, a batch for each run of rects or of lines
+	glLineWidth( px > 1.0f ? px : 1.0f );
+
+	int mode = -1;
+
+	for (int i=0; i<g->ncmd; i++)
+	{
+		const nes_shm_t::guiCmd_t &cmd = g->cmd[i];
+		int cmdMode = cmd.line ? GL_LINES : GL_QUADS;
+
+		if ( cmdMode != mode )
+		{
+			if ( mode >= 0 )
+			{
+				glEnd();
+			}
+			mode = cmdMode;
+			glBegin( mode );
+		}
+		glColor4ub( (cmd.colour >> 16) & 0xff, (cmd.colour >> 8) & 0xff,
+				cmd.colour & 0xff, (cmd.colour >> 24) & 0xff );
+
+		if ( cmd.line )
+		{
+			// pixel centres, the width is one NES pixel
+			glVertex2f( GUI_X(cmd.x1 + 0.5f), GUI_Y(cmd.y1 + 0.5f) );
+			glVertex2f( GUI_X(cmd.x2 + 0.5f), GUI_Y(cmd.y2 + 0.5f) );
+		}
+		else
+		{
+			glVertex2f( GUI_X(cmd.x1)    , GUI_Y(cmd.y2 + 1) );
+			glVertex2f( GUI_X(cmd.x2 + 1), GUI_Y(cmd.y2 + 1) );
+			glVertex2f( GUI_X(cmd.x2 + 1), GUI_Y(cmd.y1) );
+			glVertex2f( GUI_X(cmd.x1)    , GUI_Y(cmd.y1) );
+		}
+	}
+	if ( mode >= 0 )
+	{
+		glEnd();
+	}
+	glLineWidth( 1.0f );
+	glColor4ub( 255, 255, 255, 255 );
+
+	// Then the layer over them
+	if ( g->layerUsed )
+	{
+		if ( guiTexture == 0 )
+		{
+			glGenTextures(1, &guiTexture);
+			glBindTexture( GL_TEXTURE_2D, guiTexture );
+
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+			glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, 256, 256, 0,
+					GL_BGRA, GL_UNSIGNED_BYTE, 0 );
+		}
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture( GL_TEXTURE_2D, guiTexture );
+
+		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, GL_NES_WIDTH, GL_NES_HEIGHT,
+				GL_BGRA, GL_UNSIGNED_BYTE, g->layer );
+
+		float u1 = (float)g->x0 / 256.0f;
+		float u2 = (float)(g->x0 + g->width) / 256.0f;
+		float v1 = (float)g->y0 / 256.0f;
+		float v2 = (float)(g->y0 + g->height) / 256.0f;
+
+		glBegin(GL_QUADS);
+		glTexCoord2f( u1, v2 );
+		glVertex2f( 0.0f, 0.0f );
+
+		glTexCoord2f( u2, v2 );
+		glVertex2f( rw, 0.0f );
+
+		glTexCoord2f( u2, v1 );
+		glVertex2f( rw, rh );
+
+		glTexCoord2f( u1, v1 );
+		glVertex2f( 0.0f, rh );
+		glEnd();
+
+		glDisable(GL_TEXTURE_2D);
+	}
+#undef  GUI_X
+#undef  GUI_Y
+}
+
 void ConsoleViewGL_t::mousePressEvent(QMouseEvent * event)
 {
 	//printf("Mouse Button Press: (%i,%i) %x  %x\n", 
@@ -575,6 +933,12 @@ void ConsoleViewGL_t::renderFinished(void)
 {
 	videoBufferSwapMark();
 
+	if ( paintStartTime > 0.0 )
+	{
+		recordFrameStage( FRAME_STAGE_PRESENT, getHighPrecTimeStamp() - paintStartTime );
+		paintStartTime = 0.0;
+	}
+
 	// Schedule draw timing inline with vsync
 	drawTimer->start();
 }
@@ -594,6 +958,10 @@ void ConsoleViewGL_t::onDrawSignal(void)
 
 void ConsoleViewGL_t::paintGL(void)
 {
+	if ( getFrameTimingEnable() )
+	{
+		paintStartTime = getHighPrecTimeStamp();
+	}
 	int texture_width  = nes_shm->video.ncol;
 	int texture_height = nes_shm->video.nrow;
 	int l=0, r=texture_width;
@@ -700,6 +1068,34 @@ void ConsoleViewGL_t::paintGL(void)
 	glBlendFunc(GL_ONE, GL_ZERO);
 	//glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+	// With a pixel unpack buffer bound, the upload source is an offset into it
+	const GLvoid *pixels = localBuf;
+
+	if ( pixelBufFilled )
+	{
+		pixelBuf[pixelBufIdx]->bind();
+		pixels = NULL;
+	}
+
+	bool gpuScale = (nes_shm->video.gpuScaler > 1) && (scalerProg != NULL);
+
+	if ( gpuScale )
+	{
+		scalerProg->bind();
+		scalerProg->setUniformValue( "frame", 0 );
+		scalerProg->setUniformValue( "imgSize", (float)texture_width, (float)texture_height );
+		scalerProg->setUniformValue( "scale", (float)nes_shm->video.gpuScaler );
+
+		if ( textureType == GL_TEXTURE_RECTANGLE )
+		{
+			scalerProg->setUniformValue( "texScale", 1.0f, 1.0f );
+		}
+		else
+		{
+			scalerProg->setUniformValue( "texScale", (float)txtWidth, (float)txtHeight );
+		}
+	}
+
 	if ( textureType == GL_TEXTURE_RECTANGLE )
 	{
 		glDisable(GL_TEXTURE_2D);
@@ -708,7 +1104,7 @@ void ConsoleViewGL_t::paintGL(void)
 	
 		glTexSubImage2D(GL_TEXTURE_RECTANGLE, 0,
 			  	0, 0, texture_width, texture_height,
-					GL_BGRA, GL_UNSIGNED_BYTE, localBuf );
+					GL_BGRA, GL_UNSIGNED_BYTE, pixels );
 	
 		glBegin(GL_QUADS);
 		glTexCoord2f( l, b); // Bottom left of picture.
@@ -740,7 +1136,7 @@ void ConsoleViewGL_t::paintGL(void)
 	
 		glTexSubImage2D(GL_TEXTURE_2D, 0,
 			  	0, 0, texture_width, texture_height,
-					GL_BGRA, GL_UNSIGNED_BYTE, localBuf );
+					GL_BGRA, GL_UNSIGNED_BYTE, pixels );
 	
 		glBegin(GL_QUADS);
 		glTexCoord2f( x1, y1); // Bottom left of picture.
@@ -759,6 +1155,17 @@ void ConsoleViewGL_t::paintGL(void)
 	glDisable(GL_TEXTURE_2D);
 	glDisable(GL_TEXTURE_RECTANGLE);
 
+	if ( gpuScale )
+	{
+		scalerProg->release();
+	}
+	if ( pixelBufFilled )
+	{
+		pixelBuf[pixelBufIdx]->release();
+	}
+
+	drawGuiOverlay();
+
 	nes_shm->render_count++;
 	 //printf("Paint GL!\n");
 }
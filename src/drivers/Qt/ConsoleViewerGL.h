@@ -8,9 +8,12 @@
 #include <QColor>
 #include <QScreen>
 #include <QOpenGLWidget>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
 #include <QOpenGLFunctions>
 
 #include "Qt/ConsoleViewerInterface.h"
+#include "Qt/nes_shm.h"
 
 class ConsoleViewGL_t : public QOpenGLWidget, protected QOpenGLFunctions, public ConsoleViewerBase
 {
@@ -61,6 +64,12 @@ class ConsoleViewGL_t : public QOpenGLWidget, protected QOpenGLFunctions, public
 	void mouseReleaseEvent(QMouseEvent * event);
 
 	void buildTextures(void);
+	void buildPixelBuffers(void);
+	void destroyPixelBuffers(void);
+	void buildScalerProgram(void);
+	void copyFrame( uint8_t *dest, unsigned int destSize );
+	void copyGuiOverlay(void);
+	void drawGuiOverlay(void);
 	void calcPixRemap(void);
 	void doRemap(void);
 	void chkExtnsGL(void);
@@ -68,6 +77,7 @@ class ConsoleViewGL_t : public QOpenGLWidget, protected QOpenGLFunctions, public
 
 	double devPixRatio;
 	double aspectRatio;
+	double paintStartTime;  // present stage, paintGL() to the buffer swap
 	double aspectX;
 	double aspectY;
 	double xscale;
@@ -86,6 +96,7 @@ class ConsoleViewGL_t : public QOpenGLWidget, protected QOpenGLFunctions, public
 	bool   autoScaleEna;
 	bool   reqPwr2;
 	bool   vsyncEnabled;
+	bool   pixelBufExtn;
 
 	unsigned int  textureType;
 	unsigned int  mouseButtonMask;
@@ -95,6 +106,25 @@ class ConsoleViewGL_t : public QOpenGLWidget, protected QOpenGLFunctions, public
 	uint32_t  *localBuf;
 	uint32_t   localBufSize;
 
+	// Frames are staged for upload in a ring of pixel unpack buffers, so
+	// the texture update is a DMA from driver memory instead of a copy from
+	// localBuf. Two buffers let a new frame be written while the GPU still
+	// reads the previous one. localBuf is the fallback when the ring is not
+	// available.
+	static constexpr int NUM_PIXEL_BUFS = 2;
+
+	QOpenGLBuffer *pixelBuf[NUM_PIXEL_BUFS];
+	int            pixelBufIdx;
+	bool           pixelBufFilled;
+
+	// scale2x / scale3x fragment shader, NULL when it failed to build
+	QOpenGLShaderProgram *scalerProg;
+
+	// Lua gui drawing copied with the frame, drawn over it at the output
+	// resolution. The layer goes through guiTexture.
+	nes_shm_t::guiOverlay_t *guiOverlay;
+	GLuint guiTexture;
+
 	private slots:
 		void cleanupGL(void);
 		void renderFinished(void);
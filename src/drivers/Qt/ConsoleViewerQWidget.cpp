@@ -390,6 +390,7 @@ void  ConsoleViewQWidget_t::getNormalizedCursorPos( double &x, double &y )
 
 void ConsoleViewQWidget_t::paintEvent(QPaintEvent *event)
 {
+	frameStageTimer presentTimer( FRAME_STAGE_PRESENT );
 	QPainter painter(this);
 	int nesWidth  = GL_NES_WIDTH;
 	int nesHeight = GL_NES_HEIGHT;
@@ -607,6 +607,7 @@ void ConsoleViewSDL_t::onDrawSignal(void)
 
 void ConsoleViewSDL_t::render(void)
 {
+	frameStageTimer presentTimer( FRAME_STAGE_PRESENT );
 	int nesWidth  = GL_NES_WIDTH;
 	int nesHeight = GL_NES_HEIGHT;
 	float ixScale = 1.0;
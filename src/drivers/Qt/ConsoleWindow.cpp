@@ -39,6 +39,8 @@
 #include <QHeaderView>
 #include <QFileInfo>
 #include <QFileDialog>
+#include <QGridLayout>
+#include <QLabel>
 #include <QMessageBox>
 #include <QInputDialog>
 #include <QDesktopServices>
@@ -56,9 +58,11 @@
 #include "../../input.h"
 #include "../../movie.h"
 #include "../../wave.h"
+#include "../../capture.h"
 #include "../../state.h"
 #include "../../cheat.h"
 #include "../../profiler.h"
+#include "../../romscan.h"
 #include "../../version.h"
 #include "common/os_utils.h"
 #include "utils/timeStamp.h"
@@ -71,6 +75,8 @@
 #include "Qt/dface.h"
 #include "Qt/input.h"
 #include "Qt/throttle.h"
+#include "Qt/FrameDispatcher.h"
+#include "Qt/ConsoleKiosk.h"
 #include "Qt/ColorMenu.h"
 #include "Qt/ConsoleWindow.h"
 #include "Qt/InputConf.h"
@@ -89,6 +95,7 @@
 #include "Qt/StateRecorderConf.h"
 #include "Qt/TimingConf.h"
 #include "Qt/FrameTimingStats.h"
+#include "Qt/MutexContention.h"
 #include "Qt/LuaControl.h"
 #include "Qt/QtScriptManager.h"
 #include "Qt/CheatsConf.h"
@@ -103,6 +110,7 @@
 #include "Qt/MsgLogViewer.h"
 #include "Qt/AboutWindow.h"
 #include "Qt/fceuWrapper.h"
+#include "Qt/sdl-video.h"
 #include "Qt/ppuViewer.h"
 #include "Qt/NameTableViewer.h"
 #include "Qt/iNesHeaderEditor.h"
@@ -194,7 +202,8 @@ consoleWin_t::consoleWin_t(QWidget *parent)
 	connect( gameTimer, &QTimer::timeout, this, &consoleWin_t::updatePeriodic );
 
 	gameTimer->setTimerType( Qt::PreciseTimer );
-	gameTimer->start( 8 ); // 120hz
+	gameTimerPeriod = 8;
+	gameTimer->start( gameTimerPeriod ); // 120hz
 
 #ifdef __FCEU_QSCRIPT_ENABLE__
 	QtScriptManager::create(nullptr);
@@ -745,8 +754,13 @@ void consoleWin_t::resizeEvent(QResizeEvent *event)
 
 void consoleWin_t::setCyclePeriodms( int ms )
 {
+	gameTimerPeriod = ms;
+
 	// If timer is already running, it will be restarted.
-	gameTimer->start( ms );
+	if ( videoViewerVisible() )
+	{
+		gameTimer->start( ms );
+	}
    
 	//printf("Period Set to: %i ms \n", ms );
 }
@@ -871,6 +885,39 @@ void consoleWin_t::showEvent(QShowEvent *event)
 {
 	//printf("Main Window Show Event\n");
 	initScreenHandler();
+
+	updateViewerVisible();
+}
+
+void consoleWin_t::hideEvent(QHideEvent *event)
+{
+	//printf("Main Window Hide Event\n");
+	updateViewerVisible();
+}
+
+void consoleWin_t::changeEvent(QEvent *event)
+{
+	if ( event->type() == QEvent::WindowStateChange )
+	{
+		updateViewerVisible();
+	}
+	QMainWindow::changeEvent(event);
+}
+
+void consoleWin_t::updateViewerVisible(void)
+{
+	bool visible = (isVisible() && !isMinimized()) || ConsoleKiosk_t::active();
+
+	// the emulator thread stops blitting for a hidden viewer
+	setVideoViewerVisible( visible );
+
+	// Hidden, only input and the menu state need the periodic update
+	int period = visible ? gameTimerPeriod : 50;
+
+	if ( gameTimer->isActive() && (gameTimer->interval() != period) )
+	{
+		gameTimer->start( period );
+	}
 }
 
 void consoleWin_t::contextMenuEvent(QContextMenuEvent *event)
@@ -1045,6 +1092,7 @@ void consoleWin_t::createMainMenu(void)
 	
 	// File -> Recent ROMs
 	recentRomMenu = fileMenu->addMenu( tr("&Recent ROMs") );
+	recentRomMenu->setToolTipsVisible(true);
 
 	buildRecentRomMenu();
 
@@ -1955,6 +2003,13 @@ void consoleWin_t::createMainMenu(void)
 	
 	debugMenu->addAction(iNesEditAct);
 
+	// Debug -> Emulator Mutex Contention
+	act = new QAction(tr("Emulator &Mutex Contention..."), this);
+	act->setStatusTip(tr("Show who holds the emulator lock and for how long"));
+	connect(act, SIGNAL(triggered()), this, SLOT(openMutexContentionWin(void)) );
+	
+	debugMenu->addAction(act);
+
 	//-----------------------------------------------------------------------
 	// Movie
 
@@ -2091,6 +2146,18 @@ void consoleWin_t::createMainMenu(void)
 
 	movieMenu->addAction(stopWavAct);
 
+	movieMenu->addSeparator();
+
+	// Movie -> Save Instant Replay
+	saveReplayAct = new QAction(tr("Save Instant &Replay"), this);
+	saveReplayAct->setStatusTip(tr("Save the last seconds of play kept in memory"));
+	connect(saveReplayAct, SIGNAL(triggered()), this, SLOT(saveInstantReplay(void)) );
+
+	Hotkeys[ HK_SAVE_INSTANT_REPLAY ].setAction( saveReplayAct );
+	connect( Hotkeys[ HK_SAVE_INSTANT_REPLAY ].getShortcut(), SIGNAL(activated()), this, SLOT(saveInstantReplay(void)) );
+
+	movieMenu->addAction(saveReplayAct);
+
 	//-----------------------------------------------------------------------
 	// Help
  
@@ -2689,6 +2756,31 @@ void consoleWin_t::openROMFile(void)
 	dialog.setOption(QFileDialog::DontUseNativeDialog, !useNativeFileDialogVal);
 	dialog.setSidebarUrls(urls);
 
+	// Show what the ROM index knows about the highlighted file, only
+	// the Qt dialog has a layout to put it in.
+	QGridLayout *grid = qobject_cast<QGridLayout*>( dialog.layout() );
+
+	if ( !useNativeFileDialogVal && (grid != NULL) )
+	{
+		QLabel *romInfoLbl = new QLabel();
+
+		grid->addWidget( romInfoLbl, grid->rowCount(), 0, 1, grid->columnCount() );
+
+		connect( &dialog, &QFileDialog::currentChanged, [romInfoLbl]( const QString &path )
+		{
+			FCEU_RomScanEntry entry;
+
+			if ( FCEU_RomIndexFind( path.toLocal8Bit().constData(), entry ) )
+			{
+				romInfoLbl->setText( QString::fromStdString( FCEU_RomScanDescribe( entry ) ) );
+			}
+			else
+			{
+				romInfoLbl->clear();
+			}
+		});
+	}
+
 	ret = dialog.exec();
 
 	if ( ret )
@@ -3305,6 +3397,15 @@ void consoleWin_t::openTimingStatWin(void)
    tmStatWin->show();
 }
 
+void consoleWin_t::openMutexContentionWin(void)
+{
+	MutexContentionDialog_t *win;
+
+	win = new MutexContentionDialog_t(this);
+
+	win->show();
+}
+
 void consoleWin_t::openPaletteEditorWin(void)
 {
 	PaletteEditorDialog_t *win;
@@ -3376,7 +3477,8 @@ void consoleWin_t::openTasEditor(void)
 		
 		win->show();
 
-		connect(emulatorThread, SIGNAL(frameFinished(void)), win, SLOT(frameUpdate(void)) );
+		FrameDispatcher::instance()->addView( win, 0, [win]{ win->frameUpdate(); },
+				FrameDispatcher::NewFrameOnly | FrameDispatcher::WhileHidden );
 	}
 	FCEU_WRAPPER_UNLOCK();
 }
@@ -3465,6 +3567,38 @@ RestApiConfig consoleWin_t::loadRestApiConfig(void)
 	
 	apiConfig.port = port;
 	apiConfig.bindAddress = QString::fromStdString(bindAddr);
+	g_config->getOption("SDL.RestThreadCpus", &apiConfig.threadCpus);
+
+	int stateStoreMB = 256;
+	g_config->getOption("SDL.RestApiStateStoreMB", &stateStoreMB);
+
+	if (stateStoreMB < 1) {
+		stateStoreMB = 1;
+	}
+	apiConfig.stateStoreBytes = static_cast<size_t>(stateStoreMB) * 1024 * 1024;
+
+	g_config->getOption("SDL.RestApiThreads", &apiConfig.workerThreads);
+	g_config->getOption("SDL.RestApiMaxQueued", &apiConfig.maxQueuedRequests);
+	g_config->getOption("SDL.RestApiKeepAliveMax", &apiConfig.keepAliveMaxCount);
+	g_config->getOption("SDL.RestApiKeepAliveSec", &apiConfig.keepAliveTimeoutSec);
+
+	int gzipMinBytes = 1024;
+	g_config->getOption("SDL.RestApiGzipMinBytes", &gzipMinBytes);
+	apiConfig.compressMinBytes = (gzipMinBytes > 0) ? static_cast<size_t>(gzipMinBytes) : 0;
+
+	if (apiConfig.workerThreads < 0 || apiConfig.workerThreads > 256) {
+		FCEU_DispMessage("Invalid REST API thread count %d, using default", 1, apiConfig.workerThreads);
+		apiConfig.workerThreads = 0;
+	}
+	if (apiConfig.maxQueuedRequests < 0) {
+		apiConfig.maxQueuedRequests = 0;
+	}
+	if (apiConfig.keepAliveMaxCount < 1) {
+		apiConfig.keepAliveMaxCount = 1;
+	}
+	if (apiConfig.keepAliveTimeoutSec < 0) {
+		apiConfig.keepAliveTimeoutSec = 0;
+	}
 	
 	return apiConfig;
 }
@@ -4557,7 +4691,7 @@ void consoleWin_t::wavRecordAsStart(void)
 
 	dialog.setFileMode(QFileDialog::AnyFile);
 
-	dialog.setNameFilter(tr("WAV Movies (*.wav) ;; All files (*)"));
+	dialog.setNameFilter(tr("WAV Movies (*.wav) ;; FLAC Movies (*.flac) ;; All files (*)"));
 
 	dialog.setViewMode(QFileDialog::List);
 	dialog.setFilter( QDir::AllEntries | QDir::AllDirs | QDir::Hidden );
@@ -4653,6 +4787,29 @@ void consoleWin_t::wavRecordStop(void)
 	}
 }
 
+void consoleWin_t::saveInstantReplay(void)
+{
+	if ( FCEUI_GetInstantReplay() <= 0 )
+	{
+		FCEU_DispMessage("Instant replay is off, see --instantreplay", 0);
+		return;
+	}
+	std::string fileName = fceuInstantReplayFileName();
+
+	if ( fileName.empty() )
+	{
+		return;
+	}
+	FCEU_WRAPPER_LOCK();
+	bool started = FCEUI_SaveInstantReplay( fileName.c_str() );
+	FCEU_WRAPPER_UNLOCK();
+
+	if ( !started )
+	{
+		FCEU_DispMessage("Instant replay: nothing to save, or still saving the last one", 0);
+	}
+}
+
 void consoleWin_t::aboutFCEUX(void)
 {
 	AboutWindow *aboutWin;
@@ -4903,6 +5060,12 @@ void consoleWin_t::transferVideoBuffer(bool allowRedraw)
 {
 	FCEU_PROFILE_FUNC(prof, "VideoXfer");
 
+	// the kiosk's render thread takes the frames itself
+	if ( ConsoleKiosk_t::active() )
+	{
+		return;
+	}
+
 	{
 		FCEU::autoScopedLock lock(videoBufferMutex);
 		if ( nes_shm->blitUpdated )
@@ -4911,8 +5074,12 @@ void consoleWin_t::transferVideoBuffer(bool allowRedraw)
 
 			if (viewport_Interface != nullptr)
 			{
+				frameStageTimer blitTimer( FRAME_STAGE_BLIT );
+
 				viewport_Interface->transfer2LocalBuffer();
 				redrawVideoRequest = true;
+
+				inputTransferMark();
 			}
 		}
 	}
@@ -4922,6 +5089,8 @@ void consoleWin_t::transferVideoBuffer(bool allowRedraw)
 	{
 		viewport_Interface->queueRedraw();
 		redrawVideoRequest = false;
+
+		fceuWrapperStartupFinished("first_frame");
 	}
 }
 
@@ -4931,6 +5100,8 @@ void consoleWin_t::emuFrameFinish(void)
 
 	guiSignalRecvMark();
 
+	FrameDispatcher::instance()->wakeReceived();
+
 	//if ( eventProcessingInProg )
 	//{   // Prevent recursion as processEvents function can double back on us
 	//	return;
@@ -4954,6 +5125,8 @@ void consoleWin_t::emuFrameFinish(void)
 //#endif
 
 	transferVideoBuffer(false);
+
+	FrameDispatcher::instance()->dispatch();
 }
 
 void consoleWin_t::updatePeriodic(void)
@@ -4980,6 +5153,8 @@ void consoleWin_t::updatePeriodic(void)
 	// RePaint Game Viewport
 	transferVideoBuffer(true);
 
+	FrameDispatcher::instance()->dispatch();
+
 	// Low Rate Updates
 	if ( (updateCounter % 30) == 0 )
 	{
@@ -5013,6 +5188,16 @@ void consoleWin_t::updatePeriodic(void)
 		recAsWavAct->setEnabled( FCEU_IsValidUI( FCEUI_RECORDMOVIE ) && !FCEUI_WaveRecordRunning() );
 		stopWavAct->setEnabled( FCEUI_WaveRecordRunning() );
 		tasEditorAct->setEnabled( FCEU_IsValidUI(FCEUI_TASEDITOR) );
+
+		if ( aviRecordRunning() && this->statusBar() )
+		{
+			int queued, dropped;
+
+			aviRecordGetQueueStats( &queued, &dropped );
+
+			this->statusBar()->showMessage(
+				QString("AVI: encoder %1 frames behind, %2 dropped").arg(queued).arg(dropped), 1000 );
+		}
 	}
 
 	if ( errorMsgValid )
@@ -5123,6 +5308,7 @@ void emulatorThread_t::init(void)
 		setSchedParam( policy, prio );
 		#endif
 	}
+	fceuWrapperSetThreadAffinity( "SDL.EmuThreadCpus" );
 }
 
 void emulatorThread_t::setPriority( QThread::Priority priority_req )
@@ -5285,8 +5471,14 @@ void emulatorThread_t::run(void)
 
 void emulatorThread_t::signalFrameFinished(void)
 {
-	emuSignalSendMark();
-	emit frameFinished();
+	ConsoleKiosk_t::frameReady();
+
+	// one wake in flight at a time, the frames in between fold into it
+	if ( FrameDispatcher::instance()->publish() )
+	{
+		emuSignalSendMark();
+		emit frameFinished();
+	}
 }
 
 void emulatorThread_t::signalRomLoad( const char *path )
@@ -5346,6 +5538,13 @@ consoleRecentRomAction::consoleRecentRomAction(QString desc, QWidget *parent)
 	txt += desc;
 
 	setText( txt );
+
+	FCEU_RomScanEntry entry;
+
+	if ( FCEU_RomIndexFind( path, entry ) )
+	{
+		setToolTip( QString::fromStdString( FCEU_RomScanDescribe( entry ) ) );
+	}
 }
 //----------------------------------------------------------------------------
 consoleRecentRomAction::~consoleRecentRomAction(void)
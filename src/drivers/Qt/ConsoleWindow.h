@@ -170,6 +170,9 @@ class  consoleWin_t : public QMainWindow
 		AviRecordDiskThread_t *aviDiskThread;
 #ifdef __FCEU_REST_API_ENABLE__
 		FceuxApiServer *apiServer;
+
+		// From the SDL.RestApi* options, the headless console starts its server with it too
+		static RestApiConfig loadRestApiConfig(void);
 #endif
 
 		void addRecentRom( const char *rom );
@@ -270,6 +273,7 @@ class  consoleWin_t : public QMainWindow
 		QAction *recWavAct;
 		QAction *recAsWavAct;
 		QAction *stopWavAct;
+		QAction *saveReplayAct;
 		QAction *tasEditorAct;
 		QAction *netPlayHostAct;
 		QAction *netPlayJoinAct;
@@ -283,6 +287,7 @@ class  consoleWin_t : public QMainWindow
 #endif
 
 		QTimer  *gameTimer;
+		int      gameTimerPeriod; // while the viewer is visible
 		QColor   videoBgColor;
 		ColorMenuItem *bgColorMenuItem;
 		QTemporaryDir *tempDir;
@@ -320,12 +325,15 @@ class  consoleWin_t : public QMainWindow
 		void dragEnterEvent(QDragEnterEvent *event) override;
 		void dropEvent(QDropEvent *event) override;
 		void showEvent(QShowEvent *event) override;
+		void hideEvent(QHideEvent *event) override;
+		void changeEvent(QEvent *event) override;
 		void contextMenuEvent(QContextMenuEvent *event) override;
 		void syncActionConfig( QAction *act, const char *property );
 		void showErrorMsgWindow(void);
 
 	private:
 		void initHotKeys(void);
+		void updateViewerVisible(void);
 		void initScreenHandler(void);
 		void createMainMenu(void);
 		void buildRecentRomMenu(void);
@@ -337,9 +345,6 @@ class  consoleWin_t : public QMainWindow
 		void loadState(int slot);
 		void transferVideoBuffer(bool allowRedraw);
 		void syncAutoFirePatternMenu(void);
-#ifdef __FCEU_REST_API_ENABLE__
-		RestApiConfig loadRestApiConfig(void);
-#endif
 
 		QString findHelpFile(void);
 
@@ -397,6 +402,7 @@ class  consoleWin_t : public QMainWindow
 		void closeNetPlaySession(void);
 		void openAviRiffViewer(void);
 		void openTimingStatWin(void);
+		void openMutexContentionWin(void);
 		void openMovieOptWin(void);
 		void openCodeDataLogger(void);
 		void openTraceLogger(void);
@@ -506,6 +512,7 @@ class  consoleWin_t : public QMainWindow
 		void wavRecordStart(void);
 		void wavRecordAsStart(void);
 		void wavRecordStop(void);
+		void saveInstantReplay(void);
 		void winScreenChanged( QScreen *scr );
 		void winActiveChanged(void);
 		void emuFrameFinish(void);
@@ -0,0 +1,275 @@
+// EmuStateSnapshot.cpp
+//
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+#include "Qt/EmuStateSnapshot.h"
+#include "../../fceu.h"
+#include "../../cart.h"
+#include "../../ppu.h"
+#include "../../debug.h"
+#include "../../movie.h"
+#include "../../x6502.h"
+
+// Odd while the publisher is writing. Readers copy out what they want and
+// keep it only if the count was even and had not moved by the end.
+static std::atomic<uint32_t> snapSeq(0);
+static std::atomic<int>      snapSubscribers(0);
+static emuStateSnapshot_t    snap;
+
+//----------------------------------------------------------------------------
+static void beginWrite(void)
+{
+	snapSeq.store( snapSeq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+}
+//----------------------------------------------------------------------------
+static void endWrite(void)
+{
+	snapSeq.store( snapSeq.load(std::memory_order_relaxed) + 1, std::memory_order_release );
+}
+//----------------------------------------------------------------------------
+template <typename F> static bool readConsistent( F copy )
+{
+	for (;;)
+	{
+		uint32_t seq = snapSeq.load(std::memory_order_acquire);
+
+		if ( seq & 1 )
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		bool ok = copy();
+
+		std::atomic_thread_fence( std::memory_order_acquire );
+
+		if ( snapSeq.load(std::memory_order_relaxed) == seq )
+		{
+			return ok;
+		}
+	}
+}
+//----------------------------------------------------------------------------
+static int32_t romOffset( const uint8_t *p, int chip, bool chr )
+{
+	const uint8_t *rom  = chr ? CHRptr[chip] : PRGptr[chip];
+	uint32_t       size = chr ? CHRsize[chip] : PRGsize[chip];
+
+	if ( (p == nullptr) || (rom == nullptr) || (p < rom) || (p >= rom + size) )
+	{
+		return -1;
+	}
+	return static_cast<int32_t>(p - rom);
+}
+//----------------------------------------------------------------------------
+static void captureCpu(void)
+{
+	snap.frame = currFrameCounter;
+	snap.pc    = X.PC;
+	snap.a     = X.A;
+	snap.x     = X.X;
+	snap.y     = X.Y;
+	snap.s     = X.S;
+	snap.p     = X.P;
+
+	snap.ramPlain = FCEU_GetPlainMemPtr( 0, 0x800 ) != nullptr;
+
+	if ( snap.ramPlain )
+	{
+		memcpy( snap.ram, RAM, 0x800 );
+	}
+
+	for (int i=0; i<11; i++)
+	{
+		int block = i + 5;
+		uint8_t *page = ReadPage[block];
+
+		snap.cartPlain[i] = (page != nullptr);
+
+		if ( page != nullptr )
+		{
+			memcpy( snap.cart + (i << 12), page + (block << 12), 0x1000 );
+		}
+		else
+		{
+			page = Page[block << 1];
+		}
+		snap.prgRomOffset[i] = romOffset( page ? page + (block << 12) : nullptr, 0, false );
+	}
+}
+//----------------------------------------------------------------------------
+static void capturePpu(void)
+{
+	memcpy( snap.ppuRegs, PPU, 4 );
+	snap.xOffset = XOffset;
+	memcpy( snap.oam, SPRAM, 0x100 );
+
+	for (int i=0; i<8; i++)
+	{
+		const uint8_t *p = VPage[i] ? VPage[i] + (i << 10) : nullptr;
+
+		snap.chrRomOffset[i] = romOffset( p, 0, true );
+	}
+
+	// MMC5 and the like decide what the PPU sees as it reads
+	snap.ppuPlain = (FFCEUX_PPURead == FFCEUX_PPURead_Default) && (PPU_hook == nullptr);
+
+	if ( !snap.ppuPlain )
+	{
+		return;
+	}
+	for (int i=0; i<8; i++)
+	{
+		if ( VPage[i] )
+		{
+			memcpy( snap.chr + (i << 10), VPage[i] + (i << 10), 0x400 );
+		}
+		else
+		{
+			memset( snap.chr + (i << 10), 0, 0x400 );
+		}
+	}
+	for (int i=0; i<4; i++)
+	{
+		if ( vnapage[i] )
+		{
+			memcpy( snap.nametables + (i << 10), vnapage[i], 0x400 );
+		}
+		else
+		{
+			memset( snap.nametables + (i << 10), 0, 0x400 );
+		}
+	}
+	for (int i=0; i<0x20; i++)
+	{
+		snap.palette[i] = FFCEUX_PPURead_Default( 0x3F00 + i );
+	}
+}
+//----------------------------------------------------------------------------
+void emuStateSnapshotPublish(void)
+{
+	if ( snapSubscribers.load(std::memory_order_acquire) == 0 )
+	{
+		// what is there now goes stale, nobody may pick it up later
+		if ( snap.valid )
+		{
+			beginWrite();
+			snap.valid = false;
+			endWrite();
+		}
+		return;
+	}
+	beginWrite();
+
+	snap.valid = (GameInfo != nullptr);
+
+	if ( snap.valid )
+	{
+		captureCpu();
+		capturePpu();
+	}
+	endWrite();
+}
+//----------------------------------------------------------------------------
+void emuStateSnapshotSubscribe(void)
+{
+	snapSubscribers.fetch_add(1, std::memory_order_acq_rel);
+}
+//----------------------------------------------------------------------------
+void emuStateSnapshotUnsubscribe(void)
+{
+	snapSubscribers.fetch_sub(1, std::memory_order_acq_rel);
+}
+//----------------------------------------------------------------------------
+bool emuStateSnapshotGet( emuStateSnapshot_t &out )
+{
+	return readConsistent( [&out]{ memcpy( &out, &snap, sizeof(snap) ); return out.valid; } );
+}
+//----------------------------------------------------------------------------
+bool emuStateSnapshotReadCpu( uint16_t addr, int len, uint8_t *out, int *frame )
+{
+	if ( (len <= 0) || (addr + len > 0x10000) )
+	{
+		return false;
+	}
+	return readConsistent( [=]
+	{
+		if ( !snap.valid )
+		{
+			return false;
+		}
+		for (int i=0; i<len; )
+		{
+			uint32_t a = addr + i;
+			int n;
+
+			if ( a < 0x2000 )
+			{
+				if ( !snap.ramPlain )
+				{
+					return false;
+				}
+				n = 0x800 - (a & 0x7FF);
+				if ( n > len - i ) n = len - i;
+				memcpy( out + i, snap.ram + (a & 0x7FF), n );
+			}
+			else if ( (a >= 0x5000) && snap.cartPlain[(a >> 12) - 5] )
+			{
+				n = 0x1000 - (a & 0xFFF);
+				if ( n > len - i ) n = len - i;
+				memcpy( out + i, snap.cart + (a - 0x5000), n );
+			}
+			else
+			{	// registers, or a block a mapper serves
+				return false;
+			}
+			i += n;
+		}
+		if ( frame )
+		{
+			*frame = snap.frame;
+		}
+		return true;
+	});
+}
+//----------------------------------------------------------------------------
+bool emuStateSnapshotReadPpu( uint16_t addr, int len, uint8_t *out, int *frame )
+{
+	if ( (len <= 0) || (addr + len > 0x4000) )
+	{
+		return false;
+	}
+	return readConsistent( [=]
+	{
+		if ( !snap.valid || !snap.ppuPlain )
+		{
+			return false;
+		}
+		for (int i=0; i<len; i++)
+		{
+			uint32_t a = addr + i;
+
+			if ( a < 0x2000 )
+			{
+				out[i] = snap.chr[a];
+			}
+			else if ( a < 0x3F00 )
+			{
+				out[i] = snap.nametables[a & 0xFFF];
+			}
+			else
+			{
+				out[i] = snap.palette[a & 0x1F];
+			}
+		}
+		if ( frame )
+		{
+			*frame = snap.frame;
+		}
+		return true;
+	});
+}
+//----------------------------------------------------------------------------
@@ -0,0 +1,58 @@
+// EmuStateSnapshot.h
+//
+
+#pragma once
+
+#include <stdint.h>
+
+// A copy of the machine state as it was when the emulator mutex was last
+// released: CPU RAM and registers, the cartridge space, PPU memory and the
+// bank map. The holder of the mutex publishes it on the way out, through a
+// sequence lock, so read-only tools get a consistent view without waiting
+// for the emulator thread to give up the mutex; they still take it for
+// anything that changes the machine. Publishing costs a copy of the state
+// each time the mutex is released, so it is only done while somebody has
+// subscribed.
+struct emuStateSnapshot_t
+{
+	bool     valid;        // false before the first publish, or with no game loaded
+	int      frame;        // currFrameCounter
+
+	uint16_t pc;
+	uint8_t  a, x, y, s, p;
+
+	// Reads that would be served by something other than plain memory, a
+	// mapper register or a cheat, are left out and flagged so.
+	bool     ramPlain;
+	uint8_t  ram[0x800];
+
+	// $5000-$FFFF in 4K blocks
+	bool     cartPlain[11];
+	uint8_t  cart[0xB000];
+	int32_t  prgRomOffset[11]; // into PRG ROM, -1 for RAM or open bus
+
+	// The PPU space, when it is read with no mapper hook
+	bool     ppuPlain;
+	uint8_t  ppuRegs[4];
+	uint8_t  xOffset;
+	uint8_t  chr[0x2000];
+	uint8_t  nametables[0x1000];
+	uint8_t  palette[0x20];
+	uint8_t  oam[0x100];
+	int32_t  chrRomOffset[8];  // of the 1K slots into CHR ROM, -1 for CHR RAM
+};
+
+// Emulator mutex held, the outermost release
+void emuStateSnapshotPublish(void);
+
+// Any thread, without the emulator mutex
+void emuStateSnapshotSubscribe(void);
+void emuStateSnapshotUnsubscribe(void);
+
+// False while nothing valid has been published
+bool emuStateSnapshotGet( emuStateSnapshot_t &out );
+
+// False unless every byte of the range was captured, fall back to reading
+// under the mutex then
+bool emuStateSnapshotReadCpu( uint16_t addr, int len, uint8_t *out, int *frame = nullptr );
+bool emuStateSnapshotReadPpu( uint16_t addr, int len, uint8_t *out, int *frame = nullptr );
@@ -264,6 +264,7 @@ void FamilyKeyboardWidget::mousePressEvent(QMouseEvent * event)
 	if ( (keyPressed >= 0) && (event->button() == Qt::LeftButton) )
 	{
 		key[ keyPressed ].pressed();
+		inputBindingsChanged();
 	}
 	update();
 }
@@ -275,6 +276,7 @@ void FamilyKeyboardWidget::mouseReleaseEvent(QMouseEvent * event)
 	if ( keyPressed >= 0 )
 	{
 		key[ keyPressed ].released();
+		inputBindingsChanged();
 
 		keyPressed = -1;
 	}
@@ -741,6 +743,7 @@ void FKBConfigDialog::resetDefaultMapping(void)
 		fkbmap[j].DeviceNum = devnum;
 		fkbmap[j].ButtonNum = DefaultFamilyKeyBoard[j];
 	}
+	inputBindingsChanged();
 	g_config->save();
 }
 //----------------------------------------------------------------------------
@@ -1275,6 +1278,7 @@ void FKBConfigDialog::mappingLoad(const char *filepath)
 
 		convText2ButtConfig( val, &fkbmap[idx] );
 	}
+	inputBindingsChanged();
 
 	fclose(fp);
 }
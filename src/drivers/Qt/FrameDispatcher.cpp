@@ -0,0 +1,141 @@
+// FrameDispatcher.cpp
+//
+#include <stdio.h>
+
+#include "Qt/FrameDispatcher.h"
+
+//----------------------------------------------------------------------------
+FrameDispatcher::FrameDispatcher(void)
+	: QObject(nullptr), frameCounter(0), wakePending(false), dispatching(false)
+{
+	clock.start();
+}
+//----------------------------------------------------------------------------
+FrameDispatcher *FrameDispatcher::instance(void)
+{
+	static FrameDispatcher *dispatcher = new FrameDispatcher();
+
+	return dispatcher;
+}
+//----------------------------------------------------------------------------
+bool FrameDispatcher::publish(void)
+{
+	frameCounter.fetch_add(1, std::memory_order_release);
+
+	return !wakePending.exchange(true, std::memory_order_acq_rel);
+}
+//----------------------------------------------------------------------------
+void FrameDispatcher::wakeReceived(void)
+{
+	wakePending.store(false, std::memory_order_release);
+}
+//----------------------------------------------------------------------------
+void FrameDispatcher::addView( QWidget *window, int periodMs, std::function<void(void)> func, int flags )
+{
+	View v;
+
+	v.window       = window;
+	v.func         = func;
+	v.periodMs     = periodMs;
+	v.flags        = flags;
+	v.nextRunMs    = 0;
+	v.lastFrame    = frameCount();
+
+	viewList.push_back(v);
+
+	// in case the window goes without removing itself
+	connect( window, &QObject::destroyed, this, [this, window]{ removeView(window); } );
+}
+//----------------------------------------------------------------------------
+void FrameDispatcher::setViewPeriod( QWidget *window, int periodMs )
+{
+	for (size_t i=0; i<viewList.size(); i++)
+	{
+		if ( viewList[i].window == window )
+		{
+			viewList[i].periodMs  = periodMs;
+			viewList[i].nextRunMs = 0;
+		}
+	}
+}
+//----------------------------------------------------------------------------
+void FrameDispatcher::removeView( QWidget *window )
+{
+	for (size_t i=0; i<viewList.size(); )
+	{
+		if ( viewList[i].window != window )
+		{
+			i++;
+		}
+		else if ( dispatching )
+		{
+			// dispatch() is walking the list, it drops the entry when done
+			viewList[i].window = nullptr;
+			i++;
+		}
+		else
+		{
+			viewList.erase( viewList.begin() + i );
+		}
+	}
+}
+//----------------------------------------------------------------------------
+void FrameDispatcher::dispatch(void)
+{
+	if ( dispatching )
+	{	// a view that spun the event loop
+		return;
+	}
+	dispatching = true;
+
+	qint64   now   = clock.elapsed();
+	uint64_t frame = frameCount();
+
+	for (size_t i=0; i<viewList.size(); i++)
+	{
+		View &v = viewList[i];
+
+		if ( v.window == nullptr )
+		{
+			continue;
+		}
+		if ( !(v.flags & WhileHidden) && (!v.window->isVisible() || v.window->isMinimized()) )
+		{
+			continue;
+		}
+		if ( (v.flags & NewFrameOnly) && (v.lastFrame == frame) )
+		{
+			continue;
+		}
+		if ( now + tickSlackMs < v.nextRunMs )
+		{
+			continue;
+		}
+		v.lastFrame = frame;
+		v.nextRunMs += v.periodMs;
+
+		if ( v.nextRunMs + tickSlackMs <= now )
+		{	// fell behind, skip what was missed instead of catching up
+			v.nextRunMs = now + v.periodMs;
+		}
+
+		// the view may add views, which can move the list
+		std::function<void(void)> func = v.func;
+
+		func();
+	}
+
+	for (size_t i=0; i<viewList.size(); )
+	{
+		if ( viewList[i].window == nullptr )
+		{
+			viewList.erase( viewList.begin() + i );
+		}
+		else
+		{
+			i++;
+		}
+	}
+	dispatching = false;
+}
+//----------------------------------------------------------------------------
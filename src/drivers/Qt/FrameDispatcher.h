@@ -0,0 +1,82 @@
+// FrameDispatcher.h
+//
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include <QObject>
+#include <QWidget>
+#include <QElapsedTimer>
+
+// The one way emulated frames reach the GUI. The emulation thread only
+// bumps a frame counter, and wakes the GUI when it is not already due to
+// wake, so frames the GUI was too busy for are folded together rather than
+// queued up. Viewer windows register an update function and the rate they
+// want it at; the console window ticks the dispatcher from its repaint
+// timer and on each wake, and the dispatcher runs the views that are due.
+// A view is not updated while its window is hidden or minimized, unless
+// it asks to be.
+class FrameDispatcher : public QObject
+{
+	Q_OBJECT
+
+	public:
+		static FrameDispatcher *instance(void);
+
+		// Emulation thread, at the end of each pass through the frame loop.
+		// True when the GUI has to be woken, false when a wake is still
+		// pending that this frame is folded into.
+		bool publish(void);
+
+		uint64_t frameCount(void){ return frameCounter.load(std::memory_order_acquire); }
+
+		// GUI thread from here on.
+
+		enum viewFlags
+		{
+			// waits for a frame since its last update as well, with periodMs 0
+			// it is updated once for each wake however many frames that covers
+			NewFrameOnly = 0x01,
+
+			// for views that keep state up to date, not just the display
+			WhileHidden  = 0x02,
+		};
+
+		// Updates the view at most every periodMs
+		void addView( QWidget *window, int periodMs, std::function<void(void)> func, int flags = 0 );
+		void setViewPeriod( QWidget *window, int periodMs );
+		void removeView( QWidget *window );
+
+		// Acknowledges the wake, so the next frame posts a new one
+		void wakeReceived(void);
+
+		void dispatch(void);
+
+	private:
+		FrameDispatcher(void);
+
+		struct View
+		{
+			QWidget *window;
+			std::function<void(void)> func;
+			int      periodMs;
+			int      flags;
+			qint64   nextRunMs;
+			uint64_t lastFrame;
+		};
+		std::vector <View> viewList;
+
+		std::atomic<uint64_t> frameCounter;
+		std::atomic<bool>     wakePending;
+
+		QElapsedTimer clock;
+		bool dispatching;
+
+		// the repaint timer ticks every 8 ms, a view due within half a tick counts as due
+		static constexpr int tickSlackMs = 4;
+};
@@ -37,6 +37,7 @@
 #include "Qt/throttle.h"
 #include "Qt/fceuWrapper.h"
 #include "Qt/FrameTimingStats.h"
+#include "Qt/ConsoleUtilities.h"
 
 //----------------------------------------------------------------------------
 FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
@@ -53,7 +54,7 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 
 	setWindowTitle("Frame Timing Statistics");
 
-	resize(512, 512);
+	resize(512, 720);
 
 	mainLayout = new QVBoxLayout();
 	vbox = new QVBoxLayout();
@@ -90,6 +91,9 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 	frameLateCount = new QTreeWidgetItem();
 	videoTimeAbs = new QTreeWidgetItem();
 	emuSignalDelay = new QTreeWidgetItem();
+	displayPeriod = new QTreeWidgetItem();
+	framesDropped = new QTreeWidgetItem();
+	framesDuplicated = new QTreeWidgetItem();
 
 	tree->addTopLevelItem(frameTimeAbs);
 	tree->addTopLevelItem(frameTimeDel);
@@ -100,6 +104,9 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 	tree->addTopLevelItem(videoTimeAbs);
 	tree->addTopLevelItem(emuSignalDelay);
 	tree->addTopLevelItem(frameLateCount);
+	tree->addTopLevelItem(displayPeriod);
+	tree->addTopLevelItem(framesDropped);
+	tree->addTopLevelItem(framesDuplicated);
 
 	frameTimeAbs->setFlags(Qt::ItemIsEnabled | Qt::ItemNeverHasChildren);
 	frameTimeDel->setFlags(Qt::ItemIsEnabled | Qt::ItemNeverHasChildren);
@@ -113,6 +120,9 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 	frameLateCount->setText(0, tr("Frame Late Count"));
 	emuSignalDelay->setText(0, tr("EMU Signal Delay ms"));
 	videoTimeAbs->setText(0, tr("Video Period ms"));
+	displayPeriod->setText(0, tr("Display Refresh ms"));
+	framesDropped->setText(0, tr("Frames Dropped"));
+	framesDuplicated->setText(0, tr("Frames Shown Twice"));
 
 	frameTimeAbs->setTextAlignment(0, Qt::AlignLeft);
 	frameTimeDel->setTextAlignment(0, Qt::AlignLeft);
@@ -123,6 +133,9 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 	frameLateCount->setTextAlignment(0, Qt::AlignLeft);
 	videoTimeAbs->setTextAlignment(0, Qt::AlignLeft);
 	emuSignalDelay->setTextAlignment(0, Qt::AlignLeft);
+	displayPeriod->setTextAlignment(0, Qt::AlignLeft);
+	framesDropped->setTextAlignment(0, Qt::AlignLeft);
+	framesDuplicated->setTextAlignment(0, Qt::AlignLeft);
 
 	for (int i = 0; i < 4; i++)
 	{
@@ -135,8 +148,59 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 		frameLateCount->setTextAlignment(i + 1, Qt::AlignCenter);
 		videoTimeAbs->setTextAlignment(i + 1, Qt::AlignCenter);
 		emuSignalDelay->setTextAlignment(i + 1, Qt::AlignCenter);
+		displayPeriod->setTextAlignment(i + 1, Qt::AlignCenter);
+		framesDropped->setTextAlignment(i + 1, Qt::AlignCenter);
+		framesDuplicated->setTextAlignment(i + 1, Qt::AlignCenter);
 	}
 
+	// Per stage histograms
+	vbox = new QVBoxLayout();
+	stageFrame = new QGroupBox(tr("Frame Breakdown"));
+	stageFrame->setLayout(vbox);
+
+	stageTree = new QTreeWidget();
+	vbox->addWidget(stageTree);
+
+	stageTree->setColumnCount(6);
+
+	item = new QTreeWidgetItem();
+	item->setText(0, tr("Stage ms"));
+	item->setText(1, tr("Count"));
+	item->setText(2, tr("p50"));
+	item->setText(3, tr("p90"));
+	item->setText(4, tr("p99"));
+	item->setText(5, tr("Maximum"));
+	item->setTextAlignment(0, Qt::AlignLeft);
+
+	for (int i = 1; i < 6; i++)
+	{
+		item->setTextAlignment(i, Qt::AlignCenter);
+	}
+	stageTree->setHeaderItem(item);
+	stageTree->header()->setSectionResizeMode(QHeaderView::Stretch);
+	stageTree->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+
+	const char *stageLabel[FRAME_STAGE_COUNT] =
+	{
+		"Emulate", "Video Post-Processing", "Blit", "Present", "Audio Write", "Emulator Mutex Wait",
+		"Input to Photon"
+	};
+
+	for (int s = 0; s < FRAME_STAGE_COUNT; s++)
+	{
+		stageItem[s] = new QTreeWidgetItem();
+		stageItem[s]->setFlags(Qt::ItemIsEnabled | Qt::ItemNeverHasChildren);
+		stageItem[s]->setText(0, tr(stageLabel[s]));
+		stageItem[s]->setTextAlignment(0, Qt::AlignLeft);
+
+		for (int i = 1; i < 6; i++)
+		{
+			stageItem[s]->setTextAlignment(i, Qt::AlignCenter);
+		}
+		stageTree->addTopLevelItem(stageItem[s]);
+	}
+	stageFrame->setEnabled(stats.enabled);
+
 	hbox = new QHBoxLayout();
 	timingEnable = new QCheckBox(tr("Enable Timing Statistics Calculations"));
 	resetBtn = new QPushButton(tr("Reset"));
@@ -153,6 +217,7 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 
 	mainLayout->addLayout(hbox);
 	mainLayout->addWidget(statFrame);
+	mainLayout->addWidget(stageFrame);
 
 	closeButton = new QPushButton( tr("Close") );
 	closeButton->setIcon(style()->standardIcon(QStyle::SP_DialogCloseButton));
@@ -172,6 +237,7 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 	connect(updateTimer, &QTimer::timeout, this, &FrameTimingDialog_t::updatePeriodic);
 
 	updateTimer->start(200); // 5hz
+	fceuPauseTimerWhileHidden( this, updateTimer );
 
 	restoreGeometry(settings.value("frameTimingWindow/geometry").toByteArray());
 }
@@ -317,9 +383,49 @@ void FrameTimingDialog_t::updateTimingStats(void)
 	frameLateCount->setText(1, tr("0"));
 	frameLateCount->setText(2, tr(stmp));
 
+	// Display feedback, the current column says whether frames are locked to it
+	snprintf(stmp, sizeof(stmp), "%.3f", stats.frameTimeAbs.tgt * 1e3);
+	displayPeriod->setText(1, tr(stmp));
+
+	snprintf(stmp, sizeof(stmp), "%.3f%s", stats.displayPeriod * 1e3, stats.displayLocked ? " (locked)" : "");
+	displayPeriod->setText(2, tr(stmp));
+
+	snprintf(stmp, sizeof(stmp), "%u", stats.framesDropped);
+	framesDropped->setText(1, tr("0"));
+	framesDropped->setText(2, tr(stmp));
+
+	snprintf(stmp, sizeof(stmp), "%u", stats.framesDuplicated);
+	framesDuplicated->setText(1, tr("0"));
+	framesDuplicated->setText(2, tr(stmp));
+
 	statFrame->setEnabled(stats.enabled);
 
+	// Stage histograms
+	for (int s = 0; s < FRAME_STAGE_COUNT; s++)
+	{
+		struct timingHistStat_t stage;
+
+		getFrameStageStats(s, &stage);
+
+		snprintf(stmp, sizeof(stmp), "%llu", stage.count);
+		stageItem[s]->setText(1, tr(stmp));
+
+		snprintf(stmp, sizeof(stmp), "%.3f", stage.p50 * 1e3);
+		stageItem[s]->setText(2, tr(stmp));
+
+		snprintf(stmp, sizeof(stmp), "%.3f", stage.p90 * 1e3);
+		stageItem[s]->setText(3, tr(stmp));
+
+		snprintf(stmp, sizeof(stmp), "%.3f", stage.p99 * 1e3);
+		stageItem[s]->setText(4, tr(stmp));
+
+		snprintf(stmp, sizeof(stmp), "%.3f", stage.max * 1e3);
+		stageItem[s]->setText(5, tr(stmp));
+	}
+	stageFrame->setEnabled(stats.enabled);
+
 	tree->viewport()->update();
+	stageTree->viewport()->update();
 }
 //----------------------------------------------------------------------------
 void FrameTimingDialog_t::updatePeriodic(void)
@@ -18,6 +18,7 @@
 #include <QTreeWidgetItem>
 
 #include "Qt/main.h"
+#include "Qt/throttle.h"
 
 class FrameTimingDialog_t : public QDialog
 {
@@ -41,9 +42,15 @@ protected:
 	QTreeWidgetItem *frameLateCount;
 	QTreeWidgetItem *videoTimeAbs;
 	QTreeWidgetItem *emuSignalDelay;
+	QTreeWidgetItem *displayPeriod;
+	QTreeWidgetItem *framesDropped;
+	QTreeWidgetItem *framesDuplicated;
 	QGroupBox *statFrame;
+	QGroupBox *stageFrame;
 
 	QTreeWidget *tree;
+	QTreeWidget *stageTree;
+	QTreeWidgetItem *stageItem[FRAME_STAGE_COUNT];
 
 private:
 	void updateTimingStats(void);
@@ -909,6 +909,7 @@ void GamePadConfDialog_t::changeButton(int padNo, int x)
 void GamePadConfDialog_t::clearButton(int padNo, int x)
 {
 	GamePad[padNo].bmap[configIndex][x].ButtonNum = -1;
+	inputBindingsChanged();
 
 	//keyName[x]->setText( tr("") );
 	keyName[x]->clear();
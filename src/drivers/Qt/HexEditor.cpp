@@ -51,6 +51,7 @@
 #include "../../ppu.h"
 #include "../../cart.h"
 #include "../../ines.h"
+#include "../../writejournal.h"
 #include "../common/configSys.h"
 
 #include "Qt/main.h"
@@ -62,8 +63,10 @@
 #include "Qt/HexEditor.h"
 #include "Qt/CheatsConf.h"
 #include "Qt/SymbolicDebug.h"
+#include "Qt/ConsoleUtilities.h"
 #include "Qt/ConsoleDebugger.h"
 #include "Qt/ConsoleUtilities.h"
+#include "Qt/FrameDispatcher.h"
 #include "Qt/ConsoleWindow.h"
 
 static bool memNeedsCheck = false;
@@ -357,6 +360,7 @@ static int writeMem( int mode, unsigned int addr, int value )
 			if (addr < 0x2000)
 			{
 				VPage[addr >> 10][addr] = value; //todo: detect if this is vrom and turn it red if so
+				CHRPageVersion[addr >> 10]++;
 			}
 			if ((addr >= 0x2000) && (addr < 0x3F00))
 			{
@@ -372,6 +376,7 @@ static int writeMem( int mode, unsigned int addr, int value )
 		{
 			addr &= 0xFF;
 			SPRAM[addr] = value;
+			FCEUPPU_OAMChanged();
 		}
 		break;
 		case QHexEdit::MODE_NES_ROM:
@@ -388,6 +393,7 @@ static int writeMem( int mode, unsigned int addr, int value )
 			{
 				*(uint8 *)(GetNesCHRPointer(addr-16-PRGsize[0])) = value;
 			}
+			FCEU_RomModified();
 			updateDebugger = true;
 		}
 		break;
@@ -514,6 +520,7 @@ void memBlock_t::init(void)
 		buf[i].actv  = 0;
 		//buf[i].draw  = 1;
 	}
+	actvList.clear();
 }
 //----------------------------------------------------------------------------
 HexBookMark::HexBookMark(void)
@@ -1465,12 +1472,8 @@ HexEditorDialog_t::HexEditorDialog_t(QWidget *parent)
 
 	editor->memModeUpdate();
 
-	periodicTimer  = new QTimer( this );
-
-	connect( periodicTimer, &QTimer::timeout, this, &HexEditorDialog_t::updatePeriodic );
-
 	//printf("Refresh Rate: %i\n", 1000 / refreshRateOpt );
-	periodicTimer->start( 1000 / refreshRateOpt  );
+	FrameDispatcher::instance()->addView( this, 1000 / refreshRateOpt, [this]{ updatePeriodic(); } );
 
 	// Lock the mutex before adding a new window to the list,
 	// we want to be sure that the emulator is not iterating the list
@@ -1493,7 +1496,7 @@ HexEditorDialog_t::~HexEditorDialog_t(void)
 	std::list <HexEditorDialog_t*>::iterator it;
 	  
 	//printf("Hex Editor Deleted\n");
-	periodicTimer->stop();
+	FrameDispatcher::instance()->removeView( this );
 
 	// Lock the emulation thread mutex to ensure
 	// that the emulator is not attempting to update memory values
@@ -1752,48 +1755,42 @@ void HexEditorDialog_t::setViewRefresh5Hz(void)
 {
 	refreshRateOpt = 5;
 	g_config->setOption("SDL.HexEditRefreshRate", 5);
-	periodicTimer->stop();
-	periodicTimer->start(200);
+	FrameDispatcher::instance()->setViewPeriod( this, 200 );
 }
 //----------------------------------------------------------------------------
 void HexEditorDialog_t::setViewRefresh10Hz(void)
 {
 	refreshRateOpt = 10;
 	g_config->setOption("SDL.HexEditRefreshRate", 10);
-	periodicTimer->stop();
-	periodicTimer->start(100);
+	FrameDispatcher::instance()->setViewPeriod( this, 100 );
 }
 //----------------------------------------------------------------------------
 void HexEditorDialog_t::setViewRefresh20Hz(void)
 {
 	refreshRateOpt = 20;
 	g_config->setOption("SDL.HexEditRefreshRate", 20);
-	periodicTimer->stop();
-	periodicTimer->start(50);
+	FrameDispatcher::instance()->setViewPeriod( this, 50 );
 }
 //----------------------------------------------------------------------------
 void HexEditorDialog_t::setViewRefresh30Hz(void)
 {
 	refreshRateOpt = 30;
 	g_config->setOption("SDL.HexEditRefreshRate", 30);
-	periodicTimer->stop();
-	periodicTimer->start(33);
+	FrameDispatcher::instance()->setViewPeriod( this, 33 );
 }
 //----------------------------------------------------------------------------
 void HexEditorDialog_t::setViewRefresh50Hz(void)
 {
 	refreshRateOpt = 50;
 	g_config->setOption("SDL.HexEditRefreshRate", 50);
-	periodicTimer->stop();
-	periodicTimer->start(20);
+	FrameDispatcher::instance()->setViewPeriod( this, 20 );
 }
 //----------------------------------------------------------------------------
 void HexEditorDialog_t::setViewRefresh60Hz(void)
 {
 	refreshRateOpt = 60;
 	g_config->setOption("SDL.HexEditRefreshRate", 60);
-	periodicTimer->stop();
-	periodicTimer->start(16);
+	FrameDispatcher::instance()->setViewPeriod( this, 16 );
 }
 //----------------------------------------------------------------------------
 void HexEditorDialog_t::actvHighlightCB(bool enable)
@@ -2011,6 +2008,8 @@ QHexEdit::QHexEdit(QWidget *parent)
 	reverseVideo = true;
 	actvHighlightEnable = true;
 	total_instructions_lp = 0;
+	snapLineOffset = 0;
+	snapStart = snapEnd = 0;
 	pxLineXScroll = 0;
 	jumpToRomValue = 0;
 	ctxAddr = 0;
@@ -3160,6 +3159,15 @@ void QHexEdit::contextMenuEvent(QContextMenuEvent *event)
 			menu.addAction(act);
 			connect( act, SIGNAL(triggered(void)), this, SLOT(addRamExecuteBP(void)) );
 
+			if ( FCEUI_WriteJournalCovers( addr ) )
+			{
+				snprintf( stmp, sizeof(stmp), "Show &Last Writers of Address $%04X", addr );
+				act = new QAction(tr(stmp), &menu);
+				act->setEnabled( FCEUI_GetWriteJournal() > 0 );
+				menu.addAction(act);
+				connect( act, SIGNAL(triggered(void)), this, SLOT(showLastWriters(void)) );
+			}
+
 			if ( addr > 0x6000 )
 			{
 				int romAddr = GetNesFileAddress(addr);
@@ -3478,6 +3486,11 @@ void QHexEdit::addRamWriteBP(void)
 	}
 }
 //----------------------------------------------------------------------------
+void QHexEdit::showLastWriters(void)
+{
+	fceuShowLastWriters( this, ctxAddr );
+}
+//----------------------------------------------------------------------------
 void QHexEdit::addRamExecuteBP(void)
 {
 	int retval, type;
@@ -3572,7 +3585,7 @@ void QHexEdit::requestUpdate(void)
 // registers (especially controller registers $4016 and $4017)
 int QHexEdit::checkMemActivity(void)
 {
-	int c;
+	int c, n, lines, start, end;
 
 	// Don't perform memory activity checks when:
 	// 1. In ROM View Mode
@@ -3587,25 +3600,64 @@ int QHexEdit::checkMemActivity(void)
 		}
 	}
 
-	for (int i=0; i<mb.size(); i++)
+	if ( memAccessFunc == NULL )
 	{
-		c = memAccessFunc(i);
+		return -1;
+	}
 
-		if ( c != mb.buf[i].data )
+	// Fade the highlights. Only bytes on the list have one, so this does
+	// not touch the rest of the block.
+	n = 0;
+
+	for (size_t i=0; i<mb.actvList.size(); i++)
+	{
+		int ofs = mb.actvList[i];
+
+		if ( --mb.buf[ofs].actv > 0 )
 		{
-			mb.buf[i].actv  = 15;
-			mb.buf[i].data  = c;
-			//mb.buf[i].draw  = 1;
+			mb.actvList[n++] = ofs;
 		}
-		else
+	}
+	mb.actvList.resize(n);
+
+	// Only the rows in view and a page either side of them are read, a
+	// 64K view would otherwise cost 64K reads a frame. The paint event asks
+	// for a new check when the view scrolls. Bytes that were not read by
+	// the last check are taken as they are, without a change highlight.
+	lines = (viewLines > 0) ? viewLines : 1;
+	start = (lineOffset - lines) * 16;
+	end   = (lineOffset + 2*lines) * 16;
+
+	if ( start < 0 )
+	{
+		start = 0;
+	}
+	if ( end > mb.size() )
+	{
+		end = mb.size();
+	}
+
+	for (int i=start; i<end; i++)
+	{
+		c = memAccessFunc(i);
+
+		if ( c != mb.buf[i].data )
 		{
-			if ( mb.buf[i].actv > 0 )
+			if ( (i >= snapStart) && (i < snapEnd) )
 			{
-				//mb.buf[i].draw = 1;
-				mb.buf[i].actv--;
+				if ( mb.buf[i].actv == 0 )
+				{
+					mb.actvList.push_back(i);
+				}
+				mb.buf[i].actv  = 15;
 			}
+			mb.buf[i].data  = c;
+			//mb.buf[i].draw  = 1;
 		}
 	}
+	snapLineOffset = lineOffset;
+	snapStart = start;
+	snapEnd   = end;
 	total_instructions_lp = total_instructions;
 	updateRequested = false;
 
@@ -3844,6 +3896,12 @@ void QHexEdit::paintEvent(QPaintEvent *event)
 	{
 		lineOffset = maxLineOffset;
 	}
+
+	if ( lineOffset != snapLineOffset )
+	{
+		// rows that scrolled into view have not been read yet
+		updateRequested = true;
+	}
 	
 	painter.fillRect( 0, 0, w, h, bgColor );
 
@@ -44,6 +44,7 @@ struct memBlock_t
 	void setAccessFunc( int (*newMemAccessFunc)( unsigned int offset) );
 
 	struct memByte_t *buf;
+	std::vector<int> actvList; // offsets with actv > 0
 	int  _size;
 	int  _maxLines;
 	int (*memAccessFunc)( unsigned int offset);
@@ -194,6 +195,9 @@ class QHexEdit : public QWidget
 		HexEditorDialog_t *parent;
 
 		uint64_t total_instructions_lp;
+		int snapLineOffset;  // first row of the last memory activity check
+		int snapStart;       // bytes read by the last check
+		int snapEnd;
 
 		int viewMode;
 		int lineOffset;
@@ -253,6 +257,7 @@ class QHexEdit : public QWidget
 		void addRamReadBP(void);
 		void addRamWriteBP(void);
 		void addRamExecuteBP(void);
+		void showLastWriters(void);
 		void addPpuReadBP(void);
 		void addPpuWriteBP(void);
 		void frzRamSet(void);
@@ -307,7 +312,6 @@ class HexEditorDialog_t : public QDialog
 
 		QScrollBar *vbar;
 		QScrollBar *hbar;
-		QTimer     *periodicTimer;
 		QMenu      *bookmarkMenu;
 		QAction    *viewRAM;
 		QAction    *viewPPU;
@@ -31,6 +31,7 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QSettings>
+#include <QFileInfo>
 
 #include "../../fceu.h"
 
@@ -47,8 +48,11 @@
 #include "Qt/keyscan.h"
 #include "Qt/fceuWrapper.h"
 #include "Qt/ConsoleUtilities.h"
+#ifdef __FCEU_QSCRIPT_ENABLE__
+#include "Qt/QtScriptManager.h"
+#endif
 
-static bool luaScriptRunning = false;
+static int luaScriptsRunning = 0;
 static bool updateLuaDisplay = false;
 static bool openLuaKillMsgBox = false;
 static int luaKillMsgBoxRetVal = 0;
@@ -142,7 +146,7 @@ LuaControlDialog_t::LuaControlDialog_t(QWidget *parent)
 	browseButton = new QPushButton(tr("Browse"));
 	stopButton = new QPushButton(tr("Stop"));
 
-	if (luaScriptRunning)
+	if (luaScriptsRunning > 0)
 	{
 		startButton = new QPushButton(tr("Restart"));
 	}
@@ -150,16 +154,20 @@ LuaControlDialog_t::LuaControlDialog_t(QWidget *parent)
 	{
 		startButton = new QPushButton(tr("Start"));
 	}
+	// runs the script next to the ones running
+	addButton = new QPushButton(tr("Add"));
 
-	stopButton->setEnabled(luaScriptRunning);
+	stopButton->setEnabled(luaScriptsRunning > 0);
 
 	connect(browseButton, SIGNAL(clicked()), this, SLOT(openLuaScriptFile(void)));
 	connect(stopButton, SIGNAL(clicked()), this, SLOT(stopLuaScript(void)));
 	connect(startButton, SIGNAL(clicked()), this, SLOT(startLuaScript(void)));
+	connect(addButton, SIGNAL(clicked()), this, SLOT(addLuaScript(void)));
 
 	hbox->addWidget(browseButton);
 	hbox->addWidget(stopButton);
 	hbox->addWidget(startButton);
+	hbox->addWidget(addButton);
 
 	mainLayout->addWidget(lbl);
 	mainLayout->addWidget(scriptPath);
@@ -177,6 +185,40 @@ LuaControlDialog_t::LuaControlDialog_t(QWidget *parent)
 	mainLayout->addWidget(lbl);
 	mainLayout->addWidget(luaOutput);
 
+	// which scripts slow emulation down, refreshed with the window
+	lbl = new QLabel(tr("Running Scripts:"));
+	mainLayout->addWidget(lbl);
+
+	scriptTree = new QTreeWidget();
+	scriptTree->setColumnCount(7);
+	scriptTree->setHeaderLabels( QStringList() << tr("Script") << tr("ms/frame") << tr("Avg") <<
+			tr("Peak") << tr("Hook Calls") << tr("Budget") << tr("Skipped") );
+	scriptTree->setRootIsDecorated(false);
+	scriptTree->setSelectionMode(QAbstractItemView::SingleSelection);
+	mainLayout->addWidget(scriptTree);
+
+	hbox = new QHBoxLayout();
+	stopScriptButton = new QPushButton(tr("Stop Selected"));
+	connect(stopScriptButton, SIGNAL(clicked()), this, SLOT(stopSelectedScript(void)));
+
+	// applies to the selected script and to the ones added after
+	lbl = new QLabel(tr("Budget (ms/frame, 0 = none):"));
+	budgetSpin = new QDoubleSpinBox();
+	budgetSpin->setRange(0.0, 100.0);
+	budgetSpin->setDecimals(2);
+	budgetSpin->setSingleStep(0.5);
+	connect(budgetSpin, SIGNAL(valueChanged(double)), this, SLOT(budgetChanged(double)));
+
+	hbox->addWidget(stopScriptButton);
+	hbox->addStretch(5);
+	hbox->addWidget(lbl);
+	hbox->addWidget(budgetSpin);
+	mainLayout->addLayout(hbox);
+
+	cpuUsageLbl = new QLabel();
+	cpuUsageLbl->setTextInteractionFlags(Qt::TextSelectableByMouse);
+	mainLayout->addWidget(cpuUsageLbl);
+
 	closeButton = new QPushButton( tr("Close") );
 	closeButton->setIcon(style()->standardIcon(QStyle::SP_DialogCloseButton));
 	connect(closeButton, SIGNAL(clicked(void)), this, SLOT(closeWindow(void)));
@@ -250,6 +292,105 @@ void LuaControlDialog_t::updatePeriodic(void)
 		openLuaKillMessageBox();
 		openLuaKillMsgBox = false;
 	}
+	updateCpuUsage();
+}
+//----------------------------------------------------
+static QString cpuUsageText(const QString& name, double frameUs, double avgUs, double peakUs)
+{
+	// share of a 60 Hz frame
+	return QString("%1: %2 ms/frame (avg %3, peak %4, %5% of a frame)")
+		.arg(name)
+		.arg(frameUs / 1000.0, 0, 'f', 2)
+		.arg(avgUs / 1000.0, 0, 'f', 2)
+		.arg(peakUs / 1000.0, 0, 'f', 2)
+		.arg(avgUs * 100.0 / 16639.0, 0, 'f', 1);
+}
+//----------------------------------------------------
+void LuaControlDialog_t::updateCpuUsage(void)
+{
+	QStringList lines;
+#ifdef _S9XLUA_H
+	std::vector<LuaScriptStatus> scripts;
+
+	if (luaScriptsRunning > 0)
+	{
+		FCEU_WRAPPER_LOCK();
+		FCEU_LuaGetScripts(scripts);
+		FCEU_WRAPPER_UNLOCK();
+	}
+
+	// the rows are kept by script id, so the selection stays put
+	for (int i = scriptTree->topLevelItemCount() - 1; i >= 0; i--)
+	{
+		int id = scriptTree->topLevelItem(i)->data(0, Qt::UserRole).toInt();
+		bool found = false;
+
+		for (size_t j = 0; j < scripts.size(); j++)
+		{
+			found = found || (scripts[j].id == id);
+		}
+		if (!found)
+		{
+			delete scriptTree->takeTopLevelItem(i);
+		}
+	}
+
+	for (size_t j = 0; j < scripts.size(); j++)
+	{
+		const LuaScriptStatus &s = scripts[j];
+		QTreeWidgetItem *item = nullptr;
+
+		for (int i = 0; i < scriptTree->topLevelItemCount(); i++)
+		{
+			if (scriptTree->topLevelItem(i)->data(0, Qt::UserRole).toInt() == s.id)
+			{
+				item = scriptTree->topLevelItem(i);
+				break;
+			}
+		}
+		if (item == nullptr)
+		{
+			item = new QTreeWidgetItem();
+			item->setData(0, Qt::UserRole, s.id);
+			scriptTree->addTopLevelItem(item);
+		}
+
+		item->setText(0, QFileInfo(QString::fromLocal8Bit(s.name.c_str())).fileName() +
+				(s.running ? QString() : tr(" (finished)")));
+		item->setText(1, QString::number(s.usage.frameUs / 1000.0, 'f', 2));
+		item->setText(2, QString::number(s.usage.avgUs / 1000.0, 'f', 2));
+		item->setText(3, QString::number(s.usage.peakUs / 1000.0, 'f', 2));
+		item->setText(4, QString::number(s.usage.hookCalls));
+		item->setText(5, (s.usage.budgetUs > 0) ? QString::number(s.usage.budgetUs / 1000.0, 'f', 2) : tr("none"));
+		item->setText(6, QString::number(s.usage.skippedCalls));
+	}
+	stopScriptButton->setEnabled(scriptTree->currentItem() != nullptr);
+#endif
+#ifdef __FCEU_QSCRIPT_ENABLE__
+	QtScriptManager* jsMgr = QtScriptManager::getInstance();
+
+	if (jsMgr != nullptr)
+	{
+		QList<QtScriptManager::ScriptCpuUsage> jsUsage;
+
+		jsMgr->getCpuUsage(jsUsage);
+
+		for (auto& item : jsUsage)
+		{
+			QString name = QFileInfo(item.srcFile).fileName();
+
+			lines << cpuUsageText(tr("JS ") + name, item.usage.frameUs, item.usage.avgUs, item.usage.peakUs);
+		}
+	}
+#endif
+	if (lines.isEmpty())
+	{
+		cpuUsageLbl->setText(tr("No script running"));
+	}
+	else
+	{
+		cpuUsageLbl->setText(lines.join("\n"));
+	}
 }
 //----------------------------------------------------
 void LuaControlDialog_t::openLuaKillMessageBox(void)
@@ -430,6 +571,27 @@ void LuaControlDialog_t::startLuaScript(void)
 #endif
 }
 //----------------------------------------------------
+void LuaControlDialog_t::addLuaScript(void)
+{
+#ifdef _S9XLUA_H
+	int id;
+
+	FCEU_WRAPPER_LOCK();
+	id = FCEU_LuaAddScript(scriptPath->text().toLocal8Bit().constData(), scriptArgs->text().toLocal8Bit().constData());
+	if (0 == id)
+	{
+		char error_msg[2048];
+		snprintf( error_msg, sizeof(error_msg), "Error: Could not open the selected lua script: '%s'\n", scriptPath->text().toLocal8Bit().constData());
+		FCEUD_PrintError(error_msg);
+	}
+	else
+	{
+		FCEU_LuaSetScriptBudget(id, budgetSpin->value() * 1000.0);
+	}
+	FCEU_WRAPPER_UNLOCK();
+#endif
+}
+//----------------------------------------------------
 void LuaControlDialog_t::stopLuaScript(void)
 {
 #ifdef _S9XLUA_H
@@ -439,12 +601,42 @@ void LuaControlDialog_t::stopLuaScript(void)
 #endif
 }
 //----------------------------------------------------
+void LuaControlDialog_t::stopSelectedScript(void)
+{
+#ifdef _S9XLUA_H
+	QTreeWidgetItem *item = scriptTree->currentItem();
+
+	if (item == nullptr)
+	{
+		return;
+	}
+	FCEU_WRAPPER_LOCK();
+	FCEU_LuaStopScript(item->data(0, Qt::UserRole).toInt());
+	FCEU_WRAPPER_UNLOCK();
+#endif
+}
+//----------------------------------------------------
+void LuaControlDialog_t::budgetChanged(double ms)
+{
+#ifdef _S9XLUA_H
+	QTreeWidgetItem *item = scriptTree->currentItem();
+
+	if (item == nullptr)
+	{
+		return;
+	}
+	FCEU_WRAPPER_LOCK();
+	FCEU_LuaSetScriptBudget(item->data(0, Qt::UserRole).toInt(), ms * 1000.0);
+	FCEU_WRAPPER_UNLOCK();
+#endif
+}
+//----------------------------------------------------
 void LuaControlDialog_t::refreshState(void)
 {
 	int i;
 	std::string luaOutputText;
 
-	if (luaScriptRunning)
+	if (luaScriptsRunning > 0)
 	{
 		stopButton->setEnabled(true);
 		startButton->setText(tr("Restart"));
@@ -481,18 +673,21 @@ static void updateLuaWindows(void)
 //----------------------------------------------------
 void WinLuaOnStart(intptr_t hDlgAsInt)
 {
-	luaScriptRunning = true;
+	luaScriptsRunning++;
 
-	//printf("Lua Script Running: %i \n", luaScriptRunning );
+	//printf("Lua Scripts Running: %i \n", luaScriptsRunning );
 
 	updateLuaDisplay = true;
 }
 //----------------------------------------------------
 void WinLuaOnStop(intptr_t hDlgAsInt)
 {
-	luaScriptRunning = false;
+	if (luaScriptsRunning > 0)
+	{
+		luaScriptsRunning--;
+	}
 
-	//printf("Lua Script Running: %i \n", luaScriptRunning );
+	//printf("Lua Scripts Running: %i \n", luaScriptsRunning );
 
 	updateLuaDisplay = true;
 }
@@ -18,6 +18,8 @@
 #include <QGroupBox>
 #include <QLineEdit>
 #include <QTextEdit>
+#include <QTreeWidget>
+#include <QDoubleSpinBox>
 
 #include "Qt/main.h"
 
@@ -41,16 +43,25 @@ protected:
 	QPushButton *browseButton;
 	QPushButton *stopButton;
 	QPushButton *startButton;
+	QPushButton *addButton;
 	QTextEdit *luaOutput;
+	QTreeWidget *scriptTree;
+	QPushButton *stopScriptButton;
+	QDoubleSpinBox *budgetSpin;
+	QLabel    *cpuUsageLbl;
 
 private:
 public slots:
 	void closeWindow(void);
 private slots:
 	void updatePeriodic(void);
+	void updateCpuUsage(void);
 	void openLuaScriptFile(void);
 	void startLuaScript(void);
+	void addLuaScript(void);
 	void stopLuaScript(void);
+	void stopSelectedScript(void);
+	void budgetChanged(double ms);
 };
 
 // Formatted print
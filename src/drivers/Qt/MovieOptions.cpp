@@ -71,6 +71,7 @@ MovieOptionsDialog_t::MovieOptionsDialog_t(QWidget *parent)
 	aviEnableHUD = new QCheckBox(tr("AVI Enable HUD Recording"));
 	aviEnableMsg = new QCheckBox(tr("AVI Enable Msg Recording"));
 	aviEnableAudio = new QCheckBox(tr("AVI Enable Audio Recording"));
+	aviDropFrames = new QCheckBox(tr("AVI Drop Frames When Encoder Falls Behind"));
 
 	lbl = new QLabel(tr("Loading states in record mode will not immediately truncate movie, next frame input will. (VBA-rr and SNES9x style)"));
 	lbl->setWordWrap(true);
@@ -86,6 +87,7 @@ MovieOptionsDialog_t::MovieOptionsDialog_t(QWidget *parent)
 	vbox1->addWidget(aviEnableHUD);
 	vbox1->addWidget(aviEnableMsg);
 	vbox1->addWidget(aviEnableAudio);
+	vbox1->addWidget(aviDropFrames);
 	vbox1->addWidget(lbl);
 
 	readOnlyReplay->setChecked(suggestReadOnlyReplay);
@@ -99,6 +101,7 @@ MovieOptionsDialog_t::MovieOptionsDialog_t(QWidget *parent)
 	aviEnableHUD->setChecked(FCEUI_AviEnableHUDrecording());
 	aviEnableMsg->setChecked(!FCEUI_AviDisableMovieMessages());
 	aviEnableAudio->setChecked(aviGetAudioEnable());
+	aviDropFrames->setChecked(aviGetDropFramesEnable());
 
 	closeButton = new QPushButton( tr("Close") );
 	closeButton->setIcon(style()->standardIcon(QStyle::SP_DialogCloseButton));
@@ -165,6 +168,7 @@ MovieOptionsDialog_t::MovieOptionsDialog_t(QWidget *parent)
 	connect(aviEnableHUD  , SIGNAL(stateChanged(int)), this, SLOT(setAviHudEnable(int)));
 	connect(aviEnableMsg  , SIGNAL(stateChanged(int)), this, SLOT(setAviMsgEnable(int)));
 	connect(aviEnableAudio, SIGNAL(stateChanged(int)), this, SLOT(setAviAudioEnable(int)));
+	connect(aviDropFrames , SIGNAL(stateChanged(int)), this, SLOT(setAviDropFrames(int)));
 
 	connect(aviBackend, SIGNAL(currentIndexChanged(int)), this, SLOT(aviBackendChanged(int)));
 
@@ -257,6 +261,13 @@ void MovieOptionsDialog_t::setAviAudioEnable(int state)
 	aviSetAudioEnable( checked );
 }
 //----------------------------------------------------------------------------
+void MovieOptionsDialog_t::setAviDropFrames(int state)
+{
+	bool checked = (state != Qt::Unchecked);
+
+	aviSetDropFramesEnable( checked );
+}
+//----------------------------------------------------------------------------
 void MovieOptionsDialog_t::autoBackUpChanged(int state)
 {
 	autoMovieBackup = (state != Qt::Unchecked);
@@ -41,6 +41,7 @@ protected:
 	QCheckBox *aviEnableHUD;
 	QCheckBox *aviEnableMsg;
 	QCheckBox *aviEnableAudio;
+	QCheckBox *aviDropFrames;
 	QComboBox *aviBackend;
 	QStackedWidget *aviPageStack;
 
@@ -57,6 +58,7 @@ private slots:
 	void setAviHudEnable(int state);
 	void setAviMsgEnable(int state);
 	void setAviAudioEnable(int state);
+	void setAviDropFrames(int state);
 	void autoBackUpChanged(int state);
 	void loadFullStatesChanged(int state);
 	void aviBackendChanged(int idx);
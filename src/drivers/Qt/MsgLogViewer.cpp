@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <mutex>
 
 #ifdef WIN32
 #include <Windows.h>
@@ -41,6 +42,7 @@
 #include "Qt/fceuWrapper.h"
 #include "Qt/MsgLogViewer.h"
 #include "Qt/ConsoleWindow.h"
+#include "Qt/ConsoleUtilities.h"
 
 #define MSG_LOG_MAX_LINES 256
 
@@ -92,13 +94,19 @@ public:
 
 	void clear(void)
 	{
+		std::lock_guard<std::mutex> lock(mutex);
+
 		head = tail = 0;
 	}
 
+	// FCEUD_Message calls this from the logger thread (see msglog.h), the
+	// viewer reads back from the GUI thread
 	void addLine(const char *txt, bool NewLine = false)
 	{
 		long ofs;
 
+		std::lock_guard<std::mutex> lock(mutex);
+
 		if (fp == NULL)
 			return;
 
@@ -129,6 +137,8 @@ public:
 
 	size_t getTotalLineCount(void)
 	{
+		std::lock_guard<std::mutex> lock(mutex);
+
 		return totalLines;
 	}
 
@@ -149,6 +159,8 @@ public:
 	{
 		long ofs, nbytes;
 
+		std::lock_guard<std::mutex> lock(mutex);
+
 		if (fp == NULL)
 		{
 			return;
@@ -175,6 +187,7 @@ public:
 	}
 
 private:
+	std::mutex mutex;
 	FILE *fp;
 	size_t maxLines;
 	size_t totalLines;
@@ -229,6 +242,7 @@ MsgLogViewDialog_t::MsgLogViewDialog_t(QWidget *parent)
 	connect(updateTimer, &QTimer::timeout, this, &MsgLogViewDialog_t::updatePeriodic);
 
 	updateTimer->start(500); // 2hz
+	fceuPauseTimerWhileHidden( this, updateTimer );
 
 	FCEU_WRAPPER_LOCK();
 
@@ -0,0 +1,196 @@
+// MutexContention.cpp
+//
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <QHeaderView>
+#include <QCloseEvent>
+#include <QSettings>
+
+#include "Qt/main.h"
+#include "Qt/fceuWrapper.h"
+#include "Qt/MutexContention.h"
+#include "Qt/ConsoleUtilities.h"
+
+enum
+{
+	COL_SITE = 0,
+	COL_FUNC,
+	COL_LOCKS,
+	COL_TIMEOUTS,
+	COL_EMU_BLOCKED,
+	COL_WAIT_P50,
+	COL_WAIT_P99,
+	COL_WAIT_MAX,
+	COL_HOLD_P50,
+	COL_HOLD_P99,
+	COL_HOLD_MAX,
+	COL_HOLD_TOTAL,
+	COL_COUNT
+};
+
+//----------------------------------------------------------------------------
+MutexContentionDialog_t::MutexContentionDialog_t(QWidget *parent)
+	: QDialog(parent)
+{
+	QVBoxLayout *mainLayout;
+	QHBoxLayout *hbox;
+	QTreeWidgetItem *item;
+	QPushButton *resetBtn, *closeButton;
+	QSettings settings;
+
+	setWindowTitle("Emulator Mutex Contention");
+
+	resize(1024, 480);
+
+	mainLayout = new QVBoxLayout();
+
+	summaryLbl = new QLabel();
+	mainLayout->addWidget(summaryLbl);
+
+	tree = new QTreeWidget();
+	tree->setColumnCount(COL_COUNT);
+	tree->setRootIsDecorated(false);
+
+	item = new QTreeWidgetItem();
+	item->setText(COL_SITE, tr("Call Site"));
+	item->setText(COL_FUNC, tr("Function"));
+	item->setText(COL_LOCKS, tr("Locks"));
+	item->setText(COL_TIMEOUTS, tr("Timeouts"));
+	item->setText(COL_EMU_BLOCKED, tr("Emu Blocked ms"));
+	item->setText(COL_WAIT_P50, tr("Wait p50"));
+	item->setText(COL_WAIT_P99, tr("Wait p99"));
+	item->setText(COL_WAIT_MAX, tr("Wait Max"));
+	item->setText(COL_HOLD_P50, tr("Hold p50"));
+	item->setText(COL_HOLD_P99, tr("Hold p99"));
+	item->setText(COL_HOLD_MAX, tr("Hold Max"));
+	item->setText(COL_HOLD_TOTAL, tr("Hold Total ms"));
+
+	for (int i = COL_LOCKS; i < COL_COUNT; i++)
+	{
+		item->setTextAlignment(i, Qt::AlignCenter);
+	}
+	tree->setHeaderItem(item);
+	tree->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+	mainLayout->addWidget(tree);
+
+	resetBtn = new QPushButton(tr("Reset"));
+	resetBtn->setIcon(style()->standardIcon(QStyle::SP_DialogResetButton));
+	connect(resetBtn, SIGNAL(clicked(void)), this, SLOT(resetClicked(void)));
+
+	closeButton = new QPushButton( tr("Close") );
+	closeButton->setIcon(style()->standardIcon(QStyle::SP_DialogCloseButton));
+	connect(closeButton, SIGNAL(clicked(void)), this, SLOT(closeWindow(void)));
+
+	hbox = new QHBoxLayout();
+	hbox->addWidget( resetBtn, 1 );
+	hbox->addStretch(5);
+	hbox->addWidget( closeButton, 1 );
+	mainLayout->addLayout( hbox );
+
+	setLayout(mainLayout);
+
+	updateStats();
+
+	updateTimer = new QTimer(this);
+
+	connect(updateTimer, &QTimer::timeout, this, &MutexContentionDialog_t::updatePeriodic);
+
+	updateTimer->start(500); // 2hz
+	fceuPauseTimerWhileHidden( this, updateTimer );
+
+	restoreGeometry(settings.value("mutexContentionWindow/geometry").toByteArray());
+}
+//----------------------------------------------------------------------------
+MutexContentionDialog_t::~MutexContentionDialog_t(void)
+{
+	QSettings settings;
+
+	updateTimer->stop();
+
+	settings.setValue("mutexContentionWindow/geometry", saveGeometry());
+}
+//----------------------------------------------------------------------------
+void MutexContentionDialog_t::closeEvent(QCloseEvent *event)
+{
+	done(0);
+	deleteLater();
+	event->accept();
+}
+//----------------------------------------------------------------------------
+void MutexContentionDialog_t::closeWindow(void)
+{
+	done(0);
+	deleteLater();
+}
+//----------------------------------------------------------------------------
+void MutexContentionDialog_t::updateStats(void)
+{
+	char stmp[128];
+	std::vector <fceuMutexSiteStat_t> stats;
+	double emuBlocked = 0.0;
+
+	fceuWrapperGetMutexStats( stats );
+
+	// One row per site, worst first; rows are reused between updates
+	while ( tree->topLevelItemCount() > (int)stats.size() )
+	{
+		delete tree->takeTopLevelItem( tree->topLevelItemCount() - 1 );
+	}
+	while ( tree->topLevelItemCount() < (int)stats.size() )
+	{
+		QTreeWidgetItem *item = new QTreeWidgetItem();
+
+		item->setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemNeverHasChildren);
+
+		for (int i = COL_LOCKS; i < COL_COUNT; i++)
+		{
+			item->setTextAlignment(i, Qt::AlignRight);
+		}
+		tree->addTopLevelItem(item);
+	}
+
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		const fceuMutexSiteStat_t &s = stats[i];
+		QTreeWidgetItem *item = tree->topLevelItem(i);
+		const double ms[] = { s.emuBlocked, s.wait.p50, s.wait.p99, s.wait.max,
+		                      s.hold.p50, s.hold.p99, s.hold.max, s.hold.total };
+
+		item->setText(COL_SITE, QString::fromLocal8Bit(s.site.c_str()));
+		item->setText(COL_FUNC, QString::fromLocal8Bit(s.func.c_str()));
+
+		snprintf(stmp, sizeof(stmp), "%llu", s.locks);
+		item->setText(COL_LOCKS, tr(stmp));
+
+		snprintf(stmp, sizeof(stmp), "%llu", s.timeouts);
+		item->setText(COL_TIMEOUTS, tr(stmp));
+
+		for (int j = 0; j < (int)(sizeof(ms) / sizeof(ms[0])); j++)
+		{
+			snprintf(stmp, sizeof(stmp), "%.3f", ms[j] * 1e3);
+			item->setText(COL_EMU_BLOCKED + j, tr(stmp));
+		}
+		emuBlocked += s.emuBlocked;
+	}
+
+	snprintf(stmp, sizeof(stmp), "%zu call sites, emulator thread blocked by other holders for %.1f ms in total",
+			stats.size(), emuBlocked * 1e3);
+	summaryLbl->setText(tr(stmp));
+}
+//----------------------------------------------------------------------------
+void MutexContentionDialog_t::updatePeriodic(void)
+{
+	updateStats();
+}
+//----------------------------------------------------------------------------
+void MutexContentionDialog_t::resetClicked(void)
+{
+	fceuWrapperResetMutexStats();
+
+	updateStats();
+}
+//----------------------------------------------------------------------------
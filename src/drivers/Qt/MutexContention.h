@@ -0,0 +1,41 @@
+// MutexContention.h
+//
+
+#pragma once
+
+#include <QWidget>
+#include <QDialog>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QPushButton>
+#include <QLabel>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QTreeWidgetItem>
+
+#include "Qt/main.h"
+
+class MutexContentionDialog_t : public QDialog
+{
+	Q_OBJECT
+
+public:
+	MutexContentionDialog_t(QWidget *parent = 0);
+	~MutexContentionDialog_t(void);
+
+protected:
+	void closeEvent(QCloseEvent *event);
+
+	QTimer *updateTimer;
+	QTreeWidget *tree;
+	QLabel *summaryLbl;
+
+private:
+	void updateStats(void);
+
+public slots:
+	void closeWindow(void);
+private slots:
+	void updatePeriodic(void);
+	void resetClicked(void);
+};
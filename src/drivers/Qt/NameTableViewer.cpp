@@ -40,9 +40,12 @@
 #include "../../debug.h"
 #include "../../palette.h"
 
+#include "common/ppu_capture.h"
+#include "common/chr_tile_cache.h"
 #include "Qt/ColorMenu.h"
 #include "Qt/ConsoleWindow.h"
 #include "Qt/ConsoleUtilities.h"
+#include "Qt/FrameDispatcher.h"
 #include "Qt/NameTableViewer.h"
 #include "Qt/HexEditor.h"
 #include "Qt/main.h"
@@ -78,15 +81,22 @@ static class NTCache
 {
 public:
 	NTCache(void) 
-		: curr_vnapage(0)
 	{
 		memset( cache, 0, sizeof(cache) );
 	}
 
-	uint8_t* curr_vnapage;
 	uint8_t cache[0x400];
 } cache[4];
 
+// written on the emulator thread, decoded on the GUI thread
+static PPUCapture ntCapture;
+static CHRTileCache tileCache;
+static uint32_t drawnChrVersion[8];
+static uint32_t drawnSeq = 0;
+static int drawnPTable = -1;
+static int drawnAttView = -1;
+static int drawnHidePal = -1;
+
 static ppuNameTable_t nameTable[4];
 
 enum NT_MirrorType 
@@ -100,6 +110,7 @@ enum NT_MirrorType
 static NT_MirrorType ntmirroring = NT_NONE, oldntmirroring = NT_NONE;
 
 static void initNameTableViewer(void);
+static void ntViewDecode( bool force );
 //static void ChangeMirroring(void);
 //----------------------------------------------------
 int openNameTableViewWindow( QWidget *parent )
@@ -555,11 +566,7 @@ ppuNameTableViewerDialog_t::ppuNameTableViewerDialog_t(QWidget *parent)
 
 	FCEUD_UpdateNTView( -1, true);
 	
-	updateTimer  = new QTimer( this );
-
-	connect( updateTimer, &QTimer::timeout, this, &ppuNameTableViewerDialog_t::periodicUpdate );
-
-	updateTimer->start( 33 ); // 30hz
+	FrameDispatcher::instance()->addView( this, 33, [this]{ periodicUpdate(); } ); // 30hz
 
 	updateMirrorText();
 	refreshMenuSelections();
@@ -577,7 +584,7 @@ ppuNameTableViewerDialog_t::~ppuNameTableViewerDialog_t(void)
 {
 	QSettings settings;
 
-	updateTimer->stop();
+	FrameDispatcher::instance()->removeView( this );
 	nameTableViewWindow = NULL;
 
 	settings.setValue("ntViewer/geometry", saveGeometry());
@@ -606,6 +613,8 @@ void ppuNameTableViewerDialog_t::closeWindow(void)
 //----------------------------------------------------
 void ppuNameTableViewerDialog_t::periodicUpdate(void)
 {
+	ntViewDecode(false);
+
 	updateMirrorText();
 
 	if ( redrawtables )
@@ -1595,6 +1604,7 @@ static void initNameTableViewer(void)
 	palcache[(8*4)+2] = 0x10;
 	palcache[(8*4)+3] = 0x20;
 
+	drawnSeq = 0;
 }
 //----------------------------------------------------
 //static void ChangeMirroring(void)
@@ -1639,63 +1649,38 @@ static void initNameTableViewer(void)
 //	return;
 //}
 //----------------------------------------------------
-inline void DrawChr( ppuNameTableTile_t *tile, const uint8_t *chr, int pal)
+inline void DrawChr( ppuNameTableTile_t *tile, const uint8_t *pix, int pal)
 {
-	int y, x, tmp, index=0, p=0;
-	uint8 chr0, chr1;
-	//uint8 *table = &VPage[0][0]; //use the background table
-	//pbitmap += 3*
-	//
+	int y, x, p;
+
 	tile->pal  = pal;
 
-	for (y = 0; y < 8; y++) { //todo: use index for y?
-		chr0 = chr[index];
-		chr1 = chr[index+8];
-		tmp=7;
-		for (x = 0; x < 8; x++) { //todo: use tmp for x?
-			p = (chr0>>tmp)&1;
-			p |= ((chr1>>tmp)&1)<<1;
-			p = palcache[p+(pal*4)];
-			tmp--;
+	for (y = 0; y < 8; y++) {
+		for (x = 0; x < 8; x++) {
+			p = palcache[*pix++ + (pal*4)];
 
 			tile->pixel[y][x].color.setBlue( palo[p].b );
 			tile->pixel[y][x].color.setGreen( palo[p].g );
 			tile->pixel[y][x].color.setRed( palo[p].r );
 		}
-		index++;
-		//pbitmap += (NTWIDTH*3)-24;
 	}
-	//index+=8;
-	//pbitmap -= (((PALETTEBITWIDTH>>2)<<3)-24);
 }
 //----------------------------------------------------
-static void DrawNameTable(int scanline, int ntnum, bool invalidateCache) 
+static void DrawNameTable( const PPUCaptureFrame *f, int ntnum, bool invalidateCache ) 
 {
 	NTCache &c = cache[ntnum];
 	uint8_t *tablecache = c.cache;
 
-	uint8_t *table = vnapage[ntnum];
-	if (table == NULL)
-	{
-		table = vnapage[ntnum&1];
-	}
+	const uint8_t *table = f->nt[ntnum];
 
 	int a, ptable=0;
 	
-	if (PPU[0]&0x10){ //use the correct pattern table based on this bit
+	if (f->ctrl&0x10){ //use the correct pattern table based on this bit
 		ptable=0x1000;
 	}
 
-	bool invalid = invalidateCache;
-	//if we werent asked to invalidate the cache, maybe we need to invalidate it anyway due to vnapage changing
-	if (!invalid)
-	{
-		invalid = (c.curr_vnapage != vnapage[ntnum]);
-	}
-	c.curr_vnapage = vnapage[ntnum];
-	
-	//HACK: never cache anything
-	invalid = true;
+	// extended attribute tiles are not keyed by the name table bytes
+	bool invalid = invalidateCache || f->exMode;
 
 	for (int y=0;y<30;y++)
 	{
@@ -1729,77 +1714,109 @@ static void DrawNameTable(int scanline, int ntnum, bool invalidateCache)
 
 				int refreshaddr = (x)+(y)*32;
 
-				a = FCEUPPU_GetAttr(ntnum,x,y);
-				if (hidepal) a = 8;
+				const uint8_t *pix;
+				uint8_t tilePix[64];
 
-				const uint8* chrp = FCEUPPU_GetCHR(ptable+chr,refreshaddr);
-				if (attview) chrp = ATTRIBUTE_VIEW_TILE;
+				if (attview)
+				{
+					CHRTileDecode( ATTRIBUTE_VIEW_TILE, tilePix );
+					pix = tilePix;
+				}
+				else if (f->exMode)
+				{
+					CHRTileDecode( f->exChr[ntnum][refreshaddr], tilePix );
+					pix = tilePix;
+				}
+				else
+				{
+					pix = tileCache.tile( ptable + chr, f->chr, f->chrVersion );
+				}
+				if (f->exMode)
+				{
+					a = f->exAttr[refreshaddr];
+				}
+				if (hidepal) a = 8;
 
 				nameTable[ntnum].tile[y][x].pTbl    = ptable;
 				nameTable[ntnum].tile[y][x].pTblAdr = ptable+chr;
 
 				//a good way to do it:
-				DrawChr( &nameTable[ntnum].tile[y][x], chrp, a);
-
-				tablecache[ntaddr] = table[ntaddr];
-				tablecache[attraddr] = table[attraddr];
-				//one could comment out the line above...
-				//since there are so many fewer attribute values than NT values, it might be best just to refresh the whole attr table below with the memcpy
-
-				//obviously this whole scheme of nt cache doesnt work if an mmc5 game is playing tricks with the attribute table
+				DrawChr( &nameTable[ntnum].tile[y][x], pix, a);
 			}
 		}
 	}
+	// only now, an attribute byte covers 16 tiles that all compare to it
+	memcpy( tablecache, table, 0x400 );
 }
 //----------------------------------------------------
-void FCEUD_UpdateNTView(int scanline, bool drawall) 
+// GUI thread: decodes the newest capture. Tiles are only drawn again when
+// their name table entry changed, unless the palette, the background
+// pattern table or its CHR pages did.
+static void ntViewDecode( bool drawall )
 {
-	if (nameTableViewWindow == 0)
+	const PPUCaptureFrame *f;
+	const int8_t *p;
+	int base;
+
+	f = ntCapture.acquire();
+
+	if ( (f->seq == 0) || (palo == NULL) )
 	{
 		return;
 	}
-	if ( (scanline != -1) && (scanline != NTViewScanline) )
+	if ( !drawall && (f->seq == drawnSeq) )
 	{
 		return;
 	}
+	drawnSeq = f->seq;
 
-	ppu_getScroll(xpos,ypos);
+	xpos = f->xScroll;
+	ypos = f->yScroll;
 
-	if (NTViewSkip < NTViewRefresh)
+	//update palette only if required
+	if (memcmp(palcache,f->pal,32) != 0) 
 	{
-		NTViewSkip++;
-		return;
+		memcpy(palcache,f->pal,32);
+		drawall = 1; //palette has changed, so redraw all
 	}
-	NTViewSkip = 0;
 
-	if (chrchanged)
+	base = (f->ctrl & 0x10) ? 4 : 0;
+
+	for (int i=0; i<4; i++)
 	{
-		drawall = 1;
+		if ( f->chrVersion[base+i] != drawnChrVersion[base+i] )
+		{
+			chrchanged = 1;
+		}
 	}
+	memcpy( drawnChrVersion, f->chrVersion, sizeof(drawnChrVersion) );
 
-	//update palette only if required
-	if (memcmp(palcache,PALRAM,32) != 0) 
+	if ( (base != drawnPTable) || (attview != drawnAttView) || (hidepal != drawnHidePal) )
 	{
-		memcpy(palcache,PALRAM,32);
-		drawall = 1; //palette has changed, so redraw all
+		drawnPTable  = base;
+		drawnAttView = attview;
+		drawnHidePal = hidepal;
+		drawall = 1;
 	}
 
-	if ( vnapage[0] == NULL )
+	if (chrchanged)
 	{
-		return;
+		drawall = 1;
 	}
-	 
+
+	p = f->ntPage;
+
 	ntmirroring = NT_NONE;
-	if (vnapage[0] == vnapage[1])ntmirroring = NT_HORIZONTAL;
-	if (vnapage[0] == vnapage[2])ntmirroring = NT_VERTICAL;
-	if ((vnapage[0] != vnapage[1]) && (vnapage[0] != vnapage[2]))ntmirroring = NT_FOUR_SCREEN;
+	if (p[0] == p[1])ntmirroring = NT_HORIZONTAL;
+	if (p[0] == p[2])ntmirroring = NT_VERTICAL;
+	if ((p[0] != p[1]) && (p[0] != p[2]))ntmirroring = NT_FOUR_SCREEN;
 
-	if ((vnapage[0] == vnapage[1]) && (vnapage[1] == vnapage[2]) && (vnapage[2] == vnapage[3]))
+	if ((p[0] == p[1]) && (p[1] == p[2]) && (p[2] == p[3]))
 	{ 
-		if(vnapage[0] == &NTARAM[0x000])ntmirroring = NT_SINGLE_SCREEN_TABLE_0;
-		if(vnapage[0] == &NTARAM[0x400])ntmirroring = NT_SINGLE_SCREEN_TABLE_1;
-		if(vnapage[0] == ExtraNTARAM)ntmirroring = NT_SINGLE_SCREEN_TABLE_2;
-		if(vnapage[0] == ExtraNTARAM+0x400)ntmirroring = NT_SINGLE_SCREEN_TABLE_3;
+		if(p[0] == 0)ntmirroring = NT_SINGLE_SCREEN_TABLE_0;
+		if(p[0] == 1)ntmirroring = NT_SINGLE_SCREEN_TABLE_1;
+		if(p[0] == 2)ntmirroring = NT_SINGLE_SCREEN_TABLE_2;
+		if(p[0] == 3)ntmirroring = NT_SINGLE_SCREEN_TABLE_3;
 	}
 
 	if (oldntmirroring != ntmirroring)
@@ -1809,12 +1826,47 @@ void FCEUD_UpdateNTView(int scanline, bool drawall)
 
 	for (int i=0;i<4;i++)
 	{
-		DrawNameTable(scanline,i,drawall);
+		DrawNameTable(f,i,drawall);
 	}
 
 	chrchanged = 0;
 	resetDrawCounter = true;
-	return;	
+}
+//----------------------------------------------------
+void FCEUD_UpdateNTView(int scanline, bool drawall) 
+{
+	if (nameTableViewWindow == 0)
+	{
+		return;
+	}
+
+	if ( scanline == -1 )
+	{
+		// asked for by the window, draw it now rather than at the next capture
+		FCEU_WRAPPER_LOCK();
+		ntCapture.capture(true);
+		FCEU_WRAPPER_UNLOCK();
+
+		NTViewSkip = 0;
+
+		ntViewDecode(drawall);
+		return;
+	}
+
+	if ( scanline != NTViewScanline )
+	{
+		return;
+	}
+
+	if (NTViewSkip < NTViewRefresh)
+	{
+		NTViewSkip++;
+		return;
+	}
+	NTViewSkip = 0;
+
+	// emulator thread, copy the memory and leave the drawing to the window
+	ntCapture.capture(true);
 }
 //----------------------------------------------------
 ppuNameTableTileView_t::ppuNameTableTileView_t( QWidget *parent )
@@ -199,7 +199,6 @@ class ppuNameTableViewerDialog_t : public QDialog
 		QCheckBox *showAttrbCbox;
 		QCheckBox *ignorePaletteCbox;
 		QSpinBox  *scanLineEdit;
-		QTimer    *updateTimer;
 		QLineEdit *ppuAddrLbl;
 		QLineEdit *nameTableLbl;
 		QLineEdit *tileLocLbl;
@@ -23,12 +23,15 @@
 #include <QMessageBox>
 #include <QTemporaryFile>
 
+#include <random>
+
 #include "../../fceu.h"
 #include "../../cart.h"
 #include "../../cheat.h"
 #include "../../state.h"
 #include "../../movie.h"
 #include "../../debug.h"
+#include "common/rollback.h"
 #include "utils/crc32.h"
 #include "utils/timeStamp.h"
 #include "utils/StringUtils.h"
@@ -142,6 +145,11 @@ struct NetPlayFrameDataHist_t
 };
 static NetPlayFrameDataHist_t  netPlayFrameData;
 //-----------------------------------------------------------------------------
+//--- NetPlay Client Speculative Execution
+//-----------------------------------------------------------------------------
+static NetPlayRollback netPlayRollback(0);
+static bool netPlayRollbackFrame = false;
+//-----------------------------------------------------------------------------
 const char* NetPlayPlayerRoleToString(int role)
 {
 	const char* roleString = nullptr;
@@ -188,6 +196,7 @@ NetPlayServer::NetPlayServer(QObject *parent)
 
 	FCEU_WRAPPER_LOCK();
 	inputFrameCount = static_cast<uint32_t>(currFrameCounter);
+	clearInputHist();
 
 	if (currCartInfo != nullptr)
 	{
@@ -350,6 +359,9 @@ int NetPlayServer::sendRomLoadReq( NetPlayClient *client )
 
 	const char *filepath = nullptr;
 
+	// frames already queued for spectators go out ahead of the new game
+	flushSpectatorFeed();
+
 	if ( GameInfo == nullptr)
 	{
 		return -1;
@@ -437,7 +449,7 @@ static int serverActiveCheatListCB(const char *name, uint32 a, uint8 v, int c, i
 	return 1;
 }
 //-----------------------------------------------------------------------------
-int NetPlayServer::sendStateSyncReq( NetPlayClient *client )
+int NetPlayServer::sendStateSyncReq( NetPlayClient *client, bool allowBlocks )
 {
 	EMUFILE_MEMORY em;
 	int numCtrlFrames = 0, numCheats = 0, compressionLevel = 1;
@@ -445,14 +457,40 @@ int NetPlayServer::sendStateSyncReq( NetPlayClient *client )
 	netPlayLoadStateResp resp;
 	netPlayLoadStateResp::CtrlData ctrlData[netPlayLoadStateResp::MaxCtrlFrames];
 	NetPlayServerCheatQuery cheatQuery;
+	std::vector<uint32_t> manifest;
+
+	flushSpectatorFeed();
 
 	if ( GameInfo == nullptr )
 	{
 		return -1;
 	}
-	FCEUSS_SaveMS( &em, compressionLevel );
 
-	resp.stateSize    = em.size();
+	// Clients that take manifests get the hashes of the snapshot's blocks
+	// in place of the state, and ask for the blocks they need.
+	if ( allowBlocks && client->blockSync && client->stateBlocks.snapshot() )
+	{
+		const std::vector<uint32_t>& hashes = client->stateBlocks.hashes();
+
+		manifest.reserve( hashes.size() + 1 );
+		manifest.push_back( netPlayByteSwap( static_cast<uint32_t>(client->stateBlocks.size()) ) );
+
+		for (auto& h : hashes)
+		{
+			manifest.push_back( netPlayByteSwap(h) );
+		}
+		resp.hdr.msgId = NETPLAY_SYNC_STATE_MANIFEST;
+	}
+	else
+	{
+		client->stateBlocks.clear();
+
+		FCEUSS_SaveMS( &em, compressionLevel );
+	}
+	const unsigned char* bufPtr = manifest.empty() ? em.buf() : reinterpret_cast<const unsigned char*>(manifest.data());
+	size_t dataSize = manifest.empty() ? em.size() : (manifest.size() * sizeof(uint32_t));
+
+	resp.stateSize    = dataSize;
 	resp.opsCrc32     = opsCrc32;
 	resp.romCrc32     = romCrc32;
 
@@ -487,7 +525,7 @@ int NetPlayServer::sendStateSyncReq( NetPlayClient *client )
 
 	resp.calcTotalSize();
 
-	printf("Sending ROM Sync Request: %zu\n", em.size());
+	printf("Sending ROM Sync Request: %zu%s\n", dataSize, manifest.empty() ? "" : " (manifest)");
 
 	sendMsg( client, &resp, sizeof(netPlayLoadStateResp), [&resp]{ resp.toNetworkByteOrder(); } );
 
@@ -501,9 +539,6 @@ int NetPlayServer::sendStateSyncReq( NetPlayClient *client )
 	}
 	//sendMsg( client, em.buf(), em.size() );
 
-	const unsigned char* bufPtr = em.buf();
-	size_t dataSize = em.size();
-
 	while (dataSize > 0)
 	{
 		size_t bytesToWrite = dataSize;
@@ -626,6 +661,7 @@ void NetPlayServer::onRomLoad()
 
 	inputClear();
 	inputFrameCount = static_cast<uint32_t>(currFrameCounter);
+	clearInputHist();
 
 	sendPauseAll();
 
@@ -666,6 +702,7 @@ void NetPlayServer::onStateLoad()
 
 	inputClear();
 	inputFrameCount = static_cast<uint32_t>(currFrameCounter);
+	clearInputHist();
 
 	sendPauseAll();
 
@@ -688,6 +725,7 @@ void NetPlayServer::onNesReset()
 
 	inputClear();
 	inputFrameCount = static_cast<uint32_t>(currFrameCounter);
+	clearInputHist();
 
 	sendPauseAll();
 
@@ -714,6 +752,7 @@ void NetPlayServer::onCheatsChanged()
 
 	inputClear();
 	inputFrameCount = static_cast<uint32_t>(currFrameCounter);
+	clearInputHist();
 
 	sendPauseAll();
 
@@ -755,6 +794,7 @@ void NetPlayServer::resyncAllClients()
 
 	inputClear();
 	inputFrameCount = static_cast<uint32_t>(currFrameCounter);
+	clearInputHist();
 
 	for (auto& client : clientList )
 	{
@@ -862,6 +902,74 @@ void NetPlayServer::serverProcessMessage( NetPlayClient *client, void *msgBuf, s
 			}
 		}
 		break;
+		case NETPLAY_SYNC_BLOCKS_ENABLE:
+		{
+			client->blockSync = true;
+		}
+		break;
+		case NETPLAY_SYNC_BLOCKS_REQ:
+		{
+			netPlaySyncBlocksReq *msg = static_cast<netPlaySyncBlocksReq*>(msgBuf);
+			msg->toHostByteOrder();
+
+			std::vector<uint8_t> data;
+			uint32_t *blocks = msg->blockBuf();
+			const size_t numBlocks = msg->numBlocks;
+
+			bool blocksOk = (msgSize >= sizeof(netPlaySyncBlocksReq) + numBlocks * sizeof(uint32_t)) &&
+					(client->stateBlocks.size() > 0) && (msg->snapshotSize == client->stateBlocks.size());
+
+			for (size_t i=0; blocksOk && (i<numBlocks); i++)
+			{
+				blocks[i] = netPlayByteSwap(blocks[i]);
+			}
+
+			if (!blocksOk || !client->stateBlocks.pack( blocks, numBlocks, data ))
+			{
+				// the snapshot is gone, or the client could not use it
+				FCEU_WRAPPER_LOCK();
+				sendStateSyncReq( client, false );
+				FCEU_WRAPPER_UNLOCK();
+				break;
+			}
+			FCEU_printf("Sending %zu of %zu State Blocks: %zu bytes\n", numBlocks, client->stateBlocks.numBlocks(), data.size());
+
+			netPlaySyncBlocksReq resp(NETPLAY_SYNC_BLOCKS_RESP);
+			resp.snapshotSize = msg->snapshotSize;
+			resp.numBlocks    = numBlocks;
+			resp.calcTotalSize( data.size() );
+
+			for (size_t i=0; i<numBlocks; i++)
+			{
+				blocks[i] = netPlayByteSwap(blocks[i]);
+			}
+			sendMsg( client, &resp, sizeof(netPlaySyncBlocksReq), [&resp]{ resp.toNetworkByteOrder(); } );
+
+			if (numBlocks > 0)
+			{
+				sendMsg( client, blocks, numBlocks * sizeof(uint32_t) );
+			}
+			if (data.size() > 0)
+			{
+				sendMsg( client, data.data(), data.size() );
+			}
+			client->flushData();
+
+			client->stateBlocks.clear();
+		}
+		break;
+		case NETPLAY_UDP_INPUT_REQ:
+		{
+			netPlayUdpInputReq *msg = static_cast<netPlayUdpInputReq*>(msgBuf);
+			msg->toHostByteOrder();
+
+			if (udpSock != nullptr)
+			{
+				client->udpToken = msg->token;
+				client->udpPort  = 0;
+			}
+		}
+		break;
 		case NETPLAY_CLIENT_STATE:
 		{
 			netPlayClientState *msg = static_cast<netPlayClientState*>(msgBuf);
@@ -1092,7 +1200,7 @@ void NetPlayServer::processClientStateLoadRequests(void)
 	{
 		if (client->stateLoadData.pending())
 		{
-			EMUFILE_MEMORY em( client->stateLoadData.buf, client->stateLoadData.size );
+			EMUFILE_SPAN em( static_cast<const char*>(client->stateLoadData.buf), client->stateLoadData.size );
 
 			bool acceptStateLoadReq = false;
 
@@ -1125,6 +1233,179 @@ void NetPlayServer::processClientStateLoadRequests(void)
 	}
 }
 //-----------------------------------------------------------------------------
+void NetPlayServer::setSpectatorRelay(bool value)
+{
+	if (value && (spectatorTimer == nullptr))
+	{
+		spectatorTimer = new QTimer(this);
+
+		connect( spectatorTimer, SIGNAL(timeout(void)), this, SLOT(spectatorTimerExpired(void)) );
+
+		spectatorTimer->start(50); // ~3 frames per batch
+	}
+	else if (!value && (spectatorTimer != nullptr))
+	{
+		flushSpectatorFeed();
+
+		delete spectatorTimer;
+		spectatorTimer = nullptr;
+	}
+}
+//-----------------------------------------------------------------------------
+bool NetPlayServer::isRelaySpectator( NetPlayClient *client )
+{
+	return (spectatorTimer != nullptr) && !client->isPlayerRole();
+}
+//-----------------------------------------------------------------------------
+void NetPlayServer::spectatorTimerExpired(void)
+{
+	flushSpectatorFeed();
+}
+//-----------------------------------------------------------------------------
+void NetPlayServer::flushSpectatorFeed(void)
+{
+	if (spectatorFeed.isEmpty())
+	{
+		return;
+	}
+
+	// One buffer for every spectator, the sockets queue it up without a
+	// copy. Whoever cannot take it in is too far behind to ever catch up.
+	for (auto& client : clientList )
+	{
+		if ( (client->state == 0) || !isRelaySpectator(client) || client->shouldDestroy() )
+		{
+			continue;
+		}
+		QTcpSocket *sock = client->getSocket();
+
+		if (sock->bytesToWrite() > spectatorMaxBacklog)
+		{
+			FCEU_printf("NetPlay Spectator %s is too far behind, dropping\n", client->userName.toLocal8Bit().constData());
+			client->forceDisconnect();
+			continue;
+		}
+		sock->write( spectatorFeed );
+	}
+	spectatorFeed.clear();
+}
+//-----------------------------------------------------------------------------
+void NetPlayServer::clearInputHist(void)
+{
+	for (int i=0; i<inputHistSize; i++)
+	{
+		inputHist[i].frameCounter = 0;
+	}
+}
+//-----------------------------------------------------------------------------
+bool NetPlayServer::openUdpInput( int port )
+{
+	if (udpSock == nullptr)
+	{
+		udpSock = new QUdpSocket(this);
+	}
+	if (!udpSock->bind( QHostAddress::Any, port ))
+	{
+		FCEU_printf("NetPlay UDP input not available on port %i: %s\n", port, udpSock->errorString().toLocal8Bit().constData());
+		delete udpSock;
+		udpSock = nullptr;
+		return false;
+	}
+	return true;
+}
+//-----------------------------------------------------------------------------
+void NetPlayServer::readUdpDatagrams(void)
+{
+	while (udpSock->hasPendingDatagrams())
+	{
+		netPlayUdpInputReq hello;
+		QHostAddress addr;
+		quint16 port = 0;
+
+		qint64 size = udpSock->readDatagram( reinterpret_cast<char*>(&hello), sizeof(hello), &addr, &port );
+
+		if (size != sizeof(hello))
+		{
+			continue;
+		}
+		hello.toHostByteOrder();
+
+		if ( (hello.hdr.magic[0] != NETPLAY_MAGIC_NUMBER) || (hello.hdr.magic[1] != NETPLAY_MAGIC_NUMBER) ||
+		     (hello.hdr.msgId != NETPLAY_UDP_HELLO) || (hello.token == 0) )
+		{
+			continue;
+		}
+
+		for (auto& client : clientList )
+		{
+			if ( (client->udpToken == hello.token) && (client->getSocket() != nullptr) &&
+			      addr.isEqual( client->getSocket()->peerAddress(), QHostAddress::TolerantConversion ) )
+			{
+				if (client->udpPort == 0)
+				{
+					FCEU_printf("NetPlay Client %s: Input over UDP\n", client->userName.toLocal8Bit().constData());
+				}
+				client->udpAddr = addr;
+				client->udpPort = port;
+			}
+		}
+	}
+}
+//-----------------------------------------------------------------------------
+void NetPlayServer::sendUdpInput( NetPlayClient *client, uint8_t catchUpThreshold )
+{
+	netPlayRunFramesReq  msg;
+	const uint32_t lastFrame = inputFrameCount;
+	uint32_t frame = client->readyFrame + 1;
+
+	// everything the client has not reported yet, as far back as the history goes
+	if ( (frame > lastFrame) || (lastFrame - frame >= static_cast<uint32_t>(inputHistSize)) )
+	{
+		frame = (lastFrame >= static_cast<uint32_t>(inputHistSize)) ? (lastFrame - inputHistSize + 1) : 1;
+	}
+
+	for (; frame <= lastFrame; frame++)
+	{
+		const NetPlayFrameInput &in = inputHist[frame % inputHistSize];
+
+		if (in.frameCounter != frame)
+		{	// not sent in this session, start after it
+			msg.numFrames = 0;
+			msg.numRuns = 0;
+			continue;
+		}
+		if (msg.numFrames == 0)
+		{
+			msg.firstFrame = frame;
+		}
+		netPlayInputRun *run = (msg.numRuns > 0) ? &msg.run[msg.numRuns-1] : nullptr;
+
+		if ( (run != nullptr) && (run->numFrames < 255) && (memcmp( run->ctrlState, in.ctrl, sizeof(run->ctrlState) ) == 0) )
+		{
+			run->numFrames++;
+		}
+		else
+		{
+			run = &msg.run[msg.numRuns++];
+			run->numFrames = 1;
+			memcpy( run->ctrlState, in.ctrl, sizeof(run->ctrlState) );
+		}
+		msg.numFrames++;
+	}
+
+	if (msg.numFrames == 0)
+	{
+		return;
+	}
+	const size_t msgSize = msg.msgSize();
+
+	msg.hdr.msgSize = msgSize;
+	msg.catchUpThreshold = catchUpThreshold;
+	msg.toNetworkByteOrder();
+
+	udpSock->writeDatagram( reinterpret_cast<const char*>(&msg), msgSize, client->udpAddr, client->udpPort );
+}
+//-----------------------------------------------------------------------------
 void NetPlayServer::update(void)
 {
 	bool hostRdyFrame = false;
@@ -1156,6 +1437,11 @@ void NetPlayServer::update(void)
 		gpData[role] = localGP[role];
 	}
 
+	if (udpSock != nullptr)
+	{
+		readUdpDatagrams();
+	}
+
 	// Input Processing
 	for (auto it = clientList.begin(); it != clientList.end(); )
 	{
@@ -1163,7 +1449,7 @@ void NetPlayServer::update(void)
 
 		client->readMessages( serverMessageCallback, client );
 
-		if (client->isAuthenticated())
+		if (client->isAuthenticated() && !isRelaySpectator(client))
 		{
 			if (client->currentFrame < clientMinFrame)
 			{
@@ -1253,13 +1539,27 @@ void NetPlayServer::update(void)
 
 		pushBackInput( inputFrame );
 
+		inputHist[inputFrame.frameCounter % inputHistSize] = inputFrame;
+
 		runFrameReq.toNetworkByteOrder();
 
+		if (spectatorTimer != nullptr)
+		{
+			spectatorFeed.append( reinterpret_cast<const char*>(&runFrameReq), sizeof(runFrameReq) );
+		}
+
 		for (auto& client : clientList )
 		{
-			if (client->state > 0)
+			if ( (client->state > 0) && !isRelaySpectator(client) )
 			{
+				// TCP stays the reliable path, the UDP packet just gets there
+				// first when TCP is held up by a lost segment
 				sendMsg( client, &runFrameReq, sizeof(runFrameReq) );
+
+				if ( (udpSock != nullptr) && (client->udpPort != 0) )
+				{
+					sendUdpInput( client, catchUpThreshold );
+				}
 			}
 		}
 	}
@@ -1389,11 +1689,23 @@ int NetPlayClient::Create(QObject *parent)
 			printf("Error Creating Netplay Client!!!\n");
 		}
 	}
+	int rollbackFrames = 0;
+	g_config->getOption("SDL.NetPlayRollbackFrames", &rollbackFrames);
+
+	// a confirmed frame has to stay in the frame data history
+	// for as long as frames predicted after it are pending
+	if (rollbackFrames >= NetPlayFrameDataHist_t::numFrames)
+	{
+		rollbackFrames = NetPlayFrameDataHist_t::numFrames - 1;
+	}
+
 	FCEU_WRAPPER_LOCK();
 	if (traceRegistrationHandle == nullptr)
 	{
 		traceRegistrationHandle = FCEUI_TraceInstructionRegister( NetPlayTraceInstruction );
 	}
+	netPlayRollback.setMaxFrames(rollbackFrames);
+	netPlayRollbackFrame = false;
 	FCEU_WRAPPER_UNLOCK();
 
 	if (consoleWindow != nullptr)
@@ -1420,6 +1732,9 @@ int NetPlayClient::Destroy()
 		}
 		traceRegistrationHandle = nullptr;
 	}
+	netPlayRollback.setMaxFrames(0);
+	netPlayRollbackFrame = false;
+
 	// Reset frame throttling to normal incase client was dynamically adjusting frame rate.
 	FCEUD_SetEmulationSpeed(EMUSPEED_NORMAL);
 
@@ -1747,17 +2062,214 @@ static void clientMessageCallback( void *userData, void *msgBuf, size_t msgSize
 	client->clientProcessMessage( msgBuf, msgSize );
 }
 //-----------------------------------------------------------------------------
+void NetPlayClient::openUdpInput(void)
+{
+	if (udpSock == nullptr)
+	{
+		udpSock = new QUdpSocket(this);
+	}
+	if (!udpSock->bind( QHostAddress::Any, 0 ))
+	{
+		FCEU_printf("NetPlay UDP input not available: %s\n", udpSock->errorString().toLocal8Bit().constData());
+		delete udpSock;
+		udpSock = nullptr;
+		return;
+	}
+	std::random_device rd;
+
+	do
+	{
+		udpToken = rd();
+	} while (udpToken == 0);
+
+	udpHelloCounter = 0;
+	udpInputRcvd = false;
+
+	netPlayUdpInputReq req;
+	req.token = udpToken;
+	req.toNetworkByteOrder();
+	sock->write( reinterpret_cast<const char*>(&req), sizeof(req) );
+}
+//-----------------------------------------------------------------------------
+void NetPlayClient::readUdpDatagrams(void)
+{
+	constexpr size_t minSize = sizeof(netPlayRunFramesReq) - sizeof(netPlayRunFramesReq::run);
+
+	while (udpSock->hasPendingDatagrams())
+	{
+		netPlayRunFramesReq msg;
+		QHostAddress addr;
+		quint16 port = 0;
+
+		qint64 size = udpSock->readDatagram( reinterpret_cast<char*>(&msg), sizeof(msg), &addr, &port );
+
+		if ( (size < static_cast<qint64>(minSize)) ||
+		     !addr.isEqual( sock->peerAddress(), QHostAddress::TolerantConversion ) )
+		{
+			continue;
+		}
+		msg.toHostByteOrder();
+
+		if ( (msg.hdr.magic[0] != NETPLAY_MAGIC_NUMBER) || (msg.hdr.magic[1] != NETPLAY_MAGIC_NUMBER) ||
+		     (msg.hdr.msgId != NETPLAY_RUN_FRAMES_REQ) || (msg.numRuns > netPlayRunFramesReq::maxFrames) ||
+		     (static_cast<qint64>(msg.hdr.msgSize) != size) || (msg.msgSize() != static_cast<size_t>(size)) )
+		{
+			continue;
+		}
+		udpInputRcvd = true;
+		catchUpThreshold = msg.catchUpThreshold;
+
+		// Until TCP delivers the first frame after a sync there is nothing
+		// to tell a late packet from before the sync from one after it.
+		if (inputFrameReceived() == 0)
+		{
+			continue;
+		}
+		uint32_t frame = msg.firstFrame;
+
+		for (int i=0; i<msg.numRuns; i++)
+		{
+			const netPlayInputRun &run = msg.run[i];
+
+			for (int j=0; j<run.numFrames; j++, frame++)
+			{
+				// frames are only taken in order, the rest are repeats
+				if (frame == inputFrameReceived() + 1)
+				{
+					NetPlayFrameInput inputFrame;
+
+					inputFrame.frameCounter = frame;
+					inputFrame.ctrl[0] = run.ctrlState[0];
+					inputFrame.ctrl[1] = run.ctrlState[1];
+					inputFrame.ctrl[2] = run.ctrlState[2];
+					inputFrame.ctrl[3] = run.ctrlState[3];
+
+					pushBackInput( inputFrame );
+				}
+			}
+		}
+	}
+}
+//-----------------------------------------------------------------------------
+void NetPlayClient::requestSyncBlocks( const uint32_t *manifest, size_t manifestSize )
+{
+	std::vector<uint32_t> blocks;
+
+	if (manifestSize < 1)
+	{
+		return;
+	}
+	syncSnapshotSize = netPlayByteSwap(manifest[0]);
+	syncManifest.resize( manifestSize - 1 );
+
+	for (size_t i=1; i<manifestSize; i++)
+	{
+		syncManifest[i-1] = netPlayByteSwap(manifest[i]);
+	}
+
+	// what the blocks are compared to and patched into
+	stateBlocks.snapshot();
+	stateBlocks.diff( syncManifest.data(), syncManifest.size(), syncSnapshotSize, blocks );
+
+	FCEU_printf("Requesting %zu of %zu State Blocks\n", blocks.size(), syncManifest.size());
+
+	netPlaySyncBlocksReq req;
+	req.snapshotSize = syncSnapshotSize;
+	req.numBlocks    = blocks.size();
+	req.calcTotalSize();
+	req.toNetworkByteOrder();
+
+	for (auto& b : blocks)
+	{
+		b = netPlayByteSwap(b);
+	}
+	sock->write( reinterpret_cast<const char*>(&req), sizeof(req) );
+
+	if (!blocks.empty())
+	{
+		sock->write( reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(uint32_t) );
+	}
+	blockSyncPending = true;
+}
+//-----------------------------------------------------------------------------
+void NetPlayClient::applySyncBlocks( netPlaySyncBlocksReq *msg, size_t msgSize )
+{
+	msg->toHostByteOrder();
+
+	const size_t numBlocks = msg->numBlocks;
+	const size_t headSize  = sizeof(netPlaySyncBlocksReq) + numBlocks * sizeof(uint32_t);
+
+	if (!blockSyncPending || (msgSize < headSize))
+	{
+		return;
+	}
+	uint32_t *blocks = msg->blockBuf();
+
+	for (size_t i=0; i<numBlocks; i++)
+	{
+		blocks[i] = netPlayByteSwap(blocks[i]);
+	}
+
+	FCEU_WRAPPER_LOCK();
+
+	bool ok = stateBlocks.unpack( msg->snapshotSize, blocks, numBlocks, msg->dataBuf(), msgSize - headSize ) &&
+		  stateBlocks.matches( syncManifest.data(), syncManifest.size(), syncSnapshotSize ) &&
+		  stateBlocks.restore();
+
+	FCEU_WRAPPER_UNLOCK();
+
+	stateBlocks.clear();
+	syncManifest.clear();
+
+	if (ok)
+	{
+		FCEU_printf("State Sync Complete: %zu Blocks Received\n", numBlocks);
+		blockSyncPending = false;
+	}
+	else
+	{
+		// a request for no snapshot has the host fall back to the full
+		// state, frames stay on hold until it is in
+		FCEU_printf("State Sync Blocks Failed, Requesting Full State\n");
+
+		netPlaySyncBlocksReq req;
+		req.calcTotalSize();
+		req.toNetworkByteOrder();
+		sock->write( reinterpret_cast<const char*>(&req), sizeof(req) );
+	}
+}
+//-----------------------------------------------------------------------------
 void NetPlayClient::update(void)
 {
 	readMessages( clientMessageCallback, this );
 
+	if (udpSock != nullptr)
+	{
+		readUdpDatagrams();
+	}
+
 	if (_connected)
 	{
 		uint32_t ctlrData = GetGamepadPressedImmediate();
 		uint32_t currFrame = static_cast<uint32_t>(currFrameCounter);
 
 		NetPlayFrameData lastFrameData;
-		netPlayFrameData.getLast( lastFrameData );
+
+		// Frames run on a predicted input are not reported until the host
+		// confirms them, neither for pacing nor for the desync check.
+		if (netPlayRollback.pending() > 0)
+		{
+			currFrame -= netPlayRollback.pending();
+
+			if (netPlayFrameData.find( currFrame, lastFrameData ) != 0)
+			{
+				lastFrameData.reset();
+			}
+		}
+		else
+		{
+			netPlayFrameData.getLast( lastFrameData );
+		}
 
 		netPlayClientState  statusMsg;
 		statusMsg.flags     = 0;
@@ -1769,7 +2281,7 @@ void NetPlayClient::update(void)
 		{
 			statusMsg.flags |= netPlayClientState::DesyncFlag;
 		}
-		statusMsg.frameRdy  = inputFrameBack();
+		statusMsg.frameRdy  = inputFrameReceived();
 		statusMsg.frameRun  = currFrame;
 		statusMsg.opsFrame  = lastFrameData.frameNum;
 		statusMsg.opsChkSum = lastFrameData.opsCrc32;
@@ -1783,6 +2295,17 @@ void NetPlayClient::update(void)
 		statusMsg.toNetworkByteOrder();
 		sock->write( reinterpret_cast<const char*>(&statusMsg), sizeof(statusMsg) );
 
+		// Repeat the hello until input comes in over UDP, the first ones
+		// may be lost or get there before the host has the token
+		if ( (udpSock != nullptr) && !udpInputRcvd && ((udpHelloCounter++ % 30) == 0) )
+		{
+			netPlayUdpInputReq hello(NETPLAY_UDP_HELLO);
+			hello.token = udpToken;
+			hello.toNetworkByteOrder();
+
+			udpSock->writeDatagram( reinterpret_cast<const char*>(&hello), sizeof(hello), sock->peerAddress(), sock->peerPort() );
+		}
+
 		flushData();
 	}
 }
@@ -1967,6 +2490,19 @@ void NetPlayClient::clientProcessMessage( void *msgBuf, size_t msgSize )
 			FCEU_printf("Authentication Request Received\n");
 			msg.toNetworkByteOrder();
 			sock->write( (const char*)&msg, sizeof(netPlayAuthResp) );
+
+			// syncs may send a manifest of the state's blocks
+			netPlayMsgHdr blocksMsg(NETPLAY_SYNC_BLOCKS_ENABLE);
+			blocksMsg.toNetworkByteOrder();
+			sock->write( reinterpret_cast<const char*>(&blocksMsg), sizeof(blocksMsg) );
+
+			bool udpInput = false;
+			g_config->getOption("SDL.NetPlayUdpInput", &udpInput);
+
+			if (udpInput)
+			{
+				openUdpInput();
+			}
 		}
 		break;
 		case NETPLAY_LOAD_ROM_REQ:
@@ -1995,6 +2531,7 @@ void NetPlayClient::clientProcessMessage( void *msgBuf, size_t msgSize )
 			opsCrc32 = 0;
 			netPlayFrameData.reset();
 			inputClear();
+			netPlayRollback.reset();
 			FCEU_WRAPPER_UNLOCK();
 		}
 		break;
@@ -2006,6 +2543,7 @@ void NetPlayClient::clientProcessMessage( void *msgBuf, size_t msgSize )
 		}
 		break;
 		case NETPLAY_SYNC_STATE_RESP:
+		case NETPLAY_SYNC_STATE_MANIFEST:
 		{
 			netPlayLoadStateResp* msg = static_cast<netPlayLoadStateResp*>(msgBuf);
 			msg->toHostByteOrder();
@@ -2014,19 +2552,32 @@ void NetPlayClient::clientProcessMessage( void *msgBuf, size_t msgSize )
 			char *stateData = msg->stateDataBuf();
 			const uint32_t stateDataSize = msg->stateDataSize();
 
-			FCEU_printf("Sync state Request Received: %u\n", stateDataSize);
+			FCEU_printf("Sync state Request Received: %u%s\n", stateDataSize,
+					(msgId == NETPLAY_SYNC_STATE_MANIFEST) ? " (manifest)" : "");
 
-			EMUFILE_MEMORY em( stateData, stateDataSize );
+			EMUFILE_SPAN em( static_cast<const char*>(stateData), stateDataSize );
 
 			FCEU_WRAPPER_LOCK();
 
 			bool dataValid = romMatch;
 
-			if (dataValid)
+			if (dataValid && (msgId == NETPLAY_SYNC_STATE_MANIFEST))
+			{
+				// the state comes with the blocks, the rest of the sync
+				// applies from here all the same
+				requestSyncBlocks( reinterpret_cast<const uint32_t*>(stateData), stateDataSize / sizeof(uint32_t) );
+			}
+			else if (dataValid)
 			{
+				blockSyncPending = false;
+
 				serverRequestedStateLoad = true;
 				FCEUSS_LoadFP( &em, SSLOADPARAM_NOBACKUP );
 				serverRequestedStateLoad = false;
+			}
+
+			if (dataValid)
+			{
 
 				opsCrc32 = msg->opsCrc32;
 				netPlayFrameData.reset();
@@ -2039,6 +2590,7 @@ void NetPlayClient::clientProcessMessage( void *msgBuf, size_t msgSize )
 				netPlayFrameData.push( data );
 
 				inputClear();
+				netPlayRollback.reset();
 
 				const int numInputFrames = msg->numCtrlFrames;
 				for (int i=0; i<numInputFrames; i++)
@@ -2082,6 +2634,11 @@ void NetPlayClient::clientProcessMessage( void *msgBuf, size_t msgSize )
 
 		}
 		break;
+		case NETPLAY_SYNC_BLOCKS_RESP:
+		{
+			applySyncBlocks( static_cast<netPlaySyncBlocksReq*>(msgBuf), msgSize );
+		}
+		break;
 		case NETPLAY_RUN_FRAME_REQ:
 		{
 			NetPlayFrameInput  inputFrame;
@@ -2096,14 +2653,14 @@ void NetPlayClient::clientProcessMessage( void *msgBuf, size_t msgSize )
 
 			catchUpThreshold   = msg->catchUpThreshold;
 
-			uint32_t lastInputFrame = inputFrameBack();
+			uint32_t lastInputFrame = inputFrameReceived();
 			uint32_t currFrame = static_cast<uint32_t>(currFrameCounter);
 
 			if (inputFrame.frameCounter > lastInputFrame)
 			{
 				pushBackInput( inputFrame );
 			}
-			else
+			else if (!udpInputRcvd)
 			{
 				printf("Drop Frame: LastRun:%u   LastInput:%u   NewInput:%u\n", currFrame, lastInputFrame, inputFrame.frameCounter);
 			}
@@ -2268,12 +2825,20 @@ NetPlayHostDialog::NetPlayHostDialog(QWidget *parent)
 	g_config->getOption("SDL.NetPlayHostAllowClientStateLoadReq", &stateLoadReqEna);
 	allowClientStateReqCBox->setChecked(stateLoadReqEna);
 
+	bool spectatorRelayEna = false;
+	spectatorRelayCBox = new QCheckBox(tr("Relay Input to Spectators in Batches"));
+	spectatorRelayCBox->setToolTip(tr("Spectators do not hold back the players and are dropped if they fall too far behind"));
+	grid->addWidget( spectatorRelayCBox, 4, 0, 1, 2 );
+	g_config->getOption("SDL.NetPlayHostSpectatorRelay", &spectatorRelayEna);
+	spectatorRelayCBox->setChecked(spectatorRelayEna);
+
 	debugModeCBox = new QCheckBox(tr("Debug Network Messaging"));
-	grid->addWidget( debugModeCBox, 4, 0, 1, 2 );
+	grid->addWidget( debugModeCBox, 5, 0, 1, 2 );
 
 	connect(passwordRequiredCBox, SIGNAL(stateChanged(int)), this, SLOT(passwordRequiredChanged(int)));
 	connect(allowClientRomReqCBox, SIGNAL(stateChanged(int)), this, SLOT(allowClientRomReqChanged(int)));
 	connect(allowClientStateReqCBox, SIGNAL(stateChanged(int)), this, SLOT(allowClientStateReqChanged(int)));
+	connect(spectatorRelayCBox, SIGNAL(stateChanged(int)), this, SLOT(spectatorRelayChanged(int)));
 	connect(enforceAppVersionChkCBox, SIGNAL(stateChanged(int)), this, SLOT(enforceAppVersionChkChanged(int)));
 
 	startButton = new QPushButton( tr("Start") );
@@ -2331,6 +2896,12 @@ void NetPlayHostDialog::allowClientStateReqChanged(int state)
 	g_config->save();
 }
 //-----------------------------------------------------------------------------
+void NetPlayHostDialog::spectatorRelayChanged(int state)
+{
+	g_config->setOption("SDL.NetPlayHostSpectatorRelay", state != Qt::Unchecked);
+	g_config->save();
+}
+//-----------------------------------------------------------------------------
 void NetPlayHostDialog::enforceAppVersionChkChanged(int state)
 {
 	g_config->setOption("SDL.NetPlayHostEnforceAppVersionChk", state != Qt::Unchecked);
@@ -2356,6 +2927,7 @@ void NetPlayHostDialog::onStartClicked(void)
 	server->setEnforceAppVersionCheck( enforceAppVersionChkCBox->isChecked() );
 	server->setAllowClientRomLoadRequest( allowClientRomReqCBox->isChecked() );
 	server->setAllowClientStateLoadRequest( allowClientStateReqCBox->isChecked() );
+	server->setSpectatorRelay( spectatorRelayCBox->isChecked() );
 	server->setDebugMode( debugModeCBox->isChecked() );
 
 	if (passwordRequiredCBox->isChecked())
@@ -2366,6 +2938,13 @@ void NetPlayHostDialog::onStartClicked(void)
 
 	if (listenSucceeded)
 	{
+		bool udpInput = false;
+		g_config->getOption("SDL.NetPlayUdpInput", &udpInput);
+
+		if (udpInput)
+		{
+			server->openUdpInput( netPort );
+		}
 		g_config->setOption("SDL.NetworkPort", netPort);
 		done(0);
 		deleteLater();
@@ -3052,6 +3631,77 @@ void NetPlayPeriodicUpdate(void)
 //----------------------------------------------------------------------------
 static NetPlayFrameInput netPlayInputFrame;
 //----------------------------------------------------------------------------
+static uint32_t netPlayResimFrame( uint32_t aux, void *userData )
+{
+	uint8 *gfx = nullptr;
+	int32 *sound = nullptr;
+	int32 ssize = 0;
+
+	opsCrc32 = aux;
+
+	// no video or sound, the frames were seen and heard once already
+	FCEUI_Emulate( &gfx, &sound, &ssize, 2 );
+
+	return opsCrc32;
+}
+//----------------------------------------------------------------------------
+static void NetPlayRollbackUpdate(void)
+{
+	NetPlayClient *client = NetPlayClient::GetInstance();
+
+	if ( (client == nullptr) || !netPlayRollback.enabled() || (GameInfo == nullptr) )
+	{
+		return;
+	}
+
+	// Settle the frames run on a prediction with the inputs the host sent
+	// for them since, and run the frames again from the first mispredicted one.
+	while ( (netPlayRollback.pending() > 0) && client->inputAvailable() )
+	{
+		NetPlayFrameInput inputFrame = client->getNextInput();
+
+		netPlayRollback.confirm( inputFrame.ctrl );
+	}
+
+	netPlayRollbackFrame = false;
+
+	if (FCEUI_EmulationPaused())
+	{
+		return;
+	}
+
+	if (netPlayRollback.needsRollback())
+	{
+		// the frames have to run even if waiting on the host paused us
+		const bool netPlayPause = FCEUI_GetNetPlayPause();
+
+		FCEUI_SetNetPlayPause(false);
+		netPlayRollback.rollback( netPlayResimFrame, nullptr );
+		FCEUI_SetNetPlayPause(netPlayPause);
+	}
+
+	if ( client->inputAvailable() || !netPlayRollback.canPredict() )
+	{
+		return;
+	}
+
+	// No input from the host for the next frame, run it on a prediction
+	uint8_t local[4] = { 0 };
+	uint8_t joy[4];
+	uint8_t localMask = 0;
+
+	if ( (client->role >= NETPLAY_PLAYER1) && (client->role <= NETPLAY_PLAYER4) )
+	{
+		uint32_t ctlrData = GetGamepadPressedImmediate();
+
+		local[client->role] = (ctlrData >> (8 * client->role)) & 0x000000ff;
+		localMask = 1 << client->role;
+	}
+	netPlayRollback.predict( local, localMask, joy );
+
+	netPlayRollbackFrame = netPlayRollback.push( static_cast<uint32_t>(currFrameCounter) + 1, joy, localMask, opsCrc32 );
+}
+//----------------------------------------------------------------------------
 int NetPlayFrameWait(void)
 {
 	int wait = 0;
@@ -3059,7 +3709,16 @@ int NetPlayFrameWait(void)
 
 	if (client)
 	{
-		wait = client->inputAvailable() == 0;
+		if (client->stateSyncPending())
+		{
+			wait = 1;
+		}
+		else
+		{
+			NetPlayRollbackUpdate();
+
+			wait = !netPlayRollbackFrame && !client->inputAvailable();
+		}
 	}
 	else
 	{
@@ -3092,7 +3751,25 @@ void NetPlayReadInputFrame(uint8_t* joy)
 
 	if (client)
 	{
-		netPlayInputFrame = client->getNextInput();
+		if (netPlayRollbackFrame || netPlayRollback.resimulating())
+		{
+			const uint8_t *in = netPlayRollback.input();
+
+			netPlayInputFrame.frameCounter = static_cast<uint32_t>(currFrameCounter) + 1;
+			netPlayInputFrame.ctrl[0] = in[0];
+			netPlayInputFrame.ctrl[1] = in[1];
+			netPlayInputFrame.ctrl[2] = in[2];
+			netPlayInputFrame.ctrl[3] = in[3];
+
+			netPlayRollbackFrame = false;
+		}
+		else
+		{
+			netPlayInputFrame = client->getNextInput();
+
+			// keeps the input the next prediction is made from
+			netPlayRollback.confirm( netPlayInputFrame.ctrl );
+		}
 	}
 	else
 	{
@@ -31,10 +31,16 @@
 
 #include <QTcpSocket>
 #include <QTcpServer>
+#include <QUdpSocket>
+#include <QHostAddress>
+#include <QByteArray>
+#include <QTimer>
 
 #include "utils/mutex.h"
+#include "common/state_sync.h"
 
 class NetPlayClient;
+struct netPlaySyncBlocksReq;
 
 struct NetPlayFrameInput
 {
@@ -85,6 +91,11 @@ class NetPlayServer : public QTcpServer
 
 		void update(void);
 
+		// Frame input to the clients that ask for it goes over UDP too,
+		// on the port number of the TCP server
+		bool openUdpInput( int port );
+		bool udpInputOpen(void){ return udpSock != nullptr; }
+
 		size_t inputAvailable(void)
 		{
 			FCEU::autoScopedLock alock(inputMtx);
@@ -132,7 +143,7 @@ class NetPlayServer : public QTcpServer
 
 		int  sendMsg( NetPlayClient *client, const void *msg, size_t msgSize, std::function<void(void)> netByteOrderConvertFunc = []{});
 		int  sendRomLoadReq( NetPlayClient *client );
-		int  sendStateSyncReq( NetPlayClient *client );
+		int  sendStateSyncReq( NetPlayClient *client, bool allowBlocks = true );
 		int  sendPause( NetPlayClient *client );
 		int  sendUnpause( NetPlayClient *client );
 		int  sendPauseAll(void);
@@ -150,6 +161,13 @@ class NetPlayServer : public QTcpServer
 		void setAllowClientStateLoadRequest(bool value){ allowClientStateLoadReq = value; }
 		void setDebugMode(bool value){ debugMode = value; }
 
+		// Spectators get their frames in batches from a shared feed rather
+		// than one message each, do not hold back the players and are
+		// dropped when they fall too far behind
+		void setSpectatorRelay(bool value);
+		bool spectatorRelayEnabled(){ return spectatorTimer != nullptr; }
+		bool isRelaySpectator( NetPlayClient *client );
+
 		void serverProcessMessage( NetPlayClient *client, void *msgBuf, size_t msgSize );
 
 		ClientList_t& getClientList(){ return clientList; }
@@ -160,10 +178,25 @@ class NetPlayServer : public QTcpServer
 		static NetPlayServer *instance;
 
 		void processPendingConnections(void);
+		void readUdpDatagrams(void);
+		void sendUdpInput( NetPlayClient *client, uint8_t catchUpThreshold );
+		void clearInputHist(void);
+		void flushSpectatorFeed(void);
 
 		ClientList_t clientList;
 		std::list <NetPlayFrameInput> input;
 		FCEU::mutex inputMtx;
+
+		// the frames sent last, for the UDP packets to repeat
+		static constexpr int inputHistSize = 32;
+		NetPlayFrameInput inputHist[inputHistSize];
+		QUdpSocket *udpSock = nullptr;
+
+		// run frame messages for the relay spectators, in network byte order
+		static constexpr int spectatorMaxBacklog = 1024 * 1024;
+		QByteArray  spectatorFeed;
+		QTimer     *spectatorTimer = nullptr;
+
 		int role = -1;
 		int roleMask = 0;
 		NetPlayClient* clientPlayer[4] = { nullptr };
@@ -193,6 +226,7 @@ class NetPlayServer : public QTcpServer
 		void onCheatsChanged(void);
 		void processClientRomLoadRequests(void);
 		void processClientStateLoadRequests(void);
+		void spectatorTimerExpired(void);
 };
 
 class NetPlayClient : public QObject
@@ -242,6 +276,7 @@ class NetPlayClient : public QObject
 		{
 			FCEU::autoScopedLock alock(inputMtx);
 			input.push_back(in);
+			inputFrameLast = in.frameCounter;
 		};
 
 		NetPlayFrameInput getNextInput(void)
@@ -268,12 +303,27 @@ class NetPlayClient : public QObject
 			return frame;
 		}
 
+		// Last frame input was received for, run or not
+		uint32_t inputFrameReceived()
+		{
+			FCEU::autoScopedLock alock(inputMtx);
+			return inputFrameLast;
+		}
+
 		void inputClear()
 		{
 			FCEU::autoScopedLock alock(inputMtx);
 			input.clear();
+			inputFrameLast = 0;
 		}
 
+		// Asks the host for the frame input over UDP as well
+		void openUdpInput(void);
+		bool udpInputActive(void){ return udpInputRcvd; }
+
+		// Waiting on the blocks of a sync, no frames may run until they are in
+		bool stateSyncPending(void){ return blockSyncPending; }
+
 		bool isAuthenticated();
 		bool isPlayerRole();
 		bool shouldDestroy(){ return needsDestroy; }
@@ -304,6 +354,17 @@ class NetPlayClient : public QObject
 		unsigned int tailTarget = 3;
 		uint8_t gpData[4];
 
+		// UDP input token, and on the host the address the client's hello
+		// came from, set once one arrives
+		uint32_t     udpToken = 0;
+		QHostAddress udpAddr;
+		quint16      udpPort = 0;
+
+		// Snapshot of the sync in progress, on the host the one the blocks
+		// are sent from. blockSync is set when the client takes manifests.
+		NetPlayStateBlocks stateBlocks;
+		bool         blockSync = false;
+
 		struct RomLoadReqData
 		{
 			char* buf = nullptr;
@@ -351,6 +412,20 @@ class NetPlayClient : public QObject
 
 		std::list <NetPlayFrameInput> input;
 		FCEU::mutex inputMtx;
+		uint32_t inputFrameLast = 0;
+
+		void readUdpDatagrams(void);
+
+		QUdpSocket *udpSock = nullptr;
+		uint32_t    udpHelloCounter = 0;
+		bool        udpInputRcvd = false;
+
+		void requestSyncBlocks( const uint32_t *manifest, size_t manifestSize );
+		void applySyncBlocks( netPlaySyncBlocksReq *msg, size_t msgSize );
+
+		std::vector<uint32_t> syncManifest;
+		uint32_t    syncSnapshotSize = 0;
+		bool        blockSyncPending = false;
 
 		QFile*  debugLog = nullptr;
 
@@ -393,6 +468,7 @@ protected:
 	QCheckBox  *enforceAppVersionChkCBox;
 	QCheckBox  *allowClientRomReqCBox;
 	QCheckBox  *allowClientStateReqCBox;
+	QCheckBox  *spectatorRelayCBox;
 	QCheckBox  *debugModeCBox;
 
 	static NetPlayHostDialog* instance;
@@ -403,6 +479,7 @@ public slots:
 	void passwordRequiredChanged(int state);
 	void allowClientRomReqChanged(int state);
 	void allowClientStateReqChanged(int state);
+	void spectatorRelayChanged(int state);
 	void enforceAppVersionChkChanged(int state);
 };
 
@@ -21,13 +21,20 @@ enum netPlayMsgType
 	NETPLAY_UNLOAD_ROM_REQ,
 	NETPLAY_SYNC_STATE_REQ = 20,
 	NETPLAY_SYNC_STATE_RESP,
+	NETPLAY_SYNC_STATE_MANIFEST,
+	NETPLAY_SYNC_BLOCKS_ENABLE,
+	NETPLAY_SYNC_BLOCKS_REQ,
+	NETPLAY_SYNC_BLOCKS_RESP,
 	NETPLAY_RUN_FRAME_REQ = 30,
+	NETPLAY_RUN_FRAMES_REQ,
 	NETPLAY_CLIENT_STATE = 40,
 	NETPLAY_CLIENT_PAUSE_REQ,
 	NETPLAY_CLIENT_UNPAUSE_REQ,
 	NETPLAY_INFO_MSG = 50,
 	NETPLAY_ERROR_MSG,
 	NETPLAY_CHAT_MSG,
+	NETPLAY_UDP_INPUT_REQ = 60,
+	NETPLAY_UDP_HELLO,
 	NETPLAY_PING_REQ = 100,
 	NETPLAY_PING_RESP,
 };
@@ -386,6 +393,61 @@ struct netPlayLoadStateResp
 	}
 };
 
+// A NETPLAY_SYNC_STATE_MANIFEST is a netPlayLoadStateResp whose state data
+// is the size of the host's flat snapshot followed by the hash of each of
+// its blocks, all uint32 in network byte order. The client answers with
+// the blocks that differ from its own.
+struct netPlaySyncBlocksReq
+{
+	netPlayMsgHdr  hdr;
+
+	uint32_t  snapshotSize;
+	uint32_t  numBlocks;
+
+	netPlaySyncBlocksReq( uint32_t id = NETPLAY_SYNC_BLOCKS_REQ )
+		: hdr(id, sizeof(netPlaySyncBlocksReq)), snapshotSize(0), numBlocks(0)
+	{
+	}
+
+	// Size with the block numbers that follow, and dataSize bytes after them
+	size_t calcTotalSize( size_t dataSize = 0 )
+	{
+		size_t size = sizeof(netPlaySyncBlocksReq) + (numBlocks * sizeof(uint32_t)) + dataSize;
+
+		hdr.msgSize = size;
+
+		return size;
+	}
+
+	void toHostByteOrder()
+	{
+		hdr.toHostByteOrder();
+		snapshotSize = netPlayByteSwap(snapshotSize);
+		numBlocks    = netPlayByteSwap(numBlocks);
+	}
+
+	void toNetworkByteOrder()
+	{
+		hdr.toNetworkByteOrder();
+		snapshotSize = netPlayByteSwap(snapshotSize);
+		numBlocks    = netPlayByteSwap(numBlocks);
+	}
+
+	uint32_t* blockBuf()
+	{
+		uintptr_t buf = ((uintptr_t)this) + sizeof(netPlaySyncBlocksReq);
+
+		return (uint32_t*)buf;
+	}
+
+	// NETPLAY_SYNC_BLOCKS_RESP only: the requested blocks, zlib compressed
+	uint8_t* dataBuf()
+	{
+		uintptr_t buf = ((uintptr_t)this) + sizeof(netPlaySyncBlocksReq) + (numBlocks * sizeof(uint32_t));
+
+		return (uint8_t*)buf;
+	}
+};
 
 struct netPlayRunFrameReq
 {
@@ -417,6 +479,83 @@ struct netPlayRunFrameReq
 	}
 };
 
+// Frames in a row that have the same input
+struct netPlayInputRun
+{
+	uint8_t   numFrames;
+	uint8_t   ctrlState[4];
+};
+
+// Input of the frames [firstFrame, firstFrame + numFrames) as runs of equal
+// input. Sent over UDP, each packet repeats the frames the client has not
+// reported as ready yet, so that a lost packet is covered by the next one.
+struct netPlayRunFramesReq
+{
+	netPlayMsgHdr  hdr;
+
+	uint32_t  firstFrame;
+	uint16_t  numFrames;
+	uint8_t   numRuns;
+	uint8_t   catchUpThreshold;
+
+	static constexpr int maxFrames = 32;
+
+	netPlayInputRun  run[maxFrames];
+
+	netPlayRunFramesReq(void)
+		: hdr(NETPLAY_RUN_FRAMES_REQ, sizeof(netPlayRunFramesReq)), firstFrame(0), numFrames(0), numRuns(0), catchUpThreshold(10)
+	{
+		memset( run, 0, sizeof(run) );
+	}
+
+	// Size of the message with numRuns runs, the rest is not sent
+	size_t msgSize(void)
+	{
+		return sizeof(netPlayRunFramesReq) - (maxFrames - numRuns) * sizeof(netPlayInputRun);
+	}
+
+	void toHostByteOrder()
+	{
+		hdr.toHostByteOrder();
+		firstFrame = netPlayByteSwap(firstFrame);
+		numFrames  = netPlayByteSwap(numFrames);
+	}
+
+	void toNetworkByteOrder()
+	{
+		hdr.toNetworkByteOrder();
+		firstFrame = netPlayByteSwap(firstFrame);
+		numFrames  = netPlayByteSwap(numFrames);
+	}
+};
+
+// Sent by a client over TCP to ask for its frame input over UDP as well,
+// then over UDP with the same token until input starts coming in. The token
+// is how the host matches the datagrams' address to the connection.
+struct netPlayUdpInputReq
+{
+	netPlayMsgHdr  hdr;
+
+	uint32_t  token;
+
+	netPlayUdpInputReq( uint32_t id = NETPLAY_UDP_INPUT_REQ )
+		: hdr(id, sizeof(netPlayUdpInputReq)), token(0)
+	{
+	}
+
+	void toHostByteOrder()
+	{
+		hdr.toHostByteOrder();
+		token = netPlayByteSwap(token);
+	}
+
+	void toNetworkByteOrder()
+	{
+		hdr.toNetworkByteOrder();
+		token = netPlayByteSwap(token);
+	}
+};
+
 struct netPlayClientState
 {
 	netPlayMsgHdr  hdr;
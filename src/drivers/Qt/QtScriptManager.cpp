@@ -51,6 +51,7 @@
 #include "../../debug.h"
 #include "../../state.h"
 #include "../../ppu.h"
+#include "../../framehash.h"
 
 #include "common/os_utils.h"
 #include "utils/xstring.h"
@@ -79,6 +80,43 @@ extern char FileBase[];
 extern uint8 joy[4];
 
 static thread_local FCEU::JSEngine* currentEngine = nullptr;
+static thread_local const ScriptFrameSnapshot* currentSnapshot = nullptr;
+
+// A worker thread callback runs without the emulator lock, so it may only
+// look at the snapshot it was handed and not change anything
+static bool refuseOnWorker(const char* funcName)
+{
+	if (currentSnapshot == nullptr)
+	{
+		return false;
+	}
+	auto* engine = FCEU::JSEngine::getCurrent();
+
+	if (engine != nullptr)
+	{
+		engine->throwError(QJSValue::GenericError, QString(funcName) + "() cannot be called from a worker thread callback");
+	}
+	return true;
+}
+
+static uint8_t scriptReadMem(int address)
+{
+	if (currentSnapshot == nullptr)
+	{
+		return GetMem(address);
+	}
+	if (!currentSnapshot->contains(address))
+	{
+		auto* engine = FCEU::JSEngine::getCurrent();
+
+		if (engine != nullptr)
+		{
+			engine->throwError(QJSValue::RangeError, QString::asprintf("Address $%04X is not in the frame snapshot", address & 0xFFFF));
+		}
+		return 0;
+	}
+	return currentSnapshot->read(address);
+}
 
 namespace JS
 {
@@ -647,12 +685,17 @@ void EmuStateScriptObject::setSlot(int value)
 //----------------------------------------------------
 bool EmuStateScriptObject::save()
 {
-	if (data != nullptr)
+	if (refuseOnWorker("EmuState.save"))
 	{
-		delete data;
-		data = nullptr;
+		return false;
 	}
-	data = new EMUFILE_MEMORY();
+	// saving again writes over the buffer the last save grew
+	if (data == nullptr)
+	{
+		data = new EMUFILE_MEMORY();
+	}
+	data->set_len(0);
+	data->unfail();
 
 	FCEU_WRAPPER_LOCK();
 	FCEUSS_SaveMS( data, compression);
@@ -669,6 +712,11 @@ bool EmuStateScriptObject::save()
 bool EmuStateScriptObject::load()
 {
 	bool loaded = false;
+
+	if (refuseOnWorker("EmuState.load"))
+	{
+		return false;
+	}
 	if (data != nullptr)
 	{
 		FCEU_WRAPPER_LOCK();
@@ -802,11 +850,19 @@ void EmuScriptObject::print(const QString& msg)
 //----------------------------------------------------
 void EmuScriptObject::powerOn()
 {
+	if (refuseOnWorker("emu.powerOn"))
+	{
+		return;
+	}
 	fceuWrapperHardReset();
 }
 //----------------------------------------------------
 void EmuScriptObject::softReset()
 {
+	if (refuseOnWorker("emu.softReset"))
+	{
+		return;
+	}
 	fceuWrapperSoftReset();
 }
 //----------------------------------------------------
@@ -827,26 +883,46 @@ bool EmuScriptObject::paused()
 //----------------------------------------------------
 void EmuScriptObject::frameAdvance()
 {
+	if (refuseOnWorker("emu.frameAdvance"))
+	{
+		return;
+	}
 	script->frameAdvance();
 }
 //----------------------------------------------------
 int EmuScriptObject::frameCount()
 {
+	if (currentSnapshot != nullptr)
+	{
+		return currentSnapshot->frameCount;
+	}
 	return FCEUMOV_GetFrame();
 }
 //----------------------------------------------------
 int EmuScriptObject::lagCount()
 {
+	if (currentSnapshot != nullptr)
+	{
+		return currentSnapshot->lagCount;
+	}
 	return FCEUI_GetLagCount();
 }
 //----------------------------------------------------
 bool EmuScriptObject::lagged()
 {
+	if (currentSnapshot != nullptr)
+	{
+		return currentSnapshot->lagged;
+	}
 	return FCEUI_GetLagged();
 }
 //----------------------------------------------------
 void EmuScriptObject::setLagFlag(bool flag)
 {
+	if (refuseOnWorker("emu.setLagFlag"))
+	{
+		return;
+	}
 	FCEUI_SetLagFlag(flag);
 }
 //----------------------------------------------------
@@ -1017,6 +1093,11 @@ bool EmuScriptObject::loadRom(const QString& romPath)
 {
 	int ret = 0;
 
+	if (refuseOnWorker("emu.loadRom"))
+	{
+		return false;
+	}
+
 	if (!romPath.isEmpty())
 	{
 		ret = LoadGame(romPath.toLocal8Bit().constData());
@@ -1059,6 +1140,28 @@ QJSValue EmuScriptObject::getScreenPixel(int x, int y, bool useBackup)
 	return jsVal;
 }
 //----------------------------------------------------
+QJSValue EmuScriptObject::frameHash()
+{
+	uint64 exact, perceptual;
+
+	if (!FCEUI_GetFrameHash(&exact, &perceptual))
+	{
+		return QJSValue(QJSValue::UndefinedValue);
+	}
+	// 64-bit values do not fit a JS number, hand them out as hex strings
+	QJSValue jsVal = engine->newObject();
+
+	jsVal.setProperty("exact", QString::number(exact, 16).rightJustified(16, '0'));
+	jsVal.setProperty("perceptual", QString::number(perceptual, 16).rightJustified(16, '0'));
+
+	return jsVal;
+}
+//----------------------------------------------------
+int EmuScriptObject::frameHashDistance(const QString& hash1, const QString& hash2)
+{
+	return FCEUI_FrameHashDistance( hash1.toULongLong(nullptr, 16), hash2.toULongLong(nullptr, 16) );
+}
+//----------------------------------------------------
 QJSValue EmuScriptObject::createState(int slot)
 {
 	QJSValue jsVal;
@@ -1525,17 +1628,17 @@ void MemoryScriptObject::reset()
 //----------------------------------------------------
 uint8_t MemoryScriptObject::readByte(int address)
 {
-	return GetMem(address);
+	return scriptReadMem(address);
 }
 //----------------------------------------------------
 uint8_t MemoryScriptObject::readByteUnsigned(int address)
 {
-	return GetMem(address);
+	return scriptReadMem(address);
 }
 //----------------------------------------------------
 int8_t MemoryScriptObject::readByteSigned(int address)
 {
-	return static_cast<int8_t>(GetMem(address));
+	return static_cast<int8_t>(scriptReadMem(address));
 }
 //----------------------------------------------------
 uint16_t MemoryScriptObject::readWord(int addressLow, int addressHigh)
@@ -1545,7 +1648,7 @@ uint16_t MemoryScriptObject::readWord(int addressLow, int addressHigh)
 	{
 		addressHigh = addressLow + 1;
 	}
-	uint16_t result = GetMem(addressLow) | (GetMem(addressHigh) << 8);
+	uint16_t result = scriptReadMem(addressLow) | (scriptReadMem(addressHigh) << 8);
 	return result;
 }
 //----------------------------------------------------
@@ -1556,10 +1659,66 @@ uint16_t MemoryScriptObject::readWordUnsigned(int addressLow, int addressHigh)
 	{
 		addressHigh = addressLow + 1;
 	}
-	uint16_t result = GetMem(addressLow) | (GetMem(addressHigh) << 8);
+	uint16_t result = scriptReadMem(addressLow) | (scriptReadMem(addressHigh) << 8);
 	return result;
 }
 //----------------------------------------------------
+QJSValue MemoryScriptObject::newByteArray(int start, int size)
+{
+	// a QByteArray reaches JS as an ArrayBuffer, one copy with no per byte marshalling
+	QByteArray bytes(size, 0);
+
+	if (currentSnapshot != nullptr)
+	{
+		if (!currentSnapshot->contains(start, size))
+		{
+			engine->throwError(QJSValue::RangeError, QString::asprintf("Range $%04X-$%04X is not in the frame snapshot", start & 0xFFFF, (start + size - 1) & 0xFFFF));
+			return QJSValue();
+		}
+		for (int i = 0; i < size; i++)
+		{
+			bytes[i] = static_cast<char>(currentSnapshot->read(start + i));
+		}
+	}
+	else
+	{
+		FCEU_GetMemRange(start, reinterpret_cast<uint8*>(bytes.data()), size);
+	}
+
+	QJSValue buffer = engine->toScriptValue(bytes);
+
+	return engine->globalObject().property("Uint8Array").callAsConstructor(QJSValueList{ buffer });
+}
+//----------------------------------------------------
+QJSValue MemoryScriptObject::readByteRange(int start, int end)
+{
+	int size = end - start + 1;
+
+	if (size <= 0)
+	{
+		return QJSValue();
+	}
+	return newByteArray(start, size);
+}
+//----------------------------------------------------
+void MemoryScriptObject::readByteRangeInto(const QJSValue& dest, int start, int size, int offset)
+{
+	QJSValue setFunc = dest.property("set");
+
+	if (!setFunc.isCallable())
+	{
+		engine->throwError(QJSValue::TypeError, "memory.readByteRangeInto() needs a typed array to fill");
+		return;
+	}
+	if ((size <= 0) || (offset < 0) || (offset + size > dest.property("length").toInt()))
+	{
+		engine->throwError(QJSValue::RangeError, "memory.readByteRangeInto() range does not fit in the array");
+		return;
+	}
+	// TypedArray.prototype.set copies natively into the existing array
+	setFunc.callWithInstance(dest, QJSValueList{ newByteArray(start, size), offset });
+}
+//----------------------------------------------------
 int16_t MemoryScriptObject::readWordSigned(int addressLow, int addressHigh)
 {
 	// little endian, unless the high byte address is specified as a 2nd parameter
@@ -1567,12 +1726,16 @@ int16_t MemoryScriptObject::readWordSigned(int addressLow, int addressHigh)
 	{
 		addressHigh = addressLow + 1;
 	}
-	uint16_t result = GetMem(addressLow) | (GetMem(addressHigh) << 8);
+	uint16_t result = scriptReadMem(addressLow) | (scriptReadMem(addressHigh) << 8);
 	return static_cast<int16_t>(result);
 }
 //----------------------------------------------------
 void MemoryScriptObject::writeByte(int address, int value)
 {
+	if (refuseOnWorker("memory.writeByte"))
+	{
+		return;
+	}
 	uint32_t A = address;
 	uint8_t  V = value;
 
@@ -1584,66 +1747,94 @@ void MemoryScriptObject::writeByte(int address, int value)
 //----------------------------------------------------
 uint16_t MemoryScriptObject::getRegisterPC()
 {
-	return X.PC;
+	return currentSnapshot ? currentSnapshot->regPC : X.PC;
 }
 //----------------------------------------------------
 uint8_t MemoryScriptObject::getRegisterA()
 {
-	return X.A;
+	return currentSnapshot ? currentSnapshot->regA : X.A;
 }
 //----------------------------------------------------
 uint8_t MemoryScriptObject::getRegisterX()
 {
-	return X.X;
+	return currentSnapshot ? currentSnapshot->regX : X.X;
 }
 //----------------------------------------------------
 uint8_t MemoryScriptObject::getRegisterY()
 {
-	return X.Y;
+	return currentSnapshot ? currentSnapshot->regY : X.Y;
 }
 //----------------------------------------------------
 uint8_t MemoryScriptObject::getRegisterS()
 {
-	return X.S;
+	return currentSnapshot ? currentSnapshot->regS : X.S;
 }
 //----------------------------------------------------
 uint8_t MemoryScriptObject::getRegisterP()
 {
-	return X.P;
+	return currentSnapshot ? currentSnapshot->regP : X.P;
 }
 //----------------------------------------------------
 void MemoryScriptObject::setRegisterPC(uint16_t v)
 {
+	if (refuseOnWorker("memory.setRegisterPC"))
+	{
+		return;
+	}
 	X.PC = v;
 }
 //----------------------------------------------------
 void MemoryScriptObject::setRegisterA(uint8_t v)
 {
+	if (refuseOnWorker("memory.setRegisterA"))
+	{
+		return;
+	}
 	X.A = v;
 }
 //----------------------------------------------------
 void MemoryScriptObject::setRegisterX(uint8_t v)
 {
+	if (refuseOnWorker("memory.setRegisterX"))
+	{
+		return;
+	}
 	X.X = v;
 }
 //----------------------------------------------------
 void MemoryScriptObject::setRegisterY(uint8_t v)
 {
+	if (refuseOnWorker("memory.setRegisterY"))
+	{
+		return;
+	}
 	X.Y = v;
 }
 //----------------------------------------------------
 void MemoryScriptObject::setRegisterS(uint8_t v)
 {
+	if (refuseOnWorker("memory.setRegisterS"))
+	{
+		return;
+	}
 	X.S = v;
 }
 //----------------------------------------------------
 void MemoryScriptObject::setRegisterP(uint8_t v)
 {
+	if (refuseOnWorker("memory.setRegisterP"))
+	{
+		return;
+	}
 	X.P = v;
 }
 //----------------------------------------------------
 void MemoryScriptObject::registerCallback(int type, const QJSValue& func, int address, int size)
 {
+	if (refuseOnWorker("memory.register"))
+	{
+		return;
+	}
 	int n=0;
 	int *numFuncsRegistered = nullptr;
 	QJSValue** funcArray = nullptr;
@@ -1724,6 +1915,10 @@ void MemoryScriptObject::registerExec(const QJSValue& func, int address, int siz
 //----------------------------------------------------
 void MemoryScriptObject::unregisterCallback(int type, const QJSValue& func, int address, int size)
 {
+	if (refuseOnWorker("memory.unregister"))
+	{
+		return;
+	}
 	int n=0;
 	int *numFuncsRegistered = nullptr;
 	QJSValue** funcArray = nullptr;
@@ -1999,6 +2194,8 @@ QtScriptInstance::~QtScriptInstance()
 //----------------------------------------------------
 void QtScriptInstance::shutdownEngine()
 {
+	stopWorker();
+
 	running = false;
 
 	if (onFrameBeginCallback != nullptr)
@@ -2021,6 +2218,13 @@ void QtScriptInstance::shutdownEngine()
 		delete onGuiUpdateCallback;
 		onGuiUpdateCallback = nullptr;
 	}
+	if (onFrameAsyncCallback != nullptr)
+	{
+		delete onFrameAsyncCallback;
+		onFrameAsyncCallback = nullptr;
+	}
+	snapshotRanges.clear();
+	syncInterval = 0;
 
 	if (engine != nullptr)
 	{
@@ -2079,6 +2283,9 @@ void QtScriptInstance::resetEngine()
 {
 	shutdownEngine();
 	initEngine();
+
+	cpuUsage = CpuUsage();
+	usageSec = 0.0;
 }
 //----------------------------------------------------
 int QtScriptInstance::initEngine()
@@ -2104,6 +2311,7 @@ int QtScriptInstance::initEngine()
 
 	emu->setEngine(engine);
 	rom->setEngine(engine);
+	ppu->setEngine(engine);
 	mem->setEngine(engine);
 
 	// emu
@@ -2179,9 +2387,11 @@ int QtScriptInstance::loadScriptFile( QString filepath )
 	srcFile = filepath;
 
 	FCEU_WRAPPER_LOCK();
+	engineMutex.lock();
 	engine->acquireThreadContext();
 	QJSValue evalResult = engine->evaluate(fileText, filepath);
 	engine->releaseThreadContext();
+	engineMutex.unlock();
 	FCEU_WRAPPER_UNLOCK();
 
 	if (evalResult.isError())
@@ -2291,6 +2501,66 @@ void QtScriptInstance::registerGuiUpdate(const QJSValue& func)
 	onGuiUpdateCallback = new QJSValue(func);
 }
 //----------------------------------------------------
+void QtScriptInstance::registerAfterEmuFrameAsync(const QJSValue& func)
+{
+	if (refuseOnWorker("gui.registerAfterEmuFrameAsync"))
+	{
+		return;
+	}
+	if (onFrameAsyncCallback != nullptr)
+	{
+		delete onFrameAsyncCallback;
+	}
+	onFrameAsyncCallback = new QJSValue(func);
+
+	if (worker == nullptr)
+	{
+		if (snapshotRanges.isEmpty())
+		{
+			// by default just the internal RAM
+			snapshotRanges.push_back( ScriptFrameSnapshot::Range{ 0x0000, 0x0800 } );
+		}
+		worker = new ScriptWorkerThread_t(this);
+		worker->setRanges(snapshotRanges);
+		worker->start();
+	}
+}
+//----------------------------------------------------
+void QtScriptInstance::addSnapshotRange(int start, int size)
+{
+	if ((start < 0) || (size <= 0) || (start + size > 0x10000))
+	{
+		throwError(QJSValue::RangeError, "gui.addSnapshotRange() range must lie within $0000-$FFFF");
+		return;
+	}
+	snapshotRanges.push_back( ScriptFrameSnapshot::Range{ start, size } );
+
+	if (worker != nullptr)
+	{
+		worker->setRanges(snapshotRanges);
+	}
+}
+//----------------------------------------------------
+void QtScriptInstance::clearSnapshotRanges()
+{
+	snapshotRanges.clear();
+
+	if (worker != nullptr)
+	{
+		worker->setRanges(snapshotRanges);
+	}
+}
+//----------------------------------------------------
+void QtScriptInstance::setSyncInterval(int frames)
+{
+	syncInterval = (frames > 0) ? frames : 0;
+}
+//----------------------------------------------------
+int QtScriptInstance::framesSkipped()
+{
+	return (worker != nullptr) ? worker->framesSkipped() : 0;
+}
+//----------------------------------------------------
 void QtScriptInstance::print(const QString& msg)
 {
 	if (dialog)
@@ -2306,6 +2576,11 @@ bool QtScriptInstance::onEmulationThread()
 	return isEmuThread;
 }
 //----------------------------------------------------
+bool QtScriptInstance::onWorkerThread()
+{
+	return (worker != nullptr) && (QThread::currentThread() == worker);
+}
+//----------------------------------------------------
 bool QtScriptInstance::onGuiThread()
 {
 	bool isGuiThread = (QThread::currentThread() == QApplication::instance()->thread());
@@ -2349,6 +2624,18 @@ int  QtScriptInstance::runFunc(QJSValue &func, const QJSValueList& args)
 	int retval = 0;
 	auto state = getExecutionState();
 
+	FCEU::timeStampRecord startTime, endTime;
+
+	// the worker's time is not taken from the emulator, so it is not counted
+	bool timed = !onWorkerThread();
+
+	engineMutex.lock();
+
+	// callbacks run from inside a callback are already being timed
+	if (timed && (usageDepth++ == 0))
+	{
+		startTime.readNew();
+	}
 	state->start();
 
 	engine->acquireThreadContext();
@@ -2359,6 +2646,13 @@ int  QtScriptInstance::runFunc(QJSValue &func, const QJSValueList& args)
 
 	state->stop();
 
+	if (timed && (--usageDepth == 0))
+	{
+		endTime.readNew();
+		usageSec += (endTime - startTime).toSeconds();
+	}
+	engineMutex.unlock();
+
 	if (callResult.isError())
 	{
 		retval = -1;
@@ -2399,6 +2693,8 @@ int  QtScriptInstance::call(const QString& funcName, const QJSValueList& args)
 void QtScriptInstance::stopRunning()
 {
 	FCEU_WRAPPER_LOCK();
+	stopWorker();
+
 	if (running)
 	{
 		if (onScriptStopCallback != nullptr && onScriptStopCallback->isCallable())
@@ -2432,6 +2728,20 @@ void QtScriptInstance::onFrameBegin()
 	}
 }
 //----------------------------------------------------
+void QtScriptInstance::endFrameUsage()
+{
+	double us = usageSec * 1.0e6;
+
+	cpuUsage.frameUs = us;
+	cpuUsage.avgUs += (us - cpuUsage.avgUs) / 60.0;
+
+	if (us > cpuUsage.peakUs)
+	{
+		cpuUsage.peakUs = us;
+	}
+	usageSec = 0.0;
+}
+//----------------------------------------------------
 void QtScriptInstance::onFrameFinish()
 {
 	if (running)
@@ -2448,6 +2758,49 @@ void QtScriptInstance::onFrameFinish()
 	}
 }
 //----------------------------------------------------
+void QtScriptInstance::onFrameWorker(bool syncFrame)
+{
+	if (running && (worker != nullptr))
+	{
+		worker->postFrame(syncFrame);
+	}
+}
+//----------------------------------------------------
+void QtScriptInstance::runWorkerFrame(const ScriptFrameSnapshot& snapshot)
+{
+	if (!running || (onFrameAsyncCallback == nullptr) || !onFrameAsyncCallback->isCallable())
+	{
+		return;
+	}
+	currentSnapshot = &snapshot;
+
+	runFunc( *onFrameAsyncCallback, QJSValueList{ snapshot.frameCount } );
+
+	currentSnapshot = nullptr;
+}
+//----------------------------------------------------
+void QtScriptInstance::stopWorker()
+{
+	if (worker == nullptr)
+	{
+		return;
+	}
+	// a callback still running is cut short
+	if (engine != nullptr)
+	{
+		engine->setInterrupted(true);
+	}
+	worker->stop();
+	worker->wait();
+
+	if (engine != nullptr)
+	{
+		engine->setInterrupted(false);
+	}
+	delete worker;
+	worker = nullptr;
+}
+//----------------------------------------------------
 void QtScriptInstance::flushLog()
 {
 	if (dialog != nullptr)
@@ -2460,7 +2813,14 @@ void QtScriptInstance::onGuiUpdate()
 {
 	if (running && onGuiUpdateCallback != nullptr && onGuiUpdateCallback->isCallable())
 	{
+		// the GUI does not wait for a busy worker, it updates next time
+		if (!engineMutex.tryLock())
+		{
+			return;
+		}
 		runFunc( *onGuiUpdateCallback );
+
+		engineMutex.unlock();
 	}
 }
 //----------------------------------------------------
@@ -2468,7 +2828,11 @@ ScriptExecutionState* QtScriptInstance::getExecutionState()
 {
 	ScriptExecutionState* state;
 
-	if (onEmulationThread())
+	if (onWorkerThread())
+	{
+		state = &workerFuncState;
+	}
+	else if (onEmulationThread())
 	{
 		state = &emuFuncState;
 	}
@@ -2505,6 +2869,18 @@ void QtScriptInstance::checkForHang()
 		}
 	}
 
+	// the worker may take as long as it likes, unless the emulator is waiting on it
+	if ( workerFuncState.isRunning() )
+	{
+		unsigned int timeRunningMs = workerFuncState.timeCheck();
+
+		if ((timeRunningMs > funcTimeoutMs) && (worker != nullptr) && worker->emulatorWaiting())
+		{
+			printf("Interrupted Worker Thread Script Function\n");
+			engine->setInterrupted(true);
+		}
+	}
+
 }
 //----------------------------------------------------
 QString QtScriptInstance::openFileBrowser(const QString& initialPath)
@@ -2675,11 +3051,32 @@ void QtScriptManager::frameFinishedUpdate()
 	FCEU_WRAPPER_LOCK();
 	for (auto script : scriptList)
 	{
+		int interval = script->getSyncInterval();
+
 		script->onFrameFinish();
+		script->onFrameWorker( (interval > 0) && ((FCEUMOV_GetFrame() % interval) == 0) );
+		script->endFrameUsage();
 	}
 	FCEU_WRAPPER_UNLOCK();
 }
 //----------------------------------------------------
+void QtScriptManager::getCpuUsage(QList<ScriptCpuUsage>& list)
+{
+	FCEU::autoScopedLock autoLock(scriptListMutex);
+
+	list.clear();
+
+	for (auto script : scriptList)
+	{
+		ScriptCpuUsage item;
+
+		item.srcFile = script->getSrcFile();
+		item.usage = script->getCpuUsage();
+
+		list.push_back(item);
+	}
+}
+//----------------------------------------------------
 void QtScriptManager::guiUpdate()
 {
 	FCEU_WRAPPER_LOCK();
@@ -2720,6 +3117,115 @@ void ScriptMonitorThread_t::run()
 	//printf("Script Monitor Thread is Stopping...\n");
 }
 //----------------------------------------------------
+//---- Qt Script Frame Snapshot
+//----------------------------------------------------
+void ScriptFrameSnapshot::capture(const QList<Range>& rangeList)
+{
+	ranges = rangeList;
+
+	for (const auto& range : ranges)
+	{
+		FCEU_GetMemRange(range.start, &mem[range.start], range.size);
+	}
+	frameCount = FCEUMOV_GetFrame();
+	lagCount = FCEUI_GetLagCount();
+	lagged = FCEUI_GetLagged();
+
+	regPC = X.PC;
+	regA = X.A;
+	regX = X.X;
+	regY = X.Y;
+	regS = X.S;
+	regP = X.P;
+}
+//----------------------------------------------------
+bool ScriptFrameSnapshot::contains(int address, int size) const
+{
+	for (const auto& range : ranges)
+	{
+		if ((address >= range.start) && (address + size <= range.start + range.size))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+//----------------------------------------------------
+//---- Qt Script Worker Thread
+//----------------------------------------------------
+ScriptWorkerThread_t::ScriptWorkerThread_t(QtScriptInstance *script)
+	: QThread(nullptr), script(script)
+{
+}
+//----------------------------------------------------
+void ScriptWorkerThread_t::setRanges(const QList<ScriptFrameSnapshot::Range>& rangeList)
+{
+	std::lock_guard<std::mutex> lock(frameMutex);
+
+	ranges = rangeList;
+}
+//----------------------------------------------------
+void ScriptWorkerThread_t::postFrame(bool sync)
+{
+	std::unique_lock<std::mutex> lock(frameMutex);
+
+	if (quit)
+	{
+		return;
+	}
+	// the worker never has nextIdx, so it can be filled while the worker runs
+	if (pending)
+	{
+		skipped++;
+	}
+	snapshots[nextIdx].capture(ranges);
+	pending = true;
+	frameCond.notify_one();
+
+	if (sync)
+	{
+		waiting = true;
+		doneCond.wait(lock, [this]{ return quit || (!pending && !busy); });
+		waiting = false;
+	}
+}
+//----------------------------------------------------
+void ScriptWorkerThread_t::stop()
+{
+	std::lock_guard<std::mutex> lock(frameMutex);
+
+	quit = true;
+	frameCond.notify_one();
+	doneCond.notify_all();
+}
+//----------------------------------------------------
+void ScriptWorkerThread_t::run()
+{
+	std::unique_lock<std::mutex> lock(frameMutex);
+
+	for (;;)
+	{
+		frameCond.wait(lock, [this]{ return quit || pending; });
+
+		if (quit)
+		{
+			break;
+		}
+		int runIdx = nextIdx;
+
+		nextIdx ^= 1;
+		pending = false;
+		busy = true;
+
+		lock.unlock();
+		script->runWorkerFrame(snapshots[runIdx]);
+		lock.lock();
+
+		busy = false;
+		doneCond.notify_all();
+	}
+}
+//----------------------------------------------------
 //---- Qt Script Dialog Window
 //----------------------------------------------------
 QScriptDialog_t::QScriptDialog_t(QWidget *parent)
@@ -3280,9 +3786,30 @@ void QScriptDialog_t::updatePeriodic(void)
 		emuThreadText.clear();
 	}
 
-	if ((scriptInstance != nullptr) && scriptInstance->isRunning())
+	workerTextMutex.lock();
+	if (!workerThreadText.isEmpty())
+	{
+		auto* vbar = jsOutput->verticalScrollBar();
+		int vbarValue = vbar->value();
+		bool vbarAtMax = vbarValue >= vbar->maximum();
+
+		jsOutput->insertPlainText(workerThreadText);
+
+		if (vbarAtMax)
+		{
+			vbar->setValue( vbar->maximum() );
+		}
+		workerThreadText.clear();
+	}
+	workerTextMutex.unlock();
+
+	// the property tree waits for a time the worker is not in the engine
+	if ((scriptInstance != nullptr) && scriptInstance->isRunning() &&
+			scriptInstance->getEngineMutex().tryLock())
 	{
 		reloadGlobalTree();
+
+		scriptInstance->getEngineMutex().unlock();
 	}
 
 	refreshState();
@@ -3525,6 +4052,12 @@ void QScriptDialog_t::logOutput(const QString& text)
 	{
 		emuThreadText.append(text);
 	}
+	else if (QThread::currentThread() != QApplication::instance()->thread())
+	{
+		// a worker thread, which does not hold the emulator lock
+		FCEU::autoScopedLock autoLock(workerTextMutex);
+		workerThreadText.append(text);
+	}
 	else
 	{
 		auto* vbar = jsOutput->verticalScrollBar();
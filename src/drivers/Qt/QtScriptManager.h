@@ -8,6 +8,10 @@
 #include <stdio.h>
 #include <stdarg.h>
 
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
 #include <QFile>
 #include <QColor>
 #include <QWidget>
@@ -322,6 +326,16 @@ public slots:
 	Q_INVOKABLE  void ovrdLeft(bool value){ setButtonOverride<ButtonMaskLeft>(value); }
 	Q_INVOKABLE  void ovrdRight(bool value){ setButtonOverride<ButtonMaskRight>(value); }
 
+	// All of a frame's overrides in one call: the buttons of pressMask are
+	// forced on, those of releaseMask off, the others left as they are
+	Q_INVOKABLE  void ovrdButtons(int pressMask, int releaseMask = 0)
+	{
+		jsOverrideMask1[player] = (jsOverrideMask1[player] | pressMask) & ~releaseMask;
+		jsOverrideMask2[player] = (jsOverrideMask2[player] | pressMask) & ~releaseMask;
+	}
+	// Forces every button, the ones of mask on and the others off
+	Q_INVOKABLE  void ovrdState(int mask){ ovrdButtons(mask & 0xFF, ~mask & 0xFF); }
+
 	Q_INVOKABLE  void ovrdReset()
 	{
 		jsOverrideMask1[player] = 0xFF;
@@ -415,6 +429,8 @@ public slots:
 	Q_INVOKABLE  void exit();
 	Q_INVOKABLE  QString getDir();
 	Q_INVOKABLE  QJSValue getScreenPixel(int x, int y, bool useBackup = false);
+	Q_INVOKABLE  QJSValue frameHash();
+	Q_INVOKABLE  int  frameHashDistance(const QString& hash1, const QString& hash2);
 	Q_INVOKABLE  QJSValue createState(int slot = -1);
 
 };
@@ -474,6 +490,7 @@ private:
 
 	void registerCallback(int type, const QJSValue& func, int address, int size = 1);
 	void unregisterCallback(int type, const QJSValue& func, int address, int size = 1);
+	QJSValue newByteArray(int start, int size);
 
 public slots:
 	Q_INVOKABLE  uint8_t readByte(int address);
@@ -482,6 +499,8 @@ public slots:
 	Q_INVOKABLE uint16_t readWord(int addressLow, int addressHigh = -1);
 	Q_INVOKABLE  int16_t readWordSigned(int addressLow, int addressHigh = -1);
 	Q_INVOKABLE uint16_t readWordUnsigned(int addressLow, int addressHigh = -1);
+	Q_INVOKABLE QJSValue readByteRange(int start, int end);
+	Q_INVOKABLE     void readByteRangeInto(const QJSValue& dest, int start, int size, int offset = 0);
 	Q_INVOKABLE     void writeByte(int address, int value);
 	Q_INVOKABLE uint16_t getRegisterPC();
 	Q_INVOKABLE  uint8_t getRegisterA();
@@ -653,6 +672,70 @@ class ScriptExecutionState
 		unsigned int timeMs = 0;
 };
 
+// What a worker thread callback gets to see of the emulator: the memory
+// ranges the script asked for and the registers and counters, all copied
+// on the emulation thread at the end of the frame
+class ScriptFrameSnapshot
+{
+	public:
+		struct Range
+		{
+			int start;
+			int size;
+		};
+
+		void capture(const QList<Range>& rangeList);
+		bool contains(int address, int size = 1) const;
+		uint8_t read(int address) const { return mem[address & 0xFFFF]; }
+
+		QList<Range> ranges;
+		int frameCount = 0;
+		int lagCount = 0;
+		bool lagged = false;
+		uint16_t regPC = 0;
+		uint8_t regA = 0, regX = 0, regY = 0, regS = 0, regP = 0;
+
+	private:
+		uint8_t mem[0x10000];
+};
+
+// Runs a script's async frame callback off the emulation thread. The
+// emulation thread hands over a snapshot at the end of each frame and only
+// waits for the callback on the sync frames; on the others a frame the
+// worker is still busy with is replaced by the newer one and counted as
+// skipped.
+class ScriptWorkerThread_t : public QThread
+{
+	Q_OBJECT
+
+	protected:
+		void run( void ) override;
+
+	public:
+		ScriptWorkerThread_t( QtScriptInstance *script );
+
+		void setRanges(const QList<ScriptFrameSnapshot::Range>& rangeList);
+		void postFrame(bool sync);
+		void stop();
+
+		bool emulatorWaiting(){ return waiting; }
+		int  framesSkipped(){ return skipped; }
+
+	private:
+		QtScriptInstance *script;
+		std::mutex frameMutex;
+		std::condition_variable frameCond;
+		std::condition_variable doneCond;
+		QList<ScriptFrameSnapshot::Range> ranges;
+		ScriptFrameSnapshot snapshots[2];
+		int  nextIdx = 0;
+		bool pending = false;
+		bool busy = false;
+		bool quit = false;
+		std::atomic<bool> waiting{false};
+		std::atomic<int> skipped{0};
+};
+
 class QtScriptInstance : public QObject
 {
 	Q_OBJECT
@@ -671,6 +754,8 @@ public:
 	void onFrameBegin();
 	void onFrameFinish();
 	void onGuiUpdate();
+	void onFrameWorker(bool syncFrame);
+	void runWorkerFrame(const ScriptFrameSnapshot& snapshot);
 	void checkForHang();
 	void flushLog();
 	int  runFunc(QJSValue &func, const QJSValueList& args = QJSValueList());
@@ -679,6 +764,18 @@ public:
 
 	const QString& getSrcFile(){ return srcFile; };
 	FCEU::JSEngine* getEngine(){ return engine; };
+	FCEU::mutex& getEngineMutex(){ return engineMutex; }
+	int  getSyncInterval(){ return syncInterval; }
+
+	// Time spent in the script's callbacks, in microseconds
+	struct CpuUsage
+	{
+		double frameUs = 0.0;  // during the last frame
+		double avgUs = 0.0;    // moving average, over about a second of frames
+		double peakUs = 0.0;   // longest frame since the script was loaded
+	};
+	const CpuUsage& getCpuUsage(){ return cpuUsage; }
+	void endFrameUsage();
 private:
 
 	int  initEngine();
@@ -687,8 +784,10 @@ private:
 	void loadObjectChildren(QJSValue& jsObject, QObject* obj);
 
 	ScriptExecutionState* getExecutionState();
+	void stopWorker();
 
 	FCEU::JSEngine* engine = nullptr;
+	FCEU::mutex engineMutex;  // held while any thread is in the engine
 	QScriptDialog_t* dialog = nullptr;
 	JS::EmuScriptObject* emu = nullptr;
 	JS::RomScriptObject* rom = nullptr;
@@ -702,12 +801,20 @@ private:
 	QJSValue *onFrameFinishCallback = nullptr;
 	QJSValue *onScriptStopCallback = nullptr;
 	QJSValue *onGuiUpdateCallback = nullptr;
+	QJSValue *onFrameAsyncCallback = nullptr;
+	ScriptWorkerThread_t *worker = nullptr;
+	QList<ScriptFrameSnapshot::Range> snapshotRanges;
+	int syncInterval = 0;
 	ScriptExecutionState guiFuncState;
 	ScriptExecutionState emuFuncState;
+	ScriptExecutionState workerFuncState;
 	int frameAdvanceCount = 0;
 	int frameAdvanceState = 0;
 	bool running = false;
 	QString srcFile;
+	CpuUsage cpuUsage;
+	double usageSec = 0.0;  // this frame so far
+	int usageDepth = 0;
 
 signals:
 	void errorNotify();
@@ -720,8 +827,14 @@ public slots:
 	Q_INVOKABLE  void registerAfterEmuFrame(const QJSValue& func);
 	Q_INVOKABLE  void registerStop(const QJSValue& func);
 	Q_INVOKABLE  void registerGuiUpdate(const QJSValue& func);
+	Q_INVOKABLE  void registerAfterEmuFrameAsync(const QJSValue& func);
+	Q_INVOKABLE  void addSnapshotRange(int start, int size);
+	Q_INVOKABLE  void clearSnapshotRanges();
+	Q_INVOKABLE  void setSyncInterval(int frames);
+	Q_INVOKABLE  int  framesSkipped();
 	Q_INVOKABLE  bool onGuiThread();
 	Q_INVOKABLE  bool onEmulationThread();
+	Q_INVOKABLE  bool onWorkerThread();
 };
 
 class  ScriptMonitorThread_t : public QThread
@@ -752,6 +865,13 @@ public:
 	int  numScriptsLoaded(void){ return scriptList.size(); }
 	void addScriptInstance(QtScriptInstance* script);
 	void removeScriptInstance(QtScriptInstance* script);
+
+	struct ScriptCpuUsage
+	{
+		QString srcFile;
+		QtScriptInstance::CpuUsage usage;
+	};
+	void getCpuUsage(QList<ScriptCpuUsage>& list);
 private:
 	static QtScriptManager* _instance;
 
@@ -834,6 +954,8 @@ protected:
 	JsPropertyTree *propTree;
 	QtScriptInstance *scriptInstance;
 	QString   emuThreadText;
+	QString   workerThreadText;
+	FCEU::mutex workerTextMutex;
 	QString   logSavePath;
 	QLabel *logFilepathLbl;
 	QLabel *logFilepath;
@@ -48,6 +48,8 @@
 #include "../../debug.h"
 #include "../../movie.h"
 
+#include "common/ram_search.h"
+
 #include "Qt/main.h"
 #include "Qt/dface.h"
 #include "Qt/input.h"
@@ -66,56 +68,52 @@ static bool ShowSRAM = false;
 static bool ShowROM  = false;
 static RamSearchDialog_t *ramSearchWin = NULL;
 
-struct memoryState_t
-{
-	union
-	{
-		int8_t i;
-		uint8_t u;
-	} v8;
-	union
-	{
-		int16_t i;
-		uint16_t u;
-	} v16;
-	union
-	{
-		int32_t i;
-		uint32_t u;
-	} v32;
-};
-
-struct memoryLocation_t
-{
-	int addr;
-
-	memoryState_t val;
-
-	std::vector<memoryState_t> hist;
-
-	uint32_t chgCount;
-	uint64_t elimMask;
-
-	memoryLocation_t(void)
-	{
-		addr = 0;
-		val.v32.u = 0;
-		chgCount = 0;
-		elimMask = 0;
-	}
-};
-static struct memoryLocation_t memLoc[0x10000];
+static RamSearchEngine ramSrch;
 static uint8_t lclMemBuf[0x10000];
-
-static std::list<struct memoryLocation_t *> actvSrchList;
-static std::list<struct memoryLocation_t *> deactvSrchList;
-static std::vector<int> deactvFrameStack;
+static uint8_t frameMemBuf[0x10000];
+static bool frameSrchRunning = false;
 
 static int cmpOp = '=';
 static int dpySize = 'b';
 static int dpyType = 's';
 static bool chkMisAligned = false;
 
+struct framePredicateDesc_t
+{
+	const char *name;
+	int op;
+	int idleOp;
+	bool hasValue;
+	bool hasButton;
+};
+
+static const framePredicateDesc_t framePredicates[] =
+{
+	{ "Changed",                  '!', 0,   false, false },
+	{ "Unchanged",                '=', 0,   false, false },
+	{ "Increased",                '>', 0,   false, false },
+	{ "Decreased",                '<', 0,   false, false },
+	{ "Changed By",               '+', 0,   true,  false },
+	{ "Changes With Button",      '!', '=', false, true  },
+	{ "Unchanged Without Button", 0,   '=', false, true  },
+};
+
+static const struct
+{
+	const char *name;
+	uint32_t mask;
+} frameButtons[] =
+{
+	{ "A",      JOY_A      },
+	{ "B",      JOY_B      },
+	{ "Select", JOY_SELECT },
+	{ "Start",  JOY_START  },
+	{ "Up",     JOY_UP     },
+	{ "Down",   JOY_DOWN   },
+	{ "Left",   JOY_LEFT   },
+	{ "Right",  JOY_RIGHT  },
+};
+
 class ramSearchInputValidator : public QValidator
 {
 public:
@@ -493,6 +491,47 @@ RamSearchDialog_t::RamSearchDialog_t(QWidget *parent)
 	autoSearchCbox->setEnabled(true);
 	vbox2->addWidget(autoSearchCbox);
 
+	grid = new QGridLayout();
+	frame = new QGroupBox(tr("Frame Search"));
+	frame->setLayout(grid);
+	hbox2->addWidget(frame);
+
+	frameSrchPredBox = new QComboBox();
+	frameSrchBtnBox = new QComboBox();
+	frameSrchValEdit = new QLineEdit();
+	frameSrchCountEdit = new QLineEdit();
+	frameSrchButton = new QPushButton(tr("Start"));
+
+	for (size_t i = 0; i < sizeof(framePredicates) / sizeof(framePredicates[0]); i++)
+	{
+		frameSrchPredBox->addItem(tr(framePredicates[i].name), (int)i);
+	}
+	for (size_t i = 0; i < sizeof(frameButtons) / sizeof(frameButtons[0]); i++)
+	{
+		frameSrchBtnBox->addItem(tr(frameButtons[i].name), frameButtons[i].mask);
+	}
+
+	frameSrchValEdit->setValidator(inpValidator);
+	frameSrchValEdit->setText("1");
+	frameSrchCountEdit->setValidator(inpValidator);
+	frameSrchCountEdit->setText("60");
+	frameSrchCountEdit->setToolTip( tr("Number of frames to run the search for, 0 runs until stopped") );
+
+	grid->addWidget(new QLabel(tr("Value:")), 0, 0, Qt::AlignLeft);
+	grid->addWidget(frameSrchPredBox, 0, 1);
+	grid->addWidget(new QLabel(tr("By:")), 1, 0, Qt::AlignLeft);
+	grid->addWidget(frameSrchValEdit, 1, 1);
+	grid->addWidget(new QLabel(tr("Button:")), 2, 0, Qt::AlignLeft);
+	grid->addWidget(frameSrchBtnBox, 2, 1);
+	grid->addWidget(new QLabel(tr("Frames:")), 3, 0, Qt::AlignLeft);
+	grid->addWidget(frameSrchCountEdit, 3, 1);
+	grid->addWidget(frameSrchButton, 4, 0, 1, 2);
+
+	connect(frameSrchPredBox, SIGNAL(currentIndexChanged(int)), this, SLOT(frameSrchPredChanged(int)));
+	connect(frameSrchButton, SIGNAL(clicked(void)), this, SLOT(frameSearchClicked(void)));
+
+	frameSrchPredChanged(0);
+
 	setLayout(mainLayout);
 
 	cycleCounter = 0;
@@ -505,6 +544,7 @@ RamSearchDialog_t::RamSearchDialog_t(QWidget *parent)
 	connect(updateTimer, &QTimer::timeout, this, &RamSearchDialog_t::periodicUpdate);
 
 	updateTimer->start(8); // ~120hz
+	fceuPauseTimerWhileHidden( this, updateTimer );
 
 	restoreGeometry(settings.value("ramSearchWindow/geometry").toByteArray());
 }
@@ -515,16 +555,10 @@ RamSearchDialog_t::~RamSearchDialog_t(void)
 
 	updateTimer->stop();
 	//printf("Destroy RAM Search Window\n");
-	ramSearchWin = NULL;
+	stopFrameSearch();
 
-	actvSrchList.clear();
-	deactvSrchList.clear();
-	deactvFrameStack.clear();
+	ramSearchWin = NULL;
 
-	for (unsigned int addr = 0; addr < 0x08000; addr++)
-	{
-		memLoc[addr].hist.clear();
-	}
 	settings.setValue("ramSearchWindow/geometry", saveGeometry());
 }
 //----------------------------------------------------------------------------
@@ -549,32 +583,51 @@ void RamSearchDialog_t::periodicUpdate(void)
 
 	if (currFrameCounter != frameCounterLastPass)
 	{
+		bool running;
+
 		FCEU_WRAPPER_LOCK();
-		copyRamToLocalBuffer();
-		FCEU_WRAPPER_UNLOCK();
+		running = ramSrch.frameSearchActive();
 
-		//if ( currFrameCounter != (frameCounterLastPass+1) )
-		//{
-		//   printf("Warning: Ram Search Missed Frame: %i \n", currFrameCounter );
-		//}
-		updateRamValues();
+		if (!running)
+		{
+			copyRamToLocalBuffer();
+		}
+		FCEU_WRAPPER_UNLOCK();
 
-		if (autoSearchCbox->isChecked())
+		if (running)
+		{
+			// the emulator thread updates the values
+			vbar->setMaximum(ramSrch.size());
+		}
+		else
 		{
-			runSearch();
+			if (frameSrchRunning)
+			{
+				frameSearchEnded();
+			}
+			//if ( currFrameCounter != (frameCounterLastPass+1) )
+			//{
+			//   printf("Warning: Ram Search Missed Frame: %i \n", currFrameCounter );
+			//}
+			updateRamValues();
+
+			if (autoSearchCbox->isChecked())
+			{
+				runSearch();
+			}
 		}
 		frameCounterLastPass = currFrameCounter;
 	}
 
 	if ((cycleCounter % 10) == 0)
 	{
-		undoButton->setEnabled(deactvFrameStack.size() > 0);
+		undoButton->setEnabled(!frameSrchRunning && (ramSrch.undoDepth() > 0));
 
 		selAddr = ramView->getSelAddr();
 
 		if (selAddr >= 0)
 		{
-			elimButton->setEnabled(true);
+			elimButton->setEnabled(!frameSrchRunning);
 			watchButton->setEnabled(true);
 			addCheatButton->setEnabled(true);
 			hexEditButton->setEnabled(true);
@@ -624,24 +677,12 @@ void RamSearchDialog_t::misalignedChanged(int state)
 	calcRamList();
 }
 //----------------------------------------------------------------------------
-static bool memoryAddrCompare(memoryLocation_t *loc1, memoryLocation_t *loc2)
+static void setSearchFormat(void)
 {
-	return loc1->addr < loc2->addr;
-}
-static void sortActvMemList(void)
-{
-	actvSrchList.sort(memoryAddrCompare);
-}
+	int size = (dpySize == 'd') ? 4 : (dpySize == 'w') ? 2 : 1;
 
-// basic comparison functions:
-static bool LessCmp(int64_t x, int64_t y, int64_t i) { return x < y; }
-static bool MoreCmp(int64_t x, int64_t y, int64_t i) { return x > y; }
-static bool LessEqualCmp(int64_t x, int64_t y, int64_t i) { return x <= y; }
-static bool MoreEqualCmp(int64_t x, int64_t y, int64_t i) { return x >= y; }
-static bool EqualCmp(int64_t x, int64_t y, int64_t i) { return x == y; }
-static bool UnequalCmp(int64_t x, int64_t y, int64_t i) { return x != y; }
-static bool DiffByCmp(int64_t x, int64_t y, int64_t p) { return x - y == p || y - x == p; }
-static bool ModIsCmp(int64_t x, int64_t y, int64_t p) { return p && x % p == y; }
+	ramSrch.setFormat(size, dpyType == 's', ShowROM ? 0x10000 : 0x8000);
+}
 
 static int64_t getLineEditValue(QLineEdit *edit, bool forceHex = false)
 {
@@ -658,455 +699,47 @@ static int64_t getLineEditValue(QLineEdit *edit, bool forceHex = false)
 }
 
 //----------------------------------------------------------------------------
-void RamSearchDialog_t::SearchRelative(void)
+void RamSearchDialog_t::searchCandidates(int kind, int op, int64_t y)
 {
-	int elimCount = 0;
-	std::list<struct memoryLocation_t *>::iterator it;
-	memoryLocation_t *loc = NULL;
-	int64_t x = 0, y = 0, p = 0;
-	bool (*cmpFun)(int64_t x, int64_t y, int64_t p) = NULL;
+	int64_t p = 0;
 	bool storeHistory = !autoSearchCbox->isChecked();
 
-	switch (cmpOp)
+	if (op == 'd')
 	{
-	case '<':
-		cmpFun = LessCmp;
-		break;
-	case '>':
-		cmpFun = MoreCmp;
-		break;
-	case '=':
-		cmpFun = EqualCmp;
-		break;
-	case '!':
-		cmpFun = UnequalCmp;
-		break;
-	case 'l':
-		cmpFun = LessEqualCmp;
-		break;
-	case 'm':
-		cmpFun = MoreEqualCmp;
-		break;
-	case 'd':
-		cmpFun = DiffByCmp;
 		p = getLineEditValue(diffByEdit);
-		break;
-	case '%':
-		cmpFun = ModIsCmp;
-		p = getLineEditValue(moduloEdit);
-		break;
-	default:
-		cmpFun = NULL;
-		break;
 	}
-
-	if (cmpFun == NULL)
+	else if (op == '%')
 	{
-		return;
+		p = getLineEditValue(moduloEdit);
 	}
-	//printf("Performing Relative Search Operation %zi: '%c'  '%lli'  '0x%llx' \n", deactvFrameStack.size()+1, cmpOp, (long long int)p, (unsigned long long int)p );
-
-	it = actvSrchList.begin();
-
-	while (it != actvSrchList.end())
-	{
-		loc = *it;
-
-		switch (dpySize)
-		{
-		default:
-		case 'b':
-		{
-			if (dpyType == 's')
-			{
-				x = loc->val.v8.i;
-				y = loc->hist.back().v8.i;
-			}
-			else
-			{
-				x = loc->val.v8.u;
-				y = loc->hist.back().v8.u;
-			}
-		}
-		break;
-		case 'w':
-		{
-			if (dpyType == 's')
-			{
-				x = loc->val.v16.i;
-				y = loc->hist.back().v16.i;
-			}
-			else
-			{
-				x = loc->val.v16.u;
-				y = loc->hist.back().v16.u;
-			}
-		}
-		break;
-		case 'd':
-		{
-			if (dpyType == 's')
-			{
-				x = loc->val.v32.i;
-				y = loc->hist.back().v32.i;
-			}
-			else
-			{
-				x = loc->val.v32.u;
-				y = loc->hist.back().v32.u;
-			}
-		}
-		break;
-		}
-
-		if (cmpFun(x, y, p) == false)
-		{
-			//printf("Eliminated Address: $%04X\n", loc->addr );
-			it = actvSrchList.erase(it);
+	//printf("Performing Search Operation %zi: '%i' 'x %c %lli' '%lli'  '0x%llx' \n", ramSrch.undoDepth()+1, kind, op,
+	//     (long long int)y, (long long int)p, (unsigned long long int)p );
 
-			if (storeHistory)
-			{
-				deactvSrchList.push_back(loc);
-				elimCount++;
-			}
-		}
-		else
-		{
-			if (storeHistory)
-			{
-				loc->hist.push_back(loc->val);
-			}
-			it++;
-		}
-	}
+	setSearchFormat();
 
-	if (storeHistory)
-	{
-		deactvFrameStack.push_back(elimCount);
-	}
+	ramSrch.search(kind, op, y, p, storeHistory);
 
-	vbar->setMaximum(actvSrchList.size());
+	vbar->setMaximum(ramSrch.size());
 }
 //----------------------------------------------------------------------------
-void RamSearchDialog_t::SearchSpecificValue(void)
+void RamSearchDialog_t::SearchRelative(void)
 {
-	int elimCount = 0;
-	std::list<struct memoryLocation_t *>::iterator it;
-	memoryLocation_t *loc = NULL;
-	int64_t x = 0, y = 0, p = 0;
-	bool (*cmpFun)(int64_t x, int64_t y, int64_t p) = NULL;
-	bool storeHistory = !autoSearchCbox->isChecked();
-
-	switch (cmpOp)
-	{
-	case '<':
-		cmpFun = LessCmp;
-		break;
-	case '>':
-		cmpFun = MoreCmp;
-		break;
-	case '=':
-		cmpFun = EqualCmp;
-		break;
-	case '!':
-		cmpFun = UnequalCmp;
-		break;
-	case 'l':
-		cmpFun = LessEqualCmp;
-		break;
-	case 'm':
-		cmpFun = MoreEqualCmp;
-		break;
-	case 'd':
-		cmpFun = DiffByCmp;
-		p = getLineEditValue(diffByEdit);
-		break;
-	case '%':
-		cmpFun = ModIsCmp;
-		p = getLineEditValue(moduloEdit);
-		break;
-	default:
-		cmpFun = NULL;
-		break;
-	}
-
-	if (cmpFun == NULL)
-	{
-		return;
-	}
-	y = getLineEditValue(specValEdit);
-
-	//printf("Performing Specific Value Search Operation %zi: 'x %c %lli' '%lli'  '0x%llx' \n", deactvFrameStack.size()+1, cmpOp,
-	//     (long long int)y, (long long int)p, (unsigned long long int)p );
-
-	it = actvSrchList.begin();
-
-	while (it != actvSrchList.end())
-	{
-		loc = *it;
-
-		switch (dpySize)
-		{
-		default:
-		case 'b':
-		{
-			if (dpyType == 's')
-			{
-				x = loc->val.v8.i;
-			}
-			else
-			{
-				x = loc->val.v8.u;
-			}
-		}
-		break;
-		case 'w':
-		{
-			if (dpyType == 's')
-			{
-				x = loc->val.v16.i;
-			}
-			else
-			{
-				x = loc->val.v16.u;
-			}
-		}
-		break;
-		case 'd':
-		{
-			if (dpyType == 's')
-			{
-				x = loc->val.v32.i;
-			}
-			else
-			{
-				x = loc->val.v32.u;
-			}
-		}
-		break;
-		}
-
-		if (cmpFun(x, y, p) == false)
-		{
-			//printf("Eliminated Address: $%04X\n", loc->addr );
-			it = actvSrchList.erase(it);
-
-			if (storeHistory)
-			{
-				deactvSrchList.push_back(loc);
-				elimCount++;
-			}
-		}
-		else
-		{
-			if (storeHistory)
-			{
-				loc->hist.push_back(loc->val);
-			}
-			it++;
-		}
-	}
-
-	if (storeHistory)
-	{
-		deactvFrameStack.push_back(elimCount);
-	}
-
-	vbar->setMaximum(actvSrchList.size());
+	searchCandidates(RamSearchEngine::PREVIOUS_VALUE, cmpOp, 0);
 }
 //----------------------------------------------------------------------------
-void RamSearchDialog_t::SearchSpecificAddress(void)
+void RamSearchDialog_t::SearchSpecificValue(void)
 {
-	int elimCount = 0;
-	std::list<struct memoryLocation_t *>::iterator it;
-	memoryLocation_t *loc = NULL;
-	int64_t x = 0, y = 0, p = 0;
-	bool (*cmpFun)(int64_t x, int64_t y, int64_t p) = NULL;
-	bool storeHistory = !autoSearchCbox->isChecked();
-
-	switch (cmpOp)
-	{
-	case '<':
-		cmpFun = LessCmp;
-		break;
-	case '>':
-		cmpFun = MoreCmp;
-		break;
-	case '=':
-		cmpFun = EqualCmp;
-		break;
-	case '!':
-		cmpFun = UnequalCmp;
-		break;
-	case 'l':
-		cmpFun = LessEqualCmp;
-		break;
-	case 'm':
-		cmpFun = MoreEqualCmp;
-		break;
-	case 'd':
-		cmpFun = DiffByCmp;
-		p = getLineEditValue(diffByEdit);
-		break;
-	case '%':
-		cmpFun = ModIsCmp;
-		p = getLineEditValue(moduloEdit);
-		break;
-	default:
-		cmpFun = NULL;
-		break;
-	}
-
-	if (cmpFun == NULL)
-	{
-		return;
-	}
-	y = getLineEditValue(specAddrEdit);
-
-	//printf("Performing Specific Address Search Operation %zi: 'x %c 0x%llx' '%lli'  '0x%llx' \n", deactvFrameStack.size()+1, cmpOp,
-	//     (unsigned long long int)y, (long long int)p, (unsigned long long int)p );
-
-	it = actvSrchList.begin();
-
-	while (it != actvSrchList.end())
-	{
-		loc = *it;
-
-		x = loc->addr;
-
-		if (cmpFun(x, y, p) == false)
-		{
-			//printf("Eliminated Address: $%04X\n", loc->addr );
-			it = actvSrchList.erase(it);
-
-			if (storeHistory)
-			{
-				deactvSrchList.push_back(loc);
-				elimCount++;
-			}
-		}
-		else
-		{
-			if (storeHistory)
-			{
-				loc->hist.push_back(loc->val);
-			}
-			it++;
-		}
-	}
-
-	if (storeHistory)
-	{
-		deactvFrameStack.push_back(elimCount);
-	}
-
-	vbar->setMaximum(actvSrchList.size());
+	searchCandidates(RamSearchEngine::SPECIFIC_VALUE, cmpOp, getLineEditValue(specValEdit));
 }
 //----------------------------------------------------------------------------
-void RamSearchDialog_t::SearchNumberChanges(void)
+void RamSearchDialog_t::SearchSpecificAddress(void)
 {
-	int elimCount = 0;
-	std::list<struct memoryLocation_t *>::iterator it;
-	memoryLocation_t *loc = NULL;
-	int64_t x = 0, y = 0, p = 0;
-	bool (*cmpFun)(int64_t x, int64_t y, int64_t p) = NULL;
-	bool storeHistory = !autoSearchCbox->isChecked();
-
-	switch (cmpOp)
-	{
-	case '<':
-		cmpFun = LessCmp;
-		break;
-	case '>':
-		cmpFun = MoreCmp;
-		break;
-	case '=':
-		cmpFun = EqualCmp;
-		break;
-	case '!':
-		cmpFun = UnequalCmp;
-		break;
-	case 'l':
-		cmpFun = LessEqualCmp;
-		break;
-	case 'm':
-		cmpFun = MoreEqualCmp;
-		break;
-	case 'd':
-		cmpFun = DiffByCmp;
-		p = getLineEditValue(diffByEdit);
-		break;
-	case '%':
-		cmpFun = ModIsCmp;
-		p = getLineEditValue(moduloEdit);
-		break;
-	default:
-		cmpFun = NULL;
-		break;
-	}
-
-	if (cmpFun == NULL)
-	{
-		return;
-	}
-	y = getLineEditValue(numChangeEdit);
-
-	//printf("Performing Number of Changes Search Operation %zi: 'x %c 0x%llx' '%lli'  '0x%llx' \n", deactvFrameStack.size()+1, cmpOp,
-	//     (unsigned long long int)y, (long long int)p, (unsigned long long int)p );
-
-	it = actvSrchList.begin();
-
-	while (it != actvSrchList.end())
-	{
-		loc = *it;
-
-		x = loc->chgCount;
-
-		if (cmpFun(x, y, p) == false)
-		{
-			//printf("Eliminated Address: $%04X\n", loc->addr );
-			it = actvSrchList.erase(it);
-
-			if (storeHistory)
-			{
-				deactvSrchList.push_back(loc);
-				elimCount++;
-			}
-		}
-		else
-		{
-			if (storeHistory)
-			{
-				loc->hist.push_back(loc->val);
-			}
-			it++;
-		}
-	}
-
-	if (storeHistory)
-	{
-		deactvFrameStack.push_back(elimCount);
-	}
-
-	vbar->setMaximum(actvSrchList.size());
+	searchCandidates(RamSearchEngine::SPECIFIC_ADDRESS, cmpOp, getLineEditValue(specAddrEdit));
 }
 //----------------------------------------------------------------------------
-static unsigned int ReadValueAtHardwareAddress(int address, unsigned int size)
+void RamSearchDialog_t::SearchNumberChanges(void)
 {
-	unsigned int value = 0;
-	int maxAddr = ShowROM ? 0x10000 : 0x8000;
-
-	// read as little endian
-	for (unsigned int i = 0; i < size; i++)
-	{
-		if (address < maxAddr)
-		{
-			value <<= 8;
-			value |= lclMemBuf[address];
-			address++;
-		}
-	}
-	return value;
+	searchCandidates(RamSearchEngine::NUMBER_OF_CHANGES, cmpOp, getLineEditValue(numChangeEdit));
 }
 //----------------------------------------------------------------------------
 void RamSearchDialog_t::runSearch(void)
@@ -1132,7 +765,7 @@ void RamSearchDialog_t::runSearch(void)
 		SearchNumberChanges();
 	}
 
-	undoButton->setEnabled(deactvFrameStack.size() > 0);
+	undoButton->setEnabled(ramSrch.undoDepth() > 0);
 }
 //----------------------------------------------------------------------------
 void RamSearchDialog_t::copyRamToLocalBuffer(void)
@@ -1151,21 +784,7 @@ void RamSearchDialog_t::resetSearch(void)
 	copyRamToLocalBuffer();
 	FCEU_WRAPPER_UNLOCK();
 
-	actvSrchList.clear();
-	deactvSrchList.clear();
-	deactvFrameStack.clear();
-
-	for (unsigned int addr = 0; addr < 0x10000; addr++)
-	{
-		memLoc[addr].hist.clear();
-		memLoc[addr].addr = addr;
-		memLoc[addr].val.v8.u = lclMemBuf[addr];
-		memLoc[addr].val.v16.u = ReadValueAtHardwareAddress(addr, 2);
-		memLoc[addr].val.v32.u = ReadValueAtHardwareAddress(addr, 4);
-		memLoc[addr].elimMask = 0;
-		memLoc[addr].chgCount = 0;
-		memLoc[addr].hist.push_back(memLoc[addr].val);
-	}
+	ramSrch.reset(lclMemBuf);
 
 	calcRamList();
 
@@ -1174,143 +793,44 @@ void RamSearchDialog_t::resetSearch(void)
 //----------------------------------------------------------------------------
 void RamSearchDialog_t::undoSearch(void)
 {
-	int elimCount = 0;
-	memoryLocation_t *loc = NULL;
-	std::list<struct memoryLocation_t *>::iterator it;
-
-	if (deactvFrameStack.empty())
+	if (ramSrch.undoDepth() == 0)
 	{
 		printf("Error: UNDO Stack is empty\n");
 		return;
 	}
-	printf("UNDO Search Operation: %zi \n", deactvFrameStack.size());
-	// To Undo a search operation:
-	// 1. Loop through all current active values and revert previous value back to what it was before the search
-	// 2. Get the number of eliminated values from the deactivate search stack and tranfer those values back into the active search list.
-
-	it = actvSrchList.begin();
-
-	while (it != actvSrchList.end())
-	{
-		loc = *it;
+	printf("UNDO Search Operation: %zi \n", ramSrch.undoDepth());
 
-		if (!loc->hist.empty())
-		{
-			loc->hist.pop_back();
-		}
-		it++;
-	}
+	// Puts the addresses the search eliminated back and restores the
+	// previous values it was compared against.
+	ramSrch.undo();
 
-	elimCount = deactvFrameStack.back();
-	deactvFrameStack.pop_back();
+	vbar->setMaximum(ramSrch.size());
 
-	while (elimCount > 0)
-	{
-		if (deactvSrchList.empty())
-		{
-			printf("Error: Something went wrong with UNDO operation\n");
-			break;
-		}
-		loc = deactvSrchList.back();
-		deactvSrchList.pop_back();
-		actvSrchList.push_back(loc);
-		elimCount--;
-	}
-
-	sortActvMemList();
-
-	undoButton->setEnabled(deactvFrameStack.size() > 0);
+	undoButton->setEnabled(ramSrch.undoDepth() > 0);
 }
 //----------------------------------------------------------------------------
 void RamSearchDialog_t::clearChangeCounts(void)
 {
-	for (unsigned int addr = 0; addr < 0x10000; addr++)
-	{
-		memLoc[addr].chgCount = 0;
-	}
+	ramSrch.clearChangeCounts();
 }
 //----------------------------------------------------------------------------
 void RamSearchDialog_t::eliminateSelAddr(void)
 {
-	int elimCount = 0, op = '!';
-	std::list<struct memoryLocation_t *>::iterator it;
-	memoryLocation_t *loc = NULL;
-	int64_t x = 0, y = 0, p = 0;
-	bool (*cmpFun)(int64_t x, int64_t y, int64_t p) = NULL;
-
-	switch (op)
-	{
-	case '<':
-		cmpFun = LessCmp;
-		break;
-	case '>':
-		cmpFun = MoreCmp;
-		break;
-	case '=':
-		cmpFun = EqualCmp;
-		break;
-	case '!':
-		cmpFun = UnequalCmp;
-		break;
-	case 'l':
-		cmpFun = LessEqualCmp;
-		break;
-	case 'm':
-		cmpFun = MoreEqualCmp;
-		break;
-	case 'd':
-		cmpFun = DiffByCmp;
-		p = getLineEditValue(diffByEdit);
-		break;
-	case '%':
-		cmpFun = ModIsCmp;
-		p = getLineEditValue(moduloEdit);
-		break;
-	default:
-		cmpFun = NULL;
-		break;
-	}
-
-	if (cmpFun == NULL)
-	{
-		return;
-	}
-	y = ramView->getSelAddr();
+	int64_t y = ramView->getSelAddr();
 
 	if (y < 0)
 	{
 		return;
 	}
 
-	printf("Performing Eliminate Address Operation %zi: 'x %c 0x%llx' '%lli'  '0x%llx' \n", deactvFrameStack.size() + 1, cmpOp,
-		   (unsigned long long int)y, (long long int)p, (unsigned long long int)p);
-
-	it = actvSrchList.begin();
+	printf("Performing Eliminate Address Operation %zi: 'x %c 0x%llx' \n", ramSrch.undoDepth() + 1, '!',
+		   (unsigned long long int)y);
 
-	while (it != actvSrchList.end())
-	{
-		loc = *it;
+	setSearchFormat();
 
-		x = loc->addr;
+	ramSrch.search(RamSearchEngine::SPECIFIC_ADDRESS, '!', y, 0, true);
 
-		if (cmpFun(x, y, p) == false)
-		{
-			//printf("Eliminated Address: $%04X\n", loc->addr );
-			it = actvSrchList.erase(it);
-
-			deactvSrchList.push_back(loc);
-			elimCount++;
-		}
-		else
-		{
-			loc->hist.push_back(loc->val);
-			it++;
-		}
-	}
-
-	deactvFrameStack.push_back(elimCount);
-
-	vbar->setMaximum(actvSrchList.size());
+	vbar->setMaximum(ramSrch.size());
 }
 //----------------------------------------------------------------------------
 void RamSearchDialog_t::addCheatClicked(void)
@@ -1482,25 +1002,122 @@ void RamSearchDialog_t::ds4Clicked(void)
 //----------------------------------------------------------------------------
 void RamSearchDialog_t::signedTypeClicked(void)
 {
+	stopFrameSearch();
 	dpyType = 's';
 }
 //----------------------------------------------------------------------------
 void RamSearchDialog_t::unsignedTypeClicked(void)
 {
+	if (dpyType == 's')
+	{
+		stopFrameSearch();
+	}
 	dpyType = 'u';
 }
 //----------------------------------------------------------------------------
 void RamSearchDialog_t::hexTypeClicked(void)
 {
+	if (dpyType == 's')
+	{
+		stopFrameSearch();
+	}
 	dpyType = 'h';
 }
 //----------------------------------------------------------------------------
+void RamSearchDialog_t::frameSrchPredChanged(int index)
+{
+	if ((index < 0) || (index >= (int)(sizeof(framePredicates) / sizeof(framePredicates[0]))))
+	{
+		return;
+	}
+	frameSrchValEdit->setEnabled(framePredicates[index].hasValue);
+	frameSrchBtnBox->setEnabled(framePredicates[index].hasButton);
+}
+//----------------------------------------------------------------------------
+void RamSearchDialog_t::frameSearchClicked(void)
+{
+	RamSearchEngine::framePredicate_t pred;
+	int idx = frameSrchPredBox->currentIndex();
+
+	if (frameSrchRunning)
+	{
+		stopFrameSearch();
+		return;
+	}
+	if ((idx < 0) || (idx >= (int)(sizeof(framePredicates) / sizeof(framePredicates[0]))))
+	{
+		return;
+	}
+	pred.op = framePredicates[idx].op;
+	pred.idleOp = framePredicates[idx].idleOp;
+	pred.p = framePredicates[idx].hasValue ? getLineEditValue(frameSrchValEdit) : 0;
+	pred.inputMask = framePredicates[idx].hasButton ? frameSrchBtnBox->currentData().toUInt() : 0;
+	pred.numFrames = getLineEditValue(frameSrchCountEdit);
+
+	if (pred.numFrames < 0)
+	{
+		pred.numFrames = 0;
+	}
+
+	FCEU_WRAPPER_LOCK();
+	setSearchFormat();
+	ramSrch.beginFrameSearch(pred, true);
+	FCEU_WRAPPER_UNLOCK();
+
+	frameSrchRunning = true;
+
+	frameSrchButton->setText(tr("Stop"));
+	searchButton->setEnabled(false);
+	resetButton->setEnabled(false);
+	undoButton->setEnabled(false);
+	elimButton->setEnabled(false);
+}
+//----------------------------------------------------------------------------
+void RamSearchDialog_t::stopFrameSearch(void)
+{
+	if (!frameSrchRunning)
+	{
+		return;
+	}
+	FCEU_WRAPPER_LOCK();
+	ramSrch.endFrameSearch();
+	FCEU_WRAPPER_UNLOCK();
+
+	frameSearchEnded();
+}
+//----------------------------------------------------------------------------
+void RamSearchDialog_t::frameSearchEnded(void)
+{
+	frameSrchRunning = false;
+
+	frameSrchButton->setText(tr("Start"));
+	searchButton->setEnabled(true);
+	resetButton->setEnabled(true);
+	undoButton->setEnabled(ramSrch.undoDepth() > 0);
+
+	vbar->setMaximum(ramSrch.size());
+}
+//----------------------------------------------------------------------------
+void ramSearchFrameUpdate(void)
+{
+	if ((ramSearchWin == NULL) || !ramSrch.frameSearchActive())
+	{
+		return;
+	}
+	for (unsigned int addr = 0; addr < 0x10000; addr++)
+	{
+		frameMemBuf[addr] = GetMem(addr);
+	}
+	ramSrch.frameSearch(frameMemBuf, GetGamepadPressedImmediate());
+}
+//----------------------------------------------------------------------------
 void RamSearchDialog_t::calcRamList(void)
 {
-	int i, addr, startAddr, endAddr;
 	int numRegions = 0, dataSize = 1;
 	int regionStart[5], regionEnd[5];
 
+	stopFrameSearch();
+
 	if ( ShowRAM )
 	{
 		regionStart[ numRegions ] = 0x0000;		
@@ -1539,91 +1156,18 @@ void RamSearchDialog_t::calcRamList(void)
 		dataSize = 1;
 	}
 
-	actvSrchList.clear();
+	setSearchFormat();
 
-	for (i=0; i<numRegions; i++)
-	{
-		startAddr = regionStart[i];
-		  endAddr = regionEnd[i];
+	ramSrch.setCandidates(regionStart, regionEnd, numRegions, dataSize);
 
-		for (addr = startAddr; addr < endAddr; addr += dataSize)
-		{
-			switch (dpySize)
-			{
-			case 'd':
-				if ((addr + 3) < endAddr)
-				{
-					if ((memLoc[addr].elimMask == 0) &&
-						(memLoc[addr + 1].elimMask == 0) &&
-						(memLoc[addr + 2].elimMask == 0) &&
-						(memLoc[addr + 3].elimMask == 0))
-					{
-						actvSrchList.push_back(&memLoc[addr]);
-					}
-				}
-				break;
-			case 'w':
-				if ((addr + 1) < endAddr)
-				{
-					if ((memLoc[addr].elimMask == 0) &&
-						(memLoc[addr + 1].elimMask == 0))
-					{
-						actvSrchList.push_back(&memLoc[addr]);
-					}
-				}
-				break;
-			default:
-			case 'b':
-				if (memLoc[addr].elimMask == 0)
-				{
-					actvSrchList.push_back(&memLoc[addr]);
-				}
-				break;
-			}
-		}
-	}
-	vbar->setMaximum(actvSrchList.size());
+	vbar->setMaximum(ramSrch.size());
 }
 //----------------------------------------------------------------------------
 void RamSearchDialog_t::updateRamValues(void)
 {
-	std::list<struct memoryLocation_t *>::iterator it;
-	memoryLocation_t *loc = NULL;
-	memoryState_t val;
+	setSearchFormat();
 
-	for (it = actvSrchList.begin(); it != actvSrchList.end(); it++)
-	{
-		loc = *it;
-
-		val.v8.u = lclMemBuf[loc->addr];
-		val.v16.u = ReadValueAtHardwareAddress(loc->addr, 2);
-		val.v32.u = ReadValueAtHardwareAddress(loc->addr, 4);
-
-		if (dpySize == 'd')
-		{
-			if (memLoc[loc->addr].val.v32.u != val.v32.u)
-			{
-				memLoc[loc->addr].val = val;
-				memLoc[loc->addr].chgCount++;
-			}
-		}
-		else if (dpySize == 'w')
-		{
-			if (memLoc[loc->addr].val.v16.u != val.v16.u)
-			{
-				memLoc[loc->addr].val = val;
-				memLoc[loc->addr].chgCount++;
-			}
-		}
-		else
-		{
-			if (memLoc[loc->addr].val.v8.u != val.v8.u)
-			{
-				memLoc[loc->addr].val = val;
-				memLoc[loc->addr].chgCount++;
-			}
-		}
-	}
+	ramSrch.update(lclMemBuf);
 }
 //----------------------------------------------------------------------------
 QRamSearchView::QRamSearchView(QWidget *parent)
@@ -1778,9 +1322,9 @@ void QRamSearchView::keyPressEvent(QKeyEvent *event)
 		selAddr = -1;
 		selLine++;
 
-		if ( static_cast<size_t>(selLine) >= actvSrchList.size())
+		if ( static_cast<size_t>(selLine) >= ramSrch.size())
 		{
-			selLine = actvSrchList.size() - 1;
+			selLine = ramSrch.size() - 1;
 		}
 
 		if (selLine >= (lineOffset + viewLines))
@@ -1897,13 +1441,19 @@ void QRamSearchView::wheelEvent(QWheelEvent *event)
 void QRamSearchView::paintEvent(QPaintEvent *event)
 {
 	int i, x, y, row, nrow;
-	std::list<struct memoryLocation_t *>::iterator it;
+	size_t idx;
 	char addrStr[32], valStr[32], prevStr[32], chgStr[32];
 	QPainter painter(this);
-	memoryLocation_t *loc = NULL;
+	int addr;
+	int64_t val, prev;
 	int fieldWidth, fieldPad[4], fieldLen[4], fieldStart[4];
 	const char *fieldText[4];
 
+	// the emulator thread filters the candidates during a frame search
+	if (frameSrchRunning)
+	{
+		FCEU_WRAPPER_LOCK();
+	}
 	painter.setFont(font);
 	viewWidth = event->rect().width();
 	viewHeight = event->rect().height();
@@ -1921,7 +1471,7 @@ void QRamSearchView::paintEvent(QPaintEvent *event)
 
 	viewLines = nrow;
 
-	maxLineOffset = actvSrchList.size() - nrow;
+	maxLineOffset = ramSrch.size() - nrow;
 
 	if (maxLineOffset < 1)
 		maxLineOffset = 1;
@@ -1941,17 +1491,9 @@ void QRamSearchView::paintEvent(QPaintEvent *event)
 		vbar->setValue(0);
 	}
 
-	i = 0;
-	it = actvSrchList.begin();
-	while (it != actvSrchList.end())
-	{
-		if (i == lineOffset)
-		{
-			break;
-		}
-		i++;
-		it++;
-	}
+	idx = lineOffset;
+
+	setSearchFormat();
 
 	painter.fillRect(0, 0, viewWidth, viewHeight, this->palette().color(QPalette::Window));
 
@@ -1985,90 +1527,86 @@ void QRamSearchView::paintEvent(QPaintEvent *event)
 
 	for (row = 0; row < nrow; row++)
 	{
-		if (it != actvSrchList.end())
-		{
-			loc = *it;
-		}
-		else
-		{
-			loc = NULL;
-		}
-
-		if (loc == NULL)
+		if (idx >= ramSrch.size())
 		{
 			continue;
 		}
+		addr = ramSrch.address(idx);
+
 		if (selLine >= 0)
 		{
 			if (selLine == (lineOffset + row))
 			{
-				selAddr = loc->addr;
+				selAddr = addr;
 			}
 		}
-		it++;
+		idx++;
 
-		if (selAddr == loc->addr)
+		if (selAddr == addr)
 		{
 			painter.fillRect(0, y - pxLineSpacing + pxLineLead, viewWidth, pxLineSpacing, QColor("light blue"));
 		}
 
-		snprintf(addrStr, sizeof(addrStr), "$%04X", loc->addr);
+		snprintf(addrStr, sizeof(addrStr), "$%04X", addr);
+
+		val  = ramSrch.value(addr);
+		prev = ramSrch.previous(addr);
 
 		if (dpySize == 'd')
 		{
 			if (dpyType == 'h')
 			{
-				snprintf(valStr, sizeof(valStr), "0x%08X", loc->val.v32.u);
-				snprintf(prevStr, sizeof(prevStr), "0x%08X", loc->hist.back().v32.u);
+				snprintf(valStr, sizeof(valStr), "0x%08X", (uint32_t)val);
+				snprintf(prevStr, sizeof(prevStr), "0x%08X", (uint32_t)prev);
 			}
 			else if (dpyType == 'u')
 			{
-				snprintf(valStr, sizeof(valStr), "%u", loc->val.v32.u);
-				snprintf(prevStr, sizeof(prevStr), "%u", loc->hist.back().v32.u);
+				snprintf(valStr, sizeof(valStr), "%u", (uint32_t)val);
+				snprintf(prevStr, sizeof(prevStr), "%u", (uint32_t)prev);
 			}
 			else
 			{
-				snprintf(valStr, sizeof(valStr), "%i", loc->val.v32.i);
-				snprintf(prevStr, sizeof(prevStr), "%i", loc->hist.back().v32.i);
+				snprintf(valStr, sizeof(valStr), "%i", (int32_t)val);
+				snprintf(prevStr, sizeof(prevStr), "%i", (int32_t)prev);
 			}
 		}
 		else if (dpySize == 'w')
 		{
 			if (dpyType == 'h')
 			{
-				snprintf(valStr, sizeof(valStr), "0x%04X", loc->val.v16.u);
-				snprintf(prevStr, sizeof(prevStr), "0x%04X", loc->hist.back().v16.u);
+				snprintf(valStr, sizeof(valStr), "0x%04X", (uint16_t)val);
+				snprintf(prevStr, sizeof(prevStr), "0x%04X", (uint16_t)prev);
 			}
 			else if (dpyType == 'u')
 			{
-				snprintf(valStr, sizeof(valStr), "%u", loc->val.v16.u);
-				snprintf(prevStr, sizeof(prevStr), "%u", loc->hist.back().v16.u);
+				snprintf(valStr, sizeof(valStr), "%u", (uint16_t)val);
+				snprintf(prevStr, sizeof(prevStr), "%u", (uint16_t)prev);
 			}
 			else
 			{
-				snprintf(valStr, sizeof(valStr), "%i", loc->val.v16.i);
-				snprintf(prevStr, sizeof(prevStr), "%i", loc->hist.back().v16.i);
+				snprintf(valStr, sizeof(valStr), "%i", (int16_t)val);
+				snprintf(prevStr, sizeof(prevStr), "%i", (int16_t)prev);
 			}
 		}
 		else
 		{
 			if (dpyType == 'h')
 			{
-				snprintf(valStr, sizeof(valStr), "0x%02X", loc->val.v8.u);
-				snprintf(prevStr, sizeof(prevStr), "0x%02X", loc->hist.back().v8.u);
+				snprintf(valStr, sizeof(valStr), "0x%02X", (uint8_t)val);
+				snprintf(prevStr, sizeof(prevStr), "0x%02X", (uint8_t)prev);
 			}
 			else if (dpyType == 'u')
 			{
-				snprintf(valStr, sizeof(valStr), "%u", loc->val.v8.u);
-				snprintf(prevStr, sizeof(prevStr), "%u", loc->hist.back().v8.u);
+				snprintf(valStr, sizeof(valStr), "%u", (uint8_t)val);
+				snprintf(prevStr, sizeof(prevStr), "%u", (uint8_t)prev);
 			}
 			else
 			{
-				snprintf(valStr, sizeof(valStr), "%i", loc->val.v8.i);
-				snprintf(prevStr, sizeof(prevStr), "%i", loc->hist.back().v8.i);
+				snprintf(valStr, sizeof(valStr), "%i", (int8_t)val);
+				snprintf(prevStr, sizeof(prevStr), "%i", (int8_t)prev);
 			}
 		}
-		snprintf(chgStr, sizeof(chgStr), "%u", loc->chgCount);
+		snprintf(chgStr, sizeof(chgStr), "%u", ramSrch.changes(addr));
 
 		for (i = 0; i < 4; i++)
 		{
@@ -2086,5 +1624,10 @@ void QRamSearchView::paintEvent(QPaintEvent *event)
 	painter.drawLine(x + fieldStart[1], 0, x + fieldStart[1], viewHeight);
 	painter.drawLine(x + fieldStart[2], 0, x + fieldStart[2], viewHeight);
 	painter.drawLine(x + fieldStart[3], 0, x + fieldStart[3], viewHeight);
+
+	if (frameSrchRunning)
+	{
+		FCEU_WRAPPER_UNLOCK();
+	}
 }
 //----------------------------------------------------------------------------
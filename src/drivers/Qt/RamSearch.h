@@ -122,6 +122,12 @@ class RamSearchDialog_t : public QDialog
 		QCheckBox    *misalignedCbox;
 		QCheckBox    *autoSearchCbox;
 
+		QComboBox    *frameSrchPredBox;
+		QComboBox    *frameSrchBtnBox;
+		QLineEdit    *frameSrchValEdit;
+		QLineEdit    *frameSrchCountEdit;
+		QPushButton  *frameSrchButton;
+
 		int  fontCharWidth;
 		int  frameCounterLastPass;
 		unsigned int cycleCounter;
@@ -130,11 +136,14 @@ class RamSearchDialog_t : public QDialog
 	private:
 		void updateRamValues(void);
 		void calcRamList(void);
+		void searchCandidates(int kind, int op, int64_t y);
 		void SearchRelative(void);
 		void SearchSpecificValue(void);
 		void SearchSpecificAddress(void);
 		void SearchNumberChanges(void);
 		void copyRamToLocalBuffer(void);
+		void stopFrameSearch(void);
+		void frameSearchEnded(void);
 
 	public slots:
 		void closeWindow(void);
@@ -172,7 +181,13 @@ class RamSearchDialog_t : public QDialog
 		void svBtnClicked(void);
 		void saBtnClicked(void);
 		void ncBtnClicked(void);
+		void frameSrchPredChanged(int index);
+		void frameSearchClicked(void);
 
 };
 
 void openRamSearchWindow(QWidget *parent);
+
+// Runs the frame search of the RAM search window, if one is going. Called
+// by the emulator thread after each frame with the emulator mutex held.
+void ramSearchFrameUpdate(void);
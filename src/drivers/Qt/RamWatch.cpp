@@ -25,6 +25,8 @@
 #include <string.h>
 #include <ctype.h>
 #include <string>
+#include <atomic>
+#include <vector>
 
 #include <SDL.h>
 #include <QMenuBar>
@@ -52,9 +54,104 @@
 #include "Qt/RamWatch.h"
 #include "Qt/CheatsConf.h"
 #include "Qt/ConsoleUtilities.h"
+#include "Qt/FrameDispatcher.h"
 
 ramWatchList_t ramWatchList;
 static RamWatchDialog_t *ramWatchMainWin = NULL;
+
+// The watched bytes of a frame. The emulator thread fills one snapshot per
+// frame and hands it over through a triple buffer: it writes the back
+// buffer and swaps it with the middle one, the GUI swaps the middle one
+// with its front buffer when it holds a newer frame. Neither side waits
+// on the other, and the GUI reads every watch of a frame in one go.
+struct ramWatchSnapshot_t
+{
+	unsigned int gen;            // address list the bytes were sampled for
+	std::vector<uint8_t> bytes;  // one per address of the list
+};
+#define SNAPSHOT_NEW  0x04
+
+static ramWatchSnapshot_t watchSnap[3];
+static std::atomic<int> watchSnapMiddle(1);
+static int watchSnapBack  = 0;  // emulator thread only
+static int watchSnapFront = 2;  // GUI thread only
+
+// Addresses to sample, changed under the emulator mutex by the GUI
+static std::vector<int> watchAddrList;
+static unsigned int watchAddrGen = 0;
+
+// GUI side copy of the list and the index of every watch's first byte in it
+static std::vector<int> guiAddrList;
+static std::vector<int> guiWatchOfs;
+//----------------------------------------------------------------------------
+void ramWatchFrameUpdate(void)
+{
+	if ( watchAddrList.empty() )
+	{
+		return;
+	}
+	ramWatchSnapshot_t &snap = watchSnap[ watchSnapBack ];
+
+	snap.gen = watchAddrGen;
+	snap.bytes.resize( watchAddrList.size() );
+
+	for (size_t i=0; i<watchAddrList.size(); i++)
+	{
+		snap.bytes[i] = GetMem( watchAddrList[i] );
+	}
+	watchSnapBack = watchSnapMiddle.exchange( watchSnapBack | SNAPSHOT_NEW ) & ~SNAPSHOT_NEW;
+}
+//----------------------------------------------------------------------------
+// Rebuilds the address list from the watch list, passing it to the
+// emulator thread when it changed
+static void updateWatchAddrList( bool enable )
+{
+	std::list < ramWatch_t * >::iterator it;
+	std::vector<int> addrList;
+
+	guiWatchOfs.clear();
+
+	for (it = ramWatchList.ls.begin (); it != ramWatchList.ls.end (); it++)
+	{
+		ramWatch_t *rw = *it;
+
+		guiWatchOfs.push_back( addrList.size() );
+
+		if ( enable && !rw->isSep && (rw->addr >= 0) )
+		{
+			for (int i=0; i<rw->size; i++)
+			{
+				addrList.push_back( rw->addr + i );
+			}
+		}
+	}
+
+	if ( addrList != guiAddrList )
+	{
+		guiAddrList = addrList;
+
+		FCEU_WRAPPER_LOCK();
+		watchAddrList = addrList;
+		watchAddrGen++;
+		FCEU_WRAPPER_UNLOCK();
+	}
+}
+//----------------------------------------------------------------------------
+// Newest snapshot taken for the current address list, NULL if there is none
+static const ramWatchSnapshot_t *getWatchSnapshot(void)
+{
+	if ( watchSnapMiddle.load() & SNAPSHOT_NEW )
+	{
+		watchSnapFront = watchSnapMiddle.exchange( watchSnapFront ) & ~SNAPSHOT_NEW;
+	}
+	const ramWatchSnapshot_t &snap = watchSnap[ watchSnapFront ];
+
+	if ( (snap.gen != watchAddrGen) || (snap.bytes.size() != guiAddrList.size()) )
+	{
+		return NULL;
+	}
+	return &snap;
+}
 //----------------------------------------------------------------------------
 void openRamWatchWindow( QWidget *parent, int force )
 {
@@ -220,6 +317,16 @@ RamWatchDialog_t::RamWatchDialog_t(QWidget *parent)
 	
 	watchMenu->addAction(menuAct);
 
+	watchMenu->addSeparator();
+
+	// Watch -> Last Writers
+	menuAct = new QAction(tr("&Last Writers"), this);
+	menuAct->setShortcut( QKeySequence(tr("L")) );
+	menuAct->setStatusTip(tr("Show the last writes to the watch kept in the write journal"));
+	connect(menuAct, SIGNAL(triggered()), this, SLOT(lastWritersClicked(void)) );
+	
+	watchMenu->addAction(menuAct);
+
 	//-----------------------------------------------------------------------
 	// End Menu
 	//-----------------------------------------------------------------------
@@ -301,11 +408,7 @@ RamWatchDialog_t::RamWatchDialog_t(QWidget *parent)
 
 	ramWatchMainWin = this;
 
-	updateTimer  = new QTimer( this );
-
-	connect( updateTimer, &QTimer::timeout, this, &RamWatchDialog_t::periodicUpdate );
-
-	updateTimer->start( 100 ); // 10hz
+	FrameDispatcher::instance()->addView( this, 100, [this]{ periodicUpdate(); } ); // 10hz
 
 	restoreGeometry(settings.value("ramWatch/geometry").toByteArray());
 }
@@ -314,11 +417,14 @@ RamWatchDialog_t::~RamWatchDialog_t(void)
 {
 	QSettings settings;
 
-	updateTimer->stop();
+	FrameDispatcher::instance()->removeView( this );
 
 	if ( ramWatchMainWin == this )
 	{
 	   ramWatchMainWin = NULL;
+
+	   // stop sampling
+	   updateWatchAddrList( false );
 	}
 	settings.setValue("ramWatch/geometry", saveGeometry());
 
@@ -376,10 +482,16 @@ void RamWatchDialog_t::updateRamWatchDisplay(void)
 	int idx=0;
 	QTreeWidgetItem *item;
 	std::list < ramWatch_t * >::iterator it;
+	rowCache_t *rowCacheEntry;
 	FCEU::FixedString<32> addrStr;
 	FCEU::FixedString<16> valStr1, valStr2;
+	const ramWatchSnapshot_t *snap;
 	ramWatch_t *rw;
 
+	updateWatchAddrList( true );
+
+	snap = getWatchSnapshot();
+
 	for (it = ramWatchList.ls.begin (); it != ramWatchList.ls.end (); it++)
 	{
 		rw = *it;
@@ -396,7 +508,51 @@ void RamWatchDialog_t::updateRamWatchDisplay(void)
 			item->setFont( 1, font);
 			item->setFont( 2, font);
 			item->setFont( 3, font);
+
+			if ( (size_t)idx < rowCache.size() )
+			{
+				rowCache[idx].rw = NULL;
+			}
 		}
+
+		if ( rw->isSep || (rw->addr < 0) )
+		{
+			// nothing to read
+		}
+		else if ( snap != NULL )
+		{
+			rw->updateMem( &snap->bytes[ guiWatchOfs[idx] ] );
+		}
+		else
+		{
+			// no frame sampled for this list yet
+			rw->updateMem ();
+		}
+
+		if ( (size_t)idx >= rowCache.size() )
+		{
+			rowCache.resize( idx + 1 );
+			rowCache[idx].rw = NULL;
+		}
+		rowCacheEntry = &rowCache[idx];
+
+		if ( (rowCacheEntry->rw == rw) && (rowCacheEntry->addr == rw->addr) &&
+		     (rowCacheEntry->size == rw->size) && (rowCacheEntry->type == rw->type) &&
+		     (rowCacheEntry->isSep == rw->isSep) && (rowCacheEntry->val == rw->val.u32) &&
+		     (rowCacheEntry->name == rw->name) )
+		{
+			// row shows this already
+			idx++;
+			continue;
+		}
+		rowCacheEntry->rw    = rw;
+		rowCacheEntry->addr  = rw->addr;
+		rowCacheEntry->size  = rw->size;
+		rowCacheEntry->type  = rw->type;
+		rowCacheEntry->isSep = rw->isSep;
+		rowCacheEntry->val   = rw->val.u32;
+		rowCacheEntry->name  = rw->name;
+
 		if ( rw->isSep || (rw->addr < 0) )
 		{
 			addrStr = "--------";
@@ -413,8 +569,6 @@ void RamWatchDialog_t::updateRamWatchDisplay(void)
 			}
 		}
 
-		rw->updateMem ();
-
 		if ( rw->isSep || (rw->addr < 0) )
 		{
 			valStr1 = valStr2 = "--------";
@@ -508,7 +662,10 @@ void RamWatchDialog_t::updateRamWatchDisplay(void)
 
 		idx++;
 	}
-	tree->viewport()->update();
+	if ( rowCache.size() > (size_t)idx )
+	{
+		rowCache.resize( idx );
+	}
 }
 //----------------------------------------------------------------------------
 void 	RamWatchDialog_t::watchClicked( QTreeWidgetItem *item, int column)
@@ -744,6 +901,25 @@ void ramWatch_t::updateMem (void)
 		val.u32 |= GetMem (addr    ) << 24;
 	}
 }
+//----------------------------------------------------------------------------
+void ramWatch_t::updateMem (const uint8_t *bytes)
+{
+	if (size == 1)
+	{
+		val.u8 = bytes[0];
+	}
+	else if (size == 2)
+	{
+		val.u16 = (bytes[0] << 8) | bytes[1];
+	}
+	else if (size == 4)
+	{
+		val.u32  = bytes[3];
+		val.u32 |= bytes[2] << 8;
+		val.u32 |= bytes[1] << 16;
+		val.u32 |= bytes[0] << 24;
+	}
+}
 //------------------------------------------------------------------------.----
 void RamWatchDialog_t::openWatchEditWindow( ramWatch_t *rw, int mode)
 {
@@ -952,6 +1128,31 @@ void RamWatchDialog_t::addCheatClicked(void)
 	}
 }
 //----------------------------------------------------------------------------
+void RamWatchDialog_t::lastWritersClicked(void)
+{
+	ramWatch_t *rw = NULL;
+	QTreeWidgetItem *item;
+
+	item = tree->currentItem();
+
+	if ( item == NULL )
+	{
+		printf( "No Item Selected\n");
+		return;
+	}
+	int row = tree->indexOfTopLevelItem(item);
+
+	if ( row >= 0 )
+	{
+		rw = ramWatchList.getIndex(row);
+	}
+
+	if ( (rw != NULL) && !rw->isSep )
+	{
+		fceuShowLastWriters( this, rw->addr );
+	}
+}
+//----------------------------------------------------------------------------
 void RamWatchDialog_t::newWatchClicked(void)
 {
 	openWatchEditWindow();
@@ -4,6 +4,8 @@
 #pragma once
 
 #include <list>
+#include <string>
+#include <vector>
 #include <QWidget>
 #include <QDialog>
 #include <QVBoxLayout>
@@ -47,6 +49,9 @@ struct ramWatch_t
 	};
 
 	void updateMem (void);
+
+	// Same as updateMem, from the size bytes of the value
+	void updateMem (const uint8_t *bytes);
 };
 
 struct ramWatchList_t
@@ -220,10 +225,22 @@ class RamWatchDialog_t : public QDialog
 		QPushButton *dup_btn;
 		QPushButton *sep_btn;
 		QPushButton *cht_btn;
-		QTimer      *updateTimer;
 
 		std::string  saveFileName;
 
+		// what each tree row shows, to only update rows that changed
+		struct rowCache_t
+		{
+			ramWatch_t *rw;
+			int  addr;
+			int  size;
+			int  type;
+			int  isSep;
+			uint32_t val;
+			std::string name;
+		};
+		std::vector<rowCache_t> rowCache;
+
 		//ramWatchList_t ramWatchList;
 
 		int  fontCharWidth;
@@ -242,6 +259,7 @@ class RamWatchDialog_t : public QDialog
 		void appendListCB(void);
 		void periodicUpdate(void);
 		void addCheatClicked(void);
+		void lastWritersClicked(void);
 		void newWatchClicked(void);
 		void sepWatchClicked(void);
 		void dupWatchClicked(void);
@@ -256,3 +274,8 @@ class RamWatchDialog_t : public QDialog
 extern ramWatchList_t ramWatchList;
 
 void openRamWatchWindow( QWidget *parent, int force = 0 );
+
+// Samples the watched addresses into the snapshot the RAM watch windows
+// read. Called by the emulator thread after each frame with the emulator
+// mutex held.
+void ramWatchFrameUpdate(void);
@@ -7,6 +7,7 @@
 #include <exception>
 #include "CommandQueue_fwd.h"
 #include "RestApiCommands.h"
+#include "RouteMetrics.h"
 
 /**
  * @brief Execute a command with automatic exception handling
@@ -26,15 +27,23 @@ template<typename T>
 std::future<T> executeCommand(std::unique_ptr<ApiCommandWithResult<T>> cmd, 
                               unsigned int timeoutMs = 5000) {
     auto future = cmd->getResult();
+    RouteMetrics* metrics = routeMetricsCurrent();
+
+    cmd->routeMetrics = metrics;
+    cmd->queuedAt = std::chrono::steady_clock::now();
     
     // Submit to queue
     if (!getRestApiCommandQueue().push(std::move(cmd))) {
         // Queue is full - set exception on the promise
+        if (metrics) {
+            metrics->queueFull.fetch_add(1, std::memory_order_relaxed);
+        }
         std::promise<T> errorPromise;
         errorPromise.set_exception(std::make_exception_ptr(
             std::runtime_error("Command queue is full")));
         return errorPromise.get_future();
     }
+    notifyRestApiCommandPushed();
     
     return future;
 }
@@ -47,15 +56,23 @@ std::future<T> executeCommand(std::unique_ptr<ApiCommandWithResult<T>> cmd,
 inline std::future<void> executeCommand(std::unique_ptr<ApiCommandVoid> cmd,
                                         unsigned int timeoutMs = 5000) {
     auto future = cmd->getResult();
+    RouteMetrics* metrics = routeMetricsCurrent();
+
+    cmd->routeMetrics = metrics;
+    cmd->queuedAt = std::chrono::steady_clock::now();
     
     // Submit to queue
     if (!getRestApiCommandQueue().push(std::move(cmd))) {
         // Queue is full - set exception on the promise
+        if (metrics) {
+            metrics->queueFull.fetch_add(1, std::memory_order_relaxed);
+        }
         std::promise<void> errorPromise;
         errorPromise.set_exception(std::make_exception_ptr(
             std::runtime_error("Command queue is full")));
         return errorPromise.get_future();
     }
+    notifyRestApiCommandPushed();
     
     return future;
 }
@@ -78,8 +95,12 @@ T waitForResult(std::future<T>& future, unsigned int timeoutMs = 5000) {
     auto status = future.wait_for(std::chrono::milliseconds(timeoutMs));
     
     if (status == std::future_status::timeout) {
+        if (RouteMetrics* metrics = routeMetricsCurrent()) {
+            metrics->timeouts.fetch_add(1, std::memory_order_relaxed);
+        }
         throw std::runtime_error("Command execution timeout");
     }
+    routeMetricsResultReady();
     
     // This will re-throw any exception set by the command
     return future.get();
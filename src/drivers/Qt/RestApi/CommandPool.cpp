@@ -0,0 +1,58 @@
+#include "CommandPool.h"
+#include <new>
+#include <thread>
+
+constexpr size_t CommandPool::BLOCK_SIZE;
+constexpr size_t CommandPool::DEFAULT_BLOCK_COUNT;
+
+CommandPool& CommandPool::instance() {
+    static CommandPool* pool = new CommandPool();
+    return *pool;
+}
+
+CommandPool::CommandPool(size_t blockCount)
+    : slab(static_cast<unsigned char*>(::operator new(blockCount * BLOCK_SIZE))),
+      numBlocks(blockCount),
+      freeBlocks(blockCount),
+      inUse(0),
+      fallbacks(0) {
+    for (size_t i = 0; i < numBlocks; i++) {
+        freeBlocks.tryPush(static_cast<uint32_t>(i));
+    }
+}
+
+CommandPool::~CommandPool() {
+    ::operator delete(slab);
+}
+
+void* CommandPool::allocate(size_t size) {
+    uint32_t index;
+
+    if ((size <= BLOCK_SIZE) && freeBlocks.tryPop(index)) {
+        inUse.fetch_add(1, std::memory_order_relaxed);
+        return slab + static_cast<size_t>(index) * BLOCK_SIZE;
+    }
+
+    fallbacks.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(size);
+}
+
+void CommandPool::release(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    if (!owns(ptr)) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    uint32_t index = static_cast<uint32_t>(
+        (static_cast<unsigned char*>(ptr) - slab) / BLOCK_SIZE);
+
+    // The ring has a cell for every block, a failed push only means another
+    // thread is still finishing its pop of the cell we landed on.
+    while (!freeBlocks.tryPush(index)) {
+        std::this_thread::yield();
+    }
+    inUse.fetch_sub(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,79 @@
+#ifndef __COMMAND_POOL_H__
+#define __COMMAND_POOL_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "Utils/BoundedRing.h"
+
+/**
+ * @brief Fixed-size block pool backing ApiCommand allocations
+ *
+ * REST handlers create a command per request on the server threads and the
+ * emulator thread destroys it after execution. Routing those allocations
+ * through a preallocated slab keeps the global heap (and its lock) out of
+ * the per-frame command path. The free list is a lock-free BoundedRing of
+ * block indices, so any thread can allocate or release.
+ *
+ * Objects larger than BLOCK_SIZE, or requests made while every block is in
+ * use, fall back to the global operator new.
+ */
+class CommandPool {
+public:
+    static constexpr size_t BLOCK_SIZE = 256;
+    static constexpr size_t DEFAULT_BLOCK_COUNT = 1024;
+
+    /**
+     * @brief Process wide pool used by ApiCommand
+     *
+     * Never destroyed, commands may still be released by static
+     * destructors at exit.
+     */
+    static CommandPool& instance();
+
+    explicit CommandPool(size_t blockCount = DEFAULT_BLOCK_COUNT);
+    ~CommandPool();
+
+    CommandPool(const CommandPool&) = delete;
+    CommandPool& operator=(const CommandPool&) = delete;
+
+    /**
+     * @brief Allocate storage for an object of the given size
+     * @throws std::bad_alloc if the fallback allocation fails
+     */
+    void* allocate(size_t size);
+
+    /**
+     * @brief Return storage obtained from allocate()
+     */
+    void release(void* ptr);
+
+    /**
+     * @brief Number of blocks in the slab
+     */
+    size_t blockCount() const { return numBlocks; }
+
+    /**
+     * @brief Number of blocks currently handed out
+     */
+    size_t blocksInUse() const { return inUse.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Number of allocations that could not be served by the slab
+     */
+    uint64_t fallbackAllocations() const { return fallbacks.load(std::memory_order_relaxed); }
+
+private:
+    unsigned char* slab;
+    size_t numBlocks;
+    BoundedRing<uint32_t> freeBlocks;
+    std::atomic<size_t> inUse;
+    std::atomic<uint64_t> fallbacks;
+
+    bool owns(const void* ptr) const {
+        const unsigned char* p = static_cast<const unsigned char*>(ptr);
+        return (p >= slab) && (p < slab + numBlocks * BLOCK_SIZE);
+    }
+};
+
+#endif // __COMMAND_POOL_H__
@@ -1,9 +1,16 @@
 #include "CommandQueue.h"
 #include "RestApiCommands.h"
+#include <stdexcept>
+#include <thread>
 #include <utility>
 
-CommandQueue::CommandQueue(size_t maxSize) 
-    : maxQueueSize(maxSize) {
+CommandQueue::CommandQueue(size_t maxSize)
+    : ring(maxSize),
+      maxQueueSize(maxSize),
+      depth(0),
+      highWater(0),
+      pushedCount(0),
+      rejectedCount(0) {
 }
 
 CommandQueue::~CommandQueue() {
@@ -15,52 +22,61 @@ bool CommandQueue::push(std::unique_ptr<ApiCommand> cmd) {
     if (!cmd) {
         return false;  // Null command
     }
-    
-    FCEU::autoScopedLock lock(queueMutex);
-    
-    // Check if queue is full
-    if (commands.size() >= maxQueueSize) {
+
+    // Reserve a place first, this is what enforces maxQueueSize
+    size_t newDepth = depth.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+    if (newDepth > maxQueueSize) {
+        depth.fetch_sub(1, std::memory_order_acq_rel);
+        rejectedCount.fetch_add(1, std::memory_order_relaxed);
         return false;  // Queue full
     }
-    
-    commands.push(std::move(cmd));
+
+    size_t peak = highWater.load(std::memory_order_relaxed);
+    while ((newDepth > peak) &&
+           !highWater.compare_exchange_weak(peak, newDepth, std::memory_order_relaxed)) {
+    }
+
+    // The ring is at least maxQueueSize cells, so with a reserved place a
+    // failed push only means a consumer is still finishing with the cell.
+    ApiCommand* raw = cmd.release();
+
+    while (!ring.tryPush(raw)) {
+        std::this_thread::yield();
+    }
+    pushedCount.fetch_add(1, std::memory_order_relaxed);
     return true;
 }
 
 std::unique_ptr<ApiCommand> CommandQueue::tryPop() {
-    FCEU::autoScopedLock lock(queueMutex);
-    
-    if (commands.empty()) {
+    ApiCommand* raw = nullptr;
+
+    if (!ring.tryPop(raw)) {
         return nullptr;
     }
-    
-    std::unique_ptr<ApiCommand> cmd = std::move(commands.front());
-    commands.pop();
-    return cmd;
+    depth.fetch_sub(1, std::memory_order_acq_rel);
+
+    return std::unique_ptr<ApiCommand>(raw);
 }
 
 bool CommandQueue::empty() const {
-    FCEU::autoScopedLock lock(queueMutex);
-    return commands.empty();
+    return depth.load(std::memory_order_acquire) == 0;
 }
 
 size_t CommandQueue::size() const {
-    FCEU::autoScopedLock lock(queueMutex);
-    return commands.size();
+    return depth.load(std::memory_order_acquire);
+}
+
+void CommandQueue::resetHighWaterMark() {
+    highWater.store(depth.load(std::memory_order_relaxed), std::memory_order_relaxed);
 }
 
 void CommandQueue::clear() {
-    FCEU::autoScopedLock lock(queueMutex);
-    
     // Cancel all pending commands before destroying
     // This prevents futures from being left in broken promise state
-    while (!commands.empty()) {
-        auto& cmd = commands.front();
-        
+    while (auto cmd = tryPop()) {
         // Call virtual cancel method to handle promise cleanup
         cmd->cancel(std::make_exception_ptr(
             std::runtime_error("Command queue cleared - operation cancelled")));
-        
-        commands.pop();
     }
-}
\ No newline at end of file
+}
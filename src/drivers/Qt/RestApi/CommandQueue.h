@@ -1,33 +1,40 @@
 #ifndef __COMMAND_QUEUE_H__
 #define __COMMAND_QUEUE_H__
 
-#include <queue>
+#include <atomic>
 #include <memory>
 #include <cstddef>
-#include "utils/mutex.h"
+#include <cstdint>
+#include "Utils/BoundedRing.h"
 
 // Forward declaration
 class ApiCommand;
 
 /**
- * @brief Thread-safe command queue for REST API to emulator communication
+ * @brief Lock-free command queue for REST API to emulator communication
  * 
- * This queue allows the REST API server thread to submit commands that
- * will be executed on the emulator thread. All operations are protected
- * by FCEU::mutex for thread safety.
+ * This queue allows the REST API server threads to submit commands that
+ * will be executed on the emulator thread. Commands are held in a
+ * preallocated BoundedRing, so neither side takes a lock or allocates,
+ * and the emulator thread never waits on a busy HTTP worker.
  * 
  * Usage:
- * - REST API thread: push() commands into the queue
+ * - REST API threads: push() commands into the queue
  * - Emulator thread: tryPop() and execute commands
- * - Both threads: can check empty() and size()
+ * - Any thread: can check empty(), size() and the statistics
  */
 class CommandQueue {
 private:
-    std::queue<std::unique_ptr<ApiCommand>> commands;
-    mutable FCEU::mutex queueMutex;
+    BoundedRing<ApiCommand*> ring;
     static constexpr size_t DEFAULT_MAX_SIZE = 1000;
     size_t maxQueueSize;
     
+    // Commands accepted but not yet popped, bounds the queue to maxQueueSize
+    std::atomic<size_t> depth;
+    std::atomic<size_t> highWater;
+    std::atomic<uint64_t> pushedCount;
+    std::atomic<uint64_t> rejectedCount;
+    
 public:
     /**
      * @brief Construct a new Command Queue
@@ -47,7 +54,7 @@ public:
     /**
      * @brief Push a command onto the queue
      * 
-     * Thread-safe. Returns false if queue is full.
+     * Thread-safe and lock-free. Returns false if queue is full.
      * 
      * @param cmd Command to push (ownership transferred)
      * @return true if pushed successfully, false if queue is full
@@ -57,7 +64,7 @@ public:
     /**
      * @brief Try to pop a command from the queue
      * 
-     * Thread-safe. Non-blocking - returns nullptr if queue is empty.
+     * Thread-safe and lock-free. Returns nullptr if queue is empty.
      * 
      * @return Command if available, nullptr if queue is empty
      */
@@ -95,6 +102,28 @@ public:
      * @return Maximum number of commands allowed in queue
      */
     size_t getMaxSize() const { return maxQueueSize; }
+    
+    /**
+     * @brief Largest depth the queue has reached
+     * 
+     * Since construction or the last resetHighWaterMark().
+     */
+    size_t highWaterMark() const { return highWater.load(std::memory_order_relaxed); }
+    
+    /**
+     * @brief Restart high-water tracking from the current depth
+     */
+    void resetHighWaterMark();
+    
+    /**
+     * @brief Total number of commands accepted by push()
+     */
+    uint64_t totalPushed() const { return pushedCount.load(std::memory_order_relaxed); }
+    
+    /**
+     * @brief Total number of commands rejected because the queue was full
+     */
+    uint64_t totalRejected() const { return rejectedCount.load(std::memory_order_relaxed); }
 };
 
 #endif // __COMMAND_QUEUE_H__
\ No newline at end of file
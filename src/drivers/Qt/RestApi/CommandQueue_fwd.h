@@ -18,6 +18,9 @@ class ApiCommandVoid;
 // Global accessor function
 CommandQueue& getRestApiCommandQueue();
 
+// Wakes a paused emulator thread to run a command just pushed
+void notifyRestApiCommandPushed();
+
 // Command execution result tracking
 struct CommandExecutionResult {
     std::string commandName;
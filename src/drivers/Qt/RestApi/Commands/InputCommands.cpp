@@ -328,4 +328,107 @@ void InputStateCommand::execute() {
     FCEU_WRAPPER_UNLOCK();
     
     resultPromise.set_value(result);
-}
\ No newline at end of file
+}
+
+std::string InputTimelineResult::toJson() const {
+    json result;
+    result["success"] = success;
+    result["frame"] = frame;
+    result["scheduled"] = scheduled;
+    result["late"] = late;
+    result["removed"] = removed;
+    result["pending"] = pending;
+    result["next_frame"] = nextFrame;
+    result["end_frame"] = endFrame;
+    return result.dump();
+}
+
+static InputTimelineResult timelineResult() {
+    InputTimeline& timeline = InputTimeline::instance();
+    InputTimelineResult result;
+    result.success = true;
+    result.frame = currFrameCounter;
+    result.scheduled = 0;
+    result.late = 0;
+    result.removed = 0;
+    result.pending = timeline.size();
+    result.nextFrame = timeline.nextFrame();
+    result.endFrame = timeline.endFrame();
+    return result;
+}
+
+InputTimelineScheduleCommand::InputTimelineScheduleCommand(const std::vector<InputTimelineEvent>& evts, bool rel)
+    : events(evts), relative(rel) {
+    for (const auto& event : events) {
+        if (event.port > 3) {
+            throw std::runtime_error("Invalid port number");
+        }
+    }
+}
+
+void InputTimelineScheduleCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+
+    if (GameInfo == NULL) {
+        FCEU_WRAPPER_UNLOCK();
+        throw std::runtime_error("No game loaded");
+    }
+
+    InputTimeline& timeline = InputTimeline::instance();
+    int now = currFrameCounter;
+
+    // Drop what already ended so it does not count against the capacity
+    timeline.expire(now);
+
+    std::vector<InputTimelineEvent> accepted;
+    size_t late = 0;
+    accepted.reserve(events.size());
+
+    for (auto event : events) {
+        if (relative) {
+            event.frame += now;
+        }
+        // The frame now can still be read, input for it is not latched yet
+        if (event.frame + event.frames <= now) {
+            late++;
+            continue;
+        }
+        accepted.push_back(event);
+    }
+
+    if (timeline.size() + accepted.size() > InputTimeline::CAPACITY) {
+        FCEU_WRAPPER_UNLOCK();
+        throw std::runtime_error("Input timeline full");
+    }
+
+    for (const auto& event : accepted) {
+        timeline.schedule(event);
+    }
+
+    InputTimelineResult result = timelineResult();
+    result.scheduled = accepted.size();
+    result.late = late;
+
+    FCEU_WRAPPER_UNLOCK();
+
+    resultPromise.set_value(result);
+}
+
+void InputTimelineStatusCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+    InputTimeline::instance().expire(currFrameCounter);
+    InputTimelineResult result = timelineResult();
+    FCEU_WRAPPER_UNLOCK();
+
+    resultPromise.set_value(result);
+}
+
+void InputTimelineClearCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+    size_t removed = InputTimeline::instance().clear();
+    InputTimelineResult result = timelineResult();
+    result.removed = removed;
+    FCEU_WRAPPER_UNLOCK();
+
+    resultPromise.set_value(result);
+}
@@ -2,6 +2,7 @@
 #define __INPUT_COMMANDS_H__
 
 #include "../RestApiCommands.h"
+#include "../InputTimeline.h"
 #include "../../../../types.h"
 #include "../../../../fceu.h"
 #include <string>
@@ -120,6 +121,22 @@ struct InputStateResult {
     std::string toJson() const;
 };
 
+/**
+ * @brief Result structure for scheduled input operations
+ */
+struct InputTimelineResult {
+    bool success;
+    int frame;              ///< Frame counter when the command ran
+    size_t scheduled;       ///< Events added by this request
+    size_t late;            ///< Events dropped because their frames had passed
+    size_t removed;         ///< Events removed by a clear
+    size_t pending;         ///< Events waiting in the timeline
+    int nextFrame;          ///< Start of the earliest pending event, -1 if none
+    int endFrame;           ///< Frame after the last scheduled frame, -1 if none
+
+    std::string toJson() const;
+};
+
 /**
  * @brief Helper to convert button names to bitmask
  * @param buttonNames Vector of button names ("A", "B", etc.)
@@ -187,4 +204,43 @@ public:
     const char* name() const override { return "InputStateCommand"; }
 };
 
+/**
+ * @brief Command to schedule input on exact frames
+ *
+ * All events are added or none is: a request that does not fit in the
+ * timeline fails with "Input timeline full".
+ */
+class InputTimelineScheduleCommand : public ApiCommandWithResult<InputTimelineResult> {
+private:
+    std::vector<InputTimelineEvent> events;
+    bool relative;
+
+public:
+    /**
+     * @param evts Events with 0-based ports
+     * @param rel Frames are offsets from the current frame
+     */
+    InputTimelineScheduleCommand(const std::vector<InputTimelineEvent>& evts, bool rel);
+    void execute() override;
+    const char* name() const override { return "InputTimelineScheduleCommand"; }
+};
+
+/**
+ * @brief Command to get the scheduled input status
+ */
+class InputTimelineStatusCommand : public ApiCommandWithResult<InputTimelineResult> {
+public:
+    void execute() override;
+    const char* name() const override { return "InputTimelineStatusCommand"; }
+};
+
+/**
+ * @brief Command to remove all scheduled input
+ */
+class InputTimelineClearCommand : public ApiCommandWithResult<InputTimelineResult> {
+public:
+    void execute() override;
+    const char* name() const override { return "InputTimelineClearCommand"; }
+};
+
 #endif // __INPUT_COMMANDS_H__
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include "InstanceCommands.h"
+#include "../Utils/BinaryResponse.h"
+#include "../../fceuWrapper.h"
+#include "../../../../fceu.h"
+#include "../../../../cheat.h"
+#include "../../../../movie.h"
+#include "../../../../lib/json.hpp"
+#include <QFileInfo>
+#include <QString>
+#include <cstdio>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+static json instanceToJson(const InstanceInfo& info) {
+    json buttons = json::array();
+    for (int port = 0; port < 4; port++) {
+        buttons.push_back(info.buttons[port]);
+    }
+
+    json j;
+    j["id"] = info.id;
+    j["frame"] = info.frame;
+    j["lag_frames"] = info.lag;
+    j["buttons"] = buttons;
+    return j;
+}
+
+static std::string hexAddress(uint16_t address) {
+    char text[8];
+    snprintf(text, sizeof(text), "0x%04X", address);
+    return text;
+}
+
+std::string InstanceListResult::toJson() const {
+    json result;
+    result["success"] = true;
+    if (!created.empty()) {
+        result["created"] = created;
+    }
+    json list = json::array();
+    for (const auto& info : instances) {
+        list.push_back(instanceToJson(info));
+    }
+    result["instances"] = list;
+    result["max_instances"] = InstancePool::MAX_INSTANCES;
+    return result.dump();
+}
+
+std::string InstanceStepResult::toJson() const {
+    json result;
+    result["success"] = true;
+    result["frames"] = frames;
+
+    json rangeList = json::array();
+    for (const auto& range : ranges) {
+        rangeList.push_back({{"start", hexAddress(range.start)}, {"length", range.length}});
+    }
+    result["ranges"] = rangeList;
+
+    json list = json::array();
+    for (const auto& obs : instances) {
+        json item;
+        item["id"] = obs.id;
+        item["frame"] = obs.frame;
+        item["lag_frames"] = obs.lag;
+
+        json data = json::array();
+        size_t offset = 0;
+        for (const auto& range : ranges) {
+            data.push_back(base64Encode(obs.data.data() + offset, range.length));
+            offset += range.length;
+        }
+        item["data"] = data;
+        list.push_back(item);
+    }
+    result["instances"] = list;
+    return result.dump();
+}
+
+// Instances fork the loaded game, without one there is nothing to run
+static void requireGame() {
+    if (GameInfo == nullptr) {
+        FCEU_WRAPPER_UNLOCK();
+        throw std::runtime_error("No game loaded");
+    }
+}
+
+InstanceCreateCommand::InstanceCreateCommand(size_t instanceCount, const std::string& rom)
+    : count(instanceCount), romPath(rom) {
+    if ((count < 1) || (count > InstancePool::MAX_INSTANCES)) {
+        throw std::runtime_error("Count must be between 1 and 64");
+    }
+}
+
+void InstanceCreateCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+    requireGame();
+
+    if (!romPath.empty()) {
+        QString wanted = QFileInfo(QString::fromStdString(romPath)).canonicalFilePath();
+        QString loaded = QFileInfo(QString::fromLocal8Bit(GameInfo->filename)).canonicalFilePath();
+
+        if (wanted.isEmpty() || (wanted != loaded)) {
+            FCEU_WRAPPER_UNLOCK();
+            throw std::runtime_error("Instances share the loaded ROM");
+        }
+    }
+
+    InstanceListResult result;
+    try {
+        result.created = InstancePool::instance().create(count);
+    } catch (const std::exception&) {
+        FCEU_WRAPPER_UNLOCK();
+        throw;
+    }
+    result.instances = InstancePool::instance().list();
+
+    FCEU_WRAPPER_UNLOCK();
+
+    resultPromise.set_value(result);
+}
+
+void InstanceListCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+    InstanceListResult result;
+    result.instances = InstancePool::instance().list();
+    FCEU_WRAPPER_UNLOCK();
+
+    resultPromise.set_value(result);
+}
+
+void InstanceDeleteCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+
+    if (!InstancePool::instance().remove(id)) {
+        FCEU_WRAPPER_UNLOCK();
+        throw std::runtime_error("Unknown instance");
+    }
+    InstanceListResult result;
+    result.instances = InstancePool::instance().list();
+
+    FCEU_WRAPPER_UNLOCK();
+
+    resultPromise.set_value(result);
+}
+
+InstanceStepCommand::InstanceStepCommand(const std::vector<unsigned int>& instanceIds, unsigned int stepFrames,
+                                         const std::vector<InstanceInput>& stepInputs,
+                                         const std::vector<InstanceReadRange>& readRanges)
+    : ids(instanceIds), frames(stepFrames), inputs(stepInputs), ranges(readRanges) {
+    if (frames > MAX_INSTANCE_STEP_FRAMES) {
+        throw std::runtime_error("Frames must be 0 to 600");
+    }
+    if (ranges.size() > MAX_INSTANCE_READ_RANGES) {
+        throw std::runtime_error("Range count exceeds maximum allowed (16 ranges)");
+    }
+
+    size_t totalBytes = 0;
+    for (const auto& range : ranges) {
+        if (range.length == 0) {
+            throw std::runtime_error("Length must be greater than 0");
+        }
+        if (static_cast<uint32_t>(range.start) + range.length > 0x10000) {
+            throw std::runtime_error("Address range exceeds memory bounds");
+        }
+        totalBytes += range.length;
+    }
+    if (totalBytes > MAX_INSTANCE_READ_BYTES) {
+        throw std::runtime_error("Read size exceeds maximum allowed (4096 bytes per instance)");
+    }
+}
+
+void InstanceStepCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+    requireGame();
+
+    // Instance frames would be recorded into, or played from, the console's movie
+    if (FCEUMOV_Mode(MOVIEMODE_PLAY | MOVIEMODE_RECORD | MOVIEMODE_TASEDITOR)) {
+        FCEU_WRAPPER_UNLOCK();
+        throw std::runtime_error("Instances cannot run while a movie is active");
+    }
+
+    InstancePool& pool = InstancePool::instance();
+
+    if (ids.empty()) {
+        for (const auto& info : pool.list()) {
+            ids.push_back(info.id);
+        }
+    }
+    for (unsigned int id : ids) {
+        if (!pool.contains(id)) {
+            FCEU_WRAPPER_UNLOCK();
+            throw std::runtime_error("Unknown instance");
+        }
+    }
+    for (const auto& input : inputs) {
+        if (!pool.setInput(input.id, input.port, input.buttons)) {
+            FCEU_WRAPPER_UNLOCK();
+            throw std::runtime_error("Unknown instance");
+        }
+    }
+
+    InstanceStepResult result;
+    result.frames = frames;
+    result.ranges = ranges;
+    result.instances.reserve(ids.size());
+
+    // The run drives the core itself, lift the pause for its duration
+    int savedPaused = EmulationPaused;
+    EmulationPaused = 0;
+
+    try {
+        pool.run(ids, frames, [&](const InstanceInfo& info) {
+            InstanceObservation obs;
+            obs.id = info.id;
+            obs.frame = info.frame;
+            obs.lag = info.lag;
+
+            for (const auto& range : ranges) {
+                for (uint32_t i = 0; i < range.length; i++) {
+                    obs.data.push_back(FCEU_CheatGetByte(range.start + i));
+                }
+            }
+            result.instances.push_back(std::move(obs));
+        });
+    } catch (const std::exception&) {
+        EmulationPaused = savedPaused;
+        FCEU_WRAPPER_UNLOCK();
+        throw;
+    }
+    EmulationPaused = savedPaused;
+
+    FCEU_WRAPPER_UNLOCK();
+
+    resultPromise.set_value(result);
+}
+
+void runInstanceBatch(const std::vector<unsigned int>& ids, const std::vector<uint8_t>& actions,
+                      unsigned int frames, const InstanceBatchLayout& layout, std::vector<uint8_t>& out) {
+    if (GameInfo == nullptr) {
+        throw std::runtime_error("No game loaded");
+    }
+    if (FCEUMOV_Mode(MOVIEMODE_PLAY | MOVIEMODE_RECORD | MOVIEMODE_TASEDITOR)) {
+        throw std::runtime_error("Instances cannot run while a movie is active");
+    }
+
+    InstancePool& pool = InstancePool::instance();
+    for (unsigned int id : ids) {
+        if (!pool.contains(id)) {
+            throw std::runtime_error("Unknown instance");
+        }
+    }
+
+    out.resize(ids.size() * layout.size());
+
+    int savedPaused = EmulationPaused;
+    EmulationPaused = 0;
+
+    try {
+        pool.stepBatch(ids, actions.data(), frames, layout, out.data());
+    } catch (const std::exception&) {
+        EmulationPaused = savedPaused;
+        throw;
+    }
+    EmulationPaused = savedPaused;
+}
+
+InstanceStepBatchCommand::InstanceStepBatchCommand(const std::vector<unsigned int>& instanceIds,
+                                                   const std::vector<uint8_t>& batchActions,
+                                                   unsigned int frameskip,
+                                                   const InstanceBatchLayout& obsLayout)
+    : ids(instanceIds), actions(batchActions), frames(frameskip), layout(obsLayout) {
+    if ((frames < 1) || (frames > MAX_INSTANCE_FRAMESKIP)) {
+        throw std::runtime_error("Frameskip must be 1 to 60");
+    }
+    if ((layout.frameScale != 0) && (layout.frameScale != 1) &&
+        (layout.frameScale != 2) && (layout.frameScale != 4)) {
+        throw std::runtime_error("Frame scale must be 0, 1, 2 or 4");
+    }
+    if (layout.size() == 0) {
+        throw std::runtime_error("Observation is empty");
+    }
+    if (actions.empty()) {
+        throw std::runtime_error("Missing actions");
+    }
+    if (!ids.empty() && (actions.size() != 1) && (actions.size() != ids.size())) {
+        throw std::runtime_error("Action count does not match the instances");
+    }
+}
+
+void InstanceStepBatchCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+
+    if (ids.empty()) {
+        for (const auto& info : InstancePool::instance().list()) {
+            ids.push_back(info.id);
+        }
+    }
+    if ((actions.size() == 1) && (ids.size() > 1)) {
+        actions.assign(ids.size(), actions[0]);
+    }
+    if (actions.size() != ids.size()) {
+        FCEU_WRAPPER_UNLOCK();
+        throw std::runtime_error("Action count does not match the instances");
+    }
+
+    InstanceBatchResult result;
+    result.ids = ids;
+    result.layout = layout;
+
+    try {
+        runInstanceBatch(ids, actions, frames, layout, result.data);
+    } catch (const std::exception&) {
+        FCEU_WRAPPER_UNLOCK();
+        throw;
+    }
+
+    FCEU_WRAPPER_UNLOCK();
+
+    resultPromise.set_value(std::move(result));
+}
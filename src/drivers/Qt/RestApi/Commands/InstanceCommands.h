@@ -0,0 +1,207 @@
+#ifndef __INSTANCE_COMMANDS_H__
+#define __INSTANCE_COMMANDS_H__
+
+#include "../RestApiCommands.h"
+#include "../InstancePool.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Maximum frames a batch step runs on each instance
+ */
+const unsigned int MAX_INSTANCE_STEP_FRAMES = 600;
+
+/**
+ * @brief Maximum ranges read from each instance
+ */
+const size_t MAX_INSTANCE_READ_RANGES = 16;
+
+/**
+ * @brief Maximum total bytes read from each instance
+ */
+const size_t MAX_INSTANCE_READ_BYTES = 4096;
+
+/**
+ * @brief Maximum frame skip of a batch step
+ */
+const unsigned int MAX_INSTANCE_FRAMESKIP = 60;
+
+/**
+ * @brief Memory range read from an instance
+ */
+struct InstanceReadRange {
+    uint16_t start;
+    uint16_t length;
+};
+
+/**
+ * @brief Buttons given to one instance port
+ */
+struct InstanceInput {
+    unsigned int id;
+    uint8_t port;       ///< 0-based
+    uint8_t buttons;
+};
+
+/**
+ * @brief Result of the instance list, create and delete commands
+ */
+struct InstanceListResult {
+    std::vector<unsigned int> created;      ///< Ids made by a create
+    std::vector<InstanceInfo> instances;    ///< Every instance after the command
+
+    std::string toJson() const;
+};
+
+/**
+ * @brief State and read memory of one instance after a step
+ */
+struct InstanceObservation {
+    unsigned int id;
+    int frame;
+    unsigned int lag;
+    std::vector<uint8_t> data;      ///< Ranges back to back
+};
+
+/**
+ * @brief Result of an instance step
+ */
+struct InstanceStepResult {
+    unsigned int frames;
+    std::vector<InstanceReadRange> ranges;
+    std::vector<InstanceObservation> instances;
+
+    std::string toJson() const;
+};
+
+/**
+ * @brief Observations of a vector step, one per instance in ids order
+ */
+struct InstanceBatchResult {
+    std::vector<unsigned int> ids;
+    InstanceBatchLayout layout;
+    std::vector<uint8_t> data;      ///< ids.size() * layout.size() bytes
+};
+
+/**
+ * @brief Command to fork instances from the running console
+ */
+class InstanceCreateCommand : public ApiCommandWithResult<InstanceListResult> {
+private:
+    size_t count;
+    std::string romPath;
+
+public:
+    /**
+     * @param instanceCount Instances to create
+     * @param rom ROM the client expects, empty for the loaded one; instances
+     *        share the loaded game, any other ROM fails with
+     *        "Instances share the loaded ROM"
+     */
+    InstanceCreateCommand(size_t instanceCount, const std::string& rom);
+    void execute() override;
+    const char* name() const override { return "InstanceCreateCommand"; }
+};
+
+/**
+ * @brief Command to list the instances
+ */
+class InstanceListCommand : public ApiCommandWithResult<InstanceListResult> {
+public:
+    void execute() override;
+    const char* name() const override { return "InstanceListCommand"; }
+};
+
+/**
+ * @brief Command to drop an instance
+ */
+class InstanceDeleteCommand : public ApiCommandWithResult<InstanceListResult> {
+private:
+    unsigned int id;
+
+public:
+    explicit InstanceDeleteCommand(unsigned int instanceId) : id(instanceId) {}
+    void execute() override;
+    const char* name() const override { return "InstanceDeleteCommand"; }
+};
+
+/**
+ * @brief Command to step instances and read their memory
+ *
+ * Sets the given inputs, runs the frames on every selected instance one
+ * after the other, and reads the ranges from each before it is swapped
+ * out, all in one emulator-thread command. With frames 0 it only reads.
+ */
+class InstanceStepCommand : public ApiCommandWithResult<InstanceStepResult> {
+private:
+    std::vector<unsigned int> ids;      ///< Empty selects every instance
+    unsigned int frames;
+    std::vector<InstanceInput> inputs;
+    std::vector<InstanceReadRange> ranges;
+
+public:
+    /**
+     * @throws std::runtime_error if frames or ranges exceed the limits
+     */
+    InstanceStepCommand(const std::vector<unsigned int>& instanceIds, unsigned int stepFrames,
+                        const std::vector<InstanceInput>& stepInputs,
+                        const std::vector<InstanceReadRange>& readRanges);
+
+    /**
+     * @throws std::runtime_error if no game is loaded, a movie is active or
+     *         an id is unknown
+     */
+    void execute() override;
+    const char* name() const override { return "InstanceStepCommand"; }
+};
+
+/**
+ * @brief Command to step instances as a vector environment
+ *
+ * Each instance holds its action on port 1 for the frame skip, then its
+ * observation is written into one contiguous buffer. The batch is meant
+ * for reinforcement learning loops that step every environment at once.
+ */
+class InstanceStepBatchCommand : public ApiCommandWithResult<InstanceBatchResult> {
+private:
+    std::vector<unsigned int> ids;      ///< Empty selects every instance
+    std::vector<uint8_t> actions;       ///< One port 1 mask per instance
+    unsigned int frames;
+    InstanceBatchLayout layout;
+
+public:
+    /**
+     * @param instanceIds Instances, empty for all in id order
+     * @param batchActions One action per instance, a single action is given
+     *        to every instance
+     * @param frameskip Frames per step, 1 to MAX_INSTANCE_FRAMESKIP
+     * @param obsLayout Observation layout
+     * @throws std::runtime_error on an invalid frame skip, scale or actions
+     */
+    InstanceStepBatchCommand(const std::vector<unsigned int>& instanceIds,
+                             const std::vector<uint8_t>& batchActions, unsigned int frameskip,
+                             const InstanceBatchLayout& obsLayout);
+
+    /**
+     * @throws std::runtime_error like InstanceStepCommand::execute(), and
+     *         when the action count does not match the instances
+     */
+    void execute() override;
+    const char* name() const override { return "InstanceStepBatchCommand"; }
+};
+
+/**
+ * @brief Run a vector step with the emulator mutex held
+ *
+ * Shared by InstanceStepBatchCommand and the binary RPC batch, checks the
+ * movie mode and lifts the pause like InstanceStepCommand.
+ *
+ * @param ids Instances, all must exist
+ * @param actions ids.size() port 1 masks
+ * @throws std::runtime_error if a movie is active or an id is unknown
+ */
+void runInstanceBatch(const std::vector<unsigned int>& ids, const std::vector<uint8_t>& actions,
+                      unsigned int frames, const InstanceBatchLayout& layout, std::vector<uint8_t>& out);
+
+#endif // __INSTANCE_COMMANDS_H__
@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include <cstddef>
+#include <cstdio>
 #include <unordered_map>
 
 using json = nlohmann::json;
@@ -72,6 +73,70 @@ struct ScreenshotResult : public MediaResult {
     }
 };
 
+/**
+ * @brief Result structure for frame hash queries
+ *
+ * Hashes go out as 16 digit hex strings, JSON numbers lose precision
+ * past 53 bits.
+ */
+struct ScreenHashResult : public MediaResult {
+    int frame;              // Frame counter the hashes belong to
+    uint64_t exact;
+    uint64_t perceptual;
+    bool hasPerceptual;
+    int distance;           // Perceptual distance to the compare hash, -1 if none given
+    
+    ScreenHashResult() : frame(0), exact(0), perceptual(0), hasPerceptual(false), distance(-1) {}
+    
+    static std::string toHex(uint64_t v) {
+        char str[24];
+        snprintf(str, sizeof(str), "%016llx", (unsigned long long)v);
+        return str;
+    }
+    
+    std::string toJson() const override {
+        json j;
+        addCommonFields(j);
+        
+        if (success) {
+            j["frame"] = frame;
+            j["exact"] = toHex(exact);
+            if (hasPerceptual) {
+                j["perceptual"] = toHex(perceptual);
+            }
+            if (distance >= 0) {
+                j["distance"] = distance;
+            }
+        }
+        
+        return j.dump();
+    }
+};
+
+/**
+ * @brief Result structure for saving the instant replay ring
+ *
+ * The clip is written in the background, path names the file it goes to.
+ */
+struct InstantReplayResult : public MediaResult {
+    std::string path;
+    int frames;             // Frames in the clip
+    
+    InstantReplayResult() : frames(0) {}
+    
+    std::string toJson() const override {
+        json j;
+        addCommonFields(j);
+        
+        if (success) {
+            j["path"] = path;
+            j["frames"] = frames;
+        }
+        
+        return j.dump();
+    }
+};
+
 /**
  * @brief Result structure for save state operations
  */
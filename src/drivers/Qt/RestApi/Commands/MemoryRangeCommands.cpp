@@ -1,5 +1,8 @@
 #include "MemoryRangeCommands.h"
+#include "../Utils/BinaryResponse.h"
+#include "../Utils/ReadCoalescer.h"
 #include "../../fceuWrapper.h"
+#include "../../EmuStateSnapshot.h"
 #include "../../../../cheat.h"
 #include "../../../../fceu.h"
 #include <QByteArray>
@@ -57,6 +60,22 @@ std::string MemoryRangeResult::toJson() const {
     return json.str();
 }
 
+std::string MemoryRangeResult::toCbor() const {
+    CborWriter cbor;
+    cbor.beginMap(3);
+    cbor.writeText("start");
+    cbor.writeUInt(start);
+    cbor.writeText("length");
+    cbor.writeUInt(length);
+    cbor.writeText("data");
+    cbor.writeBytes(data.data(), data.size());
+    return cbor.data();
+}
+
+std::string MemoryRangeResult::toBinary() const {
+    return std::string(data.begin(), data.end());
+}
+
 // MemoryWriteResult implementation
 
 std::string MemoryWriteResult::toJson() const {
@@ -174,6 +193,37 @@ void MemoryRangeReadCommand::execute() {
     resultPromise.set_value(result);
 }
 
+bool MemoryRangeReadCommand::readSnapshot(MemoryRangeResult& result) const {
+    // Out of range requests go through execute() for its error message
+    if (length == 0 || length > MAX_MEMORY_RANGE_LENGTH) {
+        return false;
+    }
+    result.start = startAddress;
+    result.length = length;
+    result.data.resize(length);
+
+    return emuStateSnapshotReadCpu(startAddress, length, result.data.data());
+}
+
+bool MemoryRangeReadCommand::addReads(ReadCoalescer& reads) {
+    // Out of range requests go through execute() for its error message
+    if (length > MAX_MEMORY_RANGE_LENGTH) {
+        return false;
+    }
+    return reads.add(startAddress, length);
+}
+
+void MemoryRangeReadCommand::completeReads(const ReadCoalescer& reads) {
+    MemoryRangeResult result;
+    result.start = startAddress;
+    result.length = length;
+
+    const uint8_t* bytes = reads.bytes(startAddress);
+    result.data.assign(bytes, bytes + length);
+
+    resultPromise.set_value(result);
+}
+
 // MemoryRangeWriteCommand implementation
 
 MemoryRangeWriteCommand::MemoryRangeWriteCommand(uint16_t start, const std::vector<uint8_t>& writeData)
@@ -360,4 +410,38 @@ void MemoryBatchCommand::execute() {
     
     // Set the result
     resultPromise.set_value(result);
-}
\ No newline at end of file
+}
+
+bool MemoryBatchCommand::addReads(ReadCoalescer& reads) {
+    if (operations.empty() || (operations.size() > 100)) {
+        return false;
+    }
+    for (const auto& op : operations) {
+        if ((op.type != "read") || (op.length == 0) || (op.length > MAX_MEMORY_RANGE_LENGTH) ||
+            (static_cast<uint32_t>(op.address) + op.length > 0x10000)) {
+            return false;
+        }
+    }
+    for (const auto& op : operations) {
+        reads.add(op.address, op.length);
+    }
+    return true;
+}
+
+void MemoryBatchCommand::completeReads(const ReadCoalescer& reads) {
+    MemoryBatchResult result;
+    result.results.reserve(operations.size());
+
+    for (const auto& op : operations) {
+        BatchOperationResult opResult;
+        opResult.type = "read";
+        opResult.address = op.address;
+        opResult.success = true;
+
+        const uint8_t* bytes = reads.bytes(op.address);
+        opResult.data.assign(bytes, bytes + op.length);
+        result.results.push_back(opResult);
+    }
+
+    resultPromise.set_value(result);
+}
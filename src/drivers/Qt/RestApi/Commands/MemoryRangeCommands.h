@@ -37,6 +37,21 @@ struct MemoryRangeResult {
      * @return JSON string representation
      */
     std::string toJson() const;
+    
+    /**
+     * @brief Convert the result to CBOR
+     * 
+     * Map with "start" and "length" as unsigned integers and "data" as a
+     * byte string.
+     * 
+     * @return Encoded CBOR bytes
+     */
+    std::string toCbor() const;
+    
+    /**
+     * @brief Raw memory bytes for application/octet-stream responses
+     */
+    std::string toBinary() const;
 };
 
 /**
@@ -127,6 +142,19 @@ public:
      */
     void execute() override;
     
+    /**
+     * @brief Answer from the published emulator state snapshot
+     * 
+     * Runs on the calling thread without the emulator mutex.
+     * 
+     * @param result Filled in when the snapshot holds the whole range
+     * @return false when it does not, execute() has to read it then
+     */
+    bool readSnapshot(MemoryRangeResult& result) const;
+    
+    bool addReads(ReadCoalescer& reads) override;
+    void completeReads(const ReadCoalescer& reads) override;
+    
     /**
      * @brief Get the command name for logging
      * @return "MemoryRangeReadCommand"
@@ -215,6 +243,12 @@ public:
      */
     void execute() override;
     
+    /**
+     * @brief Coalesce the reads when the batch has no writes
+     */
+    bool addReads(ReadCoalescer& reads) override;
+    void completeReads(const ReadCoalescer& reads) override;
+    
     /**
      * @brief Get the command name for logging
      * @return "MemoryBatchCommand"
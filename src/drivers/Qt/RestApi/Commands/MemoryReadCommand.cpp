@@ -1,7 +1,11 @@
 #include "MemoryReadCommand.h"
+#include "../Utils/ReadCoalescer.h"
 #include "../../fceuWrapper.h"
+#include "../../EmuStateSnapshot.h"
 #include "../../../../cheat.h"
 #include "../../../../fceu.h"
+#include "../../../../writejournal.h"
+#include "../../../../lib/json.hpp"
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
@@ -69,4 +73,94 @@ void MemoryReadCommand::execute() {
     // Set the promise with the result
     // This will make the future ready for the REST endpoint
     resultPromise.set_value(result);
-}
\ No newline at end of file
+}
+
+bool MemoryReadCommand::readSnapshot(MemoryReadResult& result) const {
+    result.address = address;
+
+    return emuStateSnapshotReadCpu(address, 1, &result.value);
+}
+
+bool MemoryReadCommand::addReads(ReadCoalescer& reads) {
+    return reads.add(address, 1);
+}
+
+void MemoryReadCommand::completeReads(const ReadCoalescer& reads) {
+    MemoryReadResult result;
+    result.address = address;
+    result.value = *reads.bytes(address);
+
+    resultPromise.set_value(result);
+}
+
+// MemoryWritersCommand implementation
+
+std::string MemoryWritersResult::toJson() const {
+    nlohmann::json j;
+    char hex[8];
+    
+    snprintf(hex, sizeof(hex), "0x%04x", address);
+    j["address"] = hex;
+    j["frames"] = frames;
+    j["writes"] = nlohmann::json::array();
+    
+    for (const MemoryWriterEntry& w : writes) {
+        nlohmann::json e;
+        e["cycle"] = w.cycle;
+        e["frame"] = w.frame;
+        snprintf(hex, sizeof(hex), "0x%04x", w.pc);
+        e["pc"] = hex;
+        if (w.bank >= 0) {
+            e["bank"] = w.bank;
+        } else {
+            e["bank"] = nullptr;
+        }
+        e["old"] = w.oldValue;
+        e["new"] = w.newValue;
+        j["writes"].push_back(e);
+    }
+    return j.dump();
+}
+
+MemoryWritersCommand::MemoryWritersCommand(uint16_t addr, int maxWrites)
+    : address(addr), count(maxWrites) {
+}
+
+void MemoryWritersCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+    
+    if (GameInfo == nullptr) {
+        FCEU_WRAPPER_UNLOCK();
+        throw std::runtime_error("No game loaded");
+    }
+    if (FCEUI_GetWriteJournal() <= 0) {
+        FCEU_WRAPPER_UNLOCK();
+        throw std::runtime_error("The write journal is off");
+    }
+    if (!FCEUI_WriteJournalCovers(address)) {
+        FCEU_WRAPPER_UNLOCK();
+        throw std::runtime_error("Address not recorded, only RAM and $6000-$7FFF are");
+    }
+    
+    std::vector<FCEU_JournalWrite> writes;
+    FCEUI_WriteJournalLast(address, count, writes);
+    
+    MemoryWritersResult result;
+    result.address = address < 0x2000 ? (address & 0x7FF) : address;
+    result.frames = FCEUI_WriteJournalFrames();
+    
+    FCEU_WRAPPER_UNLOCK();
+    
+    for (const FCEU_JournalWrite& w : writes) {
+        MemoryWriterEntry e;
+        e.cycle = w.cycle;
+        e.frame = w.frame;
+        e.pc = w.pc;
+        e.bank = w.bank;
+        e.oldValue = w.oldValue;
+        e.newValue = w.newValue;
+        result.writes.push_back(e);
+    }
+    
+    resultPromise.set_value(result);
+}
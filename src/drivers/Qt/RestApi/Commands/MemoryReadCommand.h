@@ -3,6 +3,7 @@
 
 #include "../RestApiCommands.h"
 #include <string>
+#include <vector>
 #include <cstdint>
 
 /**
@@ -70,6 +71,19 @@ public:
      */
     void execute() override;
     
+    /**
+     * @brief Answer from the published emulator state snapshot
+     * 
+     * Runs on the calling thread without the emulator mutex.
+     * 
+     * @param result Filled in when the snapshot holds the byte
+     * @return false when it does not, execute() has to read it then
+     */
+    bool readSnapshot(MemoryReadResult& result) const;
+    
+    bool addReads(ReadCoalescer& reads) override;
+    void completeReads(const ReadCoalescer& reads) override;
+    
     /**
      * @brief Get the command name for logging
      * @return "MemoryReadCommand"
@@ -77,4 +91,71 @@ public:
     const char* name() const override { return "MemoryReadCommand"; }
 };
 
+/**
+ * @brief Maximum number of writes returned by a last writers query
+ */
+const int MAX_MEMORY_WRITERS = 1000;
+
+/**
+ * @brief One write kept in the write journal
+ */
+struct MemoryWriterEntry {
+    uint64_t cycle;     ///< CPU cycles since power on
+    int frame;          ///< Frame counter of the frame it was made in
+    uint16_t pc;        ///< The instruction that wrote
+    int bank;           ///< 8K PRG ROM bank of pc, -1 outside PRG ROM
+    uint8_t oldValue;   ///< Value before the write
+    uint8_t newValue;   ///< Value after the write
+};
+
+/**
+ * @brief Result structure for last writers queries
+ */
+struct MemoryWritersResult {
+    uint16_t address;                       ///< Address asked about, RAM mirrors folded
+    int frames;                             ///< Frames held in the journal
+    std::vector<MemoryWriterEntry> writes;  ///< The latest first
+    
+    /**
+     * @brief Convert the result to JSON string
+     * 
+     * Returns "address", "frames" and "writes", an array of objects with
+     * "cycle", "frame", "pc" (hex string), "bank" (null outside PRG ROM),
+     * "old" and "new".
+     * 
+     * @return JSON string representation
+     */
+    std::string toJson() const;
+};
+
+/**
+ * @brief Command to list the last writes to an address
+ * 
+ * Answers from the write journal (see writejournal.h), which has to be on
+ * (--writejournal). Only RAM and $6000-$7FFF are recorded.
+ */
+class MemoryWritersCommand : public ApiCommandWithResult<MemoryWritersResult> {
+private:
+    uint16_t address;   ///< Address to look up
+    int count;          ///< Writes to return at most
+    
+public:
+    /**
+     * @brief Construct a last writers query
+     * @param addr The 16-bit address
+     * @param maxWrites Writes to return at most
+     */
+    MemoryWritersCommand(uint16_t addr, int maxWrites);
+    
+    /**
+     * @brief Look the writes up in the journal
+     * 
+     * @throws std::runtime_error if no game is loaded, the journal is off or
+     *         the address is not recorded
+     */
+    void execute() override;
+    
+    const char* name() const override { return "MemoryWritersCommand"; }
+};
+
 #endif // __MEMORY_READ_COMMAND_H__
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "MultiRangeReadCommand.h"
+#include "MemoryRangeCommands.h"
+#include "../Utils/BinaryResponse.h"
+#include "../Utils/ReadCoalescer.h"
+#include "../../fceuWrapper.h"
+#include "../../../../fceu.h"
+#include "../../../../cheat.h"
+#include "../../../../ppu.h"
+#include <QByteArray>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+static const char* spaceName(MemorySpace space) {
+    return (space == MemorySpace::Ppu) ? "ppu" : "cpu";
+}
+
+// MultiRangeResult implementation
+
+std::string MultiRangeResult::toJson() const {
+    std::ostringstream json;
+    json << "{\"ranges\":[";
+
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (i > 0) json << ",";
+        json << "{\"space\":\"" << spaceName(ranges[i].space) << "\","
+             << "\"start\":\"0x"
+             << std::hex << std::setfill('0') << std::setw(4)
+             << ranges[i].start << "\","
+             << "\"length\":" << std::dec << ranges[i].length << ","
+             << "\"offset\":" << ranges[i].offset << "}";
+    }
+    json << "],";
+
+    QByteArray byteArray(reinterpret_cast<const char*>(data.data()), data.size());
+    json << "\"data\":\"" << byteArray.toBase64().toStdString() << "\"";
+
+    json << "}";
+    return json.str();
+}
+
+std::string MultiRangeResult::toCbor() const {
+    CborWriter cbor;
+    cbor.beginMap(2);
+
+    cbor.writeText("ranges");
+    cbor.beginArray(ranges.size());
+    for (const auto& range : ranges) {
+        cbor.beginMap(4);
+        cbor.writeText("space");
+        cbor.writeText(spaceName(range.space));
+        cbor.writeText("start");
+        cbor.writeUInt(range.start);
+        cbor.writeText("length");
+        cbor.writeUInt(range.length);
+        cbor.writeText("offset");
+        cbor.writeUInt(range.offset);
+    }
+
+    cbor.writeText("data");
+    cbor.writeBytes(data.data(), data.size());
+    return cbor.data();
+}
+
+std::string MultiRangeResult::toBinary() const {
+    std::vector<RangeTableEntry> table;
+    table.reserve(ranges.size());
+
+    for (const auto& range : ranges) {
+        RangeTableEntry entry;
+        entry.start = range.start;
+        entry.length = range.length;
+        entry.offset = range.offset;
+        table.push_back(entry);
+    }
+    return encodeRangeTable(table, data);
+}
+
+// MultiRangeReadCommand implementation
+
+MultiRangeReadCommand::MultiRangeReadCommand(const std::vector<MultiRangeEntry>& readRanges)
+    : ranges(readRanges) {
+    if (ranges.empty()) {
+        throw std::runtime_error("Range list must not be empty");
+    }
+    if (ranges.size() > MAX_MULTI_RANGE_COUNT) {
+        throw std::runtime_error("Range count exceeds maximum allowed (32 ranges)");
+    }
+
+    uint32_t offset = 0;
+    for (auto& range : ranges) {
+        if (range.length == 0) {
+            throw std::runtime_error("Length must be greater than 0");
+        }
+        if (range.length > MAX_MEMORY_RANGE_LENGTH) {
+            throw std::runtime_error("Length exceeds maximum allowed (4096 bytes)");
+        }
+
+        uint32_t limit = (range.space == MemorySpace::Ppu) ? 0x4000 : 0x10000;
+        if (static_cast<uint32_t>(range.start) + range.length > limit) {
+            throw std::runtime_error("Address range exceeds memory bounds");
+        }
+
+        range.offset = offset;
+        offset += range.length;
+    }
+}
+
+void MultiRangeReadCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+
+    if (GameInfo == nullptr) {
+        FCEU_WRAPPER_UNLOCK();
+        throw std::runtime_error("No game loaded");
+    }
+
+    MultiRangeResult result;
+    result.ranges = ranges;
+    result.data.reserve(ranges.back().offset + ranges.back().length);
+
+    for (const auto& range : ranges) {
+        if (range.space == MemorySpace::Ppu) {
+            if (!FFCEUX_PPURead) {
+                FCEU_WRAPPER_UNLOCK();
+                throw std::runtime_error("PPU read function not available");
+            }
+            size_t at = result.data.size();
+            result.data.resize(at + range.length);
+            FCEUPPU_ReadRange(range.start, result.data.data() + at, range.length);
+        } else {
+            for (uint32_t i = 0; i < range.length; i++) {
+                result.data.push_back(FCEU_CheatGetByte(range.start + i));
+            }
+        }
+    }
+
+    FCEU_WRAPPER_UNLOCK();
+
+    resultPromise.set_value(result);
+}
+
+bool MultiRangeReadCommand::addReads(ReadCoalescer& reads) {
+    for (const auto& range : ranges) {
+        if (range.space != MemorySpace::Cpu) {
+            return false;
+        }
+    }
+    for (const auto& range : ranges) {
+        reads.add(range.start, range.length);
+    }
+    return true;
+}
+
+void MultiRangeReadCommand::completeReads(const ReadCoalescer& reads) {
+    MultiRangeResult result;
+    result.ranges = ranges;
+    result.data.reserve(ranges.back().offset + ranges.back().length);
+
+    for (const auto& range : ranges) {
+        const uint8_t* bytes = reads.bytes(range.start);
+        result.data.insert(result.data.end(), bytes, bytes + range.length);
+    }
+
+    resultPromise.set_value(result);
+}
@@ -0,0 +1,105 @@
+#ifndef __MULTI_RANGE_READ_COMMAND_H__
+#define __MULTI_RANGE_READ_COMMAND_H__
+
+#include "../RestApiCommands.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Maximum number of ranges in a single multi-range read
+ */
+const size_t MAX_MULTI_RANGE_COUNT = 32;
+
+/**
+ * @brief Address space a range is read from
+ */
+enum class MemorySpace {
+    Cpu,  ///< CPU address space, read through FCEU_CheatGetByte
+    Ppu   ///< PPU address space, read through FFCEUX_PPURead
+};
+
+/**
+ * @brief One range of a multi-range read
+ */
+struct MultiRangeEntry {
+    MemorySpace space;  ///< Address space
+    uint16_t start;     ///< Starting address
+    uint16_t length;    ///< Number of bytes
+    uint32_t offset;    ///< Offset of the range in the concatenated data
+};
+
+/**
+ * @brief Result of a multi-range read
+ *
+ * All ranges are concatenated in request order into one buffer, the
+ * entries give each range's offset into it.
+ */
+struct MultiRangeResult {
+    std::vector<MultiRangeEntry> ranges;  ///< Offset table
+    std::vector<uint8_t> data;            ///< Concatenated range bytes
+
+    /**
+     * @brief Convert the result to JSON string
+     *
+     * Returns "ranges" (space, start, length, offset) and "data", the whole
+     * buffer base64 encoded.
+     *
+     * @return JSON string representation
+     */
+    std::string toJson() const;
+
+    /**
+     * @brief Convert the result to CBOR
+     *
+     * Same layout as the JSON form with "data" as a byte string.
+     *
+     * @return Encoded CBOR bytes
+     */
+    std::string toCbor() const;
+
+    /**
+     * @brief Offset table followed by the data, see encodeRangeTable()
+     */
+    std::string toBinary() const;
+};
+
+/**
+ * @brief Command to read several CPU and PPU ranges in one pass
+ *
+ * All ranges are read under a single emulator lock, so they describe the
+ * same point in time.
+ */
+class MultiRangeReadCommand : public ApiCommandWithResult<MultiRangeResult> {
+private:
+    std::vector<MultiRangeEntry> ranges;  ///< Ranges to read, offsets unset
+
+public:
+    /**
+     * @brief Construct a multi-range read command
+     * @param readRanges Ranges to read, in response order
+     * @throws std::runtime_error if a range is invalid or limits are exceeded
+     */
+    explicit MultiRangeReadCommand(const std::vector<MultiRangeEntry>& readRanges);
+
+    /**
+     * @brief Execute the reads
+     *
+     * @throws std::runtime_error if no game loaded or PPU reads unavailable
+     */
+    void execute() override;
+
+    /**
+     * @brief Coalesce the reads when every range is in CPU space
+     */
+    bool addReads(ReadCoalescer& reads) override;
+    void completeReads(const ReadCoalescer& reads) override;
+
+    /**
+     * @brief Get the command name for logging
+     * @return "MultiRangeReadCommand"
+     */
+    const char* name() const override { return "MultiRangeReadCommand"; }
+};
+
+#endif // __MULTI_RANGE_READ_COMMAND_H__
@@ -0,0 +1,63 @@
+#include "ObservationCommands.h"
+#include "../ObservationHub.h"
+#include "../../fceuWrapper.h"
+#include "../../../../fceu.h"
+#include "../../../../lib/json.hpp"
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+// External declarations
+extern uint8 *XBuf;
+extern int currFrameCounter;
+void FCEUD_GetPalette(uint8 index, uint8 *r, uint8 *g, uint8 *b);
+
+std::string ObservationSpecResult::toJson() const {
+    json result;
+    result["success"] = true;
+    result["active"] = active;
+    if (active) {
+        json j;
+        j["crop"] = {{"x", spec.cropX}, {"y", spec.cropY},
+                     {"width", spec.cropWidth}, {"height", spec.cropHeight}};
+        j["width"] = spec.width;
+        j["height"] = spec.height;
+        j["resample"] = (spec.resample == ObservationSpec::Resample::Area) ? "area" : "nearest";
+        j["grayscale"] = spec.grayscale;
+        j["stack"] = spec.stack;
+        j["shape"] = {spec.stack, spec.height, spec.width, spec.channels()};
+        j["size"] = spec.size();
+        result["spec"] = j;
+    }
+    return result.dump();
+}
+
+ObservationConfigureCommand::ObservationConfigureCommand(const ObservationSpec& observationSpec)
+    : spec(observationSpec) {
+    std::string error;
+    if (!spec.validate(error)) {
+        throw std::runtime_error(error);
+    }
+}
+
+void ObservationConfigureCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+
+    uint8_t palette[256 * 3];
+    for (int i = 0; i < 256; i++) {
+        FCEUD_GetPalette(static_cast<uint8>(i), &palette[i * 3], &palette[i * 3 + 1], &palette[i * 3 + 2]);
+    }
+
+    ObservationHub& hub = ObservationHub::instance();
+    hub.configure(spec, palette);
+    if ((GameInfo != nullptr) && (XBuf != nullptr)) {
+        hub.process(currFrameCounter, XBuf);
+    }
+
+    FCEU_WRAPPER_UNLOCK();
+
+    ObservationSpecResult result;
+    result.active = true;
+    result.spec = spec;
+    resultPromise.set_value(result);
+}
@@ -0,0 +1,37 @@
+#ifndef __OBSERVATION_COMMANDS_H__
+#define __OBSERVATION_COMMANDS_H__
+
+#include "../RestApiCommands.h"
+#include "../Utils/ObservationPipeline.h"
+#include <string>
+
+/**
+ * @brief The observation spec in effect
+ */
+struct ObservationSpecResult {
+    bool active;
+    ObservationSpec spec;
+
+    std::string toJson() const;
+};
+
+/**
+ * @brief Command to set the observation spec
+ *
+ * Reads the current palette on the emulator thread and starts the stack
+ * with the frame on screen, so an observation is available at once.
+ */
+class ObservationConfigureCommand : public ApiCommandWithResult<ObservationSpecResult> {
+private:
+    ObservationSpec spec;
+
+public:
+    /**
+     * @throws std::runtime_error if the spec is invalid
+     */
+    explicit ObservationConfigureCommand(const ObservationSpec& observationSpec);
+    void execute() override;
+    const char* name() const override { return "ObservationConfigureCommand"; }
+};
+
+#endif // __OBSERVATION_COMMANDS_H__
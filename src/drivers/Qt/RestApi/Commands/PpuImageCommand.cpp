@@ -0,0 +1,158 @@
+#include "PpuImageCommand.h"
+#include "../../fceuWrapper.h"
+#include "../../../../types.h"
+#include "../../../../fceu.h"
+#include "../../../../driver.h"
+#include "../../../../cart.h"
+#include "../../../../debug.h"
+#include "../../../../ppu.h"
+#include "../../../../utils/pngenc.h"
+#include "../../../common/chr_tile_cache.h"
+#include <stdexcept>
+
+// Both only used from execute(), which runs with the emulator locked
+static CHRTileCache tileCache;
+static FCEU::pngEncoder imageEncoder(1);
+
+// NES color of entry p (0-3) of palette pal (0-7)
+static inline uint8_t paletteColor(int pal, int p) {
+    return (p ? PALRAM[(pal << 2) | p] : PALRAM[0]) & 0x3F;
+}
+
+std::string PpuImageResult::toBinary() const {
+    return std::string(pixels.begin(), pixels.end());
+}
+
+PpuImageCommand::PpuImageCommand(PpuImageKind k, int idx, int pal, bool png)
+    : kind(k), index(idx), palette(pal), encodePng(png) {
+    
+    if (kind == PpuImageKind::PatternTable && (index < 0 || index > 1)) {
+        throw std::runtime_error("Pattern table must be 0 or 1");
+    }
+    if (kind == PpuImageKind::NameTable && (index < 0 || index > 3)) {
+        throw std::runtime_error("Name table must be 0-3");
+    }
+    if (palette < 0 || palette > 7) {
+        throw std::runtime_error("Palette must be 0-7");
+    }
+}
+
+void PpuImageCommand::renderPatternTable(PpuImageResult& result) {
+    result.width = 128;
+    result.height = 128;
+    result.pixels.resize(128 * 128);
+    
+    for (int p = 0; p < 4; p++) {
+        int n = index * 4 + p;
+        
+        if (VPage[n] == nullptr) {
+            throw std::runtime_error("Pattern table not mapped");
+        }
+        const uint8_t* tiles = tileCache.page(n, &VPage[n][n << 10], CHRPageVersion[n]);
+        
+        // a 1KB page is 4 rows of 16 tiles
+        for (int t = 0; t < 64; t++) {
+            const uint8_t* pix = &tiles[t * 64];
+            uint8_t* dst = &result.pixels[((p * 4 + (t >> 4)) * 8) * 128 + (t & 15) * 8];
+            
+            for (int y = 0; y < 8; y++, dst += 128) {
+                for (int x = 0; x < 8; x++) {
+                    dst[x] = paletteColor(palette, *pix++);
+                }
+            }
+        }
+    }
+}
+
+void PpuImageCommand::renderNameTable(PpuImageResult& result) {
+    const uint8_t* table = vnapage[index];
+    uint32_t ptable = (PPU[0] & 0x10) ? 0x1000 : 0x0000;
+    bool exMode = MMC5Hack && (MMC5HackCHRMode == 1) && (MMC5HackExNTARAMPtr != nullptr);
+    
+    if (table == nullptr) {
+        throw std::runtime_error("Name table not mapped");
+    }
+    
+    result.width = 256;
+    result.height = 240;
+    result.pixels.resize(256 * 240);
+    
+    for (int ty = 0; ty < 30; ty++) {
+        for (int tx = 0; tx < 32; tx++) {
+            int t = ty * 32 + tx;
+            uint32_t addr = ptable + table[t] * 16;
+            const uint8_t* pix;
+            uint8_t tilePix[64];
+            
+            if (MMC5Hack) {
+                // per tile banks, or the MMC5 background set
+                CHRTileDecode(FCEUPPU_GetCHR(addr, t), tilePix);
+                pix = tilePix;
+            } else {
+                int n = addr >> 10;
+                
+                if (VPage[n] == nullptr) {
+                    throw std::runtime_error("Pattern table not mapped");
+                }
+                pix = tileCache.page(n, &VPage[n][n << 10], CHRPageVersion[n]) + ((addr >> 4) & 63) * 64;
+            }
+            
+            int pal;
+            if (exMode) {
+                pal = (MMC5HackExNTARAMPtr[t] & 0xC0) >> 6;
+            } else {
+                int shift = ((ty & 2) << 1) + (tx & 2);
+                pal = (table[0x3C0 + ((ty >> 2) << 3) + (tx >> 2)] >> shift) & 3;
+            }
+            
+            uint8_t* dst = &result.pixels[ty * 8 * 256 + tx * 8];
+            for (int y = 0; y < 8; y++, dst += 256) {
+                for (int x = 0; x < 8; x++) {
+                    dst[x] = paletteColor(pal, *pix++);
+                }
+            }
+        }
+    }
+}
+
+void PpuImageCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+    
+    try {
+        if (!GameInfo) {
+            throw std::runtime_error("No game loaded");
+        }
+        
+        PpuImageResult result;
+        result.kind = kind;
+        result.index = index;
+        
+        if (kind == PpuImageKind::PatternTable) {
+            renderPatternTable(result);
+        } else {
+            renderNameTable(result);
+        }
+        
+        if (encodePng) {
+            uint8_t rgb[64 * 3];
+            std::vector<uint8_t> png;
+            
+            for (int i = 0; i < 64; i++) {
+                FCEUD_GetPalette(i, &rgb[i * 3], &rgb[i * 3 + 1], &rgb[i * 3 + 2]);
+            }
+            if (!imageEncoder.encodeIndexed(png, result.pixels.data(), result.width,
+                                            result.height, result.width, rgb, 64)) {
+                throw std::runtime_error("PNG encoding failed");
+            }
+            result.png.assign(png.begin(), png.end());
+        }
+        
+        FCEU_WRAPPER_UNLOCK();
+        
+        resultPromise.set_value(result);
+        
+    } catch (...) {
+        FCEU_WRAPPER_UNLOCK();
+        throw;
+    }
+}
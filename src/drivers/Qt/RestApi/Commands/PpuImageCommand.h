@@ -0,0 +1,82 @@
+#ifndef __PPU_IMAGE_COMMAND_H__
+#define __PPU_IMAGE_COMMAND_H__
+
+#include "../RestApiCommands.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief What a PPU image command renders
+ */
+enum class PpuImageKind {
+    PatternTable,  ///< 128x128, the 256 tiles of $0000 or $1000
+    NameTable      ///< 256x240, one name table with its attributes
+};
+
+/**
+ * @brief Result of a PPU image command
+ *
+ * pixels holds width * height NES color indices (0x00-0x3F), row by row,
+ * as looked up through palette RAM at the time of the read.
+ */
+struct PpuImageResult {
+    PpuImageKind kind;
+    int index;                    ///< Pattern table 0-1 or name table 0-3
+    int width;
+    int height;
+    std::vector<uint8_t> pixels;
+    std::string png;              ///< Indexed PNG, when asked for
+    
+    /**
+     * @brief The PNG encoded by the command, with the NES palette in use
+     */
+    std::string toPng() const { return png; }
+    
+    /**
+     * @brief The color indices, for application/octet-stream responses
+     */
+    std::string toBinary() const;
+};
+
+/**
+ * @brief Command to render a pattern table or name table from PPU memory
+ *
+ * Tiles are decoded through a CHRTileCache keyed by CHRPageVersion[], so
+ * repeated requests only decode the CHR pages that were switched or
+ * written since the last one. In MMC5 extended attribute mode every tile
+ * of a name table may come from a different bank; those are decoded on
+ * each request.
+ */
+class PpuImageCommand : public ApiCommandWithResult<PpuImageResult> {
+private:
+    PpuImageKind kind;
+    int index;
+    int palette;
+    bool encodePng;
+    
+    void renderPatternTable(PpuImageResult& result);
+    void renderNameTable(PpuImageResult& result);
+    
+public:
+    /**
+     * @brief Construct a PPU image command
+     * @param kind Pattern table or name table
+     * @param index Pattern table 0-1 or name table 0-3
+     * @param palette Palette 0-7 for pattern tables, ignored for name tables
+     * @param png Also encode the image as PNG
+     * @throws std::runtime_error if index or palette is out of range
+     */
+    PpuImageCommand(PpuImageKind kind, int index, int palette = 0, bool png = true);
+    
+    /**
+     * @brief Render, and encode, the image with the emulator mutex held
+     * @throws std::runtime_error if no game is loaded, the table is not
+     *         mapped or the PNG could not be encoded
+     */
+    void execute() override;
+    
+    const char* name() const override { return "PpuImageCommand"; }
+};
+
+#endif // __PPU_IMAGE_COMMAND_H__
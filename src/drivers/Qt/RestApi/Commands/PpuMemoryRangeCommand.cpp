@@ -1,6 +1,8 @@
 #include "PpuMemoryRangeCommand.h"
+#include "../Utils/BinaryResponse.h"
 #include "../../../../lib/json.hpp"
 #include "../../fceuWrapper.h"
+#include "../../EmuStateSnapshot.h"
 #include "../../../../fceu.h"
 #include "../../../../ppu.h"
 #include <sstream>
@@ -42,6 +44,31 @@ std::string PpuMemoryRangeResult::toJson() const {
     return result.dump();
 }
 
+std::string PpuMemoryRangeResult::toCbor() const {
+    std::string bytes = toBinary();
+    
+    CborWriter cbor;
+    cbor.beginMap(4);
+    cbor.writeText("start");
+    cbor.writeUInt(start);
+    cbor.writeText("length");
+    cbor.writeUInt(length);
+    cbor.writeText("data");
+    cbor.writeBytes(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+    cbor.writeText("region");
+    cbor.writeText(region);
+    return cbor.data();
+}
+
+std::string PpuMemoryRangeResult::toBinary() const {
+    std::string bytes;
+    bytes.reserve(values.size());
+    for (const auto& val : values) {
+        bytes.push_back(static_cast<char>(val.value));
+    }
+    return bytes;
+}
+
 std::string PpuMemoryRangeCommand::getPpuRegion(uint16_t address) {
     if (address < 0x2000) return "pattern_table";
     else if (address < 0x3000) return "nametable";
@@ -110,10 +137,13 @@ void PpuMemoryRangeCommand::execute() {
         // Reserve space for efficiency
         result.values.reserve(length);
         
-        // Read the PPU memory values
+        // Read the PPU memory values, a page at a time
+        std::vector<uint8> bytes(length);
+        FCEUPPU_ReadRange(startAddress, bytes.data(), length);
+
         for (uint16_t i = 0; i < length; i++) {
             uint16_t addr = startAddress + i;
-            uint8_t value = FFCEUX_PPURead(addr);
+            uint8_t value = bytes[i];
             
             PpuMemoryValue memVal;
             memVal.address = addr;
@@ -132,4 +162,28 @@ void PpuMemoryRangeCommand::execute() {
         FCEU_WRAPPER_UNLOCK();
         throw;
     }
+}
+
+bool PpuMemoryRangeCommand::readSnapshot(PpuMemoryRangeResult& result) const {
+    std::vector<uint8_t> bytes(length);
+
+    if (!emuStateSnapshotReadPpu(startAddress, length, bytes.data())) {
+        return false;
+    }
+    result.start = startAddress;
+    result.length = length;
+    result.region = getPpuRegion(startAddress);
+    result.description = getPpuDescription(startAddress);
+
+    result.values.reserve(length);
+
+    for (uint16_t i = 0; i < length; i++) {
+        PpuMemoryValue memVal;
+        memVal.address = startAddress + i;
+        memVal.value = bytes[i];
+        memVal.decimal = bytes[i];
+
+        result.values.push_back(memVal);
+    }
+    return true;
 }
\ No newline at end of file
@@ -41,6 +41,21 @@ struct PpuMemoryRangeResult {
      * @return JSON string representation
      */
     std::string toJson() const;
+    
+    /**
+     * @brief Convert the result to CBOR
+     * 
+     * Map with "start" and "length" as unsigned integers, "data" as a byte
+     * string and "region" as text.
+     * 
+     * @return Encoded CBOR bytes
+     */
+    std::string toCbor() const;
+    
+    /**
+     * @brief Raw memory bytes for application/octet-stream responses
+     */
+    std::string toBinary() const;
 };
 
 /**
@@ -110,6 +125,16 @@ public:
      */
     void execute() override;
     
+    /**
+     * @brief Answer from the published emulator state snapshot
+     * 
+     * Runs on the calling thread without the emulator mutex.
+     * 
+     * @param result Filled in when the snapshot holds the whole range
+     * @return false when it does not, execute() has to read it then
+     */
+    bool readSnapshot(PpuMemoryRangeResult& result) const;
+    
     /**
      * @brief Get the command name for logging
      * @return "PpuMemoryRangeCommand"
@@ -1,6 +1,7 @@
 #include "PpuMemoryReadCommand.h"
 #include "../../../../lib/json.hpp"
 #include "../../fceuWrapper.h"
+#include "../../EmuStateSnapshot.h"
 #include "../../../../fceu.h"
 #include "../../../../ppu.h"
 #include <sstream>
@@ -86,4 +87,14 @@ void PpuMemoryReadCommand::execute() {
         FCEU_WRAPPER_UNLOCK();
         throw;
     }
+}
+
+bool PpuMemoryReadCommand::readSnapshot(PpuMemoryReadResult& result) const {
+    if (!emuStateSnapshotReadPpu(address, 1, &result.value)) {
+        return false;
+    }
+    result.address = address;
+    result.region = getPpuRegion(address);
+    result.description = getPpuDescription(address);
+    return true;
 }
\ No newline at end of file
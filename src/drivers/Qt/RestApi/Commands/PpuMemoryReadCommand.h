@@ -97,6 +97,16 @@ public:
      */
     void execute() override;
     
+    /**
+     * @brief Answer from the published emulator state snapshot
+     * 
+     * Runs on the calling thread without the emulator mutex.
+     * 
+     * @param result Filled in when the snapshot holds the byte
+     * @return false when it does not, execute() has to read it then
+     */
+    bool readSnapshot(PpuMemoryReadResult& result) const;
+    
     /**
      * @brief Get the command name for logging
      * @return "PpuMemoryReadCommand"
@@ -0,0 +1,182 @@
+#include "RpcCommands.h"
+#include "InstanceCommands.h"
+#include "MemoryRangeCommands.h"
+#include "../InputTimeline.h"
+#include "../ObservationHub.h"
+#include "../Utils/StateStore.h"
+#include "../../fceuWrapper.h"
+#include "../../../../cheat.h"
+#include "../../../../fceu.h"
+#include "../../../../state.h"
+#include "../../../../emufile.h"
+#include "../../../../video.h"
+#include <zlib.h>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+extern int currFrameCounter;
+
+// Size of the frame buffer returned by a Frame operation
+static const size_t RPC_FRAME_BYTES = 256 * 240;
+
+static RpcResult rpcError(RpcOp op, RpcStatus status, const std::string& message) {
+    RpcResult result;
+    result.op = op;
+    result.status = status;
+    result.payload = message;
+    return result;
+}
+
+RpcBatchCommand::RpcBatchCommand(std::vector<RpcRequestOp>&& ops, StateStore& stateStore)
+    : operations(std::move(ops)), store(stateStore) {}
+
+RpcResult RpcBatchCommand::executeOp(const RpcRequestOp& op) {
+    RpcResult result;
+    result.op = op.op;
+
+    switch (op.op) {
+        case RpcOp::Read: {
+            if ((op.length == 0) || (op.length > MAX_MEMORY_RANGE_LENGTH) ||
+                (static_cast<uint32_t>(op.address) + op.length > 0x10000)) {
+                return rpcError(op.op, RpcStatus::BadRequest, "Invalid read range");
+            }
+            result.payload.resize(op.length);
+            for (uint16_t i = 0; i < op.length; i++) {
+                result.payload[i] = static_cast<char>(FCEU_CheatGetByte(op.address + i));
+            }
+            break;
+        }
+        case RpcOp::Write: {
+            if (op.data.empty() || (op.data.size() > MAX_MEMORY_RANGE_LENGTH)) {
+                return rpcError(op.op, RpcStatus::BadRequest, "Invalid write length");
+            }
+            MemoryRangeWriteCommand writeCmd(op.address, op.data);
+            if (!writeCmd.isWriteSafe(op.address, op.data.size())) {
+                return rpcError(op.op, RpcStatus::BadRequest, "Memory range is not safe to write");
+            }
+            for (size_t i = 0; i < op.data.size(); i++) {
+                FCEU_CheatSetByte(op.address + i, op.data[i]);
+            }
+            break;
+        }
+        case RpcOp::Input: {
+            // Held from the next frame read, same as a scheduled event at the current frame
+            InputTimelineEvent event;
+            event.frame = currFrameCounter;
+            event.frames = (op.frames > 0) ? op.frames : 1;
+            event.port = op.port;
+            event.buttons = op.buttons;
+
+            if (!InputTimeline::instance().schedule(event)) {
+                return rpcError(op.op, RpcStatus::Failed, "Input timeline full");
+            }
+            rpcAppendU32(result.payload, static_cast<uint32_t>(event.frame));
+            break;
+        }
+        case RpcOp::Snapshot: {
+            std::vector<uint8_t> data;
+            data.reserve(FCEUSS_SaveMSSizeHint());
+            EMUFILE_MEMORY em(&data);
+
+            if (!FCEUSS_SaveMS(&em, Z_NO_COMPRESSION)) {
+                return rpcError(op.op, RpcStatus::Failed, "Save state failed");
+            }
+            data.resize(em.size());
+            std::string handle = store.put(std::move(data));
+            if (handle.empty()) {
+                return rpcError(op.op, RpcStatus::Failed, "State is larger than the state store");
+            }
+            rpcAppendU64(result.payload, std::strtoull(handle.c_str(), nullptr, 16));
+            rpcAppendU32(result.payload, static_cast<uint32_t>(currFrameCounter));
+            break;
+        }
+        case RpcOp::Restore: {
+            char handle[17];
+            std::vector<uint8_t> data;
+
+            snprintf(handle, sizeof(handle), "%016llx", static_cast<unsigned long long>(op.handle));
+            if (!store.get(handle, data)) {
+                return rpcError(op.op, RpcStatus::Failed, "Unknown state handle");
+            }
+            EMUFILE_MEMORY is(&data);
+            if (!FCEUSS_LoadFP(&is, SSLOADPARAM_NOBACKUP)) {
+                return rpcError(op.op, RpcStatus::Failed, "State does not load into this game");
+            }
+            rpcAppendU32(result.payload, static_cast<uint32_t>(currFrameCounter));
+            break;
+        }
+        case RpcOp::Frame: {
+            if (XBuf == nullptr) {
+                return rpcError(op.op, RpcStatus::Failed, "No frame available");
+            }
+            // Palette indices of the last emulated frame, as /api/stream/frames sends them
+            result.payload.reserve(4 + RPC_FRAME_BYTES);
+            rpcAppendU32(result.payload, static_cast<uint32_t>(currFrameCounter));
+            result.payload.append(reinterpret_cast<const char*>(XBuf), RPC_FRAME_BYTES);
+            break;
+        }
+        case RpcOp::StepBatch: {
+            static const unsigned int scales[] = {0, 1, 2, 4};
+            InstanceBatchLayout layout;
+            layout.ram = (op.flags & RPC_BATCH_RAM) != 0;
+            layout.frameScale = scales[(op.flags & RPC_BATCH_SCALE_MASK) >> RPC_BATCH_SCALE_SHIFT];
+
+            if ((op.frames < 1) || (op.frames > MAX_INSTANCE_FRAMESKIP)) {
+                return rpcError(op.op, RpcStatus::BadRequest, "Frameskip must be 1 to 60");
+            }
+            if (layout.size() == 0) {
+                return rpcError(op.op, RpcStatus::BadRequest, "Observation is empty");
+            }
+
+            std::vector<unsigned int> ids(op.ids.begin(), op.ids.end());
+            std::vector<uint8_t> observations;
+            try {
+                runInstanceBatch(ids, op.data, op.frames, layout, observations);
+            } catch (const std::exception& e) {
+                return rpcError(op.op, RpcStatus::Failed, e.what());
+            }
+            // Observations back to back, as POST /api/instances/step_batch returns them
+            result.payload.reserve(4 + observations.size());
+            rpcAppendU32(result.payload, static_cast<uint32_t>(layout.size()));
+            result.payload.append(reinterpret_cast<const char*>(observations.data()), observations.size());
+            break;
+        }
+        case RpcOp::Observation: {
+            std::vector<uint8_t> data;
+            ObservationSpec spec;
+            int frame = 0;
+
+            if (!ObservationHub::instance().read(data, frame, spec)) {
+                return rpcError(op.op, RpcStatus::Failed, "No observation available");
+            }
+            result.payload.reserve(4 + data.size());
+            rpcAppendU32(result.payload, static_cast<uint32_t>(frame));
+            result.payload.append(reinterpret_cast<const char*>(data.data()), data.size());
+            break;
+        }
+        default:
+            return rpcError(op.op, RpcStatus::BadRequest, "Operation not allowed in a batch");
+    }
+    return result;
+}
+
+void RpcBatchCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+
+    if (GameInfo == nullptr) {
+        FCEU_WRAPPER_UNLOCK();
+        throw std::runtime_error("No game loaded");
+    }
+
+    RpcBatchResult result;
+    result.results.reserve(operations.size());
+
+    for (const auto& op : operations) {
+        result.results.push_back(executeOp(op));
+    }
+
+    FCEU_WRAPPER_UNLOCK();
+
+    resultPromise.set_value(result);
+}
@@ -0,0 +1,43 @@
+#ifndef __RPC_COMMANDS_H__
+#define __RPC_COMMANDS_H__
+
+#include "../RestApiCommands.h"
+#include "../Utils/BinaryRpc.h"
+#include <vector>
+
+class StateStore;
+
+/**
+ * @brief Results of a run of binary RPC operations
+ */
+struct RpcBatchResult {
+    std::vector<RpcResult> results;     ///< One per operation, in order
+};
+
+/**
+ * @brief Command to run binary RPC operations on the emulator thread
+ *
+ * Runs every operation except Step, which needs frames to pass, under one
+ * emulator mutex lock, so the run sees a single consistent frame. The
+ * server splits a request into runs around its steps. Operations fail on
+ * their own, a failed one does not stop the rest.
+ */
+class RpcBatchCommand : public ApiCommandWithResult<RpcBatchResult> {
+private:
+    std::vector<RpcRequestOp> operations;
+    StateStore& store;
+
+    RpcResult executeOp(const RpcRequestOp& op);
+
+public:
+    RpcBatchCommand(std::vector<RpcRequestOp>&& ops, StateStore& stateStore);
+
+    /**
+     * @throws std::runtime_error if no game is loaded
+     */
+    void execute() override;
+
+    const char* name() const override { return "RpcBatchCommand"; }
+};
+
+#endif // __RPC_COMMANDS_H__
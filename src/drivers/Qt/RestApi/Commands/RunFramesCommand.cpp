@@ -0,0 +1,156 @@
+#include "RunFramesCommand.h"
+#include "../InputApi.h"
+#include "../../fceuWrapper.h"
+#include "../../../../fceu.h"
+#include "../../../../driver.h"
+#include "../../../../cheat.h"
+#include "../../../../input.h"
+#include "../../../../movie.h"
+#include <QByteArray>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+// RunFramesResult implementation
+
+std::string RunFramesResult::toJson() const {
+    std::ostringstream json;
+    json << "{";
+
+    json << "\"start_frame\":" << startFrame << ",";
+    json << "\"end_frame\":" << endFrame << ",";
+    json << "\"frames_run\":" << frames.size() << ",";
+    json << "\"lag_frames\":" << lagFrames << ",";
+
+    // Ranges, so the client can match samples to addresses
+    json << "\"ranges\":[";
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (i > 0) json << ",";
+        json << "{\"start\":\"0x"
+             << std::hex << std::setfill('0') << std::setw(4)
+             << ranges[i].start << "\","
+             << "\"length\":" << std::dec << ranges[i].length << "}";
+    }
+    json << "],";
+
+    json << "\"observations\":[";
+    for (size_t i = 0; i < frames.size(); i++) {
+        const RunFrameObservation& obs = frames[i];
+
+        if (i > 0) json << ",";
+        json << "{\"frame\":" << obs.frame << ",";
+        json << "\"lag\":" << (obs.lag ? "true" : "false") << ",";
+        json << "\"samples\":[";
+
+        size_t offset = 0;
+        for (size_t r = 0; r < ranges.size(); r++) {
+            if (r > 0) json << ",";
+            QByteArray byteArray(reinterpret_cast<const char*>(obs.samples.data()) + offset,
+                                 ranges[r].length);
+            json << "\"" << byteArray.toBase64().toStdString() << "\"";
+            offset += ranges[r].length;
+        }
+        json << "]}";
+    }
+    json << "]";
+
+    json << "}";
+    return json.str();
+}
+
+// RunFramesCommand implementation
+
+RunFramesCommand::RunFramesCommand(const std::vector<RunFrameInput>& frameInputs,
+                                   const std::vector<RunSampleRange>& sampleRanges)
+    : inputs(frameInputs), ranges(sampleRanges) {
+    if (inputs.empty()) {
+        throw std::runtime_error("Frame list must not be empty");
+    }
+    if (inputs.size() > MAX_RUN_FRAMES) {
+        throw std::runtime_error("Frame count exceeds maximum allowed (3600 frames)");
+    }
+    if (ranges.size() > MAX_RUN_SAMPLE_RANGES) {
+        throw std::runtime_error("Sample range count exceeds maximum allowed (16 ranges)");
+    }
+
+    size_t totalBytes = 0;
+    for (const auto& range : ranges) {
+        if (range.length == 0) {
+            throw std::runtime_error("Length must be greater than 0");
+        }
+        if (static_cast<uint32_t>(range.start) + range.length > 0x10000) {
+            throw std::runtime_error("Address range exceeds memory bounds");
+        }
+        totalBytes += range.length;
+    }
+    if (totalBytes > MAX_RUN_SAMPLE_BYTES) {
+        throw std::runtime_error("Sample size exceeds maximum allowed (4096 bytes per frame)");
+    }
+}
+
+void RunFramesCommand::execute() {
+    FCEU_WRAPPER_LOCK();
+
+    if (GameInfo == nullptr) {
+        FCEU_WRAPPER_UNLOCK();
+        throw std::runtime_error("No game loaded");
+    }
+
+    size_t bytesPerFrame = 0;
+    for (const auto& range : ranges) {
+        bytesPerFrame += range.length;
+    }
+
+    RunFramesResult result;
+    result.startFrame = currFrameCounter;
+    result.ranges = ranges;
+    result.frames.reserve(inputs.size());
+
+    unsigned int lagStart = lagCounter;
+
+    // The run drives the core itself, lift the pause for its duration
+    int savedPaused = EmulationPaused;
+    EmulationPaused = 0;
+
+    for (const auto& input : inputs) {
+        // The overlay is consumed when the frame reads the pads, so set
+        // the exact state: force the given buttons on and the rest off
+        for (int port = 0; port < 2; port++) {
+            FCEU_ApiClearJoypad(port);
+            FCEU_ApiSetJoypad(port, input.ports[port], true);
+            FCEU_ApiSetJoypad(port, static_cast<uint8_t>(~input.ports[port]), false);
+        }
+
+        uint8 *gfx = nullptr;
+        int32 *sound = nullptr;
+        int32 ssize = 0;
+
+        // Skip video and sound output, only the machine state matters here
+        FCEUI_Emulate(&gfx, &sound, &ssize, 2);
+
+        RunFrameObservation obs;
+        obs.frame = currFrameCounter;
+        obs.lag = (lagFlag != 0);
+        obs.samples.reserve(bytesPerFrame);
+
+        for (const auto& range : ranges) {
+            for (uint32_t i = 0; i < range.length; i++) {
+                obs.samples.push_back(FCEU_CheatGetByte(range.start + i));
+            }
+        }
+        result.frames.push_back(std::move(obs));
+    }
+
+    // Ports not read during a frame would otherwise keep the last state
+    FCEU_ApiClearJoypad(0);
+    FCEU_ApiClearJoypad(1);
+
+    EmulationPaused = savedPaused;
+
+    result.endFrame = currFrameCounter;
+    result.lagFrames = lagCounter - lagStart;
+
+    FCEU_WRAPPER_UNLOCK();
+
+    resultPromise.set_value(result);
+}
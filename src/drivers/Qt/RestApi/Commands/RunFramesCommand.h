@@ -0,0 +1,110 @@
+#ifndef __RUN_FRAMES_COMMAND_H__
+#define __RUN_FRAMES_COMMAND_H__
+
+#include "../RestApiCommands.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Maximum number of frames a single run request may advance
+ *
+ * The whole run executes inside one emulator-thread command, so this bounds
+ * how long the GUI and the rest of the command queue are held off.
+ */
+const size_t MAX_RUN_FRAMES = 3600;
+
+/**
+ * @brief Maximum number of memory ranges sampled per frame
+ */
+const size_t MAX_RUN_SAMPLE_RANGES = 16;
+
+/**
+ * @brief Maximum total bytes sampled per frame across all ranges
+ */
+const size_t MAX_RUN_SAMPLE_BYTES = 4096;
+
+/**
+ * @brief Joypad state for one frame of a run
+ */
+struct RunFrameInput {
+    uint8_t ports[2];   ///< Button bitmask for ports 1 and 2 (JOY_* bits)
+};
+
+/**
+ * @brief Memory range sampled after every frame of a run
+ */
+struct RunSampleRange {
+    uint16_t start;     ///< Starting CPU address
+    uint16_t length;    ///< Number of bytes
+};
+
+/**
+ * @brief Observation recorded after one emulated frame
+ */
+struct RunFrameObservation {
+    int frame;                      ///< Frame counter after the frame ran
+    bool lag;                       ///< True if the game did not poll input
+    std::vector<uint8_t> samples;   ///< Sampled bytes, ranges back to back
+};
+
+/**
+ * @brief Result of a multi-frame run
+ */
+struct RunFramesResult {
+    int startFrame;                             ///< Frame counter before the run
+    int endFrame;                               ///< Frame counter after the run
+    unsigned int lagFrames;                     ///< Lag frames during the run
+    std::vector<RunSampleRange> ranges;         ///< Ranges in sample order
+    std::vector<RunFrameObservation> frames;    ///< One entry per frame
+
+    /**
+     * @brief Convert the result to JSON string
+     *
+     * Each observation carries one base64 string per requested range, in
+     * the order the ranges were given.
+     *
+     * @return JSON string representation
+     */
+    std::string toJson() const;
+};
+
+/**
+ * @brief Command to run a sequence of frames with scripted input
+ *
+ * Applies the joypad state for each frame through the API input overlay,
+ * emulates the frame and samples the requested memory ranges, all in one
+ * emulator-thread command. The run proceeds even if emulation is paused;
+ * the pause state is restored afterwards. Sound and video output are
+ * skipped for the frames of the run.
+ */
+class RunFramesCommand : public ApiCommandWithResult<RunFramesResult> {
+private:
+    std::vector<RunFrameInput> inputs;     ///< Per-frame joypad states
+    std::vector<RunSampleRange> ranges;    ///< Ranges sampled after each frame
+
+public:
+    /**
+     * @brief Construct a run command
+     * @param frameInputs Joypad state for each frame to run
+     * @param sampleRanges Memory ranges to sample after each frame
+     * @throws std::runtime_error if frame count or ranges exceed limits
+     */
+    RunFramesCommand(const std::vector<RunFrameInput>& frameInputs,
+                     const std::vector<RunSampleRange>& sampleRanges);
+
+    /**
+     * @brief Execute the run
+     *
+     * @throws std::runtime_error if no game loaded
+     */
+    void execute() override;
+
+    /**
+     * @brief Get the command name for logging
+     * @return "RunFramesCommand"
+     */
+    const char* name() const override { return "RunFramesCommand"; }
+};
+
+#endif // __RUN_FRAMES_COMMAND_H__
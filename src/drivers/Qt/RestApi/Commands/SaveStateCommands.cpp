@@ -1,7 +1,10 @@
 #include "SaveStateCommands.h"
+#include "../Utils/StateStore.h"
 #include "../../fceuWrapper.h"
 #include "../../../../state.h"
 #include "../../../../fceu.h"
+#include "../../../../emufile.h"
+#include <zlib.h>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
@@ -163,4 +166,71 @@ void ListSaveStatesCommand::execute() {
     printf("ListSaveStatesCommand: Listing save states (not fully implemented)\n");
     
     resultPromise.set_value(result);
-}
\ No newline at end of file
+}
+
+void StateSnapshotCommand::execute() {
+    if (!ensureGameLoaded()) {
+        return;
+    }
+
+    StateHandleResult result;
+    std::vector<uint8_t> data;
+
+    data.reserve(FCEUSS_SaveMSSizeHint());
+
+    FCEU_WRAPPER_LOCK();
+
+    EMUFILE_MEMORY em(&data);
+    bool saved = FCEUSS_SaveMS(&em, Z_NO_COMPRESSION);
+    result.frame = currFrameCounter;
+
+    FCEU_WRAPPER_UNLOCK();
+
+    if (!saved) {
+        setError("Save state failed");
+        return;
+    }
+    data.resize(em.size());
+    result.size = data.size();
+    result.handle = store.put(std::move(data));
+
+    if (result.handle.empty()) {
+        setError("State is larger than the state store");
+        return;
+    }
+    result.success = true;
+
+    resultPromise.set_value(result);
+}
+
+void StateRestoreCommand::execute() {
+    if (!ensureGameLoaded()) {
+        return;
+    }
+
+    StateHandleResult result;
+    std::vector<uint8_t> data;
+
+    if (!store.get(handle, data)) {
+        setError("Unknown state handle");
+        return;
+    }
+
+    FCEU_WRAPPER_LOCK();
+
+    EMUFILE_MEMORY is(&data);
+    bool loaded = FCEUSS_LoadFP(&is, SSLOADPARAM_NOBACKUP);
+    result.frame = currFrameCounter;
+
+    FCEU_WRAPPER_UNLOCK();
+
+    if (!loaded) {
+        setError("State does not load into this game");
+        return;
+    }
+    result.success = true;
+    result.handle = handle;
+    result.size = data.size();
+
+    resultPromise.set_value(result);
+}
@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+class StateStore;
+
 // Command to save current emulation state
 class SaveStateCommand : public BaseMediaCommand<SaveStateResult> {
 private:
@@ -53,4 +55,65 @@ protected:
     void execute() override;
 };
 
+/**
+ * @brief Result of taking or restoring an in-memory state
+ */
+struct StateHandleResult : public MediaResult {
+    std::string handle;
+    size_t size;
+    int frame;          // Frame counter after the operation
+
+    StateHandleResult() : size(0), frame(0) {}
+
+    std::string toJson() const override {
+        json j;
+        addCommonFields(j);
+
+        if (success) {
+            j["handle"] = handle;
+            j["size"] = size;
+            j["frame"] = frame;
+        }
+
+        return j.dump();
+    }
+};
+
+/**
+ * @brief Command to save the current state into the state store
+ *
+ * The state is an uncompressed FCEUX savestate, the same bytes a .fc0
+ * file holds, and never touches the disk.
+ */
+class StateSnapshotCommand : public BaseMediaCommand<StateHandleResult> {
+private:
+    StateStore& store;
+
+public:
+    explicit StateSnapshotCommand(StateStore& stateStore) : store(stateStore) {}
+
+    const char* name() const override { return "StateSnapshotCommand"; }
+
+protected:
+    void execute() override;
+};
+
+/**
+ * @brief Command to load a state of the state store by its handle
+ */
+class StateRestoreCommand : public BaseMediaCommand<StateHandleResult> {
+private:
+    StateStore& store;
+    std::string handle;
+
+public:
+    StateRestoreCommand(StateStore& stateStore, const std::string& stateHandle)
+        : store(stateStore), handle(stateHandle) {}
+
+    const char* name() const override { return "StateRestoreCommand"; }
+
+protected:
+    void execute() override;
+};
+
 #endif // __SAVE_STATE_COMMANDS_H__
\ No newline at end of file
@@ -3,6 +3,10 @@
 #include "../../../../video.h"
 #include "../../../../driver.h"
 #include "../../../../fceu.h"
+#include "../../../../movie.h"
+#include "../../../../framehash.h"
+#include "../../../../capture.h"
+#include "../../ConsoleUtilities.h"
 #include <QImage>
 #include <QBuffer>
 #include <QByteArray>
@@ -13,6 +17,7 @@
 #include <sstream>
 #include <iomanip>
 #include <cstring>
+#include <vector>
 
 // Static members for tracking last screenshot
 std::string LastScreenshotCommand::lastScreenshotPath;
@@ -66,34 +71,40 @@ void ScreenshotCommand::captureToBase64(ScreenshotResult& result) {
     const int width = 256;
     const int height = 240;
     
-    // Create QImage with RGB32 format
-    QImage image(width, height, QImage::Format_RGB32);
-    
-    // Get pixel data from XBuf and palette
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            uint8 pixel = XBuf[y * 256 + x];
-            uint8 r, g, b;
-            FCEUD_GetPalette(pixel, &r, &g, &b);
-            image.setPixel(x, y, qRgb(r, g, b));
-        }
-    }
-    
-    // Convert to requested format
     QByteArray imageData;
-    QBuffer buffer(&imageData);
-    buffer.open(QIODevice::WriteOnly);
-    
     bool saved = false;
-    if (format == "png") {
-        saved = image.save(&buffer, "PNG");
-    } else if (format == "jpg" || format == "jpeg") {
-        saved = image.save(&buffer, "JPEG", 90); // 90% quality
-    } else if (format == "bmp") {
-        saved = image.save(&buffer, "BMP");
+
+    if (format != "jpg" && format != "jpeg" && format != "bmp") {
+        // PNG goes through the core's indexed encoder, same as the
+        // screenshot hotkey. Anything else defaults to PNG as well.
+        std::vector<uint8> png;
+
+        saved = FCEU_EncodeSnapshotPNG(png, 0, height - 1);
+        if (saved) {
+            imageData = QByteArray(reinterpret_cast<const char*>(png.data()), (int)png.size());
+        }
     } else {
-        // Default to PNG
-        saved = image.save(&buffer, "PNG");
+        // Create QImage with RGB32 format
+        QImage image(width, height, QImage::Format_RGB32);
+        
+        // Get pixel data from XBuf and palette
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                uint8 pixel = XBuf[y * 256 + x];
+                uint8 r, g, b;
+                FCEUD_GetPalette(pixel, &r, &g, &b);
+                image.setPixel(x, y, qRgb(r, g, b));
+            }
+        }
+        
+        QBuffer buffer(&imageData);
+        buffer.open(QIODevice::WriteOnly);
+        
+        if (format == "bmp") {
+            saved = image.save(&buffer, "BMP");
+        } else {
+            saved = image.save(&buffer, "JPEG", 90); // 90% quality
+        }
     }
     
     if (saved) {
@@ -131,6 +142,70 @@ void ScreenshotCommand::execute() {
     resultPromise.set_value(result);
 }
 
+ScreenHashCommand::ScreenHashCommand(bool withPerceptual, const uint64_t* compareTo)
+    : perceptual(withPerceptual || compareTo != nullptr),
+      compare(compareTo != nullptr),
+      compareHash(compareTo ? *compareTo : 0)
+{
+}
+
+void ScreenHashCommand::execute() {
+    if (!ensureGameLoaded()) {
+        return;
+    }
+    
+    ScreenHashResult result;
+    uint64 exact = 0, phash = 0;
+    
+    FCEU_WRAPPER_LOCK();
+    result.success = FCEUI_GetFrameHash(&exact, perceptual ? &phash : nullptr);
+    result.frame = FCEUMOV_GetFrame();
+    FCEU_WRAPPER_UNLOCK();
+    
+    if (result.success) {
+        result.exact = exact;
+        result.perceptual = phash;
+        result.hasPerceptual = perceptual;
+        if (compare) {
+            result.distance = FCEUI_FrameHashDistance(phash, compareHash);
+        }
+    } else {
+        result.error = "Video buffer not available";
+    }
+    
+    resultPromise.set_value(result);
+}
+
+InstantReplayCommand::InstantReplayCommand(const std::string& savePath)
+    : path(savePath)
+{
+}
+
+void InstantReplayCommand::execute() {
+    if (!ensureGameLoaded()) {
+        return;
+    }
+    
+    InstantReplayResult result;
+    
+    FCEU_WRAPPER_LOCK();
+    if (FCEUI_GetInstantReplay() <= 0) {
+        result.error = "Instant replay is off";
+    } else if (FCEUI_InstantReplaySaving()) {
+        result.error = "The last instant replay is still being saved";
+    } else {
+        result.path = path.empty() ? fceuInstantReplayFileName() : path;
+        result.frames = FCEUI_InstantReplayFrames();
+        result.success = FCEUI_SaveInstantReplay(result.path.c_str());
+        if (!result.success) {
+            result.error = "Nothing recorded yet";
+        }
+    }
+    FCEU_WRAPPER_UNLOCK();
+    
+    resultPromise.set_value(result);
+}
+
 void LastScreenshotCommand::execute() {
     ScreenshotResult result;
     
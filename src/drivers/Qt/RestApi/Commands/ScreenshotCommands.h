@@ -52,6 +52,47 @@ public:
     const char* name() const override { return "ScreenshotCommand"; }
 };
 
+/**
+ * @brief Command to hash the current screen
+ *
+ * Cheap alternative to a screenshot for checking whether the screen
+ * matches a known state, see framehash.h for the hashes.
+ */
+class ScreenHashCommand : public BaseMediaCommand<ScreenHashResult> {
+private:
+    bool perceptual;        // also compute the perceptual hash
+    bool compare;           // compute the distance to compareHash
+    uint64_t compareHash;
+    
+public:
+    /**
+     * @brief Constructor
+     * @param withPerceptual Compute the perceptual hash as well
+     * @param compareTo Perceptual hash to measure the distance to, or NULL
+     */
+    ScreenHashCommand(bool withPerceptual = true, const uint64_t* compareTo = nullptr);
+    
+    void execute() override;
+    const char* name() const override { return "ScreenHashCommand"; }
+};
+
+/**
+ * @brief Command to save the last seconds of play kept in memory
+ *
+ * Writes the instant replay ring as an indexed capture (see capture.h),
+ * on a background thread.
+ */
+class InstantReplayCommand : public BaseMediaCommand<InstantReplayResult> {
+private:
+    std::string path;       // "" for one under <base dir>/replays
+    
+public:
+    InstantReplayCommand(const std::string& savePath = "");
+    
+    void execute() override;
+    const char* name() const override { return "InstantReplayCommand"; }
+};
+
 /**
  * @brief Command to get information about the last screenshot
  */
@@ -0,0 +1,65 @@
+#include "TasEditorCommands.h"
+#include "Qt/TasEditor/snapshot.h"
+#include "Qt/TasEditor/taseditor_lua.h"
+#include "../../../../fceu.h"
+#include "../../../../movie.h"
+#include <sstream>
+#include <stdexcept>
+
+extern TASEDITOR_LUA *taseditor_lua;
+
+// TasEditorInputResult implementation
+
+std::string TasEditorInputResult::toJson() const {
+    std::ostringstream json;
+    json << "{";
+    json << "\"success\":true,";
+    json << "\"first_change\":" << firstChange << ",";
+    json << "\"movie_length\":" << movieLength;
+    json << "}";
+    return json.str();
+}
+
+// TasEditorSetInputCommand implementation
+
+TasEditorSetInputCommand::TasEditorSetInputCommand(int frame,
+        const std::vector<TasEditorInputColumn>& inputColumns, const std::string& name)
+    : startFrame(frame), columns(inputColumns), caption(name)
+{
+    if (startFrame < 0) {
+        throw std::runtime_error("Frame must not be negative");
+    }
+    if (columns.empty()) {
+        throw std::runtime_error("No input columns given");
+    }
+    for (const auto& column : columns) {
+        if ((column.joypad < 0) || (column.joypad > 4)) {
+            throw std::runtime_error("Joypad must be between 0 and 4");
+        }
+        if (column.data.size() > MAX_TASEDITOR_INPUT_FRAMES) {
+            throw std::runtime_error("Frame count exceeds maximum allowed (1000000 frames)");
+        }
+    }
+}
+
+void TasEditorSetInputCommand::execute() {
+    if (!GameInfo) {
+        throw std::runtime_error("No game loaded");
+    }
+    if ((taseditor_lua == nullptr) || !FCEUMOV_Mode(MOVIEMODE_TASEDITOR)) {
+        throw std::runtime_error("TAS Editor is not open");
+    }
+
+    std::vector<int> joypads;
+    std::vector<std::vector<uint8_t>> data;
+    for (auto& column : columns) {
+        joypads.push_back(column.joypad);
+        data.push_back(std::move(column.data));
+    }
+
+    TasEditorInputResult result;
+    result.firstChange = taseditor_lua->setinputrange(startFrame, joypads, data, caption.c_str());
+    result.movieLength = currMovieData.getNumRecords();
+
+    resultPromise.set_value(result);
+}
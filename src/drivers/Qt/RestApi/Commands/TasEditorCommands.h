@@ -0,0 +1,73 @@
+#ifndef __TAS_EDITOR_COMMANDS_H__
+#define __TAS_EDITOR_COMMANDS_H__
+
+#include "../RestApiCommands.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Maximum number of frames a single input write may cover
+ */
+const size_t MAX_TASEDITOR_INPUT_FRAMES = 1000000;
+
+/**
+ * @brief One column of TAS Editor input, one byte per frame
+ */
+struct TasEditorInputColumn {
+    int joypad;                 ///< 0 = commands, 1-4 = players (as in the taseditor Lua library)
+    std::vector<uint8_t> data;  ///< Button bitmask (JOY_* bits) or command bits per frame
+};
+
+/**
+ * @brief Result of a TAS Editor input write
+ */
+struct TasEditorInputResult {
+    int firstChange;    ///< First frame that changed, -1 if the input was already there
+    int movieLength;    ///< Number of frames in the movie afterwards
+
+    /**
+     * @brief Convert to JSON string
+     * @return JSON representation of the result
+     */
+    std::string toJson() const;
+};
+
+/**
+ * @brief Command to write a range of input into the TAS Editor project
+ *
+ * All columns are written in one go and registered as a single History
+ * entry, then the Greenzone is invalidated once from the first changed
+ * frame. The movie is extended when the range runs past its end.
+ */
+class TasEditorSetInputCommand : public ApiCommandWithResult<TasEditorInputResult> {
+private:
+    int startFrame;
+    std::vector<TasEditorInputColumn> columns;
+    std::string caption;
+
+public:
+    /**
+     * @brief Construct an input write command
+     * @param frame First frame to write
+     * @param inputColumns Columns to write, each starting at frame
+     * @param name History caption, empty for the default one
+     */
+    TasEditorSetInputCommand(int frame, const std::vector<TasEditorInputColumn>& inputColumns,
+                             const std::string& name);
+
+    /**
+     * @brief Execute the write
+     *
+     * @throws std::runtime_error if no game loaded or TAS Editor is not open
+     */
+    void execute() override;
+
+    /**
+     * @brief Get the command name for logging
+     * @return "TasEditorSetInputCommand"
+     */
+    const char* name() const override { return "TasEditorSetInputCommand"; }
+};
+
+#endif // __TAS_EDITOR_COMMANDS_H__
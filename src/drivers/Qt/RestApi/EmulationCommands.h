@@ -2,6 +2,7 @@
 #define __EMULATION_COMMANDS_H__
 
 #include "RestApiCommands.h"
+#include "FrameClock.h"
 #include "../../../fceu.h"
 #include "../../../movie.h"
 #include "../../../driver.h"
@@ -128,4 +129,113 @@ public:
     }
 };
 
+/**
+ * @brief Frame ids of a step that was started
+ */
+struct StepStart {
+    uint64_t frameId;   ///< Last completed frame when the step began
+    uint64_t targetId;  ///< Frame id the step completes at
+};
+
+/**
+ * @brief Command to run a number of frames from the emulator loop
+ *
+ * Unlike RunFramesCommand the frames are not emulated inside the command,
+ * the normal loop runs them at the current speed and FrameClock completes
+ * the step promise once the last one is done. A paused emulator is
+ * unpaused for the step and paused again right after it, before the next
+ * frame starts. With untilInput the step ends early, at the first frame
+ * that reads the controllers.
+ */
+class StepCommand : public ApiCommandWithResult<StepStart> {
+public:
+    StepCommand(unsigned int frames, std::promise<FrameClockTick>&& done, bool untilInput = false)
+        : frames(frames), done(std::move(done)), untilInput(untilInput) {}
+
+    void execute() override {
+        if (!GameInfo) {
+            throw std::runtime_error("No game loaded");
+        }
+        bool paused = FCEUI_EmulationPaused() != 0;
+
+        StepStart start;
+        start.frameId = FrameClock::instance().currentId();
+        start.targetId = FrameClock::instance().addStep(frames, std::move(done), paused, untilInput);
+
+        if (paused) {
+            FCEUI_SetEmulationPaused(0);
+        }
+        resultPromise.set_value(start);
+    }
+
+    const char* name() const override {
+        return "StepCommand";
+    }
+
+private:
+    unsigned int frames;
+    std::promise<FrameClockTick> done;
+    bool untilInput;
+};
+
+/**
+ * @brief Result of a movie seek
+ */
+struct MovieSeekResult {
+    int frame;      ///< Movie frame after the seek
+    int replayed;   ///< Frames emulated to get there
+
+    /**
+     * @brief Convert to JSON string
+     * @return JSON representation of the result
+     */
+    std::string toJson() const {
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\":true,";
+        json << "\"frame\":" << frame << ",";
+        json << "\"frames_replayed\":" << replayed;
+        json << "}";
+        return json.str();
+    }
+};
+
+/**
+ * @brief Command to move movie playback to a frame
+ *
+ * Restores the nearest seek index snapshot before the frame (see
+ * FCEUMOV_SetSeekIndex) or goes on from the current frame, then replays
+ * the movie input without video or sound output.
+ */
+class MovieSeekCommand : public ApiCommandWithResult<MovieSeekResult> {
+private:
+    int targetFrame;
+
+public:
+    explicit MovieSeekCommand(int frame) : targetFrame(frame) {}
+
+    void execute() override {
+        if (!GameInfo) {
+            throw std::runtime_error("No game loaded");
+        }
+        if (!FCEUMOV_IsPlaying()) {
+            throw std::runtime_error("No movie playing");
+        }
+
+        int replayed = FCEUMOV_SeekToFrame(targetFrame);
+        if (replayed < 0) {
+            throw std::runtime_error("Frame cannot be reached");
+        }
+
+        MovieSeekResult result;
+        result.frame = currFrameCounter;
+        result.replayed = replayed;
+        resultPromise.set_value(result);
+    }
+
+    const char* name() const override {
+        return "MovieSeekCommand";
+    }
+};
+
 #endif // __EMULATION_COMMANDS_H__
\ No newline at end of file
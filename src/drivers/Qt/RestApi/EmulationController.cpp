@@ -2,13 +2,79 @@
 #include "EmulationCommands.h"
 #include "CommandQueue.h"
 #include "CommandExecution.h"
+#include "FrameClock.h"
+#include "Commands/InputCommands.h"
+#include "Commands/RunFramesCommand.h"
+#include "Commands/TasEditorCommands.h"
+#include "Utils/AddressParser.h"
+#include "../throttle.h"
+#include "../dface.h"
 #include "../../../lib/httplib.h"
+#include "../../../lib/json.hpp"
+#include <QByteArray>
+#include <QString>
+#include <chrono>
 #include <memory>
 #include <sstream>
 
+using json = nlohmann::json;
+
 // Timeout for command execution (2 seconds)
 static constexpr unsigned int COMMAND_TIMEOUT_MS = 2000;
 
+// Extra time allowed per frame of a run, well above real emulation cost
+static constexpr unsigned int RUN_FRAME_TIMEOUT_MS = 5;
+
+// Extra time allowed per frame a seek may have to replay
+static constexpr unsigned int SEEK_FRAME_TIMEOUT_MS = 1;
+
+// Extra time allowed per thousand frames of TAS Editor input
+static constexpr unsigned int TASEDITOR_KFRAME_TIMEOUT_MS = 5;
+
+// Stepped frames run at the emulation speed, this covers down to 1/3 speed
+static constexpr unsigned int STEP_FRAME_TIMEOUT_MS = 50;
+
+// One minute of frames per step
+static constexpr unsigned long MAX_STEP_FRAMES = 3600;
+
+// Longest frame long-poll
+static constexpr unsigned long MAX_FRAME_WAIT_MS = 30000;
+
+static constexpr unsigned long DEFAULT_FRAME_WAIT_MS = 1000;
+
+// Parse an unsigned decimal query parameter
+static uint64_t parseQueryNumber(const httplib::Request& req, const char* key) {
+    const std::string value = req.get_param_value(key);
+
+    if (value.empty() || (value.find_first_not_of("0123456789") != std::string::npos)) {
+        throw std::invalid_argument(std::string("Invalid '") + key + "'");
+    }
+    try {
+        return std::stoull(value);
+    } catch (const std::exception&) {
+        throw std::invalid_argument(std::string("Invalid '") + key + "'");
+    }
+}
+
+// Parse a button name array, missing means no buttons held
+static uint8_t parseRunButtons(const json& frame, const char* key) {
+    if (!frame.contains(key)) {
+        return 0;
+    }
+    if (!frame[key].is_array()) {
+        throw std::runtime_error(std::string("Invalid '") + key + "' array");
+    }
+
+    std::vector<std::string> buttons;
+    for (const auto& btn : frame[key]) {
+        if (!btn.is_string()) {
+            throw std::runtime_error("Button names must be strings");
+        }
+        buttons.push_back(btn.get<std::string>());
+    }
+    return buttonNamesToBitmask(buttons);
+}
+
 std::string EmulationController::createErrorResponse(const std::string& error) {
     std::ostringstream json;
     json << "{";
@@ -105,4 +171,409 @@ void EmulationController::handleStatus(const httplib::Request& req, httplib::Res
         res.status = 500;
         res.set_content(createErrorResponse(e.what()), "application/json");
     }
-}
\ No newline at end of file
+}
+
+void EmulationController::handleTiming(const httplib::Request& req, httplib::Response& res) {
+    struct frameTimingStat_t stats;
+    json response;
+
+    getFrameTimingStats(&stats);
+
+    response["enabled"] = stats.enabled;
+    response["late_frames"] = stats.lateCount;
+    response["frame_period"] = {
+        {"target_ms", stats.frameTimeAbs.tgt * 1e3},
+        {"current_ms", stats.frameTimeAbs.cur * 1e3},
+        {"min_ms", stats.frameTimeAbs.min * 1e3},
+        {"max_ms", stats.frameTimeAbs.max * 1e3}
+    };
+
+    response["display"] = {
+        {"refresh_ms", stats.displayPeriod * 1e3},
+        {"locked", stats.displayLocked},
+        {"frames_delivered", stats.framesDelivered},
+        {"frames_dropped", stats.framesDropped},
+        {"frames_duplicated", stats.framesDuplicated},
+        {"timing_mode", getTimingMode()},
+        {"spin_margin_ms", stats.sleepMargin * 1e3}
+    };
+
+    json stages = json::object();
+
+    for (int s = 0; s < FRAME_STAGE_COUNT; s++) {
+        struct timingHistStat_t stage;
+
+        getFrameStageStats(s, &stage);
+
+        stages[frameStageName(s)] = {
+            {"count", stage.count},
+            {"mean_ms", stage.mean * 1e3},
+            {"p50_ms", stage.p50 * 1e3},
+            {"p90_ms", stage.p90 * 1e3},
+            {"p99_ms", stage.p99 * 1e3},
+            {"max_ms", stage.max * 1e3}
+        };
+    }
+    response["stages"] = stages;
+
+    struct soundLatencyStat_t audio;
+
+    GetSoundLatencyStats(&audio);
+
+    response["audio"] = {
+        {"enabled", audio.enabled},
+        {"latency_ms", audio.latency * 1e3},
+        {"average_latency_ms", audio.average * 1e3},
+        {"target_latency_ms", audio.target * 1e3},
+        {"device_buffer_ms", audio.device * 1e3},
+        {"rate_ratio", audio.rateRatio},
+        {"underruns", audio.underruns},
+        {"overruns", audio.overruns}
+    };
+
+    if (req.has_param("reset") && req.get_param_value("reset") == "1") {
+        resetFrameTiming();
+    }
+
+    res.set_content(response.dump(), "application/json");
+    res.status = 200;
+}
+
+void EmulationController::handleRun(const httplib::Request& req, httplib::Response& res) {
+    try {
+        std::vector<RunFrameInput> inputs;
+        std::vector<RunSampleRange> ranges;
+        std::unique_ptr<ApiCommandWithResult<RunFramesResult>> cmd;
+
+        // Anything that goes wrong before the command is queued is the
+        // client's fault, report it as invalid_argument
+        try {
+            json body = json::parse(req.body);
+
+            if (!body.contains("frames") || !body["frames"].is_array()) {
+                throw std::runtime_error("Missing or invalid 'frames' array");
+            }
+
+            for (const auto& frame : body["frames"]) {
+                if (!frame.is_object()) {
+                    throw std::runtime_error("Frame entries must be objects");
+                }
+
+                RunFrameInput input;
+                input.ports[0] = parseRunButtons(frame, "port1");
+                input.ports[1] = parseRunButtons(frame, "port2");
+
+                // Hold the same state for several frames
+                int repeat = frame.value("repeat", 1);
+                if (repeat < 1) {
+                    throw std::runtime_error("Frame 'repeat' must be at least 1");
+                }
+                if (inputs.size() + repeat > MAX_RUN_FRAMES) {
+                    throw std::runtime_error("Frame count exceeds maximum allowed (3600 frames)");
+                }
+                inputs.insert(inputs.end(), repeat, input);
+            }
+
+            if (body.contains("sample")) {
+                if (!body["sample"].is_array()) {
+                    throw std::runtime_error("Invalid 'sample' array");
+                }
+                for (const auto& range : body["sample"]) {
+                    if (!range.contains("start") || !range["start"].is_string()) {
+                        throw std::runtime_error("Missing or invalid sample 'start'");
+                    }
+                    if (!range.contains("length") || !range["length"].is_number_integer()) {
+                        throw std::runtime_error("Missing or invalid sample 'length'");
+                    }
+
+                    int length = range["length"];
+                    if ((length <= 0) || (static_cast<size_t>(length) > MAX_RUN_SAMPLE_BYTES)) {
+                        throw std::runtime_error("Length must be between 1 and 4096");
+                    }
+
+                    RunSampleRange sample;
+                    sample.start = parseAddress(QString::fromStdString(range["start"].get<std::string>()));
+                    sample.length = static_cast<uint16_t>(length);
+                    ranges.push_back(sample);
+                }
+            }
+
+            cmd.reset(new RunFramesCommand(inputs, ranges));
+
+        } catch (const std::exception& e) {
+            throw std::invalid_argument(e.what());
+        }
+
+        unsigned int timeoutMs = COMMAND_TIMEOUT_MS +
+            static_cast<unsigned int>(inputs.size()) * RUN_FRAME_TIMEOUT_MS;
+        auto future = executeCommand(std::move(cmd), timeoutMs);
+        RunFramesResult result = waitForResult(future, timeoutMs);
+
+        res.set_content(result.toJson(), "application/json");
+        res.status = 200;
+
+    } catch (const std::invalid_argument& e) {
+        res.status = 400;
+        res.set_content(createErrorResponse(e.what()), "application/json");
+
+    } catch (const std::runtime_error& e) {
+        std::string errorMsg = e.what();
+        if (errorMsg == "No game loaded") {
+            res.status = 503;  // Service Unavailable
+        } else if (errorMsg == "Command execution timeout") {
+            res.status = 504;  // Gateway Timeout
+        } else {
+            res.status = 500;  // Internal Server Error
+        }
+        res.set_content(createErrorResponse(errorMsg), "application/json");
+
+    } catch (const std::exception& e) {
+        res.status = 500;
+        res.set_content(createErrorResponse(e.what()), "application/json");
+    }
+}
+
+void EmulationController::handleStep(const httplib::Request& req, httplib::Response& res) {
+    try {
+        unsigned int frames = 1;
+        bool wait = false;
+        bool untilInput = false;
+
+        if (req.has_param("until")) {
+            std::string value = req.get_param_value("until");
+            if (value != "input") {
+                throw std::invalid_argument("Until must be input");
+            }
+            // frames is then the most to run before giving up
+            untilInput = true;
+            frames = MAX_STEP_FRAMES;
+        }
+        if (req.has_param("frames")) {
+            uint64_t value = parseQueryNumber(req, "frames");
+            if ((value < 1) || (value > MAX_STEP_FRAMES)) {
+                throw std::invalid_argument("Frames must be 1 to 3600");
+            }
+            frames = static_cast<unsigned int>(value);
+        }
+        if (req.has_param("wait")) {
+            std::string value = req.get_param_value("wait");
+            wait = (value == "true") || (value == "1");
+        }
+
+        // Handed on to FrameClock by the command, fulfilled by the frame that ends the step
+        std::promise<FrameClockTick> done;
+        auto tick = done.get_future();
+
+        auto cmd = std::unique_ptr<ApiCommandWithResult<StepStart>>(new StepCommand(frames, std::move(done), untilInput));
+        auto future = executeCommand(std::move(cmd), COMMAND_TIMEOUT_MS);
+        StepStart start = waitForResult(future, COMMAND_TIMEOUT_MS);
+
+        json response;
+        response["success"] = true;
+        response["start_frame_id"] = start.frameId;
+        response["target_frame_id"] = start.targetId;
+        response["completed"] = false;
+
+        if (wait) {
+            unsigned int timeoutMs = COMMAND_TIMEOUT_MS + frames * STEP_FRAME_TIMEOUT_MS;
+
+            if (tick.wait_for(std::chrono::milliseconds(timeoutMs)) == std::future_status::timeout) {
+                throw std::runtime_error("Step timeout");
+            }
+            FrameClockTick last = tick.get();
+
+            response["completed"] = true;
+            response["frame_id"] = last.id;
+            response["frame"] = last.frame;
+            if (untilInput) {
+                response["lag_frames"] = last.lagFrames;
+                response["input_polled"] = (last.lagFrames < frames);
+            }
+        }
+
+        res.set_content(response.dump(), "application/json");
+        res.status = 200;
+
+    } catch (const std::invalid_argument& e) {
+        res.status = 400;
+        res.set_content(createErrorResponse(e.what()), "application/json");
+
+    } catch (const std::runtime_error& e) {
+        std::string errorMsg = e.what();
+        if (errorMsg == "No game loaded") {
+            res.status = 503;  // Service Unavailable
+        } else if (errorMsg == "Game closed") {
+            res.status = 409;  // Conflict
+        } else if (errorMsg == "Command execution timeout" || errorMsg == "Step timeout") {
+            res.status = 504;  // Gateway Timeout
+        } else {
+            res.status = 500;  // Internal Server Error
+        }
+        res.set_content(createErrorResponse(errorMsg), "application/json");
+
+    } catch (const std::exception& e) {
+        res.status = 500;
+        res.set_content(createErrorResponse(e.what()), "application/json");
+    }
+}
+
+void EmulationController::handleFrameWait(const httplib::Request& req, httplib::Response& res) {
+    try {
+        FrameClock& clock = FrameClock::instance();
+        uint64_t after = clock.currentId();
+        uint64_t timeoutMs = DEFAULT_FRAME_WAIT_MS;
+
+        if (req.has_param("after")) {
+            after = parseQueryNumber(req, "after");
+        }
+        if (req.has_param("timeout")) {
+            timeoutMs = parseQueryNumber(req, "timeout");
+            if (timeoutMs > MAX_FRAME_WAIT_MS) {
+                throw std::invalid_argument("Timeout must be at most 30000");
+            }
+        }
+
+        FrameClockTick tick;
+        bool ready = clock.waitAfter(after, static_cast<unsigned int>(timeoutMs), tick);
+
+        json response;
+        response["frame_id"] = tick.id;
+        response["frame"] = tick.frame;
+        response["timed_out"] = !ready;
+
+        res.set_content(response.dump(), "application/json");
+        res.status = 200;
+
+    } catch (const std::invalid_argument& e) {
+        res.status = 400;
+        res.set_content(createErrorResponse(e.what()), "application/json");
+
+    } catch (const std::exception& e) {
+        res.status = 500;
+        res.set_content(createErrorResponse(e.what()), "application/json");
+    }
+}
+
+void EmulationController::handleMovieSeek(const httplib::Request& req, httplib::Response& res) {
+    try {
+        int frame;
+
+        try {
+            json body = json::parse(req.body);
+
+            if (!body.contains("frame") || !body["frame"].is_number_integer()) {
+                throw std::runtime_error("Missing or invalid 'frame'");
+            }
+            frame = body["frame"];
+            if (frame < 0) {
+                throw std::runtime_error("Frame must not be negative");
+            }
+        } catch (const std::exception& e) {
+            throw std::invalid_argument(e.what());
+        }
+
+        // Without a snapshot nearby the whole way from the current frame is replayed
+        unsigned int timeoutMs = COMMAND_TIMEOUT_MS +
+            static_cast<unsigned int>(frame) * SEEK_FRAME_TIMEOUT_MS;
+        auto cmd = std::unique_ptr<ApiCommandWithResult<MovieSeekResult>>(new MovieSeekCommand(frame));
+        auto future = executeCommand(std::move(cmd), timeoutMs);
+        MovieSeekResult result = waitForResult(future, timeoutMs);
+
+        res.set_content(result.toJson(), "application/json");
+        res.status = 200;
+
+    } catch (const std::invalid_argument& e) {
+        res.status = 400;
+        res.set_content(createErrorResponse(e.what()), "application/json");
+
+    } catch (const std::runtime_error& e) {
+        std::string errorMsg = e.what();
+        if (errorMsg == "No game loaded") {
+            res.status = 503;  // Service Unavailable
+        } else if (errorMsg == "No movie playing" || errorMsg == "Frame cannot be reached") {
+            res.status = 409;  // Conflict
+        } else if (errorMsg == "Command execution timeout") {
+            res.status = 504;  // Gateway Timeout
+        } else {
+            res.status = 500;  // Internal Server Error
+        }
+        res.set_content(createErrorResponse(errorMsg), "application/json");
+
+    } catch (const std::exception& e) {
+        res.status = 500;
+        res.set_content(createErrorResponse(e.what()), "application/json");
+    }
+}
+
+void EmulationController::handleTasEditorInput(const httplib::Request& req, httplib::Response& res) {
+    try {
+        size_t frames = 0;
+        std::unique_ptr<ApiCommandWithResult<TasEditorInputResult>> cmd;
+
+        try {
+            json body = json::parse(req.body);
+
+            if (!body.contains("frame") || !body["frame"].is_number_integer()) {
+                throw std::runtime_error("Missing or invalid 'frame'");
+            }
+            if (!body.contains("columns") || !body["columns"].is_array()) {
+                throw std::runtime_error("Missing or invalid 'columns' array");
+            }
+            std::string name = body.value("name", "");
+
+            std::vector<TasEditorInputColumn> columns;
+            for (const auto& entry : body["columns"]) {
+                if (!entry.contains("joypad") || !entry["joypad"].is_number_integer()) {
+                    throw std::runtime_error("Missing or invalid column 'joypad'");
+                }
+                if (!entry.contains("data") || !entry["data"].is_string()) {
+                    throw std::runtime_error("Missing or invalid column 'data'");
+                }
+                QByteArray decoded = QByteArray::fromBase64(
+                    QByteArray::fromStdString(entry["data"].get<std::string>()));
+
+                TasEditorInputColumn column;
+                column.joypad = entry["joypad"];
+                column.data.assign(decoded.begin(), decoded.end());
+                if (column.data.size() > frames) {
+                    frames = column.data.size();
+                }
+                columns.push_back(std::move(column));
+            }
+
+            cmd.reset(new TasEditorSetInputCommand(body["frame"], columns, name));
+
+        } catch (const std::exception& e) {
+            throw std::invalid_argument(e.what());
+        }
+
+        unsigned int timeoutMs = COMMAND_TIMEOUT_MS +
+            static_cast<unsigned int>(frames / 1000) * TASEDITOR_KFRAME_TIMEOUT_MS;
+        auto future = executeCommand(std::move(cmd), timeoutMs);
+        TasEditorInputResult result = waitForResult(future, timeoutMs);
+
+        res.set_content(result.toJson(), "application/json");
+        res.status = 200;
+
+    } catch (const std::invalid_argument& e) {
+        res.status = 400;
+        res.set_content(createErrorResponse(e.what()), "application/json");
+
+    } catch (const std::runtime_error& e) {
+        std::string errorMsg = e.what();
+        if (errorMsg == "No game loaded") {
+            res.status = 503;  // Service Unavailable
+        } else if (errorMsg == "TAS Editor is not open") {
+            res.status = 409;  // Conflict
+        } else if (errorMsg == "Command execution timeout") {
+            res.status = 504;  // Gateway Timeout
+        } else {
+            res.status = 500;  // Internal Server Error
+        }
+        res.set_content(createErrorResponse(errorMsg), "application/json");
+
+    } catch (const std::exception& e) {
+        res.status = 500;
+        res.set_content(createErrorResponse(e.what()), "application/json");
+    }
+}
@@ -12,7 +12,7 @@ namespace httplib {
 /**
  * @brief REST API controller for emulation control endpoints
  * 
- * Provides HTTP handlers for pause, resume, and status operations.
+ * Provides HTTP handlers for pause, resume, status and run operations.
  * All handlers execute commands on the emulator thread via the command queue.
  */
 class EmulationController {
@@ -69,6 +69,177 @@ public:
      * - 500 Internal Server Error: Command execution failed
      */
     static void handleStatus(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle GET /api/emulation/timing
+     * 
+     * Returns the frame period and the per stage histograms of the Frame
+     * Timing Statistics dialog. Read directly, without the command queue,
+     * so it still answers while the emulator thread is stuck.
+     * 
+     * Response format:
+     * {
+     *   "enabled": true,
+     *   "late_frames": 3,
+     *   "frame_period": {"target_ms": 16.639, "current_ms": 16.641, "min_ms": 15.9, "max_ms": 41.2},
+     *   "stages": {
+     *     "emulate": {"count": 3600, "mean_ms": 1.2, "p50_ms": 1.1, "p90_ms": 1.4, "p99_ms": 2.9, "max_ms": 7.5},
+     *     ...
+     *   }
+     * }
+     * 
+     * Query parameters:
+     * - reset=1: clear the statistics after they are read
+     */
+    static void handleTiming(const httplib::Request& req, httplib::Response& res);
+    
+    /**
+     * @brief Handle POST /api/emulation/run
+     * 
+     * Runs a sequence of frames with scripted joypad input in a single
+     * emulator-thread command, sampling memory ranges after every frame.
+     * 
+     * Request format:
+     * {
+     *   "frames": [ { "port1": ["A", "Right"], "port2": [], "repeat": 1 } ],
+     *   "sample": [ { "start": "0x0000", "length": 16 } ]
+     * }
+     * 
+     * Response format:
+     * {
+     *   "start_frame": 100,
+     *   "end_frame": 101,
+     *   "frames_run": 1,
+     *   "lag_frames": 0,
+     *   "ranges": [ { "start": "0x0000", "length": 16 } ],
+     *   "observations": [ { "frame": 101, "lag": false, "samples": ["base64"] } ]
+     * }
+     * 
+     * Error responses:
+     * - 400 Bad Request: Invalid request body or limits exceeded
+     * - 503 Service Unavailable: No game loaded
+     * - 504 Gateway Timeout: Command execution timeout
+     * - 500 Internal Server Error: Command execution failed
+     */
+    static void handleRun(const httplib::Request& req, httplib::Response& res);
+    
+    /**
+     * @brief Handle POST /api/emulation/step
+     * 
+     * Lets the emulator loop run a number of frames at the current speed.
+     * A paused emulator is paused again right after the last one.
+     * 
+     * Query parameters:
+     * - frames=N: frames to run, 1 to 3600, default 1
+     * - wait=true: answer once the last frame is done instead of at once
+     * 
+     * Response format:
+     * {
+     *   "success": true,
+     *   "completed": true,
+     *   "start_frame_id": 1200,
+     *   "target_frame_id": 1210,
+     *   "frame_id": 1210,
+     *   "frame": 5321
+     * }
+     * 
+     * Without wait, "completed" is false and "frame_id"/"frame" are left
+     * out, GET /api/frame/wait?after=<target_frame_id - 1> waits for it.
+     * 
+     * Error responses:
+     * - 400 Bad Request: Invalid frames
+     * - 409 Conflict: The game was closed before the step was done
+     * - 503 Service Unavailable: No game loaded
+     * - 504 Gateway Timeout: Step not done in time, it keeps running
+     * - 500 Internal Server Error: Command execution failed
+     */
+    static void handleStep(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle GET /api/frame/wait
+     * 
+     * Long-poll for the next completed frame. Frame ids count every frame
+     * the emulator thread finished and never go backwards. Read directly,
+     * without the command queue.
+     * 
+     * Query parameters:
+     * - after=<id>: answer once a frame newer than this id is done,
+     *   default the current frame id
+     * - timeout=<ms>: longest wait, up to 30000, default 1000
+     * 
+     * Response format:
+     * {
+     *   "frame_id": 1211,
+     *   "frame": 5322,
+     *   "timed_out": false
+     * }
+     * 
+     * Error responses:
+     * - 400 Bad Request: Invalid after or timeout
+     */
+    static void handleFrameWait(const httplib::Request& req, httplib::Response& res);
+    
+    /**
+     * @brief Handle POST /api/movie/seek
+     * 
+     * Moves movie playback to a frame. With the seek index enabled
+     * (SDL.MovieSeekIndexInterval) only the frames after the nearest
+     * snapshot are replayed; without it, seeking only works forward.
+     * 
+     * Request format:
+     * {
+     *   "frame": 12000
+     * }
+     * 
+     * Response format:
+     * {
+     *   "success": true,
+     *   "frame": 12000,
+     *   "frames_replayed": 37
+     * }
+     * 
+     * Error responses:
+     * - 400 Bad Request: Invalid request body
+     * - 409 Conflict: No movie playing, or the frame cannot be reached
+     * - 503 Service Unavailable: No game loaded
+     * - 504 Gateway Timeout: Command execution timeout
+     * - 500 Internal Server Error: Command execution failed
+     */
+    static void handleMovieSeek(const httplib::Request& req, httplib::Response& res);
+    
+    /**
+     * @brief Handle POST /api/taseditor/input
+     * 
+     * Writes a range of input into the open TAS Editor project as a single
+     * History entry, extending the movie if needed. The Greenzone is
+     * invalidated once, from the first frame that actually changed.
+     * 
+     * Request format:
+     * {
+     *   "frame": 1000,
+     *   "name": "bot run",
+     *   "columns": [
+     *     {"joypad": 1, "data": "<base64, one byte per frame>"}
+     *   ]
+     * }
+     * 
+     * Joypad 0 is the commands column, 1-4 are the players.
+     * 
+     * Response format:
+     * {
+     *   "success": true,
+     *   "first_change": 1012,
+     *   "movie_length": 51000
+     * }
+     * 
+     * Error responses:
+     * - 400 Bad Request: Invalid request body
+     * - 409 Conflict: TAS Editor is not open
+     * - 503 Service Unavailable: No game loaded
+     * - 504 Gateway Timeout: Command execution timeout
+     * - 500 Internal Server Error: Command execution failed
+     */
+    static void handleTasEditorInput(const httplib::Request& req, httplib::Response& res);
     
 private:
     // Prevent instantiation
@@ -2,9 +2,16 @@
 #include "../../../lib/httplib.h"
 #include "../../../lib/json.hpp"
 #include "../../../version.h"
+#include "../../../stageprof.h"
+#include "../fceuWrapper.h"
+#include "../EmuStateSnapshot.h"
+#include "../throttle.h"
 #include "EmulationController.h"
+#include "InstanceController.h"
+#include "ObservationController.h"
 #include "RomInfoController.h"
 #include "CommandQueue.h"
+#include "CommandPool.h"
 #include "CommandExecution.h"
 #include "Commands/MemoryReadCommand.h"
 #include "Commands/InputCommands.h"
@@ -13,15 +20,192 @@
 #include "Commands/MemoryRangeCommands.h"
 #include "Commands/PpuMemoryReadCommand.h"
 #include "Commands/PpuMemoryRangeCommand.h"
+#include "Commands/PpuImageCommand.h"
+#include "Commands/MultiRangeReadCommand.h"
+#include "Commands/RpcCommands.h"
+#include "EmulationCommands.h"
 #include "InputApi.h"
+#include "FrameStream.h"
+#include "FrameClock.h"
+#include "MemoryWatch.h"
+#include "RouteMetrics.h"
 #include "Utils/AddressParser.h"
+#include "Utils/BinaryResponse.h"
+#include "Utils/BinaryRpc.h"
+#include "Utils/StateStore.h"
 #include <QDateTime>
 #include <QtGlobal>
+#include <iterator>
 #include <memory>
 #include <stdexcept>
 
+// HTTP status of an /api/state/snapshot or /api/state/restore result
+static int stateResultStatus(const StateHandleResult& result)
+{
+    if (result.success) {
+        return 200;
+    }
+    if (result.error == "No game loaded") {
+        return 503;
+    }
+    if (result.error == "Unknown state handle") {
+        return 404;
+    }
+    return 409;
+}
+
 using json = nlohmann::json;
 
+// Encode a range read result in the format negotiated from the Accept header
+template<typename Result>
+static void setRangeContent(const httplib::Request& req, httplib::Response& res,
+                            const Result& result)
+{
+    ResponseFormat format = negotiateResponseFormat(req.get_header_value("Accept"));
+    
+    switch (format) {
+        case ResponseFormat::OctetStream:
+            res.set_content(result.toBinary(), responseContentType(format));
+            break;
+        case ResponseFormat::Cbor:
+            res.set_content(result.toCbor(), responseContentType(format));
+            break;
+        case ResponseFormat::Json:
+        default:
+            res.set_content(result.toJson(), responseContentType(format));
+            break;
+    }
+}
+
+// Emulator mutex call sites exported per scrape, worst hold time first
+static const size_t kMutexMetricSites = 20;
+
+static void appendSummary(std::string& out, const char* name, const std::string& labels,
+                               const timingHistStat_t& stat)
+{
+    // Five lines repeating the labels, route patterns can make them long
+    char line[2048];
+
+    snprintf(line, sizeof(line),
+        "%s{%s,quantile=\"0.5\"} %.9f\n%s{%s,quantile=\"0.9\"} %.9f\n%s{%s,quantile=\"0.99\"} %.9f\n"
+        "%s_sum{%s} %.9f\n%s_count{%s} %llu\n",
+        name, labels.c_str(), stat.p50, name, labels.c_str(), stat.p90, name, labels.c_str(), stat.p99,
+        name, labels.c_str(), stat.total, name, labels.c_str(), stat.count);
+    out += line;
+}
+
+static std::string mutexMetricsPrometheus(const std::vector<fceuMutexSiteStat_t>& sites)
+{
+    std::string out;
+    char line[512];
+
+    out += "# HELP fceux_emulator_mutex_wait_seconds Time spent waiting for the emulator mutex, per call site\n";
+    out += "# TYPE fceux_emulator_mutex_wait_seconds summary\n";
+    for (const auto& s : sites) {
+        appendSummary(out, "fceux_emulator_mutex_wait_seconds", "site=\"" + s.site + "\"", s.wait);
+    }
+    out += "# HELP fceux_emulator_mutex_hold_seconds Time the emulator mutex was held, per call site\n";
+    out += "# TYPE fceux_emulator_mutex_hold_seconds summary\n";
+    for (const auto& s : sites) {
+        appendSummary(out, "fceux_emulator_mutex_hold_seconds", "site=\"" + s.site + "\"", s.hold);
+    }
+    out += "# HELP fceux_emulator_mutex_timeouts_total Lock attempts that gave up, per call site\n";
+    out += "# TYPE fceux_emulator_mutex_timeouts_total counter\n";
+    for (const auto& s : sites) {
+        snprintf(line, sizeof(line), "fceux_emulator_mutex_timeouts_total{site=\"%s\"} %llu\n",
+            s.site.c_str(), s.timeouts);
+        out += line;
+    }
+    out += "# HELP fceux_emulator_mutex_emulator_blocked_seconds_total Emulator thread wait while this site held the mutex\n";
+    out += "# TYPE fceux_emulator_mutex_emulator_blocked_seconds_total counter\n";
+    for (const auto& s : sites) {
+        snprintf(line, sizeof(line), "fceux_emulator_mutex_emulator_blocked_seconds_total{site=\"%s\"} %.9f\n",
+            s.site.c_str(), s.emuBlocked);
+        out += line;
+    }
+    return out;
+}
+
+// Frame stage histograms, including input to photon latency, while frame timing is enabled
+static std::string frameStageMetricsPrometheus()
+{
+    std::string out;
+
+    out += "# HELP fceux_frame_stage_seconds Time spent per frame in each stage, and input to photon latency\n";
+    out += "# TYPE fceux_frame_stage_seconds summary\n";
+    for (int s = 0; s < FRAME_STAGE_COUNT; s++) {
+        timingHistStat_t stat;
+
+        getFrameStageStats(s, &stat);
+        appendSummary(out, "fceux_frame_stage_seconds", std::string("stage=\"") + frameStageName(s) + "\"", stat);
+    }
+    return out;
+}
+
+// Route patterns are regexes, their backslashes and quotes need escaping in a label
+static std::string routeLabel(const std::string& route)
+{
+    std::string out = "route=\"";
+
+    for (char c : route) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Where the time of each route's requests goes, for the routes that have served one
+static std::string routeMetricsPrometheus(const std::vector<RouteMetrics*>& routes)
+{
+    static const char* phases[] = { "queue_wait", "execution", "serialization", "total" };
+    std::string out;
+    char line[512];
+
+    out += "# HELP fceux_rest_request_seconds REST request latency per route: command queue wait, "
+           "emulator thread execution, response serialization and total\n";
+    out += "# TYPE fceux_rest_request_seconds summary\n";
+    for (const auto* r : routes) {
+        const timingHistogram_t* hists[] = { &r->queueWait, &r->execution, &r->serialization, &r->total };
+        std::string label = routeLabel(r->route);
+
+        for (int i = 0; i < 4; i++) {
+            timingHistStat_t stat;
+
+            hists[i]->getStats(&stat);
+            appendSummary(out, "fceux_rest_request_seconds", label + ",phase=\"" + phases[i] + "\"", stat);
+        }
+    }
+    struct { const char* name; const char* help; std::atomic<uint64_t> RouteMetrics::*count; } counters[] = {
+        { "fceux_rest_requests_total", "Requests served, per route", &RouteMetrics::requests },
+        { "fceux_rest_command_timeouts_total", "Commands the request gave up waiting for, per route", &RouteMetrics::timeouts },
+        { "fceux_rest_queue_full_total", "Commands rejected by a full command queue, per route", &RouteMetrics::queueFull }
+    };
+    for (const auto& c : counters) {
+        out += std::string("# HELP ") + c.name + " " + c.help + "\n";
+        out += std::string("# TYPE ") + c.name + " counter\n";
+        for (const auto* r : routes) {
+            snprintf(line, sizeof(line), "%s{%s} %llu\n", c.name, routeLabel(r->route).c_str(),
+                (unsigned long long)(r->*c.count).load(std::memory_order_relaxed));
+            out += line;
+        }
+    }
+    return out;
+}
+
+static json mutexHistJson(const timingHistStat_t& stat)
+{
+    return {
+        {"count", stat.count},
+        {"total_ms", stat.total * 1e3},
+        {"p50_ms", stat.p50 * 1e3},
+        {"p90_ms", stat.p90 * 1e3},
+        {"p99_ms", stat.p99 * 1e3},
+        {"max_ms", stat.max * 1e3}
+    };
+}
+
 FceuxApiServer::FceuxApiServer(QObject* parent)
     : RestApiServer(parent)
 {
@@ -46,14 +230,64 @@ void FceuxApiServer::registerRoutes()
         [this](const httplib::Request& req, httplib::Response& res) {
             handleSystemCapabilities(req, res);
         });
+
+    addGetRoute("/api/system/queue",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            handleSystemQueue(req, res);
+        });
+
+    addGetRoute("/api/system/metrics",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            handleSystemMetrics(req, res);
+        });
+    
+    // Streaming endpoints
+    addGetRoute("/api/stream/frames",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            handleStreamFrames(req, res);
+        });
+    addGetRoute("/api/stream/watch",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            handleStreamWatch(req, res);
+        });
+    
+    // Binary RPC, the same operations as the JSON endpoints without JSON
+    addPostRoute("/api/rpc",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            handleRpc(req, res);
+        });
     
     // Emulation control endpoints
     addPostRoute("/api/emulation/pause", EmulationController::handlePause);
     addPostRoute("/api/emulation/resume", EmulationController::handleResume);
     addGetRoute("/api/emulation/status", EmulationController::handleStatus);
+    addGetRoute("/api/emulation/timing", EmulationController::handleTiming);
+    addPostRoute("/api/emulation/run", EmulationController::handleRun);
+    addPostRoute("/api/emulation/step", EmulationController::handleStep);
+    addGetRoute("/api/frame/wait", EmulationController::handleFrameWait);
+    
+    // Emulator instances, extra consoles of the loaded game
+    addPostRoute("/api/instances", InstanceController::handleCreate);
+    addGetRoute("/api/instances", InstanceController::handleList);
+    addPostRoute("/api/instances/step", InstanceController::handleBatchStep);
+    addPostRoute("/api/instances/step_batch", InstanceController::handleStepBatch);
+    addDeleteRoute("/api/instances/([0-9]+)", InstanceController::handleDelete);
+    addPostRoute("/api/instances/([0-9]+)/step", InstanceController::handleStep);
+    addGetRoute("/api/instances/([0-9]+)/memory/range/([0-9a-fA-Fx]+)/([0-9]+)",
+                InstanceController::handleReadRange);
+    addPostRoute("/api/movie/seek", EmulationController::handleMovieSeek);
+    addPostRoute("/api/taseditor/input", EmulationController::handleTasEditorInput);
     
     // ROM information endpoint
     addGetRoute("/api/rom/info", RomInfoController::handleRomInfo);
+    addGetRoute("/api/rom/index", RomInfoController::handleRomIndex);
+    addGetRoute("/api/rom/(prg|chr)/([0-9a-fA-Fx]+)/([0-9]+)", RomInfoController::handleRomData);
+
+    // Preprocessed observations of the console frames
+    addPutRoute("/api/observation/spec", ObservationController::handleSetSpec);
+    addGetRoute("/api/observation/spec", ObservationController::handleGetSpec);
+    addDeleteRoute("/api/observation/spec", ObservationController::handleDeleteSpec);
+    addGetRoute("/api/observation", ObservationController::handleRead);
     
     // Memory access endpoints
     addGetRoute("/api/memory/([0-9a-fA-Fx]+)", 
@@ -66,13 +300,20 @@ void FceuxApiServer::registerRoutes()
                 uint16_t address = parseAddress(QString::fromStdString(addressStr));
                 
                 // Create command
-                auto cmd = std::unique_ptr<ApiCommandWithResult<MemoryReadResult>>(new MemoryReadCommand(address));
+                MemoryReadCommand* readCmd = new MemoryReadCommand(address);
+                auto cmd = std::unique_ptr<ApiCommandWithResult<MemoryReadResult>>(readCmd);
                 
-                // Execute command with 1 second timeout
-                auto future = executeCommand(std::move(cmd), 1000);
+                // Without waiting on the emulator when the last published state has it
+                subscribeStateSnapshot();
+                MemoryReadResult result;
                 
-                // Wait for result
-                MemoryReadResult result = waitForResult(future, 1000);
+                if (!readCmd->readSnapshot(result)) {
+                    // Execute command with 1 second timeout
+                    auto future = executeCommand(std::move(cmd), 1000);
+                    
+                    // Wait for result
+                    result = waitForResult(future, 1000);
+                }
                 
                 // Return success response
                 res.status = 200;
@@ -109,6 +350,57 @@ void FceuxApiServer::registerRoutes()
             }
         });
     
+    // Last writers of an address, from the write journal, ?count= (16 by default)
+    addGetRoute("/api/memory/([0-9a-fA-Fx]+)/writers",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            try {
+                std::string addressStr = req.matches[1];
+                uint16_t address = parseAddress(QString::fromStdString(addressStr));
+                
+                int count = 16;
+                if (req.has_param("count")) {
+                    count = std::stoi(req.get_param_value("count"));
+                }
+                if (count < 1 || count > MAX_MEMORY_WRITERS) {
+                    throw std::invalid_argument("count must be 1 to " + std::to_string(MAX_MEMORY_WRITERS));
+                }
+                
+                auto cmd = std::unique_ptr<ApiCommandWithResult<MemoryWritersResult>>(
+                    new MemoryWritersCommand(address, count));
+                auto future = executeCommand(std::move(cmd), 1000);
+                MemoryWritersResult result = waitForResult(future, 1000);
+                
+                res.status = 200;
+                res.set_content(result.toJson(), "application/json");
+                
+            } catch (const std::runtime_error& e) {
+                std::string errorMsg = e.what();
+                json error;
+                error["error"] = errorMsg;
+                
+                if (errorMsg.find("Invalid address") != std::string::npos ||
+                    errorMsg.find("Address out of range") != std::string::npos ||
+                    errorMsg.find("Invalid hex format") != std::string::npos ||
+                    errorMsg.find("Address not recorded") != std::string::npos) {
+                    res.status = 400;  // Bad Request
+                } else if (errorMsg == "No game loaded" ||
+                          errorMsg == "The write journal is off") {
+                    res.status = 503;  // Service Unavailable
+                } else if (errorMsg == "Command execution timeout") {
+                    res.status = 504;  // Gateway Timeout
+                } else {
+                    res.status = 500;  // Internal Server Error
+                }
+                
+                res.set_content(error.dump(), "application/json");
+            } catch (const std::exception& e) {
+                res.status = 400;
+                json error;
+                error["error"] = e.what();
+                res.set_content(error.dump(), "application/json");
+            }
+        });
+    
     // Memory range read endpoint
     addGetRoute("/api/memory/range/([0-9a-fA-Fx]+)/([0-9]+)",
         [this](const httplib::Request& req, httplib::Response& res) {
@@ -124,15 +416,20 @@ void FceuxApiServer::registerRoutes()
                 uint16_t length = std::stoi(lengthStr);
                 
                 // Create command
-                auto cmd = std::unique_ptr<ApiCommandWithResult<MemoryRangeResult>>(
-                    new MemoryRangeReadCommand(startAddress, length));
+                MemoryRangeReadCommand* readCmd = new MemoryRangeReadCommand(startAddress, length);
+                auto cmd = std::unique_ptr<ApiCommandWithResult<MemoryRangeResult>>(readCmd);
                 
-                // Execute with 2 second timeout for larger reads
-                auto future = executeCommand(std::move(cmd), 2000);
-                MemoryRangeResult result = waitForResult(future, 2000);
+                subscribeStateSnapshot();
+                MemoryRangeResult result;
+                
+                if (!readCmd->readSnapshot(result)) {
+                    // Execute with 2 second timeout for larger reads
+                    auto future = executeCommand(std::move(cmd), 2000);
+                    result = waitForResult(future, 2000);
+                }
                 
                 res.status = 200;
-                res.set_content(result.toJson(), "application/json");
+                setRangeContent(req, res, result);
                 
             } catch (const std::runtime_error& e) {
                 std::string errorMsg = e.what();
@@ -327,6 +624,97 @@ void FceuxApiServer::registerRoutes()
             }
         });
     
+    // Multi-range read endpoint, CPU and PPU ranges in one response
+    addPostRoute("/api/memory/ranges",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            try {
+                // Parse JSON body
+                json body = json::parse(req.body);
+                if (!body.contains("ranges") || !body["ranges"].is_array()) {
+                    throw std::runtime_error("Missing or invalid 'ranges' array");
+                }
+                
+                std::vector<MultiRangeEntry> ranges;
+                for (const auto& r : body["ranges"]) {
+                    MultiRangeEntry entry;
+                    
+                    // Address space, CPU unless stated otherwise
+                    std::string space = r.value("space", std::string("cpu"));
+                    if (space == "cpu") {
+                        entry.space = MemorySpace::Cpu;
+                    } else if (space == "ppu") {
+                        entry.space = MemorySpace::Ppu;
+                    } else {
+                        throw std::runtime_error("Invalid address space: " + space);
+                    }
+                    
+                    if (!r.contains("start") || !r["start"].is_string()) {
+                        throw std::runtime_error("Missing or invalid 'start'");
+                    }
+                    QString startStr = QString::fromStdString(r["start"].get<std::string>());
+                    entry.start = (entry.space == MemorySpace::Ppu) ?
+                        parsePpuAddress(startStr) : parseAddress(startStr);
+                    
+                    if (!r.contains("length") || !r["length"].is_number_integer()) {
+                        throw std::runtime_error("Missing or invalid 'length'");
+                    }
+                    int length = r["length"];
+                    if ((length <= 0) || (length > MAX_MEMORY_RANGE_LENGTH)) {
+                        throw std::runtime_error("Length must be between 1 and 4096");
+                    }
+                    entry.length = static_cast<uint16_t>(length);
+                    entry.offset = 0;
+                    
+                    ranges.push_back(entry);
+                }
+                
+                // Create command
+                auto cmd = std::unique_ptr<ApiCommandWithResult<MultiRangeResult>>(
+                    new MultiRangeReadCommand(ranges));
+                
+                // Execute with 2 second timeout, same as single range reads
+                auto future = executeCommand(std::move(cmd), 2000);
+                MultiRangeResult result = waitForResult(future, 2000);
+                
+                res.status = 200;
+                setRangeContent(req, res, result);
+                
+            } catch (const json::exception& e) {
+                res.status = 400;
+                json error;
+                error["error"] = std::string("Invalid JSON: ") + e.what();
+                res.set_content(error.dump(), "application/json");
+            } catch (const std::runtime_error& e) {
+                std::string errorMsg = e.what();
+                json error;
+                error["error"] = errorMsg;
+                
+                if (errorMsg.find("Invalid") != std::string::npos ||
+                    errorMsg.find("Missing") != std::string::npos ||
+                    errorMsg.find("out of range") != std::string::npos ||
+                    errorMsg.find("Address range exceeds") != std::string::npos ||
+                    errorMsg.find("Length must be") != std::string::npos ||
+                    errorMsg.find("exceeds maximum") != std::string::npos ||
+                    errorMsg.find("must not be empty") != std::string::npos) {
+                    res.status = 400;  // Bad Request
+                } else if (errorMsg == "No game loaded" ||
+                          errorMsg == "PPU read function not available") {
+                    res.status = 503;  // Service Unavailable
+                } else if (errorMsg == "Command execution timeout") {
+                    res.status = 504;  // Gateway Timeout
+                } else {
+                    res.status = 500;  // Internal Server Error
+                }
+                
+                res.set_content(error.dump(), "application/json");
+            } catch (const std::exception& e) {
+                res.status = 400;
+                json error;
+                error["error"] = e.what();
+                res.set_content(error.dump(), "application/json");
+            }
+        });
+    
     // PPU memory access endpoints
     addGetRoute("/api/ppu/memory/([0-9a-fA-Fx]+)", 
         [this](const httplib::Request& req, httplib::Response& res) {
@@ -338,13 +726,19 @@ void FceuxApiServer::registerRoutes()
                 uint16_t address = parsePpuAddress(QString::fromStdString(addressStr));
                 
                 // Create command
-                auto cmd = std::unique_ptr<ApiCommandWithResult<PpuMemoryReadResult>>(new PpuMemoryReadCommand(address));
+                PpuMemoryReadCommand* readCmd = new PpuMemoryReadCommand(address);
+                auto cmd = std::unique_ptr<ApiCommandWithResult<PpuMemoryReadResult>>(readCmd);
                 
-                // Execute command with 1 second timeout
-                auto future = executeCommand(std::move(cmd), 1000);
+                subscribeStateSnapshot();
+                PpuMemoryReadResult result;
                 
-                // Wait for result
-                PpuMemoryReadResult result = waitForResult(future, 1000);
+                if (!readCmd->readSnapshot(result)) {
+                    // Execute command with 1 second timeout
+                    auto future = executeCommand(std::move(cmd), 1000);
+                    
+                    // Wait for result
+                    result = waitForResult(future, 1000);
+                }
                 
                 // Return success response
                 res.status = 200;
@@ -396,15 +790,20 @@ void FceuxApiServer::registerRoutes()
                 uint16_t length = std::stoi(lengthStr);
                 
                 // Create command
-                auto cmd = std::unique_ptr<ApiCommandWithResult<PpuMemoryRangeResult>>(
-                    new PpuMemoryRangeCommand(startAddress, length));
+                PpuMemoryRangeCommand* readCmd = new PpuMemoryRangeCommand(startAddress, length);
+                auto cmd = std::unique_ptr<ApiCommandWithResult<PpuMemoryRangeResult>>(readCmd);
                 
-                // Execute with 2 second timeout for larger reads
-                auto future = executeCommand(std::move(cmd), 2000);
-                PpuMemoryRangeResult result = waitForResult(future, 2000);
+                subscribeStateSnapshot();
+                PpuMemoryRangeResult result;
+                
+                if (!readCmd->readSnapshot(result)) {
+                    // Execute with 2 second timeout for larger reads
+                    auto future = executeCommand(std::move(cmd), 2000);
+                    result = waitForResult(future, 2000);
+                }
                 
                 res.status = 200;
-                res.set_content(result.toJson(), "application/json");
+                setRangeContent(req, res, result);
                 
             } catch (const std::runtime_error& e) {
                 std::string errorMsg = e.what();
@@ -435,6 +834,63 @@ void FceuxApiServer::registerRoutes()
             }
         });
     
+    // Decoded pattern table or name table: a PNG, or with
+    // Accept: application/octet-stream one NES color index per pixel.
+    // ?palette=0-7 picks the pattern table palette.
+    addGetRoute("/api/ppu/image/(pattern|nametable)/([0-3])",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            try {
+                PpuImageKind kind = (req.matches[1] == "pattern") ?
+                    PpuImageKind::PatternTable : PpuImageKind::NameTable;
+                int index = std::stoi(req.matches[2]);
+                int palette = 0;
+                
+                if (req.has_param("palette")) {
+                    palette = std::stoi(req.get_param_value("palette"));
+                }
+                
+                bool raw = negotiateResponseFormat(req.get_header_value("Accept")) ==
+                           ResponseFormat::OctetStream;
+                
+                auto cmd = std::unique_ptr<ApiCommandWithResult<PpuImageResult>>(
+                    new PpuImageCommand(kind, index, palette, !raw));
+                auto future = executeCommand(std::move(cmd), 2000);
+                PpuImageResult result = waitForResult(future, 2000);
+                
+                res.status = 200;
+                res.set_header("X-Image-Width", std::to_string(result.width));
+                res.set_header("X-Image-Height", std::to_string(result.height));
+                if (raw) {
+                    res.set_content(result.toBinary(), responseContentType(ResponseFormat::OctetStream));
+                } else {
+                    res.set_content(result.toPng(), "image/png");
+                }
+                
+            } catch (const std::runtime_error& e) {
+                std::string errorMsg = e.what();
+                json error;
+                error["error"] = errorMsg;
+                
+                if (errorMsg.find("must be") != std::string::npos) {
+                    res.status = 400;  // Bad Request
+                } else if (errorMsg == "No game loaded" ||
+                          errorMsg.find("not mapped") != std::string::npos) {
+                    res.status = 503;  // Service Unavailable
+                } else if (errorMsg == "Command execution timeout") {
+                    res.status = 504;  // Gateway Timeout
+                } else {
+                    res.status = 500;  // Internal Server Error
+                }
+                
+                res.set_content(error.dump(), "application/json");
+            } catch (const std::exception& e) {
+                res.status = 400;
+                json error;
+                error["error"] = e.what();
+                res.set_content(error.dump(), "application/json");
+            }
+        });
+    
     // Input control endpoints
     addGetRoute("/api/input/status",
         [this](const httplib::Request& req, httplib::Response& res) {
@@ -569,6 +1025,102 @@ void FceuxApiServer::registerRoutes()
             }
         });
     
+    // Scheduled input, applied on exact frames
+    addPostRoute("/api/input/timeline",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            try {
+                json body = json::parse(req.body);
+
+                if (!body.contains("events") || !body["events"].is_array()) {
+                    throw std::runtime_error("Missing or invalid 'events' array");
+                }
+                if (body["events"].size() > InputTimeline::CAPACITY) {
+                    throw std::runtime_error("Missing or invalid 'events' array: more than " +
+                        std::to_string(InputTimeline::CAPACITY) + " events");
+                }
+                bool relative = body.value("relative", false);
+
+                std::vector<InputTimelineEvent> events;
+                events.reserve(body["events"].size());
+
+                for (const auto& item : body["events"]) {
+                    if (!item.is_object() ||
+                        !item.contains("frame") || !item["frame"].is_number_integer() ||
+                        !item.contains("buttons") || !item["buttons"].is_array()) {
+                        throw std::runtime_error("Missing or invalid event 'frame' or 'buttons'");
+                    }
+
+                    std::vector<std::string> buttons;
+                    for (const auto& btn : item["buttons"]) {
+                        if (!btn.is_string()) {
+                            throw std::runtime_error("Button names must be strings");
+                        }
+                        buttons.push_back(btn.get<std::string>());
+                    }
+
+                    int port = item.value("port", 1);
+                    int frames = item.value("frames", 1);
+                    if (port < 1 || port > 4) {
+                        throw std::runtime_error("Invalid port number");
+                    }
+                    if (frames < 1 || frames > 65535) {
+                        throw std::runtime_error("Missing or invalid event 'frames' (1-65535)");
+                    }
+
+                    InputTimelineEvent event;
+                    event.frame = item["frame"].get<int>();
+                    event.frames = static_cast<uint16_t>(frames);
+                    event.port = static_cast<uint8_t>(port - 1);
+                    event.buttons = buttonNamesToBitmask(buttons);
+                    events.push_back(event);
+                }
+
+                auto cmd = std::unique_ptr<ApiCommandWithResult<InputTimelineResult>>(
+                    new InputTimelineScheduleCommand(events, relative));
+                auto future = executeCommand(std::move(cmd), 1000);
+                InputTimelineResult result = waitForResult(future, 1000);
+
+                res.status = 200;
+                res.set_content(result.toJson(), "application/json");
+
+            } catch (const std::runtime_error& e) {
+                handleInputError(e, res);
+            } catch (const json::exception& e) {
+                res.status = 400;
+                json error;
+                error["error"] = std::string("Invalid JSON: ") + e.what();
+                res.set_content(error.dump(), "application/json");
+            }
+        });
+
+    addGetRoute("/api/input/timeline",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            try {
+                auto cmd = std::unique_ptr<ApiCommandWithResult<InputTimelineResult>>(
+                    new InputTimelineStatusCommand());
+                auto future = executeCommand(std::move(cmd), 1000);
+                InputTimelineResult result = waitForResult(future, 1000);
+                res.status = 200;
+                res.set_content(result.toJson(), "application/json");
+            } catch (const std::runtime_error& e) {
+                handleInputError(e, res);
+            }
+        });
+
+    addDeleteRoute("/api/input/timeline",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            try {
+                auto cmd = std::unique_ptr<ApiCommandWithResult<InputTimelineResult>>(
+                    new InputTimelineClearCommand());
+                auto future = executeCommand(std::move(cmd), 1000);
+                InputTimelineResult result = waitForResult(future, 1000);
+                res.status = 200;
+                res.set_content(result.toJson(), "application/json");
+            } catch (const std::runtime_error& e) {
+                handleInputError(e, res);
+            }
+        });
+
     // Screenshot endpoints
     addPostRoute("/api/screenshot",
         [this](const httplib::Request& req, httplib::Response& res) {
@@ -612,6 +1164,79 @@ void FceuxApiServer::registerRoutes()
             }
         });
     
+    // Screen hash: ?perceptual=0 skips the perceptual hash,
+    // ?compare=<hex> adds its bit distance to the current perceptual hash
+    addGetRoute("/api/screen/hash",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            try {
+                bool perceptual = !(req.has_param("perceptual") && req.get_param_value("perceptual") == "0");
+                uint64_t compareHash = 0;
+                bool compare = false;
+                
+                if (req.has_param("compare")) {
+                    std::string hex = req.get_param_value("compare");
+                    size_t used = 0;
+                    compareHash = std::stoull(hex, &used, 16);
+                    if (used != hex.size()) {
+                        throw std::invalid_argument("compare");
+                    }
+                    compare = true;
+                }
+                
+                auto cmd = std::unique_ptr<ApiCommandWithResult<ScreenHashResult>>(
+                    new ScreenHashCommand(perceptual, compare ? &compareHash : nullptr));
+                auto future = executeCommand(std::move(cmd), 1000);
+                ScreenHashResult result = waitForResult(future, 1000);
+                
+                res.status = result.success ? 200 : 503;
+                res.set_content(result.toJson(), "application/json");
+                
+            } catch (const std::logic_error& e) {
+                res.status = 400;
+                json error;
+                error["error"] = "compare must be a hex hash";
+                res.set_content(error.dump(), "application/json");
+            } catch (const std::runtime_error& e) {
+                res.status = 500;
+                json error;
+                error["error"] = e.what();
+                res.set_content(error.dump(), "application/json");
+            }
+        });
+    
+    // Instant replay: writes the last seconds of play to a capture file,
+    // optional JSON body {"path": "..."}
+    addPostRoute("/api/replay/save",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            try {
+                std::string path;
+                
+                if (!req.body.empty()) {
+                    json body = json::parse(req.body);
+                    path = body.value("path", "");
+                }
+                
+                auto cmd = std::unique_ptr<ApiCommandWithResult<InstantReplayResult>>(
+                    new InstantReplayCommand(path));
+                auto future = executeCommand(std::move(cmd), 1000);
+                InstantReplayResult result = waitForResult(future, 1000);
+                
+                res.status = result.success ? 200 : 409;
+                res.set_content(result.toJson(), "application/json");
+                
+            } catch (const std::runtime_error& e) {
+                res.status = 500;
+                json error;
+                error["error"] = e.what();
+                res.set_content(error.dump(), "application/json");
+            } catch (const json::exception& e) {
+                res.status = 400;
+                json error;
+                error["error"] = std::string("Invalid JSON: ") + e.what();
+                res.set_content(error.dump(), "application/json");
+            }
+        });
+    
     addGetRoute("/api/screenshot/last",
         [this](const httplib::Request& req, httplib::Response& res) {
             try {
@@ -743,6 +1368,136 @@ void FceuxApiServer::registerRoutes()
             }
         });
     
+    // In-memory state endpoints, see Utils/StateStore.h
+    stateStore.setCapacity(getConfig().stateStoreBytes);
+
+    addPostRoute("/api/state/snapshot",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            try {
+                auto cmd = std::unique_ptr<ApiCommandWithResult<StateHandleResult>>(
+                    new StateSnapshotCommand(stateStore));
+                auto future = executeCommand(std::move(cmd), 2000);
+                StateHandleResult result = waitForResult(future, 2000);
+
+                res.status = stateResultStatus(result);
+                res.set_content(result.toJson(), "application/json");
+
+            } catch (const std::runtime_error& e) {
+                res.status = 500;
+                json error;
+                error["error"] = e.what();
+                res.set_content(error.dump(), "application/json");
+            }
+        });
+
+    addPostRoute("/api/state/restore",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            try {
+                json body = json::parse(req.body);
+                std::string handle = body.value("handle", "");
+
+                if (handle.empty()) {
+                    res.status = 400;
+                    json error;
+                    error["error"] = "handle is required";
+                    res.set_content(error.dump(), "application/json");
+                    return;
+                }
+
+                auto cmd = std::unique_ptr<ApiCommandWithResult<StateHandleResult>>(
+                    new StateRestoreCommand(stateStore, handle));
+                auto future = executeCommand(std::move(cmd), 2000);
+                StateHandleResult result = waitForResult(future, 2000);
+
+                res.status = stateResultStatus(result);
+                res.set_content(result.toJson(), "application/json");
+
+            } catch (const std::runtime_error& e) {
+                res.status = 500;
+                json error;
+                error["error"] = e.what();
+                res.set_content(error.dump(), "application/json");
+            } catch (const json::exception& e) {
+                res.status = 400;
+                json error;
+                error["error"] = std::string("Invalid JSON: ") + e.what();
+                res.set_content(error.dump(), "application/json");
+            }
+        });
+
+    // Raw state bytes, handled on the server thread; only restoring needs the emulator
+    addPostRoute("/api/state/upload",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            json response;
+
+            if (req.body.size() < 16) {
+                res.status = 400;
+                response["error"] = "Body must be a savestate";
+                res.set_content(response.dump(), "application/json");
+                return;
+            }
+            std::vector<uint8_t> data(req.body.begin(), req.body.end());
+            size_t size = data.size();
+            std::string handle = stateStore.put(std::move(data));
+
+            if (handle.empty()) {
+                res.status = 413;
+                response["error"] = "State is larger than the state store";
+                res.set_content(response.dump(), "application/json");
+                return;
+            }
+            response["success"] = true;
+            response["handle"] = handle;
+            response["size"] = size;
+
+            res.status = 200;
+            res.set_content(response.dump(), "application/json");
+        });
+
+    addGetRoute("/api/state/store",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            StateStore::Stats stats = stateStore.stats();
+            json response;
+
+            response["count"] = stats.count;
+            response["bytes"] = stats.bytes;
+            response["capacity"] = stats.capacity;
+            response["evictions"] = stats.evictions;
+
+            res.status = 200;
+            res.set_content(response.dump(), "application/json");
+        });
+
+    addGetRoute("/api/state/([0-9a-f]{16})",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            std::vector<uint8_t> data;
+
+            if (!stateStore.get(req.matches[1], data)) {
+                res.status = 404;
+                json error;
+                error["error"] = "Unknown state handle";
+                res.set_content(error.dump(), "application/json");
+                return;
+            }
+            res.status = 200;
+            res.set_content(reinterpret_cast<const char*>(data.data()), data.size(),
+                            "application/octet-stream");
+        });
+
+    addDeleteRoute("/api/state/([0-9a-f]{16})",
+        [this](const httplib::Request& req, httplib::Response& res) {
+            json response;
+
+            if (!stateStore.remove(req.matches[1])) {
+                res.status = 404;
+                response["error"] = "Unknown state handle";
+            } else {
+                res.status = 200;
+                response["success"] = true;
+            }
+            res.set_content(response.dump(), "application/json");
+        });
+
     // TODO: Add input validation framework for future POST/PUT endpoints
 }
 
@@ -796,25 +1551,55 @@ void FceuxApiServer::handleSystemCapabilities(const httplib::Request& req, httpl
         "/api/system/info",
         "/api/system/ping",
         "/api/system/capabilities",
+        "/api/system/queue",
+        "/api/system/metrics",
+        "/api/stream/frames",
+        "/api/stream/watch",
+        "/api/rpc",
         "/api/emulation/pause",
         "/api/emulation/resume",
         "/api/emulation/status",
+        "/api/emulation/timing",
+        "/api/emulation/run",
+        "/api/emulation/step",
+        "/api/frame/wait",
+        "/api/instances",
+        "/api/instances/step",
+        "/api/instances/step_batch",
+        "/api/instances/{id}",
+        "/api/instances/{id}/step",
+        "/api/instances/{id}/memory/range/{start}/{length}",
+        "/api/movie/seek",
+        "/api/taseditor/input",
         "/api/rom/info",
+        "/api/rom/index",
+        "/api/rom/prg/{offset}/{length}",
+        "/api/rom/chr/{offset}/{length}",
+        "/api/observation",
+        "/api/observation/spec",
         "/api/memory/{address}",
         "/api/memory/range/{start}/{length}",
         "/api/memory/range/{start}",
         "/api/memory/batch",
+        "/api/memory/ranges",
         "/api/ppu/memory/{address}",
         "/api/ppu/memory/range/{start}/{length}",
         "/api/input/status",
         "/api/input/port/{port}/press",
         "/api/input/port/{port}/release",
         "/api/input/port/{port}/state",
+        "/api/input/timeline",
         "/api/screenshot",
         "/api/screenshot/last",
+        "/api/screen/hash",
         "/api/savestate",
         "/api/loadstate",
-        "/api/savestate/list"
+        "/api/savestate/list",
+        "/api/state/snapshot",
+        "/api/state/restore",
+        "/api/state/upload",
+        "/api/state/store",
+        "/api/state/{handle}"
     });
     
     // Feature flags
@@ -822,15 +1607,504 @@ void FceuxApiServer::handleSystemCapabilities(const httplib::Request& req, httpl
         {"emulation_control", true},
         {"memory_access", true},
         {"memory_range_access", true},
+        {"binary_responses", true},
+        {"frame_streaming", true},
+        {"memory_watch", true},
+        {"frame_step", true},
         {"input_control", true},
+        {"input_timeline", true},
+        {"binary_rpc", true},
+        {"instances", true},
+        {"vector_step", true},
+        {"observations", true},
         {"save_states", true},
-        {"screenshots", true}
+        {"screenshots", true},
+        {"screen_hash", true},
+        {"stage_metrics", true},
+        {"rom_data", true},
+        {"gzip_responses", getConfig().compressMinBytes > 0}
+    };
+    
+    res.set_content(response.dump(), "application/json");
+    res.status = 200;
+}
+
+void FceuxApiServer::handleSystemQueue(const httplib::Request& req, httplib::Response& res)
+{
+    CommandQueue& queue = getRestApiCommandQueue();
+    CommandPool& pool = CommandPool::instance();
+    json response;
+    
+    response["depth"] = queue.size();
+    response["high_water_mark"] = queue.highWaterMark();
+    response["max_size"] = queue.getMaxSize();
+    response["total_pushed"] = queue.totalPushed();
+    response["total_rejected"] = queue.totalRejected();
+    
+    response["pool"] = {
+        {"blocks", pool.blockCount()},
+        {"block_size", CommandPool::BLOCK_SIZE},
+        {"in_use", pool.blocksInUse()},
+        {"fallback_allocations", pool.fallbackAllocations()}
     };
     
+    // Optional: ?reset=1 restarts high-water tracking after reading it
+    if (req.has_param("reset") && req.get_param_value("reset") == "1") {
+        queue.resetHighWaterMark();
+    }
+    
     res.set_content(response.dump(), "application/json");
     res.status = 200;
 }
 
+void FceuxApiServer::handleSystemMetrics(const httplib::Request& req, httplib::Response& res)
+{
+    std::vector<fceuMutexSiteStat_t> sites;
+
+    fceuWrapperGetMutexStats(sites);
+
+    if (sites.size() > kMutexMetricSites) {
+        sites.resize(kMutexMetricSites);
+    }
+    std::vector<RouteMetrics*> routes = RouteMetricsRegistry::instance().active();
+
+    // Prometheus text exposition by default, ?format=json for the same totals as JSON
+    if (req.has_param("format") && req.get_param_value("format") == "json") {
+        json response = json::parse(FCEU_StageProfileJson());
+        json mutexSites = json::array();
+
+        for (const auto& s : sites) {
+            mutexSites.push_back({
+                {"site", s.site},
+                {"function", s.func},
+                {"locks", s.locks},
+                {"timeouts", s.timeouts},
+                {"emulator_blocked_ms", s.emuBlocked * 1e3},
+                {"wait", mutexHistJson(s.wait)},
+                {"hold", mutexHistJson(s.hold)}
+            });
+        }
+        response["emulator_mutex"] = mutexSites;
+
+        json restRoutes = json::array();
+
+        for (const auto* r : routes) {
+            timingHistStat_t queueWait, execution, serialization, total;
+
+            r->queueWait.getStats(&queueWait);
+            r->execution.getStats(&execution);
+            r->serialization.getStats(&serialization);
+            r->total.getStats(&total);
+
+            restRoutes.push_back({
+                {"route", r->route},
+                {"requests", r->requests.load(std::memory_order_relaxed)},
+                {"timeouts", r->timeouts.load(std::memory_order_relaxed)},
+                {"queue_full", r->queueFull.load(std::memory_order_relaxed)},
+                {"queue_wait", mutexHistJson(queueWait)},
+                {"execution", mutexHistJson(execution)},
+                {"serialization", mutexHistJson(serialization)},
+                {"total", mutexHistJson(total)}
+            });
+        }
+        response["rest_routes"] = restRoutes;
+
+        res.set_content(response.dump(), "application/json");
+    } else {
+        res.set_content(FCEU_StageProfilePrometheus() + mutexMetricsPrometheus(sites) + frameStageMetricsPrometheus() +
+            routeMetricsPrometheus(routes),
+            "text/plain; version=0.0.4");
+    }
+    res.status = 200;
+}
+
+void FceuxApiServer::beforeStop()
+{
+    // Wake stream connections and frame long-polls so their worker threads can finish
+    FrameStreamHub::instance().closeAll();
+    MemoryWatchHub::instance().closeAll();
+    FrameClock::instance().closeAll();
+
+    if (stateSnapshotSubscribed.exchange(false)) {
+        emuStateSnapshotUnsubscribe();
+    }
+}
+
+void FceuxApiServer::subscribeStateSnapshot()
+{
+    if (!stateSnapshotSubscribed.exchange(true)) {
+        emuStateSnapshotSubscribe();
+    }
+}
+
+void FceuxApiServer::handleStreamFrames(const httplib::Request& req, httplib::Response& res)
+{
+    FrameStreamOptions opts;
+    
+    try {
+        if (req.has_param("video")) {
+            std::string video = req.get_param_value("video");
+            if (video == "raw") {
+                opts.video = FrameStreamOptions::Video::Raw;
+            } else if (video == "diff") {
+                opts.video = FrameStreamOptions::Video::Diff;
+            } else if (video == "none") {
+                opts.video = FrameStreamOptions::Video::None;
+            } else {
+                throw std::runtime_error("Invalid video mode: " + video);
+            }
+        }
+        
+        if (req.has_param("every")) {
+            int every = std::stoi(req.get_param_value("every"));
+            if ((every < 1) || (every > 600)) {
+                throw std::runtime_error("'every' must be between 1 and 600");
+            }
+            opts.every = static_cast<unsigned int>(every);
+        }
+        
+        if (req.has_param("queue")) {
+            int queue = std::stoi(req.get_param_value("queue"));
+            if ((queue < 1) || (queue > 60)) {
+                throw std::runtime_error("'queue' must be between 1 and 60");
+            }
+            opts.maxQueue = static_cast<size_t>(queue);
+        }
+        
+        // ranges=0x0000:2048,0x6000:256
+        if (req.has_param("ranges")) {
+            std::string spec = req.get_param_value("ranges");
+            size_t total = 0;
+            size_t pos = 0;
+            
+            while (pos < spec.size()) {
+                size_t comma = spec.find(',', pos);
+                if (comma == std::string::npos) {
+                    comma = spec.size();
+                }
+                std::string item = spec.substr(pos, comma - pos);
+                pos = comma + 1;
+                
+                size_t colon = item.find(':');
+                if (colon == std::string::npos) {
+                    throw std::runtime_error("Invalid range: " + item);
+                }
+                FrameStreamRange range;
+                range.start = parseAddress(QString::fromStdString(item.substr(0, colon)));
+                int length = std::stoi(item.substr(colon + 1));
+                if ((length <= 0) || (length > MAX_MEMORY_RANGE_LENGTH)) {
+                    throw std::runtime_error("Length must be between 1 and 4096");
+                }
+                if (range.start + length > 0x10000) {
+                    throw std::runtime_error("Address range exceeds memory bounds");
+                }
+                range.length = static_cast<uint16_t>(length);
+                
+                total += range.length;
+                opts.ranges.push_back(range);
+            }
+            
+            if (opts.ranges.size() > 16) {
+                throw std::runtime_error("Too many ranges, maximum is 16");
+            }
+            if (total > MAX_MEMORY_RANGE_LENGTH) {
+                throw std::runtime_error("Total range length exceeds maximum of 4096 bytes");
+            }
+        }
+    } catch (const std::exception& e) {
+        // std::stoi reports bad numbers as invalid_argument/out_of_range
+        json error;
+        error["error"] = e.what();
+        res.status = 400;
+        res.set_content(error.dump(), "application/json");
+        return;
+    }
+    
+    std::shared_ptr<FrameSubscriber> subscriber = FrameStreamHub::instance().subscribe(opts);
+    if (!subscriber) {
+        json error;
+        error["error"] = "Too many stream subscribers";
+        res.status = 503;
+        res.set_content(error.dump(), "application/json");
+        return;
+    }
+    
+    res.status = 200;
+    res.set_header("Cache-Control", "no-cache");
+    res.set_chunked_content_provider("text/event-stream",
+        [subscriber](size_t offset, httplib::DataSink& sink) {
+            FrameStreamEvent event;
+            
+            if (subscriber->waitEvent(event, 1000)) {
+                std::string message = subscriber->encodeEvent(event);
+                return sink.write(message.data(), message.size());
+            }
+            if (subscriber->isClosed()) {
+                sink.done();
+                return true;
+            }
+            
+            // Comment line keeps proxies from timing out a paused emulator
+            static const char keepalive[] = ": keepalive\n\n";
+            return sink.write(keepalive, sizeof(keepalive) - 1);
+        },
+        [subscriber](bool success) {
+            FrameStreamHub::instance().unsubscribe(subscriber);
+        });
+}
+
+void FceuxApiServer::handleStreamWatch(const httplib::Request& req, httplib::Response& res)
+{
+    MemoryWatchOptions opts;
+    
+    try {
+        if (req.has_param("queue")) {
+            int queue = std::stoi(req.get_param_value("queue"));
+            if ((queue < 1) || (queue > 600)) {
+                throw std::runtime_error("'queue' must be between 1 and 600");
+            }
+            opts.maxQueue = static_cast<size_t>(queue);
+        }
+        
+        // watch=0x0075:2,0x00CE:1:eq=5,0x0700:1:cross=100,0x0300:256
+        if (!req.has_param("watch")) {
+            throw std::runtime_error("Missing 'watch' list");
+        }
+        std::string spec = req.get_param_value("watch");
+        size_t total = 0;
+        size_t pos = 0;
+        
+        while (pos < spec.size()) {
+            size_t comma = spec.find(',', pos);
+            if (comma == std::string::npos) {
+                comma = spec.size();
+            }
+            std::string item = spec.substr(pos, comma - pos);
+            pos = comma + 1;
+            
+            size_t colon = item.find(':');
+            if (colon == std::string::npos) {
+                throw std::runtime_error("Invalid watch: " + item);
+            }
+            size_t predicateColon = item.find(':', colon + 1);
+            
+            MemoryWatchEntry entry;
+            entry.start = parseAddress(QString::fromStdString(item.substr(0, colon)));
+            int length = std::stoi(item.substr(colon + 1, predicateColon - colon - 1));
+            if ((length <= 0) || (length > MAX_MEMORY_RANGE_LENGTH)) {
+                throw std::runtime_error("Length must be between 1 and 4096");
+            }
+            if (entry.start + length > 0x10000) {
+                throw std::runtime_error("Address range exceeds memory bounds");
+            }
+            entry.length = static_cast<uint16_t>(length);
+            
+            if (predicateColon != std::string::npos) {
+                std::string predicate = item.substr(predicateColon + 1);
+                
+                if (predicate == "changed") {
+                    entry.predicate = MemoryWatchEntry::Predicate::Changed;
+                } else if (predicate.compare(0, 3, "eq=") == 0) {
+                    entry.predicate = MemoryWatchEntry::Predicate::Equals;
+                    entry.operand = static_cast<uint32_t>(std::stoul(predicate.substr(3), nullptr, 0));
+                } else if (predicate.compare(0, 6, "cross=") == 0) {
+                    entry.predicate = MemoryWatchEntry::Predicate::Crosses;
+                    entry.operand = static_cast<uint32_t>(std::stoul(predicate.substr(6), nullptr, 0));
+                } else {
+                    throw std::runtime_error("Invalid predicate: " + predicate);
+                }
+                if ((entry.predicate != MemoryWatchEntry::Predicate::Changed) &&
+                    (entry.length > MemoryWatchEntry::MAX_VALUE_LENGTH)) {
+                    throw std::runtime_error("eq and cross need a length of 1 to 4 bytes");
+                }
+            }
+            
+            total += entry.length;
+            opts.entries.push_back(entry);
+        }
+        
+        if (opts.entries.empty()) {
+            throw std::runtime_error("Missing 'watch' list");
+        }
+        if (opts.entries.size() > MemoryWatchHub::MAX_WATCH_ENTRIES) {
+            throw std::runtime_error("Too many watches, maximum is 64");
+        }
+        if (total > MemoryWatchHub::MAX_WATCH_BYTES) {
+            throw std::runtime_error("Total watch length exceeds maximum of 4096 bytes");
+        }
+    } catch (const std::exception& e) {
+        // std::stoi reports bad numbers as invalid_argument/out_of_range
+        json error;
+        error["error"] = e.what();
+        res.status = 400;
+        res.set_content(error.dump(), "application/json");
+        return;
+    }
+    
+    std::shared_ptr<MemoryWatcher> watcher = MemoryWatchHub::instance().subscribe(opts);
+    if (!watcher) {
+        json error;
+        error["error"] = "Too many memory watchers";
+        res.status = 503;
+        res.set_content(error.dump(), "application/json");
+        return;
+    }
+    
+    res.status = 200;
+    res.set_header("Cache-Control", "no-cache");
+    res.set_chunked_content_provider("text/event-stream",
+        [watcher](size_t offset, httplib::DataSink& sink) {
+            MemoryWatchEvent event;
+            
+            if (watcher->waitEvent(event, 1000)) {
+                std::string message = watcher->encodeEvent(event);
+                return sink.write(message.data(), message.size());
+            }
+            if (watcher->isClosed()) {
+                sink.done();
+                return true;
+            }
+            
+            // Quiet memory sends nothing, keep proxies from timing out
+            static const char keepalive[] = ": keepalive\n\n";
+            return sink.write(keepalive, sizeof(keepalive) - 1);
+        },
+        [watcher](bool success) {
+            MemoryWatchHub::instance().unsubscribe(watcher);
+        });
+}
+
+// Binary RPC limits, steps match POST /api/emulation/step
+static const unsigned int kRpcCommandTimeoutMs = 2000;
+static const unsigned int kRpcStepFrameTimeoutMs = 50;
+static const uint16_t kRpcMaxStepFrames = 3600;
+// Instance frames run back to back, without waiting for the frame pacing
+static const unsigned int kRpcBatchFrameTimeoutMs = 5;
+
+void FceuxApiServer::handleRpc(const httplib::Request& req, httplib::Response& res)
+{
+    std::vector<RpcRequestOp> ops;
+    std::string decodeError;
+
+    if (!decodeRpcRequest(req.body, ops, decodeError)) {
+        res.status = 400;
+        json error;
+        error["error"] = decodeError;
+        res.set_content(error.dump(), "application/json");
+        return;
+    }
+
+    std::vector<RpcResult> results;
+    results.reserve(ops.size());
+    bool stopped = false;
+    size_t i = 0;
+
+    while (i < ops.size()) {
+        if (stopped) {
+            // An earlier operation timed out, the emulator state is unknown
+            RpcResult skipped;
+            skipped.op = ops[i].op;
+            skipped.status = RpcStatus::Timeout;
+            skipped.payload = "Not run";
+            results.push_back(skipped);
+            i++;
+            continue;
+        }
+
+        if (ops[i].op == RpcOp::Step) {
+            RpcResult result;
+            result.op = RpcOp::Step;
+            unsigned int frames = ops[i].frames;
+            i++;
+
+            if ((frames < 1) || (frames > kRpcMaxStepFrames)) {
+                result.status = RpcStatus::BadRequest;
+                result.payload = "Frames must be 1 to 3600";
+                results.push_back(result);
+                continue;
+            }
+
+            try {
+                std::promise<FrameClockTick> done;
+                auto tick = done.get_future();
+
+                auto cmd = std::unique_ptr<ApiCommandWithResult<StepStart>>(new StepCommand(frames, std::move(done)));
+                auto future = executeCommand(std::move(cmd), kRpcCommandTimeoutMs);
+                waitForResult(future, kRpcCommandTimeoutMs);
+
+                unsigned int timeoutMs = kRpcCommandTimeoutMs + frames * kRpcStepFrameTimeoutMs;
+                if (tick.wait_for(std::chrono::milliseconds(timeoutMs)) == std::future_status::timeout) {
+                    throw std::runtime_error("Step timeout");
+                }
+                FrameClockTick last = tick.get();
+                rpcAppendU64(result.payload, last.id);
+                rpcAppendU32(result.payload, static_cast<uint32_t>(last.frame));
+
+            } catch (const std::runtime_error& e) {
+                std::string errorMsg = e.what();
+                result.payload = errorMsg;
+                if (errorMsg == "No game loaded") {
+                    result.status = RpcStatus::NoGame;
+                } else if (errorMsg == "Step timeout" || errorMsg == "Command execution timeout") {
+                    result.status = RpcStatus::Timeout;
+                    stopped = true;
+                } else {
+                    result.status = RpcStatus::Failed;
+                }
+            }
+            results.push_back(result);
+            continue;
+        }
+
+        // Everything up to the next step runs in one emulator thread pass
+        size_t end = i;
+        while ((end < ops.size()) && (ops[end].op != RpcOp::Step)) {
+            end++;
+        }
+        std::vector<RpcRequestOp> run(std::make_move_iterator(ops.begin() + i),
+                                      std::make_move_iterator(ops.begin() + end));
+        std::vector<RpcOp> runOps;
+        unsigned int runTimeoutMs = kRpcCommandTimeoutMs;
+        for (const auto& op : run) {
+            runOps.push_back(op.op);
+            if (op.op == RpcOp::StepBatch) {
+                runTimeoutMs += static_cast<unsigned int>(op.ids.size() * op.frames) * kRpcBatchFrameTimeoutMs;
+            }
+        }
+        i = end;
+
+        try {
+            auto cmd = std::unique_ptr<ApiCommandWithResult<RpcBatchResult>>(
+                new RpcBatchCommand(std::move(run), stateStore));
+            auto future = executeCommand(std::move(cmd), runTimeoutMs);
+            RpcBatchResult batch = waitForResult(future, runTimeoutMs);
+
+            for (auto& result : batch.results) {
+                results.push_back(std::move(result));
+            }
+        } catch (const std::runtime_error& e) {
+            std::string errorMsg = e.what();
+            RpcStatus status = RpcStatus::Failed;
+            if (errorMsg == "No game loaded") {
+                status = RpcStatus::NoGame;
+            } else if (errorMsg == "Command execution timeout") {
+                status = RpcStatus::Timeout;
+                stopped = true;
+            }
+            for (RpcOp op : runOps) {
+                RpcResult result;
+                result.op = op;
+                result.status = status;
+                result.payload = errorMsg;
+                results.push_back(result);
+            }
+        }
+    }
+
+    res.status = 200;
+    res.set_content(encodeRpcResponse(results), "application/octet-stream");
+}
+
 QString FceuxApiServer::getCurrentTimestamp() const
 {
     return QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
@@ -849,6 +2123,8 @@ void FceuxApiServer::handleInputError(const std::runtime_error& e, httplib::Resp
         res.status = 400;  // Bad Request
     } else if (errorMsg == "No game loaded") {
         res.status = 503;  // Service Unavailable
+    } else if (errorMsg == "Input timeline full") {
+        res.status = 409;  // Conflict
     } else if (errorMsg == "Command execution timeout") {
         res.status = 504;  // Gateway Timeout
     } else {
@@ -2,7 +2,9 @@
 #define __FCEUX_API_SERVER_H__
 
 #include "RestApiServer.h"
+#include "Utils/StateStore.h"
 #include <QString>
+#include <atomic>
 
 /**
  * @brief FCEUX-specific REST API server implementation
@@ -23,6 +25,11 @@ protected:
      * @brief Register FCEUX-specific API routes
      */
     void registerRoutes() override;
+    
+    /**
+     * @brief Close frame stream subscribers before the server stops
+     */
+    void beforeStop() override;
 
 private:
     /**
@@ -40,6 +47,31 @@ private:
      */
     void handleSystemCapabilities(const httplib::Request& req, httplib::Response& res);
 
+    /**
+     * @brief GET /api/system/queue - Returns command queue depth and pool statistics
+     */
+    void handleSystemQueue(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief GET /api/system/metrics - Time spent per emulation stage, Prometheus or JSON
+     */
+    void handleSystemMetrics(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief GET /api/stream/frames - Server-Sent Events stream of frames and RAM
+     */
+    void handleStreamFrames(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief GET /api/stream/watch - Server-Sent Events of watched memory changes
+     */
+    void handleStreamWatch(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief POST /api/rpc - Binary batch of step, input, memory, state and frame operations
+     */
+    void handleRpc(const httplib::Request& req, httplib::Response& res);
+
     /**
      * @brief Get current ISO 8601 timestamp
      */
@@ -49,6 +81,21 @@ private:
      * @brief Handle errors for input endpoints
      */
     void handleInputError(const std::runtime_error& e, httplib::Response& res);
+
+    /**
+     * @brief States of the /api/state endpoints, capped by RestApiConfig::stateStoreBytes
+     */
+    /**
+     * @brief Have the emulator publish its state snapshot until the server stops
+     * 
+     * Memory reads answer from the snapshot instead of queueing a command
+     * when it holds what they ask for. The first read subscribes, so a
+     * server nobody reads memory from costs the emulator nothing.
+     */
+    void subscribeStateSnapshot();
+
+    StateStore stateStore;
+    std::atomic<bool> stateSnapshotSubscribed{false};
 };
 
 #endif // __FCEUX_API_SERVER_H__
\ No newline at end of file
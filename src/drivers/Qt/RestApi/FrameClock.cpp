@@ -0,0 +1,124 @@
+#include "FrameClock.h"
+#include <chrono>
+#include <stdexcept>
+
+FrameClock& FrameClock::instance() {
+    static FrameClock clock;
+    return clock;
+}
+
+FrameClock::FrameClock()
+    : lastId(0),
+      waiters(0),
+      stepCount(0),
+      lastTickFrame(0),
+      lastFrame(-1),
+      closeCount(0),
+      pauseWhenDone(false) {
+}
+
+bool FrameClock::frameDone(int frame, bool lagged) {
+    if (frame == lastFrame) {
+        return false;  // Nothing new was emulated
+    }
+    lastFrame = frame;
+
+    lastTickFrame.store(frame);
+    uint64_t id = lastId.fetch_add(1) + 1;
+
+    if ((waiters.load() == 0) && (stepCount.load() == 0)) {
+        return false;
+    }
+    bool pauseNow = false;
+    std::vector<Step> finished;
+    {
+        std::lock_guard<std::mutex> lock(clockMutex);
+
+        for (size_t i = 0; i < steps.size(); ) {
+            if (steps[i].untilInput && lagged) {
+                steps[i].lagFrames++;
+            }
+            if ((steps[i].target <= id) || (steps[i].untilInput && !lagged)) {
+                finished.push_back(std::move(steps[i]));
+                steps.erase(steps.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        stepCount.store(steps.size());
+
+        if (steps.empty() && pauseWhenDone && !finished.empty()) {
+            pauseWhenDone = false;
+            pauseNow = true;
+        }
+    }
+    clockCond.notify_all();
+
+    for (auto& step : finished) {
+        FrameClockTick tick = { id, frame, step.lagFrames };
+        step.done.set_value(tick);
+    }
+    return pauseNow;
+}
+
+bool FrameClock::waitAfter(uint64_t after, unsigned int timeoutMs, FrameClockTick& tick) {
+    std::unique_lock<std::mutex> lock(clockMutex);
+
+    // Counted before the predicate is checked, so frameDone() either sees
+    // the waiter or the waiter sees the new id
+    waiters.fetch_add(1);
+    const uint64_t closes = closeCount;
+    bool ready = clockCond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]() {
+        return (lastId.load() > after) || (closeCount != closes);
+    });
+    waiters.fetch_sub(1);
+
+    tick.id = lastId.load();
+    tick.frame = lastTickFrame.load();
+    tick.lagFrames = 0;
+
+    return ready && (tick.id > after);
+}
+
+uint64_t FrameClock::addStep(unsigned int frames, std::promise<FrameClockTick>&& done, bool pauseAfter,
+                             bool untilInput) {
+    if (frames < 1) {
+        frames = 1;
+    }
+    std::lock_guard<std::mutex> lock(clockMutex);
+
+    Step step;
+    step.target = lastId.load() + frames;
+    step.done = std::move(done);
+    step.untilInput = untilInput;
+    step.lagFrames = 0;
+    steps.push_back(std::move(step));
+    stepCount.store(steps.size());
+
+    // A step started while an earlier one runs the paused emulator keeps
+    // it running until both are done
+    pauseWhenDone = pauseWhenDone || pauseAfter;
+
+    return steps.back().target;
+}
+
+void FrameClock::cancelSteps(const std::string& reason) {
+    std::vector<Step> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(clockMutex);
+        cancelled.swap(steps);
+        stepCount.store(0);
+        pauseWhenDone = false;
+    }
+    for (auto& step : cancelled) {
+        step.done.set_exception(std::make_exception_ptr(std::runtime_error(reason)));
+    }
+}
+
+void FrameClock::closeAll() {
+    {
+        std::lock_guard<std::mutex> lock(clockMutex);
+        closeCount++;
+    }
+    clockCond.notify_all();
+}
@@ -0,0 +1,117 @@
+#ifndef __FRAME_CLOCK_H__
+#define __FRAME_CLOCK_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A frame an API client waited for
+ */
+struct FrameClockTick {
+    uint64_t id;    ///< Frame id, counts every completed frame since startup
+    int frame;      ///< Frame counter of that frame
+    unsigned int lagFrames;  ///< Frames of the step that did not read input
+};
+
+/**
+ * @brief Completed frame notifications for steps and long-polls
+ *
+ * The frame id is a monotonic count of the frames the emulator thread
+ * finished, unlike the frame counter it never goes backwards on a state
+ * load or power cycle. Loop iterations that did not emulate anything
+ * (emulation paused) do not advance it.
+ *
+ * frameDone() is called by the emulator thread once per loop iteration
+ * with the emulator mutex held. It costs two atomic loads while nobody is
+ * waiting and no step is pending.
+ */
+class FrameClock {
+public:
+    static FrameClock& instance();
+
+    FrameClock();
+
+    /**
+     * @brief Id of the last completed frame
+     */
+    uint64_t currentId() const { return lastId.load(); }
+
+    /**
+     * @brief Record the end of an emulator loop iteration
+     *
+     * Repeated calls with the same frame counter are ignored. Completes the
+     * steps that reached their frame.
+     *
+     * @param frame Current frame counter
+     * @param lagged The frame did not read the controllers
+     * @return true when the last pending step asked for emulation to be
+     *         paused again, the caller then pauses before the next frame
+     */
+    bool frameDone(int frame, bool lagged = false);
+
+    /**
+     * @brief Wait for a frame newer than an id
+     *
+     * @param after Frame id already seen by the client
+     * @param timeoutMs Longest time to wait
+     * @param tick Newest frame, also filled in on timeout
+     * @return false on timeout or when closeAll() was called
+     */
+    bool waitAfter(uint64_t after, unsigned int timeoutMs, FrameClockTick& tick);
+
+    /**
+     * @brief Complete a promise once a number of frames more are done
+     *
+     * Emulator thread only. The promise is kept until the frame is done, or
+     * failed by cancelSteps().
+     *
+     * @param frames Frames to wait for, at least 1
+     * @param done Promise receiving the frame that completed the step
+     * @param pauseAfter Pause emulation once no step is pending any more
+     * @param untilInput Complete early, with the first frame that reads the
+     *                   controllers; frames is then the most to wait for
+     * @return Frame id the step completes at at the latest
+     */
+    uint64_t addStep(unsigned int frames, std::promise<FrameClockTick>&& done, bool pauseAfter,
+                     bool untilInput = false);
+
+    /**
+     * @brief Fail every pending step, used when the game is closed
+     *
+     * @param reason Exception message given to the waiting requests
+     */
+    void cancelSteps(const std::string& reason);
+
+    size_t pendingSteps() const { return stepCount.load(); }
+
+    /**
+     * @brief Wake the long-polls waiting now, used when the server stops
+     */
+    void closeAll();
+
+private:
+    struct Step {
+        uint64_t target;
+        std::promise<FrameClockTick> done;
+        bool untilInput;
+        unsigned int lagFrames;
+    };
+
+    std::mutex clockMutex;
+    std::condition_variable clockCond;
+    std::vector<Step> steps;
+    std::atomic<uint64_t> lastId;
+    std::atomic<size_t> waiters;
+    std::atomic<size_t> stepCount;
+    std::atomic<int> lastTickFrame;
+    int lastFrame;
+    uint64_t closeCount;
+    bool pauseWhenDone;
+};
+
+#endif // __FRAME_CLOCK_H__
@@ -0,0 +1,218 @@
+#include "FrameStream.h"
+#include "Utils/BinaryResponse.h"
+#include "Utils/FrameDiff.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+const int FrameStreamHub::FRAME_WIDTH;
+const int FrameStreamHub::FRAME_HEIGHT;
+const size_t FrameStreamHub::FRAME_SIZE;
+const size_t FrameStreamHub::MAX_SUBSCRIBERS;
+
+// FrameSubscriber implementation
+
+FrameSubscriber::FrameSubscriber(const FrameStreamOptions& options)
+    : opts(options),
+      closed(false),
+      dropped(0),
+      lastQueuedFrame(-1) {
+    if (opts.every < 1) {
+        opts.every = 1;
+    }
+    if (opts.maxQueue < 1) {
+        opts.maxQueue = 1;
+    }
+}
+
+bool FrameSubscriber::due(int frame) {
+    if ((lastQueuedFrame >= 0) && (frame - lastQueuedFrame < static_cast<int>(opts.every)) &&
+        (frame >= lastQueuedFrame)) {
+        return false;
+    }
+    // A frame counter that went backwards (state load, power cycle) restarts pacing
+    lastQueuedFrame = frame;
+    return true;
+}
+
+void FrameSubscriber::push(FrameStreamEvent&& event) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (pending.size() >= opts.maxQueue) {
+            pending.pop_front();
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        pending.push_back(std::move(event));
+    }
+    queueCond.notify_one();
+}
+
+void FrameSubscriber::close() {
+    closed.store(true, std::memory_order_release);
+    {
+        // Taking the lock orders the store against a waiter checking the predicate
+        std::lock_guard<std::mutex> lock(queueMutex);
+    }
+    queueCond.notify_all();
+}
+
+bool FrameSubscriber::waitEvent(FrameStreamEvent& event, unsigned int timeoutMs) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+
+    queueCond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] {
+        return !pending.empty() || closed.load(std::memory_order_acquire);
+    });
+
+    if (pending.empty() || closed.load(std::memory_order_acquire)) {
+        return false;
+    }
+    event = std::move(pending.front());
+    pending.pop_front();
+    return true;
+}
+
+std::string FrameSubscriber::encodeEvent(const FrameStreamEvent& event) {
+    std::ostringstream json;
+    json << "{\"frame\":" << event.frame << ",";
+    json << "\"dropped\":" << droppedEvents();
+
+    if ((opts.video != FrameStreamOptions::Video::None) && event.video) {
+        const std::vector<uint8_t>& cur = *event.video;
+        const char* encoding = "raw";
+        std::string payload;
+        bool sendDiff = false;
+
+        if (opts.video == FrameStreamOptions::Video::Diff) {
+            encoding = "key";
+            if (lastSentVideo.size() == cur.size()) {
+                std::string diff = encodeFrameDiff(lastSentVideo.data(), cur.data(), cur.size());
+                // A diff bigger than the frame is not worth it, send a key frame
+                if (diff.size() < cur.size()) {
+                    encoding = "diff";
+                    payload = base64Encode(reinterpret_cast<const uint8_t*>(diff.data()), diff.size());
+                    sendDiff = true;
+                }
+            }
+            lastSentVideo = cur;
+        }
+        if (!sendDiff) {
+            payload = base64Encode(cur.data(), cur.size());
+        }
+
+        json << ",\"video\":{\"encoding\":\"" << encoding << "\","
+             << "\"width\":" << FrameStreamHub::FRAME_WIDTH << ","
+             << "\"height\":" << FrameStreamHub::FRAME_HEIGHT << ","
+             << "\"data\":\"" << payload << "\"}";
+    }
+
+    if (!opts.ranges.empty()) {
+        json << ",\"ranges\":[";
+        size_t offset = 0;
+        for (size_t i = 0; i < opts.ranges.size(); i++) {
+            const FrameStreamRange& range = opts.ranges[i];
+            size_t length = std::min<size_t>(range.length, event.samples.size() - offset);
+
+            if (i > 0) json << ",";
+            json << "{\"start\":\"0x"
+                 << std::hex << std::setfill('0') << std::setw(4) << range.start << "\","
+                 << std::dec << "\"data\":\""
+                 << base64Encode(event.samples.data() + offset, length) << "\"}";
+            offset += length;
+        }
+        json << "]";
+    }
+    json << "}";
+
+    std::ostringstream sse;
+    sse << "event: frame\n";
+    sse << "id: " << event.frame << "\n";
+    sse << "data: " << json.str() << "\n\n";
+    return sse.str();
+}
+
+// FrameStreamHub implementation
+
+FrameStreamHub& FrameStreamHub::instance() {
+    static FrameStreamHub hub;
+    return hub;
+}
+
+FrameStreamHub::FrameStreamHub()
+    : count(0),
+      lastFrame(-1) {
+}
+
+std::shared_ptr<FrameSubscriber> FrameStreamHub::subscribe(const FrameStreamOptions& opts) {
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+
+    if (subscribers.size() >= MAX_SUBSCRIBERS) {
+        return nullptr;
+    }
+
+    std::shared_ptr<FrameSubscriber> subscriber(new FrameSubscriber(opts));
+    subscribers.push_back(subscriber);
+    count.store(subscribers.size(), std::memory_order_relaxed);
+    return subscriber;
+}
+
+void FrameStreamHub::unsubscribe(const std::shared_ptr<FrameSubscriber>& subscriber) {
+    if (!subscriber) {
+        return;
+    }
+    subscriber->close();
+
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), subscriber),
+                      subscribers.end());
+    count.store(subscribers.size(), std::memory_order_relaxed);
+}
+
+void FrameStreamHub::closeAll() {
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+
+    for (auto& subscriber : subscribers) {
+        subscriber->close();
+    }
+    subscribers.clear();
+    count.store(0, std::memory_order_relaxed);
+}
+
+void FrameStreamHub::publish(int frame, const uint8_t* video, ByteReader readByte) {
+    if (count.load(std::memory_order_relaxed) == 0) {
+        lastFrame = -1;
+        return;
+    }
+    if (frame == lastFrame) {
+        return;  // Nothing new was emulated
+    }
+    lastFrame = frame;
+
+    std::shared_ptr<const std::vector<uint8_t>> frameCopy;
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+
+    for (auto& subscriber : subscribers) {
+        if (!subscriber->due(frame)) {
+            continue;
+        }
+        const FrameStreamOptions& opts = subscriber->options();
+
+        FrameStreamEvent event;
+        event.frame = frame;
+
+        if ((opts.video != FrameStreamOptions::Video::None) && (video != nullptr)) {
+            // One copy per frame, shared by every subscriber that wants it
+            if (!frameCopy) {
+                frameCopy = std::make_shared<const std::vector<uint8_t>>(video, video + FRAME_SIZE);
+            }
+            event.video = frameCopy;
+        }
+
+        for (const auto& range : opts.ranges) {
+            for (uint32_t i = 0; i < range.length; i++) {
+                event.samples.push_back(readByte(range.start + i));
+            }
+        }
+        subscriber->push(std::move(event));
+    }
+}
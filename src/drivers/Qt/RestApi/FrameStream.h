@@ -0,0 +1,163 @@
+#ifndef __FRAME_STREAM_H__
+#define __FRAME_STREAM_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Memory range sent with every streamed frame
+ */
+struct FrameStreamRange {
+    uint16_t start;     ///< Starting CPU address
+    uint16_t length;    ///< Number of bytes
+};
+
+/**
+ * @brief Per-subscriber stream settings
+ */
+struct FrameStreamOptions {
+    enum class Video {
+        None,   ///< No picture, RAM ranges only
+        Raw,    ///< Full indexed 8-bit frame every event
+        Diff    ///< Changes against the previously sent frame
+    };
+
+    Video video = Video::Raw;
+    unsigned int every = 1;                 ///< Send every Nth emulated frame
+    std::vector<FrameStreamRange> ranges;   ///< RAM sampled with each frame
+    size_t maxQueue = 4;                    ///< Pending events before dropping the oldest
+};
+
+/**
+ * @brief One emulated frame captured for a subscriber
+ */
+struct FrameStreamEvent {
+    int frame;                                          ///< Frame counter
+    std::shared_ptr<const std::vector<uint8_t>> video;  ///< Indexed pixels, shared between subscribers
+    std::vector<uint8_t> samples;                       ///< Range bytes, back to back
+};
+
+/**
+ * @brief A connected stream client
+ *
+ * Events are queued by the emulator thread and drained by the HTTP thread
+ * serving the connection. A slow client never blocks the emulator, once
+ * maxQueue events are pending the oldest is dropped and counted.
+ */
+class FrameSubscriber {
+public:
+    explicit FrameSubscriber(const FrameStreamOptions& opts);
+
+    const FrameStreamOptions& options() const { return opts; }
+
+    /**
+     * @brief Wait for the next event
+     * @return false on timeout or when the subscriber was closed
+     */
+    bool waitEvent(FrameStreamEvent& event, unsigned int timeoutMs);
+
+    /**
+     * @brief Encode an event as a Server-Sent Events message
+     *
+     * Keeps the previously sent frame for diff mode, so call it only from
+     * the thread serving the connection and for every event sent.
+     */
+    std::string encodeEvent(const FrameStreamEvent& event);
+
+    bool isClosed() const { return closed.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Events dropped because the client fell behind
+     */
+    uint64_t droppedEvents() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    friend class FrameStreamHub;
+
+    FrameStreamOptions opts;
+
+    std::mutex queueMutex;
+    std::condition_variable queueCond;
+    std::deque<FrameStreamEvent> pending;
+    std::atomic<bool> closed;
+    std::atomic<uint64_t> dropped;
+
+    // Emulator thread only
+    int lastQueuedFrame;
+
+    // Connection thread only
+    std::vector<uint8_t> lastSentVideo;
+
+    bool due(int frame);
+    void push(FrameStreamEvent&& event);
+    void close();
+};
+
+/**
+ * @brief Fan-out of completed frames to stream subscribers
+ *
+ * publish() is called by the emulator thread once per loop iteration with
+ * the emulator mutex held. It costs one atomic load while nobody is
+ * subscribed, and one copy of the frame buffer per frame that at least one
+ * subscriber is due for.
+ */
+class FrameStreamHub {
+public:
+    static const int FRAME_WIDTH = 256;
+    static const int FRAME_HEIGHT = 240;
+    static const size_t FRAME_SIZE = FRAME_WIDTH * FRAME_HEIGHT;
+
+    /// Each subscriber holds an HTTP worker thread for its connection
+    static const size_t MAX_SUBSCRIBERS = 4;
+
+    typedef uint8_t (*ByteReader)(uint32_t address);
+
+    static FrameStreamHub& instance();
+
+    FrameStreamHub();
+
+    /**
+     * @brief Register a new subscriber
+     * @return Subscriber, or nullptr if MAX_SUBSCRIBERS are connected
+     */
+    std::shared_ptr<FrameSubscriber> subscribe(const FrameStreamOptions& opts);
+
+    /**
+     * @brief Remove a subscriber and wake its connection
+     */
+    void unsubscribe(const std::shared_ptr<FrameSubscriber>& subscriber);
+
+    /**
+     * @brief Close every subscriber, used when the server stops
+     */
+    void closeAll();
+
+    size_t subscriberCount() const { return count.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Offer the frame just emulated to all subscribers
+     *
+     * Repeated calls with the same frame number (emulation paused) are
+     * ignored.
+     *
+     * @param frame Current frame counter
+     * @param video Frame buffer, at least FRAME_SIZE bytes, may be null
+     * @param readByte CPU memory reader for the RAM ranges
+     */
+    void publish(int frame, const uint8_t* video, ByteReader readByte);
+
+private:
+    std::mutex subscribersMutex;
+    std::vector<std::shared_ptr<FrameSubscriber>> subscribers;
+    std::atomic<size_t> count;
+    int lastFrame;
+};
+
+#endif // __FRAME_STREAM_H__
@@ -1,4 +1,7 @@
 #include "InputApi.h"
+#include "InputTimeline.h"
+
+extern int currFrameCounter;
 
 // API input overlay masks (similar to Lua's luajoypads1/2)
 uint8_t apiJoypadMask1[4] = { 0xFF, 0xFF, 0xFF, 0xFF };  // AND mask - all bits pass through by default
@@ -13,6 +16,10 @@ void FCEU_ApiInputInit() {
 }
 
 uint8_t FCEU_ApiReadJoypad(int which, uint8_t joyl) {
+    // Scheduled input replaces the port input on its frames, press and
+    // state overlays below still apply on top of it
+    InputTimeline::instance().apply(currFrameCounter, which, joyl);
+
     // Apply the overlay masks just like Lua does
     // AND with mask1 clears bits where mask1 has 0
     // OR with mask2 sets bits where mask2 has 1
@@ -11,7 +11,7 @@ extern uint8_t apiJoypadMask2[4];  // OR mask  (1 = force set, 0 = no effect)
 // Initialize the API input system
 void FCEU_ApiInputInit();
 
-// Apply API input overlays to controller state
+// Apply scheduled input and API input overlays to controller state
 // Called from UpdateGP() in input.cpp, similar to FCEU_LuaReadJoypad
 uint8_t FCEU_ApiReadJoypad(int which, uint8_t joyl);
 
@@ -0,0 +1,94 @@
+#include "InputTimeline.h"
+#include <algorithm>
+
+const size_t InputTimeline::CAPACITY;
+
+InputTimeline& InputTimeline::instance() {
+    static InputTimeline timeline;
+    return timeline;
+}
+
+InputTimeline::InputTimeline()
+    : head(0) {
+    events.reserve(CAPACITY);
+}
+
+static int eventEnd(const InputTimelineEvent& event) {
+    return event.frame + event.frames;
+}
+
+void InputTimeline::compact() {
+    // Reuse the consumed front before the buffer would have to grow
+    if (head > 0) {
+        events.erase(events.begin(), events.begin() + head);
+        head = 0;
+    }
+}
+
+bool InputTimeline::schedule(const InputTimelineEvent& event) {
+    if (size() >= CAPACITY) {
+        return false;
+    }
+    if (events.size() >= CAPACITY) {
+        compact();
+    }
+    InputTimelineEvent added = event;
+    if (added.frames < 1) {
+        added.frames = 1;
+    }
+
+    // Usually scheduled in order, so this is an append; equal frames keep their order
+    auto pos = std::upper_bound(events.begin() + head, events.end(), added,
+        [](const InputTimelineEvent& a, const InputTimelineEvent& b) {
+            return a.frame < b.frame;
+        });
+    events.insert(pos, added);
+    return true;
+}
+
+void InputTimeline::expire(int frame) {
+    // Events are sorted by start only, a long event in front keeps
+    // shorter ones behind it until it ends; apply() skips those
+    while ((head < events.size()) && (eventEnd(events[head]) <= frame)) {
+        head++;
+    }
+    if (head == events.size()) {
+        events.clear();
+        head = 0;
+    }
+}
+
+bool InputTimeline::apply(int frame, int port, uint8_t& buttons) {
+    expire(frame);
+
+    bool covered = false;
+    uint8_t held = 0;
+
+    for (size_t i = head; (i < events.size()) && (events[i].frame <= frame); i++) {
+        const InputTimelineEvent& event = events[i];
+
+        if ((event.port == port) && (frame < eventEnd(event))) {
+            held |= event.buttons;
+            covered = true;
+        }
+    }
+    if (covered) {
+        buttons = held;
+    }
+    return covered;
+}
+
+size_t InputTimeline::clear() {
+    size_t removed = size();
+    events.clear();
+    head = 0;
+    return removed;
+}
+
+int InputTimeline::endFrame() const {
+    int end = -1;
+    for (size_t i = head; i < events.size(); i++) {
+        end = std::max(end, eventEnd(events[i]));
+    }
+    return end;
+}
@@ -0,0 +1,89 @@
+#ifndef __INPUT_TIMELINE_H__
+#define __INPUT_TIMELINE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Buttons held on one port for a run of frames
+ */
+struct InputTimelineEvent {
+    int frame;          ///< First frame, by frame counter, the buttons are held
+    uint16_t frames;    ///< Number of frames held, at least 1
+    uint8_t port;       ///< Controller port (0-3)
+    uint8_t buttons;    ///< Button bitmask
+};
+
+/**
+ * @brief Input scheduled ahead of time for exact frames
+ *
+ * Events are kept sorted by start frame in a fixed capacity buffer that is
+ * consumed from the front as frames go by. While an event covers the
+ * frame being emulated, its buttons replace the port's input (several
+ * events covering the same frame and port are combined), so the timing no
+ * longer depends on when the request arrived.
+ *
+ * Emulator thread only: events are added from a command and applied from
+ * the joypad read in UpdateGP().
+ */
+class InputTimeline {
+public:
+    static const size_t CAPACITY = 4096;
+
+    static InputTimeline& instance();
+
+    InputTimeline();
+
+    /**
+     * @brief Add an event
+     *
+     * @return false if the timeline is full
+     */
+    bool schedule(const InputTimelineEvent& event);
+
+    /**
+     * @brief Input of a port for the frame being emulated
+     *
+     * Drops the events that ended before the frame.
+     *
+     * @param frame Frame counter of the frame being emulated
+     * @param port Controller port (0-3)
+     * @param buttons Port input, replaced when an event covers the frame
+     * @return true if an event covered the frame
+     */
+    bool apply(int frame, int port, uint8_t& buttons);
+
+    /**
+     * @brief Drop every event that ends at or before a frame
+     */
+    void expire(int frame);
+
+    /**
+     * @brief Remove all events
+     * @return Number of events removed
+     */
+    size_t clear();
+
+    size_t size() const { return events.size() - head; }
+
+    bool empty() const { return size() == 0; }
+
+    /**
+     * @brief Start frame of the earliest event, -1 when empty
+     */
+    int nextFrame() const { return empty() ? -1 : events[head].frame; }
+
+    /**
+     * @brief Frame after the last frame any event covers, -1 when empty
+     */
+    int endFrame() const;
+
+private:
+    std::vector<InputTimelineEvent> events;
+    size_t head;    ///< First event not consumed yet
+
+    void compact();
+};
+
+#endif // __INPUT_TIMELINE_H__
@@ -0,0 +1,338 @@
+#include "InstanceController.h"
+#include "CommandQueue.h"
+#include "CommandExecution.h"
+#include "Commands/InputCommands.h"
+#include "Commands/InstanceCommands.h"
+#include "Utils/AddressParser.h"
+#include "../../../lib/httplib.h"
+#include "../../../lib/json.hpp"
+#include <QString>
+#include <memory>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+// Timeout for command execution (2 seconds)
+static constexpr unsigned int COMMAND_TIMEOUT_MS = 2000;
+
+// Extra time allowed per instance frame, including the state swap
+static constexpr unsigned int INSTANCE_FRAME_TIMEOUT_MS = 5;
+
+static unsigned int parseInstanceId(const std::string& text) {
+    try {
+        return static_cast<unsigned int>(std::stoul(text));
+    } catch (const std::exception&) {
+        throw std::invalid_argument("Invalid instance id");
+    }
+}
+
+void InstanceController::setError(const std::string& error, httplib::Response& res) {
+    if (error == "No game loaded") {
+        res.status = 503;  // Service Unavailable
+    } else if (error == "Unknown instance") {
+        res.status = 404;  // Not Found
+    } else if ((error == "Instances share the loaded ROM") ||
+               (error == "Instances cannot run while a movie is active")) {
+        res.status = 409;  // Conflict
+    } else if ((error.find("Too many instances") != std::string::npos) ||
+               (error == "Action count does not match the instances")) {
+        res.status = 400;  // Bad Request
+    } else if (error == "Command execution timeout") {
+        res.status = 504;  // Gateway Timeout
+    } else {
+        res.status = 500;  // Internal Server Error
+    }
+    json response;
+    response["success"] = false;
+    response["error"] = error;
+    res.set_content(response.dump(), "application/json");
+}
+
+void InstanceController::handleCreate(const httplib::Request& req, httplib::Response& res) {
+    try {
+        std::unique_ptr<ApiCommandWithResult<InstanceListResult>> cmd;
+
+        try {
+            size_t count = 1;
+            std::string rom;
+
+            if (!req.body.empty()) {
+                json body = json::parse(req.body);
+                int value = body.value("count", 1);
+                if (value < 1) {
+                    throw std::runtime_error("Count must be between 1 and 64");
+                }
+                count = static_cast<size_t>(value);
+                rom = body.value("rom", "");
+            }
+            cmd.reset(new InstanceCreateCommand(count, rom));
+
+        } catch (const std::exception& e) {
+            throw std::invalid_argument(e.what());
+        }
+
+        auto future = executeCommand(std::move(cmd), COMMAND_TIMEOUT_MS);
+        InstanceListResult result = waitForResult(future, COMMAND_TIMEOUT_MS);
+
+        res.status = 201;
+        res.set_content(result.toJson(), "application/json");
+
+    } catch (const std::invalid_argument& e) {
+        res.status = 400;
+        json response;
+        response["success"] = false;
+        response["error"] = e.what();
+        res.set_content(response.dump(), "application/json");
+    } catch (const std::exception& e) {
+        setError(e.what(), res);
+    }
+}
+
+void InstanceController::handleList(const httplib::Request& req, httplib::Response& res) {
+    try {
+        auto cmd = std::unique_ptr<ApiCommandWithResult<InstanceListResult>>(new InstanceListCommand());
+        auto future = executeCommand(std::move(cmd), COMMAND_TIMEOUT_MS);
+        InstanceListResult result = waitForResult(future, COMMAND_TIMEOUT_MS);
+
+        res.status = 200;
+        res.set_content(result.toJson(), "application/json");
+
+    } catch (const std::exception& e) {
+        setError(e.what(), res);
+    }
+}
+
+void InstanceController::handleDelete(const httplib::Request& req, httplib::Response& res) {
+    try {
+        unsigned int id = parseInstanceId(req.matches[1]);
+
+        auto cmd = std::unique_ptr<ApiCommandWithResult<InstanceListResult>>(new InstanceDeleteCommand(id));
+        auto future = executeCommand(std::move(cmd), COMMAND_TIMEOUT_MS);
+        InstanceListResult result = waitForResult(future, COMMAND_TIMEOUT_MS);
+
+        res.status = 200;
+        res.set_content(result.toJson(), "application/json");
+
+    } catch (const std::exception& e) {
+        setError(e.what(), res);
+    }
+}
+
+void InstanceController::runStep(const std::string& text, const std::vector<unsigned int>& selected,
+                                 bool single, httplib::Response& res) {
+    try {
+        std::vector<unsigned int> ids = selected;
+        std::unique_ptr<ApiCommandWithResult<InstanceStepResult>> cmd;
+        unsigned int frames = 1;
+
+        // Anything that goes wrong before the command is queued is the
+        // client's fault, report it as invalid_argument
+        try {
+            json body = text.empty() ? json::object() : json::parse(text);
+            std::vector<InstanceInput> inputs;
+            std::vector<InstanceReadRange> ranges;
+
+            int value = body.value("frames", 1);
+            if ((value < 0) || (static_cast<unsigned int>(value) > MAX_INSTANCE_STEP_FRAMES)) {
+                throw std::runtime_error("Frames must be 0 to 600");
+            }
+            frames = static_cast<unsigned int>(value);
+
+            if (!single && body.contains("ids")) {
+                if (!body["ids"].is_array()) {
+                    throw std::runtime_error("Invalid 'ids' array");
+                }
+                for (const auto& id : body["ids"]) {
+                    ids.push_back(id.get<unsigned int>());
+                }
+            }
+
+            if (body.contains("input")) {
+                if (!body["input"].is_array()) {
+                    throw std::runtime_error("Invalid 'input' array");
+                }
+                for (const auto& item : body["input"]) {
+                    if (!item.contains("buttons") || !item["buttons"].is_array()) {
+                        throw std::runtime_error("Missing or invalid input 'buttons'");
+                    }
+                    InstanceInput input;
+                    if (single) {
+                        input.id = ids[0];
+                    } else if (item.contains("id")) {
+                        input.id = item["id"].get<unsigned int>();
+                    } else {
+                        throw std::runtime_error("Missing input 'id'");
+                    }
+
+                    int port = item.value("port", 1);
+                    if ((port < 1) || (port > 4)) {
+                        throw std::runtime_error("Invalid port number");
+                    }
+                    input.port = static_cast<uint8_t>(port - 1);
+                    input.buttons = buttonNamesToBitmask(item["buttons"].get<std::vector<std::string>>());
+                    inputs.push_back(input);
+                }
+            }
+
+            if (body.contains("ranges")) {
+                if (!body["ranges"].is_array()) {
+                    throw std::runtime_error("Invalid 'ranges' array");
+                }
+                for (const auto& item : body["ranges"]) {
+                    if (!item.contains("start") || !item["start"].is_string()) {
+                        throw std::runtime_error("Missing or invalid range 'start'");
+                    }
+                    int length = item.value("length", 0);
+                    if ((length <= 0) || (static_cast<size_t>(length) > MAX_INSTANCE_READ_BYTES)) {
+                        throw std::runtime_error("Length must be between 1 and 4096");
+                    }
+                    InstanceReadRange range;
+                    range.start = parseAddress(QString::fromStdString(item["start"].get<std::string>()));
+                    range.length = static_cast<uint16_t>(length);
+                    ranges.push_back(range);
+                }
+            }
+
+            cmd.reset(new InstanceStepCommand(ids, frames, inputs, ranges));
+
+        } catch (const std::exception& e) {
+            throw std::invalid_argument(e.what());
+        }
+
+        size_t count = ids.empty() ? InstancePool::MAX_INSTANCES : ids.size();
+        unsigned int timeoutMs = COMMAND_TIMEOUT_MS +
+            static_cast<unsigned int>(count * frames) * INSTANCE_FRAME_TIMEOUT_MS;
+        auto future = executeCommand(std::move(cmd), timeoutMs);
+        InstanceStepResult result = waitForResult(future, timeoutMs);
+
+        res.status = 200;
+        res.set_content(result.toJson(), "application/json");
+
+    } catch (const std::invalid_argument& e) {
+        res.status = 400;
+        json response;
+        response["success"] = false;
+        response["error"] = e.what();
+        res.set_content(response.dump(), "application/json");
+    } catch (const std::exception& e) {
+        setError(e.what(), res);
+    }
+}
+
+void InstanceController::handleBatchStep(const httplib::Request& req, httplib::Response& res) {
+    runStep(req.body, std::vector<unsigned int>(), false, res);
+}
+
+void InstanceController::handleStep(const httplib::Request& req, httplib::Response& res) {
+    try {
+        std::vector<unsigned int> ids(1, parseInstanceId(req.matches[1]));
+        runStep(req.body, ids, true, res);
+    } catch (const std::invalid_argument& e) {
+        res.status = 400;
+        json response;
+        response["success"] = false;
+        response["error"] = e.what();
+        res.set_content(response.dump(), "application/json");
+    }
+}
+
+void InstanceController::handleStepBatch(const httplib::Request& req, httplib::Response& res) {
+    try {
+        std::unique_ptr<ApiCommandWithResult<InstanceBatchResult>> cmd;
+        size_t count = 0;
+        unsigned int frames = 1;
+
+        try {
+            json body = json::parse(req.body);
+            std::vector<unsigned int> ids;
+            std::vector<uint8_t> actions;
+            InstanceBatchLayout layout;
+
+            if (!body.contains("actions") || !body["actions"].is_array()) {
+                throw std::runtime_error("Missing or invalid 'actions' array");
+            }
+            for (const auto& action : body["actions"]) {
+                if (action.is_array()) {
+                    actions.push_back(buttonNamesToBitmask(action.get<std::vector<std::string>>()));
+                } else if (action.is_number_unsigned() && (action.get<unsigned int>() <= 0xFF)) {
+                    actions.push_back(static_cast<uint8_t>(action.get<unsigned int>()));
+                } else {
+                    throw std::runtime_error("Invalid action");
+                }
+            }
+
+            if (body.contains("ids")) {
+                if (!body["ids"].is_array()) {
+                    throw std::runtime_error("Invalid 'ids' array");
+                }
+                for (const auto& id : body["ids"]) {
+                    ids.push_back(id.get<unsigned int>());
+                }
+            }
+
+            int skip = body.value("frameskip", 1);
+            if ((skip < 1) || (static_cast<unsigned int>(skip) > MAX_INSTANCE_FRAMESKIP)) {
+                throw std::runtime_error("Frameskip must be 1 to 60");
+            }
+            frames = static_cast<unsigned int>(skip);
+
+            layout.ram = body.value("ram", true);
+            int scale = body.value("frame_scale", 0);
+            if (scale < 0) {
+                throw std::runtime_error("Frame scale must be 0, 1, 2 or 4");
+            }
+            layout.frameScale = static_cast<unsigned int>(scale);
+
+            count = ids.empty() ? InstancePool::MAX_INSTANCES : ids.size();
+            cmd.reset(new InstanceStepBatchCommand(ids, actions, frames, layout));
+
+        } catch (const std::exception& e) {
+            throw std::invalid_argument(e.what());
+        }
+
+        unsigned int timeoutMs = COMMAND_TIMEOUT_MS +
+            static_cast<unsigned int>(count * frames) * INSTANCE_FRAME_TIMEOUT_MS;
+        auto future = executeCommand(std::move(cmd), timeoutMs);
+        InstanceBatchResult result = waitForResult(future, timeoutMs);
+
+        std::string order;
+        for (unsigned int id : result.ids) {
+            if (!order.empty()) {
+                order += ",";
+            }
+            order += std::to_string(id);
+        }
+
+        res.status = 200;
+        res.set_header("X-Observation-Size", std::to_string(result.layout.size()));
+        res.set_header("X-Instance-Ids", order);
+        res.set_content(std::string(result.data.begin(), result.data.end()), "application/octet-stream");
+
+    } catch (const std::invalid_argument& e) {
+        res.status = 400;
+        json response;
+        response["success"] = false;
+        response["error"] = e.what();
+        res.set_content(response.dump(), "application/json");
+    } catch (const std::exception& e) {
+        setError(e.what(), res);
+    }
+}
+
+void InstanceController::handleReadRange(const httplib::Request& req, httplib::Response& res) {
+    try {
+        std::vector<unsigned int> ids(1, parseInstanceId(req.matches[1]));
+
+        json body;
+        body["frames"] = 0;
+        body["ranges"] = json::array({{{"start", req.matches[2].str()},
+                                       {"length", std::stoi(req.matches[3])}}});
+        runStep(body.dump(), ids, true, res);
+    } catch (const std::exception& e) {
+        res.status = 400;
+        json response;
+        response["success"] = false;
+        response["error"] = e.what();
+        res.set_content(response.dump(), "application/json");
+    }
+}
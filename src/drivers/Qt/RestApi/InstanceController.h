@@ -0,0 +1,121 @@
+#ifndef __INSTANCE_CONTROLLER_H__
+#define __INSTANCE_CONTROLLER_H__
+
+#include <string>
+#include <vector>
+
+// Forward declarations
+namespace httplib {
+    struct Request;
+    struct Response;
+}
+
+/**
+ * @brief REST API controller for the emulator instance endpoints
+ *
+ * Instances are extra consoles of the loaded game held by InstancePool.
+ * All handlers execute commands on the emulator thread via the command
+ * queue.
+ */
+class InstanceController {
+public:
+    /**
+     * @brief Handle POST /api/instances
+     *
+     * Forks instances from the running console.
+     *
+     * Request body (optional):
+     * {
+     *   "count": 8,              // 1-64, default 1
+     *   "rom": "/path/game.nes"  // must be the loaded ROM when given
+     * }
+     *
+     * Error responses:
+     * - 400 Bad Request: Invalid count, or the pool would pass 64 instances
+     * - 409 Conflict: Another ROM than the loaded one was asked for
+     * - 503 Service Unavailable: No game loaded
+     */
+    static void handleCreate(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle GET /api/instances
+     */
+    static void handleList(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle DELETE /api/instances/{id}
+     *
+     * Error responses:
+     * - 404 Not Found: Unknown instance
+     */
+    static void handleDelete(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle POST /api/instances/step
+     *
+     * Steps several instances and returns their memory.
+     *
+     * Request body:
+     * {
+     *   "frames": 1,                                       // 0-600, 0 only reads
+     *   "ids": [2, 3],                                     // optional, default all
+     *   "input": [{"id": 2, "port": 1, "buttons": ["A"]}], // optional, held until changed
+     *   "ranges": [{"start": "0x0000", "length": 2048}]    // optional
+     * }
+     *
+     * Error responses:
+     * - 400 Bad Request: Invalid request body
+     * - 404 Not Found: Unknown instance
+     * - 409 Conflict: A movie is active
+     * - 503 Service Unavailable: No game loaded
+     * - 504 Gateway Timeout: Command execution timeout
+     */
+    static void handleBatchStep(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle POST /api/instances/{id}/step
+     *
+     * Same body and response as the batch step, without "ids" and "id".
+     */
+    static void handleStep(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle POST /api/instances/step_batch
+     *
+     * Steps instances as a vector environment and returns every
+     * observation in one application/octet-stream body, ram then frame per
+     * instance. X-Observation-Size gives the bytes per instance and
+     * X-Instance-Ids the instance order.
+     *
+     * Request body:
+     * {
+     *   "actions": [0, ["A", "RIGHT"]],  // port 1 masks or button names, per instance
+     *   "ids": [2, 3],                   // optional, default all
+     *   "frameskip": 4,                  // 1-60, default 1
+     *   "ram": true,                     // 2 KB of work RAM, default true
+     *   "frame_scale": 2                 // 0 none, 1, 2 or 4, default 0
+     * }
+     *
+     * Error responses: as the batch step, 400 also for a bad action count
+     */
+    static void handleStepBatch(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle GET /api/instances/{id}/memory/range/{start}/{length}
+     */
+    static void handleReadRange(const httplib::Request& req, httplib::Response& res);
+
+private:
+    // Prevent instantiation
+    InstanceController() = delete;
+    ~InstanceController() = delete;
+
+    // Parse a step body and run it on the instances
+    static void runStep(const std::string& body, const std::vector<unsigned int>& ids,
+                        bool single, httplib::Response& res);
+
+    // Map an error to its status and set the response
+    static void setError(const std::string& error, httplib::Response& res);
+};
+
+#endif // __INSTANCE_CONTROLLER_H__
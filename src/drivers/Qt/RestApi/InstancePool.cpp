@@ -0,0 +1,173 @@
+#include "InstancePool.h"
+#include "InputApi.h"
+#include "../../../context.h"
+#include "../../../fceu.h"
+#include "../../../driver.h"
+#include "../../../input.h"
+#include "../../../movie.h"
+#include "../../../video.h"
+#include <cstring>
+#include <stdexcept>
+
+const size_t InstancePool::MAX_INSTANCES;
+const size_t InstanceBatchLayout::RAM_BYTES;
+
+InstancePool& InstancePool::instance() {
+    static InstancePool pool;
+    return pool;
+}
+
+InstancePool::InstancePool()
+    : console(new FCEU::Context()) {}
+
+InstancePool::~InstancePool() {}
+
+std::vector<unsigned int> InstancePool::create(size_t count) {
+    if (instances.size() + count > MAX_INSTANCES) {
+        throw std::runtime_error("Too many instances (maximum 64)");
+    }
+
+    std::vector<unsigned int> ids;
+    ids.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+        Instance inst;
+        inst.context.reset(new FCEU::Context());
+        std::memset(inst.buttons, 0, sizeof(inst.buttons));
+
+        if (!inst.context->capture()) {
+            throw std::runtime_error("Console state capture failed");
+        }
+        unsigned int id = inst.context->id();
+        instances[id] = std::move(inst);
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+bool InstancePool::remove(unsigned int id) {
+    return instances.erase(id) > 0;
+}
+
+void InstancePool::clear() {
+    instances.clear();
+    console->reset();
+}
+
+bool InstancePool::contains(unsigned int id) const {
+    return instances.count(id) > 0;
+}
+
+InstanceInfo InstancePool::info(unsigned int id, const Instance& inst) const {
+    InstanceInfo result;
+    result.id = id;
+    result.frame = inst.context->frameCount();
+    result.lag = inst.context->lagCount();
+    std::memcpy(result.buttons, inst.buttons, sizeof(result.buttons));
+    return result;
+}
+
+std::vector<InstanceInfo> InstancePool::list() const {
+    std::vector<InstanceInfo> result;
+    result.reserve(instances.size());
+    for (const auto& pair : instances) {
+        result.push_back(info(pair.first, pair.second));
+    }
+    return result;
+}
+
+bool InstancePool::setInput(unsigned int id, int port, uint8_t buttons) {
+    auto it = instances.find(id);
+    if ((it == instances.end()) || (port < 0) || (port > 3)) {
+        return false;
+    }
+    it->second.buttons[port] = buttons;
+    return true;
+}
+
+void InstancePool::run(const std::vector<unsigned int>& ids, unsigned int frames, const Visitor& visit,
+                       bool render) {
+    if (!console->capture()) {
+        throw std::runtime_error("Console state capture failed");
+    }
+
+    try {
+        for (unsigned int id : ids) {
+            auto it = instances.find(id);
+            if (it == instances.end()) {
+                throw std::runtime_error("Unknown instance");
+            }
+            Instance& inst = it->second;
+            FCEU::Context::Scope scope(*inst.context);
+
+            if (!scope.ok()) {
+                throw std::runtime_error("Instance state does not load");
+            }
+
+            for (unsigned int f = 0; f < frames; f++) {
+                // Exactly the instance buttons, whatever the console is fed
+                for (int port = 0; port < 4; port++) {
+                    FCEU_ApiClearJoypad(port);
+                    FCEU_ApiSetJoypad(port, inst.buttons[port], true);
+                    FCEU_ApiSetJoypad(port, static_cast<uint8_t>(~inst.buttons[port]), false);
+                }
+
+                uint8 *gfx = nullptr;
+                int32 *sound = nullptr;
+                int32 ssize = 0;
+
+                // Skip 1 still does not render, only the last frame is drawn
+                bool draw = render && (f + 1 == frames);
+                FCEUI_Emulate(&gfx, &sound, &ssize, draw ? 0 : 2);
+            }
+            FCEU_ApiClearAllJoypads();
+
+            InstanceInfo current = info(id, inst);
+            current.frame = currFrameCounter;
+            current.lag = lagCounter;
+            visit(current);
+        }
+    } catch (...) {
+        FCEU_ApiClearAllJoypads();
+        console->activate();
+        throw;
+    }
+
+    if (!console->activate()) {
+        throw std::runtime_error("Console state does not load");
+    }
+}
+
+void InstancePool::stepBatch(const std::vector<unsigned int>& ids, const uint8_t* actions, unsigned int frames,
+                             const InstanceBatchLayout& layout, uint8_t* out) {
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (!setInput(ids[i], 0, actions[i])) {
+            throw std::runtime_error("Unknown instance");
+        }
+    }
+
+    const size_t stride = layout.size();
+    const unsigned int scale = layout.frameScale;
+    uint8_t* obs = out;
+
+    run(ids, frames, [&](const InstanceInfo&) {
+        uint8_t* dst = obs;
+
+        if (layout.ram) {
+            std::memcpy(dst, RAM, InstanceBatchLayout::RAM_BYTES);
+            dst += InstanceBatchLayout::RAM_BYTES;
+        }
+        if (scale == 1) {
+            std::memcpy(dst, XBuf, 256 * 240);
+        } else if (scale > 1) {
+            // Nearest pixel, palette indices do not average
+            for (unsigned int y = 0; y < 240; y += scale) {
+                const uint8_t* row = XBuf + y * 256;
+                for (unsigned int x = 0; x < 256; x += scale) {
+                    *dst++ = row[x];
+                }
+            }
+        }
+        obs += stride;
+    }, scale != 0);
+}
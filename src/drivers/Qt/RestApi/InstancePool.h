@@ -0,0 +1,146 @@
+#ifndef __INSTANCE_POOL_H__
+#define __INSTANCE_POOL_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace FCEU {
+    class Context;
+}
+
+/**
+ * @brief State of one emulator instance
+ */
+struct InstanceInfo {
+    unsigned int id;
+    int frame;              ///< Frame counter of the instance
+    unsigned int lag;       ///< Lag frames of the instance
+    uint8_t buttons[4];     ///< Buttons held on each port
+};
+
+/**
+ * @brief Observation written per instance by InstancePool::stepBatch()
+ *
+ * Each observation is the 2 KB of work RAM, if selected, followed by the
+ * frame palette indices sampled every frameScale pixels, if frameScale is
+ * not 0: 1 is the full 256x240 frame, 2 is 128x120, 4 is 64x60.
+ */
+struct InstanceBatchLayout {
+    static const size_t RAM_BYTES = 0x800;
+
+    bool ram = true;
+    unsigned int frameScale = 0;    ///< 0, 1, 2 or 4
+
+    size_t frameBytes() const { return frameScale ? (256 / frameScale) * (240 / frameScale) : 0; }
+
+    size_t size() const { return (ram ? RAM_BYTES : 0) + frameBytes(); }
+};
+
+/**
+ * @brief Extra consoles of the loaded game, run on request over REST
+ *
+ * Every instance is an FCEU::Context forked from the running console, so
+ * all instances share the loaded ROM. The core runs one context at a time:
+ * run() parks the console in its own context, swaps each instance in for
+ * its frames and swaps the console back, so the window keeps showing and
+ * playing the console as before.
+ *
+ * Instances ignore the keyboard, the press/state overlays and scheduled
+ * input; they only see the buttons set with setInput().
+ *
+ * Emulator thread only, with the emulator mutex held.
+ */
+class InstancePool {
+public:
+    static const size_t MAX_INSTANCES = 64;
+
+    /// Called while an instance is active, after its frames ran
+    typedef std::function<void(const InstanceInfo& info)> Visitor;
+
+    static InstancePool& instance();
+
+    InstancePool();
+    ~InstancePool();
+
+    /**
+     * @brief Fork instances from the running console
+     *
+     * @return Ids of the new instances
+     * @throws std::runtime_error if the pool would pass MAX_INSTANCES or the
+     *         console state cannot be captured
+     */
+    std::vector<unsigned int> create(size_t count);
+
+    /**
+     * @return false if the id is unknown
+     */
+    bool remove(unsigned int id);
+
+    /**
+     * @brief Drop every instance, used when the game is closed
+     */
+    void clear();
+
+    bool contains(unsigned int id) const;
+
+    size_t size() const { return instances.size(); }
+
+    std::vector<InstanceInfo> list() const;
+
+    /**
+     * @brief Set the buttons held on a port from the next frame on
+     *
+     * @param port Controller port (0-3)
+     * @return false if the id is unknown
+     */
+    bool setInput(unsigned int id, int port, uint8_t buttons);
+
+    /**
+     * @brief Run frames on instances
+     *
+     * With frames 0 the instances are only made active, to read their
+     * memory in the visitor.
+     *
+     * @param ids Instances, in the order they run; all must exist
+     * @param frames Frames to run on each
+     * @param visit Called for each instance while it is still active
+     * @param render Render the last frame of each instance into XBuf
+     * @throws std::runtime_error if an instance cannot be activated; the
+     *         console is restored in every case
+     */
+    void run(const std::vector<unsigned int>& ids, unsigned int frames, const Visitor& visit,
+             bool render = false);
+
+    /**
+     * @brief Step instances in lockstep, vector environment style
+     *
+     * Holds actions[i] on port 1 of ids[i], runs the frames on each and
+     * writes the observations back to back into out, in ids order.
+     *
+     * @param ids Instances; all must exist
+     * @param actions One port 1 button mask per instance
+     * @param frames Frames per instance, the frame skip, at least 1
+     * @param layout What each observation holds
+     * @param out ids.size() * layout.size() bytes
+     * @throws std::runtime_error as run()
+     */
+    void stepBatch(const std::vector<unsigned int>& ids, const uint8_t* actions, unsigned int frames,
+                   const InstanceBatchLayout& layout, uint8_t* out);
+
+private:
+    struct Instance {
+        std::unique_ptr<FCEU::Context> context;
+        uint8_t buttons[4];
+    };
+
+    std::map<unsigned int, Instance> instances;
+    std::unique_ptr<FCEU::Context> console;     ///< The console, parked during run()
+
+    InstanceInfo info(unsigned int id, const Instance& inst) const;
+};
+
+#endif // __INSTANCE_POOL_H__
@@ -0,0 +1,244 @@
+#include "MemoryWatch.h"
+#include "Utils/BinaryResponse.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+const uint16_t MemoryWatchEntry::MAX_VALUE_LENGTH;
+const size_t MemoryWatchHub::MAX_WATCHERS;
+const size_t MemoryWatchHub::MAX_WATCH_BYTES;
+const size_t MemoryWatchHub::MAX_WATCH_ENTRIES;
+
+// Little endian value of a watched range
+static uint32_t watchValue(const uint8_t* bytes, uint16_t length) {
+    uint32_t value = 0;
+    for (uint16_t i = 0; i < length; i++) {
+        value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+static bool predicateFired(const MemoryWatchEntry& entry, uint32_t value, uint32_t previous) {
+    switch (entry.predicate) {
+        case MemoryWatchEntry::Predicate::Equals:
+            return (value == entry.operand) && (previous != entry.operand);
+        case MemoryWatchEntry::Predicate::Crosses:
+            return (previous < entry.operand) != (value < entry.operand);
+        case MemoryWatchEntry::Predicate::Changed:
+        default:
+            return value != previous;
+    }
+}
+
+// MemoryWatcher implementation
+
+MemoryWatcher::MemoryWatcher(const MemoryWatchOptions& options)
+    : opts(options),
+      closed(false),
+      needResync(false),
+      dropped(0),
+      primed(false) {
+    if (opts.maxQueue < 1) {
+        opts.maxQueue = 1;
+    }
+    size_t total = 0;
+    for (const auto& entry : opts.entries) {
+        total += entry.length;
+    }
+    previous.assign(total, 0);
+    current.assign(total, 0);
+}
+
+void MemoryWatcher::evaluate(int frame, ByteReader readByte) {
+    size_t offset = 0;
+    for (const auto& entry : opts.entries) {
+        for (uint32_t i = 0; i < entry.length; i++) {
+            current[offset + i] = readByte(entry.start + i);
+        }
+        offset += entry.length;
+    }
+
+    const bool resync = !primed || needResync.exchange(false);
+    MemoryWatchEvent event;
+    event.frame = frame;
+    event.resync = resync;
+
+    offset = 0;
+    for (size_t i = 0; i < opts.entries.size(); i++) {
+        const MemoryWatchEntry& entry = opts.entries[i];
+        const uint8_t* cur = &current[offset];
+        const uint8_t* prev = &previous[offset];
+
+        if (entry.length <= MemoryWatchEntry::MAX_VALUE_LENGTH) {
+            uint32_t value = watchValue(cur, entry.length);
+            uint32_t before = primed ? watchValue(prev, entry.length) : value;
+
+            if (resync || predicateFired(entry, value, before)) {
+                MemoryWatchChange change = { static_cast<uint16_t>(i), entry.start, 0, 0, value, before };
+                event.changes.push_back(change);
+            }
+        } else {
+            // Long ranges only watch for changes, reported as runs of changed bytes
+            uint32_t pos = 0;
+            while (pos < entry.length) {
+                if (!resync && (cur[pos] == prev[pos])) {
+                    pos++;
+                    continue;
+                }
+                uint32_t end = pos + 1;
+                while ((end < entry.length) && (resync || (cur[end] != prev[end]))) {
+                    end++;
+                }
+                MemoryWatchChange change = { static_cast<uint16_t>(i),
+                                             static_cast<uint16_t>(entry.start + pos),
+                                             static_cast<uint16_t>(event.data.size()),
+                                             static_cast<uint16_t>(end - pos), 0, 0 };
+                event.changes.push_back(change);
+                event.data.insert(event.data.end(), cur + pos, cur + end);
+                pos = end;
+            }
+        }
+        offset += entry.length;
+    }
+
+    previous.swap(current);
+    primed = true;
+
+    if (!event.changes.empty()) {
+        push(std::move(event));
+    }
+}
+
+void MemoryWatcher::push(MemoryWatchEvent&& event) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (pending.size() >= opts.maxQueue) {
+            pending.pop_front();
+            dropped.fetch_add(1, std::memory_order_relaxed);
+
+            // The lost changes are only recovered by reporting everything again
+            needResync.store(true);
+        }
+        pending.push_back(std::move(event));
+    }
+    queueCond.notify_one();
+}
+
+void MemoryWatcher::close() {
+    closed.store(true, std::memory_order_release);
+    {
+        // Taking the lock orders the store against a waiter checking the predicate
+        std::lock_guard<std::mutex> lock(queueMutex);
+    }
+    queueCond.notify_all();
+}
+
+bool MemoryWatcher::waitEvent(MemoryWatchEvent& event, unsigned int timeoutMs) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+
+    queueCond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] {
+        return !pending.empty() || closed.load(std::memory_order_acquire);
+    });
+
+    if (pending.empty() || closed.load(std::memory_order_acquire)) {
+        return false;
+    }
+    event = std::move(pending.front());
+    pending.pop_front();
+    return true;
+}
+
+std::string MemoryWatcher::encodeEvent(const MemoryWatchEvent& event) const {
+    std::ostringstream json;
+    json << "{\"frame\":" << event.frame << ",";
+    json << "\"dropped\":" << droppedEvents() << ",";
+    json << "\"resync\":" << (event.resync ? "true" : "false") << ",";
+    json << "\"changes\":[";
+
+    for (size_t i = 0; i < event.changes.size(); i++) {
+        const MemoryWatchChange& change = event.changes[i];
+
+        if (i > 0) json << ",";
+        json << "{\"watch\":" << change.entry << ","
+             << "\"address\":\"0x" << std::hex << std::setfill('0') << std::setw(4)
+             << change.address << "\"" << std::dec;
+
+        if (change.length == 0) {
+            json << ",\"value\":" << change.value << ",\"previous\":" << change.previous;
+        } else {
+            json << ",\"data\":\"" << base64Encode(event.data.data() + change.offset, change.length) << "\"";
+        }
+        json << "}";
+    }
+    json << "]}";
+
+    std::ostringstream sse;
+    sse << "event: watch\n";
+    sse << "id: " << event.frame << "\n";
+    sse << "data: " << json.str() << "\n\n";
+    return sse.str();
+}
+
+// MemoryWatchHub implementation
+
+MemoryWatchHub& MemoryWatchHub::instance() {
+    static MemoryWatchHub hub;
+    return hub;
+}
+
+MemoryWatchHub::MemoryWatchHub()
+    : count(0),
+      lastFrame(-1) {
+}
+
+std::shared_ptr<MemoryWatcher> MemoryWatchHub::subscribe(const MemoryWatchOptions& opts) {
+    std::lock_guard<std::mutex> lock(watchersMutex);
+
+    if (watchers.size() >= MAX_WATCHERS) {
+        return nullptr;
+    }
+
+    std::shared_ptr<MemoryWatcher> watcher(new MemoryWatcher(opts));
+    watchers.push_back(watcher);
+    count.store(watchers.size(), std::memory_order_relaxed);
+    return watcher;
+}
+
+void MemoryWatchHub::unsubscribe(const std::shared_ptr<MemoryWatcher>& watcher) {
+    if (!watcher) {
+        return;
+    }
+    watcher->close();
+
+    std::lock_guard<std::mutex> lock(watchersMutex);
+    watchers.erase(std::remove(watchers.begin(), watchers.end(), watcher), watchers.end());
+    count.store(watchers.size(), std::memory_order_relaxed);
+}
+
+void MemoryWatchHub::closeAll() {
+    std::lock_guard<std::mutex> lock(watchersMutex);
+
+    for (auto& watcher : watchers) {
+        watcher->close();
+    }
+    watchers.clear();
+    count.store(0, std::memory_order_relaxed);
+}
+
+void MemoryWatchHub::evaluate(int frame, ByteReader readByte) {
+    if (count.load(std::memory_order_relaxed) == 0) {
+        lastFrame = -1;
+        return;
+    }
+    if (frame == lastFrame) {
+        return;  // Nothing new was emulated
+    }
+    lastFrame = frame;
+
+    std::lock_guard<std::mutex> lock(watchersMutex);
+
+    for (auto& watcher : watchers) {
+        watcher->evaluate(frame, readByte);
+    }
+}
@@ -0,0 +1,182 @@
+#ifndef __MEMORY_WATCH_H__
+#define __MEMORY_WATCH_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One watched memory range and the condition that reports it
+ */
+struct MemoryWatchEntry {
+    enum class Predicate {
+        Changed,    ///< Any byte differs from the previous frame
+        Equals,     ///< Value became equal to the operand
+        Crosses     ///< Value moved across the operand, in either direction
+    };
+
+    /// Largest range compared as one little endian value
+    static const uint16_t MAX_VALUE_LENGTH = 4;
+
+    uint16_t start;                         ///< Starting CPU address
+    uint16_t length;                        ///< Number of bytes
+    Predicate predicate = Predicate::Changed;
+    uint32_t operand = 0;                   ///< Equals/Crosses value
+};
+
+/**
+ * @brief Per-subscriber watch settings
+ */
+struct MemoryWatchOptions {
+    std::vector<MemoryWatchEntry> entries;
+    size_t maxQueue = 64;   ///< Pending events before dropping the oldest
+};
+
+/**
+ * @brief A watch entry that fired on a frame
+ *
+ * Entries up to MAX_VALUE_LENGTH bytes report their value, longer Changed
+ * entries report each run of changed bytes, found in the event data.
+ */
+struct MemoryWatchChange {
+    uint16_t entry;     ///< Index in MemoryWatchOptions::entries
+    uint16_t address;   ///< First address of the value or run
+    uint16_t offset;    ///< Offset of the run bytes in the event data
+    uint16_t length;    ///< Run length, 0 for a value
+    uint32_t value;     ///< New value
+    uint32_t previous;  ///< Value on the previous frame
+};
+
+/**
+ * @brief Watch results of one frame for a subscriber
+ */
+struct MemoryWatchEvent {
+    int frame;                              ///< Frame counter
+    bool resync;                            ///< Every entry is reported, not only changes
+    std::vector<MemoryWatchChange> changes;
+    std::vector<uint8_t> data;              ///< Changed run bytes, back to back
+};
+
+/**
+ * @brief A connected watch client
+ *
+ * The emulator thread compares the watched memory with the previous frame
+ * and queues an event only when an entry fired. The first event, and the
+ * first after events were dropped for a slow client, reports every entry
+ * so the client never holds stale values.
+ */
+class MemoryWatcher {
+public:
+    explicit MemoryWatcher(const MemoryWatchOptions& opts);
+
+    const MemoryWatchOptions& options() const { return opts; }
+
+    /**
+     * @brief Wait for the next event
+     * @return false on timeout or when the watcher was closed
+     */
+    bool waitEvent(MemoryWatchEvent& event, unsigned int timeoutMs);
+
+    /**
+     * @brief Encode an event as a Server-Sent Events message
+     */
+    std::string encodeEvent(const MemoryWatchEvent& event) const;
+
+    bool isClosed() const { return closed.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Events dropped because the client fell behind
+     */
+    uint64_t droppedEvents() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    friend class MemoryWatchHub;
+
+    typedef uint8_t (*ByteReader)(uint32_t address);
+
+    MemoryWatchOptions opts;
+
+    std::mutex queueMutex;
+    std::condition_variable queueCond;
+    std::deque<MemoryWatchEvent> pending;
+    std::atomic<bool> closed;
+    std::atomic<bool> needResync;
+    std::atomic<uint64_t> dropped;
+
+    // Emulator thread only
+    std::vector<uint8_t> previous;
+    std::vector<uint8_t> current;
+    bool primed;
+
+    void evaluate(int frame, ByteReader readByte);
+    void push(MemoryWatchEvent&& event);
+    void close();
+};
+
+/**
+ * @brief Evaluation of memory watches once per frame
+ *
+ * evaluate() is called by the emulator thread once per loop iteration
+ * with the emulator mutex held, next to FrameStreamHub::publish(). It
+ * costs one atomic load while nobody is watching.
+ */
+class MemoryWatchHub {
+public:
+    /// Each watcher holds an HTTP worker thread for its connection
+    static const size_t MAX_WATCHERS = 8;
+
+    /// Watched bytes per watcher
+    static const size_t MAX_WATCH_BYTES = 4096;
+
+    /// Entries per watcher
+    static const size_t MAX_WATCH_ENTRIES = 64;
+
+    typedef uint8_t (*ByteReader)(uint32_t address);
+
+    static MemoryWatchHub& instance();
+
+    MemoryWatchHub();
+
+    /**
+     * @brief Register a new watcher
+     * @return Watcher, or nullptr if MAX_WATCHERS are connected
+     */
+    std::shared_ptr<MemoryWatcher> subscribe(const MemoryWatchOptions& opts);
+
+    /**
+     * @brief Remove a watcher and wake its connection
+     */
+    void unsubscribe(const std::shared_ptr<MemoryWatcher>& watcher);
+
+    /**
+     * @brief Close every watcher, used when the server stops
+     */
+    void closeAll();
+
+    size_t watcherCount() const { return count.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Compare the watched memory with the previous frame
+     *
+     * Repeated calls with the same frame number (emulation paused) are
+     * ignored.
+     *
+     * @param frame Current frame counter
+     * @param readByte CPU memory reader
+     */
+    void evaluate(int frame, ByteReader readByte);
+
+private:
+    std::mutex watchersMutex;
+    std::vector<std::shared_ptr<MemoryWatcher>> watchers;
+    std::atomic<size_t> count;
+    int lastFrame;
+};
+
+#endif // __MEMORY_WATCH_H__
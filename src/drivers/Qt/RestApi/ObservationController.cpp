@@ -0,0 +1,125 @@
+#include "ObservationController.h"
+#include "ObservationHub.h"
+#include "CommandQueue.h"
+#include "CommandExecution.h"
+#include "Commands/ObservationCommands.h"
+#include "../../../lib/httplib.h"
+#include "../../../lib/json.hpp"
+#include <memory>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+// Timeout for command execution (2 seconds)
+static constexpr unsigned int COMMAND_TIMEOUT_MS = 2000;
+
+static void setError(int status, const std::string& error, httplib::Response& res) {
+    res.status = status;
+    json response;
+    response["success"] = false;
+    response["error"] = error;
+    res.set_content(response.dump(), "application/json");
+}
+
+static unsigned int specValue(const json& body, const char* key, unsigned int fallback) {
+    if (!body.contains(key)) {
+        return fallback;
+    }
+    if (!body[key].is_number_unsigned()) {
+        throw std::runtime_error(std::string("Invalid '") + key + "'");
+    }
+    return body[key].get<unsigned int>();
+}
+
+void ObservationController::handleSetSpec(const httplib::Request& req, httplib::Response& res) {
+    try {
+        std::unique_ptr<ApiCommandWithResult<ObservationSpecResult>> cmd;
+
+        try {
+            json body = req.body.empty() ? json::object() : json::parse(req.body);
+            ObservationSpec spec;
+
+            if (body.contains("crop")) {
+                const json& crop = body["crop"];
+                if (!crop.is_object()) {
+                    throw std::runtime_error("Invalid 'crop' object");
+                }
+                spec.cropX = specValue(crop, "x", spec.cropX);
+                spec.cropY = specValue(crop, "y", spec.cropY);
+                spec.cropWidth = specValue(crop, "width", ObservationSpec::FRAME_WIDTH - spec.cropX);
+                spec.cropHeight = specValue(crop, "height", ObservationSpec::FRAME_HEIGHT - spec.cropY);
+            }
+            spec.width = specValue(body, "width", spec.width);
+            spec.height = specValue(body, "height", spec.height);
+            spec.stack = specValue(body, "stack", spec.stack);
+            spec.grayscale = body.value("grayscale", spec.grayscale);
+
+            std::string resample = body.value("resample", "area");
+            if (resample == "area") {
+                spec.resample = ObservationSpec::Resample::Area;
+            } else if (resample == "nearest") {
+                spec.resample = ObservationSpec::Resample::Nearest;
+            } else {
+                throw std::runtime_error("Resample must be 'area' or 'nearest'");
+            }
+
+            cmd.reset(new ObservationConfigureCommand(spec));
+
+        } catch (const std::exception& e) {
+            throw std::invalid_argument(e.what());
+        }
+
+        auto future = executeCommand(std::move(cmd), COMMAND_TIMEOUT_MS);
+        ObservationSpecResult result = waitForResult(future, COMMAND_TIMEOUT_MS);
+
+        res.status = 200;
+        res.set_content(result.toJson(), "application/json");
+
+    } catch (const std::invalid_argument& e) {
+        setError(400, e.what(), res);
+    } catch (const std::exception& e) {
+        std::string error = e.what();
+        setError((error == "Command execution timeout") ? 504 : 500, error, res);
+    }
+}
+
+void ObservationController::handleGetSpec(const httplib::Request& req, httplib::Response& res) {
+    ObservationSpecResult result;
+    result.active = ObservationHub::instance().spec(result.spec);
+
+    res.status = 200;
+    res.set_content(result.toJson(), "application/json");
+}
+
+void ObservationController::handleDeleteSpec(const httplib::Request& req, httplib::Response& res) {
+    ObservationHub::instance().disable();
+
+    ObservationSpecResult result;
+    result.active = false;
+    res.status = 200;
+    res.set_content(result.toJson(), "application/json");
+}
+
+void ObservationController::handleRead(const httplib::Request& req, httplib::Response& res) {
+    ObservationHub& hub = ObservationHub::instance();
+    std::vector<uint8_t> data;
+    ObservationSpec spec;
+    int frame = 0;
+
+    if (!hub.isActive()) {
+        setError(409, "No observation spec set", res);
+        return;
+    }
+    if (!hub.read(data, frame, spec)) {
+        setError(503, "No observation available", res);
+        return;
+    }
+
+    std::string shape = std::to_string(spec.stack) + "," + std::to_string(spec.height) + "," +
+                        std::to_string(spec.width) + "," + std::to_string(spec.channels());
+
+    res.status = 200;
+    res.set_header("X-Observation-Shape", shape);
+    res.set_header("X-Frame", std::to_string(frame));
+    res.set_content(std::string(data.begin(), data.end()), "application/octet-stream");
+}
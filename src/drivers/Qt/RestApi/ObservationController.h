@@ -0,0 +1,67 @@
+#ifndef __OBSERVATION_CONTROLLER_H__
+#define __OBSERVATION_CONTROLLER_H__
+
+// Forward declarations
+namespace httplib {
+    struct Request;
+    struct Response;
+}
+
+/**
+ * @brief REST API controller for the preprocessed observation endpoints
+ *
+ * The spec is set through the command queue, the observation itself is
+ * read straight from ObservationHub without waiting for the emulator
+ * thread.
+ */
+class ObservationController {
+public:
+    /**
+     * @brief Handle PUT /api/observation/spec
+     *
+     * Request body, every field optional:
+     * {
+     *   "crop": {"x": 0, "y": 0, "width": 256, "height": 240},
+     *   "width": 84,
+     *   "height": 84,
+     *   "resample": "area",    // or "nearest"
+     *   "grayscale": true,     // false gives RGB
+     *   "stack": 4             // 1-16
+     * }
+     *
+     * Error responses:
+     * - 400 Bad Request: Invalid spec
+     * - 504 Gateway Timeout: Command execution timeout
+     */
+    static void handleSetSpec(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle GET /api/observation/spec
+     */
+    static void handleGetSpec(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle DELETE /api/observation/spec
+     */
+    static void handleDeleteSpec(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle GET /api/observation
+     *
+     * Returns the stacked frames as application/octet-stream, oldest first.
+     * X-Observation-Shape gives stack,height,width,channels and X-Frame the
+     * frame counter of the newest frame.
+     *
+     * Error responses:
+     * - 409 Conflict: No spec set
+     * - 503 Service Unavailable: No frame processed yet
+     */
+    static void handleRead(const httplib::Request& req, httplib::Response& res);
+
+private:
+    // Prevent instantiation
+    ObservationController() = delete;
+    ~ObservationController() = delete;
+};
+
+#endif // __OBSERVATION_CONTROLLER_H__
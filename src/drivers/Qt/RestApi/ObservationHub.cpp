@@ -0,0 +1,56 @@
+#include "ObservationHub.h"
+
+ObservationHub& ObservationHub::instance() {
+    static ObservationHub hub;
+    return hub;
+}
+
+ObservationHub::ObservationHub() : active(false), lastFrame(-1) {}
+
+void ObservationHub::configure(const ObservationSpec& spec, const uint8_t* palette) {
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    pipeline.configure(spec, palette);
+    lastFrame = -1;
+    active.store(true, std::memory_order_release);
+}
+
+void ObservationHub::disable() {
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    active.store(false, std::memory_order_release);
+    pipeline.reset();
+}
+
+bool ObservationHub::spec(ObservationSpec& out) {
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    out = pipeline.spec();
+    return active.load(std::memory_order_relaxed);
+}
+
+void ObservationHub::process(int frame, const uint8_t* video) {
+    if (!active.load(std::memory_order_acquire) || (video == nullptr)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    if (frame == lastFrame) {
+        return;  // Nothing new was emulated
+    }
+    lastFrame = frame;
+    pipeline.process(video);
+}
+
+void ObservationHub::clear() {
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    pipeline.reset();
+    lastFrame = -1;
+}
+
+bool ObservationHub::read(std::vector<uint8_t>& out, int& frame, ObservationSpec& spec) {
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    if (!active.load(std::memory_order_relaxed) || (pipeline.stacked() == 0)) {
+        return false;
+    }
+    spec = pipeline.spec();
+    out.resize(spec.size());
+    frame = lastFrame;
+    return pipeline.observation(out.data());
+}
@@ -0,0 +1,78 @@
+#ifndef __OBSERVATION_HUB_H__
+#define __OBSERVATION_HUB_H__
+
+#include "Utils/ObservationPipeline.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Server-wide observation preprocessing of the console frames
+ *
+ * Once a spec is set, process() runs the pipeline on every frame the
+ * emulator thread finishes, next to FrameStreamHub::publish(), so a client
+ * fetches a ready stacked tensor instead of full screenshots. It costs one
+ * atomic load while no spec is set.
+ */
+class ObservationHub {
+public:
+    static ObservationHub& instance();
+
+    ObservationHub();
+
+    /**
+     * @brief Set the spec, dropping the stacked frames
+     *
+     * @param spec Valid spec
+     * @param palette 256 RGB triples, taken from the current palette
+     */
+    void configure(const ObservationSpec& spec, const uint8_t* palette);
+
+    /**
+     * @brief Stop processing frames
+     */
+    void disable();
+
+    bool isActive() const { return active.load(std::memory_order_acquire); }
+
+    /**
+     * @brief The configured spec
+     * @return false while no spec is set
+     */
+    bool spec(ObservationSpec& out);
+
+    /**
+     * @brief Process the frame just emulated
+     *
+     * Repeated calls with the same frame number (emulation paused) are
+     * ignored.
+     *
+     * @param frame Current frame counter
+     * @param video Frame buffer, 256x240 palette indices, may be null
+     */
+    void process(int frame, const uint8_t* video);
+
+    /**
+     * @brief Drop the stacked frames, used when the game is closed
+     */
+    void clear();
+
+    /**
+     * @brief Copy the stacked observation
+     *
+     * @param out Resized to spec.size() bytes
+     * @param frame Frame counter of the newest stacked frame
+     * @param spec Spec the observation was made with
+     * @return false while no spec is set or no frame was processed
+     */
+    bool read(std::vector<uint8_t>& out, int& frame, ObservationSpec& spec);
+
+private:
+    std::mutex pipelineMutex;
+    ObservationPipeline pipeline;
+    std::atomic<bool> active;
+    int lastFrame;
+};
+
+#endif // __OBSERVATION_HUB_H__
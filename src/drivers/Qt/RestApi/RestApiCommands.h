@@ -5,17 +5,34 @@
 #include <future>
 #include <exception>
 #include <string>
+#include <cstddef>
+#include <chrono>
+#include "CommandPool.h"
+
+struct RouteMetrics;
+
+class ReadCoalescer;
 
 /**
  * @brief Base class for all REST API commands
  * 
  * Commands are executed on the emulator thread via the command queue.
  * Derived classes must implement execute() and name() methods.
+ * 
+ * Command objects are allocated from CommandPool, so creating one per
+ * request does not go through the global heap.
  */
 class ApiCommand {
 public:
     virtual ~ApiCommand() = default;
     
+    static void* operator new(std::size_t size) {
+        return CommandPool::instance().allocate(size);
+    }
+    
+    static void operator delete(void* ptr) {
+        CommandPool::instance().release(ptr);
+    }
     
     /**
      * @brief Execute the command on the emulator thread
@@ -45,6 +62,40 @@ public:
         // Base implementation does nothing
         // Commands with results should override
     }
+
+    /**
+     * @brief Register the CPU memory this command reads, for coalescing
+     * 
+     * Commands that only read CPU memory can override this instead of
+     * doing their reads in execute(). Read commands pending together at a
+     * frame boundary then share one pass over memory, and completeReads()
+     * is called in place of execute().
+     * 
+     * @param reads Coalescer to add the ranges to
+     * @return true if the command is answered by completeReads(), false
+     *         to run execute() as usual (the default, and for requests
+     *         execute() would reject)
+     */
+    virtual bool addReads(ReadCoalescer& reads) {
+        return false;
+    }
+
+    /**
+     * @brief Answer the command from coalesced reads
+     * 
+     * Called on the emulator thread with the emulator mutex held, after
+     * addReads() returned true and the ranges were read.
+     * 
+     * @param reads Coalescer holding the bytes read
+     */
+    virtual void completeReads(const ReadCoalescer& reads) {
+    }
+
+    /** @brief Route the command is charged to, set by executeCommand() */
+    RouteMetrics* routeMetrics = nullptr;
+
+    /** @brief When it was pushed to the queue */
+    std::chrono::steady_clock::time_point queuedAt;
 };
 
 /**
@@ -1,5 +1,8 @@
 #include "RestApiServer.h"
+#include "RouteMetrics.h"
+#include "Utils/HttpEncoding.h"
 #include "../../../lib/httplib.h"
+#include "../../common/os_utils.h"
 #include <iostream>
 #include <cerrno>
 #include <cstring>
@@ -50,6 +53,20 @@ bool RestApiServer::start(int port)
         m_server->set_read_timeout(m_config.readTimeoutSec, 0);
         m_server->set_write_timeout(m_config.writeTimeoutSec, 0);
 
+        // A worker serves one connection at a time, for as long as it is kept
+        // alive, so every concurrently connected client needs its own thread
+        if ((m_config.workerThreads > 0) || (m_config.maxQueuedRequests > 0)) {
+            size_t threads = (m_config.workerThreads > 0) ?
+                static_cast<size_t>(m_config.workerThreads) : CPPHTTPLIB_THREAD_POOL_COUNT;
+            size_t maxQueued = static_cast<size_t>(m_config.maxQueuedRequests);
+
+            m_server->new_task_queue = [threads, maxQueued]() {
+                return new httplib::ThreadPool(threads, maxQueued);
+            };
+        }
+        m_server->set_keep_alive_max_count(static_cast<size_t>(m_config.keepAliveMaxCount));
+        m_server->set_keep_alive_timeout(m_config.keepAliveTimeoutSec);
+
         // Setup default routes
         setupDefaultRoutes();
 
@@ -112,6 +129,8 @@ void RestApiServer::stop()
         return;
     }
 
+    beforeStop();
+
     m_running = false;
 
     if (m_server) {
@@ -137,10 +156,29 @@ void RestApiServer::registerRoutes()
     // Subclasses can override to add custom routes
 }
 
+void RestApiServer::beforeStop()
+{
+    // Default implementation does nothing
+}
+
+// Charges the time of each request, and of the commands it runs, to its route
+static std::function<void(const httplib::Request&, httplib::Response&)> timedHandler(
+    const char* method, const std::string& pattern,
+    std::function<void(const httplib::Request&, httplib::Response&)> handler)
+{
+    RouteMetrics* metrics = RouteMetricsRegistry::instance().get(method, pattern);
+
+    return [metrics, handler](const httplib::Request& req, httplib::Response& res) {
+        RouteRequestScope scope(metrics);
+        handler(req, res);
+    };
+}
+
 void RestApiServer::addGetRoute(const std::string& pattern, 
     std::function<void(const httplib::Request&, httplib::Response&)> handler)
 {
     if (m_server) {
+        handler = timedHandler("GET", pattern, handler);
         m_server->Get(pattern, handler);
         // Debug output
         printf("REST API: Registered GET route: %s\n", pattern.c_str());
@@ -153,6 +191,8 @@ void RestApiServer::addPostRoute(const std::string& pattern,
     std::function<void(const httplib::Request&, httplib::Response&)> handler)
 {
     if (m_server) {
+        handler = timedHandler("POST", pattern, handler);
+
         // WORKAROUND: Store POST handlers in our map for manual routing
         // This bypasses httplib's POST routing which fails in Qt environment
         m_postHandlers[pattern] = handler;
@@ -171,7 +211,7 @@ void RestApiServer::addPutRoute(const std::string& pattern,
     std::function<void(const httplib::Request&, httplib::Response&)> handler)
 {
     if (m_server) {
-        m_server->Put(pattern, handler);
+        m_server->Put(pattern, timedHandler("PUT", pattern, handler));
     }
 }
 
@@ -179,12 +219,15 @@ void RestApiServer::addDeleteRoute(const std::string& pattern,
     std::function<void(const httplib::Request&, httplib::Response&)> handler)
 {
     if (m_server) {
-        m_server->Delete(pattern, handler);
+        m_server->Delete(pattern, timedHandler("DELETE", pattern, handler));
     }
 }
 
 void RestApiServer::serverThreadFunc()
 {
+    // Request handler threads are started from here and inherit it
+    fceu_set_thread_affinity(m_config.threadCpus.c_str());
+
     if (!m_server) {
         m_running = false;
         try {
@@ -265,6 +308,8 @@ void RestApiServer::setupDefaultRoutes()
     
     // Pre-routing handler for request inspection and POST workaround
     m_server->set_pre_routing_handler([this](const httplib::Request& req, httplib::Response& res) {
+        routeMetricsRequestStart();
+
         // WORKAROUND: Manually handle POST requests due to httplib issue
         if (req.method == "POST") {
             // Check our stored POST handlers
@@ -277,6 +322,33 @@ void RestApiServer::setupDefaultRoutes()
         
         return httplib::Server::HandlerResponse::Unhandled;
     });
+
+    // gzip large bodies for clients that accept it. Streamed responses have
+    // no body here and are sent as they are, ranges are taken of the body
+    // before this and cannot be encoded after.
+    size_t compressMinBytes = m_config.compressMinBytes;
+
+    m_server->set_post_routing_handler([compressMinBytes](const httplib::Request& req, httplib::Response& res) {
+        if ((compressMinBytes == 0) || (res.body.size() < compressMinBytes) || !req.ranges.empty() ||
+            res.has_header("Content-Encoding") ||
+            !compressibleContentType(res.get_header_value("Content-Type"))) {
+            return;
+        }
+        res.set_header("Vary", "Accept-Encoding");
+
+        if (!acceptsGzip(req.get_header_value("Accept-Encoding"))) {
+            return;
+        }
+        std::string gzipped;
+
+        // The fastest level, most of the gain on memory and JSON for little time
+        if (gzipEncode(res.body, gzipped, 1) && (gzipped.size() < res.body.size())) {
+            res.body.swap(gzipped);
+            res.set_header("Content-Encoding", "gzip");
+            res.headers.erase("Content-Length");
+            res.set_header("Content-Length", std::to_string(res.body.size()));
+        }
+    });
     
     // Exception handler
     m_server->set_exception_handler([](const httplib::Request& req, httplib::Response& res, std::exception_ptr ep) {
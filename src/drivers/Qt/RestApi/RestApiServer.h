@@ -33,6 +33,13 @@ struct RestApiConfig {
     int readTimeoutSec = 5;
     int writeTimeoutSec = 5;
     int startupTimeoutSec = 10;
+    std::string threadCpus;  // CPU list for the server thread, empty for any
+    int workerThreads = 0;      // Request worker threads, 0 for the cpp-httplib default
+    int maxQueuedRequests = 0;  // Connections waiting for a worker, 0 for no limit
+    int keepAliveMaxCount = 100;  // Requests served on one connection before it is closed
+    int keepAliveTimeoutSec = 5;  // Idle time before a keep-alive connection is closed
+    size_t stateStoreBytes = 256u * 1024u * 1024u;  // Memory cap of the /api/state store
+    size_t compressMinBytes = 1024;  // Smallest body sent gzip encoded to clients accepting it, 0 for never
 };
 
 class RestApiServer : public QObject
@@ -77,6 +84,10 @@ protected:
     // Virtual method for subclasses to register routes
     virtual void registerRoutes();
 
+    // Called by stop() before the listener shuts down, so subclasses can end
+    // long-lived responses (streams) that would otherwise hold worker threads
+    virtual void beforeStop();
+
     // Helper method for subclasses to add routes
     void addGetRoute(const std::string& pattern, std::function<void(const httplib::Request&, httplib::Response&)> handler);
     void addPostRoute(const std::string& pattern, std::function<void(const httplib::Request&, httplib::Response&)> handler);
@@ -0,0 +1,33 @@
+#include "RomCache.h"
+#include "../../../fceu.h"
+
+std::string RomImage::etag(const std::string& what) const {
+    return "W/\"" + md5 + "-" + std::to_string(modifyCount) + "-" + what + "\"";
+}
+
+RomCache& RomCache::instance() {
+    static RomCache cache;
+    return cache;
+}
+
+std::shared_ptr<const RomImage> RomCache::get() const {
+    std::shared_ptr<const RomImage> current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = image;
+    }
+    if (current && (current->modifyCount != FCEU_GetRomModifyCount())) {
+        return nullptr;
+    }
+    return current;
+}
+
+void RomCache::set(std::shared_ptr<const RomImage> newImage) {
+    std::lock_guard<std::mutex> lock(mutex);
+    image = std::move(newImage);
+}
+
+void RomCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    image.reset();
+}
@@ -0,0 +1,59 @@
+#ifndef __ROM_CACHE_H__
+#define __ROM_CACHE_H__
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief What the REST API serves of a loaded ROM that only changes with it
+ *
+ * Taken once on the emulator thread, read by the HTTP workers without it.
+ */
+struct RomImage {
+    std::string md5;            ///< Of the ROM as loaded, hex
+    uint32_t modifyCount = 0;   ///< FCEU_GetRomModifyCount() when it was taken
+    std::string infoJson;       ///< Body of GET /api/rom/info
+    std::vector<uint8_t> prg;   ///< PRG ROM, chip 0
+    std::vector<uint8_t> chr;   ///< CHR ROM, chip 0; empty for CHR RAM
+
+    /**
+     * @brief Entity tag of a representation of this image
+     *
+     * Weak, as the same tag is sent for the gzip encoded body.
+     *
+     * @param what Which part and format, "info", "prg-0-256-json", ...
+     */
+    std::string etag(const std::string& what) const;
+};
+
+/**
+ * @brief The image of the loaded ROM, once a request asked for it
+ *
+ * Filled by RomImageCommand and dropped when the game is closed. An image
+ * taken before the ROM was last written to, from the hex editor or a
+ * script, is not handed out; the next request takes a new one.
+ */
+class RomCache {
+public:
+    static RomCache& instance();
+
+    /**
+     * @brief The image, nullptr if there is none or it is out of date
+     */
+    std::shared_ptr<const RomImage> get() const;
+
+    /** @brief Store a new image, on the emulator thread */
+    void set(std::shared_ptr<const RomImage> image);
+
+    /** @brief Drop the image, on the emulator thread as the game closes */
+    void clear();
+
+private:
+    mutable std::mutex mutex;
+    std::shared_ptr<const RomImage> image;
+};
+
+#endif // __ROM_CACHE_H__
@@ -2,6 +2,7 @@
 #define __ROM_INFO_COMMANDS_H__
 
 #include "RestApiCommands.h"
+#include "RomCache.h"
 #include "../../../fceu.h"
 #include "../../../git.h"
 #include "../../../cart.h"
@@ -81,13 +82,19 @@ struct RomInfo {
 class RomInfoCommand : public ApiCommandWithResult<RomInfo> {
 public:
     void execute() override {
+        resultPromise.set_value(collect());
+    }
+
+    /**
+     * @brief Information on the loaded ROM, with the emulator mutex held
+     */
+    static RomInfo collect() {
         RomInfo info;
         
         // Check if ROM is loaded
         if (!GameInfo) {
             info.loaded = false;
-            resultPromise.set_value(info);
-            return;
+            return info;
         }
         
         info.loaded = true;
@@ -132,7 +139,7 @@ public:
         // Get MD5 hash
         info.md5 = RomInfo::md5ToHexString(GameInfo->MD5.data);
         
-        resultPromise.set_value(info);
+        return info;
     }
     
     const char* name() const override {
@@ -140,4 +147,40 @@ public:
     }
 };
 
+/**
+ * @brief Command to get the image of the loaded ROM for RomCache
+ *
+ * Takes a new image unless the cache holds an up to date one, and stores
+ * it there. The result is nullptr when no game is loaded.
+ */
+class RomImageCommand : public ApiCommandWithResult<std::shared_ptr<const RomImage>> {
+public:
+    void execute() override {
+        std::shared_ptr<const RomImage> cached = RomCache::instance().get();
+
+        if (cached || !GameInfo) {
+            resultPromise.set_value(cached);
+            return;
+        }
+        std::shared_ptr<RomImage> image = std::make_shared<RomImage>();
+
+        image->md5 = RomInfo::md5ToHexString(GameInfo->MD5.data);
+        image->modifyCount = FCEU_GetRomModifyCount();
+        image->infoJson = RomInfoCommand::collect().toJson();
+
+        if (PRGptr[0] && (PRGsize[0] > 0)) {
+            image->prg.assign(PRGptr[0], PRGptr[0] + PRGsize[0]);
+        }
+        if (CHRptr[0] && (CHRsize[0] > 0) && !CHRram[0]) {
+            image->chr.assign(CHRptr[0], CHRptr[0] + CHRsize[0]);
+        }
+        RomCache::instance().set(image);
+        resultPromise.set_value(image);
+    }
+
+    const char* name() const override {
+        return "RomImageCommand";
+    }
+};
+
 #endif // __ROM_INFO_COMMANDS_H__
\ No newline at end of file
@@ -2,24 +2,86 @@
 #include "RomInfoCommands.h"
 #include "CommandQueue.h"
 #include "CommandExecution.h"
+#include "Utils/BinaryResponse.h"
+#include "Utils/HttpEncoding.h"
 #include "../../../lib/httplib.h"
+#include "../../../romscan.h"
+#include <cstdio>
 #include <memory>
 #include <sstream>
 
 // Timeout for command execution (2 seconds)
 static constexpr unsigned int COMMAND_TIMEOUT_MS = 2000;
 
+// Largest ROM range one request reads
+static constexpr unsigned long MAX_ROM_RANGE = 0x10000;
+
+static std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static void setError(httplib::Response& res, int status, const std::string& error) {
+    res.status = status;
+    res.set_content("{\"success\":false,\"error\":" + jsonString(error) + "}", "application/json");
+}
+
+// The cached image of the loaded ROM, taken on the emulator thread when
+// there is none; nullptr when no game is loaded
+static std::shared_ptr<const RomImage> romImage() {
+    std::shared_ptr<const RomImage> image = RomCache::instance().get();
+
+    if (!image) {
+        auto cmd = std::unique_ptr<ApiCommandWithResult<std::shared_ptr<const RomImage>>>(new RomImageCommand());
+        auto future = executeCommand(std::move(cmd), COMMAND_TIMEOUT_MS);
+
+        image = waitForResult(future, COMMAND_TIMEOUT_MS);
+    }
+    return image;
+}
+
+// Answers with 304 Not Modified when the client has this representation
+static bool notModified(const httplib::Request& req, httplib::Response& res, const std::string& etag) {
+    res.set_header("ETag", etag);
+    res.set_header("Cache-Control", "no-cache");
+
+    if (etagMatches(req.get_header_value("If-None-Match"), etag)) {
+        res.status = 304;
+        return true;
+    }
+    return false;
+}
+
 void RomInfoController::handleRomInfo(const httplib::Request& req, httplib::Response& res) {
     try {
-        // Create and execute ROM info command
-        auto cmd = std::unique_ptr<ApiCommandWithResult<RomInfo>>(new RomInfoCommand());
-        auto future = executeCommand(std::move(cmd), COMMAND_TIMEOUT_MS);
-        
-        // Wait for result
-        RomInfo info = waitForResult(future, COMMAND_TIMEOUT_MS);
+        std::shared_ptr<const RomImage> image = romImage();
+
+        if (!image) {
+            RomInfo info;
+
+            info.loaded = false;
+            res.set_content(info.toJson(), "application/json");
+            res.status = 200;
+            return;
+        }
+        if (notModified(req, res, image->etag("info"))) {
+            return;
+        }
         
         // Return ROM info as JSON
-        res.set_content(info.toJson(), "application/json");
+        res.set_content(image->infoJson, "application/json");
         res.status = 200;
         
     } catch (const std::exception& e) {
@@ -33,4 +95,148 @@ void RomInfoController::handleRomInfo(const httplib::Request& req, httplib::Resp
         res.status = 500;
         res.set_content(json.str(), "application/json");
     }
-}
\ No newline at end of file
+}
+
+void RomInfoController::handleRomData(const httplib::Request& req, httplib::Response& res) {
+    static const char* formatNames[] = { "json", "bin", "cbor" };
+
+    std::string chip = req.matches[1];
+    unsigned long offset;
+    unsigned long length;
+
+    try {
+        offset = std::stoul(req.matches[2].str(), nullptr, 0);
+        length = std::stoul(req.matches[3].str(), nullptr, 10);
+    } catch (const std::exception&) {
+        setError(res, 400, "Invalid offset or length");
+        return;
+    }
+    if ((length < 1) || (length > MAX_ROM_RANGE)) {
+        setError(res, 400, "Length must be between 1 and 65536");
+        return;
+    }
+
+    std::shared_ptr<const RomImage> image;
+
+    try {
+        image = romImage();
+    } catch (const std::exception& e) {
+        setError(res, (std::string(e.what()) == "Command execution timeout") ? 504 : 500, e.what());
+        return;
+    }
+    if (!image) {
+        setError(res, 503, "No game loaded");
+        return;
+    }
+
+    const std::vector<uint8_t>& rom = (chip == "prg") ? image->prg : image->chr;
+
+    if (rom.empty()) {
+        setError(res, 404, (chip == "prg") ? "No PRG ROM" : "No CHR ROM, the game uses CHR RAM");
+        return;
+    }
+    if ((offset >= rom.size()) || (length > rom.size() - offset)) {
+        setError(res, 400, "Range exceeds ROM size");
+        return;
+    }
+
+    ResponseFormat format = negotiateResponseFormat(req.get_header_value("Accept"));
+    char what[64];
+
+    snprintf(what, sizeof(what), "%s-%lx-%lx-%s", chip.c_str(), offset, length,
+             formatNames[static_cast<int>(format)]);
+
+    res.set_header("Vary", "Accept");
+    if (notModified(req, res, image->etag(what))) {
+        return;
+    }
+
+    const uint8_t* data = rom.data() + offset;
+
+    switch (format) {
+        case ResponseFormat::OctetStream:
+            res.set_content(std::string(reinterpret_cast<const char*>(data), length), responseContentType(format));
+            break;
+        case ResponseFormat::Cbor: {
+            CborWriter cbor;
+
+            cbor.beginMap(5);
+            cbor.writeText("chip");
+            cbor.writeText(chip);
+            cbor.writeText("offset");
+            cbor.writeUInt(offset);
+            cbor.writeText("length");
+            cbor.writeUInt(length);
+            cbor.writeText("size");
+            cbor.writeUInt(rom.size());
+            cbor.writeText("data");
+            cbor.writeBytes(data, length);
+            res.set_content(cbor.data(), responseContentType(format));
+            break;
+        }
+        case ResponseFormat::Json:
+        default: {
+            char head[160];
+
+            snprintf(head, sizeof(head), "{\"chip\":\"%s\",\"offset\":\"0x%lx\",\"length\":%lu,\"size\":%lu,\"data\":\"",
+                     chip.c_str(), offset, length, static_cast<unsigned long>(rom.size()));
+            res.set_content(head + base64Encode(data, length) + "\"}", responseContentType(format));
+            break;
+        }
+    }
+    res.status = 200;
+}
+
+void RomInfoController::handleRomIndex(const httplib::Request& req, httplib::Response& res) {
+    static const char* formats[] = { "unknown", "ines", "nes2.0", "unif", "fds", "nsf" };
+    static const char* regions[] = { "ntsc", "pal", "dual", "dendy" };
+    static const char* mirrorings[] = { "horizontal", "vertical", "4screen" };
+
+    if (!req.has_param("path")) {
+        setError(res, 400, "Missing path parameter");
+        return;
+    }
+
+    FCEU_RomScanEntry entry;
+
+    if (!FCEU_RomIndexFind(req.get_param_value("path"), entry)) {
+        setError(res, 404, "ROM not in index");
+        return;
+    }
+
+    char md5[33];
+    for (int i = 0; i < 16; i++) {
+        snprintf(md5 + i * 2, 3, "%02x", entry.md5[i]);
+    }
+    char crc[9];
+    snprintf(crc, sizeof(crc), "%08x", entry.crc32);
+
+    std::ostringstream json;
+    json << "{";
+    json << "\"path\":" << jsonString(entry.path) << ",";
+    json << "\"inner\":" << jsonString(entry.inner) << ",";
+    json << "\"format\":\"" << formats[entry.format] << "\",";
+    json << "\"mapper\":" << entry.mapper << ",";
+    json << "\"submapper\":" << entry.submapper << ",";
+    json << "\"board\":" << jsonString(entry.board) << ",";
+    json << "\"name\":" << jsonString(entry.name) << ",";
+    json << "\"prg_size\":" << entry.prgSize << ",";
+    json << "\"chr_size\":" << entry.chrSize << ",";
+    json << "\"prg_ram\":" << entry.prgRam << ",";
+    json << "\"prg_nvram\":" << entry.prgNvram << ",";
+    json << "\"chr_ram\":" << entry.chrRam << ",";
+    json << "\"chr_nvram\":" << entry.chrNvram << ",";
+    json << "\"mirroring\":\"" << (entry.mirroring >= 0 && entry.mirroring <= 2 ? mirrorings[entry.mirroring] : "mapper") << "\",";
+    json << "\"has_battery\":" << (entry.battery ? "true" : "false") << ",";
+    json << "\"has_trainer\":" << (entry.trainer ? "true" : "false") << ",";
+    json << "\"vs_system\":" << (entry.vsSystem ? "true" : "false") << ",";
+    json << "\"region\":\"" << regions[entry.region] << "\",";
+    json << "\"sides\":" << entry.sides << ",";
+    json << "\"crc32\":\"" << crc << "\",";
+    json << "\"md5\":\"" << md5 << "\",";
+    json << "\"summary\":" << jsonString(FCEU_RomScanDescribe(entry));
+    json << "}";
+
+    res.status = 200;
+    res.set_content(json.str(), "application/json");
+}
@@ -17,6 +17,28 @@ public:
      * @param res HTTP response
      */
     static void handleRomInfo(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle GET /api/rom/(prg|chr)/{offset}/{length} endpoint
+     *
+     * Reads the ROM image by offset into the PRG or CHR chip, not through
+     * the CPU or PPU address space, so the answer only changes with the
+     * ROM and carries an ETag. Answered from RomCache without the command
+     * queue once it holds the image.
+     * @param req HTTP request
+     * @param res HTTP response
+     */
+    static void handleRomData(const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * @brief Handle GET /api/rom/index endpoint
+     *
+     * Looks a ROM file up in the ROM library index written by --scan,
+     * without loading it. Does not go through the command queue.
+     * @param req HTTP request, with the file in the "path" parameter
+     * @param res HTTP response
+     */
+    static void handleRomIndex(const httplib::Request& req, httplib::Response& res);
 };
 
 #endif // __ROM_INFO_CONTROLLER_H__
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "RouteMetrics.h"
+
+typedef std::chrono::steady_clock routeClock;
+
+// Of the request the worker thread is serving
+static thread_local RouteMetrics* tlsRoute = nullptr;
+static thread_local routeClock::time_point tlsStart;
+static thread_local routeClock::time_point tlsResultReady;
+static thread_local bool tlsHaveResult = false;
+
+static double secondsSince(routeClock::time_point start, routeClock::time_point end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+RouteMetricsRegistry& RouteMetricsRegistry::instance() {
+    static RouteMetricsRegistry registry;
+    return registry;
+}
+
+RouteMetrics* RouteMetricsRegistry::get(const std::string& method, const std::string& pattern) {
+    std::string route = method + " " + pattern;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (const auto& r : routes) {
+        if (r->route == route) {
+            return r.get();
+        }
+    }
+    routes.emplace_back(new RouteMetrics());
+    routes.back()->route = route;
+    return routes.back().get();
+}
+
+std::vector<RouteMetrics*> RouteMetricsRegistry::active() {
+    std::vector<RouteMetrics*> out;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (const auto& r : routes) {
+        if (r->requests.load(std::memory_order_relaxed) > 0) {
+            out.push_back(r.get());
+        }
+    }
+    return out;
+}
+
+RouteRequestScope::RouteRequestScope(RouteMetrics* metrics) {
+    tlsRoute = metrics;
+    tlsHaveResult = false;
+}
+
+RouteRequestScope::~RouteRequestScope() {
+    if (tlsRoute) {
+        routeClock::time_point end = routeClock::now();
+
+        tlsRoute->total.record(secondsSince(tlsStart, end));
+        if (tlsHaveResult) {
+            tlsRoute->serialization.record(secondsSince(tlsResultReady, end));
+        }
+        tlsRoute->requests.fetch_add(1, std::memory_order_relaxed);
+    }
+    tlsRoute = nullptr;
+    tlsHaveResult = false;
+}
+
+void routeMetricsRequestStart() {
+    tlsStart = routeClock::now();
+}
+
+RouteMetrics* routeMetricsCurrent() {
+    return tlsRoute;
+}
+
+void routeMetricsResultReady() {
+    if (tlsRoute) {
+        tlsResultReady = routeClock::now();
+        tlsHaveResult = true;
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef __ROUTE_METRICS_H__
+#define __ROUTE_METRICS_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../TimingHistogram.h"
+
+/**
+ * @brief Where the time of the requests to one route goes
+ *
+ * Commands are charged to the route whose handler pushed them. A request
+ * that pushes several commands adds each one's queue wait and execution.
+ */
+struct RouteMetrics {
+    std::string route;                 ///< "GET /api/..." as registered
+
+    timingHistogram_t queueWait;       ///< Pushed to popped by the emulator thread
+    timingHistogram_t execution;       ///< Run on the emulator thread
+    timingHistogram_t serialization;   ///< Last result ready to the handler returning
+    timingHistogram_t total;           ///< Pre-routing to the handler returning
+
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> timeouts{0};   ///< waitForResult() gave up
+    std::atomic<uint64_t> queueFull{0};  ///< executeCommand() found the queue full
+};
+
+/**
+ * @brief The metrics of every route, for /api/system/metrics
+ *
+ * Entries are made as routes are registered and live until exit, so the
+ * commands and handlers can keep a plain pointer to theirs. Recording is
+ * lock free, only registration and listing take the mutex.
+ */
+class RouteMetricsRegistry {
+public:
+    static RouteMetricsRegistry& instance();
+
+    /**
+     * @brief The entry of a route, made on first use
+     *
+     * Registering the same route again, on a server restart, returns the
+     * entry it had.
+     */
+    RouteMetrics* get(const std::string& method, const std::string& pattern);
+
+    /**
+     * @brief The routes that have served a request, in registration order
+     */
+    std::vector<RouteMetrics*> active();
+
+private:
+    std::mutex mutex;
+    std::deque<std::unique_ptr<RouteMetrics>> routes;
+};
+
+/**
+ * @brief Times one request on the HTTP worker thread serving it
+ *
+ * Made by the wrapper RestApiServer puts around each route handler. While
+ * it exists, commands the thread pushes and waits for are charged to the
+ * route. The total runs from the pre-routing handler's routeMetricsRequestStart(),
+ * so it includes the routing, to the end of the handler.
+ */
+class RouteRequestScope {
+public:
+    explicit RouteRequestScope(RouteMetrics* metrics);
+    ~RouteRequestScope();
+
+    RouteRequestScope(const RouteRequestScope&) = delete;
+    RouteRequestScope& operator=(const RouteRequestScope&) = delete;
+};
+
+/**
+ * @brief A request arrived, from the pre-routing handler
+ */
+void routeMetricsRequestStart();
+
+/**
+ * @brief The route the calling thread is serving, nullptr outside a handler
+ */
+RouteMetrics* routeMetricsCurrent();
+
+/**
+ * @brief A command result the handler waited for is ready
+ *
+ * What the handler does from then on, encoding the result into the
+ * response, counts as serialization.
+ */
+void routeMetricsResultReady();
+
+#endif // __ROUTE_METRICS_H__
@@ -0,0 +1,181 @@
+#include "BinaryResponse.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+static std::string trimLower(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = s.find_last_not_of(" \t");
+
+    std::string out = s.substr(begin, end - begin + 1);
+    std::transform(out.begin(), out.end(), out.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return out;
+}
+
+ResponseFormat negotiateResponseFormat(const std::string& acceptHeader) {
+    ResponseFormat best = ResponseFormat::Json;
+    double bestQ = 0.0;
+    size_t pos = 0;
+
+    while (pos <= acceptHeader.size()) {
+        size_t comma = acceptHeader.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = acceptHeader.size();
+        }
+        std::string range = acceptHeader.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        // Split off parameters, only q is of interest
+        double q = 1.0;
+        size_t semi = range.find(';');
+        std::string type = trimLower(range.substr(0, semi));
+
+        while (semi != std::string::npos) {
+            size_t next = range.find(';', semi + 1);
+            std::string param = trimLower(range.substr(semi + 1, next - semi - 1));
+            if ((param.size() > 2) && (param.compare(0, 2, "q=") == 0)) {
+                q = std::strtod(param.c_str() + 2, nullptr);
+            }
+            semi = next;
+        }
+
+        ResponseFormat format;
+        if (type == "application/octet-stream") {
+            format = ResponseFormat::OctetStream;
+        } else if (type == "application/cbor") {
+            format = ResponseFormat::Cbor;
+        } else if ((type == "application/json") || (type == "application/*") || (type == "*/*")) {
+            format = ResponseFormat::Json;
+        } else {
+            continue;
+        }
+
+        if (q > bestQ) {
+            best = format;
+            bestQ = q;
+        }
+    }
+    return best;
+}
+
+const char* responseContentType(ResponseFormat format) {
+    switch (format) {
+        case ResponseFormat::OctetStream:
+            return "application/octet-stream";
+        case ResponseFormat::Cbor:
+            return "application/cbor";
+        case ResponseFormat::Json:
+        default:
+            return "application/json";
+    }
+}
+
+std::string base64Encode(const uint8_t* data, size_t length) {
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string out;
+    out.reserve(((length + 2) / 3) * 4);
+
+    size_t i = 0;
+    for (; i + 2 < length; i += 3) {
+        uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        out.push_back(alphabet[(v >> 18) & 0x3F]);
+        out.push_back(alphabet[(v >> 12) & 0x3F]);
+        out.push_back(alphabet[(v >> 6) & 0x3F]);
+        out.push_back(alphabet[v & 0x3F]);
+    }
+
+    if (i < length) {
+        uint32_t v = data[i] << 16;
+        if (i + 1 < length) {
+            v |= data[i + 1] << 8;
+        }
+        out.push_back(alphabet[(v >> 18) & 0x3F]);
+        out.push_back(alphabet[(v >> 12) & 0x3F]);
+        out.push_back((i + 1 < length) ? alphabet[(v >> 6) & 0x3F] : '=');
+        out.push_back('=');
+    }
+    return out;
+}
+
+// CborWriter implementation
+
+void CborWriter::writeHead(uint8_t majorType, uint64_t value) {
+    uint8_t major = static_cast<uint8_t>(majorType << 5);
+
+    if (value < 24) {
+        buffer.push_back(static_cast<char>(major | value));
+        return;
+    }
+
+    int bytes;
+    if (value <= 0xFF) {
+        buffer.push_back(static_cast<char>(major | 24));
+        bytes = 1;
+    } else if (value <= 0xFFFF) {
+        buffer.push_back(static_cast<char>(major | 25));
+        bytes = 2;
+    } else if (value <= 0xFFFFFFFFull) {
+        buffer.push_back(static_cast<char>(major | 26));
+        bytes = 4;
+    } else {
+        buffer.push_back(static_cast<char>(major | 27));
+        bytes = 8;
+    }
+
+    // Argument follows in network byte order
+    for (int i = bytes - 1; i >= 0; i--) {
+        buffer.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+void CborWriter::beginMap(size_t pairs) {
+    writeHead(5, pairs);
+}
+
+void CborWriter::beginArray(size_t items) {
+    writeHead(4, items);
+}
+
+void CborWriter::writeUInt(uint64_t value) {
+    writeHead(0, value);
+}
+
+void CborWriter::writeText(const std::string& text) {
+    writeHead(3, text.size());
+    buffer.append(text);
+}
+
+void CborWriter::writeBytes(const uint8_t* data, size_t length) {
+    writeHead(2, length);
+    buffer.append(reinterpret_cast<const char*>(data), length);
+}
+
+// Offset table encoding
+
+static void appendLE(std::string& out, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+std::string encodeRangeTable(const std::vector<RangeTableEntry>& entries,
+                             const std::vector<uint8_t>& data) {
+    std::string out;
+    out.reserve(4 + entries.size() * RANGE_TABLE_ENTRY_SIZE + data.size());
+
+    appendLE(out, static_cast<uint32_t>(entries.size()), 4);
+    for (const auto& entry : entries) {
+        appendLE(out, entry.offset, 4);
+        appendLE(out, entry.start, 2);
+        appendLE(out, entry.length, 2);
+    }
+    out.append(reinterpret_cast<const char*>(data.data()), data.size());
+
+    return out;
+}
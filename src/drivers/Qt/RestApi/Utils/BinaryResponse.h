@@ -0,0 +1,101 @@
+#ifndef __BINARY_RESPONSE_H__
+#define __BINARY_RESPONSE_H__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Response encodings supported by the memory endpoints
+ */
+enum class ResponseFormat {
+    Json,         ///< application/json (default)
+    OctetStream,  ///< application/octet-stream, raw bytes
+    Cbor          ///< application/cbor
+};
+
+/**
+ * @brief Pick the response format from an HTTP Accept header
+ *
+ * Media ranges are compared by their q value, earlier ranges win ties.
+ * Anything that is not octet-stream or CBOR, including an empty header,
+ * wildcards and q=0 entries, selects JSON so existing clients are
+ * unaffected.
+ *
+ * @param acceptHeader Value of the Accept header, may be empty
+ * @return Negotiated format
+ */
+ResponseFormat negotiateResponseFormat(const std::string& acceptHeader);
+
+/**
+ * @brief Content-Type for a response format
+ */
+const char* responseContentType(ResponseFormat format);
+
+/**
+ * @brief Standard base64 (RFC 4648) encoding with padding
+ *
+ * For code that cannot depend on QByteArray, such as the stream encoder
+ * that also runs in standalone tests.
+ */
+std::string base64Encode(const uint8_t* data, size_t length);
+
+/**
+ * @brief Minimal CBOR (RFC 8949) encoder
+ *
+ * Covers what the memory endpoints need: unsigned integers, text and byte
+ * strings, and definite length arrays and maps. The caller is responsible
+ * for writing the announced number of items after beginArray()/beginMap().
+ */
+class CborWriter {
+public:
+    void beginMap(size_t pairs);
+    void beginArray(size_t items);
+    void writeUInt(uint64_t value);
+    void writeText(const std::string& text);
+    void writeBytes(const uint8_t* data, size_t length);
+
+    /**
+     * @brief Encoded bytes written so far
+     */
+    const std::string& data() const { return buffer; }
+
+private:
+    std::string buffer;
+
+    void writeHead(uint8_t majorType, uint64_t value);
+};
+
+/**
+ * @brief Entry of the offset table in a multi-range binary response
+ */
+struct RangeTableEntry {
+    uint16_t start;    ///< Starting address of the range
+    uint16_t length;   ///< Number of bytes
+    uint32_t offset;   ///< Offset of the range in the data section
+};
+
+/**
+ * @brief Size in bytes of one encoded offset table entry
+ */
+const size_t RANGE_TABLE_ENTRY_SIZE = 8;
+
+/**
+ * @brief Build an application/octet-stream multi-range body
+ *
+ * Layout, all integers little endian:
+ * - uint32 entry count
+ * - per entry: uint32 offset, uint16 start, uint16 length
+ * - data section, the ranges back to back
+ *
+ * Offsets are relative to the start of the data section.
+ *
+ * @param entries Offset table, in request order
+ * @param data Concatenated range bytes
+ * @return Encoded body
+ */
+std::string encodeRangeTable(const std::vector<RangeTableEntry>& entries,
+                             const std::vector<uint8_t>& data);
+
+#endif // __BINARY_RESPONSE_H__
@@ -0,0 +1,206 @@
+#include "BinaryRpc.h"
+
+// Bounds checked little endian reader over the request body
+class RpcReader {
+public:
+    explicit RpcReader(const std::string& body)
+        : data(reinterpret_cast<const uint8_t*>(body.data())), size(body.size()), pos(0) {}
+
+    bool u8(uint8_t& value) {
+        if (size - pos < 1) {
+            return false;
+        }
+        value = data[pos++];
+        return true;
+    }
+
+    bool u16(uint16_t& value) {
+        uint64_t v;
+        if (!little(2, v)) {
+            return false;
+        }
+        value = static_cast<uint16_t>(v);
+        return true;
+    }
+
+    bool u32(uint32_t& value) {
+        uint64_t v;
+        if (!little(4, v)) {
+            return false;
+        }
+        value = static_cast<uint32_t>(v);
+        return true;
+    }
+
+    bool u64(uint64_t& value) {
+        return little(8, value);
+    }
+
+    bool bytes(size_t count, std::vector<uint8_t>& out) {
+        if (size - pos < count) {
+            return false;
+        }
+        out.assign(data + pos, data + pos + count);
+        pos += count;
+        return true;
+    }
+
+    bool atEnd() const { return pos == size; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+
+    bool little(size_t count, uint64_t& value) {
+        if (size - pos < count) {
+            return false;
+        }
+        value = 0;
+        for (size_t i = 0; i < count; i++) {
+            value |= static_cast<uint64_t>(data[pos + i]) << (8 * i);
+        }
+        pos += count;
+        return true;
+    }
+};
+
+static void appendLittle(std::string& out, uint64_t value, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+void rpcAppendU32(std::string& out, uint32_t value) {
+    appendLittle(out, value, 4);
+}
+
+void rpcAppendU64(std::string& out, uint64_t value) {
+    appendLittle(out, value, 8);
+}
+
+bool decodeRpcRequest(const std::string& body, std::vector<RpcRequestOp>& ops, std::string& error) {
+    RpcReader reader(body);
+    uint32_t magic;
+    uint8_t version, reserved;
+    uint16_t count;
+
+    ops.clear();
+
+    if (!reader.u32(magic) || !reader.u8(version) || !reader.u8(reserved) || !reader.u16(count)) {
+        error = "Truncated request header";
+        return false;
+    }
+    if (magic != RPC_REQUEST_MAGIC) {
+        error = "Bad request magic";
+        return false;
+    }
+    if (version != RPC_VERSION) {
+        error = "Unsupported request version " + std::to_string(version);
+        return false;
+    }
+    if (count == 0) {
+        error = "No operations provided";
+        return false;
+    }
+    if (count > MAX_RPC_OPS) {
+        error = "Too many operations (maximum " + std::to_string(MAX_RPC_OPS) + ")";
+        return false;
+    }
+    ops.reserve(count);
+
+    for (uint16_t i = 0; i < count; i++) {
+        uint8_t opcode;
+        RpcRequestOp op;
+        bool ok;
+
+        if (!reader.u8(opcode)) {
+            error = "Truncated operation " + std::to_string(i);
+            return false;
+        }
+        op.op = static_cast<RpcOp>(opcode);
+
+        switch (op.op) {
+            case RpcOp::Read:
+                ok = reader.u16(op.address) && reader.u16(op.length);
+                break;
+            case RpcOp::Write:
+                ok = reader.u16(op.address) && reader.u16(op.length) &&
+                     reader.bytes(op.length, op.data);
+                break;
+            case RpcOp::Input:
+                ok = reader.u8(op.port) && reader.u8(op.buttons) && reader.u16(op.frames);
+                if (ok && ((op.port < 1) || (op.port > 4))) {
+                    error = "Invalid port number in operation " + std::to_string(i);
+                    return false;
+                }
+                op.port--;
+                break;
+            case RpcOp::Step:
+                ok = reader.u16(op.frames);
+                break;
+            case RpcOp::Snapshot:
+            case RpcOp::Frame:
+            case RpcOp::Observation:
+                ok = true;
+                break;
+            case RpcOp::Restore:
+                ok = reader.u64(op.handle);
+                break;
+            case RpcOp::StepBatch: {
+                uint8_t instances = 0, frameskip = 0;
+                ok = reader.u8(instances) && reader.u8(frameskip) && reader.u8(op.flags);
+                for (uint8_t n = 0; ok && (n < instances); n++) {
+                    uint32_t id;
+                    uint8_t buttons;
+                    ok = reader.u32(id) && reader.u8(buttons);
+                    op.ids.push_back(id);
+                    op.data.push_back(buttons);
+                }
+                if (ok && ((instances == 0) ||
+                           (op.flags & ~(RPC_BATCH_RAM | RPC_BATCH_SCALE_MASK)))) {
+                    error = "Invalid batch step in operation " + std::to_string(i);
+                    return false;
+                }
+                op.frames = frameskip;
+                break;
+            }
+            default:
+                error = "Unknown opcode " + std::to_string(opcode) + " in operation " + std::to_string(i);
+                return false;
+        }
+        if (!ok) {
+            error = "Truncated operation " + std::to_string(i);
+            return false;
+        }
+        ops.push_back(std::move(op));
+    }
+
+    if (!reader.atEnd()) {
+        error = "Trailing bytes after the last operation";
+        return false;
+    }
+    return true;
+}
+
+std::string encodeRpcResponse(const std::vector<RpcResult>& results) {
+    size_t total = RPC_HEADER_SIZE;
+    for (const auto& result : results) {
+        total += 6 + result.payload.size();
+    }
+
+    std::string out;
+    out.reserve(total);
+    rpcAppendU32(out, RPC_RESPONSE_MAGIC);
+    out.push_back(static_cast<char>(RPC_VERSION));
+    out.push_back(0);
+    appendLittle(out, results.size(), 2);
+
+    for (const auto& result : results) {
+        out.push_back(static_cast<char>(result.op));
+        out.push_back(static_cast<char>(result.status));
+        rpcAppendU32(out, static_cast<uint32_t>(result.payload.size()));
+        out.append(result.payload);
+    }
+    return out;
+}
@@ -0,0 +1,116 @@
+#ifndef __BINARY_RPC_H__
+#define __BINARY_RPC_H__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Operations of the binary RPC endpoint
+ *
+ * Values are the opcode bytes on the wire.
+ */
+enum class RpcOp : uint8_t {
+    Read = 0x01,        ///< u16 address, u16 length
+    Write = 0x02,       ///< u16 address, u16 length, length bytes
+    Input = 0x03,       ///< u8 port (1-4), u8 buttons, u16 frames
+    Step = 0x04,        ///< u16 frames
+    Snapshot = 0x05,    ///< no fields
+    Restore = 0x06,     ///< u64 handle
+    Frame = 0x07,       ///< no fields
+    StepBatch = 0x08,   ///< u8 count, u8 frameskip, u8 flags, count * (u32 instance id, u8 buttons)
+    Observation = 0x09  ///< no fields
+};
+
+/// StepBatch flag, the observation starts with the 2 KB of work RAM
+const uint8_t RPC_BATCH_RAM = 0x01;
+
+/// StepBatch flags bits 1-2, frame sampled every 1, 2 or 4 pixels, 0 for none
+const uint8_t RPC_BATCH_SCALE_SHIFT = 1;
+const uint8_t RPC_BATCH_SCALE_MASK = 0x06;
+
+/**
+ * @brief Result status of one operation
+ */
+enum class RpcStatus : uint8_t {
+    Ok = 0,
+    BadRequest = 1,     ///< Invalid fields, payload is the error text
+    NoGame = 2,         ///< No game loaded
+    Failed = 3,         ///< Operation failed, payload is the error text
+    Timeout = 4         ///< Not done in time, later operations did not run
+};
+
+/**
+ * @brief A decoded request operation
+ *
+ * Only the fields of the operation are set.
+ */
+struct RpcRequestOp {
+    RpcOp op;
+    uint16_t address = 0;
+    uint16_t length = 0;
+    uint8_t port = 0;           ///< 0-based
+    uint8_t buttons = 0;
+    uint16_t frames = 0;
+    uint64_t handle = 0;
+    std::vector<uint8_t> data;      ///< Write bytes, StepBatch buttons
+    std::vector<uint32_t> ids;      ///< StepBatch instances
+    uint8_t flags = 0;              ///< StepBatch flags
+};
+
+/**
+ * @brief Result of one operation
+ */
+struct RpcResult {
+    RpcOp op;
+    RpcStatus status = RpcStatus::Ok;
+    std::string payload;
+};
+
+/// Request magic, "FXRQ"
+const uint32_t RPC_REQUEST_MAGIC = 0x51525846;
+
+/// Response magic, "FXRS"
+const uint32_t RPC_RESPONSE_MAGIC = 0x53525846;
+
+const uint8_t RPC_VERSION = 1;
+
+/// Operations per request
+const size_t MAX_RPC_OPS = 256;
+
+/// Size of the request and response headers
+const size_t RPC_HEADER_SIZE = 8;
+
+/**
+ * @brief Decode an application/octet-stream RPC request
+ *
+ * Layout, all integers little endian:
+ * - u32 magic "FXRQ", u8 version, u8 reserved, u16 operation count
+ * - per operation: u8 opcode, then its fields (see RpcOp)
+ *
+ * @param body Request body
+ * @param ops Decoded operations, in request order
+ * @param error Reason when decoding fails
+ * @return false if the request is malformed
+ */
+bool decodeRpcRequest(const std::string& body, std::vector<RpcRequestOp>& ops, std::string& error);
+
+/**
+ * @brief Encode the results of a request
+ *
+ * Layout, all integers little endian:
+ * - u32 magic "FXRS", u8 version, u8 reserved, u16 result count
+ * - per result: u8 opcode, u8 status, u32 payload length, payload
+ *
+ * Payloads sit unchanged in the body, a client can use them in place.
+ */
+std::string encodeRpcResponse(const std::vector<RpcResult>& results);
+
+/**
+ * @brief Little endian helpers for result payloads
+ */
+void rpcAppendU32(std::string& out, uint32_t value);
+void rpcAppendU64(std::string& out, uint64_t value);
+
+#endif // __BINARY_RPC_H__
@@ -0,0 +1,134 @@
+#ifndef __BOUNDED_RING_H__
+#define __BOUNDED_RING_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief Bounded lock-free multi-producer/multi-consumer ring
+ *
+ * Fixed capacity ring of cells, each carrying a sequence number that tells
+ * producers and consumers whether the cell is free or holds a value
+ * (D. Vyukov's bounded MPMC queue). No allocation after construction and
+ * no locks; a push or pop is one CAS on the shared position plus a store
+ * on the cell.
+ *
+ * Capacity is rounded up to a power of two. tryPush() can fail
+ * transiently while a consumer is still draining the cell a producer
+ * wants, callers that bound the element count themselves can simply retry.
+ *
+ * @tparam T Trivially copyable element type (pointers, indices)
+ */
+template<typename T>
+class BoundedRing {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+
+    // Producers and consumers update different positions, keep them on
+    // separate cache lines. Padding rather than alignas so the ring can
+    // live in heap objects without C++17 aligned new.
+    char pad0[CACHE_LINE];
+    std::atomic<size_t> enqueuePos;
+    char pad1[CACHE_LINE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeuePos;
+    char pad2[CACHE_LINE - sizeof(std::atomic<size_t>)];
+
+    static size_t roundUpPow2(size_t n) {
+        size_t p = 2;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+public:
+    /**
+     * @brief Construct a ring holding at least minCapacity elements
+     * @param minCapacity Requested capacity, rounded up to a power of two
+     */
+    explicit BoundedRing(size_t minCapacity)
+        : cells(new Cell[roundUpPow2(minCapacity)]),
+          mask(roundUpPow2(minCapacity) - 1),
+          enqueuePos(0),
+          dequeuePos(0) {
+        for (size_t i = 0; i <= mask; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedRing(const BoundedRing&) = delete;
+    BoundedRing& operator=(const BoundedRing&) = delete;
+
+    /**
+     * @brief Append a value
+     * @return false if the ring is (momentarily) full
+     */
+    bool tryPush(const T& value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // Full
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove the oldest value
+     * @return false if the ring is empty
+     */
+    bool tryPop(T& value) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // Empty
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        value = cell->value;
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Number of cells in the ring
+     */
+    size_t capacity() const { return mask + 1; }
+};
+
+#endif // __BOUNDED_RING_H__
@@ -0,0 +1,78 @@
+#include "FrameDiff.h"
+#include <cstring>
+
+static const size_t MAX_RUN_LENGTH = 0xFFFF;
+
+static void appendRun(std::string& out, const uint8_t* cur, size_t offset, size_t length) {
+    while (length > 0) {
+        size_t chunk = (length > MAX_RUN_LENGTH) ? MAX_RUN_LENGTH : length;
+
+        for (int i = 0; i < 4; i++) {
+            out.push_back(static_cast<char>((offset >> (i * 8)) & 0xFF));
+        }
+        out.push_back(static_cast<char>(chunk & 0xFF));
+        out.push_back(static_cast<char>((chunk >> 8) & 0xFF));
+        out.append(reinterpret_cast<const char*>(cur + offset), chunk);
+
+        offset += chunk;
+        length -= chunk;
+    }
+}
+
+std::string encodeFrameDiff(const uint8_t* prev, const uint8_t* cur, size_t size) {
+    std::string out;
+    size_t i = 0;
+
+    while (i < size) {
+        // Skip unchanged bytes
+        while ((i < size) && (prev[i] == cur[i])) {
+            i++;
+        }
+        if (i >= size) {
+            break;
+        }
+
+        // Extend the run until a gap long enough to be worth a new header
+        size_t start = i;
+        size_t end = i + 1;
+        size_t gap = 0;
+
+        for (size_t j = end; j < size; j++) {
+            if (prev[j] != cur[j]) {
+                end = j + 1;
+                gap = 0;
+            } else if (++gap >= FRAME_DIFF_RUN_HEADER) {
+                break;
+            }
+        }
+
+        appendRun(out, cur, start, end - start);
+        i = end;
+    }
+    return out;
+}
+
+bool applyFrameDiff(uint8_t* buffer, size_t size, const std::string& diff) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(diff.data());
+    size_t remaining = diff.size();
+
+    while (remaining > 0) {
+        if (remaining < FRAME_DIFF_RUN_HEADER) {
+            return false;
+        }
+
+        size_t offset = static_cast<size_t>(p[0]) | (static_cast<size_t>(p[1]) << 8) |
+                        (static_cast<size_t>(p[2]) << 16) | (static_cast<size_t>(p[3]) << 24);
+        size_t length = static_cast<size_t>(p[4]) | (static_cast<size_t>(p[5]) << 8);
+        p += FRAME_DIFF_RUN_HEADER;
+        remaining -= FRAME_DIFF_RUN_HEADER;
+
+        if ((length > remaining) || (offset > size) || (length > size - offset)) {
+            return false;
+        }
+        std::memcpy(buffer + offset, p, length);
+        p += length;
+        remaining -= length;
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef __FRAME_DIFF_H__
+#define __FRAME_DIFF_H__
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Size in bytes of a run header in a frame diff
+ */
+const size_t FRAME_DIFF_RUN_HEADER = 6;
+
+/**
+ * @brief Encode the difference between two equally sized buffers
+ *
+ * The diff is a sequence of runs, each a little endian uint32 offset and
+ * uint16 length followed by that many bytes of the new buffer. Changed
+ * spans separated by fewer unchanged bytes than a run header are merged,
+ * and runs are split at 65535 bytes. Identical buffers give an empty diff.
+ *
+ * @param prev Previous buffer
+ * @param cur Current buffer
+ * @param size Size of both buffers
+ * @return Encoded diff
+ */
+std::string encodeFrameDiff(const uint8_t* prev, const uint8_t* cur, size_t size);
+
+/**
+ * @brief Apply a diff produced by encodeFrameDiff()
+ *
+ * @param buffer Buffer holding the previous contents, updated in place
+ * @param size Size of buffer
+ * @param diff Encoded diff
+ * @return false if the diff is malformed or writes outside the buffer
+ */
+bool applyFrameDiff(uint8_t* buffer, size_t size, const std::string& diff);
+
+#endif // __FRAME_DIFF_H__
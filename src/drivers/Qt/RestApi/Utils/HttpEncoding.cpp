@@ -0,0 +1,120 @@
+#include "HttpEncoding.h"
+#include <zlib.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+static std::string trimLower(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = s.find_last_not_of(" \t");
+
+    std::string out = s.substr(begin, end - begin + 1);
+    std::transform(out.begin(), out.end(), out.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return out;
+}
+
+static std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    return s.substr(begin, s.find_last_not_of(" \t") - begin + 1);
+}
+
+bool acceptsGzip(const std::string& acceptEncoding) {
+    double gzipQ = -1.0;
+    double wildcardQ = -1.0;
+    size_t pos = 0;
+
+    while (pos <= acceptEncoding.size()) {
+        size_t comma = acceptEncoding.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = acceptEncoding.size();
+        }
+        std::string coding = acceptEncoding.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        double q = 1.0;
+        size_t semi = coding.find(';');
+        std::string name = trimLower(coding.substr(0, semi));
+
+        while (semi != std::string::npos) {
+            size_t next = coding.find(';', semi + 1);
+            std::string param = trimLower(coding.substr(semi + 1, next - semi - 1));
+            if ((param.size() > 2) && (param.compare(0, 2, "q=") == 0)) {
+                q = std::strtod(param.c_str() + 2, nullptr);
+            }
+            semi = next;
+        }
+
+        if ((name == "gzip") || (name == "x-gzip")) {
+            gzipQ = q;
+        } else if (name == "*") {
+            wildcardQ = q;
+        }
+    }
+    // An explicit gzip entry overrides the wildcard
+    return (gzipQ >= 0.0) ? (gzipQ > 0.0) : (wildcardQ > 0.0);
+}
+
+bool gzipEncode(const std::string& in, std::string& out, int level) {
+    z_stream zs = {};
+
+    // 16 added to the window bits selects the gzip wrapper
+    if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&zs, static_cast<uLong>(in.size())));
+
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+
+    return ret == Z_STREAM_END;
+}
+
+bool compressibleContentType(const std::string& contentType) {
+    std::string type = trimLower(contentType.substr(0, contentType.find(';')));
+
+    if (type == "text/event-stream") {
+        return false;
+    }
+    return (type.compare(0, 5, "text/") == 0) ||
+           (type == "application/json") ||
+           (type == "application/cbor") ||
+           (type == "application/octet-stream");
+}
+
+bool etagMatches(const std::string& ifNoneMatch, const std::string& etag) {
+    std::string want = (etag.compare(0, 2, "W/") == 0) ? etag.substr(2) : etag;
+    size_t pos = 0;
+
+    while (pos <= ifNoneMatch.size()) {
+        size_t comma = ifNoneMatch.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = ifNoneMatch.size();
+        }
+        std::string tag = trim(ifNoneMatch.substr(pos, comma - pos));
+        pos = comma + 1;
+
+        if (tag == "*") {
+            return true;
+        }
+        if (tag.compare(0, 2, "W/") == 0) {
+            tag = tag.substr(2);
+        }
+        if (!tag.empty() && (tag == want)) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,45 @@
+#ifndef __HTTP_ENCODING_H__
+#define __HTTP_ENCODING_H__
+
+#include <string>
+
+/**
+ * @brief Whether an Accept-Encoding header allows a gzip response
+ *
+ * gzip, x-gzip or a * wildcard with a q value above 0 allow it, unless
+ * gzip itself is given q=0. An empty header allows identity only.
+ *
+ * @param acceptEncoding Value of the Accept-Encoding header, may be empty
+ */
+bool acceptsGzip(const std::string& acceptEncoding);
+
+/**
+ * @brief Compress a body into the gzip format (RFC 1952)
+ *
+ * @param in Body to compress
+ * @param out Set to the compressed body
+ * @param level zlib compression level, 1 (fastest) to 9
+ * @return false if zlib failed, out is left unspecified then
+ */
+bool gzipEncode(const std::string& in, std::string& out, int level = 6);
+
+/**
+ * @brief Whether compressing a response of this Content-Type pays off
+ *
+ * JSON, CBOR, raw memory and text do; images, which are compressed
+ * already, and event streams, which are sent as they are made, do not.
+ */
+bool compressibleContentType(const std::string& contentType);
+
+/**
+ * @brief Whether an If-None-Match header matches an entity tag
+ *
+ * Uses the weak comparison of RFC 9110 13.1.2, so W/"x" and "x" match,
+ * and * matches any tag.
+ *
+ * @param ifNoneMatch Value of the If-None-Match header, may be empty
+ * @param etag Tag of the current representation, quotes included
+ */
+bool etagMatches(const std::string& ifNoneMatch, const std::string& etag);
+
+#endif // __HTTP_ENCODING_H__
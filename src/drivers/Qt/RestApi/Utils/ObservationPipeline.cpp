@@ -0,0 +1,138 @@
+#include "ObservationPipeline.h"
+#include <algorithm>
+#include <cstring>
+
+const unsigned int ObservationSpec::FRAME_WIDTH;
+const unsigned int ObservationSpec::FRAME_HEIGHT;
+const unsigned int ObservationSpec::MAX_STACK;
+
+bool ObservationSpec::validate(std::string& error) const {
+    if ((cropWidth == 0) || (cropHeight == 0) ||
+        (cropX + cropWidth > FRAME_WIDTH) || (cropY + cropHeight > FRAME_HEIGHT)) {
+        error = "Crop must lie inside the 256x240 frame";
+        return false;
+    }
+    if ((width == 0) || (height == 0) || (width > cropWidth) || (height > cropHeight)) {
+        error = "Output size must be 1 to the crop size";
+        return false;
+    }
+    if ((stack == 0) || (stack > MAX_STACK)) {
+        error = "Stack must be 1 to " + std::to_string(MAX_STACK);
+        return false;
+    }
+    return true;
+}
+
+ObservationPipeline::ObservationPipeline() : head(0), count(0) {
+    std::memset(colors, 0, sizeof(colors));
+}
+
+// Output cell i covers crop pixels [start[i], start[i + 1])
+static void cellStarts(std::vector<unsigned int>& start, unsigned int cells, unsigned int crop) {
+    start.resize(cells + 1);
+    for (unsigned int i = 0; i <= cells; i++) {
+        start[i] = i * crop / cells;
+    }
+}
+
+void ObservationPipeline::configure(const ObservationSpec& spec, const uint8_t* palette) {
+    current = spec;
+
+    for (int i = 0; i < 256; i++) {
+        const uint8_t* rgb = palette + i * 3;
+        if (spec.grayscale) {
+            // ITU-R BT.601 luma, as the usual Atari style preprocessing
+            colors[i][0] = static_cast<uint8_t>((299 * rgb[0] + 587 * rgb[1] + 114 * rgb[2] + 500) / 1000);
+        } else {
+            std::memcpy(colors[i], rgb, 3);
+        }
+    }
+
+    cellStarts(colStart, spec.width, spec.cropWidth);
+    cellStarts(rowStart, spec.height, spec.cropHeight);
+    row.resize(static_cast<size_t>(spec.cropWidth) * spec.channels());
+    sums.resize(static_cast<size_t>(spec.width) * spec.channels());
+    frames.assign(spec.size(), 0);
+    reset();
+}
+
+void ObservationPipeline::reset() {
+    head = 0;
+    count = 0;
+}
+
+void ObservationPipeline::process(const uint8_t* frame) {
+    if (frames.empty()) {
+        return;
+    }
+    const unsigned int ch = current.channels();
+    const unsigned int width = current.width;
+    uint8_t* out = frames.data() + head * current.frameBytes();
+
+    for (unsigned int oy = 0; oy < current.height; oy++) {
+        const unsigned int y0 = rowStart[oy];
+        const unsigned int y1 = rowStart[oy + 1];
+
+        if (current.resample == ObservationSpec::Resample::Nearest) {
+            const uint8_t* src = frame + (current.cropY + (y0 + y1) / 2) * ObservationSpec::FRAME_WIDTH + current.cropX;
+            for (unsigned int ox = 0; ox < width; ox++) {
+                const uint8_t* color = colors[src[(colStart[ox] + colStart[ox + 1]) / 2]];
+                for (unsigned int c = 0; c < ch; c++) {
+                    *out++ = color[c];
+                }
+            }
+            continue;
+        }
+
+        std::fill(sums.begin(), sums.end(), 0);
+        for (unsigned int y = y0; y < y1; y++) {
+            const uint8_t* src = frame + (current.cropY + y) * ObservationSpec::FRAME_WIDTH + current.cropX;
+
+            // Palette lookup of the whole row first, then plain sums
+            uint8_t* dst = row.data();
+            for (unsigned int x = 0; x < current.cropWidth; x++) {
+                for (unsigned int c = 0; c < ch; c++) {
+                    *dst++ = colors[src[x]][c];
+                }
+            }
+            for (unsigned int ox = 0; ox < width; ox++) {
+                const uint8_t* cell = row.data() + colStart[ox] * ch;
+                const unsigned int pixels = colStart[ox + 1] - colStart[ox];
+                uint32_t* sum = sums.data() + ox * ch;
+                for (unsigned int i = 0; i < pixels; i++) {
+                    for (unsigned int c = 0; c < ch; c++) {
+                        sum[c] += cell[i * ch + c];
+                    }
+                }
+            }
+        }
+        for (unsigned int ox = 0; ox < width; ox++) {
+            const uint32_t area = (colStart[ox + 1] - colStart[ox]) * (y1 - y0);
+            for (unsigned int c = 0; c < ch; c++) {
+                *out++ = static_cast<uint8_t>((sums[ox * ch + c] + area / 2) / area);
+            }
+        }
+    }
+
+    head = (head + 1) % current.stack;
+    if (count < current.stack) {
+        count++;
+    }
+}
+
+bool ObservationPipeline::observation(uint8_t* out) const {
+    if (count == 0) {
+        return false;
+    }
+    const size_t bytes = current.frameBytes();
+    const unsigned int stack = current.stack;
+    const unsigned int oldest = (head + stack - count) % stack;
+
+    for (unsigned int i = 0; i < stack; i++) {
+        // Slots before the oldest processed frame repeat it
+        unsigned int age = (i + count < stack) ? 0 : i + count - stack;
+        unsigned int slot = (oldest + age) % stack;
+        std::memcpy(out + i * bytes, frames.data() + slot * bytes, bytes);
+    }
+    return true;
+}
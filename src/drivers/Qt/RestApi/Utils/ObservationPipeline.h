@@ -0,0 +1,111 @@
+#ifndef __OBSERVATION_PIPELINE_H__
+#define __OBSERVATION_PIPELINE_H__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief How an observation is computed from the indexed frame
+ *
+ * The crop is taken from the 256x240 frame, resampled to width x height
+ * and converted through the palette to luma or RGB. The last stack frames
+ * are kept, an observation is stack x height x width x channels bytes,
+ * oldest frame first.
+ */
+struct ObservationSpec {
+    enum class Resample {
+        Nearest,    ///< Center pixel of each output cell
+        Area        ///< Mean of each output cell
+    };
+
+    static const unsigned int FRAME_WIDTH = 256;
+    static const unsigned int FRAME_HEIGHT = 240;
+    static const unsigned int MAX_STACK = 16;
+
+    unsigned int cropX = 0;
+    unsigned int cropY = 0;
+    unsigned int cropWidth = FRAME_WIDTH;
+    unsigned int cropHeight = FRAME_HEIGHT;
+    unsigned int width = 84;
+    unsigned int height = 84;
+    Resample resample = Resample::Area;
+    bool grayscale = true;      ///< One luma channel, otherwise RGB
+    unsigned int stack = 4;
+
+    unsigned int channels() const { return grayscale ? 1 : 3; }
+
+    size_t frameBytes() const { return static_cast<size_t>(width) * height * channels(); }
+
+    size_t size() const { return frameBytes() * stack; }
+
+    /**
+     * @brief Check the spec
+     * @param error Reason when invalid
+     * @return false if the crop leaves the frame, the output is larger
+     *         than the crop or the stack is out of range
+     */
+    bool validate(std::string& error) const;
+};
+
+/**
+ * @brief Crop, resample, palette conversion and frame stacking
+ *
+ * Tables are built once by configure() so that process() is a table
+ * lookup per crop pixel and a sum per output cell, loops the compiler
+ * vectorizes.
+ */
+class ObservationPipeline {
+public:
+    ObservationPipeline();
+
+    /**
+     * @brief Set the spec and palette, dropping the stacked frames
+     *
+     * @param spec Valid spec
+     * @param palette 256 RGB triples for the frame buffer indices
+     */
+    void configure(const ObservationSpec& spec, const uint8_t* palette);
+
+    const ObservationSpec& spec() const { return current; }
+
+    /**
+     * @brief Process a 256x240 indexed frame onto the stack
+     */
+    void process(const uint8_t* frame);
+
+    /**
+     * @brief Drop the stacked frames, keeping the spec
+     */
+    void reset();
+
+    /**
+     * @brief Frames processed since the last configure() or reset(), up to the stack
+     */
+    unsigned int stacked() const { return count; }
+
+    /**
+     * @brief Write the stacked frames, oldest first
+     *
+     * While fewer frames than the stack were processed the oldest one is
+     * repeated in front, as after an environment reset.
+     *
+     * @param out spec().size() bytes
+     * @return false if no frame was processed yet
+     */
+    bool observation(uint8_t* out) const;
+
+private:
+    ObservationSpec current;
+    uint8_t colors[256][3];                 ///< Palette, luma in [0] when grayscale
+    std::vector<unsigned int> colStart;     ///< Crop column of each output column, width + 1
+    std::vector<unsigned int> rowStart;     ///< Crop row of each output row, height + 1
+    std::vector<uint8_t> row;               ///< One converted crop row
+    std::vector<uint32_t> sums;             ///< Area sums of one output row
+    std::vector<uint8_t> frames;            ///< Stack ring
+    unsigned int head;                      ///< Next ring slot
+    unsigned int count;
+};
+
+#endif // __OBSERVATION_PIPELINE_H__
@@ -0,0 +1,47 @@
+#include "ReadCoalescer.h"
+#include <algorithm>
+
+const size_t ReadCoalescer::MEMORY_SIZE;
+
+ReadCoalescer::ReadCoalescer()
+    : memory(MEMORY_SIZE, 0) {
+    spans.reserve(64);
+}
+
+bool ReadCoalescer::add(uint16_t start, uint32_t length) {
+    if ((length == 0) || (start + length > MEMORY_SIZE)) {
+        return false;
+    }
+    Span span = { start, start + length };
+    spans.push_back(span);
+    return true;
+}
+
+size_t ReadCoalescer::readAll(ByteReader readByte) {
+    if (spans.empty()) {
+        return 0;
+    }
+    std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) {
+        return a.start < b.start;
+    });
+
+    // Merge in place, touching or overlapping spans become one
+    size_t merged = 0;
+    for (size_t i = 1; i < spans.size(); i++) {
+        if (spans[i].start <= spans[merged].end) {
+            spans[merged].end = std::max(spans[merged].end, spans[i].end);
+        } else {
+            spans[++merged] = spans[i];
+        }
+    }
+    spans.resize(merged + 1);
+
+    size_t count = 0;
+    for (const auto& span : spans) {
+        for (uint32_t addr = span.start; addr < span.end; addr++) {
+            memory[addr] = readByte(addr);
+        }
+        count += span.end - span.start;
+    }
+    return count;
+}
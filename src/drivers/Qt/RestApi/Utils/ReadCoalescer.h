@@ -0,0 +1,68 @@
+#ifndef __READ_COALESCER_H__
+#define __READ_COALESCER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief CPU memory reads of several commands merged into one pass
+ *
+ * Read-only commands pending at a frame boundary register their ranges
+ * with add(). readAll() then reads every requested byte once, with
+ * overlapping and adjacent ranges merged, into a 64 KB image of the CPU
+ * address space that each command copies its answer from.
+ *
+ * Emulator thread only. clear() keeps the storage, so a steady stream of
+ * reads does not allocate.
+ */
+class ReadCoalescer {
+public:
+    typedef uint8_t (*ByteReader)(uint32_t address);
+
+    static const size_t MEMORY_SIZE = 0x10000;
+
+    ReadCoalescer();
+
+    /**
+     * @brief Request a range
+     * @return false if the range is empty or runs past 0xFFFF
+     */
+    bool add(uint16_t start, uint32_t length);
+
+    /**
+     * @brief Read every requested byte once
+     * @return Number of bytes read
+     */
+    size_t readAll(ByteReader readByte);
+
+    /**
+     * @brief Bytes read from an address by the last readAll()
+     *
+     * Only the requested ranges hold valid data.
+     */
+    const uint8_t* bytes(uint16_t start) const { return &memory[start]; }
+
+    /**
+     * @brief Forget all ranges
+     */
+    void clear() { spans.clear(); }
+
+    bool empty() const { return spans.empty(); }
+
+    /**
+     * @brief Contiguous spans left after merging, valid after readAll()
+     */
+    size_t spanCount() const { return spans.size(); }
+
+private:
+    struct Span {
+        uint32_t start;
+        uint32_t end;   ///< One past the last address
+    };
+
+    std::vector<Span> spans;
+    std::vector<uint8_t> memory;
+};
+
+#endif // __READ_COALESCER_H__
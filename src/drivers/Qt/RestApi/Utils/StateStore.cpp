@@ -0,0 +1,96 @@
+#include "StateStore.h"
+#include <chrono>
+#include <random>
+#include <cstdio>
+
+// splitmix64, a bijection, so distinct ids give distinct handles
+static uint64_t mixHandle(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+StateStore::StateStore(size_t capacityBytes)
+    : bytes(0), capacity(capacityBytes), nextId(0), evictions(0) {
+    std::random_device rd;
+    salt = (static_cast<uint64_t>(rd()) << 32) ^ rd() ^
+           static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+void StateStore::setCapacity(size_t capacityBytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    capacity = capacityBytes;
+    evictTo(capacity);
+}
+
+void StateStore::evictTo(size_t limit) {
+    while ((bytes > limit) && !lru.empty()) {
+        bytes -= lru.back().data.size();
+        index.erase(lru.back().handle);
+        lru.pop_back();
+        evictions++;
+    }
+}
+
+std::string StateStore::put(std::vector<uint8_t>&& data) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (data.size() > capacity) {
+        return std::string();
+    }
+    evictTo(capacity - data.size());
+
+    char handle[24];
+    snprintf(handle, sizeof(handle), "%016llx", (unsigned long long)mixHandle(salt ^ nextId++));
+
+    bytes += data.size();
+    lru.push_front(Entry());
+    lru.front().handle = handle;
+    lru.front().data.swap(data);
+    index[lru.front().handle] = lru.begin();
+
+    return lru.front().handle;
+}
+
+bool StateStore::get(const std::string& handle, std::vector<uint8_t>& data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(handle);
+
+    if (it == index.end()) {
+        return false;
+    }
+    lru.splice(lru.begin(), lru, it->second);
+    data = it->second->data;
+    return true;
+}
+
+bool StateStore::remove(const std::string& handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(handle);
+
+    if (it == index.end()) {
+        return false;
+    }
+    bytes -= it->second->data.size();
+    lru.erase(it->second);
+    index.erase(it);
+    return true;
+}
+
+void StateStore::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    lru.clear();
+    index.clear();
+    bytes = 0;
+}
+
+StateStore::Stats StateStore::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats s;
+    s.count = lru.size();
+    s.bytes = bytes;
+    s.capacity = capacity;
+    s.evictions = evictions;
+    return s;
+}
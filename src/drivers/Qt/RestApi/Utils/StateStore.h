@@ -0,0 +1,88 @@
+#ifndef __STATE_STORE_H__
+#define __STATE_STORE_H__
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Default memory cap of the state store, 256 MB
+ */
+const size_t DEFAULT_STATE_STORE_BYTES = 256u * 1024u * 1024u;
+
+/**
+ * @brief In-memory save states addressed by opaque handles
+ *
+ * Holds the states that /api/state/snapshot takes and /api/state/upload
+ * receives, so nothing goes through the filesystem. When the total size
+ * would pass the cap the least recently used states are evicted; a restore
+ * or download counts as a use. Handles are 16 hex digits, unique for the
+ * life of the store and not guessable from each other.
+ *
+ * All methods are thread safe.
+ */
+class StateStore {
+public:
+    struct Stats {
+        size_t count;           ///< States held
+        size_t bytes;           ///< Their total size
+        size_t capacity;        ///< Memory cap
+        uint64_t evictions;     ///< States evicted to stay under the cap
+    };
+
+    explicit StateStore(size_t capacityBytes = DEFAULT_STATE_STORE_BYTES);
+
+    /**
+     * @brief Change the memory cap, evicting states that no longer fit
+     */
+    void setCapacity(size_t capacityBytes);
+
+    /**
+     * @brief Store a state
+     *
+     * @param data State bytes, moved into the store
+     * @return Handle of the state, empty if the state alone is larger than the cap
+     */
+    std::string put(std::vector<uint8_t>&& data);
+
+    /**
+     * @brief Copy a state out and mark it most recently used
+     *
+     * @return false if the handle is unknown or was evicted
+     */
+    bool get(const std::string& handle, std::vector<uint8_t>& data);
+
+    /**
+     * @brief Drop a state
+     *
+     * @return false if the handle is unknown
+     */
+    bool remove(const std::string& handle);
+
+    void clear();
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::string handle;
+        std::vector<uint8_t> data;
+    };
+
+    mutable std::mutex mutex;
+    std::list<Entry> lru;   // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    size_t bytes;
+    size_t capacity;
+    uint64_t nextId;
+    uint64_t salt;
+    uint64_t evictions;
+
+    void evictTo(size_t limit);
+};
+
+#endif // __STATE_STORE_H__
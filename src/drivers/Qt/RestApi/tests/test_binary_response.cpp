@@ -0,0 +1,141 @@
+/**
+ * Unit tests for REST API binary response helpers
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../Utils/BinaryResponse.h"
+
+static std::vector<uint8_t> bytesOf(const std::string& s) {
+    return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+// Content negotiation
+
+TEST(ResponseFormatTest, DefaultsToJson) {
+    EXPECT_EQ(negotiateResponseFormat(""), ResponseFormat::Json);
+    EXPECT_EQ(negotiateResponseFormat("*/*"), ResponseFormat::Json);
+    EXPECT_EQ(negotiateResponseFormat("text/html"), ResponseFormat::Json);
+    EXPECT_EQ(negotiateResponseFormat("application/json"), ResponseFormat::Json);
+}
+
+TEST(ResponseFormatTest, SelectsBinaryFormats) {
+    EXPECT_EQ(negotiateResponseFormat("application/octet-stream"), ResponseFormat::OctetStream);
+    EXPECT_EQ(negotiateResponseFormat("application/cbor"), ResponseFormat::Cbor);
+    EXPECT_EQ(negotiateResponseFormat(" Application/CBOR "), ResponseFormat::Cbor);
+}
+
+TEST(ResponseFormatTest, FirstRangeWinsTies) {
+    EXPECT_EQ(negotiateResponseFormat("application/cbor, application/json"), ResponseFormat::Cbor);
+    EXPECT_EQ(negotiateResponseFormat("application/json, application/cbor"), ResponseFormat::Json);
+}
+
+TEST(ResponseFormatTest, HonoursQValues) {
+    EXPECT_EQ(negotiateResponseFormat("application/json;q=0.5, application/octet-stream"),
+              ResponseFormat::OctetStream);
+    EXPECT_EQ(negotiateResponseFormat("application/octet-stream;q=0.2, application/json;q=0.9"),
+              ResponseFormat::Json);
+    EXPECT_EQ(negotiateResponseFormat("application/cbor;q=0"), ResponseFormat::Json);
+}
+
+TEST(ResponseFormatTest, ContentTypes) {
+    EXPECT_STREQ(responseContentType(ResponseFormat::Json), "application/json");
+    EXPECT_STREQ(responseContentType(ResponseFormat::OctetStream), "application/octet-stream");
+    EXPECT_STREQ(responseContentType(ResponseFormat::Cbor), "application/cbor");
+}
+
+// Base64, test vectors from RFC 4648 section 10
+
+TEST(Base64Test, Rfc4648Vectors) {
+    const char* vectors[][2] = {
+        { "",       ""         },
+        { "f",      "Zg=="     },
+        { "fo",     "Zm8="     },
+        { "foo",    "Zm9v"     },
+        { "foob",   "Zm9vYg==" },
+        { "fooba",  "Zm9vYmE=" },
+        { "foobar", "Zm9vYmFy" },
+    };
+
+    for (const auto& v : vectors) {
+        std::string in(v[0]);
+        EXPECT_EQ(base64Encode(reinterpret_cast<const uint8_t*>(in.data()), in.size()), v[1]);
+    }
+}
+
+TEST(Base64Test, HighBytes) {
+    const uint8_t bytes[] = { 0xFF, 0xFE, 0xFD };
+    EXPECT_EQ(base64Encode(bytes, sizeof(bytes)), "//79");
+}
+
+// CBOR encoding, expected bytes from RFC 8949 appendix A
+
+TEST(CborWriterTest, UnsignedIntegers) {
+    struct { uint64_t value; std::string encoded; } cases[] = {
+        { 0,           std::string("\x00", 1) },
+        { 23,          "\x17" },
+        { 24,          "\x18\x18" },
+        { 255,         "\x18\xff" },
+        { 256,         std::string("\x19\x01\x00", 3) },
+        { 1000000,     std::string("\x1a\x00\x0f\x42\x40", 5) },
+        { 1000000000000ull, std::string("\x1b\x00\x00\x00\xe8\xd4\xa5\x10\x00", 9) },
+    };
+
+    for (const auto& c : cases) {
+        CborWriter cbor;
+        cbor.writeUInt(c.value);
+        EXPECT_EQ(cbor.data(), c.encoded) << "value " << c.value;
+    }
+}
+
+TEST(CborWriterTest, StringsAndContainers) {
+    CborWriter cbor;
+    cbor.beginMap(2);
+    cbor.writeText("a");
+    cbor.writeUInt(1);
+    cbor.writeText("b");
+    cbor.beginArray(2);
+    cbor.writeUInt(2);
+    const uint8_t bytes[] = { 0x01, 0x02, 0x03, 0x04 };
+    cbor.writeBytes(bytes, sizeof(bytes));
+
+    EXPECT_EQ(cbor.data(), std::string("\xa2\x61\x61\x01\x61\x62\x82\x02\x44\x01\x02\x03\x04", 13));
+}
+
+TEST(CborWriterTest, LongByteString) {
+    std::vector<uint8_t> bytes(2048, 0xAA);
+    CborWriter cbor;
+    cbor.writeBytes(bytes.data(), bytes.size());
+
+    ASSERT_EQ(cbor.data().size(), 3u + bytes.size());
+    EXPECT_EQ(cbor.data().substr(0, 3), std::string("\x59\x08\x00", 3));
+}
+
+// Offset table
+
+TEST(RangeTableTest, Layout) {
+    std::vector<RangeTableEntry> entries = {
+        { 0x0000, 2, 0 },
+        { 0x6000, 3, 2 },
+    };
+    std::vector<uint8_t> data = bytesOf("\x10\x11\x20\x21\x22");
+
+    std::string body = encodeRangeTable(entries, data);
+
+    ASSERT_EQ(body.size(), 4 + 2 * RANGE_TABLE_ENTRY_SIZE + data.size());
+    EXPECT_EQ(body.substr(0, 4), std::string("\x02\x00\x00\x00", 4));
+    EXPECT_EQ(body.substr(4, 8), std::string("\x00\x00\x00\x00\x00\x00\x02\x00", 8));
+    EXPECT_EQ(body.substr(12, 8), std::string("\x02\x00\x00\x00\x00\x60\x03\x00", 8));
+    EXPECT_EQ(body.substr(20), std::string("\x10\x11\x20\x21\x22"));
+}
+
+TEST(RangeTableTest, Empty) {
+    std::string body = encodeRangeTable(std::vector<RangeTableEntry>(), std::vector<uint8_t>());
+    EXPECT_EQ(body, std::string("\x00\x00\x00\x00", 4));
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
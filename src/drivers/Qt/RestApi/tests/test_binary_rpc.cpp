@@ -0,0 +1,153 @@
+/**
+ * Unit tests for the REST API binary RPC codec
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../Utils/BinaryRpc.h"
+
+static std::string header(uint16_t count, uint8_t version = RPC_VERSION) {
+    std::string out;
+    rpcAppendU32(out, RPC_REQUEST_MAGIC);
+    out.push_back(static_cast<char>(version));
+    out.push_back(0);
+    out.push_back(static_cast<char>(count & 0xFF));
+    out.push_back(static_cast<char>(count >> 8));
+    return out;
+}
+
+static void appendU16(std::string& out, uint16_t value) {
+    out.push_back(static_cast<char>(value & 0xFF));
+    out.push_back(static_cast<char>(value >> 8));
+}
+
+TEST(BinaryRpcTest, MagicIsAscii) {
+    std::string out;
+    rpcAppendU32(out, RPC_REQUEST_MAGIC);
+    EXPECT_EQ(out, "FXRQ");
+    out.clear();
+    rpcAppendU32(out, RPC_RESPONSE_MAGIC);
+    EXPECT_EQ(out, "FXRS");
+}
+
+TEST(BinaryRpcTest, DecodesEveryOperation) {
+    std::string body = header(7);
+    body.push_back(0x01); appendU16(body, 0x0300); appendU16(body, 16);
+    body.push_back(0x02); appendU16(body, 0x0010); appendU16(body, 2);
+    body.push_back('\x12'); body.push_back('\x34');
+    body.push_back(0x03); body.push_back(2); body.push_back('\x81'); appendU16(body, 5);
+    body.push_back(0x04); appendU16(body, 60);
+    body.push_back(0x05);
+    body.push_back(0x06); rpcAppendU64(body, 0x0123456789abcdefULL);
+    body.push_back(0x07);
+
+    std::vector<RpcRequestOp> ops;
+    std::string error;
+    ASSERT_TRUE(decodeRpcRequest(body, ops, error)) << error;
+    ASSERT_EQ(ops.size(), 7u);
+
+    EXPECT_EQ(ops[0].op, RpcOp::Read);
+    EXPECT_EQ(ops[0].address, 0x0300);
+    EXPECT_EQ(ops[0].length, 16);
+
+    EXPECT_EQ(ops[1].op, RpcOp::Write);
+    EXPECT_EQ(ops[1].data, (std::vector<uint8_t>{0x12, 0x34}));
+
+    EXPECT_EQ(ops[2].op, RpcOp::Input);
+    EXPECT_EQ(ops[2].port, 1);
+    EXPECT_EQ(ops[2].buttons, 0x81);
+    EXPECT_EQ(ops[2].frames, 5);
+
+    EXPECT_EQ(ops[3].op, RpcOp::Step);
+    EXPECT_EQ(ops[3].frames, 60);
+
+    EXPECT_EQ(ops[4].op, RpcOp::Snapshot);
+    EXPECT_EQ(ops[5].handle, 0x0123456789abcdefULL);
+    EXPECT_EQ(ops[6].op, RpcOp::Frame);
+}
+
+TEST(BinaryRpcTest, RejectsMalformedRequests) {
+    std::vector<RpcRequestOp> ops;
+    std::string error;
+
+    EXPECT_FALSE(decodeRpcRequest("FXR", ops, error));
+    EXPECT_FALSE(decodeRpcRequest("XXXX\x01\x00\x01\x00\x05", ops, error));
+    EXPECT_FALSE(decodeRpcRequest(header(1, 2) + "\x05", ops, error));
+    EXPECT_FALSE(decodeRpcRequest(header(0), ops, error));
+    EXPECT_FALSE(decodeRpcRequest(header(MAX_RPC_OPS + 1), ops, error));
+
+    // Unknown opcode
+    EXPECT_FALSE(decodeRpcRequest(header(1) + "\x7f", ops, error));
+
+    // Write announcing more bytes than sent
+    std::string body = header(1);
+    body.push_back(0x02); appendU16(body, 0); appendU16(body, 4);
+    body.append("ab");
+    EXPECT_FALSE(decodeRpcRequest(body, ops, error));
+    EXPECT_EQ(error, "Truncated operation 0");
+
+    // Bad input port
+    body = header(1);
+    body.push_back(0x03); body.push_back(5); body.push_back(0); appendU16(body, 1);
+    EXPECT_FALSE(decodeRpcRequest(body, ops, error));
+
+    // Trailing garbage
+    EXPECT_FALSE(decodeRpcRequest(header(1) + "\x05" + "x", ops, error));
+}
+
+TEST(BinaryRpcTest, DecodesBatchStep) {
+    std::string body = header(1);
+    body.push_back(0x08); body.push_back(2); body.push_back(4);
+    body.push_back(RPC_BATCH_RAM | (2 << RPC_BATCH_SCALE_SHIFT));
+    rpcAppendU32(body, 7); body.push_back('\x80');
+    rpcAppendU32(body, 9); body.push_back(0x01);
+
+    std::vector<RpcRequestOp> ops;
+    std::string error;
+    ASSERT_TRUE(decodeRpcRequest(body, ops, error)) << error;
+    ASSERT_EQ(ops.size(), 1u);
+    EXPECT_EQ(ops[0].op, RpcOp::StepBatch);
+    EXPECT_EQ(ops[0].frames, 4);
+    EXPECT_EQ(ops[0].ids, (std::vector<uint32_t>{7, 9}));
+    EXPECT_EQ(ops[0].data, (std::vector<uint8_t>{0x80, 0x01}));
+    EXPECT_EQ((ops[0].flags & RPC_BATCH_SCALE_MASK) >> RPC_BATCH_SCALE_SHIFT, 2);
+
+    // No instances, unknown flags, short instance list
+    EXPECT_FALSE(decodeRpcRequest(header(1) + std::string("\x08\x00\x01\x01", 4), ops, error));
+    EXPECT_FALSE(decodeRpcRequest(header(1) + std::string("\x08\x01\x01\x80\x01\x00\x00\x00\x00", 9), ops, error));
+    EXPECT_FALSE(decodeRpcRequest(header(1) + std::string("\x08\x02\x01\x01\x01\x00\x00\x00\x00", 9), ops, error));
+    EXPECT_EQ(error, "Truncated operation 0");
+}
+
+TEST(BinaryRpcTest, DecodesObservation) {
+    std::vector<RpcRequestOp> ops;
+    std::string error;
+    ASSERT_TRUE(decodeRpcRequest(header(1) + "\x09", ops, error)) << error;
+    EXPECT_EQ(ops[0].op, RpcOp::Observation);
+}
+
+TEST(BinaryRpcTest, EncodesResultsInPlace) {
+    std::vector<RpcResult> results(2);
+    results[0].op = RpcOp::Read;
+    results[0].payload = std::string("\x00\x01\x02", 3);
+    results[1].op = RpcOp::Write;
+    results[1].status = RpcStatus::Failed;
+    results[1].payload = "nope";
+
+    std::string out = encodeRpcResponse(results);
+    ASSERT_EQ(out.size(), RPC_HEADER_SIZE + 6 + 3 + 6 + 4);
+    EXPECT_EQ(out.substr(0, 4), "FXRS");
+    EXPECT_EQ(out[4], RPC_VERSION);
+    EXPECT_EQ(out[6], 2);
+    EXPECT_EQ(out[7], 0);
+
+    EXPECT_EQ(out[8], 0x01);
+    EXPECT_EQ(out[9], 0);
+    EXPECT_EQ(out[10], 3);
+    EXPECT_EQ(out.substr(14, 3), std::string("\x00\x01\x02", 3));
+
+    EXPECT_EQ(out[17], 0x02);
+    EXPECT_EQ(out[18], 3);
+    EXPECT_EQ(out.substr(23), "nope");
+}
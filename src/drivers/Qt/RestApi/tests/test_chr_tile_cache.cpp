@@ -0,0 +1,64 @@
+/**
+ * Unit tests for the CHR tile cache behind the PPU image endpoint
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include "../../../common/chr_tile_cache.h"
+
+TEST(ChrTileCacheTest, DecodesBothBitPlanes) {
+    // row 0: plane 0 only, row 1: plane 1 only, row 2: both, rest clear
+    uint8_t chr[16] = { 0xF0, 0x00, 0x0F, 0, 0, 0, 0, 0,
+                        0x00, 0xF0, 0x0F, 0, 0, 0, 0, 0 };
+    uint8_t pix[64];
+
+    CHRTileDecode(chr, pix);
+
+    const uint8_t expected[3][8] = {
+        { 1, 1, 1, 1, 0, 0, 0, 0 },
+        { 2, 2, 2, 2, 0, 0, 0, 0 },
+        { 0, 0, 0, 0, 3, 3, 3, 3 },
+    };
+    EXPECT_EQ(0, memcmp(pix, expected, sizeof(expected)));
+    for (int i = 24; i < 64; i++) {
+        EXPECT_EQ(0, pix[i]);
+    }
+}
+
+TEST(ChrTileCacheTest, PageDecodedOncePerVersion) {
+    static uint8_t chr[8][0x400];
+    uint32_t version[8] = { 0 };
+    CHRTileCache cache;
+
+    memset(chr, 0, sizeof(chr));
+    chr[2][5 * 16] = 0x80;  // tile 5 of page 2, top left pixel
+
+    const uint8_t* tile = cache.tile(0x0800 + 5 * 16, chr, version);
+    EXPECT_EQ(1, tile[0]);
+    EXPECT_EQ(1u, cache.decodeCount());
+
+    // same version: served from the cache even though the bytes changed
+    chr[2][5 * 16] = 0x00;
+    tile = cache.tile(0x0800 + 5 * 16, chr, version);
+    EXPECT_EQ(1, tile[0]);
+    EXPECT_EQ(1u, cache.decodeCount());
+
+    version[2]++;
+    tile = cache.tile(0x0800 + 5 * 16, chr, version);
+    EXPECT_EQ(0, tile[0]);
+    EXPECT_EQ(2u, cache.decodeCount());
+}
+
+TEST(ChrTileCacheTest, InvalidateForcesDecode) {
+    static uint8_t chr[0x400];
+    CHRTileCache cache;
+
+    memset(chr, 0, sizeof(chr));
+    cache.page(7, chr, 42);
+    cache.page(7, chr, 42);
+    EXPECT_EQ(1u, cache.decodeCount());
+
+    cache.invalidate();
+    cache.page(7, chr, 42);
+    EXPECT_EQ(2u, cache.decodeCount());
+}
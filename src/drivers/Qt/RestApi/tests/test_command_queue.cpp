@@ -8,6 +8,7 @@
 #include <vector>
 #include <atomic>
 #include "../CommandQueue.h"
+#include "../CommandPool.h"
 #include "../RestApiCommands.h"
 
 // Mock command for testing
@@ -171,6 +172,88 @@ TEST_F(CommandQueueTest, ConcurrentAccess) {
     EXPECT_TRUE(queue.empty());
 }
 
+// Test depth and high-water statistics
+TEST_F(CommandQueueTest, Statistics) {
+    CommandQueue queue(4);
+    
+    EXPECT_EQ(queue.highWaterMark(), 0);
+    
+    for (int i = 0; i < 6; i++) {
+        queue.push(std::make_unique<MockCommand>());
+    }
+    EXPECT_EQ(queue.size(), 4);
+    EXPECT_EQ(queue.highWaterMark(), 4);
+    EXPECT_EQ(queue.totalPushed(), 4);
+    EXPECT_EQ(queue.totalRejected(), 2);
+    
+    // High-water mark survives draining
+    queue.tryPop();
+    queue.tryPop();
+    queue.tryPop();
+    EXPECT_EQ(queue.size(), 1);
+    EXPECT_EQ(queue.highWaterMark(), 4);
+    
+    queue.resetHighWaterMark();
+    EXPECT_EQ(queue.highWaterMark(), 1);
+}
+
+// Test that the queue keeps FIFO order and wraps around its ring
+TEST_F(CommandQueueTest, FifoOrderAcrossWrap) {
+    CommandQueue queue(3);
+    
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 3; i++) {
+            EXPECT_TRUE(queue.push(std::make_unique<MockCommand>("cmd" + std::to_string(round * 3 + i))));
+        }
+        for (int i = 0; i < 3; i++) {
+            auto cmd = queue.tryPop();
+            ASSERT_NE(cmd, nullptr);
+            EXPECT_EQ(std::string(cmd->name()), "cmd" + std::to_string(round * 3 + i));
+        }
+        EXPECT_EQ(queue.tryPop(), nullptr);
+    }
+}
+
+// Test that commands are served from the pool and returned to it
+TEST_F(CommandQueueTest, CommandPoolReuse) {
+    CommandPool& pool = CommandPool::instance();
+    size_t inUseBefore = pool.blocksInUse();
+    uint64_t fallbackBefore = pool.fallbackAllocations();
+    
+    {
+        CommandQueue queue;
+        for (int i = 0; i < 100; i++) {
+            queue.push(std::make_unique<MockCommand>());
+        }
+        EXPECT_EQ(pool.blocksInUse(), inUseBefore + 100);
+        
+        while (auto cmd = queue.tryPop()) {
+            cmd->execute();
+        }
+    }
+    EXPECT_EQ(pool.blocksInUse(), inUseBefore);
+    EXPECT_EQ(pool.fallbackAllocations(), fallbackBefore);
+}
+
+// Test pool exhaustion falls back to the heap
+TEST_F(CommandQueueTest, CommandPoolFallback) {
+    CommandPool pool(2);
+    
+    void* a = pool.allocate(32);
+    void* b = pool.allocate(32);
+    void* c = pool.allocate(32);                             // Pool exhausted
+    void* d = pool.allocate(CommandPool::BLOCK_SIZE + 1);    // Too large
+    
+    EXPECT_EQ(pool.blocksInUse(), 2);
+    EXPECT_EQ(pool.fallbackAllocations(), 2);
+    
+    pool.release(a);
+    pool.release(b);
+    pool.release(c);
+    pool.release(d);
+    EXPECT_EQ(pool.blocksInUse(), 0);
+}
+
 // Test command with result
 TEST_F(CommandQueueTest, CommandWithResult) {
     auto cmd = std::make_unique<TestResultCommand>(42);
@@ -0,0 +1,162 @@
+/**
+ * Unit tests for REST API frame completion notifications
+ */
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <thread>
+#include "../FrameClock.h"
+
+TEST(FrameClockTest, RepeatedFrameIsNotCounted) {
+    FrameClock clock;
+
+    clock.frameDone(10);
+    clock.frameDone(10);
+    clock.frameDone(11);
+    EXPECT_EQ(clock.currentId(), 2u);
+}
+
+TEST(FrameClockTest, IdKeepsGoingWhenCounterGoesBack) {
+    FrameClock clock;
+
+    clock.frameDone(500);
+    clock.frameDone(3);   // State load
+    clock.frameDone(4);
+    EXPECT_EQ(clock.currentId(), 3u);
+}
+
+TEST(FrameClockTest, StepCompletesOnNthFrame) {
+    FrameClock clock;
+    clock.frameDone(1);
+
+    std::promise<FrameClockTick> done;
+    auto future = done.get_future();
+    EXPECT_EQ(clock.addStep(3, std::move(done), false), 4u);
+
+    EXPECT_FALSE(clock.frameDone(2));
+    EXPECT_FALSE(clock.frameDone(3));
+    EXPECT_EQ(future.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+
+    EXPECT_FALSE(clock.frameDone(4));
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    FrameClockTick tick = future.get();
+    EXPECT_EQ(tick.id, 4u);
+    EXPECT_EQ(tick.frame, 4);
+    EXPECT_EQ(clock.pendingSteps(), 0u);
+}
+
+TEST(FrameClockTest, StepUntilInputSkipsLagFrames) {
+    FrameClock clock;
+
+    std::promise<FrameClockTick> done;
+    auto future = done.get_future();
+    EXPECT_EQ(clock.addStep(10, std::move(done), true, true), 10u);
+
+    EXPECT_FALSE(clock.frameDone(1, true));
+    EXPECT_FALSE(clock.frameDone(2, true));
+    EXPECT_EQ(future.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+
+    EXPECT_TRUE(clock.frameDone(3, false));
+    FrameClockTick tick = future.get();
+    EXPECT_EQ(tick.id, 3u);
+    EXPECT_EQ(tick.lagFrames, 2u);
+}
+
+TEST(FrameClockTest, StepUntilInputGivesUpAtLimit) {
+    FrameClock clock;
+
+    std::promise<FrameClockTick> done;
+    auto future = done.get_future();
+    clock.addStep(2, std::move(done), false, true);
+
+    clock.frameDone(1, true);
+    clock.frameDone(2, true);
+    FrameClockTick tick = future.get();
+    EXPECT_EQ(tick.id, 2u);
+    EXPECT_EQ(tick.lagFrames, 2u);
+}
+
+TEST(FrameClockTest, PausesAfterLastPendingStep) {
+    FrameClock clock;
+
+    std::promise<FrameClockTick> first, second;
+    auto firstDone = first.get_future();
+    auto secondDone = second.get_future();
+    clock.addStep(1, std::move(first), true);
+    clock.addStep(2, std::move(second), false);
+
+    EXPECT_FALSE(clock.frameDone(1));
+    EXPECT_EQ(firstDone.get().id, 1u);
+    EXPECT_TRUE(clock.frameDone(2));
+    EXPECT_EQ(secondDone.get().id, 2u);
+
+    // Nothing pending, nothing to pause
+    EXPECT_FALSE(clock.frameDone(3));
+}
+
+TEST(FrameClockTest, CancelFailsPendingSteps) {
+    FrameClock clock;
+
+    std::promise<FrameClockTick> done;
+    auto future = done.get_future();
+    clock.addStep(5, std::move(done), true);
+    clock.cancelSteps("Game closed");
+
+    EXPECT_THROW(future.get(), std::runtime_error);
+    EXPECT_EQ(clock.pendingSteps(), 0u);
+    EXPECT_FALSE(clock.frameDone(1));
+}
+
+TEST(FrameClockTest, WaitReturnsAtOnceForOldId) {
+    FrameClock clock;
+    clock.frameDone(7);
+
+    FrameClockTick tick;
+    EXPECT_TRUE(clock.waitAfter(0, 0, tick));
+    EXPECT_EQ(tick.id, 1u);
+    EXPECT_EQ(tick.frame, 7);
+}
+
+TEST(FrameClockTest, WaitTimesOut) {
+    FrameClock clock;
+
+    FrameClockTick tick;
+    EXPECT_FALSE(clock.waitAfter(0, 20, tick));
+    EXPECT_EQ(tick.id, 0u);
+}
+
+TEST(FrameClockTest, WaitWakesOnNextFrame) {
+    FrameClock clock;
+    clock.frameDone(1);
+
+    std::thread emulator([&clock]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        clock.frameDone(2);
+    });
+
+    FrameClockTick tick;
+    EXPECT_TRUE(clock.waitAfter(1, 5000, tick));
+    EXPECT_EQ(tick.id, 2u);
+    EXPECT_EQ(tick.frame, 2);
+    emulator.join();
+}
+
+TEST(FrameClockTest, CloseWakesWaiters) {
+    FrameClock clock;
+
+    std::thread server([&clock]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        clock.closeAll();
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    FrameClockTick tick;
+    EXPECT_FALSE(clock.waitAfter(0, 5000, tick));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(4));
+    server.join();
+
+    // Later waits are not affected
+    clock.frameDone(1);
+    EXPECT_TRUE(clock.waitAfter(0, 0, tick));
+}
@@ -0,0 +1,96 @@
+/**
+ * Unit tests for REST API frame diff encoding
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <random>
+#include "../Utils/FrameDiff.h"
+
+static const size_t FRAME_SIZE = 256 * 240;
+
+TEST(FrameDiffTest, IdenticalFramesGiveEmptyDiff) {
+    std::vector<uint8_t> frame(FRAME_SIZE, 0x0F);
+    EXPECT_TRUE(encodeFrameDiff(frame.data(), frame.data(), frame.size()).empty());
+}
+
+TEST(FrameDiffTest, SingleByteChange) {
+    std::vector<uint8_t> prev(FRAME_SIZE, 0x00);
+    std::vector<uint8_t> cur(prev);
+    cur[0x1234] = 0x2A;
+
+    std::string diff = encodeFrameDiff(prev.data(), cur.data(), cur.size());
+
+    ASSERT_EQ(diff.size(), FRAME_DIFF_RUN_HEADER + 1);
+    EXPECT_EQ(diff, std::string("\x34\x12\x00\x00\x01\x00\x2a", 7));
+}
+
+TEST(FrameDiffTest, NearbyChangesAreMerged) {
+    std::vector<uint8_t> prev(64, 0x00);
+    std::vector<uint8_t> cur(prev);
+    cur[10] = 1;
+    cur[13] = 1;    // gap of 2, merged
+    cur[40] = 1;    // far away, separate run
+
+    std::string diff = encodeFrameDiff(prev.data(), cur.data(), cur.size());
+
+    EXPECT_EQ(diff.size(), (FRAME_DIFF_RUN_HEADER + 4) + (FRAME_DIFF_RUN_HEADER + 1));
+}
+
+TEST(FrameDiffTest, LongRunsAreSplit) {
+    std::vector<uint8_t> prev(FRAME_SIZE, 0x00);
+    std::vector<uint8_t> cur(FRAME_SIZE, 0x01);
+
+    std::string diff = encodeFrameDiff(prev.data(), cur.data(), cur.size());
+
+    EXPECT_EQ(diff.size(), FRAME_SIZE + 1 * FRAME_DIFF_RUN_HEADER);
+    ASSERT_TRUE(applyFrameDiff(prev.data(), prev.size(), diff));
+    EXPECT_EQ(prev, cur);
+
+    std::vector<uint8_t> big0(0x20000, 0x00);
+    std::vector<uint8_t> big1(0x20000, 0x01);
+    diff = encodeFrameDiff(big0.data(), big1.data(), big1.size());
+    EXPECT_EQ(diff.size(), big1.size() + 3 * FRAME_DIFF_RUN_HEADER);
+}
+
+TEST(FrameDiffTest, RoundTripRandomFrames) {
+    std::mt19937 rng(1234);
+    std::vector<uint8_t> prev(FRAME_SIZE);
+    for (auto& b : prev) b = static_cast<uint8_t>(rng() & 0x3F);
+
+    for (int iter = 0; iter < 20; iter++) {
+        std::vector<uint8_t> cur(prev);
+        int changes = rng() % 2000;
+        for (int c = 0; c < changes; c++) {
+            cur[rng() % FRAME_SIZE] = static_cast<uint8_t>(rng() & 0x3F);
+        }
+
+        std::string diff = encodeFrameDiff(prev.data(), cur.data(), cur.size());
+        std::vector<uint8_t> rebuilt(prev);
+        ASSERT_TRUE(applyFrameDiff(rebuilt.data(), rebuilt.size(), diff));
+        EXPECT_EQ(rebuilt, cur);
+
+        prev = cur;
+    }
+}
+
+TEST(FrameDiffTest, RejectsMalformedDiffs) {
+    std::vector<uint8_t> buffer(16, 0x00);
+
+    // Truncated header
+    EXPECT_FALSE(applyFrameDiff(buffer.data(), buffer.size(), std::string("\x00\x00\x00", 3)));
+
+    // Length runs past the payload
+    EXPECT_FALSE(applyFrameDiff(buffer.data(), buffer.size(),
+                                std::string("\x00\x00\x00\x00\x04\x00\x01", 7)));
+
+    // Writes past the end of the buffer
+    EXPECT_FALSE(applyFrameDiff(buffer.data(), buffer.size(),
+                                std::string("\x0f\x00\x00\x00\x02\x00\x01\x02", 8)));
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,169 @@
+/**
+ * Unit tests for REST API frame streaming
+ */
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include "../FrameStream.h"
+
+static uint8_t fakeRam[0x800];
+
+static uint8_t readFakeRam(uint32_t address) {
+    return fakeRam[address & 0x7FF];
+}
+
+class FrameStreamTest : public ::testing::Test {
+protected:
+    FrameStreamHub hub;
+    std::vector<uint8_t> video;
+
+    void SetUp() override {
+        video.assign(FrameStreamHub::FRAME_SIZE, 0x0F);
+        for (size_t i = 0; i < sizeof(fakeRam); i++) {
+            fakeRam[i] = static_cast<uint8_t>(i);
+        }
+    }
+};
+
+TEST_F(FrameStreamTest, NoSubscribersIsANoOp) {
+    hub.publish(1, video.data(), readFakeRam);
+    EXPECT_EQ(hub.subscriberCount(), 0u);
+}
+
+TEST_F(FrameStreamTest, SubscriberLimit) {
+    std::vector<std::shared_ptr<FrameSubscriber>> subs;
+    for (size_t i = 0; i < FrameStreamHub::MAX_SUBSCRIBERS; i++) {
+        subs.push_back(hub.subscribe(FrameStreamOptions()));
+        ASSERT_TRUE(subs.back() != nullptr);
+    }
+    EXPECT_TRUE(hub.subscribe(FrameStreamOptions()) == nullptr);
+
+    hub.unsubscribe(subs.front());
+    EXPECT_EQ(hub.subscriberCount(), FrameStreamHub::MAX_SUBSCRIBERS - 1);
+    EXPECT_TRUE(subs.front()->isClosed());
+    EXPECT_TRUE(hub.subscribe(FrameStreamOptions()) != nullptr);
+}
+
+TEST_F(FrameStreamTest, PausedFramesAreNotRepeated) {
+    auto sub = hub.subscribe(FrameStreamOptions());
+
+    hub.publish(10, video.data(), readFakeRam);
+    hub.publish(10, video.data(), readFakeRam);
+    hub.publish(11, video.data(), readFakeRam);
+
+    FrameStreamEvent event;
+    ASSERT_TRUE(sub->waitEvent(event, 0));
+    EXPECT_EQ(event.frame, 10);
+    ASSERT_TRUE(sub->waitEvent(event, 0));
+    EXPECT_EQ(event.frame, 11);
+    EXPECT_FALSE(sub->waitEvent(event, 0));
+}
+
+TEST_F(FrameStreamTest, PerSubscriberPacing) {
+    FrameStreamOptions everyThird;
+    everyThird.every = 3;
+    everyThird.maxQueue = 16;
+    auto slow = hub.subscribe(everyThird);
+
+    FrameStreamOptions everyFrame;
+    everyFrame.maxQueue = 16;
+    auto fast = hub.subscribe(everyFrame);
+
+    for (int frame = 1; frame <= 9; frame++) {
+        hub.publish(frame, video.data(), readFakeRam);
+    }
+
+    std::vector<int> slowFrames, fastFrames;
+    FrameStreamEvent event;
+    while (slow->waitEvent(event, 0)) slowFrames.push_back(event.frame);
+    while (fast->waitEvent(event, 0)) fastFrames.push_back(event.frame);
+
+    EXPECT_EQ(slowFrames, std::vector<int>({1, 4, 7}));
+    EXPECT_EQ(fastFrames.size(), 9u);
+}
+
+TEST_F(FrameStreamTest, SlowClientDropsOldest) {
+    FrameStreamOptions opts;
+    opts.maxQueue = 2;
+    auto sub = hub.subscribe(opts);
+
+    for (int frame = 1; frame <= 5; frame++) {
+        hub.publish(frame, video.data(), readFakeRam);
+    }
+
+    FrameStreamEvent event;
+    ASSERT_TRUE(sub->waitEvent(event, 0));
+    EXPECT_EQ(event.frame, 4);
+    ASSERT_TRUE(sub->waitEvent(event, 0));
+    EXPECT_EQ(event.frame, 5);
+    EXPECT_EQ(sub->droppedEvents(), 3u);
+}
+
+TEST_F(FrameStreamTest, RangesAreSampled) {
+    FrameStreamOptions opts;
+    opts.video = FrameStreamOptions::Video::None;
+    opts.ranges.push_back({0x0010, 2});
+    opts.ranges.push_back({0x0100, 1});
+    auto sub = hub.subscribe(opts);
+
+    hub.publish(1, video.data(), readFakeRam);
+
+    FrameStreamEvent event;
+    ASSERT_TRUE(sub->waitEvent(event, 0));
+    EXPECT_FALSE(event.video);
+    EXPECT_EQ(event.samples, std::vector<uint8_t>({0x10, 0x11, 0x00}));
+
+    std::string sse = sub->encodeEvent(event);
+    EXPECT_EQ(sse.find("event: frame\nid: 1\ndata: "), 0u);
+    EXPECT_NE(sse.find("\"ranges\":[{\"start\":\"0x0010\",\"data\":\"EBE=\"},"
+                       "{\"start\":\"0x0100\",\"data\":\"AA==\"}]"), std::string::npos);
+    EXPECT_EQ(sse.find("\"video\""), std::string::npos);
+    EXPECT_EQ(sse.substr(sse.size() - 2), "\n\n");
+}
+
+TEST_F(FrameStreamTest, DiffModeSendsKeyFrameFirst) {
+    FrameStreamOptions opts;
+    opts.video = FrameStreamOptions::Video::Diff;
+    opts.maxQueue = 8;
+    auto sub = hub.subscribe(opts);
+
+    hub.publish(1, video.data(), readFakeRam);
+    video[100] = 0x20;
+    hub.publish(2, video.data(), readFakeRam);
+
+    FrameStreamEvent event;
+    ASSERT_TRUE(sub->waitEvent(event, 0));
+    std::string first = sub->encodeEvent(event);
+    ASSERT_TRUE(sub->waitEvent(event, 0));
+    std::string second = sub->encodeEvent(event);
+
+    EXPECT_NE(first.find("\"encoding\":\"key\""), std::string::npos);
+    EXPECT_NE(second.find("\"encoding\":\"diff\""), std::string::npos);
+    EXPECT_LT(second.size(), 200u);
+}
+
+TEST_F(FrameStreamTest, CloseAllWakesWaiters) {
+    auto sub = hub.subscribe(FrameStreamOptions());
+
+    std::thread closer([this] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        hub.closeAll();
+    });
+
+    FrameStreamEvent event;
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(sub->waitEvent(event, 5000));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    closer.join();
+
+    EXPECT_TRUE(sub->isClosed());
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), 1000);
+    EXPECT_EQ(hub.subscriberCount(), 0u);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,114 @@
+/**
+ * Unit tests for REST API scheduled input
+ */
+
+#include <gtest/gtest.h>
+#include "../InputTimeline.h"
+
+static InputTimelineEvent makeEvent(int frame, int port, uint8_t buttons, int frames = 1) {
+    InputTimelineEvent event;
+    event.frame = frame;
+    event.frames = static_cast<uint16_t>(frames);
+    event.port = static_cast<uint8_t>(port);
+    event.buttons = buttons;
+    return event;
+}
+
+TEST(InputTimelineTest, AppliesOnlyOnScheduledFrames) {
+    InputTimeline timeline;
+    timeline.schedule(makeEvent(10, 0, 0x01, 2));
+
+    uint8_t buttons = 0x80;
+    EXPECT_FALSE(timeline.apply(9, 0, buttons));
+    EXPECT_EQ(buttons, 0x80);
+
+    EXPECT_TRUE(timeline.apply(10, 0, buttons));
+    EXPECT_EQ(buttons, 0x01);
+
+    buttons = 0x80;
+    EXPECT_TRUE(timeline.apply(11, 0, buttons));
+    EXPECT_EQ(buttons, 0x01);
+
+    buttons = 0x80;
+    EXPECT_FALSE(timeline.apply(12, 0, buttons));
+    EXPECT_EQ(buttons, 0x80);
+    EXPECT_TRUE(timeline.empty());
+}
+
+TEST(InputTimelineTest, PortsAreIndependent) {
+    InputTimeline timeline;
+    timeline.schedule(makeEvent(5, 1, 0x08));
+
+    uint8_t buttons = 0;
+    EXPECT_FALSE(timeline.apply(5, 0, buttons));
+    EXPECT_TRUE(timeline.apply(5, 1, buttons));
+    EXPECT_EQ(buttons, 0x08);
+}
+
+TEST(InputTimelineTest, OutOfOrderEventsAreSorted) {
+    InputTimeline timeline;
+    timeline.schedule(makeEvent(30, 0, 0x04));
+    timeline.schedule(makeEvent(10, 0, 0x01));
+    timeline.schedule(makeEvent(20, 0, 0x02));
+
+    EXPECT_EQ(timeline.nextFrame(), 10);
+    EXPECT_EQ(timeline.endFrame(), 31);
+
+    uint8_t buttons = 0;
+    EXPECT_TRUE(timeline.apply(20, 0, buttons));
+    EXPECT_EQ(buttons, 0x02);
+    EXPECT_EQ(timeline.size(), 2u);
+    EXPECT_EQ(timeline.nextFrame(), 20);
+
+    timeline.apply(21, 0, buttons);
+    EXPECT_EQ(timeline.size(), 1u);
+    EXPECT_EQ(timeline.nextFrame(), 30);
+}
+
+TEST(InputTimelineTest, OverlappingEventsCombine) {
+    InputTimeline timeline;
+    timeline.schedule(makeEvent(0, 0, 0x80, 10));
+    timeline.schedule(makeEvent(4, 0, 0x01, 1));
+
+    uint8_t buttons = 0;
+    timeline.apply(4, 0, buttons);
+    EXPECT_EQ(buttons, 0x81);
+
+    // The short event ended, the long one still holds
+    timeline.apply(5, 0, buttons);
+    EXPECT_EQ(buttons, 0x80);
+}
+
+TEST(InputTimelineTest, EmptyButtonsHoldNothing) {
+    InputTimeline timeline;
+    timeline.schedule(makeEvent(3, 0, 0x00, 2));
+
+    uint8_t buttons = 0xFF;
+    EXPECT_TRUE(timeline.apply(3, 0, buttons));
+    EXPECT_EQ(buttons, 0x00);
+}
+
+TEST(InputTimelineTest, CapacityIsBounded) {
+    InputTimeline timeline;
+    for (size_t i = 0; i < InputTimeline::CAPACITY; i++) {
+        ASSERT_TRUE(timeline.schedule(makeEvent(static_cast<int>(i), 0, 0x01)));
+    }
+    EXPECT_FALSE(timeline.schedule(makeEvent(0, 0, 0x01)));
+
+    // Consuming frames makes room again
+    uint8_t buttons = 0;
+    timeline.apply(100, 0, buttons);
+    EXPECT_EQ(timeline.size(), InputTimeline::CAPACITY - 100);
+    EXPECT_TRUE(timeline.schedule(makeEvent(5000, 0, 0x01)));
+    EXPECT_EQ(timeline.endFrame(), 5001);
+}
+
+TEST(InputTimelineTest, ClearRemovesEverything) {
+    InputTimeline timeline;
+    timeline.schedule(makeEvent(1, 0, 0x01));
+    timeline.schedule(makeEvent(2, 1, 0x01));
+
+    EXPECT_EQ(timeline.clear(), 2u);
+    EXPECT_TRUE(timeline.empty());
+    EXPECT_EQ(timeline.nextFrame(), -1);
+}
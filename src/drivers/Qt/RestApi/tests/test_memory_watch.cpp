@@ -0,0 +1,209 @@
+/**
+ * Unit tests for REST API memory watches
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include "../MemoryWatch.h"
+
+static uint8_t fakeRam[0x800];
+
+static uint8_t readFakeRam(uint32_t address) {
+    return fakeRam[address & 0x7FF];
+}
+
+static MemoryWatchEntry makeEntry(uint16_t start, uint16_t length,
+                                  MemoryWatchEntry::Predicate predicate = MemoryWatchEntry::Predicate::Changed,
+                                  uint32_t operand = 0) {
+    MemoryWatchEntry entry;
+    entry.start = start;
+    entry.length = length;
+    entry.predicate = predicate;
+    entry.operand = operand;
+    return entry;
+}
+
+class MemoryWatchTest : public ::testing::Test {
+protected:
+    MemoryWatchHub hub;
+
+    void SetUp() override {
+        memset(fakeRam, 0, sizeof(fakeRam));
+    }
+};
+
+TEST_F(MemoryWatchTest, FirstFrameReportsEverything) {
+    MemoryWatchOptions opts;
+    opts.entries.push_back(makeEntry(0x0075, 2));
+    opts.entries.push_back(makeEntry(0x0300, 16));
+    auto watcher = hub.subscribe(opts);
+
+    fakeRam[0x75] = 0x34;
+    fakeRam[0x76] = 0x12;
+    hub.evaluate(1, readFakeRam);
+
+    MemoryWatchEvent event;
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+    EXPECT_TRUE(event.resync);
+    ASSERT_EQ(event.changes.size(), 2u);
+    EXPECT_EQ(event.changes[0].value, 0x1234u);
+    EXPECT_EQ(event.changes[1].length, 16u);
+}
+
+TEST_F(MemoryWatchTest, UnchangedMemorySendsNothing) {
+    MemoryWatchOptions opts;
+    opts.entries.push_back(makeEntry(0x0000, 64));
+    auto watcher = hub.subscribe(opts);
+
+    MemoryWatchEvent event;
+    hub.evaluate(1, readFakeRam);
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+
+    hub.evaluate(2, readFakeRam);
+    hub.evaluate(3, readFakeRam);
+    EXPECT_FALSE(watcher->waitEvent(event, 0));
+}
+
+TEST_F(MemoryWatchTest, LongRangesReportChangedRuns) {
+    MemoryWatchOptions opts;
+    opts.entries.push_back(makeEntry(0x0300, 32));
+    auto watcher = hub.subscribe(opts);
+
+    MemoryWatchEvent event;
+    hub.evaluate(1, readFakeRam);
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+
+    fakeRam[0x302] = 1;
+    fakeRam[0x303] = 2;
+    fakeRam[0x310] = 3;
+    hub.evaluate(2, readFakeRam);
+
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+    EXPECT_FALSE(event.resync);
+    ASSERT_EQ(event.changes.size(), 2u);
+    EXPECT_EQ(event.changes[0].address, 0x0302);
+    EXPECT_EQ(event.changes[0].length, 2u);
+    EXPECT_EQ(event.changes[1].address, 0x0310);
+    EXPECT_EQ(event.changes[1].length, 1u);
+    ASSERT_EQ(event.data.size(), 3u);
+    EXPECT_EQ(event.data[2], 3);
+}
+
+TEST_F(MemoryWatchTest, EqualsFiresOnTransition) {
+    MemoryWatchOptions opts;
+    opts.entries.push_back(makeEntry(0x0010, 1, MemoryWatchEntry::Predicate::Equals, 5));
+    auto watcher = hub.subscribe(opts);
+
+    MemoryWatchEvent event;
+    hub.evaluate(1, readFakeRam);
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+
+    fakeRam[0x10] = 4;
+    hub.evaluate(2, readFakeRam);
+    EXPECT_FALSE(watcher->waitEvent(event, 0));
+
+    fakeRam[0x10] = 5;
+    hub.evaluate(3, readFakeRam);
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+    EXPECT_EQ(event.frame, 3);
+    EXPECT_EQ(event.changes[0].value, 5u);
+    EXPECT_EQ(event.changes[0].previous, 4u);
+
+    // Staying equal does not fire again
+    hub.evaluate(4, readFakeRam);
+    EXPECT_FALSE(watcher->waitEvent(event, 0));
+}
+
+TEST_F(MemoryWatchTest, CrossesFiresBothWays) {
+    MemoryWatchOptions opts;
+    opts.entries.push_back(makeEntry(0x0020, 2, MemoryWatchEntry::Predicate::Crosses, 300));
+    auto watcher = hub.subscribe(opts);
+
+    MemoryWatchEvent event;
+    hub.evaluate(1, readFakeRam);
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+
+    fakeRam[0x20] = 200;
+    hub.evaluate(2, readFakeRam);
+    EXPECT_FALSE(watcher->waitEvent(event, 0));
+
+    fakeRam[0x21] = 1;  // 456
+    hub.evaluate(3, readFakeRam);
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+    EXPECT_EQ(event.changes[0].value, 456u);
+
+    fakeRam[0x21] = 0;  // 200
+    hub.evaluate(4, readFakeRam);
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+    EXPECT_EQ(event.changes[0].previous, 456u);
+}
+
+TEST_F(MemoryWatchTest, DroppedEventsForceResync) {
+    MemoryWatchOptions opts;
+    opts.entries.push_back(makeEntry(0x0000, 1));
+    opts.entries.push_back(makeEntry(0x0001, 1));
+    opts.maxQueue = 2;
+    auto watcher = hub.subscribe(opts);
+
+    for (int frame = 1; frame <= 3; frame++) {
+        fakeRam[0] = static_cast<uint8_t>(frame);
+        hub.evaluate(frame, readFakeRam);
+    }
+    EXPECT_EQ(watcher->droppedEvents(), 1u);
+
+    MemoryWatchEvent event;
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+
+    fakeRam[0] = 9;
+    hub.evaluate(4, readFakeRam);
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+    EXPECT_TRUE(event.resync);
+    EXPECT_EQ(event.changes.size(), 2u);
+}
+
+TEST_F(MemoryWatchTest, PausedFramesAreNotRepeated) {
+    MemoryWatchOptions opts;
+    opts.entries.push_back(makeEntry(0x0000, 1));
+    auto watcher = hub.subscribe(opts);
+
+    MemoryWatchEvent event;
+    hub.evaluate(10, readFakeRam);
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+
+    fakeRam[0] = 1;
+    hub.evaluate(10, readFakeRam);
+    EXPECT_FALSE(watcher->waitEvent(event, 0));
+    hub.evaluate(11, readFakeRam);
+    EXPECT_TRUE(watcher->waitEvent(event, 0));
+}
+
+TEST_F(MemoryWatchTest, EncodesServerSentEvent) {
+    MemoryWatchOptions opts;
+    opts.entries.push_back(makeEntry(0x0075, 1));
+    auto watcher = hub.subscribe(opts);
+
+    fakeRam[0x75] = 7;
+    hub.evaluate(42, readFakeRam);
+
+    MemoryWatchEvent event;
+    ASSERT_TRUE(watcher->waitEvent(event, 0));
+    std::string message = watcher->encodeEvent(event);
+
+    EXPECT_EQ(message.find("event: watch\nid: 42\n"), 0u);
+    EXPECT_NE(message.find("\"address\":\"0x0075\",\"value\":7"), std::string::npos);
+}
+
+TEST_F(MemoryWatchTest, WatcherLimit) {
+    std::vector<std::shared_ptr<MemoryWatcher>> watchers;
+    for (size_t i = 0; i < MemoryWatchHub::MAX_WATCHERS; i++) {
+        watchers.push_back(hub.subscribe(MemoryWatchOptions()));
+        ASSERT_TRUE(watchers.back() != nullptr);
+    }
+    EXPECT_TRUE(hub.subscribe(MemoryWatchOptions()) == nullptr);
+
+    hub.unsubscribe(watchers.front());
+    EXPECT_TRUE(watchers.front()->isClosed());
+    EXPECT_EQ(hub.watcherCount(), MemoryWatchHub::MAX_WATCHERS - 1);
+}
@@ -0,0 +1,115 @@
+/**
+ * Unit tests for the REST API observation preprocessing
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../Utils/ObservationPipeline.h"
+
+static const size_t FRAME_SIZE = 256 * 240;
+
+// Index i is gray level i
+static std::vector<uint8_t> grayPalette() {
+    std::vector<uint8_t> palette(256 * 3);
+    for (int i = 0; i < 256; i++) {
+        palette[i * 3] = palette[i * 3 + 1] = palette[i * 3 + 2] = static_cast<uint8_t>(i);
+    }
+    return palette;
+}
+
+TEST(ObservationPipelineTest, ValidatesSpec) {
+    std::string error;
+    ObservationSpec spec;
+    EXPECT_TRUE(spec.validate(error));
+
+    spec.cropX = 200;
+    EXPECT_FALSE(spec.validate(error));
+
+    spec = ObservationSpec();
+    spec.width = 300;
+    EXPECT_FALSE(spec.validate(error));
+
+    spec = ObservationSpec();
+    spec.stack = 0;
+    EXPECT_FALSE(spec.validate(error));
+}
+
+TEST(ObservationPipelineTest, AreaAveragesCells) {
+    ObservationSpec spec;
+    spec.cropWidth = 4;
+    spec.cropHeight = 2;
+    spec.width = 2;
+    spec.height = 1;
+    spec.stack = 1;
+
+    std::vector<uint8_t> frame(FRAME_SIZE, 0);
+    frame[0] = 10; frame[1] = 20; frame[256] = 30; frame[257] = 40;
+    frame[2] = 100; frame[3] = 100; frame[258] = 100; frame[259] = 101;
+
+    ObservationPipeline pipeline;
+    pipeline.configure(spec, grayPalette().data());
+    pipeline.process(frame.data());
+
+    uint8_t out[2];
+    ASSERT_TRUE(pipeline.observation(out));
+    EXPECT_EQ(out[0], 25);
+    EXPECT_EQ(out[1], 100);
+}
+
+TEST(ObservationPipelineTest, NearestKeepsRgb) {
+    ObservationSpec spec;
+    spec.cropX = 8;
+    spec.cropWidth = 8;
+    spec.cropHeight = 8;
+    spec.width = 2;
+    spec.height = 2;
+    spec.resample = ObservationSpec::Resample::Nearest;
+    spec.grayscale = false;
+    spec.stack = 1;
+
+    std::vector<uint8_t> palette(256 * 3, 0);
+    palette[5 * 3] = 1; palette[5 * 3 + 1] = 2; palette[5 * 3 + 2] = 3;
+
+    std::vector<uint8_t> frame(FRAME_SIZE, 0);
+    frame[2 * 256 + 8 + 6] = 5;     // center of the top right cell
+
+    ObservationPipeline pipeline;
+    pipeline.configure(spec, palette.data());
+    pipeline.process(frame.data());
+
+    ASSERT_EQ(spec.size(), 12u);
+    uint8_t out[12];
+    ASSERT_TRUE(pipeline.observation(out));
+    EXPECT_EQ(std::vector<uint8_t>(out, out + 6), (std::vector<uint8_t>{0, 0, 0, 1, 2, 3}));
+    EXPECT_EQ(std::vector<uint8_t>(out + 6, out + 12), std::vector<uint8_t>(6, 0));
+}
+
+TEST(ObservationPipelineTest, StacksOldestFirst) {
+    ObservationSpec spec;
+    spec.width = 1;
+    spec.height = 1;
+    spec.stack = 3;
+
+    ObservationPipeline pipeline;
+    pipeline.configure(spec, grayPalette().data());
+
+    uint8_t out[3];
+    EXPECT_FALSE(pipeline.observation(out));
+
+    std::vector<uint8_t> frame(FRAME_SIZE, 7);
+    pipeline.process(frame.data());
+    ASSERT_TRUE(pipeline.observation(out));
+    EXPECT_EQ(std::vector<uint8_t>(out, out + 3), (std::vector<uint8_t>{7, 7, 7}));
+
+    for (uint8_t value : {8, 9, 10}) {
+        std::fill(frame.begin(), frame.end(), value);
+        pipeline.process(frame.data());
+    }
+    ASSERT_TRUE(pipeline.observation(out));
+    EXPECT_EQ(std::vector<uint8_t>(out, out + 3), (std::vector<uint8_t>{8, 9, 10}));
+    EXPECT_EQ(pipeline.stacked(), 3u);
+
+    pipeline.reset();
+    EXPECT_FALSE(pipeline.observation(out));
+}
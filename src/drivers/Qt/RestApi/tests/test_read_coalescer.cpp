@@ -0,0 +1,74 @@
+/**
+ * Unit tests for coalesced REST API memory reads
+ */
+
+#include <gtest/gtest.h>
+#include "../Utils/ReadCoalescer.h"
+
+static uint32_t readCount;
+
+static uint8_t readAddress(uint32_t address) {
+    readCount++;
+    return static_cast<uint8_t>(address ^ (address >> 8));
+}
+
+class ReadCoalescerTest : public ::testing::Test {
+protected:
+    ReadCoalescer reads;
+
+    void SetUp() override {
+        readCount = 0;
+    }
+};
+
+TEST_F(ReadCoalescerTest, RejectsEmptyAndOutOfBounds) {
+    EXPECT_FALSE(reads.add(0x0000, 0));
+    EXPECT_FALSE(reads.add(0xFFFF, 2));
+    EXPECT_TRUE(reads.add(0xFFFF, 1));
+    EXPECT_TRUE(reads.add(0x0000, 0x10000));
+}
+
+TEST_F(ReadCoalescerTest, OverlappingRangesAreReadOnce) {
+    reads.add(0x0300, 16);
+    reads.add(0x0308, 16);
+    reads.add(0x0300, 4);
+    reads.add(0x0300, 1);
+
+    EXPECT_EQ(reads.readAll(readAddress), 24u);
+    EXPECT_EQ(readCount, 24u);
+    EXPECT_EQ(reads.spanCount(), 1u);
+
+    for (uint32_t addr = 0x0300; addr < 0x0318; addr++) {
+        EXPECT_EQ(reads.bytes(0x0300)[addr - 0x0300], readAddress(addr));
+    }
+}
+
+TEST_F(ReadCoalescerTest, AdjacentRangesMerge) {
+    reads.add(0x0010, 16);
+    reads.add(0x0000, 16);
+
+    EXPECT_EQ(reads.readAll(readAddress), 32u);
+    EXPECT_EQ(reads.spanCount(), 1u);
+}
+
+TEST_F(ReadCoalescerTest, DisjointRangesStaySeparate) {
+    reads.add(0x6000, 8);
+    reads.add(0x0000, 8);
+    reads.add(0x0100, 8);
+
+    EXPECT_EQ(reads.readAll(readAddress), 24u);
+    EXPECT_EQ(reads.spanCount(), 3u);
+    EXPECT_EQ(*reads.bytes(0x6003), readAddress(0x6003));
+    EXPECT_EQ(*reads.bytes(0x0105), readAddress(0x0105));
+}
+
+TEST_F(ReadCoalescerTest, ClearStartsOver) {
+    reads.add(0x0000, 8);
+    reads.readAll(readAddress);
+    reads.clear();
+
+    EXPECT_TRUE(reads.empty());
+    readCount = 0;
+    EXPECT_EQ(reads.readAll(readAddress), 0u);
+    EXPECT_EQ(readCount, 0u);
+}
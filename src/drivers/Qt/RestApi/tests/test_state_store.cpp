@@ -0,0 +1,95 @@
+/**
+ * Unit tests for the REST API in-memory state store
+ */
+
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "../Utils/StateStore.h"
+
+static std::vector<uint8_t> makeState(size_t size, uint8_t fill) {
+    return std::vector<uint8_t>(size, fill);
+}
+
+TEST(StateStoreTest, PutThenGet) {
+    StateStore store(1024);
+    std::string handle = store.put(makeState(100, 0x5A));
+
+    ASSERT_EQ(handle.size(), 16u);
+
+    std::vector<uint8_t> out;
+    ASSERT_TRUE(store.get(handle, out));
+    EXPECT_EQ(out, makeState(100, 0x5A));
+    EXPECT_EQ(store.stats().count, 1u);
+    EXPECT_EQ(store.stats().bytes, 100u);
+}
+
+TEST(StateStoreTest, HandlesAreUnique) {
+    StateStore store(1 << 20);
+    std::set<std::string> handles;
+
+    for (int i = 0; i < 1000; i++) {
+        handles.insert(store.put(makeState(1, 0)));
+    }
+    EXPECT_EQ(handles.size(), 1000u);
+}
+
+TEST(StateStoreTest, UnknownHandle) {
+    StateStore store(1024);
+    std::vector<uint8_t> out;
+
+    EXPECT_FALSE(store.get("0123456789abcdef", out));
+    EXPECT_FALSE(store.remove("0123456789abcdef"));
+}
+
+TEST(StateStoreTest, EvictsLeastRecentlyUsed) {
+    StateStore store(300);
+    std::string a = store.put(makeState(100, 1));
+    std::string b = store.put(makeState(100, 2));
+    std::string c = store.put(makeState(100, 3));
+    std::vector<uint8_t> out;
+
+    // a becomes the most recently used, so b goes first
+    ASSERT_TRUE(store.get(a, out));
+    std::string d = store.put(makeState(100, 4));
+
+    EXPECT_TRUE(store.get(a, out));
+    EXPECT_FALSE(store.get(b, out));
+    EXPECT_TRUE(store.get(c, out));
+    EXPECT_TRUE(store.get(d, out));
+    EXPECT_EQ(store.stats().bytes, 300u);
+    EXPECT_EQ(store.stats().evictions, 1u);
+}
+
+TEST(StateStoreTest, StateLargerThanCapIsRefused) {
+    StateStore store(100);
+    std::string a = store.put(makeState(50, 1));
+
+    EXPECT_TRUE(store.put(makeState(101, 2)).empty());
+
+    std::vector<uint8_t> out;
+    EXPECT_TRUE(store.get(a, out));
+}
+
+TEST(StateStoreTest, LoweringCapEvicts) {
+    StateStore store(1000);
+    std::string a = store.put(makeState(400, 1));
+    std::string b = store.put(makeState(400, 2));
+
+    store.setCapacity(500);
+
+    std::vector<uint8_t> out;
+    EXPECT_FALSE(store.get(a, out));
+    EXPECT_TRUE(store.get(b, out));
+    EXPECT_EQ(store.stats().capacity, 500u);
+}
+
+TEST(StateStoreTest, RemoveFreesBytes) {
+    StateStore store(1000);
+    std::string a = store.put(makeState(400, 1));
+
+    EXPECT_TRUE(store.remove(a));
+    EXPECT_EQ(store.stats().bytes, 0u);
+    EXPECT_EQ(store.stats().count, 0u);
+}
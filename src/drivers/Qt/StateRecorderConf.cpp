@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <vector>
 
 #include <QCloseEvent>
 #include <QGridLayout>
@@ -140,6 +141,27 @@ StateRecorderDialog_t::StateRecorderDialog_t(QWidget *parent)
 	frame->setLayout(hbox);
 	grid->addWidget( frame, 1, 1 );
 
+	frame = new QGroupBox(tr("Key Frame Every:"));
+	hbox  = new QHBoxLayout();
+
+	keyFrameInterval = new QSpinBox();
+	keyFrameInterval->setMinimum(1);
+	keyFrameInterval->setMaximum(600);
+	keyFrameInterval->setToolTip( tr("Snapshots between full key frames, the ones in between only store changes.\n"
+	                                 "1 stores every snapshot as a full compressed save state.") );
+
+	opt = 30;
+	g_config->getOption("SDL.StateRecorderKeyFrameInterval", &opt);
+	keyFrameInterval->setValue(opt);
+
+	connect( keyFrameInterval, SIGNAL(valueChanged(int)), this, SLOT(spinBoxValueChanged(int)) );
+
+	hbox->addWidget( keyFrameInterval );
+	hbox->addWidget( new QLabel( tr("Snapshots") ) );
+
+	frame->setLayout(hbox);
+	grid->addWidget( frame, 0, 1 );
+
 	frame1 = new QGroupBox(tr("Snapshot Timing Setting:"));
 	hbox1  = new QHBoxLayout();
 	frame1->setLayout(hbox1);
@@ -378,6 +400,7 @@ void StateRecorderDialog_t::packConfig( StateRecorderConfigData &config )
 	config.timeBetweenSnapsMinutes = static_cast<float>( snapMinutes->value() ) +
 		                          ( static_cast<float>( snapSeconds->value() ) / 60.0f );
 	config.compressionLevel = cmprLvlCbox->currentData().toInt();
+	config.keyFrameInterval = keyFrameInterval->value();
 	config.loadPauseTimeSeconds = pauseDuration->value();
 	config.pauseOnLoad = static_cast<StateRecorderConfigData::PauseType>( pauseOnLoadCbox->currentData().toInt() );
 }
@@ -443,6 +466,7 @@ void StateRecorderDialog_t::applyChanges(void)
 	g_config->setOption("SDL.StateRecorderTimeBetweenSnapsMin", snapMinutes->value() );
 	g_config->setOption("SDL.StateRecorderTimeBetweenSnapsSec", snapSeconds->value() );
 	g_config->setOption("SDL.StateRecorderCompressionLevel", config.compressionLevel);
+	g_config->setOption("SDL.StateRecorderKeyFrameInterval", config.keyFrameInterval);
 	g_config->setOption("SDL.StateRecorderPauseOnLoad", config.pauseOnLoad);
 	g_config->setOption("SDL.StateRecorderPauseDuration", config.loadPauseTimeSeconds);
 	g_config->setOption("SDL.StateRecorderEnable", recorderEnable->isChecked() );
@@ -621,6 +645,7 @@ void StateRecorderDialog_t::recalcMemoryUsage(void)
 
 		EMUFILE_MEMORY em;
 		int compressionLevel = cmprLvlCbox->currentData().toInt();
+		std::vector <uint8> snap( FCEUSS_SnapshotSize() );
 
 		ts_start = getHighPrecTimeStamp();
 
@@ -628,14 +653,40 @@ void StateRecorderDialog_t::recalcMemoryUsage(void)
 		// on what the compression delays will be.
 		for (int i=0; i<numIterations; i++)
 		{
-			em.set_len(0);
-			FCEUSS_SaveMS( &em, compressionLevel );
+			if (keyFrameInterval->value() > 1)
+			{
+				FCEUSS_Snapshot( snap.data(), snap.size() );
+			}
+			else
+			{
+				em.set_len(0);
+				FCEUSS_SaveMS( &em, compressionLevel );
+			}
 		}
 		ts_end   = getHighPrecTimeStamp();
 
 		saveTimeMs = (ts_end - ts_start) * 1000.0 / static_cast<double>(numIterations);
 
-		fsnapSize = static_cast<float>( em.size() );
+		if (keyFrameInterval->value() > 1)
+		{
+			// Delta size depends on the game, prefer the average of the running
+			// recorder and fall back to the key frame size as an upper bound.
+			int numSnapsSaved = FCEU_StateRecorderGetNumSnapsSaved();
+
+			if (numSnapsSaved > 0)
+			{
+				fsnapSize = static_cast<float>( FCEU_StateRecorderGetDataSize() ) /
+				            static_cast<float>( numSnapsSaved );
+			}
+			else
+			{
+				fsnapSize = static_cast<float>( snap.size() );
+			}
+		}
+		else
+		{
+			fsnapSize = static_cast<float>( em.size() );
+		}
 
 		FCEU_WRAPPER_UNLOCK();
 	}
@@ -37,6 +37,7 @@ protected:
 	QSpinBox     *snapSeconds;
 	QSpinBox     *snapFrames;
 	QSpinBox     *historyDuration;
+	QSpinBox     *keyFrameInterval;
 	QSpinBox     *pauseDuration;
 	QCheckBox    *recorderEnable;
 	QLineEdit    *numSnapsLbl;
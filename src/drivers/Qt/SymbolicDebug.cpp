@@ -75,7 +75,7 @@ debugSymbol_t *replaceSymbols( int flags, int addr, char *str )
 	return sym;
 }
 //--------------------------------------------------------------
-int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugSymbol_t *symOut, debugSymbol_t *symOut2 )
+int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugSymbol_t *symOut, debugSymbol_t *symOut2, const disasmValues_t *vals )
 {
 	debugSymbol_t *sym  = NULL;
 	debugSymbol_t *sym2 = NULL;
@@ -89,9 +89,11 @@ int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugS
 	symDebugEnable = (flags & ASM_DEBUG_SYMS  ) ? true : false;
 	showTrace      = (flags & ASM_DEBUG_TRACES) ? true : false;
 
-	//these may be replaced later with passed-in values to make a lighter-weight disassembly mode that may not query the referenced values
-	#define RX (X.X)
-	#define RY (X.Y)
+	// Registers and referenced memory are the live ones unless the values
+	// of an earlier run of the instruction were passed in (trace logger).
+	#define RX (vals ? vals->X : X.X)
+	#define RY (vals ? vals->Y : X.Y)
+	#define MEMVAL(a) (vals ? vals->value : GetMem(a))
 
 	switch (opcode[0]) 
 	{
@@ -106,12 +108,18 @@ int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugS
 			(a) = (opcode[1]+(i))&0xFF; \
 		}
 		#define indirectX(a) { \
-			(a) = (opcode[1]+RX)&0xFF; \
-			(a) = GetMem((a)) | (GetMem(((a)+1)&0xff))<<8; \
+			if (vals) (a) = vals->effAddr; \
+			else { \
+				(a) = (opcode[1]+RX)&0xFF; \
+				(a) = GetMem((a)) | (GetMem(((a)+1)&0xff))<<8; \
+			} \
 		}
 		#define indirectY(a) { \
-			(a) = GetMem(opcode[1]) | (GetMem((opcode[1]+1)&0xff))<<8; \
-			(a) += RY; \
+			if (vals) (a) = vals->effAddr; \
+			else { \
+				(a) = GetMem(opcode[1]) | (GetMem((opcode[1]+1)&0xff))<<8; \
+				(a) += RY; \
+			} \
 		}
 
 
@@ -178,7 +186,7 @@ int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugS
 				else
 					sb << sb_addr(tmp);
 
-				sb << " = " << sb_lit(GetMem(tmp));
+				sb << " = " << sb_lit(MEMVAL(tmp));
 			}
 			break;
 
@@ -218,7 +226,7 @@ int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugS
 				sb << sb_addr(opcode[1], 2);
 
 			if (showTrace)
-				sb << " = " << sb_lit(GetMem(opcode[1]));
+				sb << " = " << sb_lit(MEMVAL(opcode[1]));
 
 		// ################################## End of SP CODE ###########################
 			break;
@@ -275,7 +283,7 @@ int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugS
 				sb << sb_addr(tmp);
 
 			if (showTrace)
-				sb << " = " << sb_lit(GetMem(tmp));
+				sb << " = " << sb_lit(MEMVAL(tmp));
 
 			break;
 
@@ -327,7 +335,7 @@ int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugS
 				else
 					sb << sb_addr(tmp);
 
-				sb << " = " << sb_lit(GetMem(tmp));
+				sb << " = " << sb_lit(MEMVAL(tmp));
 			}
 			break;
 
@@ -367,7 +375,7 @@ int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugS
 				else
 					sb << sb_addr(tmp);
 
-				sb << " = " << sb_lit(GetMem(tmp));
+				sb << " = " << sb_lit(MEMVAL(tmp));
 			}
 		// ################################## End of SP CODE ###########################
 			break;
@@ -408,7 +416,7 @@ int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugS
 				else
 					sb << sb_addr(tmp2);
 
-				sb << " = " << sb_lit(GetMem(tmp2));
+				sb << " = " << sb_lit(MEMVAL(tmp2));
 			}
 
 			break;
@@ -457,7 +465,7 @@ int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugS
 			absolute(tmp); 
 
 			sb << "JMP (" << sb_addr(tmp);
-			sb << ") = " << sb_addr(GetMem(tmp) | GetMem(tmp + 1) << 8);
+			sb << ") = " << sb_addr(vals ? vals->effAddr : (GetMem(tmp) | GetMem(tmp + 1) << 8));
 			
 			break;
 
@@ -88,6 +88,16 @@ int generateNLFilenameForAddress(int address, std::string &NLfilename);
 #define  ASM_DEBUG_ADDR_02X   0x0008
 #define  ASM_DEBUG_TRACES     0x0010
 
-int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugSymbol_t *symOut = NULL, debugSymbol_t *symOut2 = NULL );
+// Values an instruction saw when it ran, for disassembling it later on
+// instead of reading the current CPU registers and memory.
+struct disasmValues_t
+{
+	uint8_t  X;
+	uint8_t  Y;
+	uint8_t  value;    // byte at effAddr
+	uint16_t effAddr;  // operand address, or the JMP ($xxxx) target
+};
+
+int DisassembleWithDebug(int addr, uint8_t *opcode, int flags, char *str, debugSymbol_t *symOut = NULL, debugSymbol_t *symOut2 = NULL, const disasmValues_t *vals = NULL );
 
 #endif
@@ -42,6 +42,7 @@
 #include <QActionGroup>
 #include <QApplication>
 #include <QGuiApplication>
+#include <QScreen>
 #include <QDesktopServices>
 
 #include "fceu.h"
@@ -257,6 +258,7 @@ TasEditorWindow::~TasEditorWindow(void)
 	branches.free();
 	//popupDisplay.free();
 	history.free();
+	BOOKMARK::stopScreenshotCompression();
 	playback.stopSeeking();
 	selection.free();
 
@@ -749,6 +751,13 @@ QMenuBar *TasEditorWindow::buildMenuBar(void)
 
 	confMenu->addAction(act);
 
+	// Config -> Set Greenzone Spill Capacity
+	act = new QAction(tr("Set Greenzone Spill Capacity"), this);
+	act->setStatusTip(tr("Set Greenzone Spill Capacity"));
+	connect(act, SIGNAL(triggered()), this, SLOT(setGreenzoneSpillCapacity(void)) );
+
+	confMenu->addAction(act);
+
 	confMenu->addSeparator();
 
 	// Config -> Enable Greenzoneing
@@ -1555,7 +1564,7 @@ void TasEditorWindow::frameUpdate(void)
 	}
 #endif
 
-	pianoRoll->update();
+	pianoRoll->scheduleUpdate();
 
 	if ( recentProjectMenuReset )
 	{
@@ -3426,14 +3435,14 @@ void TasEditorWindow::openProjectSaveOptions(void)
 void TasEditorWindow::setGreenzoneCapacity(void)
 {
 	int ret;
-	int newValue = taseditorConfig.greenzoneCapacity;
+	int newValue = taseditorConfig.greenzoneMemoryLimit;
 	QInputDialog dialog(this);
 	FCEU_CRITICAL_SECTION( emuLock );
 
 	dialog.setWindowTitle( tr("Greenzone Capacity") );
 	dialog.setInputMode( QInputDialog::IntInput );
-	dialog.setIntRange( GREENZONE_CAPACITY_MIN, GREENZONE_CAPACITY_MAX );
-	dialog.setLabelText( tr("Keep savestates for how many frames?\n(actual limit of savestates can be 5 times more than the number provided)") );
+	dialog.setIntRange( GREENZONE_MEMORY_LIMIT_MIN, GREENZONE_MEMORY_LIMIT_MAX );
+	dialog.setLabelText( tr("How many megabytes of memory may the Greenzone use?\n(least recently used savestates are discarded beyond that)") );
 	dialog.setIntValue( newValue );
 
 	ret = dialog.exec();
@@ -3442,23 +3451,55 @@ void TasEditorWindow::setGreenzoneCapacity(void)
 	{
 		newValue = dialog.intValue();
 
-		if (newValue < GREENZONE_CAPACITY_MIN)
+		if (newValue < GREENZONE_MEMORY_LIMIT_MIN)
 		{
-			newValue = GREENZONE_CAPACITY_MIN;
+			newValue = GREENZONE_MEMORY_LIMIT_MIN;
 		}
-		else if (newValue > GREENZONE_CAPACITY_MAX)
+		else if (newValue > GREENZONE_MEMORY_LIMIT_MAX)
 		{
-			newValue = GREENZONE_CAPACITY_MAX;
+			newValue = GREENZONE_MEMORY_LIMIT_MAX;
 		}
-		if (newValue < taseditorConfig.greenzoneCapacity)
+		if (newValue < taseditorConfig.greenzoneMemoryLimit)
 		{
-			taseditorConfig.greenzoneCapacity = newValue;
+			taseditorConfig.greenzoneMemoryLimit = newValue;
 			greenzone.runGreenzoneCleaning();
 		}
 		else
 		{
-			taseditorConfig.greenzoneCapacity = newValue;
+			taseditorConfig.greenzoneMemoryLimit = newValue;
+		}
+	}
+}
+// ----------------------------------------------------------------------------------------------
+void TasEditorWindow::setGreenzoneSpillCapacity(void)
+{
+	int ret;
+	int newValue = taseditorConfig.greenzoneSpillLimit;
+	QInputDialog dialog(this);
+	FCEU_CRITICAL_SECTION( emuLock );
+
+	dialog.setWindowTitle( tr("Greenzone Spill Capacity") );
+	dialog.setInputMode( QInputDialog::IntInput );
+	dialog.setIntRange( GREENZONE_SPILL_LIMIT_MIN, GREENZONE_SPILL_LIMIT_MAX );
+	dialog.setLabelText( tr("How many megabytes of disk may the Greenzone use for savestates that don't fit in memory?\n(0 discards them instead)") );
+	dialog.setIntValue( newValue );
+
+	ret = dialog.exec();
+
+	if ( ret == QDialog::Accepted )
+	{
+		newValue = dialog.intValue();
+
+		if (newValue < GREENZONE_SPILL_LIMIT_MIN)
+		{
+			newValue = GREENZONE_SPILL_LIMIT_MIN;
 		}
+		else if (newValue > GREENZONE_SPILL_LIMIT_MAX)
+		{
+			newValue = GREENZONE_SPILL_LIMIT_MAX;
+		}
+		taseditorConfig.greenzoneSpillLimit = newValue;
+		greenzone.runGreenzoneCleaning();
 	}
 }
 // ----------------------------------------------------------------------------------------------
@@ -4122,6 +4163,11 @@ QPianoRoll::QPianoRoll(QWidget *parent)
 
 	fceuLoadConfigColor("SDL.TasPianoRollGridColor"   , &gridColor );
 
+	nextRepaintTime = 0;
+	repaintTimer = new QTimer(this);
+	repaintTimer->setSingleShot(true);
+	connect( repaintTimer, SIGNAL(timeout(void)), this, SLOT(update(void)) );
+
 	calcFontData();
 }
 //----------------------------------------------------------------------------
@@ -4295,6 +4341,10 @@ void QPianoRoll::setFont( QFont &newFont )
 void QPianoRoll::calcFontData(void)
 {
 	QRect rect;
+
+	// the column layout changes, so do all pre-rendered rows
+	rowCache.clear();
+
 	QWidget::setFont(font);
 	QFontMetrics metrics(font);
 #if QT_VERSION > QT_VERSION_CHECK(5, 11, 0)
@@ -6254,14 +6304,402 @@ void QPianoRoll::finishDrag(void)
 	//mustCheckItemUnderMouse = true;
 }
 //----------------------------------------------------------------------------
+void QPianoRoll::getRowState( int lineNum, bool rowIsSel, rowState &state )
+{
+	QColor blkColor;
+	int frame_lag = greenzone->lagLog.getLagInfoAtFrame(lineNum);
+	bool marked = markersManager->getMarkerAtFrame(lineNum) != 0;
+
+	// zeroed as a whole, rows are compared with memcmp
+	memset( &state, 0, sizeof(state) );
+
+	state.lineNum  = lineNum;
+	state.xScroll  = pxLineXScroll;
+	state.width    = viewWidth;
+	state.selected = rowIsSel;
+	state.marked   = marked;
+
+	for (int i=0; i<2; i++)
+	{
+		if ( lineNum == history->getUndoHint())
+		{
+			// undo hint here
+			blkColor = (i%2) ? QColor(UNDOHINT_INPUT_COLOR2) : QColor(UNDOHINT_INPUT_COLOR1);
+		}
+		else if ( lineNum == currFrameCounter ||  lineNum == (playback->getFlashingPauseFrame() - 1))
+		{
+			// this is current frame
+			blkColor = (i%2) ? QColor(CUR_INPUT_COLOR2) : QColor(CUR_INPUT_COLOR1);
+		}
+		else if ( lineNum < greenzone->getSize() )
+		{
+			if (!greenzone->isSavestateEmpty(lineNum))
+			{
+				// the frame is normal Greenzone frame
+				if (frame_lag == LAGGED_YES)
+				{
+					blkColor = (i%2) ? QColor(LAG_INPUT_COLOR2) : QColor(LAG_INPUT_COLOR1);
+				}
+				else
+				{
+					blkColor = (i%2) ? QColor(GREENZONE_INPUT_COLOR2) : QColor(GREENZONE_INPUT_COLOR1);
+				}
+			}
+			else if (  !greenzone->isSavestateEmpty(lineNum & EVERY16TH)
+				|| !greenzone->isSavestateEmpty(lineNum & EVERY8TH)
+				|| !greenzone->isSavestateEmpty(lineNum & EVERY4TH)
+				|| !greenzone->isSavestateEmpty(lineNum & EVERY2ND))
+			{
+				// the frame is in a gap (in Greenzone tail)
+				if (frame_lag == LAGGED_YES)
+				{
+					blkColor = (i%2) ? QColor(PALE_LAG_INPUT_COLOR2) : QColor(PALE_LAG_INPUT_COLOR1);
+				}
+				else
+				{
+					blkColor = (i%2) ? QColor(PALE_GREENZONE_INPUT_COLOR2) : QColor(PALE_GREENZONE_INPUT_COLOR1);
+				}
+			}
+			else 
+			{
+				// the frame is above Greenzone tail
+				if (frame_lag == LAGGED_YES)
+				{
+					blkColor = (i%2) ? QColor(VERY_PALE_LAG_INPUT_COLOR2) : QColor(VERY_PALE_LAG_INPUT_COLOR1);
+				}
+				else if (frame_lag == LAGGED_NO)
+				{
+					blkColor = (i%2) ? QColor(VERY_PALE_GREENZONE_INPUT_COLOR2) : QColor(VERY_PALE_GREENZONE_INPUT_COLOR1);
+				}
+				else
+				{
+					blkColor = (i%2) ? QColor(NORMAL_INPUT_COLOR2) : QColor(NORMAL_INPUT_COLOR1);
+				}
+			}
+		}
+		else
+		{
+			// the frame is below Greenzone head
+			if (frame_lag == LAGGED_YES)
+			{
+				blkColor = (i%2) ? QColor(VERY_PALE_LAG_INPUT_COLOR2) : QColor(VERY_PALE_LAG_INPUT_COLOR1);
+			}
+			else if (frame_lag == LAGGED_NO)
+			{
+				blkColor = (i%2) ? QColor(VERY_PALE_GREENZONE_INPUT_COLOR2) : QColor(VERY_PALE_GREENZONE_INPUT_COLOR1);
+			}
+			else
+			{
+				blkColor = (i%2) ? QColor(NORMAL_INPUT_COLOR2) : QColor(NORMAL_INPUT_COLOR1);
+			}
+		}
+		state.ctlrColor[i] = blkColor.rgba();
+	}
+
+	// frame number
+	if (lineNum == history->getUndoHint())
+	{
+		// undo hint here
+		if (marked && (dragMode != DRAG_MODE_MARKER || markerDragFrameNumber != lineNum))
+		{
+			blkColor = (taseditorConfig->bindMarkersToInput) ? QColor( BINDMARKED_UNDOHINT_FRAMENUM_COLOR ) : QColor( MARKED_UNDOHINT_FRAMENUM_COLOR );
+		}
+		else
+		{
+			blkColor = QColor( UNDOHINT_FRAMENUM_COLOR );
+		}
+	}
+	else if (lineNum == currFrameCounter || lineNum == (playback->getFlashingPauseFrame() - 1))
+	{
+		// this is current frame
+		if (marked && (dragMode != DRAG_MODE_MARKER || markerDragFrameNumber != lineNum))
+		{
+			blkColor = (taseditorConfig->bindMarkersToInput) ? QColor( CUR_BINDMARKED_FRAMENUM_COLOR ) : QColor( CUR_MARKED_FRAMENUM_COLOR );
+		}
+		else
+		{
+			blkColor = QColor( CUR_FRAMENUM_COLOR );
+		}
+	}
+	else if (marked && (dragMode != DRAG_MODE_MARKER || markerDragFrameNumber != lineNum))
+	{
+		// this is marked frame
+		blkColor = (taseditorConfig->bindMarkersToInput) ? QColor( BINDMARKED_FRAMENUM_COLOR ) : QColor( MARKED_FRAMENUM_COLOR );
+	}
+	else if (lineNum < greenzone->getSize())
+	{
+		if (!greenzone->isSavestateEmpty(lineNum))
+		{
+			// the frame is normal Greenzone frame
+			if (frame_lag == LAGGED_YES)
+			{
+				blkColor = QColor( LAG_FRAMENUM_COLOR );
+			}
+			else
+			{
+				blkColor = QColor( GREENZONE_FRAMENUM_COLOR );
+			}
+		}
+		else if (!greenzone->isSavestateEmpty(lineNum & EVERY16TH)
+			|| !greenzone->isSavestateEmpty(lineNum & EVERY8TH)
+			|| !greenzone->isSavestateEmpty(lineNum & EVERY4TH)
+			|| !greenzone->isSavestateEmpty(lineNum & EVERY2ND))
+		{
+			// the frame is in a gap (in Greenzone tail)
+			if (frame_lag == LAGGED_YES)
+			{
+				blkColor = QColor( PALE_LAG_FRAMENUM_COLOR );
+			}
+			else
+			{
+				blkColor = QColor( PALE_GREENZONE_FRAMENUM_COLOR );
+			}
+		}
+		else 
+		{
+			// the frame is above Greenzone tail
+			if (frame_lag == LAGGED_YES)
+			{
+				blkColor = QColor( VERY_PALE_LAG_FRAMENUM_COLOR );
+			}
+			else if (frame_lag == LAGGED_NO)
+			{
+				blkColor = QColor( VERY_PALE_GREENZONE_FRAMENUM_COLOR );
+			}
+			else
+			{
+				blkColor = QColor( NORMAL_FRAMENUM_COLOR );
+			}
+		}
+	}
+	else
+	{
+		// the frame is below Greenzone head
+		if (frame_lag == LAGGED_YES)
+		{
+			blkColor = QColor( VERY_PALE_LAG_FRAMENUM_COLOR );
+		}
+		else if (frame_lag == LAGGED_NO)
+		{
+			blkColor = QColor( VERY_PALE_GREENZONE_FRAMENUM_COLOR );
+		}
+		else
+		{
+			blkColor = QColor( NORMAL_FRAMENUM_COLOR );
+		}
+	}
+	state.frameNumColor = blkColor.rgba();
+
+	// Input and Hot Changes
+	for (int i=0; i<numCtlr; i++)
+	{
+		state.joysticks[i] = currMovieData.records[ lineNum ].joysticks[i];
+
+		for (int j=0; j<8; j++)
+		{
+			if (taseditorConfig->enableHotChanges)
+			{
+				state.hotChanges[i*8+j] = history->getCurrentSnapshot().inputlog.getHotChangesInfo( lineNum, i*8+j );
+			}
+			else
+			{
+				state.hotChanges[i*8+j] = 0xFF;
+			}
+		}
+	}
+
+	// arrow and Bookmark
+	int iImage = bookmarks->findBookmarkAtFrame(lineNum);
+	if (iImage < 0)
+	{
+		// no bookmark at this frame
+		if (lineNum == playback->getLastPosition())
+		{
+			if (lineNum == currFrameCounter)
+			{
+				iImage = GREEN_BLUE_ARROW_IMAGE_ID;
+			}
+			else
+			{
+				iImage = GREEN_ARROW_IMAGE_ID;
+			}
+		}
+		else if (lineNum == currFrameCounter)
+		{
+			iImage = BLUE_ARROW_IMAGE_ID;
+		}
+	}
+	else
+	{
+		// bookmark at this frame
+		if (lineNum == playback->getLastPosition())
+		{
+			iImage |= BOOKMARKS_WITH_GREEN_ARROW;
+		}
+		else if (lineNum == currFrameCounter)
+		{
+			iImage |= BOOKMARKS_WITH_BLUE_ARROW;
+		}
+		else
+		{
+			iImage |= BOOKMARKS_WITH_NO_ARROW;
+		}
+	}
+	state.image = iImage;
+}
+//----------------------------------------------------------------------------
+void QPianoRoll::renderRow( QPixmap &pixmap, const rowState &state )
+{
+	static const char *buttonNames[] = { "A", "B", "S", "T", "U", "D", "L", "R", NULL };
+	int x;
+	char stmp[32];
+	QColor rowTextColor;
+	QRect rect;
+	qreal dpr = devicePixelRatioF();
+	QSize size( state.width, pxLineSpacing );
+
+	if ( pixmap.isNull() || (pixmap.size() != size * dpr) )
+	{
+		pixmap = QPixmap( size * dpr );
+	}
+	pixmap.setDevicePixelRatio( dpr );
+	pixmap.fill( this->palette().color(QPalette::Window) );
+
+	QPainter painter( &pixmap );
+
+	font.setBold(true);
+	font.setItalic(false);
+	painter.setFont(font);
+
+	for (int i=0; i<numCtlr; i++)
+	{
+		x = pxFrameCtlX[i] - pxLineXScroll;
+
+		painter.fillRect( x, 0, pxWidthCtlCol, pxLineSpacing, QColor( state.ctlrColor[i%2] ) );
+	}
+	x = -pxLineXScroll + pxFrameColX;
+
+	painter.fillRect( x, 0, pxWidthFrameCol, pxLineSpacing, QColor( state.frameNumColor ) );
+
+	// Selected Line
+	if ( state.selected )
+	{
+		painter.fillRect( 0, 0, state.width, pxLineSpacing, QColor( 10, 36, 106 ) );
+
+		rowTextColor = QColor( 255, 255, 255 );
+	}
+	else
+	{
+		rowTextColor = QColor( 0, 0, 0 );
+	}
+	painter.setPen( rowTextColor );
+
+	for (int i=0; i<numCtlr; i++)
+	{
+		uint8_t data = state.joysticks[i];
+
+		x = pxFrameCtlX[i] - pxLineXScroll;
+
+		for (int j=0; j<8; j++)
+		{
+			int hotChangeVal = state.hotChanges[i*8+j];
+
+			if ( hotChangeVal == 0xFF )
+			{
+				// Hot Changes are off
+				hotChangeVal = -1;
+			}
+			else if ( !state.selected && (hotChangeVal < 16) )
+			{
+				painter.setPen( hotChangesColors[hotChangeVal] );
+			}
+			else
+			{
+				painter.setPen( rowTextColor );
+			}
+
+			if ( data & (0x01 << j) )
+			{
+				painter.drawText( x + pxCharWidth, pxLineTextOfs, tr(buttonNames[j]) );
+			}
+			else if ( hotChangeVal > 0 )
+			{
+				painter.drawText( x + pxCharWidth, pxLineTextOfs, tr("-") );
+			}
+			x += pxWidthBtnCol;
+		}
+	}
+
+	// Frame number column
+	painter.setPen( rowTextColor );
+
+	snprintf( stmp, sizeof(stmp), "%07i", state.lineNum );
+
+	rect = painter.fontMetrics().boundingRect( tr(stmp) );
+
+	x = -pxLineXScroll + pxFrameColX + (pxWidthFrameCol - rect.width()) / 2;
+
+	if (state.marked)
+	{
+		font.setItalic(true);
+		font.setBold(false);
+		painter.setFont(font);
+	}
+	painter.drawText( x, pxLineTextOfs, tr(stmp) );
+
+	if ( font.italic() )
+	{
+		font.setBold(true);
+		font.setItalic(false);
+		painter.setFont(font);
+	}
+
+	if ( state.image >= 0 )
+	{
+		drawArrow( &painter, -pxLineXScroll, 0, state.image );
+	}
+}
+//----------------------------------------------------------------------------
+void QPianoRoll::drawRow( QPainter *painter, int lineNum, int y, bool rowIsSel )
+{
+	rowState state;
+
+	getRowState( lineNum, rowIsSel, state );
+
+	// a row is only drawn again when something in it changed, scrolling just moves the strips
+	rowStrip &strip = rowCache[lineNum];
+
+	if ( strip.pixmap.isNull() || memcmp( &strip.state, &state, sizeof(state) ) )
+	{
+		renderRow( strip.pixmap, state );
+		memcpy( &strip.state, &state, sizeof(state) );
+	}
+	painter->drawPixmap( 0, y, strip.pixmap );
+}
+//----------------------------------------------------------------------------
+void QPianoRoll::scheduleUpdate(void)
+{
+	// frames finish much more often than the display refreshes while seeking or at turbo speed,
+	// so the Piano Roll is repainted at most once per display refresh
+	uint64_t now = getTasEditorTime();
+
+	if ( now >= nextRepaintTime )
+	{
+		update();
+	}
+	else if ( !repaintTimer->isActive() )
+	{
+		repaintTimer->start( nextRepaintTime - now );
+	}
+}
+//----------------------------------------------------------------------------
 void QPianoRoll::paintEvent(QPaintEvent *event)
 {
 	FCEU_CRITICAL_SECTION( emuLock );
 	int x, y, row, nrow, lineNum;
 	QPainter painter(this);
-	QColor /*white(255,255,255),*/ black(0,0,0), blkColor, rowTextColor, hdrGridColor;
+	QColor /*white(255,255,255),*/ black(0,0,0), hdrGridColor;
 	static const char *buttonNames[] = { "A", "B", "S", "T", "U", "D", "L", "R", NULL };
-	char stmp[32];
 	char rowIsSel=0;
 	char rowSelArray[256];
 	int numSelRows=0;
@@ -6382,349 +6820,25 @@ void QPianoRoll::paintEvent(QPaintEvent *event)
 
 	for (row=0; row<nrow; row++)
 	{
-		uint8_t data;
-
 		lineNum = lineOffset + row;
 
 		if ( static_cast<size_t>(lineNum) >= currMovieData.records.size() )
 		{
 			break;
 		}
-		int frame_lag = greenzone->lagLog.getLagInfoAtFrame(lineNum);
-
 		rowSelArray[row] = rowIsSel = selection->isRowSelected( lineNum );
 
-		for (int i=0; i<numCtlr; i++)
-		{
-			x = pxFrameCtlX[i] - pxLineXScroll;
-
-			if ( lineNum == history->getUndoHint())
-			{
-				// undo hint here
-				blkColor = (i%2) ? QColor(UNDOHINT_INPUT_COLOR2) : QColor(UNDOHINT_INPUT_COLOR1);
-			}
-			else if ( lineNum == currFrameCounter ||  lineNum == (playback->getFlashingPauseFrame() - 1))
-			{
-				// this is current frame
-				blkColor = (i%2) ? QColor(CUR_INPUT_COLOR2) : QColor(CUR_INPUT_COLOR1);
-			}
-			else if ( lineNum < greenzone->getSize() )
-			{
-				if (!greenzone->isSavestateEmpty(lineNum))
-				{
-					// the frame is normal Greenzone frame
-					if (frame_lag == LAGGED_YES)
-					{
-						blkColor = (i%2) ? QColor(LAG_INPUT_COLOR2) : QColor(LAG_INPUT_COLOR1);
-					}
-					else
-					{
-						blkColor = (i%2) ? QColor(GREENZONE_INPUT_COLOR2) : QColor(GREENZONE_INPUT_COLOR1);
-					}
-				}
-				else if (  !greenzone->isSavestateEmpty(lineNum & EVERY16TH)
-					|| !greenzone->isSavestateEmpty(lineNum & EVERY8TH)
-					|| !greenzone->isSavestateEmpty(lineNum & EVERY4TH)
-					|| !greenzone->isSavestateEmpty(lineNum & EVERY2ND))
-				{
-					// the frame is in a gap (in Greenzone tail)
-					if (frame_lag == LAGGED_YES)
-					{
-						blkColor = (i%2) ? QColor(PALE_LAG_INPUT_COLOR2) : QColor(PALE_LAG_INPUT_COLOR1);
-					}
-					else
-					{
-						blkColor = (i%2) ? QColor(PALE_GREENZONE_INPUT_COLOR2) : QColor(PALE_GREENZONE_INPUT_COLOR1);
-					}
-				}
-				else 
-				{
-					// the frame is above Greenzone tail
-					if (frame_lag == LAGGED_YES)
-					{
-						blkColor = (i%2) ? QColor(VERY_PALE_LAG_INPUT_COLOR2) : QColor(VERY_PALE_LAG_INPUT_COLOR1);
-					}
-					else if (frame_lag == LAGGED_NO)
-					{
-						blkColor = (i%2) ? QColor(VERY_PALE_GREENZONE_INPUT_COLOR2) : QColor(VERY_PALE_GREENZONE_INPUT_COLOR1);
-					}
-					else
-					{
-						blkColor = (i%2) ? QColor(NORMAL_INPUT_COLOR2) : QColor(NORMAL_INPUT_COLOR1);
-					}
-				}
-			}
-			else
-			{
-				// the frame is below Greenzone head
-				if (frame_lag == LAGGED_YES)
-				{
-					blkColor = (i%2) ? QColor(VERY_PALE_LAG_INPUT_COLOR2) : QColor(VERY_PALE_LAG_INPUT_COLOR1);
-				}
-				else if (frame_lag == LAGGED_NO)
-				{
-					blkColor = (i%2) ? QColor(VERY_PALE_GREENZONE_INPUT_COLOR2) : QColor(VERY_PALE_GREENZONE_INPUT_COLOR1);
-				}
-				else
-				{
-					blkColor = (i%2) ? QColor(NORMAL_INPUT_COLOR2) : QColor(NORMAL_INPUT_COLOR1);
-				}
-			}
-			painter.fillRect( x, y, pxWidthCtlCol, pxLineSpacing, blkColor );
-		}
-
-		// Frame number column
-		// font
-		//if (markersManager.getMarkerAtFrame(lineNum))
-		//	SelectObject(msg->nmcd.hdc, hMainListSelectFont);
-		//else
-		//	SelectObject(msg->nmcd.hdc, hMainListFont);
-		// bg
-		// frame number
-		if (lineNum == history->getUndoHint())
-		{
-			// undo hint here
-			if (markersManager->getMarkerAtFrame(lineNum) && (dragMode != DRAG_MODE_MARKER || markerDragFrameNumber != lineNum))
-			{
-				blkColor = (taseditorConfig->bindMarkersToInput) ? QColor( BINDMARKED_UNDOHINT_FRAMENUM_COLOR ) : QColor( MARKED_UNDOHINT_FRAMENUM_COLOR );
-			}
-			else
-			{
-				blkColor = QColor( UNDOHINT_FRAMENUM_COLOR );
-			}
-		}
-		else if (lineNum == currFrameCounter || lineNum == (playback->getFlashingPauseFrame() - 1))
-		{
-			// this is current frame
-			if (markersManager->getMarkerAtFrame(lineNum) && (dragMode != DRAG_MODE_MARKER || markerDragFrameNumber != lineNum))
-			{
-				blkColor = (taseditorConfig->bindMarkersToInput) ? QColor( CUR_BINDMARKED_FRAMENUM_COLOR ) : QColor( CUR_MARKED_FRAMENUM_COLOR );
-			}
-			else
-			{
-				blkColor = QColor( CUR_FRAMENUM_COLOR );
-			}
-		}
-		else if (markersManager->getMarkerAtFrame(lineNum) && (dragMode != DRAG_MODE_MARKER || markerDragFrameNumber != lineNum))
-		{
-			// this is marked frame
-			blkColor = (taseditorConfig->bindMarkersToInput) ? QColor( BINDMARKED_FRAMENUM_COLOR ) : QColor( MARKED_FRAMENUM_COLOR );
-		}
-		else if (lineNum < greenzone->getSize())
-		{
-			if (!greenzone->isSavestateEmpty(lineNum))
-			{
-				// the frame is normal Greenzone frame
-				if (frame_lag == LAGGED_YES)
-				{
-					blkColor = QColor( LAG_FRAMENUM_COLOR );
-				}
-				else
-				{
-					blkColor = QColor( GREENZONE_FRAMENUM_COLOR );
-				}
-			}
-			else if (!greenzone->isSavestateEmpty(lineNum & EVERY16TH)
-				|| !greenzone->isSavestateEmpty(lineNum & EVERY8TH)
-				|| !greenzone->isSavestateEmpty(lineNum & EVERY4TH)
-				|| !greenzone->isSavestateEmpty(lineNum & EVERY2ND))
-			{
-				// the frame is in a gap (in Greenzone tail)
-				if (frame_lag == LAGGED_YES)
-				{
-					blkColor = QColor( PALE_LAG_FRAMENUM_COLOR );
-				}
-				else
-				{
-					blkColor = QColor( PALE_GREENZONE_FRAMENUM_COLOR );
-				}
-			}
-			else 
-			{
-				// the frame is above Greenzone tail
-				if (frame_lag == LAGGED_YES)
-				{
-					blkColor = QColor( VERY_PALE_LAG_FRAMENUM_COLOR );
-				}
-				else if (frame_lag == LAGGED_NO)
-				{
-					blkColor = QColor( VERY_PALE_GREENZONE_FRAMENUM_COLOR );
-				}
-				else
-				{
-					blkColor = QColor( NORMAL_FRAMENUM_COLOR );
-				}
-			}
-		}
-		else
-		{
-			// the frame is below Greenzone head
-			if (frame_lag == LAGGED_YES)
-			{
-				blkColor = QColor( VERY_PALE_LAG_FRAMENUM_COLOR );
-			}
-			else if (frame_lag == LAGGED_NO)
-			{
-				blkColor = QColor( VERY_PALE_GREENZONE_FRAMENUM_COLOR );
-			}
-			else
-			{
-				blkColor = QColor( NORMAL_FRAMENUM_COLOR );
-			}
-		}
-		x = -pxLineXScroll + pxFrameColX;
-
-		painter.fillRect( x, y, pxWidthFrameCol, pxLineSpacing, blkColor );
-
-		// Selected Line
 		if ( rowIsSel )
 		{
-			painter.fillRect( 0, y, viewWidth, pxLineSpacing, QColor( 10, 36, 106 ) );
-
-			rowTextColor = QColor( 255, 255, 255 );
-
 			numSelRows++;
 		}
-		else
-		{
-			rowTextColor = QColor( 0, 0, 0 );
-		}
-		painter.setPen( rowTextColor );
-
-		for (int i=0; i<numCtlr; i++)
-		{
-			int ctlrOfs, btnOfs, hotChangeVal;
-			data = currMovieData.records[ lineNum ].joysticks[i];
-
-			x = pxFrameCtlX[i] - pxLineXScroll;
-
-			ctlrOfs = i*8;
-
-			for (int j=0; j<8; j++)
-			{
-				btnOfs = ctlrOfs+j;
-
-				if (taseditorConfig->enableHotChanges)
-				{
-					hotChangeVal = history->getCurrentSnapshot().inputlog.getHotChangesInfo( lineNum, btnOfs );
-
-					if ( !rowIsSel && (hotChangeVal >= 0) && (hotChangeVal < 16) )
-					{
-						painter.setPen( hotChangesColors[hotChangeVal] );
-					}
-					else
-					{
-						painter.setPen( rowTextColor );
-					}
-				}
-				else
-				{
-					hotChangeVal = -1;
-				}
-				rect = QRect( x, y, pxWidthBtnCol, pxLineSpacing );
-
-				if ( data & (0x01 << j) )
-				{
-					painter.drawText( x + pxCharWidth, y+pxLineTextOfs, tr(buttonNames[j]) );
-					//painter.drawText( rect, Qt::AlignCenter, tr(buttonNames[j]) );
-					//painter.drawText( rect, Qt::AlignHCenter | Qt::AlignBottom, tr(buttonNames[j]) );
-				}
-				else if ( hotChangeVal > 0 )
-				{
-					painter.drawText( x + pxCharWidth, y+pxLineTextOfs, tr("-") );
-					//painter.drawText( rect, Qt::AlignCenter, tr("-") );
-					//painter.drawText( rect, Qt::AlignHCenter | Qt::AlignBottom, tr("-") );
-				}
-				x += pxWidthBtnCol;
-			}
-			//painter.drawLine( x, y, x, pxLineSpacing );
-		}
-
-		// Frame number column
-		// font
-		//if (markersManager.getMarkerAtFrame(lineNum))
-		//	SelectObject(msg->nmcd.hdc, hMainListSelectFont);
-		//else
-		//	SelectObject(msg->nmcd.hdc, hMainListFont);
-		// bg
-		painter.setPen( rowTextColor );
-
-		//rect = QRect( -pxLineXScroll + pxFrameColX, y, pxWidthFrameCol, pxLineSpacing );
-
-		snprintf( stmp, sizeof(stmp), "%07i", lineNum );
-
-		rect = painter.fontMetrics().boundingRect( tr(stmp) );
-
-		x = -pxLineXScroll + pxFrameColX + (pxWidthFrameCol - rect.width()) / 2;
-
-		if (markersManager->getMarkerAtFrame(lineNum))
-		{
-			font.setItalic(true);
-			font.setBold(false);
-		}
-		else
-		{
-			font.setBold(true);
-			font.setItalic(false);
-		}
-		painter.setFont(font);
-		painter.drawText( x, y+pxLineTextOfs, tr(stmp) );
-		//painter.drawText( rect, Qt::AlignCenter, tr(stmp) );
-		//painter.drawText( rect, Qt::AlignHCenter | Qt::AlignBottom, tr(stmp) );
-
-		if ( font.italic() )
-		{
-			font.setBold(true);
-			font.setItalic(false);
-			painter.setFont(font);
-		}
-
-		x = -pxLineXScroll;
-
-		int iImage = bookmarks->findBookmarkAtFrame(lineNum);
-		if (iImage < 0)
-		{
-			// no bookmark at this frame
-			if (lineNum == playback->getLastPosition())
-			{
-				if (lineNum == currFrameCounter)
-				{
-					iImage = GREEN_BLUE_ARROW_IMAGE_ID;
-				}
-				else
-				{
-					iImage = GREEN_ARROW_IMAGE_ID;
-				}
-			}
-			else if (lineNum == currFrameCounter)
-			{
-				iImage = BLUE_ARROW_IMAGE_ID;
-			}
-		}
-		else
-		{
-			// bookmark at this frame
-			if (lineNum == playback->getLastPosition())
-			{
-				iImage |= BOOKMARKS_WITH_GREEN_ARROW;
-			}
-			else if (lineNum == currFrameCounter)
-			{
-				iImage |= BOOKMARKS_WITH_BLUE_ARROW;
-			}
-			else
-			{
-				iImage |= BOOKMARKS_WITH_NO_ARROW;
-			}
-		}
-
-		if ( iImage >= 0 )
-		{
-			drawArrow( &painter, x, y, iImage );
-		}
+		drawRow( &painter, lineNum, y, rowIsSel );
 
 		y += pxLineSpacing;
 	}
+	// forget the rows that went far out of view
+	rowCache.erase( rowCache.begin(), rowCache.lower_bound( lineOffset - nrow ) );
+	rowCache.erase( rowCache.upper_bound( lineOffset + 2*nrow ), rowCache.end() );
 
 	int gridBlack = gridColor.black();
 	hdrGridColor = gridColor;
@@ -6844,6 +6958,15 @@ void QPianoRoll::paintEvent(QPaintEvent *event)
 
 	font.setBold(false);
 	painter.setFont(font);
+
+	QScreen *screen = QGuiApplication::primaryScreen();
+	qreal refreshRate = screen ? screen->refreshRate() : 60.0;
+
+	if ( refreshRate < 1.0 )
+	{
+		refreshRate = 60.0;
+	}
+	nextRepaintTime = getTasEditorTime() + (uint64_t)(1000.0 / refreshRate);
 }
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
@@ -7044,9 +7167,7 @@ int bookmarkPreviewPopup::loadImage(int index)
 {
 	// uncompress
 	int ret = 0;
-	uLongf destlen = SCREENSHOT_SIZE;
-	int e = uncompress(screenShotRaster, &destlen, &bookmarks->bookmarksArray[index].savedScreenshot[0], bookmarks->bookmarksArray[index].savedScreenshot.size());
-	if (e != Z_OK && e != Z_BUF_ERROR)
+	if (!bookmarks->bookmarksArray[index].getScreenshot(screenShotRaster))
 	{
 		// error decompressing
 		FCEU_printf("Error decompressing screenshot %d\n", index);
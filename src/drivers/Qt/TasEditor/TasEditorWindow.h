@@ -33,6 +33,8 @@
 #include <QAction>
 #include <QFont>
 #include <QPainter>
+#include <QPixmap>
+#include <QTimer>
 #include <QShortcut>
 #include <QTabWidget>
 #include <QProgressBar>
@@ -212,6 +214,7 @@ class QPianoRoll : public QWidget
 		void  followUndoHint(void);
 		void  setLightInHeaderColumn(int column, int level);
 		void  periodicUpdate(void);
+		void  scheduleUpdate(void);
 
 		void  setFont( QFont &font );
 
@@ -242,7 +245,30 @@ class QPianoRoll : public QWidget
 		void finishDrag(void);
 		void updateDrag(void);
 
+		// everything that is drawn in one row, rows that look the same are not drawn again
+		struct rowState
+		{
+			int      lineNum;
+			int      xScroll;
+			int      width;
+			int      image;			// arrow/Bookmark image, -1 = none
+			QRgb     ctlrColor[2];		// even and odd joypad columns
+			QRgb     frameNumColor;
+			uint8_t  joysticks[4];
+			uint8_t  hotChanges[4 * 8];	// 0xFF when Hot Changes are off
+			uint8_t  selected;
+			uint8_t  marked;
+		};
+		struct rowStrip
+		{
+			rowState state;
+			QPixmap  pixmap;
+		};
+
 		void drawArrow( QPainter *painter, int xl, int yl, int value );
+		void drawRow( QPainter *painter, int lineNum, int y, bool rowIsSel );
+		void getRowState( int lineNum, bool rowIsSel, rowState &state );
+		void renderRow( QPixmap &pixmap, const rowState &state );
 
 		int    calcColumn( int px );
 		QPoint convPixToCursor( QPoint p );
@@ -305,6 +331,10 @@ class QPianoRoll : public QWidget
 
 		int playbackCursorPos;
 
+		std::map <int, rowStrip> rowCache;	// pre-rendered visible rows by frame
+		QTimer   *repaintTimer;
+		uint64_t  nextRepaintTime;
+
 		bool useDarkTheme;
 		bool rightButtonDragMode;
 
@@ -609,6 +639,7 @@ class TasEditorWindow : public QDialog
 		void playbackTurboSeekCb(bool);
 		void openProjectSaveOptions(void);
 		void setGreenzoneCapacity(void);
+		void setGreenzoneSpillCapacity(void);
 		void setMaxUndoCapacity(void);
 		void setCurrentPattern(int);
 		void tabViewChanged(int);
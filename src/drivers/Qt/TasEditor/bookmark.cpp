@@ -16,6 +16,11 @@ Bookmark - Single Bookmark data
 ------------------------------------------------------------------------------------ */
 
 #include <zlib.h>
+#include <string.h>
+
+#include <deque>
+#include <thread>
+#include <condition_variable>
 
 #include "Qt/TasEditor/taseditor_project.h"
 #include "Qt/TasEditor/TasEditorWindow.h"
@@ -23,6 +28,55 @@ Bookmark - Single Bookmark data
 extern uint8 *XBuf;
 extern uint8 *XBackBuf;
 
+static std::mutex screenshotQueueLock;
+static std::condition_variable screenshotQueueCond;
+static std::deque< std::shared_ptr<BOOKMARK_SCREENSHOT> > screenshotQueue;
+static std::thread *screenshotCompressor = NULL;
+static bool screenshotCompressorQuit = false;
+
+// the caller holds shot->lock
+static void compressScreenshot(BOOKMARK_SCREENSHOT *shot)
+{
+	if (shot->raw.empty())
+		return;
+	uLongf comprlen = (SCREENSHOT_SIZE>>9)+12 + SCREENSHOT_SIZE;
+	shot->compressed.resize(comprlen);
+	if (compress(&shot->compressed[0], &comprlen, &shot->raw[0], SCREENSHOT_SIZE) != Z_OK)
+	{
+		// keep the picture as it is
+		shot->compressed.clear();
+		return;
+	}
+	shot->compressed.resize(comprlen);
+	std::vector<uint8_t>().swap(shot->raw);
+}
+
+static void screenshotCompressorLoop()
+{
+	std::unique_lock<std::mutex> lock(screenshotQueueLock);
+
+	for (;;)
+	{
+		if (screenshotQueue.empty())
+		{
+			if (screenshotCompressorQuit)
+				break;
+			screenshotQueueCond.wait(lock);
+			continue;
+		}
+		std::shared_ptr<BOOKMARK_SCREENSHOT> shot = screenshotQueue.front();
+		screenshotQueue.pop_front();
+
+		lock.unlock();
+		{
+			std::lock_guard<std::mutex> shotLock(shot->lock);
+			compressScreenshot(shot.get());
+		}
+		shot.reset();
+		lock.lock();
+	}
+}
+
 BOOKMARK::BOOKMARK()
 {
 	notEmpty = false;
@@ -40,7 +94,7 @@ void BOOKMARK::free()
 	SNAPSHOT tmp;
 	snapshot = tmp;
 	savestate.resize(0);
-	savedScreenshot.resize(0);
+	savedScreenshot.reset();
 }
 
 bool BOOKMARK::isDifferentFromCurrentMovie()
@@ -65,21 +119,27 @@ bool BOOKMARK::isDifferentFromCurrentMovie()
 void BOOKMARK::set()
 {
 	// copy Input and Hotchanges
-	snapshot.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges);
+	snapshot.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges, -1, &history->getCurrentSnapshot());
 	snapshot.keyFrame = currFrameCounter;
 	if (taseditorConfig->enableHotChanges)
 		snapshot.inputlog.copyHotChanges(&history->getCurrentSnapshot().inputlog);
 	// copy savestate
 	savestate = greenzone->getSavestateOfFrame(currFrameCounter);
-	// save screenshot
-	uLongf comprlen = (SCREENSHOT_SIZE>>9)+12 + SCREENSHOT_SIZE;
-	savedScreenshot.resize(comprlen);
-	// compress screenshot data
-	if (taseditorConfig->HUDInBranchScreenshots)
-		compress(&savedScreenshot[0], &comprlen, XBuf, SCREENSHOT_SIZE);
-	else
-		compress(&savedScreenshot[0], &comprlen, XBackBuf, SCREENSHOT_SIZE);
-	savedScreenshot.resize(comprlen);
+	// save screenshot, the compressor thread packs it
+	uint8 *pixels = taseditorConfig->HUDInBranchScreenshots ? XBuf : XBackBuf;
+	std::shared_ptr<BOOKMARK_SCREENSHOT> shot = std::make_shared<BOOKMARK_SCREENSHOT>();
+	shot->raw.assign(pixels, pixels + SCREENSHOT_SIZE);
+	savedScreenshot = shot;
+	{
+		std::lock_guard<std::mutex> lock(screenshotQueueLock);
+		if (!screenshotCompressor)
+		{
+			screenshotCompressorQuit = false;
+			screenshotCompressor = new std::thread(screenshotCompressorLoop);
+		}
+		screenshotQueue.push_back(shot);
+		screenshotQueueCond.notify_all();
+	}
 
 	notEmpty = true;
 	flashPhase = FLASH_PHASE_MAX;
@@ -109,10 +169,16 @@ void BOOKMARK::save(EMUFILE *os)
 		int size = savestate.size();
 		write32le(size, os);
 		os->fwrite(&savestate[0], size);
-		// write saved_screenshot
-		size = savedScreenshot.size();
-		write32le(size, os);
-		os->fwrite(&savedScreenshot[0], size);
+		// write saved_screenshot, packing it here if the compressor hasn't yet
+		if (savedScreenshot)
+		{
+			std::lock_guard<std::mutex> lock(savedScreenshot->lock);
+			compressScreenshot(savedScreenshot.get());
+			size = savedScreenshot->compressed.size();
+			write32le(size, os);
+			if (size)
+				os->fwrite(&savedScreenshot->compressed[0], size);
+		} else write32le((uint32)0, os);
 	} else write8le((uint8)0, os);
 }
 // returns true if couldn't load
@@ -132,8 +198,9 @@ bool BOOKMARK::load(EMUFILE *is)
 		if ((int)is->fread(&savestate[0], size) < size) return true;
 		// read saved_screenshot
 		if (!read32le(&size, is)) return true;
-		savedScreenshot.resize(size);
-		if ((int)is->fread(&savedScreenshot[0], size) < size) return true;
+		savedScreenshot = std::make_shared<BOOKMARK_SCREENSHOT>();
+		savedScreenshot->compressed.resize(size);
+		if (size && (int)is->fread(&savedScreenshot->compressed[0], size) < size) return true;
 	} else
 	{
 		free();
@@ -142,6 +209,38 @@ bool BOOKMARK::load(EMUFILE *is)
 	flashType = flashPhase = floatingPhase = 0;
 	return false;
 }
+bool BOOKMARK::getScreenshot(uint8_t *pixels)
+{
+	if (!savedScreenshot)
+		return false;
+	std::lock_guard<std::mutex> lock(savedScreenshot->lock);
+	if (!savedScreenshot->raw.empty())
+	{
+		memcpy(pixels, &savedScreenshot->raw[0], SCREENSHOT_SIZE);
+		return true;
+	}
+	if (savedScreenshot->compressed.empty())
+		return false;
+	uLongf destlen = SCREENSHOT_SIZE;
+	int e = uncompress(pixels, &destlen, &savedScreenshot->compressed[0], savedScreenshot->compressed.size());
+	return (e == Z_OK || e == Z_BUF_ERROR);
+}
+
+// lets the compressor finish the screenshots it has and end
+void BOOKMARK::stopScreenshotCompression()
+{
+	{
+		std::lock_guard<std::mutex> lock(screenshotQueueLock);
+		if (!screenshotCompressor)
+			return;
+		screenshotCompressorQuit = true;
+		screenshotQueueCond.notify_all();
+	}
+	screenshotCompressor->join();
+	delete screenshotCompressor;
+	screenshotCompressor = NULL;
+}
+
 bool BOOKMARK::skipLoad(EMUFILE *is)
 {
 	uint8 tmp;
@@ -2,6 +2,8 @@
 #pragma once
 #include <stdint.h>
 #include <vector>
+#include <memory>
+#include <mutex>
 
 #include "Qt/TasEditor/snapshot.h"
 
@@ -19,6 +21,16 @@ enum FLASH_TYPES
 #define SCREENSHOT_HEIGHT 240
 #define SCREENSHOT_SIZE SCREENSHOT_WIDTH * SCREENSHOT_HEIGHT
 
+// The indexed picture of a Bookmark. It is compressed by a background thread, so
+// setting a Bookmark only copies the frame, and copies of the Bookmark (History
+// backups) share it.
+struct BOOKMARK_SCREENSHOT
+{
+	std::mutex lock;
+	std::vector<uint8_t> raw;			// SCREENSHOT_SIZE pixels until compressed
+	std::vector<uint8_t> compressed;
+};
+
 class BOOKMARK
 {
 public:
@@ -36,11 +48,16 @@ public:
 	bool load(EMUFILE *is);
 	bool skipLoad(EMUFILE *is);
 
+	// fills SCREENSHOT_SIZE indexed pixels, false when there is no screenshot
+	bool getScreenshot(uint8_t *pixels);
+
+	static void stopScreenshotCompression();
+
 	// saved vars
 	bool notEmpty;
 	SNAPSHOT snapshot;
 	std::vector<uint8_t> savestate;
-	std::vector<uint8_t> savedScreenshot;
+	std::shared_ptr<BOOKMARK_SCREENSHOT> savedScreenshot;
 
 	// not saved vars
 	int flashPhase;
@@ -17,21 +17,39 @@ Branches - Manager of Branches
 * implements the working of Branches Tree: creating, recalculating relations, animating, redrawing, mouseover, clicks
 * on demand: reacts on Bookmarks/current Movie changes and recalculates the Branches Tree
 * regularly updates animations in Branches Tree and calculates Playback cursor position on the Tree
+* on demand: (from Lua) replays all Branches to a given frame and reports memory values there, every Branch in its own worker process where the platform can fork
 * stores resources: coordinates for building Branches Tree, animation timings
 ------------------------------------------------------------------------------------ */
 
+#include <errno.h>
 #include <math.h>
+#include <string.h>
 #include <zlib.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define  BRANCHES_FORK_WORKERS
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
 #include <QToolTip>
 #include <QFontMetrics>
 
+#include "fceu.h"
+#include "cheat.h"
+#include "state.h"
+#include "driver.h"
+#include "video.h"
+#include "context.h"
 #include "utils/xstring.h"
 #include "Qt/fceuWrapper.h"
 #include "Qt/TasEditor/taseditor_project.h"
 #include "Qt/TasEditor/TasEditorWindow.h"
 
 
+extern char lagFlag;
+extern uint32 cur_input_display;
+
 //extern COLORREF bookmark_flash_colors[TOTAL_BOOKMARK_COMMANDS][FLASH_PHASE_MAX+1];
 
 // resources
@@ -1287,6 +1305,144 @@ int BRANCHES::findFullTimelineForBranch(int branchNumber)
 	return cachedTimelines[branchNumber];
 }
 
+// emulates the Bookmark from its keyframe to "targetFrame" on the active console and reads "addresses" there
+// the console is left at the target frame and currMovieData.records holds the Input of the Bookmark
+static bool replayBranch(BOOKMARK& bookmark, int targetFrame, const std::vector<int>& addresses, std::vector<uint8_t>& values)
+{
+	EMUFILE_MEMORY state(&bookmark.savestate);
+	if (!FCEUSS_LoadFP(&state, SSLOADPARAM_NOBACKUP))
+		return false;
+	currFrameCounter = bookmark.snapshot.keyFrame;
+	bookmark.snapshot.inputlog.toMovie(currMovieData);
+	while (currFrameCounter < targetFrame)
+		FCEUI_EmulateOffscreen();
+	values.resize(addresses.size());
+	for (int i = 0; i < (int)addresses.size(); ++i)
+		values[i] = FCEU_CheatGetByte(addresses[i] & 0xFFFF);
+	return true;
+}
+
+#ifdef BRANCHES_FORK_WORKERS
+// starts one forked copy of the emulator per Branch, so that they all run at the same time
+// the slots whose worker couldn't be started are left in "slots"
+static void evaluateInWorkers(std::vector<int>& slots, int targetFrame, const std::vector<int>& addresses, std::vector<BRANCH_OUTCOME>& outcomes)
+{
+	std::vector<pid_t> pids(slots.size(), -1);
+	std::vector<int> pipes(slots.size(), -1);
+	for (int i = 0; i < (int)slots.size(); ++i)
+	{
+		int fd[2];
+		if (pipe(fd) != 0)
+			break;
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			// the worker owns a copy of the whole process, it only has to send the values back
+			close(fd[0]);
+			std::vector<uint8_t> values;
+			if (!replayBranch(bookmarks->bookmarksArray[slots[i]], targetFrame, addresses, values))
+				_exit(1);
+			size_t done = 0;
+			while (done < values.size())
+			{
+				ssize_t n = write(fd[1], &values[done], values.size() - done);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0)
+					_exit(1);
+				done += n;
+			}
+			_exit(0);
+		}
+		close(fd[1]);
+		if (pid < 0)
+		{
+			close(fd[0]);
+			break;
+		}
+		pids[i] = pid;
+		pipes[i] = fd[0];
+	}
+	// collect the results in order, the workers keep running meanwhile
+	std::vector<int> notStarted;
+	for (int i = 0; i < (int)slots.size(); ++i)
+	{
+		if (pids[i] < 0)
+		{
+			notStarted.push_back(slots[i]);
+			continue;
+		}
+		BRANCH_OUTCOME& outcome = outcomes[slots[i]];
+		outcome.values.resize(addresses.size());
+		size_t done = 0;
+		while (done < outcome.values.size())
+		{
+			ssize_t n = read(pipes[i], &outcome.values[done], outcome.values.size() - done);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break;
+			done += n;
+		}
+		close(pipes[i]);
+		int status = 0;
+		while (waitpid(pids[i], &status, 0) < 0 && errno == EINTR) {}
+		outcome.reached = (done == outcome.values.size() && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+		if (!outcome.reached)
+			outcome.values.clear();
+	}
+	slots.swap(notStarted);
+}
+#endif
+
+// replays every Branch from its keyframe to "targetFrame" and reads "addresses" of CPU memory there, the current movie, Greenzone and Playback stay untouched
+// where the platform can fork, the Branches run in parallel in worker processes, otherwise they are replayed one after another on the core
+void BRANCHES::evaluate(int targetFrame, const std::vector<int>& addresses, std::vector<BRANCH_OUTCOME>& outcomes)
+{
+	outcomes.assign(TOTAL_BOOKMARKS, BRANCH_OUTCOME());
+	std::vector<int> slots;
+	for (int i = 0; i < TOTAL_BOOKMARKS; ++i)
+	{
+		outcomes[i].reached = false;
+		if (bookmarks->bookmarksArray[i].notEmpty && bookmarks->bookmarksArray[i].snapshot.keyFrame <= targetFrame)
+			slots.push_back(i);
+	}
+	// Recording would write the replayed Input into the project
+	if (slots.empty() || isTaseditorRecording())
+		return;
+
+#ifdef BRANCHES_FORK_WORKERS
+	evaluateInWorkers(slots, targetFrame, addresses, outcomes);
+	if (slots.empty())
+		return;
+#endif
+
+	// park the visible console and the movie Input, the Branches are replayed on the same core
+	FCEU::Context playbackContext;
+	if (!playbackContext.capture())
+		return;
+	char savedLagFlag = lagFlag;
+	uint32 savedInputDisplay = cur_input_display;
+	std::vector<uint8_t> savedDeemph(XDBuf, XDBuf + 256 * 256);
+	std::vector<MovieRecord> savedRecords;
+	savedRecords.swap(currMovieData.records);
+
+	for (int i = 0; i < (int)slots.size(); ++i)
+	{
+		BRANCH_OUTCOME& outcome = outcomes[slots[i]];
+		outcome.reached = replayBranch(bookmarks->bookmarksArray[slots[i]], targetFrame, addresses, outcome.values);
+		if (!outcome.reached)
+			outcome.values.clear();
+	}
+
+	currMovieData.records.swap(savedRecords);
+	if (!playbackContext.activate())
+		playback->jump(playbackContext.frameCount(), true, false, false);
+	memcpy(XDBuf, &savedDeemph[0], 256 * 256);
+	cur_input_display = savedInputDisplay;
+	lagFlag = savedLagFlag;
+}
+
 void BRANCHES::setChangesMadeSinceBranch()
 {
 	bool oldStateOfChangesSinceCurrentBranch = changesSinceCurrentBranch;
@@ -104,6 +104,13 @@
 
 #define FIRST_DIFFERENCE_UNKNOWN -2
 
+// result of replaying one Branch to a target frame, see BRANCHES::evaluate()
+struct BRANCH_OUTCOME
+{
+	bool reached;						// false if the Bookmark is empty, starts after the target frame or couldn't be replayed
+	std::vector<uint8_t> values;		// one byte per requested address, read at the target frame
+};
+
 class BRANCHES : public QWidget
 {
 	Q_OBJECT
@@ -138,6 +145,8 @@ public:
 	void invalidateRelationsOfBranchSlot(int slot);
 	int findFullTimelineForBranch(int branchNumber);
 
+	void evaluate(int targetFrame, const std::vector<int>& addresses, std::vector<BRANCH_OUTCOME>& outcomes);
+
 	int findItemUnderMouse(int mouseX, int mouseY);
 
 	// not saved vars
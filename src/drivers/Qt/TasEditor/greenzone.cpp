@@ -15,27 +15,116 @@ Greenzone - Access zone
 * saves and loads the data from a project file. On error: truncates Greenzone to last successfully read savestate
 * regularly checks if there's a savestate of current emulation state, if there's no such savestate in array then creates one and updates lag info for previous frame
 * implements the working of "Auto-adjust Input according to lag" feature
-* regularly runs gradual cleaning of the savestates array (for memory saving), deleting oldest savestates
+* keeps savestates uncompressed in a page-deduplicating store (see greenzone_store.cpp); they are compressed only when written to the project file, in batches on all cores
+* in the project file most savestates are stored as the compressed XOR against the previously saved one, with a whole savestate every GREENZONE_KEYFRAME_INTERVAL
+* regularly runs cleaning of the savestates array (for memory saving), spilling least recently used savestates to a disk file once the memory limit is exceeded, and deleting them once that is full too
+* brings spilled savestates around the Playback cursor back into memory a few at a time, while the memory limit allows
+* while emulation is paused, regenerates savestates ahead of the Playback cursor in short slices (Greenzone lookahead), within the memory limit
 * on demand: (when movie Input was changed) truncates the size of Greenzone, deleting savestates that became irrelevant because of new Input. After truncating it may also move Playback cursor (which must always reside within Greenzone) and may launch Playback seeking
-* stores resources: save id, properties of gradual cleaning, timing of cleaning
+* stores resources: save id, timing of cleaning
 ------------------------------------------------------------------------------------ */
 
+#include <chrono>
 #include <zlib.h>
 
 #include "fceu.h"
 #include "state.h"
 #include "driver.h"
+#include "video.h"
+#include "utils/endian.h"
+#include "utils/parallel.h"
 #include "Qt/TasEditor/taseditor_project.h"
 #include "Qt/TasEditor/TasEditorWindow.h"
 
 extern char lagFlag;
+extern uint32 cur_input_display;
 
 static char greenzone_save_id[GREENZONE_ID_LEN] = "GREENZONE";
 static char greenzone_skipsave_id[GREENZONE_ID_LEN] = "GREENZONX";
+static char greenzone_delta_save_id[GREENZONE_ID_LEN] = "GREENZOND";
+
+#define SAVESTATE_HEADER_SIZE 16
+#define SAVESTATE_UNCOMPRESSED (~0u)
+
+// savestates in project files are zlib-compressed, in memory they are not (so that pages can be shared between frames)
+static bool inflateSavestate(const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+{
+	if (in.size() < SAVESTATE_HEADER_SIZE || memcmp(&in[0], "FCSX", 4))
+		return false;
+	uint32_t totalsize = FCEU_de32lsb((uint8 *)&in[4]);
+	uint32_t comprlen = FCEU_de32lsb((uint8 *)&in[12]);
+	if (comprlen == SAVESTATE_UNCOMPRESSED)
+	{
+		if (in.size() < SAVESTATE_HEADER_SIZE + totalsize)
+			return false;
+		out.assign(in.begin(), in.begin() + SAVESTATE_HEADER_SIZE + totalsize);
+		return true;
+	}
+	if (in.size() < SAVESTATE_HEADER_SIZE + comprlen)
+		return false;
+	out.resize(SAVESTATE_HEADER_SIZE + totalsize);
+	memcpy(&out[0], &in[0], SAVESTATE_HEADER_SIZE);
+	FCEU_en32lsb(&out[12], SAVESTATE_UNCOMPRESSED);
+	uLongf uncomprlen = totalsize;
+	return uncompress(&out[SAVESTATE_HEADER_SIZE], &uncomprlen, &in[SAVESTATE_HEADER_SIZE], comprlen) == Z_OK && uncomprlen == totalsize;
+}
+static void deflateSavestate(const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+{
+	uint32_t totalsize = in.size() - SAVESTATE_HEADER_SIZE;
+	uLongf comprlen = compressBound(totalsize);
+	out.resize(SAVESTATE_HEADER_SIZE + comprlen);
+	memcpy(&out[0], &in[0], SAVESTATE_HEADER_SIZE);
+	if (compress2(&out[SAVESTATE_HEADER_SIZE], &comprlen, &in[SAVESTATE_HEADER_SIZE], totalsize, Z_DEFAULT_COMPRESSION) == Z_OK)
+	{
+		FCEU_en32lsb(&out[12], comprlen);
+		out.resize(SAVESTATE_HEADER_SIZE + comprlen);
+	} else
+	{
+		out = in;
+	}
+}
+
+// delta savestates: "FCSD", size of the whole savestate, 0, size of the compressed XOR against the previous savestate of the file
+static bool isDeltaSavestate(const std::vector<uint8_t>& in)
+{
+	return in.size() >= SAVESTATE_HEADER_SIZE && !memcmp(&in[0], "FCSD", 4);
+}
+static void deflateDelta(const std::vector<uint8_t>& in, const std::vector<uint8_t>& base, std::vector<uint8_t>& out, std::vector<uint8_t>& diff)
+{
+	uint32_t totalsize = in.size();
+	diff.resize(totalsize);
+	for (uint32_t i = 0; i < totalsize; ++i)
+		diff[i] = in[i] ^ base[i];
+	uLongf comprlen = compressBound(totalsize);
+	out.resize(SAVESTATE_HEADER_SIZE + comprlen);
+	memcpy(&out[0], "FCSD", 4);
+	FCEU_en32lsb(&out[4], totalsize);
+	FCEU_en32lsb(&out[8], 0);
+	if (compress2(&out[SAVESTATE_HEADER_SIZE], &comprlen, &diff[0], totalsize, Z_DEFAULT_COMPRESSION) == Z_OK)
+	{
+		FCEU_en32lsb(&out[12], comprlen);
+		out.resize(SAVESTATE_HEADER_SIZE + comprlen);
+	} else
+	{
+		deflateSavestate(in, out);
+	}
+}
+// only uncompresses the XOR, it still has to be applied to the previous savestate
+static bool inflateDelta(const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+{
+	uint32_t totalsize = FCEU_de32lsb((uint8 *)&in[4]);
+	uint32_t comprlen = FCEU_de32lsb((uint8 *)&in[12]);
+	if (in.size() < SAVESTATE_HEADER_SIZE + comprlen)
+		return false;
+	out.resize(totalsize);
+	uLongf uncomprlen = totalsize;
+	return uncompress(&out[0], &uncomprlen, &in[SAVESTATE_HEADER_SIZE], comprlen) == Z_OK && uncomprlen == totalsize;
+}
 
 GREENZONE::GREENZONE()
 {
 	nextCleaningTime = 0;
+	lookaheadLimit = -1;
 }
 
 void GREENZONE::init()
@@ -45,9 +134,11 @@ void GREENZONE::init()
 }
 void GREENZONE::free()
 {
-	savestates.resize(0);
+	savestates.reset();
+	picturelessFrames.clear();
 	greenzoneSize = 0;
 	lagLog.reset();
+	lookaheadLimit = -1;
 }
 void GREENZONE::reset()
 {
@@ -70,6 +161,10 @@ void GREENZONE::update()
 	if (getTasEditorTime() > nextCleaningTime)
 		runGreenzoneCleaning();
 
+	// savestates the Playback cursor may soon need should not have to be read from disk
+	if (savestates.spillUsage() && savestates.memoryUsage() < (size_t)taseditorConfig->greenzoneMemoryLimit * 1024 * 1024)
+		savestates.prefetch(currFrameCounter, PREFETCH_RADIUS, PREFETCH_BATCH);
+
 	// also log lag frames
 	if (currFrameCounter > 0)
 	{
@@ -102,78 +197,108 @@ void GREENZONE::update()
 			}
 		}
 	}
+
+	// use the idle time to extend the Greenzone ahead of the Playback cursor
+	regenerateAhead();
 }
 
 void GREENZONE::collectCurrentState()
 {
-	if ((int)savestates.size() <= currFrameCounter)
+	if (savestates.getNumFrames() <= currFrameCounter)
 		savestates.resize(currFrameCounter + 1);
 	// if frame is not saved - log savestate
-	if (!savestates[currFrameCounter].size())
+	if (!savestates.has(currFrameCounter))
 	{
-		EMUFILE_MEMORY ms(&savestates[currFrameCounter]);
-		FCEUSS_SaveMS(&ms, Z_DEFAULT_COMPRESSION);
-		ms.trim();
+		stateFile.set_len(0);
+		FCEUSS_SaveMS(&stateFile, Z_NO_COMPRESSION);
+		savestates.put(currFrameCounter, stateFile.buf(), stateFile.size());
+		// a turbo seek does not draw the frames before its target
+		setPictureless(currFrameCounter, FCEUI_GetComputeOnly());
 	}
 	if (greenzoneSize <= currFrameCounter)
 		greenzoneSize = currFrameCounter + 1;
 }
 
+// emulates the frames after the end of the Greenzone while the user isn't watching, so that jumping forward after an edit doesn't have to wait for seeking
+void GREENZONE::regenerateAhead()
+{
+	// only when Playback is idle: not seeking, not running, not recording
+	if (!taseditorConfig->enableGreenzoning || taseditorConfig->greenzoneLookahead <= 0)
+		return;
+	if (!FCEUI_EmulationPaused() || playback->getPauseFrame() >= 0 || isTaseditorRecording())
+		return;
+	int target = currFrameCounter + taseditorConfig->greenzoneLookahead;
+	if (target > currMovieData.getNumRecords() - 1)
+		target = currMovieData.getNumRecords() - 1;
+	if (lookaheadLimit >= 0 && target > lookaheadLimit)
+		target = lookaheadLimit;
+	if (greenzoneSize > target)
+		return;
+	// the lookahead never makes the cleaning throw away savestates the user has visited
+	size_t memoryLimit = (size_t)taseditorConfig->greenzoneMemoryLimit * 1024 * 1024;
+	if (savestates.memoryUsage() >= memoryLimit)
+		return;
+	// continue from the last savestate of the Greenzone
+	int frame = greenzoneSize - 1;
+	while (frame > currFrameCounter && !savestates.has(frame))
+		frame--;
+
+	// park the visible console, the lookahead runs on the same core
+	if (!playbackContext.capture())
+		return;
+	char savedLagFlag = lagFlag;
+	uint32 savedInputDisplay = cur_input_display;
+	savedDeemph.assign(XDBuf, XDBuf + 256 * 256);
+
+	if (frame == currFrameCounter || loadSavestateOfFrame(frame))
+	{
+		// TAS Editor savestates don't carry the frame counter
+		currFrameCounter = frame;
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(LOOKAHEAD_TIME_SLICE);
+		while (currFrameCounter < target)
+		{
+			FCEUI_EmulateOffscreen();
+			int lag = lagFlag ? LAGGED_YES : LAGGED_NO;
+			int old_lag = lagLog.getLagInfoAtFrame(currFrameCounter - 1);
+			if (taseditorConfig->autoAdjustInputAccordingToLag && old_lag != LAGGED_UNKNOWN && old_lag != lag)
+			{
+				// this frame needs the Input adjustment that only Playback does, leave the rest to Playback
+				lookaheadLimit = currFrameCounter - 1;
+				break;
+			}
+			if (old_lag != lag)
+			{
+				lagLog.setLagInfo(currFrameCounter - 1, lag == LAGGED_YES);
+				history->getCurrentSnapshot().laglog.setLagInfo(currFrameCounter - 1, lag == LAGGED_YES);
+			}
+			collectCurrentState();
+			if (savestates.memoryUsage() >= memoryLimit || std::chrono::steady_clock::now() >= deadline)
+				break;
+		}
+	}
+
+	if (!playbackContext.activate())
+		playback->jump(playbackContext.frameCount(), true, false, false);
+	memcpy(XDBuf, &savedDeemph[0], 256 * 256);
+	cur_input_display = savedInputDisplay;
+	lagFlag = savedLagFlag;
+}
+
 bool GREENZONE::loadSavestateOfFrame(unsigned int frame)
 {
-	if (frame >= savestates.size() || !savestates[frame].size())
+	if (!savestates.get(frame, *stateFile.get_vec()))
 		return false;
-	EMUFILE_MEMORY ms(&savestates[frame]);
-	return FCEUSS_LoadFP(&ms, SSLOADPARAM_NOBACKUP);
+	stateFile.set_len(stateFile.get_vec()->size());
+	stateFile.fseek(0, SEEK_SET);
+	return FCEUSS_LoadFP(&stateFile, SSLOADPARAM_NOBACKUP);
 }
 
 void GREENZONE::runGreenzoneCleaning()
 {
-	bool changed = false;
-	int i = currFrameCounter - taseditorConfig->greenzoneCapacity;
-	if (i <= 0) goto finish;	// zeroth frame should not be cleaned
-	int limit;
-	// 2x of 1/2
-	limit = i - 2 * taseditorConfig->greenzoneCapacity;
-	if (limit < 0) limit = 0;
-	for (; i > limit; i--)
-	{
-		if (i & 0x1)
-			changed = changed | clearSavestateAndFreeMemory(i);
-	}
-	if (i < 0) goto finish;
-	// 4x of 1/4
-	limit = i - 4 * taseditorConfig->greenzoneCapacity;
-	if (limit < 0) limit = 0;
-	for (; i > limit; i--)
-	{
-		if (i & 0x3)
-			changed = changed | clearSavestateAndFreeMemory(i);
-	}
-	if (i < 0) goto finish;
-	// 8x of 1/8
-	limit = i - 8 * taseditorConfig->greenzoneCapacity;
-	if (limit < 0) limit = 0;
-	for (; i > limit; i--)
-	{
-		if (i & 0x7)
-			changed = changed | clearSavestateAndFreeMemory(i);
-	}
-	if (i < 0) goto finish;
-	// 16x of 1/16
-	limit = i - 16 * taseditorConfig->greenzoneCapacity;
-	if (limit < 0) limit = 0;
-	for (; i > limit; i--)
-	{
-		if (i & 0xF)
-			changed = changed | clearSavestateAndFreeMemory(i);
-	}
-	// clear all remaining
-	for (; i > 0; i--)
-	{
-		changed = changed | clearSavestateAndFreeMemory(i);
-	}
-finish:
+	size_t memoryLimit = (size_t)taseditorConfig->greenzoneMemoryLimit * 1024 * 1024;
+	savestates.setSpillCapacity((size_t)taseditorConfig->greenzoneSpillLimit * 1024 * 1024);
+	// zeroth frame and the Playback cursor frame are never cleaned
+	bool changed = savestates.evictLeastRecentlyUsed(memoryLimit, currFrameCounter) > 0;
 	if (changed)
 	{
 		//pianoRoll.redraw();
@@ -186,29 +311,31 @@ finish:
 // returns true if actually cleared savestate data
 bool GREENZONE::clearSavestateOfFrame(unsigned int frame)
 {
-	if (frame < savestates.size() && savestates[frame].size())
-	{
-	    savestates[frame].resize(0);
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return savestates.clear(frame);
 }
-bool GREENZONE::clearSavestateAndFreeMemory(unsigned int frame)
+
+// reads a savestate of given size from project file, returns false on read error or when it does not uncompress
+bool GREENZONE::readSavestate(EMUFILE *is, int frame, unsigned int size)
 {
-	if (frame < savestates.size() && savestates[frame].size())
-	{
-		//savestates[frame].swap(std::vector<uint8_t>()); //FIXME
-		savestates[frame].clear();
-		savestates[frame].shrink_to_fit();
-		return true;
-	}
-	else
+	fileBuffer.resize(size);
+	if (size && is->fread(&fileBuffer[0], size) < size)
+		return false;
+	if (!inflateSavestate(fileBuffer, *stateFile.get_vec()))
 	{
+		FCEU_printf("Greenzone savestate of frame %d is corrupt\n", frame);
 		return false;
 	}
+	savestates.put(frame, stateFile.get_vec()->data(), stateFile.get_vec()->size());
+	setPictureless(frame, false);
+	return true;
+}
+// writes size and savestate of given frame to project file
+void GREENZONE::writeSavestate(EMUFILE *os, int frame)
+{
+	savestates.get(frame, *stateFile.get_vec());
+	deflateSavestate(*stateFile.get_vec(), fileBuffer);
+	write32le((int)fileBuffer.size(), os);
+	os->fwrite(&fileBuffer[0], fileBuffer.size());
 }
 
 void GREENZONE::ungreenzoneSelectedFrames()
@@ -223,7 +350,7 @@ void GREENZONE::ungreenzoneSelectedFrames()
 	// degreenzone frames, going backwards
 	for (RowsSelection::reverse_iterator it(current_selection->rbegin()); it != current_selection_rend; it++)
 	{
-		changed = changed | clearSavestateAndFreeMemory(*it);
+		changed = changed | clearSavestateOfFrame(*it);
 	}
 	if (changed)
 	{
@@ -239,10 +366,10 @@ void GREENZONE::save(EMUFILE *os, int save_type)
 		setTasProjectProgressBarText("Saving Greenzone...");
 		collectCurrentState();		// in case the project is being saved before the greenzone.update() was called within current frame
 		runGreenzoneCleaning();
-		if (greenzoneSize > (int)savestates.size())
-			greenzoneSize = savestates.size();
-		// write "GREENZONE" string
-		os->fwrite(greenzone_save_id, GREENZONE_ID_LEN);
+		if (greenzoneSize > savestates.getNumFrames())
+			greenzoneSize = savestates.getNumFrames();
+		// write "GREENZOND" string, savestates that follow are stored as deltas
+		os->fwrite(greenzone_delta_save_id, GREENZONE_ID_LEN);
 		// write LagLog
 		lagLog.save(os);
 		// write size
@@ -252,82 +379,36 @@ void GREENZONE::save(EMUFILE *os, int save_type)
 
 		setTasProjectProgressBar( 0, greenzoneSize );
 	}
-	int frame, size;
-	int last_tick = -1;
+	std::vector<int> framesToSave;
 
 	switch (save_type)
 	{
 		case GREENZONE_SAVING_MODE_ALL:
 		{
-			// write savestates
-			for (frame = 0; frame < greenzoneSize; ++frame)
-			{
-				// update TASEditor progressbar from time to time
-				if (frame / PROGRESSBAR_UPDATE_RATE > last_tick)
-				{
-					setTasProjectProgressBar( frame, greenzoneSize );
-					playback->setProgressbar(frame, greenzoneSize);
-					last_tick = frame / PROGRESSBAR_UPDATE_RATE;
-				}
-				if (!savestates[frame].size()) continue;
-				write32le(frame, os);
-				// write savestate
-				size = savestates[frame].size();
-				write32le(size, os);
-				os->fwrite(&savestates[frame][0], size);
-			}
+			for (int frame = 0; frame < greenzoneSize; ++frame)
+				if (savestates.has(frame))
+					framesToSave.push_back(frame);
+			writeSavestates(os, framesToSave);
 			// write -1 as eof for greenzone
 			write32le(-1, os);
 			break;
 		}
 		case GREENZONE_SAVING_MODE_16TH:
 		{
-			// write savestates
-			for (frame = 0; frame < greenzoneSize; ++frame)
-			{
-				if (!(frame & 0xF) || frame == currFrameCounter)
-				{
-					// update TASEditor progressbar from time to time
-					if (frame / PROGRESSBAR_UPDATE_RATE > last_tick)
-					{
-						setTasProjectProgressBar( frame, greenzoneSize );
-						playback->setProgressbar(frame, greenzoneSize);
-						last_tick = frame / PROGRESSBAR_UPDATE_RATE;
-					}
-					if (!savestates[frame].size()) continue;
-					write32le(frame, os);
-					// write savestate
-					size = savestates[frame].size();
-					write32le(size, os);
-					os->fwrite(&savestates[frame][0], size);
-				}
-			}
+			for (int frame = 0; frame < greenzoneSize; ++frame)
+				if ((!(frame & 0xF) || frame == currFrameCounter) && savestates.has(frame))
+					framesToSave.push_back(frame);
+			writeSavestates(os, framesToSave);
 			// write -1 as eof for greenzone
 			write32le(-1, os);
 			break;
 		}
 		case GREENZONE_SAVING_MODE_MARKED:
 		{
-			// write savestates
-			for (frame = 0; frame < greenzoneSize; ++frame)
-			{
-				if (markersManager->getMarkerAtFrame(frame) || frame == currFrameCounter)
-				{
-					// update TASEditor progressbar from time to time
-					if (frame / PROGRESSBAR_UPDATE_RATE > last_tick)
-					{
-						setTasProjectProgressBar( frame, greenzoneSize );
-						playback->setProgressbar(frame, greenzoneSize);
-						last_tick = frame / PROGRESSBAR_UPDATE_RATE;
-					}
-					if (!savestates[frame].size()) continue;
-					write32le(frame, os);
-					// write savestate
-					size = savestates[frame].size();
-					write32le(size, os);
-					os->fwrite(&savestates[frame][0], size);
-				}
-			}
+			for (int frame = 0; frame < greenzoneSize; ++frame)
+				if ((markersManager->getMarkerAtFrame(frame) || frame == currFrameCounter) && savestates.has(frame))
+					framesToSave.push_back(frame);
+			writeSavestates(os, framesToSave);
 			// write -1 as eof for greenzone
 			write32le(-1, os);
 			break;
@@ -344,9 +425,7 @@ void GREENZONE::save(EMUFILE *os, int save_type)
 			{
 				// write ONE savestate for currFrameCounter
 				collectCurrentState();
-				int size = savestates[currFrameCounter].size();
-				write32le(size, os);
-				os->fwrite(&savestates[currFrameCounter][0], size);
+				writeSavestate(os, currFrameCounter);
 			}
 			break;
 		}
@@ -393,8 +472,7 @@ bool GREENZONE::load(EMUFILE *is, unsigned int offset)
 				// there must be one savestate in the file
 				if (read32le(&size, is) && size >= 0)
 				{
-					savestates[frame].resize(size);
-					if (is->fread(&savestates[frame][0], size) == size)
+					if (readSavestate(is, frame, size))
 					{
 						if (loadSavestateOfFrame(currFrameCounter))
 						{
@@ -414,7 +492,8 @@ bool GREENZONE::load(EMUFILE *is, unsigned int offset)
 		}
 		goto error;
 	}
-	if (strcmp(greenzone_save_id, save_id)) goto error;		// string is not valid
+	// "GREENZONE" = every savestate is stored whole (older project files), "GREENZOND" = deltas
+	if (strcmp(greenzone_save_id, save_id) && strcmp(greenzone_delta_save_id, save_id)) goto error;		// string is not valid
 
 	setTasProjectProgressBarText("Loading Greenzone...");
 	// read LagLog
@@ -428,42 +507,77 @@ bool GREENZONE::load(EMUFILE *is, unsigned int offset)
 		if (read32le(&frame, is))
 		{
 			currFrameCounter = frame;
-			int greenzone_tail_frame = currFrameCounter - taseditorConfig->greenzoneCapacity;
-			int greenzone_tail_frame2 = greenzone_tail_frame - 2 * taseditorConfig->greenzoneCapacity;
-			int greenzone_tail_frame4 = greenzone_tail_frame - 4 * taseditorConfig->greenzoneCapacity;
-			int greenzone_tail_frame8 = greenzone_tail_frame - 8 * taseditorConfig->greenzoneCapacity;
-			int greenzone_tail_frame16 = greenzone_tail_frame - 16 * taseditorConfig->greenzoneCapacity;
-			// read savestates
-			while(1)
+			// read savestates, a batch at a time, and uncompress every batch on all cores
+			std::vector<int> batchFrames;
+			std::vector<std::vector<uint8_t>> packed(SAVESTATES_BATCH), raw(SAVESTATES_BATCH);
+			std::vector<char> inflated(SAVESTATES_BATCH), delta(SAVESTATES_BATCH);
+			std::vector<uint8_t> previous;		// last savestate of the previous batch, the base of a delta
+			bool hasPrevious = false;
+			bool eof = false;
+			while (!eof)
 			{
-				if (!read32le(&frame, is)) break;
-				if (frame < 0) break;		// -1 = eof
-				// update TASEditor progressbar from time to time
-				if (frame / PROGRESSBAR_UPDATE_RATE > last_tick)
+				batchFrames.clear();
+				while ((int)batchFrames.size() < SAVESTATES_BATCH)
 				{
-					setTasProjectProgressBar( frame, greenzoneSize );
-					playback->setProgressbar(frame, greenzoneSize);
-					last_tick = frame / PROGRESSBAR_UPDATE_RATE;
+					if (!read32le(&frame, is) || frame < 0)		// -1 = eof
+					{
+						eof = true;
+						break;
+					}
+					// read savestate
+					std::vector<uint8_t>& buffer = packed[batchFrames.size()];
+					if (!read32le(&size, is)) { eof = true; break; }
+					buffer.resize(size);
+					if (size && is->fread(&buffer[0], size) < size) { eof = true; break; }
+					batchFrames.push_back(frame);
 				}
-				// read savestate
-				if (!read32le(&size, is)) break;
-				if (size < 0) break;
-				if (frame <= greenzone_tail_frame16
-					|| (frame <= greenzone_tail_frame8 && (frame & 0xF))
-					|| (frame <= greenzone_tail_frame4 && (frame & 0x7))
-					|| (frame <= greenzone_tail_frame2 && (frame & 0x3))
-					|| (frame <= greenzone_tail_frame && (frame & 0x1)))
+				int count = batchFrames.size();
+				FCEU::parallelFor(count, [&](int i)
 				{
-					// skip loading this savestate
-					if (is->fseek(size, SEEK_CUR) != 0) break;
-				} else
+					delta[i] = isDeltaSavestate(packed[i]);
+					inflated[i] = delta[i] ? inflateDelta(packed[i], raw[i]) : inflateSavestate(packed[i], raw[i]);
+				});
+				const std::vector<uint8_t>* base = hasPrevious ? &previous : NULL;
+				for (int i = 0; i < count; ++i)
 				{
-					// load this savestate
-					if ((int)savestates.size() <= frame)
-						savestates.resize(frame + 1);
-					savestates[frame].resize(size);
-					if (is->fread(&savestates[frame][0], size) < size) break;
-					prev_frame = frame;			// successfully read one Greenzone frame info
+					if (!inflated[i])
+						FCEU_printf("Greenzone savestate of frame %d is corrupt\n", batchFrames[i]);
+					if (inflated[i] && delta[i])
+					{
+						// apply the XOR to the previous savestate, a delta cannot be restored when the previous one is missing
+						if (base && base->size() == raw[i].size())
+						{
+							uint8_t* state = raw[i].data();
+							const uint8_t* prev = base->data();
+							for (size_t k = 0; k < raw[i].size(); ++k)
+								state[k] ^= prev[k];
+						} else
+						{
+							inflated[i] = false;
+						}
+					}
+					if (inflated[i])
+					{
+						savestates.put(batchFrames[i], raw[i].data(), raw[i].size());
+						setPictureless(batchFrames[i], false);
+						base = &raw[i];
+					} else
+					{
+						base = NULL;
+					}
+					prev_frame = batchFrames[i];			// successfully read one Greenzone frame info
+				}
+				if (base && base != &previous)
+					previous = *base;
+				hasPrevious = (base != NULL);
+				// update TASEditor progressbar from time to time
+				if (count && prev_frame / PROGRESSBAR_UPDATE_RATE > last_tick)
+				{
+					setTasProjectProgressBar( prev_frame, greenzoneSize );
+					playback->setProgressbar(prev_frame, greenzoneSize);
+					last_tick = prev_frame / PROGRESSBAR_UPDATE_RATE;
+					// keep within the memory limit while loading big files (oldest loaded frames go first)
+					runGreenzoneCleaning();
 				}
 			}
 			if (prev_frame+1 == greenzoneSize)
@@ -601,8 +715,10 @@ void GREENZONE::invalidate(int after)
 	{
 		if (after >= currMovieData.getNumRecords())
 			after = currMovieData.getNumRecords() - 1;
+		// the Input changed, the lookahead may start over from the new end of the Greenzone
+		lookaheadLimit = -1;
 		// clear all savestates that became irrelevant
-		for (int i = savestates.size() - 1; i > after; i--)
+		for (int i = savestates.getNumFrames() - 1; i > after; i--)
 			clearSavestateOfFrame(i);
 		if (greenzoneSize > after + 1)
 		{
@@ -621,8 +737,10 @@ void GREENZONE::invalidateAndUpdatePlayback(int after)
 	{
 		if (after >= currMovieData.getNumRecords())
 			after = currMovieData.getNumRecords() - 1;
+		// the Input changed, the lookahead may start over from the new end of the Greenzone
+		lookaheadLimit = -1;
 		// clear all savestates that became irrelevant
-		for (int i = savestates.size() - 1; i > after; i--)
+		for (int i = savestates.getNumFrames() - 1; i > after; i--)
 			clearSavestateOfFrame(i);
 		if (greenzoneSize > after + 1 || currFrameCounter > after)
 		{
@@ -655,7 +773,7 @@ void GREENZONE::invalidateAndUpdatePlayback(int after)
 int GREENZONE::findFirstGreenzonedFrame(int starting_index)
 {
 	for (int i = starting_index; i < greenzoneSize; ++i)
-		if (savestates[i].size()) return i;
+		if (savestates.has(i)) return i;
 	return -1;	// error
 }
 
@@ -666,25 +784,95 @@ int GREENZONE::getSize()
 }
 
 // this should only be used by Bookmark Set procedure
-std::vector<uint8>& GREENZONE::getSavestateOfFrame(int frame)
+// returns a compressed savestate, as Bookmarks keep them that way
+std::vector<uint8_t> GREENZONE::getSavestateOfFrame(int frame)
 {
-	return savestates[frame];
+	std::vector<uint8_t> savestate;
+	if (savestates.get(frame, *stateFile.get_vec()))
+		deflateSavestate(*stateFile.get_vec(), savestate);
+	return savestate;
 }
 // this function should only be used by Bookmark Deploy procedure
+// writes the savestates of the frames, compressing every batch of them on all cores
+void GREENZONE::writeSavestates(EMUFILE *os, const std::vector<int>& frames)
+{
+	std::vector<std::vector<uint8_t>> raw(SAVESTATES_BATCH), packed(SAVESTATES_BATCH), diff(SAVESTATES_BATCH);
+	std::vector<const std::vector<uint8_t>*> bases(SAVESTATES_BATCH);
+	std::vector<char> collected(SAVESTATES_BATCH);
+	std::vector<uint8_t> previous;		// last savestate of the previous batch
+	const std::vector<uint8_t>* last = NULL;
+	int written = 0;
+	for (size_t first = 0; first < frames.size(); first += SAVESTATES_BATCH)
+	{
+		int count = ((int)(frames.size() - first) < SAVESTATES_BATCH) ? (int)(frames.size() - first) : SAVESTATES_BATCH;
+		// update TASEditor progressbar
+		setTasProjectProgressBar( frames[first], greenzoneSize );
+		playback->setProgressbar(frames[first], greenzoneSize);
+		// the store is not thread safe, so only the compression runs in parallel
+		for (int i = 0; i < count; ++i)
+		{
+			collected[i] = savestates.get(frames[first + i], raw[i]);
+			if (!collected[i]) continue;
+			// every GREENZONE_KEYFRAME_INTERVAL'th savestate is stored whole, others as a delta to the savestate written before
+			bases[i] = (last && (written % GREENZONE_KEYFRAME_INTERVAL) && last->size() == raw[i].size()) ? last : NULL;
+			last = &raw[i];
+			written++;
+		}
+		FCEU::parallelFor(count, [&](int i)
+		{
+			if (!collected[i]) return;
+			if (bases[i])
+				deflateDelta(raw[i], *bases[i], packed[i], diff[i]);
+			else
+				deflateSavestate(raw[i], packed[i]);
+		});
+		// raw[] is refilled by the next batch, keep the base of its first delta
+		if (last && last != &previous)
+		{
+			previous = *last;
+			last = &previous;
+		}
+		for (int i = 0; i < count; ++i)
+		{
+			if (!collected[i]) continue;
+			write32le(frames[first + i], os);
+			write32le((int)packed[i].size(), os);
+			os->fwrite(&packed[i][0], packed[i].size());
+		}
+	}
+}
 void GREENZONE::writeSavestateForFrame(int frame, std::vector<uint8>& savestate)
 {
-	if ((int)savestates.size() <= frame)
-		savestates.resize(frame + 1);
-	savestates[frame] = savestate;
+	if (!inflateSavestate(savestate, *stateFile.get_vec()))
+		return;
+	savestates.put(frame, stateFile.get_vec()->data(), stateFile.get_vec()->size());
+	setPictureless(frame, false);
 	if (greenzoneSize <= frame)
 		greenzoneSize = frame + 1;
 }
 
 bool GREENZONE::isSavestateEmpty(unsigned int frame)
 {
-	if ((int)frame < greenzoneSize && frame < savestates.size() && savestates[frame].size())
+	if ((int)frame < greenzoneSize && savestates.has(frame))
 		return false;
 	else
 		return true;
 }
 
+// the savestate restores the game but not its picture, it can only be seeked from
+bool GREENZONE::isSavestatePictureless(unsigned int frame)
+{
+	return frame < picturelessFrames.size() && picturelessFrames[frame];
+}
+
+void GREENZONE::setPictureless(int frame, bool pictureless)
+{
+	if ((int)picturelessFrames.size() <= frame)
+	{
+		if (!pictureless)
+			return;
+		picturelessFrames.resize(frame + 1, false);
+	}
+	picturelessFrames[frame] = pictureless;
+}
+
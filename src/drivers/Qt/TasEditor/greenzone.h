@@ -3,12 +3,19 @@
 #include <stdint.h>
 #include <vector>
 
+#include "emufile.h"
+#include "context.h"
 #include "Qt/TasEditor/laglog.h"
+#include "Qt/TasEditor/greenzone_store.h"
 
 #define GREENZONE_ID_LEN 10
 
 #define TIME_BETWEEN_CLEANINGS (10000)
 
+#define LOOKAHEAD_TIME_SLICE (5)		// milliseconds of Greenzone lookahead per update
+#define PREFETCH_RADIUS 60				// spilled savestates this many frames around the Playback cursor are brought back into memory
+#define PREFETCH_BATCH 4				// at most this many per update
+
 // Greenzone cleaning masks
 #define EVERY16TH 0xFFFFFFF0
 #define EVERY8TH 0xFFFFFFF8
@@ -16,6 +23,8 @@
 #define EVERY2ND 0xFFFFFFFE
 
 #define PROGRESSBAR_UPDATE_RATE 1000	// progressbar is updated after every 1000 savestates loaded from FM3 file
+#define SAVESTATES_BATCH 128			// savestates compressed/uncompressed together when saving/loading FM3 file
+#define GREENZONE_KEYFRAME_INTERVAL 64	// in FM3 file every 64th saved savestate is stored whole, the rest as a delta to the previous one
 
 class GREENZONE
 {
@@ -41,26 +50,37 @@ public:
 	int findFirstGreenzonedFrame(int startingFrame = 0);
 
 	int getSize();
-	std::vector<uint8_t>& getSavestateOfFrame(int frame);
+	std::vector<uint8_t> getSavestateOfFrame(int frame);
 	void writeSavestateForFrame(int frame, std::vector<uint8>& savestate);
 	bool isSavestateEmpty(unsigned int frame);
+	bool isSavestatePictureless(unsigned int frame);
 
 	// saved data
 	LAGLOG lagLog;
 
 private:
 	void collectCurrentState();
+	void regenerateAhead();
 	bool clearSavestateOfFrame(unsigned int frame);
-	bool clearSavestateAndFreeMemory(unsigned int frame);
+	bool readSavestate(EMUFILE *is, int frame, unsigned int size);
+	void writeSavestate(EMUFILE *os, int frame);
+	void writeSavestates(EMUFILE *os, const std::vector<int>& frames);
+	void setPictureless(int frame, bool pictureless);
 
 	void adjustUp();
 	void adjustDown();
 
 	// saved data
 	int greenzoneSize;
-	std::vector<std::vector<uint8_t>> savestates;
+	GREENZONE_STORE savestates;
 
 	// not saved data
 	uint64_t nextCleaningTime;
+	int lookaheadLimit;					// the lookahead stops here, -1 = no limit
+	FCEU::Context playbackContext;		// the console at the Playback cursor while the lookahead runs
+	std::vector<uint8_t> savedDeemph;
+	EMUFILE_MEMORY stateFile;			// uncompressed savestate being stored or loaded
+	std::vector<uint8_t> fileBuffer;	// savestate as read from/written to the project file
+	std::vector<bool> picturelessFrames;	// taken after a compute-only frame, their back buffer is stale
 	
 };
@@ -0,0 +1,203 @@
+/* ---------------------------------------------------------------------------------
+Implementation file of GREENZONE_SPILL class
+
+(The MIT License)
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------------
+Greenzone spill - the cold tier of the Greenzone store
+[Single instance, owned by Greenzone store]
+
+* keeps the savestates the store evicts from memory in a temporary file mapped into memory, so that reading one back is a memcpy out of the page cache
+* the file is split into fixed size blocks, a savestate takes as many as it needs wherever they are free, so the file never has to be compacted
+* the file is made on the first spill and extended GREENZONE_SPILL_GROWTH at a time up to the capacity, it is deleted when the store is reset
+* if the file can't be made or extended, what it holds stays readable and the store discards savestates that don't fit, as it did without this tier
+------------------------------------------------------------------------------------ */
+
+#include <string.h>
+#include <QDir>
+#include <QTemporaryFile>
+
+#include "../../../fceu.h"
+#include "Qt/TasEditor/greenzone_spill.h"
+
+GREENZONE_SPILL::GREENZONE_SPILL()
+{
+	file = NULL;
+	map = NULL;
+	mappedBlocks = 0;
+	nextBlock = 0;
+	capacity = 0;
+	failed = false;
+}
+
+GREENZONE_SPILL::~GREENZONE_SPILL()
+{
+	closeFile();
+}
+
+void GREENZONE_SPILL::closeFile()
+{
+	if (file)
+	{
+		if (map)
+			file->unmap(map);
+		delete file;		// removes the file
+	}
+	file = NULL;
+	map = NULL;
+	mappedBlocks = 0;
+}
+
+void GREENZONE_SPILL::reset()
+{
+	closeFile();
+	nextBlock = 0;
+	freeBlocks.clear();
+	failed = false;
+}
+
+void GREENZONE_SPILL::setCapacity(size_t bytes)
+{
+	capacity = bytes;
+}
+
+// blocks that may be handed out: up to the capacity, and no more than are mapped once the file can't grow
+size_t GREENZONE_SPILL::limitBlocks() const
+{
+	size_t blocks = capacity / GREENZONE_SPILL_BLOCK_SIZE;
+	return (failed && mappedBlocks < blocks) ? mappedBlocks : blocks;
+}
+
+size_t GREENZONE_SPILL::getCapacity() const
+{
+	return limitBlocks() * GREENZONE_SPILL_BLOCK_SIZE;
+}
+
+size_t GREENZONE_SPILL::usage() const
+{
+	return (nextBlock - freeBlocks.size()) * (size_t)GREENZONE_SPILL_BLOCK_SIZE;
+}
+
+bool GREENZONE_SPILL::fits(size_t size) const
+{
+	size_t blocksNeeded = (size + GREENZONE_SPILL_BLOCK_SIZE - 1) / GREENZONE_SPILL_BLOCK_SIZE;
+	size_t capacityBlocks = limitBlocks();
+	if (usage() / GREENZONE_SPILL_BLOCK_SIZE + blocksNeeded > capacityBlocks)
+		return false;
+	// blocks past the limit, after the capacity was lowered, are not handed out again
+	size_t usable = 0;
+	for (size_t i = 0; i < freeBlocks.size() && usable < blocksNeeded; ++i)
+	{
+		if (freeBlocks[i] < capacityBlocks)
+			usable++;
+	}
+	return usable + (capacityBlocks > nextBlock ? capacityBlocks - nextBlock : 0) >= blocksNeeded;
+}
+
+// maps more of the file, so that blocksNeeded blocks past nextBlock are mapped
+bool GREENZONE_SPILL::grow(size_t blocksNeeded)
+{
+	size_t wanted = nextBlock + blocksNeeded;
+	if (wanted <= mappedBlocks)
+		return true;
+	if (failed)
+		return false;
+	size_t newBlocks = mappedBlocks + GREENZONE_SPILL_GROWTH / GREENZONE_SPILL_BLOCK_SIZE;
+	if (newBlocks < wanted)
+		newBlocks = wanted;
+	if (newBlocks > capacity / GREENZONE_SPILL_BLOCK_SIZE)
+		newBlocks = capacity / GREENZONE_SPILL_BLOCK_SIZE;
+	if (newBlocks < wanted)
+		return false;
+
+	if (!file)
+	{
+		file = new QTemporaryFile(QDir::tempPath() + "/fceux_greenzone_XXXXXX.spill");
+		if (!file->open())
+		{
+			FCEU_printf("TAS Editor: can't create the Greenzone spill file, least recently used savestates will be discarded\n");
+			closeFile();
+			failed = true;
+			return false;
+		}
+	}
+	// the old view stays until the new one is there, so a failure loses nothing already spilled
+	// and if the disk can't take a whole step, just what is needed now is tried
+	uint8_t* newMap = NULL;
+	if (file->resize((qint64)newBlocks * GREENZONE_SPILL_BLOCK_SIZE))
+		newMap = file->map(0, (qint64)newBlocks * GREENZONE_SPILL_BLOCK_SIZE);
+	if (!newMap && newBlocks > wanted)
+	{
+		newBlocks = wanted;
+		if (file->resize((qint64)newBlocks * GREENZONE_SPILL_BLOCK_SIZE))
+			newMap = file->map(0, (qint64)newBlocks * GREENZONE_SPILL_BLOCK_SIZE);
+	}
+	if (!newMap)
+	{
+		FCEU_printf("TAS Editor: can't extend the Greenzone spill file %s to %zu MB, least recently used savestates will be discarded\n",
+			file->fileName().toLocal8Bit().constData(), (newBlocks * GREENZONE_SPILL_BLOCK_SIZE + (1 << 20) - 1) >> 20);
+		failed = true;
+		return false;
+	}
+	if (map)
+		file->unmap(map);
+	map = newMap;
+	mappedBlocks = newBlocks;
+	return true;
+}
+
+bool GREENZONE_SPILL::write(const uint8_t* data, size_t size, std::vector<uint32_t>& blocks)
+{
+	blocks.clear();
+	if (!fits(size))
+		return false;
+	size_t blocksNeeded = (size + GREENZONE_SPILL_BLOCK_SIZE - 1) / GREENZONE_SPILL_BLOCK_SIZE;
+	size_t capacityBlocks = limitBlocks();
+	blocks.reserve(blocksNeeded);
+
+	for (size_t i = freeBlocks.size(); i-- > 0 && blocks.size() < blocksNeeded; )
+	{
+		if (freeBlocks[i] < capacityBlocks)
+		{
+			blocks.push_back(freeBlocks[i]);
+			freeBlocks.erase(freeBlocks.begin() + i);
+		}
+	}
+	size_t fresh = blocksNeeded - blocks.size();
+	if (fresh && !grow(fresh))
+	{
+		freeBlocks.insert(freeBlocks.end(), blocks.begin(), blocks.end());
+		blocks.clear();
+		return false;
+	}
+	for (size_t i = 0; i < fresh; ++i)
+		blocks.push_back(nextBlock++);
+
+	for (size_t i = 0, offset = 0; i < blocks.size(); ++i, offset += GREENZONE_SPILL_BLOCK_SIZE)
+	{
+		size_t todo = (size - offset < GREENZONE_SPILL_BLOCK_SIZE) ? size - offset : GREENZONE_SPILL_BLOCK_SIZE;
+		memcpy(map + (size_t)blocks[i] * GREENZONE_SPILL_BLOCK_SIZE, data + offset, todo);
+	}
+	return true;
+}
+
+void GREENZONE_SPILL::read(const std::vector<uint32_t>& blocks, size_t size, uint8_t* out) const
+{
+	for (size_t i = 0, offset = 0; i < blocks.size(); ++i, offset += GREENZONE_SPILL_BLOCK_SIZE)
+	{
+		size_t todo = (size - offset < GREENZONE_SPILL_BLOCK_SIZE) ? size - offset : GREENZONE_SPILL_BLOCK_SIZE;
+		memcpy(out + offset, map + (size_t)blocks[i] * GREENZONE_SPILL_BLOCK_SIZE, todo);
+	}
+}
+
+void GREENZONE_SPILL::release(std::vector<uint32_t>& blocks)
+{
+	freeBlocks.insert(freeBlocks.end(), blocks.begin(), blocks.end());
+	blocks.clear();
+	blocks.shrink_to_fit();
+	// once nothing is spilled the file goes, it is made again when needed
+	if (freeBlocks.size() == nextBlock)
+		reset();
+}
@@ -0,0 +1,40 @@
+// Specification file for GREENZONE_SPILL class
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+class QTemporaryFile;
+
+#define GREENZONE_SPILL_BLOCK_SIZE 1024
+#define GREENZONE_SPILL_GROWTH (64 * 1024 * 1024)	// the file is extended by this much at a time
+
+class GREENZONE_SPILL
+{
+public:
+	GREENZONE_SPILL();
+	~GREENZONE_SPILL();
+	void reset();
+
+	void setCapacity(size_t bytes);
+	size_t getCapacity() const;
+	size_t usage() const;
+
+	bool fits(size_t size) const;
+	bool write(const uint8_t* data, size_t size, std::vector<uint32_t>& blocks);
+	void read(const std::vector<uint32_t>& blocks, size_t size, uint8_t* out) const;
+	void release(std::vector<uint32_t>& blocks);
+
+private:
+	size_t limitBlocks() const;
+	bool grow(size_t blocksNeeded);
+	void closeFile();
+
+	QTemporaryFile* file;
+	uint8_t* map;
+	size_t mappedBlocks;
+	uint32_t nextBlock;				// blocks below this have been handed out at least once
+	std::vector<uint32_t> freeBlocks;
+	size_t capacity;
+	bool failed;					// the file could not be made or extended, it is not tried again until reset
+};
@@ -0,0 +1,458 @@
+/* ---------------------------------------------------------------------------------
+Implementation file of GREENZONE_STORE class
+
+(The MIT License)
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------------
+Greenzone store - savestate storage of the Greenzone
+[Single instance, owned by Greenzone]
+
+* keeps one uncompressed savestate per frame, split into fixed size pages
+* pages are content-addressed and shared between frames, so memory that did not change between frames (most of it) is stored once
+* a page equal to the same page of the previously stored state is shared without compressing or hashing it
+* new pages are compressed with the fastest zlib level
+* tracks when each frame was last stored or read, and evicts the least recently used frames on demand
+* evicted frames are spilled to Greenzone spill with their pages as they are encoded here, and are only discarded when it is full too
+* spilled frames are read straight from the spill, and brought back into memory when prefetched around the Playback cursor
+------------------------------------------------------------------------------------ */
+
+#include <string.h>
+#include <algorithm>
+#include <zlib.h>
+#include "framehash.h"
+
+#include "Qt/TasEditor/greenzone_store.h"
+
+// Per frame bookkeeping outside of the pages themselves
+#define FRAME_OVERHEAD (sizeof(FRAME))
+#define PAGE_OVERHEAD (sizeof(PAGE) + 2 * sizeof(void*))
+
+GREENZONE_STORE::GREENZONE_STORE()
+{
+	pageBytes = 0;
+	pageRefCount = 0;
+	spillRefCount = 0;
+	accessCounter = 0;
+}
+
+void GREENZONE_STORE::reset()
+{
+	pages.clear();
+	freePages.clear();
+	pageIndex.clear();
+	frames.clear();
+	lastState.clear();
+	lastPages.clear();
+	spill.reset();
+	pageBytes = 0;
+	pageRefCount = 0;
+	spillRefCount = 0;
+	accessCounter = 0;
+}
+
+uint32_t GREENZONE_STORE::storePage(const uint8_t* raw, uint32_t rawSize)
+{
+	uLongf comprlen = compressBound(rawSize);
+	if (compressBuf.size() < comprlen)
+		compressBuf.resize(comprlen);
+
+	const uint8_t* data = raw;
+	uint32_t dataSize = rawSize;
+	if (compress2(&compressBuf[0], &comprlen, raw, rawSize, Z_BEST_SPEED) == Z_OK && comprlen < rawSize)
+	{
+		data = &compressBuf[0];
+		dataSize = comprlen;
+	}
+	return internPage(data, dataSize, rawSize);
+}
+
+// stores a page already encoded by storePage, or shares an equal one
+uint32_t GREENZONE_STORE::internPage(const uint8_t* data, uint32_t dataSize, uint32_t rawSize)
+{
+	// zlib output is deterministic, so equal pages have equal encodings
+	uint64_t hash = FCEU_XXH64(data, dataSize, rawSize);
+	auto range = pageIndex.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		PAGE& page = pages[it->second];
+		if (page.rawSize == rawSize && page.data.size() == dataSize && !memcmp(&page.data[0], data, dataSize))
+		{
+			page.refs++;
+			return it->second;
+		}
+	}
+
+	uint32_t id;
+	if (freePages.size())
+	{
+		id = freePages.back();
+		freePages.pop_back();
+	} else
+	{
+		id = pages.size();
+		pages.push_back(PAGE());
+	}
+	PAGE& page = pages[id];
+	page.data.assign(data, data + dataSize);
+	page.hash = hash;
+	page.rawSize = rawSize;
+	page.refs = 1;
+	pageIndex.insert(std::make_pair(hash, id));
+	pageBytes += dataSize;
+	return id;
+}
+
+void GREENZONE_STORE::releasePage(uint32_t id)
+{
+	PAGE& page = pages[id];
+	if (--page.refs > 0)
+		return;
+
+	auto range = pageIndex.equal_range(page.hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (it->second == id)
+		{
+			pageIndex.erase(it);
+			break;
+		}
+	}
+	pageBytes -= page.data.size();
+	page.data.clear();
+	page.data.shrink_to_fit();
+	freePages.push_back(id);
+}
+
+void GREENZONE_STORE::releasePages(FRAME& frame)
+{
+	for (size_t i = 0; i < frame.pages.size(); ++i)
+		releasePage(frame.pages[i]);
+	pageRefCount -= frame.pages.size();
+	frame.pages.clear();
+	frame.pages.shrink_to_fit();
+}
+
+void GREENZONE_STORE::releaseFrame(FRAME& frame)
+{
+	releasePages(frame);
+	if (frame.spillBlocks.size())
+	{
+		spillRefCount -= frame.spillBlocks.size();
+		spill.release(frame.spillBlocks);
+	}
+	frame.spillSize = 0;
+	frame.size = 0;
+}
+
+// spill record: page count, then rawSize and dataSize of every page, then the page data one after another
+bool GREENZONE_STORE::spillFrame(FRAME& frame)
+{
+	size_t recordSize = sizeof(uint32_t) * (1 + 2 * frame.pages.size());
+	for (size_t i = 0; i < frame.pages.size(); ++i)
+		recordSize += pages[frame.pages[i]].data.size();
+	if (!spill.fits(recordSize))
+		return false;
+
+	spillBuf.resize(recordSize);
+	uint32_t* header = (uint32_t*)&spillBuf[0];
+	uint8_t* data = &spillBuf[sizeof(uint32_t) * (1 + 2 * frame.pages.size())];
+	header[0] = frame.pages.size();
+	for (size_t i = 0; i < frame.pages.size(); ++i)
+	{
+		const PAGE& page = pages[frame.pages[i]];
+		header[1 + 2 * i] = page.rawSize;
+		header[2 + 2 * i] = page.data.size();
+		memcpy(data, &page.data[0], page.data.size());
+		data += page.data.size();
+	}
+	if (!spill.write(&spillBuf[0], recordSize, frame.spillBlocks))
+		return false;
+	spillRefCount += frame.spillBlocks.size();
+	frame.spillSize = recordSize;
+	releasePages(frame);
+	return true;
+}
+
+// reads the spill record of the frame into spillBuf, false if it does not hold together
+bool GREENZONE_STORE::readSpilled(FRAME& frame)
+{
+	spillBuf.resize(frame.spillSize);
+	spill.read(frame.spillBlocks, frame.spillSize, &spillBuf[0]);
+	if (frame.spillSize < sizeof(uint32_t))
+		return false;
+	const uint32_t* header = (const uint32_t*)&spillBuf[0];
+	size_t headerSize = sizeof(uint32_t) * (1 + 2 * (size_t)header[0]);
+	if (headerSize > frame.spillSize)
+		return false;
+	size_t total = headerSize, rawTotal = 0;
+	for (size_t i = 0; i < header[0]; ++i)
+	{
+		rawTotal += header[1 + 2 * i];
+		total += header[2 + 2 * i];
+	}
+	return total == frame.spillSize && rawTotal == frame.size;
+}
+
+// brings a spilled frame back into memory, sharing its pages with the frames already there
+bool GREENZONE_STORE::promoteFrame(FRAME& frame)
+{
+	if (!readSpilled(frame))
+		return false;
+	const uint32_t* header = (const uint32_t*)&spillBuf[0];
+	const uint8_t* data = &spillBuf[sizeof(uint32_t) * (1 + 2 * (size_t)header[0])];
+	std::vector<uint32_t> newPages;
+	newPages.reserve(header[0]);
+	for (size_t i = 0; i < header[0]; ++i)
+	{
+		newPages.push_back(internPage(data, header[2 + 2 * i], header[1 + 2 * i]));
+		data += header[2 + 2 * i];
+	}
+
+	spillRefCount -= frame.spillBlocks.size();
+	spill.release(frame.spillBlocks);
+	frame.spillSize = 0;
+	frame.pages.swap(newPages);
+	pageRefCount += frame.pages.size();
+	frame.lastAccess = ++accessCounter;
+	return true;
+}
+
+void GREENZONE_STORE::rememberLastState(const uint8_t* state, size_t size, const std::vector<uint32_t>& newPages)
+{
+	// lastPages holds its own references, so the pages stay valid even if their frame is cleared
+	for (size_t i = 0; i < newPages.size(); ++i)
+		pages[newPages[i]].refs++;
+	for (size_t i = 0; i < lastPages.size(); ++i)
+		releasePage(lastPages[i]);
+	lastPages = newPages;
+	lastState.assign(state, state + size);
+}
+
+void GREENZONE_STORE::put(int frame, const uint8_t* state, size_t size)
+{
+	if (frame < 0)
+		return;
+	if ((int)frames.size() <= frame)
+		resize(frame + 1);
+
+	FRAME& entry = frames[frame];
+	std::vector<uint32_t> newPages;
+	newPages.reserve((size + GREENZONE_PAGE_SIZE - 1) / GREENZONE_PAGE_SIZE);
+
+	for (size_t offset = 0; offset < size; offset += GREENZONE_PAGE_SIZE)
+	{
+		uint32_t rawSize = std::min<size_t>(GREENZONE_PAGE_SIZE, size - offset);
+		size_t index = offset / GREENZONE_PAGE_SIZE;
+
+		if (index < lastPages.size() && offset + rawSize <= lastState.size()
+			&& pages[lastPages[index]].rawSize == rawSize
+			&& !memcmp(&lastState[offset], state + offset, rawSize))
+		{
+			pages[lastPages[index]].refs++;
+			newPages.push_back(lastPages[index]);
+		} else
+		{
+			newPages.push_back(storePage(state + offset, rawSize));
+		}
+	}
+
+	// release the old contents after storing the new ones, so shared pages are not freed and recreated
+	releaseFrame(entry);
+	entry.pages.swap(newPages);
+	pageRefCount += entry.pages.size();
+	entry.size = size;
+	entry.lastAccess = ++accessCounter;
+
+	rememberLastState(state, size, entry.pages);
+}
+
+bool GREENZONE_STORE::get(int frame, std::vector<uint8_t>& state)
+{
+	if (!has(frame))
+		return false;
+
+	FRAME& entry = frames[frame];
+	state.resize(entry.size);
+
+	size_t offset = 0;
+	if (entry.pages.empty())
+	{
+		// spilled, decoded from the record without bringing it back into memory
+		if (!readSpilled(entry))
+			return false;
+		const uint32_t* header = (const uint32_t*)&spillBuf[0];
+		const uint8_t* data = &spillBuf[sizeof(uint32_t) * (1 + 2 * (size_t)header[0])];
+		for (size_t i = 0; i < header[0]; ++i)
+		{
+			uint32_t pageRawSize = header[1 + 2 * i], dataSize = header[2 + 2 * i];
+			if (dataSize == pageRawSize)
+			{
+				memcpy(&state[offset], data, pageRawSize);
+			} else
+			{
+				uLongf rawSize = pageRawSize;
+				if (uncompress(&state[offset], &rawSize, data, dataSize) != Z_OK || rawSize != pageRawSize)
+					return false;
+			}
+			data += dataSize;
+			offset += pageRawSize;
+		}
+		entry.lastAccess = ++accessCounter;
+		return true;
+	}
+	for (size_t i = 0; i < entry.pages.size(); ++i)
+	{
+		const PAGE& page = pages[entry.pages[i]];
+		if (page.data.size() == page.rawSize)
+		{
+			memcpy(&state[offset], &page.data[0], page.rawSize);
+		} else
+		{
+			uLongf rawSize = page.rawSize;
+			if (uncompress(&state[offset], &rawSize, &page.data[0], page.data.size()) != Z_OK || rawSize != page.rawSize)
+				return false;
+		}
+		offset += page.rawSize;
+	}
+	entry.lastAccess = ++accessCounter;
+	return true;
+}
+
+bool GREENZONE_STORE::has(int frame) const
+{
+	return frame >= 0 && frame < (int)frames.size() && frames[frame].size;
+}
+
+// returns true if actually cleared savestate data
+bool GREENZONE_STORE::clear(int frame)
+{
+	if (!has(frame))
+		return false;
+	releaseFrame(frames[frame]);
+	return true;
+}
+
+int GREENZONE_STORE::getNumFrames() const
+{
+	return frames.size();
+}
+
+void GREENZONE_STORE::resize(int numFrames)
+{
+	for (int i = numFrames; i < (int)frames.size(); ++i)
+		releaseFrame(frames[i]);
+	FRAME empty;
+	empty.size = 0;
+	empty.lastAccess = 0;
+	empty.spillSize = 0;
+	frames.resize(numFrames, empty);
+}
+
+size_t GREENZONE_STORE::memoryUsage() const
+{
+	return pageBytes + pages.size() * PAGE_OVERHEAD + frames.size() * FRAME_OVERHEAD
+		+ (pageRefCount + spillRefCount) * sizeof(uint32_t) + lastState.capacity();
+}
+
+size_t GREENZONE_STORE::spillUsage() const
+{
+	return spill.usage();
+}
+
+void GREENZONE_STORE::setSpillCapacity(size_t bytes)
+{
+	spill.setCapacity(bytes);
+}
+
+// spills least recently stored/read frames until the store fits memoryLimit, discarding them when the spill is full
+// frame 0 and protectedFrame are never evicted, returns the number of frames discarded
+int GREENZONE_STORE::evictLeastRecentlyUsed(size_t memoryLimit, int protectedFrame)
+{
+	int evicted = 0;
+
+	// spilled frames, least recently used first, listed the first time one has to go
+	std::vector<std::pair<uint64_t, int>> spilled;
+	size_t nextSpilled = 0;
+	bool spilledListed = false;
+	auto discardSpilled = [&](uint64_t olderThan) -> bool
+	{
+		if (!spilledListed)
+		{
+			for (int i = 1; i < (int)frames.size(); ++i)
+			{
+				if (i != protectedFrame && frames[i].spillBlocks.size())
+					spilled.push_back(std::make_pair(frames[i].lastAccess, i));
+			}
+			std::sort(spilled.begin(), spilled.end());
+			spilledListed = true;
+		}
+		while (nextSpilled < spilled.size() && spilled[nextSpilled].first < olderThan)
+		{
+			FRAME& frame = frames[spilled[nextSpilled++].second];
+			if (frame.spillBlocks.size())
+			{
+				releaseFrame(frame);
+				return true;
+			}
+		}
+		return false;
+	};
+
+	// the spill capacity may have been lowered
+	while (spill.usage() > spill.getCapacity() && discardSpilled(UINT64_MAX))
+		evicted++;
+
+	if (memoryUsage() <= memoryLimit)
+		return evicted;
+
+	std::vector<std::pair<uint64_t, int>> candidates;
+	for (int i = 1; i < (int)frames.size(); ++i)
+	{
+		if (i != protectedFrame && frames[i].pages.size())
+			candidates.push_back(std::make_pair(frames[i].lastAccess, i));
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	for (size_t i = 0; i < candidates.size() && memoryUsage() > memoryLimit; ++i)
+	{
+		FRAME& frame = frames[candidates[i].second];
+		if (spillFrame(frame))
+			continue;
+		// make room in the spill by discarding what was used less recently than this frame, or else discard this one
+		bool spilledFrame = false;
+		while (!spilledFrame && discardSpilled(candidates[i].first))
+		{
+			evicted++;
+			spilledFrame = spillFrame(frame);
+		}
+		if (!spilledFrame)
+		{
+			releaseFrame(frame);
+			evicted++;
+		}
+	}
+	return evicted;
+}
+
+// brings up to maxFrames spilled frames within radius of centerFrame back into memory, nearest first
+// returns the number of frames brought back
+int GREENZONE_STORE::prefetch(int centerFrame, int radius, int maxFrames)
+{
+	int fetched = 0;
+	for (int distance = 0; distance <= radius && fetched < maxFrames; ++distance)
+	{
+		for (int side = 0; side < 2 && fetched < maxFrames; ++side)
+		{
+			int frame = side ? centerFrame - distance : centerFrame + distance;
+			if (side && !distance)
+				continue;
+			if (!has(frame) || frames[frame].pages.size())
+				continue;
+			if (promoteFrame(frames[frame]))
+				fetched++;
+		}
+	}
+	return fetched;
+}
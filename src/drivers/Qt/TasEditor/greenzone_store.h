@@ -0,0 +1,77 @@
+// Specification file for GREENZONE_STORE class
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <unordered_map>
+
+#include "Qt/TasEditor/greenzone_spill.h"
+
+#define GREENZONE_PAGE_SIZE 4096
+
+class GREENZONE_STORE
+{
+public:
+	GREENZONE_STORE();
+	void reset();
+
+	void put(int frame, const uint8_t* state, size_t size);
+	bool get(int frame, std::vector<uint8_t>& state);
+	bool has(int frame) const;
+	bool clear(int frame);
+
+	int getNumFrames() const;
+	void resize(int numFrames);
+
+	size_t memoryUsage() const;
+	size_t spillUsage() const;
+	void setSpillCapacity(size_t bytes);
+	int evictLeastRecentlyUsed(size_t memoryLimit, int protectedFrame);
+	int prefetch(int centerFrame, int radius, int maxFrames);
+
+private:
+	struct PAGE
+	{
+		std::vector<uint8_t> data;	// zlib stream, or the raw bytes when that is not smaller
+		uint64_t hash;
+		uint32_t rawSize;
+		int refs;
+	};
+	// a frame with a size but no pages is spilled: its pages are in the spill file as one record
+	struct FRAME
+	{
+		std::vector<uint32_t> pages;
+		uint32_t size;
+		uint64_t lastAccess;
+		std::vector<uint32_t> spillBlocks;
+		uint32_t spillSize;
+	};
+
+	uint32_t storePage(const uint8_t* raw, uint32_t rawSize);
+	uint32_t internPage(const uint8_t* data, uint32_t dataSize, uint32_t rawSize);
+	void releasePage(uint32_t id);
+	void releasePages(FRAME& frame);
+	void releaseFrame(FRAME& frame);
+	bool spillFrame(FRAME& frame);
+	bool readSpilled(FRAME& frame);
+	bool promoteFrame(FRAME& frame);
+	void rememberLastState(const uint8_t* state, size_t size, const std::vector<uint32_t>& pages);
+
+	std::vector<PAGE> pages;
+	std::vector<uint32_t> freePages;
+	std::unordered_multimap<uint64_t, uint32_t> pageIndex;
+	std::vector<FRAME> frames;
+
+	// The most recently stored state, pages unchanged since then are shared without compressing
+	std::vector<uint8_t> lastState;
+	std::vector<uint32_t> lastPages;
+
+	GREENZONE_SPILL spill;
+	std::vector<uint8_t> spillBuf;
+
+	std::vector<uint8_t> compressBuf;
+	size_t pageBytes;
+	size_t pageRefCount;	// page ids held by all frames
+	size_t spillRefCount;	// spill block ids held by all frames
+	uint64_t accessCounter;
+};
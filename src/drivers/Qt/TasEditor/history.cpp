@@ -16,13 +16,15 @@ History - History of movie modifications
 * implements all restoring operations: undo, redo, revert to any snapshot from the array
 * also stores the state of "undo pointer"
 * regularly updates the state of "undo pointer"
-* regularly (when emulator is paused) searches for uncompressed items in the History Log and compresses first found item
+* regularly (when emulator is paused) searches for uncompressed items in the History Log and compresses first found item, and frees Hot Changes maps of compressed items
+* creates new snapshots from the current one, so they share the Input chunks that an operation didn't change
 * implements the working of History List: creating, redrawing, clicks, auto-scrolling
 * stores resources: save id, ids and names of all possible types of modification, timings of "undo pointer"
 ------------------------------------------------------------------------------------ */
 
 #include "fceu.h"
 #include "driver.h"
+#include "utils/parallel.h"
 #include "Qt/ConsoleWindow.h"
 #include "Qt/TasEditor/taseditor_project.h"
 #include "Qt/TasEditor/TasEditorWindow.h"
@@ -163,16 +165,25 @@ void HISTORY::update()
 	{
 		if (FCEUI_EmulationPaused())
 		{
-			// search for the first occurrence of an item containing non-compressed snapshot
+			// compressed snapshots other than the current one don't need their Hot Changes maps until Undo/Redo gets to them
 			int real_pos;
 			for (int i = historyTotalItems - 1; i >= 0; i--)
+			{
+				real_pos = (historyStartPos + i) % historySize;
+				if (i != historyCursorPos && snapshots[real_pos].isAlreadyCompressed())
+					snapshots[real_pos].inputlog.releaseHotChanges();
+				if (bookmarkBackups[real_pos].notEmpty && bookmarkBackups[real_pos].snapshot.isAlreadyCompressed())
+					bookmarkBackups[real_pos].snapshot.inputlog.releaseHotChanges();
+			}
+			// search for the first occurrence of an item containing non-compressed snapshot
+			for (int i = historyTotalItems - 1; i >= 0; i--)
 			{
 				real_pos = (historyStartPos + i) % historySize;
 				if (!snapshots[real_pos].isAlreadyCompressed())
 				{
 					snapshots[real_pos].compressData();
 					break;
-				} else if (bookmarkBackups[real_pos].notEmpty && bookmarkBackups[real_pos].snapshot.isAlreadyCompressed())
+				} else if (bookmarkBackups[real_pos].notEmpty && !bookmarkBackups[real_pos].snapshot.isAlreadyCompressed())
 				{
 					bookmarkBackups[real_pos].snapshot.compressData();
 					break;
@@ -474,7 +485,7 @@ int HISTORY::registerChanges(int mod_type, int start, int end, int size, const c
 {
 	// create new snapshot
 	SNAPSHOT snap;
-	snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges);
+	snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges, -1, &getCurrentSnapshot());
 	// check if there are Input differences from latest snapshot
 	int real_pos = (historyStartPos + historyCursorPos) % historySize;
 	int first_changes = snap.inputlog.findFirstChange(snapshots[real_pos].inputlog, start, end);
@@ -631,7 +642,7 @@ int HISTORY::registerAdjustLag(int start, int size)
 {
 	// create new snapshot
 	SNAPSHOT snap;
-	snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges);
+	snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges, -1, &getCurrentSnapshot());
 	// check if there are Input differences from latest snapshot
 	int real_pos = (historyStartPos + historyCursorPos) % historySize;
 	SNAPSHOT& current_snap = snapshots[real_pos];
@@ -671,7 +682,7 @@ void HISTORY::registerMarkersChange(int modificationType, int start, int end, co
 {
 	// create new snapshot
 	SNAPSHOT snap;
-	snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges);
+	snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges, -1, &getCurrentSnapshot());
 	// fill description:
 	snap.modificationType = modificationType;
 	strcat(snap.description, modCaptions[modificationType]);
@@ -711,7 +722,7 @@ void HISTORY::registerBookmarkSet(int slot, BOOKMARK& backupCopy, int oldCurrent
 {
 	// create new snapshot
 	SNAPSHOT snap;
-	snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges);
+	snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges, -1, &getCurrentSnapshot());
 	// fill description: modification type + keyframe of the Bookmark
 	snap.modificationType = MODTYPE_BOOKMARK_0 + slot;
 	strcat(snap.description, modCaptions[snap.modificationType]);
@@ -729,7 +740,7 @@ int HISTORY::registerBranching(int slot, bool markers_changed)
 {
 	// create new snapshot
 	SNAPSHOT snap;
-	snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges);
+	snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges, -1, &getCurrentSnapshot());
 	// check if there are Input differences from latest snapshot
 	int real_pos = (historyStartPos + historyCursorPos) % historySize;
 	int first_changes = snap.inputlog.findFirstChange(snapshots[real_pos].inputlog);
@@ -836,7 +847,7 @@ void HISTORY::registerRecording(int frameOfChange, uint32 joypadDifferenceBits)
 	{
 		// not consecutive - create new snapshot and add it to history
 		SNAPSHOT snap;
-		snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges);
+		snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges, -1, &getCurrentSnapshot());
 		snap.recordedJoypadDifferenceBits = joypadDifferenceBits;
 		// fill description:
 		snap.modificationType = MODTYPE_RECORD;
@@ -877,7 +888,7 @@ int HISTORY::registerImport(MovieData& md, const char* filename)
 {
 	// create new snapshot
 	SNAPSHOT snap;
-	snap.init(md, greenzone->lagLog, taseditorConfig->enableHotChanges, getInputType(currMovieData));
+	snap.init(md, greenzone->lagLog, taseditorConfig->enableHotChanges, getInputType(currMovieData), &getCurrentSnapshot());
 	// check if there are Input differences from latest snapshot
 	int real_pos = (historyStartPos + historyCursorPos) % historySize;
 	int first_changes = snap.inputlog.findFirstChange(snapshots[real_pos].inputlog);
@@ -911,7 +922,7 @@ int HISTORY::registerLuaChanges(const char* name, int start, bool insertionOrDel
 {
 	// create new snapshot
 	SNAPSHOT snap;
-	snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges);
+	snap.init(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges, -1, &getCurrentSnapshot());
 	// check if there are Input differences from latest snapshot
 	int real_pos = (historyStartPos + historyCursorPos) % historySize;
 	int first_changes = snap.inputlog.findFirstChange(snapshots[real_pos].inputlog, start);
@@ -994,6 +1005,14 @@ void HISTORY::save(EMUFILE *os, bool really_save)
 		setTasProjectProgressBarText("Saving History...");
 		setTasProjectProgressBar( 0, historyTotalItems );
 
+		// compress what autocompression didn't get to yet, items are independent so this runs on all cores
+		FCEU::parallelFor(historyTotalItems, [this](int i)
+		{
+			int pos = (historyStartPos + i) % historySize;
+			snapshots[pos].compressData();
+			if (bookmarkBackups[pos].notEmpty)
+				bookmarkBackups[pos].snapshot.compressData();
+		});
 		// write "HISTORY" string
 		os->fwrite(historySaveID, HISTORY_ID_LEN);
 		// write vars
@@ -13,6 +13,8 @@ InputLog - Log of Input
 * optionally can store map of Hot Changes
 * implements InputLog creation: copying Input, copying Hot Changes
 * implements full/partial restoring of data from InputLog: Input, Hot Changes
+* keeps Input in chunks of frames, column by column, shared between copies of the InputLog until one of them changes (copy-on-write)
+* takes over unchanged chunks of the previous InputLog when the new one is created from the movie, so History snapshots only add the chunks of an edit
 * implements compression and decompression of stored data
 * saves and loads the data from a project file. On error: sends warning to caller
 * implements searching of first mismatch comparing two InputLogs or comparing this InputLog to a movie
@@ -20,7 +22,9 @@ InputLog - Log of Input
 * implements all operations with Hot Changes maps: copying (full/partial), updating/fading, setting new hot places by comparing two InputLogs
 ------------------------------------------------------------------------------------ */
 
+#include <algorithm>
 #include <zlib.h>
+#include "framehash.h"
 #include "Qt/TasEditor/inputlog.h"
 #include "Qt/TasEditor/taseditor_project.h"
 
@@ -33,33 +37,66 @@ INPUTLOG::INPUTLOG()
 	size = 0;
 	inputType = 0;
 	hasHotChanges = 0;
+	lastChunk = 0;
 	alreadyCompressed = false;
 }
 
-void INPUTLOG::init(MovieData& md, bool hotchanges, int force_input_type)
+void INPUTLOG::init(MovieData& md, bool hotchanges, int force_input_type, INPUTLOG* previous)
 {
 	hasHotChanges = hotchanges;
 	if (force_input_type < 0)
 		inputType = getInputType(md);
 	else
 		inputType = force_input_type;
-	int num_joys = joysticksPerFrame[inputType];
+	alreadyCompressed = false;
 	// retrieve Input data from movie data
 	size = md.getNumRecords();
-	joysticks.resize(BYTES_PER_JOYSTICK * num_joys * size);		// it's much faster to have this format than have [frame][joy] or other structures
-	commands.resize(size);				// commands take 1 byte per frame
+	chunks.clear();
 	if (hasHotChanges)
 		initHotChanges();
 
-	// fill Input vector
-	int joy;
-	for (int frame = 0; frame < size; ++frame)
+	if (!previous || previous == this || previous->inputType != inputType)
 	{
-		for (joy = num_joys - 1; joy >= 0; joy--)
-			joysticks[frame * num_joys * BYTES_PER_JOYSTICK + joy * BYTES_PER_JOYSTICK] = md.records[frame].joysticks[joy];
-		commands[frame] = md.records[frame].commands;
+		appendChunks(md, 0, size);
+		updateChunkStarts();
+		return;
 	}
-	alreadyCompressed = false;
+	// take over the chunks of the previous InputLog that the movie still contains,
+	// either at the same frames or moved by the number of inserted/deleted frames
+	int delta = size - previous->size;
+	int frame = 0, new_frames_start = 0;
+	while (frame < size)
+	{
+		int index = previous->findChunkStartingAt(frame);
+		if (index < 0 || !chunkMatchesMovie(*previous->chunks[index], md, frame))
+		{
+			index = (delta) ? previous->findChunkStartingAt(frame - delta) : -1;
+			if (index >= 0 && !chunkMatchesMovie(*previous->chunks[index], md, frame))
+				index = -1;
+		}
+		if (index >= 0)
+		{
+			appendChunks(md, new_frames_start, frame);
+			chunks.push_back(previous->chunks[index]);
+			frame += previous->chunks[index]->frames;
+			new_frames_start = frame;
+			continue;
+		}
+		// no match here, try the next frame where a chunk of the previous InputLog could start
+		int next = size;
+		std::vector<int>::iterator it = std::upper_bound(previous->chunkStarts.begin(), previous->chunkStarts.end(), frame);
+		if (it != previous->chunkStarts.end() && *it < next)
+			next = *it;
+		if (delta)
+		{
+			it = std::upper_bound(previous->chunkStarts.begin(), previous->chunkStarts.end(), frame - delta);
+			if (it != previous->chunkStarts.end() && *it + delta < next)
+				next = *it + delta;
+		}
+		frame = next;
+	}
+	appendChunks(md, new_frames_start, size);
+	updateChunkStarts();
 }
 
 // this function only updates one frame of Input Log and Hot Changes data
@@ -70,9 +107,7 @@ void INPUTLOG::reinit(MovieData& md, bool hotchanges, int frame_of_change)
 	int num_joys = joysticksPerFrame[inputType];
 	int joy;
 	// retrieve Input data from movie data
-	size = md.getNumRecords();
-	joysticks.resize(BYTES_PER_JOYSTICK * num_joys * size, 0);
-	commands.resize(size);
+	resizeFrames(md.getNumRecords());
 	if (hasHotChanges)
 	{
 		// resize Hot Changes
@@ -92,10 +127,13 @@ void INPUTLOG::reinit(MovieData& md, bool hotchanges, int frame_of_change)
 		hotChanges.resize(0);
 	}
 
-	// update Input vector
+	// update Input chunk
+	int index = findChunk(frame_of_change);
+	CHUNK& chunk = getWritableChunk(index);
+	int offset = frame_of_change - chunkStarts[index];
 	for (joy = num_joys - 1; joy >= 0; joy--)
-		joysticks[frame_of_change * num_joys * BYTES_PER_JOYSTICK + joy * BYTES_PER_JOYSTICK] = md.records[frame_of_change].joysticks[joy];
-	commands[frame_of_change] = md.records[frame_of_change].commands;
+		chunk.data[joy * chunk.frames + offset] = md.records[frame_of_change].joysticks[joy];
+	chunk.data[num_joys * chunk.frames + offset] = md.records[frame_of_change].commands;
 	alreadyCompressed = false;
 }
 
@@ -106,27 +144,46 @@ void INPUTLOG::toMovie(MovieData& md, int start, int end)
 	md.records.resize(end + 1);
 	int num_joys = joysticksPerFrame[inputType];
 	int joy;
-	for (int frame = start; frame <= end; ++frame)
+	for (int frame = start; frame <= end; )
 	{
-		for (joy = num_joys - 1; joy >= 0; joy--)
-			md.records[frame].joysticks[joy] = joysticks[frame * num_joys * BYTES_PER_JOYSTICK + joy * BYTES_PER_JOYSTICK];
-		md.records[frame].commands = commands[frame];
+		int index = findChunk(frame);
+		CHUNK& chunk = *chunks[index];
+		int offset = frame - chunkStarts[index];
+		for (; offset < chunk.frames && frame <= end; ++offset, ++frame)
+		{
+			for (joy = num_joys - 1; joy >= 0; joy--)
+				md.records[frame].joysticks[joy] = chunk.data[joy * chunk.frames + offset];
+			md.records[frame].commands = chunk.data[num_joys * chunk.frames + offset];
+		}
 	}
 }
 
 void INPUTLOG::compressData()
 {
+	// the project file keeps the old layout: joysticks interleaved frame by frame, then commands
+	int num_joys = joysticksPerFrame[inputType];
+	std::vector<uint8_t> joysticks(BYTES_PER_JOYSTICK * num_joys * size);
+	std::vector<uint8_t> commands(size);
+	for (int index = 0; index < (int)chunks.size(); ++index)
+	{
+		CHUNK& chunk = *chunks[index];
+		int start = chunkStarts[index];
+		for (int joy = num_joys - 1; joy >= 0; joy--)
+			for (int i = 0; i < chunk.frames; ++i)
+				joysticks[(start + i) * num_joys * BYTES_PER_JOYSTICK + joy * BYTES_PER_JOYSTICK] = chunk.data[joy * chunk.frames + i];
+		memcpy(&commands[start], &chunk.data[num_joys * chunk.frames], chunk.frames);
+	}
 	// compress joysticks
 	int len = joysticks.size();
 	uLongf comprlen = (len>>9)+12 + len;
 	compressedJoysticks.resize(comprlen);
-	compress(&compressedJoysticks[0], &comprlen, &joysticks[0], len);
+	compress(&compressedJoysticks[0], &comprlen, joysticks.data(), len);
 	compressedJoysticks.resize(comprlen);
 	// compress commands
 	len = commands.size();
 	comprlen = (len>>9)+12 + len;
 	compressedCommands.resize(comprlen);
-	compress(&compressedCommands[0], &comprlen, &commands[0], len);
+	compress(&compressedCommands[0], &comprlen, commands.data(), len);
 	compressedCommands.resize(comprlen);
 	if (hasHotChanges)
 	{
@@ -144,6 +201,12 @@ bool INPUTLOG::isAlreadyCompressed()
 {
 	return alreadyCompressed;
 }
+// frees the Hot Changes map of a compressed InputLog, it is uncompressed again when needed
+void INPUTLOG::releaseHotChanges()
+{
+	if (alreadyCompressed && hasHotChanges && !compressedHotChanges.empty())
+		std::vector<uint8_t>().swap(hotChanges);
+}
 
 void INPUTLOG::save(EMUFILE *os)
 {
@@ -184,24 +247,25 @@ bool INPUTLOG::load(EMUFILE *is)
 	uLongf destlen;
 	// read and uncompress joysticks data
 	destlen = size * BYTES_PER_JOYSTICK * joysticksPerFrame[inputType];
-	joysticks.resize(destlen);
+	std::vector<uint8_t> joysticks(destlen);
 	// read size
 	if (!read32le(&comprlen, is)) return true;
 	if (comprlen == 0) return true;
 	compressedJoysticks.resize(comprlen);
 	if (is->fread(&compressedJoysticks[0], comprlen) != comprlen) return true;
-	int e = uncompress(&joysticks[0], &destlen, &compressedJoysticks[0], comprlen);
+	int e = uncompress(joysticks.data(), &destlen, &compressedJoysticks[0], comprlen);
 	if (e != Z_OK && e != Z_BUF_ERROR) return true;
 	// read and uncompress commands data
 	destlen = size;
-	commands.resize(destlen);
+	std::vector<uint8_t> commands(destlen);
 	// read size
 	if (!read32le(&comprlen, is)) return true;
 	if (comprlen <= 0) return true;
 	compressedCommands.resize(comprlen);
 	if (is->fread(&compressedCommands[0], comprlen) != comprlen) return true;
-	e = uncompress(&commands[0], &destlen, &compressedCommands[0], comprlen);
+	e = uncompress(commands.data(), &destlen, &compressedCommands[0], comprlen);
 	if (e != Z_OK && e != Z_BUF_ERROR) return true;
+	buildChunks(joysticks.data(), commands.data());
 	// read hotchanges
 	if (!read8le(&tmp, is)) return true;
 	hasHotChanges = (tmp != 0);
@@ -253,11 +317,36 @@ int INPUTLOG::findFirstChange(INPUTLOG& theirLog, int start, int end)
 
 	int joy;
 	int num_joys = joysticksPerFrame[inputType];
-	for (int frame = start; frame <= end; ++frame)
+	int frame = start;
+	while (frame <= end)
 	{
-		for (joy = num_joys - 1; joy >= 0; joy--)
-			if (getJoystickData(frame, joy) != theirLog.getJoystickData(frame, joy)) return frame;
-		if (getCommandsData(frame) != theirLog.getCommandsData(frame)) return frame;
+		int index = findChunk(frame);
+		int chunk_end = chunkStarts[index] + chunks[index]->frames;
+		if (frame < their_log_end)
+		{
+			int their_index = theirLog.findChunk(frame);
+			int their_chunk_end = theirLog.chunkStarts[their_index] + theirLog.chunks[their_index]->frames;
+			// chunks that cover the same frames are compared by their hashes
+			if (frame == chunkStarts[index] && frame == theirLog.chunkStarts[their_index] && chunk_end == their_chunk_end && chunk_end - 1 <= end && inputType == theirLog.inputType)
+			{
+				if (chunks[index] == theirLog.chunks[their_index] || getChunkHash(index) == theirLog.getChunkHash(their_index))
+				{
+					frame = chunk_end;
+					continue;
+				}
+			}
+			if (chunk_end > their_chunk_end)
+				chunk_end = their_chunk_end;
+		}
+		if (chunk_end > end + 1)
+			chunk_end = end + 1;
+		// otherwise compare frame by frame up to the nearest chunk boundary
+		for (; frame < chunk_end; ++frame)
+		{
+			for (joy = num_joys - 1; joy >= 0; joy--)
+				if (getJoystickData(frame, joy) != theirLog.getJoystickData(frame, joy)) return frame;
+			if (getCommandsData(frame) != theirLog.getCommandsData(frame)) return frame;
+		}
 	}
 	// no difference was found
 
@@ -275,11 +364,19 @@ int INPUTLOG::findFirstChange(MovieData& md, int start, int end)
 
 	int joy;
 	int num_joys = joysticksPerFrame[inputType];
-	for (int frame = start; frame <= end; ++frame)
+	for (int frame = start; frame <= end; )
 	{
-		for (joy = num_joys - 1; joy >= 0; joy--)
-			if (getJoystickData(frame, joy) != md.records[frame].joysticks[joy]) return frame;
-		if (getCommandsData(frame) != md.records[frame].commands) return frame;
+		int index = findChunk(frame);
+		CHUNK& chunk = *chunks[index];
+		int offset = frame - chunkStarts[index];
+		const uint8_t* cmds = &chunk.data[num_joys * chunk.frames];
+		for (; offset < chunk.frames && frame <= end; ++offset, ++frame)
+		{
+			MovieRecord& record = md.records[frame];
+			for (joy = num_joys - 1; joy >= 0; joy--)
+				if (chunk.data[joy * chunk.frames + offset] != record.joysticks[joy]) return frame;
+			if (cmds[offset] != record.commands) return frame;
+		}
 	}
 	// no difference was found
 
@@ -296,25 +393,28 @@ int INPUTLOG::getJoystickData(int frame, int joy)
 {
 	if (frame < 0 || frame >= size)
 		return 0;
-	if (joy > joysticksPerFrame[inputType])
+	if (joy < 0 || joy >= joysticksPerFrame[inputType])
 		return 0;
-	return joysticks[frame * BYTES_PER_JOYSTICK * joysticksPerFrame[inputType] + joy];
+	int index = findChunk(frame);
+	CHUNK& chunk = *chunks[index];
+	return chunk.data[joy * chunk.frames + frame - chunkStarts[index]];
 }
 int INPUTLOG::getCommandsData(int frame)
 {
 	if (frame < 0 || frame >= size)
 		return 0;
-	return commands[frame];
+	int index = findChunk(frame);
+	CHUNK& chunk = *chunks[index];
+	return chunk.data[joysticksPerFrame[inputType] * chunk.frames + frame - chunkStarts[index]];
 }
 
 void INPUTLOG::insertFrames(int at, int frames)
 {
-	size += frames;
-	if (at == -1) 
+	restoreHotChanges();
+	if (at == -1 || at >= size) 
 	{
 		// append frames to the end
-		commands.resize(size);
-		joysticks.resize(BYTES_PER_JOYSTICK * joysticksPerFrame[inputType] * size);
+		resizeFrames(size + frames);
 		if (hasHotChanges)
 		{
 			hotChanges.resize(joysticksPerFrame[inputType] * size * HOTCHANGE_BYTES_PER_JOY);
@@ -325,16 +425,29 @@ void INPUTLOG::insertFrames(int at, int frames)
 		}
 	} else
 	{
-		// insert frames
-		// insert 1 byte of commands
-		commands.insert(commands.begin() + at, frames, 0);
-		// insert X bytes of joystics
-		int bytes = BYTES_PER_JOYSTICK * joysticksPerFrame[inputType];
-		joysticks.insert(joysticks.begin() + (at * bytes), frames * bytes, 0);
+		// insert frames, only the chunk at the insertion point is rewritten
+		int index = findChunk(at);
+		CHUNK& chunk = getWritableChunk(index);
+		int offset = at - chunkStarts[index];
+		int columns = getNumColumns();
+		std::vector<uint8_t> data((chunk.frames + frames) * columns, 0);
+		for (int c = 0; c < columns; ++c)
+		{
+			uint8_t* src = &chunk.data[c * chunk.frames];
+			uint8_t* dst = &data[c * (chunk.frames + frames)];
+			memcpy(dst, src, offset);
+			memcpy(dst + offset + frames, src + offset, chunk.frames - offset);
+		}
+		chunk.data.swap(data);
+		chunk.frames += frames;
+		size += frames;
+		if (chunk.frames > INPUTLOG_MAX_CHUNK_FRAMES)
+			splitChunk(index);
+		updateChunkStarts();
 		if (hasHotChanges)
 		{
 			// insert X bytes of hot_changes
-			bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
+			int bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
 			hotChanges.insert(hotChanges.begin() + (at * bytes), frames * bytes, BYTE_VALUE_CONTAINING_MAX_HOTCHANGES);
 		}
 	}
@@ -343,15 +456,27 @@ void INPUTLOG::insertFrames(int at, int frames)
 }
 void INPUTLOG::eraseFrame(int frame)
 {
-	// erase 1 byte of commands
-	commands.erase(commands.begin() + frame);
-	// erase X bytes of joystics
-	int bytes = BYTES_PER_JOYSTICK * joysticksPerFrame[inputType];
-	joysticks.erase(joysticks.begin() + (frame * bytes), joysticks.begin() + ((frame + 1) * bytes));
+	restoreHotChanges();
+	// erase the frame from all columns of its chunk
+	int index = findChunk(frame);
+	CHUNK& chunk = getWritableChunk(index);
+	int offset = frame - chunkStarts[index];
+	int columns = getNumColumns();
+	for (int c = 0, pos = 0; c < columns; ++c)
+	{
+		for (int i = 0; i < chunk.frames; ++i)
+			if (i != offset)
+				chunk.data[pos++] = chunk.data[c * chunk.frames + i];
+	}
+	chunk.frames--;
+	chunk.data.resize(chunk.frames * columns);
+	if (!chunk.frames)
+		chunks.erase(chunks.begin() + index);
+	updateChunkStarts();
 	if (hasHotChanges)
 	{
 		// erase X bytes of hot_changes
-		bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
+		int bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
 		hotChanges.erase(hotChanges.begin() + (frame * bytes), hotChanges.begin() + ((frame + 1) * bytes));
 	}
 	size--;
@@ -359,16 +484,219 @@ void INPUTLOG::eraseFrame(int frame)
 	alreadyCompressed = false;
 }
 // -----------------------------------------------------------------------------------------------
+int INPUTLOG::getNumColumns()
+{
+	return joysticksPerFrame[inputType] * BYTES_PER_JOYSTICK + 1;
+}
+
+// returns the index of the chunk containing the frame, which must be inside the InputLog
+int INPUTLOG::findChunk(int frame)
+{
+	if (lastChunk < (int)chunks.size() && frame >= chunkStarts[lastChunk])
+	{
+		if (frame < chunkStarts[lastChunk] + chunks[lastChunk]->frames)
+			return lastChunk;
+		if (lastChunk + 1 < (int)chunks.size() && frame < chunkStarts[lastChunk + 1] + chunks[lastChunk + 1]->frames)
+			return ++lastChunk;
+	}
+	lastChunk = std::upper_bound(chunkStarts.begin(), chunkStarts.end(), frame) - chunkStarts.begin() - 1;
+	return lastChunk;
+}
+
+// chunks may be shared with copies of this InputLog (History snapshots, Bookmarks), so clone before writing
+INPUTLOG::CHUNK& INPUTLOG::getWritableChunk(int index)
+{
+	if (chunks[index].use_count() > 1)
+		chunks[index] = std::make_shared<CHUNK>(*chunks[index]);
+	chunks[index]->hashIsValid = false;
+	return *chunks[index];
+}
+
+uint64_t INPUTLOG::getChunkHash(int index)
+{
+	CHUNK& chunk = *chunks[index];
+	if (!chunk.hashIsValid)
+	{
+		chunk.hash = FCEU_XXH64(chunk.data.data(), chunk.data.size(), 0);
+		chunk.hashIsValid = true;
+	}
+	return chunk.hash;
+}
+
+// builds the chunks from the project file layout (joysticks interleaved frame by frame)
+void INPUTLOG::buildChunks(const uint8_t* joys, const uint8_t* cmds)
+{
+	int num_joys = joysticksPerFrame[inputType];
+	chunks.clear();
+	for (int start = 0; start < size; start += INPUTLOG_CHUNK_FRAMES)
+	{
+		std::shared_ptr<CHUNK> chunk = std::make_shared<CHUNK>();
+		chunk->frames = (size - start < INPUTLOG_CHUNK_FRAMES) ? size - start : INPUTLOG_CHUNK_FRAMES;
+		chunk->data.resize((num_joys + 1) * chunk->frames);
+		chunk->hashIsValid = false;
+		for (int joy = num_joys - 1; joy >= 0; joy--)
+			for (int i = 0; i < chunk->frames; ++i)
+				chunk->data[joy * chunk->frames + i] = joys[(start + i) * num_joys * BYTES_PER_JOYSTICK + joy * BYTES_PER_JOYSTICK];
+		memcpy(&chunk->data[num_joys * chunk->frames], cmds + start, chunk->frames);
+		chunks.push_back(chunk);
+	}
+	updateChunkStarts();
+}
+
+// copies frames from "start" to "end" (not including) of the movie data into new chunks
+void INPUTLOG::appendChunks(MovieData& md, int start, int end)
+{
+	int num_joys = joysticksPerFrame[inputType];
+	int joy;
+	for (; start < end; start += INPUTLOG_CHUNK_FRAMES)
+	{
+		std::shared_ptr<CHUNK> chunk = std::make_shared<CHUNK>();
+		chunk->frames = (end - start < INPUTLOG_CHUNK_FRAMES) ? end - start : INPUTLOG_CHUNK_FRAMES;
+		chunk->data.resize((num_joys + 1) * chunk->frames);
+		chunk->hashIsValid = false;
+		uint8_t* cmds = &chunk->data[num_joys * chunk->frames];
+		for (int i = 0; i < chunk->frames; ++i)
+		{
+			MovieRecord& record = md.records[start + i];
+			for (joy = num_joys - 1; joy >= 0; joy--)
+				chunk->data[joy * chunk->frames + i] = record.joysticks[joy];
+			cmds[i] = record.commands;
+		}
+		chunks.push_back(chunk);
+	}
+}
+
+// returns true if the movie data holds the Input of the chunk at frames starting from "start"
+bool INPUTLOG::chunkMatchesMovie(const CHUNK& chunk, MovieData& md, int start)
+{
+	if (start < 0 || start + chunk.frames > md.getNumRecords())
+		return false;
+	int num_joys = joysticksPerFrame[inputType];
+	const uint8_t* cmds = &chunk.data[num_joys * chunk.frames];
+	for (int i = 0; i < chunk.frames; ++i)
+	{
+		MovieRecord& record = md.records[start + i];
+		if (cmds[i] != record.commands)
+			return false;
+		for (int joy = num_joys - 1; joy >= 0; joy--)
+			if (chunk.data[joy * chunk.frames + i] != record.joysticks[joy])
+				return false;
+	}
+	return true;
+}
+
+// returns the index of the chunk that begins at the frame, or -1
+int INPUTLOG::findChunkStartingAt(int frame)
+{
+	if (frame < 0 || frame >= size)
+		return -1;
+	int index = findChunk(frame);
+	return (chunkStarts[index] == frame) ? index : -1;
+}
+
+// cuts an oversized chunk into chunks of INPUTLOG_CHUNK_FRAMES
+void INPUTLOG::splitChunk(int index)
+{
+	std::shared_ptr<CHUNK> big = chunks[index];
+	int columns = getNumColumns();
+	std::vector<std::shared_ptr<CHUNK>> pieces;
+	for (int start = 0; start < big->frames; start += INPUTLOG_CHUNK_FRAMES)
+	{
+		std::shared_ptr<CHUNK> chunk = std::make_shared<CHUNK>();
+		chunk->frames = (big->frames - start < INPUTLOG_CHUNK_FRAMES) ? big->frames - start : INPUTLOG_CHUNK_FRAMES;
+		chunk->data.resize(columns * chunk->frames);
+		chunk->hashIsValid = false;
+		for (int c = 0; c < columns; ++c)
+			memcpy(&chunk->data[c * chunk->frames], &big->data[c * big->frames + start], chunk->frames);
+		pieces.push_back(chunk);
+	}
+	chunks.erase(chunks.begin() + index);
+	chunks.insert(chunks.begin() + index, pieces.begin(), pieces.end());
+}
+
+void INPUTLOG::updateChunkStarts()
+{
+	chunkStarts.resize(chunks.size());
+	int start = 0;
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		chunkStarts[i] = start;
+		start += chunks[i]->frames;
+	}
+	lastChunk = 0;
+}
+
+// truncates the InputLog or pads it with empty frames, Hot Changes are left to the caller
+void INPUTLOG::resizeFrames(int newSize)
+{
+	int columns = getNumColumns();
+	if (newSize < size)
+	{
+		int index = (newSize > 0) ? findChunk(newSize - 1) : -1;
+		chunks.resize(index + 1);
+		if (index >= 0 && chunkStarts[index] + chunks[index]->frames > newSize)
+		{
+			CHUNK& chunk = getWritableChunk(index);
+			int frames = newSize - chunkStarts[index];
+			for (int c = 1; c < columns; ++c)
+				memmove(&chunk.data[c * frames], &chunk.data[c * chunk.frames], frames);
+			chunk.frames = frames;
+			chunk.data.resize(columns * frames);
+		}
+	} else if (newSize > size)
+	{
+		int added = newSize - size;
+		// top up the last chunk first
+		if (!chunks.empty() && chunks.back()->frames < INPUTLOG_CHUNK_FRAMES)
+		{
+			CHUNK& chunk = getWritableChunk(chunks.size() - 1);
+			int frames = chunk.frames + ((added < INPUTLOG_CHUNK_FRAMES - chunk.frames) ? added : INPUTLOG_CHUNK_FRAMES - chunk.frames);
+			chunk.data.resize(columns * frames, 0);
+			for (int c = columns - 1; c > 0; c--)
+			{
+				memmove(&chunk.data[c * frames], &chunk.data[c * chunk.frames], chunk.frames);
+				memset(&chunk.data[c * frames + chunk.frames], 0, frames - chunk.frames);
+			}
+			memset(&chunk.data[chunk.frames], 0, frames - chunk.frames);
+			added -= frames - chunk.frames;
+			chunk.frames = frames;
+		}
+		while (added > 0)
+		{
+			std::shared_ptr<CHUNK> chunk = std::make_shared<CHUNK>();
+			chunk->frames = (added < INPUTLOG_CHUNK_FRAMES) ? added : INPUTLOG_CHUNK_FRAMES;
+			chunk->data.assign(columns * chunk->frames, 0);
+			chunk->hashIsValid = false;
+			chunks.push_back(chunk);
+			added -= chunk->frames;
+		}
+	}
+	size = newSize;
+	updateChunkStarts();
+}
+// -----------------------------------------------------------------------------------------------
+void INPUTLOG::restoreHotChanges()
+{
+	if (!hasHotChanges || !size || !hotChanges.empty() || !alreadyCompressed || compressedHotChanges.empty())
+		return;
+	uLongf destlen = joysticksPerFrame[inputType] * size * HOTCHANGE_BYTES_PER_JOY;
+	hotChanges.resize(destlen);
+	uncompress(&hotChanges[0], &destlen, &compressedHotChanges[0], compressedHotChanges.size());
+}
+
 void INPUTLOG::initHotChanges()
 {
+	restoreHotChanges();
 	hotChanges.resize(joysticksPerFrame[inputType] * size * HOTCHANGE_BYTES_PER_JOY);
 }
 
 void INPUTLOG::copyHotChanges(INPUTLOG* sourceOfHotChanges, int limiterFrameOfSource)
 {
+	restoreHotChanges();
 	// copy hot changes from source InputLog
 	if (sourceOfHotChanges && sourceOfHotChanges->hasHotChanges && sourceOfHotChanges->inputType == inputType)
 	{
+		sourceOfHotChanges->restoreHotChanges();
 		int frames_to_copy = sourceOfHotChanges->size;
 		if (frames_to_copy > size)
 			frames_to_copy = size;
@@ -382,9 +710,11 @@ void INPUTLOG::copyHotChanges(INPUTLOG* sourceOfHotChanges, int limiterFrameOfSo
 } 
 void INPUTLOG::inheritHotChanges(INPUTLOG* sourceOfHotChanges)
 {
+	restoreHotChanges();
 	// copy hot changes from source InputLog and fade them
 	if (sourceOfHotChanges && sourceOfHotChanges->hasHotChanges && sourceOfHotChanges->inputType == inputType)
 	{
+		sourceOfHotChanges->restoreHotChanges();
 		int frames_to_copy = sourceOfHotChanges->size;
 		if (frames_to_copy > size)
 			frames_to_copy = size;
@@ -396,9 +726,11 @@ void INPUTLOG::inheritHotChanges(INPUTLOG* sourceOfHotChanges)
 } 
 void INPUTLOG::inheritHotChanges_DeleteSelection(INPUTLOG* sourceOfHotChanges, RowsSelection* frameset)
 {
+	restoreHotChanges();
 	// copy hot changes from source InputLog, but omit deleted frames (which are represented by the "frameset")
 	if (sourceOfHotChanges && sourceOfHotChanges->hasHotChanges && sourceOfHotChanges->inputType == inputType)
 	{
+		sourceOfHotChanges->restoreHotChanges();
 		int bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
 		int frame = 0, pos = 0, source_pos = 0;
 		int this_size = hotChanges.size(), source_size = sourceOfHotChanges->hotChanges.size();
@@ -425,11 +757,13 @@ void INPUTLOG::inheritHotChanges_DeleteSelection(INPUTLOG* sourceOfHotChanges, R
 } 
 void INPUTLOG::inheritHotChanges_InsertSelection(INPUTLOG* sourceOfHotChanges, RowsSelection* frameset)
 {
+	restoreHotChanges();
 	// copy hot changes from source InputLog, but insert filled lines for inserted frames (which are represented by the "frameset")
 	RowsSelection::iterator it(frameset->begin());
 	RowsSelection::iterator frameset_end(frameset->end());
 	if (sourceOfHotChanges && sourceOfHotChanges->hasHotChanges && sourceOfHotChanges->inputType == inputType)
 	{
+		sourceOfHotChanges->restoreHotChanges();
 		int bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
 		int frame = 0, region_len = 0, pos = 0, source_pos = 0;
 		int this_size = hotChanges.size(), source_size = sourceOfHotChanges->hotChanges.size();
@@ -486,10 +820,12 @@ void INPUTLOG::inheritHotChanges_InsertSelection(INPUTLOG* sourceOfHotChanges, R
 }
 void INPUTLOG::inheritHotChanges_DeleteNum(INPUTLOG* sourceOfHotChanges, int start, int frames, bool fadeOld)
 {
+	restoreHotChanges();
 	int bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
 	// copy hot changes from source InputLog up to "start" and from "start+frames" to end
 	if (sourceOfHotChanges && sourceOfHotChanges->hasHotChanges && sourceOfHotChanges->inputType == inputType)
 	{
+		sourceOfHotChanges->restoreHotChanges();
 		int this_size = hotChanges.size(), source_size = sourceOfHotChanges->hotChanges.size();
 		int bytes_to_copy = bytes * start;
 		int dest_pos = 0, source_pos = 0;
@@ -508,10 +844,12 @@ void INPUTLOG::inheritHotChanges_DeleteNum(INPUTLOG* sourceOfHotChanges, int sta
 } 
 void INPUTLOG::inheritHotChanges_InsertNum(INPUTLOG* sourceOfHotChanges, int start, int frames, bool fadeOld)
 {
+	restoreHotChanges();
 	int bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
 	// copy hot changes from source InputLog up to "start", then make a gap, then copy from "start+frames" to end
 	if (sourceOfHotChanges && sourceOfHotChanges->hasHotChanges && sourceOfHotChanges->inputType == inputType)
 	{
+		sourceOfHotChanges->restoreHotChanges();
 		int this_size = hotChanges.size(), source_size = sourceOfHotChanges->hotChanges.size();
 		int bytes_to_copy = bytes * start;
 		int dest_pos = 0, source_pos = 0;
@@ -532,6 +870,7 @@ void INPUTLOG::inheritHotChanges_InsertNum(INPUTLOG* sourceOfHotChanges, int sta
 }
 void INPUTLOG::inheritHotChanges_PasteInsert(INPUTLOG* sourceOfHotChanges, RowsSelection* insertedSet)
 {
+	restoreHotChanges();
 	// copy hot changes from source InputLog and insert filled lines for inserted frames (which are represented by "inserted_set")
 	int bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
 	int frame = 0, pos = 0;
@@ -541,6 +880,7 @@ void INPUTLOG::inheritHotChanges_PasteInsert(INPUTLOG* sourceOfHotChanges, RowsS
 
 	if (sourceOfHotChanges && sourceOfHotChanges->hasHotChanges && sourceOfHotChanges->inputType == inputType)
 	{
+		sourceOfHotChanges->restoreHotChanges();
 		int source_pos = 0;
 		int source_size = sourceOfHotChanges->hotChanges.size();
 		while (pos < this_size)
@@ -615,6 +955,7 @@ void INPUTLOG::setMaxHotChangeBits(int frame, int joypad, uint8 joyBits)
 void INPUTLOG::setMaxHotChanges(int frame, int absoluteButtonNumber)
 {
 	if (frame < 0 || frame >= size || !hasHotChanges) return;
+	restoreHotChanges();
 	// set max value to the button hotness
 	if (absoluteButtonNumber & 1)
 		hotChanges[frame * (HOTCHANGE_BYTES_PER_JOY * joysticksPerFrame[inputType]) + (absoluteButtonNumber >> 1)] |= BYTE_VALUE_CONTAINING_MAX_HOTCHANGE_HI;
@@ -624,6 +965,7 @@ void INPUTLOG::setMaxHotChanges(int frame, int absoluteButtonNumber)
 
 void INPUTLOG::fadeHotChanges(int startByte, int endByte)
 {
+	restoreHotChanges();
 	uint8 hi_half, low_half;
 	if (endByte < 0)
 		endByte = hotChanges.size();
@@ -644,6 +986,7 @@ int INPUTLOG::getHotChangesInfo(int frame, int absoluteButtonNumber)
 {
 	if (!hasHotChanges || frame < 0 || frame >= size || absoluteButtonNumber < 0 || absoluteButtonNumber >= NUM_JOYPAD_BUTTONS * joysticksPerFrame[inputType])
 		return 0;
+	restoreHotChanges();
 
 	uint8 val = hotChanges[frame * (HOTCHANGE_BYTES_PER_JOY * joysticksPerFrame[inputType]) + (absoluteButtonNumber >> 1)];
 
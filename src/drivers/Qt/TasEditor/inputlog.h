@@ -2,6 +2,7 @@
 #pragma once
 #include <stdint.h>
 #include <vector>
+#include <memory>
 
 #include "fceu.h"
 #include "movie.h"
@@ -20,6 +21,9 @@ enum INPUT_TYPES
 #define BUTTONS_PER_JOYSTICK 8
 #define BYTES_PER_JOYSTICK 1			// 1 byte per 1 joystick (8 buttons)
 
+#define INPUTLOG_CHUNK_FRAMES 1024						// Input is kept in chunks of this many frames
+#define INPUTLOG_MAX_CHUNK_FRAMES (INPUTLOG_CHUNK_FRAMES * 2)	// a chunk that grows beyond this is split
+
 #define HOTCHANGE_BITS_PER_VALUE 4		// any HotChange value takes 4 bits
 #define HOTCHANGE_BITMASK 0xF			// "1111"
 #define HOTCHANGE_MAX_VALUE 0xF			// "1111" max
@@ -33,7 +37,7 @@ class INPUTLOG
 {
 public:
 	INPUTLOG();
-	void init(MovieData& md, bool hotchanges, int force_input_type = -1);
+	void init(MovieData& md, bool hotchanges, int force_input_type = -1, INPUTLOG* previous = NULL);	// unchanged chunks of "previous" are shared instead of copied
 	void reinit(MovieData& md, bool hotchanges, int frame_of_change);		// used when combining consecutive Recordings
 	void toMovie(MovieData& md, int start = 0, int end = -1);
 
@@ -43,6 +47,7 @@ public:
 
 	void compressData(void);
 	bool isAlreadyCompressed(void);
+	void releaseHotChanges(void);
 
 	int findFirstChange(INPUTLOG& theirLog, int start = 0, int end = -1);
 	int findFirstChange(MovieData& md, int start = 0, int end = -1);
@@ -77,6 +82,28 @@ public:
 	bool hasHotChanges;
 
 private:
+	// a run of consecutive frames, stored column by column: joystick 0, joystick 1, ..., commands
+	// chunks are shared between copies of an InputLog and only cloned when one of them writes to it
+	struct CHUNK
+	{
+		int frames;
+		std::vector<uint8_t> data;	// (joysticks + 1) columns of "frames" bytes
+		uint64_t hash;
+		bool hashIsValid;
+	};
+
+	int getNumColumns();
+	int findChunk(int frame);
+	CHUNK& getWritableChunk(int index);
+	uint64_t getChunkHash(int index);
+	void buildChunks(const uint8_t* joys, const uint8_t* cmds);
+	void appendChunks(MovieData& md, int start, int end);
+	bool chunkMatchesMovie(const CHUNK& chunk, MovieData& md, int start);
+	int findChunkStartingAt(int frame);
+	void restoreHotChanges();
+	void splitChunk(int index);
+	void updateChunkStarts();
+	void resizeFrames(int newSize);
 	
 	// also saved data
 	std::vector<uint8_t> compressedJoysticks;
@@ -85,8 +112,10 @@ private:
 
 	// not saved data
 	std::vector<uint8_t> hotChanges;		// Format: buttons01joy0-for-frame0, buttons23joy0-for-frame0, buttons45joy0-for-frame0, buttons67joy0-for-frame0, buttons01joy1-for-frame0, ...
-	std::vector<uint8_t> joysticks;		// Format: joy0-for-frame0, joy1-for-frame0, joy2-for-frame0, joy3-for-frame0, joy0-for-frame1, joy1-for-frame1, ...
-	std::vector<uint8_t> commands;		// Format: commands-for-frame0, commands-for-frame1, ...
+									// empty after releaseHotChanges() until the map is needed again
+	std::vector<std::shared_ptr<CHUNK>> chunks;	// joysticks and commands, INPUTLOG_CHUNK_FRAMES per chunk until frames are inserted or erased
+	std::vector<int> chunkStarts;		// first frame of every chunk
+	int lastChunk;					// chunk of the last lookup, Piano Roll reads rows in order
 	bool alreadyCompressed;			// to compress only once
 };
 
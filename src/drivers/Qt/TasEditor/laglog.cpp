@@ -9,7 +9,8 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 ------------------------------------------------------------------------------------
 LagLog - Log of Lag appearance
 
-* stores the frame-by-frame log of lag appearance
+* stores the frame-by-frame log of lag appearance as two bitsets (known frames and lag frames) with rank/select
+* answers lag counts over ranges and finds the next/previous lag frame without scanning
 * implements compression and decompression of stored data
 * saves and loads the data from a project file. On error: sends warning to caller
 * provides interface for reading and writing log data
@@ -27,15 +28,20 @@ LAGLOG::LAGLOG(void)
 
 void LAGLOG::reset(void)
 {
-	lagLog.resize(0);
+	knownFrames.reset();
+	lagFrames.reset();
 	alreadyCompressed = false;
 }
 
 void LAGLOG::compressData(void)
 {
-	unsigned int len = lagLog.size() * sizeof(uint8);
+	unsigned int len = knownFrames.size() * sizeof(uint8);
 	if (len)
 	{
+		// the project file keeps one byte per frame
+		std::vector<uint8_t> lagLog(len);
+		for (unsigned int i = 0; i < len; ++i)
+			lagLog[i] = getLagInfoAtFrame(i);
 		uLongf comprlen = (len>>9)+12 + len;
 		compressedLagLog.resize(comprlen, LAGGED_UNKNOWN);
 		compress(&compressedLagLog[0], &comprlen, (uint8*)&lagLog[0], len);
@@ -60,7 +66,7 @@ void LAGLOG::resetCompressedStatus(void)
 void LAGLOG::save(EMUFILE *os)
 {
 	// write size
-	unsigned int size = lagLog.size();
+	unsigned int size = knownFrames.size();
 	write32le(size, os);
 	if (size)
 	{
@@ -78,18 +84,30 @@ bool LAGLOG::load(EMUFILE *is)
 	if (read32le(&size, is))
 	{
 		alreadyCompressed = true;
-		lagLog.resize(size, LAGGED_UNKNOWN);
+		knownFrames.reset();
+		lagFrames.reset();
 		if (size)
 		{
 			// read and uncompress array
+			std::vector<uint8_t> lagLog(size, LAGGED_UNKNOWN);
 			unsigned int comprlen;
-			uLongf destlen = size * sizeof(int);
+			uLongf destlen = size;
 			if (!read32le(&comprlen, is)) return true;
 			if (comprlen == 0) return true;
 			compressedLagLog.resize(comprlen);
 			if (is->fread(&compressedLagLog[0], comprlen) != comprlen) return true;
 			int e = uncompress((uint8*)&lagLog[0], &destlen, &compressedLagLog[0], comprlen);
 			if (e != Z_OK && e != Z_BUF_ERROR) return true;
+			knownFrames.resize(size);
+			lagFrames.resize(size);
+			for (unsigned int i = 0; i < size; ++i)
+			{
+				if (lagLog[i] == LAGGED_YES || lagLog[i] == LAGGED_NO)
+				{
+					knownFrames.set(i, true);
+					lagFrames.set(i, lagLog[i] == LAGGED_YES);
+				}
+			}
 		}
 		else
 		{
@@ -119,60 +137,49 @@ bool LAGLOG::skipLoad(EMUFILE *is)
 // -------------------------------------------------------------------------------------------------
 void LAGLOG::invalidateFromFrame(int frame)
 {
-	if (frame >= 0 && static_cast<size_t>(frame) < lagLog.size())
+	if (frame >= 0 && frame < knownFrames.size())
 	{
-		lagLog.resize(frame);
+		knownFrames.resize(frame);
+		lagFrames.resize(frame);
 		alreadyCompressed = false;
 	}
 }
 
 void LAGLOG::setLagInfo(int frame, bool lagFlag)
 {
-	if (lagLog.size() <= static_cast<size_t>(frame))
-		lagLog.resize(frame + 1, LAGGED_UNKNOWN);
-
-	if (lagFlag)
-		lagLog[frame] = LAGGED_YES;
-	else
-		lagLog[frame] = LAGGED_NO;
+	if (frame < 0) return;
+	if (knownFrames.size() <= frame)
+	{
+		knownFrames.resize(frame + 1);
+		lagFrames.resize(frame + 1);
+	}
+	knownFrames.set(frame, true);
+	lagFrames.set(frame, lagFlag);
 
 	alreadyCompressed = false;
 }
 void LAGLOG::eraseFrame(int frame, int numFrames)
 {
-	if ( static_cast<size_t>(frame) < lagLog.size())
+	if (frame >= 0 && frame < knownFrames.size() && numFrames >= 1)
 	{
-		if (numFrames == 1)
-		{
-			// erase 1 frame
-			lagLog.erase(lagLog.begin() + frame);
-			alreadyCompressed = false;
-		}
-		else if (numFrames > 1)
-		{
-			// erase many frames
-			if ( static_cast<size_t>(frame + numFrames) > lagLog.size())
-				numFrames = static_cast<int>(lagLog.size()) - frame;
-			lagLog.erase(lagLog.begin() + frame, lagLog.begin() + (frame + numFrames));
-			alreadyCompressed = false;
-		}
+		knownFrames.erase(frame, numFrames);
+		lagFrames.erase(frame, numFrames);
+		alreadyCompressed = false;
 	}
 }
 void LAGLOG::insertFrame(int frame, bool lagFlag, int numFrames)
 {
-	if ( static_cast<size_t>(frame) < lagLog.size())
+	if (frame < 0) return;
+	if (frame < knownFrames.size())
 	{
 		// insert
-		lagLog.insert(lagLog.begin() + frame, numFrames, (lagFlag) ? LAGGED_YES : LAGGED_NO);
+		knownFrames.insert(frame, numFrames, true);
+		lagFrames.insert(frame, numFrames, lagFlag);
 	}
 	else
 	{
 		// append
-		lagLog.resize(frame + 1, LAGGED_UNKNOWN);
-		if (lagFlag)
-			lagLog[frame] = LAGGED_YES;
-		else
-			lagLog[frame] = LAGGED_NO;
+		setLagInfo(frame, lagFlag);
 	}
 	alreadyCompressed = false;
 }
@@ -180,35 +187,55 @@ void LAGLOG::insertFrame(int frame, bool lagFlag, int numFrames)
 // getters
 int LAGLOG::getSize(void)
 {
-	return lagLog.size();
+	return knownFrames.size();
 }
 int LAGLOG::getLagInfoAtFrame(int frame)
 {
-	if (static_cast<size_t>(frame) < lagLog.size())
-		return lagLog[frame];
+	if (knownFrames.get(frame))
+		return lagFrames.get(frame) ? LAGGED_YES : LAGGED_NO;
 	else
 		return LAGGED_UNKNOWN;
 }
 
+int LAGLOG::countLagFrames(int start, int end)
+{
+	if (end < start) return 0;
+	return lagFrames.rank(end + 1) - lagFrames.rank(start);
+}
+int LAGLOG::findNextLagFrame(int frame)
+{
+	return lagFrames.findNext(frame);
+}
+int LAGLOG::findPrevLagFrame(int frame)
+{
+	return lagFrames.findPrev(frame);
+}
+
 int LAGLOG::findFirstChange(LAGLOG& theirLog)
 {
 	// search for differences to the end of this or their LagLog, whichever is less
-	int end = lagLog.size() - 1;
-	int their_log_end = theirLog.getSize() - 1;
-	if (end > their_log_end)
-		end = their_log_end;
+	int end = knownFrames.size();
+	if (end > theirLog.getSize())
+		end = theirLog.getSize();
 
-	uint8 my_lag_info, their_lag_info;
-	for (int i = 0; i <= end; ++i)
+	// compare 64 frames at a time: a difference counts only where both infos are known
+	int num_words = (end + 63) >> 6;
+	for (int i = 0; i < num_words; ++i)
 	{
-		// if old info != new info and both infos are known
-		my_lag_info = lagLog[i];
-		their_lag_info = theirLog.getLagInfoAtFrame(i);
-		if ((my_lag_info == LAGGED_YES && their_lag_info == LAGGED_NO) || (my_lag_info == LAGGED_NO && their_lag_info == LAGGED_YES))
-			return i;
+		uint64_t diff = knownFrames.getWord(i) & theirLog.knownFrames.getWord(i) & (lagFrames.getWord(i) ^ theirLog.lagFrames.getWord(i));
+		if (i == num_words - 1 && (end & 63))
+			diff &= (1ULL << (end & 63)) - 1;
+		if (diff)
+		{
+			int frame = i * 64;
+			while (!(diff & 1))
+			{
+				diff >>= 1;
+				frame++;
+			}
+			return frame;
+		}
 	}
 	// no difference was found
 	return -1;
 }
-
-
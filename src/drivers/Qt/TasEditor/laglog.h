@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include <vector>
 
+#include "Qt/TasEditor/rankbitset.h"
+
 enum LAG_FLAG_VALUES
 {
 	LAGGED_NO = 0,
@@ -33,13 +35,18 @@ public:
 	int getSize(void);
 	int getLagInfoAtFrame(int frame);
 
+	int countLagFrames(int start, int end);		// lag frames from start to end (inclusive)
+	int findNextLagFrame(int frame);			// first lag frame at or after the frame, -1 if none
+	int findPrevLagFrame(int frame);			// last lag frame at or before the frame, -1 if none
+
 	int findFirstChange(LAGLOG& theirLog);
 
 private:
 	// saved data
-	std::vector<uint8_t> compressedLagLog;
+	std::vector<uint8_t> compressedLagLog;	// one LAG_FLAG_VALUES byte per frame, compressed
 
 	// not saved data
-	std::vector<uint8_t> lagLog;
+	RANK_BITSET knownFrames;		// set if the lag info of the frame is known
+	RANK_BITSET lagFrames;			// set if the frame is lagged (only for known frames)
 	bool alreadyCompressed;			// to compress only once
 };
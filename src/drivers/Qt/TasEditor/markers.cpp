@@ -51,8 +51,8 @@ bool MARKERS::load(EMUFILE *is)
 	uint32_t size=0;
 	if (read32le(&size, is))
 	{
-		markersArray.resize(size);
 		// read and uncompress array
+		std::vector<int> ids(size);
 		alreadyCompressed = true;
 		uint32_t comprlen, len;
 		uLongf destlen = size * sizeof(int);
@@ -60,8 +60,12 @@ bool MARKERS::load(EMUFILE *is)
 		if (comprlen <= 0) return true;
 		compressedMarkersArray.resize(comprlen);
 		if (is->fread(&compressedMarkersArray[0], comprlen) != comprlen) return true;
-		int e = uncompress((uint8*)&markersArray[0], &destlen, &compressedMarkersArray[0], comprlen);
+		int e = uncompress((uint8*)ids.data(), &destlen, &compressedMarkersArray[0], comprlen);
 		if (e != Z_OK && e != Z_BUF_ERROR) return true;
+		markersArray.reset();
+		markersArray.resize(size);
+		for (uint32_t i = 0; i < size; ++i)
+			if (ids[i]) markersArray.set(i, true);
 		// read notes
 		if (read32le(&size, is))
 		{
@@ -105,10 +109,15 @@ bool MARKERS::skipLoad(EMUFILE *is)
 
 void MARKERS::compressData()
 {
-	uint32_t len = markersArray.size() * sizeof(int);
+	// the project file keeps the Marker number of every frame
+	int size = markersArray.size();
+	std::vector<int> ids(size);
+	for (int i = 0, id = 0; i < size; ++i)
+		if (markersArray.get(i)) ids[i] = ++id;
+	uint32_t len = size * sizeof(int);
 	uLongf comprlen = (len>>9)+12 + len;
 	compressedMarkersArray.resize(comprlen);
-	compress(&compressedMarkersArray[0], &comprlen, (uint8*)&markersArray[0], len);
+	compress(&compressedMarkersArray[0], &comprlen, (uint8*)ids.data(), len);
 	compressedMarkersArray.resize(comprlen);
 	alreadyCompressed = true;
 }
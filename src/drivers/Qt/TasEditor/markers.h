@@ -5,6 +5,7 @@
 #include <string>
 
 #include "fceu.h"
+#include "Qt/TasEditor/rankbitset.h"
 #define MAX_NOTE_LEN 100
 
 class MARKERS
@@ -23,7 +24,7 @@ public:
 	// saved data
 	std::vector<std::string> notes;		// Format: 0th - note for intro (Marker 0), 1st - note for Marker1, 2nd - note for Marker2, ...
 	// not saved data
-	std::vector<int> markersArray;		// Format: 0th = Marker number (id) for frame 0, 1st = Marker number for frame 1, ...
+	RANK_BITSET markersArray;		// Format: bit is set for every frame that has a Marker, the Marker number (id) of a frame is the number of Markers up to and including it
 
 private:
 	// also saved data
@@ -41,7 +41,7 @@ void MARKERS_MANAGER::init()
 }
 void MARKERS_MANAGER::free()
 {
-	markers.markersArray.resize(0);
+	markers.markersArray.reset();
 	markers.notes.resize(0);
 }
 void MARKERS_MANAGER::reset()
@@ -56,7 +56,7 @@ void MARKERS_MANAGER::reset()
 void MARKERS_MANAGER::update()
 {
 	// the size of current markers_array must be no less then the size of Input
-	if ((int)markers.markersArray.size() < currMovieData.getNumRecords())
+	if (markers.markersArray.size() < currMovieData.getNumRecords())
 		markers.markersArray.resize(currMovieData.getNumRecords());
 }
 
@@ -118,11 +118,13 @@ bool MARKERS_MANAGER::setMarkersArraySize(int newSize)
 {
 	// if we are truncating, clear Markers that are gonna be erased (so that obsolete notes will be erased too)
 	bool markers_changed = false;
-	for (int i = markers.markersArray.size() - 1; i >= newSize; i--)
+	if (newSize < markers.markersArray.size())
 	{
-		if (markers.markersArray[i])
+		int kept = markers.markersArray.rank(newSize);
+		int total = markers.markersArray.count();
+		if (total > kept)
 		{
-			removeMarkerFromFrame(i);
+			markers.notes.erase(markers.notes.begin() + kept + 1, markers.notes.begin() + total + 1);
 			markers_changed = true;
 		}
 	}
@@ -132,81 +134,77 @@ bool MARKERS_MANAGER::setMarkersArraySize(int newSize)
 
 int MARKERS_MANAGER::getMarkerAtFrame(int frame)
 {
-	if (frame >= 0 && frame < (int)markers.markersArray.size())
-		return markers.markersArray[frame];
+	if (markers.markersArray.get(frame))
+		return markers.markersArray.rank(frame) + 1;
 	else
 		return 0;
 }
 // finds and returns # of Marker starting from start_frame and searching up
 int MARKERS_MANAGER::getMarkerAboveFrame(int startFrame)
 {
-	if (startFrame >= (int)markers.markersArray.size())
-		startFrame = markers.markersArray.size() - 1;
-	for (; startFrame >= 0; startFrame--)
-		if (markers.markersArray[startFrame]) return markers.markersArray[startFrame];
-	return 0;
+	return getMarkerAboveFrame(markers, startFrame);
 }
 // special version of the function
 int MARKERS_MANAGER::getMarkerAboveFrame(MARKERS& targetMarkers, int startFrame)
 {
-	if (startFrame >= (int)targetMarkers.markersArray.size())
-		startFrame = targetMarkers.markersArray.size() - 1;
-	for (; startFrame >= 0; startFrame--)
-		if (targetMarkers.markersArray[startFrame]) return targetMarkers.markersArray[startFrame];
-	return 0;
+	// Markers are numbered in the order of frames, so this is the number of Markers up to the start_frame
+	if (startFrame < 0)
+		return 0;
+	return targetMarkers.markersArray.rank(startFrame + 1);
 }
 // finds frame where the Marker is set
 int MARKERS_MANAGER::getMarkerFrameNumber(int marker_id)
 {
-	for (int i = markers.markersArray.size() - 1; i >= 0; i--)
-		if (markers.markersArray[i] == marker_id) return i;
-	// didn't find
-	return -1;
+	// zeroth Marker - just assume it's set on frame 0
+	if (marker_id <= 0)
+		return 0;
+	return markers.markersArray.select(marker_id - 1);
+}
+// finds the nearest frame with a Marker at or after the frame, -1 if there's none
+int MARKERS_MANAGER::getNextMarkerFrame(int frame)
+{
+	return markers.markersArray.findNext(frame);
+}
+// finds the nearest frame with a Marker at or before the frame, -1 if there's none
+int MARKERS_MANAGER::getPrevMarkerFrame(int frame)
+{
+	return markers.markersArray.findPrev(frame);
 }
 // returns number of new Marker
 int MARKERS_MANAGER::setMarkerAtFrame(int frame)
 {
 	if (frame < 0)
 		return 0;
-	else if (frame >= (int)markers.markersArray.size())
+	else if (frame >= markers.markersArray.size())
 		markers.markersArray.resize(frame + 1);
-	else if (markers.markersArray[frame])
-		return markers.markersArray[frame];
+	else if (markers.markersArray.get(frame))
+		return getMarkerAtFrame(frame);
 
+	// following Markers' ids increase by themselves
 	int marker_num = getMarkerAboveFrame(frame) + 1;
-	markers.markersArray[frame] = marker_num;
+	markers.markersArray.set(frame, true);
 	if (taseditorConfig->emptyNewMarkerNotes)
 		markers.notes.insert(markers.notes.begin() + marker_num, 1, "");
 	else
 		// copy previous Marker note
 		markers.notes.insert(markers.notes.begin() + marker_num, 1, markers.notes[marker_num - 1]);
-	// increase following Markers' ids
-	int size = markers.markersArray.size();
-	for (frame++; frame < size; ++frame)
-		if (markers.markersArray[frame])
-			markers.markersArray[frame]++;
 	return marker_num;
 }
 void MARKERS_MANAGER::removeMarkerFromFrame(int frame)
 {
-	if (markers.markersArray[frame])
+	if (markers.markersArray.get(frame))
 	{
 		// erase corresponding note
-		markers.notes.erase(markers.notes.begin() + markers.markersArray[frame]);
-		// clear Marker
-		markers.markersArray[frame] = 0;
-		// decrease following Markers' ids
-		int size = markers.markersArray.size();
-		for (frame++; frame < size; ++frame)
-			if (markers.markersArray[frame])
-				markers.markersArray[frame]--;
+		markers.notes.erase(markers.notes.begin() + getMarkerAtFrame(frame));
+		// clear Marker, following Markers' ids decrease by themselves
+		markers.markersArray.set(frame, false);
 	}
 }
 void MARKERS_MANAGER::toggleMarkerAtFrame(int frame)
 {
-	if (frame >= 0 && frame < (int)markers.markersArray.size())
+	if (frame >= 0 && frame < markers.markersArray.size())
 	{
-		if (markers.markersArray[frame])
+		if (markers.markersArray.get(frame))
 			removeMarkerFromFrame(frame);
 		else
 			setMarkerAtFrame(frame);
@@ -216,49 +214,24 @@ void MARKERS_MANAGER::toggleMarkerAtFrame(int frame)
 bool MARKERS_MANAGER::eraseMarker(int frame, int numFrames)
 {
 	bool markers_changed = false;
-	if (frame < (int)markers.markersArray.size())
+	if (frame >= 0 && frame < markers.markersArray.size() && numFrames >= 1)
 	{
-		if (numFrames == 1)
-		{
-			// erase 1 frame
-			// if there's a Marker, first clear it
-			if (markers.markersArray[frame])
-			{
-				removeMarkerFromFrame(frame);
-				markers_changed = true;
-			}
-			// erase 1 frame
-			markers.markersArray.erase(markers.markersArray.begin() + frame);
-		} else
+		if (frame + numFrames > markers.markersArray.size())
+			numFrames = markers.markersArray.size() - frame;
+		// if there are Markers at those frames, first clear their notes
+		int first = markers.markersArray.rank(frame);
+		int num_markers = markers.markersArray.rank(frame + numFrames) - first;
+		if (num_markers)
 		{
-			// erase many frames
-			if (frame + numFrames > (int)markers.markersArray.size())
-				numFrames = (int)markers.markersArray.size() - frame;
-			// if there are Markers at those frames, first clear them
-			for (int i = frame; i < (frame + numFrames); ++i)
-			{
-				if (markers.markersArray[i])
-				{
-					removeMarkerFromFrame(i);
-					markers_changed = true;
-				}
-			}
-			// erase frames
-			markers.markersArray.erase(markers.markersArray.begin() + frame, markers.markersArray.begin() + (frame + numFrames));
+			markers.notes.erase(markers.notes.begin() + first + 1, markers.notes.begin() + first + 1 + num_markers);
+			markers_changed = true;
 		}
+		// erase frames
+		markers.markersArray.erase(frame, numFrames);
 		// check if there were some Markers after this frame
 		// since these Markers were shifted, markers_changed should be set to true
-		if (!markers_changed)
-		{
-			for (int i = markers.markersArray.size() - 1; i >= frame; i--)
-			{
-				if (markers.markersArray[i])
-				{
-					markers_changed = true;		// Markers moved
-					break;
-				}
-			}
-		}
+		if (!markers_changed && markers.markersArray.count() > first)
+			markers_changed = true;		// Markers moved
 	}
 	return markers_changed;
 }
@@ -271,17 +244,9 @@ bool MARKERS_MANAGER::insertEmpty(int at, int numFrames)
 		return false;
 	} else
 	{
-		bool markers_changed = false;
 		// first check if there are Markers after the frame
-		for (int i = markers.markersArray.size() - 1; i >= at; i--)
-		{
-			if (markers.markersArray[i])
-			{
-				markers_changed = true;		// Markers moved
-				break;
-			}
-		}
-		markers.markersArray.insert(markers.markersArray.begin() + at, numFrames, 0);
+		bool markers_changed = markers.markersArray.count() > markers.markersArray.rank(at);		// Markers moved
+		markers.markersArray.insert(at, numFrames, false);
 		return markers_changed;
 	}
 }
@@ -326,30 +291,22 @@ void MARKERS_MANAGER::restoreMarkersFromCopy(MARKERS& source)
 // return true only when difference is found before end frame (not including end frame)
 bool MARKERS_MANAGER::checkMarkersDiff(MARKERS& theirMarkers)
 {
-	int end_my = getMarkersArraySize() - 1;
-	int end_their = theirMarkers.markersArray.size() - 1;
-	int min_end = end_my;
-	int i;
-	// 1 - check if there are any Markers after min_end
-	if (end_my < end_their)
-	{
-		for (i = end_their; i > min_end; i--)
-			if (theirMarkers.markersArray[i])
-				return true;
-	} else if (end_my > end_their)
-	{
-		min_end = end_their;
-		for (i = end_my; i > min_end; i--)
-			if (markers.markersArray[i])
-				return true;
-	}
-	// 2 - check if there's any difference before min_end
-	for (i = min_end; i >= 0; i--)
+	int size_my = getMarkersArraySize();
+	int size_their = theirMarkers.markersArray.size();
+	int min_size = (size_my < size_their) ? size_my : size_their;
+	// 1 - check if there are any Markers after min_size
+	if (markers.markersArray.count() > markers.markersArray.rank(min_size))
+		return true;
+	if (theirMarkers.markersArray.count() > theirMarkers.markersArray.rank(min_size))
+		return true;
+	// 2 - check if there's any difference before min_size
+	if (!markers.markersArray.equalsPrefix(theirMarkers.markersArray, min_size))
+		return true;
+	// same frames have Markers, so the same ids have to have the same notes
+	int num_markers = markers.markersArray.rank(min_size);
+	for (int i = 1; i <= num_markers; ++i)
 	{
-		if (markers.markersArray[i] != theirMarkers.markersArray[i])
-			return true;
-		else if (markers.markersArray[i] &&	// not empty
-			markers.notes[markers.markersArray[i]].compare(theirMarkers.notes[theirMarkers.markersArray[i]]))	// notes differ
+		if (markers.notes[i].compare(theirMarkers.notes[i]))	// notes differ
 			return true;
 	}
 	// 3 - check if there's difference between 0th Notes
@@ -42,6 +42,8 @@ public:
 	int getMarkerAboveFrame(int startFrame);
 	int getMarkerAboveFrame(MARKERS& targetMarkers, int startFrame);		// special version of the function
 	int getMarkerFrameNumber(int markerID);
+	int getNextMarkerFrame(int frame);
+	int getPrevMarkerFrame(int frame);
 
 	int setMarkerAtFrame(int frame);
 	void removeMarkerFromFrame(int frame);
@@ -312,11 +312,8 @@ void PLAYBACK::handleMiddleButtonClick()
 			if (shift_down)
 			{
 				// if Shift is held, seek to nearest Marker
-				int last_frame = markersManager->getMarkersArraySize() - 1;	// the end of movie Markers
-				int target_frame = currFrameCounter + 1;
-				for (; target_frame <= last_frame; ++target_frame)
-					if (markersManager->getMarkerAtFrame(target_frame)) break;
-				if (target_frame <= last_frame)
+				int target_frame = markersManager->getNextMarkerFrame(currFrameCounter + 1);
+				if (target_frame >= 0)
 					startSeekingToFrame(target_frame);
 			}
 			else if (ctrl_down)
@@ -412,8 +409,7 @@ void PLAYBACK::handleRewindFull(int speed)
 	// jump trough "speed" amount of previous Markers
 	while (speed > 0)
 	{
-		for (; index >= 0; index--)
-			if (markersManager->getMarkerAtFrame(index)) break;
+		index = markersManager->getPrevMarkerFrame(index);
 		speed--;
 	}
 	if (index >= 0)
@@ -428,8 +424,9 @@ void PLAYBACK::handleForwardFull(int speed)
 	// jump trough "speed" amount of next Markers
 	while (speed > 0)
 	{
-		for (; index <= last_frame; ++index)
-			if (markersManager->getMarkerAtFrame(index)) break;
+		index = markersManager->getNextMarkerFrame(index);
+		if (index < 0)
+			index = last_frame + 1;
 		speed--;
 	}
 	if (index <= last_frame)
@@ -541,8 +538,9 @@ bool PLAYBACK::setPlaybackAboveOrToFrame(int frame, bool forceStateReload)
 		{
 			// we can remain at current game state
 			break;
-		} else if (!greenzone->isSavestateEmpty(i))
+		} else if (!greenzone->isSavestateEmpty(i) && !(i == frame && i > 0 && greenzone->isSavestatePictureless(i)))
 		{
+			// a state without its picture is only loaded to seek on from
 			state_changed = true;	// after we once tried loading a savestate, we cannot use currFrameCounter state anymore, because the game state might have been corrupted by this loading attempt
 			if (greenzone->loadSavestateOfFrame(i))
 				break;
@@ -0,0 +1,264 @@
+/* ---------------------------------------------------------------------------------
+Implementation file of RANK_BITSET class
+
+(The MIT License)
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------------
+RankBitset - bit per frame with rank/select
+
+* stores one bit per frame in 64-bit words, used by LagLog and Markers
+* keeps a directory of set bit counts per block of RANK_BLOCK_WORDS words, so rank() is O(1) and select() is O(log n)
+* the directory is rebuilt lazily on the first query after a change
+* the bits past the end of the last word are always kept clear
+------------------------------------------------------------------------------------ */
+
+#include <algorithm>
+
+#include "Qt/TasEditor/rankbitset.h"
+
+static inline int countBits(uint64_t w)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcountll(w);
+#else
+	w = w - ((w >> 1) & 0x5555555555555555ULL);
+	w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+	w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int)((w * 0x0101010101010101ULL) >> 56);
+#endif
+}
+// w must not be 0
+static inline int lowestBit(uint64_t w)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(w);
+#else
+	int bit = 0;
+	while (!(w & 1))
+	{
+		w >>= 1;
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+RANK_BITSET::RANK_BITSET()
+{
+	numBits = 0;
+	ranksAreValid = false;
+}
+
+void RANK_BITSET::reset()
+{
+	words.resize(0);
+	blockRanks.resize(0);
+	numBits = 0;
+	ranksAreValid = false;
+}
+
+int RANK_BITSET::size() const
+{
+	return numBits;
+}
+void RANK_BITSET::resize(int newSize)
+{
+	if (newSize < 0) newSize = 0;
+	if (newSize < numBits)
+	{
+		truncate(newSize);
+	} else
+	{
+		numBits = newSize;
+		words.resize((newSize + 63) >> 6, 0);
+	}
+	ranksAreValid = false;
+}
+
+bool RANK_BITSET::get(int pos) const
+{
+	if (pos < 0 || pos >= numBits) return false;
+	return (words[pos >> 6] >> (pos & 63)) & 1;
+}
+void RANK_BITSET::set(int pos, bool value)
+{
+	if (pos < 0 || pos >= numBits) return;
+	if (value)
+		words[pos >> 6] |= 1ULL << (pos & 63);
+	else
+		words[pos >> 6] &= ~(1ULL << (pos & 63));
+	ranksAreValid = false;
+}
+void RANK_BITSET::insert(int at, int num, bool value)
+{
+	if (at < 0 || num <= 0) return;
+	if (at > numBits)
+		resize(at);
+	// move the bits after "at" aside, then put them back "num" bits further
+	std::vector<uint64_t> tail;
+	int tailBits = numBits - at;
+	for (int pos = at; pos < numBits; pos += 64)
+		tail.push_back(readBits(pos));
+	truncate(at);
+	resize(at + num + tailBits);
+	if (value)
+		fill(at, num);
+	for (int i = 0; i < (int)tail.size(); ++i)
+		orBits(at + num + i * 64, tail[i]);
+}
+void RANK_BITSET::erase(int at, int num)
+{
+	if (at < 0 || at >= numBits || num <= 0) return;
+	if (at + num > numBits)
+		num = numBits - at;
+	std::vector<uint64_t> tail;
+	int tailBits = numBits - at - num;
+	for (int pos = at + num; pos < numBits; pos += 64)
+		tail.push_back(readBits(pos));
+	truncate(at);
+	resize(at + tailBits);
+	for (int i = 0; i < (int)tail.size(); ++i)
+		orBits(at + i * 64, tail[i]);
+}
+
+int RANK_BITSET::count()
+{
+	return rank(numBits);
+}
+int RANK_BITSET::rank(int pos)
+{
+	if (pos <= 0) return 0;
+	if (pos > numBits) pos = numBits;
+	if (!ranksAreValid)
+		updateRanks();
+	int word = pos >> 6;
+	int result = blockRanks[word / RANK_BLOCK_WORDS];
+	for (int i = word - word % RANK_BLOCK_WORDS; i < word; ++i)
+		result += countBits(words[i]);
+	if (pos & 63)
+		result += countBits(words[word] & ((1ULL << (pos & 63)) - 1));
+	return result;
+}
+int RANK_BITSET::select(int index)
+{
+	if (index < 0) return -1;
+	if (!ranksAreValid)
+		updateRanks();
+	int numBlocks = (int)blockRanks.size() - 1;
+	if (index >= blockRanks[numBlocks]) return -1;
+	// the last block that starts with no more than "index" set bits before it
+	int block = (int)(std::upper_bound(blockRanks.begin(), blockRanks.begin() + numBlocks, index) - blockRanks.begin()) - 1;
+	int result = blockRanks[block];
+	for (int i = block * RANK_BLOCK_WORDS; i < (int)words.size(); ++i)
+	{
+		int bits = countBits(words[i]);
+		if (result + bits > index)
+		{
+			uint64_t w = words[i];
+			for (int skip = index - result; skip > 0; skip--)
+				w &= w - 1;
+			return i * 64 + lowestBit(w);
+		}
+		result += bits;
+	}
+	return -1;
+}
+int RANK_BITSET::findNext(int pos)
+{
+	if (pos < 0) pos = 0;
+	if (pos >= numBits) return -1;
+	return select(rank(pos));
+}
+int RANK_BITSET::findPrev(int pos)
+{
+	if (pos < 0) return -1;
+	int before = rank(pos + 1);
+	if (!before) return -1;
+	return select(before - 1);
+}
+
+bool RANK_BITSET::equalsPrefix(const RANK_BITSET& their, int num) const
+{
+	if (num > numBits || num > their.numBits) return false;
+	int fullWords = num >> 6;
+	for (int i = 0; i < fullWords; ++i)
+		if (words[i] != their.words[i]) return false;
+	if (num & 63)
+	{
+		uint64_t mask = (1ULL << (num & 63)) - 1;
+		if ((words[fullWords] ^ their.words[fullWords]) & mask) return false;
+	}
+	return true;
+}
+
+int RANK_BITSET::getNumWords() const
+{
+	return words.size();
+}
+uint64_t RANK_BITSET::getWord(int index) const
+{
+	if (index < 0 || index >= (int)words.size()) return 0;
+	return words[index];
+}
+
+size_t RANK_BITSET::getMemoryUsage() const
+{
+	return words.capacity() * sizeof(uint64_t) + blockRanks.capacity() * sizeof(int);
+}
+// -------------------------------------------------------------------------------------------------
+// 64 bits starting at pos, bits past the end are clear
+uint64_t RANK_BITSET::readBits(int pos) const
+{
+	int index = pos >> 6, offset = pos & 63;
+	uint64_t bits = (index < (int)words.size()) ? (words[index] >> offset) : 0;
+	if (offset && index + 1 < (int)words.size())
+		bits |= words[index + 1] << (64 - offset);
+	return bits;
+}
+// the bits must not reach past the end
+void RANK_BITSET::orBits(int pos, uint64_t bits)
+{
+	int index = pos >> 6, offset = pos & 63;
+	words[index] |= bits << offset;
+	if (offset && index + 1 < (int)words.size())
+		words[index + 1] |= bits >> (64 - offset);
+	ranksAreValid = false;
+}
+void RANK_BITSET::truncate(int newSize)
+{
+	numBits = newSize;
+	words.resize((newSize + 63) >> 6);
+	if (newSize & 63)
+		words.back() &= (1ULL << (newSize & 63)) - 1;
+	ranksAreValid = false;
+}
+void RANK_BITSET::fill(int at, int num)
+{
+	int end = at + num;
+	while (at < end)
+	{
+		int offset = at & 63;
+		int bits = std::min(64 - offset, end - at);
+		uint64_t mask = (bits == 64) ? ~0ULL : (((1ULL << bits) - 1) << offset);
+		words[at >> 6] |= mask;
+		at += bits;
+	}
+	ranksAreValid = false;
+}
+void RANK_BITSET::updateRanks()
+{
+	int numBlocks = (words.size() + RANK_BLOCK_WORDS - 1) / RANK_BLOCK_WORDS;
+	blockRanks.resize(numBlocks + 1);
+	int total = 0;
+	for (int block = 0; block < numBlocks; ++block)
+	{
+		blockRanks[block] = total;
+		int end = std::min((block + 1) * RANK_BLOCK_WORDS, (int)words.size());
+		for (int i = block * RANK_BLOCK_WORDS; i < end; ++i)
+			total += countBits(words[i]);
+	}
+	blockRanks[numBlocks] = total;
+	ranksAreValid = true;
+}
@@ -0,0 +1,47 @@
+// Specification file for RANK_BITSET class
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define RANK_BLOCK_WORDS 8			// a rank directory entry per 512 bits
+
+class RANK_BITSET
+{
+public:
+	RANK_BITSET();
+	void reset();
+
+	int size() const;
+	void resize(int newSize);		// new bits are clear
+
+	bool get(int pos) const;
+	void set(int pos, bool value);
+	void insert(int at, int num, bool value);
+	void erase(int at, int num);
+
+	int count();					// number of set bits
+	int rank(int pos);				// number of set bits before pos
+	int select(int index);			// position of the index'th set bit (0-based), -1 if there is none
+	int findNext(int pos);			// first set bit at or after pos, -1 if there is none
+	int findPrev(int pos);			// last set bit at or before pos, -1 if there is none
+
+	bool equalsPrefix(const RANK_BITSET& their, int num) const;		// true if the first num bits of both are the same
+
+	int getNumWords() const;
+	uint64_t getWord(int index) const;	// bits past the end are clear
+
+	size_t getMemoryUsage() const;
+
+private:
+	uint64_t readBits(int pos) const;
+	void orBits(int pos, uint64_t bits);
+	void truncate(int newSize);
+	void fill(int at, int num);
+	void updateRanks();
+
+	std::vector<uint64_t> words;
+	std::vector<int> blockRanks;	// number of set bits before each block of RANK_BLOCK_WORDS words
+	int numBits;
+	bool ranksAreValid;
+};
@@ -213,10 +213,7 @@ void SELECTION::jumpToPreviousMarker(int speed)
 	// jump trough "speed" amount of previous Markers
 	while (speed > 0)
 	{
-		for (index--; index >= 0; index--)
-		{
-			if (markersManager->getMarkerAtFrame(index)) break;
-		}
+		index = markersManager->getPrevMarkerFrame(index - 1);
 		speed--;
 	}
 	if (index >= 0)
@@ -237,10 +234,9 @@ void SELECTION::jumpToNextMarker(int speed)
 	// jump trough "speed" amount of previous Markers
 	while (speed > 0)
 	{
-		for (++index; index <= last_frame; ++index)
-		{
-			if (markersManager->getMarkerAtFrame(index)) break;
-		}
+		index = markersManager->getNextMarkerFrame(index + 1);
+		if (index < 0 || index > last_frame)
+			index = last_frame + 1;
 		speed--;
 	}
 	if (index <= last_frame)
@@ -695,15 +691,11 @@ void SELECTION::selectAllRowsBetweenMarkers()
 
 	// find Markers
 	// searching up starting from center-0
-	for (upper_marker = center; upper_marker >= 0; upper_marker--)
-	{
-		if (markersManager->getMarkerAtFrame(upper_marker)) break;
-	}
+	upper_marker = markersManager->getPrevMarkerFrame(center);
 	// searching down starting from center+1
-	for (lower_marker = center+1; lower_marker < movie_size; ++lower_marker)
-	{
-		if (markersManager->getMarkerAtFrame(lower_marker)) break;
-	}
+	lower_marker = markersManager->getNextMarkerFrame(center + 1);
+	if (lower_marker < 0 || lower_marker >= movie_size)
+		lower_marker = movie_size;
 
 	clearAllRowsSelection();
 
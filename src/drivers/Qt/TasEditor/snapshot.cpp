@@ -33,9 +33,9 @@ SNAPSHOT::SNAPSHOT()
 	description[0] = 0;
 }
 
-void SNAPSHOT::init(MovieData& md, LAGLOG& lagLog, bool hotchanges, int enforceInputType)
+void SNAPSHOT::init(MovieData& md, LAGLOG& lagLog, bool hotchanges, int enforceInputType, SNAPSHOT* previous)
 {
-	inputlog.init(md, hotchanges, enforceInputType);
+	inputlog.init(md, hotchanges, enforceInputType, (previous) ? &previous->inputlog : NULL);
 
 	// make a copy of the given laglog
 	laglog = lagLog;
@@ -53,7 +53,9 @@ TASEDITOR_CONFIG::TASEDITOR_CONFIG(void)
 	followUndoContext = true;
 	followMarkerNoteContext = true;
 
-	greenzoneCapacity = GREENZONE_CAPACITY_DEFAULT;
+	greenzoneMemoryLimit = GREENZONE_MEMORY_LIMIT_DEFAULT;
+	greenzoneSpillLimit = GREENZONE_SPILL_LIMIT_DEFAULT;
+	greenzoneLookahead = GREENZONE_LOOKAHEAD_DEFAULT;
 	maxUndoLevels = UNDO_LEVELS_DEFAULT;
 	enableGreenzoning = true;
 	autofirePatternSkipsLag = true;
@@ -119,7 +121,9 @@ void TASEDITOR_CONFIG::load(void)
 	g_config->getOption("SDL.TasEnableHotChanges"                        , &enableHotChanges  );
 	g_config->getOption("SDL.TasFollowUndoContext"                       , &followUndoContext  );
 	g_config->getOption("SDL.TasFollowMarkerNoteContext"                 , &followMarkerNoteContext  );
-	g_config->getOption("SDL.TasGreenzoneCapacity"                       , &greenzoneCapacity  );
+	g_config->getOption("SDL.TasGreenzoneMemoryLimit"                    , &greenzoneMemoryLimit  );
+	g_config->getOption("SDL.TasGreenzoneSpillLimit"                     , &greenzoneSpillLimit  );
+	g_config->getOption("SDL.TasGreenzoneLookahead"                      , &greenzoneLookahead  );
 	g_config->getOption("SDL.TasMaxUndoLevels"                           , &maxUndoLevels  );
 	g_config->getOption("SDL.TasEnableGreenzoning"                       , &enableGreenzoning  );
 	g_config->getOption("SDL.TasAutofirePatternSkipsLag"                 , &autofirePatternSkipsLag  );
@@ -175,7 +179,9 @@ void TASEDITOR_CONFIG::save(void)
 	g_config->setOption("SDL.TasEnableHotChanges"                        , enableHotChanges  );
 	g_config->setOption("SDL.TasFollowUndoContext"                       , followUndoContext  );
 	g_config->setOption("SDL.TasFollowMarkerNoteContext"                 , followMarkerNoteContext  );
-	g_config->setOption("SDL.TasGreenzoneCapacity"                       , greenzoneCapacity  );
+	g_config->setOption("SDL.TasGreenzoneMemoryLimit"                    , greenzoneMemoryLimit  );
+	g_config->setOption("SDL.TasGreenzoneSpillLimit"                     , greenzoneSpillLimit  );
+	g_config->setOption("SDL.TasGreenzoneLookahead"                      , greenzoneLookahead  );
 	g_config->setOption("SDL.TasMaxUndoLevels"                           , maxUndoLevels  );
 	g_config->setOption("SDL.TasEnableGreenzoning"                       , enableGreenzoning  );
 	g_config->setOption("SDL.TasAutofirePatternSkipsLag"                 , autofirePatternSkipsLag  );
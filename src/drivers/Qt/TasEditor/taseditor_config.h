@@ -1,9 +1,17 @@
 // Specification file for TASEDITOR_CONFIG class
 #pragma once
 
-#define GREENZONE_CAPACITY_MIN 1
-#define GREENZONE_CAPACITY_MAX 50000	// this limitation is here just because we're running in 32-bit OS, so there's 2GB limit of RAM
-#define GREENZONE_CAPACITY_DEFAULT 10000
+#define GREENZONE_MEMORY_LIMIT_MIN 64			// in megabytes
+#define GREENZONE_MEMORY_LIMIT_MAX 65536
+#define GREENZONE_MEMORY_LIMIT_DEFAULT 1024
+
+#define GREENZONE_SPILL_LIMIT_MIN 0				// in megabytes, 0 = discard evicted savestates instead of spilling them to disk
+#define GREENZONE_SPILL_LIMIT_MAX 1048576
+#define GREENZONE_SPILL_LIMIT_DEFAULT 4096
+
+#define GREENZONE_LOOKAHEAD_MIN 0				// in frames, 0 = don't regenerate ahead of the Playback cursor
+#define GREENZONE_LOOKAHEAD_MAX 36000
+#define GREENZONE_LOOKAHEAD_DEFAULT 600
 
 #define UNDO_LEVELS_MIN 1
 #define UNDO_LEVELS_MAX 1000			// this limitation is here just because we're running in 32-bit OS, so there's 2GB limit of RAM
@@ -64,7 +72,9 @@ public:
 	bool followUndoContext;
 	bool followMarkerNoteContext;
 
-	int greenzoneCapacity;
+	int greenzoneMemoryLimit;		// in megabytes
+	int greenzoneSpillLimit;		// in megabytes
+	int greenzoneLookahead;			// in frames
 	int maxUndoLevels;
 
 	bool enableGreenzoning;
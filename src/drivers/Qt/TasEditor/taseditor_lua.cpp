@@ -428,17 +428,11 @@ int TASEDITOR_LUA::applyinputchanges(const char* name)
 					case LUA_CHANGE_TYPE_DELETEFRAMES:
 					{
 						InsertionDeletion_was_made = true;
-						for (int t = pending_changes[i].data; t > 0; t--)
+						currMovieData.eraseRecords(pending_changes[i].frame, pending_changes[i].data);
+						greenzone->lagLog.eraseFrame(pending_changes[i].frame, pending_changes[i].data);
+						if (taseditorConfig->bindMarkersToInput)
 						{
-							if (pending_changes[i].frame < (int)currMovieData.getNumRecords())
-							{
-								currMovieData.eraseRecords(pending_changes[i].frame);
-							}
-							greenzone->lagLog.eraseFrame(pending_changes[i].frame);
-							if (taseditorConfig->bindMarkersToInput)
-							{
-								markersManager->eraseMarker(pending_changes[i].frame);
-							}
+							markersManager->eraseMarker(pending_changes[i].frame, pending_changes[i].data);
 						}
 						break;
 					}
@@ -488,5 +482,73 @@ void TASEDITOR_LUA::clearinputchanges()
 		pending_changes.resize(0);
 	}
 }
+
+// int taseditor.setinputrange(int frame, table input [, string name])
+// writes whole columns of Input starting at the frame, bypassing the list of pending changes
+int TASEDITOR_LUA::setinputrange(int frame, std::vector<int>& joypads, std::vector<std::vector<uint8_t>>& columns, const char* name)
+{
+	if (FCEUMOV_Mode(MOVIEMODE_TASEDITOR))
+	{
+		if (frame < 0) return -1;
+		int end = frame;
+		for (int i = 0; i < (int)joypads.size(); ++i)
+		{
+			if (joypads[i] < LUA_JOYPAD_COMMANDS || joypads[i] > LUA_JOYPAD_4P) return -1;
+			if (frame + (int)columns[i].size() > end)
+				end = frame + columns[i].size();
+		}
+		if (end == frame) return -1;
+		if (end > (int)currMovieData.getNumRecords())
+		{
+			// expand movie once to fit the whole range
+			currMovieData.insertEmpty(-1, end - currMovieData.getNumRecords());
+			markersManager->update();
+		}
+		for (int i = 0; i < (int)joypads.size(); ++i)
+		{
+			const std::vector<uint8_t>& input = columns[i];
+			MovieRecord* record = &currMovieData.records[frame];
+			if (joypads[i] == LUA_JOYPAD_COMMANDS)
+			{
+				for (int t = 0; t < (int)input.size(); ++t)
+					record[t].commands = input[t];
+			} else
+			{
+				int joy = joypads[i] - LUA_JOYPAD_1P;
+				for (int t = 0; t < (int)input.size(); ++t)
+					record[t].joysticks[joy] = input[t];
+			}
+		}
+		// frames were only appended, so the snapshot can inherit hotchanges the easy way
+		int result = history->registerLuaChanges(name, frame, false);
+		if (result >= 0)
+		{
+			greenzone->invalidateAndUpdatePlayback(result);
+		}
+		return result;
+	}
+	else
+	{
+		return -1;
+	}
+}
+
+// table taseditor.evaluatebranches(int frame, table addresses)
+void TASEDITOR_LUA::evaluatebranches(int frame, std::vector<int>& addresses, std::vector<int>& slots, std::vector<std::vector<uint8_t>>& values)
+{
+	if (FCEUMOV_Mode(MOVIEMODE_TASEDITOR))
+	{
+		std::vector<BRANCH_OUTCOME> outcomes;
+		branches->evaluate(frame, addresses, outcomes);
+		for (int i = 0; i < (int)outcomes.size(); ++i)
+		{
+			if (outcomes[i].reached)
+			{
+				slots.push_back(i);
+				values.push_back(outcomes[i].values);
+			}
+		}
+	}
+}
 // --------------------------------------------------------------------------------
 
@@ -65,6 +65,8 @@ public:
 	void submitdeleteframes(int frame, int number);
 	int applyinputchanges(const char* name);
 	void clearinputchanges();
+	int setinputrange(int frame, std::vector<int>& joypads, std::vector<std::vector<uint8_t>>& columns, const char* name);
+	void evaluatebranches(int frame, std::vector<int>& addresses, std::vector<int>& slots, std::vector<std::vector<uint8_t>>& values);
 
 private:
 	std::vector<PENDING_CHANGES> pending_changes;
@@ -185,10 +185,46 @@ TimingConfDialog_t::TimingConfDialog_t(QWidget *parent)
 #ifdef __linux__
 	timingDevSelBox->addItem(tr("Timer FD"), 1);
 #endif
+	timingDevSelBox->addItem(tr("Sleep then Spin"), 2);
+	timingDevSelBox->setToolTip(tr("Sleep then Spin sleeps to about a millisecond short of the frame and spins the rest, for frames on time to the microsecond under load."));
 	hbox->addWidget(new QLabel(tr("Timing Mechanism:")));
 	hbox->addWidget(timingDevSelBox);
 	mainLayout->addLayout(hbox);
 
+	{
+		int displaySync = 0, displayLead = 4;
+
+		g_config->getOption("SDL.EmuDisplaySync", &displaySync);
+		g_config->getOption("SDL.EmuDisplayLead", &displayLead);
+
+		hbox = new QHBoxLayout();
+		displaySyncEna = new QCheckBox(tr("Lock to Display Refresh"));
+		displaySyncEna->setToolTip(tr("With vsync on and a display refresh within 0.4% of the emulated frame rate, run frames at the display's rate so none is dropped or shown twice. The sound is resampled to match."));
+		displaySyncEna->setChecked(displaySync);
+		displayLeadBox = new QSpinBox();
+		displayLeadBox->setRange(1, 16);
+		displayLeadBox->setSuffix(tr(" ms"));
+		displayLeadBox->setValue(displayLead);
+		displayLeadBox->setToolTip(tr("How long before the refresh a frame should be ready; lower is less input latency, too low misses refreshes."));
+
+		hbox->addWidget(displaySyncEna);
+		hbox->addWidget(new QLabel(tr("Frame Ready Ahead:")));
+		hbox->addWidget(displayLeadBox);
+		mainLayout->addLayout(hbox);
+	}
+
+	hbox = new QHBoxLayout();
+	runAheadBox = new QSpinBox();
+	runAheadBox->setRange(0, FCEU_RUNAHEAD_MAX);
+	runAheadBox->setSpecialValueText(tr("Off"));
+	runAheadBox->setSuffix(tr(" frames"));
+	runAheadBox->setValue(FCEUI_GetRunAhead());
+	runAheadBox->setToolTip(tr("Show the picture this many frames ahead, taking away the game's own input lag. Costs one more emulated frame each, and is off while a movie, netplay, the debugger or Lua memory hooks are active."));
+	hbox->addWidget(new QLabel(tr("Run-Ahead:")));
+	hbox->addWidget(runAheadBox);
+	hbox->addStretch(1);
+	mainLayout->addLayout(hbox);
+
 	vbox = new QVBoxLayout();
 	grid = new QGridLayout();
 	ppuOverClockBox = new QGroupBox( tr("Overclocking (Old PPU Only)") );
@@ -201,6 +237,8 @@ TimingConfDialog_t::TimingConfDialog_t(QWidget *parent)
 	postRenderBox      = new QSpinBox();
 	vblankScanlinesBox = new QSpinBox();
 	no7bitSamples      = new QCheckBox( tr("Don't Overclock 7-bit Samples") );
+	lagOverclockBox    = new QCheckBox( tr("Only on Lag Frames of Listed Games") );
+	lagListGameBox     = new QCheckBox( tr("List This Game") );
 
 	postRenderBox->setRange(0, 999);
 	vblankScanlinesBox->setRange(0, 999);
@@ -208,6 +246,8 @@ TimingConfDialog_t::TimingConfDialog_t(QWidget *parent)
 	postRenderBox->setValue( postrenderscanlines );
 	vblankScanlinesBox->setValue( vblankscanlines );
 	no7bitSamples->setChecked( skip_7bit_overclocking );
+	lagOverclockBox->setChecked( lagOverclock );
+	lagOverclockBox->setToolTip( tr("Add the scanlines only to frames that have not read input yet by then, the ones that would lag") );
 
 	vbox->addLayout( grid );
 	grid->addWidget( new QLabel( tr("Post-render") ), 0, 0 );
@@ -215,6 +255,8 @@ TimingConfDialog_t::TimingConfDialog_t(QWidget *parent)
 	grid->addWidget( postRenderBox, 0, 1 );
 	grid->addWidget( vblankScanlinesBox, 1, 1 );
 	vbox->addWidget( no7bitSamples );
+	vbox->addWidget( lagOverclockBox );
+	vbox->addWidget( lagListGameBox );
 
 	closeButton = new QPushButton( tr("Close") );
 	closeButton->setIcon(style()->standardIcon(QStyle::SP_DialogCloseButton));
@@ -250,11 +292,16 @@ TimingConfDialog_t::TimingConfDialog_t(QWidget *parent)
 #endif
 	connect(emuPrioCtlEna, SIGNAL(stateChanged(int)), this, SLOT(emuSchedCtlChange(int)));
 	connect(timingDevSelBox, SIGNAL(activated(int)), this, SLOT(emuTimingMechChange(int)));
+	connect(displaySyncEna, SIGNAL(stateChanged(int)), this, SLOT(displaySyncChanged(int)));
+	connect(displayLeadBox, SIGNAL(valueChanged(int)), this, SLOT(displayLeadChanged(int)));
+	connect(runAheadBox, SIGNAL(valueChanged(int)), this, SLOT(runAheadChanged(int)));
 
 	connect( ppuOverClockBox   , SIGNAL(toggled(bool))    , this, SLOT(overclockingToggled(bool)));
 	connect( postRenderBox     , SIGNAL(valueChanged(int)), this, SLOT(postRenderChanged(int)));
 	connect( vblankScanlinesBox, SIGNAL(valueChanged(int)), this, SLOT(vblankScanlinesChanged(int)));
 	connect( no7bitSamples     , SIGNAL(stateChanged(int)), this, SLOT(no7bitChanged(int)));
+	connect( lagOverclockBox   , SIGNAL(stateChanged(int)), this, SLOT(lagOverclockChanged(int)));
+	connect( lagListGameBox    , SIGNAL(stateChanged(int)), this, SLOT(lagListGameChanged(int)));
 
 	updateTimer  = new QTimer( this );
 
@@ -642,6 +689,41 @@ void TimingConfDialog_t::emuTimingMechChange(int index)
 	FCEU_WRAPPER_UNLOCK();
 }
 //----------------------------------------------------------------------------
+void TimingConfDialog_t::displaySyncChanged(int state)
+{
+	bool enable = (state != Qt::Unchecked);
+
+	FCEU_WRAPPER_LOCK();
+
+	setDisplaySync( enable, displayLeadBox->value() * 1e-3 );
+
+	g_config->setOption("SDL.EmuDisplaySync", enable);
+
+	FCEU_WRAPPER_UNLOCK();
+}
+//----------------------------------------------------------------------------
+void TimingConfDialog_t::displayLeadChanged(int value)
+{
+	FCEU_WRAPPER_LOCK();
+
+	setDisplaySync( getDisplaySync(), value * 1e-3 );
+
+	g_config->setOption("SDL.EmuDisplayLead", value);
+
+	FCEU_WRAPPER_UNLOCK();
+}
+//----------------------------------------------------------------------------
+void TimingConfDialog_t::runAheadChanged(int value)
+{
+	FCEU_WRAPPER_LOCK();
+
+	FCEUI_SetRunAhead( value );
+
+	g_config->setOption("SDL.RunAhead", value);
+
+	FCEU_WRAPPER_UNLOCK();
+}
+//----------------------------------------------------------------------------
 void TimingConfDialog_t::updateTimingMech(void)
 {
 	int mode = getTimingMode();
@@ -693,9 +775,54 @@ void TimingConfDialog_t::no7bitChanged(int value)
 	//printf("Skip 7-bit: %i\n", skip_7bit_overclocking );
 }
 //----------------------------------------------------------------------------
+void TimingConfDialog_t::lagOverclockChanged(int value)
+{
+	FCEU_WRAPPER_LOCK();
+	lagOverclock = (value != Qt::Unchecked);
+	g_config->setOption("SDL.LagOverClock", lagOverclock );
+	FCEU_WRAPPER_UNLOCK();
+}
+//----------------------------------------------------------------------------
+void TimingConfDialog_t::lagListGameChanged(int value)
+{
+	bool listed = (value != Qt::Unchecked);
+
+	FCEU_WRAPPER_LOCK();
+	if ( (GameInfo != NULL) && (listed != FCEUI_LagOverclockListed()) )
+	{
+		std::string games, md5 = md5_asciistr( GameInfo->MD5 );
+
+		g_config->getOption("SDL.LagOverClockGames", &games );
+
+		if ( listed )
+		{
+			if ( !games.empty() )
+			{
+				games += " ";
+			}
+			games += md5;
+		}
+		else
+		{
+			size_t i;
+
+			while ( (i = games.find( md5 )) != std::string::npos )
+			{
+				games.erase( i, md5.size() );
+			}
+		}
+		g_config->setOption("SDL.LagOverClockGames", games );
+		FCEUI_SetLagOverclockGames( games.c_str() );
+	}
+	FCEU_WRAPPER_UNLOCK();
+}
+//----------------------------------------------------------------------------
 void TimingConfDialog_t::updateOverclocking(void)
 {
 	ppuOverClockBox->setEnabled( !newppu );
 	ppuOverClockBox->setChecked( overclock_enabled );
+
+	lagListGameBox->setEnabled( GameInfo != NULL );
+	lagListGameBox->setChecked( FCEUI_LagOverclockListed() );
 }
 //----------------------------------------------------------------------------
@@ -48,11 +48,16 @@ protected:
 	QLabel *guiSchedNiceLabel;
 #endif
 	QComboBox *timingDevSelBox;
+	QCheckBox *displaySyncEna;
+	QSpinBox  *displayLeadBox;
+	QSpinBox  *runAheadBox;
 
 	QGroupBox *ppuOverClockBox;
 	QSpinBox  *postRenderBox;
 	QSpinBox  *vblankScanlinesBox;
 	QCheckBox *no7bitSamples;
+	QCheckBox *lagOverclockBox;
+	QCheckBox *lagListGameBox;
 
 	QTimer    *updateTimer;
 
@@ -77,8 +82,13 @@ private slots:
 	void guiSchedPrioChange(int val);
 	void guiSchedPolicyChange(int index);
 	void emuTimingMechChange(int index);
+	void displaySyncChanged(int state);
+	void displayLeadChanged(int value);
+	void runAheadChanged(int value);
 	void overclockingToggled(bool on);
 	void postRenderChanged(int value);
 	void vblankScanlinesChanged(int value);
 	void no7bitChanged(int value);
+	void lagOverclockChanged(int value);
+	void lagListGameChanged(int value);
 };
@@ -0,0 +1,121 @@
+// TimingHistogram.cpp
+//
+#include <string.h>
+
+#include "Qt/TimingHistogram.h"
+
+static int bucketIndex( uint64_t us )
+{
+	const int EXACT = timingHistogram_t::EXACT;
+
+	if ( us < EXACT )
+	{
+		return (int)us;
+	}
+	int shift = 0;
+
+	while ( (us >> shift) >= EXACT )
+	{
+		shift++;
+	}
+	int idx = EXACT + (shift - 1) * (1 << timingHistogram_t::SUB_BITS) +
+		(int)((us >> shift) - (EXACT >> 1));
+
+	return (idx < timingHistogram_t::BUCKETS) ? idx : timingHistogram_t::BUCKETS - 1;
+}
+
+// Middle of the values that land in a bucket, in microseconds
+static double bucketValue( int idx )
+{
+	const int EXACT = timingHistogram_t::EXACT;
+	const int SUB   = 1 << timingHistogram_t::SUB_BITS;
+
+	if ( idx < EXACT )
+	{
+		return (double)idx;
+	}
+	int rel   = idx - EXACT;
+	int shift = rel / SUB + 1;
+	uint64_t lo = ( (uint64_t)((EXACT >> 1) + (rel % SUB)) ) << shift;
+
+	return (double)lo + (double)(1ULL << shift) * 0.5;
+}
+
+timingHistogram_t::timingHistogram_t(void)
+{
+	reset();
+}
+
+void timingHistogram_t::record( double seconds )
+{
+	uint64_t us = (seconds > 0.0) ? (uint64_t)(seconds * 1e6 + 0.5) : 0;
+
+	bucket[ bucketIndex(us) ].fetch_add( 1, std::memory_order_relaxed );
+	count.fetch_add( 1, std::memory_order_relaxed );
+	totalUs.fetch_add( us, std::memory_order_relaxed );
+
+	uint64_t prev = maxUs.load( std::memory_order_relaxed );
+
+	while ( (us > prev) && !maxUs.compare_exchange_weak( prev, us, std::memory_order_relaxed ) )
+	{
+	}
+}
+
+void timingHistogram_t::getStats( struct timingHistStat_t *stats ) const
+{
+	uint32_t counts[BUCKETS];
+	uint64_t total = 0;
+
+	memset( stats, 0, sizeof(*stats) );
+
+	// the buckets are summed again, count may move on while they are read
+	for (int i=0; i<BUCKETS; i++)
+	{
+		counts[i] = bucket[i].load( std::memory_order_relaxed );
+		total += counts[i];
+	}
+	if ( total == 0 )
+	{
+		return;
+	}
+	const double quantile[3] = { 0.50, 0.90, 0.99 };
+	double *result[3] = { &stats->p50, &stats->p90, &stats->p99 };
+	uint64_t seen = 0;
+	int q = 0;
+
+	for (int i=0; (i<BUCKETS) && (q < 3); i++)
+	{
+		seen += counts[i];
+
+		while ( (q < 3) && (seen >= (uint64_t)(quantile[q] * total + 0.5)) && (seen > 0) )
+		{
+			*result[q++] = bucketValue(i) * 1e-6;
+		}
+	}
+	uint64_t recorded = count.load( std::memory_order_relaxed );
+
+	stats->count = total;
+	stats->total = (double)totalUs.load( std::memory_order_relaxed ) * 1e-6;
+	stats->mean  = stats->total / (double)(recorded ? recorded : total);
+	stats->max   = (double)maxUs.load( std::memory_order_relaxed ) * 1e-6;
+
+	// a percentile is never above the largest value seen
+	for (q=0; q<3; q++)
+	{
+		if ( *result[q] > stats->max )
+		{
+			*result[q] = stats->max;
+		}
+	}
+}
+
+void timingHistogram_t::reset(void)
+{
+	for (int i=0; i<BUCKETS; i++)
+	{
+		bucket[i].store( 0, std::memory_order_relaxed );
+	}
+	count.store( 0, std::memory_order_relaxed );
+	totalUs.store( 0, std::memory_order_relaxed );
+	maxUs.store( 0, std::memory_order_relaxed );
+}
@@ -0,0 +1,43 @@
+// TimingHistogram.h
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Log-linear buckets in microseconds, the way HDR histograms lay them out:
+// exact below 32 us, then 16 buckets per power of two, so any percentile is
+// within 1/16 of the real value up to the top bucket at about 30 s.
+// Recording and reading are lock free, from any thread.
+
+struct timingHistStat_t
+{
+	unsigned long long count;
+	double total;   // seconds, all values added up
+	double mean;
+	double p50;
+	double p90;
+	double p99;
+	double max;
+};
+
+class timingHistogram_t
+{
+	public:
+		static const int SUB_BITS = 4;
+		static const int EXACT    = 2 << SUB_BITS;
+		static const int BUCKETS  = EXACT + 20 * (1 << SUB_BITS);
+
+		timingHistogram_t(void);
+
+		void record( double seconds );
+		void getStats( struct timingHistStat_t *stats ) const;
+		void reset(void);
+
+	private:
+		std::atomic<uint32_t> bucket[BUCKETS];
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> totalUs;
+		std::atomic<uint64_t> maxUs;
+};
@@ -0,0 +1,497 @@
+// TraceLogBinary.cpp
+//
+#include <stdio.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "Qt/TraceLogger.h"
+#include "Qt/TraceLogBinary.h"
+
+//----------------------------------------------------
+static void put16( std::vector<uint8_t> &buf, uint32_t v )
+{
+	buf.push_back( v & 0xff );
+	buf.push_back( (v >> 8) & 0xff );
+}
+//----------------------------------------------------
+static void put32( uint8_t *p, uint32_t v )
+{
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+}
+//----------------------------------------------------
+static uint32_t get32( const uint8_t *p )
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+//----------------------------------------------------
+static void putVarint( std::vector<uint8_t> &buf, uint64_t v )
+{
+	while (v >= 0x80)
+	{
+		buf.push_back( (v & 0x7f) | 0x80 );
+		v >>= 7;
+	}
+	buf.push_back( v );
+}
+//----------------------------------------------------
+// Bounds checked reading of a decompressed chunk
+struct chunkReader_t
+{
+	const uint8_t *p;
+	const uint8_t *end;
+	bool ok;
+
+	chunkReader_t( const uint8_t *data, size_t size )
+		: p(data), end(data + size), ok(true) {}
+
+	uint8_t get8(void)
+	{
+		if (p >= end)
+		{
+			ok = false;
+			return 0;
+		}
+		return *(p++);
+	}
+
+	uint16_t get16(void)
+	{
+		uint16_t v = get8();
+
+		return v | (get8() << 8);
+	}
+
+	uint64_t getVarint(void)
+	{
+		uint64_t v = 0;
+		int shift = 0;
+		uint8_t b;
+
+		do
+		{
+			b = get8();
+			if (shift < 64)
+			{
+				v |= (uint64_t)(b & 0x7f) << shift;
+			}
+			shift += 7;
+		} while ((b & 0x80) && ok);
+
+		return v;
+	}
+
+	void getText( char *txt, size_t maxSize )
+	{
+		size_t len = get8();
+
+		if ((size_t)(end - p) < len)
+		{
+			ok = false;
+			len = 0;
+		}
+		if (len >= maxSize)
+		{
+			memcpy( txt, p, maxSize - 1 );
+			txt[maxSize - 1] = 0;
+		}
+		else
+		{
+			memcpy( txt, p, len );
+			txt[len] = 0;
+		}
+		p += len;
+	}
+};
+//----------------------------------------------------
+//---- Binary Trace Log Writer
+//----------------------------------------------------
+TraceLogBinaryWriter::TraceLogBinaryWriter(void)
+{
+	fp = NULL;
+	error = false;
+	numRecords = 0;
+	lastFrame = lastCycle = lastInstr = 0;
+}
+//----------------------------------------------------
+TraceLogBinaryWriter::~TraceLogBinaryWriter(void)
+{
+	close();
+}
+//----------------------------------------------------
+bool TraceLogBinaryWriter::open( const char *path )
+{
+	uint8_t hdr[12];
+
+	close();
+
+	fp = fopen( path, "wb" );
+
+	if (fp == NULL)
+	{
+		return false;
+	}
+	memcpy( hdr, TRACE_BIN_MAGIC, 8 );
+	put32( &hdr[8], TRACE_BIN_VERSION );
+
+	error = fwrite( hdr, 1, sizeof(hdr), fp ) != sizeof(hdr);
+
+	raw.clear();
+	raw.reserve( chunkSize + 256 );
+	numRecords = 0;
+	lastFrame = lastCycle = lastInstr = 0;
+
+	return !error;
+}
+//----------------------------------------------------
+void TraceLogBinaryWriter::close(void)
+{
+	if (fp == NULL)
+	{
+		return;
+	}
+	flush();
+
+	fclose(fp); fp = NULL;
+}
+//----------------------------------------------------
+bool TraceLogBinaryWriter::add( const traceRecord_t &rec )
+{
+	if (fp == NULL)
+	{
+		return false;
+	}
+
+	if (rec.opSize == 0)
+	{
+		size_t len = strnlen( rec.asmTxt, sizeof(rec.asmTxt) );
+
+		raw.push_back( TRACE_BIN_MESSAGE );
+		raw.push_back( len );
+		raw.insert( raw.end(), rec.asmTxt, rec.asmTxt + len );
+	}
+	else
+	{
+		uint8_t flags = 0;
+		size_t len = rec.asmTxtSize;
+
+		if (rec.callAddr >= 0)
+		{
+			flags |= TRACE_BIN_CALL_ADDR;
+		}
+		if (rec.skippedLines > 0)
+		{
+			flags |= TRACE_BIN_SKIPPED;
+		}
+		raw.push_back( TRACE_BIN_INSTRUCTION );
+		raw.push_back( flags );
+		put16( raw, rec.cpu.PC );
+
+		raw.push_back( rec.opSize );
+		for (int i=0; (i<rec.opSize) && (i<3); i++)
+		{
+			raw.push_back( rec.opCode[i] );
+		}
+		raw.push_back( rec.cpu.A );
+		raw.push_back( rec.cpu.X );
+		raw.push_back( rec.cpu.Y );
+		raw.push_back( rec.cpu.S );
+		raw.push_back( rec.cpu.P );
+
+		putVarint( raw, (uint32_t)(rec.bank + 1) );
+
+		// The counters only grow within a log, so after the first record of
+		// a chunk these are mostly one byte each.
+		putVarint( raw, rec.frameCount - lastFrame );
+		putVarint( raw, rec.cycleCount - lastCycle );
+		putVarint( raw, rec.instrCount - lastInstr );
+
+		lastFrame = rec.frameCount;
+		lastCycle = rec.cycleCount;
+		lastInstr = rec.instrCount;
+
+		if (flags & TRACE_BIN_CALL_ADDR)
+		{
+			put16( raw, rec.callAddr );
+		}
+		if (flags & TRACE_BIN_SKIPPED)
+		{
+			putVarint( raw, rec.skippedLines );
+		}
+		if (len >= sizeof(rec.asmTxt))
+		{
+			len = sizeof(rec.asmTxt) - 1;
+		}
+		raw.push_back( len );
+		raw.insert( raw.end(), rec.asmTxt, rec.asmTxt + len );
+	}
+	numRecords++;
+
+	if (raw.size() >= chunkSize)
+	{
+		flush();
+	}
+	return !error;
+}
+//----------------------------------------------------
+bool TraceLogBinaryWriter::flush(void)
+{
+	if ((fp == NULL) || (numRecords == 0))
+	{
+		return !error;
+	}
+	uLongf packedSize = compressBound( raw.size() );
+	uint8_t hdr[12];
+
+	packed.resize( packedSize );
+
+	if (compress2( packed.data(), &packedSize, raw.data(), raw.size(), Z_BEST_SPEED ) != Z_OK)
+	{
+		error = true;
+	}
+	else
+	{
+		put32( &hdr[0], raw.size() );
+		put32( &hdr[4], packedSize );
+		put32( &hdr[8], numRecords );
+
+		if ( (fwrite( hdr, 1, sizeof(hdr), fp ) != sizeof(hdr)) ||
+		     (fwrite( packed.data(), 1, packedSize, fp ) != packedSize) )
+		{
+			error = true;
+		}
+		fflush(fp);
+	}
+	raw.clear();
+	numRecords = 0;
+	lastFrame = lastCycle = lastInstr = 0;
+
+	return !error;
+}
+//----------------------------------------------------
+//---- Binary Trace Log Reader
+//----------------------------------------------------
+TraceLogBinaryReader::TraceLogBinaryReader(void)
+{
+	fp = NULL;
+	numRecords = 0;
+	cachedChunk = -1;
+}
+//----------------------------------------------------
+TraceLogBinaryReader::~TraceLogBinaryReader(void)
+{
+	close();
+}
+//----------------------------------------------------
+bool TraceLogBinaryReader::open( const char *path )
+{
+	uint8_t hdr[12];
+
+	close();
+
+	fp = fopen( path, "rb" );
+
+	if (fp == NULL)
+	{
+		return false;
+	}
+	if ( (fread( hdr, 1, sizeof(hdr), fp ) != sizeof(hdr)) ||
+	     (memcmp( hdr, TRACE_BIN_MAGIC, 8 ) != 0) ||
+	     (get32( &hdr[8] ) != TRACE_BIN_VERSION) )
+	{
+		close();
+		return false;
+	}
+
+	long fileSize, ofs = ftell(fp);
+
+	fseek( fp, 0, SEEK_END );
+	fileSize = ftell(fp);
+	fseek( fp, ofs, SEEK_SET );
+
+	// A chunk that was cut short, by a crash say, ends the index
+	while (fread( hdr, 1, sizeof(hdr), fp ) == sizeof(hdr))
+	{
+		chunk_t c;
+
+		c.ofs = ftell(fp);
+		c.rawSize = get32( &hdr[0] );
+		c.packedSize = get32( &hdr[4] );
+		c.numRecords = get32( &hdr[8] );
+		c.firstRecord = numRecords;
+
+		if ((fileSize - c.ofs < (long)c.packedSize) || (fseek( fp, c.packedSize, SEEK_CUR ) != 0))
+		{
+			break;
+		}
+		chunks.push_back(c);
+
+		numRecords += c.numRecords;
+	}
+	return true;
+}
+//----------------------------------------------------
+void TraceLogBinaryReader::close(void)
+{
+	if (fp != NULL)
+	{
+		fclose(fp); fp = NULL;
+	}
+	chunks.clear();
+	numRecords = 0;
+	cachedChunk = -1;
+	raw.clear();
+}
+//----------------------------------------------------
+bool TraceLogBinaryReader::loadChunk( size_t idx )
+{
+	if ((int)idx == cachedChunk)
+	{
+		return true;
+	}
+	const chunk_t &c = chunks[idx];
+	std::vector<uint8_t> packed( c.packedSize );
+	uLongf rawSize = c.rawSize;
+
+	cachedChunk = -1;
+	raw.resize( c.rawSize );
+
+	if ( (fseek( fp, c.ofs, SEEK_SET ) != 0) ||
+	     (fread( packed.data(), 1, c.packedSize, fp ) != c.packedSize) )
+	{
+		return false;
+	}
+	if ( (uncompress( raw.data(), &rawSize, packed.data(), c.packedSize ) != Z_OK) ||
+	     (rawSize != c.rawSize) )
+	{
+		return false;
+	}
+	cachedChunk = idx;
+
+	return true;
+}
+//----------------------------------------------------
+size_t TraceLogBinaryReader::read( size_t first, size_t count, std::vector<traceRecord_t> &out )
+{
+	size_t idx = 0, done = 0;
+
+	out.clear();
+
+	if ((fp == NULL) || (first >= numRecords))
+	{
+		return 0;
+	}
+	if (count > numRecords - first)
+	{
+		count = numRecords - first;
+	}
+
+	// last chunk starting at or before first
+	{
+		size_t lo = 0, hi = chunks.size();
+
+		while (hi - lo > 1)
+		{
+			size_t mid = (lo + hi) / 2;
+
+			if (chunks[mid].firstRecord <= first)
+			{
+				lo = mid;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		idx = lo;
+	}
+
+	while ((done < count) && (idx < chunks.size()))
+	{
+		if (!loadChunk(idx))
+		{
+			break;
+		}
+		const chunk_t &c = chunks[idx];
+		chunkReader_t in( raw.data(), raw.size() );
+		uint64_t frame = 0, cycle = 0, instr = 0;
+
+		for (size_t i = c.firstRecord; (i < c.firstRecord + c.numRecords) && (done < count); i++)
+		{
+			traceRecord_t rec;
+			uint8_t type = in.get8();
+
+			if (type == TRACE_BIN_MESSAGE)
+			{
+				in.getText( rec.asmTxt, sizeof(rec.asmTxt) );
+			}
+			else if (type == TRACE_BIN_INSTRUCTION)
+			{
+				uint8_t flags = in.get8();
+
+				rec.cpu.PC = in.get16();
+				rec.opSize = in.get8();
+
+				for (int j=0; j<rec.opSize; j++)
+				{
+					uint8_t b = in.get8();
+
+					if (j < 3)
+					{
+						rec.opCode[j] = b;
+					}
+				}
+				if (rec.opSize > 3)
+				{
+					rec.opSize = 3;
+				}
+				rec.cpu.A = in.get8();
+				rec.cpu.X = in.get8();
+				rec.cpu.Y = in.get8();
+				rec.cpu.S = in.get8();
+				rec.cpu.P = in.get8();
+
+				rec.bank = (int32_t)in.getVarint() - 1;
+
+				frame += in.getVarint();
+				cycle += in.getVarint();
+				instr += in.getVarint();
+
+				rec.frameCount = frame;
+				rec.cycleCount = cycle;
+				rec.instrCount = instr;
+
+				if (flags & TRACE_BIN_CALL_ADDR)
+				{
+					rec.callAddr = in.get16();
+				}
+				if (flags & TRACE_BIN_SKIPPED)
+				{
+					rec.skippedLines = in.getVarint();
+				}
+				in.getText( rec.asmTxt, sizeof(rec.asmTxt) );
+				rec.asmTxtSize = strlen( rec.asmTxt );
+			}
+			else
+			{
+				in.ok = false;
+			}
+
+			if (!in.ok)
+			{
+				return done;
+			}
+			if (i >= first)
+			{
+				out.push_back(rec);
+				done++;
+			}
+		}
+		idx++;
+	}
+	return done;
+}
+//----------------------------------------------------
@@ -0,0 +1,118 @@
+// TraceLogBinary.h
+//
+// Binary trace log files. Rather than a text line per instruction, the disk
+// thread writes a few bytes per trace record and packs them into zlib
+// compressed chunks, so neither the text formatting nor the disk bandwidth
+// limits how long a trace can run. The file is turned into the usual text
+// log on demand, see traceLogBinaryToText().
+//
+// Layout, all integers little-endian:
+//
+//   header:  "FCEUXTRB", uint32 version
+//   chunks:  uint32 rawSize, uint32 packedSize, uint32 numRecords,
+//            packedSize bytes of zlib data holding rawSize bytes of records
+//
+// A record starts with its type. An instruction is
+//
+//   uint8  TRACE_BIN_INSTRUCTION
+//   uint8  flags (TRACE_BIN_CALL_ADDR, TRACE_BIN_SKIPPED)
+//   uint16 PC
+//   uint8  opSize, then opSize opcode bytes
+//   uint8  A, X, Y, S, P
+//   varint bank + 1
+//   varint frame, cycle and instruction count, each as the difference to
+//          the previous instruction of the same chunk
+//   uint16 callAddr      if TRACE_BIN_CALL_ADDR
+//   varint skippedLines  if TRACE_BIN_SKIPPED
+//   uint8  length, then the disassembly text
+//
+// and a message is TRACE_BIN_MESSAGE, uint8 length and the text. Varints
+// are LEB128. Every chunk decodes on its own, which is what lets the reader
+// seek.
+//
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <vector>
+
+struct traceRecord_t;
+
+#define TRACE_BIN_MAGIC      "FCEUXTRB"
+#define TRACE_BIN_VERSION    1
+
+#define TRACE_BIN_INSTRUCTION  1
+#define TRACE_BIN_MESSAGE      2
+
+#define TRACE_BIN_CALL_ADDR  0x01
+#define TRACE_BIN_SKIPPED    0x02
+
+class TraceLogBinaryWriter
+{
+	public:
+		TraceLogBinaryWriter(void);
+		~TraceLogBinaryWriter(void);
+
+		bool open( const char *path );
+		void close(void);
+		bool isOpen(void){ return fp != NULL; }
+
+		// Returns false once writing to the file failed
+		bool add( const traceRecord_t &rec );
+
+		// Compresses and writes what was added since the last chunk
+		bool flush(void);
+
+		// Size of a chunk before it is compressed and written
+		static const size_t chunkSize = 256 * 1024;
+
+	private:
+		FILE *fp;
+		bool  error;
+
+		std::vector<uint8_t> raw;
+		std::vector<uint8_t> packed;
+		uint32_t numRecords;
+
+		uint64_t lastFrame;
+		uint64_t lastCycle;
+		uint64_t lastInstr;
+};
+
+class TraceLogBinaryReader
+{
+	public:
+		TraceLogBinaryReader(void);
+		~TraceLogBinaryReader(void);
+
+		// Reads the header and the chunk index, not the records
+		bool open( const char *path );
+		void close(void);
+
+		size_t size(void){ return numRecords; }
+
+		// Decodes records first to first+count-1 into out. Only the chunks
+		// holding them are read. Returns the number of records decoded.
+		size_t read( size_t first, size_t count, std::vector<traceRecord_t> &out );
+
+	private:
+		struct chunk_t
+		{
+			long     ofs;
+			uint32_t rawSize;
+			uint32_t packedSize;
+			uint32_t numRecords;
+			size_t   firstRecord;
+		};
+
+		bool loadChunk( size_t idx );
+
+		FILE *fp;
+		std::vector<chunk_t> chunks;
+		size_t numRecords;
+
+		// last chunk that was decompressed
+		int cachedChunk;
+		std::vector<uint8_t> raw;
+};
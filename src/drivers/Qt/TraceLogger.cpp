@@ -23,6 +23,8 @@
 #include <stdio.h>
 #include <math.h>
 
+#include <atomic>
+
 #ifdef WIN32
 #include <windows.h>
 #include "../win/TraceFileWriter.h"
@@ -43,6 +45,7 @@
 #include <QMessageBox>
 #include <QShortcut>
 #include <QPainter>
+#include <QProgressDialog>
 #include <QGuiApplication>
 
 #include "../../types.h"
@@ -64,6 +67,7 @@
 #include "Qt/ConsoleWindow.h"
 #include "Qt/ConsoleUtilities.h"
 #include "Qt/TraceLogger.h"
+#include "Qt/TraceLogBinary.h"
 #include "Qt/main.h"
 #include "Qt/dface.h"
 #include "Qt/input.h"
@@ -110,10 +114,48 @@ static int logging = 0;
 static int logging_options = LOG_REGISTERS | LOG_PROCESSOR_STATUS | LOG_TO_THE_LEFT | LOG_MESSAGES | LOG_BREAKPOINTS | LOG_CODE_TABBING;
 static int oldcodecount = 0, olddatacount = 0;
 
-static traceRecord_t *recBuf = NULL;
+// Entry of the in-memory trace buffer. The emulation thread only copies the
+// registers and the operand the instruction saw into one of these, the text
+// is built by the view for the lines it shows, see decodeRingRecord().
+struct traceRingRecord_t
+{
+	uint64_t cycleCount;
+	uint64_t instrCount;
+	uint32_t frameCount;
+	int32_t  skippedLines;
+
+	uint16_t PC;
+	uint16_t effAddr;   // operand address, or the JMP ($xxxx) target
+	uint16_t callAddr;  // subroutine left by an RTS
+	int16_t  bank;
+
+	uint8_t  opCode[3];
+	uint8_t  opSize;
+	uint8_t  A, X, Y, S, P;
+	uint8_t  value;     // byte at effAddr before the instruction ran
+	uint8_t  flags;
+};
+
+#define RING_OVERFLOW   0x01
+#define RING_UNDEFINED  0x02
+#define RING_CALL_ADDR  0x04
+#define RING_WRITE      0x08  // effAddr was stored to, value is the old byte
+#define RING_MESSAGE    0x10  // effAddr indexes recMsgText
+
+// Written by the emulation thread only and read by the view without a lock.
+// recBufSeq counts the records started, it is bumped before a record is
+// written so that a reader can tell which of the records it copied may have
+// been overwritten meanwhile, see readRingRecords().
+static traceRingRecord_t *recBuf = NULL;
 static int recBufMax = 0;
-static int recBufHead = 0;
-static int recBufNum = 0;
+static std::atomic<int> recBufHead(0);
+static std::atomic<int> recBufNum(0);
+static std::atomic<uint64_t> recBufSeq(0);
+
+// Messages are rare, their text lives outside of the records
+#define RING_MSG_SLOTS  256
+static char recMsgText[RING_MSG_SLOTS][64];
+static unsigned int recMsgNext = 0;
 static traceRecord_t *logBuf = NULL;
 static int logBufMax = 3000000;
 // logBufHead and logBufTail are volatile because they are shared use by both the emulation and disk logger threads.
@@ -131,6 +173,7 @@ static HANDLE logFile = INVALID_HANDLE_VALUE;
 static int logFile = -1;
 #endif
 static std::string  logFilePath;
+static bool logFileBinary = false;
 static void* traceRegistrationHandle = nullptr;
 //----------------------------------------------------
 static void initLogOption( const char *name, int bitmask )
@@ -149,6 +192,48 @@ static void initLogOption( const char *name, int bitmask )
 	}
 }
 //----------------------------------------------------
+// "8000-BFFF", or one value for both ends; false when empty
+static bool parseFilterRange( const std::string &s, int *start, int *end )
+{
+	unsigned int a, b;
+	int n = sscanf( s.c_str(), "%x-%x", &a, &b );
+
+	if ( n < 1 )
+	{
+		return false;
+	}
+	*start = a;
+	*end   = (n == 2) ? b : a;
+
+	return true;
+}
+//----------------------------------------------------
+// Hands the filter options to the trace callback, so what they leave
+// out is dropped in the emulator thread before a record is made.
+static bool setTraceFilter(void)
+{
+	TraceFilter f;
+	std::string range;
+	int opt;
+
+	g_config->getOption("SDL.TraceFilterPcRange", &range);
+	parseFilterRange( range, &f.pcStart, &f.pcEnd );
+
+	g_config->getOption("SDL.TraceFilterBankRange", &range);
+	parseFilterRange( range, &f.bankStart, &f.bankEnd );
+
+	g_config->getOption("SDL.TraceFilterSkipNMI", &opt);
+	f.skipNMI = opt ? true : false;
+
+	g_config->getOption("SDL.TraceFilterSampleEvery", &opt);
+	f.sampleEvery = (opt > 1) ? opt : 0;
+
+	g_config->getOption("SDL.TraceFilterStartCondition", &f.startCondition);
+	g_config->getOption("SDL.TraceFilterStopCondition", &f.stopCondition);
+
+	return FCEUI_TraceInstructionSetFilter( traceRegistrationHandle, &f );
+}
+//----------------------------------------------------
 TraceLoggerDialog_t::TraceLoggerDialog_t(QWidget *parent)
 	: QDialog(parent, Qt::Window)
 {
@@ -184,6 +269,15 @@ TraceLoggerDialog_t::TraceLoggerDialog_t(QWidget *parent)
 	// File
 	fileMenu = menuBar->addMenu(tr("&File"));
 
+	// File -> Convert Binary Log
+	act = new QAction(tr("Convert &Binary Log to Text..."), this);
+	act->setStatusTip(tr("Write a Compressed Binary Log out as a Text Log"));
+	connect(act, SIGNAL(triggered()), this, SLOT(convertBinaryLog(void)) );
+
+	fileMenu->addAction(act);
+
+	fileMenu->addSeparator();
+
 	// File -> Close
 	act = new QAction(tr("&Close"), this);
 	act->setShortcut(QKeySequence::Close);
@@ -255,6 +349,7 @@ TraceLoggerDialog_t::TraceLoggerDialog_t(QWidget *parent)
 	connect(logMaxLinesComboBox, SIGNAL(activated(int)), this, SLOT(logMaxLinesChanged(int)));
 
 	logFileCbox = new QCheckBox(tr("Log to File"));
+	logBinaryCbox = new QCheckBox(tr("Compressed Binary"));
 	selLogFileButton = new QPushButton(tr("Browse..."));
 	startStopButton = new QPushButton(tr("Start Logging"));
 	autoUpdateCbox = new QCheckBox(tr("Automatically update this window while logging"));
@@ -266,6 +361,11 @@ TraceLoggerDialog_t::TraceLoggerDialog_t(QWidget *parent)
 	logFileCbox->setChecked( opt );
 	connect(logFileCbox, SIGNAL(stateChanged(int)), this, SLOT(logToFileStateChanged(int)));
 
+	g_config->getOption("SDL.TraceLogBinary", &opt );
+	logBinaryCbox->setChecked( opt );
+	logBinaryCbox->setToolTip( tr("Write records in a compact compressed form instead of text.\nUse File -> Convert Binary Log to Text to read them.") );
+	connect(logBinaryCbox, SIGNAL(stateChanged(int)), this, SLOT(logBinaryStateChanged(int)));
+
 	g_config->getOption("SDL.TraceLogPeriodicWindowUpdate", &opt );
 	autoUpdateCbox->setChecked( opt );
 	connect(autoUpdateCbox, SIGNAL(stateChanged(int)), this, SLOT(autoUpdateStateChanged(int)));
@@ -297,6 +397,7 @@ TraceLoggerDialog_t::TraceLoggerDialog_t(QWidget *parent)
 	hbox = new QHBoxLayout();
 	hbox->addWidget(logFileCbox);
 	hbox->addWidget(selLogFileButton);
+	hbox->addWidget(logBinaryCbox);
 
 	grid->addLayout(hbox, 1, 0, Qt::AlignLeft);
 	grid->addWidget(autoUpdateCbox, 1, 1, Qt::AlignLeft);
@@ -387,6 +488,69 @@ TraceLoggerDialog_t::TraceLoggerDialog_t(QWidget *parent)
 
 	mainLayout->addWidget(frame, 1);
 
+	grid = new QGridLayout();
+	frame = new QGroupBox(tr("Trace Filter"));
+	frame->setLayout(grid);
+
+	std::string stmp;
+
+	filterPcRangeEntry = new QLineEdit();
+	filterPcRangeEntry->setPlaceholderText(tr("Any"));
+	filterPcRangeEntry->setToolTip(tr("Only log code at these addresses, in hex: 8000-BFFF"));
+	g_config->getOption("SDL.TraceFilterPcRange", &stmp);
+	filterPcRangeEntry->setText(tr(stmp.c_str()));
+
+	filterBankRangeEntry = new QLineEdit();
+	filterBankRangeEntry->setPlaceholderText(tr("Any"));
+	filterBankRangeEntry->setToolTip(tr("Only log code from these ROM banks, in hex: 0-3"));
+	g_config->getOption("SDL.TraceFilterBankRange", &stmp);
+	filterBankRangeEntry->setText(tr(stmp.c_str()));
+
+	filterSkipNmiCbox = new QCheckBox(tr("Skip NMI Handler"));
+	g_config->getOption("SDL.TraceFilterSkipNMI", &opt);
+	filterSkipNmiCbox->setChecked(opt);
+
+	filterSampleSpinBox = new QSpinBox();
+	filterSampleSpinBox->setRange(1, 1000000);
+	filterSampleSpinBox->setToolTip(tr("Log one in this many of the instructions that pass the rest of the filter"));
+	g_config->getOption("SDL.TraceFilterSampleEvery", &opt);
+	filterSampleSpinBox->setValue(opt);
+
+	filterStartCondEntry = new QLineEdit();
+	filterStartCondEntry->setToolTip(tr("Start logging at the instruction this breakpoint condition is true for"));
+	g_config->getOption("SDL.TraceFilterStartCondition", &stmp);
+	filterStartCondEntry->setText(tr(stmp.c_str()));
+
+	filterStopCondEntry = new QLineEdit();
+	filterStopCondEntry->setToolTip(tr("Stop logging after the instruction this breakpoint condition is true for"));
+	g_config->getOption("SDL.TraceFilterStopCondition", &stmp);
+	filterStopCondEntry->setText(tr(stmp.c_str()));
+
+	connect(filterPcRangeEntry, SIGNAL(editingFinished(void)), this, SLOT(filterChanged(void)));
+	connect(filterBankRangeEntry, SIGNAL(editingFinished(void)), this, SLOT(filterChanged(void)));
+	connect(filterSkipNmiCbox, SIGNAL(stateChanged(int)), this, SLOT(filterChanged(void)));
+	connect(filterSampleSpinBox, SIGNAL(valueChanged(int)), this, SLOT(filterChanged(void)));
+	connect(filterStartCondEntry, SIGNAL(editingFinished(void)), this, SLOT(filterChanged(void)));
+	connect(filterStopCondEntry, SIGNAL(editingFinished(void)), this, SLOT(filterChanged(void)));
+
+	grid->addWidget(new QLabel(tr("PC Range:")), 0, 0, Qt::AlignLeft);
+	grid->addWidget(filterPcRangeEntry, 0, 1);
+	grid->addWidget(new QLabel(tr("Bank Range:")), 0, 2, Qt::AlignLeft);
+	grid->addWidget(filterBankRangeEntry, 0, 3);
+	grid->addWidget(filterSkipNmiCbox, 0, 4, Qt::AlignLeft);
+
+	grid->addWidget(new QLabel(tr("Start When:")), 1, 0, Qt::AlignLeft);
+	grid->addWidget(filterStartCondEntry, 1, 1);
+	grid->addWidget(new QLabel(tr("Stop When:")), 1, 2, Qt::AlignLeft);
+	grid->addWidget(filterStopCondEntry, 1, 3);
+
+	hbox = new QHBoxLayout();
+	hbox->addWidget(new QLabel(tr("Log Every")));
+	hbox->addWidget(filterSampleSpinBox);
+	grid->addLayout(hbox, 1, 4, Qt::AlignLeft);
+
+	mainLayout->addWidget(frame, 1);
+
 	setLayout(mainLayout);
 
 	traceViewCounter = 0;
@@ -397,6 +561,7 @@ TraceLoggerDialog_t::TraceLoggerDialog_t(QWidget *parent)
 	connect(updateTimer, &QTimer::timeout, this, &TraceLoggerDialog_t::updatePeriodic);
 
 	updateTimer->start(50); // 20hz
+	fceuPauseTimerWhileHidden( this, updateTimer );
 
 	diskThread = new TraceLogDiskThread_t(this);
 
@@ -539,12 +704,32 @@ void TraceLoggerDialog_t::toggleLoggingOnOff(void)
 	}
 	else
 	{
+		FCEU_WRAPPER_LOCK();
+		if (traceRegistrationHandle == nullptr)
+		{
+			traceRegistrationHandle = FCEUI_TraceInstructionRegister( FCEUD_TraceInstruction );
+		}
+		if ( !setTraceFilter() )
+		{
+			FCEUI_TraceInstructionUnregisterHandle( traceRegistrationHandle );
+			traceRegistrationHandle = nullptr;
+			FCEU_WRAPPER_UNLOCK();
+
+			if ( consoleWindow )
+			{
+				consoleWindow->QueueErrorMsgWindow("Error: Trace filter start or stop condition is not valid.");
+			}
+			return;
+		}
+		FCEU_WRAPPER_UNLOCK();
+
 		if (logFileCbox->isChecked())
 		{
 			if ( logFilePath.size() == 0 )
 			{
 				openLogFile();
 			}
+			logFileBinary = logBinaryCbox->isChecked();
 			diskThread->start();
 			msleep(100);
 		}
@@ -553,10 +738,6 @@ void TraceLoggerDialog_t::toggleLoggingOnOff(void)
 		startStopButton->setIcon( style()->standardIcon( QStyle::SP_MediaStop ) );
 
 		FCEU_WRAPPER_LOCK();
-		if (traceRegistrationHandle == nullptr)
-		{
-			traceRegistrationHandle = FCEUI_TraceInstructionRegister( FCEUD_TraceInstruction );
-		}
 		logging = 1;
 		FCEU_WRAPPER_UNLOCK();
 	}
@@ -588,12 +769,20 @@ void TraceLoggerDialog_t::openLogFile(void)
 
 	dialog.setFileMode(QFileDialog::AnyFile);
 
-	dialog.setNameFilter(tr("LOG files (*.log *.LOG) ;; All files (*)"));
+	if (logBinaryCbox->isChecked())
+	{
+		dialog.setNameFilter(tr("Binary Trace files (*.trb *.TRB) ;; All files (*)"));
+		dialog.setDefaultSuffix(tr(".trb"));
+	}
+	else
+	{
+		dialog.setNameFilter(tr("LOG files (*.log *.LOG) ;; All files (*)"));
+		dialog.setDefaultSuffix(tr(".log"));
+	}
 
 	dialog.setViewMode(QFileDialog::List);
 	dialog.setFilter(QDir::AllEntries | QDir::AllDirs | QDir::Hidden);
 	dialog.setLabelText(QFileDialog::Accept, tr("Open"));
-	dialog.setDefaultSuffix(tr(".log"));
 
 	romFile = getRomFile();
 
@@ -642,6 +831,111 @@ void TraceLoggerDialog_t::openLogFile(void)
 	return;
 }
 //----------------------------------------------------
+static QString selectTraceFile( QWidget *parent, const QString &title, const QString &filter,
+		const QString &suffix, bool save )
+{
+	int ret, useNativeFileDialogVal;
+	QString filename;
+	QFileDialog dialog(parent, title);
+
+	dialog.setFileMode( save ? QFileDialog::AnyFile : QFileDialog::ExistingFile );
+	dialog.setAcceptMode( save ? QFileDialog::AcceptSave : QFileDialog::AcceptOpen );
+	dialog.setNameFilter(filter);
+	dialog.setDefaultSuffix(suffix);
+	dialog.setViewMode(QFileDialog::List);
+	dialog.setFilter(QDir::AllEntries | QDir::AllDirs | QDir::Hidden);
+
+	if ( logFilePath.size() != 0 )
+	{
+		std::string dir;
+		getDirFromFile(logFilePath.c_str(), dir);
+		dialog.setDirectory(QString::fromStdString(dir));
+	}
+
+	// Check config option to use native file dialog or not
+	g_config->getOption("SDL.UseNativeFileDialog", &useNativeFileDialogVal);
+
+	dialog.setOption(QFileDialog::DontUseNativeDialog, !useNativeFileDialogVal);
+
+	ret = dialog.exec();
+
+	if (ret)
+	{
+		QStringList fileList;
+		fileList = dialog.selectedFiles();
+
+		if (fileList.size() > 0)
+		{
+			filename = fileList[0];
+		}
+	}
+	return filename;
+}
+//----------------------------------------------------
+void TraceLoggerDialog_t::convertBinaryLog(void)
+{
+	QString binFile, txtFile;
+	TraceLogBinaryReader reader;
+	std::vector<traceRecord_t> recs;
+	const size_t batchSize = 65536;
+	char line[256];
+	FILE *fp;
+
+	binFile = selectTraceFile( this, tr("Select Binary Log File"),
+			tr("Binary Trace files (*.trb *.TRB) ;; All files (*)"), tr(".trb"), false );
+
+	if (binFile.isNull())
+	{
+		return;
+	}
+	if ( !reader.open( binFile.toLocal8Bit().constData() ) )
+	{
+		QMessageBox::critical( this, tr("Error"), tr("Not a binary trace log: ") + binFile );
+		return;
+	}
+
+	txtFile = selectTraceFile( this, tr("Save Text Log As"),
+			tr("LOG files (*.log *.LOG) ;; All files (*)"), tr(".log"), true );
+
+	if (txtFile.isNull())
+	{
+		return;
+	}
+	fp = fopen( txtFile.toLocal8Bit().constData(), "w" );
+
+	if (fp == NULL)
+	{
+		QMessageBox::critical( this, tr("Error"), tr("Failed to open log file for writing: ") + txtFile );
+		return;
+	}
+
+	// The lines come out with the log options currently selected
+	QProgressDialog progress( tr("Converting Binary Log..."), tr("Cancel"), 0, 1000, this );
+
+	progress.setWindowModality(Qt::WindowModal);
+
+	for (size_t i = 0; i < reader.size(); i += batchSize)
+	{
+		if (reader.read( i, batchSize, recs ) == 0)
+		{
+			break;
+		}
+		for (size_t j = 0; j < recs.size(); j++)
+		{
+			recs[j].convToText(line);
+			fputs( line, fp );
+			fputc( '\n', fp );
+		}
+		progress.setValue( (int)((i * 1000) / reader.size()) );
+
+		if (progress.wasCanceled())
+		{
+			break;
+		}
+	}
+	fclose(fp);
+}
+//----------------------------------------------------
 void TraceLoggerDialog_t::hbarChanged(int val)
 {
 	traceView->update();
@@ -733,6 +1027,11 @@ void TraceLoggerDialog_t::logToFileStateChanged(int state)
 	g_config->setOption("SDL.TraceLogSaveToFile", state != Qt::Unchecked );
 }
 //----------------------------------------------------
+void TraceLoggerDialog_t::logBinaryStateChanged(int state)
+{
+	g_config->setOption("SDL.TraceLogBinary", state != Qt::Unchecked );
+}
+//----------------------------------------------------
 void TraceLoggerDialog_t::autoUpdateStateChanged(int state)
 {
 	g_config->setOption("SDL.TraceLogPeriodicWindowUpdate", state != Qt::Unchecked );
@@ -894,6 +1193,26 @@ void TraceLoggerDialog_t::logNewMapCodeChanged(int state)
 	g_config->setOption("SDL.TraceLogNewInstructions", (logging_options & LOG_NEW_INSTRUCTIONS) ? 1 : 0 );
 }
 //----------------------------------------------------
+void TraceLoggerDialog_t::filterChanged(void)
+{
+	g_config->setOption("SDL.TraceFilterPcRange", filterPcRangeEntry->text().toLocal8Bit().constData() );
+	g_config->setOption("SDL.TraceFilterBankRange", filterBankRangeEntry->text().toLocal8Bit().constData() );
+	g_config->setOption("SDL.TraceFilterSkipNMI", filterSkipNmiCbox->isChecked() );
+	g_config->setOption("SDL.TraceFilterSampleEvery", filterSampleSpinBox->value() );
+	g_config->setOption("SDL.TraceFilterStartCondition", filterStartCondEntry->text().toLocal8Bit().constData() );
+	g_config->setOption("SDL.TraceFilterStopCondition", filterStopCondEntry->text().toLocal8Bit().constData() );
+
+	if ( logging )
+	{
+		FCEU_WRAPPER_LOCK();
+		if ( (traceRegistrationHandle != nullptr) && !setTraceFilter() && consoleWindow )
+		{
+			consoleWindow->QueueErrorMsgWindow("Error: Trace filter start or stop condition is not valid.");
+		}
+		FCEU_WRAPPER_UNLOCK();
+	}
+}
+//----------------------------------------------------
 void TraceLoggerDialog_t::logNewMapDataChanged(int state)
 {
 	if (state == Qt::Unchecked)
@@ -1064,14 +1383,14 @@ int initTraceLogBuffer(int maxRecs)
 	{
 		size_t size;
 
-		size = maxRecs * sizeof(traceRecord_t);
+		size = maxRecs * sizeof(traceRingRecord_t);
 
 		if ( recBuf != NULL )
 		{
 			free(recBuf); recBuf = NULL;
 		}
 
-		recBuf = (traceRecord_t *)malloc(size);
+		recBuf = (traceRingRecord_t *)malloc(size);
 
 		if (recBuf)
 		{
@@ -1103,20 +1422,155 @@ void openTraceLoggerWindow(QWidget *parent)
 	traceLogWindow->show();
 }
 //----------------------------------------------------
-static void pushToLogBuffer(traceRecord_t &rec)
+static void pushToRingBuffer(const traceRingRecord_t &r)
+{
+	int head = recBufHead.load(std::memory_order_relaxed);
+	int num  = recBufNum.load(std::memory_order_relaxed);
+
+	recBufSeq.store( recBufSeq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+
+	recBuf[head] = r;
+
+	if ( num < recBufMax )
+	{
+		recBufNum.store( num + 1, std::memory_order_release );
+	}
+	recBufHead.store( (head + 1) % recBufMax, std::memory_order_release );
+}
+//----------------------------------------------------
+// Copies the count records that end dist records before the head into out
+// and sets firstIdx to the buffer index of the first one. Returns a bit mask of the copies that are whole, the others were written
+// by the emulation thread while they were copied.
+static uint64_t readRingRecords(int dist, int count, traceRingRecord_t *out, int *firstIdx)
 {
+	uint64_t seq, written, valid = 0;
+	int head, idx;
+
+	if ( (recBuf == NULL) || (recBufMax == 0) )
+	{
+		return 0;
+	}
+	seq  = recBufSeq.load(std::memory_order_acquire);
+	head = recBufHead.load(std::memory_order_acquire);
 
-	recBuf[recBufHead] = rec;
-	recBufHead = (recBufHead + 1) % recBufMax;
+	idx = head - dist - count;
 
-	if ( recBufNum < recBufMax )
+	while (idx < 0)
 	{
-		recBufNum++;
+		idx += recBufMax;
 	}
+	*firstIdx = idx;
+
+	for (int i = 0; i < count; i++)
+	{
+		out[i] = recBuf[idx];
+		idx = (idx + 1) % recBufMax;
+	}
+	std::atomic_thread_fence( std::memory_order_acquire );
+
+	written = recBufSeq.load(std::memory_order_relaxed) - seq;
+
+	for (int i = 0; i < count; i++)
+	{
+		// number of writes it takes to get to this record, one less since
+		// the write in progress when seq was read is not counted
+		uint64_t ahead = recBufMax - (dist + count - i);
+
+		if ( written < ahead )
+		{
+			valid |= (1ull << i);
+		}
+	}
+	return valid;
+}
+//----------------------------------------------------
+static void decodeRingRecord(const traceRingRecord_t &r, traceRecord_t &rec)
+{
+	int asmFlags = ASM_DEBUG_TRACES;
+	disasmValues_t vals;
+	char asmTxt[256];
+
+	rec = traceRecord_t();
+
+	if ( r.flags & RING_MESSAGE )
+	{
+		strcpy( rec.asmTxt, recMsgText[r.effAddr % RING_MSG_SLOTS] );
+		return;
+	}
+	rec.cpu.PC = r.PC;
+	rec.cpu.A  = r.A;
+	rec.cpu.X  = r.X;
+	rec.cpu.Y  = r.Y;
+	rec.cpu.S  = r.S;
+	rec.cpu.P  = r.P;
+
+	for (int i = 0; i < 3; i++)
+	{
+		rec.opCode[i] = r.opCode[i];
+	}
+	rec.opSize = r.opSize;
+	rec.bank   = r.bank;
+
+	rec.frameCount = r.frameCount;
+	rec.cycleCount = r.cycleCount;
+	rec.instrCount = r.instrCount;
+	rec.skippedLines = r.skippedLines;
+
+	if ( r.flags & RING_CALL_ADDR )
+	{
+		rec.callAddr = r.callAddr;
+	}
+	if ( r.flags & RING_WRITE )
+	{
+		rec.writeAddr   = r.effAddr;
+		rec.preWriteVal = r.value;
+	}
+	else
+	{
+		rec.writeAddr   = -1;
+		rec.preWriteVal = 0;
+	}
+
+	if ( r.flags & RING_OVERFLOW )
+	{
+		rec.flags |= 0x01;
+		return;
+	}
+	if ( r.flags & RING_UNDEFINED )
+	{
+		rec.flags |= 0x02;
+		return;
+	}
+	if ( r.opSize == 0 )
+	{
+		// never written
+		return;
+	}
+	if (logging_options & LOG_SYMBOLIC)
+	{
+		asmFlags |= ASM_DEBUG_SYMS | ASM_DEBUG_REGS;
+	}
+	vals.X = r.X;
+	vals.Y = r.Y;
+	vals.value   = r.value;
+	vals.effAddr = r.effAddr;
+
+	DisassembleWithDebug(r.PC + r.opSize, rec.opCode, asmFlags, asmTxt, NULL, NULL, &vals);
+
+	rec.appendAsmText(asmTxt);
+}
+//----------------------------------------------------
+static void pushToLogBuffer(traceRingRecord_t &r)
+{
+	pushToRingBuffer(r);
 
 	if ( logBuf )
 	{
 		int nextHead, delayCount = 0;
+		traceRecord_t rec;
+
+		decodeRingRecord(r, rec);
 		logBuf[logBufHead] = rec;
 		nextHead = (logBufHead + 1) % logBufMax;
 
@@ -1154,13 +1608,18 @@ static void pushToLogBuffer(traceRecord_t &rec)
 //----------------------------------------------------
 static void pushMsgToLogBuffer(const char *msg)
 {
-	traceRecord_t rec;
+	traceRingRecord_t r;
+	unsigned int slot = recMsgNext++ % RING_MSG_SLOTS;
+
+	strncpy(recMsgText[slot], msg, sizeof(recMsgText[slot]));
 
-	strncpy(rec.asmTxt, msg, sizeof(rec.asmTxt));
+	recMsgText[slot][sizeof(recMsgText[slot]) - 1] = 0;
 
-	rec.asmTxt[sizeof(rec.asmTxt) - 1] = 0;
+	memset(&r, 0, sizeof(r));
+	r.flags   = RING_MESSAGE;
+	r.effAddr = slot;
 
-	pushToLogBuffer(rec);
+	pushToLogBuffer(r);
 }
 //----------------------------------------------------
 int FCEUD_TraceLoggerStart(void)
@@ -1176,6 +1635,10 @@ int FCEUD_TraceLoggerStart(void)
 		{
 			traceRegistrationHandle = FCEUI_TraceInstructionRegister( FCEUD_TraceInstruction );
 		}
+		if ( !setTraceFilter() )
+		{
+			FCEU_printf("Trace filter condition is not valid, logging everything\n");
+		}
 		logging = 1;
 		FCEU_WRAPPER_UNLOCK();
 	}
@@ -1226,38 +1689,35 @@ void FCEUD_FlushTrace()
 //----------------------------------------------------
 void FCEUD_TraceInstruction(uint8 *opcode, int size)
 {
-	if (NetPlayActive())
-	{
-		NetPlayTraceInstruction(opcode, size);
-	}
-
 	if (!logging)
 		return;
 
-	traceRecord_t rec;
+	traceRingRecord_t r;
 
-	char asmTxt[256];
 	unsigned int addr = X.PC;
 	static int unloggedlines = 0;
-	int asmFlags = ASM_DEBUG_TRACES;
 
-	rec.cpu.PC = X.PC;
-	rec.cpu.A = X.A;
-	rec.cpu.X = X.X;
-	rec.cpu.Y = X.Y;
-	rec.cpu.S = X.S;
-	rec.cpu.P = X.P;
+	r.PC = X.PC;
+	r.A = X.A;
+	r.X = X.X;
+	r.Y = X.Y;
+	r.S = X.S;
+	r.P = X.P;
 
-	for (int i = 0; i < size; i++)
+	for (int i = 0; i < 3; i++)
 	{
-		rec.opCode[i] = opcode[i];
+		r.opCode[i] = (i < size) ? opcode[i] : 0;
 	}
-	rec.opSize = size;
-	rec.romAddr = GetPRGAddress(addr);
-	rec.bank = getBank(addr);
+	r.opSize = size;
+	r.bank = getBank(addr);
+	r.flags = 0;
+	r.skippedLines = 0;
+	r.callAddr = 0;
+	r.effAddr = 0;
+	r.value = 0;
 
-	rec.frameCount = currFrameCounter;
-	rec.instrCount = total_instructions;
+	r.frameCount = currFrameCounter;
+	r.instrCount = total_instructions;
 
 	int64 counter_value = timestampbase + (uint64)timestamp - total_cycles_base;
 	if (counter_value < 0) // sanity check
@@ -1265,16 +1725,11 @@ void FCEUD_TraceInstruction(uint8 *opcode, int size)
 		ResetDebugStatisticsCounters();
 		counter_value = 0;
 	}
-	rec.cycleCount = counter_value;
-
-	if (logging_options & LOG_SYMBOLIC)
-	{
-		asmFlags |= ASM_DEBUG_SYMS | ASM_DEBUG_REGS;
-	}
+	r.cycleCount = counter_value;
 
 	// if instruction executed from the RAM, skip this, log all instead
 	// TODO: loops folding mame-lyke style
-	if (rec.romAddr != -1)
+	if ((logging_options & (LOG_NEW_INSTRUCTIONS | LOG_NEW_DATA)) && (GetPRGAddress(addr) != -1))
 	{
 		if (((logging_options & LOG_NEW_INSTRUCTIONS) && (oldcodecount != codecount)) ||
 			((logging_options & LOG_NEW_DATA) && (olddatacount != datacount)))
@@ -1285,127 +1740,116 @@ void FCEUD_TraceInstruction(uint8 *opcode, int size)
 			if (unloggedlines > 0)
 			{
 				//snprintf(str_result, "(%d lines skipped)", unloggedlines);
-				rec.skippedLines = unloggedlines;
+				r.skippedLines = unloggedlines;
 				unloggedlines = 0;
 			}
 		}
 		else
 		{
-			if ((logging_options & LOG_NEW_INSTRUCTIONS) ||
-				(logging_options & LOG_NEW_DATA))
+			if (FCEUI_GetLoggingCD())
 			{
-				if (FCEUI_GetLoggingCD())
-				{
-					unloggedlines++;
-				}
-				return;
+				unloggedlines++;
 			}
+			return;
 		}
 	}
 
 	if ((addr + size) > 0xFFFF)
 	{
-		//snprintf(str_data, "%02X        ", opcode[0]);
-		//snprintf(str_disassembly, "OVERFLOW");
-		rec.flags |= 0x01;
+		r.flags |= RING_OVERFLOW;
+	}
+	else if (size == 0)
+	{
+		r.flags |= RING_UNDEFINED;
 	}
 	else
 	{
-		char *a = 0;
-		switch (size)
+		uint16_t tmp;
+
+		// Operand address and value, as the disassembly would read them now
+		switch (optype[opcode[0]])
 		{
-		case 0:
-			//snprintf(str_disassembly,"UNDEFINED");
-			rec.flags |= 0x02;
+			case 1: // (Indirect,X)
+				tmp = (opcode[1] + X.X) & 0xFF;
+				r.effAddr = GetMem(tmp) | (GetMem((tmp + 1) & 0xFF) << 8);
 			break;
-		case 1:
-		{
-			DisassembleWithDebug(addr + 1, opcode, asmFlags, asmTxt);
-			// special case: an RTS opcode
-			if (opcode[0] == 0x60)
-			{
-				// add the beginning address of the subroutine that we exit from
-				unsigned int caller_addr = GetMem(((X.S) + 1) | 0x0100) + (GetMem(((X.S) + 2) | 0x0100) << 8) - 0x2;
-				if (GetMem(caller_addr) == 0x20)
-				{
-					// this was a JSR instruction - take the subroutine address from it
-					unsigned int call_addr = GetMem(caller_addr + 1) + (GetMem(caller_addr + 2) << 8);
-					rec.callAddr = call_addr;
-				}
-			}
-			a = asmTxt;
+			case 2: // Zero Page
+				r.effAddr = opcode[1];
 			break;
-		}
-		case 2:
-			DisassembleWithDebug(addr + 2, opcode, asmFlags, asmTxt);
-			a = asmTxt;
+			case 3: // Absolute
+				r.effAddr = opcode[1] | (opcode[2] << 8);
+			break;
+			case 4: // (Indirect),Y
+				r.effAddr = (GetMem(opcode[1]) | (GetMem((opcode[1] + 1) & 0xFF) << 8)) + X.Y;
+			break;
+			case 5: // Zero Page,X
+				r.effAddr = (opcode[1] + X.X) & 0xFF;
+			break;
+			case 6: // Absolute,Y
+				r.effAddr = (opcode[1] | (opcode[2] << 8)) + X.Y;
+			break;
+			case 7: // Absolute,X
+				r.effAddr = (opcode[1] | (opcode[2] << 8)) + X.X;
 			break;
-		case 3:
-			DisassembleWithDebug(addr + 3, opcode, asmFlags, asmTxt);
-			a = asmTxt;
+			case 8: // Zero Page,Y
+				r.effAddr = (opcode[1] + X.Y) & 0xFF;
 			break;
 		}
+		if (optype[opcode[0]] != 0)
+		{
+			r.value = GetMem(r.effAddr);
+		}
 
-		if (a)
+		if (opcode[0] == 0x6C)
 		{
-			rec.appendAsmText(a);
+			// JMP ($xxxx), keep the target
+			tmp = r.effAddr;
+			r.effAddr = GetMem(tmp) | (GetMem(tmp + 1) << 8);
+		}
+		else if (opcode[0] == 0x60)
+		{
+			// special case: an RTS opcode
+			// add the beginning address of the subroutine that we exit from
+			unsigned int caller_addr = GetMem(((X.S) + 1) | 0x0100) + (GetMem(((X.S) + 2) | 0x0100) << 8) - 0x2;
+			if (GetMem(caller_addr) == 0x20)
+			{
+				// this was a JSR instruction - take the subroutine address from it
+				r.callAddr = GetMem(caller_addr + 1) + (GetMem(caller_addr + 2) << 8);
+				r.flags |= RING_CALL_ADDR;
+			}
 		}
 	}
 
 	switch ( opcode[0] )
 	{
-		// Zero page
 		case 0x85: // STA - Store Accumulator
 		case 0x86: // STX - Store X Register
 		case 0x84: // STY - Store Y Register
 		case 0xC6: // DEC - Decrement Memory
 		case 0xE6: // INC - Increment Memory
-			rec.writeAddr = opcode[1];
-		break;
-		// Absolute
 		case 0x8D: // STA - Store Accumulator
 		case 0x8E: // STX - Store X Register
 		case 0x8C: // STY - Store Y Register
 		case 0xCE: // DEC - Decrement Memory
 		case 0xEE: // INC - Increment Memory
-			rec.writeAddr = opcode[1] | opcode[2] << 8;
-		break;
-		// Indirect X
 		case 0x81: // STA - Store A Register
-			rec.writeAddr = (opcode[1] + X.X) & 0xFF;
-			rec.writeAddr = GetMem((rec.writeAddr)) | (GetMem(((rec.writeAddr)+1)&0xff))<<8;
-		break;
-		// Indirect Y
 		case 0x91: // STA - Store A Register
-			rec.writeAddr  = GetMem(opcode[1]) | (GetMem((opcode[1]+1)&0xff))<<8;
-			rec.writeAddr += X.Y;
-		break;
-		// Zero Page X
 		case 0x95: // STA - Store Accumulator
 		case 0x94: // STY - Store Y Register
 		case 0xD6: // DEC - Decrement Memory
 		case 0xF6: // INC - Increment Memory
-			rec.writeAddr = (opcode[1]+ X.X) & 0xFF;
-		break;
-		// Zero Page Y
 		case 0x96: // STX - Store X Register
-			rec.writeAddr = (opcode[1]+ X.Y) & 0xFF;
+			// effAddr and value already hold the target and its old byte
+			if ( !(r.flags & RING_OVERFLOW) )
+			{
+				r.flags |= RING_WRITE;
+			}
 		break;
 		default:
-			rec.writeAddr = -1;
 		break;
 	}
 
-	if ( rec.writeAddr >= 0 )
-	{
-		rec.preWriteVal = GetMem( rec.writeAddr );
-	}
-	else
-	{
-		rec.preWriteVal = 0;
-	}
-
-	pushToLogBuffer(rec);
+	pushToLogBuffer(r);
 
 	return; // TEST
 	// All of the following log text creation is very cpu intensive, to keep emulation
@@ -2227,7 +2671,7 @@ void QTraceLogView::drawText(QPainter *painter, int x, int y, const char *txt, i
 //----------------------------------------------------
 void QTraceLogView::paintEvent(QPaintEvent *event)
 {
-	int i, x, y, v, row, start, end, nrow, lineLen;
+	int i, x, y, v, row, start, nrow, lineLen;
 	QPainter painter(this);
 	char line[256];
 	QColor hlgtFG("white"), hlgtBG("blue");
@@ -2275,28 +2719,36 @@ void QTraceLogView::paintEvent(QPaintEvent *event)
 		pxLineXScroll = hbar->value();
 	}
 
-	end = recBufHead - v;
-
-	if (end < 0)
-		end += recBufMax;
-
-	start = (end - nrow);
-
-	if (start < 0)
-		start += recBufMax;
-
 	for (i = 0; i < 64; i++)
 	{
 		lineBufIdx[i] = -1;
 	}
 
-	row = 0;
-	while (start != end)
+	if ( nrow > 64 )
 	{
-		lineBufIdx[row] = start;
-		rec[row] = recBuf[start];
-		row++;
-		start = (start + 1) % recBufMax;
+		nrow = 64;
+	}
+
+	if ( nrow > 0 )
+	{
+		traceRingRecord_t ringRec[64];
+		uint64_t valid;
+
+		valid = readRingRecords( v, nrow, ringRec, &start );
+
+		for (row = 0; row < nrow; row++)
+		{
+			if ( valid & (1ull << row) )
+			{
+				lineBufIdx[row] = start;
+				decodeRingRecord( ringRec[row], rec[row] );
+			}
+			else
+			{
+				rec[row] = traceRecord_t();
+			}
+			start = (start + 1) % recBufMax;
+		}
 	}
 
 	if (captureHighLightText)
@@ -2450,6 +2902,15 @@ void TraceLogDiskThread_t::run(void)
 
 	setPriority( QThread::HighestPriority );
 
+	fceuWrapperSetThreadAffinity( "SDL.TraceThreadCpus" );
+
+	if (logFileBinary)
+	{
+		runBinary();
+		emit finished();
+		return;
+	}
+
 #ifdef WIN32
 	TraceFileWriter tracer;
 	if (!tracer.open(logFilePath.c_str(), (bool)FCEUI_EmulationPaused()))
@@ -2576,31 +3037,89 @@ void TraceLogDiskThread_t::run(void)
 	emit finished();
 }
 //----------------------------------------------------
+// Writes the records as a compressed binary log rather than text, see
+// TraceLogBinary.h. Chunks are flushed whenever emulation pauses, so what
+// was logged up to a breakpoint can be converted right away.
+void TraceLogDiskThread_t::runBinary(void)
+{
+	TraceLogBinaryWriter writer;
+	bool dataNeedsFlush = false;
+
+	if ( !writer.open( logFilePath.c_str() ) )
+	{
+		char stmp[1024];
+		snprintf( stmp, sizeof(stmp), "Error: Failed to open log file for writing: %s", logFilePath.c_str() );
+		consoleWindow->QueueErrorMsgWindow(stmp);
+		return;
+	}
+	if ( logBuf == NULL )
+	{
+		logBufHead = logBufTail = 0;
+
+		logBuf = (traceRecord_t *)malloc( logBufMax * sizeof(traceRecord_t) );
+
+		if ( logBuf == NULL )
+		{
+			consoleWindow->QueueErrorMsgWindow("Error: Failed to allocate the trace log buffer");
+			writer.close();
+			return;
+		}
+	}
+
+	while ( !isInterruptionRequested() )
+	{
+		bool isPaused = FCEUI_EmulationPaused() ? true : false;
+
+		while (logBufHead != logBufTail)
+		{
+			if ( !writer.add( logBuf[logBufTail] ) )
+			{
+				// what is already in the file stays readable, nothing more
+				// is written to it until logging is started again
+				char stmp[1024];
+				snprintf( stmp, sizeof(stmp), "Error: Failed to write the binary trace log, logging to %s stopped", logFilePath.c_str() );
+				consoleWindow->QueueErrorMsgWindow(stmp);
+				writer.close();
+				return;
+			}
+			logBufTail = (logBufTail + 1) % logBufMax;
+			dataNeedsFlush = true;
+		}
+
+		if (isPaused && dataNeedsFlush)
+		{
+			writer.flush();
+			dataNeedsFlush = false;
+		}
+		SDL_Delay(1);
+	}
+	writer.close();
+}
+//----------------------------------------------------
 //---  Trace Logger BackUp (Undo) Instruction
 //----------------------------------------------------
-static int undoInstruction( traceRecord_t &rec )
+static int undoInstruction( traceRingRecord_t &r )
 {
 	// TODO Undo memory writes
 	//printf("BackUp (Undo) Instruction\n");
-	X.PC = rec.cpu.PC;
-	X.A  = rec.cpu.A;
-	X.X  = rec.cpu.X;
-	X.Y  = rec.cpu.Y;
-	X.S  = rec.cpu.S;
-	X.P  = rec.cpu.P;
+	X.PC = r.PC;
+	X.A  = r.A;
+	X.X  = r.X;
+	X.Y  = r.Y;
+	X.S  = r.S;
+	X.P  = r.P;
 
-	if ( rec.writeAddr >= 0 )
+	if ( r.flags & RING_WRITE )
 	{
-		if ( rec.writeAddr < 0x8000 )
+		if ( r.effAddr < 0x8000 )
 		{
 			writefunc wfunc;
         
-			wfunc = GetWriteHandler (rec.writeAddr);
+			wfunc = GetWriteHandler (r.effAddr);
         
 			if (wfunc)
 			{
-				wfunc ((uint32) rec.writeAddr,
-				       (uint8) (rec.preWriteVal & 0x000000ff));
+				wfunc ((uint32) r.effAddr, r.value);
 			}
 		}
 	}
@@ -9,6 +9,8 @@
 #include <QHBoxLayout>
 #include <QComboBox>
 #include <QCheckBox>
+#include <QLineEdit>
+#include <QSpinBox>
 #include <QPushButton>
 #include <QRadioButton>
 #include <QLabel>
@@ -147,6 +149,7 @@ class  TraceLogDiskThread_t : public QThread
 		~TraceLogDiskThread_t(void);
 
 	private:
+		void runBinary(void);
 
 	signals:
 		void finished(void);
@@ -167,6 +170,7 @@ protected:
 	QTimer *updateTimer;
 	QLabel    *logLastLbl;
 	QCheckBox *logFileCbox;
+	QCheckBox *logBinaryCbox;
 	QComboBox *logMaxLinesComboBox;
 
 	QCheckBox *autoUpdateCbox;
@@ -184,6 +188,13 @@ protected:
 	QCheckBox *logNewMapCodeCbox;
 	QCheckBox *logNewMapDataCbox;
 
+	QLineEdit *filterPcRangeEntry;
+	QLineEdit *filterBankRangeEntry;
+	QCheckBox *filterSkipNmiCbox;
+	QSpinBox  *filterSampleSpinBox;
+	QLineEdit *filterStartCondEntry;
+	QLineEdit *filterStopCondEntry;
+
 	QPushButton *selLogFileButton;
 	QPushButton *startStopButton;
 	QPushButton *clearButton;
@@ -205,6 +216,7 @@ private slots:
 	void updatePeriodic(void);
 	void autoUpdateStateChanged(int state);
 	void logToFileStateChanged(int state);
+	void logBinaryStateChanged(int state);
 	void logRegStateChanged(int state);
 	void logFrameStateChanged(int state);
 	void logEmuMsgStateChanged(int state);
@@ -218,6 +230,7 @@ private slots:
 	void logBankNumStateChanged(int state);
 	void logNewMapCodeChanged(int state);
 	void logNewMapDataChanged(int state);
+	void filterChanged(void);
 	void logMaxLinesChanged(int index);
 	void hbarChanged(int value);
 	void vbarChanged(int value);
@@ -225,6 +238,7 @@ private slots:
 	void pageUpActivated(void);
 	void pageDnActivated(void);
 	void openLogFile(void);
+	void convertBinaryLog(void);
 	void clearLog(void);
 };
 
@@ -272,6 +272,9 @@ int getHotKeyConfig( int i, const char **nameOut, const char **keySeqOut, const
 		case HK_STOP_WAV:
 			name = "StopWav"; keySeq = ""; group = "WAV";
 		break;
+		case HK_SAVE_INSTANT_REPLAY:
+			name = "SaveInstantReplay"; keySeq = ""; title = "Save Instant Replay"; group = "AVI";
+		break;
 		case HK_MUTE_CAPTURE:
 			name = "MuteCapture"; keySeq = "'";
 		break;
@@ -457,7 +460,7 @@ CreateDirs(const std::string &dir)
  * hopefully become obsolete once the new configuration system is in
  * place.
  */
-static void
+void
 GetBaseDirectory(std::string &dir)
 {
 	const char *home = getenv("FCEUX_HOME");
@@ -538,13 +541,20 @@ InitConfig()
 	config->addOption("soundq", "SDL.Sound.Quality", 1);
 	config->addOption("soundrecord", "SDL.Sound.RecordFile", "");
 	config->addOption("soundbufsize", "SDL.Sound.BufSize", 128);
+	config->addOption("soundlatency", "SDL.Sound.Latency", 20);
 	config->addOption("lowpass", "SDL.Sound.LowPass", 0);
+	config->addOption("soundbackend", "SDL.Sound.Backend", "sdl");
+	config->addOption("alsadevice", "SDL.Sound.AlsaDevice", "default");
 	config->addOption("SDL.Sound.UseGlobalFocus", 1);
     
 	config->addOption('g', "gamegenie", "SDL.GameGenie", 0);
 	config->addOption("pal", "SDL.PAL", 0);
 	config->addOption("autoPal", "SDL.AutoDetectPAL", 1);
 	config->addOption("frameskip", "SDL.Frameskip", 0);
+	config->addOption("computeonly", "SDL.ComputeOnly", 0);
+	config->addOption("romcache", "SDL.RomCache", 0);
+	config->addOption("instantreplay", "SDL.InstantReplaySeconds", 0);
+	config->addOption("writejournal", "SDL.WriteJournalMB", 0);
 	config->addOption("intFrameRate", "SDL.IntFrameRate", 0);
 	config->addOption("clipsides", "SDL.ClipSides", 0);
 	config->addOption("nospritelim", "SDL.DisableSpriteLimit", 0);
@@ -577,6 +587,10 @@ InitConfig()
 	config->addOption("SDL.VideoBgColor", "#000000");
 	config->addOption("SDL.UseBgPaletteForVideo", false);
 	config->addOption("SDL.VideoVsync", 1);
+	config->addOption("kiosk", "SDL.Kiosk", 0);
+	config->addOption("kioskSwapInterval", "SDL.KioskSwapInterval", 1);
+	config->addOption("headless", "SDL.Headless", 0);
+	config->addOption("luaGuiOverlay", "SDL.LuaGuiOverlay", 0);
 
 	// set x/y res to 0 for automatic fullscreen resolution detection (no change)
 	config->addOption('x', "xres", "SDL.XResolution", 0);
@@ -608,6 +622,8 @@ InitConfig()
 	config->addOption("SDL.ShowLagCount", 0);
 	config->addOption("SDL.ShowRerecordCount", 0);
 	config->addOption("SDL.ShowGuiMessages", 1);
+	// Software blit worker threads, -1 picks from the core count and 0 blits on the emulator thread
+	config->addOption("SDL.VideoBlitThreads", -1);
 
 	// OpenGL options
 	config->addOption("opengl", "SDL.OpenGL", 1);
@@ -636,6 +652,9 @@ InitConfig()
 	config->addOption("SDL.NetPlayHostAllowClientRomLoadReq", 0);
 	config->addOption("SDL.NetPlayHostAllowClientStateLoadReq", 0);
 	config->addOption("SDL.NetPlayHostEnforceAppVersionChk", 1);
+	config->addOption("SDL.NetPlayHostSpectatorRelay", 0);
+	config->addOption("SDL.NetPlayRollbackFrames", 0);
+	config->addOption("SDL.NetPlayUdpInput", 0);
      
 	// input configuration options
 	config->addOption("input1", "SDL.Input.0", "GamePad.0");
@@ -655,12 +674,28 @@ InitConfig()
 
 	// enable / disable opposite directionals (left + right or up + down simultaneously)
 	config->addOption("opposite-directionals", "SDL.Input.EnableOppositeDirectionals", 0);
+
+	// sample the gamepads on a thread of their own, and at the game's strobe
+	config->addOption("inputthread", "SDL.Input.SampleThread", 0);
+	config->addOption("inputthreadperiod", "SDL.Input.SamplePeriodUs", 1000);
     
 	// pause movie playback at frame x
 	config->addOption("pauseframe", "SDL.PauseFrame", 0);
 	config->addOption("recordhud", "SDL.RecordHUD", 0);
 	config->addOption("moviemsg", "SDL.MovieMsg", 0);
 
+	// zlib level (0-9) for PNG screenshots, from the hotkey and the REST API
+	config->addOption("SDL.PngCompressionLevel", 1);
+
+	// Don't blit, upload or redraw frames that repeat the previous one
+	config->addOption("SDL.SkipUnchangedFrames", 1);
+
+	// Export each frame, RAM and nametables through POSIX shared memory for
+	// local tools, see drivers/common/shm_export.h. An empty name means
+	// "/fceux-<pid>".
+	config->addOption("shmexport", "SDL.ShmExport", 0);
+	config->addOption("SDL.ShmExportName", "");
+
 #ifdef _USE_LIBAV
 	config->addOption("SDL.AviDriver", AVI_DRIVER_LIBAV);
 #else
@@ -675,6 +710,11 @@ InitConfig()
 	config->addOption("SDL.AviVideoFormat", AVI_RGB24);
 #endif
 	config->addOption("SDL.AviRecordAudio", 1);
+	// Frames the AVI encoder may fall behind by, 0 is as many as the buffer holds.
+	// When it is that far behind new frames are dropped if AviDropFrames is set,
+	// otherwise emulation waits for the encoder.
+	config->addOption("SDL.AviQueueFrames", 300);
+	config->addOption("SDL.AviDropFrames", 0);
 
 #ifdef _USE_LIBAV
 	config->addOption("SDL.AviFFmpegVideoCodec", "");
@@ -683,6 +723,8 @@ InitConfig()
 	config->addOption("SDL.AviFFmpegAudioSmpFmt", -1);
 	config->addOption("SDL.AviFFmpegAudioSmpRate", -1);
 	config->addOption("SDL.AviFFmpegAudioChanLayout", -1);
+	config->addOption("SDL.AviFFmpegHwEncode", 0);
+	config->addOption("SDL.AviFFmpegHwDevice", "");
 #endif
 #ifdef  WIN32
 	config->addOption("SDL.AviVfwFccHandler", "");
@@ -727,6 +769,9 @@ InitConfig()
 	config->addOption("SDL.DebuggerBreakOnBadOpcodes", 0);
 	config->addOption("SDL.DebuggerBreakOnUnloggedCode", 0);
 	config->addOption("SDL.DebuggerBreakOnUnloggedData", 0);
+	config->addOption("SDL.DebuggerReverseDebug", 0);
+	config->addOption("SDL.DebuggerReverseInterval", 30);
+	config->addOption("SDL.DebuggerReverseBudgetMB", 64);
 	config->addOption("SDL.DebugAutoStartTraceLogger", 0);
 
 	// Code Data Logger Options
@@ -736,6 +781,7 @@ InitConfig()
 
 	// Trace Logger Options
 	config->addOption("SDL.TraceLogSaveToFile", 0);
+	config->addOption("SDL.TraceLogBinary", 0);
 	config->addOption("SDL.TraceLogSaveFilePath", "");
 	config->addOption("SDL.TraceLogPeriodicWindowUpdate", 1);
 	config->addOption("SDL.TraceLogRegisterState", 1);
@@ -751,10 +797,31 @@ InitConfig()
 	config->addOption("SDL.TraceLogSymbolic", 0);
 	config->addOption("SDL.TraceLogStackTabbing", 1);
 	config->addOption("SDL.TraceLogLeftDisassembly", 1);
+	config->addOption("SDL.TraceFilterPcRange", "");
+	config->addOption("SDL.TraceFilterBankRange", "");
+	config->addOption("SDL.TraceFilterSkipNMI", 0);
+	config->addOption("SDL.TraceFilterSampleEvery", 1);
+	config->addOption("SDL.TraceFilterStartCondition", "");
+	config->addOption("SDL.TraceFilterStopCondition", "");
 	
 	// overwrite the config file?
 	config->addOption("no-config", "SDL.NoConfig", 0);
 
+	// startup timing report, 1 text or 2 JSON; not kept in the config file
+	config->addOption("startup-report", "SDL.StartupReport", 0);
+	config->addOption("benchmark-startup", "SDL.BenchmarkStartup", 0);
+
+	// time the stages of one frame in this many for /api/system/metrics, 0 for none
+	config->addOption("profile-interval", "SDL.StageProfileInterval", 60);
+
+	// hand FCEU_printf messages to the log from a logger thread, and how
+	// many a second each thread may log before the rest are dropped
+	config->addOption("async-log", "SDL.AsyncMsgLog", 1);
+	config->addOption("log-rate", "SDL.MsgLogRate", 1000);
+
+	// keep the frame timing statistics and stage histograms from startup
+	config->addOption("frame-timing", "SDL.FrameTimingStats", 0);
+
 	config->addOption("autoresume", "SDL.AutoResume", 0);
 	config->addOption("SDL.FamilyKeyboardFont"  , "");
     
@@ -770,6 +837,8 @@ InitConfig()
 	config->addOption("SDL.SubtitlesOnAVI"         , 0 );
 	config->addOption("SDL.AutoMovieBackup"        , 0 );
 	config->addOption("SDL.MovieFullSaveStateLoads", 0 );
+	config->addOption("SDL.MovieSeekIndexInterval" , 0 );   // frames between seek snapshots, 0 = off
+	config->addOption("SDL.MovieSeekIndexMemoryMB" , 64 );
 	
 	config->addOption("fourscore", "SDL.FourScore", 0);
 
@@ -796,6 +865,7 @@ InitConfig()
 	config->addOption("SDL.StateRecorderTimeBetweenSnapsMin", 0);
 	config->addOption("SDL.StateRecorderTimeBetweenSnapsSec", 3);
 	config->addOption("SDL.StateRecorderCompressionLevel", 0);
+	config->addOption("SDL.StateRecorderKeyFrameInterval", 30);
 	config->addOption("SDL.StateRecorderPauseOnLoad", 1);
 	config->addOption("SDL.StateRecorderPauseDuration", 3);
 
@@ -816,6 +886,9 @@ InitConfig()
 	config->addOption("SDL.HelpFilePath", "");
 	config->addOption("SDL.AviFilePath", "");
 	config->addOption("SDL.WavFilePath", "");
+	config->addOption("SDL.WavBufferKB", 1024);
+	config->addOption("SDL.WavBatchKB", 64);
+	config->addOption("SDL.WavSync", FCEU_WAVE_SYNC_CLOSE);
 
 	for (unsigned int i=0; i<10; i++)
 	{
@@ -854,7 +927,9 @@ InitConfig()
 	config->addOption("SDL.TasEnableHotChanges"                        , tasCfg.enableHotChanges  );
 	config->addOption("SDL.TasFollowUndoContext"                       , tasCfg.followUndoContext  );
 	config->addOption("SDL.TasFollowMarkerNoteContext"                 , tasCfg.followMarkerNoteContext  );
-	config->addOption("SDL.TasGreenzoneCapacity"                       , tasCfg.greenzoneCapacity  );
+	config->addOption("SDL.TasGreenzoneMemoryLimit"                    , tasCfg.greenzoneMemoryLimit  );
+	config->addOption("SDL.TasGreenzoneSpillLimit"                     , tasCfg.greenzoneSpillLimit  );
+	config->addOption("SDL.TasGreenzoneLookahead"                      , tasCfg.greenzoneLookahead  );
 	config->addOption("SDL.TasMaxUndoLevels"                           , tasCfg.maxUndoLevels  );
 	config->addOption("SDL.TasEnableGreenzoning"                       , tasCfg.enableGreenzoning  );
 	config->addOption("SDL.TasAutofirePatternSkipsLag"                 , tasCfg.autofirePatternSkipsLag  );
@@ -905,11 +980,23 @@ InitConfig()
 	config->addOption("_guiSchedPolicy"     , "SDL.GuiSchedPolicy", 0);
 	config->addOption("_guiSchedNice"       , "SDL.GuiSchedNice"  , 0);
 	config->addOption("_guiSchedPrioRt"     , "SDL.GuiSchedPrioRt", 40);
+	config->addOption("_audioSchedPolicy"   , "SDL.AudioSchedPolicy", 0);
+	config->addOption("_audioSchedPrioRt"   , "SDL.AudioSchedPrioRt", 40);
+	config->addOption("emucpus"             , "SDL.EmuThreadCpus"  , "");
+	config->addOption("audiocpus"           , "SDL.AudioThreadCpus", "");
+	config->addOption("tracecpus"           , "SDL.TraceThreadCpus", "");
+	config->addOption("avicpus"             , "SDL.AviThreadCpus"  , "");
+	config->addOption("restcpus"            , "SDL.RestThreadCpus" , "");
 	config->addOption("_emuTimingMech"      , "SDL.EmuTimingMech" , 0);
+	config->addOption("displaysync"         , "SDL.EmuDisplaySync", 0);
+	config->addOption("displaylead"         , "SDL.EmuDisplayLead", 4);
+	config->addOption("runahead"            , "SDL.RunAhead"      , 0);
 	config->addOption("SDL.OverClockEnable"     , 0);
 	config->addOption("SDL.PostRenderScanlines" , 0);
 	config->addOption("SDL.VBlankScanlines"     , 0);
 	config->addOption("SDL.Skip7bitOverClocking", 1);
+	config->addOption("SDL.LagOverClock"        , 0);
+	config->addOption("SDL.LagOverClockGames"   , "");
 
 	// fcm -> fm2 conversion
 	config->addOption("fcmconvert", "SDL.FCMConvert", "");
@@ -959,6 +1046,12 @@ InitConfig()
 	config->addOption("SDL.RestApiEnabled", 1);
 	config->addOption("SDL.RestApiPort", 8080);  // Valid range: 1-65535
 	config->addOption("SDL.RestApiBindAddress", "0.0.0.0");
+	config->addOption("SDL.RestApiStateStoreMB", 256);  // Memory cap of /api/state snapshots
+	config->addOption("SDL.RestApiThreads", 0);         // Worker threads, 0 for the default
+	config->addOption("SDL.RestApiMaxQueued", 0);       // Connections waiting for a worker, 0 for no limit
+	config->addOption("SDL.RestApiKeepAliveMax", 100);  // Requests per keep-alive connection
+	config->addOption("SDL.RestApiKeepAliveSec", 5);    // Idle keep-alive timeout
+	config->addOption("SDL.RestApiGzipMinBytes", 1024); // Smallest response sent gzip encoded, 0 for never
 
 	// GamePad 0 - 3
 	for(unsigned int i = 0; i < GAMEPAD_NUM_DEVICES; i++) 
@@ -1125,7 +1218,8 @@ UpdateEMUCore(Config *config)
 {
 	int ntsccol, ntsctint, ntschue, flag, region;
 	int startNTSC, endNTSC, startPAL, endPAL;
-	std::string cpalette;
+	int wavBufferKB, wavBatchKB, wavSync;
+	std::string cpalette, lagOverclockGames;
 
 	config->getOption("SDL.NTSCpalette", &ntsccol);
 	config->getOption("SDL.Tint", &ntsctint);
@@ -1152,6 +1246,13 @@ UpdateEMUCore(Config *config)
 	config->getOption("SDL.PostRenderScanlines" , &postrenderscanlines    );
 	config->getOption("SDL.VBlankScanlines"     , &vblankscanlines        );
 	config->getOption("SDL.Skip7bitOverClocking", &skip_7bit_overclocking );
+	config->getOption("SDL.LagOverClock"        , &lagOverclock           );
+	config->getOption("SDL.LagOverClockGames"   , &lagOverclockGames      );
+	FCEUI_SetLagOverclockGames(lagOverclockGames.c_str());
+	config->getOption("SDL.WavBufferKB"         , &wavBufferKB            );
+	config->getOption("SDL.WavBatchKB"          , &wavBatchKB             );
+	config->getOption("SDL.WavSync"             , &wavSync                );
+	FCEUI_SetWaveRecordBuffering(wavBufferKB, wavBatchKB, wavSync);
 	config->getOption("SDL.ShowGuiMessages"     , &vidGuiMsgEna           );
 	config->getOption("SDL.FrameAdvanceDelay"   , &frameAdvance_Delay     );
 
@@ -4,6 +4,7 @@
 #include "common/configSys.h"
 
 Config *InitConfig(void);
+void GetBaseDirectory(std::string &dir);
 void UpdateEMUCore(Config *);
 int LoadCPalette(const std::string &file);
 
@@ -54,6 +55,7 @@ enum HOTKEY {
 	HK_PLAY_MOVIE_FROM, HK_MOVIE_PLAY_RESTART, HK_RECORD_MOVIE_TO, HK_STOP_MOVIE,
 	HK_RECORD_AVI, HK_RECORD_AVI_TO, HK_STOP_AVI,
 	HK_RECORD_WAV, HK_RECORD_WAV_TO, HK_STOP_WAV,
+	HK_SAVE_INSTANT_REPLAY,
 
 	// Display
 	HK_TOGGLE_FG, HK_TOGGLE_BG, HK_TOGGLE_INPUT_DISPLAY, HK_LAG_COUNTER_DISPLAY,
@@ -15,6 +15,19 @@ void WriteSound(int32_t *Buffer, int Count);
 int KillSound(void);
 uint32_t GetMaxSound(void);
 uint32_t GetWriteSound(void);
+
+struct soundLatencyStat_t
+{
+	bool   enabled;
+	double latency;   // seconds from WriteSound() to the device, now
+	double average;   // same, smoothed the way rate control sees it
+	double target;
+	double device;    // part of it spent in the device buffer
+	double rateRatio; // resampling adjustment, 1.0 is none
+	unsigned int underruns;
+	unsigned int overruns;
+};
+void GetSoundLatencyStats(struct soundLatencyStat_t *stats);
 bool FCEUD_SoundIsMuted(void);
 void FCEUD_MuteSoundOutput(bool value);
 void FCEUD_MuteSoundWindow(bool value);
@@ -25,6 +25,11 @@
 #include <limits.h>
 #include <unzip.h>
 
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
 #include <QFileInfo>
 #include <QStyleFactory>
 #include "Qt/main.h"
@@ -40,22 +45,37 @@
 #include "Qt/NetPlay.h"
 #include "Qt/AviRecord.h"
 #include "Qt/HexEditor.h"
+#include "Qt/RamWatch.h"
+#include "Qt/RamSearch.h"
 #include "Qt/CheatsConf.h"
 #include "Qt/SymbolicDebug.h"
 #include "Qt/CodeDataLogger.h"
 #include "Qt/QtScriptManager.h"
 #include "Qt/ConsoleDebugger.h"
 #include "Qt/ConsoleWindow.h"
+#include "Qt/ConsoleHeadless.h"
 #include "Qt/ConsoleUtilities.h"
+#include "Qt/EmuStateSnapshot.h"
 #include "Qt/TasEditor/TasEditorWindow.h"
 #include "Qt/fceux_git_info.h"
 
 #include "common/cheat.h"
 #include "../../fceu.h"
 #include "../../cheat.h"
+#include "../../input.h"
 #include "../../movie.h"
+#include "../../wave.h"
 #include "../../state.h"
 #include "../../profiler.h"
+#include "../../romscan.h"
+#include "../../movieverify.h"
+#include "../../nsfrender.h"
+#include "../../startuptime.h"
+#include "../../stageprof.h"
+#include "../../msglog.h"
+#include "../../romcache.h"
+#include "../../capture.h"
+#include "../../writejournal.h"
 #include "../../version.h"
 
 #ifdef _S9XLUA_H
@@ -63,6 +83,7 @@
 #endif
 
 #include "common/os_utils.h"
+#include "common/shm_export.h"
 #include "common/configSys.h"
 #include "utils/timeStamp.h"
 #include "utils/StringUtils.h"
@@ -84,6 +105,16 @@
 #include "Qt/RestApi/CommandQueue_fwd.h"
 #include "Qt/RestApi/RestApiCommands.h"
 #include "Qt/RestApi/Commands/InputCommands.h"
+#include "Qt/RestApi/FrameStream.h"
+#include "Qt/RestApi/FrameClock.h"
+#include "Qt/RestApi/MemoryWatch.h"
+#include "Qt/RestApi/InputTimeline.h"
+#include "Qt/RestApi/InstancePool.h"
+#include "Qt/RestApi/ObservationHub.h"
+#include "Qt/RestApi/RomCache.h"
+#include "Qt/RestApi/RouteMetrics.h"
+#include "Qt/RestApi/Utils/ReadCoalescer.h"
+#include "../../video.h"
 #endif
 //*****************************************************************
 // Define Global Variables to be shared with FCEU Core
@@ -139,6 +170,10 @@ CommandQueue& getRestApiCommandQueue() {
     return g_restApiCommandQueue;
 }
 
+void notifyRestApiCommandPushed() {
+    SpeedThrottleWake();
+}
+
 // Get recent command execution errors
 std::vector<CommandExecutionResult> getRecentCommandErrors(size_t maxCount) {
     FCEU::autoScopedLock lock(g_historyMutex);
@@ -166,6 +201,72 @@ static void addCommandResult(const CommandExecutionResult& result) {
     g_commandHistory.push_back(result);
 }
 
+// CPU memory reader for streamed RAM ranges and coalesced reads
+static uint8_t readStreamByte(uint32_t address) {
+    return FCEU_CheatGetByte(address);
+}
+
+// Read-only memory commands waiting for their shared pass
+static ReadCoalescer g_coalescedReads;
+static std::vector<std::unique_ptr<ApiCommand>> g_coalescedCommands;
+
+// Run one command, or answer it from the coalesced reads, and record the outcome
+static void runApiCommand(ApiCommand& cmd, bool coalesced) {
+    CommandExecutionResult result;
+    result.commandName = cmd.name();
+    result.timestamp = std::chrono::system_clock::now();
+
+    auto start = std::chrono::steady_clock::now();
+    
+    // Execute command with error handling
+    try {
+        FCEU_StageScope stage(FCEU_STAGE_REST);
+        FCEU_CountAdd(FCEU_COUNTER_REST_COMMANDS, 1);
+
+        if (coalesced) {
+            cmd.completeReads(g_coalescedReads);
+        } else {
+            cmd.execute();
+        }
+        result.success = true;
+    } catch (const std::exception& e) {
+        result.success = false;
+        result.errorMessage = e.what();
+        FCEU_printf("REST API Command '%s' failed: %s\n", 
+                   cmd.name(), e.what());
+    } catch (...) {
+        result.success = false;
+        result.errorMessage = "Unknown exception";
+        FCEU_printf("REST API Command '%s' failed: Unknown exception\n", 
+                   cmd.name());
+    }
+
+    // Coalesced commands leave out their share of the read pass
+    if (cmd.routeMetrics) {
+        cmd.routeMetrics->execution.record(std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+    
+    // Track execution result
+    addCommandResult(result);
+}
+
+// Read the ranges of all waiting read commands at once, then answer each
+static void flushCoalescedReads() {
+    if (g_coalescedCommands.empty()) {
+        return;
+    }
+    {
+        FCEU_StageScope stage(FCEU_STAGE_REST);
+        g_coalescedReads.readAll(readStreamByte);
+    }
+    for (auto& cmd : g_coalescedCommands) {
+        runApiCommand(*cmd, true);
+    }
+    g_coalescedCommands.clear();
+    g_coalescedReads.clear();
+}
+
 // Process commands from the REST API queue
 static void processApiCommands() {
     // Only process if emulator is running
@@ -174,6 +275,10 @@ static void processApiCommands() {
     }
     
     const int MAX_COMMANDS_PER_FRAME = 10;
+
+    // Consecutive read-only commands share one pass and count as one command
+    const size_t MAX_COALESCED_READS = 256;
+
     int processed = 0;
     
     while (processed < MAX_COMMANDS_PER_FRAME) {
@@ -181,32 +286,27 @@ static void processApiCommands() {
         if (!cmd) {
             break;  // No more commands
         }
-        
-        CommandExecutionResult result;
-        result.commandName = cmd->name();
-        result.timestamp = std::chrono::system_clock::now();
-        
-        // Execute command with error handling
-        try {
-            cmd->execute();
-            result.success = true;
-        } catch (const std::exception& e) {
-            result.success = false;
-            result.errorMessage = e.what();
-            FCEU_printf("REST API Command '%s' failed: %s\n", 
-                       cmd->name(), e.what());
-        } catch (...) {
-            result.success = false;
-            result.errorMessage = "Unknown exception";
-            FCEU_printf("REST API Command '%s' failed: Unknown exception\n", 
-                       cmd->name());
+        if (cmd->routeMetrics) {
+            cmd->routeMetrics->queueWait.record(std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - cmd->queuedAt).count());
         }
         
-        // Track execution result
-        addCommandResult(result);
+        if ((g_coalescedCommands.size() < MAX_COALESCED_READS) && cmd->addReads(g_coalescedReads)) {
+            if (g_coalescedCommands.empty()) {
+                processed++;
+            }
+            g_coalescedCommands.push_back(std::move(cmd));
+            continue;
+        }
+
+        // Reads queued before this command must not see what it does
+        flushCoalescedReads();
+
+        runApiCommand(*cmd, false);
         
         processed++;
     }
+    flushCoalescedReads();
 }
 
 // Cleanup function for shutdown
@@ -361,6 +461,7 @@ DriverInitialize(FCEUGI *gi)
 	}
 
 	InitInputInterface();
+	inputSampleThreadStart();
 	return 1;
 }
 
@@ -373,6 +474,7 @@ DriverKill()
 	if (!noconfig)
 		g_config->save();
 
+	inputSampleThreadStop();
 	KillJoysticks();
 
 	if(inited&4)
@@ -387,9 +489,14 @@ int LoadGameFromLua( const char *path )
 	//printf("Load From Lua: '%s'\n", path);
 	fceuWrapperUnLock();
 
-	consoleWindow->emulatorThread->signalRomLoad(path);
+	emulatorThread_t *emuThread = consoleWindow ? consoleWindow->emulatorThread : ConsoleHeadless_t::emulatorThread();
 
-	fceuWrapperLock();
+	if ( emuThread )
+	{
+		emuThread->signalRomLoad(path);
+	}
+
+	FCEU_WRAPPER_LOCK();
 	return 0;
 }
 
@@ -476,7 +583,7 @@ int LoadGame(const char *path, bool silent, bool netPlayRequested)
 
 	g_config->getOption( "SDL.AutoOpenDebugger", &autoOpenDebugger );
 
-	if ( autoOpenDebugger && !debuggerWindowIsOpen() )
+	if ( autoOpenDebugger && consoleWindow && !debuggerWindowIsOpen() )
 	{
 		consoleWindow->openDebugWindow();
 	}
@@ -614,7 +721,7 @@ CloseGame(void)
 		{
 			fceuWrapperUnLock();
 			msleep(100);
-			fceuWrapperLock();
+			FCEU_WRAPPER_LOCK();
 		}
 		else
 		{
@@ -652,6 +759,16 @@ CloseGame(void)
 		tasWin->requestWindowClose();
 	}
 
+#ifdef __FCEU_REST_API_ENABLE__
+	// Steps waiting for frames of this game would never finish
+	FrameClock::instance().cancelSteps("Game closed");
+	// Scheduled frames refer to this game's frame counter
+	InputTimeline::instance().clear();
+	// Instances are forks of this game
+	InstancePool::instance().clear();
+	ObservationHub::instance().clear();
+	RomCache::instance().clear();
+#endif
 	FCEUI_CloseGame();
 
 	DriverKill();
@@ -730,6 +847,40 @@ void fceuWrapperRequestAppExit(void)
 	{
 		consoleWindow->requestClose();
 	}
+	else
+	{
+		ConsoleHeadless_t::requestQuit();
+	}
+}
+
+// --startup-report and --benchmark-startup: 0 off, 1 text, 2 JSON
+static int startupReport = 0;
+static int benchmarkStartup = 0;
+
+// Called when the first frame is presented, or the window is up without
+// a game. Prints the startup timing when asked for, and quits after it
+// for --benchmark-startup.
+void fceuWrapperStartupFinished(const char *mark)
+{
+	if ( FCEU_StartupTimingFinished() )
+	{
+		return;
+	}
+	FCEU_StartupTimingFinish(mark);
+
+	int mode = benchmarkStartup ? benchmarkStartup : startupReport;
+
+	if ( mode )
+	{
+		std::string report = FCEU_StartupTimingReport( mode == 2 );
+
+		fputs( report.c_str(), stdout );
+		fflush( stdout );
+	}
+	if ( benchmarkStartup )
+	{
+		fceuWrapperRequestAppExit();
+	}
 }
 
 static const char *DriverUsage =
@@ -744,8 +895,20 @@ static const char *DriverUsage =
 "                          Devices: quizking hypershot mahjong toprider ftrainer\n"
 "                          familykeyboard oekakids arkanoid shadow bworld\n"
 "                          4player\n"
+"--inputthread  {0|1}   Sample the gamepads on a thread of their own and again\n"
+"                       when the game strobes them, outside of movies.\n"
+"--inputthreadperiod x  Microseconds between input thread samples, 100 to 8000.\n"
 "--gamegenie    {0|1}   Enable emulated Game Genie.\n"
 "--frameskip    x       Set # of frames to skip per emulated frame.\n"
+"--computeonly  {0|1}   Run unthrottled without video or sound output, for\n"
+"                       scripted batch runs. Only applies to this session.\n"
+"--romcache     {0|1}   Cache ROM hashes and decompressed archives, so loading\n"
+"                       the same file again is faster.\n"
+"--instantreplay x      Keep the last x seconds of play in memory, for the\n"
+"                       Save Instant Replay hotkey. 0 (default) disables.\n"
+"--writejournal x       Keep up to x MB of CPU writes to RAM and $6000-$7FFF,\n"
+"                       for Last Writers in the hex editor and RAM watch.\n"
+"                       Runs the CPU as the debugger does. 0 (default) disables.\n"
 "--xres         x       Set horizontal resolution for full screen mode.\n"
 "--yres         x       Set vertical resolution for full screen mode.\n"
 "--autoscale    {0|1}   Enable autoscaling in fullscreen. \n"
@@ -754,6 +917,12 @@ static const char *DriverUsage =
 "                         (Real numbers >0 with OpenGL, otherwise integers >0).\n"
 "--(x/y)stretch {0|1}   Stretch to fill surface on x/y axis (OpenGL only).\n"
 "--fullscreen   {0|1}   Enable full screen mode.\n"
+"--kiosk        {0|1}   Present from a fullscreen window of its own, drawn\n"
+"                         by a render thread; for DRM/KMS use -platform eglfs.\n"
+"--kioskSwapInterval x  Refreshes between kiosk swaps, 0 swaps unsynced.\n"
+"--headless     {0|1}   Run without any window, and without a display server,\n"
+"                         controlled over the REST API. Only applies to this\n"
+"                         session; add --computeonly 1 to run unthrottled.\n"
 "--noframe      {0|1}   Hide title bar and window decorations.\n"
 "--special      {1-4}   Use special video scaling filters\n"
 "                         (1 = hq2x; 2 = Scale2x; 3 = NTSC 2x; 4 = hq3x;\n"
@@ -763,6 +932,21 @@ static const char *DriverUsage =
 "--soundrate    x       Set sound playback rate to x Hz.\n"
 "--soundq      {0|1|2}  Set sound quality. (0 = Low 1 = High 2 = Very High)\n"
 "--soundbufsize x       Set sound buffer size to x ms.\n"
+"--soundlatency x       Keep about x ms of sound buffered, 5 to 200.\n"
+"--soundbackend {sdl|alsa} Play sound through SDL, or straight to an ALSA\n"
+"                         device with small periods (when built with ALSA).\n"
+"--alsadevice   d       ALSA device for --soundbackend alsa, e.g. hw:0,0.\n"
+"--displaysync {0|1}    Pace frames to the display refresh when it is within\n"
+"                         0.4% of the emulated frame rate (needs vsync).\n"
+"--displaylead  x       With --displaysync, have a frame ready x ms before\n"
+"                         the refresh that shows it.\n"
+"--runahead     x       Show the picture x frames ahead (0 to 4) to take\n"
+"                         away the game's own input lag.\n"
+"--emucpus      l       Pin the emulator thread to CPU list l (\"2\", \"0-3,8\"\n"
+"                         or \"node1\" for a NUMA node). Likewise --audiocpus\n"
+"                         for the sound output, --tracecpus for the trace log\n"
+"                         writer, --avicpus for the AVI encoder and --restcpus\n"
+"                         for the REST API server.\n"
 "--volume      {0-256}  Set volume to x.\n"
 "--soundrecord  f       Record sound to file f.\n"
 "--playmov      f       Play back a recorded FCM/FM2/FM3 movie from filename f.\n"
@@ -787,7 +971,34 @@ static const char *DriverUsage =
 "                         to not save/load automatically provide a number\n"
 "                         greater than 9\n"
 "--periodicsaves {0|1}  enable automatic periodic saving.  This will save to\n"
-"                         the state passed to --savestate\n";
+"                         the state passed to --savestate\n"
+"--scan         d       Scan the ROMs in directory d and its subdirectories\n"
+"                         into the ROM index, then exit without a GUI.\n"
+"--scan-threads x       Number of threads --scan uses, 0 for one per core.\n"
+"--verify  f1 f2 ...    Replay the movies given in compute-only mode, print a\n"
+"                         JSON report of their hashes and desyncs, then exit\n"
+"                         without a GUI. The exit status is 1 if any failed.\n"
+"--verify-rom   f       ROM the movies of --verify are played on, instead of\n"
+"                         the one matching their romChecksum.\n"
+"--verify-report f      Write the --verify report to file f.\n"
+"--verify-interval x    Also report the RAM hash every x frames.\n"
+"-j, --jobs     x       Number of movies --verify replays or tracks\n"
+"                         --nsf-render renders at once, 0 for one per core.\n"
+"--nsf-render   f       Render the tracks of NSF file f to WAV files at full\n"
+"                         speed without a picture, then exit without a GUI.\n"
+"--track        x       Track --nsf-render renders, 0 for all of them.\n"
+"--seconds      x       Length of each rendered track, 150 by default.\n"
+"--silence      x       End a rendered track once it has been silent for x\n"
+"                         seconds, 0 for never.\n"
+"-o, --output   f       WAV file --nsf-render writes; with all tracks the\n"
+"                         track number is added to the name.\n"
+"--startup-report {0|1|2} Print how long each phase of startup took, up to\n"
+"                         the first frame, as 1 text or 2 JSON.\n"
+"--benchmark-startup {0|1|2} Like --startup-report, then exit.\n"
+"--profile-interval x   Time the emulation stages of one frame in x for\n"
+"                         /api/system/metrics, 0 for none.\n"
+"--frame-timing {0|1}   Keep the frame timing statistics from startup, for\n"
+"                         /api/emulation/timing.\n";
 
 static void ShowUsage(const char *prog)
 {
@@ -832,6 +1043,157 @@ static void ShowUsage(const char *prog)
 	
 }
 
+// Handles --verify, returns false when it is not given. Exits with status 1
+// when a movie did not pass.
+static bool VerifyMovies( int argc, char *argv[] )
+{
+	std::vector<std::string> movies;
+	const char *rom = "";
+	const char *report = NULL;
+	int jobs = 0, interval = 0;
+	bool verify = false;
+
+	for (int i=1; i<argc; i++)
+	{
+		if ( strcmp(argv[i], "--verify") == 0)
+		{
+			verify = true;
+
+			while ( (i+1 < argc) && (argv[i+1][0] != '-') )
+			{
+				movies.push_back( argv[++i] );
+			}
+		}
+		else if ( i+1 >= argc )
+		{
+			break;
+		}
+		else if ( (strcmp(argv[i], "-j") == 0) || (strcmp(argv[i], "--jobs") == 0) )
+		{
+			jobs = atoi(argv[++i]);
+		}
+		else if ( strcmp(argv[i], "--verify-rom") == 0)
+		{
+			rom = argv[++i];
+		}
+		else if ( strcmp(argv[i], "--verify-report") == 0)
+		{
+			report = argv[++i];
+		}
+		else if ( strcmp(argv[i], "--verify-interval") == 0)
+		{
+			interval = atoi(argv[++i]);
+		}
+	}
+
+	if ( !verify )
+	{
+		return false;
+	}
+	std::string dir;
+
+	GetBaseDirectory(dir);
+	FCEUI_SetBaseDirectory(dir.c_str());
+
+	std::vector<FCEU_MovieVerifyResult> results;
+	int failed = FCEUI_VerifyMovies(movies, rom, jobs, interval, results);
+	std::string json = FCEU_MovieVerifyReport(results);
+
+	if ( report != NULL )
+	{
+		FILE *fp = fopen(report, "w");
+
+		if ( fp == NULL )
+		{
+			printf("Error: Could not write %s\n", report);
+			exit(1);
+		}
+		fputs(json.c_str(), fp);
+		fclose(fp);
+	}
+	else
+	{
+		fputs(json.c_str(), stdout);
+	}
+
+	if ( failed > 0 )
+	{
+		exit(1);
+	}
+	return true;
+}
+
+// Handles --nsf-render, returns false when it is not given. Exits with
+// status 1 when a track could not be rendered.
+static bool RenderNSF( int argc, char *argv[] )
+{
+	FCEU_NSFRenderSettings settings;
+	const char *nsf = NULL;
+	const char *output = NULL;
+	int track = 0, jobs = 0;
+
+	for (int i=1; i<argc-1; i++)
+	{
+		if ( strcmp(argv[i], "--nsf-render") == 0)
+		{
+			nsf = argv[++i];
+		}
+		else if ( strcmp(argv[i], "--track") == 0)
+		{
+			track = atoi(argv[++i]);
+		}
+		else if ( strcmp(argv[i], "--seconds") == 0)
+		{
+			settings.seconds = atof(argv[++i]);
+		}
+		else if ( strcmp(argv[i], "--silence") == 0)
+		{
+			settings.silence = atof(argv[++i]);
+		}
+		else if ( (strcmp(argv[i], "-o") == 0) || (strcmp(argv[i], "--output") == 0) )
+		{
+			output = argv[++i];
+		}
+		else if ( (strcmp(argv[i], "-j") == 0) || (strcmp(argv[i], "--jobs") == 0) )
+		{
+			jobs = atoi(argv[++i]);
+		}
+		else if ( strcmp(argv[i], "--soundrate") == 0)
+		{
+			settings.rate = atoi(argv[++i]);
+		}
+		else if ( strcmp(argv[i], "--soundq") == 0)
+		{
+			settings.quality = atoi(argv[++i]);
+		}
+	}
+
+	if ( nsf == NULL )
+	{
+		return false;
+	}
+	if ( output == NULL )
+	{
+		printf("Error: --nsf-render needs an output file, -o f\n");
+		exit(1);
+	}
+	std::vector<FCEU_NSFRenderResult> results;
+	int failed = FCEUI_RenderNSF(nsf, track, output, settings, jobs, results);
+
+	if ( failed < 0 )
+	{
+		printf("Error: %s is not an NSF or has no track %d\n", nsf, track);
+		exit(1);
+	}
+	fputs(FCEU_NSFRenderReport(results).c_str(), stdout);
+
+	if ( failed > 0 )
+	{
+		exit(1);
+	}
+	return true;
+}
+
 // Pre-GUI initialization.
 int  fceuWrapperPreInit( int argc, char *argv[] )
 {
@@ -844,7 +1206,7 @@ int  fceuWrapperPreInit( int argc, char *argv[] )
 		}
 		else if ( strcmp(argv[i], "--no-gui") == 0)
 		{
-			printf("Error: Qt/SDL version does not support --no-gui option.\n");
+			printf("Error: Qt/SDL version does not support --no-gui option, use --headless 1.\n");
 			exit(1);
 		}
 		else if ( strcmp(argv[i], "--version") == 0)
@@ -853,6 +1215,38 @@ int  fceuWrapperPreInit( int argc, char *argv[] )
 			exit(0);
 		}
 	}
+
+	// --scan runs before the GUI exists, it only needs the base directory
+	// to find the index.
+	const char *scanDir = NULL;
+	int scanThreads = 0;
+
+	for (int i=1; i<argc-1; i++)
+	{
+		if ( strcmp(argv[i], "--scan") == 0)
+		{
+			scanDir = argv[++i];
+		}
+		else if ( strcmp(argv[i], "--scan-threads") == 0)
+		{
+			scanThreads = atoi(argv[++i]);
+		}
+	}
+
+	if ( scanDir != NULL )
+	{
+		std::string dir;
+
+		GetBaseDirectory(dir);
+		FCEUI_SetBaseDirectory(dir.c_str());
+
+		if ( FCEUI_ScanRomLibrary(scanDir, "", scanThreads) < 0 )
+		{
+			printf("Error: Could not scan %s into %s\n", scanDir, FCEU_RomIndexPath().c_str());
+			exit(1);
+		}
+		exit(0);
+	}
 	return 0;
 }
 
@@ -863,6 +1257,12 @@ int  fceuWrapperInit( int argc, char *argv[] )
 
 	FCEUD_Message("Starting " FCEU_NAME_AND_VERSION "...\n");
 
+	// Without a display server SDL's video can only come up on its dummy driver
+	if ( ConsoleHeadless_t::requested( argc, argv ) )
+	{
+		SDL_SetHint( SDL_HINT_VIDEODRIVER, "dummy" );
+	}
+
 	/* SDL_INIT_VIDEO Needed for (joystick config) event processing? */
 	if (SDL_Init(SDL_INIT_VIDEO)) 
 	{
@@ -875,7 +1275,9 @@ int  fceuWrapperInit( int argc, char *argv[] )
 	}
 
 	// Initialize the configuration system
+	FCEU_StartupPhase configPhase("config");
 	g_config = InitConfig();
+	configPhase.end();
 
 	if ( !g_config )
 	{
@@ -894,7 +1296,40 @@ int  fceuWrapperInit( int argc, char *argv[] )
 		exit(-1);
 	}
 
+	// --verify replays movies before the config parser sees the command line,
+	// which would take the movie names for ROMs.
+	if ( VerifyMovies(argc, argv) )
+	{
+		exit(0);
+	}
+
+	// --nsf-render likewise, its -o is not a config option
+	if ( RenderNSF(argc, argv) )
+	{
+		exit(0);
+	}
+
+	FCEU_StartupPhase parsePhase("config");
 	int romIndex = g_config->parse(argc, argv);
+	parsePhase.end();
+
+	g_config->getOption("SDL.StartupReport", &startupReport);
+	g_config->getOption("SDL.BenchmarkStartup", &benchmarkStartup);
+	g_config->setOption("SDL.StartupReport", 0);
+	g_config->setOption("SDL.BenchmarkStartup", 0);
+
+	int profileInterval;
+	g_config->getOption("SDL.StageProfileInterval", &profileInterval);
+	FCEUI_SetStageProfileInterval(profileInterval);
+
+	int asyncLog, logRate;
+	g_config->getOption("SDL.AsyncMsgLog", &asyncLog);
+	g_config->getOption("SDL.MsgLogRate", &logRate);
+	FCEU_SetAsyncMsgLog(asyncLog != 0, logRate);
+
+	int frameTiming;
+	g_config->getOption("SDL.FrameTimingStats", &frameTiming);
+	setFrameTimingEnable(frameTiming != 0);
 
 	// This is here so that a default fceux.cfg will be created on first
 	// run, even without a valid ROM to play.
@@ -909,6 +1344,11 @@ int  fceuWrapperInit( int argc, char *argv[] )
 		g_config->save();
 	}
 
+	// From here on the GUI saves the configuration on every change, leave
+	// the writing to a background thread that only does the last of a burst.
+	// fceuWrapperMemoryCleanup() writes what is still pending.
+	g_config->setSaveDelay(500);
+
 	// update the input devices
 	UpdateInput(g_config);
 
@@ -983,6 +1423,9 @@ int  fceuWrapperInit( int argc, char *argv[] )
 	else
 		FCEUI_SetAviEnableHUDrecording(false);
 
+	g_config->getOption("SDL.PngCompressionLevel", &opt);
+	FCEUI_SetPNGCompressionLevel(opt);
+
 	g_config->getOption("SDL.SuggestReadOnlyReplay"  , &suggestReadOnlyReplay);
 	g_config->getOption("SDL.PauseAfterMoviePlayback", &pauseAfterPlayback);
 	g_config->getOption("SDL.CloseFinishedMovie"     , &closeFinishedMovie);
@@ -991,6 +1434,11 @@ int  fceuWrapperInit( int argc, char *argv[] )
 	g_config->getOption("SDL.AutoMovieBackup"        , &autoMovieBackup);
 	g_config->getOption("SDL.MovieFullSaveStateLoads", &fullSaveStateLoads);
 
+	int seekInterval, seekMemoryMB;
+	g_config->getOption("SDL.MovieSeekIndexInterval", &seekInterval);
+	g_config->getOption("SDL.MovieSeekIndexMemoryMB", &seekMemoryMB);
+	FCEUMOV_SetSeekIndex( seekInterval, (size_t)seekMemoryMB * 1024 * 1024 );
+
 	// check to see if movie messages are disabled
 	int mm;
 	g_config->getOption("SDL.MovieMsg", &mm);
@@ -1078,6 +1526,23 @@ int  fceuWrapperInit( int argc, char *argv[] )
 		return -1;
 	}
 
+	g_config->getOption("SDL.ShmExport", &opt);
+	if ( opt )
+	{
+		std::string shmExportName;
+
+		g_config->getOption("SDL.ShmExportName", &shmExportName);
+
+		if ( FCEU_ShmExportOpen( shmExportName.c_str() ) )
+		{
+			printf("Exporting emulator state to shared memory %s\n", FCEU_ShmExportName() );
+		}
+		else
+		{
+			printf("Error: Failed to open shared memory export\n");
+		}
+	}
+
 	// update the emu core
 	UpdateEMUCore(g_config);
 
@@ -1113,6 +1578,19 @@ int  fceuWrapperInit( int argc, char *argv[] )
 		g_config->getOption("SDL.EmuTimingMech", &timingMode);
 
 		setTimingMode( timingMode );
+
+		int displaySync = 0, displayLead = 4;
+
+		g_config->getOption("SDL.EmuDisplaySync", &displaySync);
+		g_config->getOption("SDL.EmuDisplayLead", &displayLead);
+
+		setDisplaySync( displaySync ? true : false, displayLead * 1e-3 );
+
+		int runAhead = 0;
+
+		g_config->getOption("SDL.RunAhead", &runAhead);
+
+		FCEUI_SetRunAhead( runAhead );
 	}
 	
 	// load the hotkeys from the config life
@@ -1127,6 +1605,7 @@ int  fceuWrapperInit( int argc, char *argv[] )
 		int srTimeBtwSnapsMin = 0;
 		int srTimeBtwSnapsSec = 3;
 		int srCompressionLevel = 0;
+		int srKeyFrameInterval = 30;
 		int pauseOnLoadTime = 3;
 		int pauseOnLoad = StateRecorderConfigData::TEMPORARY_PAUSE;
 
@@ -1137,6 +1616,7 @@ int  fceuWrapperInit( int argc, char *argv[] )
 		g_config->getOption("SDL.StateRecorderTimeBetweenSnapsMin", &srTimeBtwSnapsMin);
 		g_config->getOption("SDL.StateRecorderTimeBetweenSnapsSec", &srTimeBtwSnapsSec);
 		g_config->getOption("SDL.StateRecorderCompressionLevel", &srCompressionLevel);
+		g_config->getOption("SDL.StateRecorderKeyFrameInterval", &srKeyFrameInterval);
 		g_config->getOption("SDL.StateRecorderPauseOnLoad", &pauseOnLoad);
 		g_config->getOption("SDL.StateRecorderPauseDuration", &pauseOnLoadTime);
 
@@ -1149,6 +1629,7 @@ int  fceuWrapperInit( int argc, char *argv[] )
 			                          ( static_cast<float>( srTimeBtwSnapsSec ) / 60.0f );
 		srConfig.framesBetweenSnaps = srFramesBtwSnaps;
 		srConfig.compressionLevel = srCompressionLevel;
+		srConfig.keyFrameInterval = srKeyFrameInterval;
 		srConfig.loadPauseTimeSeconds = pauseOnLoadTime;
 		srConfig.pauseOnLoad = static_cast<StateRecorderConfigData::PauseType>(pauseOnLoad);
 
@@ -1258,6 +1739,31 @@ int  fceuWrapperInit( int argc, char *argv[] )
 	g_config->getOption("SDL.NewPPU", &newppu);
 	g_config->getOption("SDL.Frameskip", &frameskip);
 
+	// Compute-only is chosen per run, never saved to the config file
+	int computeOnly = 0;
+	g_config->getOption("SDL.ComputeOnly", &computeOnly);
+	g_config->setOption("SDL.ComputeOnly", 0);
+	// as is headless, main() has read it off the command line already
+	g_config->setOption("SDL.Headless", 0);
+
+	if (computeOnly)
+	{
+		FCEUI_printf("Compute-only mode: video and sound output disabled, throttling off\n");
+		FCEUI_SetComputeOnly(true);
+	}
+
+	int romCache = 0;
+	g_config->getOption("SDL.RomCache", &romCache);
+	FCEUI_SetRomCache(romCache ? true : false);
+
+	int replaySeconds = 0;
+	g_config->getOption("SDL.InstantReplaySeconds", &replaySeconds);
+	FCEUI_SetInstantReplay(replaySeconds);
+
+	int journalMB = 0;
+	g_config->getOption("SDL.WriteJournalMB", &journalMB);
+	FCEUI_SetWriteJournal(journalMB);
+
 	return 0;
 }
 
@@ -1278,6 +1784,8 @@ int  fceuWrapperMemoryCleanup(void)
 
 	close_nes_shm();
 
+	FCEU_ShmExportClose();
+
 	if ( g_config )
 	{
 		delete g_config; g_config = NULL;
@@ -1336,7 +1844,11 @@ FCEUD_Update(uint8 *XBuf,
 	//#endif
 	aviRecordAddAudioFrame( Buffer, Count );
 	
-	WriteSound(Buffer,Count);
+	{
+		frameStageTimer audioTimer( FRAME_STAGE_AUDIO );
+
+		WriteSound(Buffer,Count);
+	}
 
 	//int ocount = Count;
 	// apply frame scaling to Count
@@ -1418,6 +1930,8 @@ FCEUD_Update(uint8 *XBuf,
 	{
 		if (XBuf && (inited&4)) 
 		{
+			frameStageTimer videoTimer( FRAME_STAGE_VIDEO );
+
 			BlitScreen(XBuf); blitDone = 1;
 		}
 	}
@@ -1430,7 +1944,9 @@ static void DoFun(int frameskip, int periodic_saves)
 	int32 *sound = 0;
 	int32 ssize = 0;
 	static int fskipc = 0;
+	static bool seekComputeOnly = false;
 	//static int opause = 0;
+	bool seekFar = false;
 
 	// If TAS editor is engaged, check whether a seek frame is set.
 	// If a seek is in progress, don't emulate past target frame.
@@ -1447,8 +1963,26 @@ static void DoFun(int frameskip, int periodic_saves)
 				FCEUI_SetEmulationPaused(EMULATIONPAUSED_PAUSED);
 				return;
 			}
+			// the frame that lands on the target is drawn
+			seekFar = turbo && (currFrameCounter + 1 < runToFrameTarget);
 		}
 	}
+
+	// A turbo seek runs the frames on the way to its target compute-only: no
+	// picture, filtering, blit or sound, the Greenzone still takes its
+	// savestates. A zapper reads the picture back, its games are not.
+	bool computeOnly = seekFar && !InputScanlineHookActive() && !aviRecordRunning() && !FCEUI_WaveRecordRunning();
+
+	if ( computeOnly && !seekComputeOnly && !FCEUI_GetComputeOnly() )
+	{
+		FCEUI_SetComputeOnly( true );
+		seekComputeOnly = true;
+	}
+	else if ( !computeOnly && seekComputeOnly )
+	{	// a session started compute-only stays so
+		FCEUI_SetComputeOnly( false );
+		seekComputeOnly = false;
+	}
     //TODO peroidic saves, working on it right now
     if (periodic_saves && FCEUD_GetTime() % PERIODIC_SAVE_INTERVAL < 30){
         FCEUI_SaveState(NULL, false);
@@ -1457,11 +1991,24 @@ static void DoFun(int frameskip, int periodic_saves)
 	fskipc = (fskipc + 1) % (frameskip + 1);
 #endif
 
-	if (NoWaiting || turbo) 
+	// Fast-forward is bound by emulation alone: no sound, and no more frames
+	// are drawn than the display can show. Recordings need every frame.
+	bool fastForward = fastForwardActive() && !aviRecordRunning() && !FCEUI_WaveRecordRunning();
+	int skip = fskipc;
+
+	FCEUI_SetFastForward( fastForward );
+
+	if ( fastForward && !skip && !fastForwardFrameDue() )
+	{
+		skip = 1;
+	}
 	{
-		gfx = 0;
+		frameStageTimer emulateTimer( FRAME_STAGE_EMULATE );
+
+		FCEUI_Emulate(&gfx, &sound, &ssize, skip);
 	}
-	FCEUI_Emulate(&gfx, &sound, &ssize, fskipc);
+	inputFrameMark( !FCEUI_GetLagged() );
+
 	FCEUD_Update(gfx, sound, ssize);
 
 	//if(opause!=FCEUI_EmulationPaused()) 
@@ -1476,9 +2023,130 @@ static void DoFun(int frameskip, int periodic_saves)
 static std::string lockFile;
 static bool debugMutexLock = false;
 
+//*****************************************************************
+// Emulator mutex contention profile
+//
+// Every lock is timed from the request to the acquisition (wait) and the
+// outermost one until its matching unlock (hold), one pair of histograms per
+// call site. The hold site and start time are only written while the mutex
+// is held, so the mutex itself protects them.
+//*****************************************************************
+struct mutexSite_t
+{
+	const char *file;
+	int         line;
+	const char *func;
+
+	std::atomic<uint64_t> locks;
+	std::atomic<uint64_t> timeouts;
+	std::atomic<uint64_t> emuBlockedUs;
+
+	timingHistogram_t wait;
+	timingHistogram_t hold;
+
+	mutexSite_t( const char *f, int l, const char *fn )
+		: file(f), line(l), func(fn), locks(0), timeouts(0), emuBlockedUs(0)
+	{
+	}
+};
+
+static mutexSite_t unknownMutexSite( "(unknown)", 0, "" );
+static std::map <std::pair<const char*,int>, mutexSite_t*> mutexSiteMap;
+static std::mutex mutexSiteMapLock;
+static std::atomic<mutexSite_t*> mutexHoldSite( nullptr );
+static double mutexHoldStart = 0.0;
+static thread_local bool isEmulatorThread = false;
+
+static mutexSite_t *getMutexSite( const char *filename, int line, const char *func )
+{
+	std::lock_guard<std::mutex> guard( mutexSiteMapLock );
+
+	mutexSite_t *&site = mutexSiteMap[ std::make_pair(filename, line) ];
+
+	if ( site == nullptr )
+	{
+		site = new mutexSite_t( filename, line, func );
+	}
+	return site;
+}
+
+static void mutexAcquired( mutexSite_t *site, mutexSite_t *holder, double waitStart )
+{
+	double now = getHighPrecTimeStamp();
+
+	site->wait.record( now - waitStart );
+	site->locks.fetch_add( 1, std::memory_order_relaxed );
+
+	// Blame the emulator thread's wait on whoever had the lock when it asked
+	if ( isEmulatorThread && (holder != nullptr) && (holder != site) )
+	{
+		holder->emuBlockedUs.fetch_add( (uint64_t)((now - waitStart) * 1e6), std::memory_order_relaxed );
+	}
+
+	if ( mutexLocks == 0 )
+	{
+		mutexHoldStart = now;
+		mutexHoldSite.store( site );
+	}
+	mutexLocks++;
+}
+
+// The console window's, or the headless console's without it
+static FCEU::mutex *emulatorMutex(void)
+{
+	if ( consoleWindow != NULL )
+	{
+		return &consoleWindow->emulatorMutex;
+	}
+	return ConsoleHeadless_t::emulatorMutex();
+}
+
+static void fceuWrapperLock( mutexSite_t *site )
+{
+	mutexSite_t *holder = mutexHoldSite.load();
+	double waitStart = getHighPrecTimeStamp();
+
+	FCEU::mutex *mtx = emulatorMutex();
+
+	mutexPending++;
+	if ( mtx != NULL )
+	{
+		mtx->lock();
+	}
+	mutexPending--;
+
+	mutexAcquired( site, holder, waitStart );
+}
+
+static bool fceuWrapperTryLock( mutexSite_t *site, int timeout )
+{
+	bool lockAcq = false;
+	mutexSite_t *holder = mutexHoldSite.load();
+	double waitStart = getHighPrecTimeStamp();
+
+	FCEU::mutex *mtx = emulatorMutex();
+
+	mutexPending++;
+	if ( mtx != NULL )
+	{
+		lockAcq = mtx->tryLock( timeout );
+	}
+	mutexPending--;
+
+	if ( lockAcq )
+	{
+		mutexAcquired( site, holder, waitStart );
+	}
+	else
+	{
+		site->timeouts.fetch_add( 1, std::memory_order_relaxed );
+	}
+	return lockAcq;
+}
+
 void fceuWrapperLock(const char *filename, int line, const char *func)
 {
-	fceuWrapperLock();
+	fceuWrapperLock( getMutexSite( filename, line, func ) );
 
 	if ( debugMutexLock )
 	{
@@ -1499,20 +2167,14 @@ void fceuWrapperLock(const char *filename, int line, const char *func)
 
 void fceuWrapperLock(void)
 {
-	mutexPending++;
-	if ( consoleWindow != NULL )
-	{
-		consoleWindow->emulatorMutex.lock();
-	}
-	mutexPending--;
-	mutexLocks++;
+	fceuWrapperLock( &unknownMutexSite );
 }
 
 bool fceuWrapperTryLock(const char *filename, int line, const char *func, int timeout)
 {
 	bool lockAcq = false;
 
-	lockAcq = fceuWrapperTryLock( timeout );
+	lockAcq = fceuWrapperTryLock( getMutexSite( filename, line, func ), timeout );
 
 	if ( lockAcq && debugMutexLock)
 	{
@@ -1527,30 +2189,38 @@ bool fceuWrapperTryLock(const char *filename, int line, const char *func, int ti
 
 bool fceuWrapperTryLock(int timeout)
 {
-	bool lockAcq = false;
-
-	mutexPending++;
-	if ( consoleWindow != NULL )
-	{
-		lockAcq = consoleWindow->emulatorMutex.tryLock( timeout );
-	}
-	mutexPending--;
-
-	if ( lockAcq )
-	{
-		mutexLocks++;
-	}
-	return lockAcq;
+	return fceuWrapperTryLock( &unknownMutexSite, timeout );
 }
 
 void fceuWrapperUnLock(void)
 {
 	if ( mutexLocks > 0 )
 	{
+		if ( mutexLocks == 1 )
+		{
+			emuStateSnapshotPublish();
+
+			mutexSite_t *site = mutexHoldSite.exchange( nullptr );
+
+			if ( site != nullptr )
+			{
+				site->hold.record( getHighPrecTimeStamp() - mutexHoldStart );
+			}
+		}
 		mutexLocks--;
-		if ( consoleWindow != NULL )
+
+		bool released = (mutexLocks == 0);
+
+		FCEU::mutex *mtx = emulatorMutex();
+
+		if ( mtx != NULL )
+		{
+			mtx->unlock();
+		}
+		if ( released && !isEmulatorThread )
 		{
-			consoleWindow->emulatorMutex.unlock();
+			// the GUI may have changed what a paused emulator shows
+			SpeedThrottleWake();
 		}
 	}
 	else
@@ -1560,16 +2230,162 @@ void fceuWrapperUnLock(void)
 	}
 }
 
+static void getMutexSiteStat( mutexSite_t *site, fceuMutexSiteStat_t &stat )
+{
+	char txt[32];
+	const char *file = site->file;
+
+	// __FILE__ is whatever path the compiler was given, keep the name only
+	for (const char *c = site->file; *c; c++)
+	{
+		if ( (*c == '/') || (*c == '\\') )
+		{
+			file = c + 1;
+		}
+	}
+	snprintf( txt, sizeof(txt), ":%i", site->line );
+
+	stat.site.assign( file );
+
+	if ( site->line > 0 )
+	{
+		stat.site.append( txt );
+	}
+	stat.func.assign( site->func );
+	stat.locks      = site->locks.load( std::memory_order_relaxed );
+	stat.timeouts   = site->timeouts.load( std::memory_order_relaxed );
+	stat.emuBlocked = (double)site->emuBlockedUs.load( std::memory_order_relaxed ) * 1e-6;
+
+	site->wait.getStats( &stat.wait );
+	site->hold.getStats( &stat.hold );
+}
+
+void fceuWrapperGetMutexStats( std::vector <fceuMutexSiteStat_t> &stats )
+{
+	std::vector <mutexSite_t*> sites;
+
+	{
+		std::lock_guard<std::mutex> guard( mutexSiteMapLock );
+
+		sites.push_back( &unknownMutexSite );
+
+		for (auto it = mutexSiteMap.begin(); it != mutexSiteMap.end(); it++)
+		{
+			sites.push_back( it->second );
+		}
+	}
+	stats.clear();
+
+	for (size_t i=0; i<sites.size(); i++)
+	{
+		fceuMutexSiteStat_t stat;
+
+		getMutexSiteStat( sites[i], stat );
+
+		if ( (stat.locks > 0) || (stat.timeouts > 0) )
+		{
+			stats.push_back( stat );
+		}
+	}
+	std::sort( stats.begin(), stats.end(),
+		[]( const fceuMutexSiteStat_t &a, const fceuMutexSiteStat_t &b )
+		{
+			return a.hold.total > b.hold.total;
+		} );
+}
+
+static void resetMutexSite( mutexSite_t *site )
+{
+	site->locks.store( 0, std::memory_order_relaxed );
+	site->timeouts.store( 0, std::memory_order_relaxed );
+	site->emuBlockedUs.store( 0, std::memory_order_relaxed );
+	site->wait.reset();
+	site->hold.reset();
+}
+
+void fceuWrapperResetMutexStats(void)
+{
+	std::lock_guard<std::mutex> guard( mutexSiteMapLock );
+
+	resetMutexSite( &unknownMutexSite );
+
+	for (auto it = mutexSiteMap.begin(); it != mutexSiteMap.end(); it++)
+	{
+		resetMutexSite( it->second );
+	}
+}
+
 bool fceuWrapperIsLocked(void)
 {
 	return mutexLocks > 0;
 }
 
+// True when a Lua script wants the next frame run without handing this one
+// to the frontend first, see emu.loopframes()
+static bool luaLoopFramePending(void)
+{
+#ifdef _S9XLUA_H
+	return GameInfo && !FCEUI_EmulationPaused() && !NetPlayActive() &&
+		(mutexPending == 0) && FCEU_LuaLoopFrame();
+#else
+	return false;
+#endif
+}
+
+// Something still wants the picture of a paused emulator now and then
+static bool videoConsumerAttached(void)
+{
+	if ( videoViewerVisible() || aviRecordRunning() || FCEU_ShmExportActive() )
+	{
+		return true;
+	}
+#ifdef __FCEU_REST_API_ENABLE__
+	if ( FrameStreamHub::instance().subscriberCount() > 0 )
+	{
+		return true;
+	}
+#endif
+	return false;
+}
+
+// Paused and nothing steps the emulator on its own, so there is no frame
+// to pace. Scripts keep the frame rate, they may draw while paused.
+static bool emulatorCanIdle(void)
+{
+	if ( !FCEUI_EmulationPaused() || FCEUI_FrameAdvanceRequested() || NetPlayActive() )
+	{
+		return false;
+	}
+#ifdef _S9XLUA_H
+	if ( FCEU_LuaRunning() )
+	{
+		return false;
+	}
+#endif
+#ifdef __FCEU_QSCRIPT_ENABLE__
+	auto* qscriptMgr = QtScriptManager::getInstance();
+
+	if ( (qscriptMgr != nullptr) && (qscriptMgr->numScriptsLoaded() > 0) )
+	{
+		return false;
+	}
+#endif
+#ifdef __FCEU_REST_API_ENABLE__
+	if ( !getRestApiCommandQueue().empty() )
+	{
+		return false;
+	}
+#endif
+	return true;
+}
+
 int  fceuWrapperUpdate( void )
 {
 	bool lock_acq;
 	static bool mutexLockFail = false;
 
+	isEmulatorThread = true;
+
 	// If a request is pending, 
 	// sleep to allow request to be serviced.
 	if ( mutexPending > 0 )
@@ -1577,7 +2393,11 @@ int  fceuWrapperUpdate( void )
 		msleep( 16 );
 	}
 
-	lock_acq = fceuWrapperTryLock( __FILE__, __LINE__, __func__ );
+	{
+		frameStageTimer mutexTimer( FRAME_STAGE_MUTEX );
+
+		lock_acq = fceuWrapperTryLock( __FILE__, __LINE__, __func__ );
+	}
 
 	if ( !lock_acq )
 	{
@@ -1615,35 +2435,58 @@ int  fceuWrapperUpdate( void )
  
 	if ( GameInfo )
 	{
+		// frames a Lua script asked for with emu.loopframes() run back to
+		// back here, without the unlock, frame signal and throttle below
+		do
+		{
 #ifdef __FCEU_REST_API_ENABLE__
-		// Process REST API commands early in the frame
-		processApiCommands();
+			// Process REST API commands early in the frame
+			processApiCommands();
 		
-		// Process pending button releases
-		InputReleaseManager::processPendingReleases();
+			// Process pending button releases
+			InputReleaseManager::processPendingReleases();
 #endif
 
 #ifdef __FCEU_QSCRIPT_ENABLE__
-		auto* qscriptMgr = QtScriptManager::getInstance();
+			auto* qscriptMgr = QtScriptManager::getInstance();
 
-		bool scriptsLoaded = (qscriptMgr != nullptr) && (qscriptMgr->numScriptsLoaded() > 0);
+			bool scriptsLoaded = (qscriptMgr != nullptr) && (qscriptMgr->numScriptsLoaded() > 0);
 
-		if (scriptsLoaded)
-		{
-			qscriptMgr->frameBeginUpdate();
-		}
+			if (scriptsLoaded)
+			{
+				qscriptMgr->frameBeginUpdate();
+			}
 #endif
 
-		DoFun(frameskip, periodic_saves);
+			DoFun(frameskip, periodic_saves);
+
+#ifdef __FCEU_REST_API_ENABLE__
+			// Hand the finished frame to stream subscribers
+			FrameStreamHub::instance().publish(currFrameCounter, XBuf, readStreamByte);
+			MemoryWatchHub::instance().evaluate(currFrameCounter, readStreamByte);
+			ObservationHub::instance().process(currFrameCounter, XBuf);
+
+			// Complete API steps, pausing again before the next frame if one asked to
+			if (FrameClock::instance().frameDone(currFrameCounter, FCEUI_GetLagged()))
+			{
+				FCEUI_SetEmulationPaused(EMULATIONPAUSED_PAUSED);
+			}
+#endif
+			FCEU_ShmExportUpdate();
 	
 #ifdef __FCEU_QSCRIPT_ENABLE__
-		if (scriptsLoaded)
-		{
-			qscriptMgr->frameFinishedUpdate();
-		}
+			if (scriptsLoaded)
+			{
+				qscriptMgr->frameFinishedUpdate();
+			}
 #endif
 
-		hexEditorUpdateMemoryValues();
+			hexEditorUpdateMemoryValues();
+
+			ramWatchFrameUpdate();
+			ramSearchFrameUpdate();
+		}
+		while ( luaLoopFramePending() );
 
 		fceuWrapperUnLock();
 
@@ -1657,11 +2500,21 @@ int  fceuWrapperUpdate( void )
 #ifdef __FCEU_PROFILER_ENABLE__
 		FCEU_profiler_log_thread_activity();
 #endif
-		while ( SpeedThrottle() )
+		if ( emulatorCanIdle() )
 		{
-			// Input device processing is in main thread
-			// because to MAC OS X SDL2 requires it.
-			//FCEUD_UpdateInput(); 
+			// Woken by the GUI releasing the emulator mutex, the pause and
+			// frame advance keys or a REST command. The paused picture is
+			// only redrawn while something looks at it.
+			SpeedThrottleIdle( videoConsumerAttached() ? 50 : 1000 );
+		}
+		else
+		{
+			while ( SpeedThrottle() )
+			{
+				// Input device processing is in main thread
+				// because to MAC OS X SDL2 requires it.
+				//FCEUD_UpdateInput(); 
+			}
 		}
 	}
 	else
@@ -1680,47 +2533,10 @@ int  fceuWrapperUpdate( void )
 
 static int minizip_ScanArchive( const char *filepath, ArchiveScanRecord &rec)
 {
-	int idx=0, ret;
-	unzFile zf;
-	unz_file_info fi;
-	char filename[512];
-
-	zf = unzOpen( filepath );
-
-	if ( zf == NULL )
-	{
-		//printf("Error: Failed to open Zip File: '%s'\n", fname.c_str() );
-		return -1;
-	}
-	rec.type = 0;
-
-	ret = unzGoToFirstFile( zf );
-
-	//printf("unzGoToFirstFile: %i \n", ret );
+	// the zip's central directory, with where each entry is
+	rec = FCEU_ScanZip( filepath );
 
-	while ( ret == 0 )
-	{
-		FCEUARCHIVEFILEINFO_ITEM item;
-
-		unzGetCurrentFileInfo( zf, &fi, filename, sizeof(filename), NULL, 0, NULL, 0 );
-
-		//printf("Filename: %u '%s' \n", fi.uncompressed_size, filename );
-
-		item.name.assign( filename );
-		item.size  = fi.uncompressed_size;
-		item.index = idx; idx++;
-
-		rec.files.push_back( item );
-
-		ret = unzGoToNextFile( zf );
-
-		//printf("unzGoToNextFile: %i \n", ret );
-	}
-	rec.numFilesInArchive = idx;
-
-	unzClose( zf );
-
-	return 0;
+	return rec.isArchive() ? 0 : -1;
 }
 
 #ifdef _USE_LIBARCHIVE
@@ -1798,105 +2614,61 @@ ArchiveScanRecord FCEUD_ScanArchive(std::string fname)
 {
 	int ret = -1;
 	ArchiveScanRecord rec;
-		
-#ifdef _USE_LIBARCHIVE
-	ret = libarchive_ScanArchive( fname.c_str(), rec );
-#endif
 
+	// zips first, minizip can go straight to an entry where libarchive reads up to it
+	ret = minizip_ScanArchive( fname.c_str(), rec );
+
+#ifdef _USE_LIBARCHIVE
 	if (ret == -1)
 	{
-		minizip_ScanArchive( fname.c_str(), rec );
+		rec = ArchiveScanRecord();
+		libarchive_ScanArchive( fname.c_str(), rec );
 	}
+#endif
 	return rec;
 }
 
 static FCEUFILE* minizip_OpenArchive(ArchiveScanRecord& asr, std::string &fname, std::string *searchFile, int innerIndex )
 {
-	int ret, idx=0;
 	FCEUFILE* fp = nullptr;
-	void *tmpMem = nullptr;
-	unzFile zf;
-	unz_file_info fi;
-	char filename[512];
-	bool foundFile = false;
-
-	zf = unzOpen( fname.c_str() );
-
-	if ( zf == NULL )
-	{
-		//printf("Error: Failed to open Zip File: '%s'\n", fname.c_str() );
-		return fp;
-	}
+	ArchiveScanRecord zip = FCEU_ScanZip( fname );
+	const FCEUARCHIVEFILEINFO_ITEM *item = nullptr;
 
-	//printf("Searching for %s in %s \n", searchFile.c_str(), fname.c_str() );
-
-	ret = unzGoToFirstFile( zf );
-
-	//printf("unzGoToFirstFile: %i \n", ret );
-
-	while ( ret == 0 )
+	for (size_t i=0; i<zip.files.size(); i++)
 	{
-		unzGetCurrentFileInfo( zf, &fi, filename, sizeof(filename), NULL, 0, NULL, 0 );
-
-		//printf("Filename: %u '%s' \n", fi.uncompressed_size, filename );
-
 		if ( (searchFile != nullptr) && !searchFile->empty())
 		{
-			if ( strcmp( searchFile->c_str(), filename ) == 0 )
+			if ( zip.files[i].name == *searchFile )
 			{
-			   //printf("Found Filename: %u '%s' \n", fi.uncompressed_size, filename );
-				foundFile = true; break;
+				item = &zip.files[i]; break;
 			}
 		}
-		else if ((innerIndex != -1) && (idx == innerIndex))
+		else if ((innerIndex != -1) && (zip.files[i].index == static_cast<uint32>(innerIndex)))
 		{
-			foundFile = true; break;
+			item = &zip.files[i]; break;
 		}
-
-		ret = unzGoToNextFile( zf );
-
-		//printf("unzGoToNextFile: %i \n", ret );
-		idx++;
 	}
 
-	if ( !foundFile )
+	if ( item == nullptr )
 	{
-		unzClose( zf );
 		return fp;
 	}
 
-	tmpMem = ::malloc( fi.uncompressed_size );
+	fp = FCEU_UnzipFile( fname, *item );
 
-	if ( tmpMem == NULL )
+	if ( fp == nullptr )
 	{
-		unzClose( zf );
 		return fp;
 	}
-	//printf("Loading via minizip\n");
-
-	EMUFILE_MEMORY* ms = new EMUFILE_MEMORY(fi.uncompressed_size);
-
-	unzOpenCurrentFile( zf );
-	unzReadCurrentFile( zf, tmpMem, fi.uncompressed_size );
-	unzCloseCurrentFile( zf );
-
-	ms->fwrite( tmpMem, fi.uncompressed_size );
-
-	free( tmpMem );
 
 	//if we extracted the file correctly
-	fp = new FCEUFILE();
 	fp->archiveFilename = fname;
-	fp->filename = filename;
+	fp->filename = item->name;
 	fp->fullFilename = fp->archiveFilename + "|" + fp->filename;
-	fp->archiveIndex = idx;
+	fp->archiveIndex = item->index;
 	fp->mode = FCEUFILE::READ;
-	fp->size = fi.uncompressed_size;
-	fp->stream = ms;
 	fp->archiveCount = (int)asr.numFilesInArchive;
-	ms->fseek(0,SEEK_SET); //rewind so that the rom analyzer sees a freshly opened file
-
-	unzClose( zf );
+	fp->stream->fseek(0,SEEK_SET); //rewind so that the rom analyzer sees a freshly opened file
 
 	return fp;
 }
@@ -2035,6 +2807,15 @@ void fceuWrapperClearArchiveFileLoadIndex()
 	archiveFileLoadIndex = -1;
 }
 
+int fceuWrapperSetThreadAffinity(const char *option)
+{
+	std::string cpus;
+
+	g_config->getOption( option, &cpus );
+
+	return fceu_set_thread_affinity( cpus.c_str() );
+}
+
 FCEUFILE* FCEUD_OpenArchive(ArchiveScanRecord& asr, std::string& fname, std::string* innerFilename, int* userCancel)
 {
 	FCEUFILE* fp = nullptr;
@@ -2093,14 +2874,14 @@ FCEUFILE* FCEUD_OpenArchive(ArchiveScanRecord& asr, std::string& fname, std::str
 		//printf("Archive Search File: %s\n", searchFile.c_str());
 	}
 
-#ifdef _USE_LIBARCHIVE
-	fp = libarchive_OpenArchive(asr, fname, &searchFile, archiveFileLoadIndex );
-#endif
+	fp = minizip_OpenArchive(asr, fname, &searchFile, archiveFileLoadIndex );
 
+#ifdef _USE_LIBARCHIVE
 	if (fp == nullptr)
 	{
-		fp = minizip_OpenArchive(asr, fname, &searchFile, archiveFileLoadIndex );
+		fp = libarchive_OpenArchive(asr, fname, &searchFile, archiveFileLoadIndex );
 	}
+#endif
 	//printf("Archive File Index: %i\n", fp->archiveIndex);
 	return fp;
 }
@@ -2116,13 +2897,14 @@ FCEUFILE* FCEUD_OpenArchiveIndex(ArchiveScanRecord& asr, std::string &fname, int
 {
 	FCEUFILE* fp = nullptr;
 
+	fp = minizip_OpenArchive(asr, fname, nullptr, innerIndex);
+
 #ifdef _USE_LIBARCHIVE
-	fp = libarchive_OpenArchive( asr, fname, nullptr, innerIndex );
-#endif
 	if (fp == nullptr)
 	{
-		fp = minizip_OpenArchive(asr, fname, nullptr, innerIndex);
+		fp = libarchive_OpenArchive( asr, fname, nullptr, innerIndex );
 	}
+#endif
 
 	return fp;
 }
@@ -1,7 +1,11 @@
 // fceuWrapper.h
 //
+#include <string>
+#include <vector>
+
 #include "Qt/config.h"
 #include "Qt/dface.h"
+#include "Qt/TimingHistogram.h"
 
 //*****************************************************************
 // Define Global Variables to be shared with FCEU Core
@@ -48,7 +52,28 @@ int  fceuWrapperHardReset(void);
 int  fceuWrapperTogglePause(void);
 bool fceuWrapperGameLoaded(void);
 void fceuWrapperRequestAppExit(void);
+void fceuWrapperStartupFinished(const char *mark);
 void fceuWrapperClearArchiveFileLoadIndex(void);
+
+// Pins the calling thread to the CPUs of an SDL.*ThreadCpus option
+int  fceuWrapperSetThreadAffinity(const char *option);
+
+// Emulator mutex contention, kept per call site of the lock. Sites that take
+// the lock without the FCEU_WRAPPER_* macros are counted as "(unknown)".
+struct fceuMutexSiteStat_t
+{
+	std::string  site;   // file:line
+	std::string  func;
+	unsigned long long  locks;
+	unsigned long long  timeouts;
+	double  emuBlocked;  // seconds the emulator thread waited while this site held the lock
+	struct timingHistStat_t  wait;
+	struct timingHistStat_t  hold;
+};
+
+// Filled in worst first, by total hold time
+void fceuWrapperGetMutexStats( std::vector <fceuMutexSiteStat_t> &stats );
+void fceuWrapperResetMutexStats(void);
 void fceuWrapperSetArchiveFileLoadIndex(int idx);
 
 class  fceuCriticalSection
@@ -37,6 +37,7 @@
 #include "Qt/sdl.h"
 #include "Qt/sdl-video.h"
 #include "Qt/sdl-joystick.h"
+#include "Qt/throttle.h"
 
 #include "common/cheat.h"
 #include "../../movie.h"
@@ -50,6 +51,7 @@
 
 #include <cstring>
 #include <cstdio>
+#include <atomic>
 
 /** GLOBALS **/
 int NoWaiting = 0;
@@ -65,6 +67,14 @@ static int CurInputType[NUM_INPUT_DEVICES] = {SI_GAMEPAD, SI_GAMEPAD, SI_NONE};
 static int cspec = 0;
 static int buttonConfigInProgress = 0;
 
+// A key, joystick or binding changed since the bindings were last tested.
+// FCEUD_UpdateInput only tests them again when this is set, or while an
+// autofire button or frame advance is held, as those change with time.
+static std::atomic<bool> inputBindingsDirty(true);
+static bool autoFireHeld = false;
+static bool frameAdvancing = false;
+static bool moviePlaying = false;
+
 extern int gametype;
 static int DTestButton(ButtConfig *bc, bool isFKB = false);
 
@@ -141,6 +151,10 @@ static void UpdateTopRider(void);
 
 static uint32 JSreturn = 0;
 
+static uint32 SampleGamepad(bool *exitCombo);
+class inputSampleThread_t;
+static inputSampleThread_t *inputSampleThread = nullptr;
+
 #include "keyscan.h"
 static uint8_t g_keyState[SDL_NUM_SCANCODES];
 static int keyModifier = 0;
@@ -597,6 +611,7 @@ void gamepad_function_key_t::updateStatus(void)
 void TogglePause(void)
 {
 	FCEUI_ToggleEmulationPause();
+	SpeedThrottleWake();
 
 	int no_cursor;
 	g_config->getOption("SDL.NoFullscreenCursor", &no_cursor);
@@ -770,6 +785,7 @@ void toggleFamilyKeyboardFunc(void)
 	if (CurInputType[2] == SIFC_FKB)
 	{
 		g_fkbEnabled = !g_fkbEnabled;
+		inputBindingsDirty = true;
 
 		FCEUI_DispMessage("Family Keyboard %sabled.", 0,
 						  g_fkbEnabled ? "En" : "Dis");
@@ -1017,13 +1033,13 @@ static void KeyboardCommands(void)
 		//printf("NoWaiting: 0x%04x\n", NoWaiting );
 	}
 
-	static bool frameAdvancing = false;
 	if (Hotkeys[HK_FRAME_ADVANCE].getState())
 	{
 		if (frameAdvancing == false)
 		{
 			frameAdvHoldTimer = 0;
 			FCEUI_FrameAdvance();
+			SpeedThrottleWake();
 			frameAdvancing = true;
 			//printf("Frame Advance Start\n");
 		}
@@ -1231,7 +1247,7 @@ void GetMouseData(uint32 (&d)[3])
 
 	b = 0; // map mouse buttons
 
-	if (consoleWindow->viewport_Interface)
+	if (consoleWindow && consoleWindow->viewport_Interface)
 	{
 		consoleWindow->viewport_Interface->getNormalizedCursorPos(nx, ny);
 
@@ -1286,6 +1302,34 @@ void GetMouseRelative(int32 (&d)[3])
 //{
 //	printf("Key State is: %i \n", g_keyState[ scanCode ] );
 //}
+/**
+ * Time stamps gamepad presses for the input to photon latency. SDL stamps its
+ * events in milliseconds when it pumps them in.
+ */
+static void
+markInputEvent(const SDL_Event &event)
+{
+	bool press = false;
+
+	switch (event.type)
+	{
+	case SDL_JOYBUTTONDOWN:
+	case SDL_CONTROLLERBUTTONDOWN:
+		press = true;
+		break;
+	case SDL_JOYHATMOTION:
+		press = (event.jhat.value != SDL_HAT_CENTERED);
+		break;
+	case SDL_JOYAXISMOTION:
+		press = (abs(event.jaxis.value) >= 0x4000);
+		break;
+	}
+	if (press)
+	{
+		inputEventMark( getHighPrecTimeStamp() - 1e-3 * (SDL_GetTicks() - event.common.timestamp) );
+	}
+}
+
 /**
  * Handles outstanding SDL events.
  */
@@ -1297,8 +1341,17 @@ pollEventsSDL()
 	// loop, handling all pending events
 	while (SDL_PollEvent(&event))
 	{
+		markInputEvent(event);
+
 		switch (event.type)
 		{
+		case SDL_JOYAXISMOTION:
+		case SDL_JOYHATMOTION:
+		case SDL_JOYBALLMOTION:
+		case SDL_JOYBUTTONDOWN:
+		case SDL_JOYBUTTONUP:
+			inputBindingsDirty = true;
+			break;
 		case SDL_QUIT:
 			CloseGame();
 			puts("Quit");
@@ -1359,11 +1412,15 @@ pollEventsSDL()
 
 			g_keyState[event.key.keysym.scancode] = (event.type == SDL_KEYDOWN) ? 1 : 0;
 
+			inputBindingsDirty = true;
+
 			KeyboardCommands();
 
 			break;
 		case SDL_JOYDEVICEADDED:
 			{
+				inputBindingsDirty = true;
+
 				int devIdx = AddJoystick(event.jdevice.which);
 				if (devIdx >= 0)
 				{
@@ -1410,6 +1467,7 @@ pollEventsSDL()
 			}
 			break;
 		case SDL_JOYDEVICEREMOVED:
+			inputBindingsDirty = true;
 			RemoveJoystick(event.jdevice.which);
 			break;
 		default:
@@ -1442,6 +1500,18 @@ int ButtonConfigBegin()
 void ButtonConfigEnd()
 {
 	buttonConfigInProgress = 0;
+
+	inputBindingsDirty = true;
+}
+
+/**
+ * Has the next FCEUD_UpdateInput test every binding, for changes that
+ * don't come in as an SDL event: a binding edited or loaded, or a
+ * virtual key clicked.
+ */
+void inputBindingsChanged(void)
+{
+	inputBindingsDirty = true;
 }
 
 /**
@@ -1520,15 +1590,46 @@ UpdateGamepad(void)
 	{
 		return;
 	}
+	bool exitCombo = false;
+
+	uint32 JS = SampleGamepad(&exitCombo);
+
+	if (exitCombo)
+	{
+		FCEUI_printf("all buttons pressed, exiting\n");
+		CloseGame();
+		FCEUI_Kill();
+		exit(0);
+	}
+	JSreturn = JS;
+
+	autoFireHeld = false;
+
+	for (int wg = 0; wg < 4; wg++)
+	{
+		if (GamePad[wg].bmapState[8] || GamePad[wg].bmapState[9])
+		{
+			autoFireHeld = true;
+		}
+	}
+}
 
+/**
+ * Test the gamepad button mappings, returns the four pads' buttons.
+ */
+static uint32
+SampleGamepad(bool *exitCombo)
+{
 	uint32 JS = 0;
 	int x,c;
 	int wg;
 	bool fire;
 	char btns[GAMEPAD_NUM_BUTTONS];
 
-	int opposite_dirs;
+	// the options are looked up once per poll, not once per pad and config
+	int opposite_dirs, four_button_exit;
 	g_config->getOption("SDL.Input.EnableOppositeDirectionals", &opposite_dirs);
+	g_config->getOption("SDL.ABStartSelectExit", &four_button_exit);
 
 	// go through each of the four game pads
 	for (wg = 0; wg < 4; wg++)
@@ -1570,15 +1671,11 @@ UpdateGamepad(void)
 				}
 			}
 
-			int four_button_exit;
-			g_config->getOption("SDL.ABStartSelectExit", &four_button_exit);
 			// if a+b+start+select is pressed, exit
 			if (four_button_exit && JS == 15)
 			{
-				FCEUI_printf("all buttons pressed, exiting\n");
-				CloseGame();
-				FCEUI_Kill();
-				exit(0);
+				*exitCombo = true;
+				return JS;
 			}
 
 			// rapid-fire a, rapid-fire b
@@ -1610,7 +1707,116 @@ UpdateGamepad(void)
 	//   if((JS & (0x30<<x) ) == (0x30<<x) ) JS&=~(0x30<<x);
 	//  }
 
-	JSreturn = JS;
+	return JS;
+}
+
+// Samples the gamepads every SDL.Input.SamplePeriodUs, so the core can take
+// the newest state when the game strobes the pads rather than what the GUI
+// thread saw on its last pass. The four pads are one 32 bit word, an atomic
+// store publishes a complete sample.
+class inputSampleThread_t : public QThread
+{
+	public:
+		inputSampleThread_t( int periodUs )
+			: periodUs(periodUs), quit(false), latest(0), exitCombo(false)
+		{
+		}
+
+		void requestQuit(void){ quit = true; }
+
+		uint32 sample(void){ return latest.load(std::memory_order_acquire); }
+
+		bool exitRequested(void){ return exitCombo.load(std::memory_order_acquire); }
+
+	protected:
+		void run(void) override
+		{
+			while (!quit)
+			{
+				bool exitPressed = false;
+
+				// keeps the GUI thread from closing a device while it is read
+				SDL_LockJoysticks();
+				SDL_JoystickUpdate();
+
+				uint32 JS = SampleGamepad(&exitPressed);
+
+				SDL_UnlockJoysticks();
+
+				latest.store(JS, std::memory_order_release);
+
+				if (exitPressed)
+				{
+					exitCombo.store(true, std::memory_order_release);
+				}
+				QThread::usleep(periodUs);
+			}
+		}
+
+		int periodUs;
+		std::atomic<bool>   quit;
+		std::atomic<uint32> latest;
+		std::atomic<bool>   exitCombo;
+};
+
+/**
+ * Emulation thread, the core takes the pads from JSreturn.
+ */
+static void
+InputSamplerFunc(void)
+{
+	JSreturn = inputSampleThread->sample();
+}
+
+/**
+ * Start the input sampling thread, if it is enabled.
+ */
+void inputSampleThreadStart(void)
+{
+	int enable = 0, periodUs = 1000;
+
+	g_config->getOption("SDL.Input.SampleThread", &enable);
+	g_config->getOption("SDL.Input.SamplePeriodUs", &periodUs);
+
+	if (!enable || (inputSampleThread != nullptr))
+	{
+		return;
+	}
+	if (periodUs < 100)
+	{
+		periodUs = 100;
+	}
+	else if (periodUs > 8000)
+	{
+		periodUs = 8000;
+	}
+	inputSampleThread = new inputSampleThread_t(periodUs);
+
+	inputSampleThread->start(QThread::TimeCriticalPriority);
+
+	FCEU_WRAPPER_LOCK();
+	FCEUI_SetInputSampler(InputSamplerFunc);
+	FCEU_WRAPPER_UNLOCK();
+}
+
+/**
+ * Stop the input sampling thread, before the joysticks are closed.
+ */
+void inputSampleThreadStop(void)
+{
+	if (inputSampleThread == nullptr)
+	{
+		return;
+	}
+	FCEU_WRAPPER_LOCK();
+	FCEUI_SetInputSampler(nullptr);
+	FCEU_WRAPPER_UNLOCK();
+
+	inputSampleThread->requestQuit();
+	inputSampleThread->wait();
+
+	delete inputSampleThread;
+	inputSampleThread = nullptr;
 }
 
 static ButtConfig powerpadsc[2][12] = {
@@ -1689,10 +1895,30 @@ void FCEUD_UpdateInput(void)
 		return;
 	}
 
-	updateGamePadKeyMappings();
-
 	pollEventsSDL();
-	KeyboardCommands();
+
+	// the device functions leave their state alone during playback, so
+	// test the bindings once playback starts or stops
+	if (FCEUMOV_Mode(MOVIEMODE_PLAY) != moviePlaying)
+	{
+		moviePlaying = !moviePlaying;
+		inputBindingsDirty = true;
+	}
+
+	// nothing a binding looks at has changed since the last pass, the
+	// buffers the core reads still hold what those bindings gave
+	bool rescan = inputBindingsDirty.exchange(false) || autoFireHeld;
+
+	if (rescan)
+	{
+		updateGamePadKeyMappings();
+	}
+	if (rescan || frameAdvancing)
+	{
+		KeyboardCommands();
+	}
+
+	inputPollMark();
 
 	for (x = 0; x < 2; x++)
 	{
@@ -1710,7 +1936,10 @@ void FCEUD_UpdateInput(void)
 			break;
 		case SI_POWERPADA:
 		case SI_POWERPADB:
-			powerpadbuf[x] = UpdatePPadData(x);
+			if (rescan)
+			{
+				powerpadbuf[x] = UpdatePPadData(x);
+			}
 			break;
 		case SI_MOUSE:
 		case SI_SNES_MOUSE:
@@ -1728,26 +1957,41 @@ void FCEUD_UpdateInput(void)
 		t |= 2;
 		break;
 	case SIFC_FKB:
-		if (g_fkbEnabled)
+		if (g_fkbEnabled && rescan)
 		{
 			UpdateFKB();
 		}
 		break;
 	case SIFC_HYPERSHOT:
-		UpdateHyperShot();
+		if (rescan)
+		{
+			UpdateHyperShot();
+		}
 		break;
 	case SIFC_MAHJONG:
-		UpdateMahjong();
+		if (rescan)
+		{
+			UpdateMahjong();
+		}
 		break;
 	case SIFC_QUIZKING:
-		UpdateQuizKing();
+		if (rescan)
+		{
+			UpdateQuizKing();
+		}
 		break;
 	case SIFC_FTRAINERB:
 	case SIFC_FTRAINERA:
-		UpdateFTrainer();
+		if (rescan)
+		{
+			UpdateFTrainer();
+		}
 		break;
 	case SIFC_TOPRIDER:
-		UpdateTopRider();
+		if (rescan)
+		{
+			UpdateTopRider();
+		}
 		break;
 	case SIFC_OEKAKIDS:
 		t |= 2;
@@ -1756,7 +2000,20 @@ void FCEUD_UpdateInput(void)
 
 	if (t & 1)
 	{
-		UpdateGamepad();
+		if (inputSampleThread == nullptr)
+		{
+			if (rescan)
+			{
+				UpdateGamepad();
+			}
+		}
+		else if (inputSampleThread->exitRequested())
+		{
+			FCEUI_printf("all buttons pressed, exiting\n");
+			CloseGame();
+			FCEUI_Kill();
+			exit(0);
+		}
 	}
 
 	// Don't get input when a movie is playing back
@@ -1814,6 +2071,8 @@ void InitInputInterface()
 
 	memset(g_keyState, 0, sizeof(g_keyState));
 
+	inputBindingsDirty = true;
+
 	for (t = 0, x = 0; x < 2; x++)
 	{
 		attrib = 0;
@@ -2927,6 +3186,7 @@ void UpdateInput(Config *config)
 		fkbmap[j].DeviceNum = devnum;
 		fkbmap[j].ButtonNum = button;
 	}
+	inputBindingsDirty = true;
 }
 
 // Definitions from main.h:
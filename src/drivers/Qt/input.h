@@ -36,6 +36,7 @@ void setHotKeys(void);
 int getKeyState( int k );
 int ButtonConfigBegin();
 void ButtonConfigEnd();
+void inputBindingsChanged(void);
 void ConfigButton(char *text, ButtConfig *bc);
 int DWaitButton(const uint8_t *text, ButtConfig *bc, int *buttonConfigStatus = NULL);
 
@@ -124,6 +125,8 @@ struct gamepad_function_key_t
 #define SDL_FCEU_HOTKEY_EVENT	SDL_USEREVENT
 
 void InitInputInterface(void);
+void inputSampleThreadStart(void);
+void inputSampleThreadStop(void);
 void InputUserActiveFix(void);
 
 extern bool replaceP2StartWithMicrophone;
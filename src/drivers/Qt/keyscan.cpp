@@ -24,6 +24,7 @@
 #include <SDL.h>
 
 #include "Qt/keyscan.h"
+#include "Qt/throttle.h"
 
 using namespace Qt;
 
@@ -1658,6 +1659,11 @@ int pushKeyEvent(QKeyEvent *event, int pressDown)
 	{
 		sdlev.type = SDL_KEYDOWN;
 		sdlev.key.state = SDL_PRESSED;
+
+		if (!event->isAutoRepeat())
+		{
+			inputEventMark( getHighPrecTimeStamp() );
+		}
 	}
 	else
 	{
@@ -25,9 +25,12 @@
 //#include <QProxyStyle>
 
 #include "Qt/ConsoleWindow.h"
+#include "Qt/ConsoleKiosk.h"
+#include "Qt/ConsoleHeadless.h"
 #include "Qt/fceuWrapper.h"
 #include "Qt/SplashScreen.h"
 #include "Qt/QtScriptManager.h"
+#include "../../startuptime.h"
 
 #if defined(WIN32) && (QT_VERSION_MAJOR < 6)
 #include <QtPlatformHeaders/QWindowsWindowFunctions>
@@ -103,10 +106,17 @@ int main( int argc, char *argv[] )
 {
 	int retval = 0;
 
+	FCEU_StartupTimingStart();
+
 	fceuWrapperPreInit(argc, argv);
 
+	// Headless there are no widgets, so no display server to connect to
+	bool headless = ConsoleHeadless_t::requested(argc, argv);
+
 	qInstallMessageHandler(MessageOutput);
-	QApplication app(argc, argv);
+	FCEU_StartupPhase qtInitPhase("qt_init");
+	QCoreApplication *app = headless ? new QCoreApplication(argc, argv) : new QApplication(argc, argv);
+	qtInitPhase.end();
 
 	QCoreApplication::setOrganizationName("TasEmulators");
 	QCoreApplication::setOrganizationDomain("TasEmulators.org");
@@ -114,11 +124,11 @@ int main( int argc, char *argv[] )
 
 	fceuSplashScreen *splash = NULL;
 	
-	if ( showSplashScreen() )
+	if ( !headless && showSplashScreen() )
 	{
 		splash = new fceuSplashScreen();
 		splash->show();
-		app.processEvents();
+		app->processEvents();
 	}
 
 	#ifdef WIN32
@@ -152,9 +162,46 @@ int main( int argc, char *argv[] )
 
 	fceuWrapperInit( argc, argv );
 
+	if ( headless )
+	{
+		ConsoleHeadless_t::start();
+
+		if ( !fceuWrapperGameLoaded() )
+		{
+			fceuWrapperStartupFinished("headless");
+		}
+
+		retval = app->exec();
+
+		ConsoleHeadless_t::stop();
+
+		fceuWrapperMemoryCleanup();
+
+		delete app;
+
+		return retval;
+	}
+
+	FCEU_StartupPhase windowPhase("main_window");
+
 	consoleWindow = new consoleWin_t();
 
-	consoleWindow->show();
+	int kiosk = 0;
+	g_config->getOption("SDL.Kiosk", &kiosk);
+
+	// The kiosk window takes the screen, the console window stays hidden
+	if ( !kiosk || !ConsoleKiosk_t::start( QGuiApplication::primaryScreen() ) )
+	{
+		consoleWindow->show();
+	}
+
+	windowPhase.end();
+
+	// Without a game no frame comes, startup ends here
+	if ( !fceuWrapperGameLoaded() )
+	{
+		fceuWrapperStartupFinished("window_shown");
+	}
 
 	// Need to wait for window to initialize before video init can be called.
 	//consoleWindow->videoInit();
@@ -174,14 +221,18 @@ int main( int argc, char *argv[] )
 		//delete splash; this is handled by Qt event loop
 	}
 
-	retval = app.exec();
+	retval = app->exec();
 
 	//printf("App Return: %i \n", retval );
 
+	ConsoleKiosk_t::stop();
+
 	delete consoleWindow;
 
 	fceuWrapperMemoryCleanup();
 
+	delete app;
+
 	return retval;
 }
 
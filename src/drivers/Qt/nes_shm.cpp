@@ -30,9 +30,8 @@ nes_shm_t *open_nes_shm(void)
 {
 	nes_shm_t *vaddr;
 
-	vaddr = (nes_shm_t*)malloc( sizeof(struct nes_shm_t) );
-
-	memset( vaddr, 0, sizeof(struct nes_shm_t));
+	// calloc leaves the pages of the large buffers untouched until drawn into
+	vaddr = (nes_shm_t*)calloc( 1, sizeof(struct nes_shm_t) );
 
 	vaddr->video.ncol      = GL_NES_WIDTH;
 	vaddr->video.nrow      = GL_NES_HEIGHT;
@@ -13,6 +13,7 @@
 #define  GL_NES_HEIGHT  240
 #define  NES_VIDEO_BUFLEN   5
 #define  NES_AUDIO_BUFLEN   480000
+#define  NES_GUI_MAX_CMDS   16384
 
 struct  nes_shm_t
 {
@@ -30,6 +31,7 @@ struct  nes_shm_t
 		int   yscale;
 		int   xyRatio;
 		int   preScaler;
+		int   gpuScaler; // 2 or 3 when the OpenGL viewer runs scale2x/scale3x, else 0
 		int   test;
 	} video;
 
@@ -40,10 +42,49 @@ struct  nes_shm_t
 	uint32_t  pixbuf[NES_VIDEO_BUFLEN][1048576]; // 1024 x 1024
 	uint32_t  avibuf[1048576]; // 1024 x 1024
 
+	// Lua gui drawing of the last blit, for the OpenGL viewer to draw over
+	// the picture (see FCEU_LuaGetGuiOverlay). Coordinates are NES pixels.
+	struct guiCmd_t
+	{
+		int16_t  x1, y1, x2, y2;
+		uint32_t colour;  // ARGB
+		int      line;
+	};
+
+	struct guiOverlay_t
+	{
+		int       composite;  // set by the viewer that can draw it
+		int       active;     // there is drawing
+		int       x0, y0;     // NES pixel at the picture's top left
+		int       width;      // NES pixels across and down the picture
+		int       height;
+		int       ncmd;
+		int       layerUsed;
+		guiCmd_t  cmd[NES_GUI_MAX_CMDS];
+		uint32_t  layer[GL_NES_WIDTH * GL_NES_HEIGHT];
+	} gui;
+
+	// Pixels of each buffer written to so far. The buffers are sized for
+	// the largest scaler, but only the pages drawn into become resident.
+	int   pixBufUsed;
+
+	void use_pixbuf(void)
+	{
+		int n = video.ncol * video.nrow;
+
+		if ( n > pixBufUsed )
+		{
+			pixBufUsed = (n < 1048576) ? n : 1048576;
+		}
+	}
+
 	void clear_pixbuf(void)
 	{
-		memset( pixbuf, 0, sizeof(pixbuf) );
-		memset( avibuf, 0, sizeof(avibuf) );
+		for (int i=0; i<NES_VIDEO_BUFLEN; i++)
+		{
+			memset( pixbuf[i], 0, pixBufUsed * sizeof(uint32_t) );
+		}
+		memset( avibuf, 0, pixBufUsed * sizeof(uint32_t) );
 	}
 
 	struct sndBuf_t
@@ -46,6 +46,8 @@
 #include "../../debug.h"
 #include "../../palette.h"
 
+#include "common/ppu_capture.h"
+#include "common/chr_tile_cache.h"
 #include "Qt/ppuViewer.h"
 #include "Qt/main.h"
 #include "Qt/dface.h"
@@ -55,6 +57,7 @@
 #include "Qt/fceuWrapper.h"
 #include "Qt/ConsoleWindow.h"
 #include "Qt/ConsoleUtilities.h"
+#include "Qt/FrameDispatcher.h"
 #include "Qt/PaletteEditor.h"
 #include "Qt/ColorMenu.h"
 
@@ -77,11 +80,20 @@ static int PPUView_sprite16Mode[2] = { 0, 0 };
 static int pindex[2] = { 0, 0 };
 static uint8_t pallast[32+3] = { 0 }; // palette cache for change comparison
 static uint8_t palcache[36] = { 0 }; //palette cache for drawing
-static uint8_t chrcache0[0x1000] = {0}, chrcache1[0x1000] = {0}, logcache0[0x1000] = {0}, logcache1[0x1000] = {0}; //cache CHR, fixes a refresh problem when right-clicking
-static uint8_t oam[256];
+static uint8_t oam[256]; // sprites as last drawn
 static bool	redrawWindow = true;
 
+// written on the emulator thread, decoded on the GUI thread
+static PPUCapture ppuCapture;
+static CHRTileCache tileCache;
+static uint32_t drawnChrVersion[8];
+static int drawnPal[2] = { -1, -1 };
+static int drawnMask = -1;
+static int drawnCtrl = -1;
+static uint32_t drawnSeq = 0;
+
 static void initPPUViewer(void);
+static void ppuViewDecode( bool force );
 static ppuPatternTable_t pattern0;
 static ppuPatternTable_t pattern1;
 static oamPatternTable_t oamPattern;
@@ -445,11 +457,7 @@ ppuViewerDialog_t::ppuViewerDialog_t(QWidget *parent)
 	// End Menu 
 	//-----------------------------------------------------------------------
 
-	updateTimer  = new QTimer( this );
-
-	connect( updateTimer, &QTimer::timeout, this, &ppuViewerDialog_t::periodicUpdate );
-
-	updateTimer->start( 33 ); // 30hz
+	FrameDispatcher::instance()->addView( this, 33, [this]{ periodicUpdate(); } ); // 30hz
 
 	restoreGeometry(settings.value("ppuViewer/geometry").toByteArray());
 
@@ -461,7 +469,7 @@ ppuViewerDialog_t::~ppuViewerDialog_t(void)
 {
 	QSettings settings;
 
-	updateTimer->stop();
+	FrameDispatcher::instance()->removeView( this );
 	ppuViewWindow = NULL;
 
 	//printf("PPU Viewer Window Deleted\n");
@@ -489,6 +497,8 @@ void ppuViewerDialog_t::closeWindow(void)
 //----------------------------------------------------
 void ppuViewerDialog_t::periodicUpdate(void)
 {
+	ppuViewDecode(false);
+
 	cycleCount = (cycleCount + 1) % 4;
 
 	if ( redrawWindow || (cycleCount == 0) )
@@ -1364,6 +1374,7 @@ static int writeMemPPU( unsigned int addr, int value )
 	if (addr < 0x2000)
 	{
 		VPage[addr >> 10][addr] = value; //todo: detect if this is vrom and turn it red if so
+		CHRPageVersion[addr >> 10]++;
 	}
 	if ((addr >= 0x2000) && (addr < 0x3F00))
 	{
@@ -1381,12 +1392,10 @@ static void initPPUViewer(void)
 {
 	memset( pallast  , 0, sizeof(pallast)   );
 	memset( palcache , 0, sizeof(palcache)  );
-	memset( chrcache0, 0, sizeof(chrcache0) );
-	memset( chrcache1, 0, sizeof(chrcache1) );
-	memset( logcache0, 0, sizeof(logcache0) );
-	memset( logcache1, 0, sizeof(logcache1) );
 	memset( oam,       0, sizeof(oam)       );
 
+	drawnSeq = 0;
+
 	// forced palette (e.g. for debugging CHR when palettes are all-black)
 	palcache[(8*4)+0] = 0x0F;
 	palcache[(8*4)+1] = 0x00;
@@ -1398,11 +1407,11 @@ static void initPPUViewer(void)
 
 }
 //----------------------------------------------------
-static void DrawPatternTable( ppuPatternTable_t *pattern, uint8_t *table, uint8_t *log, uint8_t pal)
+static void DrawPatternTable( ppuPatternTable_t *pattern, const PPUCaptureFrame *f, int table, uint8_t pal)
 {
-	int i,j,x,y,index=0;
-	int p=0,tmp;
-	uint8_t chr0,chr1,logs,shift;
+	int i,j,x,y,n,p;
+	const uint8_t *tiles, *pix, *log;
+	uint8_t logs,shift;
 
 	if (palo == NULL)
 	{
@@ -1414,52 +1423,43 @@ static void DrawPatternTable( ppuPatternTable_t *pattern, uint8_t *table, uint8_
 	{
 		for (j = 0; j < 16; j++)	//Rows
 		{
-			//printf("Tile: %X%X  index:%04X   %04X\n", j,i,index, (i<<4)|(j<<8));
-			//-----------------------------------------------
+			n = (table << 8) | (i << 4) | j;
+
+			tiles = tileCache.page( n >> 6, f->chr[n >> 6], f->chrVersion[n >> 6] );
+			pix   = &tiles[(n & 63) * 64];
+			log   = &f->chrLog[n >> 6][(n & 63) * 16];
+
 			for (y = 0; y < 8; y++)
 			{
-				chr0 = table[index];
-				chr1 = table[index + 8];
-				logs = log[index] & log[index + 8];
-				tmp = 7;
+				logs = log[y] & log[y + 8];
 				shift=(PPUView_maskUnusedGraphics && debug_loggingCD && (((logs & 3) != 0) == PPUView_invertTheMask))?3:0;
 				for (x = 0; x < 8; x++)
 				{
-					p  =  (chr0 >> tmp) & 1;
-					p |= ((chr1 >> tmp) & 1) << 1;
+					p = *pix++;
 
 					pattern->tile[i][j].pixel[y][x].val = p;
 
 					p = palcache[p | pal];
-					tmp--;
 					pattern->tile[i][j].pixel[y][x].color.setBlue( palo[p].b >> shift );
 					pattern->tile[i][j].pixel[y][x].color.setGreen( palo[p].g >> shift );
 					pattern->tile[i][j].pixel[y][x].color.setRed( palo[p].r >> shift );
-
-					//printf("Tile: %X%X Pixel: (%i,%i)  P:%i RGB: (%i,%i,%i)\n", j, i, x, y, p,
-					//	  pattern->tile[j][i].pixel[y][x].color.red(), 
-					//	  pattern->tile[j][i].pixel[y][x].color.green(), 
-					//	  pattern->tile[j][i].pixel[y][x].color.blue() );
 				}
-				index++;
 			}
-			index+=8;
-			//------------------------------------------------
 		}
 	}
 }
 //----------------------------------------------------
-static void drawSpriteTable(void)
+static void drawSpriteTable( const PPUCaptureFrame *f )
 {
-	int j=0, y,x,yy,xx,p,tmp,idx,chr0,chr1,pal,t0,t1;
-	uint8_t *chrcache;
+	int j=0, y,x,yy,xx,p,pal,t0,t1;
+	const uint8_t *pix;
 	struct oamSpriteData_t *spr;
 
 	if (palo == NULL)
 	{
 		return;
 	}
-	oamPattern.mode8x16 = (PPU[0] & 0x20) ? 1 : 0;
+	oamPattern.mode8x16 = (f->ctrl & 0x20) ? 1 : 0;
 
 	for (int i=0; i<64; i++)
 	{
@@ -1479,22 +1479,11 @@ static void drawSpriteTable(void)
 		}
 		else
 		{
-			spr->bank  = (PPU[0] & 0x08) ? 1 : 0;
+			spr->bank  = (f->ctrl & 0x08) ? 1 : 0;
 			spr->tNum  = (oam[j+1]);
 		}
 
-		idx = spr->tNum << 4;
-
-		if ( spr->bank )
-		{
-			chrcache = chrcache1;
-			spr->chrAddr = 0x1000 + idx;
-		}
-		else
-		{
-			chrcache = chrcache0;
-			spr->chrAddr = idx;
-		}
+		spr->chrAddr = (spr->bank ? 0x1000 : 0x0000) + (spr->tNum << 4);
 
 		if ( oamPattern.mode8x16 && spr->vFlip )
 		{
@@ -1508,96 +1497,29 @@ static void drawSpriteTable(void)
 
 		pal = spr->pal * 4;
 
-		for (yy = 0; yy < 8; yy++)
+		for (int t = 0; t < 2; t++)
 		{
-			if ( spr->vFlip )
-			{
-				y = 7 - yy;
-			}
-			else
-			{
-				y = yy;
-			}
-
-			chr0 = chrcache[idx];
-			chr1 = chrcache[idx + 8];
-			tmp = 7;
-
-			for (xx = 0; xx < 8; xx++)
-			{
-				if ( spr->hFlip )
-				{
-					x = 7 - xx;
-				}
-				else
-				{
-					x = xx;
-				}
-
-				p  =  (chr0 >> tmp) & 1;
-				p |= ((chr1 >> tmp) & 1) << 1;
-
-				spr->tile[t0].pixel[y][x].val = p;
+			pix = tileCache.tile( spr->chrAddr + (t << 4), f->chr, f->chrVersion );
 
-				p = palcache[p | pal];
-				tmp--;
-				spr->tile[t0].pixel[y][x].color.setBlue( palo[p].b );
-				spr->tile[t0].pixel[y][x].color.setGreen( palo[p].g );
-				spr->tile[t0].pixel[y][x].color.setRed( palo[p].r );
-
-				//printf("Tile: %X%X Pixel: (%i,%i)  P:%i RGB: (%i,%i,%i)\n", j, i, x, y, p,
-				//	  pattern->tile[j][i].pixel[y][x].color.red(), 
-				//	  pattern->tile[j][i].pixel[y][x].color.green(), 
-				//	  pattern->tile[j][i].pixel[y][x].color.blue() );
-			}
-			idx++;
-		}
-		idx+=8;
-
-		for (yy = 0; yy < 8; yy++)
-		{
-			if ( spr->vFlip )
-			{
-				y = 7 - yy;
-			}
-			else
+			for (yy = 0; yy < 8; yy++)
 			{
-				y = yy;
-			}
-			chr0 = chrcache[idx];
-			chr1 = chrcache[idx + 8];
-			tmp = 7;
+				y = spr->vFlip ? 7 - yy : yy;
 
-			for (xx = 0; xx < 8; xx++)
-			{
-				if ( spr->hFlip )
+				for (xx = 0; xx < 8; xx++)
 				{
-					x = 7 - xx;
-				}
-				else
-				{
-					x = xx;
-				}
-
-				p  =  (chr0 >> tmp) & 1;
-				p |= ((chr1 >> tmp) & 1) << 1;
+					x = spr->hFlip ? 7 - xx : xx;
 
-				spr->tile[t1].pixel[y][x].val = p;
+					p = *pix++;
 
-				p = palcache[p | pal];
-				tmp--;
-				spr->tile[t1].pixel[y][x].color.setBlue( palo[p].b );
-				spr->tile[t1].pixel[y][x].color.setGreen( palo[p].g );
-				spr->tile[t1].pixel[y][x].color.setRed( palo[p].r );
+					spr->tile[t ? t1 : t0].pixel[y][x].val = p;
 
-				//printf("Tile: %X%X Pixel: (%i,%i)  P:%i RGB: (%i,%i,%i)\n", j, i, x, y, p,
-				//	  pattern->tile[j][i].pixel[y][x].color.red(), 
-				//	  pattern->tile[j][i].pixel[y][x].color.green(), 
-				//	  pattern->tile[j][i].pixel[y][x].color.blue() );
+					p = palcache[p | pal];
+					spr->tile[t ? t1 : t0].pixel[y][x].color.setBlue( palo[p].b );
+					spr->tile[t ? t1 : t0].pixel[y][x].color.setGreen( palo[p].g );
+					spr->tile[t ? t1 : t0].pixel[y][x].color.setRed( palo[p].r );
+				}
 			}
-			idx++;
 		}
-		idx+=8;
 
 		//if ( oamPattern.mode8x16 )
 		//{
@@ -1609,86 +1531,123 @@ static void drawSpriteTable(void)
 	}
 }
 //----------------------------------------------------
-void FCEUD_UpdatePPUView(int scanline, int refreshchr)
+// GUI thread: decodes the newest capture, skipping the pattern tables and
+// sprites none of whose inputs changed since they were last drawn
+static void ppuViewDecode( bool force )
 {
-	if ( (ppuViewWindow == NULL) && (spriteViewWindow == NULL) )
+	const PPUCaptureFrame *f;
+	bool isNew, palChanged = false, chrChanged[2] = { false, false };
+	int mask;
+
+	f = ppuCapture.acquire( &isNew );
+
+	if ( (f->seq == 0) || (palo == NULL) )
 	{
 		return;
 	}
-	if ( (scanline != -1) && (scanline != PPUViewScanline) )
+	if ( !force && (f->seq == drawnSeq) )
 	{
 		return;
 	}
-	int x,i;
+	drawnSeq = f->seq;
 
-	if (refreshchr)
+	// update palette only if required
+	if ( force || (memcmp(pallast, f->pal, 32) != 0) || (memcmp(pallast+32, f->upal, 3) != 0) )
 	{
-		int i10, x10;
-		for (i = 0, x=0x1000; i < 0x1000; i++, x++)
+		//printf("Updated PPU View Palette\n");
+		memcpy(pallast, f->pal, 32);
+		memcpy(pallast+32, f->upal, 3);
+
+		// cache palette content
+		memcpy(palcache,f->pal,32);
+		palcache[0x10] = palcache[0x00];
+		palcache[0x04] = palcache[0x14] = f->upal[0];
+		palcache[0x08] = palcache[0x18] = f->upal[1];
+		palcache[0x0C] = palcache[0x1C] = f->upal[2];
+
+		palChanged = true;
+	}
+
+	for (int i = 0; i < 8; i++)
+	{
+		if ( f->chrVersion[i] != drawnChrVersion[i] )
 		{
-			i10 = i>>10;
-			x10 = x>>10;
+			drawnChrVersion[i] = f->chrVersion[i];
+			chrChanged[i >> 2] = true;
+		}
+	}
 
-			if ( VPage[i10] == NULL )
-			{
-				continue;
-			}
-			chrcache0[i] = VPage[i10][i];
-			chrcache1[i] = VPage[x10][x];
+	mask = (PPUView_maskUnusedGraphics ? 1 : 0) | (PPUView_invertTheMask ? 2 : 0) | (debug_loggingCD ? 4 : 0);
 
-			if (debug_loggingCD) 
-			{
-				if (cdloggerVideoDataSize)
-				{
-					int addr;
-					addr = &VPage[i10][i] - CHRptr[0];
-					if ((addr >= 0) && (addr < (int)cdloggerVideoDataSize))
-						logcache0[i] = cdloggervdata[addr];
-					addr = &VPage[x10][x] - CHRptr[0];
-					if ((addr >= 0) && (addr < (int)cdloggerVideoDataSize))
-						logcache1[i] = cdloggervdata[addr];
-				}
-			  	else
-			  	{
-					logcache0[i] = cdloggervdata[i];
-					logcache1[i] = cdloggervdata[x];
-				}
-			}
+	if ( mask != drawnMask )
+	{
+		drawnMask = mask;
+		force = true;
+	}
+
+	for (int t = 0; t < 2; t++)
+	{
+		if ( force || palChanged || chrChanged[t] || (pindex[t] != drawnPal[t]) )
+		{
+			drawnPal[t] = pindex[t];
+
+			DrawPatternTable( t ? &pattern1 : &pattern0, f, t, pindex[t] );
+
+			redrawWindow = true;
 		}
 	}
 
-	if (PPUViewSkip < PPUViewRefresh) 
+	if ( spriteViewWindow != NULL )
+	{
+		if ( force || palChanged || chrChanged[0] || chrChanged[1] ||
+		     (f->ctrl != drawnCtrl) || (memcmp( oam, f->oam, 256 ) != 0) )
+		{
+			memcpy( oam, f->oam, 256 );
+			drawnCtrl = f->ctrl;
+
+			drawSpriteTable( f );
+
+			redrawWindow = true;
+		}
+	}
+}
+//----------------------------------------------------
+void FCEUD_UpdatePPUView(int scanline, int refreshchr)
+{
+	if ( (ppuViewWindow == NULL) && (spriteViewWindow == NULL) )
 	{
-		PPUViewSkip++;
 		return;
 	}
-	PPUViewSkip = 0;
-	
-	// update palette only if required
-	if ( (palo != NULL) && ( (memcmp(pallast, PALRAM, 32) != 0) || (memcmp(pallast+32, UPALRAM, 3) != 0) ))
+
+	if ( scanline == -1 )
 	{
-		//printf("Updated PPU View Palette\n");
-		memcpy(pallast, PALRAM, 32);
-		memcpy(pallast+32, UPALRAM, 3);
+		// asked for by a window, draw it now rather than at the next capture
+		if (refreshchr)
+		{
+			FCEU_WRAPPER_LOCK();
+			ppuCapture.capture(false);
+			FCEU_WRAPPER_UNLOCK();
+		}
+		PPUViewSkip = 0;
 
-		// cache palette content
-		memcpy(palcache,PALRAM,32);
-		palcache[0x10] = palcache[0x00];
-		palcache[0x04] = palcache[0x14] = UPALRAM[0];
-		palcache[0x08] = palcache[0x18] = UPALRAM[1];
-		palcache[0x0C] = palcache[0x1C] = UPALRAM[2];
+		ppuViewDecode(true);
+		return;
 	}
 
-	DrawPatternTable( &pattern0,chrcache0,logcache0,pindex[0]);
-	DrawPatternTable( &pattern1,chrcache1,logcache1,pindex[1]);
-
-	if ( spriteViewWindow != NULL )
+	if ( scanline != PPUViewScanline )
 	{
-		memcpy( oam, SPRAM, 256 );
+		return;
+	}
 
-		drawSpriteTable();
+	if (PPUViewSkip < PPUViewRefresh) 
+	{
+		PPUViewSkip++;
+		return;
 	}
-	redrawWindow = true;
+	PPUViewSkip = 0;
+
+	// emulator thread, copy the memory and leave the drawing to the window
+	ppuCapture.capture(false);
 }
 //----------------------------------------------------
 //-- Tile Palette View
@@ -2105,11 +2064,7 @@ ppuTileEditor_t::ppuTileEditor_t(int patternIndex, QWidget *parent)
 
 	mainLayout->addLayout( hbox, 1 );
 
-	updateTimer  = new QTimer( this );
-
-	connect( updateTimer, &QTimer::timeout, this, &ppuTileEditor_t::periodicUpdate );
-
-	updateTimer->start( 100 ); // 10hz
+	FrameDispatcher::instance()->addView( this, 100, [this]{ periodicUpdate(); } ); // 10hz
 
 	restoreGeometry(settings.value("ppuTileEditorWindow/geometry").toByteArray());
 }
@@ -2117,7 +2072,7 @@ ppuTileEditor_t::ppuTileEditor_t(int patternIndex, QWidget *parent)
 ppuTileEditor_t::~ppuTileEditor_t(void)
 {
 	QSettings settings;
-	updateTimer->stop();
+	FrameDispatcher::instance()->removeView( this );
 
 	//printf("PPU Tile Editor Window Deleted\n");
 	settings.setValue("ppuTileEditorWindow/geometry", saveGeometry());
@@ -3117,11 +3072,7 @@ spriteViewerDialog_t::spriteViewerDialog_t(QWidget *parent)
 
 	grid->addWidget( showPosHex, 5, 0, 1, 2 );
 
-	updateTimer  = new QTimer( this );
-
-	connect( updateTimer, &QTimer::timeout, this, &spriteViewerDialog_t::periodicUpdate );
-
-	updateTimer->start( 33 ); // 30hz
+	FrameDispatcher::instance()->addView( this, 33, [this]{ periodicUpdate(); } ); // 30hz
 
 	resize( minimumSizeHint() );
 
@@ -3135,6 +3086,8 @@ spriteViewerDialog_t::spriteViewerDialog_t(QWidget *parent)
 //----------------------------------------------------
 spriteViewerDialog_t::~spriteViewerDialog_t(void)
 {
+	FrameDispatcher::instance()->removeView( this );
+
 	if ( this == spriteViewWindow )
 	{
 		spriteViewWindow = NULL;
@@ -3190,6 +3143,8 @@ void spriteViewerDialog_t::periodicUpdate(void)
 
 	//return;
 
+	ppuViewDecode(false);
+
 	idx = oamView->getSpriteIndex();
 
 	snprintf( stmp, sizeof(stmp), "$%02X", idx );
@@ -241,7 +241,6 @@ class ppuTileEditor_t : public QDialog
 		void keyPressEvent(QKeyEvent *event);
 		void closeEvent(QCloseEvent *bar);
 
-		QTimer     *updateTimer;
 	private:
 		QLabel    *tileIdxLbl;
 		QComboBox *palSelBox;
@@ -279,7 +278,6 @@ class ppuViewerDialog_t : public QDialog
 		QCheckBox  *invertMaskCbox;
 		QSlider    *refreshSlider;
 		QSpinBox   *scanLineEdit;
-		QTimer     *updateTimer;
 
 		int         cycleCount;
 
@@ -466,7 +464,6 @@ class spriteViewerDialog_t : public QDialog
 
 		void closeEvent(QCloseEvent *bar);
 	private:
-		QTimer *updateTimer;
 		QRadioButton *useSprRam;
 		QRadioButton *useCpuPag;
 		QSpinBox     *cpuPagIdx;
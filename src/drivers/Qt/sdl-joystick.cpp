@@ -454,6 +454,8 @@ int GamePad_t::setDeviceIndex(int in)
 	{
 		jsDev[devIdx].bindPort(portNum);
 	}
+	inputBindingsChanged();
+
 	return 0;
 }
 //********************************************************************************
@@ -595,6 +597,8 @@ int GamePad_t::setMapping(nesGamePadMap_t *gpm)
 			convText2ButtConfig( gpm->conf[c].btn[i], &bmap[c][i] );
 		}
 	}
+	inputBindingsChanged();
+
 	return 0;
 }
 //********************************************************************************
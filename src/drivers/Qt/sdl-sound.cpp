@@ -24,6 +24,7 @@
 #include "sdl.h"
 
 #include "common/configSys.h"
+#include "common/os_utils.h"
 #include "utils/memory.h"
 #include "Qt/nes_shm.h"
 #include "Qt/throttle.h"
@@ -31,19 +32,41 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _USE_ALSA
+#include <alsa/asoundlib.h>
+#endif
 
 extern Config *g_config;
 extern bool turbo;
 
-static volatile int *s_Buffer = 0;
-static unsigned int s_BufferSize;
-static unsigned int s_BufferSize25;
-static unsigned int s_BufferSize50;
-static unsigned int s_BufferSize75;
-static unsigned int s_BufferRead;
-static unsigned int s_BufferWrite;
-static volatile unsigned int s_BufferIn = 0;
+// Single producer (emulator thread, WriteSound) single consumer (SDL audio
+// thread, fillaudio) ring. The read and write counters run freely and are
+// only masked to index the storage, so each side owns one of them and no
+// lock is needed; a release store publishes the samples written before it.
+static int *s_Buffer = 0;
+static unsigned int s_BufferSize;  // most samples held, <= s_BufferMask+1
+static unsigned int s_BufferMask;
+static std::atomic<unsigned int> s_BufferRead(0);
+static std::atomic<unsigned int> s_BufferWrite(0);
 static unsigned int s_SampleRate = 44100;
+static unsigned int s_DeviceSamples = 512;
+
+// Dynamic rate control: rather than sleeping when the ring is full or
+// skipping samples, the resampler in WriteSound() stretches the output by at
+// most drcMaxDelta to keep the fill level around the latency target.
+static const double drcMaxDelta = 0.005;
+static unsigned int s_TargetFill = 882;
+static double s_FillAvg = 0.0;
+static double s_DrcRatio = 1.0;
+static double s_DrcIntegral = 0.0;
+static double s_ResamplePos = 0.0;
+static int    s_ResamplePrev = 0;
+static std::atomic<unsigned int> s_OverrunCounter(0);
 static double noiseGate = 0.0;
 static double noiseGateRate = 0.010;
 static bool   noiseGateActive = true;
@@ -53,26 +76,73 @@ static const unsigned int supportedSampleRates[] = { 11025, 22050, 44100, 48000,
 
 static bool s_mute = false;
 
+// Applied by fillaudio on the SDL audio thread, which is new for every device opened
+static bool        s_AudioThreadReady = false;
+static std::string s_AudioThreadCpus;
+static int         s_AudioSchedPolicy = 0;
+static int         s_AudioSchedPrio = 0;
+
+#ifdef _USE_ALSA
+// The ALSA backend bypasses SDL and the sound server: its own thread takes
+// the samples from the ring into the device's mmap'ed buffer a period at a
+// time, and reads back how much is queued in the device, which then stands
+// in for the fixed s_DeviceSamples in rate control and the latency stats.
+static snd_pcm_t        *s_AlsaPcm = NULL;
+static std::thread      *s_AlsaThread = NULL;
+static std::atomic<bool> s_AlsaQuit(false);
+static std::atomic<bool> s_AlsaSilence(false);
+static std::atomic<int>  s_AlsaDelay(0);
+static bool              s_AlsaMmap = false;
+static snd_pcm_uframes_t s_AlsaPeriod = 0;
+#endif
+
 extern int EmulationPaused;
 extern double frmRateAdjRatio;
 extern double g_fpsScale;
 
 /**
- * Callback from the SDL to get and play audio data.
+ * Samples queued past the ring, which the SDL device only tells in size.
+ */
+static unsigned int
+deviceFill(void)
+{
+#ifdef _USE_ALSA
+	if ( s_AlsaPcm )
+	{
+		int delay = s_AlsaDelay.load( std::memory_order_relaxed );
+
+		return (delay > 0) ? delay : 0;
+	}
+#endif
+	return s_DeviceSamples;
+}
+
+/**
+ * Moves len samples from the ring to the device, on the audio thread.
  */
 static void
-fillaudio(void *udata,
-		uint8 *stream,
+fillSamples(int16 *tmps,
 		int len)
 {
-	char bufStarveDetected = 0;
 	static int16_t sample = 0;
 	char mute;
-	//unsigned int starve_lp = nes_shm->sndBuf.starveCounter;
-	int16 *tmps = (int16*)stream;
-	len >>= 1;
+	unsigned int rd = s_BufferRead.load( std::memory_order_relaxed );
+	unsigned int avail = s_BufferWrite.load( std::memory_order_acquire ) - rd;
 
-	if ( s_BufferIn > s_BufferSize25 )
+	if ( !s_AudioThreadReady )
+	{
+		s_AudioThreadReady = true;
+
+		fceu_set_thread_affinity( s_AudioThreadCpus.c_str() );
+
+		if ( s_AudioSchedPolicy )
+		{
+			fceu_set_thread_sched( s_AudioSchedPolicy, s_AudioSchedPrio );
+		}
+	}
+
+	// Wait for the ring to reach the latency target before starting
+	if ( avail >= s_TargetFill )
 	{
 		fillInit = 0;
 	}
@@ -120,7 +190,7 @@ fillaudio(void *udata,
 			}
 			else
 			{
-				if ( s_BufferIn )
+				if ( avail )
 				{	
 					noiseGate += noiseGateRate;
 
@@ -131,11 +201,11 @@ fillaudio(void *udata,
 					}
 				}
 			}
-			if (s_BufferIn) 
+			if (avail) 
 			{
-				sample = s_Buffer[s_BufferRead] * noiseGate;
-				s_BufferRead = (s_BufferRead + 1) % s_BufferSize;
-				s_BufferIn--;
+				sample = s_Buffer[rd & s_BufferMask] * noiseGate;
+				rd++;
+				avail--;
 
 				*tmps = sample * noiseGate;
 			}
@@ -154,16 +224,15 @@ fillaudio(void *udata,
 	{
 		while (len) 
 		{
-			if (s_BufferIn) 
+			if (avail) 
 			{
-				sample = s_Buffer[s_BufferRead];
-				s_BufferRead = (s_BufferRead + 1) % s_BufferSize;
-				s_BufferIn--;
+				sample = s_Buffer[rd & s_BufferMask];
+				rd++;
+				avail--;
 			} else {
         	 		// Retain last known sample value, helps avoid clicking
         	 		// noise when sound system is starved of audio data.
 				//sample = 0; 
-				bufStarveDetected = 1;
 				nes_shm->sndBuf.starveCounter++;
 			}
 
@@ -174,25 +243,234 @@ fillaudio(void *udata,
 			len--;
 		}
 	}
-	if ( bufStarveDetected )
+	s_BufferRead.store( rd, std::memory_order_release );
+}
+
+/**
+ * Callback from the SDL to get and play audio data.
+ */
+static void
+fillaudio(void *udata,
+		uint8 *stream,
+		int len)
+{
+	fillSamples( (int16*)stream, len >> 1 );
+}
+
+#ifdef _USE_ALSA
+static bool
+alsaRecover(int err)
+{
+	if ( snd_pcm_recover( s_AlsaPcm, err, 1 ) < 0 )
+	{
+		fprintf(stderr, "ALSA sound: %s\n", snd_strerror(err) );
+		return false;
+	}
+	if ( err == -EPIPE )
 	{
-		//s_StarveCounter = nes_shm->sndBuf.starveCounter - starve_lp;
-		//printf("Starve:%u\n", s_StarveCounter );
+		nes_shm->sndBuf.starveCounter++;
+	}
+	return true;
+}
+
+static void
+alsaFill(int16 *dst,
+		int len)
+{
+	if ( s_AlsaSilence.load( std::memory_order_relaxed ) )
+	{
+		memset( dst, 0, len * sizeof(int16) );
+	}
+	else
+	{
+		fillSamples( dst, len );
 	}
 }
 
+/**
+ * The ALSA audio thread: tops the device buffer up a period at a time.
+ */
+static void
+alsaLoop(void)
+{
+	std::vector <int16> period( s_AlsaPeriod );
+
+	while ( !s_AlsaQuit.load() )
+	{
+		snd_pcm_sframes_t avail = snd_pcm_avail_update( s_AlsaPcm );
+		snd_pcm_sframes_t delay;
+
+		if ( avail < 0 )
+		{
+			if ( !alsaRecover( avail ) )
+			{
+				break;
+			}
+			continue;
+		}
+		if ( static_cast<snd_pcm_uframes_t>(avail) < s_AlsaPeriod )
+		{
+			snd_pcm_wait( s_AlsaPcm, 100 );
+			continue;
+		}
+
+		if ( s_AlsaMmap )
+		{
+			snd_pcm_uframes_t frames = avail;
+
+			while ( frames > 0 )
+			{
+				const snd_pcm_channel_area_t *areas;
+				snd_pcm_uframes_t offset, count = frames;
+				snd_pcm_sframes_t done;
+				int err;
+
+				err = snd_pcm_mmap_begin( s_AlsaPcm, &areas, &offset, &count );
+
+				if ( err < 0 )
+				{
+					alsaRecover( err );
+					break;
+				}
+				alsaFill( (int16*)( (uint8*)areas[0].addr + ((areas[0].first + offset * areas[0].step) >> 3) ), count );
+
+				done = snd_pcm_mmap_commit( s_AlsaPcm, offset, count );
+
+				if ( (done < 0) || (static_cast<snd_pcm_uframes_t>(done) != count) )
+				{
+					alsaRecover( (done < 0) ? done : -EPIPE );
+					break;
+				}
+				frames -= count;
+			}
+		}
+		else
+		{
+			alsaFill( &period[0], s_AlsaPeriod );
+
+			snd_pcm_sframes_t done = snd_pcm_writei( s_AlsaPcm, &period[0], s_AlsaPeriod );
+
+			if ( (done < 0) && !alsaRecover( done ) )
+			{
+				break;
+			}
+		}
+		if ( snd_pcm_delay( s_AlsaPcm, &delay ) == 0 )
+		{
+			s_AlsaDelay.store( delay, std::memory_order_relaxed );
+		}
+	}
+}
+
+/**
+ * Opens the ALSA device with the smallest period near the one asked for,
+ * two periods of buffer, in mmap mode where the device has it.
+ */
+static bool
+alsaOpen(const char *device,
+		unsigned int periodSamples)
+{
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_sw_params_t *sw;
+	snd_pcm_uframes_t bufferSize;
+	unsigned int rate = s_SampleRate;
+	int err;
+
+	err = snd_pcm_open( &s_AlsaPcm, device, SND_PCM_STREAM_PLAYBACK, 0 );
+
+	if ( err < 0 )
+	{
+		fprintf(stderr, "ALSA sound: cannot open %s: %s\n", device, snd_strerror(err) );
+		s_AlsaPcm = NULL;
+		return false;
+	}
+	snd_pcm_hw_params_alloca( &hw );
+	snd_pcm_hw_params_any( s_AlsaPcm, hw );
+
+	s_AlsaMmap = snd_pcm_hw_params_set_access( s_AlsaPcm, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED ) == 0;
+
+	if ( !s_AlsaMmap )
+	{
+		snd_pcm_hw_params_set_access( s_AlsaPcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED );
+	}
+	s_AlsaPeriod = periodSamples;
+	bufferSize   = periodSamples * 2;
+
+	if ( (err = snd_pcm_hw_params_set_format( s_AlsaPcm, hw, SND_PCM_FORMAT_S16 )) < 0 ||
+	     (err = snd_pcm_hw_params_set_channels( s_AlsaPcm, hw, 1 )) < 0 ||
+	     (err = snd_pcm_hw_params_set_rate_resample( s_AlsaPcm, hw, 1 )) < 0 ||
+	     (err = snd_pcm_hw_params_set_rate_near( s_AlsaPcm, hw, &rate, 0 )) < 0 ||
+	     (err = snd_pcm_hw_params_set_period_size_near( s_AlsaPcm, hw, &s_AlsaPeriod, 0 )) < 0 ||
+	     (err = snd_pcm_hw_params_set_buffer_size_near( s_AlsaPcm, hw, &bufferSize )) < 0 ||
+	     (err = snd_pcm_hw_params( s_AlsaPcm, hw )) < 0 )
+	{
+		fprintf(stderr, "ALSA sound: cannot set up %s: %s\n", device, snd_strerror(err) );
+		snd_pcm_close( s_AlsaPcm );
+		s_AlsaPcm = NULL;
+		return false;
+	}
+	snd_pcm_hw_params_get_period_size( hw, &s_AlsaPeriod, 0 );
+	snd_pcm_hw_params_get_buffer_size( hw, &bufferSize );
+
+	if ( rate != s_SampleRate )
+	{
+		fprintf(stderr, "ALSA sound: %s does not play at %u Hz\n", device, s_SampleRate );
+		snd_pcm_close( s_AlsaPcm );
+		s_AlsaPcm = NULL;
+		return false;
+	}
+
+	snd_pcm_sw_params_alloca( &sw );
+	snd_pcm_sw_params_current( s_AlsaPcm, sw );
+	snd_pcm_sw_params_set_avail_min( s_AlsaPcm, sw, s_AlsaPeriod );
+	snd_pcm_sw_params_set_start_threshold( s_AlsaPcm, sw, bufferSize );
+	snd_pcm_sw_params( s_AlsaPcm, sw );
+
+	s_DeviceSamples = s_AlsaPeriod;
+	s_AlsaDelay.store( 0 );
+	s_AlsaQuit.store( false );
+	s_AlsaSilence.store( false );
+
+	s_AlsaThread = new std::thread( alsaLoop );
+
+	fprintf(stderr, "Loading ALSA sound on %s, %s, %lu sample periods...\n", device,
+			s_AlsaMmap ? "mmap" : "read/write", (unsigned long)s_AlsaPeriod );
+	return true;
+}
+
+static void
+alsaClose(void)
+{
+	if ( s_AlsaThread )
+	{
+		s_AlsaQuit.store( true );
+		s_AlsaThread->join();
+		delete s_AlsaThread;
+		s_AlsaThread = NULL;
+	}
+	if ( s_AlsaPcm )
+	{
+		snd_pcm_drop( s_AlsaPcm );
+		snd_pcm_close( s_AlsaPcm );
+		s_AlsaPcm = NULL;
+	}
+}
+#endif
+
 /**
  * Initialize the audio subsystem.
  */
 int
 InitSound()
 {
-	int i, sound, soundrate, soundbufsize, soundvolume, soundtrianglevolume, soundsquare1volume, soundsquare2volume, soundnoisevolume, soundpcmvolume, soundq;
+	int i, sound, soundrate, soundbufsize, soundlatency, soundvolume, soundtrianglevolume, soundsquare1volume, soundsquare2volume, soundnoisevolume, soundpcmvolume, soundq;
 	SDL_AudioSpec spec;
 	const char *driverName;
 	int frmRateSampleAdj = 0;
 	int samplesPerFrame;
 	bool sampleRateIsSupported = false;
+	bool useAlsa = false;
+	std::string backend;
 
 	g_config->getOption("SDL.Sound", &sound);
 	if (!sound) 
@@ -200,8 +478,19 @@ InitSound()
 		return 0;
 	}
 
+	g_config->getOption("SDL.Sound.Backend", &backend);
+
+	if ( backend == "alsa" )
+	{
+#ifdef _USE_ALSA
+		useAlsa = true;
+#else
+		printf("Error: ALSA sound backend is not built in, using SDL\n");
+#endif
+	}
+
 	memset(&spec, 0, sizeof(spec));
-	if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) 
+	if ( !useAlsa && (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) )
 	{
 		puts(SDL_GetError());
 		KillSound();
@@ -212,6 +501,7 @@ InitSound()
 	g_config->getOption("SDL.Sound.Mute", &s_mute);
 	g_config->getOption("SDL.Sound.Rate", &soundrate);
 	g_config->getOption("SDL.Sound.BufSize", &soundbufsize);
+	g_config->getOption("SDL.Sound.Latency", &soundlatency);
 	g_config->getOption("SDL.Sound.Volume", &soundvolume);
 	g_config->getOption("SDL.Sound.Quality", &soundq);
 	g_config->getOption("SDL.Sound.TriangleVolume", &soundtrianglevolume);
@@ -245,6 +535,13 @@ InitSound()
 		g_config->setOption("SDL.Sound.BufSize", soundbufsize);
 	}
 
+	if ( (soundlatency < 5) || (soundlatency > 200) )
+	{
+		printf("Error: Audio Latency of %i ms is invalid, reverting to default of 20\n", soundlatency);
+		soundlatency = 20;
+		g_config->setOption("SDL.Sound.Latency", soundlatency);
+	}
+
 	spec.freq = s_SampleRate = soundrate;
 	spec.format = AUDIO_S16SYS;
 	spec.channels = 1;
@@ -254,11 +551,27 @@ InitSound()
 
 	samplesPerFrame = (int)( ( (double)s_SampleRate / getBaseFrameRate() ) );
 
-	if ( samplesPerFrame >= 1024 )
+	s_TargetFill = soundlatency * soundrate / 1000;
+
+	// A frame of samples arrives at once, so the ring can never run lower
+	if ( s_TargetFill < static_cast<unsigned int>(samplesPerFrame) )
 	{
-		spec.samples = 1024;
+		s_TargetFill = samplesPerFrame;
 	}
 
+	// Let the device pull about a third of the target at a time. An ALSA
+	// device is asked for periods down to 64 samples, SDL's own buffering
+	// comes on top of a sound server's so it has to stay coarser.
+	while ( (spec.samples > (useAlsa ? 64 : 256)) && (spec.samples * 3 > s_TargetFill) )
+	{
+		spec.samples >>= 1;
+	}
+	while ( (spec.samples < 1024) && (spec.samples * 6 < s_TargetFill) )
+	{
+		spec.samples <<= 1;
+	}
+	s_DeviceSamples = spec.samples;
+
 	s_BufferSize = soundbufsize * soundrate / 1000;
 
 	// For safety, set a bare minimum:
@@ -266,38 +579,91 @@ InitSound()
 	{
 		s_BufferSize = spec.samples * 4;
 	}
-	s_BufferSize25 =    s_BufferSize/4;
-	s_BufferSize50 =    s_BufferSize/2;
-	s_BufferSize75 = (3*s_BufferSize)/4;
+	if (s_BufferSize < 2 * (s_TargetFill + samplesPerFrame))
+	{
+		s_BufferSize = 2 * (s_TargetFill + samplesPerFrame);
+	}
+	s_BufferMask = 1;
+
+	while ( s_BufferMask < s_BufferSize )
+	{
+		s_BufferMask <<= 1;
+	}
 
-	//printf("Audio Buffer: %i  %i \n", spec.samples, s_BufferSize );
+	//printf("Audio Buffer: %i  %i  %i \n", spec.samples, s_TargetFill, s_BufferSize );
 
 	noiseGate = 0.0;
 	noiseGateRate = 1.0 / (double)spec.samples;
 	noiseGateActive = true;
 	fillInit = 1;
 
-	s_Buffer = (int *)FCEU_dmalloc(sizeof(int) * s_BufferSize);
+	s_Buffer = (int *)FCEU_dmalloc(sizeof(int) * s_BufferMask);
 
 	if (!s_Buffer)
 	{
 		return 0;
 	}
-	s_BufferRead = s_BufferWrite = s_BufferIn = 0;
-
-	if (SDL_OpenAudio(&spec, 0) < 0)
+	s_BufferMask--;
+	s_BufferRead.store(0);
+	s_BufferWrite.store(0);
+	s_OverrunCounter.store(0);
+
+	s_FillAvg = s_TargetFill;
+	s_DrcRatio = 1.0;
+	s_DrcIntegral = 0.0;
+	s_ResamplePos = 0.0;
+	s_ResamplePrev = 0;
+
+	int setSchedParam = 0;
+	g_config->getOption("SDL.SetSchedParam", &setSchedParam);
+	g_config->getOption("SDL.AudioSchedPolicy", &s_AudioSchedPolicy);
+	g_config->getOption("SDL.AudioSchedPrioRt", &s_AudioSchedPrio);
+	g_config->getOption("SDL.AudioThreadCpus", &s_AudioThreadCpus);
+
+	if ( !setSchedParam )
 	{
-		puts(SDL_GetError());
-		KillSound();
-		return 0;
+		s_AudioSchedPolicy = 0;
 	}
-	SDL_PauseAudio(0);
+	s_AudioThreadReady = false;
+
+#ifdef _USE_ALSA
+	if ( useAlsa )
+	{
+		std::string device;
 
-	driverName = SDL_GetCurrentAudioDriver();
+		g_config->getOption("SDL.Sound.AlsaDevice", &device);
 
-	if ( driverName )
+		if ( !alsaOpen( device.c_str(), spec.samples ) )
+		{
+			printf("Error: ALSA sound could not start, using SDL\n");
+			useAlsa = false;
+
+			if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
+			{
+				puts(SDL_GetError());
+				KillSound();
+				return 0;
+			}
+		}
+	}
+#endif
+
+	if ( !useAlsa )
 	{
-		fprintf(stderr, "Loading SDL sound with %s driver...\n", driverName);
+		if (SDL_OpenAudio(&spec, 0) < 0)
+		{
+			puts(SDL_GetError());
+			KillSound();
+			return 0;
+		}
+		SDL_PauseAudio(0);
+
+		driverName = SDL_GetCurrentAudioDriver();
+
+		if ( driverName )
+		{
+			fprintf(stderr, "Loading SDL sound with %s driver...\n", driverName);
+		}
 	}
  
 	frmRateSampleAdj = (int)( ( ((double)soundrate) * getFrameRateAdjustmentRatio()) - ((double)soundrate) );
@@ -331,7 +697,30 @@ GetMaxSound(void)
 uint32
 GetWriteSound(void)
 {
-	return(s_BufferSize - s_BufferIn);
+	unsigned int fill = s_BufferWrite.load() - s_BufferRead.load();
+
+	return (fill < s_BufferSize) ? (s_BufferSize - fill) : 0;
+}
+
+/**
+ * Reports how long a sample takes from WriteSound() to the audio device,
+ * which is how far the sound lags the picture of the same frame.
+ */
+void
+GetSoundLatencyStats(struct soundLatencyStat_t *stats)
+{
+	double rate = s_SampleRate ? (double)s_SampleRate : 1.0;
+	unsigned int fill = s_BufferWrite.load() - s_BufferRead.load();
+	unsigned int device = deviceFill();
+
+	stats->enabled   = (s_Buffer != 0);
+	stats->latency   = (fill + device) / rate;
+	stats->average   = (s_FillAvg + s_DeviceSamples) / rate;
+	stats->target    = (s_TargetFill + s_DeviceSamples) / rate;
+	stats->device    = device / rate;
+	stats->rateRatio = s_DrcRatio;
+	stats->underruns = nes_shm ? nes_shm->sndBuf.starveCounter : 0;
+	stats->overruns  = s_OverrunCounter.load();
 }
 
 /**
@@ -341,161 +730,85 @@ void
 WriteSound(int32 *buf,
            int Count)
 {
+	extern int EmulationPaused;
+	unsigned int wr, fill, room;
+	double step, pos, error;
 
-	int uflowMode = 0;
-	int ovrFlowSkip = 1;
-	int udrFlowDup  = 1;
-	static int skipCounter = 0;
-
-	if ( (NoWaiting & 0x01) || turbo )
+	if ( (NoWaiting & 0x01) || turbo || FCEUI_GetComputeOnly() )
 	{	// During Turbo mode, don't bother with sound as
 		// overflowing the audio buffer can cause delays.
 		return;
 	}
-
-	if ( g_fpsScale >= 0.99995 )
+	if ( (EmulationPaused != 0) || (s_Buffer == 0) || (Count <= 0) )
 	{
-		uflowMode = 0;
-		ovrFlowSkip = (int)(g_fpsScale * 1000);
+		return;
+	}
+	wr   = s_BufferWrite.load( std::memory_order_relaxed );
+	fill = wr - s_BufferRead.load( std::memory_order_acquire );
+	room = (fill < s_BufferSize) ? (s_BufferSize - fill) : 0;
 
-		if ( s_BufferIn >= s_BufferSize50 )
-		{
-			ovrFlowSkip += 1;
-		}
+	// Nudge the rate by the smoothed distance from the target fill, half
+	// way through this frame's samples. More buffered than wanted makes the
+	// step a little longer, so fewer samples come out. The integral takes
+	// up a steady clock difference between the emulator and the device, so
+	// the fill settles on the target rather than beside it. What the
+	// device reports queued beyond its nominal period counts as fill, so
+	// with ALSA the ring follows the device clock itself.
+	s_FillAvg += 0.05 * ( (fill + (double)deviceFill() - s_DeviceSamples + Count / (2.0 * g_fpsScale)) - s_FillAvg );
+
+	error = (s_FillAvg - s_TargetFill) / (double)s_TargetFill;
+
+	s_DrcIntegral += 0.002 * error;
+
+	if ( s_DrcIntegral > 1.0 )
+	{
+		s_DrcIntegral = 1.0;
 	}
-	else
+	else if ( s_DrcIntegral < -1.0 )
 	{
-		udrFlowDup = (int)(1.0 / g_fpsScale);
+		s_DrcIntegral = -1.0;
+	}
+	error += s_DrcIntegral;
 
-		if ( udrFlowDup < 1 )
-		{
-			udrFlowDup = 1;
-		}
-		if ( s_BufferIn < s_BufferSize50 )
-		{
-			udrFlowDup++;
-		}
-		else if ( s_BufferIn > s_BufferSize75 )
-		{
-			udrFlowDup--;
-		}
-		uflowMode = (udrFlowDup > 1);
+	if ( error > 1.0 )
+	{
+		error = 1.0;
 	}
-	extern int EmulationPaused;
-	if (EmulationPaused == 0)
+	else if ( error < -1.0 )
 	{
-		int waitCount = 0;
+		error = -1.0;
+	}
+	s_DrcRatio = 1.0 + drcMaxDelta * error;
 
-		if ( uflowMode )
-		{	// Underflow mode
-			SDL_LockAudio();
-			while (Count)
-			{
-				if ( s_BufferIn == s_BufferSize )
-				{
-					SDL_UnlockAudio();
-					while (s_BufferIn == s_BufferSize) 
-					{
-						SDL_Delay(1); waitCount++;
+	// Speed changes are resampled too: at 2x every other sample is taken,
+	// at 1/2x each one is interpolated into two.
+	step = g_fpsScale * s_DrcRatio;
+	pos  = s_ResamplePos;
 
-						if ( waitCount > 1000 )
-						{
-							printf("Error: Sound sink is not draining... Breaking out of audio loop to prevent lockup.\n");
-							return;
-						}
-					}
-					SDL_LockAudio();
-				}
+	// Output samples sit at pos along the input, where 0 is the last
+	// sample of the previous call and n is buf[n-1]
+	while ( pos < Count )
+	{
+		int idx = (int)pos;
+		int a = idx ? buf[idx-1] : s_ResamplePrev;
+		int b = buf[idx];
 
-				for (int i=0; i<udrFlowDup; i++)
-				{
-					s_Buffer[s_BufferWrite] = *buf;
-					s_BufferWrite = (s_BufferWrite + 1) % s_BufferSize;
-            
-					s_BufferIn++;
-				}
-            
-				Count--;
-				buf++;
-			}
-			SDL_UnlockAudio();
+		if ( room > 0 )
+		{
+			s_Buffer[wr & s_BufferMask] = a + (int)( (b - a) * (pos - idx) );
+			wr++;
+			room--;
 		}
 		else
 		{
-			if ( ovrFlowSkip <= 1000 )
-			{	// Perfect one to one realtime
-				skipCounter = 0;
-
-				SDL_LockAudio();
-				while (Count)
-				{
-					if (s_BufferIn == s_BufferSize) 
-					{
-						SDL_UnlockAudio();
-						while (s_BufferIn == s_BufferSize) 
-						{
-							SDL_Delay(1); waitCount++;
-
-							if ( waitCount > 1000 )
-							{
-								printf("Error: Sound sink is not draining... Breaking out of audio loop to prevent lockup.\n");
-								return;
-							}
-						}
-						SDL_LockAudio();
-					}
-
-					s_Buffer[s_BufferWrite] = *buf;
-					Count--;
-					s_BufferWrite = (s_BufferWrite + 1) % s_BufferSize;
-            
-					s_BufferIn++;
-					buf++;
-				}
-				SDL_UnlockAudio();
-			}
-			else
-			{	// Overflow mode
-				SDL_LockAudio();
-				while (Count)
-				{
-					if (s_BufferIn == s_BufferSize) 
-					{
-						SDL_UnlockAudio();
-						while (s_BufferIn == s_BufferSize) 
-						{
-							SDL_Delay(1); waitCount++;
-
-							if ( waitCount > 1000 )
-							{
-								printf("Error: Sound sink is not draining... Breaking out of audio loop to prevent lockup.\n");
-								return;
-							}
-						}
-						SDL_LockAudio();
-					}
-
-					//printf("%i >= %i \n", skipCounter, ovrFlowSkip );
-
-					if ( skipCounter >= ovrFlowSkip )
-					{
-						s_Buffer[s_BufferWrite] = *buf;
-						s_BufferWrite = (s_BufferWrite + 1) % s_BufferSize;
-            
-						s_BufferIn++;
-
-						skipCounter -= ovrFlowSkip;
-					}
-					skipCounter = (skipCounter+1000);
-            
-					Count--;
-					buf++;
-				}
-				SDL_UnlockAudio();
-			}
-
+			s_OverrunCounter++;
 		}
+		pos += step;
 	}
+	s_ResamplePos  = pos - Count;
+	s_ResamplePrev = buf[Count-1];
+
+	s_BufferWrite.store( wr, std::memory_order_release );
 }
 
 /**
@@ -504,6 +817,13 @@ WriteSound(int32 *buf,
 void
 SilenceSound(int n)
 { 
+#ifdef _USE_ALSA
+	if ( s_AlsaPcm )
+	{
+		s_AlsaSilence.store( n != 0 );
+		return;
+	}
+#endif
 	SDL_PauseAudio(n);   
 }
 
@@ -514,13 +834,17 @@ int
 KillSound(void)
 {
 	FCEUI_Sound(0);
+#ifdef _USE_ALSA
+	alsaClose();
+#endif
 	SDL_CloseAudio();
 	SDL_QuitSubSystem(SDL_INIT_AUDIO);
 	if(s_Buffer) {
 		free((void *)s_Buffer);
 		s_Buffer = 0;
 	}
-	s_BufferIn = 0;
+	s_BufferRead.store(0);
+	s_BufferWrite.store(0);
 	return 0;
 }
 
@@ -23,6 +23,7 @@
 #include "Qt/sdl.h"
 #include "Qt/NetPlay.h"
 #include "Qt/throttle.h"
+#include "Qt/TimingHistogram.h"
 #include "utils/timeStamp.h"
 
 #if defined(__linux__) || defined(__APPLE__) || defined(__unix__)
@@ -33,6 +34,13 @@
 #include <sys/timerfd.h>
 #endif
 
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
 static const double Slowest = 0.015625; // 1/64x speed (around 1 fps on NTSC)
 static const double Fastest = 32;       // 32x speed   (around 1920 fps on NTSC)
 static const double Normal  = 1.0;      // 1x speed    (around 60 fps on NTSC)
@@ -58,6 +66,23 @@ static double emuLatencyCur  = 0.0;
 static double emuLatencyMin  = 1.0;
 static double emuLatencyMax  = 0.0;
 static bool   keepFrameTimeStats = false;
+
+// Hybrid pacing: sleep to a margin short of the deadline, then spin. The
+// margin follows how late the sleeps wake, so it grows under load.
+static double sleepMargin = 0.001;
+
+// Display feedback from the viewer's buffer swaps (GUI thread) read by the
+// throttle (emulator thread)
+static std::atomic<double> swapLastTs(0.0);
+static std::atomic<double> swapPeriod(0.0);
+static std::atomic<bool>   displayLocked(false);
+static std::atomic<unsigned int> framesDelivered(0);
+static std::atomic<unsigned int> framesDropped(0);
+static std::atomic<unsigned int> framesDuplicated(0);
+static unsigned int swapLastFrame = 0;
+static int  swapRejects = 0;
+static bool displaySync = false;
+static double displayLead = 0.004;
 static int InFrame = 0;
 double g_fpsScale = Normal; // used by sdl.cpp
 bool MaxSpeed = false;
@@ -133,6 +158,8 @@ static void setTimer( double hz )
 }
 #endif
 
+static int timingMode = 0;
+
 int getTimingMode(void)
 {
 #ifdef __linux__
@@ -141,7 +168,7 @@ int getTimingMode(void)
 		return 1;
 	}
 #endif
-	return 0;
+	return timingMode;
 }
 
 int setTimingMode( int mode )
@@ -149,14 +176,95 @@ int setTimingMode( int mode )
 #ifdef __linux__
 	useTimerFD = (mode == 1);
 #endif
+	timingMode = (mode == 2) ? 2 : 0;
+
 	return 0;
 }
 
+void setDisplaySync( bool enable, double lead )
+{
+	displaySync = enable;
+	displayLead = lead;
+
+	if ( !enable )
+	{
+		displayLocked = false;
+	}
+}
+
+bool getDisplaySync( double *lead )
+{
+	if ( lead )
+	{
+		*lead = displayLead;
+	}
+	return displaySync;
+}
+
 void setFrameTimingEnable( bool enable )
 {
 	keepFrameTimeStats = enable;
 }
 
+bool getFrameTimingEnable(void)
+{
+	return keepFrameTimeStats;
+}
+
+//**************************************************************************************
+// Frame stage histograms, recorded by the emulator and GUI threads and read
+// by the GUI and the REST server
+//**************************************************************************************
+static timingHistogram_t frameStageHist[FRAME_STAGE_COUNT];
+
+static const char *frameStageNames[FRAME_STAGE_COUNT] =
+{
+	"emulate", "video", "blit", "present", "audio", "mutex_wait", "input_to_photon"
+};
+
+const char *frameStageName( int stage )
+{
+	return ( (stage >= 0) && (stage < FRAME_STAGE_COUNT) ) ? frameStageNames[stage] : "";
+}
+
+void recordFrameStage( int stage, double seconds )
+{
+	if ( !keepFrameTimeStats || (stage < 0) || (stage >= FRAME_STAGE_COUNT) )
+	{
+		return;
+	}
+	frameStageHist[stage].record( seconds );
+}
+
+int getFrameStageStats( int stage, struct timingHistStat_t *stats )
+{
+	if ( (stage < 0) || (stage >= FRAME_STAGE_COUNT) )
+	{
+		memset( stats, 0, sizeof(*stats) );
+		return -1;
+	}
+	frameStageHist[stage].getStats( stats );
+
+	return 0;
+}
+
+frameStageTimer::frameStageTimer( int stageIdx )
+	: stage(stageIdx), start(0.0)
+{
+	if ( keepFrameTimeStats )
+	{
+		start = getHighPrecTimeStamp();
+	}
+}
+
+frameStageTimer::~frameStageTimer(void)
+{
+	if ( keepFrameTimeStats && (start > 0.0) )
+	{
+		recordFrameStage( stage, getHighPrecTimeStamp() - start );
+	}
+}
+
 int  getFrameTimingStats( struct frameTimingStat_t *stats )
 {
 	stats->enabled   = keepFrameTimeStats;
@@ -205,15 +313,143 @@ int  getFrameTimingStats( struct frameTimingStat_t *stats )
 	stats->emuSignalDelay.min = emuLatencyMin;
 	stats->emuSignalDelay.max = emuLatencyMax;
 
+	stats->displayPeriod    = swapPeriod.load();
+	stats->displayLocked    = displayLocked.load();
+	stats->sleepMargin      = sleepMargin;
+	stats->framesDelivered  = framesDelivered.load();
+	stats->framesDropped    = framesDropped.load();
+	stats->framesDuplicated = framesDuplicated.load();
+
 	return 0;
 }
 
-void videoBufferSwapMark(void)
+//**************************************************************************************
+// Input to photon. A press waits in inputEventTs until the emulator polls it
+// and in inputPolledTs until a frame has read the pads after that poll. It
+// then goes with the blit of the frame, and with the frame into the viewer,
+// so the swap that first shows that frame records the latency. Each step
+// keeps the earliest press it holds, later ones fold into it.
+//**************************************************************************************
+static std::atomic<double> inputEventTs(0.0);
+static double              inputPolledTs = 0.0;  // emulator thread
+static double              inputReadTs   = 0.0;  // emulator thread
+static std::atomic<double> inputFrameTs(0.0);
+static std::atomic<double> inputShownTs(0.0);
+
+// longer than this it was waiting on a pause or a hidden viewer, not on the pipeline
+static const double inputLatencyMax = 1.0;
+
+static void keepEarliest( std::atomic<double> &dest, double ts )
+{
+	double none = 0.0;
+
+	if ( ts > 0.0 )
+	{
+		dest.compare_exchange_strong( none, ts );
+	}
+}
+
+void inputEventMark( double ts )
 {
 	if ( keepFrameTimeStats )
 	{
-		double ts = getHighPrecTimeStamp();
+		keepEarliest( inputEventTs, ts );
+	}
+}
+
+void inputPollMark(void)
+{
+	double ts = inputEventTs.exchange( 0.0 );
+
+	if ( (ts > 0.0) && (inputPolledTs == 0.0) )
+	{
+		inputPolledTs = ts;
+	}
+}
+
+void inputFrameMark( bool padsRead )
+{
+	if ( padsRead && (inputPolledTs > 0.0) )
+	{
+		if ( inputReadTs == 0.0 )
+		{
+			inputReadTs = inputPolledTs;
+		}
+		inputPolledTs = 0.0;
+	}
+}
+
+double inputBlitTake(void)
+{
+	double ts = inputReadTs;
+
+	inputReadTs = 0.0;
+
+	return ts;
+}
+
+void inputBlitMark( double ts )
+{
+	keepEarliest( inputFrameTs, ts );
+}
+
+void inputTransferMark(void)
+{
+	keepEarliest( inputShownTs, inputFrameTs.exchange( 0.0 ) );
+}
+
+void videoBufferSwapMark(void)
+{
+	double ts = getHighPrecTimeStamp();
+	double last = swapLastTs.load();
+	double inputTs = inputShownTs.exchange( 0.0 );
+
+	if ( (inputTs > 0.0) && ((ts - inputTs) < inputLatencyMax) )
+	{
+		recordFrameStage( FRAME_STAGE_INPUT, ts - inputTs );
+	}
+	double period = swapPeriod.load();
+	unsigned int frames = framesDelivered.load();
+
+	// With vsync on, swaps come one refresh apart. Intervals far from the
+	// current estimate are missed refreshes or pauses, not a new period,
+	// unless they keep coming.
+	if ( (last > 0.0) && ((ts - last) < 0.25) )
+	{
+		double dt = ts - last;
+
+		if ( (period == 0.0) || (swapRejects > 30) )
+		{
+			period = dt; swapRejects = 0;
+		}
+		else if ( fabs(dt - period) < (0.25 * period) )
+		{
+			period += 0.05 * (dt - period); swapRejects = 0;
+		}
+		else
+		{
+			swapRejects++;
+		}
+		swapPeriod = period;
+
+		// A refresh without a new frame shows the last one again, a swap
+		// after more than one new frame never shows the ones in between
+		int refreshes = (int)( (dt / period) + 0.5 );
 
+		if ( refreshes > 1 )
+		{
+			framesDuplicated += (refreshes - 1);
+		}
+		if ( (frames - swapLastFrame) > 1 )
+		{
+			framesDropped += (frames - swapLastFrame - 1);
+		}
+	}
+	swapLastTs = ts;
+	swapLastFrame = frames;
+
+	if ( keepFrameTimeStats )
+	{
 		videoPeriodCur = ts - videoLastTs;
 
 		if ( videoPeriodCur < videoPeriodMin )
@@ -230,6 +466,8 @@ void videoBufferSwapMark(void)
 
 void emuSignalSendMark(void)
 {
+	framesDelivered++;
+
 	if ( keepFrameTimeStats )
 	{
 		emuSignalTx.readNew();
@@ -267,6 +505,13 @@ void resetFrameTiming(void)
 	videoPeriodMax = 0.0;
 	emuLatencyMin =  1.0;
 	emuLatencyMax =  0.0;
+	framesDropped = 0;
+	framesDuplicated = 0;
+
+	for (int s=0; s<FRAME_STAGE_COUNT; s++)
+	{
+		frameStageHist[s].reset();
+	}
 }
 
 /* LOGMUL = exp(log(2) / 3)
@@ -362,6 +607,75 @@ static int highPrecSleep( FCEU::timeStampRecord &ts )
 	return ret;
 }
 
+// Sleep until sleepMargin before the deadline, then spin the rest. Sleep
+// calls routinely wake late, by a scheduler tick under load; spinning the
+// last part lands the frame on time at the cost of a little CPU.
+static void hybridWait( FCEU::timeStampRecord &deadline )
+{
+	FCEU::timeStampRecord now, wake, sleepTime;
+
+	now.readNew();
+
+	double left = (deadline - now).toSeconds();
+
+	if ( (deadline > now) && (left > sleepMargin) )
+	{
+		sleepTime.fromSeconds( left - sleepMargin );
+		highPrecSleep( sleepTime );
+
+		wake.readNew();
+
+		// how far past the requested wake up the sleep ran
+		double late = (wake - now).toSeconds() - (left - sleepMargin);
+
+		if ( late < 0.0 )
+		{
+			late = 0.0;
+		}
+		sleepMargin += 0.1 * ( (2.0 * late + 0.0002) - sleepMargin );
+
+		if ( sleepMargin > 0.004 )
+		{
+			sleepMargin = 0.004;
+		}
+	}
+	do
+	{
+		now.readNew();
+	}
+	while ( now < deadline );
+}
+
+// Keep the emulator in step with the display: run at the measured refresh
+// when it is close to the emulated rate, and move frame starts toward the
+// point displayLead ahead of the next refresh, so a frame is ready just in
+// time for the swap that shows it.
+static void displaySyncAdjust( FCEU::timeStampRecord &next, FCEU::timeStampRecord &period )
+{
+	double refresh = swapPeriod.load();
+	double last = swapLastTs.load();
+	double nextSec = next.toSeconds();
+
+	bool lock = displaySync && (refresh > 0.0) && (g_fpsScale == Normal) &&
+		(fabs(refresh - desired_frametime) < (0.004 * desired_frametime)) &&
+		((nextSec - last) < 0.1) && (getTimingMode() != 1) && !NetPlayActive();
+
+	displayLocked = lock;
+
+	if ( !lock )
+	{
+		return;
+	}
+	period.fromSeconds( refresh );
+
+	double x = (nextSec + displayLead - last) / refresh;
+	double phaseErr = -(x - floor(x + 0.5)) * refresh;
+
+	nextSec += 0.1 * phaseErr;
+
+	next.fromSeconds( nextSec );
+}
+
 /**
  * Perform FPS speed throttling by delaying until the next time slot.
  */
@@ -370,7 +684,7 @@ SpeedThrottle(void)
 {
 	bool isEmuPaused = FCEUI_EmulationPaused() ? true : false;
 	bool noWaitActive = (NoWaiting & 0x01) ? true : false;
-	bool turboActive = (turbo || noWaitActive || NetPlaySkipWait());
+	bool turboActive = (turbo || noWaitActive || NetPlaySkipWait() || FCEUI_GetComputeOnly());
 
 	// If Emulator is paused, don't waste CPU cycles spinning on nothing.
 	if ( !isEmuPaused && ((g_fpsScale >= 32) || turboActive) )
@@ -446,7 +760,14 @@ SpeedThrottle(void)
 	}
 	else if ( !time_left.isZero() )
 	{
-		highPrecSleep( time_left );
+		if ( (timingMode == 2) && !InFrame )
+		{
+			hybridWait( Nexttime );
+		}
+		else
+		{
+			highPrecSleep( time_left );
+		}
 	}
 	else
 	{
@@ -459,7 +780,14 @@ SpeedThrottle(void)
 #else
 	if ( !time_left.isZero() )
 	{
-		highPrecSleep( time_left );
+		if ( (timingMode == 2) && !InFrame )
+		{
+			hybridWait( Nexttime );
+		}
+		else
+		{
+			highPrecSleep( time_left );
+		}
 	}
 	else
 	{
@@ -507,8 +835,13 @@ SpeedThrottle(void)
 		}
 		NetPlayThrottleControl();
 
+		FCEU::timeStampRecord framePeriod = DesiredFrameTime;
+
 		Lasttime = Nexttime;
-		Nexttime = Lasttime + DesiredFrameTime;
+		Nexttime = Lasttime + framePeriod;
+
+		displaySyncAdjust( Nexttime, framePeriod );
+
 		Latetime = Nexttime + HalfFrameTime;
 
 		if ( cur_time >= Nexttime )
@@ -524,6 +857,85 @@ SpeedThrottle(void)
 	return 1; /* Must still wait some more */
 }
 
+static std::mutex idleMutex;
+static std::condition_variable idleCond;
+static std::atomic<bool> idleWake(false);
+static std::atomic<bool> idleWaiting(false);
+
+/**
+ * While paused there is no frame to pace, so instead of going round once a
+ * frame the emulator thread sleeps until SpeedThrottleWake() or the timeout.
+ * The frame timing starts over afterwards.
+ */
+void
+SpeedThrottleIdle( int timeoutMs )
+{
+	{
+		std::unique_lock<std::mutex> lock(idleMutex);
+
+		idleWaiting = true;
+
+		idleCond.wait_for( lock, std::chrono::milliseconds(timeoutMs), []{ return idleWake.load(); } );
+
+		idleWake = false;
+		idleWaiting = false;
+	}
+	Lasttime.zero();
+	InFrame = 0;
+}
+
+/**
+ * Ends an idle wait early, or the next one if the emulator thread is not
+ * waiting yet. Callable from any thread, only takes the lock to wake it.
+ */
+void
+SpeedThrottleWake(void)
+{
+	idleWake = true;
+
+	if ( idleWaiting.load() )
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+
+		idleCond.notify_one();
+	}
+}
+
+/**
+ * Whether the emulator runs as fast as it can: turbo, no-wait or the top
+ * speed, where SpeedThrottle does not wait at all.
+ */
+bool fastForwardActive(void)
+{
+	bool noWaitActive = (NoWaiting & 0x01) ? true : false;
+
+	return (turbo || noWaitActive || (g_fpsScale >= Fastest)) && !FCEUI_EmulationPaused();
+}
+
+/**
+ * While fast-forwarding, whether the next frame should be shown. No more
+ * frames are shown than the display swaps buffers, the rest are only
+ * emulated.
+ */
+bool fastForwardFrameDue(void)
+{
+	static double lastShown = 0.0;
+	double period = swapPeriod.load();
+	double ts = getHighPrecTimeStamp();
+
+	if ( period <= 0.0 )
+	{
+		period = 1.0 / 60.0; // nothing swapped yet
+	}
+	if ( (ts - lastShown) < period )
+	{
+		return false;
+	}
+	lastShown = ts;
+
+	return true;
+}
+
 /**
  * Set the emulation speed throttling to the next entry in the speed table.
  */
@@ -28,6 +28,9 @@
 #include "../../version.h"
 #include "../../video.h"
 #include "../../input.h"
+#ifdef _S9XLUA_H
+#include "../../fceulua.h"
+#endif
 
 #include "utils/memory.h"
 
@@ -38,6 +41,8 @@
 #include "Qt/AviRecord.h"
 #include "Qt/fceuWrapper.h"
 #include "Qt/ConsoleWindow.h"
+#include "Qt/throttle.h"
+#include "Qt/ConsoleKiosk.h"
 
 #ifdef CREATE_AVI
 #include "../videolog/nesvideos-piece.h"
@@ -46,6 +51,10 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <atomic>
+
+#include <QThread>
+#include <QSemaphore>
 
 // GLOBALS
 extern Config *g_config;
@@ -58,6 +67,7 @@ static int s_inited = 0;
 
 static int s_eefx = 0;
 static int s_clipSides = 0;
+static int s_luaGuiOverlay = 0;
 static int s_fullscreen = 0;
 static int noframe = 0;
 static int initBlitToHighDone = 0;
@@ -69,12 +79,26 @@ static int initBlitToHighDone = 0;
 
 static int s_paletterefresh = 1;
 
+// Frames that repeat the last one blitted are not drawn again, so a static
+// screen costs no scaling, no texture upload and no redraw. The AVI buffer
+// keeps its own tracker since it is fed at a different point of the frame.
+static int s_skipUnchanged = 1;
+static FCEU_FrameChangeTracker blitTracker;
+static FCEU_FrameChangeTracker aviTracker;
+
+// Set by the GUI thread, the main window is visible and not minimized
+static std::atomic<bool> viewerVisible(true);
+
 extern bool MaxSpeed;
 extern int input_display;
 extern int frame_display;
 extern int rerecord_display;
 extern uint8 PALRAM[0x20];
 
+static void blitPoolInit(void);
+static void blitPoolShutdown(void);
+static void blitPoolWait(void);
+
 /**
  * Attempts to destroy the graphical video display.  Returns 0 on
  * success, -1 on failure.
@@ -84,6 +108,8 @@ KillVideo(void)
 {
 	//printf("Killing Video\n");
 
+	blitPoolShutdown();
+
 	if ( nes_shm != NULL )
 	{
 		nes_shm->clear_pixbuf();
@@ -116,6 +142,19 @@ KillVideo(void)
 // this variable contains information about the special scaling filters
 static int s_sponge = 0;
 
+// Special filters 10 and 11 are scale2x and scale3x done in the OpenGL
+// viewer's fragment shader, the emulator thread blits those frames at 1x.
+static int gpuScalerFactor( int filter )
+{
+	switch ( filter )
+	{
+		case 10: return 2;
+		case 11: return 3;
+		default: break;
+	}
+	return 0;
+}
+
 void FCEUD_VideoChanged(void)
 {
 	int buf;
@@ -136,11 +175,14 @@ void CalcVideoDimensions(void)
 	//printf("Calc Video: %i -> %i \n", s_srendline, s_erendline );
 
 	nes_shm->video.preScaler = s_sponge;
+	nes_shm->video.gpuScaler = gpuScalerFactor( s_sponge );
 
 	switch ( s_sponge )
 	{
 		default:
 		case 0: // None
+		case 10: // Scale2x, OpenGL
+		case 11: // Scale3x, OpenGL
 			nes_shm->video.xscale = 1;
 			nes_shm->video.yscale = 1;
 		break;
@@ -204,12 +246,14 @@ int InitVideo(FCEUGI *gi)
 	g_config->getOption("SDL.XStretch", &xstretch);
 	g_config->getOption("SDL.YStretch", &ystretch);
 	g_config->getOption("SDL.ClipSides", &s_clipSides);
+	g_config->getOption("SDL.LuaGuiOverlay", &s_luaGuiOverlay);
 	g_config->getOption("SDL.NoFrame", &noframe);
 	g_config->getOption("SDL.ShowFPS", &show_fps);
 	g_config->getOption("SDL.ShowFrameCount", &frame_display);
 	g_config->getOption("SDL.ShowLagCount", &lagCounterDisplay);
 	g_config->getOption("SDL.ShowRerecordCount", &rerecord_display);
 	g_config->getOption("SDL.ShowGuiMessages", &vidGuiMsgEna);
+	g_config->getOption("SDL.SkipUnchangedFrames", &s_skipUnchanged);
 	g_config->getOption("SDL.ScanLineStartNTSC", &startNTSC);
 	g_config->getOption("SDL.ScanLineEndNTSC", &endNTSC);
 	g_config->getOption("SDL.ScanLineStartPAL", &startPAL);
@@ -226,11 +270,14 @@ int InitVideo(FCEUGI *gi)
 	s_tlines = s_erendline - s_srendline + 1;
 
 	nes_shm->video.preScaler = s_sponge;
+	nes_shm->video.gpuScaler = gpuScalerFactor( s_sponge );
 
 	switch ( s_sponge )
 	{
 		default:
 		case 0: // None
+		case 10: // Scale2x, OpenGL
+		case 11: // Scale3x, OpenGL
 			nes_shm->video.xscale = 1;
 			nes_shm->video.yscale = 1;
 		break;
@@ -313,13 +360,19 @@ int InitVideo(FCEUGI *gi)
 							rmask,
 							gmask,
 							bmask,
-							s_eefx, s_sponge, 0);
+							s_eefx, gpuScalerFactor(s_sponge) ? 0 : s_sponge, 0);
 
 		initBlitToHighDone = 1;
 	}
 
 	s_paletterefresh = 1;
 
+	// the filter or the dimensions may have changed
+	blitTracker.invalidate();
+	aviTracker.invalidate();
+
+	blitPoolInit();
+
 	return 0;
 }
 
@@ -470,6 +523,7 @@ doBlitScreen(uint8_t *XBuf, uint8_t *dest)
 	nes_shm->video.nrow    = h;
 	nes_shm->video.pitch   = pitch;
 	nes_shm->video.preScaler = s_sponge;
+	nes_shm->use_pixbuf();
 
 	if ( dest == NULL ) return;
 
@@ -490,6 +544,254 @@ doBlitScreen(uint8_t *XBuf, uint8_t *dest)
 		Blit8ToHigh(XBuf + NOFFSET, dest, bw, s_tlines, pitch, ixScale, iyScale);
 	}
 }
+//**************************************************************************************
+// Blit Worker Pool
+//
+// The vidblit line modes (plain, scaled, prescale and NTSC at 32bpp, see
+// Blit8ToHighBandable) are drawn off the emulator thread. BlitScreen copies
+// the rendered lines, gives each worker one horizontal band of them and
+// returns, so emulation of the next frame overlaps the blit. The last worker
+// to finish publishes the frame through the pixBufIdx ring. One frame is in
+// flight at a time, the next BlitScreen waits for it. The other filters
+// still blit on the emulator thread.
+//**************************************************************************************
+#define  MAX_BLIT_WORKERS  4
+
+class BlitWorker_t : public QThread
+{
+	public:
+		BlitWorker_t( int bandIdx ) : quit(false), band(bandIdx) {}
+
+		QSemaphore  go;
+		bool        quit;
+
+	protected:
+		void run(void) override;
+
+	private:
+		int band;
+};
+
+static struct blitJob_t
+{
+	uint8  src[256*241];  // rendered lines, one spare line for the NTSC overread
+	uint8  srcD[256*241]; // matching deemph lines
+	uint8 *dest;
+	int    bufIdx;
+	int    xr, yr, pitch;
+	int    xscale, yscale;
+	int    ofs;
+	int    burst;
+	double inputTs;        // press first shown by this frame, see inputBlitTake()
+	bool   busy;           // only touched by the emulator thread
+
+	std::atomic<int> pending;
+	QSemaphore       done;
+} blitJob;
+
+static BlitWorker_t *blitWorker[MAX_BLIT_WORKERS] = { nullptr };
+static int numBlitWorkers = 0;
+
+void BlitWorker_t::run(void)
+{
+	while (1)
+	{
+		go.acquire();
+
+		if ( quit )
+		{
+			break;
+		}
+		int y0 = (blitJob.yr *  band   ) / numBlitWorkers;
+		int y1 = (blitJob.yr * (band+1)) / numBlitWorkers;
+
+		Blit8ToHighBand( blitJob.src + blitJob.ofs, blitJob.srcD + blitJob.ofs, blitJob.dest,
+				blitJob.xr, blitJob.pitch, blitJob.xscale, blitJob.yscale, y0, y1, blitJob.burst );
+
+		if ( --blitJob.pending == 0 )
+		{
+			{
+				FCEU::autoScopedLock lock(consoleWindow->videoBufferMutex);
+
+				nes_shm->pixBufIdx = (blitJob.bufIdx+1) % NES_VIDEO_BUFLEN;
+				nes_shm->blit_count++;
+				nes_shm->blitUpdated = 1;
+
+				inputBlitMark( blitJob.inputTs );
+			}
+			// the frame may have been reported before its bands were done
+			ConsoleKiosk_t::frameReady();
+
+			blitJob.done.release();
+		}
+	}
+}
+
+static void blitPoolInit(void)
+{
+	int n;
+
+	if ( numBlitWorkers > 0 )
+	{
+		return;
+	}
+	g_config->getOption("SDL.VideoBlitThreads", &n);
+
+	if ( n < 0 )
+	{
+		n = QThread::idealThreadCount() - 1;
+	}
+	if ( n > MAX_BLIT_WORKERS )
+	{
+		n = MAX_BLIT_WORKERS;
+	}
+	for (int i=0; i<n; i++)
+	{
+		blitWorker[i] = new BlitWorker_t(i);
+		blitWorker[i]->setObjectName( QString("BlitWorker%1").arg(i) );
+		blitWorker[i]->start();
+	}
+	numBlitWorkers = (n > 0) ? n : 0;
+}
+
+static void blitPoolWait(void)
+{
+	if ( blitJob.busy )
+	{
+		blitJob.done.acquire();
+		blitJob.busy = false;
+	}
+}
+
+static void blitPoolShutdown(void)
+{
+	blitPoolWait();
+
+	for (int i=0; i<numBlitWorkers; i++)
+	{
+		blitWorker[i]->quit = true;
+		blitWorker[i]->go.release();
+		blitWorker[i]->wait();
+
+		delete blitWorker[i]; blitWorker[i] = nullptr;
+	}
+	numBlitWorkers = 0;
+}
+
+// Hands the frame to the worker pool when the current filter can be banded.
+// Returns false when the caller has to blit it on this thread instead.
+static bool blitPoolStart(uint8_t *XBuf)
+{
+	if ( (numBlitWorkers == 0) || nes_shm->video.test || !Blit8ToHighBandable() )
+	{
+		return false;
+	}
+	// an unscaled blit costs about as much as copying the frame out
+	if ( (nes_shm->video.xscale == 1) && (nes_shm->video.yscale == 1) )
+	{
+		return false;
+	}
+
+	// refreshes the palette and the video dimensions, nothing is drawn
+	doBlitScreen(XBuf, NULL);
+
+	int lineOfs = s_srendline * 256;
+	int numLines = s_tlines < 240 ? s_tlines+1 : s_tlines;
+
+	memcpy( blitJob.src , XBuf  + lineOfs, numLines * 256 );
+	memcpy( blitJob.srcD, XDBuf + lineOfs, numLines * 256 );
+
+	blitJob.bufIdx = nes_shm->pixBufIdx;
+	blitJob.dest   = (uint8*)nes_shm->pixbuf[blitJob.bufIdx];
+	blitJob.xr     = (s_sponge == 3) ? 256 : NWIDTH;
+	blitJob.yr     = s_tlines;
+	blitJob.pitch  = nes_shm->video.pitch;
+	blitJob.xscale = nes_shm->video.xscale;
+	blitJob.yscale = nes_shm->video.yscale;
+	blitJob.ofs    = NOFFSET;
+	blitJob.burst  = Blit8ToHighNextBurst();
+	blitJob.inputTs = inputBlitTake();
+
+	blitJob.pending = numBlitWorkers;
+	blitJob.busy    = true;
+
+	for (int i=0; i<numBlitWorkers; i++)
+	{
+		blitWorker[i]->go.release();
+	}
+	return true;
+}
+
+// True when buf is the same picture, with the same palette, as the last
+// frame tracker saw, so the blit into dest can be skipped. The NTSC filter
+// always blits, its output moves with the color burst phase of each frame.
+static bool frameUnchanged( FCEU_FrameChangeTracker &tracker, uint8_t *buf )
+{
+	if ( !s_skipUnchanged || (s_sponge == 3) || nes_shm->video.test || (XDBuf == NULL) )
+	{
+		return false;
+	}
+	bool same = (tracker.update( buf, XDBuf ) == 0);
+
+	return same && !s_paletterefresh;
+}
+
+#ifdef _S9XLUA_H
+/**
+ * Hands the Lua gui drawing of the frame to the OpenGL viewer, and picks
+ * whether the next frames' is drawn by it or blended into XBuf. Recordings
+ * are taken from XBuf, so the drawing stays there while one runs.
+ */
+static void publishLuaGui(void)
+{
+	const LuaGuiCommand *cmds = NULL;
+	const uint32 *layer = NULL;
+	int ncmd = 0;
+	bool wasActive = nes_shm->gui.active != 0;
+	bool active = FCEU_LuaGetGuiOverlay( &cmds, &ncmd, &layer );
+
+	FCEU_LuaSetGuiOverlay( s_luaGuiOverlay && nes_shm->gui.composite && !aviRecordRunning() );
+
+	if ( !active && !wasActive )
+	{
+		return;
+	}
+	FCEU::autoScopedLock lock(consoleWindow->videoBufferMutex);
+
+	nes_shm->gui.active = active;
+
+	if ( active )
+	{
+		if ( ncmd > NES_GUI_MAX_CMDS )
+		{
+			ncmd = NES_GUI_MAX_CMDS;
+		}
+		for (int i=0; i<ncmd; i++)
+		{
+			nes_shm->gui.cmd[i].x1 = cmds[i].x1;
+			nes_shm->gui.cmd[i].y1 = cmds[i].y1;
+			nes_shm->gui.cmd[i].x2 = cmds[i].x2;
+			nes_shm->gui.cmd[i].y2 = cmds[i].y2;
+			nes_shm->gui.cmd[i].colour = cmds[i].colour;
+			nes_shm->gui.cmd[i].line   = cmds[i].line;
+		}
+		nes_shm->gui.ncmd = ncmd;
+		nes_shm->gui.layerUsed = (layer != NULL);
+
+		if ( layer != NULL )
+		{
+			memcpy( nes_shm->gui.layer, layer, sizeof(nes_shm->gui.layer) );
+		}
+		nes_shm->gui.x0     = NOFFSET;
+		nes_shm->gui.y0     = s_srendline;
+		nes_shm->gui.width  = 256 - 2*NOFFSET;
+		nes_shm->gui.height = s_tlines;
+	}
+	// the viewer redraws for it even when the picture is unchanged
+	nes_shm->blitUpdated = 1;
+}
+#endif
+
 /**
  * Pushes the given buffer of bits to the screen.
  */
@@ -511,6 +813,29 @@ BlitScreen(uint8 *XBuf)
 
 	if (consoleWindow != nullptr)
 	{
+		// the previous frame may still be in the worker pool
+		blitPoolWait();
+
+		// nobody sees the viewer, the frame is blitted again once it shows
+		if ( !viewerVisible.load(std::memory_order_relaxed) )
+		{
+			blitTracker.invalidate();
+			return;
+		}
+
+#ifdef _S9XLUA_H
+		publishLuaGui();
+#endif
+		// the viewer still holds this picture
+		if ( frameUnchanged( blitTracker, XBuf ) )
+		{
+			return;
+		}
+
+		if ( blitPoolStart(XBuf) )
+		{
+			return;
+		}
 		FCEU::autoScopedLock lock(consoleWindow->videoBufferMutex);
 
 		int i = nes_shm->pixBufIdx;
@@ -520,6 +845,8 @@ BlitScreen(uint8 *XBuf)
 		nes_shm->pixBufIdx = (i+1) % NES_VIDEO_BUFLEN;
 		nes_shm->blit_count++;
 		nes_shm->blitUpdated = 1;
+
+		inputBlitMark( inputBlitTake() );
 	}
 }
 
@@ -527,13 +854,33 @@ void FCEUI_AviVideoUpdate(const unsigned char* buffer)
 {	// This is not used by Qt Emulator, avi recording pulls from the post processed video buffer
 	// instead of emulation core video buffer. This allows for the video scaler effects
 	// and higher resolution to be seen in recording.
-	doBlitScreen( (uint8_t*)buffer, (uint8_t*)nes_shm->avibuf);
+	blitPoolWait();
+
+	// avibuf still holds this picture, it only needs to be queued again
+	if ( !frameUnchanged( aviTracker, (uint8_t*)buffer ) )
+	{
+		doBlitScreen( (uint8_t*)buffer, (uint8_t*)nes_shm->avibuf);
+	}
 
 	aviRecordAddFrame();
 
 	return;
 }
 
+void setVideoViewerVisible(bool visible)
+{
+	if ( viewerVisible.exchange(visible) != visible )
+	{
+		// a paused emulator redraws its picture for the viewer right away
+		SpeedThrottleWake();
+	}
+}
+
+bool videoViewerVisible(void)
+{
+	return viewerVisible.load();
+}
+
 /**
  *  Converts an x-y coordinate in the window manager into an x-y
  *  coordinate on FCEU's screen.
@@ -13,5 +13,10 @@ bool FCEUI_AviEnableHUDrecording();
 void FCEUI_SetAviEnableHUDrecording(bool enable);
 bool FCEUI_AviDisableMovieMessages();
 void FCEUI_SetAviDisableMovieMessages(bool disable);
+
+// Whether the main window shows the game. While it does not, the frames are
+// not scaled or blitted for the viewer.
+void setVideoViewerVisible(bool visible);
+bool videoViewerVisible(void);
 #endif
 
@@ -1,8 +1,19 @@
 // throttle.h
+
+#pragma once
+
+#include "Qt/TimingHistogram.h"
+
 int SpeedThrottle(void);
+void SpeedThrottleIdle( int timeoutMs ); // paused, sleep until woken or timeout
+void SpeedThrottleWake(void);
 void RefreshThrottleFPS(void);
 int getTimingMode(void);
-int setTimingMode(int mode);
+int setTimingMode(int mode); // 0 sleep, 1 timerfd (Linux), 2 sleep then spin
+void setDisplaySync( bool enable, double lead );
+bool getDisplaySync( double *lead = nullptr );
+bool fastForwardActive(void);
+bool fastForwardFrameDue(void);
 
 
 struct frameTimingStat_t
@@ -52,13 +63,63 @@ struct frameTimingStat_t
 
 	unsigned int lateCount;
 
+	// kept whether or not timing statistics are enabled
+	double displayPeriod;   // measured buffer swap period, 0 before any swaps
+	bool   displayLocked;   // frames are paced to the display
+	double sleepMargin;     // spun part of a hybrid wait
+	unsigned int framesDelivered;
+	unsigned int framesDropped;
+	unsigned int framesDuplicated;
+
 	bool enabled;
 };
 
+// Parts of a frame timed into histograms while frame timing is enabled
+enum frameStage_t
+{
+	FRAME_STAGE_EMULATE = 0, // FCEUI_Emulate(), emulator thread
+	FRAME_STAGE_VIDEO,       // BlitScreen() post-processing, emulator thread
+	FRAME_STAGE_BLIT,        // copy to the viewer's buffer, GUI thread
+	FRAME_STAGE_PRESENT,     // viewer paint and present, GUI thread
+	FRAME_STAGE_AUDIO,       // WriteSound(), emulator thread
+	FRAME_STAGE_MUTEX,       // emulator thread waiting on emulatorMutex
+	FRAME_STAGE_INPUT,       // input event to the swap of the first frame that read it
+	FRAME_STAGE_COUNT
+};
+
+const char *frameStageName( int stage );
+void recordFrameStage( int stage, double seconds );
+int  getFrameStageStats( int stage, struct timingHistStat_t *stats );
+bool getFrameTimingEnable(void);
+
+// Times its scope to a stage when frame timing is enabled
+class frameStageTimer
+{
+	public:
+		explicit frameStageTimer( int stage );
+		~frameStageTimer(void);
+
+		frameStageTimer( const frameStageTimer & ) = delete;
+		frameStageTimer &operator = ( const frameStageTimer & ) = delete;
+
+	private:
+		int    stage;
+		double start;
+};
+
 void resetFrameTiming(void);
 void setFrameTimingEnable( bool enable );
 int  getFrameTimingStats( struct frameTimingStat_t *stats );
 void videoBufferSwapMark(void);
+
+// Input to photon latency, recorded as FRAME_STAGE_INPUT. The earliest press
+// not yet shown is carried along the marks in this order.
+void   inputEventMark( double ts );     // a press, at its event time stamp
+void   inputPollMark(void);             // FCEUD_UpdateInput() hands input to the core
+void   inputFrameMark( bool padsRead ); // after the frame, whether the game read the pads
+double inputBlitTake(void);             // emulator thread, as the frame's blit starts
+void   inputBlitMark( double ts );      // blit published, under videoBufferMutex
+void   inputTransferMark(void);         // viewer took the frame, under videoBufferMutex
 void emuSignalSendMark(void);
 void guiSignalRecvMark(void);
 double getHighPrecTimeStamp(void);
@@ -0,0 +1,428 @@
+// cdl_coverage.cpp
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(NOSSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CDL_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../cart.h"
+#include "../../debug.h"
+#include "../../ppu.h"
+#include "../../git.h"
+#include "common/cdl_coverage.h"
+
+extern unsigned int cdloggerVideoDataSize;
+
+static inline int countBits(uint32_t w)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcount(w);
+#else
+	w = w - ((w >> 1) & 0x55555555);
+	w = (w & 0x33333333) + ((w >> 2) & 0x33333333);
+	w = (w + (w >> 4)) & 0x0F0F0F0F;
+	return (int)((w * 0x01010101) >> 24);
+#endif
+}
+
+//************************************************************
+bool FCEU_CDLBegin(void)
+{
+	if (GameInfo == NULL)
+	{
+		return false;
+	}
+	FCEU_CDLEnd();
+
+	// same layout as the debugger's Code/Data Logger
+	cdloggerdataSize = PRGsize[(GameInfo->type == GIT_FDS) ? 1 : 0];
+	cdloggerdata = (unsigned char *)calloc(cdloggerdataSize ? cdloggerdataSize : 1, 1);
+
+	if (!CHRram[0] || (CHRptr[0] == PRGptr[0]))
+	{
+		cdloggerVideoDataSize = CHRsize[0];
+		cdloggervdata = cdloggerVideoDataSize ? (unsigned char *)calloc(cdloggerVideoDataSize, 1) : NULL;
+	}
+	else if (GameInfo->type != GIT_NSF)
+	{
+		cdloggerVideoDataSize = 0;
+		cdloggervdata = (unsigned char *)calloc(8192, 1);
+	}
+
+	codecount = datacount = rendercount = vromreadcount = 0;
+	undefinedcount = cdloggerdataSize;
+	undefinedvromcount = cdloggerVideoDataSize ? cdloggerVideoDataSize : 8192;
+
+	FCEUI_SetLoggingCD(1);
+
+	return true;
+}
+//************************************************************
+void FCEU_CDLEnd(void)
+{
+	FCEUI_SetLoggingCD(0);
+
+	if (cdloggerdata)
+	{
+		free(cdloggerdata);
+		cdloggerdata = NULL;
+	}
+	cdloggerdataSize = 0;
+
+	if (cdloggervdata)
+	{
+		free(cdloggervdata);
+		cdloggervdata = NULL;
+	}
+	cdloggerVideoDataSize = 0;
+}
+//************************************************************
+bool FCEU_CDLActive(void)
+{
+	return cdloggerdata != NULL;
+}
+//************************************************************
+bool FCEU_CDLSave(const char *path)
+{
+	FILE *fp;
+	bool ok;
+
+	if (cdloggerdata == NULL)
+	{
+		return false;
+	}
+	fp = fopen(path, "wb");
+
+	if (fp == NULL)
+	{
+		return false;
+	}
+	ok = fwrite(cdloggerdata, 1, cdloggerdataSize, fp) == cdloggerdataSize;
+
+	if (ok && cdloggerVideoDataSize)
+	{
+		ok = fwrite(cdloggervdata, 1, cdloggerVideoDataSize, fp) == cdloggerVideoDataSize;
+	}
+	if (fclose(fp) != 0)
+	{
+		ok = false;
+	}
+	return ok;
+}
+//************************************************************
+size_t FCEU_CDLPrgSize(void)
+{
+	if (GameInfo == NULL)
+	{
+		return 0;
+	}
+	return PRGsize[(GameInfo->type == GIT_FDS) ? 1 : 0];
+}
+//************************************************************
+CDLCoverage::CDLCoverage( size_t prgSize, size_t bankSize )
+{
+	prg  = prgSize;
+	bank = bankSize ? bankSize : 0x4000;
+}
+//************************************************************
+static void addNewByte( std::vector<CDLCoverage::range_t> &ranges, uint32_t ofs )
+{
+	if ( !ranges.empty() && (ranges.back().end + 1 == ofs) )
+	{
+		ranges.back().end = ofs;
+	}
+	else
+	{
+		CDLCoverage::range_t r;
+
+		r.start = r.end = ofs;
+
+		ranges.push_back(r);
+	}
+}
+//************************************************************
+bool CDLCoverage::add( const char *path )
+{
+	std::vector<uint8_t> buf;
+	file_t f;
+	long size;
+	FILE *fp;
+
+	fp = fopen( path, "rb" );
+
+	if ( fp == NULL )
+	{
+		error = std::string("Unable to open ") + path;
+		return false;
+	}
+	fseek( fp, 0, SEEK_END );
+	size = ftell( fp );
+	fseek( fp, 0, SEEK_SET );
+
+	if ( size <= 0 )
+	{
+		fclose(fp);
+		error = std::string("Empty CDL file ") + path;
+		return false;
+	}
+	buf.resize( size );
+
+	if ( fread( buf.data(), 1, size, fp ) != (size_t)size )
+	{
+		fclose(fp);
+		error = std::string("Unable to read ") + path;
+		return false;
+	}
+	fclose(fp);
+
+	if ( fileList.empty() )
+	{
+		if ( (prg == 0) || (prg > (size_t)size) )
+		{
+			prg = size;
+		}
+		merged.assign( size, 0 );
+	}
+	else if ( (size_t)size != merged.size() )
+	{
+		error = std::string("CDL file size differs from the first file: ") + path;
+		return false;
+	}
+
+	f.path = path;
+	f.covered = 0;
+	f.newBytes = 0;
+
+	uint8_t *dst = merged.data();
+	const uint8_t *src = buf.data();
+	size_t i = 0;
+
+#ifdef CDL_SSE2
+	const __m128i codeData = _mm_set1_epi8(3);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; i + 16 <= prg; i += 16)
+	{
+		__m128i m = _mm_loadu_si128( (const __m128i*)(dst + i) );
+		__m128i t = _mm_loadu_si128( (const __m128i*)(src + i) );
+
+		// 0xFF in the bytes with neither the code nor the data bit
+		__m128i mNone = _mm_cmpeq_epi8( _mm_and_si128( m, codeData ), zero );
+		__m128i tNone = _mm_cmpeq_epi8( _mm_and_si128( t, codeData ), zero );
+
+		uint32_t hit  = ~_mm_movemask_epi8( tNone ) & 0xFFFF;
+		uint32_t hitNew = _mm_movemask_epi8( _mm_andnot_si128( tNone, mNone ) );
+
+		_mm_storeu_si128( (__m128i*)(dst + i), _mm_or_si128( m, t ) );
+
+		f.covered += countBits( hit );
+
+		if ( hitNew )
+		{
+			f.newBytes += countBits( hitNew );
+
+			for (int j = 0; j < 16; j++)
+			{
+				if ( hitNew & (1 << j) )
+				{
+					addNewByte( f.newRanges, i + j );
+				}
+			}
+		}
+	}
+#endif
+	for (; i < prg; i++)
+	{
+		if ( src[i] & 3 )
+		{
+			f.covered++;
+
+			if ( !(dst[i] & 3) )
+			{
+				f.newBytes++;
+				addNewByte( f.newRanges, i );
+			}
+		}
+		dst[i] |= src[i];
+	}
+	// CHR part, merged only
+	for (; i < merged.size(); i++)
+	{
+		dst[i] |= src[i];
+	}
+
+	fileList.push_back(f);
+
+	return true;
+}
+//************************************************************
+CDLCoverage::count_t CDLCoverage::count( size_t start, size_t size )
+{
+	count_t c;
+	size_t i, end;
+
+	c.code = c.data = c.covered = 0;
+
+	end = start + size;
+
+	if ( end > prg )
+	{
+		end = prg;
+	}
+	i = start;
+
+#ifdef CDL_SSE2
+	const __m128i code = _mm_set1_epi8(1);
+	const __m128i data = _mm_set1_epi8(2);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; i + 16 <= end; i += 16)
+	{
+		__m128i m = _mm_loadu_si128( (const __m128i*)(merged.data() + i) );
+
+		uint32_t noCode = _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_and_si128( m, code ), zero ) );
+		uint32_t noData = _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_and_si128( m, data ), zero ) );
+
+		c.code    += 16 - countBits( noCode );
+		c.data    += 16 - countBits( noData );
+		c.covered += 16 - countBits( noCode & noData );
+	}
+#endif
+	for (; i < end; i++)
+	{
+		uint8_t b = merged[i];
+
+		c.code    += (b & 1) ? 1 : 0;
+		c.data    += (b & 2) ? 1 : 0;
+		c.covered += (b & 3) ? 1 : 0;
+	}
+	return c;
+}
+//************************************************************
+bool CDLCoverage::saveCDL( const char *path )
+{
+	FILE *fp;
+	bool ok;
+
+	fp = fopen( path, "wb" );
+
+	if ( fp == NULL )
+	{
+		error = std::string("Unable to create ") + path;
+		return false;
+	}
+	ok = fwrite( merged.data(), 1, merged.size(), fp ) == merged.size();
+
+	if ( fclose(fp) != 0 )
+	{
+		ok = false;
+	}
+	if ( !ok )
+	{
+		error = std::string("Unable to write ") + path;
+	}
+	return ok;
+}
+//************************************************************
+static void writeJsonString( FILE *fp, const std::string &s )
+{
+	fputc( '"', fp );
+
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		unsigned char c = s[i];
+
+		if ( (c == '"') || (c == '\\') )
+		{
+			fprintf( fp, "\\%c", c );
+		}
+		else if ( c < 0x20 )
+		{
+			fprintf( fp, "\\u%04x", c );
+		}
+		else
+		{
+			fputc( c, fp );
+		}
+	}
+	fputc( '"', fp );
+}
+//************************************************************
+bool CDLCoverage::saveSummary( const char *path )
+{
+	FILE *fp;
+	count_t total;
+	size_t chrUsed = 0;
+	bool ok;
+
+	fp = fopen( path, "w" );
+
+	if ( fp == NULL )
+	{
+		error = std::string("Unable to create ") + path;
+		return false;
+	}
+	total = count( 0, prg );
+
+	for (size_t i = prg; i < merged.size(); i++)
+	{
+		chrUsed += (merged[i] & 3) ? 1 : 0;
+	}
+
+	fprintf( fp, "{\n" );
+	fprintf( fp, "  \"prg_size\": %zu,\n", prg );
+	fprintf( fp, "  \"chr_size\": %zu,\n", chrSize() );
+	fprintf( fp, "  \"prg\": { \"code\": %zu, \"data\": %zu, \"covered\": %zu },\n",
+			total.code, total.data, total.covered );
+	fprintf( fp, "  \"chr\": { \"covered\": %zu },\n", chrUsed );
+
+	fprintf( fp, "  \"bank_size\": %zu,\n", bank );
+	fprintf( fp, "  \"banks\": [" );
+
+	for (size_t ofs = 0, n = 0; ofs < prg; ofs += bank, n++)
+	{
+		size_t size = (prg - ofs < bank) ? (prg - ofs) : bank;
+		count_t c = count( ofs, size );
+
+		fprintf( fp, "%s\n    { \"bank\": %zu, \"offset\": %zu, \"size\": %zu, \"code\": %zu, \"data\": %zu, \"covered\": %zu }",
+				n ? "," : "", n, ofs, size, c.code, c.data, c.covered );
+	}
+	fprintf( fp, "\n  ],\n" );
+
+	fprintf( fp, "  \"files\": [" );
+
+	for (size_t i = 0; i < fileList.size(); i++)
+	{
+		const file_t &f = fileList[i];
+
+		fprintf( fp, "%s\n    { \"path\": ", i ? "," : "" );
+		writeJsonString( fp, f.path );
+		fprintf( fp, ", \"covered\": %zu, \"new_bytes\": %zu, \"new_ranges\": [", f.covered, f.newBytes );
+
+		for (size_t j = 0; j < f.newRanges.size(); j++)
+		{
+			fprintf( fp, "%s[%u, %u]", j ? ", " : "", f.newRanges[j].start, f.newRanges[j].end );
+		}
+		fprintf( fp, "] }" );
+	}
+	fprintf( fp, "\n  ]\n}\n" );
+
+	ok = !ferror( fp );
+
+	if ( fclose(fp) != 0 )
+	{
+		ok = false;
+	}
+	if ( !ok )
+	{
+		error = std::string("Unable to write ") + path;
+	}
+	return ok;
+}
+//************************************************************
@@ -0,0 +1,90 @@
+// cdl_coverage.h
+//
+// Code/data logger sessions without the debugger window, and merging of the
+// .cdl files of many runs into one coverage report.
+//
+// A .cdl file is the log of one ROM as written by the Code/Data Logger: one
+// byte per PRG ROM byte, then one per CHR ROM byte if the cart has CHR ROM.
+// In the PRG part bit 0 marks code and bit 1 data, which is what coverage is
+// counted on. The files are merged by ORing the bytes.
+//
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Allocates and clears the log for the loaded game and starts logging
+bool FCEU_CDLBegin(void);
+
+// Stops logging and frees the log
+void FCEU_CDLEnd(void);
+
+bool FCEU_CDLActive(void);
+
+// Writes the log in the .cdl layout
+bool FCEU_CDLSave(const char *path);
+
+// Size of the PRG part of the loaded game's log, 0 without a game
+size_t FCEU_CDLPrgSize(void);
+
+class CDLCoverage
+{
+	public:
+		// prgSize is the PRG part of every file, 0 to take the whole of the
+		// first file as PRG. bankSize is the unit of the per bank report.
+		CDLCoverage( size_t prgSize = 0, size_t bankSize = 0x4000 );
+
+		// ORs a file into the merged log and records the PRG bytes it covers
+		// that none of the files added before it did. Every file must have
+		// the size of the first one.
+		bool add( const char *path );
+
+		bool saveCDL( const char *path );
+
+		// JSON summary: totals, coverage of each bank and the ranges each
+		// file was first to hit
+		bool saveSummary( const char *path );
+
+		const std::string &errorMsg(void){ return error; }
+
+		struct range_t
+		{
+			uint32_t start;
+			uint32_t end;    // last byte, inclusive
+		};
+
+		struct file_t
+		{
+			std::string path;
+			size_t covered;  // PRG bytes logged as code or data
+			size_t newBytes; // of those, not covered by the files before
+			std::vector<range_t> newRanges;
+		};
+
+		struct count_t
+		{
+			size_t code;
+			size_t data;
+			size_t covered;  // code or data
+		};
+
+		// Counts over the merged PRG bytes [start, start+size)
+		count_t count( size_t start, size_t size );
+
+		size_t prgSize(void){ return prg; }
+		size_t chrSize(void){ return merged.size() - prg; }
+
+		const std::vector<file_t> &files(void){ return fileList; }
+
+	private:
+		size_t prg;
+		size_t bank;
+
+		std::vector<uint8_t> merged;
+		std::vector<file_t>  fileList;
+
+		std::string error;
+};
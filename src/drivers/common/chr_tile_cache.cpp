@@ -0,0 +1,55 @@
+// chr_tile_cache.cpp
+//
+#include <string.h>
+
+#include "common/chr_tile_cache.h"
+
+//************************************************************
+void CHRTileDecode( const uint8_t *chr, uint8_t *pix )
+{
+	for (int y = 0; y < 8; y++)
+	{
+		uint8_t chr0 = chr[y];
+		uint8_t chr1 = chr[y + 8];
+
+		for (int x = 7; x >= 0; x--)
+		{
+			*pix++ = ((chr0 >> x) & 1) | (((chr1 >> x) & 1) << 1);
+		}
+	}
+}
+//************************************************************
+CHRTileCache::CHRTileCache(void)
+{
+	memset( pix, 0, sizeof(pix) );
+	memset( ver, 0, sizeof(ver) );
+	decodes = 0;
+
+	invalidate();
+}
+//************************************************************
+void CHRTileCache::invalidate(void)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		valid[i] = false;
+	}
+}
+//************************************************************
+const uint8_t *CHRTileCache::page( int n, const uint8_t *chr, uint32_t version )
+{
+	n &= 7;
+
+	if ( !valid[n] || (ver[n] != version) )
+	{
+		for (int t = 0; t < 64; t++)
+		{
+			CHRTileDecode( &chr[t * 16], pix[n][t] );
+		}
+		ver[n]   = version;
+		valid[n] = true;
+		decodes++;
+	}
+	return &pix[n][0][0];
+}
+//************************************************************
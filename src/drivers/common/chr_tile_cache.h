@@ -0,0 +1,49 @@
+// chr_tile_cache.h
+//
+// Decoded 8x8 pattern tiles for the PPU and Name Table viewers and the REST
+// image endpoints. A tile comes out as 64 color indices (0-3), row by row,
+// which the caller maps through whatever palette it draws with.
+//
+// Tiles are kept per 1KB CHR page along with the version the caller gave
+// for the page, and only decoded again when that version changes. The
+// viewers pass the versions of their capture frame; code running with the
+// emulator locked can pass CHRPageVersion[], which the cart bumps on every
+// bank switch and every CHR RAM write. A cache is not thread safe; give
+// each consumer its own.
+//
+#pragma once
+
+#include <stdint.h>
+
+// 16 bytes of 2bpp pattern data into 64 color indices
+void CHRTileDecode( const uint8_t *chr, uint8_t *pix );
+
+class CHRTileCache
+{
+	public:
+		CHRTileCache(void);
+
+		// The 64 tiles of page n ($0000-$1FFF in 1KB steps), 64 bytes each.
+		// chr is the page's data, read only when version differs from the
+		// one the page was last decoded at.
+		const uint8_t *page( int n, const uint8_t *chr, uint32_t version );
+
+		// The tile at pattern address addr, chr holding the 8 pages
+		const uint8_t *tile( uint32_t addr, const uint8_t (*chr)[0x400], const uint32_t *version )
+		{
+			addr &= 0x1FFF;
+			return page( addr >> 10, chr[addr >> 10], version[addr >> 10] ) + ((addr >> 4) & 63) * 64;
+		}
+
+		// Forgets every page, for when the versions start over
+		void invalidate(void);
+
+		// Number of pages decoded so far
+		uint32_t decodeCount(void){ return decodes; };
+
+	private:
+		uint8_t  pix[8][64][64];
+		uint32_t ver[8];
+		bool     valid[8];
+		uint32_t decodes;
+};
@@ -1,5 +1,4 @@
 #include <iostream>
-#include <fstream>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -702,8 +701,7 @@ Config::_load()
 int
 Config::_loadFile(const char* fname)
 {
-	size_t pos=0, eqPos=0;
-	std::fstream config;
+	size_t pos=0, eqPos=0, start=0, end=0;
 	std::map<std::string, int>::iterator int_i;
 	std::map<std::string, double>::iterator dbl_i;
 	std::map<std::string, std::string>::iterator str_i;
@@ -716,59 +714,143 @@ Config::_loadFile(const char* fname)
 	{
 		configFile = fname;
 	}
-	std::string line, name, value;
+	std::string text, line, name, value;
 	char buf[4096];
+	size_t n;
 
-	// set the exception handling to catch i/o errors
-	config.exceptions(std::fstream::badbit);
+	// read the whole file at once, it is parsed from memory
+	FILE *fp = fopen(configFile.c_str(), "rb");
+	if(fp == NULL) {
+		// XXX file couldn't be opened?
+		return 0;
+	}
+	while((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		text.append(buf, n);
+	}
+	if(ferror(fp)) {
+		fclose(fp);
+		std::cerr << "Error reading " << configFile << std::endl;
+		return -1;
+	}
+	fclose(fp);
 
-	try {
-		// open the file for reading (create if it doesn't exist)
-		config.open(configFile.c_str(), std::ios::in | std::ios::out);
-		if(!config.is_open()) {
-			// XXX file couldn't be opened?
-			return 0;
-			}
+	while(start < text.size()) {
+		// get a line, without its line ending
+		end = text.find('\n', start);
+		if(end == std::string::npos) {
+			end = text.size();
+		}
+		line.assign(text, start, end - start);
+		start = end + 1;
 
-		while(!config.eof()) {
-			// read a line
-			config.getline(buf, sizeof(buf));
-			line = buf;
+		if(!line.empty() && (line[line.size()-1] == '\r')) {
+			line.erase(line.size()-1);
+		}
 
-			// check line validity
-			eqPos = line.find("=");
-			if(line[0] == '#') {
-				// skip this line
-				continue;
-			}
+		// check line validity
+		eqPos = line.find("=");
+		if(line.empty() || line[0] == '#') {
+			// skip this line
+			continue;
+		}
 
-			// get the name and value for the option
-			pos = line.find(" ");
-			name = line.substr(0, (pos > eqPos) ? eqPos : pos);
-			pos = line.find_first_not_of(" ", eqPos + 1);
-			if (pos == std::string::npos)
-				value = "";
-			else value = line.substr(pos);
-
-			// check if the option exists, and if so, set it appropriately
-			str_i = _strOptMap.find(name);
-			dbl_i = _dblOptMap.find(name);
-			int_i = _intOptMap.find(name);
-			if(str_i != _strOptMap.end()) {
-				str_i->second = value;
-			} else if(int_i != _intOptMap.end()) {
-				int_i->second = atol(value.c_str());
-			} else if(dbl_i != _dblOptMap.end()) {
-				dbl_i->second = atof(value.c_str());
-			}
+		// get the name and value for the option
+		pos = line.find(" ");
+		name = line.substr(0, (pos > eqPos) ? eqPos : pos);
+		pos = line.find_first_not_of(" ", eqPos + 1);
+		if (pos == std::string::npos)
+			value = "";
+		else value = line.substr(pos);
+
+		// check if the option exists, and if so, set it appropriately
+		if((str_i = _strOptMap.find(name)) != _strOptMap.end()) {
+			str_i->second = value;
+		} else if((int_i = _intOptMap.find(name)) != _intOptMap.end()) {
+			int_i->second = atol(value.c_str());
+		} else if((dbl_i = _dblOptMap.find(name)) != _dblOptMap.end()) {
+			dbl_i->second = atof(value.c_str());
 		}
+	}
+
+	return 0;
+}
 
-		// close the file
-		config.close();
-	} catch(std::fstream::failure &e) {
-		std::cerr << e.what() << std::endl;
+/**
+ * Formats the current configuration settings the way they are saved.
+ */
+std::string
+Config::_format() const
+{
+	std::map<std::string, int>::const_iterator int_i;
+	std::map<std::string, double>::const_iterator dbl_i;
+	std::map<std::string, std::string>::const_iterator str_i;
+	std::string text;
+	char buf[4096];
+
+	text.reserve(64 * (_intOptMap.size() + _dblOptMap.size() + _strOptMap.size()));
+
+	// write a warning
+	text.append("# Auto-generated\n# SDL keysyms defined in /usr/include/SDL/SDL_keysym.h\n# getSDLKey can be found \
+            in the source directory and can assist in remapping hotkeys\n#\n");
+
+	// write each configuration setting
+	for(int_i = _intOptMap.begin(); int_i != _intOptMap.end(); int_i++) 
+	{
+		snprintf(buf, sizeof(buf), "%s = %d\n",
+			int_i->first.c_str(), int_i->second);
+		text.append(buf);
+	}
+	for(dbl_i = _dblOptMap.begin(); dbl_i != _dblOptMap.end(); dbl_i++) 
+	{
+		snprintf(buf, sizeof(buf), "%s = %f\n",
+			dbl_i->first.c_str(), dbl_i->second);
+		text.append(buf);
+	}
+	for(str_i = _strOptMap.begin(); str_i != _strOptMap.end(); str_i++) 
+	{
+		text.append(str_i->first);
+		text.append(" = ");
+		text.append(str_i->second);
+		text.append("\n");
+	}
+	return text;
+}
+
+/**
+ * Writes text to the configuration file, unless it is what was
+ * written last.  The caller holds _fileMutex.
+ */
+int
+Config::_writeFile(const std::string &text)
+{
+	std::string configFile = _dir + "/" + cfgFile;
+	std::string tmpFile = configFile + ".tmp";
+
+	if(text == _savedText) {
+		return 0;
+	}
+
+	// write a temporary file and move it over the old one, so a crash
+	// while writing does not leave half a configuration behind
+	FILE *fp = fopen(tmpFile.c_str(), "wb");
+	if(fp == NULL) {
+		std::cerr << "Could not write " << tmpFile << std::endl;
+		return -1;
+	}
+	bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+	ok = (fclose(fp) == 0) && ok;
+
+#ifdef WIN32
+	if(ok) {
+		remove(configFile.c_str());
+	}
+#endif
+	if(!ok || (rename(tmpFile.c_str(), configFile.c_str()) != 0)) {
+		std::cerr << "Could not write " << configFile << std::endl;
+		remove(tmpFile.c_str());
 		return -1;
 	}
+	_savedText = text;
 
 	return 0;
 }
@@ -779,53 +861,101 @@ Config::_loadFile(const char* fname)
 int
 Config::save()
 {
-	std::fstream config;
-	std::map<std::string, int>::iterator int_i;
-	std::map<std::string, double>::iterator dbl_i;
-	std::map<std::string, std::string>::iterator str_i;
-	std::string configFile = _dir + "/" + cfgFile;
-	char buf[4096];
+	std::string text = _format();
+
+	if(_saveDelayMs <= 0)
+	{
+		std::lock_guard<std::mutex> fileLock(_fileMutex);
+
+		return _writeFile(text);
+	}
+
+	std::lock_guard<std::mutex> lock(_saveMutex);
+
+	_pendingText.swap(text);
+	_pending = true;
+	_saveDue = std::chrono::steady_clock::now() + std::chrono::milliseconds(_saveDelayMs);
 
-	// set the exception handling to catch i/o errors
-	config.exceptions(std::ios::failbit | std::ios::badbit);
+	if(!_writer.joinable())
+	{
+		_writer = std::thread(&Config::_writerLoop, this);
+	}
+	_saveCond.notify_one();
+
+	return 0;
+}
 
-	try
+void
+Config::setSaveDelay(int ms)
+{
+	if(ms <= 0)
 	{
-		// open the file, truncate and for write
-		config.open(configFile.c_str(), std::ios::out | std::ios::trunc);
+		flush();
+	}
+	std::lock_guard<std::mutex> lock(_saveMutex);
 
-		// write a warning
-		strcpy(buf, "# Auto-generated\n# SDL keysyms defined in /usr/include/SDL/SDL_keysym.h\n# getSDLKey can be found \
-            in the source directory and can assist in remapping hotkeys\n#\n");
-		config.write(buf, strlen(buf));
+	_saveDelayMs = ms;
+}
+
+int
+Config::flush()
+{
+	std::lock_guard<std::mutex> fileLock(_fileMutex);
+	std::string text;
+
+	{
+		std::lock_guard<std::mutex> lock(_saveMutex);
 
-		// write each configuration setting
-		for(int_i = _intOptMap.begin(); int_i != _intOptMap.end(); int_i++) 
+		if(!_pending)
 		{
-			snprintf(buf, sizeof(buf), "%s = %d\n",
-				int_i->first.c_str(), int_i->second);
-			config.write(buf, strlen(buf));
+			return 0;
 		}
-		for(dbl_i = _dblOptMap.begin(); dbl_i != _dblOptMap.end(); dbl_i++) 
+		text.swap(_pendingText);
+		_pending = false;
+	}
+	return _writeFile(text);
+}
+
+/**
+ * Background writer, waits until no save() came for the save delay
+ * and writes the last one.
+ */
+void
+Config::_writerLoop()
+{
+	std::unique_lock<std::mutex> lock(_saveMutex);
+
+	while(!_quit)
+	{
+		if(!_pending)
 		{
-			snprintf(buf, sizeof(buf), "%s = %f\n",
-				dbl_i->first.c_str(), dbl_i->second);
-			config.write(buf, strlen(buf));
+			_saveCond.wait(lock);
+			continue;
 		}
-		for(str_i = _strOptMap.begin(); str_i != _strOptMap.end(); str_i++) 
+		if(std::chrono::steady_clock::now() < _saveDue)
 		{
-			snprintf(buf, sizeof(buf), "%s = %s\n",
-				str_i->first.c_str(), str_i->second.c_str());
-			config.write(buf, strlen(buf));
+			_saveCond.wait_until(lock, _saveDue);
+			continue;
 		}
 
-		// close the file
-		config.close();
-	} catch(std::fstream::failure &e)
-	{
-		std::cerr << e.what() << std::endl;
-		return -1;
+		// flush() takes _fileMutex before _saveMutex
+		lock.unlock();
+		flush();
+		lock.lock();
 	}
+}
 
-	return 0;
+Config::~Config()
+{
+	{
+		std::lock_guard<std::mutex> lock(_saveMutex);
+
+		_quit = true;
+		_saveCond.notify_one();
+	}
+	if(_writer.joinable())
+	{
+		_writer.join();
+	}
+	flush();
 }
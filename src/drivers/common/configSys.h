@@ -3,6 +3,10 @@
 
 #include <map>
 #include <string>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 #ifdef __QT_DRIVER__
 #include <QString>
@@ -20,12 +24,27 @@ private:
     std::map<char, std::string>        _shortArgMap;
     std::map<std::string, std::string> _longArgMap;
 
+    // deferred saves, see setSaveDelay()
+    int _saveDelayMs;
+    std::thread _writer;
+    std::mutex _fileMutex;      // held while the file is written
+    std::mutex _saveMutex;      // guards the fields below
+    std::condition_variable _saveCond;
+    std::string _pendingText;
+    bool _pending;
+    bool _quit;
+    std::chrono::steady_clock::time_point _saveDue;
+    std::string _savedText;     // last text written, under _fileMutex
+
 private:
     int _addOption(char, const std::string &, const std::string &, int);
     int _addOption(const std::string &, const std::string &, int);
     int _load(void);
 	int _loadFile(const char* fname);
     int _parseArgs(int, char **);
+    std::string _format(void) const;
+    int _writeFile(const std::string &);
+    void _writerLoop(void);
 
 public:
     const static int STRING   = 1;
@@ -34,8 +53,8 @@ public:
     const static int FUNCTION = 4;
 
 public:
-    Config(std::string d) : _dir(d) { }
-    ~Config() { }
+    Config(std::string d) : _dir(d), _saveDelayMs(0), _pending(false), _quit(false) { }
+    ~Config();
 
     /**
      * Adds a configuration option.  All options must be added before
@@ -98,9 +117,21 @@ public:
 
     /**
      * Save all of the current configuration options to the
-     * configuration file.
+     * configuration file.  With a save delay set, the options are
+     * only copied and a background thread writes them once no
+     * save() has come for that long.
      */
     int save();
+
+    /**
+     * Sets the save delay in milliseconds, 0 to write in save().
+     */
+    void setSaveDelay(int ms);
+
+    /**
+     * Writes a deferred save now.  Also done on destruction.
+     */
+    int flush();
 };
 
 #endif // !__CONFIGSYS_H
@@ -1,6 +1,9 @@
 // os_util.cpp
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
 
 #if defined(WIN32)
 #include <windows.h>
@@ -10,6 +13,9 @@
 #include <errno.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
 #endif
 
 #include "common/os_utils.h"
@@ -99,3 +105,230 @@ int msleep( int ms )
 	return ret;
 }
 //************************************************************
+// Parses "0-3,8" into CPU numbers
+static bool parseCpuList( const char *list, std::vector<int> &cpus )
+{
+	const char *p = list;
+
+	while (*p)
+	{
+		char *end;
+		long first = strtol( p, &end, 10 );
+		long last  = first;
+
+		if ( (end == p) || (first < 0) )
+		{
+			return false;
+		}
+		p = end;
+
+		if (*p == '-')
+		{
+			last = strtol( p+1, &end, 10 );
+
+			if ( (end == p+1) || (last < first) || (last - first >= 4096) )
+			{
+				return false;
+			}
+			p = end;
+		}
+		for (long c=first; c<=last; c++)
+		{
+			cpus.push_back( static_cast<int>(c) );
+		}
+		while ( (*p == ' ') || (*p == '\n') )
+		{
+			p++;
+		}
+		if (*p == ',')
+		{
+			p++;
+		}
+		else if (*p)
+		{
+			return false;
+		}
+	}
+	return !cpus.empty();
+}
+//************************************************************
+static bool parseCpuSpec( const char *spec, std::vector<int> &cpus )
+{
+	if (strncmp( spec, "node", 4 ) != 0)
+	{
+		return parseCpuList( spec, cpus );
+	}
+#if defined(__linux__)
+	char path[128], list[1024];
+	FILE *fp;
+
+	snprintf( path, sizeof(path), "/sys/devices/system/node/node%s/cpulist", spec + 4 );
+
+	fp = ::fopen( path, "r" );
+
+	if (fp == NULL)
+	{
+		return false;
+	}
+	if (fgets( list, sizeof(list), fp ) == NULL)
+	{
+		list[0] = 0;
+	}
+	::fclose(fp);
+
+	return parseCpuList( list, cpus );
+#else
+	return false;
+#endif
+}
+//************************************************************
+int fceu_set_thread_affinity( const char *cpus )
+{
+	std::vector<int> list;
+
+	if ( (cpus == NULL) || (cpus[0] == 0) )
+	{
+		return 0;
+	}
+	if ( !parseCpuSpec( cpus, list ) )
+	{
+		fprintf( stderr, "Invalid CPU list '%s'\n", cpus );
+		return -1;
+	}
+#if defined(WIN32)
+	DWORD_PTR mask = 0;
+
+	for (size_t i=0; i<list.size(); i++)
+	{
+		if (list[i] < (int)(sizeof(mask) * 8))
+		{
+			mask |= ((DWORD_PTR)1) << list[i];
+		}
+	}
+	if ( (mask == 0) || (SetThreadAffinityMask( GetCurrentThread(), mask ) == 0) )
+	{
+		fprintf( stderr, "SetThreadAffinityMask '%s' failed\n", cpus );
+		return -1;
+	}
+	return 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+
+	for (size_t i=0; i<list.size(); i++)
+	{
+		if (list[i] < CPU_SETSIZE)
+		{
+			CPU_SET( list[i], &set );
+		}
+	}
+	int err = pthread_setaffinity_np( pthread_self(), sizeof(set), &set );
+
+	if (err)
+	{
+		fprintf( stderr, "pthread_setaffinity_np '%s' failed: %s\n", cpus, strerror(err) );
+		return -1;
+	}
+	return 0;
+#else
+	// macOS only takes affinity hints between threads, not CPU numbers
+	fprintf( stderr, "Thread CPU affinity is not supported on this system\n" );
+	return -1;
+#endif
+}
+//************************************************************
+int fceu_set_thread_sched( int policy, int priority )
+{
+#if defined(WIN32)
+	// No policies, the closest is the highest thread priority
+	if (policy != 0)
+	{
+		SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL );
+	}
+	return 0;
+#else
+	struct sched_param p;
+	int minPrio = sched_get_priority_min( policy );
+	int maxPrio = sched_get_priority_max( policy );
+
+	if (priority < minPrio)
+	{
+		priority = minPrio;
+	}
+	else if (priority > maxPrio)
+	{
+		priority = maxPrio;
+	}
+	memset( &p, 0, sizeof(p) );
+	p.sched_priority = priority;
+
+	int err = pthread_setschedparam( pthread_self(), policy, &p );
+
+	if (err)
+	{
+		fprintf( stderr, "pthread_setschedparam failed: %s\n", strerror(err) );
+		return -1;
+	}
+	return 0;
+#endif
+}
+//************************************************************
+#if defined(WIN32)
+static double fileTimeSeconds( const FILETIME &t )
+{
+	ULARGE_INTEGER u;
+
+	u.LowPart  = t.dwLowDateTime;
+	u.HighPart = t.dwHighDateTime;
+
+	return (double)u.QuadPart * 1.0e-7;
+}
+#endif
+//************************************************************
+double fceu_thread_cpu_seconds(void)
+{
+#if defined(WIN32)
+	FILETIME creation, exit, kernel, user;
+
+	if ( !GetThreadTimes( GetCurrentThread(), &creation, &exit, &kernel, &user ) )
+	{
+		return -1.0;
+	}
+	return fileTimeSeconds(kernel) + fileTimeSeconds(user);
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
+
+	if ( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) != 0 )
+	{
+		return -1.0;
+	}
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+#else
+	return -1.0;
+#endif
+}
+//************************************************************
+double fceu_process_cpu_seconds(void)
+{
+#if defined(WIN32)
+	FILETIME creation, exit, kernel, user;
+
+	if ( !GetProcessTimes( GetCurrentProcess(), &creation, &exit, &kernel, &user ) )
+	{
+		return -1.0;
+	}
+	return fileTimeSeconds(kernel) + fileTimeSeconds(user);
+#elif defined(CLOCK_PROCESS_CPUTIME_ID)
+	struct timespec ts;
+
+	if ( clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &ts ) != 0 )
+	{
+		return -1.0;
+	}
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+#else
+	return -1.0;
+#endif
+}
+//************************************************************
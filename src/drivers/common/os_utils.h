@@ -8,3 +8,17 @@ int fceu_mkpath( const char *path );
 bool fceu_file_exists( const char *filepath );
 
 int msleep( int ms );
+
+// Pins the calling thread to a list of CPUs such as "3" or "0-3,8", or to
+// the CPUs of a NUMA node with "node1" (Linux). An empty list does nothing.
+int fceu_set_thread_affinity( const char *cpus );
+
+// Scheduling policy (SCHED_FIFO, SCHED_RR, ...) of the calling thread; most
+// systems only allow real-time policies to privileged users.
+int fceu_set_thread_sched( int policy, int priority );
+
+// CPU time, user and system, used by the calling thread and by the whole
+// process so far, in seconds; negative where the system can not tell.
+double fceu_thread_cpu_seconds(void);
+
+double fceu_process_cpu_seconds(void);
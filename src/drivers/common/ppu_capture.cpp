@@ -0,0 +1,183 @@
+// ppu_capture.cpp
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../git.h"
+#include "../../cart.h"
+#include "../../ppu.h"
+#include "../../ines.h"
+#include "../../debug.h"
+#include "common/ppu_capture.h"
+
+//************************************************************
+PPUCapture::PPUCapture(void)
+{
+	memset( buf, 0, sizeof(buf) );
+	memset( lastChr, 0, sizeof(lastChr) );
+	memset( lastLog, 0, sizeof(lastLog) );
+	memset( version, 0, sizeof(version) );
+
+	back  = 0;
+	ready = 1;
+	front = 2;
+	readyNew = false;
+	seq = 0;
+}
+//************************************************************
+static int8_t ntPageIndex( const uint8_t *table )
+{
+	if ( table == &NTARAM[0x000] ) return 0;
+	if ( table == &NTARAM[0x400] ) return 1;
+
+	if ( ExtraNTARAM != NULL )
+	{
+		if ( table == ExtraNTARAM )         return 2;
+		if ( table == ExtraNTARAM + 0x400 ) return 3;
+	}
+	return -1;
+}
+//************************************************************
+void PPUCapture::capture( bool nameTables )
+{
+	PPUCaptureFrame &f = buf[back];
+
+	for (int i = 0; i < 8; i++)
+	{
+		uint32_t addr = i << 10;
+		const uint8_t *src;
+
+		if ( VPage[i] == NULL )
+		{
+			memset( f.chr[i], 0, 0x400 );
+			memset( f.chrLog[i], 0, 0x400 );
+		}
+		else
+		{
+			// the name tables draw from the MMC5 background banks
+			src = nameTables ? FCEUPPU_GetCHR( addr, 0 ) : &VPage[i][addr];
+
+			memcpy( f.chr[i], src, 0x400 );
+
+			memset( f.chrLog[i], 0, 0x400 );
+
+			if ( debug_loggingCD && (cdloggervdata != NULL) )
+			{
+				if ( cdloggerVideoDataSize )
+				{
+					ptrdiff_t ofs = src - CHRptr[0];
+
+					if ( (ofs >= 0) && (ofs + 0x400 <= (ptrdiff_t)cdloggerVideoDataSize) )
+					{
+						memcpy( f.chrLog[i], &cdloggervdata[ofs], 0x400 );
+					}
+				}
+				else
+				{
+					memcpy( f.chrLog[i], &cdloggervdata[addr], 0x400 );
+				}
+			}
+		}
+
+		if ( (memcmp( f.chr[i], lastChr[i], 0x400 ) != 0) ||
+		     (memcmp( f.chrLog[i], lastLog[i], 0x400 ) != 0) )
+		{
+			memcpy( lastChr[i], f.chr[i], 0x400 );
+			memcpy( lastLog[i], f.chrLog[i], 0x400 );
+			version[i]++;
+		}
+		f.chrVersion[i] = version[i];
+	}
+
+	f.exMode = false;
+
+	if ( nameTables )
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			const uint8_t *table = vnapage[i];
+
+			if ( table == NULL )
+			{
+				table = vnapage[i & 1];
+			}
+			if ( (table == NULL) || (GameInfo == NULL) || (GameInfo->type == GIT_NSF) )
+			{
+				memset( f.nt[i], 0, 0x400 );
+				f.ntPage[i] = -1;
+				continue;
+			}
+			memcpy( f.nt[i], table, 0x400 );
+
+			f.ntPage[i] = ntPageIndex( vnapage[i] );
+
+			for (int j = 0; (j <= i) && (f.ntPage[i] < 0); j++)
+			{
+				if ( vnapage[j] == vnapage[i] )
+				{
+					f.ntPage[i] = 4 + j;
+				}
+			}
+		}
+
+		// tiles here are picked per screen position from the whole CHR ROM,
+		// so they are resolved now
+		if ( MMC5Hack && (MMC5HackCHRMode == 1) && (MMC5HackExNTARAMPtr != NULL) )
+		{
+			uint32_t ptable = (PPU[0] & 0x10) ? 0x1000 : 0x0000;
+
+			f.exMode = true;
+
+			for (int t = 0; t < 960; t++)
+			{
+				f.exAttr[t] = (MMC5HackExNTARAMPtr[t] & 0xC0) >> 6;
+
+				for (int i = 0; i < 4; i++)
+				{
+					memcpy( f.exChr[i][t], FCEUPPU_GetCHR( ptable + f.nt[i][t] * 16, t ), 16 );
+				}
+			}
+		}
+		ppu_getScroll( f.xScroll, f.yScroll );
+	}
+
+	memcpy( f.pal, PALRAM, sizeof(f.pal) );
+	memcpy( f.upal, UPALRAM, sizeof(f.upal) );
+	memcpy( f.oam, SPRAM, sizeof(f.oam) );
+
+	f.ctrl = PPU[0];
+	f.seq  = ++seq;
+
+	FCEU::autoScopedLock lock(mtx);
+
+	int tmp = ready;
+
+	ready = back;
+	back  = tmp;
+
+	readyNew = true;
+}
+//************************************************************
+const PPUCaptureFrame *PPUCapture::acquire( bool *isNew )
+{
+	FCEU::autoScopedLock lock(mtx);
+
+	if ( isNew )
+	{
+		*isNew = readyNew;
+	}
+	if ( readyNew )
+	{
+		int tmp = front;
+
+		front = ready;
+		ready = tmp;
+
+		readyNew = false;
+	}
+	return &buf[front];
+}
+//************************************************************
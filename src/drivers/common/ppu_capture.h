@@ -0,0 +1,81 @@
+// ppu_capture.h
+//
+// Raw PPU memory for the PPU and Name Table viewers. At the viewer's scan
+// line the emulator copies the pattern tables, name tables, palette and OAM
+// as they are mapped at that moment into a capture frame, and does nothing
+// else; turning that into pixels is up to the GUI thread.
+//
+// Frames go through three buffers: the one being written, the newest one
+// published and the one the GUI is reading. Publishing and picking up swap
+// two of them under a lock, so neither side ever waits for the other to
+// finish with a frame.
+//
+// Each 1KB CHR page has a version that changes whenever its bytes, or its
+// code/data logger flags, differ from the last capture, so a viewer only
+// decodes the tiles of pages that changed.
+//
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "utils/mutex.h"
+
+struct PPUCaptureFrame
+{
+	uint8_t  chr[8][0x400];     // $0000-$1FFF as the CHR banks map it
+	uint8_t  chrLog[8][0x400];  // code/data logger flags of those bytes
+	uint32_t chrVersion[8];
+
+	uint8_t  nt[4][0x400];      // $2000-$2FFF, attribute tables included
+	// Where each name table lives: 0,1 the console RAM halves, 2,3 the
+	// cart RAM halves, 4+n the same memory as name table n, -1 none. Two
+	// tables share memory when their entries are equal.
+	int8_t   ntPage[4];
+
+	// MMC5 extended attribute mode, tiles and attributes come from ex RAM
+	bool     exMode;
+	uint8_t  exAttr[960];
+	uint8_t  exChr[4][960][16];
+
+	uint8_t  pal[32];           // PALRAM
+	uint8_t  upal[3];           // UPALRAM
+	uint8_t  oam[256];
+	uint8_t  ctrl;              // $2000
+
+	int      xScroll;
+	int      yScroll;
+
+	uint32_t seq;               // 0 until the first capture
+};
+
+class PPUCapture
+{
+	public:
+		PPUCapture(void);
+
+		// Emulator thread, or any thread holding the emulator lock: copies
+		// the PPU memory and publishes it. The name tables are only copied
+		// when asked for.
+		void capture( bool nameTables );
+
+		// GUI thread: the newest frame published, which stays valid until
+		// the next call. isNew tells whether it changed since the last call.
+		const PPUCaptureFrame *acquire( bool *isNew = NULL );
+
+	private:
+		PPUCaptureFrame buf[3];
+
+		int  back;
+		int  ready;
+		int  front;
+		bool readyNew;
+
+		// what the versions are compared against, only seen by the writer
+		uint8_t  lastChr[8][0x400];
+		uint8_t  lastLog[8][0x400];
+		uint32_t version[8];
+		uint32_t seq;
+
+		FCEU::mutex mtx;
+};
@@ -0,0 +1,451 @@
+// ram_search.cpp
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drivers/common/ram_search.h"
+
+#define BLOCK_SIZE  64
+
+static inline int lowestBit( uint64_t w )
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(w);
+#else
+	int n = 0;
+
+	while ( !(w & 1) )
+	{
+		w >>= 1; n++;
+	}
+	return n;
+#endif
+}
+
+// basic comparison kernels, unpredictable results must not branch
+struct LessCmp      { bool operator()( int64_t x, int64_t y, int64_t p ) const { return x < y; } };
+struct MoreCmp      { bool operator()( int64_t x, int64_t y, int64_t p ) const { return x > y; } };
+struct LessEqualCmp { bool operator()( int64_t x, int64_t y, int64_t p ) const { return x <= y; } };
+struct MoreEqualCmp { bool operator()( int64_t x, int64_t y, int64_t p ) const { return x >= y; } };
+struct EqualCmp     { bool operator()( int64_t x, int64_t y, int64_t p ) const { return x == y; } };
+struct UnequalCmp   { bool operator()( int64_t x, int64_t y, int64_t p ) const { return x != y; } };
+struct StepCmp      { bool operator()( int64_t x, int64_t y, int64_t p ) const { return x - y == p; } };
+struct DiffByCmp    { bool operator()( int64_t x, int64_t y, int64_t p ) const { return (x - y == p) | (y - x == p); } };
+struct ModIsCmp     { bool operator()( int64_t x, int64_t y, int64_t p ) const { return p && x % p == y; } };
+
+//************************************************************
+RamSearchEngine::RamSearchEngine(void)
+{
+	valSize   = 1;
+	valSigned = false;
+	maxAddr   = 0x8000;
+
+	bits.assign( memSize / 64, 0 );
+
+	// room for a 4 byte load from the last address
+	cur.assign( memSize + 4, 0 );
+	last.assign( memSize + 4, 0 );
+	prev.assign( memSize + 4, 0 );
+	chg.assign( memSize, 0 );
+
+	memset( &frame, 0, sizeof(frame) );
+	frameActive  = false;
+	frameHistory = false;
+	frameCount   = 0;
+}
+//************************************************************
+void RamSearchEngine::setFormat( int size, bool isSigned, int max )
+{
+	valSize   = (size == 4) ? 4 : (size == 2) ? 2 : 1;
+	valSigned = isSigned;
+	maxAddr   = (max > memSize) ? memSize : max;
+}
+//************************************************************
+inline int64_t RamSearchEngine::load( const uint8_t *buf, uint32_t addr )
+{
+	uint32_t v;
+
+	if ( (int)(addr + valSize) <= maxAddr )
+	{
+		switch ( valSize )
+		{
+			case 4:
+				v = (buf[addr] << 24) | (buf[addr+1] << 16) | (buf[addr+2] << 8) | buf[addr+3];
+			break;
+			case 2:
+				v = (buf[addr] << 8) | buf[addr+1];
+			break;
+			default:
+				v = buf[addr];
+			break;
+		}
+	}
+	else
+	{
+		v = 0;
+
+		for (int i = 0; (i < valSize) && ((int)addr < maxAddr); i++)
+		{
+			v = (v << 8) | buf[addr++];
+		}
+	}
+
+	if ( valSigned )
+	{
+		switch ( valSize )
+		{
+			case 4:  return (int32_t)v;
+			case 2:  return (int16_t)v;
+			default: return (int8_t)v;
+		}
+	}
+	return v;
+}
+//************************************************************
+int64_t RamSearchEngine::value( int addr )
+{
+	return load( cur.data(), addr );
+}
+//************************************************************
+int64_t RamSearchEngine::previous( int addr )
+{
+	return load( prev.data(), addr );
+}
+//************************************************************
+void RamSearchEngine::reset( const uint8_t *mem )
+{
+	memcpy( cur.data(), mem, memSize );
+	memcpy( last.data(), mem, memSize );
+	memcpy( prev.data(), mem, memSize );
+
+	memset( chg.data(), 0, chg.size() * sizeof(uint32_t) );
+
+	undoStack.clear();
+
+	frameActive = false;
+}
+//************************************************************
+void RamSearchEngine::setCandidates( const int *start, const int *end, int numRegions, int step )
+{
+	memset( bits.data(), 0, bits.size() * sizeof(uint64_t) );
+
+	if ( step < 1 )
+	{
+		step = 1;
+	}
+
+	for (int i = 0; i < numRegions; i++)
+	{
+		for (int addr = start[i]; addr + valSize <= end[i]; addr += step)
+		{
+			bits[addr >> 6] |= (uint64_t)1 << (addr & 63);
+		}
+	}
+	rebuildCandidates();
+}
+//************************************************************
+void RamSearchEngine::rebuildCandidates(void)
+{
+	cand.clear();
+
+	for (size_t w = 0; w < bits.size(); w++)
+	{
+		uint64_t m = bits[w];
+
+		while ( m )
+		{
+			cand.push_back( (w << 6) | lowestBit(m) );
+
+			m &= m - 1;
+		}
+	}
+}
+//************************************************************
+void RamSearchEngine::update( const uint8_t *mem )
+{
+	int64_t x[BLOCK_SIZE], y[BLOCK_SIZE];
+
+	cur.swap( last );
+
+	memcpy( cur.data(), mem, memSize );
+
+	for (size_t i = 0; i < cand.size(); i += BLOCK_SIZE)
+	{
+		const uint16_t *a = &cand[i];
+		size_t num = cand.size() - i;
+
+		if ( num > BLOCK_SIZE )
+		{
+			num = BLOCK_SIZE;
+		}
+		for (size_t j = 0; j < num; j++)
+		{
+			x[j] = load( cur.data(), a[j] );
+			y[j] = load( last.data(), a[j] );
+		}
+		for (size_t j = 0; j < num; j++)
+		{
+			chg[ a[j] ] += (x[j] != y[j]);
+		}
+	}
+}
+//************************************************************
+void RamSearchEngine::fetch( int kind, const uint16_t *a, size_t num, int64_t *x, int64_t *y, int64_t val )
+{
+	size_t j;
+
+	switch ( kind )
+	{
+		case PREVIOUS_VALUE:
+			for (j = 0; j < num; j++)
+			{
+				x[j] = load( cur.data(), a[j] );
+				y[j] = load( prev.data(), a[j] );
+			}
+		break;
+		case SPECIFIC_VALUE:
+			for (j = 0; j < num; j++)
+			{
+				x[j] = load( cur.data(), a[j] );
+				y[j] = val;
+			}
+		break;
+		case SPECIFIC_ADDRESS:
+			for (j = 0; j < num; j++)
+			{
+				x[j] = a[j];
+				y[j] = val;
+			}
+		break;
+		case NUMBER_OF_CHANGES:
+			for (j = 0; j < num; j++)
+			{
+				x[j] = chg[ a[j] ];
+				y[j] = val;
+			}
+		break;
+		case LAST_FRAME:
+			for (j = 0; j < num; j++)
+			{
+				x[j] = load( cur.data(), a[j] );
+				y[j] = load( last.data(), a[j] );
+			}
+		break;
+		case STORED_VALUE:
+			for (j = 0; j < num; j++)
+			{
+				x[j] = load( prev.data(), a[j] );
+				y[j] = val;
+			}
+		break;
+	}
+}
+//************************************************************
+template <class Cmp>
+void RamSearchEngine::filter( Cmp cmp, int kind, int64_t y, int64_t p, uint64_t *elim )
+{
+	int64_t xv[BLOCK_SIZE], yv[BLOCK_SIZE];
+	size_t out = 0;
+
+	for (size_t i = 0; i < cand.size(); i += BLOCK_SIZE)
+	{
+		uint16_t *a = &cand[i];
+		size_t num = cand.size() - i;
+		uint64_t keep = 0, gone;
+
+		if ( num > BLOCK_SIZE )
+		{
+			num = BLOCK_SIZE;
+		}
+		fetch( kind, a, num, xv, yv, y );
+
+		for (size_t j = 0; j < num; j++)
+		{
+			keep |= (uint64_t)cmp( xv[j], yv[j], p ) << j;
+		}
+		gone = ~keep;
+
+		if ( num < BLOCK_SIZE )
+		{
+			gone &= ((uint64_t)1 << num) - 1;
+		}
+
+		while ( gone )
+		{
+			int addr = a[ lowestBit(gone) ];
+			uint64_t bit = (uint64_t)1 << (addr & 63);
+
+			bits[addr >> 6] &= ~bit;
+
+			if ( elim )
+			{
+				elim[addr >> 6] |= bit;
+			}
+			gone &= gone - 1;
+		}
+
+		// compact the survivors, out never passes i + j
+		for (size_t j = 0; j < num; j++)
+		{
+			cand[out] = a[j];
+			out += (keep >> j) & 1;
+		}
+	}
+	cand.resize( out );
+}
+//************************************************************
+bool RamSearchEngine::apply( int kind, int op, int64_t y, int64_t p, uint64_t *elim )
+{
+	switch ( op )
+	{
+		case '<': filter( LessCmp(),      kind, y, p, elim ); break;
+		case '>': filter( MoreCmp(),      kind, y, p, elim ); break;
+		case 'l': filter( LessEqualCmp(), kind, y, p, elim ); break;
+		case 'm': filter( MoreEqualCmp(), kind, y, p, elim ); break;
+		case '=': filter( EqualCmp(),     kind, y, p, elim ); break;
+		case '!': filter( UnequalCmp(),   kind, y, p, elim ); break;
+		case '+': filter( StepCmp(),      kind, y, p, elim ); break;
+		case 'd': filter( DiffByCmp(),    kind, y, p, elim ); break;
+		case '%': filter( ModIsCmp(),     kind, y, p, elim ); break;
+		default:
+			return false;
+	}
+	return true;
+}
+//************************************************************
+size_t RamSearchEngine::search( int kind, int op, int64_t y, int64_t p, bool storeHistory )
+{
+	uint64_t *elim = NULL;
+
+	if ( storeHistory )
+	{
+		undoStack.push_back( step_t() );
+
+		step_t &step = undoStack.back();
+
+		step.elim.assign( bits.size(), 0 );
+		step.prev = prev;
+
+		elim = step.elim.data();
+	}
+
+	if ( !apply( kind, op, y, p, elim ) )
+	{
+		if ( storeHistory )
+		{
+			undoStack.pop_back();
+		}
+		return cand.size();
+	}
+
+	if ( storeHistory )
+	{
+		// the survivors now compare to this frame
+		memcpy( prev.data(), cur.data(), memSize );
+	}
+	return cand.size();
+}
+//************************************************************
+void RamSearchEngine::storeCurrent(void)
+{
+	for (size_t i = 0; i < cand.size(); i++)
+	{
+		memcpy( &prev[ cand[i] ], &cur[ cand[i] ], valSize );
+	}
+}
+//************************************************************
+void RamSearchEngine::beginFrameSearch( const framePredicate_t &pred, bool storeHistory )
+{
+	endFrameSearch();
+
+	frame = pred;
+	frameHistory = storeHistory;
+	frameCount = 0;
+
+	if ( storeHistory )
+	{
+		undoStack.push_back( step_t() );
+
+		step_t &step = undoStack.back();
+
+		step.elim.assign( bits.size(), 0 );
+		step.prev = prev;
+	}
+	frameActive = true;
+}
+//************************************************************
+void RamSearchEngine::endFrameSearch(void)
+{
+	if ( !frameActive )
+	{
+		return;
+	}
+	frameActive = false;
+
+	if ( frameHistory )
+	{
+		memcpy( prev.data(), cur.data(), memSize );
+	}
+}
+//************************************************************
+bool RamSearchEngine::frameSearch( const uint8_t *mem, uint32_t input )
+{
+	int op = frame.op;
+
+	if ( !frameActive )
+	{
+		return false;
+	}
+	update( mem );
+
+	// the first frame only sets the values the next one compares to
+	if ( frameCount > 0 )
+	{
+		if ( frame.inputMask && !(input & frame.inputMask) )
+		{
+			op = frame.idleOp;
+		}
+		if ( op )
+		{
+			apply( LAST_FRAME, op, 0, frame.p, frameHistory ? undoStack.back().elim.data() : NULL );
+		}
+	}
+	frameCount++;
+
+	if ( (frame.numFrames > 0) && (frameCount > frame.numFrames) )
+	{
+		endFrameSearch();
+		return false;
+	}
+	return true;
+}
+//************************************************************
+bool RamSearchEngine::undo(void)
+{
+	endFrameSearch();
+
+	if ( undoStack.empty() )
+	{
+		return false;
+	}
+	step_t &step = undoStack.back();
+
+	for (size_t w = 0; w < bits.size(); w++)
+	{
+		bits[w] |= step.elim[w];
+	}
+	prev.swap( step.prev );
+
+	undoStack.pop_back();
+
+	rebuildCandidates();
+
+	return true;
+}
+//************************************************************
+void RamSearchEngine::clearChangeCounts(void)
+{
+	memset( chg.data(), 0, chg.size() * sizeof(uint32_t) );
+}
+//************************************************************
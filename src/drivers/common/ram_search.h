@@ -0,0 +1,139 @@
+// ram_search.h
+//
+// Candidate set of the RAM search. The addresses still in the search are
+// kept as a sorted array, one entry per address, and every search pass
+// works through it 64 candidates at a time: the values of a block are
+// loaded into x/y arrays, a compare kernel turns them into a 64 bit keep
+// mask and the survivors are compacted to the front of the array.
+//
+// History is kept per search rather than per address. A search that is
+// stored pushes a bitmap of the addresses it eliminated along with the
+// memory snapshot its relative comparisons were made against, so undoing
+// it is an OR of the bitmap into the candidate set and a restore of the
+// snapshot.
+//
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+class RamSearchEngine
+{
+	public:
+		RamSearchEngine(void);
+
+		// What the searches compare
+		enum
+		{
+			PREVIOUS_VALUE = 0, // value against its value at the last stored search
+			SPECIFIC_VALUE,     // value against a constant
+			SPECIFIC_ADDRESS,   // address against a constant
+			NUMBER_OF_CHANGES,  // change count against a constant
+			LAST_FRAME,         // value against its value one update before
+			STORED_VALUE        // value at the last stored search against a constant
+		};
+
+		// Values are size bytes, big end first, signed or not. A value that
+		// would reach past maxAddr is made of the bytes below it only.
+		void setFormat( int size, bool isSigned, int maxAddr );
+
+		// Takes mem as the first snapshot, clears the change counts and
+		// the undo history. The candidates are left to setCandidates().
+		void reset( const uint8_t *mem );
+
+		// Makes every step-th address of the regions [start, end) a
+		// candidate, as long as the value fits in the region.
+		void setCandidates( const int *start, const int *end, int numRegions, int step );
+
+		// New frame of memory, counts the candidates whose value changed
+		void update( const uint8_t *mem );
+
+		// Keeps the candidates for which "x op y" holds, op being one of
+		// the RAM search dialog's '<', '>', 'l', 'm', '=', '!', 'd' (differs
+		// by p), '+' (x - y is p) and '%' (modulo p is y). Stored searches can be undone and
+		// make the current memory the snapshot PREVIOUS_VALUE compares to.
+		// Returns the number of candidates left.
+		size_t search( int kind, int op, int64_t y, int64_t p, bool storeHistory );
+
+		// Frame searches apply a predicate to every frame rather than once:
+		// each frameSearch() call updates the memory and keeps the
+		// candidates for which "value op value of the frame before" holds.
+		// With an input mask, op applies to the frames where any of the
+		// masked buttons is held and idleOp to the others, 0 meaning no
+		// test. The whole run is one undo step.
+		struct framePredicate_t
+		{
+			int      op;
+			int      idleOp;
+			int64_t  p;
+			uint32_t inputMask;
+			int      numFrames;  // 0 to run until endFrameSearch()
+		};
+
+		void beginFrameSearch( const framePredicate_t &pred, bool storeHistory );
+		void endFrameSearch(void);
+
+		// Returns false when the search is not running, or ended because
+		// it went through its frames
+		bool frameSearch( const uint8_t *mem, uint32_t input );
+
+		bool frameSearchActive(void){ return frameActive; }
+		int  frameSearchFrames(void){ return frameCount; }
+
+		// Makes the current values of the candidates the ones
+		// PREVIOUS_VALUE and STORED_VALUE compare to, without an undo step
+		void storeCurrent(void);
+
+		bool undo(void);
+		size_t undoDepth(void){ return undoStack.size(); }
+
+		void clearChangeCounts(void);
+
+		size_t size(void){ return cand.size(); }
+		int address( size_t idx ){ return cand[idx]; }
+
+		int64_t value( int addr );
+		int64_t previous( int addr );
+		uint32_t changes( int addr ){ return chg[addr]; }
+
+		static const int memSize = 0x10000;
+
+	private:
+		struct step_t
+		{
+			std::vector<uint64_t> elim;
+			std::vector<uint8_t>  prev;
+		};
+
+		int64_t load( const uint8_t *buf, uint32_t addr );
+
+		void fetch( int kind, const uint16_t *addr, size_t num, int64_t *x, int64_t *y, int64_t val );
+
+		template <class Cmp>
+		void filter( Cmp cmp, int kind, int64_t y, int64_t p, uint64_t *elim );
+
+		bool apply( int kind, int op, int64_t y, int64_t p, uint64_t *elim );
+
+		void rebuildCandidates(void);
+
+		int  valSize;
+		bool valSigned;
+		int  maxAddr;
+
+		std::vector<uint16_t> cand;  // sorted
+		std::vector<uint64_t> bits;  // candidate bitmap, same set as cand
+
+		std::vector<uint8_t>  cur;   // memory of the last update
+		std::vector<uint8_t>  last;  // memory of the update before
+		std::vector<uint8_t>  prev;  // memory of the last stored search
+		std::vector<uint32_t> chg;
+
+		std::vector<step_t> undoStack;
+
+		framePredicate_t frame;
+		bool frameActive;
+		bool frameHistory;
+		int  frameCount;
+};
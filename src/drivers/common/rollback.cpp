@@ -0,0 +1,193 @@
+// rollback.cpp
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../types.h"
+#include "../../state.h"
+#include "common/rollback.h"
+
+//************************************************************
+NetPlayRollback::NetPlayRollback( int maxFrames )
+{
+	setMaxFrames( maxFrames );
+}
+//************************************************************
+void NetPlayRollback::reset(void)
+{
+	head = 0;
+	count = 0;
+	confirmedCount = 0;
+	firstBad = -1;
+	inRollback = false;
+
+	memset( last, 0, sizeof(last) );
+	memset( cur, 0, sizeof(cur) );
+	memset( &stat, 0, sizeof(stat) );
+}
+//************************************************************
+void NetPlayRollback::setMaxFrames( int maxFrames )
+{
+	reset();
+
+	ring.resize( (maxFrames > 0) ? maxFrames : 0 );
+}
+//************************************************************
+void NetPlayRollback::predict( const uint8_t local[4], uint8_t localMask, uint8_t out[4] )
+{
+	for (int i = 0; i < 4; i++)
+	{
+		out[i] = (localMask & (1 << i)) ? local[i] : last[i];
+	}
+}
+//************************************************************
+bool NetPlayRollback::save( frame_t &f )
+{
+	size_t size = FCEUSS_SnapshotSize();
+
+	if ( size == 0 )
+	{
+		return false;
+	}
+	if ( f.state.size() != size )
+	{
+		f.state.resize( size );
+	}
+	return FCEUSS_Snapshot( f.state.data(), size );
+}
+//************************************************************
+bool NetPlayRollback::push( uint32_t frame, const uint8_t joy[4], uint8_t localMask, uint32_t aux )
+{
+	if ( !canPredict() )
+	{
+		return false;
+	}
+	frame_t &f = at( count );
+
+	if ( !save( f ) )
+	{
+		return false;
+	}
+	f.frame = frame;
+	f.aux = aux;
+	f.localMask = localMask;
+	memcpy( f.joy, joy, sizeof(f.joy) );
+
+	memcpy( cur, joy, sizeof(cur) );
+
+	count++;
+	stat.predicted++;
+
+	return true;
+}
+//************************************************************
+void NetPlayRollback::dropSettled(void)
+{
+	// confirmed frames are only kept while a rollback may start at or
+	// before them
+	int n = (firstBad >= 0) ? firstBad : confirmedCount;
+
+	head = (head + n) % ring.size();
+	count -= n;
+	confirmedCount -= n;
+
+	if ( firstBad >= 0 )
+	{
+		firstBad -= n;
+	}
+}
+//************************************************************
+bool NetPlayRollback::confirm( const uint8_t joy[4] )
+{
+	bool ok;
+
+	memcpy( last, joy, sizeof(last) );
+
+	if ( pending() == 0 )
+	{
+		return true;
+	}
+	frame_t &f = at( confirmedCount );
+
+	ok = memcmp( f.joy, joy, sizeof(f.joy) ) == 0;
+
+	if ( !ok )
+	{
+		memcpy( f.joy, joy, sizeof(f.joy) );
+
+		if ( firstBad < 0 )
+		{
+			firstBad = confirmedCount;
+		}
+		stat.mispredicted++;
+	}
+	confirmedCount++;
+
+	if ( firstBad >= 0 )
+	{
+		// the frames still pending are run again anyway, on a prediction
+		// from the newer input
+		for (int i = confirmedCount; i < count; i++)
+		{
+			frame_t &p = at( i );
+
+			predict( p.joy, p.localMask, p.joy );
+		}
+	}
+	dropSettled();
+
+	return ok;
+}
+//************************************************************
+int NetPlayRollback::rollback( uint32_t (*runFrame)( uint32_t aux, void *userData ), void *userData )
+{
+	uint32_t aux;
+	int n = 0;
+
+	if ( firstBad < 0 )
+	{
+		return 0;
+	}
+	frame_t &f = at( firstBad );
+
+	if ( !FCEUSS_Restore( f.state.data(), f.state.size() ) )
+	{
+		// nothing to go back to, the confirmed input only applies from here
+		firstBad = -1;
+		dropSettled();
+		return 0;
+	}
+	inRollback = true;
+
+	aux = f.aux;
+
+	for (int i = firstBad; i < count; i++)
+	{
+		frame_t &r = at( i );
+
+		if ( i > firstBad )
+		{
+			save( r );
+			r.aux = aux;
+		}
+		memcpy( cur, r.joy, sizeof(cur) );
+
+		aux = runFrame( aux, userData );
+		n++;
+	}
+	inRollback = false;
+
+	firstBad = -1;
+	dropSettled();
+
+	stat.rollbacks++;
+	stat.resimulated += n;
+
+	if ( (uint32_t)n > stat.maxDepth )
+	{
+		stat.maxDepth = n;
+	}
+	return n;
+}
+//************************************************************
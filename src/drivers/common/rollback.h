@@ -0,0 +1,109 @@
+// rollback.h
+//
+// Speculative execution for NetPlay. Instead of waiting for the host's input
+// of a frame, the frame is run on a prediction: the ports of the local
+// player take the local buttons, the others hold what they held in the last
+// confirmed frame. The state the frame starts from is kept, as a flat
+// snapshot, in a ring of at most maxFrames entries.
+//
+// Confirmed inputs arrive in order and each one settles the oldest frame
+// still run on a prediction. A frame that was predicted right is dropped
+// from the ring, one that was not is corrected and rollback() restores its
+// snapshot and runs it and every frame after it again before the next frame
+// is emulated.
+//
+// Along with the state each frame carries an aux word of the caller's, for
+// state of its own that has to travel with the emulator's (the NetPlay ops
+// checksum).
+//
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+class NetPlayRollback
+{
+	public:
+		NetPlayRollback( int maxFrames = 8 );
+
+		// Drops every frame run on a prediction, and the last confirmed input
+		void reset(void);
+
+		// 0 turns speculation off, beyond maxFrames the caller has to wait
+		void setMaxFrames( int maxFrames );
+		int  maxFrames(void){ return (int)ring.size(); }
+
+		bool enabled(void){ return !ring.empty(); }
+
+		// Frames run on a prediction and not confirmed yet
+		int  pending(void){ return count - confirmedCount; }
+
+		bool canPredict(void){ return count < (int)ring.size(); }
+
+		// Input of the next frame on a prediction, localMask has a bit set
+		// for each port the local player owns
+		void predict( const uint8_t local[4], uint8_t localMask, uint8_t out[4] );
+
+		// Keeps the state the next frame starts from and makes joy the input
+		// it runs on. localMask as for predict(), the other ports are the
+		// ones a late prediction may still be revised for.
+		bool push( uint32_t frame, const uint8_t joy[4], uint8_t localMask, uint32_t aux );
+
+		// Input of a frame the host confirmed. With frames pending it
+		// settles the oldest of them and returns false if it was mispredicted.
+		bool confirm( const uint8_t joy[4] );
+
+		bool needsRollback(void){ return firstBad >= 0; }
+
+		// Restores the first mispredicted frame and runs it and the frames
+		// after it again. runFrame runs one frame on input(), starting from
+		// the aux word it is given and returning the one the next frame
+		// starts from. Returns the number of frames run.
+		int  rollback( uint32_t (*runFrame)( uint32_t aux, void *userData ), void *userData );
+
+		// Input of the frame being run, valid after push() and in rollback()
+		const uint8_t *input(void){ return cur; }
+
+		bool resimulating(void){ return inRollback; }
+
+		struct stats_t
+		{
+			uint32_t predicted;     // frames run on a prediction
+			uint32_t mispredicted;  // of those, confirmed with other inputs
+			uint32_t rollbacks;
+			uint32_t resimulated;   // frames run again
+			uint32_t maxDepth;      // longest rollback, in frames
+		};
+
+		const stats_t &stats(void){ return stat; }
+
+	private:
+		struct frame_t
+		{
+			uint32_t frame;
+			uint32_t aux;
+			uint8_t  joy[4];
+			uint8_t  localMask;
+			std::vector<uint8_t> state;
+		};
+
+		frame_t &at( int i ){ return ring[ (head + i) % ring.size() ]; }
+
+		bool save( frame_t &f );
+
+		void dropSettled(void);
+
+		std::vector<frame_t> ring;
+		int  head;
+		int  count;
+		int  confirmedCount;  // at the front of the ring, kept for a rollback
+		int  firstBad;        // ring offset of the first mispredicted frame
+
+		uint8_t last[4];      // last confirmed input
+		uint8_t cur[4];
+		bool    inRollback;
+
+		stats_t stat;
+};
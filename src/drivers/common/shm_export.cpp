@@ -0,0 +1,172 @@
+// shm_export.cpp
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define  SHM_EXPORT_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <string>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../driver.h"
+#include "../../movie.h"
+#include "../../palette.h"
+#include "../../ppu.h"
+#include "../../video.h"
+#include "common/shm_export.h"
+
+extern uint8 PALRAM[0x20];
+
+static fceux_shm_t *shm = NULL;
+static std::string  shmName;
+
+//************************************************************
+bool FCEU_ShmExportOpen(const char *name)
+{
+	FCEU_ShmExportClose();
+
+#ifdef SHM_EXPORT_POSIX
+	char defName[64];
+
+	if ( (name == NULL) || (name[0] == 0) )
+	{
+		snprintf( defName, sizeof(defName), "/fceux-%i", (int)getpid() );
+		name = defName;
+	}
+
+	int fd = shm_open( name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+
+	if ( fd < 0 )
+	{
+		perror("shm_open");
+		return false;
+	}
+	if ( ftruncate( fd, sizeof(fceux_shm_t) ) != 0 )
+	{
+		perror("ftruncate");
+		close(fd); shm_unlink(name);
+		return false;
+	}
+	void *vaddr = mmap( NULL, sizeof(fceux_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+
+	close(fd);
+
+	if ( vaddr == MAP_FAILED )
+	{
+		perror("mmap");
+		shm_unlink(name);
+		return false;
+	}
+	shm = (fceux_shm_t*)vaddr;
+
+	memset( shm, 0, sizeof(fceux_shm_t) );
+
+	shm->version    = FCEUX_SHM_VERSION;
+	shm->size       = sizeof(fceux_shm_t);
+	shm->writer_pid = getpid();
+
+	// readers may poll for the magic, so it goes in last
+	__atomic_store_n( &shm->magic, FCEUX_SHM_MAGIC, __ATOMIC_RELEASE );
+
+	shmName = name;
+
+	return true;
+#else
+	return false;
+#endif
+}
+//************************************************************
+void FCEU_ShmExportClose(void)
+{
+#ifdef SHM_EXPORT_POSIX
+	if ( shm )
+	{
+		munmap( shm, sizeof(fceux_shm_t) );
+		shm_unlink( shmName.c_str() );
+		shm = NULL;
+	}
+#endif
+	shmName.clear();
+}
+//************************************************************
+bool FCEU_ShmExportActive(void)
+{
+	return shm != NULL;
+}
+//************************************************************
+const char *FCEU_ShmExportName(void)
+{
+	return shmName.c_str();
+}
+//************************************************************
+void FCEU_ShmExportUpdate(void)
+{
+#ifdef SHM_EXPORT_POSIX
+	if ( shm == NULL )
+	{
+		return;
+	}
+	uint32_t seq = shm->seq;
+
+	__atomic_store_n( &shm->seq, seq + 1, __ATOMIC_RELAXED );
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+
+	shm->flags = 0;
+
+	if ( GameInfo != NULL )
+	{
+		shm->flags |= FCEUX_SHM_GAME_LOADED;
+	}
+	if ( FCEUI_EmulationPaused() )
+	{
+		shm->flags |= FCEUX_SHM_PAUSED;
+	}
+	shm->frame = FCEUMOV_GetFrame();
+	shm->lag   = FCEUI_GetLagCount();
+
+	if ( XBackBuf && XDBuf )
+	{
+		memcpy( shm->pixels, XBackBuf, sizeof(shm->pixels) );
+		memcpy( shm->deemph, XDBuf   , sizeof(shm->deemph) );
+	}
+
+	for (int i=0; i<256; i++)
+	{
+		FCEUD_GetPalette( i, &shm->palette[i][0], &shm->palette[i][1], &shm->palette[i][2] );
+	}
+	if ( palo )
+	{
+		for (int i=0; i<512; i++)
+		{
+			shm->deemph_palette[i][0] = palo[i].r;
+			shm->deemph_palette[i][1] = palo[i].g;
+			shm->deemph_palette[i][2] = palo[i].b;
+		}
+	}
+
+	if ( (GameInfo != NULL) && RAM )
+	{
+		memcpy( shm->ram, RAM, sizeof(shm->ram) );
+
+		for (int i=0; i<4; i++)
+		{
+			if ( vnapage[i] )
+			{
+				memcpy( shm->nametables[i], vnapage[i], 0x400 );
+			}
+		}
+		memcpy( shm->palette_ram, PALRAM, sizeof(shm->palette_ram) );
+	}
+
+	__atomic_store_n( &shm->seq, seq + 2, __ATOMIC_RELEASE );
+#endif
+}
+//************************************************************
@@ -0,0 +1,114 @@
+// shm_export.h
+//
+// Shared memory export of the emulator state for processes on the same
+// machine. Once per emulated frame the writer copies the frame, the 2KB of
+// work RAM, the nametables and the palette into a POSIX shared memory
+// object, so a reader can take snapshots with no round trip to the
+// emulator at all.
+//
+// This header is the reader side's contract as well. The layout only grows
+// at the end; a change that moves a field bumps FCEUX_SHM_VERSION. Readers
+// check magic and version, and size to find out which fields exist.
+//
+// Consistency is kept with a sequence lock. The writer makes seq odd,
+// updates the fields, then makes it even again. A reader copies what it
+// needs between two reads of seq and retries when they differ or are odd,
+// see fceux_shm_read() below.
+
+#ifndef __FCEUX_SHM_EXPORT_H__
+#define __FCEUX_SHM_EXPORT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define FCEUX_SHM_MAGIC     0x4D485346  // "FSHM"
+#define FCEUX_SHM_VERSION   1
+
+#define FCEUX_SHM_WIDTH     256
+#define FCEUX_SHM_HEIGHT    240
+
+// flags
+#define FCEUX_SHM_GAME_LOADED   0x0001
+#define FCEUX_SHM_PAUSED        0x0002
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fceux_shm_s
+{
+	// fixed at creation
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;          // sizeof(fceux_shm_t) of the writer
+	uint32_t writer_pid;
+
+	// seqlock, odd while an update is in progress
+	volatile uint32_t seq;
+
+	// everything below is only consistent between two equal, even seq reads
+	uint32_t flags;
+	uint32_t frame;         // movie frame counter, FCEUMOV_GetFrame()
+	uint32_t lag;           // lag counter
+
+	// picture before the HUD is drawn: one palette index and one deemph
+	// value (0-7) per pixel
+	uint8_t  pixels[FCEUX_SHM_HEIGHT][FCEUX_SHM_WIDTH];
+	uint8_t  deemph[FCEUX_SHM_HEIGHT][FCEUX_SHM_WIDTH];
+
+	// RGB for pixel p: palette[p] when its deemph value d is 0,
+	// otherwise deemph_palette[(p & 0x3F) + d*64]
+	uint8_t  palette[256][3];
+	uint8_t  deemph_palette[512][3];
+
+	uint8_t  ram[0x800];            // CPU $0000-$07FF
+	uint8_t  nametables[4][0x400];  // PPU $2000-$2FFF as currently mapped
+	uint8_t  palette_ram[0x20];     // PPU $3F00-$3F1F
+} fceux_shm_t;
+
+#if defined(__GNUC__) || defined(__clang__)
+// Copies len bytes at offset ofs of the segment into dest as one consistent
+// snapshot. Returns the frame counter of the snapshot. Spins while the
+// writer is in the middle of an update, which takes a few microseconds.
+static inline uint32_t fceux_shm_read(const fceux_shm_t *shm, size_t ofs, void *dest, size_t len)
+{
+	uint32_t s1, s2 = 0, frame = 0;
+
+	do
+	{
+		s1 = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+		if (s1 & 1)
+		{
+			continue;
+		}
+		frame = shm->frame;
+		memcpy(dest, (const uint8_t *)shm + ofs, len);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		s2 = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED);
+	} while ((s1 & 1) || (s1 != s2));
+
+	return frame;
+}
+#endif
+
+#ifdef __cplusplus
+}
+
+// Writer side, used by the frontends.
+
+// Creates (or replaces) the shared memory object name, "/fceux-<pid>" when
+// name is NULL or empty. Returns false when the platform has no POSIX
+// shared memory or the object cannot be created.
+bool FCEU_ShmExportOpen(const char *name);
+void FCEU_ShmExportClose(void);
+bool FCEU_ShmExportActive(void);
+const char *FCEU_ShmExportName(void);
+
+// Publishes the current frame and memory. Called once per emulated frame
+// by the frontend with the emulator locked. Does nothing when not open.
+void FCEU_ShmExportUpdate(void);
+
+#endif
+
+#endif // __FCEUX_SHM_EXPORT_H__
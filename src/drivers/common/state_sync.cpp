@@ -0,0 +1,169 @@
+// state_sync.cpp
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "../../types.h"
+#include "../../state.h"
+#include "utils/crc32.h"
+#include "common/state_sync.h"
+
+//************************************************************
+size_t NetPlayStateBlocks::blockLen( uint32_t idx )
+{
+	size_t ofs = (size_t)idx * blockSize;
+
+	return (state.size() - ofs < blockSize) ? (state.size() - ofs) : blockSize;
+}
+//************************************************************
+void NetPlayStateBlocks::rehash(void)
+{
+	hash.resize( (state.size() + blockSize - 1) / blockSize );
+
+	for (size_t i = 0; i < hash.size(); i++)
+	{
+		hash[i] = CalcCRC32( 0, &state[i * blockSize], blockLen(i) );
+	}
+}
+//************************************************************
+void NetPlayStateBlocks::clear(void)
+{
+	state.clear();
+	hash.clear();
+}
+//************************************************************
+bool NetPlayStateBlocks::snapshot(void)
+{
+	size_t size = FCEUSS_SnapshotSize();
+
+	if ( size == 0 )
+	{
+		clear();
+		return false;
+	}
+	state.resize( size );
+
+	if ( !FCEUSS_Snapshot( state.data(), size ) )
+	{
+		clear();
+		return false;
+	}
+	rehash();
+
+	return true;
+}
+//************************************************************
+bool NetPlayStateBlocks::restore(void)
+{
+	if ( state.empty() )
+	{
+		return false;
+	}
+	return FCEUSS_Restore( state.data(), state.size() );
+}
+//************************************************************
+void NetPlayStateBlocks::diff( const uint32_t *hashes, size_t numHashes, size_t snapshotSize, std::vector<uint32_t> &blocks )
+{
+	bool all = (snapshotSize != state.size()) || (numHashes != hash.size());
+
+	blocks.clear();
+
+	for (size_t i = 0; i < numHashes; i++)
+	{
+		if ( all || (hashes[i] != hash[i]) )
+		{
+			blocks.push_back( i );
+		}
+	}
+}
+//************************************************************
+bool NetPlayStateBlocks::pack( const uint32_t *blocks, size_t num, std::vector<uint8_t> &out )
+{
+	std::vector<uint8_t> raw;
+	uLongf len;
+
+	out.clear();
+
+	for (size_t i = 0; i < num; i++)
+	{
+		if ( blocks[i] >= hash.size() )
+		{
+			return false;
+		}
+		const uint8_t *p = &state[ (size_t)blocks[i] * blockSize ];
+
+		raw.insert( raw.end(), p, p + blockLen( blocks[i] ) );
+	}
+	if ( raw.empty() )
+	{
+		return true;
+	}
+	len = compressBound( raw.size() );
+
+	out.resize( len );
+
+	if ( compress2( out.data(), &len, raw.data(), raw.size(), 6 ) != Z_OK )
+	{
+		out.clear();
+		return false;
+	}
+	out.resize( len );
+
+	return true;
+}
+//************************************************************
+bool NetPlayStateBlocks::unpack( size_t snapshotSize, const uint32_t *blocks, size_t num, const uint8_t *data, size_t dataSize )
+{
+	std::vector<uint8_t> raw;
+	size_t rawSize = 0;
+	uLongf len;
+
+	state.resize( snapshotSize );
+	rehash();
+
+	for (size_t i = 0; i < num; i++)
+	{
+		if ( blocks[i] >= hash.size() )
+		{
+			return false;
+		}
+		rawSize += blockLen( blocks[i] );
+	}
+	if ( rawSize == 0 )
+	{
+		return true;
+	}
+	raw.resize( rawSize );
+
+	len = rawSize;
+
+	if ( (uncompress( raw.data(), &len, data, dataSize ) != Z_OK) || (len != rawSize) )
+	{
+		return false;
+	}
+	const uint8_t *p = raw.data();
+
+	for (size_t i = 0; i < num; i++)
+	{
+		size_t n = blockLen( blocks[i] );
+
+		memcpy( &state[ (size_t)blocks[i] * blockSize ], p, n );
+		p += n;
+	}
+	rehash();
+
+	return true;
+}
+//************************************************************
+bool NetPlayStateBlocks::matches( const uint32_t *hashes, size_t numHashes, size_t snapshotSize )
+{
+	if ( (snapshotSize != state.size()) || (numHashes != hash.size()) )
+	{
+		return false;
+	}
+	return memcmp( hashes, hash.data(), numHashes * sizeof(uint32_t) ) == 0;
+}
+//************************************************************
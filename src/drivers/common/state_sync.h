@@ -0,0 +1,58 @@
+// state_sync.h
+//
+// Block level state transfer for NetPlay syncs. The flat snapshot of the
+// loaded game (FCEUSS_Snapshot) is cut into blockSize byte blocks and each
+// block is hashed. The host sends the hashes of its snapshot, the client
+// compares them with its own and asks for the blocks that differ, which
+// the host sends compressed. After a desync most of the state is still the
+// same on both ends, and a late joiner starts from the power on state of
+// the same ROM, so only the blocks that changed go over the network.
+//
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+class NetPlayStateBlocks
+{
+	public:
+		static const size_t blockSize = 1024;
+
+		// Takes a snapshot of the loaded game and hashes its blocks
+		bool snapshot(void);
+
+		// Loads the snapshot, as patched by unpack()
+		bool restore(void);
+
+		void clear(void);
+
+		size_t size(void){ return state.size(); }
+		size_t numBlocks(void){ return hash.size(); }
+
+		const std::vector<uint32_t> &hashes(void){ return hash; }
+
+		// Blocks whose hash differs from the ones given, every block when
+		// the snapshot sizes differ
+		void diff( const uint32_t *hashes, size_t numHashes, size_t snapshotSize, std::vector<uint32_t> &blocks );
+
+		// Compresses the blocks listed, returns false on an index past the
+		// last block
+		bool pack( const uint32_t *blocks, size_t num, std::vector<uint8_t> &out );
+
+		// Writes packed blocks into the snapshot, resized to snapshotSize
+		// first, and rehashes it
+		bool unpack( size_t snapshotSize, const uint32_t *blocks, size_t num, const uint8_t *data, size_t dataSize );
+
+		// Whether the snapshot hashes to the ones given
+		bool matches( const uint32_t *hashes, size_t numHashes, size_t snapshotSize );
+
+	private:
+		size_t blockLen( uint32_t idx );
+
+		void rehash(void);
+
+		std::vector<uint8_t>  state;
+		std::vector<uint32_t> hash;
+};
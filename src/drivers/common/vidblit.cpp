@@ -28,9 +28,15 @@
 #include "../../types.h"
 #include "../../palette.h"
 #include "../../utils/memory.h"
+#include "../../stageprof.h"
 #include "nes_ntsc.h"
 #include "video.h"
 
+#if !defined(NOSSE2) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define VIDBLIT_AVX2
+#include <immintrin.h>
+#endif
+
 extern u8 *XBuf;
 extern u8 *XBackBuf;
 extern u8 *XDBuf;
@@ -54,7 +60,10 @@ static uint16 *specbuf=NULL;		// 8bpp -> 16bpp, pre hq2x/hq3x
 static uint32 *specbuf32bpp= NULL;	// Buffer to hold output of hq2x/hq3x when converting to 16bpp and 24bpp
 static uint8  *specbuf8bpp = NULL;	// For 2xscale, 3xscale.
 static uint8  *ntscblit    = NULL;	// For nes_ntsc
-static uint32 *prescalebuf = NULL;	// Prescale pointresizes to 2x-4x to allow less blur with hardware acceleration.
+static nes_ntsc_t *ntscCache = NULL;	// nes_ntsc of the last NTSC filter,
+static int ntscCacheOpt = -1;		// its specfilteropt
+static int ntscCacheBpp = 0;		// and bpp
+static int     prescale    = 0;		// Prescale pointresizes to 2x-4x to allow less blur with hardware acceleration.
 
 //////////////////////
 // PAL filter start //
@@ -106,6 +115,91 @@ static void CalculateShift(uint32 *CBM, int *cshiftr, int *cshiftl)
 }
 
 
+// Row kernels for the plain 32bpp blits. They translate count pixels of
+// src through palettetranslate, taking the deemph palette for any pixel
+// whose deemph bitplane value is nonzero, same as _ModernDeemphColorMap<1>.
+// A NULL deemph row gives the legacy lookup used by the scaled path.
+// BlitRow is picked once at InitBlitToHigh() time.
+typedef void (*BlitRowFuncPtr)( uint32 *dest, const uint8 *src, const uint8 *deemph, int count );
+
+static void BlitRow_C(uint32 *dest, const uint8 *src, const uint8 *deemph, int count)
+{
+	const uint32 *pt = palettetranslate;
+	int x = 0;
+
+	if(!deemph)
+	{
+		for(;x+4<=count;x+=4)
+		{
+			dest[x  ] = pt[src[x  ]];
+			dest[x+1] = pt[src[x+1]];
+			dest[x+2] = pt[src[x+2]];
+			dest[x+3] = pt[src[x+3]];
+		}
+		for(;x<count;x++)
+			dest[x] = pt[src[x]];
+		return;
+	}
+
+	//select the index without a branch, deemph is mixed within a line often enough to mispredict
+	for(;x<count;x++)
+	{
+		uint32 p = src[x];
+		uint32 d = deemph[x];
+		uint32 mask = 0u - (uint32)(d != 0);
+		dest[x] = pt[p ^ ((p ^ (256+(p&0x3F)+(d*64))) & mask)];
+	}
+}
+
+#if defined(VIDBLIT_AVX2)
+//8 pixels per step through the AVX2 dword gather
+__attribute__((target("avx2")))
+static void BlitRow_AVX2(uint32 *dest, const uint8 *src, const uint8 *deemph, int count)
+{
+	const int *pt = (const int *)palettetranslate;
+	int x = 0;
+
+	if(!deemph)
+	{
+		for(;x+8<=count;x+=8)
+		{
+			__m256i p = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src+x)));
+			_mm256_storeu_si256((__m256i*)(dest+x), _mm256_i32gather_epi32(pt, p, 4));
+		}
+	}
+	else
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i lowbits = _mm256_set1_epi32(0x3F);
+		const __m256i base = _mm256_set1_epi32(256);
+
+		for(;x+8<=count;x+=8)
+		{
+			__m256i p = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src+x)));
+			__m256i d = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(deemph+x)));
+			__m256i didx = _mm256_add_epi32(_mm256_add_epi32(base, _mm256_and_si256(p, lowbits)), _mm256_slli_epi32(d, 6));
+			__m256i idx = _mm256_blendv_epi8(didx, p, _mm256_cmpeq_epi32(d, zero));
+			_mm256_storeu_si256((__m256i*)(dest+x), _mm256_i32gather_epi32(pt, idx, 4));
+		}
+	}
+
+	if(x < count)
+		BlitRow_C(dest+x, src+x, deemph ? deemph+x : NULL, count-x);
+}
+#endif
+
+static BlitRowFuncPtr BlitRow = BlitRow_C;
+
+static void SelectBlitRowFunc(void)
+{
+	BlitRow = BlitRow_C;
+#if defined(VIDBLIT_AVX2)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		BlitRow = BlitRow_AVX2;
+#endif
+}
+
 int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int specfilt, int specfilteropt)
 {
 	// -Video Modes Tag-
@@ -130,11 +224,27 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 			break;			
 		}
 		
-		nes_ntsc = (nes_ntsc_t*) FCEU_dmalloc( sizeof (nes_ntsc_t) );
-		
+		// the kernel tables take a while to build, keep the last ones
+		// for when the video is set up again with the same filter
+		if ( ntscCache && (ntscCacheOpt == specfilteropt) && (ntscCacheBpp == b) )
+		{
+			nes_ntsc = ntscCache;
+		}
+		else
+		{
+			nes_ntsc = ntscCache ? ntscCache : (nes_ntsc_t*) FCEU_dmalloc( sizeof (nes_ntsc_t) );
+
+			if ( nes_ntsc )
+			{
+				nes_ntsc_init( nes_ntsc, &ntsc_setup, b );
+			}
+		}
+		ntscCache    = NULL;
+		ntscCacheOpt = specfilteropt;
+		ntscCacheBpp = b;
+
 		if ( nes_ntsc )
 		{
-			nes_ntsc_init( nes_ntsc, &ntsc_setup, b );			
 			ntscblit = (uint8*)FCEU_dmalloc(602*257*b);
 		}
 		
@@ -199,8 +309,7 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 	}
 	else if (specfilt >= 6 && specfilt <= 8)
 	{
-		int multi = specfilt - 4; // magic assuming prescales are specfilt >= 6
-		prescalebuf = (uint32 *)FCEU_dmalloc(256*240*multi*sizeof(uint32));
+		prescale = 1;
 	}
 	else if (specfilt == 9)
 	{
@@ -228,6 +337,8 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 	if(!palettetranslate)
 		return(0);
 	
+	SelectBlitRowFunc();
+	
 	
 	CBM[0]=rmask;
 	CBM[1]=gmask;
@@ -264,17 +375,15 @@ void KillBlitToHigh(void)
 		specbuf=NULL;
 	}
 	if (nes_ntsc) {
-		FCEU_free(nes_ntsc);
+		// kept for the next InitBlitToHigh()
+		ntscCache = nes_ntsc;
 		nes_ntsc = NULL;
 	}
 	if (ntscblit) {
 		free(ntscblit);
 		ntscblit = NULL;
 	}
-	if (prescalebuf) {
-		free(prescalebuf);
-		prescalebuf = NULL;
-	}
+	prescale = 0;
 	if (palrgb) {
 		free(palrgb);
 		palrgb = NULL;
@@ -527,8 +636,118 @@ static ModernDeemphColorMapFuncPtr getModernDeemphColorMapFunc(int scale)
 	return ptr;
 }
 
+//writes count pixels of s to d, each repeated xscale times
+static void ExpandRow32(uint32 *d, const uint32 *s, int count, int xscale)
+{
+	if(xscale == 1)
+	{
+		memcpy(d, s, count*sizeof(uint32));
+	}
+	else if(xscale == 2)
+	{
+		for(int x=0;x<count;x++,d+=2)
+			d[0] = d[1] = s[x];
+	}
+	else if(xscale == 3)
+	{
+		for(int x=0;x<count;x++,d+=3)
+			d[0] = d[1] = d[2] = s[x];
+	}
+	else if(xscale == 4)
+	{
+		for(int x=0;x<count;x++,d+=4)
+			d[0] = d[1] = d[2] = d[3] = s[x];
+	}
+	else
+	{
+		for(int x=0;x<count;x++)
+		{
+			for(int subpixel=0;subpixel<xscale;subpixel++)
+				*d++ = s[x];
+		}
+	}
+}
+
+int Blit8ToHighBandable(void)
+{
+	return Bpp == 4 && !specbuf8bpp && !palrgb && !specbuf;
+}
+
+uint8 Blit8ToHighNextBurst(void)
+{
+	burst_phase ^= 1;
+	return burst_phase;
+}
+
+//32bpp output for the modes where every output line comes from one source
+//line: plain, scaled, bare prescale and NTSC. Nothing outside lines y0..y1
+//of dest and ntscblit is written, so bands of one frame can run at once.
+void Blit8ToHighBand(const uint8 *src, const uint8 *srcD, uint8 *dest, int xr, int pitch, int xscale, int yscale, int y0, int y1, int burst)
+{
+	uint32 line[256];
+	int y;
+
+	src  += y0*256;
+	srcD += y0*256;
+
+	if(prescale)
+	{
+		//the prescaled image is packed, pitch is not used
+		int dxr = xr*xscale;
+		uint32 *d = (uint32 *)dest + dxr*yscale*y0;
+
+		//expand each line once, then copy it down for the remaining yscale-1 lines
+		for(y=y0; y<y1; y++, src+=256, srcD+=256, d+=dxr*yscale)
+		{
+			BlitRow(line, src, srcD, xr);
+			ExpandRow32(d, line, xr, xscale);
+			for(int sub=1; sub<yscale; sub++)
+				memcpy(d+dxr*sub, d, dxr*sizeof(uint32));
+		}
+	}
+	else if(xscale==1 && yscale==1)
+	{
+		//THE MAIN BLITTING CODEPATH (there may be others that are important)
+		dest += y0*pitch;
+		for(y=y0; y<y1; y++, src+=256, srcD+=256, dest+=pitch)
+			BlitRow((uint32 *)dest, src, srcD, xr);
+	}
+	else if(nes_ntsc && GameInfo && GameInfo->type!=GIT_NSF)
+	{
+		int outxr = 301 - (ClipSidesOffset ? 19 : 0);
+		//if(xr == 282) outxr = 282; //hack for windows
+		const int in_stride = Bpp * outxr * 2;
+		const int out_stride = pitch;
+		uint8 *blit = ntscblit + in_stride*y0;
+
+		//nes_ntsc_blit steps the burst phase once per line
+		nes_ntsc_blit( nes_ntsc, (unsigned char*)src, (unsigned char*)srcD, xr, (burst + y0) % nes_ntsc_burst_count, xr, y1-y0, blit, in_stride );
+
+		const uint8 *in = blit + (Bpp * xscale);
+		uint8 *out = dest + 2*out_stride*y0;
+		for(y=y0; y<y1; y++, in += in_stride, out += 2*out_stride ) {
+			memcpy(out, in, Bpp * outxr * xscale);
+			memcpy(out + out_stride, in, Bpp * outxr * xscale);
+		}
+	}
+	else
+	{
+		//translate the line once, expand it into the first output line and copy that down
+		dest += y0*yscale*pitch;
+		for(y=y0; y<y1; y++, src+=256, dest+=pitch*yscale)
+		{
+			BlitRow(line, src, NULL, xr);
+			ExpandRow32((uint32 *)dest, line, xr, xscale);
+			for(int doo=1;doo<yscale;doo++)
+				memcpy(dest+pitch*doo, dest, (xr*xscale)<<2);
+		}
+	}
+}
+
 void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale)
 {
+	FCEU_StageScope stage(FCEU_STAGE_BLIT);
+
 	int x,y;
 	int pinc;
 	uint8 *destbackup = NULL;	/* For hq2x */
@@ -612,48 +831,13 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 		}
 		return;
 	}
-	else if(prescalebuf)             // bare prescale
+	else if(Blit8ToHighBandable())   // plain, scaled, bare prescale and NTSC at 32bpp
+	{
+		Blit8ToHighBand(src, XDBuf + (src-XBuf), dest, xr, pitch, xscale, yscale, 0, yr, Blit8ToHighNextBurst());
+		return;
+	}
+	else if(prescale)                // bare prescale is only supported at 32bpp
 	{
-		destbackup = dest;
-		dest = (uint8 *)prescalebuf;
-		pitchbackup = pitch;		
-		pitch = xr*sizeof(uint32);
-		pinc = pitch-(xr<<2);
-
-		for(y=yr; y; y--, src+=256-xr)
-		{
-			for(x=xr; x; x--)
-			{
-				*(uint32 *)dest = _ModernDeemphColorMap<1>(src,XBuf);
-				dest += 4;
-				src++;
-			}
-			dest += pinc;
-		}
-
-		if (Bpp == 4) // are other modes really needed?
-		{
-			uint32 *s = prescalebuf;
-			uint32 *d = (uint32 *)destbackup; // use 32-bit pointers ftw
-			int subpixel,yend;
-
-			yend = yr*yscale;
-
-			for (y=0; y<yend; y++)
-			{
-				int back = xr*(y%yscale>0); // bool as multiplier
-				for (x=0; x<xr; x++)
-				{
-					for (subpixel=0; subpixel<xscale; subpixel++)
-					{
-						*d++ = *(s-back);
-					}
-					s++;
-				}
-				if (back)
-					s -= xr;
-			}
-		}
 		return;
 	}
 	else if (palrgb)                 // pal moire
@@ -857,47 +1041,6 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 		{
 			switch(Bpp)
 			{
-			case 4:
-				if ( nes_ntsc && GameInfo && GameInfo->type!=GIT_NSF) {
-					int outxr = 301 - (ClipSidesOffset ? 19 : 0);
-					//if(xr == 282) outxr = 282; //hack for windows
-					burst_phase ^= 1;
-					u8* srcD = XDBuf + (src-XBuf); // get deemphasis buffer
-					nes_ntsc_blit( nes_ntsc, (unsigned char*)src, (unsigned char*)srcD, xr, burst_phase, xr, yr, ntscblit, (2*outxr) * Bpp );
-
-					const uint8 *in = ntscblit + (Bpp * xscale);
-					uint8 *out = dest;
-					const int in_stride = Bpp * outxr * 2;
-					const int out_stride = pitch;
-					for( int y = 0; y < yr; y++, in += in_stride, out += 2*out_stride ) {
-						memcpy(out, in, Bpp * outxr * xscale);
-						memcpy(out + out_stride, in, Bpp * outxr * xscale);
-					}
-				} else {
-					pinc=pitch-((xr*xscale)<<2);
-					for(y=yr;y;y--,src+=256-xr)
-					{
-						int doo=yscale;
-						        
-						do
-						{
-							for(x=xr;x;x--,src++)
-							{
-								int too=xscale;
-								do
-								{
-									*(uint32 *)dest=palettetranslate[*src];
-									dest+=4;
-								} while(--too);
-							}
-							src-=xr;
-							dest+=pinc;
-						} while(--doo);
-						src+=xr;
-					}
-				}
-				break;
-			
 			case 3:
 				pinc=pitch-((xr*xscale)*3);
 				for(y=yr;y;y--,src+=256-xr)
@@ -957,20 +1100,6 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 		else
 			switch(Bpp)
 			{
-			case 4:
-				pinc=pitch-(xr<<2);
-				for(y=yr;y;y--,src+=256-xr)
-				{
-					for(x=xr;x;x--)
-					{
-						//THE MAIN BLITTING CODEPATH (there may be others that are important)
-						*(uint32 *)dest = _ModernDeemphColorMap<1>(src,XBuf);
-						dest+=4;
-						src++;
-					}
-					dest+=pinc;
-				}
-				break;
 			case 3:
 				pinc=pitch-(xr+xr+xr);
 				for(y=yr;y;y--,src+=256-xr)
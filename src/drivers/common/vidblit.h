@@ -22,6 +22,16 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int eefx, in
 void SetPaletteBlitToHigh(uint8 *src);
 void KillBlitToHigh(void);
 void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale);
+
+// Band rendering of Blit8ToHigh() for modes where every output line comes
+// from one source line. When Blit8ToHighBandable() is nonzero, lines
+// [y0,y1) of a frame can be drawn with Blit8ToHighBand() on any thread,
+// several bands at once. srcD is the deemph plane matching src, and burst
+// is one value from Blit8ToHighNextBurst() per frame.
+int Blit8ToHighBandable(void);
+uint8 Blit8ToHighNextBurst(void);
+void Blit8ToHighBand(const uint8 *src, const uint8 *srcD, uint8 *dest, int xr, int pitch, int xscale, int yscale, int y0, int y1, int burst);
+
 void Blit8To8(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, int efx, int special);
 
 void Blit32to24(uint32 *src, uint8 *dest, int xr, int yr, int dpitch);
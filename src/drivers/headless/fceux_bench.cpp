@@ -0,0 +1,797 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// fceux_bench.cpp
+//
+// fceux-bench, the benchmark of libfceux-core. Plays the cases of a corpus
+// file (see bench_corpus.txt) unthrottled and writes a JSON report of the
+// frames per second, ns per CPU instruction, heap allocations and work
+// counters (see EFCEU_Counter) of each, so that two builds can be compared
+// with scripts/bench_compare.py. BENCH_SCHEMA goes up whenever a field
+// changes meaning or goes away, and the report names the git revision built.
+//
+// Every ROM and movie of the corpus is pinned by the MD5 of the file: a case
+// whose file does not match is not run, since its numbers would not compare.
+// --pin writes the MD5s of the files found into the corpus.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../driver.h"
+#include "../../movie.h"
+#include "../../debug.h"
+#include "../../movieverify.h"
+#include "../../version.h"
+#include "../../allocstats.h"
+#include "../../stageprof.h"
+#include "../../utils/md5.h"
+#include "../Qt/fceux_git_info.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "headless.h"
+#include "fceux_core.h"
+
+#ifndef FCEUX_BENCH_CORPUS
+#define FCEUX_BENCH_CORPUS "bench_corpus.txt"
+#endif
+
+// 2: "schema", "git_rev", and per case "counters" and "allocations_per_frame"
+#define BENCH_SCHEMA 2
+
+//*****************************************************************
+// Corpus
+//*****************************************************************
+struct BenchCase
+{
+	std::string name;
+	std::string rom;        // under the ROM directory, or "builtin"
+	std::string md5;        // pin of rom, "" for none
+	std::string movie;      // FM2 played from power on, "" for none
+	std::string movieMd5;
+	int  frames;            // 0 for the length of the movie
+	bool newPPU;
+	int  sound;             // FCEUI_SetSoundQuality(), -1 for synthesis off
+	bool savestate;         // time savestates instead of frames
+	int  line;              // in the corpus, for --pin
+
+	BenchCase() : frames(0), newPPU(false), sound(-1), savestate(false), line(0) {}
+};
+
+struct BenchResult
+{
+	std::string error;      // why it was not run, "" when it was
+	bool   skipped;         // a file of the corpus is missing
+	int    frames;
+	double seconds;         // fastest of the repeats
+	uint64 instructions;
+	uint64 allocations;     // during the fastest repeat
+	uint64 allocatedBytes;
+	uint64 ramHash;         // after the last frame, the same in every build
+	size_t stateSize;
+	double savesPerSec;
+	double loadsPerSec;
+	double snapshotsPerSec; // fceux_core_snapshot() and restore, per pair
+	uint64 counters[FCEU_COUNTER_COUNT]; // during the fastest repeat, or the timed saves and loads
+
+	BenchResult() : skipped(false), frames(0), seconds(0), instructions(0), allocations(0),
+		allocatedBytes(0), ramHash(0), stateSize(0), savesPerSec(0), loadsPerSec(0), snapshotsPerSec(0)
+	{
+		memset( counters, 0, sizeof(counters) );
+	}
+};
+
+static std::string Trim(const std::string &s)
+{
+	size_t b = s.find_first_not_of(" \t\r\n");
+	size_t e = s.find_last_not_of(" \t\r\n");
+
+	return (b == std::string::npos) ? "" : s.substr(b, e - b + 1);
+}
+
+static std::vector<std::string> SplitWords(const std::string &s)
+{
+	std::vector<std::string> words;
+	size_t i = 0;
+
+	while (i < s.size())
+	{
+		size_t b = s.find_first_not_of(" \t", i);
+
+		if (b == std::string::npos)
+		{
+			break;
+		}
+		size_t e = s.find_first_of(" \t", b);
+
+		if (e == std::string::npos)
+		{
+			e = s.size();
+		}
+		words.push_back( s.substr(b, e - b) );
+		i = e;
+	}
+	return words;
+}
+
+static bool ReadLines(const char *path, std::vector<std::string> &lines)
+{
+	FILE *fp = fopen( path, "rb" );
+
+	if (fp == nullptr)
+	{
+		return false;
+	}
+	std::string text;
+	char buf[4096];
+	size_t n;
+
+	while ( (n = fread( buf, 1, sizeof(buf), fp )) > 0 )
+	{
+		text.append( buf, n );
+	}
+	fclose( fp );
+
+	size_t i = 0;
+
+	while (i <= text.size())
+	{
+		size_t e = text.find('\n', i);
+
+		if (e == std::string::npos)
+		{
+			e = text.size();
+		}
+		std::string line = text.substr(i, e - i);
+
+		if (!line.empty() && line[line.size()-1] == '\r')
+		{
+			line.erase(line.size()-1);
+		}
+		lines.push_back( line );
+		i = e + 1;
+	}
+	if (!lines.empty() && lines.back().empty())
+	{
+		lines.pop_back();
+	}
+	return true;
+}
+
+// "name key=value ..." per line, # for comments
+static bool ParseCorpus(const std::vector<std::string> &lines, std::vector<BenchCase> &cases)
+{
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		std::string line = Trim( lines[i].substr(0, lines[i].find('#')) );
+
+		if (line.empty())
+		{
+			continue;
+		}
+		std::vector<std::string> words = SplitWords( line );
+		BenchCase c;
+
+		c.name = words[0];
+		c.line = (int)i;
+
+		for (size_t w = 1; w < words.size(); w++)
+		{
+			size_t eq = words[w].find('=');
+			std::string key = words[w].substr(0, eq);
+			std::string value = (eq == std::string::npos) ? "" : words[w].substr(eq + 1);
+
+			if      (key == "rom")       c.rom = value;
+			else if (key == "md5")       c.md5 = value;
+			else if (key == "movie")     c.movie = value;
+			else if (key == "movie_md5") c.movieMd5 = value;
+			else if (key == "frames")    c.frames = atoi( value.c_str() );
+			else if (key == "ppu" && (value == "old" || value == "new"))
+			{
+				c.newPPU = (value == "new");
+			}
+			else if (key == "sound" && (value == "off" || value == "0" || value == "1" || value == "2"))
+			{
+				c.sound = (value == "off") ? -1 : atoi( value.c_str() );
+			}
+			else if (key == "mode" && (value == "run" || value == "savestate"))
+			{
+				c.savestate = (value == "savestate");
+			}
+			else
+			{
+				fprintf( stderr, "corpus line %u: bad setting '%s'\n", (unsigned)i + 1, words[w].c_str() );
+				return false;
+			}
+		}
+		if (c.rom.empty() || (c.movie.empty() && c.frames <= 0))
+		{
+			fprintf( stderr, "corpus line %u: %s needs rom= and frames= or movie=\n", (unsigned)i + 1, c.name.c_str() );
+			return false;
+		}
+		cases.push_back( c );
+	}
+	return true;
+}
+
+// MD5 of a whole file, "" when it can not be read
+static std::string FileMD5(const std::string &path)
+{
+	FILE *fp = fopen( path.c_str(), "rb" );
+
+	if (fp == nullptr)
+	{
+		return "";
+	}
+	md5_context ctx;
+	MD5DATA digest;
+	uint8 buf[65536];
+	size_t n;
+
+	md5_starts( &ctx );
+
+	while ( (n = fread( buf, 1, sizeof(buf), fp )) > 0 )
+	{
+		md5_update( &ctx, buf, (uint32)n );
+	}
+	fclose( fp );
+
+	md5_finish( &ctx, digest.data );
+
+	return md5_asciistr( digest );
+}
+
+//*****************************************************************
+// Built in test program, so the suite has a case without any files:
+// NROM, rendering and NMI on, adding up RAM in a loop.
+//*****************************************************************
+static const uint8 builtinProgram[] =
+{
+	0x78,             // SEI
+	0xD8,             // CLD
+	0xA2, 0xFF,       // LDX #$FF
+	0x9A,             // TXS
+	0x2C, 0x02, 0x20, // BIT $2002   wait for two vblanks
+	0x10, 0xFB,       // BPL -5
+	0x2C, 0x02, 0x20, // BIT $2002
+	0x10, 0xFB,       // BPL -5
+	0xA9, 0x80,       // LDA #$80
+	0x8D, 0x00, 0x20, // STA $2000   NMI on
+	0xA9, 0x1E,       // LDA #$1E
+	0x8D, 0x01, 0x20, // STA $2001   background and sprites on
+	0xE6, 0x10,       // $8019: INC $10
+	0xA5, 0x10,       // LDA $10
+	0x65, 0x11,       // ADC $11
+	0x85, 0x11,       // STA $11
+	0x4C, 0x19, 0x80, // JMP $8019
+	0xE6, 0x12,       // $8024: INC $12
+	0x40,             // RTI
+};
+
+static std::string BuiltinRomPath(void)
+{
+#ifdef WIN32
+	const char *dir = getenv("TEMP");
+#else
+	const char *dir = getenv("TMPDIR");
+#endif
+	return std::string( dir ? dir : "/tmp" ) + "/fceux-bench-builtin.nes";
+}
+
+static bool WriteBuiltinRom(const std::string &path)
+{
+	std::vector<uint8> image( 16 + 0x4000 + 0x2000, 0 );
+	uint8 *prg = &image[16];
+
+	memcpy( &image[0], "NES\x1a\x01\x01", 6 );
+	memcpy( prg, builtinProgram, sizeof(builtinProgram) );
+
+	// NMI $8024, RESET $8000, IRQ $8024
+	prg[0x3FFA] = 0x24; prg[0x3FFB] = 0x80;
+	prg[0x3FFC] = 0x00; prg[0x3FFD] = 0x80;
+	prg[0x3FFE] = 0x24; prg[0x3FFF] = 0x80;
+
+	FILE *fp = fopen( path.c_str(), "wb" );
+
+	if (fp == nullptr)
+	{
+		return false;
+	}
+	bool ok = fwrite( &image[0], 1, image.size(), fp ) == image.size();
+
+	return (fclose( fp ) == 0) && ok;
+}
+
+//*****************************************************************
+// Running a case
+//*****************************************************************
+static double Now(void)
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// counters now less base
+static void CountersSince(const uint64_t base[FCEU_COUNTER_COUNT], uint64 counters[FCEU_COUNTER_COUNT])
+{
+	uint64_t now[FCEU_COUNTER_COUNT];
+
+	FCEU_GetCounters( now );
+
+	for (int i = 0; i < FCEU_COUNTER_COUNT; i++)
+	{
+		counters[i] = now[i] - base[i];
+	}
+}
+
+static std::string RomPath(const BenchCase &c, const std::string &romDir)
+{
+	return (c.rom == "builtin") ? BuiltinRomPath() : romDir + "/" + c.rom;
+}
+
+static std::string MoviePath(const BenchCase &c, const std::string &romDir)
+{
+	return c.movie.empty() ? "" : romDir + "/" + c.movie;
+}
+
+// Power on with the settings of the case, and the movie started
+static bool StartCase(const BenchCase &c, const std::string &rom, const std::string &movie, std::string &error)
+{
+	fceux_core_close_rom();
+
+	newppu = c.newPPU ? 1 : 0;
+
+	if (fceux_core_load_rom( rom.c_str() ) != 0)
+	{
+		error = "cannot load ROM";
+		return false;
+	}
+	FCEUI_Sound( (c.sound < 0) ? 0 : 48000 );
+	FCEUI_SetSoundQuality( (c.sound < 0) ? 0 : c.sound );
+
+	if (!movie.empty())
+	{
+		FCEUI_LoadMovie( movie.c_str(), true, 0 );
+
+		if (!FCEUMOV_Mode(MOVIEMODE_PLAY))
+		{
+			error = "cannot play movie";
+			return false;
+		}
+	}
+	return true;
+}
+
+static int CaseFrames(const BenchCase &c)
+{
+	if (c.frames > 0)
+	{
+		return c.frames;
+	}
+	return currMovieData.getNumRecords();
+}
+
+static void RunFrames(const BenchCase &c, int frames)
+{
+	for (int i = 0; i < frames; i++)
+	{
+		if (!c.movie.empty() && !FCEUMOV_Mode(MOVIEMODE_PLAY))
+		{
+			break;
+		}
+		fceux_core_run_frames(1);
+	}
+}
+
+static void RunCase(const BenchCase &c, const std::string &romDir, int repeat, BenchResult &result)
+{
+	std::string rom = RomPath( c, romDir );
+	std::string movie = MoviePath( c, romDir );
+
+	// the pins first, numbers of other files would not compare
+	std::string md5 = FileMD5( rom );
+
+	if (md5.empty() || (!movie.empty() && FileMD5( movie ).empty()))
+	{
+		result.skipped = true;
+		result.error = md5.empty() ? "ROM not found" : "movie not found";
+		return;
+	}
+	if ( (!c.md5.empty() && c.md5 != md5) || (!movie.empty() && !c.movieMd5.empty() && c.movieMd5 != FileMD5( movie )) )
+	{
+		result.error = "MD5 does not match the corpus";
+		return;
+	}
+
+	for (int r = 0; r < repeat; r++)
+	{
+		if (!StartCase( c, rom, movie, result.error ))
+		{
+			return;
+		}
+		int frames = CaseFrames( c );
+
+		if (c.savestate)
+		{
+			// time saves and loads of the state some way into the game
+			RunFrames( c, frames );
+
+			result.stateSize = fceux_core_save_state( nullptr, 0 );
+
+			std::vector<uint8_t> state( result.stateSize );
+			std::vector<uint8_t> snapshot( fceux_core_snapshot_size() );
+			const int count = 1000;
+
+			fceux_core_save_state( &state[0], state.size() );
+
+			uint64_t counterBase[FCEU_COUNTER_COUNT];
+			FCEU_GetCounters( counterBase );
+
+			double t = Now();
+			for (int i = 0; i < count; i++)
+			{
+				fceux_core_save_state( &state[0], state.size() );
+			}
+			double saves = count / (Now() - t);
+
+			t = Now();
+			for (int i = 0; i < count; i++)
+			{
+				fceux_core_load_state( &state[0], state.size() );
+			}
+			double loads = count / (Now() - t);
+
+			t = Now();
+			for (int i = 0; i < count; i++)
+			{
+				fceux_core_snapshot( &snapshot[0], snapshot.size() );
+				fceux_core_restore( &snapshot[0], snapshot.size() );
+			}
+			double snapshots = count / (Now() - t);
+
+			CountersSince( counterBase, result.counters );
+
+			if (saves > result.savesPerSec)         result.savesPerSec = saves;
+			if (loads > result.loadsPerSec)         result.loadsPerSec = loads;
+			if (snapshots > result.snapshotsPerSec) result.snapshotsPerSec = snapshots;
+
+			result.frames = frames;
+			result.ramHash = FCEU_MovieVerifyRamHash();
+			continue;
+		}
+
+		uint64 frameBase = fceux_core_frame_count();
+		uint64 instructionBase = total_instructions;
+		uint64 allocBase = FCEU_AllocCount();
+		uint64 bytesBase = FCEU_AllocBytes();
+		uint64_t counterBase[FCEU_COUNTER_COUNT];
+		FCEU_GetCounters( counterBase );
+		double t = Now();
+
+		RunFrames( c, frames );
+
+		double seconds = Now() - t;
+
+		if ( (r == 0) || (seconds < result.seconds) )
+		{
+			result.seconds = seconds;
+			result.frames = (int)(fceux_core_frame_count() - frameBase);
+			result.instructions = total_instructions - instructionBase;
+			result.allocations = FCEU_AllocCount() - allocBase;
+			result.allocatedBytes = FCEU_AllocBytes() - bytesBase;
+			CountersSince( counterBase, result.counters );
+		}
+		result.ramHash = FCEU_MovieVerifyRamHash();
+	}
+	FCEUI_StopMovie();
+	fceux_core_close_rom();
+	newppu = 0;
+}
+
+//*****************************************************************
+// Report
+//*****************************************************************
+static std::string JsonString(const std::string &s)
+{
+	std::string out = "\"";
+
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		char c = s[i];
+
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			char esc[8];
+			snprintf( esc, sizeof(esc), "\\u%04x", c );
+			out += esc;
+		}
+		else
+		{
+			out += c;
+		}
+	}
+	return out + "\"";
+}
+
+static std::string Report(const std::vector<BenchCase> &cases, const std::vector<BenchResult> &results, int repeat)
+{
+	std::string out;
+	char line[512];
+
+	snprintf( line, sizeof(line), "{\n  \"schema\": %d", BENCH_SCHEMA );
+	out += line;
+	out += ",\n  \"version\": " + JsonString( FCEU_NAME_AND_VERSION );
+	out += ",\n  \"git_rev\": " + JsonString( fceu_get_git_rev() );
+#ifdef __VERSION__
+	out += ",\n  \"compiler\": " + JsonString( __VERSION__ );
+#endif
+	snprintf( line, sizeof(line), ",\n  \"repeat\": %d,\n  \"cases\": [", repeat );
+	out += line;
+
+	for (size_t i = 0; i < cases.size(); i++)
+	{
+		const BenchCase &c = cases[i];
+		const BenchResult &r = results[i];
+
+		out += (i ? ",\n    {" : "\n    {");
+		out += "\"name\": " + JsonString( c.name );
+		out += ", \"rom\": " + JsonString( c.rom );
+
+		if (!c.movie.empty())
+		{
+			out += ", \"movie\": " + JsonString( c.movie );
+		}
+		snprintf( line, sizeof(line), ", \"ppu\": \"%s\", \"sound\": \"%s\", \"mode\": \"%s\"",
+			c.newPPU ? "new" : "old", (c.sound < 0) ? "off" : ((c.sound == 0) ? "0" : (c.sound == 1) ? "1" : "2"),
+			c.savestate ? "savestate" : "run" );
+		out += line;
+
+		if (!r.error.empty())
+		{
+			out += std::string(", \"status\": \"") + (r.skipped ? "skipped" : "failed") + "\"";
+			out += ", \"error\": " + JsonString( r.error ) + "}";
+			continue;
+		}
+		snprintf( line, sizeof(line), ", \"status\": \"ok\", \"frames\": %d, \"ram_hash\": \"%016llx\"",
+			r.frames, (unsigned long long)r.ramHash );
+		out += line;
+
+		if (c.savestate)
+		{
+			snprintf( line, sizeof(line), ", \"state_bytes\": %u, \"saves_per_sec\": %.1f, \"loads_per_sec\": %.1f, \"snapshots_per_sec\": %.1f",
+				(unsigned)r.stateSize, r.savesPerSec, r.loadsPerSec, r.snapshotsPerSec );
+		}
+		else
+		{
+			double fps = (r.seconds > 0) ? r.frames / r.seconds : 0;
+			double nsPerInstruction = r.instructions ? r.seconds * 1e9 / r.instructions : 0;
+			double allocationsPerFrame = r.frames ? (double)r.allocations / r.frames : 0;
+
+			snprintf( line, sizeof(line), ", \"seconds\": %.6f, \"fps\": %.1f, \"instructions\": %llu, \"ns_per_instruction\": %.3f, \"allocations\": %llu, \"allocated_bytes\": %llu, \"allocations_per_frame\": %.3f",
+				r.seconds, fps, (unsigned long long)r.instructions, nsPerInstruction,
+				(unsigned long long)r.allocations, (unsigned long long)r.allocatedBytes, allocationsPerFrame );
+		}
+		out += line;
+		out += ", \"counters\": {";
+
+		for (int k = 0; k < FCEU_COUNTER_COUNT; k++)
+		{
+			snprintf( line, sizeof(line), "%s\"%s\": %llu", k ? ", " : "", FCEU_CounterName(k), (unsigned long long)r.counters[k] );
+			out += line;
+		}
+		out += "}}";
+	}
+	out += "\n  ]\n}\n";
+
+	return out;
+}
+
+// Writes the MD5 of the files of every case into the corpus
+static bool PinCorpus(const char *path, std::vector<std::string> &lines, const std::vector<BenchCase> &cases, const std::string &romDir)
+{
+	for (size_t i = 0; i < cases.size(); i++)
+	{
+		const BenchCase &c = cases[i];
+
+		if (c.rom == "builtin")
+		{
+			continue;
+		}
+		std::string md5 = FileMD5( RomPath( c, romDir ) );
+		std::string movieMd5 = c.movie.empty() ? "" : FileMD5( MoviePath( c, romDir ) );
+
+		if (md5.empty() || (!c.movie.empty() && movieMd5.empty()))
+		{
+			fprintf( stderr, "%s: not found, not pinned\n", c.name.c_str() );
+			continue;
+		}
+		std::string &line = lines[c.line];
+		size_t comment = line.find('#');
+		std::string tail = (comment == std::string::npos) ? "" : "  " + line.substr(comment);
+		std::vector<std::string> words = SplitWords( Trim( line.substr(0, comment) ) );
+		std::string pinned;
+
+		for (size_t w = 0; w < words.size(); w++)
+		{
+			if (words[w].compare(0, 4, "md5=") != 0 && words[w].compare(0, 10, "movie_md5=") != 0)
+			{
+				pinned += (w ? " " : "") + words[w];
+			}
+		}
+		pinned += " md5=" + md5;
+
+		if (!movieMd5.empty())
+		{
+			pinned += " movie_md5=" + movieMd5;
+		}
+		line = pinned + tail;
+	}
+
+	std::string text;
+
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		text += lines[i] + "\n";
+	}
+	FILE *fp = fopen( path, "wb" );
+
+	if (fp == nullptr)
+	{
+		return false;
+	}
+	bool ok = fwrite( text.data(), 1, text.size(), fp ) == text.size();
+
+	return (fclose( fp ) == 0) && ok;
+}
+
+static void ShowUsage(const char *prog)
+{
+	printf(
+"Usage: %s [options]\n"
+"\n"
+"Plays the cases of a corpus through libfceux-core unthrottled and writes\n"
+"a JSON report of frames/sec, ns per CPU instruction, heap allocations and\n"
+"the work counters of each subsystem.\n"
+"\n"
+"--corpus  f       Corpus file, default %s\n"
+"--rom-dir d       Directory the ROMs and movies of the corpus are in, default .\n"
+"--case    name    Only run the cases whose name starts with name.\n"
+"--repeat  n       Run each case n times and keep the fastest, default 3.\n"
+"--output  f       Write the report to f instead of stdout.\n"
+"--pin             Write the MD5 of every ROM and movie found into the corpus.\n",
+		prog, FCEUX_BENCH_CORPUS );
+}
+
+int main(int argc, char *argv[])
+{
+	const char *corpusPath = FCEUX_BENCH_CORPUS;
+	const char *outputPath = nullptr;
+	std::string romDir = ".";
+	std::string only;
+	int  repeat = 3;
+	bool pin = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+
+		if      (arg == "--corpus"  && hasValue) corpusPath = argv[++i];
+		else if (arg == "--rom-dir" && hasValue) romDir = argv[++i];
+		else if (arg == "--case"    && hasValue) only = argv[++i];
+		else if (arg == "--repeat"  && hasValue) repeat = atoi( argv[++i] );
+		else if (arg == "--output"  && hasValue) outputPath = argv[++i];
+		else if (arg == "--pin") pin = true;
+		else
+		{
+			ShowUsage( argv[0] );
+			return (arg == "-h" || arg == "--help") ? 0 : 1;
+		}
+	}
+	if (repeat < 1)
+	{
+		repeat = 1;
+	}
+
+	std::vector<std::string> lines;
+	std::vector<BenchCase> corpus, cases;
+
+	if (!ReadLines( corpusPath, lines ))
+	{
+		fprintf( stderr, "cannot read corpus %s\n", corpusPath );
+		return 1;
+	}
+	if (!ParseCorpus( lines, corpus ))
+	{
+		return 1;
+	}
+	if (pin)
+	{
+		if (!PinCorpus( corpusPath, lines, corpus, romDir ))
+		{
+			fprintf( stderr, "cannot write corpus %s\n", corpusPath );
+			return 1;
+		}
+		return 0;
+	}
+	for (size_t i = 0; i < corpus.size(); i++)
+	{
+		if (corpus[i].name.compare(0, only.size(), only) == 0)
+		{
+			cases.push_back( corpus[i] );
+		}
+	}
+
+	if (!WriteBuiltinRom( BuiltinRomPath() ))
+	{
+		fprintf( stderr, "cannot write %s\n", BuiltinRomPath().c_str() );
+		return 1;
+	}
+	// the report may go to stdout
+	headlessSetMessageFile( stderr );
+
+	if (fceux_core_init() != 0)
+	{
+		fprintf( stderr, "cannot initialize the core\n" );
+		return 1;
+	}
+	std::vector<BenchResult> results( cases.size() );
+	int failed = 0;
+
+	for (size_t i = 0; i < cases.size(); i++)
+	{
+		fprintf( stderr, "%s...\n", cases[i].name.c_str() );
+
+		RunCase( cases[i], romDir, repeat, results[i] );
+
+		if (!results[i].error.empty())
+		{
+			fprintf( stderr, "%s: %s\n", cases[i].name.c_str(), results[i].error.c_str() );
+
+			if (!results[i].skipped)
+			{
+				failed++;
+			}
+		}
+	}
+	fceux_core_shutdown();
+	remove( BuiltinRomPath().c_str() );
+
+	std::string report = Report( cases, results, repeat );
+	FILE *fp = outputPath ? fopen( outputPath, "w" ) : stdout;
+
+	if (fp == nullptr)
+	{
+		fprintf( stderr, "cannot write %s\n", outputPath );
+		return 1;
+	}
+	fwrite( report.data(), 1, report.size(), fp );
+
+	if (fp != stdout)
+	{
+		fclose( fp );
+	}
+	return failed ? 1 : 0;
+}
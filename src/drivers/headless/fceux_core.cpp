@@ -0,0 +1,742 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// fceux_core.cpp
+//
+#include <string.h>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../driver.h"
+#include "../../cheat.h"
+#include "../../state.h"
+#include "../../movie.h"
+#include "../../input.h"
+#include "../../video.h"
+#include "../../capture.h"
+#include "../../romcache.h"
+#include "../../bootcache.h"
+#include "../../romscan.h"
+#include "../../movieverify.h"
+#include "../../nsfrender.h"
+#include "../../startuptime.h"
+#include "../../stageprof.h"
+#include "../../allocstats.h"
+#include "../../guestprof.h"
+#include "../../inputsearch.h"
+#include "../../inputfuzz.h"
+#include "../common/shm_export.h"
+#include "../common/cdl_coverage.h"
+#include "../../emufile.h"
+#include "zlib.h"
+
+#include <string>
+#include <vector>
+
+#include "headless.h"
+#include "fceux_core.h"
+
+extern uint8 *XBuf;
+
+static bool   coreInitialized = false;
+static uint32 joyData = 0;
+static int    fourScore = 0;
+static EMUFILE_MEMORY stateBuffer;
+static std::string loadedPath;
+
+extern void headlessGetPaletteRGB(uint8 index, uint8 *r, uint8 *g, uint8 *b);
+
+static void applyInputConfig(void)
+{
+	FCEUI_SetInput( 0, SI_GAMEPAD, &joyData, 0 );
+	FCEUI_SetInput( 1, SI_GAMEPAD, &joyData, 0 );
+	FCEUI_SetInputFC( SIFC_NONE, nullptr, 0 );
+	FCEUI_SetInputFourscore( fourScore ? true : false );
+}
+
+int fceux_core_init(void)
+{
+	if (coreInitialized)
+	{
+		return 0;
+	}
+	FCEU_StartupTimingStart();
+
+	if (FCEUI_Initialize() != 1)
+	{
+		return -1;
+	}
+	FCEUI_SetBaseDirectory(".");
+
+	// No audio device, leave synthesis off. APU timing is unaffected.
+	FCEUI_Sound(0);
+	FCEUI_SetSoundQuality(0);
+	FCEUI_SetGameGenie(false);
+	FCEUI_SetVidSystem(0);
+
+	coreInitialized = true;
+
+	return 0;
+}
+
+void fceux_core_shutdown(void)
+{
+	if (!coreInitialized)
+	{
+		return;
+	}
+	fceux_core_close_rom();
+
+	FCEU_ShmExportClose();
+
+	FCEUI_Kill();
+
+	coreInitialized = false;
+}
+
+int fceux_core_load_rom(const char *path)
+{
+	if (!coreInitialized || (path == nullptr))
+	{
+		return -1;
+	}
+	// Loading the same ROM again lets FCEUI_LoadGame() skip closing it,
+	// unless code/data logging has to start over
+	if ( (loadedPath != path) || FCEU_CDLActive() )
+	{
+		fceux_core_close_rom();
+	}
+
+	if (FCEUI_LoadGame( path, 1, true ) == nullptr)
+	{
+		fceux_core_close_rom();
+		return -1;
+	}
+	isloaded = 1;
+	loadedPath = path;
+
+	joyData = 0;
+	applyInputConfig();
+
+	return 0;
+}
+
+void fceux_core_close_rom(void)
+{
+	if (isloaded)
+	{
+		FCEU_CDLEnd();
+		FCEUI_CloseGame();
+		isloaded = 0;
+		loadedPath.clear();
+	}
+}
+
+int fceux_core_rom_loaded(void)
+{
+	return (GameInfo != nullptr);
+}
+
+void fceux_core_power(void)
+{
+	if (GameInfo)
+	{
+		FCEUI_PowerNES();
+	}
+}
+
+int fceux_core_hot_power(void)
+{
+	if (GameInfo && FCEUI_HotPowerNES())
+	{
+		return 0;
+	}
+	return -1;
+}
+
+void fceux_core_reset(void)
+{
+	if (GameInfo)
+	{
+		FCEUI_ResetNES();
+	}
+}
+
+void fceux_core_set_input(int port, uint8_t buttons)
+{
+	if ( (port < 0) || (port > 3) )
+	{
+		return;
+	}
+	const int shift = port * 8;
+
+	joyData = (joyData & ~(0xFFu << shift)) | (static_cast<uint32>(buttons) << shift);
+}
+
+void fceux_core_set_fourscore(int enable)
+{
+	fourScore = enable;
+
+	if (GameInfo)
+	{
+		FCEUI_SetInputFourscore( fourScore ? true : false );
+	}
+}
+
+int fceux_core_run_frames(int count)
+{
+	int frames = 0;
+
+	if (GameInfo == nullptr)
+	{
+		return 0;
+	}
+
+	while (frames < count)
+	{
+		uint8 *gfx = nullptr;
+		int32 *sound = nullptr;
+		int32 ssize = 0;
+
+		FCEUI_Emulate( &gfx, &sound, &ssize, 0 );
+
+		FCEU_ShmExportUpdate();
+
+		frames++;
+	}
+	FCEU_StartupTimingFinish("first_frame");
+
+	return frames;
+}
+
+int fceux_core_run_to_input_poll(int max_frames)
+{
+	int lagged = 0;
+
+	if (GameInfo == nullptr)
+	{
+		return -1;
+	}
+
+	while (lagged < max_frames)
+	{
+		fceux_core_run_frames(1);
+
+		if (!FCEUI_GetLagged())
+		{
+			break;
+		}
+		lagged++;
+	}
+	return lagged;
+}
+
+void fceux_core_set_compute_only(int enable)
+{
+	FCEUI_SetComputeOnly( enable ? true : false );
+}
+
+void fceux_core_set_idle_skip(int enable)
+{
+	FCEUI_SetIdleSkip( enable ? true : false );
+}
+
+void fceux_core_set_code_cache(int enable)
+{
+	FCEUI_SetCodeCache( enable ? true : false );
+}
+
+int fceux_core_memory_usage(uint64_t *resident, uint64_t *unshared)
+{
+	FCEU_MemoryUsage usage;
+	bool ok = FCEU_GetMemoryUsage( &usage );
+
+	if (resident)
+	{
+		*resident = usage.resident;
+	}
+	if (unshared)
+	{
+		*unshared = usage.residentAnon;
+	}
+	return ok ? 0 : -1;
+}
+
+void fceux_core_set_rom_cache(int enable)
+{
+	FCEUI_SetRomCache( enable ? true : false );
+}
+
+void fceux_core_set_boot_cache(int enable)
+{
+	FCEUI_SetBootCache( enable ? true : false );
+}
+
+int fceux_core_boot_prefix(const uint32_t *pads, int frames, const char *movie)
+{
+	std::vector<uint32> prefix;
+
+	if (movie != nullptr)
+	{
+		if (!FCEUI_BootPrefixFromMovie( movie, frames, prefix ))
+		{
+			return -1;
+		}
+	}
+	else if ( (pads != nullptr) && (frames > 0) )
+	{
+		prefix.assign( pads, pads + frames );
+	}
+	FCEU_BootCacheStats stats;
+
+	if (!FCEUI_BootFastForward( prefix, stats ))
+	{
+		return -1;
+	}
+	return stats.hit ? 1 : 0;
+}
+
+int fceux_core_scan_roms(const char *dir, const char *index_path, int threads)
+{
+	if (!coreInitialized || (dir == nullptr))
+	{
+		return -1;
+	}
+	return FCEUI_ScanRomLibrary( dir, index_path ? index_path : "", threads );
+}
+
+int fceux_core_verify_movies(const char *const *movies, int count, const char *rom, int jobs,
+                             int interval, const char *report_path)
+{
+	if (!coreInitialized || (movies == nullptr) || (count < 0))
+	{
+		return -1;
+	}
+	std::vector<std::string> list( movies, movies + count );
+	std::vector<FCEU_MovieVerifyResult> results;
+
+	int failed = FCEUI_VerifyMovies( list, rom ? rom : "", jobs, interval, results );
+	loadedPath.clear();
+
+	std::string report = FCEU_MovieVerifyReport( results );
+	FILE *fp = report_path ? fopen( report_path, "w" ) : stdout;
+
+	if (fp == nullptr)
+	{
+		return -1;
+	}
+	fwrite( report.data(), 1, report.size(), fp );
+
+	if (fp != stdout)
+	{
+		fclose( fp );
+	}
+	return failed;
+}
+
+int fceux_core_bisect_desync(const char *movie, const char *rom, int a_newppu, int a_raminit,
+                             int b_newppu, int b_raminit, int window, const char *report_path)
+{
+	if (!coreInitialized || (movie == nullptr) || (window < 0))
+	{
+		return -2;
+	}
+	FCEU_DesyncRun a, b;
+	a.newPPU = a_newppu;
+	a.ramInit = a_raminit;
+	b.newPPU = b_newppu;
+	b.ramInit = b_raminit;
+
+	FCEU_DesyncResult result;
+	bool ok = FCEUI_BisectDesync( movie, rom, a, b, window, result );
+	loadedPath.clear();
+
+	std::string report = FCEU_DesyncReport( result, a, b );
+	FILE *fp = report_path ? fopen( report_path, "w" ) : stdout;
+
+	if (fp == nullptr)
+	{
+		return -2;
+	}
+	fwrite( report.data(), 1, report.size(), fp );
+
+	if (fp != stdout)
+	{
+		fclose( fp );
+	}
+	return ok ? result.desyncFrame : -2;
+}
+
+int fceux_core_render_nsf(const char *nsf, int track, const char *output, double seconds,
+                          double silence, int jobs)
+{
+	if (!coreInitialized || (nsf == nullptr) || (output == nullptr))
+	{
+		return -1;
+	}
+	FCEU_NSFRenderSettings settings;
+	settings.seconds = seconds;
+	settings.silence = silence;
+
+	std::vector<FCEU_NSFRenderResult> results;
+	int failed = FCEUI_RenderNSF( nsf, track, output, settings, jobs, results );
+	loadedPath.clear();
+	return failed;
+}
+
+static int WriteReport(const std::string &report, const char *report_path)
+{
+	FILE *fp = report_path ? fopen( report_path, "w" ) : stdout;
+
+	if (fp == nullptr)
+	{
+		return -1;
+	}
+	fwrite( report.data(), 1, report.size(), fp );
+
+	if (fp != stdout)
+	{
+		fclose( fp );
+	}
+	return 0;
+}
+
+int fceux_core_startup_report(const char *report_path, int json)
+{
+	return WriteReport( FCEU_StartupTimingReport( json ? true : false ), report_path );
+}
+
+void fceux_core_set_profile_interval(int interval)
+{
+	FCEUI_SetStageProfileInterval( interval );
+}
+
+int fceux_core_metrics(const char *report_path, int json)
+{
+	return WriteReport( json ? FCEU_StageProfileJson() : FCEU_StageProfilePrometheus(), report_path );
+}
+
+void fceux_core_set_guest_profiler(int enable)
+{
+	FCEUI_SetGuestProfiler( enable ? true : false );
+}
+
+int fceux_core_guest_profile(const char *report_path)
+{
+	return WriteReport( FCEU_GuestProfileCollapsed(), report_path );
+}
+
+int fceux_core_search_input(const uint8_t *alphabet, int count, int depth, int frames, const char *objective,
+                            int jobs, const char *report_path)
+{
+	if ((GameInfo == nullptr) || (alphabet == nullptr) || (count <= 0) || (objective == nullptr))
+	{
+		return -1;
+	}
+	FCEU_InputSearchSettings settings;
+	settings.alphabet.assign( alphabet, alphabet + count );
+	settings.objective = objective;
+	settings.depth = depth;
+	settings.frames = frames;
+	settings.jobs = jobs;
+
+	std::vector<FCEU_InputSearchResult> results;
+	FCEU_InputSearchStats stats;
+	bool searched = FCEUI_SearchInput( settings, results, stats );
+
+	if (WriteReport( FCEU_InputSearchReport( results, stats ), report_path ) != 0 || !searched)
+	{
+		return -1;
+	}
+	return static_cast<int>(results.size());
+}
+
+static bool WriteInputs(const std::vector<FCEU_InputFuzzInput> &inputs, const char *out_dir, const char *name)
+{
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		char path[32];
+		snprintf( path, sizeof(path), "/%s-%06u.bin", name, (unsigned)i );
+
+		FILE *fp = fopen( (std::string(out_dir) + path).c_str(), "wb" );
+
+		if (fp == nullptr)
+		{
+			return false;
+		}
+		bool ok = fwrite( inputs[i].frames.data(), 1, inputs[i].frames.size(), fp ) == inputs[i].frames.size();
+
+		if ( (fclose( fp ) != 0) || !ok )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int fceux_core_fuzz_input(int frames, int execs, int jobs, uint32_t seed, const char *out_dir,
+                          const char *report_path)
+{
+	if (GameInfo == nullptr)
+	{
+		return -1;
+	}
+	if (!FCEU_CDLActive() && !FCEU_CDLBegin())
+	{
+		return -1;
+	}
+	FCEU_InputFuzzSettings settings;
+	settings.frames = frames;
+	settings.execs = execs;
+	settings.jobs = jobs;
+	settings.seed = seed;
+
+	std::vector<FCEU_InputFuzzInput> corpus, crashes;
+	FCEU_InputFuzzStats stats;
+	bool fuzzed = FCEUI_FuzzInput( settings, corpus, crashes, stats );
+
+	if (WriteReport( FCEU_InputFuzzReport( corpus, crashes, stats ), report_path ) != 0 || !fuzzed)
+	{
+		return -1;
+	}
+	if (out_dir && (!WriteInputs( corpus, out_dir, "input" ) || !WriteInputs( crashes, out_dir, "crash" )))
+	{
+		return -1;
+	}
+	return static_cast<int>(crashes.size());
+}
+
+uint32_t fceux_core_frame_count(void)
+{
+	return static_cast<uint32_t>(currFrameCounter);
+}
+
+uint32_t fceux_core_lag_count(void)
+{
+	return lagCounter;
+}
+
+uint8_t fceux_core_read_ram(uint16_t address)
+{
+	if (GameInfo == nullptr)
+	{
+		return 0;
+	}
+	return FCEU_CheatGetByte(address);
+}
+
+size_t fceux_core_read_memory(uint16_t address, uint8_t *buf, size_t length)
+{
+	size_t i;
+
+	if ( (GameInfo == nullptr) || (buf == nullptr) )
+	{
+		return 0;
+	}
+	if (length > (0x10000u - address))
+	{
+		length = 0x10000u - address;
+	}
+	for (i=0; i<length; i++)
+	{
+		buf[i] = FCEU_CheatGetByte( address + i );
+	}
+	return length;
+}
+
+void fceux_core_write_ram(uint16_t address, uint8_t value)
+{
+	if (GameInfo == nullptr)
+	{
+		return;
+	}
+	FCEU_CheatSetByte( address, value );
+}
+
+const uint8_t *fceux_core_framebuffer(void)
+{
+	return XBuf;
+}
+
+void fceux_core_framebuffer_rgb(uint8_t *buf)
+{
+	if ( (XBuf == nullptr) || (buf == nullptr) )
+	{
+		return;
+	}
+	const int numPixels = FCEUX_CORE_FRAME_WIDTH * FCEUX_CORE_FRAME_HEIGHT;
+
+	for (int i=0; i<numPixels; i++)
+	{
+		headlessGetPaletteRGB( XBuf[i], &buf[0], &buf[1], &buf[2] );
+		buf += 3;
+	}
+}
+
+size_t fceux_core_save_state(uint8_t *buf, size_t size)
+{
+	if (GameInfo == nullptr)
+	{
+		return 0;
+	}
+	if (buf == nullptr)
+	{	// counts what would be written, without writing it anywhere: the
+		// span overflows, which is what fails it here
+		EMUFILE_SPAN os( buf, 0 );
+		bool saved = FCEUSS_SaveMS( &os, Z_NO_COMPRESSION );
+
+		return (saved || os.fail()) ? os.size() : 0;
+	}
+	stateBuffer.set_len(0);
+	stateBuffer.unfail();
+
+	if (!FCEUSS_SaveMS( &stateBuffer, Z_NO_COMPRESSION ))
+	{
+		return 0;
+	}
+	size_t len = stateBuffer.size();
+
+	if ( (buf != nullptr) && (size >= len) )
+	{
+		memcpy( buf, stateBuffer.buf(), len );
+	}
+	return len;
+}
+
+int fceux_core_load_state(const uint8_t *buf, size_t size)
+{
+	if ( (GameInfo == nullptr) || (buf == nullptr) || (size == 0) )
+	{
+		return -1;
+	}
+	EMUFILE_SPAN is( buf, size );
+
+	return FCEUSS_LoadFP( &is, SSLOADPARAM_NOBACKUP ) ? 0 : -1;
+}
+
+size_t fceux_core_snapshot_size(void)
+{
+	return (GameInfo != nullptr) ? FCEUSS_SnapshotSize() : 0;
+}
+
+int fceux_core_snapshot(uint8_t *buf, size_t size)
+{
+	if (GameInfo == nullptr)
+	{
+		return -1;
+	}
+	return FCEUSS_Snapshot( buf, size ) ? 0 : -1;
+}
+
+int fceux_core_restore(const uint8_t *buf, size_t size)
+{
+	if (GameInfo == nullptr)
+	{
+		return -1;
+	}
+	return FCEUSS_Restore( buf, size ) ? 0 : -1;
+}
+
+int fceux_core_begin_capture(const char *path)
+{
+	if ( (GameInfo == nullptr) || (path == nullptr) )
+	{
+		return -1;
+	}
+	return FCEUI_BeginIndexedCapture( path ) ? 0 : -1;
+}
+
+void fceux_core_end_capture(void)
+{
+	FCEUI_EndIndexedCapture();
+}
+
+void fceux_core_set_instant_replay(int seconds)
+{
+	FCEUI_SetInstantReplay( seconds );
+}
+
+int fceux_core_save_instant_replay(const char *path)
+{
+	if (path == nullptr)
+	{
+		return -1;
+	}
+	return FCEUI_SaveInstantReplay( path ) ? 0 : -1;
+}
+
+int fceux_core_shm_open(const char *name)
+{
+	return FCEU_ShmExportOpen( name ) ? 0 : -1;
+}
+
+void fceux_core_shm_close(void)
+{
+	FCEU_ShmExportClose();
+}
+
+int fceux_core_cdl_begin(void)
+{
+	return FCEU_CDLBegin() ? 0 : -1;
+}
+
+void fceux_core_cdl_end(void)
+{
+	FCEU_CDLEnd();
+}
+
+int fceux_core_cdl_save(const char *path)
+{
+	if (path == nullptr)
+	{
+		return -1;
+	}
+	return FCEU_CDLSave( path ) ? 0 : -1;
+}
+
+int fceux_core_cdl_merge(const char *const *paths, int count, size_t prg_size, size_t bank_size,
+                         const char *out_cdl, const char *out_json)
+{
+	if ( (paths == nullptr) || (count <= 0) )
+	{
+		return -1;
+	}
+	if (prg_size == 0)
+	{
+		prg_size = FCEU_CDLPrgSize();
+	}
+	CDLCoverage cov( prg_size, bank_size );
+
+	for (int i=0; i<count; i++)
+	{
+		if ( !cov.add( paths[i] ) )
+		{
+			FCEU_printf("%s\n", cov.errorMsg().c_str());
+			return -1;
+		}
+	}
+	if ( out_cdl && !cov.saveCDL( out_cdl ) )
+	{
+		FCEU_printf("%s\n", cov.errorMsg().c_str());
+		return -1;
+	}
+	if ( out_json && !cov.saveSummary( out_json ) )
+	{
+		FCEU_printf("%s\n", cov.errorMsg().c_str());
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,306 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// fceux_core.h
+//
+// C interface to libfceux-core, the emulator core built without any GUI,
+// audio or video driver. Intended for batch workers and bindings that only
+// need to load a ROM, feed input, step frames and inspect the machine.
+//
+// Typical use:
+//
+//     fceux_core_init();
+//     fceux_core_load_rom("game.nes");
+//     for (;;)
+//     {
+//         fceux_core_set_input(0, FCEUX_CORE_BTN_RIGHT | FCEUX_CORE_BTN_A);
+//         fceux_core_run_frames(1);
+//         uint8_t lives = fceux_core_read_ram(0x075A);
+//     }
+//     fceux_core_shutdown();
+//
+// All functions must be called from the same thread.
+//
+#ifndef __FCEUX_CORE_H__
+#define __FCEUX_CORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FCEUX_CORE_BTN_A       0x01
+#define FCEUX_CORE_BTN_B       0x02
+#define FCEUX_CORE_BTN_SELECT  0x04
+#define FCEUX_CORE_BTN_START   0x08
+#define FCEUX_CORE_BTN_UP      0x10
+#define FCEUX_CORE_BTN_DOWN    0x20
+#define FCEUX_CORE_BTN_LEFT    0x40
+#define FCEUX_CORE_BTN_RIGHT   0x80
+
+#define FCEUX_CORE_FRAME_WIDTH   256
+#define FCEUX_CORE_FRAME_HEIGHT  240
+
+// Initialize the core. Returns 0 on success.
+int  fceux_core_init(void);
+
+// Release everything allocated by the core, closing any loaded game.
+void fceux_core_shutdown(void);
+
+// Load a ROM image (iNES, UNIF, FDS, NSF or an archive containing one).
+// Returns 0 on success.
+int  fceux_core_load_rom(const char *path);
+
+// Close the loaded ROM, if any.
+void fceux_core_close_rom(void);
+
+// Returns non-zero when a ROM is loaded.
+int  fceux_core_rom_loaded(void);
+
+// Hard reset (power cycle) or soft reset of the console.
+void fceux_core_power(void);
+void fceux_core_reset(void);
+
+// Put the console back in the state loading the ROM left it in, which takes
+// about as long as loading a savestate, for batch runs that start every run
+// from power on. RAM and mapper state repeat exactly between runs; battery
+// backed memory is kept. Returns 0 on success, -1 for NSF, FDS and VS System
+// games or while a movie is active, where fceux_core_power() still works.
+// Loading the ROM that is already loaded, unchanged on disk, does the same.
+int  fceux_core_hot_power(void);
+
+// Set the joypad button mask (FCEUX_CORE_BTN_*) for a port (0-3).
+// Ports 2 and 3 are only read when four score is enabled.
+void fceux_core_set_input(int port, uint8_t buttons);
+
+// Enable or disable the four score adapter.
+void fceux_core_set_fourscore(int enable);
+
+// Emulate count frames and return the number of frames emulated.
+int  fceux_core_run_frames(int count);
+
+// Emulate frames until one reads the controllers, at most max_frames, so
+// that the input set before the call is the input read by the last frame.
+// Returns the number of lag frames emulated before it (max_frames when
+// every frame lagged), or -1 when no game is loaded.
+int  fceux_core_run_to_input_poll(int max_frames);
+
+// Compute-only mode skips pixel post-processing and screen overlays while
+// keeping emulation timing exact. The framebuffer is not meaningful while it
+// is enabled; use it for search and batch runs that only inspect memory.
+void fceux_core_set_compute_only(int enable);
+
+// Idle loop skipping counts the passes of short loops that only wait on RAM
+// or $2002 instead of running them, up to the next interrupt or mapper and
+// APU event. Results stay cycle exact. Off by default.
+void fceux_core_set_idle_skip(int enable);
+
+// The code cache runs PRG ROM instructions from blocks decoded once instead
+// of fetching and decoding them every time. Results stay cycle exact. Off by
+// default.
+void fceux_core_set_code_cache(int enable);
+
+// Bytes of RAM the process holds, and of those the ones not shared with other
+// processes of the same program: what one more instance costs on the host.
+// Returns -1 where the platform does not report it (only Linux does).
+int  fceux_core_memory_usage(uint64_t *resident, uint64_t *unshared);
+
+// Remember the CRC32/MD5 of every ROM loaded, and a decompressed copy of
+// zipped or gzipped ones, in <base directory>/romcache so loading the same
+// file again skips hashing and decompression. Off by default.
+void fceux_core_set_rom_cache(int enable);
+
+// Keep the console as a fixed input prefix (an FDS BIOS boot, a logo and
+// title screen) leaves it, in <base directory>/bootcache, keyed on the ROM,
+// its battery memory, region, PPU and input settings, the prefix and the
+// build. Off by default; with it off the prefix is still run.
+void fceux_core_set_boot_cache(int enable);
+
+// Right after loading the ROM or a power cycle, get through frames frames of
+// input from the cache or by running them off screen: one pad state per
+// frame in pads (pad 1 in the low byte), or the first frames of the FM2
+// movie when movie is not NULL (frames -1 for all of it). Returns 1 when
+// the cached state was loaded, 0 when the frames were run, or -1 when the
+// console already ran, a movie is playing or the movie can not be read.
+int  fceux_core_boot_prefix(const uint32_t *pads, int frames, const char *movie);
+
+// Parse the header of every ROM under dir, on threads threads (0 for one
+// per core), without loading any of them, and merge mapper, size, region,
+// CRC32 and MD5 of each into the ROM index at index_path (NULL for
+// <base directory>/romindex.dat). Unchanged files are not parsed again.
+// Returns the number of ROMs found, or -1 on error.
+int  fceux_core_scan_roms(const char *dir, const char *index_path, int threads);
+
+// Replay each movie from its start in compute-only mode, jobs at a time
+// (0 for one per core) in worker processes where the platform has fork(),
+// and write a JSON report with the final RAM and frame hash, lag count and
+// checkpoint desyncs of each to report_path (NULL for stdout). rom may be
+// NULL to find each movie's ROM by its checksum in the ROM index or by name
+// next to the movie; interval > 0 adds the RAM hash every interval frames.
+// The loaded ROM is closed. Returns the number of movies that did not pass,
+// or -1 on error.
+int  fceux_core_verify_movies(const char *const *movies, int count, const char *rom, int jobs,
+                              int interval, const char *report_path);
+
+// Play a movie twice, under the PPU (0 old, 1 new) and RAM init option of run
+// a and of run b (-1 to keep the current PPU or the movie's RAM init), and
+// find the first frame they differ in by the hash of RAM and CPU registers.
+// The instructions of that frame are traced in both runs and the first one
+// that differs is written to the JSON report with window instructions around
+// it and the RAM bytes that differ after the frame (report_path NULL for
+// stdout). The loaded ROM is closed. Returns the desync frame, -1 when the
+// runs agree to the end, or -2 on error.
+int  fceux_core_bisect_desync(const char *movie, const char *rom, int a_newppu, int a_raminit,
+                              int b_newppu, int b_raminit, int window, const char *report_path);
+
+// Render track (1 based, 0 for all) of an NSF to a 16-bit mono WAV file at
+// 48 kHz with the picture skipped, jobs tracks at a time (0 for one per core)
+// in worker processes where the platform has fork(). Each track lasts
+// seconds, or ends once it has been silent for silence seconds (0 for
+// never). With all tracks the number is added to each output name, "out.wav"
+// giving "out-01.wav" and on. The loaded ROM is closed. Returns the number of
+// tracks that failed, or -1 when nsf is not an NSF or has no such track.
+int  fceux_core_render_nsf(const char *nsf, int track, const char *output, double seconds,
+                           double silence, int jobs);
+
+// Write the startup timing, from fceux_core_init() to the end of the first
+// frame run, as a table or as JSON when json is set to report_path (NULL
+// for stdout). Returns -1 when the file can not be written.
+int  fceux_core_startup_report(const char *report_path, int json);
+
+// Time the emulation stages (CPU, PPU lines, sound, ...) of one frame in
+// interval, 0 for none; 60 by default. fceux_core_metrics() writes the totals
+// so far in Prometheus text format, or JSON when json is set, to
+// report_path (NULL for stdout). Returns -1 when it can not be written.
+void fceux_core_set_profile_interval(int interval);
+int  fceux_core_metrics(const char *report_path, int json);
+
+// Count the CPU cycles of the game per instruction and routine, at debugger
+// speed. fceux_core_guest_profile() writes the call stacks counted so far in
+// the collapsed format of flamegraph.pl to report_path (NULL for stdout).
+// Returns -1 when it can not be written.
+void fceux_core_set_guest_profiler(int enable);
+int  fceux_core_guest_profile(const char *report_path);
+
+// Play every sequence of depth steps made of the count button sets of
+// alphabet on pad 1, each step held for frames frames, from the running
+// console, and write the ten with the highest value of objective (a debugger
+// breakpoint condition, "$0086 + $006D * #100" say) to report_path (NULL for
+// stdout), one "score: buttons of each step" line each. Sequences reaching a
+// state another one reached already are not played further. The steps below
+// the first ones run in jobs worker processes (0 for one per core) where the
+// platform has fork(). The console is left as it was. Returns the number of
+// sequences written, or -1 when the search can not run.
+int  fceux_core_search_input(const uint8_t *alphabet, int count, int depth, int frames, const char *objective,
+                             int jobs, const char *report_path);
+
+// Fuzz the input of pad 1 from the running console: execs inputs of frames
+// frames, each a mutation of one that ran PRG code no input had run before,
+// in worker processes where the platform has fork() (jobs, 0 for one per
+// core). seed picks the mutations. Starts the code/data logger when it is not
+// running (its log is the coverage) and leaves it running for
+// fceux_core_cdl_save(). Inputs that jam the CPU or wrap the stack pointer
+// are crashes. When out_dir is not NULL, every input found is written to it
+// as input-NNNNNN.bin and every crash as crash-NNNNNN.bin, one byte of
+// FCEUX_CORE_BTN_* per frame. The throughput and crashes go to report_path
+// (NULL for stdout). The console is left as it was. Returns the number of
+// crashes, or -1 when the fuzzer can not run.
+int  fceux_core_fuzz_input(int frames, int execs, int jobs, uint32_t seed, const char *out_dir,
+                           const char *report_path);
+
+// Number of frames emulated since the ROM was loaded and number of those
+// during which the game did not poll input.
+uint32_t fceux_core_frame_count(void);
+uint32_t fceux_core_lag_count(void);
+
+// Read CPU address space without side effects.
+uint8_t fceux_core_read_ram(uint16_t address);
+size_t  fceux_core_read_memory(uint16_t address, uint8_t *buf, size_t length);
+
+// Write CPU address space using the cheat interface (RAM and writable SRAM).
+void fceux_core_write_ram(uint16_t address, uint8_t value);
+
+// Emulated picture, FCEUX_CORE_FRAME_WIDTH x FCEUX_CORE_FRAME_HEIGHT palette
+// indices (one byte per pixel). Valid until the next call into the core.
+const uint8_t *fceux_core_framebuffer(void);
+
+// Convert the current picture to packed 24-bit RGB. buf must hold
+// FCEUX_CORE_FRAME_WIDTH * FCEUX_CORE_FRAME_HEIGHT * 3 bytes.
+void fceux_core_framebuffer_rgb(uint8_t *buf);
+
+// Serialize the emulator state into buf. Returns the number of bytes the
+// state requires; nothing is written if size is too small, so passing a
+// null buffer queries the size.
+size_t fceux_core_save_state(uint8_t *buf, size_t size);
+
+// Restore a state produced by fceux_core_save_state. Returns 0 on success.
+int  fceux_core_load_state(const uint8_t *buf, size_t size);
+
+// Flat snapshots for tight save/restore loops. Much faster than the
+// functions above: a plain copy of the emulator state with no headers,
+// compression or movie data. A snapshot is only valid for the ROM that was
+// loaded when it was taken. fceux_core_snapshot_size() is fixed per ROM, so
+// buffers can be allocated once and reused.
+size_t fceux_core_snapshot_size(void);
+
+// Returns 0 on success, -1 if no ROM is loaded or the buffer is too small.
+int  fceux_core_snapshot(uint8_t *buf, size_t size);
+int  fceux_core_restore(const uint8_t *buf, size_t size);
+
+// Record every following frame's palette indices, deemphasis bits and sound
+// to path in the lossless indexed capture format (see capture.h). Recording
+// stops at fceux_core_end_capture, fceux_core_close_rom or another begin.
+// Returns 0 on success.
+int  fceux_core_begin_capture(const char *path);
+void fceux_core_end_capture(void);
+
+// Keep the last seconds of play in memory (0, the default, for none), and
+// write them to path in the same capture format on a background thread.
+// Saving returns -1 when nothing is kept yet or the last save is still
+// being written.
+void fceux_core_set_instant_replay(int seconds);
+int  fceux_core_save_instant_replay(const char *path);
+
+// Publish the picture, work RAM, nametables and palette after every frame
+// run through POSIX shared memory object name ("/fceux-<pid>" when null),
+// laid out as in drivers/common/shm_export.h. Returns 0 on success.
+int  fceux_core_shm_open(const char *name);
+void fceux_core_shm_close(void);
+
+// Code/data logger for coverage runs. Begin clears the log of the loaded ROM
+// and starts logging, save writes it as a .cdl file in the layout of the
+// debugger's Code/Data Logger. Closing the ROM ends logging. Return 0 on
+// success.
+int  fceux_core_cdl_begin(void);
+void fceux_core_cdl_end(void);
+int  fceux_core_cdl_save(const char *path);
+
+// Merge count .cdl files of the same ROM into out_cdl and write a JSON
+// summary of the combined coverage, per bank of bank_size bytes and the PRG
+// ranges each file was first to hit, to out_json. Either output may be null.
+// prg_size is the PRG part of each file: 0 takes the loaded ROM's, or the
+// whole file when no ROM is loaded. bank_size 0 means 16 KB. Returns 0 on
+// success.
+int  fceux_core_cdl_merge(const char *const *paths, int count, size_t prg_size, size_t bank_size,
+                          const char *out_cdl, const char *out_json);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FCEUX_CORE_H__
@@ -0,0 +1,709 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// fceux_testrom.cpp
+//
+// fceux-testrom, the accuracy test runner of libfceux-core. Runs the test
+// ROMs of a manifest (see testrom_manifest.txt) under the old and the new
+// PPU, unthrottled and in compute-only mode, several at a time in worker
+// processes where the platform has fork(). A test passes by the $6000
+// result protocol of blargg's tests or by the hash of its last frame. The
+// results are printed as a matrix of tests by PPU, and written as JSON
+// with the frames and time each run took.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../driver.h"
+#include "../../framehash.h"
+#include "../../version.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../workerpool.h"
+#include "headless.h"
+#include "fceux_core.h"
+
+#ifndef FCEUX_TESTROM_MANIFEST
+#define FCEUX_TESTROM_MANIFEST "testrom_manifest.txt"
+#endif
+
+#ifdef WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+//*****************************************************************
+// Manifest
+//*****************************************************************
+struct TestCase
+{
+	std::string name;
+	std::string rom;        // under the ROM directory, or "builtin"
+	int  frames;            // before the test times out, or the frames hashed
+	bool hashResult;        // pass by the frame hash instead of $6000
+	uint64 hash[2];         // expected, old and new PPU
+	bool hasHash[2];
+	bool ppu[2];            // run under the old, the new PPU
+
+	TestCase() : frames(1800), hashResult(false)
+	{
+		hash[0] = hash[1] = 0;
+		hasHash[0] = hasHash[1] = false;
+		ppu[0] = ppu[1] = true;
+	}
+};
+
+enum
+{
+	TEST_PASSED = 0,
+	TEST_FAILED,
+	TEST_TIMEOUT,
+	TEST_SKIPPED,
+	TEST_ERROR,
+};
+
+static const char *statusNames[] = { "passed", "failed", "timeout", "skipped", "error" };
+
+// one test under one PPU, sent back from the worker as it is
+struct TestRun
+{
+	int    test;
+	int    newPPU;
+	int    status;
+	int    code;            // $6000 result, -1 for none
+	int    frames;
+	double seconds;
+	uint64 hash;            // of the last frame, hash tests
+	char   message[256];    // the text at $6004, or why it did not run
+};
+
+static std::string Trim(const std::string &s)
+{
+	size_t b = s.find_first_not_of(" \t\r\n");
+	size_t e = s.find_last_not_of(" \t\r\n");
+
+	return (b == std::string::npos) ? "" : s.substr(b, e - b + 1);
+}
+
+static std::vector<std::string> SplitWords(const std::string &s)
+{
+	std::vector<std::string> words;
+	size_t i = 0;
+
+	while (i < s.size())
+	{
+		size_t b = s.find_first_not_of(" \t", i);
+
+		if (b == std::string::npos)
+		{
+			break;
+		}
+		size_t e = s.find_first_of(" \t", b);
+
+		if (e == std::string::npos)
+		{
+			e = s.size();
+		}
+		words.push_back( s.substr(b, e - b) );
+		i = e;
+	}
+	return words;
+}
+
+static bool ParseHash(const std::string &value, uint64 &hash)
+{
+	char *end = nullptr;
+
+	hash = strtoull( value.c_str(), &end, 16 );
+
+	return !value.empty() && (*end == 0);
+}
+
+// "name key=value ..." per line, # for comments
+static bool ReadManifest(const char *path, std::vector<TestCase> &tests)
+{
+	FILE *fp = fopen( path, "rb" );
+
+	if (fp == nullptr)
+	{
+		fprintf( stderr, "cannot read manifest %s\n", path );
+		return false;
+	}
+	char buf[1024];
+	int lineNo = 0;
+	bool ok = true;
+
+	while (ok && fgets( buf, sizeof(buf), fp ))
+	{
+		std::string line = buf;
+
+		lineNo++;
+		line = Trim( line.substr(0, line.find('#')) );
+
+		if (line.empty())
+		{
+			continue;
+		}
+		std::vector<std::string> words = SplitWords( line );
+		TestCase t;
+
+		t.name = words[0];
+
+		for (size_t w = 1; ok && (w < words.size()); w++)
+		{
+			size_t eq = words[w].find('=');
+			std::string key = words[w].substr(0, eq);
+			std::string value = (eq == std::string::npos) ? "" : words[w].substr(eq + 1);
+
+			if      (key == "rom")      t.rom = value;
+			else if (key == "frames")   t.frames = atoi( value.c_str() );
+			else if (key == "hash")     ok = t.hasHash[0] = ParseHash( value, t.hash[0] );
+			else if (key == "hash_new") ok = t.hasHash[1] = ParseHash( value, t.hash[1] );
+			else if (key == "result" && (value == "6000" || value == "hash"))
+			{
+				t.hashResult = (value == "hash");
+			}
+			else if (key == "ppu" && (value == "both" || value == "old" || value == "new"))
+			{
+				t.ppu[0] = (value != "new");
+				t.ppu[1] = (value != "old");
+			}
+			else
+			{
+				ok = false;
+			}
+			if (!ok)
+			{
+				fprintf( stderr, "manifest line %d: bad setting '%s'\n", lineNo, words[w].c_str() );
+			}
+		}
+		if (ok && (t.rom.empty() || (t.frames <= 0)))
+		{
+			fprintf( stderr, "manifest line %d: %s needs rom= and frames= above 0\n", lineNo, t.name.c_str() );
+			ok = false;
+		}
+		// the old PPU's hash stands for both unless the new one has its own
+		if (!t.hasHash[1])
+		{
+			t.hasHash[1] = t.hasHash[0];
+			t.hash[1] = t.hash[0];
+		}
+		tests.push_back( t );
+	}
+	fclose( fp );
+
+	return ok;
+}
+
+//*****************************************************************
+// Built in test, so the runner has a case without any files: NROM,
+// reporting "passed" through $6000 with the signature and text.
+//*****************************************************************
+static const uint8 builtinProgram[] =
+{
+	0x78,             // SEI
+	0xD8,             // CLD
+	0xA2, 0xFF,       // LDX #$FF
+	0x9A,             // TXS
+	0xA9, 0x80,       // LDA #$80
+	0x8D, 0x00, 0x60, // STA $6000   running
+	0xA9, 0xDE,       // LDA #$DE
+	0x8D, 0x01, 0x60, // STA $6001
+	0xA9, 0xB0,       // LDA #$B0
+	0x8D, 0x02, 0x60, // STA $6002
+	0xA9, 0x61,       // LDA #$61
+	0x8D, 0x03, 0x60, // STA $6003
+	0xA2, 0x00,       // LDX #0
+	0xBD, 0x2E, 0x80, // $801B: LDA $802E,X
+	0x9D, 0x04, 0x60, // STA $6004,X
+	0xF0, 0x03,       // BEQ +3
+	0xE8,             // INX
+	0xD0, 0xF5,       // BNE -11
+	0xA9, 0x00,       // LDA #0
+	0x8D, 0x00, 0x60, // STA $6000   passed
+	0x4C, 0x2B, 0x80, // $802B: JMP $802B
+	'b', 'u', 'i', 'l', 't', 'i', 'n', ' ', 'p', 'a', 's', 's', 'e', 'd', '\n', 0,
+};
+
+static std::string BuiltinRomPath(void)
+{
+#ifdef WIN32
+	const char *dir = getenv("TEMP");
+#else
+	const char *dir = getenv("TMPDIR");
+#endif
+	return std::string( dir ? dir : "/tmp" ) + "/fceux-testrom-builtin.nes";
+}
+
+static bool WriteBuiltinRom(const std::string &path)
+{
+	std::vector<uint8> image( 16 + 0x4000 + 0x2000, 0 );
+	uint8 *prg = &image[16];
+
+	memcpy( &image[0], "NES\x1a\x01\x01", 6 );
+	memcpy( prg, builtinProgram, sizeof(builtinProgram) );
+
+	// NMI, RESET and IRQ $8000
+	prg[0x3FFA] = 0x00; prg[0x3FFB] = 0x80;
+	prg[0x3FFC] = 0x00; prg[0x3FFD] = 0x80;
+	prg[0x3FFE] = 0x00; prg[0x3FFF] = 0x80;
+
+	FILE *fp = fopen( path.c_str(), "wb" );
+
+	if (fp == nullptr)
+	{
+		return false;
+	}
+	bool ok = fwrite( &image[0], 1, image.size(), fp ) == image.size();
+
+	return (fclose( fp ) == 0) && ok;
+}
+
+//*****************************************************************
+// Running a test
+//*****************************************************************
+static double Now(void)
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static std::string RomPath(const TestCase &t, const std::string &romDir)
+{
+	return (t.rom == "builtin") ? BuiltinRomPath() : romDir + "/" + t.rom;
+}
+
+static bool FileExists(const std::string &path)
+{
+	FILE *fp = fopen( path.c_str(), "rb" );
+
+	if (fp == nullptr)
+	{
+		return false;
+	}
+	fclose( fp );
+	return true;
+}
+
+// blargg's tests ask for the reset after this many frames (100 ms) or more
+static const int RESET_DELAY = 6;
+
+static void RunTest(const TestCase &t, const std::string &rom, TestRun &run)
+{
+	fceux_core_close_rom();
+
+	newppu = run.newPPU;
+
+	if (fceux_core_load_rom( rom.c_str() ) != 0)
+	{
+		run.status = TEST_ERROR;
+		snprintf( run.message, sizeof(run.message), "cannot load ROM" );
+		return;
+	}
+	fceux_core_set_compute_only( 1 );
+	run.status = TEST_TIMEOUT;
+
+	int resetAt = -1;
+	double start = Now();
+
+	for (run.frames = 0; run.frames < t.frames; )
+	{
+		// the last frame is drawn, for the frame hash
+		if (t.hashResult && (run.frames == t.frames - 1))
+		{
+			fceux_core_set_compute_only( 0 );
+		}
+		fceux_core_run_frames( 1 );
+		run.frames++;
+
+		if (t.hashResult)
+		{
+			continue;
+		}
+		uint8_t mem[4];
+
+		fceux_core_read_memory( 0x6000, mem, sizeof(mem) );
+
+		if ( (mem[1] != 0xDE) || (mem[2] != 0xB0) || (mem[3] != 0x61) || (mem[0] == 0x80) )
+		{
+			continue;
+		}
+		if (mem[0] == 0x81)
+		{
+			if (resetAt < 0)
+			{
+				resetAt = run.frames + RESET_DELAY;
+			}
+			else if (run.frames >= resetAt)
+			{
+				fceux_core_reset();
+				resetAt = -1;
+			}
+			continue;
+		}
+		uint8_t text[sizeof(run.message)];
+
+		fceux_core_read_memory( 0x6004, text, sizeof(text) - 1 );
+		text[sizeof(text) - 1] = 0;
+		snprintf( run.message, sizeof(run.message), "%s", Trim( (const char *)text ).c_str() );
+
+		run.code = mem[0];
+		run.status = (mem[0] == 0) ? TEST_PASSED : TEST_FAILED;
+		break;
+	}
+	run.seconds = Now() - start;
+
+	if (t.hashResult)
+	{
+		if (!FCEUI_GetFrameHash( &run.hash, nullptr ))
+		{
+			run.hash = 0;
+		}
+		run.status = (t.hasHash[run.newPPU] && (run.hash == t.hash[run.newPPU])) ? TEST_PASSED : TEST_FAILED;
+
+		if (!t.hasHash[run.newPPU])
+		{
+			snprintf( run.message, sizeof(run.message), "no hash in the manifest" );
+		}
+	}
+	else if (run.status == TEST_TIMEOUT)
+	{
+		snprintf( run.message, sizeof(run.message), "no result after %d frames", t.frames );
+	}
+	fceux_core_set_compute_only( 0 );
+	fceux_core_close_rom();
+	newppu = 0;
+}
+
+#ifdef FCEU_WORKER_POOL
+// one forked copy of the emulator per run, at most jobs at a time; the runs
+// whose worker could not be started are left in pending
+static void RunInWorkers(const std::vector<TestCase> &tests, const std::string &romDir, std::vector<TestRun> &runs,
+	std::vector<size_t> &pending, int jobs)
+{
+	FCEU_RunInWorkers( pending, jobs,
+		[&](size_t index, std::vector<uint8> &reply)
+		{
+			TestRun &run = runs[index];
+
+			RunTest( tests[run.test], RomPath( tests[run.test], romDir ), run );
+			reply.assign( (const uint8 *)&run, (const uint8 *)&run + sizeof(run) );
+		},
+		[&](size_t index, const std::vector<uint8> &reply, const std::string &error)
+		{
+			TestRun &run = runs[index];
+
+			if (error.empty() && (reply.size() == sizeof(run)))
+			{
+				memcpy( &run, &reply[0], sizeof(run) );
+			}
+			else
+			{
+				run.status = TEST_ERROR;
+				snprintf( run.message, sizeof(run.message), "%s", error.empty() ? "worker failed" : error.c_str() );
+			}
+		} );
+}
+#endif
+
+//*****************************************************************
+// Report
+//*****************************************************************
+static std::string JsonString(const std::string &s)
+{
+	std::string out = "\"";
+
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		char c = s[i];
+
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			char esc[8];
+			snprintf( esc, sizeof(esc), "\\u%04x", c );
+			out += esc;
+		}
+		else
+		{
+			out += c;
+		}
+	}
+	return out + "\"";
+}
+
+static std::string Report(const std::vector<TestCase> &tests, const std::vector<TestRun> &runs)
+{
+	std::string out;
+	char line[512];
+
+	out += "{\n  \"version\": " + JsonString( FCEU_NAME_AND_VERSION );
+	out += ",\n  \"tests\": [";
+
+	for (size_t i = 0; i < tests.size(); i++)
+	{
+		const TestCase &t = tests[i];
+		bool first = true;
+
+		out += (i ? ",\n    {" : "\n    {");
+		out += "\"name\": " + JsonString( t.name );
+		out += ", \"rom\": " + JsonString( t.rom );
+		out += std::string(", \"result\": \"") + (t.hashResult ? "hash" : "6000") + "\", \"runs\": [";
+
+		for (size_t r = 0; r < runs.size(); r++)
+		{
+			const TestRun &run = runs[r];
+
+			if (run.test != (int)i)
+			{
+				continue;
+			}
+			snprintf( line, sizeof(line), "%s\n      {\"ppu\": \"%s\", \"status\": \"%s\", \"code\": %d, \"frames\": %d, \"seconds\": %.3f, \"fps\": %.1f",
+				first ? "" : ",", run.newPPU ? "new" : "old", statusNames[run.status], run.code, run.frames,
+				run.seconds, (run.seconds > 0) ? run.frames / run.seconds : 0.0 );
+			out += line;
+
+			if (t.hashResult)
+			{
+				snprintf( line, sizeof(line), ", \"hash\": \"%016llx\"", (unsigned long long)run.hash );
+				out += line;
+			}
+			out += ", \"message\": " + JsonString( run.message ) + "}";
+			first = false;
+		}
+		out += "\n    ]}";
+	}
+	out += "\n  ]\n}\n";
+
+	return out;
+}
+
+// tests down, PPUs across, and the totals
+static void PrintMatrix(const std::vector<TestCase> &tests, const std::vector<TestRun> &runs)
+{
+	size_t width = 4;
+	int count[TEST_ERROR + 1] = { 0 };
+
+	for (size_t i = 0; i < tests.size(); i++)
+	{
+		width = std::max( width, tests[i].name.size() );
+	}
+	printf( "%-*s  %-12s  %-12s\n", (int)width, "test", "old PPU", "new PPU" );
+
+	for (size_t i = 0; i < tests.size(); i++)
+	{
+		std::string cell[2] = { "-", "-" };
+
+		for (size_t r = 0; r < runs.size(); r++)
+		{
+			const TestRun &run = runs[r];
+			char text[32];
+
+			if (run.test != (int)i)
+			{
+				continue;
+			}
+			if (run.status == TEST_FAILED && run.code >= 0)
+			{
+				snprintf( text, sizeof(text), "failed #%d", run.code );
+			}
+			else
+			{
+				snprintf( text, sizeof(text), "%s", statusNames[run.status] );
+			}
+			cell[run.newPPU] = text;
+			count[run.status]++;
+		}
+		printf( "%-*s  %-12s  %-12s\n", (int)width, tests[i].name.c_str(), cell[0].c_str(), cell[1].c_str() );
+	}
+	printf( "\n%d passed, %d failed, %d timed out, %d skipped, %d errors\n",
+		count[TEST_PASSED], count[TEST_FAILED], count[TEST_TIMEOUT], count[TEST_SKIPPED], count[TEST_ERROR] );
+}
+
+static void ShowUsage(const char *prog)
+{
+	printf(
+"Usage: %s [options]\n"
+"\n"
+"Runs the test ROMs of a manifest under the old and the new PPU through\n"
+"libfceux-core, unthrottled and several at a time, and prints a matrix of\n"
+"the results.\n"
+"\n"
+"--manifest f      Manifest file, default %s\n"
+"--rom-dir  d      Directory the ROMs of the manifest are in, default .\n"
+"--test     name   Only run the tests whose name starts with name.\n"
+"--jobs     n      Tests run at a time, default one per core.\n"
+"--json     f      Also write a JSON report with the frames and time of each run to f.\n"
+"--verbose         Show the messages of the emulator.\n",
+		prog, FCEUX_TESTROM_MANIFEST );
+}
+
+int main(int argc, char *argv[])
+{
+	const char *manifestPath = FCEUX_TESTROM_MANIFEST;
+	const char *jsonPath = nullptr;
+	std::string romDir = ".";
+	std::string only;
+	int  jobs = 0;
+	bool verbose = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+
+		if      (arg == "--manifest" && hasValue) manifestPath = argv[++i];
+		else if (arg == "--rom-dir"  && hasValue) romDir = argv[++i];
+		else if (arg == "--test"     && hasValue) only = argv[++i];
+		else if (arg == "--jobs"     && hasValue) jobs = atoi( argv[++i] );
+		else if (arg == "--json"     && hasValue) jsonPath = argv[++i];
+		else if (arg == "--verbose") verbose = true;
+		else
+		{
+			ShowUsage( argv[0] );
+			return (arg == "-h" || arg == "--help") ? 0 : 1;
+		}
+	}
+	if (jobs <= 0)
+	{
+		jobs = std::max( 1, (int)std::thread::hardware_concurrency() );
+	}
+
+	std::vector<TestCase> manifest, tests;
+
+	if (!ReadManifest( manifestPath, manifest ))
+	{
+		return 1;
+	}
+	for (size_t i = 0; i < manifest.size(); i++)
+	{
+		if (manifest[i].name.compare(0, only.size(), only) == 0)
+		{
+			tests.push_back( manifest[i] );
+		}
+	}
+
+	if (!WriteBuiltinRom( BuiltinRomPath() ))
+	{
+		fprintf( stderr, "cannot write %s\n", BuiltinRomPath().c_str() );
+		return 1;
+	}
+	FILE *messages = verbose ? stderr : fopen( NULL_DEVICE, "w" );
+
+	headlessSetMessageFile( messages ? messages : stderr );
+
+	if (fceux_core_init() != 0)
+	{
+		fprintf( stderr, "cannot initialize the core\n" );
+		return 1;
+	}
+
+	// one run per test and PPU, those without a ROM are skipped here
+	std::vector<TestRun> runs;
+	std::vector<size_t> pending;
+
+	for (size_t i = 0; i < tests.size(); i++)
+	{
+		bool found = FileExists( RomPath( tests[i], romDir ) );
+
+		for (int ppu = 0; ppu < 2; ppu++)
+		{
+			if (!tests[i].ppu[ppu])
+			{
+				continue;
+			}
+			TestRun run;
+			memset( &run, 0, sizeof(run) );
+			run.test = (int)i;
+			run.newPPU = ppu;
+			run.code = -1;
+
+			if (!found)
+			{
+				run.status = TEST_SKIPPED;
+				snprintf( run.message, sizeof(run.message), "ROM not found" );
+			}
+			else
+			{
+				pending.push_back( runs.size() );
+			}
+			runs.push_back( run );
+		}
+	}
+
+	double start = Now();
+
+#ifdef FCEU_WORKER_POOL
+	RunInWorkers( tests, romDir, runs, pending, jobs );
+#endif
+	// no workers here, run the rest one after another
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		TestRun &run = runs[pending[i]];
+
+		RunTest( tests[run.test], RomPath( tests[run.test], romDir ), run );
+	}
+	double seconds = Now() - start;
+
+	fceux_core_shutdown();
+	remove( BuiltinRomPath().c_str() );
+
+	if (messages && (messages != stderr))
+	{
+		headlessSetMessageFile( nullptr );
+		fclose( messages );
+	}
+
+	PrintMatrix( tests, runs );
+	printf( "%.2f seconds\n", seconds );
+
+	if (jsonPath)
+	{
+		std::string report = Report( tests, runs );
+		FILE *fp = fopen( jsonPath, "w" );
+
+		if (fp == nullptr)
+		{
+			fprintf( stderr, "cannot write %s\n", jsonPath );
+			return 1;
+		}
+		fwrite( report.data(), 1, report.size(), fp );
+		fclose( fp );
+	}
+
+	int failed = 0;
+
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		if (runs[i].status != TEST_PASSED && runs[i].status != TEST_SKIPPED)
+		{
+			failed++;
+		}
+	}
+	return failed ? 1 : 0;
+}
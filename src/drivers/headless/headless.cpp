@@ -0,0 +1,228 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// headless.cpp
+//
+// Minimal driver layer for libfceux-core. Everything the core expects from a
+// driver is either implemented trivially here or left as a no-op.
+//
+#include <stdio.h>
+#include <string.h>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../driver.h"
+#include "../../file.h"
+#include "../../emufile.h"
+#include "../../utils/timeStamp.h"
+
+#include "headless.h"
+
+//*****************************************************************
+// Define Global Variables to be shared with FCEU Core
+//*****************************************************************
+int  dendy = 0;
+int eoptions=0;
+int isloaded=0;
+int pal_emulation=0;
+int closeFinishedMovie = 0;
+int KillFCEUXonFrame = 0;
+
+bool swapDuty = 0;
+bool turbo = false;
+
+static struct
+{
+	uint8 r, g, b;
+} palette[256];
+
+static uint32 paletteSerial = 0;
+
+static unsigned int keyboardState[256] = { 0 };
+
+//*****************************************************************
+// Video and palette
+//*****************************************************************
+void FCEUD_SetPalette(uint8 index, uint8 r, uint8 g, uint8 b)
+{
+	palette[index].r = r;
+	palette[index].g = g;
+	palette[index].b = b;
+
+	paletteSerial++;
+}
+
+void FCEUD_GetPalette(uint8 index, uint8 *r, uint8 *g, uint8 *b)
+{
+	*r = palette[index].r;
+	*g = palette[index].g;
+	*b = palette[index].b;
+}
+
+void headlessGetPaletteRGB(uint8 index, uint8 *r, uint8 *g, uint8 *b)
+{
+	FCEUD_GetPalette( index, r, g, b );
+}
+
+uint32 headlessPaletteSerial(void)
+{
+	return paletteSerial;
+}
+
+void FCEUD_Update(uint8 *XBuf, int32 *Buffer, int Count)
+{
+	// Frames are consumed by the embedding application directly from the core.
+}
+
+void FCEUD_VideoChanged(void) {}
+void FCEUD_UpdateNTView(int scanline, bool drawall) {}
+void FCEUD_UpdatePPUView(int scanline, int drawall) {}
+bool FCEUD_ShouldDrawInputAids(void) { return false; }
+int  FCEUD_ShowStatusIcon(void) { return 0; }
+void FCEUD_ToggleStatusIcon(void) {}
+void FCEUD_HideMenuToggle(void) {}
+
+//*****************************************************************
+// Messages
+//*****************************************************************
+void FCEUD_PrintError(const char *errormsg)
+{
+	fprintf(stderr, "%s\n", errormsg);
+}
+
+static FILE *messageFile = nullptr;
+
+void headlessSetMessageFile(FILE *fp)
+{
+	messageFile = fp;
+}
+
+void FCEUD_Message(const char *text)
+{
+	fputs(text, messageFile ? messageFile : stdout);
+}
+
+const char *FCEUD_GetCompilerString(void)
+{
+	return __VERSION__;
+}
+
+//*****************************************************************
+// Timing
+//*****************************************************************
+uint64 FCEUD_GetTime(void)
+{
+	FCEU::timeStampRecord ts;
+
+	ts.readNew();
+
+	return ts.toCounts();
+}
+
+uint64 FCEUD_GetTimeFreq(void)
+{
+	return FCEU::timeStampRecord::countFreq();
+}
+
+void RefreshThrottleFPS(void) {}
+void FCEUD_SetEmulationSpeed(int cmd) {}
+void FCEUD_TurboOn(void) {}
+void FCEUD_TurboOff(void) {}
+void FCEUD_TurboToggle(void) {}
+
+//*****************************************************************
+// Files and archives
+//*****************************************************************
+FILE *FCEUD_UTF8fopen(const char *fn, const char *mode)
+{
+	return fopen(fn,mode);
+}
+
+EMUFILE_FILE* FCEUD_UTF8_fstream(const char *fn, const char *m)
+{
+	return new EMUFILE_FILE(fn, m);
+}
+
+// Archive support is provided by the GUI drivers. An invalid scan record makes
+// FCEU_fopen fall back to plain files, zip and gzip handling.
+ArchiveScanRecord FCEUD_ScanArchive(std::string fname)
+{
+	return ArchiveScanRecord();
+}
+
+FCEUFILE* FCEUD_OpenArchive(ArchiveScanRecord& asr, std::string& fname, std::string* innerFilename)
+{
+	return nullptr;
+}
+
+FCEUFILE* FCEUD_OpenArchive(ArchiveScanRecord& asr, std::string& fname, std::string* innerFilename, int* userCancel)
+{
+	return nullptr;
+}
+
+FCEUFILE* FCEUD_OpenArchiveIndex(ArchiveScanRecord& asr, std::string& fname, int innerIndex)
+{
+	return nullptr;
+}
+
+FCEUFILE* FCEUD_OpenArchiveIndex(ArchiveScanRecord& asr, std::string& fname, int innerIndex, int* userCancel)
+{
+	return nullptr;
+}
+
+//*****************************************************************
+// Input
+//*****************************************************************
+unsigned int *GetKeyboard(void)
+{
+	return keyboardState;
+}
+
+void GetMouseData(uint32 (&md)[3])
+{
+	md[0] = md[1] = md[2] = 0;
+}
+
+void FCEUD_SetInput(bool fourscore, bool microphone, ESI port0, ESI port1, ESIFC fcexp) {}
+void FCEUI_UseInputPreset(int preset) {}
+
+//*****************************************************************
+// Driver UI hooks invoked by core commands, not available headless
+//*****************************************************************
+void FCEUD_SoundToggle(void) {}
+void FCEUD_SoundVolumeAdjust(int n) {}
+void FCEUD_SaveStateAs(void) {}
+void FCEUD_LoadStateFrom(void) {}
+void FCEUD_MovieRecordTo(void) {}
+void FCEUD_MovieReplayFrom(void) {}
+void FCEUD_AviRecordTo(void) {}
+void FCEUD_AviStop(void) {}
+bool FCEUD_PauseAfterPlayback(void) { return false; }
+void FCEUD_DebugBreakpoint(int bp_num) {}
+void FCEUD_FlushTrace(void) {}
+
+bool FCEUI_AviIsRecording(void) { return false; }
+bool FCEUI_AviEnableHUDrecording(void) { return false; }
+bool FCEUI_AviDisableMovieMessages(void) { return true; }
+void FCEUI_AviVideoUpdate(const unsigned char* buffer) {}
+
+//*****************************************************************
+// Netplay
+//*****************************************************************
+int FCEUD_SendData(void *data, uint32 len) { return 1; }
+int FCEUD_RecvData(void *data, uint32 len) { return 1; }
+void FCEUD_NetworkClose(void) {}
+void FCEUD_NetplayText(uint8 *text) {}
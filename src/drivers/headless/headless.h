@@ -0,0 +1,30 @@
+#ifndef __FCEU_HEADLESS_H
+#define __FCEU_HEADLESS_H
+
+// Driver declarations shared with the core when building libfceux-core.
+// The headless driver has no display, audio device or event loop; frames
+// are only produced when the embedding application asks for them.
+
+#include <stdio.h>
+
+#include "../../types.h"
+#include "../../driver.h"
+
+extern int isloaded;
+
+extern int dendy;
+extern int pal_emulation;
+extern int eoptions;
+extern bool swapDuty;
+
+void FCEUD_Update(uint8 *XBuf, int32 *Buffer, int Count);
+uint64 FCEUD_GetTime();
+uint64 FCEUD_GetTimeFreq(void);
+
+// Where FCEUD_Message() writes, stdout when null
+void headlessSetMessageFile(FILE *fp);
+
+// Changes whenever the core sets a palette entry
+uint32 headlessPaletteSerial(void);
+
+#endif
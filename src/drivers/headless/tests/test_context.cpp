@@ -0,0 +1,106 @@
+/**
+ * Unit tests for FCEU::Context on the headless core
+ */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../../../types.h"
+#include "../../../context.h"
+#include "../fceux_core.h"
+
+// NROM image that loops incrementing the zero page byte at addr
+static std::string writeRom(const char *name, uint8_t addr) {
+    const char *dir = getenv("TMPDIR");
+    std::string path = std::string(dir ? dir : "/tmp") + "/" + name;
+    std::vector<uint8_t> image(16 + 0x4000 + 0x2000, 0);
+    uint8_t *prg = &image[16];
+    const uint8_t program[] = {
+        0x78,             // SEI
+        0xE6, addr,       // $8001: INC addr
+        0x4C, 0x01, 0x80, // JMP $8001
+    };
+
+    memcpy(&image[0], "NES\x1a\x01\x01", 6);
+    memcpy(prg, program, sizeof(program));
+    prg[0x3FFA] = 0x00; prg[0x3FFB] = 0x80;
+    prg[0x3FFC] = 0x00; prg[0x3FFD] = 0x80;
+    prg[0x3FFE] = 0x00; prg[0x3FFF] = 0x80;
+
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (fp) {
+        fwrite(&image[0], 1, image.size(), fp);
+        fclose(fp);
+    }
+    return path;
+}
+
+class ContextTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(fceux_core_init(), 0);
+        romA = writeRom("fceux-context-a.nes", 0x10);
+        romB = writeRom("fceux-context-b.nes", 0x20);
+    }
+
+    void TearDown() override {
+        fceux_core_close_rom();
+        remove(romA.c_str());
+        remove(romB.c_str());
+    }
+
+    std::string romA, romB;
+};
+
+TEST_F(ContextTest, CaptureAndActivate) {
+    ASSERT_EQ(fceux_core_load_rom(romA.c_str()), 0);
+    fceux_core_run_frames(2);
+
+    FCEU::Context ctx;
+    ASSERT_TRUE(ctx.capture());
+    uint8_t saved = fceux_core_read_ram(0x10);
+
+    fceux_core_run_frames(3);
+    EXPECT_NE(fceux_core_read_ram(0x10), saved);
+
+    ASSERT_TRUE(ctx.activate());
+    EXPECT_EQ(fceux_core_read_ram(0x10), saved);
+}
+
+TEST_F(ContextTest, ActivateFailsAfterGameChange) {
+    ASSERT_EQ(fceux_core_load_rom(romA.c_str()), 0);
+    fceux_core_run_frames(2);
+
+    FCEU::Context ctx;
+    ASSERT_TRUE(ctx.capture());
+    EXPECT_TRUE(ctx.isValid());
+
+    ASSERT_EQ(fceux_core_load_rom(romB.c_str()), 0);
+    fceux_core_run_frames(2);
+    uint8_t running = fceux_core_read_ram(0x20);
+
+    EXPECT_FALSE(ctx.isValid());
+    EXPECT_FALSE(ctx.activate());
+    EXPECT_FALSE(ctx.isActive());
+    EXPECT_EQ(fceux_core_read_ram(0x20), running);
+
+    // captured again, the context belongs to the new game
+    ASSERT_TRUE(ctx.capture());
+    EXPECT_TRUE(ctx.activate());
+}
+
+TEST_F(ContextTest, ActivateFailsAfterClosingTheGame) {
+    ASSERT_EQ(fceux_core_load_rom(romA.c_str()), 0);
+
+    FCEU::Context ctx;
+    ASSERT_TRUE(ctx.capture());
+
+    // the same ROM loaded again is another cart as far as contexts go
+    fceux_core_close_rom();
+    ASSERT_EQ(fceux_core_load_rom(romA.c_str()), 0);
+    EXPECT_FALSE(ctx.activate());
+}
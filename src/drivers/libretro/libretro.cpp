@@ -0,0 +1,509 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// libretro.cpp
+//
+// libretro core (fceux_libretro) on top of libfceux-core. The frontend
+// owns the display, audio device and input; the headless driver layer
+// stands in for the rest of the driver.
+//
+// Savestates are flat snapshots: a constant size for the loaded game, no
+// chunk headers and no zlib, so a frontend can serialize every frame for
+// run-ahead, rewind and netplay. Frames are translated to XRGB8888 through
+// the palette table of the common blitter, sound goes out in one batch.
+//
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include <string>
+
+#include "libretro.h"
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../driver.h"
+#include "../../cheat.h"
+#include "../../state.h"
+#include "../../version.h"
+#include "../common/vidblit.h"
+#include "../headless/headless.h"
+
+#define LIBRETRO_SOUND_RATE  48000
+#define LIBRETRO_MAX_SAMPLES 4096   // a frame at 48 kHz is 800, 960 on PAL
+
+static retro_environment_t        environ_cb = NULL;
+static retro_video_refresh_t      video_cb = NULL;
+static retro_audio_sample_t       audio_cb = NULL;
+static retro_audio_sample_batch_t audio_batch_cb = NULL;
+static retro_input_poll_t         input_poll_cb = NULL;
+static retro_input_state_t        input_state_cb = NULL;
+
+static uint32 joyData = 0;
+static uint32 paletteSerial = 0;
+static bool   paletteValid = false;
+static std::string saveDir;
+static std::string systemDir;
+
+static uint32 frameBuf[256 * 240];
+static int16  soundBuf[LIBRETRO_MAX_SAMPLES * 2];
+
+// NES pad bits, in the order of FCEUX_CORE_BTN_*
+static const unsigned padMap[8] =
+{
+	RETRO_DEVICE_ID_JOYPAD_A,
+	RETRO_DEVICE_ID_JOYPAD_B,
+	RETRO_DEVICE_ID_JOYPAD_SELECT,
+	RETRO_DEVICE_ID_JOYPAD_START,
+	RETRO_DEVICE_ID_JOYPAD_UP,
+	RETRO_DEVICE_ID_JOYPAD_DOWN,
+	RETRO_DEVICE_ID_JOYPAD_LEFT,
+	RETRO_DEVICE_ID_JOYPAD_RIGHT,
+};
+
+extern uint8 *XBuf;
+extern void headlessGetPaletteRGB(uint8 index, uint8 *r, uint8 *g, uint8 *b);
+
+static void getRenderedLines(int *first, int *count)
+{
+	int slstart = 0, slend = 239;
+
+	FCEUI_GetCurrentVidSystem( &slstart, &slend );
+
+	if ( (slstart < 0) || (slend > 239) || (slend < slstart) )
+	{
+		slstart = 0;
+		slend = 239;
+	}
+	*first = slstart;
+	*count = slend - slstart + 1;
+}
+
+// The blitter's table is rebuilt only when the core changed the palette
+static void updatePalette(void)
+{
+	uint32 serial = headlessPaletteSerial();
+
+	if ( paletteValid && (serial == paletteSerial) )
+	{
+		return;
+	}
+	uint8 pal[256 * 4];
+
+	for (int i = 0; i < 256; i++)
+	{
+		headlessGetPaletteRGB( i, &pal[i*4], &pal[i*4+1], &pal[i*4+2] );
+		pal[i*4+3] = 0;
+	}
+	SetPaletteBlitToHigh( pal );
+
+	paletteSerial = serial;
+	paletteValid = true;
+}
+
+static void updateInput(void)
+{
+	uint32 data = 0;
+
+	input_poll_cb();
+
+	for (unsigned port = 0; port < 2; port++)
+	{
+		for (int bit = 0; bit < 8; bit++)
+		{
+			if ( input_state_cb( port, RETRO_DEVICE_JOYPAD, 0, padMap[bit] ) )
+			{
+				data |= 1u << (port * 8 + bit);
+			}
+		}
+	}
+	joyData = data;
+}
+
+static void outputVideo(uint8 *gfx)
+{
+	int first, count;
+
+	if ( gfx == NULL )
+	{
+		// frame skipped, the frontend shows the last one again
+		video_cb( NULL, 256, 240, 256 * sizeof(uint32) );
+		return;
+	}
+	getRenderedLines( &first, &count );
+
+	updatePalette();
+
+	Blit8ToHigh( gfx + first * 256, (uint8*)frameBuf, 256, count, 256 * sizeof(uint32), 1, 1 );
+
+	video_cb( frameBuf, 256, count, 256 * sizeof(uint32) );
+}
+
+static void outputSound(const int32 *sound, int32 count)
+{
+	if ( (sound == NULL) || (count <= 0) )
+	{
+		return;
+	}
+	if ( count > LIBRETRO_MAX_SAMPLES )
+	{
+		count = LIBRETRO_MAX_SAMPLES;
+	}
+	// the core mixes mono into 32 bits, the frontend takes stereo 16 bit frames
+	for (int32 i = 0; i < count; i++)
+	{
+		int32 s = sound[i];
+
+		if ( s > 32767 )
+		{
+			s = 32767;
+		}
+		else if ( s < -32768 )
+		{
+			s = -32768;
+		}
+		soundBuf[i*2] = soundBuf[i*2+1] = (int16)s;
+	}
+
+	size_t done = 0;
+
+	while ( done < (size_t)count )
+	{
+		size_t n = audio_batch_cb( soundBuf + done * 2, count - done );
+
+		if ( n == 0 )
+		{
+			break;
+		}
+		done += n;
+	}
+}
+
+static bool addCheatCode(const char *code)
+{
+	int a, v, c, type = 1;
+	char *end;
+
+	if ( FCEUI_DecodeGG( code, &a, &v, &c ) )
+	{
+		return FCEUI_AddCheat( code, a, v, c, 1 ) != 0;
+	}
+	if ( FCEUI_DecodePAR( code, &a, &v, &c, &type ) )
+	{
+		return FCEUI_AddCheat( code, a, v, c, type ) != 0;
+	}
+
+	// raw AAAA:VV or AAAA?CC:VV
+	a = strtol( code, &end, 16 );
+	c = -1;
+
+	if ( *end == '?' )
+	{
+		c = strtol( end + 1, &end, 16 );
+	}
+	if ( *end != ':' )
+	{
+		return false;
+	}
+	v = strtol( end + 1, &end, 16 );
+
+	if ( *end || (a < 0) || (a > 0xFFFF) || (v < 0) || (v > 0xFF) )
+	{
+		return false;
+	}
+	return FCEUI_AddCheat( code, a, v, c, 1 ) != 0;
+}
+
+//*****************************************************************
+// libretro API
+//*****************************************************************
+RETRO_API unsigned retro_api_version(void)
+{
+	return RETRO_API_VERSION;
+}
+
+RETRO_API void retro_set_environment(retro_environment_t cb)
+{
+	bool noGame = false;
+
+	environ_cb = cb;
+
+	environ_cb( RETRO_ENVIRONMENT_SET_SUPPORT_NO_GAME, &noGame );
+}
+
+RETRO_API void retro_set_video_refresh(retro_video_refresh_t cb)
+{
+	video_cb = cb;
+}
+
+RETRO_API void retro_set_audio_sample(retro_audio_sample_t cb)
+{
+	audio_cb = cb;
+}
+
+RETRO_API void retro_set_audio_sample_batch(retro_audio_sample_batch_t cb)
+{
+	audio_batch_cb = cb;
+}
+
+RETRO_API void retro_set_input_poll(retro_input_poll_t cb)
+{
+	input_poll_cb = cb;
+}
+
+RETRO_API void retro_set_input_state(retro_input_state_t cb)
+{
+	input_state_cb = cb;
+}
+
+RETRO_API void retro_init(void)
+{
+	const char *dir = NULL;
+
+	if ( environ_cb( RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY, &dir ) && dir )
+	{
+		systemDir = dir;
+	}
+	dir = NULL;
+
+	if ( environ_cb( RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY, &dir ) && dir )
+	{
+		saveDir = dir;
+	}
+	else
+	{
+		saveDir = systemDir;
+	}
+	if ( saveDir.empty() )
+	{
+		saveDir = ".";
+	}
+
+	FCEUI_Initialize();
+
+	// battery saves go straight into the save directory, disksys.rom is
+	// looked for in the system directory
+	FCEUI_SetBaseDirectory( saveDir );
+	FCEUI_SetDirOverride( FCEUIOD_NV, (char*)saveDir.c_str() );
+
+	if ( !systemDir.empty() )
+	{
+		FCEUI_SetDirOverride( FCEUIOD_FDSROM, (char*)systemDir.c_str() );
+	}
+
+	FCEUI_Sound( LIBRETRO_SOUND_RATE );
+	FCEUI_SetSoundQuality( 1 );
+	FCEUI_SetGameGenie( false );
+	FCEUI_SetVidSystem( 0 );
+
+	InitBlitToHigh( 4, 0x00FF0000, 0x0000FF00, 0x000000FF, 0, 0, 0 );
+	paletteValid = false;
+}
+
+RETRO_API void retro_deinit(void)
+{
+	KillBlitToHigh();
+
+	FCEUI_Kill();
+}
+
+RETRO_API void retro_get_system_info(struct retro_system_info *info)
+{
+	memset( info, 0, sizeof(*info) );
+
+	info->library_name     = "FCEUX";
+	info->library_version  = FCEU_VERSION_STRING;
+	info->valid_extensions = "nes|fds|unf|unif|nsf|zip|gz";
+	info->need_fullpath    = true;
+	info->block_extract    = false;
+}
+
+RETRO_API void retro_get_system_av_info(struct retro_system_av_info *info)
+{
+	int first, count;
+
+	getRenderedLines( &first, &count );
+
+	memset( info, 0, sizeof(*info) );
+
+	info->geometry.base_width   = 256;
+	info->geometry.base_height  = count;
+	info->geometry.max_width    = 256;
+	info->geometry.max_height   = 240;
+	info->geometry.aspect_ratio = 4.0f / 3.0f;
+
+	info->timing.fps         = FCEUI_GetDesiredFPS() / 16777216.0;
+	info->timing.sample_rate = LIBRETRO_SOUND_RATE;
+}
+
+RETRO_API void retro_set_controller_port_device(unsigned port, unsigned device)
+{
+	// both ports are always standard pads
+}
+
+RETRO_API void retro_reset(void)
+{
+	if ( GameInfo )
+	{
+		FCEUI_ResetNES();
+	}
+}
+
+RETRO_API void retro_run(void)
+{
+	uint8 *gfx = NULL;
+	int32 *sound = NULL;
+	int32 ssize = 0;
+
+	updateInput();
+
+	FCEUI_Emulate( &gfx, &sound, &ssize, 0 );
+
+	outputVideo( gfx );
+	outputSound( sound, ssize );
+}
+
+RETRO_API size_t retro_serialize_size(void)
+{
+	return GameInfo ? FCEUSS_SnapshotSize() : 0;
+}
+
+RETRO_API bool retro_serialize(void *data, size_t size)
+{
+	return GameInfo && FCEUSS_Snapshot( (uint8*)data, size );
+}
+
+RETRO_API bool retro_unserialize(const void *data, size_t size)
+{
+	return GameInfo && FCEUSS_Restore( (const uint8*)data, size );
+}
+
+RETRO_API void retro_cheat_reset(void)
+{
+	FCEU_DeleteAllCheats();
+}
+
+RETRO_API void retro_cheat_set(unsigned index, bool enabled, const char *code)
+{
+	if ( !enabled || (code == NULL) )
+	{
+		return;
+	}
+	// a cheat may be several codes joined with '+'
+	std::string codes( code );
+	size_t start = 0;
+
+	while ( start < codes.size() )
+	{
+		size_t end = codes.find( '+', start );
+
+		if ( end == std::string::npos )
+		{
+			end = codes.size();
+		}
+		std::string one;
+
+		for (size_t i = start; i < end; i++)
+		{
+			if ( !isspace( (unsigned char)codes[i] ) )
+			{
+				one += toupper( (unsigned char)codes[i] );
+			}
+		}
+		if ( !one.empty() && !addCheatCode( one.c_str() ) )
+		{
+			FCEU_printf( "libretro: cheat code not understood: %s\n", one.c_str() );
+		}
+		start = end + 1;
+	}
+}
+
+RETRO_API bool retro_load_game(const struct retro_game_info *game)
+{
+	enum retro_pixel_format fmt = RETRO_PIXEL_FORMAT_XRGB8888;
+
+	if ( (game == NULL) || (game->path == NULL) )
+	{
+		return false;
+	}
+	if ( !environ_cb( RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt ) )
+	{
+		FCEUD_PrintError( "libretro: the frontend does not take XRGB8888 frames" );
+		return false;
+	}
+
+	if ( FCEUI_LoadGame( game->path, 1, true ) == NULL )
+	{
+		return false;
+	}
+	isloaded = 1;
+
+	joyData = 0;
+	FCEUI_SetInput( 0, SI_GAMEPAD, &joyData, 0 );
+	FCEUI_SetInput( 1, SI_GAMEPAD, &joyData, 0 );
+	FCEUI_SetInputFC( SIFC_NONE, NULL, 0 );
+	FCEUI_SetInputFourscore( false );
+
+	// snapshots are raw machine state, in this host's byte order
+	uint64 quirks = RETRO_SERIALIZATION_QUIRK_ENDIAN_DEPENDENT;
+
+	environ_cb( RETRO_ENVIRONMENT_SET_SERIALIZATION_QUIRKS, &quirks );
+
+	paletteValid = false;
+
+	return true;
+}
+
+RETRO_API bool retro_load_game_special(unsigned game_type, const struct retro_game_info *info, size_t num_info)
+{
+	return false;
+}
+
+RETRO_API void retro_unload_game(void)
+{
+	if ( isloaded )
+	{
+		// the frontend keeps its cheats, they are not written to a cheat file
+		FCEU_FlushGameCheats( NULL, 1 );
+
+		FCEUI_CloseGame();
+		isloaded = 0;
+	}
+}
+
+RETRO_API unsigned retro_get_region(void)
+{
+	return FCEUI_GetCurrentVidSystem( NULL, NULL ) ? RETRO_REGION_PAL : RETRO_REGION_NTSC;
+}
+
+RETRO_API void *retro_get_memory_data(unsigned id)
+{
+	if ( (id == RETRO_MEMORY_SYSTEM_RAM) && GameInfo )
+	{
+		return RAM;
+	}
+	return NULL;
+}
+
+RETRO_API size_t retro_get_memory_size(unsigned id)
+{
+	if ( (id == RETRO_MEMORY_SYSTEM_RAM) && GameInfo )
+	{
+		return 0x800;
+	}
+	return 0;
+}
@@ -18,6 +18,7 @@
 #include "../../fceu.h"
 #include "../../cheat.h"
 #include "../../debug.h"
+#include "../../ppu.h"
 #include "../../driver.h"
 #include "../../version.h"
 #include "../../movie.h"
@@ -271,6 +272,7 @@ struct memViewWin_t
 			{
 				addr &= 0xFF;
 				SPRAM[addr] = value;
+				FCEUPPU_OAMChanged();
 			}
 			break;
 			case MODE_NES_ROM:
@@ -1250,6 +1250,8 @@ void DeleteBreak(int sel)
 		watchpoint[i].condText = watchpoint[i+1].condText;
 		watchpoint[i].desc = watchpoint[i+1].desc;
 // ################################## End of SP CODE ###########################
+		watchpoint[i].hitCount = watchpoint[i+1].hitCount;
+		watchpoint[i].evalCount = watchpoint[i+1].evalCount;
 	}
 	// erase last BP item
 	watchpoint[numWPs].address = 0;
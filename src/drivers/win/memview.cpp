@@ -23,6 +23,7 @@
 #include "common.h"
 #include "../../types.h"
 #include "../../debug.h"
+#include "../../ppu.h"
 #include "../../fceu.h"
 #include "../../cheat.h"
 #include "../../cart.h"
@@ -1040,6 +1041,7 @@ void InputData(char *input){
 				case MODE_NES_OAM:
 					addr &= 0xFF;
 					SPRAM[addr] = data[i];
+					FCEUPPU_OAMChanged();
 					break;
 				case MODE_NES_FILE:
 					// ROM
@@ -2253,6 +2255,7 @@ LRESULT CALLBACK MemViewCallB(HWND hwnd, UINT message, WPARAM wParam, LPARAM lPa
 			{
 				for (uint16 addr=0; addr<sizeof(bar); ++addr)
 					SPRAM[addr] = bar[addr];
+				FCEUPPU_OAMChanged();
 			}
 			return 0;
 		}
@@ -186,6 +186,7 @@ void ChangeMirroring(){
 				vnapage[0] = vnapage[1] = vnapage[2] = vnapage[3] = ExtraNTARAM + 0x400;
 			break;
 	}
+	FCEUPPU_PagesChanged();
 	return;
 }
 
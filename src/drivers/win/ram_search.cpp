@@ -59,7 +59,7 @@ bool ShowROM = false;
 
 // used for changing colors of cheated address.
 extern int numsubcheats;
-extern CHEATF_SUBFAST SubCheats[256];
+extern CHEATF_SUBFAST SubCheats[MAX_SUBCHEATS];
 
 bool IsHardwareAddressValid(HWAddressType address)
 {
@@ -26,6 +26,13 @@ THE SOFTWARE.
 #include <stdio.h>
 #include <vector>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 bool EMUFILE::readAllBytes(std::vector<u8>* dstbuf, const std::string& fname)
 {
 	EMUFILE_FILE file(fname.c_str(),"rb");
@@ -61,6 +68,100 @@ size_t EMUFILE_MEMORY::_fread(const void *ptr, size_t bytes){
 	return todo;
 }
 
+EMUFILE_MAPPED* EMUFILE_MAPPED::open(const char* fname)
+{
+#ifdef WIN32
+	return NULL;
+#else
+	int fd = ::open(fname, O_RDONLY);
+	if(fd < 0) return NULL;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+	{
+		::close(fd);
+		return NULL;
+	}
+
+	void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	//the mapping keeps the file referenced
+	::close(fd);
+	if(map == MAP_FAILED) return NULL;
+
+	EMUFILE_MAPPED* ret = new EMUFILE_MAPPED();
+	ret->map = map;
+	ret->data = (const u8*)map;
+	ret->len = (size_t)st.st_size;
+	return ret;
+#endif
+}
+
+EMUFILE_MAPPED::~EMUFILE_MAPPED()
+{
+#ifndef WIN32
+	if(map) munmap(map, len);
+#endif
+}
+
+size_t EMUFILE_MAPPED::_fread(const void *ptr, size_t bytes){
+	size_t remain = (static_cast<size_t>(pos) < len) ? len-pos : 0;
+	size_t todo = std::min<size_t>(remain,bytes);
+	if(todo)
+		memcpy((void*)ptr,data+pos,todo);
+	pos += todo;
+	if(todo<bytes)
+		failbit = true;
+	return todo;
+}
+
+size_t EMUFILE_SPAN::_fread(const void *ptr, size_t bytes){
+	size_t remain = (pos >= 0 && static_cast<size_t>(pos) < readable()) ? readable()-pos : 0;
+	size_t todo = std::min<size_t>(remain,bytes);
+	if(todo)
+		memcpy((void*)ptr,data+pos,todo);
+	pos += todo;
+	if(todo<bytes)
+		failbit = true;
+	return todo;
+}
+
+void EMUFILE_SPAN::fwrite(const void *ptr, size_t bytes){
+	size_t room = (!readonly && pos >= 0 && static_cast<size_t>(pos) < capacity) ? capacity-pos : 0;
+	size_t todo = std::min<size_t>(room,bytes);
+	if(todo)
+		memcpy(data+pos,ptr,todo);
+	if(todo<bytes)
+		failbit = true;
+	pos += static_cast<long>(bytes);
+	len = std::max<size_t>(pos,len);
+}
+
+int EMUFILE_SPAN::fprintf(const char *format, ...) {
+	va_list argptr;
+	va_start(argptr, format);
+	int amt = vsnprintf(0,0,format,argptr);
+	va_end(argptr);
+
+	char* tempbuf = new char[amt+1];
+	va_start(argptr, format);
+	vsnprintf(tempbuf,amt+1,format,argptr);
+	va_end(argptr);
+
+	fwrite(tempbuf,amt);
+	delete[] tempbuf;
+	return amt;
+}
+
+EMUFILE* EMUFILE_SPAN::memwrap()
+{
+	return this;
+}
+
+EMUFILE* EMUFILE_MAPPED::memwrap()
+{
+	return new EMUFILE_MEMORY((void*)data,len);
+}
+
 void EMUFILE_FILE::open(const char* fname, const char* mode)
 {
 	fp = fopen(fname,mode);
@@ -116,6 +116,10 @@ public:
 	virtual void fflush() = 0;
 
 	virtual void truncate(size_t length) = 0;
+
+	//the next bytes in place when they are all in memory, so a reader can
+	//parse them without copying them out first. NULL otherwise.
+	virtual const u8* peek(size_t bytes) { return NULL; }
 };
 
 //todo - handle read-only specially?
@@ -259,6 +263,172 @@ public:
 		vec->resize(len);
 	}
 
+	virtual const u8* peek(size_t bytes) {
+		if(pos < 0 || static_cast<size_t>(pos) + bytes > len) return NULL;
+		return vec->data() + pos;
+	}
+
+	virtual size_t size() { return len; }
+};
+
+//reads and writes a buffer the caller owns, which never grows. A write past
+//its end sets the failbit, but size() still counts the bytes, so writing
+//into an empty span measures how big a buffer the data would need.
+class EMUFILE_SPAN : public EMUFILE {
+protected:
+	u8* data;
+	size_t capacity;
+	size_t len;
+	long int pos;
+	bool readonly;
+
+	size_t readable() { return std::min<size_t>(len,capacity); }
+
+public:
+
+	//empty, to be written
+	EMUFILE_SPAN(void* buf, size_t capacity) : data((u8*)buf), capacity(buf ? capacity : 0), len(0), pos(0), readonly(false) { }
+	//holding size bytes, to be read
+	EMUFILE_SPAN(const void* buf, size_t size) : data((u8*)buf), capacity(buf ? size : 0), len(buf ? size : 0), pos(0), readonly(true) { }
+
+	u8* buf() { return data; }
+
+	virtual FILE *get_fp() { return NULL; }
+
+	virtual EMUFILE* memwrap();
+
+	virtual void truncate(size_t length) {
+		if(readonly || length > capacity) failbit = true;
+		len = length;
+		if (static_cast<size_t>(pos) > length) pos=static_cast<long int>(length);
+	}
+
+	virtual int fprintf(const char *format, ...);
+
+	virtual int fgetc() {
+		if(pos < 0 || static_cast<size_t>(pos) >= readable()) {
+			failbit = true;
+			return -1;
+		}
+		return data[pos++];
+	}
+	virtual int fputc(int c) {
+		u8 temp = (u8)c;
+		fwrite(&temp,1);
+		return 0;
+	}
+
+	virtual size_t _fread(const void *ptr, size_t bytes);
+
+	virtual void fwrite(const void *ptr, size_t bytes);
+
+	virtual int fseek(long int offset, int origin){
+		switch(origin) {
+			case SEEK_SET:
+				pos = offset;
+				break;
+			case SEEK_CUR:
+				pos += offset;
+				break;
+			case SEEK_END:
+				pos = (long int)(len+offset);
+				break;
+			default:
+				assert(false);
+		}
+		return 0;
+	}
+
+	virtual long int ftell() {
+		return pos;
+	}
+
+	virtual void fflush() {}
+
+	virtual const u8* peek(size_t bytes) {
+		if(pos < 0 || static_cast<size_t>(pos) + bytes > readable()) return NULL;
+		return data + pos;
+	}
+
+	virtual size_t size() { return len; }
+};
+
+//a read only view of a whole file through mmap(), so reading a ROM is a
+//memcpy out of the page cache. Writes fail.
+class EMUFILE_MAPPED : public EMUFILE {
+protected:
+	void* map;
+	const u8* data;
+	size_t len;
+	long int pos;
+
+	EMUFILE_MAPPED() : map(0), data(0), len(0), pos(0) { }
+
+public:
+
+	//NULL when the file can not be mapped, an empty file or a system
+	//without mmap() included; open it as an EMUFILE_FILE instead then.
+	static EMUFILE_MAPPED* open(const char* fname);
+
+	virtual ~EMUFILE_MAPPED();
+
+	const u8* buf() { return data; }
+
+	virtual FILE *get_fp() { return NULL; }
+
+	virtual EMUFILE* memwrap();
+
+	virtual void truncate(size_t length) { failbit = true; }
+
+	virtual int fprintf(const char *format, ...) {
+		failbit = true;
+		return 0;
+	}
+
+	virtual int fgetc() {
+		if(static_cast<size_t>(pos) >= len) {
+			failbit = true;
+			return -1;
+		}
+		return data[pos++];
+	}
+	virtual int fputc(int c) {
+		failbit = true;
+		return EOF;
+	}
+
+	virtual size_t _fread(const void *ptr, size_t bytes);
+
+	virtual void fwrite(const void *ptr, size_t bytes) { failbit = true; }
+
+	virtual int fseek(long int offset, int origin){
+		switch(origin) {
+			case SEEK_SET:
+				pos = offset;
+				break;
+			case SEEK_CUR:
+				pos += offset;
+				break;
+			case SEEK_END:
+				pos = (long int)(len+offset);
+				break;
+			default:
+				assert(false);
+		}
+		return 0;
+	}
+
+	virtual long int ftell() {
+		return pos;
+	}
+
+	virtual void fflush() {}
+
+	virtual const u8* peek(size_t bytes) {
+		if(pos < 0 || static_cast<size_t>(pos) + bytes > len) return NULL;
+		return data + pos;
+	}
+
 	virtual size_t size() { return len; }
 };
 
@@ -30,20 +30,30 @@
 #include "utils/crc32.h"
 
 #include "cart.h"
+#include "debug.h"
 #include "nsf.h"
 #include "fds.h"
 #include "ines.h"
 #include "unif.h"
 #include "cheat.h"
+#include "startuptime.h"
+#include "stageprof.h"
+#include "msglog.h"
+#include "allocstats.h"
 #include "palette.h"
 #include "profiler.h"
+#include "reversedebug.h"
+#include "writejournal.h"
 #include "state.h"
 #include "movie.h"
 #include "video.h"
+#include "capture.h"
 #include "input.h"
 #include "file.h"
 #include "vsuni.h"
 #include "ines.h"
+#include "context.h"
+#include "wave.h"
 #ifdef __WIN_DRIVER__
 #include "drivers/win/pref.h"
 #include "utils/xstring.h"
@@ -78,6 +88,8 @@ extern void RefreshThrottleFPS();
 #else
 #ifdef __QT_DRIVER__
 #include "drivers/Qt/sdl.h"
+#elif defined(__HEADLESS_DRIVER__)
+#include "drivers/headless/headless.h"
 #else
 #include "drivers/sdl/sdl.h"
 #endif
@@ -86,12 +98,17 @@ extern void RefreshThrottleFPS();
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
 
+#include <cctype>
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
 #include <cstdarg>
 #include <ctime>
+#include <sys/stat.h>
 
 using namespace std;
 
@@ -107,6 +124,8 @@ int normalscanlines;
 int totalscanlines;
 int postrenderscanlines = 0;
 int vblankscanlines = 0;
+bool lagOverclock = 0; // overclock only the frames that would lag, of the listed games
+static std::vector<MD5DATA> lagOverclockGames;
 //------------
 
 int AFon = 1, AFoff = 1, AutoFireOffset = 0; //For keeping track of autofire settings
@@ -116,6 +135,8 @@ bool AutoSS = false;        //Flagged true when the first auto-savestate is made
 bool movieSubtitles = true; //Toggle for displaying movie subtitles
 bool DebuggerWasUpdated = false; //To prevent the debugger from updating things without being updated.
 bool AutoResumePlay = false;
+bool computeOnlyMode = false; //Emulate without producing video or sound, see FCEUI_SetComputeOnly
+static bool fastForwardMode = false; //see FCEUI_SetFastForward
 char romNameWhenClosingEmulator[2048] = {0};
 static unsigned int pauseTimer = 0;
 
@@ -160,6 +181,41 @@ bool CheckFileExists(const char* filename) {
 	}
 }
 
+void FCEUI_SetLagOverclockGames(const char *md5s) {
+	lagOverclockGames.clear();
+
+	std::string hex;
+	for (const char *p = md5s ? md5s : ""; ; p++) {
+		if (*p && isxdigit((unsigned char)*p)) {
+			hex += *p;
+			continue;
+		}
+		if (hex.size() == 32) {
+			MD5DATA md5;
+			for (int i = 0; i < 16; i++)
+				md5.data[i] = (uint8)strtoul(hex.substr(i * 2, 2).c_str(), NULL, 16);
+			lagOverclockGames.push_back(md5);
+		}
+		hex.clear();
+		if (!*p)
+			break;
+	}
+}
+
+bool FCEUI_LagOverclockListed(void) {
+	if (!GameInfo)
+		return false;
+	for (size_t i = 0; i < lagOverclockGames.size(); i++)
+		if (!memcmp(lagOverclockGames[i].data, GameInfo->MD5.data, 16))
+			return true;
+	return false;
+}
+
+bool FCEU_OverclockNow(void) {
+	// lagFlag is cleared by the first read of the pads in the frame
+	return !lagOverclock || (lagFlag && FCEUI_LagOverclockListed());
+}
+
 void FCEU_TogglePPU(void) {
 	newppu ^= 1;
 	if (newppu) {
@@ -176,10 +232,119 @@ void FCEU_TogglePPU(void) {
 #endif
 }
 
+// Machine state right after the current game was loaded and powered on.
+// FCEUI_HotPowerNES() and loading the same file again restore it instead of
+// tearing the game down, see TakePowerOnState().
+extern int RAMInitSeed;
+extern u64 xoroshiro128plus_s[2];
+static std::vector<uint8> powerOnState;
+static int powerOnSeed;
+static u64 powerOnRandom[2];
+static int powerOnVidSys;
+static std::string powerOnName;
+static std::string powerOnPatch;
+static long long powerOnSize, powerOnMTime;
+
+static bool StatRomFile(const char *name, long long &size, long long &mtime)
+{
+	// an archive is named "archive|file", what changes is the archive
+	std::string path(name);
+	size_t bar = path.find('|');
+	if (bar != std::string::npos)
+		path.resize(bar);
+
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+	size = (long long)st.st_size;
+	mtime = (long long)st.st_mtime;
+	return true;
+}
+
+static int CurrentVidSys(void)
+{
+	return PAL | (dendy << 1) | (newppu << 2);
+}
+
+static void TakePowerOnState(const char *name)
+{
+	powerOnState.clear();
+
+	// NSF, FDS and VS System keep state out of the snapshot chunks (player,
+	// disk side, coin and DIP logic); the genie ROM replaces the game's
+	// mapping until it exits
+	if (GameInfo->type != GIT_CART || geniestage || !currCartInfo)
+		return;
+	if (!StatRomFile(name, powerOnSize, powerOnMTime))
+		return;
+
+	powerOnState.resize(FCEUSS_SnapshotSize());
+	if (!FCEUSS_Snapshot(powerOnState.data(), powerOnState.size()))
+	{
+		powerOnState.clear();
+		return;
+	}
+	powerOnSeed = RAMInitSeed;
+	memcpy(powerOnRandom, xoroshiro128plus_s, sizeof(powerOnRandom));
+	powerOnVidSys = CurrentVidSys();
+	powerOnName = name;
+	powerOnPatch = LoadedRomFNamePatchToUse;
+}
+
+static bool CanRestorePowerOnState(void)
+{
+	// movies and netplay have to see the power command go by
+	return GameInfo && !powerOnState.empty() && !geniestage &&
+		FCEUMOV_Mode(MOVIEMODE_INACTIVE) && !FCEUnetplay &&
+		powerOnState.size() == FCEUSS_SnapshotSize() &&
+		powerOnVidSys == CurrentVidSys();
+}
+
+static void RestorePowerOnState(void)
+{
+	// battery backed memory survives a power cycle, keep what the game wrote
+	std::vector< std::vector<uint8> > battery;
+	if (currCartInfo->battery)
+	{
+		for (size_t x = 0; x < currCartInfo->SaveGame.size(); x++)
+		{
+			const CartInfo::SaveGame_t &sg = currCartInfo->SaveGame[x];
+			battery.push_back(sg.bufptr ? std::vector<uint8>(sg.bufptr, sg.bufptr + sg.buflen) : std::vector<uint8>());
+		}
+	}
+
+	FCEUSS_Restore(powerOnState.data(), powerOnState.size());
+
+	for (size_t x = 0; x < battery.size(); x++)
+	{
+		if (!battery[x].empty())
+			memcpy(currCartInfo->SaveGame[x].bufptr, battery[x].data(), battery[x].size());
+	}
+
+	// the rest of what PowerNES() does outside the snapshot chunks
+	RAMInitSeed = powerOnSeed;
+	memcpy(xoroshiro128plus_s, powerOnRandom, sizeof(powerOnRandom));
+	timestampbase = 0;
+	FCEU_PowerCheats();
+	LagCounterReset();
+	extern uint8 *XBackBuf;
+	memset(XBackBuf, 0, 256 * 256);
+	currFrameCounter = 0;
+	EmulationPaused = 0;
+
+	if ( FCEU_StateRecorderIsEnabled() )
+	{
+		FCEU_StateRecorderStart();
+	}
+}
+
 static void FCEU_CloseGame(void)
 {
 	if (GameInfo)
 	{
+		FCEU_ReverseDebugReset();
+		FCEU_ResetWriteJournal();
+
 		if (AutoResumePlay)
 		{
 			// save "-resume" savestate
@@ -196,6 +361,13 @@ static void FCEU_CloseGame(void)
 			FCEUD_NetworkClose();
 		}
 
+		// A capture belongs to the game being closed, and so does the replay ring
+		FCEUI_EndIndexedCapture();
+		FCEU_ResetInstantReplay();
+
+		// Contexts hold state for the game being closed
+		FCEU::Context::gameClosed();
+
 		if (GameInfo->name) {
 			free(GameInfo->name);
 			GameInfo->name = nullptr;
@@ -212,6 +384,8 @@ static void FCEU_CloseGame(void)
 				FCEU_FlushGameCheats(0, 0);
 		}
 
+		FCEUSS_WriteBackups();
+
 		GameInterface(GI_CLOSE);
 
 		FCEU_StateRecorderStop();
@@ -231,6 +405,7 @@ static void FCEU_CloseGame(void)
 		GameInfo = nullptr;
 
 		currFrameCounter = 0;
+		powerOnState.clear();
 
 		//Reset flags for Undo/Redo/Auto Savestating //adelikat: TODO: maybe this stuff would be cleaner as a struct or class
 		lastSavestateMade.clear();
@@ -269,7 +444,6 @@ int frameAdvance_Delay = FRAMEADVANCE_DELAY_DEFAULT;
 //indicates that the emulation core just frame advanced (consumed the frame advance state and paused)
 bool JustFrameAdvanced = false;
 
-static int *AutosaveStatus; //is it safe to load Auto-savestate
 static int AutosaveIndex = 0; //which Auto-savestate we're on
 int AutosaveQty = 4; // Number of Autosaves to store
 int AutosaveFrequency = 256; // Number of frames between autosaves
@@ -310,6 +484,8 @@ void FlushGenieRW(void) {
 			ARead[x + 0x8000] = AReadG[x];
 			BWrite[x + 0x8000] = BWriteG[x];
 		}
+		UpdateCartReadPages(0x8000, 0xFFFF);
+		UpdateCartWritePages(0x8000, 0xFFFF);
 		free(AReadG);
 		free(BWriteG);
 		AReadG = nullptr;
@@ -341,6 +517,7 @@ void SetReadHandler(int32 start, int32 end, readfunc func) {
 	else
 		for (x = end; x >= start; x--)
 			ARead[x] = func;
+	UpdateCartReadPages(start, end);
 }
 
 writefunc GetWriteHandler(int32 a) {
@@ -366,6 +543,7 @@ void SetWriteHandler(int32 start, int32 end, writefunc func) {
 	else
 		for (x = end; x >= start; x--)
 			BWrite[x] = func;
+	UpdateCartWritePages(start, end);
 }
 
 uint8 *RAM;
@@ -401,6 +579,52 @@ static DECLFR(ARAMH) {
 	return RAM[A & 0x7FF];
 }
 
+const uint8 *FCEU_GetPlainMemPtr(uint16 A, int len) {
+	if (!GameInfo || len <= 0)
+		return NULL;
+	if (A < 0x2000) {
+		// within one mirror, every byte read by the RAM handler
+		if ((A & 0x7FF) + len > 0x800)
+			return NULL;
+		for (int i = 0; i < len; i++)
+			if (ARead[A + i] != ARAML && ARead[A + i] != ARAMH)
+				return NULL;
+		return RAM + (A & 0x7FF);
+	}
+	if (A >= 0x5000 && (A & 0xFFF) + len <= 0x1000 && ReadPage[A >> 12])
+		return ReadPage[A >> 12] + A;
+	return NULL;
+}
+
+void FCEU_GetMemRange(uint16 A, uint8 *out, int len) {
+	if (!GameInfo) {
+		if (len > 0) memset(out, 0, len);
+		return;
+	}
+	while (len > 0) {
+		int n = 1;
+		readfunc f = ARead[A];
+
+		if (A < 0x2000 && (f == ARAML || f == ARAMH)) {
+			// up to the end of the mirror, or of the run of RAM handlers
+			n = 0x800 - (A & 0x7FF);
+			if (n > len) n = len;
+			for (int i = 1; i < n; i++)
+				if (ARead[A + i] != f) { n = i; break; }
+			memcpy(out, RAM + (A & 0x7FF), n);
+		} else if (A >= 0x5000 && ReadPage[A >> 12]) {
+			n = 0x1000 - (A & 0xFFF);
+			if (n > len) n = len;
+			memcpy(out, ReadPage[A >> 12] + A, n);
+		} else {
+			*out = GetMem(A);
+		}
+		A += n;
+		out += n;
+		len -= n;
+	}
+}
+
 
 void ResetGameLoaded(void) {
 	if (GameInfo) FCEU_CloseGame();
@@ -408,6 +632,7 @@ void ResetGameLoaded(void) {
 	GameStateRestore = 0;
 	PPU_hook = nullptr;
 	GameHBIRQHook = nullptr;
+	FCEUPPU_DiscardHBIRQ();
 	FFCEUX_PPURead = nullptr;
 	FFCEUX_PPUWrite = nullptr;
 	if (GameExpSound.Kill)
@@ -429,6 +654,8 @@ int NSFLoad(const char *name, FCEUFILE *fp);
 //name should be UTF-8, hopefully, or else there may be trouble
 FCEUGI *FCEUI_LoadGameVirtual(const char *name, int OverwriteVidMode, bool silent)
 {
+	FCEU_StartupPhase phase("rom_load");
+
 	//----------
 	//attempt to open the files
 	FCEUFILE *fp;
@@ -442,7 +669,23 @@ FCEUGI *FCEUI_LoadGameVirtual(const char *name, int OverwriteVidMode, bool silen
 	// currently there's only one situation:
 	// the user clicked cancel form the open from archive dialog
 	int userCancel = 0;
-	fp = FCEU_fopen(name, LoadedRomFNamePatchToUse[0] ? LoadedRomFNamePatchToUse : nullptr, "rb", 0, -1, romextensions, &userCancel);
+
+	// The file that is already loaded, unchanged since, only needs the
+	// machine put back the way the load left it
+	long long size, mtime;
+	if (CanRestorePowerOnState() && !AutoResumePlay && !FSettings.GameGenie &&
+		powerOnName == name && powerOnPatch == LoadedRomFNamePatchToUse &&
+		StatRomFile(name, size, mtime) && size == powerOnSize && mtime == powerOnMTime)
+	{
+		FCEU_printf("Reloading %s...\n\n", name);
+		// as closing the game would
+		FCEU_SaveGameSave(currCartInfo);
+		RestorePowerOnState();
+		FCEU_ResetMessages();
+		return GameInfo;
+	}
+
+	fp = FCEU_fopen(name, LoadedRomFNamePatchToUse[0] ? LoadedRomFNamePatchToUse : nullptr, "rb", 0, -1, romextensions, &userCancel, true);
 
 	if (!fp)
 	{
@@ -465,16 +708,15 @@ FCEUGI *FCEUI_LoadGameVirtual(const char *name, int OverwriteVidMode, bool silen
 
 	// reset loaded game BEFORE it's loading.
 	ResetGameLoaded();
+	FCEU_FrameAllocReset();
 	//file opened ok. start loading.
 	FCEU_printf("Loading %s...\n\n", fullname.c_str());
 	GetFileBase(fp->filename.c_str());
 	//reset parameters so they're cleared just in case a format's loader doesn't know to do the clearing
 	MasterRomInfoParams = TMasterRomInfoParams();
 
-	if (!AutosaveStatus)
-		AutosaveStatus = (int*)FCEU_dmalloc(sizeof(int) * AutosaveQty);
-	for (AutosaveIndex = 0; AutosaveIndex < AutosaveQty; ++AutosaveIndex)
-		AutosaveStatus[AutosaveIndex] = 0;
+	FCEUSS_AutosaveReset(AutosaveQty);
+	AutosaveIndex = 0;
 
 	FCEU_CloseGame();
 	GameInfo = new FCEUGI();
@@ -539,6 +781,9 @@ FCEUGI *FCEUI_LoadGameVirtual(const char *name, int OverwriteVidMode, bool silen
 		}
 
 		PowerNES();
+		TakePowerOnState(name);
+
+		FCEU_printf("Snapshot size: %u bytes\n", (unsigned int)FCEUSS_SnapshotSize());
 
 		if (GameInfo->type != GIT_NSF)
 			FCEU_LoadGamePalette();
@@ -618,9 +863,21 @@ FCEUGI *FCEUI_LoadGame(const char *name, int OverwriteVidMode, bool silent)
 	return FCEUI_LoadGameVirtual(name, OverwriteVidMode, silent);
 }
 
+bool FCEUI_HotPowerNES(void)
+{
+	if (!CanRestorePowerOnState() || !FCEU_IsValidUI(FCEUI_POWER))
+		return false;
+
+	FCEU_DispMessage("Command: Power switch", 0);
+	RestorePowerOnState();
+	return true;
+}
+
 
 //Return: Flag that indicates whether the function was succesful or not.
 bool FCEUI_Initialize() {
+	FCEU_StartupPhase phase("fceui_initialize");
+
 	srand(time(0));
 
 	if (!FCEU_InitVirtualVideo()) {
@@ -657,6 +914,10 @@ void FCEUI_Kill(void) {
 	#ifdef _S9XLUA_H
 	FCEU_LuaStop();
 	#endif
+	FCEUSS_StopSaves();
+	FCEU_StopInstantReplay();
+	FCEUMOV_StopWrites();
+	FCEU_MsgLogStop();
 	FCEU_KillVirtualVideo();
 	FCEU_KillGenie();
 	FreeBuffers();
@@ -739,14 +1000,102 @@ void UpdateAutosave(void);
 extern unsigned int frameAdvHoldTimer;
 #endif
 
+#ifdef __FCEU_QNETWORK_ENABLE__
+extern bool NetPlayActive(void);
+#endif
+
+//run-ahead, see FCEUI_SetRunAhead
+static int runAheadFrames = 0;
+static std::vector<uint8> runAheadState;
+static std::vector<uint8> runAheadPicture;
+
+static bool CanRunAhead(int skip)
+{
+	// every frame run ahead is thrown away again, so nothing may see it go by:
+	// movies and netplay take or send its input, debugger and Lua hooks would
+	// fire on it, and a wave recording would write its sound
+	if (!runAheadFrames || skip || computeOnlyMode || geniestage == 1)
+		return false;
+	if (!GameInfo || (GameInfo->type == GIT_NSF) || (GameInfo->type == GIT_VSUNI))
+		return false;
+	if (!FCEUMOV_Mode(MOVIEMODE_INACTIVE) || FCEUnetplay)
+		return false;
+#ifdef __FCEU_QNETWORK_ENABLE__
+	if (NetPlayActive())
+		return false;
+#endif
+	return !X6502_NeedsInstrumentation() && !FCEUI_WaveRecordRunning();
+}
+
+//Runs runAheadFrames frames past the one just emulated with the same input,
+//keeps the picture of the last one in XBuf and rolls everything else back
+static void RunAhead(void)
+{
+	FCEU_PROFILE_FUNC(prof, "Run Ahead");
+
+	// the frames ahead start where this one ends
+	timestampbase += timestamp;
+	timestamp = 0;
+	soundtimestamp = 0;
+
+	size_t size = FCEUSS_SnapshotSize();
+	if (runAheadState.size() != size)
+		runAheadState.resize(size);
+	if (!FCEUSS_Snapshot(runAheadState.data(), size))
+		return;
+	FCEUSND_SaveSynthesis();
+
+	// counters the frontend shows that are outside of the snapshot
+	int frameCounter = currFrameCounter;
+	int realLagFlag = lagFlag;
+	bool realJustLagged = justLagged;
+
+	for (int i = 0; i < runAheadFrames; i++)
+		FCEUI_EmulateOffscreen();
+
+	runAheadPicture.resize(256*256*2);
+	memcpy(runAheadPicture.data(), XBuf, 256*256);
+	memcpy(runAheadPicture.data() + 256*256, XDBuf, 256*256);
+
+	FCEUSS_Restore(runAheadState.data(), size);
+	FCEUSND_RestoreSynthesis();
+	currFrameCounter = frameCounter;
+	lagFlag = realLagFlag;
+	justLagged = realJustLagged;
+
+	memcpy(XBuf, runAheadPicture.data(), 256*256);
+	memcpy(XDBuf, runAheadPicture.data() + 256*256, 256*256);
+}
+
+void FCEUI_SetRunAhead(int frames)
+{
+	runAheadFrames = std::max(0, std::min(frames, FCEU_RUNAHEAD_MAX));
+
+	// the first frame ahead sizes the buffers
+	FCEU_FrameAllocReset();
+
+	if (!runAheadFrames)
+	{
+		std::vector<uint8>().swap(runAheadState);
+		std::vector<uint8>().swap(runAheadPicture);
+	}
+}
+
+int FCEUI_GetRunAhead(void)
+{
+	return runAheadFrames;
+}
+
 ///Emulates a single frame.
 
 ///Skip may be passed in, if FRAMESKIP is #defined, to cause this to emulate more than one frame
 void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int skip) {
 	FCEU_PROFILE_FUNC(prof, "Emulate Single Frame");
+	FCEU_StageFrameScope stageFrame;
+	FCEU_FrameAllocScope frameAllocs;
 	//skip initiates frame skip if 1, or frame skip and sound skip if 2
 	FCEU_MAYBE_UNUSED int r;
-	int ssize;
+	int ssize = 0;
 
 	JustFrameAdvanced = false;
 
@@ -816,7 +1165,9 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 #endif
 		if (EmulationPaused & (EMULATIONPAUSED_PAUSED | EMULATIONPAUSED_TIMER | EMULATIONPAUSED_NETPLAY) )
 		{
-			// emulator is paused
+			// emulator is paused, a background save queued before still
+			// reports its result
+			FCEUSS_UpdateSaves();
 			memcpy(XBuf, XBackBuf, 256*256);
 			FCEU_PutImage();
 			*pXBuf = XBuf;
@@ -828,12 +1179,17 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 
 	AutoFire();
 	UpdateAutosave();
+	FCEUSS_UpdateSaves();
+	FCEUMOV_UpdateWrites();
 	FCEU_StateRecorderUpdate();
 
 #ifdef _S9XLUA_H
 	FCEU_LuaFrameBoundary();
 #endif
 
+	FCEU_ReverseDebugFrameStart();
+
+	FCEUMOV_UpdateSeekIndex();
 	FCEU_UpdateInput();
 	lagFlag = 1;
 
@@ -846,6 +1202,17 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 
 	if (skip != 2) ssize = FlushEmulateSound();  //If skip = 2 we are skipping sound processing
 
+	//raw frame for the indexed capture, before the HUD is drawn into XBuf
+	if (FCEUI_IndexedCaptureRunning())
+		FCEU_WriteIndexedCapture(XBuf, XDBuf, skip != 2 ? WaveFinal : NULL, skip != 2 ? ssize : 0);
+	FCEU_WriteInstantReplay(XBuf, XDBuf, skip != 2 ? WaveFinal : NULL, skip != 2 ? ssize : 0);
+
+	//show a frame from a little ahead of the one the sound and movie are at
+	if (CanRunAhead(skip))
+		RunAhead();
+
+	if (computeOnlyMode) skip = 2; //Nothing to hand back to the driver
+
 	//flush tracer once a frame, since we're likely to end up back at a user interaction loop after this with emulation paused
 	FCEUD_FlushTrace();
 
@@ -853,7 +1220,12 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 	CallRegisteredLuaFunctions(LUACALL_AFTEREMULATION);
 #endif
 
-	FCEU_PutImage();
+	if (computeOnlyMode)
+		; //no picture at all
+	else if (skip)
+		FCEU_PutImageDummy(); //not shown, only keep the HUD counters going
+	else
+		FCEU_PutImage();
 
 #ifdef __WIN_DRIVER__
 	//These Windows only dialogs need to be updated only once per frame so they are included here
@@ -909,6 +1281,34 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 		ProcessSubtitles();
 }
 
+void FCEUI_EmulateOffscreen(void) {
+	FCEU_PROFILE_FUNC(prof, "Emulate Offscreen Frame");
+	FCEU_StageFrameScope stageFrame;
+
+	FCEUMOV_UpdateSeekIndex();
+	FCEU_UpdateInput();
+	lagFlag = 1;
+
+	if (geniestage != 1) FCEU_ApplyPeriodicCheats();
+	FCEUPPU_Loop(0);
+
+	//the sound is thrown away, but the APU must be flushed exactly like in a shown frame
+	FlushEmulateSound();
+
+	//savestates carry the back buffer, keep it in step as FCEU_PutImage would
+	memcpy(XBackBuf, XBuf, 256*256);
+
+	timestampbase += timestamp;
+	timestamp = 0;
+	soundtimestamp = 0;
+
+	//the lag counter is part of the savestate
+	if (lagFlag) {
+		lagCounter++;
+		justLagged = true;
+	} else justLagged = false;
+}
+
 void FCEUI_CloseGame(void) {
 	if (!FCEU_IsValidUI(FCEUI_CLOSEGAME))
 		return;
@@ -919,6 +1319,9 @@ void FCEUI_CloseGame(void) {
 void ResetNES(void) {
 	FCEUMOV_AddCommand(FCEUNPCMD_RESET);
 	if (!GameInfo) return;
+	FCEU_ReverseDebugReset();
+	X6502_FlushMapIRQ();
+	FCEUPPU_FlushHBIRQ();
 	GameInterface(GI_RESETM2);
 	FCEUSND_Reset();
 	FCEUPPU_Reset();
@@ -1016,6 +1419,8 @@ void hand(X6502 *X, int type, uint32 A) {
 void PowerNES(void) {
 	FCEUMOV_AddCommand(FCEUNPCMD_POWER);
 	if (!GameInfo) return;
+	FCEU_ReverseDebugReset();
+	FCEU_ResetWriteJournal();
 
 	//reseed random, unless we're in a movie
 	extern int disableBatteryLoading;
@@ -1110,7 +1515,8 @@ void FCEU_printf( __FCEU_PRINTF_FORMAT const char *format, ...)
 
 	va_start(ap, format);
 	vsnprintf(temp, sizeof(temp), format, ap);
-	FCEUD_Message(temp);
+	if (!FCEU_MsgLogPut(temp))
+		FCEUD_Message(temp);
 
 #if 0
 	FILE *ofile;
@@ -1130,6 +1536,8 @@ void FCEU_PrintError( __FCEU_PRINTF_FORMAT const char *format, ...)
 
 	va_start(ap, format);
 	vsnprintf(temp, sizeof(temp), format, ap);
+	// after the messages logged before it
+	FCEU_MsgLogFlush();
 	FCEUD_PrintError(temp);
 
 	va_end(ap);
@@ -1281,6 +1689,34 @@ void FCEUI_ToggleEmulationPause(void)
 		FCEUD_FlushTrace();
 }
 
+void FCEUI_SetComputeOnly(bool enable)
+{
+	if (computeOnlyMode == enable)
+		return;
+
+	computeOnlyMode = enable;
+	FCEUSND_SuspendSynthesis(computeOnlyMode || fastForwardMode);
+}
+
+bool FCEUI_GetComputeOnly(void)
+{
+	return computeOnlyMode;
+}
+
+void FCEUI_SetFastForward(bool enable)
+{
+	if (fastForwardMode == enable)
+		return;
+
+	fastForwardMode = enable;
+	FCEUSND_SuspendSynthesis(computeOnlyMode || fastForwardMode);
+}
+
+bool FCEUI_GetFastForward(void)
+{
+	return fastForwardMode;
+}
+
 void FCEUI_FrameAdvanceEnd(void) {
 	frameAdvanceRequested = false;
 }
@@ -1290,6 +1726,10 @@ void FCEUI_FrameAdvance(void) {
 	frameAdvanceRequested = true;
 }
 
+bool FCEUI_FrameAdvanceRequested(void) {
+	return frameAdvanceRequested;
+}
+
 void FCEUI_PauseForDuration(int secs)
 {
 	int framesPerSec;
@@ -1345,11 +1785,10 @@ void UpdateAutosave(void) {
 		AutosaveCounter = 0;
 		AutosaveIndex = (AutosaveIndex + 1) % AutosaveQty;
 		f = strdup(FCEU_MakeFName(FCEUMKF_AUTOSTATE, AutosaveIndex, 0).c_str());
-		FCEUSS_Save(f, false);
-		AutoSS = true;  //Flag that an auto-savestate was made
+		if (FCEUSS_Autosave(AutosaveIndex, f))
+			AutoSS = true;  //Flag that an auto-savestate was made
 		free(f);
 		f = nullptr;
-		AutosaveStatus[AutosaveIndex] = 1;
 	}
 }
 
@@ -1357,15 +1796,15 @@ void FCEUI_RewindToLastAutosave(void) {
 	if (!EnableAutosave || !AutoSS)
 		return;
 
-	if (AutosaveStatus[AutosaveIndex] == 1) {
+	if (FCEUSS_AutosaveExists(AutosaveIndex)) {
 		char * f;
 		f = strdup(FCEU_MakeFName(FCEUMKF_AUTOSTATE, AutosaveIndex, 0).c_str());
-		FCEUSS_Load(f);
+		FCEUSS_LoadAutosave(AutosaveIndex, f);
 		free(f);
 		f = nullptr;
 
 		//Set pointer to previous available slot
-		if (AutosaveStatus[(AutosaveIndex + AutosaveQty - 1) % AutosaveQty] == 1) {
+		if (FCEUSS_AutosaveExists((AutosaveIndex + AutosaveQty - 1) % AutosaveQty)) {
 			AutosaveIndex = (AutosaveIndex + AutosaveQty - 1) % AutosaveQty;
 		}
 
@@ -1495,6 +1934,7 @@ virtual void Power() {
 	vnapage[2] = NTARAM;
 	vnapage[1] = NTARAM + 0x400;
 	vnapage[3] = NTARAM + 0x400;
+	FCEUPPU_PagesChanged();
 	PPUNTARAM = 0xF;
 }
 };
@@ -1574,6 +2014,16 @@ uint8 FCEU_ReadRomByte(uint32 i) {
 	return 0;
 }
 
+static std::atomic<uint32> romModifyCount(0);
+
+void FCEU_RomModified(void) {
+	romModifyCount.fetch_add(1, std::memory_order_release);
+}
+
+uint32 FCEU_GetRomModifyCount(void) {
+	return romModifyCount.load(std::memory_order_acquire);
+}
+
 void FCEU_WriteRomByte(uint32 i, uint8 value) {
 	if (i < 16)
 #ifdef __WIN_DRIVER__
@@ -1585,4 +2035,5 @@ void FCEU_WriteRomByte(uint32 i, uint8 value) {
 		PRGptr[0][i - 16] = value;
 	else if (i < 16 + PRGsize[0] + CHRsize[0])
 		CHRptr[0][i - 16 - PRGsize[0]] = value;
+	FCEU_RomModified();
 }
@@ -15,8 +15,17 @@ extern int normalscanlines;
 extern int totalscanlines;
 extern int postrenderscanlines;
 extern int vblankscanlines;
+extern bool lagOverclock;
+
+//With lagOverclock the overclocking scanlines only run while the frame has
+//not read input yet, the frames that would lag, and only for the games
+//listed here: ROM MD5s in hex, separated by spaces or commas.
+void FCEUI_SetLagOverclockGames(const char *md5s);
+bool FCEUI_LagOverclockListed(void);   //the loaded game is listed
+bool FCEU_OverclockNow(void);          //for the PPU, at the overclocking scanlines
 
 extern bool AutoResumePlay;
+extern bool computeOnlyMode;
 extern bool frameAdvanceLagSkip;
 extern char romNameWhenClosingEmulator[];
 
@@ -78,9 +87,22 @@ extern int RAMInitOption;
 uint8 FCEU_ReadRomByte(uint32 i);
 void FCEU_WriteRomByte(uint32 i, uint8 value);
 
+// Counts writes to the ROM image, for copies of it kept on other threads.
+// Code writing PRGptr/CHRptr directly has to call FCEU_RomModified() too.
+void FCEU_RomModified(void);
+uint32 FCEU_GetRomModifyCount(void);
+
 extern readfunc ARead[0x10000];
 extern writefunc BWrite[0x10000];
 
+//Same bytes as GetMem() on each address from A on, wrapping at $FFFF. RAM and
+//plain ROM pages are copied directly, everything else goes through GetMem().
+void FCEU_GetMemRange(uint16 A, uint8 *out, int len);
+
+//The len bytes from A on when they are internal RAM or a plain ROM/RAM page,
+//read with no side effect and no cheat in between; NULL otherwise.
+const uint8 *FCEU_GetPlainMemPtr(uint16 A, int len);
+
 enum GI {
 	GI_RESETM2	=1,
 	GI_POWER =2,
@@ -148,9 +170,7 @@ void FCEU_TogglePPU();
 void SetNESDeemph_OldHacky(uint8 d, int force);
 void DrawTextTrans(uint8 *dest, uint32 width, uint8 *textmsg, uint8 fgcolor);
 void FCEU_PutImage(void);
-#ifdef FRAMESKIP
 void FCEU_PutImageDummy(void);
-#endif
 
 #ifdef WIN32
 extern void UpdateCheckedMenuItems();
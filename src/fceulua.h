@@ -2,6 +2,9 @@
 #ifndef _FCEULUA_H
 #define _FCEULUA_H
 
+#include <string>
+#include <vector>
+
 enum LuaCallID
 {
 	LUACALL_BEFOREEMULATION,
@@ -69,13 +72,60 @@ void FCEU_ReloadLuaCode();
 void FCEU_LuaStop();
 int FCEU_LuaRunning();
 
+// Scripts started with FCEU_LuaAddScript run next to the one FCEU_LoadLuaCode
+// started, each in its own Lua state, and are stopped with it. Returns the
+// script's id, 0 on failure.
+int FCEU_LuaAddScript(const char *filename, const char *arg=NULL);
+void FCEU_LuaStopScript(int id);
+
 void FCEU_LuaReadZapper(const uint32* mouse_in, uint32* mouse_out);
 uint8 FCEU_LuaReadJoypad(int,uint8); // HACK - Function needs controller input
 int FCEU_LuaSpeed();
 int FCEU_LuaFrameskip();
+int FCEU_LuaLoopFrame();
+
+// Time the script took on the emulator thread: the main chunk's frames, the
+// frame and memory hook callbacks. All in microseconds.
+struct LuaCpuUsage
+{
+	double frameUs;         // during the last frame
+	double avgUs;           // moving average, over about a second of frames
+	double peakUs;          // longest frame since the script started
+	unsigned int hookCalls; // memory hook calls during the last frame
+	double budgetUs;        // the time a frame may take, 0 for no budget
+	unsigned int skippedCalls; // frame and memory hook calls the budget held back during the last frame
+};
+// Once a script has used its budget in a frame, its frame and memory hook
+// callbacks are skipped until the next one. 0 removes the budget.
+void FCEU_LuaSetScriptBudget(int id, double us);
+
+struct LuaScriptStatus
+{
+	int id;
+	std::string name;
+	bool running;
+	LuaCpuUsage usage;
+};
+void FCEU_LuaGetScripts(std::vector<LuaScriptStatus> &scripts);
 bool FCEU_LuaRerecordCountSkip();
 
 void FCEU_LuaGui(uint8 *XBuf);
+
+// With the overlay on, FCEU_LuaGui leaves the gui drawing to the video
+// driver, to be drawn over the picture at the output resolution instead of
+// blended into XBuf. Boxes, lines and pixels are kept as commands; text,
+// images and whatever follows them in the frame go to a 256x240 layer over
+// the commands.
+struct LuaGuiCommand
+{
+	int16 x1, y1, x2, y2;   // a filled rect's corners, inclusive, or a line's ends
+	uint32 colour;          // ARGB
+	bool line;
+};
+void FCEU_LuaSetGuiOverlay(bool enable);
+// The drawing of the last frame, false when there is none. layer is the
+// ARGB layer, or NULL when nothing was drawn into it.
+bool FCEU_LuaGetGuiOverlay(const LuaGuiCommand **commands, int *count, const uint32 **layer);
 void FCEU_LuaUpdatePalette();
 
 struct lua_State* FCEU_GetLuaState();
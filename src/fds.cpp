@@ -37,6 +37,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 //	TODO:  Add code to put a delay in between the time a disk is inserted
 //	and the when it can be successfully read/written to.  This should
@@ -80,6 +81,23 @@ static uint8 *diskdatao[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
 
 static uint8 *diskdata[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
 
+/* What savestate files keep of each side, its XOR with the original. */
+static uint8 *diskstate[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+/* Disk writes since the game was loaded, folded into the image when it is
+ * saved on close. Each entry points back at the one it was written after, so
+ * writing after loading an older state starts a branch and keeps the writes
+ * it went back over. Flat snapshots keep the entry the disk is at instead of
+ * the sides and are restored by walking the journal there. */
+struct FDSDiskWrite {
+	uint32 parent;
+	uint16 offset;
+	uint8 side, was, value;
+};
+static std::vector<FDSDiskWrite> diskJournal(1);
+static uint32 diskAt;		/* entry the disk is at, 0 for as loaded */
+static uint32 diskNode;		/* the same, as kept in snapshots */
+
 static int TotalSides; //mbg merge 7/17/06 - unsignedectomy
 static uint8 DiskWritten = 0;    /* Set to 1 if disk was written to. */
 static uint8 writeskip;
@@ -115,17 +133,70 @@ void FDSGI(GI h) {
 	}
 }
 
+static void ResetDiskJournal(void) {
+	diskJournal.assign(1, FDSDiskWrite());
+	diskAt = diskNode = 0;
+}
+
+static void JournalDiskWrite(int side, uint32 offset, uint8 V) {
+	uint8 *p = &diskdata[side][offset];
+	if (*p == V)
+		return;
+
+	FDSDiskWrite w;
+	w.parent = diskAt;
+	w.offset = offset;
+	w.side = side;
+	w.was = *p;
+	w.value = V;
+	diskJournal.push_back(w);
+	diskAt = diskNode = diskJournal.size() - 1;
+	*p = V;
+}
+
+/* Undoes the writes up to the branch both entries are on, then redoes the
+ * ones down to node. Parents always come before their children. */
+static void SeekDiskJournal(uint32 node) {
+	if (node >= diskJournal.size()) {
+		diskNode = diskAt;
+		return;
+	}
+
+	std::vector<uint32> redo;
+	uint32 at = diskAt, to = node;
+	while (at != to) {
+		if (at > to) {
+			const FDSDiskWrite &w = diskJournal[at];
+			diskdata[w.side][w.offset] = w.was;
+			at = w.parent;
+		} else {
+			redo.push_back(to);
+			to = diskJournal[to].parent;
+		}
+	}
+	for (size_t i = redo.size(); i-- > 0; ) {
+		const FDSDiskWrite &w = diskJournal[redo[i]];
+		diskdata[w.side][w.offset] = w.value;
+	}
+	diskAt = node;
+}
+
 static void FDSStateRestore(int version) {
 	int x;
 
 	setmirror(((FDSRegs[5] & 8) >> 3) ^ 1);
 
-	if (version >= 9810)
-		for (x = 0; x < TotalSides; x++) {
-			int b;
-			for (b = 0; b < 65500; b++)
-				diskdata[x][b] ^= diskdatao[x][b];
-		}
+	if (FCEU_state_restoring_snapshot) {
+		SeekDiskJournal(diskNode);
+		return;
+	}
+
+	/* A savestate file has the whole disk, what differs is journaled */
+	for (x = 0; x < TotalSides; x++) {
+		int b;
+		for (b = 0; b < 65500; b++)
+			JournalDiskWrite(x, b, version >= 9810 ? diskstate[x][b] ^ diskdatao[x][b] : diskstate[x][b]);
+	}
 }
 
 void FDSSound();
@@ -619,7 +690,7 @@ static DECLFW(FDSWrite) {
 			switch (mapperFDS_block) {
 				case DSK_FILEHDR:
 					if (mapperFDS_diskaddr < mapperFDS_blocklen) {
-						fds_disk() = V;
+						JournalDiskWrite(InDisk, mapperFDS_blockstart + mapperFDS_diskaddr, V);
 						DiskWritten = 1;
 						switch (mapperFDS_diskaddr) {
 							case 13: mapperFDS_filesize = V; break;
@@ -635,7 +706,7 @@ static DECLFW(FDSWrite) {
 					break;
 				default:
 					if (mapperFDS_diskaddr < mapperFDS_blocklen) {
-						fds_disk() = V;
+						JournalDiskWrite(InDisk, mapperFDS_blockstart + mapperFDS_diskaddr, V);
 					DiskWritten = 1;
 						mapperFDS_diskaddr++;
 					}
@@ -699,11 +770,17 @@ static DECLFW(FDSWrite) {
 static void FreeFDSMemory(void) {
 	int x;
 
-	for (x = 0; x < TotalSides; x++)
+	for (x = 0; x < TotalSides; x++) {
 		if (diskdata[x]) {
 			free(diskdata[x]);
 			diskdata[x] = 0;
 		}
+		if (diskstate[x]) {
+			free(diskstate[x]);
+			diskstate[x] = 0;
+		}
+	}
+	ResetDiskJournal();
 }
 
 static int SubLoad(FCEUFILE *fp) {
@@ -746,16 +823,7 @@ static void PreSave(void) {
 	for (x = 0; x < TotalSides; x++) {
 		int b;
 		for (b = 0; b < 65500; b++)
-			diskdata[x][b] ^= diskdatao[x][b];
-	}
-}
-
-static void PostSave(void) {
-	int x;
-	for (x = 0; x < TotalSides; x++) {
-		int b;
-		for (b = 0; b < 65500; b++)
-			diskdata[x][b] ^= diskdatao[x][b];
+			diskstate[x][b] = diskdata[x][b] ^ diskdatao[x][b];
 	}
 }
 
@@ -825,16 +893,15 @@ int FDSLoad(const char *name, FCEUFILE *fp) {
 
 	fclose(zp);
 
+	for (x = 0; x < TotalSides; x++) {
+		diskdatao[x] = (uint8*)FCEU_malloc(65500);
+		memcpy(diskdatao[x], diskdata[x], 65500);
+	}
+
 	if (!disableBatteryLoading) {
 		FCEUFILE *tp;
 		char *fn = strdup(FCEU_MakeFName(FCEUMKF_FDS, 0, 0).c_str());
 
-		int x;
-		for (x = 0; x < TotalSides; x++) {
-			diskdatao[x] = (uint8*)FCEU_malloc(65500);
-			memcpy(diskdatao[x], diskdata[x], 65500);
-		}
-
 		if ((tp = FCEU_fopen(fn, 0, "rb", 0))) {
 			FCEU_printf("Disk was written. Auxiliary FDS file open \"%s\".\n",fn);
 			FreeFDSMemory();
@@ -862,14 +929,19 @@ int FDSLoad(const char *name, FCEUFILE *fp) {
 	SelectDisk = 0;
 	InDisk = 255;
 
-	ResetExState(PreSave, PostSave);
+	for (x = 0; x < TotalSides; x++)
+		diskstate[x] = (uint8*)FCEU_malloc(65500);
+	PreSave();
+
+	ResetExState(PreSave, 0);
 	FDSSoundStateAdd();
 
 	for (x = 0; x < TotalSides; x++) {
 		char temp[8];
 		snprintf(temp, sizeof(temp), "DDT%d", x);
-		AddExState(diskdata[x], 65500, 0, temp);
+		AddExState(diskstate[x], 65500 | FCEUSTATE_NOSNAPSHOT, 0, temp);
 	}
+	AddExState(&diskNode, 4 | FCEUSTATE_SNAPSHOTONLY, 1, "DNOD");
 
 	AddExState(FDSRegs, sizeof(FDSRegs), 0, "FREG");
 	AddExState(&IRQCount, 4, 1, "IRQC");
@@ -47,11 +47,17 @@
 #include "state.h"
 #include "movie.h"
 #include "driver.h"
+#include "romcache.h"
 #include "utils/xstring.h"
 
 #ifndef WIN32
 #include <zlib.h>
 #endif
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -186,77 +192,139 @@ FileBaseInfo DetermineFileBase(const char *f) {
 
 inline FileBaseInfo DetermineFileBase(const std::string& str) { return DetermineFileBase(str.c_str()); }
 
-static FCEUFILE * TryUnzip(const std::string& path) {
-	unzFile tz;
-	if((tz=unzOpen(path.c_str())))  // If it's not a zip file, use regular file handlers.
-		// Assuming file type by extension usually works,
-		// but I don't like it. :)
+ArchiveScanRecord FCEU_ScanArchive(const std::string& path)
+{
+	ArchiveScanRecord asr;
+
+	if(FCEU_ArchiveIndexFind(path, "scan", asr))
+		return asr;
+
+	asr = FCEUD_ScanArchive(path);
+	if(asr.numFilesInArchive >= 0)
+		FCEU_ArchiveIndexStore(path, "scan", asr);
+	return asr;
+}
+
+ArchiveScanRecord FCEU_ScanZip(const std::string& path)
+{
+	ArchiveScanRecord asr;
+
+	if(FCEU_ArchiveIndexFind(path, "zip", asr))
+		return asr;
+
+	unzFile zf = unzOpen(path.c_str());
+	if(!zf)
+		return asr;
+
+	asr.type = 0;
+	for(int ret = unzGoToFirstFile(zf); ret == UNZ_OK; ret = unzGoToNextFile(zf))
 	{
-		if(unzGoToFirstFile(tz)==UNZ_OK)
-		{
-			for(;;)
-			{
-				char tempu[512];	// Longer filenames might be possible, but I don't
-				// think people would name files that long in zip files...
-				unzGetCurrentFileInfo(tz,0,tempu,512,0,0,0,0);
-				tempu[511]=0;
-				if(strlen(tempu)>=4)
-				{
-					char *za=tempu+strlen(tempu)-4;
+		char name[512];
+		unz_file_info info;
+		unz64_file_pos pos;
 
-					//if(!ext)
-					{
-						if(!strcasecmp(za,".nes") || !strcasecmp(za,".fds") ||
-							!strcasecmp(za,".nsf") || !strcasecmp(za,".unf") ||
-							!strcasecmp(za,".nez"))
-							break;
-					}
-					//else if(!strcasecmp(za,ext))
-					//	break;
-				}
-				if(strlen(tempu)>=5)
-				{
-					if(!strcasecmp(tempu+strlen(tempu)-5,".unif"))
-						break;
-				}
-				if(unzGoToNextFile(tz)!=UNZ_OK)
-				{
-					if(unzGoToFirstFile(tz)!=UNZ_OK) goto zpfail;
-					unzCloseCurrentFile(tz);
-					unzClose(tz);
-					return 0;
-				}
-			}
-			if(unzOpenCurrentFile(tz)!=UNZ_OK)
-				goto zpfail;
-		}
-		else
+		if(unzGetCurrentFileInfo(zf,&info,name,sizeof(name),0,0,0,0) != UNZ_OK || unzGetFilePos64(zf,&pos) != UNZ_OK)
+			break;
+		name[sizeof(name)-1] = 0;
+
+		FCEUARCHIVEFILEINFO_ITEM item;
+		item.name = name;
+		item.size = info.uncompressed_size;
+		item.index = (uint32)asr.files.size();
+		item.crc32 = info.crc;
+		item.dirPos = pos.pos_in_zip_directory;
+		item.fileNum = pos.num_of_file;
+		asr.files.push_back(item);
+	}
+	unzClose(zf);
+
+	asr.numFilesInArchive = (int)asr.files.size();
+	FCEU_ArchiveIndexStore(path, "zip", asr);
+	return asr;
+}
+
+FCEUFILE* FCEU_UnzipFile(const std::string& path, const FCEUARCHIVEFILEINFO_ITEM& item)
+{
+	unzFile zf = unzOpen(path.c_str());
+	if(!zf)
+		return 0;
+
+	unz64_file_pos pos;
+	pos.pos_in_zip_directory = item.dirPos;
+	pos.num_of_file = item.fileNum;
+
+	char name[512] = "";
+	bool found = unzGoToFilePos64(zf,&pos) == UNZ_OK
+		&& unzGetCurrentFileInfo(zf,0,name,sizeof(name),0,0,0,0) == UNZ_OK;
+	name[sizeof(name)-1] = 0;
+
+	//an index out of step with the archive lands on another file, or none
+	EMUFILE_MEMORY* ms = 0;
+	if(found && item.name == name && unzOpenCurrentFile(zf) == UNZ_OK)
+	{
+		//inflated straight into the buffer the loaders read. closing checks
+		//the CRC once all of it has been read
+		ms = new EMUFILE_MEMORY(item.size);
+		int n = item.size ? unzReadCurrentFile(zf,ms->buf(),item.size) : 0;
+		if(unzCloseCurrentFile(zf) != UNZ_OK || n != (int)item.size)
 		{
-zpfail:
-			unzClose(tz);
-			return 0;
+			delete ms;
+			ms = 0;
 		}
+	}
+	unzClose(zf);
 
-		unz_file_info ufo;
-		unzGetCurrentFileInfo(tz,&ufo,0,0,0,0,0,0);
+	if(!ms)
+		return 0;
 
-		int size = ufo.uncompressed_size;
-		EMUFILE_MEMORY* ms = new EMUFILE_MEMORY(size);
-		unzReadCurrentFile(tz,ms->buf(),ufo.uncompressed_size);
-		unzCloseCurrentFile(tz);
-		unzClose(tz);
+	FCEUFILE *fceufp = new FCEUFILE();
+	fceufp->stream = ms;
+	fceufp->size = item.size;
+	return fceufp;
+}
 
-		FCEUFILE *fceufp = new FCEUFILE();
-		fceufp->stream = ms;
-		fceufp->size = size;
-		return fceufp;
+//the first ROM in a zip, from its directory
+static FCEUFILE * TryUnzip(const std::string& path) {
+	ArchiveScanRecord asr = FCEU_ScanZip(path);
 
-	}
+	for(size_t i=0;i<asr.files.size();i++)
+	{
+		const char *name = asr.files[i].name.c_str();
+		size_t len = strlen(name);
+
+		if(len>=4)
+		{
+			const char *za = name+len-4;
 
+			if(!strcasecmp(za,".nes") || !strcasecmp(za,".fds") ||
+				!strcasecmp(za,".nsf") || !strcasecmp(za,".unf") ||
+				!strcasecmp(za,".nez"))
+				return FCEU_UnzipFile(path, asr.files[i]);
+		}
+		if(len>=5 && !strcasecmp(name+len-5,".unif"))
+			return FCEU_UnzipFile(path, asr.files[i]);
+	}
 	return 0;
 }
 
-FCEUFILE * FCEU_fopen(const char *path, const char *ipsfn, const char *mode, char *ext, int index, const char** extensions, int* userCancel)
+//keeps a decompressed copy of a ROM that was just inflated, so the next load can map it
+static void CacheRomImage(FCEUFILE *fp, const std::string& cacheKey)
+{
+	FCEU_RomCacheEntry entry;
+
+	if(cacheKey.empty())
+		return;
+
+	EMUFILE_MEMORY* ms = fp->EnsureMemorystream();
+	entry.filename = fp->filename;
+	entry.archiveCount = fp->archiveCount;
+	entry.archiveIndex = fp->archiveIndex;
+	if(FCEU_RomCacheWriteImage(cacheKey, entry, ms->buf(), fp->size))
+		FCEU_RomCacheStore(cacheKey, entry);
+	fp->romCacheKey = cacheKey;
+}
+
+FCEUFILE * FCEU_fopen(const char *path, const char *ipsfn, const char *mode, char *ext, int index, const char** extensions, int* userCancel, bool romLoad)
 {
 	FILE *ipsfile=0;
 	FCEUFILE *fceufp=0;
@@ -278,7 +346,41 @@ FCEUFILE * FCEU_fopen(const char *path, const char *ipsfn, const char *mode, cha
 		ipsfile=FCEUD_UTF8fopen(ipsfn,"rb");
 	if(read)
 	{
-		ArchiveScanRecord asr = FCEUD_ScanArchive(fileToOpen);
+		ArchiveScanRecord asr;
+		std::string cacheKey;
+		if(romLoad)
+			FCEU_RomCacheKey(cacheKey, fileToOpen, archive != "" ? fname : "", index);
+
+		//a copy decompressed by an earlier load skips the archive altogether
+		FCEU_RomCacheEntry cached;
+		if(FCEU_RomCacheFind(cacheKey, cached) && !cached.image.empty())
+		{
+			EMUFILE_MAPPED* ms = EMUFILE_MAPPED::open(cached.image.c_str());
+			if(ms)
+			{
+				fceufp = new FCEUFILE();
+				fceufp->filename = cached.filename;
+				fceufp->archiveCount = cached.archiveCount;
+				fceufp->archiveIndex = cached.archiveIndex;
+				if(fceufp->isArchive())
+				{
+					fceufp->archiveFilename = fileToOpen;
+					fceufp->fullFilename = fileToOpen + "|" + fceufp->filename;
+					fceufp->logicalPath = DetermineFileBase(fileToOpen).filebasedirectory + fceufp->filename;
+				}
+				else
+				{
+					fceufp->fullFilename = fileToOpen;
+					fceufp->logicalPath = fileToOpen;
+				}
+				fceufp->romCacheKey = cacheKey;
+				fceufp->stream = ms;
+				fceufp->size = ms->size();
+				goto applyips;
+			}
+		}
+
+		asr = FCEU_ScanArchive(fileToOpen);
 		if (asr.numFilesInArchive < 0)
 		{
 			// error occurred, return
@@ -310,6 +412,7 @@ FCEUFILE * FCEU_fopen(const char *path, const char *ipsfn, const char *mode, cha
 					fceufp->logicalPath = fileToOpen;
 					fceufp->fullFilename = fileToOpen;
 					fceufp->archiveIndex = -1;
+					CacheRomImage(fceufp, cacheKey);
 					goto applyips;
 				}
 			}
@@ -344,6 +447,7 @@ FCEUFILE * FCEU_fopen(const char *path, const char *ipsfn, const char *mode, cha
 						fceufp->archiveIndex = -1;
 						fceufp->stream = ms;
 						fceufp->size = size;
+						CacheRomImage(fceufp, cacheKey);
 						goto applyips;
 					}
 				}
@@ -356,7 +460,18 @@ FCEUFILE * FCEU_fopen(const char *path, const char *ipsfn, const char *mode, cha
 			fceufp->logicalPath = fileToOpen;
 			fceufp->fullFilename = fileToOpen;
 			fceufp->archiveIndex = -1;
+			fceufp->romCacheKey = cacheKey;
 			fceufp->stream = fp;
+			if(romLoad)
+			{
+				//the loaders copy the ROM out of the page cache directly
+				EMUFILE_MAPPED* ms = EMUFILE_MAPPED::open(fileToOpen.c_str());
+				if(ms)
+				{
+					delete fp;
+					fceufp->stream = ms;
+				}
+			}
 			FCEU_fseek(fceufp,0,SEEK_END);
 			fceufp->size = FCEU_ftell(fceufp);
 			FCEU_fseek(fceufp,0,SEEK_SET);
@@ -377,6 +492,10 @@ FCEUFILE * FCEU_fopen(const char *path, const char *ipsfn, const char *mode, cha
 
 			FileBaseInfo fbi = DetermineFileBase(fileToOpen);
 			fceufp->logicalPath = fbi.filebasedirectory + fceufp->filename;
+
+			//only when nobody had to be asked which file to open
+			if(archive != "" || index != -1 || asr.files.size() == 1)
+				CacheRomImage(fceufp, cacheKey);
 			goto applyips;
 		}
 
@@ -384,6 +503,9 @@ FCEUFILE * FCEU_fopen(const char *path, const char *ipsfn, const char *mode, cha
 		//try to open the ips file
 		if(!ipsfile && !ipsfn)
 			ipsfile=FCEUD_UTF8fopen(FCEU_MakeIpsFilename(DetermineFileBase(fceufp->logicalPath.c_str())),"rb");
+		//the hashes of a patched ROM are not those of the file
+		if(ipsfile)
+			fceufp->romCacheKey.clear();
 		ApplyIPS(ipsfile,fceufp);
 		return fceufp;
 	}
@@ -795,6 +917,19 @@ bool FCEU_isFileInArchive(const char *path)
 
 
 
+bool FCEU_SyncFile(FILE *fp)
+{
+	if(fflush(fp) != 0)
+		return false;
+#if defined(WIN32)
+	return _commit(_fileno(fp)) == 0;
+#elif defined(__APPLE__)
+	return fsync(fileno(fp)) == 0;
+#else
+	return fdatasync(fileno(fp)) == 0;
+#endif
+}
+
 void FCEUARCHIVEFILEINFO::FilterByExtension(const char** ext)
 {
 	if(!ext) return;
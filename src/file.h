@@ -37,6 +37,9 @@ struct FCEUFILE {
 	//the size of the file
 	size_t size;
 
+	//the key of this file in the ROM load cache, "" when it is not cached
+	std::string romCacheKey;
+
 	//whether the file is contained in an archive
 	bool isArchive() { return archiveCount > 0; }
 
@@ -80,6 +83,13 @@ struct FCEUFILE {
 struct FCEUARCHIVEFILEINFO_ITEM {
 	std::string name;
 	uint32 size, index;
+
+	//from the zip central directory (FCEU_ScanZip), 0 for other archives.
+	//dirPos and fileNum are where minizip finds the entry, see unzGoToFilePos64
+	uint32 crc32;
+	uint64 dirPos, fileNum;
+
+	FCEUARCHIVEFILEINFO_ITEM() : size(0), index(0), crc32(0), dirPos(0), fileNum(0) {}
 };
 
 class FCEUARCHIVEFILEINFO : public std::vector<FCEUARCHIVEFILEINFO_ITEM> {
@@ -121,10 +131,21 @@ struct ArchiveScanRecord
 	bool isArchive() { return type != -1; }
 };
 
+//FCEUD_ScanArchive, through the archive index of the ROM load cache (romcache.h)
+ArchiveScanRecord FCEU_ScanArchive(const std::string& path);
+//lists a zip from its central directory, also through the archive index;
+//type is -1 when path is not a zip
+ArchiveScanRecord FCEU_ScanZip(const std::string& path);
+//inflates one entry of FCEU_ScanZip's list into a memory stream, 0 on error
+FCEUFILE* FCEU_UnzipFile(const std::string& path, const FCEUARCHIVEFILEINFO_ITEM& item);
+
 
-FCEUFILE *FCEU_fopen(const char *path, const char *ipsfn, const char *mode, char *ext, int index=-1, const char** extensions = 0, int* userCancel = 0);
+//romLoad maps plain files rather than reading them, and goes through the ROM load cache (romcache.h)
+FCEUFILE *FCEU_fopen(const char *path, const char *ipsfn, const char *mode, char *ext, int index=-1, const char** extensions = 0, int* userCancel = 0, bool romLoad = false);
 bool FCEU_isFileInArchive(const char *path);
 int FCEU_fclose(FCEUFILE*);
+//flushes a stdio file and has the system put it on disk (fdatasync)
+bool FCEU_SyncFile(FILE *fp);
 uint64 FCEU_fread(void *ptr, size_t size, size_t nmemb, FCEUFILE*);
 uint64 FCEU_fwrite(void *ptr, size_t size, size_t nmemb, FCEUFILE*);
 int FCEU_fseek(FCEUFILE*, long offset, int whence);
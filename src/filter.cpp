@@ -7,18 +7,49 @@
 #include "x6502.h"
 #include "fceu.h"
 #include "filter.h"
+#include "startuptime.h"
 
 #include "fcoeffs.h"
 
 #include <cmath>
 #include <cstdio>
 
+#if !defined(NOSSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define FILTER_SSE2
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FILTER_NEON
+#include <arm_neon.h>
+#endif
+
 static int32 sq2coeffs[SQ2NCOEFFS];
 static int32 coeffs[NCOEFFS];
 
 static uint32 mrindex;
 static uint32 mrratio;
 
+static int64 sexyAcc1=0, sexyAcc2=0;
+static int64 lowpassAcc=0;
+
+void FCEU_GetFilterState(FCEU_FilterState *fs)
+{
+ fs->mrindex=mrindex;
+ fs->acc1=sexyAcc1;
+ fs->acc2=sexyAcc2;
+ fs->lowpassAcc=lowpassAcc;
+}
+
+void FCEU_SetFilterState(const FCEU_FilterState *fs)
+{
+ mrindex=fs->mrindex;
+ sexyAcc1=fs->acc1;
+ sexyAcc2=fs->acc2;
+ lowpassAcc=fs->lowpassAcc;
+}
+
 void SexyFilter2(int32 *in, int32 count)
 {
  #ifdef moo
@@ -32,7 +63,7 @@ void SexyFilter2(int32 *in, int32 count)
  c=p*0x100000;
  //printf("%f\n",(double)c/0x100000);
  #endif
- static int64 acc=0;
+ int64 &acc=lowpassAcc;
 
  while(count--)
  {
@@ -50,7 +81,7 @@ void SexyFilter2(int32 *in, int32 count)
 
 void SexyFilter(int32 *in, int32 *out, int32 count)
 {
- static int64 acc1=0,acc2=0;
+ int64 &acc1=sexyAcc1,&acc2=sexyAcc2;
  int32 mul1,mul2,vmul;
 
  mul1=(94<<16)/FSettings.SndRate;
@@ -81,6 +112,77 @@ void SexyFilter(int32 *in, int32 *out, int32 count)
  }
 }
 
+#if defined(FILTER_SSE2)
+static INLINE __m128i MulLo32(__m128i a, __m128i b)
+{
+#if defined(__SSE4_1__)
+	return _mm_mullo_epi32(a, b);
+#else
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+	                          _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+static INLINE int32 HorizontalSum(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(v);
+}
+#endif
+
+/* Runs the FIR for the two input positions that get interpolated into one
+   output sample. S points ncoeffs samples before the first of them.
+   The vector paths walk S and the coefficients in the same direction,
+   which gives the same sums because MakeFilters() builds symmetric
+   tables. ncoeffs is a multiple of 4.
+*/
+static INLINE void FIRPair(const int32 *S, const int32 *D, uint32 ncoeffs, int32 *acc, int32 *acc2)
+{
+#if defined(FILTER_SSE2)
+	__m128i sum = _mm_setzero_si128();
+	__m128i sum2 = _mm_setzero_si128();
+
+	for(uint32 c=0;c<ncoeffs;c+=4)
+	{
+		__m128i d = _mm_loadu_si128((const __m128i*)(D + c));
+		__m128i s1 = _mm_loadu_si128((const __m128i*)(S + 1 + c));
+		__m128i s2 = _mm_loadu_si128((const __m128i*)(S + 2 + c));
+		sum = _mm_add_epi32(sum, _mm_srai_epi32(MulLo32(s1, d), 6));
+		sum2 = _mm_add_epi32(sum2, _mm_srai_epi32(MulLo32(s2, d), 6));
+	}
+	*acc = HorizontalSum(sum);
+	*acc2 = HorizontalSum(sum2);
+#elif defined(FILTER_NEON)
+	int32x4_t sum = vdupq_n_s32(0);
+	int32x4_t sum2 = vdupq_n_s32(0);
+
+	for(uint32 c=0;c<ncoeffs;c+=4)
+	{
+		int32x4_t d = vld1q_s32(D + c);
+		sum = vaddq_s32(sum, vshrq_n_s32(vmulq_s32(vld1q_s32(S + 1 + c), d), 6));
+		sum2 = vaddq_s32(sum2, vshrq_n_s32(vmulq_s32(vld1q_s32(S + 2 + c), d), 6));
+	}
+	int32x2_t pair = vpadd_s32(vget_low_s32(sum), vget_high_s32(sum));
+	int32x2_t pair2 = vpadd_s32(vget_low_s32(sum2), vget_high_s32(sum2));
+	*acc = vget_lane_s32(vpadd_s32(pair, pair), 0);
+	*acc2 = vget_lane_s32(vpadd_s32(pair2, pair2), 0);
+#else
+	int32 a=0,a2=0;
+	unsigned int c;
+
+	for(c=ncoeffs;c;c--,D++)
+	{
+		a+=(S[c]**D)>>6;
+		a2+=(S[1+c]**D)>>6;
+	}
+	*acc = a;
+	*acc2 = a2;
+#endif
+}
+
 /* Returns number of samples written to out. */
 /* leftover is set to the number of samples that need to be copied
    from the end of in to the beginning of in.
@@ -109,15 +211,9 @@ int32 NeoFilterSound(int32 *in, int32 *out, uint32 inlen, int32 *leftover)
 	if(FSettings.soundq==2)
         for(x=mrindex;x<max;x+=mrratio)
         {
-			int32 acc=0,acc2=0;
-			unsigned int c;
-			int32 *S,*D;
+			int32 acc,acc2;
 
-			for(c=SQ2NCOEFFS,S=&in[(x>>16)-SQ2NCOEFFS],D=sq2coeffs;c;c--,D++)
-			{
-				acc+=(S[c]**D)>>6;
-				acc2+=(S[1+c]**D)>>6;
-			}
+			FIRPair(&in[(x>>16)-SQ2NCOEFFS],sq2coeffs,SQ2NCOEFFS,&acc,&acc2);
 
 			acc=((int64)acc*(65536-(x&65535))+(int64)acc2*(x&65535))>>(16+11);
 			*out=acc;
@@ -127,15 +223,9 @@ int32 NeoFilterSound(int32 *in, int32 *out, uint32 inlen, int32 *leftover)
 	else
 		for(x=mrindex;x<max;x+=mrratio)
 		{
-			int32 acc=0,acc2=0;
-			unsigned int c;
-			const int32 *S,*D;
+			int32 acc,acc2;
 
-			for(c=NCOEFFS,S=&in[(x>>16)-NCOEFFS],D=coeffs;c;c--,D++)
-			{
-				acc+=(S[c]**D)>>6;
-				acc2+=(S[1+c]**D)>>6;
-			}
+			FIRPair(&in[(x>>16)-NCOEFFS],coeffs,NCOEFFS,&acc,&acc2);
 
 			acc=((int64)acc*(65536-(x&65535))+(int64)acc2*(x&65535))>>(16+11);
 			*out=acc;
@@ -167,6 +257,8 @@ int32 NeoFilterSound(int32 *in, int32 *out, uint32 inlen, int32 *leftover)
 
 void MakeFilters(int32 rate)
 {
+ FCEU_StartupPhase phase("sound_filters");
+
  const int32 *tabs[8]={C44100NTSC,C44100PAL,C48000NTSC,C48000PAL,C96000NTSC,
         C96000PAL, nullptr, nullptr};
  const int32 *sq2tabs[8]={SQ2C44100NTSC,SQ2C44100PAL,SQ2C48000NTSC,SQ2C48000PAL,
@@ -1,3 +1,12 @@
 int32 NeoFilterSound(int32 *in, int32 *out, uint32 inlen, int32 *leftover);
 void MakeFilters(int32 rate);
 void SexyFilter(int32 *in, int32 *out, int32 count);
+
+//Filter history carried from one frame into the next
+struct FCEU_FilterState
+{
+	uint32 mrindex;
+	int64 acc1, acc2, lowpassAcc;
+};
+void FCEU_GetFilterState(FCEU_FilterState *fs);
+void FCEU_SetFilterState(const FCEU_FilterState *fs);
@@ -0,0 +1,213 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// framehash.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "palette.h"
+#include "video.h"
+#include "framehash.h"
+
+#include <cstring>
+
+#define HASH_WIDTH    256
+#define HASH_HEIGHT   240
+#define HASH_PLANE    (HASH_WIDTH * HASH_HEIGHT)
+
+// perceptual hash grid, HASH_WIDTH and HASH_HEIGHT divide evenly
+#define PHASH_GRID    8
+#define PHASH_BLOCKW  (HASH_WIDTH / PHASH_GRID)
+#define PHASH_BLOCKH  (HASH_HEIGHT / PHASH_GRID)
+
+//XXH64 as published by Yann Collet, little endian reads
+static const uint64 PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64 PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64 PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64 PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64 PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64 rotl64(uint64 x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64 read64(const uint8 *p)
+{
+	uint64 v;
+	memcpy(&v, p, 8);
+#ifdef FCEU_BIG_ENDIAN
+	v = ((v & 0x00000000000000FFULL) << 56) | ((v & 0x000000000000FF00ULL) << 40) |
+	    ((v & 0x0000000000FF0000ULL) << 24) | ((v & 0x00000000FF000000ULL) <<  8) |
+	    ((v & 0x000000FF00000000ULL) >>  8) | ((v & 0x0000FF0000000000ULL) >> 24) |
+	    ((v & 0x00FF000000000000ULL) >> 40) | ((v & 0xFF00000000000000ULL) >> 56);
+#endif
+	return v;
+}
+
+static inline uint32 read32(const uint8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+static inline uint64 xxhRound(uint64 acc, uint64 input)
+{
+	acc += input * PRIME64_2;
+	acc  = rotl64(acc, 31);
+	return acc * PRIME64_1;
+}
+
+static inline uint64 xxhMerge(uint64 acc, uint64 val)
+{
+	acc ^= xxhRound(0, val);
+	return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64 FCEU_XXH64(const void *data, size_t len, uint64 seed)
+{
+	const uint8 *p = (const uint8 *)data;
+	const uint8 *end = p + len;
+	uint64 h;
+
+	if (len >= 32)
+	{
+		const uint8 *limit = end - 32;
+		uint64 v1 = seed + PRIME64_1 + PRIME64_2;
+		uint64 v2 = seed + PRIME64_2;
+		uint64 v3 = seed;
+		uint64 v4 = seed - PRIME64_1;
+
+		do
+		{
+			v1 = xxhRound(v1, read64(p));
+			v2 = xxhRound(v2, read64(p+8));
+			v3 = xxhRound(v3, read64(p+16));
+			v4 = xxhRound(v4, read64(p+24));
+			p += 32;
+		} while (p <= limit);
+
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = xxhMerge(h, v1);
+		h = xxhMerge(h, v2);
+		h = xxhMerge(h, v3);
+		h = xxhMerge(h, v4);
+	}
+	else
+		h = seed + PRIME64_5;
+
+	h += (uint64)len;
+
+	for (; p + 8 <= end; p += 8)
+	{
+		h ^= xxhRound(0, read64(p));
+		h  = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+	}
+	if (p + 4 <= end)
+	{
+		h ^= (uint64)read32(p) * PRIME64_1;
+		h  = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+	for (; p < end; p++)
+	{
+		h ^= (*p) * PRIME64_5;
+		h  = rotl64(h, 11) * PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+static uint64 PerceptualHash(const uint8 *pix, const uint8 *deemph)
+{
+	uint8 luma[512];
+	uint32 block[PHASH_GRID * PHASH_GRID];
+	uint64 total = 0;
+	uint64 hash = 0;
+
+	//Rec. 601 luma of every (pixel, deemph) pair, same colors the blitters use
+	for (int i = 0; i < 512; i++)
+	{
+		if (palo)
+			luma[i] = (palo[i].r * 77 + palo[i].g * 150 + palo[i].b * 29) >> 8;
+		else
+			luma[i] = i & 0x3F;
+	}
+
+	memset(block, 0, sizeof(block));
+
+	for (int y = 0; y < HASH_HEIGHT; y++)
+	{
+		uint32 *b = block + (y / PHASH_BLOCKH) * PHASH_GRID;
+		const uint8 *p = pix + y * HASH_WIDTH;
+		const uint8 *d = deemph + y * HASH_WIDTH;
+
+		for (int bx = 0; bx < PHASH_GRID; bx++)
+		{
+			uint32 sum = 0;
+			for (int x = 0; x < PHASH_BLOCKW; x++)
+				sum += luma[(p[x] & 0x3F) | (d[x] << 6)];
+			b[bx] += sum;
+			p += PHASH_BLOCKW;
+			d += PHASH_BLOCKW;
+		}
+	}
+
+	for (int i = 0; i < PHASH_GRID * PHASH_GRID; i++)
+		total += block[i];
+
+	//compare block*64 with the frame total instead of dividing for the mean
+	for (int i = 0; i < PHASH_GRID * PHASH_GRID; i++)
+		if ((uint64)block[i] * (PHASH_GRID * PHASH_GRID) > total)
+			hash |= 1ULL << i;
+
+	return hash;
+}
+
+bool FCEUI_GetFrameHash(uint64 *exact, uint64 *perceptual)
+{
+	if (!GameInfo || !XBackBuf || !XDBuf)
+		return false;
+
+	if (exact)
+		*exact = FCEU_XXH64(XBackBuf, HASH_PLANE, FCEU_XXH64(XDBuf, HASH_PLANE, 0));
+
+	if (perceptual)
+		*perceptual = PerceptualHash(XBackBuf, XDBuf);
+
+	return true;
+}
+
+int FCEUI_FrameHashDistance(uint64 a, uint64 b)
+{
+	uint64 x = a ^ b;
+	int n = 0;
+
+	while (x)
+	{
+		x &= x - 1;
+		n++;
+	}
+	return n;
+}
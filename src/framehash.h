@@ -0,0 +1,51 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// framehash.h
+
+#pragma once
+
+#include "types.h"
+
+#include <cstddef>
+
+/*
+ *  Frame hashes, for scripts and bots that only need to know whether the
+ *  screen is in a known state (title screen, game over) and would otherwise
+ *  fetch and compare a whole screenshot.
+ *
+ *  Both hashes are taken on request from the emulator screen as the last
+ *  FCEU_PutImage() left it (XBackBuf, before the HUD and Lua drawing, with
+ *  the deemph plane XDBuf), so they do not change with on-screen messages.
+ *
+ *  exact       XXH64 of the 256x240 pixel plane, seeded with the XXH64 of
+ *              the deemph plane. Equal frames give equal hashes.
+ *  perceptual  an average hash: the frame is cut into 8x8 blocks of 32x30
+ *              pixels and bit n is set when block n (row major) is brighter
+ *              than the frame's mean. Similar frames differ in few bits,
+ *              compare with FCEUI_FrameHashDistance().
+ */
+
+// returns false when there is no frame to hash. perceptual may be NULL to skip it.
+bool FCEUI_GetFrameHash(uint64 *exact, uint64 *perceptual);
+
+// number of differing bits between two perceptual hashes, 0 to 64
+int FCEUI_FrameHashDistance(uint64 a, uint64 b);
+
+uint64 FCEU_XXH64(const void *data, size_t len, uint64 seed);
@@ -0,0 +1,398 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// guestprof.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "x6502.h"
+#include "debug.h"
+#include "debugsymboltable.h"
+#include "guestprof.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+
+bool fceuGuestProfiling = false;
+
+// one routine as called from one call stack
+struct GuestNode
+{
+	int    parent;
+	uint32 loc;
+	int    kind;
+	uint64 cycles;
+	uint64 calls;
+	std::map<uint64, int> children;
+};
+
+struct GuestFrame
+{
+	int node;
+	int sp;     // the stack pointer the routine returns to
+};
+
+// deeper calls are counted in the routine that made them
+static const size_t MAX_DEPTH = 64;
+
+// longer than any instruction and its DMA, a jump of the clock (state load)
+static const uint64 MAX_STEP = 0x10000;
+
+static std::vector<GuestNode> nodes;
+static std::vector<GuestFrame> frames;
+static std::unordered_map<uint32, uint64> instructions;
+static uint64 total;
+static uint64 last;
+static bool   counting;     // last is valid
+static uint32 lastLoc;
+static uint8  lastOp;
+static int    pendingKind = -1;
+static int    pendingSp;
+
+// bank+1 in the upper half, so RAM and unmapped code are bank 0
+static uint32 Loc(uint16 pc)
+{
+	int bank = pc < 0x8000 ? -1 : getBank(pc);
+	return ((uint32)(bank + 1) << 16) | pc;
+}
+
+static int LocBank(uint32 loc)
+{
+	return (int)(loc >> 16) - 1;
+}
+
+static void ResetNodes(void)
+{
+	nodes.clear();
+	frames.clear();
+
+	GuestNode root;
+	root.parent = -1;
+	root.loc = 0;
+	root.kind = FCEU_GUESTPROF_RESET;
+	root.cycles = root.calls = 0;
+	nodes.push_back(root);
+}
+
+static void Charge(uint64 now)
+{
+	if (counting && now > last && now - last < MAX_STEP)
+	{
+		uint64 d = now - last;
+		instructions[lastLoc] += d;
+		nodes[frames.empty() ? 0 : frames.back().node].cycles += d;
+		total += d;
+	}
+	last = now;
+	counting = true;
+}
+
+static void Enter(uint16 pc, int kind, int sp)
+{
+	if (frames.size() >= MAX_DEPTH)
+	{
+		return;
+	}
+	int cur = frames.empty() ? 0 : frames.back().node;
+	uint32 loc = Loc(pc);
+	uint64 key = ((uint64)kind << 32) | loc;
+	int child;
+	auto it = nodes[cur].children.find(key);
+
+	if (it == nodes[cur].children.end())
+	{
+		GuestNode node;
+		node.parent = cur;
+		node.loc = loc;
+		node.kind = kind;
+		node.cycles = node.calls = 0;
+		child = (int)nodes.size();
+		nodes.push_back(node);
+		nodes[cur].children[key] = child;
+	}
+	else
+	{
+		child = it->second;
+	}
+	nodes[child].calls++;
+
+	GuestFrame frame;
+	frame.node = child;
+	frame.sp = sp;
+	frames.push_back(frame);
+}
+
+// every routine the stack pointer got back above has returned
+static void Leave(int sp)
+{
+	while (!frames.empty() && frames.back().sp <= sp)
+	{
+		frames.pop_back();
+	}
+}
+
+// what the last instruction did to the call stack, pc being the next one
+static void Transition(uint16 pc)
+{
+	if (lastOp == 0x20)
+	{
+		Enter(pc, FCEU_GUESTPROF_CALL, (X.S + 2) & 0xFF);
+	}
+	else if (lastOp == 0x60 || lastOp == 0x40)
+	{
+		Leave(X.S);
+	}
+	lastOp = 0;
+}
+
+void FCEU_GuestProfileStep(uint16 pc, uint8 op)
+{
+	if (nodes.empty())
+	{
+		ResetNodes();
+	}
+	// the cycles of taking an interrupt go to its handler
+	if (pendingKind >= 0)
+	{
+		Enter(pc, pendingKind, pendingSp);
+		pendingKind = -1;
+		lastLoc = Loc(pc);
+	}
+	Charge(timestampbase + timestamp);
+	Transition(pc);
+	lastLoc = Loc(pc);
+	lastOp = op;
+}
+
+void FCEU_GuestProfileInterrupt(int kind, uint16 pc)
+{
+	if (nodes.empty())
+	{
+		ResetNodes();
+	}
+	Charge(timestampbase + timestamp);
+	Transition(pc);
+
+	if (kind == FCEU_GUESTPROF_RESET)
+	{
+		frames.clear();
+		pendingKind = -1;
+		return;
+	}
+	pendingKind = kind;
+	pendingSp = X.S;
+}
+
+//----------------------------------------------------------------------------
+
+void FCEUI_SetGuestProfiler(bool enable)
+{
+	fceuGuestProfiling = enable;
+	// the call stack is rebuilt from the next call on
+	frames.clear();
+	counting = false;
+	pendingKind = -1;
+	lastOp = 0;
+}
+
+bool FCEUI_GetGuestProfiler(void)
+{
+	return fceuGuestProfiling;
+}
+
+void FCEUI_ResetGuestProfile(void)
+{
+	ResetNodes();
+	instructions.clear();
+	total = 0;
+	counting = false;
+	pendingKind = -1;
+	lastOp = 0;
+}
+
+uint64 FCEU_GuestProfileTotal(void)
+{
+	return total;
+}
+
+static std::string LocName(uint32 loc, int kind)
+{
+	int bank = LocBank(loc);
+	uint16 addr = loc & 0xFFFF;
+	char name[32];
+
+	if (kind == FCEU_GUESTPROF_RESET)
+	{
+		return "(root)";
+	}
+	debugSymbol_t *sym = debugSymbolTable.getSymbolAtBankOffset(bank, addr);
+	if (sym != nullptr && !sym->name().empty())
+	{
+		return sym->name();
+	}
+
+	const char *prefix = kind == FCEU_GUESTPROF_NMI ? "NMI " : kind == FCEU_GUESTPROF_IRQ ? "IRQ " : "";
+	if (bank < 0)
+	{
+		snprintf(name, sizeof(name), "%s$%04X", prefix, addr);
+	}
+	else
+	{
+		snprintf(name, sizeof(name), "%s$%02X:%04X", prefix, bank, addr);
+	}
+	return name;
+}
+
+static bool MostCycles(const FCEU_GuestProfileEntry &a, const FCEU_GuestProfileEntry &b)
+{
+	return a.cycles > b.cycles;
+}
+
+static bool MostInclusive(const FCEU_GuestProfileEntry &a, const FCEU_GuestProfileEntry &b)
+{
+	return a.inclusive != b.inclusive ? a.inclusive > b.inclusive : a.cycles > b.cycles;
+}
+
+void FCEU_GuestProfileInstructions(std::vector<FCEU_GuestProfileEntry> &out, size_t max)
+{
+	out.clear();
+	out.reserve(instructions.size());
+
+	for (auto &i : instructions)
+	{
+		FCEU_GuestProfileEntry e;
+		e.bank = LocBank(i.first);
+		e.addr = i.first & 0xFFFF;
+		e.kind = FCEU_GUESTPROF_CALL;
+		e.cycles = e.inclusive = i.second;
+		e.calls = 0;
+		out.push_back(e);
+	}
+	std::sort(out.begin(), out.end(), MostCycles);
+	if (max && out.size() > max)
+	{
+		out.resize(max);
+	}
+	for (auto &e : out)
+	{
+		e.name = LocName(((uint32)(e.bank + 1) << 16) | e.addr, FCEU_GUESTPROF_CALL);
+	}
+}
+
+void FCEU_GuestProfileRoutines(std::vector<FCEU_GuestProfileEntry> &out, size_t max)
+{
+	std::map<uint64, FCEU_GuestProfileEntry> routines;
+	std::vector<uint64> subtree(nodes.size());
+
+	out.clear();
+
+	// children always come after their parent
+	for (size_t i = nodes.size(); i-- > 0; )
+	{
+		subtree[i] += nodes[i].cycles;
+		if (nodes[i].parent >= 0)
+		{
+			subtree[nodes[i].parent] += subtree[i];
+		}
+	}
+	for (size_t i = 1; i < nodes.size(); i++)
+	{
+		const GuestNode &node = nodes[i];
+		uint64 key = ((uint64)node.kind << 32) | node.loc;
+		auto it = routines.find(key);
+
+		if (it == routines.end())
+		{
+			FCEU_GuestProfileEntry e;
+			e.bank = LocBank(node.loc);
+			e.addr = node.loc & 0xFFFF;
+			e.kind = node.kind;
+			e.cycles = e.inclusive = e.calls = 0;
+			it = routines.insert(std::make_pair(key, e)).first;
+		}
+		it->second.cycles += node.cycles;
+		it->second.calls += node.calls;
+
+		// a routine that recursed is only counted once, at its outermost call
+		bool nested = false;
+		for (int p = node.parent; p > 0 && !nested; p = nodes[p].parent)
+		{
+			nested = nodes[p].loc == node.loc && nodes[p].kind == node.kind;
+		}
+		if (!nested)
+		{
+			it->second.inclusive += subtree[i];
+		}
+	}
+
+	for (auto &r : routines)
+	{
+		out.push_back(r.second);
+	}
+	std::sort(out.begin(), out.end(), MostInclusive);
+	if (max && out.size() > max)
+	{
+		out.resize(max);
+	}
+	for (auto &e : out)
+	{
+		e.name = LocName(((uint32)(e.bank + 1) << 16) | e.addr, e.kind);
+	}
+}
+
+std::string FCEU_GuestProfileCollapsed(void)
+{
+	std::vector<std::string> paths(nodes.size());
+	std::string out;
+	char count[32];
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		std::string name = LocName(nodes[i].loc, nodes[i].kind);
+
+		// the separators of the format
+		std::replace(name.begin(), name.end(), ';', '_');
+		std::replace(name.begin(), name.end(), ' ', '_');
+
+		paths[i] = nodes[i].parent >= 0 ? paths[nodes[i].parent] + ";" + name : name;
+
+		if (nodes[i].cycles)
+		{
+			snprintf(count, sizeof(count), " %llu\n", (unsigned long long)nodes[i].cycles);
+			out += paths[i] + count;
+		}
+	}
+	return out;
+}
+
+bool FCEU_GuestProfileWriteCollapsed(const char *path)
+{
+	FILE *fp = fopen(path, "w");
+
+	if (fp == nullptr)
+	{
+		return false;
+	}
+	std::string text = FCEU_GuestProfileCollapsed();
+	bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+
+	return fclose(fp) == 0 && ok;
+}
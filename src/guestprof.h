@@ -0,0 +1,83 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// guestprof.h
+
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+/*
+ *  Guest profiler. Where stageprof.h times the emulator, this counts the CPU
+ *  cycles of the game itself: every instruction run is charged to its
+ *  bank:address, and to the routine it runs in. Routines are followed from
+ *  JSR, NMI and IRQ to the RTS or RTI that brings the stack pointer back to
+ *  where it was, so code that drops its return address or returns through
+ *  a pushed one does not leave the call stack behind for good.
+ *
+ *  It runs in the instrumented CPU loop, at debugger speed. Names come from
+ *  the debugger symbol table (NL files or an imported ld65 .dbg), the
+ *  bank:address otherwise. Everything but the hooks has to be called with
+ *  the emulator locked.
+ */
+
+struct FCEU_GuestProfileEntry
+{
+	int         bank;       // getBank(), -1 outside of PRG ROM
+	uint16      addr;
+	int         kind;       // FCEU_GUESTPROF_*, for routines
+	std::string name;
+	uint64      cycles;     // in the instruction or routine itself
+	uint64      inclusive;  // routines: with the routines they call
+	uint64      calls;      // routines: times entered
+};
+
+enum
+{
+	FCEU_GUESTPROF_CALL = 0,
+	FCEU_GUESTPROF_NMI,
+	FCEU_GUESTPROF_IRQ,
+	FCEU_GUESTPROF_RESET,
+};
+
+void FCEUI_SetGuestProfiler(bool enable);
+bool FCEUI_GetGuestProfiler(void);
+void FCEUI_ResetGuestProfile(void);
+
+// Cycles counted since the last reset
+uint64 FCEU_GuestProfileTotal(void);
+
+// The max instructions or routines with the most cycles, most first;
+// routines by inclusive cycles. 0 for all of them.
+void FCEU_GuestProfileInstructions(std::vector<FCEU_GuestProfileEntry> &out, size_t max = 0);
+void FCEU_GuestProfileRoutines(std::vector<FCEU_GuestProfileEntry> &out, size_t max = 0);
+
+// Call stacks in the collapsed format of flamegraph.pl and speedscope,
+// one "outer;inner;innermost cycles" line for each
+std::string FCEU_GuestProfileCollapsed(void);
+bool FCEU_GuestProfileWriteCollapsed(const char *path);
+
+// From the instrumented CPU loop: before each instruction, and before an
+// interrupt or reset is taken with pc being the address it leaves
+extern bool fceuGuestProfiling;
+void FCEU_GuestProfileStep(uint16 pc, uint8 op);
+void FCEU_GuestProfileInterrupt(int kind, uint16 pc);
@@ -33,6 +33,8 @@
 #include "utils/memory.h"
 #include "utils/crc32.h"
 #include "utils/md5.h"
+#include "romcache.h"
+#include "romscan.h"
 #include "utils/xstring.h"
 #include "cheat.h"
 #include "vsuni.h"
@@ -42,6 +44,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <vector>
 
 extern SFORMAT FCEUVSUNI_STATEINFO[];
 
@@ -147,9 +151,9 @@ struct INPSEL {
 };
 
 /*
-* Function to set input controllers based on CRC
+* Function to find input controllers based on CRC
 */
-static void SetInput(void) {
+static bool FindInput(uint32 crc32, ESI *input1, ESI *input2, ESIFC *inputfc) {
 	static struct INPSEL moo[] =
 	{
 		{0x19b0a9f1,	SI_GAMEPAD,		SI_ZAPPER,		SIFC_NONE		},	// 6-in-1 (MGC-023)(Unl)[!]
@@ -227,14 +231,19 @@ static void SetInput(void) {
 	int x = 0;
 
 	while (moo[x].input1 >= 0 || moo[x].input2 >= 0 || moo[x].inputfc >= 0) {
-		if (moo[x].crc32 == iNESGameCRC32) {
-			GameInfo->input[0] = moo[x].input1;
-			GameInfo->input[1] = moo[x].input2;
-			GameInfo->inputfc = moo[x].inputfc;
-			break;
+		if (moo[x].crc32 == crc32) {
+			*input1 = moo[x].input1;
+			*input2 = moo[x].input2;
+			*inputfc = moo[x].inputfc;
+			return true;
 		}
 		x++;
 	}
+	return false;
+}
+
+static void SetInput(void) {
+	FindInput(iNESGameCRC32, &GameInfo->input[0], &GameInfo->input[1], &GameInfo->inputfc);
 }
 
 struct INPSEL_NES20 {
@@ -245,10 +254,9 @@ struct INPSEL_NES20 {
 };
 
 /*
-* Function to set input controllers based on NES 2.0 header
+* Function to find input controllers based on NES 2.0 header
 */
-extern int eoptions;
-static void SetInputNes20(uint8 expansion) {
+static bool FindInputNes20(uint8 expansion, ESI *input1, ESI *input2, ESIFC *inputfc) {
 	static struct INPSEL_NES20 moo[] =
 	{
 		{0x01,			SI_GAMEPAD,		SI_GAMEPAD,		SIFC_UNSET		}, // Standard NES/Famicom controllers
@@ -281,18 +289,25 @@ static void SetInputNes20(uint8 expansion) {
 
 	int x = 0;
 
-	if (expansion == 0x02) 
-		eoptions |= 32768; // dirty hack to enable Four-Score
-	GameInfo->vs_cswitch = expansion == 0x05;		
-
 	while (moo[x].expansion_id) {
 		if (moo[x].expansion_id == expansion) {
-			GameInfo->input[0] = moo[x].input1;
-			GameInfo->input[1] = moo[x].input2;
-			GameInfo->inputfc = moo[x].inputfc;
-			break;		}
+			*input1 = moo[x].input1;
+			*input2 = moo[x].input2;
+			*inputfc = moo[x].inputfc;
+			return true;
+		}
 		x++;
 	}
+	return false;
+}
+
+extern int eoptions;
+static void SetInputNes20(uint8 expansion) {
+	if (expansion == 0x02) 
+		eoptions |= 32768; // dirty hack to enable Four-Score
+	GameInfo->vs_cswitch = expansion == 0x05;		
+
+	FindInputNes20(expansion, &GameInfo->input[0], &GameInfo->input[1], &GameInfo->inputfc);
 }
 
 #define INESB_INCOMPLETE  1
@@ -343,7 +358,11 @@ static const TMasterRomInfo sMasterRomInfo[] = {
 const TMasterRomInfo* MasterRomInfo;
 TMasterRomInfoParams MasterRomInfoParams;
 
-static void CheckHInfo(uint64 partialmd5) {
+/* Corrects the mapper, mirroring and battery flag of an image from what is
+known about its CRC32 and MD5. Returns what was changed, bit 3 meaning the
+image should not have any CHR ROM.
+*/
+static int32 FixHInfo(uint32 crc32, uint64 partialmd5, bool hasCHR, int *mapper, uint8 *mirroring, bool *battery) {
 	/* ROM images that have the battery-backed bit set in the header that really
 	don't have battery-backed RAM is not that big of a problem, so I'll
 	treat this differently by only listing games that should have battery-backed RAM.
@@ -395,56 +414,35 @@ static void CheckHInfo(uint64 partialmd5) {
 	};
 	int32 tofix = 0, x, mask;
 
-	MasterRomInfo = NULL;
-	for (size_t i = 0; i < ARRAY_SIZE(sMasterRomInfo); i++) {
-		const TMasterRomInfo& info = sMasterRomInfo[i];
-		if (info.md5lower != partialmd5)
-			continue;
-
-		MasterRomInfo = &info;
-		if (!info.params) break;
-
-		std::vector<std::string> toks = tokenize_str(info.params, ",");
-		for (size_t j = 0; j < toks.size(); j++) {
-			std::vector<std::string> parts = tokenize_str(toks[j], "=");
-			MasterRomInfoParams[parts[0]] = parts[1];
-		}
-		break;
-	}
-
 	x = 0;
 	do {
-		if (moo[x].crc32 == iNESGameCRC32) {
+		if (moo[x].crc32 == crc32) {
 			if (moo[x].mapper >= 0) {
-				if (moo[x].mapper & 0x800 && VROM_size) {
-					VROM_size = 0;
-					free(VROM);
-					VROM = NULL;
+				if (moo[x].mapper & 0x800 && hasCHR)
 					tofix |= 8;
-				}
 				if (moo[x].mapper & 0x1000)
 					mask = 0xFFF;
 				else
 					mask = 0xFF;
-				if (MapperNo != (moo[x].mapper & mask)) {
+				if (*mapper != (moo[x].mapper & mask)) {
 					tofix |= 1;
-					MapperNo = moo[x].mapper & mask;
+					*mapper = moo[x].mapper & mask;
 				}
 			}
 			if (moo[x].mirror >= 0) {
 				if (moo[x].mirror == 8) {
-					if (Mirroring == 2) {	/* Anything but hard-wired(four screen). */
+					if (*mirroring == 2) {	/* Anything but hard-wired(four screen). */
 						tofix |= 2;
-						Mirroring = 0;
+						*mirroring = 0;
 					}
-				} else if (Mirroring != moo[x].mirror) {
-					if (Mirroring != (moo[x].mirror & ~4))
+				} else if (*mirroring != moo[x].mirror) {
+					if (*mirroring != (moo[x].mirror & ~4))
 						if ((moo[x].mirror & ~4) <= 2)	/* Don't complain if one-screen mirroring
 														needs to be set(the iNES header can't
 														hold this information).
 														*/
 							tofix |= 2;
-					Mirroring = moo[x].mirror;
+					*mirroring = moo[x].mirror;
 				}
 			}
 			break;
@@ -455,9 +453,9 @@ static void CheckHInfo(uint64 partialmd5) {
 	x = 0;
 	while (savie[x] != 0) {
 		if (savie[x] == partialmd5) {
-			if (!(head.ROM_type & 2)) {
+			if (!*battery) {
 				tofix |= 4;
-				head.ROM_type |= 2;
+				*battery = true;
 			}
 		}
 		x++;
@@ -466,14 +464,46 @@ static void CheckHInfo(uint64 partialmd5) {
 	/* Games that use these iNES mappers tend to have the four-screen bit set
 	when it should not be.
 	*/
-	if ((MapperNo == 118 || MapperNo == 24 || MapperNo == 26) && (Mirroring == 2)) {
-		Mirroring = 0;
+	if ((*mapper == 118 || *mapper == 24 || *mapper == 26) && (*mirroring == 2)) {
+		*mirroring = 0;
 		tofix |= 2;
 	}
 
 	/* Four-screen mirroring implicitly set. */
-	if (MapperNo == 99)
-		Mirroring = 2;
+	if (*mapper == 99)
+		*mirroring = 2;
+
+	return tofix;
+}
+
+static void CheckHInfo(uint64 partialmd5) {
+	MasterRomInfo = NULL;
+	for (size_t i = 0; i < ARRAY_SIZE(sMasterRomInfo); i++) {
+		const TMasterRomInfo& info = sMasterRomInfo[i];
+		if (info.md5lower != partialmd5)
+			continue;
+
+		MasterRomInfo = &info;
+		if (!info.params) break;
+
+		std::vector<std::string> toks = tokenize_str(info.params, ",");
+		for (size_t j = 0; j < toks.size(); j++) {
+			std::vector<std::string> parts = tokenize_str(toks[j], "=");
+			MasterRomInfoParams[parts[0]] = parts[1];
+		}
+		break;
+	}
+
+	bool battery = (head.ROM_type & 2) != 0;
+	int32 tofix = FixHInfo(iNESGameCRC32, partialmd5, VROM_size != 0, &MapperNo, &Mirroring, &battery);
+
+	if (tofix & 8) {
+		VROM_size = 0;
+		free(VROM);
+		VROM = NULL;
+	}
+	if (battery)
+		head.ROM_type |= 2;
 
 	if (tofix)
 	{
@@ -818,6 +848,70 @@ BMAPPINGLocal bmap[] = {
 	{"",					0, NULL}
 };
 
+// ROM names that say the image is for a PAL console
+static bool iNESNameIsPAL(const char *name) {
+	return strstr(name, "(E)") || strstr(name, "(e)")
+		|| strstr(name, "(Europe)") || strstr(name, "(PAL)")
+		|| strstr(name, "(F)") || strstr(name, "(f)")
+		|| strstr(name, "(G)") || strstr(name, "(g)")
+		|| strstr(name, "(I)") || strstr(name, "(i)");
+}
+
+// PRG and CHR ROM sizes in a header. PRG is rounded up to a power of 2 for
+// PRGCartMapping; round_size is false for the mappers whose images only hold
+// not_round bytes of it.
+static void iNESROMSizes(const iNES_HEADER &h, bool ines2, int mapper, int *rom_size, int *not_round, int *vrom_size, int *round_size) {
+	int not_round_size = 0;
+	int rom_size_bytes = 0;
+	int vrom_size_bytes = 0;
+
+	if (!ines2)	{
+		not_round_size = h.ROM_size << 14;
+	}
+	else {
+		if ((h.Upper_ROM_VROM_size & 0x0F) != 0x0F)
+			// simple notation
+			not_round_size = (h.ROM_size | ((h.Upper_ROM_VROM_size & 0x0F) << 8)) << 14;
+		else
+			// exponent-multiplier notation
+			not_round_size = ((1 << (h.ROM_size >> 2)) * ((h.ROM_size & 0b11) * 2 + 1));
+	}
+	
+	if (!h.ROM_size && !ines2)
+		rom_size_bytes = 256 << 14;
+	else
+		rom_size_bytes = uppow2(not_round_size);
+
+	if (!ines2)	{
+		vrom_size_bytes = uppow2(h.VROM_size << 13);
+	}
+	else {
+		if ((h.Upper_ROM_VROM_size & 0xF0) != 0xF0)
+			// simple notation
+			vrom_size_bytes = uppow2((h.VROM_size | ((h.Upper_ROM_VROM_size & 0xF0) << 4)) << 13);
+		else
+			vrom_size_bytes = ((1 << (h.VROM_size >> 2)) * ((h.VROM_size & 0b11) * 2 + 1));
+	}
+
+	int round = true;
+	for (int i = 0; i != sizeof(not_power2) / sizeof(not_power2[0]); ++i) {
+		//for games not to the power of 2, so we just read enough
+		//prg rom from it, but we have to keep ROM_size to the power of 2
+		//since PRGCartMapping wants ROM_size to be to the power of 2
+		//so instead if not to power of 2, we just use h.ROM_size when
+		//we use FCEU_read
+		if (not_power2[i] == mapper) {
+			round = false;
+			break;
+		}
+	}
+
+	*rom_size = rom_size_bytes;
+	*not_round = not_round_size;
+	*vrom_size = vrom_size_bytes;
+	*round_size = round;
+}
+
 int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	int result;
 	struct md5_context md5;
@@ -827,6 +921,12 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 
 	if (FCEU_fread(&head, 1, 16, fp) != 16 || memcmp(&head, "NES\x1A", 4))
 		return LOADER_INVALID_FORMAT;
+
+	// hashes of an earlier load of the same file, header checked in case
+	FCEU_RomCacheEntry cached;
+	bool useCached = FCEU_RomCacheFind(fp->romCacheKey, cached) && cached.hashed &&
+		!memcmp(cached.header, &head, sizeof(cached.header));
+	memcpy(cached.header, &head, sizeof(cached.header));
 	// Remove header size from filesize
 	filesize -= 16;
 
@@ -857,50 +957,8 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	MirroringAs2bits = head.ROM_type & 1;
 	if (head.ROM_type & 8) MirroringAs2bits |= 2;
 
-	int not_round_size = 0;
-	int rom_size_bytes = 0;
-	int vrom_size_bytes = 0;
-
-	if (!iNES2)	{
-		not_round_size = head.ROM_size << 14;
-	}
-	else {
-		if ((head.Upper_ROM_VROM_size & 0x0F) != 0x0F)
-			// simple notation
-			not_round_size = (head.ROM_size | ((head.Upper_ROM_VROM_size & 0x0F) << 8)) << 14;
-		else
-			// exponent-multiplier notation
-			not_round_size = ((1 << (head.ROM_size >> 2)) * ((head.ROM_size & 0b11) * 2 + 1));
-	}
-	
-	if (!head.ROM_size && !iNES2)
-		rom_size_bytes = 256 << 14;
-	else
-		rom_size_bytes = uppow2(not_round_size);
-
-	if (!iNES2)	{
-		vrom_size_bytes = uppow2(head.VROM_size << 13);
-	}
-	else {
-		if ((head.Upper_ROM_VROM_size & 0xF0) != 0xF0)
-			// simple notation
-			vrom_size_bytes = uppow2((head.VROM_size | ((head.Upper_ROM_VROM_size & 0xF0) << 4)) << 13);
-		else
-			vrom_size_bytes = ((1 << (head.VROM_size >> 2)) * ((head.VROM_size & 0b11) * 2 + 1));
-	}
-
-	int round = true;
-	for (int i = 0; i != sizeof(not_power2) / sizeof(not_power2[0]); ++i) {
-		//for games not to the power of 2, so we just read enough
-		//prg rom from it, but we have to keep ROM_size to the power of 2
-		//since PRGCartMapping wants ROM_size to be to the power of 2
-		//so instead if not to power of 2, we just use head.ROM_size when
-		//we use FCEU_read
-		if (not_power2[i] == MapperNo) {
-			round = false;
-			break;
-		}
-	}
+	int not_round_size, rom_size_bytes, vrom_size_bytes, round;
+	iNESROMSizes(head, iNES2 != 0, MapperNo, &rom_size_bytes, &not_round_size, &vrom_size_bytes, &round);
 
 	ROM_size = rom_size_bytes >> 14;
 	VROM_size = vrom_size_bytes >> 13;
@@ -988,16 +1046,26 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 		FCEU_printf(" Misc ROM size : %d\n", MiscROM_size);
 	}
 
-	md5_starts(&md5); 
-	md5_update(&md5, ROM, rom_size_bytes);
+	if (useCached) {
+		iNESGameCRC32 = cached.crc32;
+		memcpy(iNESCart.MD5, cached.md5, sizeof(iNESCart.MD5));
+	} else {
+		md5_starts(&md5); 
+		md5_update(&md5, ROM, rom_size_bytes);
 
-	iNESGameCRC32 = CalcCRC32(0, ROM, rom_size_bytes);
+		iNESGameCRC32 = CalcCRC32(0, ROM, rom_size_bytes);
 
-	if (vrom_size_bytes) {
-		iNESGameCRC32 = CalcCRC32(iNESGameCRC32, VROM, vrom_size_bytes);
-		md5_update(&md5, VROM, vrom_size_bytes);
+		if (vrom_size_bytes) {
+			iNESGameCRC32 = CalcCRC32(iNESGameCRC32, VROM, vrom_size_bytes);
+			md5_update(&md5, VROM, vrom_size_bytes);
+		}
+		md5_finish(&md5, iNESCart.MD5);
+
+		cached.hashed = true;
+		cached.crc32 = iNESGameCRC32;
+		memcpy(cached.md5, iNESCart.MD5, sizeof(cached.md5));
+		FCEU_RomCacheStore(fp->romCacheKey, cached);
 	}
-	md5_finish(&md5, iNESCart.MD5);
 	memcpy(&GameInfo->MD5, &iNESCart.MD5, sizeof(iNESCart.MD5));
 	for (int x = 0; x < 8; x++)
 		partialmd5 |= (uint64)iNESCart.MD5[7 - x] << (x * 8);
@@ -1114,18 +1182,106 @@ init_ok:
 	if (iNES2) {
 		FCEUI_SetVidSystem(((head.TV_system & 3) == 1) ? 1 : 0);
 	} else if (OverwriteVidMode) {
-		if (strstr(name, "(E)") || strstr(name, "(e)")
-			|| strstr(name, "(Europe)") || strstr(name, "(PAL)")
-			|| strstr(name, "(F)") || strstr(name, "(f)")
-			|| strstr(name, "(G)") || strstr(name, "(g)")
-			|| strstr(name, "(I)") || strstr(name, "(i)"))
-			FCEUI_SetVidSystem(1);
-		else
-			FCEUI_SetVidSystem(0);
+		FCEUI_SetVidSystem(iNESNameIsPAL(name) ? 1 : 0);
 	}
 	return LOADER_OK;
 }
 
+// What iNESLoad() would find out about an image in memory, without loading
+// it or touching any of the globals above. Used by the ROM library scanner.
+bool iNESScan(const uint8 *data, size_t size, const char *name, FCEU_RomScanEntry &entry) {
+	iNES_HEADER h;
+
+	if (size < 16 || memcmp(data, "NES\x1A", 4))
+		return false;
+	memcpy(&h, data, 16);
+	h.cleanup();
+
+	bool ines2 = ((h.ROM_type2 & 0x0C) == 0x08);
+	int mapper = (h.ROM_type >> 4) | (h.ROM_type2 & 0xF0);
+	if (ines2)
+		mapper |= ((h.ROM_type3 & 0x0F) << 8);
+	uint8 mirroring = (h.ROM_type & 8) ? 2 : (h.ROM_type & 1);
+
+	int rom_size_bytes, not_round_size, vrom_size_bytes, round;
+	iNESROMSizes(h, ines2, mapper, &rom_size_bytes, &not_round_size, &vrom_size_bytes, &round);
+	// nonsense sizes in a header are not worth allocating for
+	if (rom_size_bytes <= 0 || rom_size_bytes > (64 << 20) || vrom_size_bytes < 0 || vrom_size_bytes > (64 << 20))
+		return false;
+
+	// hashed the way iNESLoad() reads them, padded with 0xFF
+	size_t pos = 16 + ((h.ROM_type & 4) ? 512 : 0);
+	std::vector<uint8> prg(rom_size_bytes, 0xFF), chr(vrom_size_bytes, 0xFF);
+	size_t n = (pos < size) ? std::min(size - pos, (size_t)(round ? rom_size_bytes : not_round_size)) : 0;
+	memcpy(prg.data(), data + pos, n);
+	pos += n;
+	n = (pos < size) ? std::min(size - pos, chr.size()) : 0;
+	memcpy(chr.data(), data + pos, n);
+
+	struct md5_context md5;
+	md5_starts(&md5);
+	md5_update(&md5, prg.data(), prg.size());
+	entry.crc32 = CalcCRC32(0, prg.data(), prg.size());
+	if (!chr.empty()) {
+		entry.crc32 = CalcCRC32(entry.crc32, chr.data(), chr.size());
+		md5_update(&md5, chr.data(), chr.size());
+	}
+	md5_finish(&md5, entry.md5);
+
+	uint64 partialmd5 = 0;
+	for (int x = 0; x < 8; x++)
+		partialmd5 |= (uint64)entry.md5[7 - x] << (x * 8);
+
+	ESI input1 = SI_UNSET, input2 = SI_UNSET;
+	ESIFC inputfc = SIFC_UNSET;
+	FindInput(entry.crc32, &input1, &input2, &inputfc);
+	if (ines2)
+		FindInputNes20(h.expansion, &input1, &input2, &inputfc);
+
+	bool battery = (h.ROM_type & 2) != 0;
+	int32 tofix = FixHInfo(entry.crc32, partialmd5, vrom_size_bytes != 0, &mapper, &mirroring, &battery);
+
+	if (!ines2)
+		entry.vsSystem = (h.ROM_type2 & 1) != 0;
+	else
+		entry.vsSystem = (!(h.ROM_type2 & 2) ? (h.ROM_type2 & 3) : (h.VS_hardware & 0xF)) == 1;
+	if (const VSUNIENTRY *vs = FCEU_VSUniFind(partialmd5)) {
+		mapper = vs->mapper;
+		mirroring = vs->mirroring;
+		entry.vsSystem = true;
+	}
+
+	entry.format = ines2 ? ROMSCAN_NES20 : ROMSCAN_INES;
+	entry.mapper = mapper;
+	entry.submapper = ines2 ? (h.ROM_type3 >> 4) : 0;
+	entry.prgSize = round ? rom_size_bytes : not_round_size;
+	entry.chrSize = (tofix & 8) ? 0 : vrom_size_bytes;
+	if (ines2) {
+		entry.prgRam = (h.RAM_size & 0x0F) ? (64 << (h.RAM_size & 0x0F)) : 0;
+		entry.prgNvram = (h.RAM_size & 0xF0) ? (64 << ((h.RAM_size & 0xF0) >> 4)) : 0;
+		entry.chrRam = (h.VRAM_size & 0x0F) ? (64 << (h.VRAM_size & 0x0F)) : 0;
+		entry.chrNvram = (h.VRAM_size & 0xF0) ? (64 << ((h.VRAM_size & 0xF0) >> 4)) : 0;
+	}
+	entry.mirroring = mirroring;
+	entry.battery = battery;
+	entry.trainer = (h.ROM_type & 4) != 0;
+	entry.input[0] = input1;
+	entry.input[1] = input2;
+	entry.inputfc = inputfc;
+
+	if (ines2) {
+		entry.region = h.TV_system & 3;
+	} else {
+		const char *base = name;
+		if (strrchr(base, '/'))
+			base = strrchr(base, '/') + 1;
+		if (strrchr(base, '\\'))
+			base = strrchr(base, '\\') + 1;
+		entry.region = iNESNameIsPAL(base) ? ROMSCAN_PAL : ROMSCAN_NTSC;
+	}
+	return true;
+}
+
 // bbit edited: the whole function below was added
 int iNesSave(void) {
 	char name[2048];
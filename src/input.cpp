@@ -35,6 +35,7 @@
 #include "vsuni.h"
 #include "fds.h"
 #include "driver.h"
+#include "reversedebug.h"
 
 #ifdef __FCEU_REST_API_ENABLE__
 #include "drivers/Qt/RestApi/InputApi.h"
@@ -122,12 +123,35 @@ FCPORT portFC;
 FILE* DumpInputFile;
 FILE* PlayInputFile;
 
+//devices whose update waits for the game to touch $4016/$4017, see FCEU_UpdateInput
+static bool JPortUpdatePending[2];
+static bool FCPortUpdatePending = false;
+
+static void UpdatePendingDevices(void)
+{
+	for(int port=0;port<2;port++)
+	{
+		if(JPortUpdatePending[port])
+		{
+			JPortUpdatePending[port] = false;
+			joyports[port].driver->Update(port,joyports[port].ptr,joyports[port].attrib);
+		}
+	}
+	if(FCPortUpdatePending)
+	{
+		FCPortUpdatePending = false;
+		portFC.driver->Update(portFC.ptr,portFC.attrib);
+	}
+}
+
 static DECLFR(JPRead)
 {
 	lagFlag = 0;
 	uint8 ret=0;
 	static bool microphone = false;
 
+	UpdatePendingDevices();
+
 	ret|=joyports[A&1].driver->Read(A&1);
 
 	// Test if the port 2 start button is being pressed.
@@ -165,8 +189,16 @@ static DECLFR(JPRead)
 	return(ret);
 }
 
+//strobe-time sampling, see FCEUI_SetInputSampler
+static void (*InputSampler)(void) = 0;
+static bool StrobeSampled = false;
+static uint8 StrobeRaw[4];
+static void StrobeSample(void);
+
 static DECLFW(B4016)
 {
+	UpdatePendingDevices();
+
 	if(portFC.driver)
 		portFC.driver->Write(V&7);
 
@@ -184,6 +216,8 @@ static DECLFW(B4016)
 
 		//mbg 6/7/08 - I guess he means that the input drivers could track the strobing themselves
 		//I dont see why it is unreasonable here.
+		if(InputSampler && !StrobeSampled)
+			StrobeSample();
 		for(int i=0;i<2;i++)
 			joyports[i].driver->Strobe(i);
 		if(portFC.driver)
@@ -453,15 +487,82 @@ extern bool NetPlayActive(void);
 void NetPlayReadInputFrame(uint8_t* joy);
 #endif
 
+//Devices that only latch the driver's buttons or keys can wait until the game
+//strobes or reads them, a frame that never touches $4016/$4017 skips them.
+//Pads, light guns (their aim is needed while the lines render) and mice (the
+//driver hands over motion once) are always updated.
+static bool JPortDefersUpdate(int port)
+{
+	switch(joyports[port].type)
+	{
+	case SI_POWERPADA:
+	case SI_POWERPADB:
+	case SI_ARKANOID:
+	case SI_VIRTUALBOY:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool FCPortDefersUpdate(void)
+{
+	switch(portFC.type)
+	{
+	case SIFC_ARKANOID:
+	case SIFC_FKB:
+	case SIFC_SUBORKB:
+	case SIFC_PEC586KB:
+	case SIFC_HYPERSHOT:
+	case SIFC_MAHJONG:
+	case SIFC_QUIZKING:
+	case SIFC_FTRAINERA:
+	case SIFC_FTRAINERB:
+	case SIFC_TOPRIDER:
+		return true;
+	default:
+		return false;
+	}
+}
+
 void FCEU_UpdateInput(void)
 {
+	StrobeSampled = false;
+
+	//a recorded, networked or replayed frame needs every device's state at the
+	//start of the frame, so nothing waits for the game then
+	bool deferUpdates = FCEUMOV_Mode(MOVIEMODE_INACTIVE|MOVIEMODE_FINISHED) && !FCEUnetplay && !FCEU_ReverseDebugReplaying() && !FCEUI_GetRunAhead();
+	#ifdef __FCEU_QNETWORK_ENABLE__
+	if(NetPlayActive())
+		deferUpdates = false;
+	#endif
+
+	JPortUpdatePending[0] = JPortUpdatePending[1] = false;
+	FCPortUpdatePending = false;
+
 	//tell all drivers to poll input and set up their logical states
 	if(!FCEUMOV_Mode(MOVIEMODE_PLAY))
 	{
+		if(InputSampler)
+			InputSampler();
 		for(int port=0;port<2;port++){
+			if(deferUpdates && JPortDefersUpdate(port))
+			{
+				JPortUpdatePending[port] = true;
+				continue;
+			}
 			joyports[port].driver->Update(port,joyports[port].ptr,joyports[port].attrib);
+			if(joyports[port].driver==&GPC)
+			{
+				//what the driver gave, before Lua and the others had their say
+				for(int i=port;i<4;i+=2)
+					StrobeRaw[i] = *(uint32 *)joyports[port].ptr >> (i*8);
+			}
 		}
-		portFC.driver->Update(portFC.ptr,portFC.attrib);
+		if(deferUpdates && FCPortDefersUpdate())
+			FCPortUpdatePending = true;
+		else
+			portFC.driver->Update(portFC.ptr,portFC.attrib);
 	}
 
 	if (GameInfo->type == GIT_VSUNI) {
@@ -485,6 +586,53 @@ void FCEU_UpdateInput(void)
 	if(GameInfo->type==GIT_VSUNI){
 		FCEU_VSUniSwap(&joy[0],&joy[1]);
 	}
+
+	//a frame replayed by the reverse debugger gets the pads it was played with
+	FCEU_ReverseDebugInput(joy);
+}
+
+//Runs on the game's first strobe in a frame. The pads are sampled once more
+//and the buttons whose value came from the driver take the new one, those
+//that Lua, a script or the API set for the frame keep it. Only the first
+//strobe samples, games that read the pads twice to catch DPCM glitches
+//compare two reads of the same state.
+static void StrobeSample(void)
+{
+	StrobeSampled = true;
+
+	//movies and netplay need what the frame recorded to be what the game saw,
+	//and so does a frame the reverse debugger replays
+	if(!FCEUMOV_Mode(MOVIEMODE_INACTIVE|MOVIEMODE_FINISHED) || FCEUnetplay || FCEU_ReverseDebugReplaying())
+		return;
+	#ifdef __FCEU_QNETWORK_ENABLE__
+	if(NetPlayActive())
+		return;
+	#endif
+	//the VS swap is applied after the sample, run-ahead replays the frame's input
+	if(GameInfo->type==GIT_VSUNI || FCEUI_GetRunAhead())
+		return;
+
+	InputSampler();
+
+	for(int port=0;port<2;port++)
+	{
+		if(joyports[port].driver!=&GPC)
+			continue;
+
+		for(int i=port;i<4;i+=2)
+		{
+			uint8 now = *(uint32 *)joyports[port].ptr >> (i*8);
+			uint8 kept = joy[i] ^ StrobeRaw[i];
+
+			joy[i] = (joy[i] & kept) | (now & ~kept);
+			StrobeRaw[i] = now;
+		}
+	}
+}
+
+void FCEUI_SetInputSampler(void (*sampler)(void))
+{
+	InputSampler = sampler;
 }
 
 static DECLFR(VSUNIRead0)
@@ -525,6 +673,12 @@ void InputScanlineHook(uint8 *bg, uint8 *spr, uint32 linets, int final)
 	portFC.driver->SLHook(bg,spr,linets,final);
 }
 
+//true if any attached device looks at the rendered lines (zapper and the like)
+bool InputScanlineHookActive(void)
+{
+	return joyports[0].driver->_SLHook || joyports[1].driver->_SLHook || portFC.driver->_SLHook;
+}
+
 #include <iostream>
 //binds JPorts[pad] to the driver specified in JPType[pad]
 static void SetInputStuff(int port)
@@ -104,6 +104,7 @@ extern void (*PStrobe[2])(void);
 
 //called from PPU on scanline events.
 extern void InputScanlineHook(uint8 *bg, uint8 *spr, uint32 linets, int final);
+extern bool InputScanlineHookActive(void);
 
 void FCEU_DoSimpleCommand(int cmd);
 
@@ -0,0 +1,597 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// inputfuzz.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "debug.h"
+#include "git.h"
+#include "input.h"
+#include "movie.h"
+#include "netplay.h"
+#include "sound.h"
+#include "state.h"
+#include "video.h"
+#include "wave.h"
+#include "x6502.h"
+#include "inputfuzz.h"
+#include "workerpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <thread>
+
+#ifdef __FCEU_QNETWORK_ENABLE__
+extern bool NetPlayActive(void);
+#endif
+
+extern bool justLagged;
+
+// frames between the snapshots an input is replayed from
+static const int CHECKPOINT_FRAMES = 100;
+
+// mutations stacked on one input, and the frames one spans at most
+static const int MAX_MUTATIONS = 4;
+static const int MAX_SPAN = 60;
+
+// the inputs each worker plays in a round: about this many rounds, within
+// the bounds, so that the workers learn of each other's finds now and then
+static const int ROUNDS = 16;
+static const int ROUND_EXECS_MIN = 16;
+static const int ROUND_EXECS_MAX = 1000;
+
+FCEU_InputFuzzSettings::FCEU_InputFuzzSettings()
+	: frames(600), execs(10000), pad(0), buttons(0xFF), seed(1), jobs(0)
+{
+}
+
+FCEU_InputFuzzInput::FCEU_InputFuzzInput()
+	: newCode(0), crash(-1), crashFrame(-1), crashPC(0)
+{
+}
+
+FCEU_InputFuzzStats::FCEU_InputFuzzStats()
+	: execs(0), frames(0), seconds(0), codeBefore(0), codeAfter(0), workers(0)
+{
+}
+
+// an input of the corpus, with the states it passes through every
+// CHECKPOINT_FRAMES frames as far as they were taken yet
+struct FuzzEntry
+{
+	std::vector<uint8> frames;
+	std::vector<std::vector<uint8> > checkpoints;
+};
+
+struct InputFuzz
+{
+	const FCEU_InputFuzzSettings &settings;
+	size_t size;                            // of a snapshot
+	uint32 joy;                             // what the gamepads read
+	uint64 random;
+	std::vector<uint8> buttons;             // the mutations may press, one bit each
+	std::vector<uint8> base;
+	std::vector<FuzzEntry> entries;
+	std::vector<FCEU_InputFuzzInput> corpus;
+	std::vector<FCEU_InputFuzzInput> crashes;
+	std::set<uint32> crashSeen;             // kind and address
+	uint64 execs;
+	uint64 frames;
+
+	// the stack pointer before the instruction about to run, for the hook
+	uint8  lastS;
+	uint16 lastPC;
+	int    stackCrash;
+	uint16 stackPC;
+
+	InputFuzz(const FCEU_InputFuzzSettings &s)
+		: settings(s), size(FCEUSS_SnapshotSize()), joy(0), execs(0), frames(0),
+		  lastS(0), lastPC(0), stackCrash(-1), stackPC(0)
+	{
+		Seed(0);
+		for (int i = 0; i < 8; i++)
+		{
+			if (settings.buttons & (1 << i))
+				buttons.push_back(1 << i);
+		}
+	}
+
+	void Seed(uint32 stream)
+	{
+		random = ((uint64)settings.seed << 32 | stream) * 0x9E3779B97F4A7C15ULL + 1;
+	}
+
+	// xorshift64*
+	uint32 Next(void)
+	{
+		random ^= random >> 12;
+		random ^= random << 25;
+		random ^= random >> 27;
+		return (uint32)((random * 0x2545F4914F6CDD1DULL) >> 32);
+	}
+
+	uint32 Below(uint32 n)
+	{
+		return Next() % n;
+	}
+
+	// changes a few spans of input, returns the first frame changed
+	int Mutate(std::vector<uint8> &input)
+	{
+		int n = settings.frames;
+		int from = n;
+		int count = 1 + Below(MAX_MUTATIONS);
+
+		for (int i = 0; i < count; i++)
+		{
+			int start = Below(n);
+			int end = std::min(n, start + 1 + (int)Below(MAX_SPAN));
+
+			switch (Below(4))
+			{
+			case 0:
+				// a button held or let go
+				if (!buttons.empty())
+				{
+					uint8 bit = buttons[Below(buttons.size())];
+					bool press = Next() & 1;
+					for (int f = start; f < end; f++)
+						input[f] = press ? (input[f] | bit) : (input[f] & ~bit);
+				}
+				break;
+			case 1:
+				std::fill(input.begin() + start, input.begin() + end, (uint8)(Next() & settings.buttons));
+				break;
+			case 2:
+				std::fill(input.begin() + start, input.begin() + end, 0);
+				break;
+			case 3:
+			{
+				// the end of another input
+				const std::vector<uint8> &other = entries[Below(entries.size())].frames;
+				std::copy(other.begin() + start, other.end(), input.begin() + start);
+				break;
+			}
+			}
+			from = std::min(from, start);
+		}
+		return from;
+	}
+
+	void Crash(FCEU_InputFuzzInput &found)
+	{
+		if (crashSeen.insert((uint32)found.crash << 16 | found.crashPC).second)
+			crashes.push_back(found);
+	}
+
+	// plays input, which is the same as parent's (NULL for none) up to frame
+	// from; it joins the corpus when it runs new code, or always with keep
+	bool Run(FuzzEntry *parent, const std::vector<uint8> &input, int from, bool keep)
+	{
+		size_t k = parent ? std::min(parent->checkpoints.size(), (size_t)(from / CHECKPOINT_FRAMES)) : 0;
+		const std::vector<uint8> &start = k ? parent->checkpoints[k - 1] : base;
+		std::vector<std::vector<uint8> > own;
+		FCEU_InputFuzzInput found;
+		int code = codecount;
+
+		FCEUSS_Restore(start.data(), size);
+		lastS = X.S;
+		lastPC = X.PC;
+		stackCrash = -1;
+
+		for (int f = (int)k * CHECKPOINT_FRAMES; f < settings.frames; f++)
+		{
+			joy = (uint32)input[f] << (settings.pad * 8);
+			FCEUI_EmulateOffscreen();
+			frames++;
+
+			if (X.jammed || stackCrash >= 0)
+			{
+				found.crash = X.jammed ? FCEU_FUZZ_JAM : stackCrash;
+				found.crashFrame = f;
+				found.crashPC = X.jammed ? X.PC : stackPC;
+				break;
+			}
+			if ((f + 1) % CHECKPOINT_FRAMES)
+				continue;
+
+			std::vector<uint8> state(size);
+			FCEUSS_Snapshot(state.data(), size);
+			if (f + 1 > from)
+				own.push_back(state);
+			else if (parent && (size_t)(f + 1) / CHECKPOINT_FRAMES == parent->checkpoints.size() + 1)
+				parent->checkpoints.push_back(state);
+		}
+		execs++;
+
+		found.frames = input;
+		found.newCode = codecount - code;
+		if (found.crash >= 0)
+		{
+			Crash(found);
+			return false;
+		}
+		if (found.newCode)
+			corpus.push_back(found);
+		if (!found.newCode && !keep)
+			return true;
+
+		// the snapshots before from are the parent's
+		FuzzEntry entry;
+		entry.frames = input;
+		if (parent)
+			entry.checkpoints.assign(parent->checkpoints.begin(),
+				parent->checkpoints.begin() + std::min(parent->checkpoints.size(), (size_t)(from / CHECKPOINT_FRAMES)));
+		entry.checkpoints.insert(entry.checkpoints.end(), own.begin(), own.end());
+		entries.push_back(entry);
+		return true;
+	}
+
+	void Fuzz(int count)
+	{
+		for (int i = 0; i < count && !entries.empty(); i++)
+		{
+			size_t parent = Below(entries.size());
+			std::vector<uint8> input = entries[parent].frames;
+			int from = Mutate(input);
+			Run(&entries[parent], input, from, false);
+		}
+	}
+};
+
+// a push or pull that took the stack pointer around its page; TXS may put
+// it anywhere
+static void FuzzStackHook(unsigned int address, unsigned int value, void *userData)
+{
+	InputFuzz &fuzz = *(InputFuzz *)userData;
+	int d = (int8)(X.S - fuzz.lastS);
+
+	if (d != 0 && d >= -6 && d <= 6 && (d < 0) != (X.S < fuzz.lastS) && fuzz.stackCrash < 0 && GetMem(fuzz.lastPC) != 0x9A)
+	{
+		fuzz.stackCrash = d < 0 ? FCEU_FUZZ_STACK_OVERFLOW : FCEU_FUZZ_STACK_UNDERFLOW;
+		fuzz.stackPC = fuzz.lastPC;
+	}
+	fuzz.lastS = X.S;
+	fuzz.lastPC = address;
+}
+
+//----------------------------------------------------------------------------
+// Workers
+
+#ifdef FCEU_WORKER_POOL
+// what a worker sends back, followed by corpus and crashes inputs of a
+// FuzzWorkerInput and the frames each, then its PRG log
+struct FuzzWorkerReply
+{
+	uint64 execs;
+	uint64 frames;
+	uint32 corpus;
+	uint32 crashes;
+};
+
+struct FuzzWorkerInput
+{
+	uint32 newCode;
+	int32  crash;
+	int32  crashFrame;
+	uint32 crashPC;
+	uint32 length;
+};
+
+static void PutInput(std::vector<uint8> &data, const FCEU_InputFuzzInput &input)
+{
+	FuzzWorkerInput header;
+	header.newCode = input.newCode;
+	header.crash = input.crash;
+	header.crashFrame = input.crashFrame;
+	header.crashPC = input.crashPC;
+	header.length = input.frames.size();
+	data.insert(data.end(), (const uint8 *)&header, (const uint8 *)&header + sizeof(header));
+	data.insert(data.end(), input.frames.begin(), input.frames.end());
+}
+
+static bool GetInput(const std::vector<uint8> &data, size_t &pos, FCEU_InputFuzzInput &input)
+{
+	FuzzWorkerInput header;
+	if (data.size() - pos < sizeof(header))
+		return false;
+	memcpy(&header, &data[pos], sizeof(header));
+	pos += sizeof(header);
+	if (data.size() - pos < header.length)
+		return false;
+	input.newCode = header.newCode;
+	input.crash = header.crash;
+	input.crashFrame = header.crashFrame;
+	input.crashPC = header.crashPC;
+	input.frames.assign(data.begin() + pos, data.begin() + pos + header.length);
+	pos += header.length;
+	return true;
+}
+
+// the worker's PRG log ORed into the one here, with its counts
+static void MergeLog(const uint8 *log)
+{
+	for (unsigned int i = 0; i < cdloggerdataSize; i++)
+	{
+		uint8 had = cdloggerdata[i];
+		uint8 add = log[i] & ~had;
+		if (!add)
+			continue;
+		if (add & 1)
+			codecount++;
+		if (add & 2)
+			datacount++;
+		if (!(had & 3) && (add & 3))
+			undefinedcount--;
+		cdloggerdata[i] = had | add;
+	}
+}
+
+// takes the reply of a worker into fuzz, false when it is not a whole one
+static bool ReadReply(const std::vector<uint8> &data, InputFuzz &fuzz)
+{
+	FuzzWorkerReply reply;
+	if (data.size() < sizeof(reply))
+		return false;
+	memcpy(&reply, &data[0], sizeof(reply));
+
+	size_t pos = sizeof(reply);
+	std::vector<FCEU_InputFuzzInput> corpus(reply.corpus), crashes(reply.crashes);
+	for (uint32 i = 0; i < reply.corpus; i++)
+	{
+		if (!GetInput(data, pos, corpus[i]) || corpus[i].frames.size() != (size_t)fuzz.settings.frames)
+			return false;
+	}
+	for (uint32 i = 0; i < reply.crashes; i++)
+	{
+		if (!GetInput(data, pos, crashes[i]))
+			return false;
+	}
+	if (data.size() - pos != cdloggerdataSize)
+		return false;
+
+	MergeLog(&data[pos]);
+	for (uint32 i = 0; i < reply.corpus; i++)
+	{
+		// its snapshots are taken again once it is mutated here
+		FuzzEntry entry;
+		entry.frames = corpus[i].frames;
+		fuzz.entries.push_back(entry);
+		fuzz.corpus.push_back(corpus[i]);
+	}
+	for (uint32 i = 0; i < reply.crashes; i++)
+		fuzz.Crash(crashes[i]);
+	fuzz.execs += reply.execs;
+	fuzz.frames += reply.frames;
+	return true;
+}
+
+// one round of up to jobs forked copies of the emulator, perWorker inputs
+// each; returns the inputs they played, 0 when none could be started
+static int FuzzInWorkers(InputFuzz &fuzz, int jobs, int perWorker, int remaining, uint32 round,
+	FCEU_InputFuzzStats &stats)
+{
+	std::vector<size_t> pending;
+	std::vector<int> counts;
+	for (int w = 0, planned = 0; w < jobs && planned < remaining; w++)
+	{
+		counts.push_back(std::min(perWorker, remaining - planned));
+		planned += counts.back();
+		pending.push_back(w);
+	}
+
+	std::vector<std::vector<uint8> > replies(counts.size());
+	std::vector<bool> failed(counts.size(), false);
+	int workers = FCEU_RunInWorkers(pending, (int)counts.size(),
+		[&](size_t w, std::vector<uint8> &data)
+		{
+			// what was found so far is the parent's
+			size_t corpusStart = fuzz.corpus.size(), crashesStart = fuzz.crashes.size();
+			fuzz.execs = fuzz.frames = 0;
+			fuzz.Seed(round * jobs + w + 1);
+			fuzz.Fuzz(counts[w]);
+
+			FuzzWorkerReply reply;
+			memset(&reply, 0, sizeof(reply));
+			reply.execs = fuzz.execs;
+			reply.frames = fuzz.frames;
+			reply.corpus = fuzz.corpus.size() - corpusStart;
+			reply.crashes = fuzz.crashes.size() - crashesStart;
+
+			data.assign((const uint8 *)&reply, (const uint8 *)&reply + sizeof(reply));
+			for (size_t i = corpusStart; i < fuzz.corpus.size(); i++)
+				PutInput(data, fuzz.corpus[i]);
+			for (size_t i = crashesStart; i < fuzz.crashes.size(); i++)
+				PutInput(data, fuzz.crashes[i]);
+			data.insert(data.end(), cdloggerdata, cdloggerdata + cdloggerdataSize);
+		},
+		[&](size_t w, const std::vector<uint8> &data, const std::string &error)
+		{
+			replies[w] = data;
+			failed[w] = !error.empty();
+		});
+	stats.workers += workers;
+
+	// in the order they were started, so that a seed fuzzes the same; the
+	// pool starts them in order and stops at the first it can not start
+	int started = 0;
+	for (int w = 0; w < workers; w++)
+	{
+		if (failed[w] || !ReadReply(replies[w], fuzz))
+			stats.error = "a worker failed, its finds are missing";
+		started += counts[w];
+	}
+	return started;
+}
+#endif
+
+//----------------------------------------------------------------------------
+
+static bool CanFuzz(const FCEU_InputFuzzSettings &settings, std::string &error)
+{
+	// the frames are run off screen like the ones of run-ahead, nothing may
+	// see them go by
+	if (!GameInfo || GameInfo->type == GIT_NSF)
+		error = "no game loaded";
+	else if (settings.frames < 1 || settings.execs < 1)
+		error = "nothing to fuzz";
+	else if (settings.pad < 0 || settings.pad > 3 || joyports[settings.pad & 1].type != SI_GAMEPAD)
+		error = "the pad is not a gamepad";
+	else if (!cdloggerdata || !debug_loggingCD)
+		error = "the code/data logger is not running";
+	else if (numWPs)
+		error = "breakpoints are set";
+	else if (FCEUnetplay)
+		error = "netplay is active";
+#ifdef __FCEU_QNETWORK_ENABLE__
+	else if (NetPlayActive())
+		error = "netplay is active";
+#endif
+	else if (FCEUI_WaveRecordRunning())
+		error = "sound is being recorded";
+	return error.empty();
+}
+
+bool FCEUI_FuzzInput(const FCEU_InputFuzzSettings &settings, std::vector<FCEU_InputFuzzInput> &corpus,
+	std::vector<FCEU_InputFuzzInput> &crashes, FCEU_InputFuzzStats &stats)
+{
+	corpus.clear();
+	crashes.clear();
+	stats = FCEU_InputFuzzStats();
+
+	if (!CanFuzz(settings, stats.error))
+		return false;
+
+	InputFuzz fuzz(settings);
+	fuzz.base.resize(fuzz.size);
+	if (!FCEUSS_Snapshot(fuzz.base.data(), fuzz.size))
+	{
+		stats.error = "cannot take a snapshot";
+		return false;
+	}
+
+	// park the console: what the snapshot has not, and the movie and pads
+	FCEUSND_SaveSynthesis();
+	std::vector<uint8> picture(256*256*3);
+	memcpy(&picture[0], XBuf, 256*256);
+	memcpy(&picture[256*256], XBackBuf, 256*256);
+	memcpy(&picture[256*256*2], XDBuf, 256*256);
+	int frameCounter = currFrameCounter;
+	char realLagFlag = lagFlag;
+	bool realJustLagged = justLagged;
+	EMOVIEMODE realMovieMode = movieMode;
+	void *realPads[2] = { joyports[0].ptr, joyports[1].ptr };
+	bool computeOnly = FCEUI_GetComputeOnly();
+	bool breakOnCode = break_on_unlogged_code, breakOnData = break_on_unlogged_data;
+
+	movieMode = MOVIEMODE_INACTIVE;
+	joyports[0].ptr = joyports[1].ptr = &fuzz.joy;
+	FCEUI_SetComputeOnly(true);
+	break_on_unlogged_code = break_on_unlogged_data = false;
+	X6502_MemHook::Add(X6502_MemHook::Exec, FuzzStackHook, &fuzz);
+
+	auto start = std::chrono::steady_clock::now();
+	stats.codeBefore = codecount;
+
+	// the seeds are the corpus to start with, whatever they run
+	std::vector<std::vector<uint8> > seeds = settings.seeds;
+	if (seeds.empty())
+		seeds.resize(1);
+	for (size_t i = 0; i < seeds.size(); i++)
+	{
+		seeds[i].resize(settings.frames, 0);
+		fuzz.Run(nullptr, seeds[i], 0, true);
+	}
+	if (fuzz.entries.empty())
+		stats.error = "every seed crashes";
+
+	int remaining = std::max(0, settings.execs - (int)fuzz.execs);
+	int jobs = settings.jobs > 0 ? settings.jobs : std::max(1, (int)std::thread::hardware_concurrency());
+
+#ifdef FCEU_WORKER_POOL
+	if (jobs > 1 && !fuzz.entries.empty())
+	{
+		int perWorker = std::max(ROUND_EXECS_MIN, std::min(ROUND_EXECS_MAX, remaining / (jobs * ROUNDS)));
+		for (uint32 round = 0; remaining > 0 && stats.error.empty(); round++)
+		{
+			int played = FuzzInWorkers(fuzz, jobs, perWorker, remaining, round, stats);
+			if (!played)
+				break;
+			remaining -= played;
+		}
+	}
+#endif
+	fuzz.Fuzz(remaining);
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	stats.codeAfter = codecount;
+	stats.execs = fuzz.execs;
+	stats.frames = fuzz.frames;
+
+	X6502_MemHook::Remove(X6502_MemHook::Exec, FuzzStackHook, &fuzz);
+	break_on_unlogged_code = breakOnCode;
+	break_on_unlogged_data = breakOnData;
+	FCEUI_SetComputeOnly(computeOnly);
+	FCEUSS_Restore(fuzz.base.data(), fuzz.size);
+	FCEUSND_RestoreSynthesis();
+	memcpy(XBuf, &picture[0], 256*256);
+	memcpy(XBackBuf, &picture[256*256], 256*256);
+	memcpy(XDBuf, &picture[256*256*2], 256*256);
+	currFrameCounter = frameCounter;
+	lagFlag = realLagFlag;
+	justLagged = realJustLagged;
+	movieMode = realMovieMode;
+	joyports[0].ptr = realPads[0];
+	joyports[1].ptr = realPads[1];
+
+	corpus.swap(fuzz.corpus);
+	crashes.swap(fuzz.crashes);
+	return !fuzz.entries.empty();
+}
+
+std::string FCEU_InputFuzzReport(const std::vector<FCEU_InputFuzzInput> &corpus,
+	const std::vector<FCEU_InputFuzzInput> &crashes, const FCEU_InputFuzzStats &stats)
+{
+	static const char *kinds[] = { "jam", "stack overflow", "stack underflow" };
+	std::string report;
+	char buf[160];
+
+	if (!stats.error.empty())
+		report += "error: " + stats.error + "\n";
+	snprintf(buf, sizeof(buf), "%llu inputs, %llu frames in %.2f s: %.1f inputs/s, %.0f frames/s, %d workers\n",
+		(unsigned long long)stats.execs, (unsigned long long)stats.frames, stats.seconds,
+		stats.seconds > 0 ? stats.execs / stats.seconds : 0.0, stats.seconds > 0 ? stats.frames / stats.seconds : 0.0,
+		stats.workers);
+	report += buf;
+	snprintf(buf, sizeof(buf), "code bytes logged: %d before, %d after; %u inputs found new code, %u crashes\n",
+		stats.codeBefore, stats.codeAfter, (unsigned)corpus.size(), (unsigned)crashes.size());
+	report += buf;
+
+	for (size_t i = 0; i < crashes.size(); i++)
+	{
+		snprintf(buf, sizeof(buf), "%s at $%04X, frame %d\n", kinds[crashes[i].crash], crashes[i].crashPC, crashes[i].crashFrame);
+		report += buf;
+	}
+	return report;
+}
@@ -0,0 +1,102 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// inputfuzz.h
+
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+/*
+ *  Input fuzzer. From the running console, inputs of a number of frames of
+ *  gamepad buttons are played one after another, each a mutation of one in
+ *  the corpus (buttons held or let go over a span of frames, a span set at
+ *  random or cleared, the end of another input spliced in). An input that
+ *  runs PRG code the Code/Data Logger had not logged yet joins the corpus,
+ *  so the logger has to be running: its log is the coverage, and what the
+ *  fuzzer finds is in it afterwards.
+ *
+ *  An input crashes when the CPU jams on an illegal opcode or the stack
+ *  pointer wraps around its page on a push or pull; the first input of each
+ *  kind and address is kept. Inputs are replayed from the snapshots their
+ *  parent passed through, so only the frames from the mutation on are run.
+ *  Where the platform can fork, the fuzzing runs in rounds of worker
+ *  processes, each starting from the corpus and log so far and sending
+ *  back what it found.
+ *
+ *  The frames are run off screen in compute-only mode, like those of the
+ *  input search, and the console is put back the way it was afterwards.
+ */
+
+enum
+{
+	FCEU_FUZZ_JAM = 0,              // the CPU ran a KIL opcode
+	FCEU_FUZZ_STACK_OVERFLOW,       // a push wrapped from $0100 to $01FF
+	FCEU_FUZZ_STACK_UNDERFLOW,      // a pull wrapped from $01FF to $0100
+};
+
+struct FCEU_InputFuzzSettings
+{
+	int    frames;                  // of an input, 600 by default
+	int    execs;                   // inputs played, 10000 by default
+	int    pad;                     // gamepad played, 0 to 3
+	uint8  buttons;                 // the mutations may press, all by default
+	uint32 seed;                    // of the mutations
+	int    jobs;                    // worker processes, 0 for one per core
+	std::vector<std::vector<uint8> > seeds;  // first inputs, none for one without buttons
+
+	FCEU_InputFuzzSettings();
+};
+
+struct FCEU_InputFuzzInput
+{
+	std::vector<uint8> frames;      // the buttons of each frame
+	uint32 newCode;                 // PRG bytes it was first to run
+	int    crash;                   // FCEU_FUZZ_*, -1 for none
+	int    crashFrame;              // the crash happened in
+	uint16 crashPC;
+
+	FCEU_InputFuzzInput();
+};
+
+struct FCEU_InputFuzzStats
+{
+	uint64 execs;                   // inputs played
+	uint64 frames;                  // frames run for them
+	double seconds;
+	int    codeBefore;              // PRG code bytes logged before and after
+	int    codeAfter;
+	int    workers;                 // worker processes run
+	std::string error;              // why there was no fuzzing, "" when there was
+
+	FCEU_InputFuzzStats();
+};
+
+// Fuzzes from the running console. corpus has the inputs that found new
+// code, in the order they were found, and crashes the crashing ones.
+// Returns false, with stats.error set, when it can not run.
+bool FCEUI_FuzzInput(const FCEU_InputFuzzSettings &settings, std::vector<FCEU_InputFuzzInput> &corpus,
+	std::vector<FCEU_InputFuzzInput> &crashes, FCEU_InputFuzzStats &stats);
+
+// The throughput and coverage, then one line per crash
+std::string FCEU_InputFuzzReport(const std::vector<FCEU_InputFuzzInput> &corpus,
+	const std::vector<FCEU_InputFuzzInput> &crashes, const FCEU_InputFuzzStats &stats);
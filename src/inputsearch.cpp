@@ -0,0 +1,505 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// inputsearch.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "debug.h"
+#include "framehash.h"
+#include "git.h"
+#include "input.h"
+#include "movie.h"
+#include "netplay.h"
+#include "sound.h"
+#include "state.h"
+#include "video.h"
+#include "wave.h"
+#include "x6502.h"
+#include "inputsearch.h"
+#include "workerpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#ifdef FCEU_WORKER_POOL
+#include <sys/mman.h>
+#endif
+
+#ifdef __FCEU_QNETWORK_ENABLE__
+extern bool NetPlayActive(void);
+#endif
+
+extern bool justLagged;
+
+// states handed to the workers for each of them, the ones below some states
+// end much sooner than below others
+static const int NODES_PER_JOB = 4;
+
+// hashes of the states seen, at most; past that states are searched again
+static const size_t SEEN_SLOTS_MAX = 1 << 22;
+static const size_t SEEN_PROBES = 32;
+
+FCEU_InputSearchSettings::FCEU_InputSearchSettings()
+	: depth(8), frames(1), pad(0), best(10), jobs(0), dedupe(true)
+{
+}
+
+FCEU_InputSearchStats::FCEU_InputSearchStats()
+	: nodes(0), duplicates(0), workers(0)
+{
+}
+
+std::vector<uint8> FCEU_InputSearchResult::frames(int framesPerStep) const
+{
+	std::vector<uint8> out;
+	for (size_t i = 0; i < steps.size(); i++)
+		out.insert(out.end(), std::max(framesPerStep, 1), steps[i]);
+	return out;
+}
+
+static bool Better(const FCEU_InputSearchResult &a, const FCEU_InputSearchResult &b)
+{
+	return a.score != b.score ? a.score > b.score : a.steps.size() < b.steps.size();
+}
+
+// The hashes of the states seen, open addressed. The workers are forked
+// with it mapped shared, so that each skips the states any of them reached.
+class SeenStates
+{
+public:
+	SeenStates(size_t states)
+		: slots(nullptr), count(SEEN_SLOTS_MAX), mapped(false)
+	{
+		// twice the states, as a power of two
+		while (count > 1024 && count / 4 >= states)
+			count /= 2;
+#ifdef FCEU_WORKER_POOL
+		void *p = mmap(nullptr, count * sizeof(*slots), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (p != MAP_FAILED)
+		{
+			slots = (std::atomic<uint64> *)p;
+			mapped = true;
+		}
+#endif
+		// a fresh mapping is zeroed already
+		if (!slots)
+		{
+			slots = new std::atomic<uint64>[count];
+			for (size_t i = 0; i < count; i++)
+				slots[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	~SeenStates()
+	{
+#ifdef FCEU_WORKER_POOL
+		if (mapped)
+		{
+			munmap((void *)slots, count * sizeof(*slots));
+			return;
+		}
+#endif
+		delete[] slots;
+	}
+
+	// false when hash was inserted before
+	bool insert(uint64 hash)
+	{
+		// 0 marks a free slot
+		hash |= hash == 0;
+		size_t i = hash & (count - 1);
+		for (size_t probe = 0; probe < SEEN_PROBES; probe++)
+		{
+			uint64 slot = slots[i].load(std::memory_order_relaxed);
+			if (slot == 0 && slots[i].compare_exchange_strong(slot, hash, std::memory_order_relaxed))
+				return true;
+			if (slot == hash)
+				return false;
+			i = (i + 1) & (count - 1);
+		}
+		// full around there, it is searched again then
+		return true;
+	}
+
+private:
+	SeenStates(const SeenStates&) = delete;
+	SeenStates& operator=(const SeenStates&) = delete;
+
+	std::atomic<uint64> *slots;
+	size_t count;
+	bool mapped;
+};
+
+// a state the search goes on from, and the steps that led to it
+struct SearchNode
+{
+	std::vector<uint8> state;
+	std::vector<uint8> steps;
+};
+
+struct InputSearch
+{
+	const FCEU_InputSearchSettings &settings;
+	Condition *objective;
+	size_t size;                            // of a snapshot
+	uint32 joy;                             // what the gamepads read
+	std::vector<std::vector<uint8> > levels;
+	std::vector<uint8> steps;
+	SeenStates seen;
+	std::vector<FCEU_InputSearchResult> results;
+	uint64 nodes;
+	uint64 duplicates;
+
+	InputSearch(const FCEU_InputSearchSettings &s, Condition *c)
+		: settings(s), objective(c), size(FCEUSS_SnapshotSize()), joy(0), seen(States(s)), nodes(0), duplicates(0)
+	{
+		levels.resize(settings.depth + 1, std::vector<uint8>(size));
+	}
+
+	// the states there are at most, for the size of seen
+	static size_t States(const FCEU_InputSearchSettings &s)
+	{
+		if (!s.dedupe)
+			return 0;
+		size_t states = 1, level = 1;
+		for (int i = 0; i < s.depth && states < SEEN_SLOTS_MAX; i++)
+		{
+			level = std::min(level * s.alphabet.size(), SEEN_SLOTS_MAX);
+			states += level;
+		}
+		return states;
+	}
+
+	void Keep(int score, const std::vector<uint8> &sequence)
+	{
+		FCEU_InputSearchResult result;
+		result.score = score;
+		result.steps = sequence;
+
+		if ((int)results.size() >= settings.best && !Better(result, results.back()))
+			return;
+		// after the equal ones, the first found stays first
+		results.insert(std::upper_bound(results.begin(), results.end(), result, Better), result);
+		if ((int)results.size() > settings.best)
+			results.pop_back();
+	}
+
+	void Step(uint8 buttons)
+	{
+		joy = (uint32)buttons << (settings.pad * 8);
+		for (int i = 0; i < settings.frames; i++)
+			FCEUI_EmulateOffscreen();
+		nodes++;
+	}
+
+	// the state the core is in into buf, false when it was reached before
+	bool Take(std::vector<uint8> &buf)
+	{
+		FCEUSS_Snapshot(buf.data(), size);
+		if (settings.dedupe && !seen.insert(FCEU_XXH64(buf.data(), size, 0)))
+		{
+			duplicates++;
+			return false;
+		}
+		return true;
+	}
+
+	// every sequence of remaining steps from levels[level], depth first; the
+	// core is in that state already
+	void Below(int level, int remaining)
+	{
+		const std::vector<uint8> &alphabet = settings.alphabet;
+
+		for (size_t i = 0; i < alphabet.size(); i++)
+		{
+			if (i > 0)
+				FCEUSS_Restore(levels[level].data(), size);
+			Step(alphabet[i]);
+
+			bool more = remaining > 1;
+			if ((settings.dedupe || more) && !Take(levels[level + 1]))
+				continue;
+
+			steps.push_back(alphabet[i]);
+			Keep(evaluate(objective), steps);
+			if (more)
+				Below(level + 1, remaining - 1);
+			steps.pop_back();
+		}
+	}
+
+	void Below(const SearchNode &node, int remaining)
+	{
+		levels[0] = node.state;
+		steps = node.steps;
+		FCEUSS_Restore(levels[0].data(), size);
+		Below(0, remaining);
+	}
+
+	// one step from every node of frontier, breadth first
+	void Expand(std::vector<SearchNode> &frontier)
+	{
+		std::vector<SearchNode> next;
+
+		for (size_t n = 0; n < frontier.size(); n++)
+		{
+			for (size_t i = 0; i < settings.alphabet.size(); i++)
+			{
+				FCEUSS_Restore(frontier[n].state.data(), size);
+				Step(settings.alphabet[i]);
+
+				SearchNode child;
+				child.state.resize(size);
+				if (!Take(child.state))
+					continue;
+				child.steps = frontier[n].steps;
+				child.steps.push_back(settings.alphabet[i]);
+				Keep(evaluate(objective), child.steps);
+				next.push_back(child);
+			}
+		}
+		frontier.swap(next);
+	}
+};
+
+//----------------------------------------------------------------------------
+// Workers
+
+#ifdef FCEU_WORKER_POOL
+// what a worker sends back, followed by count results of an int32 score,
+// a uint32 step count and the steps each
+struct SearchWorkerReply
+{
+	uint64 nodes;
+	uint64 duplicates;
+	uint32 count;
+};
+
+// takes the reply of a worker into search, false when it is not a whole one
+static bool ReadReply(const std::vector<uint8> &data, InputSearch &search)
+{
+	SearchWorkerReply reply;
+	if (data.size() < sizeof(reply))
+		return false;
+	memcpy(&reply, &data[0], sizeof(reply));
+
+	size_t pos = sizeof(reply);
+	for (uint32 i = 0; i < reply.count; i++)
+	{
+		int32 score;
+		uint32 len;
+		if (data.size() - pos < sizeof(score) + sizeof(len))
+			return false;
+		memcpy(&score, &data[pos], sizeof(score));
+		memcpy(&len, &data[pos + sizeof(score)], sizeof(len));
+		pos += sizeof(score) + sizeof(len);
+		if (data.size() - pos < len)
+			return false;
+		search.Keep(score, std::vector<uint8>(data.begin() + pos, data.begin() + pos + len));
+		pos += len;
+	}
+	search.nodes += reply.nodes;
+	search.duplicates += reply.duplicates;
+	return true;
+}
+
+// one forked copy of the emulator per node, at most jobs at a time; the
+// nodes whose worker could not be started are left in pending
+static void SearchInWorkers(InputSearch &search, int remaining, int jobs, std::vector<SearchNode> &pending,
+	FCEU_InputSearchStats &stats)
+{
+	std::vector<size_t> indices;
+	for (size_t i = 0; i < pending.size(); i++)
+		indices.push_back(i);
+
+	stats.workers += FCEU_RunInWorkers(indices, jobs,
+		[&](size_t index, std::vector<uint8> &data)
+		{
+			// the nodes and results so far are the parent's
+			search.results.clear();
+			search.nodes = search.duplicates = 0;
+			search.Below(pending[index], remaining);
+
+			SearchWorkerReply reply;
+			memset(&reply, 0, sizeof(reply));
+			reply.nodes = search.nodes;
+			reply.duplicates = search.duplicates;
+			reply.count = search.results.size();
+
+			data.assign((const uint8 *)&reply, (const uint8 *)&reply + sizeof(reply));
+			for (size_t i = 0; i < search.results.size(); i++)
+			{
+				int32 score = search.results[i].score;
+				uint32 len = search.results[i].steps.size();
+				data.insert(data.end(), (const uint8 *)&score, (const uint8 *)&score + sizeof(score));
+				data.insert(data.end(), (const uint8 *)&len, (const uint8 *)&len + sizeof(len));
+				data.insert(data.end(), search.results[i].steps.begin(), search.results[i].steps.end());
+			}
+		},
+		[&](size_t index, const std::vector<uint8> &data, const std::string &error)
+		{
+			if (!error.empty() || !ReadReply(data, search))
+				stats.error = "a worker failed, the sequences below its state are missing";
+		});
+
+	std::vector<SearchNode> notStarted;
+	for (size_t i = 0; i < indices.size(); i++)
+		notStarted.push_back(std::move(pending[indices[i]]));
+	pending.swap(notStarted);
+}
+#endif
+
+//----------------------------------------------------------------------------
+
+static bool CanSearch(const FCEU_InputSearchSettings &settings, std::string &error)
+{
+	// the frames are run off screen like the ones of run-ahead, nothing may
+	// see them go by
+	if (!GameInfo || GameInfo->type == GIT_NSF)
+		error = "no game loaded";
+	else if (settings.alphabet.empty() || settings.depth < 1 || settings.frames < 1 || settings.best < 1)
+		error = "nothing to search";
+	else if (settings.pad < 0 || settings.pad > 3 || joyports[settings.pad & 1].type != SI_GAMEPAD)
+		error = "the pad is not a gamepad";
+	else if (FCEUnetplay)
+		error = "netplay is active";
+#ifdef __FCEU_QNETWORK_ENABLE__
+	else if (NetPlayActive())
+		error = "netplay is active";
+#endif
+	else if (X6502_NeedsInstrumentation())
+		error = "the debugger, tracer or profiler is active";
+	else if (FCEUI_WaveRecordRunning())
+		error = "sound is being recorded";
+	return error.empty();
+}
+
+bool FCEUI_SearchInput(const FCEU_InputSearchSettings &settings, std::vector<FCEU_InputSearchResult> &results,
+	FCEU_InputSearchStats &stats)
+{
+	results.clear();
+	stats = FCEU_InputSearchStats();
+
+	if (!CanSearch(settings, stats.error))
+		return false;
+	Condition *objective = generateCondition(settings.objective.c_str());
+	if (!objective)
+	{
+		stats.error = "invalid objective";
+		return false;
+	}
+
+	InputSearch search(settings, objective);
+	std::vector<SearchNode> frontier(1);
+	frontier[0].state.resize(search.size);
+	if (!FCEUSS_Snapshot(frontier[0].state.data(), search.size))
+	{
+		delete objective;
+		stats.error = "cannot take a snapshot";
+		return false;
+	}
+
+	// park the console: what the snapshot has not, and the movie and pads
+	std::vector<uint8> start = frontier[0].state;
+	FCEUSND_SaveSynthesis();
+	std::vector<uint8> picture(256*256*3);
+	memcpy(&picture[0], XBuf, 256*256);
+	memcpy(&picture[256*256], XBackBuf, 256*256);
+	memcpy(&picture[256*256*2], XDBuf, 256*256);
+	int frameCounter = currFrameCounter;
+	char realLagFlag = lagFlag;
+	bool realJustLagged = justLagged;
+	EMOVIEMODE realMovieMode = movieMode;
+	void *realPads[2] = { joyports[0].ptr, joyports[1].ptr };
+
+	movieMode = MOVIEMODE_INACTIVE;
+	joyports[0].ptr = joyports[1].ptr = &search.joy;
+	search.seen.insert(FCEU_XXH64(start.data(), start.size(), 0));
+
+	int jobs = settings.jobs > 0 ? settings.jobs : std::max(1, (int)std::thread::hardware_concurrency());
+	int level = 0;
+
+#ifdef FCEU_WORKER_POOL
+	if (jobs > 1)
+	{
+		// the first steps here, until there are enough states for the workers
+		while (level < settings.depth - 1 && !frontier.empty() && (int)frontier.size() < jobs * NODES_PER_JOB)
+		{
+			search.Expand(frontier);
+			level++;
+		}
+		if (level < settings.depth && frontier.size() > 1)
+			SearchInWorkers(search, settings.depth - level, jobs, frontier, stats);
+	}
+#endif
+
+	if (level < settings.depth)
+	{
+		for (size_t i = 0; i < frontier.size(); i++)
+			search.Below(frontier[i], settings.depth - level);
+	}
+
+	FCEUSS_Restore(start.data(), start.size());
+	FCEUSND_RestoreSynthesis();
+	memcpy(XBuf, &picture[0], 256*256);
+	memcpy(XBackBuf, &picture[256*256], 256*256);
+	memcpy(XDBuf, &picture[256*256*2], 256*256);
+	currFrameCounter = frameCounter;
+	lagFlag = realLagFlag;
+	justLagged = realJustLagged;
+	movieMode = realMovieMode;
+	joyports[0].ptr = realPads[0];
+	joyports[1].ptr = realPads[1];
+	delete objective;
+
+	results.swap(search.results);
+	stats.nodes = search.nodes;
+	stats.duplicates = search.duplicates;
+	return true;
+}
+
+std::string FCEU_InputSearchReport(const std::vector<FCEU_InputSearchResult> &results, const FCEU_InputSearchStats &stats)
+{
+	std::string report;
+	char buf[96];
+
+	if (!stats.error.empty())
+		report += "error: " + stats.error + "\n";
+	snprintf(buf, sizeof(buf), "%llu steps played, %llu duplicates, %d workers\n",
+		(unsigned long long)stats.nodes, (unsigned long long)stats.duplicates, stats.workers);
+	report += buf;
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		snprintf(buf, sizeof(buf), "%d:", results[i].score);
+		report += buf;
+		for (size_t s = 0; s < results[i].steps.size(); s++)
+		{
+			snprintf(buf, sizeof(buf), " %02X", results[i].steps[s]);
+			report += buf;
+		}
+		report += "\n";
+	}
+	return report;
+}
@@ -0,0 +1,90 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// inputsearch.h
+
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+/*
+ *  Input search. From the running console, every sequence of depth steps
+ *  made of the button sets in the alphabet is played, each step holding its
+ *  buttons for some frames, and the objective (an expression in the syntax
+ *  of the debugger's breakpoint conditions, "$0010 + $0011 * #100" say) is
+ *  evaluated after each step. The sequences with the highest values are
+ *  returned.
+ *
+ *  A sequence that brings the console to a state another one reached
+ *  already, every byte of the flat snapshot being equal (RAM, CPU, PPU, APU
+ *  and mapper registers), is not played any further. Where the platform can
+ *  fork, the first steps are played here until there are enough states to
+ *  share out, and the rest of the search below each of them runs in worker
+ *  processes, several at a time and each handed the next state once it is
+ *  done with one.
+ *
+ *  The frames are run off screen, with the movie left as it is and without
+ *  sound, and the console is put back the way it was afterwards.
+ */
+
+struct FCEU_InputSearchSettings
+{
+	std::vector<uint8> alphabet;    // button sets tried on each step
+	std::string objective;          // the value to maximize
+	int  depth;                     // steps, 8 by default
+	int  frames;                    // frames each step holds its buttons, 1 by default
+	int  pad;                       // gamepad played, 0 to 3
+	int  best;                      // sequences returned, 10 by default
+	int  jobs;                      // worker processes, 0 for one per core
+	bool dedupe;                    // skip states seen already, on by default
+
+	FCEU_InputSearchSettings();
+};
+
+struct FCEU_InputSearchResult
+{
+	int score;                      // the objective after the last step
+	std::vector<uint8> steps;       // the buttons of each step
+
+	// the buttons of each frame, in the column format of the TAS Editor's
+	// taseditor.setinputrange()
+	std::vector<uint8> frames(int framesPerStep) const;
+};
+
+struct FCEU_InputSearchStats
+{
+	uint64 nodes;                   // steps played
+	uint64 duplicates;              // of which reached a state seen already
+	int    workers;                 // worker processes run
+	std::string error;              // why there was no search, "" when there was
+
+	FCEU_InputSearchStats();
+};
+
+// Searches from the running console. results has the best sequences, the
+// highest first and the shorter first among equal ones. Returns false, with
+// stats.error set, when the search can not run.
+bool FCEUI_SearchInput(const FCEU_InputSearchSettings &settings, std::vector<FCEU_InputSearchResult> &results,
+	FCEU_InputSearchStats &stats);
+
+// One "score: buttons of each step in hex" line per result, after the stats
+std::string FCEU_InputSearchReport(const std::vector<FCEU_InputSearchResult> &results, const FCEU_InputSearchStats &stats);
@@ -5,8 +5,8 @@
 #include <ctype.h>
 
 #include "types.h"
+#include "emufile.h"
 #include "ld65dbg.h"
-#include "utils/StringUtils.h"
 
 
 namespace ld65
@@ -36,371 +36,334 @@ namespace ld65
 	}
 	//---------------------------------------------------------------------------------------------------
 	sym::sym(int id, const char *name, int size, int value, int type)
-		: _name(name ? name : ""), _id(id), _size(size), _value(value), _type(type), _scope(nullptr), _segment(nullptr)
+		: _name(name ? name : ""), _id(id), _size(size), _value(value), _type(type), _scopeID(-1), _segmentID(-1), _scope(nullptr), _segment(nullptr)
 	{
 	}
 	//---------------------------------------------------------------------------------------------------
-	database::database(void)
-	{
-	}
+	// One pass over the file as it lies in memory. Only the lines naming
+	// segments, scopes and symbols are looked into, the line and span
+	// records that make up most of a large file are skipped at their type.
 	//---------------------------------------------------------------------------------------------------
-	database::~database(void)
+	enum
 	{
-		for (auto itSym = symMap.begin(); itSym != symMap.end(); itSym++)
-		{
-			delete itSym->second;
-		}
-		for (auto itScope = scopeMap.begin(); itScope != scopeMap.end(); itScope++)
-		{
-			delete itScope->second;
-		}
-		for (auto itSeg = segmentMap.begin(); itSeg != segmentMap.end(); itSeg++)
-		{
-			delete itSeg->second;
-		}
-	}
-	//---------------------------------------------------------------------------------------------------
-	database::dbgLine::dbgLine(size_t bufferSize)
+		LINE_OTHER = 0,
+		LINE_INFO,
+		LINE_SEG,
+		LINE_SCOPE,
+		LINE_SYM
+	};
+
+	static bool isIdentChar( char c )
 	{
-		buf = NULL;
-		bufSize = 0;
-		readPtr = 0;
-
-		allocBuffer( bufferSize );
+		return isalnum( static_cast<unsigned char>(c) ) || (c == '_');
 	}
-	//---------------------------------------------------------------------------------------------------
-	database::dbgLine::~dbgLine(void)
+
+	static bool tokenIs( const char *tk, size_t len, const char *s )
 	{
-		if (buf)
-		{
-			::free(buf); buf = NULL;
-		}
-		bufSize = 0;
-		readPtr = 0;
+		return (strlen(s) == len) && (memcmp( tk, s, len ) == 0);
 	}
-	//---------------------------------------------------------------------------------------------------
-	void database::dbgLine::allocBuffer(size_t bufferSize)
+
+	// Decimal, or hex with a 0x prefix, as ld65 writes them
+	static int parseInt( const char *p, const char *end )
 	{
-		if (buf)
+		bool neg = false;
+		int  v = 0;
+
+		if ( (p < end) && (*p == '-') )
 		{
-			::free(buf); buf = NULL;
+			neg = true; p++;
 		}
-		bufSize = 0;
-		readPtr = 0;
+		if ( (end - p > 1) && (p[0] == '0') && ((p[1] == 'x') || (p[1] == 'X')) )
+		{
+			p += 2;
 
-		buf = static_cast<char*>( ::malloc( bufferSize ) );
+			while ( (p < end) && isxdigit( static_cast<unsigned char>(*p) ) )
+			{
+				int d = isdigit( static_cast<unsigned char>(*p) ) ? (*p - '0') : ((tolower(*p) - 'a') + 10);
 
-		if (buf == NULL)
-		{
-			bufSize = 0;
+				v = (v << 4) | d; p++;
+			}
 		}
 		else
 		{
-			buf[0] = 0;
-			bufSize = bufferSize;
+			while ( (p < end) && isdigit( static_cast<unsigned char>(*p) ) )
+			{
+				v = (v * 10) + (*p - '0'); p++;
+			}
 		}
-		readPtr = 0;
+		return neg ? -v : v;
 	}
-	//---------------------------------------------------------------------------------------------------
-	const char *database::dbgLine::readFromFile( FILE *fp )
-	{
-		readPtr = 0;
 
-		return fgets(buf, bufSize, fp);
-	}
-	//---------------------------------------------------------------------------------------------------
-	int database::dbgLine::readToken( char *tk, size_t tkSize )
+	struct dbgKeyValue
+	{
+		const char *key;
+		size_t      keyLen;
+		const char *val;
+		size_t      valLen;
+	};
+
+	// Reads the next key=value at p, quotes are taken off string values
+	static bool nextKeyValue( const char *&p, const char *eol, dbgKeyValue &kv )
 	{
-		int charsRead = 0;
-		size_t i,j;
+		while ( (p < eol) && ((*p == ',') || isspace( static_cast<unsigned char>(*p) )) ) p++;
 
-		i=readPtr; j=0;
-		if ( buf[i] != 0 )
-		{
-			while (isspace(buf[i])) i++;
+		kv.key = p;
 
-			if ( isalpha(buf[i]) || (buf[i] == '_') )
-			{
-				while ( isalnum(buf[i]) || (buf[i] == '_') )
-				{
-					if (j < tkSize)
-					{
-						tk[j] = buf[i]; j++;
-					}
-					i++;
-				}
-			}
-			else if (buf[i] != 0)
-			{
-				if (j < tkSize)
-				{
-					tk[j] = buf[i]; j++;
-				}
-				i++;
-			}
-		}
-		charsRead = j;
-		readPtr = i;
+		while ( (p < eol) && isIdentChar(*p) ) p++;
 
-		if (j < tkSize)
-		{
-			tk[j] = 0;
-		}
-		else
+		kv.keyLen = p - kv.key;
+
+		if ( (kv.keyLen == 0) || (p >= eol) || (*p != '=') )
 		{
-			tk[tkSize-1] = 0;
+			return false;
 		}
-		return charsRead;
-	}
-	//---------------------------------------------------------------------------------------------------
-	int database::dbgLine::readKeyValuePair( char *keyValueBuffer, size_t keyValueBufferSize )
-	{
-		int charsRead = 0;
-		size_t i,j;
-		bool isStringLiteral = false;
+		p++;
 
-		i=readPtr; j=0;
-		if ( buf[i] != 0 )
+		if ( (p < eol) && (*p == '\"') )
 		{
-			while (isspace(buf[i])) i++;
+			p++;
+			kv.val = p;
 
-			if ( isalpha(buf[i]) || (buf[i] == '_') )
-			{
-				while ( isalnum(buf[i]) || (buf[i] == '_') )
-				{
-					if (j < keyValueBufferSize)
-					{
-						keyValueBuffer[j] = buf[i]; j++;
-					}
-					i++;
-				}
-			}
-			else if (buf[i] != 0)
-			{
-				if (j < keyValueBufferSize)
-				{
-					keyValueBuffer[j] = buf[i]; j++;
-				}
-				i++;
-			}
+			while ( (p < eol) && (*p != '\"') ) p++;
 
-			while (isspace(buf[i])) i++;
-		}
+			kv.valLen = p - kv.val;
 
-		if ( buf[i] == '=' )
+			if (p < eol) p++;
+		}
+		else
 		{
-			if (j < keyValueBufferSize)
-			{
-				keyValueBuffer[j] = buf[i]; j++;
-			}
-			i++;
+			kv.val = p;
 
-			while (isspace(buf[i])) i++;
+			while ( (p < eol) && (*p != ',') && !isspace( static_cast<unsigned char>(*p) ) ) p++;
 
-			while ( buf[i] != 0 )
-			{
-				if ( !isStringLiteral && buf[i] == ',' )
-				{
-					break;
-				}
-				else if ( buf[i] == '\"' )
-				{
-					isStringLiteral = !isStringLiteral;
-				}
-				else
-				{
-					if (j < keyValueBufferSize)
-					{
-						if (!isspace(buf[i]))
-						{
-							keyValueBuffer[j] = buf[i]; j++;
-						}
-					}
-				}
-				i++;
-			}
-			if (buf[i] == ',')
-			{
-				i++;
-			}
+			kv.valLen = p - kv.val;
 		}
-		charsRead = j;
-		readPtr = i;
+		return true;
+	}
 
-		if (j < keyValueBufferSize)
-		{
-			keyValueBuffer[j] = 0;
-		}
-		else
+	template <class T>
+	static T &recordAt( std::vector<T> &v, int id )
+	{
+		if ( static_cast<size_t>(id) >= v.size() )
 		{
-			keyValueBuffer[keyValueBufferSize-1] = 0;
+			v.resize( id + 1 );
 		}
-		return charsRead;
+		return v[id];
+	}
+	//---------------------------------------------------------------------------------------------------
+	database::database(void)
+	{
+	}
+	//---------------------------------------------------------------------------------------------------
+	database::~database(void)
+	{
 	}
 	//---------------------------------------------------------------------------------------------------
-	int database::dbgLine::splitKeyValuePair( char *keyValueBuffer, char **keyPtr, char **valuePtr )
+	void database::parse( const char *buf, size_t len )
 	{
-		size_t i=0;
+		const char *p = buf, *end = buf + len;
 
-		if (keyPtr != nullptr)
+		while ( p < end )
 		{
-			*keyPtr = keyValueBuffer;
-		}
-		while (keyValueBuffer[i] != 0)
-		{
-			if (keyValueBuffer[i] == '=')
+			const char *eol = static_cast<const char*>( memchr( p, '\n', end - p ) );
+
+			if (eol == nullptr)
 			{
-				keyValueBuffer[i] = 0; i++; break;
+				eol = end;
 			}
-			i++;
-		}
-		if (valuePtr != nullptr)
-		{
-			*valuePtr = &keyValueBuffer[i];
-		}
-		return 0;
-	}
-	//---------------------------------------------------------------------------------------------------
-	int database::dbgFileLoad( const char *dbgFilePath )
-	{
-		static constexpr size_t lineSize = 4096;
-		FILE *fp;
-		dbgLine line( lineSize );
-		char lineType[64];
-		fceuScopedPtr <char> keyValueBuffer( new char[ lineSize ], FCEU_ALLOC_TYPE_NEW_ARRAY );
+			while ( (p < eol) && isspace( static_cast<unsigned char>(*p) ) ) p++;
 
-		fp = ::fopen( dbgFilePath, "r");
+			const char *tk = p;
 
-		if (fp == NULL)
-		{
-			return -1;
-		}
+			while ( (p < eol) && isIdentChar(*p) ) p++;
 
-		while ( line.readFromFile(fp) != NULL )
-		{
-			//printf("%s", line.getLine());
+			size_t tkLen = p - tk;
+			int lineType = LINE_OTHER;
 
-			if ( line.readToken( lineType, sizeof(lineType) ) )
+			if ( tokenIs( tk, tkLen, "sym" ) )
 			{
-				int id = -1, size = 0, startAddr = 0, ofs = -1, parentID = -1, scopeID = -1, segmentID = -1;
-				int value = 0;
-				unsigned char segType = segment::READ;
-				char name[256];
-				char type[32];
+				lineType = LINE_SYM;
+			}
+			else if ( tokenIs( tk, tkLen, "scope" ) )
+			{
+				lineType = LINE_SCOPE;
+			}
+			else if ( tokenIs( tk, tkLen, "seg" ) )
+			{
+				lineType = LINE_SEG;
+			}
+			else if ( tokenIs( tk, tkLen, "info" ) )
+			{
+				lineType = LINE_INFO;
+			}
 
-				name[0] = 0;
-				type[0] = 0;
+			if ( lineType != LINE_OTHER )
+			{
+				int id = -1, size = 0, startAddr = 0, ofs = -1, parentID = -1, scopeID = -1, segmentID = -1;
+				int value = 0, symType = sym::IMPORT;
+				const char *name = "";
+				size_t nameLen = 0;
+				dbgKeyValue kv;
 
-				while ( line.readKeyValuePair( keyValueBuffer.get(), lineSize) )
+				while ( nextKeyValue( p, eol, kv ) )
 				{
-					char *key, *val;
-
-					line.splitKeyValuePair( keyValueBuffer.get(), &key, &val );
-
-					//printf("   Key '%s' -> Value '%s' \n", key, val );
+					const char *val = kv.val, *valEnd = kv.val + kv.valLen;
 
-					if ( strcmp( key, "id") == 0 )
+					if ( lineType == LINE_INFO )
+					{
+						// Record counts, so the tables are sized once
+						if ( tokenIs( kv.key, kv.keyLen, "seg" ) )
+						{
+							segments.reserve( parseInt( val, valEnd ) );
+						}
+						else if ( tokenIs( kv.key, kv.keyLen, "scope" ) )
+						{
+							scopes.reserve( parseInt( val, valEnd ) );
+						}
+						else if ( tokenIs( kv.key, kv.keyLen, "sym" ) )
+						{
+							syms.reserve( parseInt( val, valEnd ) );
+						}
+					}
+					else if ( tokenIs( kv.key, kv.keyLen, "id" ) )
 					{
-						id = strtol( val, nullptr, 0 );
+						id = parseInt( val, valEnd );
 					}
-					else if ( strcmp( key, "name") == 0 )
+					else if ( tokenIs( kv.key, kv.keyLen, "name" ) )
 					{
-						Strlcpy( name, val, sizeof(name));
+						name = kv.val; nameLen = kv.valLen;
 					}
-					else if ( strcmp( key, "size") == 0 )
+					else if ( tokenIs( kv.key, kv.keyLen, "size" ) )
 					{
-						size = strtol( val, nullptr, 0 );
+						size = parseInt( val, valEnd );
 					}
-					else if ( strcmp( key, "val") == 0 )
+					else if ( tokenIs( kv.key, kv.keyLen, "val" ) )
 					{
-						value = strtol( val, nullptr, 0 );
+						value = parseInt( val, valEnd );
 					}
-					else if ( strcmp( key, "scope") == 0 )
+					else if ( tokenIs( kv.key, kv.keyLen, "scope" ) )
 					{
-						scopeID = strtol( val, nullptr, 0 );
+						scopeID = parseInt( val, valEnd );
 					}
-					else if ( strcmp( key, "parent") == 0 )
+					else if ( tokenIs( kv.key, kv.keyLen, "parent" ) )
 					{
-						parentID = strtol( val, nullptr, 0 );
+						parentID = parseInt( val, valEnd );
 					}
-					else if ( strcmp( key, "seg") == 0 )
+					else if ( tokenIs( kv.key, kv.keyLen, "seg" ) )
 					{
-						segmentID = strtol( val, nullptr, 0 );
+						segmentID = parseInt( val, valEnd );
 					}
-					else if ( strcmp( key, "ooffs") == 0 )
+					else if ( tokenIs( kv.key, kv.keyLen, "start" ) )
 					{
-						ofs = strtol( val, nullptr, 0 );
+						startAddr = parseInt( val, valEnd );
 					}
-					else if ( strcmp( key, "type") == 0 )
+					else if ( tokenIs( kv.key, kv.keyLen, "ooffs" ) )
 					{
-						Strlcpy( type, val, sizeof(type));
+						ofs = parseInt( val, valEnd );
+					}
+					else if ( tokenIs( kv.key, kv.keyLen, "type" ) )
+					{
+						if ( tokenIs( val, kv.valLen, "lab" ) )
+						{
+							symType = sym::LABEL;
+						}
+						else if ( tokenIs( val, kv.valLen, "equ" ) )
+						{
+							symType = sym::EQU;
+						}
 					}
 				}
 
-				if ( strcmp( lineType, "seg" ) == 0 )
+				if ( id >= 0 )
 				{
-					if ( id >= 0 )
+					if ( lineType == LINE_SEG )
 					{
-						segment *s = new segment( id, name, startAddr, size, ofs, segType );
+						segment &s = recordAt( segments, id );
 
-						segmentMap[id] = s;
+						s = segment( id, nullptr, startAddr, size, ofs, segment::READ );
+						s._name.assign( name, nameLen );
 					}
-				}
-				else if ( strcmp( lineType, "scope" ) == 0 )
-				{
-					if ( id >= 0 )
+					else if ( lineType == LINE_SCOPE )
 					{
-						scope *s = new scope( id, name, size, parentID );
+						scope &s = recordAt( scopes, id );
 
-						scopeMap[id] = s;
-
-						auto it = scopeMap.find( parentID );
+						s = scope( id, nullptr, size, parentID );
+						s._name.assign( name, nameLen );
+					}
+					else if ( lineType == LINE_SYM )
+					{
+						sym &s = recordAt( syms, id );
 
-						if ( it != scopeMap.end() )
-						{
-							//printf("Found Parent:%i for %i\n", parentID, id );
-							s->_parent = it->second;
-						}
+						s = sym( id, nullptr, size, value, symType );
+						s._name.assign( name, nameLen );
+						s._scopeID   = scopeID;
+						s._segmentID = segmentID;
 					}
 				}
-				else if ( strcmp( lineType, "sym") == 0 )
-				{
-					if ( id >= 0 )
-					{
-						int symType = sym::IMPORT;
+			}
+			p = eol + 1;
+		}
+	}
+	//---------------------------------------------------------------------------------------------------
+	// Resolves the IDs once every record is in place, the tables no longer move
+	void database::link(void)
+	{
+		for (size_t i=0; i<scopes.size(); i++)
+		{
+			scope &s = scopes[i];
+			int parentID = s._parentID;
 
-						if ( strcmp( type, "lab") == 0)
-						{
-							symType = sym::LABEL;
-						}
-						else if ( strcmp( type, "equ") == 0)
-						{
-							symType = sym::EQU;
-						}
+			if ( (parentID >= 0) && (static_cast<size_t>(parentID) < scopes.size()) && (scopes[parentID]._id >= 0) )
+			{
+				s._parent = &scopes[parentID];
+			}
+		}
+		for (size_t i=0; i<syms.size(); i++)
+		{
+			sym &s = syms[i];
+
+			if ( (s._scopeID >= 0) && (static_cast<size_t>(s._scopeID) < scopes.size()) && (scopes[s._scopeID]._id >= 0) )
+			{
+				s._scope = &scopes[s._scopeID];
+			}
+			if ( (s._segmentID >= 0) && (static_cast<size_t>(s._segmentID) < segments.size()) && (segments[s._segmentID]._id >= 0) )
+			{
+				s._segment = &segments[s._segmentID];
+			}
+		}
+	}
+	//---------------------------------------------------------------------------------------------------
+	int database::dbgFileLoad( const char *dbgFilePath )
+	{
+		EMUFILE_MAPPED *map = EMUFILE_MAPPED::open( dbgFilePath );
 
-						sym *s = new sym( id, name, size, value, symType );
+		scopes.clear();
+		segments.clear();
+		syms.clear();
 
-						auto it = scopeMap.find( scopeID );
+		if ( map )
+		{
+			parse( reinterpret_cast<const char*>( map->buf() ), map->size() );
 
-						if ( it != scopeMap.end() )
-						{
-							//printf("Found Scope:%i for %s\n", scopeID, name );
-							s->_scope = it->second;
-						}
+			delete map;
+		}
+		else
+		{
+			EMUFILE_FILE fp( dbgFilePath, "rb" );
 
-						auto itSeg = segmentMap.find( segmentID );
+			if ( !fp.is_open() )
+			{
+				return -1;
+			}
+			std::vector<char> buf( fp.size() );
 
-						if ( itSeg != segmentMap.end() )
-						{
-							//printf("Found Segment:%i for %s\n", segmentID, name );
-							s->_segment = itSeg->second;
-						}
-						symMap[id] = s;
-					}
-				}
+			if ( buf.size() > 0 )
+			{
+				buf.resize( fp.fread( &buf[0], buf.size() ) );
 			}
+			parse( buf.data(), buf.size() );
 		}
-		::fclose(fp);
+		link();
 
 		return 0;
 	}
@@ -409,10 +372,13 @@ namespace ld65
 	{
 		int numSyms = 0;
 
-		for (auto it = symMap.begin(); it != symMap.end(); it++)
+		for (size_t i=0; i<syms.size(); i++)
 		{
-			cb( userData, it->second );
-			numSyms++;
+			if ( syms[i]._id >= 0 )
+			{
+				cb( userData, &syms[i] );
+				numSyms++;
+			}
 		}
 		return numSyms;
 	}
@@ -3,7 +3,7 @@
 #pragma once
 #include <stdio.h>
 #include <string>
-#include <map>
+#include <vector>
 
 namespace ld65
 {
@@ -15,7 +15,7 @@ namespace ld65
 			static constexpr unsigned char  READ = 0x01;
 			static constexpr unsigned char WRITE = 0x02;
 
-			segment( int id, const char *name = nullptr, int startAddr = 0, int size = 0, int ofs = -1, unsigned char type = READ );
+			segment( int id = -1, const char *name = nullptr, int startAddr = 0, int size = 0, int ofs = -1, unsigned char type = READ );
 
 			const char *name(void){ return _name.c_str(); };
 
@@ -38,7 +38,7 @@ namespace ld65
 	class scope
 	{
 		public:
-			scope( int id, const char *name = nullptr, int size = 0, int parentID = -1);
+			scope( int id = -1, const char *name = nullptr, int size = 0, int parentID = -1);
 
 			const char *name(void){ return _name.c_str(); };
 
@@ -68,7 +68,7 @@ namespace ld65
 				EQU
 			};
 
-			sym( int id, const char *name = nullptr, int size = 0, int value = 0, int type = IMPORT);
+			sym( int id = -1, const char *name = nullptr, int size = 0, int value = 0, int type = IMPORT);
 
 			int id(void){ return _id; };
 
@@ -90,6 +90,8 @@ namespace ld65
 			int   _size;
 			int   _value;
 			int   _type;
+			int   _scopeID;
+			int   _segmentID;
 
 			scope   *_scope;
 			segment *_segment;
@@ -108,32 +110,14 @@ namespace ld65
 			int iterateSymbols( void *userData, void (*cb)( void *userData, sym *s ) );
 
 		private:
-			std::map<int, scope*> scopeMap;
-			std::map<int, segment*> segmentMap;
-			std::map<int, sym*> symMap;
+			// Records by debug ID. ld65 numbers them from zero without gaps,
+			// so they are stored in place rather than allocated one by one.
+			std::vector<scope> scopes;
+			std::vector<segment> segments;
+			std::vector<sym> syms;
 
-			class dbgLine
-			{
-				public:
-					dbgLine(size_t bufferSize = 1024);
-					~dbgLine(void);
-
-					const char *readFromFile( FILE *fp );
-
-					const char *getLine(void){ return buf; };
-
-					int readToken( char *tk, size_t tkSize );
+			void parse( const char *buf, size_t len );
 
-					int readKeyValuePair( char *keyValueBuffer, size_t keyValueBufferSize );
-
-					static int splitKeyValuePair( char *keyValueBuffer, char **keyPtr, char **valuePtr );
-
-				private:
-					void allocBuffer(size_t bufferSize);
-
-					size_t readPtr;
-					size_t bufSize;
-					char  *buf;
-			};
+			void link(void);
 	};
 };
@@ -36,6 +36,9 @@
 #include "utils/memory.h"
 #include "utils/crc32.h"
 #include "fceulua.h"
+#include "framehash.h"
+#include "stageprof.h"
+#include "inputsearch.h"
 
 extern char FileBase[];
 
@@ -72,6 +75,7 @@ void fceuWrapperRequestAppExit(void);
 
 #endif
 
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -175,19 +179,109 @@ extern void AddRecentLuaFile(const char *filename);
 extern bool turbo;
 extern int32 fps_scale;
 
+// Anonymous states saved while no movie (or netplay) needs the full format
+// are flat snapshots, FCEUSS_Snapshot() followed by the back buffer, so
+// saving and loading one is a copy. The slots all have one size and go
+// back to this pool when their state is collected.
+#define LUA_SNAPSHOT_POOL_MAX 64
+#define LUA_SNAPSHOT_BACKBUF (256*256)
+
+static std::vector<uint8*> luaSnapshotPool;
+static size_t luaSnapshotSlotSize = 0;
+
+#ifdef __QT_DRIVER__
+bool NetPlayActive(void);	// a netplay client hands its state loads to the host
+static inline bool luaNetPlayActive() { return NetPlayActive(); }
+#else
+static inline bool luaNetPlayActive() { return false; }
+#endif
+
+static void luaSnapshotPoolClear()
+{
+	for (size_t i = 0; i < luaSnapshotPool.size(); i++)
+		free(luaSnapshotPool[i]);
+	luaSnapshotPool.clear();
+}
+
+static uint8* luaSnapshotAlloc(size_t size)
+{
+	if (size != luaSnapshotSlotSize)
+	{
+		// another game, the slots kept are the wrong size
+		luaSnapshotPoolClear();
+		luaSnapshotSlotSize = size;
+	}
+	if (!luaSnapshotPool.empty())
+	{
+		uint8* slot = luaSnapshotPool.back();
+		luaSnapshotPool.pop_back();
+		return slot;
+	}
+	return (uint8*)malloc(size);
+}
+
+static void luaSnapshotFree(uint8* slot, size_t size)
+{
+	if (size == luaSnapshotSlotSize && luaSnapshotPool.size() < LUA_SNAPSHOT_POOL_MAX)
+		luaSnapshotPool.push_back(slot);
+	else
+		free(slot);
+}
+
 struct LuaSaveState {
 	std::string filename;
 	EMUFILE_MEMORY *data;
+	uint8 *snapshot;		// or this, FCEUSS_SnapshotSize() bytes then the back buffer
+	size_t snapshotSize;
 	bool anonymous, persisted;
 	LuaSaveState()
 		: data(0)
+		, snapshot(0)
+		, snapshotSize(0)
 		, anonymous(false)
 		, persisted(false)
 	{}
 	~LuaSaveState() {
 		if(data) delete data;
+		releaseSnapshot();
+	}
+	void releaseSnapshot() {
+		if(snapshot) luaSnapshotFree(snapshot, snapshotSize + LUA_SNAPSHOT_BACKBUF);
+		snapshot = 0;
+		snapshotSize = 0;
+	}
+	// A file needs the full format, which is only made from the running
+	// console, so the snapshot is loaded for as long as writing it takes.
+	void snapshotToData() {
+		if(!snapshot) return;
+		if(snapshotSize == FCEUSS_SnapshotSize())
+		{
+			std::vector<uint8> cur(snapshotSize + LUA_SNAPSHOT_BACKBUF);
+			FCEUSS_Snapshot(&cur[0], snapshotSize);
+			memcpy(&cur[snapshotSize], XBackBuf, LUA_SNAPSHOT_BACKBUF);
+
+			FCEUSS_Restore(snapshot, snapshotSize);
+			memcpy(XBackBuf, snapshot + snapshotSize, LUA_SNAPSHOT_BACKBUF);
+			if(data) delete data;
+			data = new EMUFILE_MEMORY();
+			FCEUSS_SaveMS(data,Z_NO_COMPRESSION);
+			data->fseek(0,SEEK_SET);
+
+			FCEUSS_Restore(&cur[0], snapshotSize);
+			memcpy(XBackBuf, &cur[snapshotSize], LUA_SNAPSHOT_BACKBUF);
+		}
+		releaseSnapshot();
 	}
 	void persist() {
+		snapshotToData();
+		if(!data) return;
+		if(filename.empty())
+		{
+			// anonymous states only get a file once they need one
+			char* tmp = tempnam(NULL, "snlua");
+			filename = tmp;
+			free(tmp);
+		}
 		persisted = true;
 		FILE* outf = fopen(filename.c_str(),"wb");
 		fwrite(data->buf(),1,data->size(),outf);
@@ -257,7 +351,8 @@ int luaRunning = FALSE;
 static int frameBoundary = FALSE;
 
 // The execution speed we're running at.
-static enum {SPEED_NORMAL, SPEED_NOTHROTTLE, SPEED_TURBO, SPEED_MAXIMUM} speedmode = SPEED_NORMAL;
+enum LuaSpeedMode {SPEED_NORMAL, SPEED_NOTHROTTLE, SPEED_TURBO, SPEED_MAXIMUM};
+static LuaSpeedMode speedmode = SPEED_NORMAL;
 
 // Rerecord count skip mode
 static int skipRerecords = FALSE;
@@ -291,13 +386,231 @@ static enum { GUI_USED_SINCE_LAST_DISPLAY, GUI_USED_SINCE_LAST_FRAME, GUI_CLEAR
 static uint8 *gui_data = NULL;
 static int gui_saw_current_palette = FALSE;
 
+// With the overlay on (FCEU_LuaSetGuiOverlay), boxes, lines and pixels are
+// kept as commands for the video driver instead of being drawn into
+// gui_data. Once something has been drawn into gui_data in a frame, the
+// rest of the frame is drawn there too, so the commands are always under it.
+static bool gui_overlay = false;
+static bool gui_layer_used = false;
+static std::vector<LuaGuiCommand> gui_commands;
+static const size_t GUI_MAX_COMMANDS = 16384;
+
 // Protects Lua calls from going nuts.
 // We set this to a big number like 1000 and decrement it
 // over time. The script gets knifed once this reaches zero.
 static int numTries;
 
-// number of registered memory functions (1 per hooked byte)
-static unsigned int numMemHooks;
+// frames left of an emu.loopframes() run
+static int luaLoopFrames;
+
+// emu.advancetoinputpoll() in progress: frames it may still run, lag frames run
+static bool luaInputPollWaiting = false;
+static int luaInputPollFrames;
+static int luaInputPollSkipped;
+
+// CPU accounting, time of the outermost call into the script only so that
+// callbacks run from script code are not counted twice
+uint64 FCEUD_GetTime(void);
+uint64 FCEUD_GetTimeFreq(void);
+
+static uint64 luaUsageTicks;          // this frame so far
+static unsigned int luaUsageHookCalls;
+static int luaUsageDepth;
+static LuaCpuUsage luaUsage;
+
+// Once the script has used its budget in a frame, its frame and memory hook
+// callbacks are skipped until the next one. 0 is no budget.
+static uint64 luaBudgetTicks;
+static unsigned int luaBudgetSkips;   // callbacks skipped this frame
+
+struct LuaUsageScope
+{
+	uint64 start;
+
+	LuaUsageScope() { start = (luaUsageDepth++ == 0) ? FCEUD_GetTime() : 0; }
+	~LuaUsageScope() { if (--luaUsageDepth == 0) luaUsageTicks += FCEUD_GetTime() - start; }
+};
+
+// Memory hooks of a script, looked up per address with no Lua call: a set
+// bit marks a hooked address and func holds the registry reference of its
+// callback. A function registered over a range takes one reference,
+// refCount counts the addresses using it.
+#define MEMHOOK_ADDRESSES 0x10000
+struct LuaMemHooks
+{
+	uint32 bits[LUAMEMHOOK_COUNT][MEMHOOK_ADDRESSES >> 5];
+	int func[LUAMEMHOOK_COUNT][MEMHOOK_ADDRESSES];
+	std::map<int, unsigned int> refCount;
+	unsigned int count[LUAMEMHOOK_COUNT];
+};
+
+// Every script's hooks merged, an access the CPU hook finds no bit for
+// costs no more with several scripts than with one
+static uint32 memHookBits[LUAMEMHOOK_COUNT][MEMHOOK_ADDRESSES >> 5];
+static unsigned int numMemHooksOfType[LUAMEMHOOK_COUNT];
+
+// the CPU hooks are only installed for the types in use, the CPU core
+// runs its uninstrumented loop when none are
+static bool memHookInstalled[LUAMEMHOOK_COUNT];
+static int memHookDepth;
+
+// Scripts run side by side, each in its own Lua state, on one dispatcher:
+// the frame boundary, the frame, gui, savestate and memory hook callbacks go
+// to each script in the order they started. The file scope state above (L,
+// luaRunning, frameAdvanceWaiting, the usage figures...) is the current
+// script's, LuaScriptSwitch trades it for another's before that one's code
+// runs. The gui drawing and the joypad and zapper overrides are shared.
+struct LuaScript
+{
+	int id;
+	unsigned int recordKey; // of the savestate data its registersave function gives
+	std::string name;
+	LuaMemHooks *hooks;
+
+	lua_State *L;
+	int running;
+	int frameAdvanceWaiting;
+	LuaSpeedMode speedmode;
+	int skipRerecords;
+	int loopFrames;
+	bool inputPollWaiting;
+	int inputPollFrames;
+	int inputPollSkipped;
+	int exitErrorCount;
+	int callbackErrorCounter;
+	int transparencyModifier;
+	void(*print)(intptr_t uid, const char* str);
+	void(*onstart)(intptr_t uid);
+	void(*onstop)(intptr_t uid);
+	intptr_t uid;
+	uint64 usageTicks;
+	unsigned int usageHookCalls;
+	int usageDepth;
+	LuaCpuUsage usage;
+	uint64 budgetTicks;
+	unsigned int budgetSkips;
+};
+
+static std::vector<LuaScript*> luaScripts;
+static LuaScript *luaCur = NULL;
+static int luaNextScriptId = 1;
+
+static void LuaScriptStore(LuaScript *s)
+{
+	s->L = L;
+	s->running = luaRunning;
+	s->frameAdvanceWaiting = frameAdvanceWaiting;
+	s->speedmode = speedmode;
+	s->skipRerecords = skipRerecords;
+	s->loopFrames = luaLoopFrames;
+	s->inputPollWaiting = luaInputPollWaiting;
+	s->inputPollFrames = luaInputPollFrames;
+	s->inputPollSkipped = luaInputPollSkipped;
+	s->exitErrorCount = luaexiterrorcount;
+	s->callbackErrorCounter = luaCallbackErrorCounter;
+	s->transparencyModifier = transparencyModifier;
+	s->print = info_print;
+	s->onstart = info_onstart;
+	s->onstop = info_onstop;
+	s->uid = info_uid;
+	s->usageTicks = luaUsageTicks;
+	s->usageHookCalls = luaUsageHookCalls;
+	s->usageDepth = luaUsageDepth;
+	s->usage = luaUsage;
+	s->budgetTicks = luaBudgetTicks;
+	s->budgetSkips = luaBudgetSkips;
+}
+
+static void LuaScriptLoad(const LuaScript *s)
+{
+	L = s->L;
+	luaRunning = s->running;
+	frameAdvanceWaiting = s->frameAdvanceWaiting;
+	speedmode = s->speedmode;
+	skipRerecords = s->skipRerecords;
+	luaLoopFrames = s->loopFrames;
+	luaInputPollWaiting = s->inputPollWaiting;
+	luaInputPollFrames = s->inputPollFrames;
+	luaInputPollSkipped = s->inputPollSkipped;
+	luaexiterrorcount = s->exitErrorCount;
+	luaCallbackErrorCounter = s->callbackErrorCounter;
+	transparencyModifier = s->transparencyModifier;
+	info_print = s->print;
+	info_onstart = s->onstart;
+	info_onstop = s->onstop;
+	info_uid = s->uid;
+	luaUsageTicks = s->usageTicks;
+	luaUsageHookCalls = s->usageHookCalls;
+	luaUsageDepth = s->usageDepth;
+	luaUsage = s->usage;
+	luaBudgetTicks = s->budgetTicks;
+	luaBudgetSkips = s->budgetSkips;
+}
+
+static void LuaScriptSwitch(LuaScript *s)
+{
+	if (s == luaCur)
+		return;
+	if (luaCur)
+		LuaScriptStore(luaCur);
+	luaCur = s;
+	if (s)
+		LuaScriptLoad(s);
+}
+
+// Brings the current script's state into its LuaScript, for a look at all of them
+static void LuaScriptSync()
+{
+	if (luaCur)
+		LuaScriptStore(luaCur);
+}
+
+static bool LuaScriptAlive(const LuaScript *s)
+{
+	return std::find(luaScripts.begin(), luaScripts.end(), s) != luaScripts.end();
+}
+
+static LuaScript *LuaFindScript(int id)
+{
+	for (size_t n = 0; n < luaScripts.size(); n++)
+		if (luaScripts[n]->id == id)
+			return luaScripts[n];
+	return NULL;
+}
+
+// Makes a script the current one, the one before comes back after, unless
+// it stopped meanwhile
+struct LuaScriptScope
+{
+	LuaScript *prev;
+
+	LuaScriptScope(LuaScript *s) : prev(luaCur) { LuaScriptSwitch(s); }
+	~LuaScriptScope() { if (prev && LuaScriptAlive(prev)) LuaScriptSwitch(prev); }
+};
+
+// Runs f as each script in turn. A script that stops in f takes its slot
+// with it, the next one is in that slot then.
+template<typename F>
+static void LuaForEachScript(F f)
+{
+	for (size_t n = 0; n < luaScripts.size(); n++)
+	{
+		LuaScript *s = luaScripts[n];
+		{
+			LuaScriptScope scope(s);
+			f();
+		}
+		if (n >= luaScripts.size() || luaScripts[n] != s)
+			n--;
+	}
+}
+
+static bool LuaOverBudget()
+{
+	return luaBudgetTicks && (luaUsageTicks >= luaBudgetTicks);
+}
+
+static void LuaStopScript(LuaScript *s);
 
 // Look in fceu.h for macros named like JOY_UP to determine the order.
 static const char *button_mappings[] = {
@@ -327,16 +640,6 @@ static const char* luaCallIDStrings [] =
 //make sure we have the right number of strings
 CTASSERT(sizeof(luaCallIDStrings)/sizeof(*luaCallIDStrings) == LUACALL_COUNT)
 
-static const char* luaMemHookTypeStrings [] =
-{
-	"MEMHOOK_WRITE",
-	"MEMHOOK_READ",
-	"MEMHOOK_EXEC",
-};
-
-//make sure we have the right number of strings
-CTASSERT(sizeof(luaMemHookTypeStrings)/sizeof(*luaMemHookTypeStrings) ==  LUAMEMHOOK_COUNT)
-
 static char* rawToCString(lua_State* L, int idx=0);
 static const char* toCString(lua_State* L, int idx=0);
 
@@ -348,6 +651,15 @@ static int exitScheduled = FALSE;
 static void FCEU_LuaOnStop()
 {
 	luaRunning = FALSE;
+
+	// the overrides and the speed are everybody's while another script runs
+	LuaScriptSync();
+	for (size_t n = 0; n < luaScripts.size(); n++)
+	{
+		if (luaScripts[n]->L && luaScripts[n]->running)
+			return;
+	}
+
 	luazapperx = -1;
 	luazappery = -1;
 	luazapperfire = -1;
@@ -379,13 +691,29 @@ static void FCEU_LuaOnStop()
  * Returns 0 if no, 1 if yes. If yes, caller should also
  * consult FCEU_LuaFrameSkip().
  */
+// The fastest speed a running script asked for
+static LuaSpeedMode LuaScriptsSpeedMode()
+{
+	LuaSpeedMode mode = SPEED_NORMAL;
+
+	LuaScriptSync();
+	for (size_t n = 0; n < luaScripts.size(); n++)
+	{
+		const LuaScript *s = luaScripts[n];
+
+		if (s->L && s->running && (s->speedmode > mode))
+			mode = s->speedmode;
+	}
+	return mode;
+}
+
 int FCEU_LuaSpeed() {
-	if (!L || !luaRunning)
+	if (luaScripts.empty())
 		return 0;
 
 	//printf("%d\n", speedmode);
 
-	switch (speedmode) {
+	switch (LuaScriptsSpeedMode()) {
 	case SPEED_NOTHROTTLE:
 	case SPEED_TURBO:
 	case SPEED_MAXIMUM:
@@ -396,15 +724,56 @@ int FCEU_LuaSpeed() {
 	}
 }
 
+// Closes the accounting of a frame
+static void LuaUsageEndFrame()
+{
+	double us = (double)luaUsageTicks * 1000000.0 / (double)FCEUD_GetTimeFreq();
+
+	luaUsage.frameUs = us;
+	luaUsage.avgUs += (us - luaUsage.avgUs) / 60.0;
+	if (us > luaUsage.peakUs)
+		luaUsage.peakUs = us;
+	luaUsage.hookCalls = luaUsageHookCalls;
+	luaUsage.skippedCalls = luaBudgetSkips;
+
+	luaUsageTicks = 0;
+	luaUsageHookCalls = 0;
+	luaBudgetSkips = 0;
+}
+
+/**
+ * True when a script asked with emu.loopframes() for the next frame to be
+ * run right away, counts that frame off.
+ */
+int FCEU_LuaLoopFrame() {
+	int loop = 0;
+
+	LuaScriptSync();
+	for (size_t n = 0; n < luaScripts.size(); n++)
+	{
+		LuaScript *s = luaScripts[n];
+
+		if (s->L && s->running && (s->loopFrames > 0))
+		{
+			s->loopFrames--;
+			loop = 1;
+		}
+	}
+	if (luaCur)
+		luaLoopFrames = luaCur->loopFrames;
+
+	return loop;
+}
+
 /**
  * Asks Lua if it wants control whether this frame is skipped.
  * Returns 0 if no, 1 if frame should be skipped, -1 if it should not be.
  */
 int FCEU_LuaFrameskip() {
-	if (!L || !luaRunning)
+	if (luaScripts.empty())
 		return 0;
 
-	switch (speedmode) {
+	switch (LuaScriptsSpeedMode()) {
 	case SPEED_NORMAL:
 		return 0;
 	case SPEED_NOTHROTTLE:
@@ -524,6 +893,126 @@ static int emu_frameadvance(lua_State *L) {
 	// It's actually rather disappointing...
 }
 
+// int emu.advancetoinputpoll([int max])
+//
+//  Like emu.frameadvance(), but the coroutine sleeps through the frames that
+//  do not read the controllers and is given back the number of them after
+//  the first frame that does, or after max (3600) frames.
+static int emu_advancetoinputpoll(lua_State *L) {
+	int max = luaL_optinteger(L, 1, 3600);
+
+	if (frameAdvanceWaiting)
+		return luaL_error(L, "can't call emu.advancetoinputpoll() from here");
+
+	frameAdvanceWaiting = TRUE;
+	luaInputPollWaiting = true;
+	luaInputPollFrames = (max > 0) ? max : 1;
+	luaInputPollSkipped = 0;
+
+	return lua_yield(L, 0);
+}
+
+// emu.loopframes(int n)
+//
+//  Runs the next n frames back to back on the emulator thread, without
+//  returning to the frontend's event loop, throttle or screen update in
+//  between. The frame callbacks and emu.frameadvance() run on every one of
+//  them. 0 cancels. Pausing or the frontend asking for the emulator ends it.
+static int emu_loopframes(lua_State *L)
+{
+	int n = luaL_checkinteger(L, 1);
+
+	luaLoopFrames = (n > 0) ? n : 0;
+	return 0;
+}
+
+// table emu.searchinput(table options)
+//
+//  Plays every sequence of options.depth steps (8) made of the button sets
+//  in options.alphabet, each held on options.pad (1) for options.frames (1),
+//  from the current frame, and returns the options.best (10) sequences with
+//  the highest value of options.objective, a breakpoint condition such as
+//  "$0086 + $006D * #100". Each is {score=, steps={buttons of each step},
+//  input=string} with input ready for taseditor.setinputrange(). States
+//  reached before are not played further unless options.dedupe is false.
+//  options.jobs worker processes (0, one per core) share the search. The
+//  console is left as it was. Returns nil and the reason when it can't run.
+static int emu_searchinput(lua_State *L)
+{
+	luaL_checktype(L, 1, LUA_TTABLE);
+	FCEU_InputSearchSettings settings;
+
+	lua_getfield(L, 1, "alphabet");
+	if (lua_istable(L, -1))
+	{
+		int n = luaL_getn(L, -1);
+		for (int i = 1; i <= n; i++)
+		{
+			lua_rawgeti(L, -1, i);
+			settings.alphabet.push_back(lua_tointeger(L, -1));
+			lua_pop(L, 1);
+		}
+	}
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "objective");
+	if (lua_isstring(L, -1))
+		settings.objective = lua_tostring(L, -1);
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "depth");
+	if (lua_isnumber(L, -1))
+		settings.depth = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "frames");
+	if (lua_isnumber(L, -1))
+		settings.frames = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "pad");
+	if (lua_isnumber(L, -1))
+		settings.pad = lua_tointeger(L, -1) - 1;
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "best");
+	if (lua_isnumber(L, -1))
+		settings.best = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "jobs");
+	if (lua_isnumber(L, -1))
+		settings.jobs = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "dedupe");
+	if (!lua_isnil(L, -1))
+		settings.dedupe = lua_toboolean(L, -1) != 0;
+	lua_pop(L, 1);
+
+	std::vector<FCEU_InputSearchResult> results;
+	FCEU_InputSearchStats stats;
+	if (!FCEUI_SearchInput(settings, results, stats))
+	{
+		lua_pushnil(L);
+		lua_pushstring(L, stats.error.c_str());
+		return 2;
+	}
+
+	lua_createtable(L, results.size(), 0);
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		lua_createtable(L, 0, 3);
+		lua_pushinteger(L, results[i].score);
+		lua_setfield(L, -2, "score");
+		lua_createtable(L, results[i].steps.size(), 0);
+		for (size_t s = 0; s < results[i].steps.size(); s++)
+		{
+			lua_pushinteger(L, results[i].steps[s]);
+			lua_rawseti(L, -2, s + 1);
+		}
+		lua_setfield(L, -2, "steps");
+		std::vector<uint8> input = results[i].frames(settings.frames);
+		lua_pushlstring(L, (const char *)input.data(), input.size());
+		lua_setfield(L, -2, "input");
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
 // bool emu.paused()
 static int emu_paused(lua_State *L)
 {
@@ -1396,7 +1885,7 @@ void LuaSaveData::ClearRecords()
 
 
 
-void CallRegisteredLuaSaveFunctions(int savestateNumber, LuaSaveData& saveData)
+static void CallScriptSaveFunction(int savestateNumber, LuaSaveData& saveData)
 {
 	//lua_State* L = FCEU_GetLuaState();
 	if(L)
@@ -1419,7 +1908,7 @@ void CallRegisteredLuaSaveFunctions(int savestateNumber, LuaSaveData& saveData)
 				fprintf(stderr, "Lua error in registersave function: %s\n", lua_tostring(L, -1));
 #endif
 			}
-			saveData.SaveRecord(L, LUA_DATARECORDKEY);
+			saveData.SaveRecord(L, luaCur->recordKey);
 		}
 		else
 		{
@@ -1428,8 +1917,13 @@ void CallRegisteredLuaSaveFunctions(int savestateNumber, LuaSaveData& saveData)
 	}
 }
 
+void CallRegisteredLuaSaveFunctions(int savestateNumber, LuaSaveData& saveData)
+{
+	LuaForEachScript([&]() { CallScriptSaveFunction(savestateNumber, saveData); });
+}
+
 
-void CallRegisteredLuaLoadFunctions(int savestateNumber, const LuaSaveData& saveData)
+static void CallScriptLoadFunction(int savestateNumber, const LuaSaveData& saveData)
 {
 	//lua_State* L = FCEU_GetLuaState();
 	if(L)
@@ -1450,12 +1944,12 @@ void CallRegisteredLuaLoadFunctions(int savestateNumber, const LuaSaveData& save
 			int prevGarbage = lua_gc(L, LUA_GCCOUNT, 0);
 
 			lua_pushinteger(L, savestateNumber);
-			saveData.LoadRecord(L, LUA_DATARECORDKEY, numParamsExpected);
+			saveData.LoadRecord(L, luaCur->recordKey, numParamsExpected);
 #else
 			int prevGarbage = lua_gc(L, LUA_GCCOUNT, 0);
 
 			lua_pushinteger(L, savestateNumber);
-			saveData.LoadRecord(L, LUA_DATARECORDKEY, (unsigned int) -1);
+			saveData.LoadRecord(L, luaCur->recordKey, (unsigned int) -1);
 #endif
 
 			int n = lua_gettop(L) - 1;
@@ -1490,6 +1984,11 @@ void CallRegisteredLuaLoadFunctions(int savestateNumber, const LuaSaveData& save
 	}
 }
 
+void CallRegisteredLuaLoadFunctions(int savestateNumber, const LuaSaveData& saveData)
+{
+	LuaForEachScript([&]() { CallScriptLoadFunction(savestateNumber, saveData); });
+}
+
 
 // rom.getfilename()
 //
@@ -1612,9 +2111,7 @@ static int memory_readbyterange(lua_State *L) {
 		return 0;
 
 	char* buf = (char*)alloca(range_size);
-	for(int i=0;i<range_size;i++) {
-		buf[i] = GetMem(range_start+i);
-	}
+	FCEU_GetMemRange(range_start, (uint8*)buf, range_size);
 
 	lua_pushlstring(L,buf,range_size);
 
@@ -1642,6 +2139,145 @@ static int ppu_readbyterange(lua_State *L) {
 	return 1;
 }
 
+// Byte buffer for scripts that read the same memory every frame. It is
+// filled in place, so reading it creates no strings or tables:
+//   local buf = memory.newbuffer(0x800)
+//   buf:copyfrom(0x0000, 0x800)         -- CPU memory as memory.readbyte sees it
+//   buf:copyfromppu(0x0000, 0x2000, 0)  -- PPU memory, dest offset optional
+//   buf:gather({0x30, 0x75, 0x3B8}, 16) -- each listed CPU address to the next byte
+//   local hp = buf[0x75]                -- bytes are indexed from 0, #buf is the size
+// The copy functions return the buffer.
+#define LUA_BYTEBUFFER "FCEU.ByteBuffer"
+
+struct LuaByteBuffer {
+	int size;
+	uint8 data[1];
+};
+
+static LuaByteBuffer *checkbytebuffer(lua_State *L, int idx) {
+	return (LuaByteBuffer *)luaL_checkudata(L, idx, LUA_BYTEBUFFER);
+}
+
+// offset of the destination, checks that [ofs, ofs+len) is in the buffer
+static int bytebuffer_checkrange(lua_State *L, LuaByteBuffer *buf, int ofsArg, int len) {
+	int ofs = luaL_optinteger(L, ofsArg, 0);
+
+	if (len < 0 || ofs < 0 || ofs > buf->size - len)
+		luaL_error(L, "%d bytes at offset %d do not fit in a buffer of %d", len, ofs, buf->size);
+	return ofs;
+}
+
+static int memory_newbuffer(lua_State *L) {
+	int size = luaL_checkinteger(L, 1);
+	if (size < 0)
+		luaL_argerror(L, 1, "negative size");
+
+	LuaByteBuffer *buf = (LuaByteBuffer *)lua_newuserdata(L, offsetof(LuaByteBuffer, data) + (size ? size : 1));
+	buf->size = size;
+	memset(buf->data, 0, size);
+
+	luaL_getmetatable(L, LUA_BYTEBUFFER);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+static int bytebuffer_copyfrom(lua_State *L) {
+	LuaByteBuffer *buf = checkbytebuffer(L, 1);
+	int addr = luaL_checkinteger(L, 2);
+	int len = luaL_checkinteger(L, 3);
+	int ofs = bytebuffer_checkrange(L, buf, 4, len);
+
+	FCEU_GetMemRange(addr, buf->data + ofs, len);
+
+	lua_settop(L, 1);
+	return 1;
+}
+
+static int bytebuffer_copyfromppu(lua_State *L) {
+	LuaByteBuffer *buf = checkbytebuffer(L, 1);
+	uint32 addr = luaL_checkinteger(L, 2);
+	int len = luaL_checkinteger(L, 3);
+	int ofs = bytebuffer_checkrange(L, buf, 4, len);
+
+	FCEUPPU_ReadRange(addr, buf->data + ofs, len);
+
+	lua_settop(L, 1);
+	return 1;
+}
+
+static int bytebuffer_gather(lua_State *L) {
+	LuaByteBuffer *buf = checkbytebuffer(L, 1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	int num = (int)lua_objlen(L, 2);
+	int ofs = bytebuffer_checkrange(L, buf, 3, num);
+
+	for (int i = 0; i < num; i++) {
+		lua_rawgeti(L, 2, i + 1);
+		buf->data[ofs + i] = GetMem(lua_tointeger(L, -1));
+		lua_pop(L, 1);
+	}
+
+	lua_settop(L, 1);
+	return 1;
+}
+
+// buf:tostring([offset [, len]])
+static int bytebuffer_tostring(lua_State *L) {
+	LuaByteBuffer *buf = checkbytebuffer(L, 1);
+	int ofs = luaL_optinteger(L, 2, 0);
+	int len = luaL_optinteger(L, 3, buf->size - ofs);
+
+	bytebuffer_checkrange(L, buf, 2, len);
+
+	lua_pushlstring(L, (const char *)buf->data + ofs, len);
+	return 1;
+}
+
+static int bytebuffer_size(lua_State *L) {
+	lua_pushinteger(L, checkbytebuffer(L, 1)->size);
+	return 1;
+}
+
+static int bytebuffer_index(lua_State *L) {
+	LuaByteBuffer *buf = checkbytebuffer(L, 1);
+
+	if (lua_type(L, 2) == LUA_TNUMBER) {
+		int i = lua_tointeger(L, 2);
+		if (i >= 0 && i < buf->size)
+			lua_pushinteger(L, buf->data[i]);
+		else
+			lua_pushnil(L);
+		return 1;
+	}
+	// methods
+	lua_getmetatable(L, 1);
+	lua_pushvalue(L, 2);
+	lua_rawget(L, -2);
+	return 1;
+}
+
+static int bytebuffer_newindex(lua_State *L) {
+	LuaByteBuffer *buf = checkbytebuffer(L, 1);
+	int i = luaL_checkinteger(L, 2);
+
+	if (i < 0 || i >= buf->size)
+		luaL_error(L, "index %d out of a buffer of %d", i, buf->size);
+	buf->data[i] = luaL_checkinteger(L, 3);
+	return 0;
+}
+
+static const struct luaL_reg bytebuffermeta [] = {
+	{"copyfrom", bytebuffer_copyfrom},
+	{"copyfromppu", bytebuffer_copyfromppu},
+	{"gather", bytebuffer_gather},
+	{"tostring", bytebuffer_tostring},
+	{"size", bytebuffer_size},
+	{"__index", bytebuffer_index},
+	{"__newindex", bytebuffer_newindex},
+	{"__len", bytebuffer_size},
+	{NULL,NULL}
+};
+
 static inline bool isalphaorunderscore(char c)
 {
 	return isalpha(c) || c == '_';
@@ -2011,6 +2647,53 @@ cpuToRegisterMaps [] =
 };
 
 
+#ifdef __FCEU_LUAJIT__
+// View of the CPU for LuaJIT's FFI. The layout stays as it is, new fields go
+// at the end with a new version, and the pointers lead to the live values,
+// so ram[i] in a script is a plain load with no API call. Unlike
+// memory.readbyte it sees RAM as written, without cheat substitutions.
+struct LuaFFIView
+{
+	uint32 version;
+	uint32 ramSize;
+	uint8 *ram;
+	uint16 *pc;
+	uint8 *a, *x, *y, *s, *p;
+};
+static LuaFFIView luaFFIView;
+
+static const char luaFFIViewInit[] =
+	"local ffi = require('ffi')\n"
+	"ffi.cdef[[\n"
+	"typedef struct {\n"
+	"	uint32_t version;\n"
+	"	uint32_t ramsize;\n"
+	"	uint8_t *ram;\n"
+	"	uint16_t *pc;\n"
+	"	uint8_t *a, *x, *y, *s, *p;\n"
+	"} fceu_view_t;\n"
+	"]]\n"
+	"memory.view = ffi.cast('fceu_view_t*', memory.ffiview())\n";
+
+// memory.ffiview() returns the view as a light userdata, memory.view is
+// already cast to fceu_view_t*
+static int memory_ffiview(lua_State *L)
+{
+	luaFFIView.version = 1;
+	luaFFIView.ramSize = 0x800;
+	luaFFIView.ram = RAM;
+	luaFFIView.pc = &_PC;
+	luaFFIView.a = &_A;
+	luaFFIView.x = &_X;
+	luaFFIView.y = &_Y;
+	luaFFIView.s = &_S;
+	luaFFIView.p = &_P;
+
+	lua_pushlightuserdata(L, &luaFFIView);
+	return 1;
+}
+#endif
+
 //DEFINE_LUA_FUNCTION(memory_getregister, "cpu_dot_registername_string")
 static int memory_getregister(lua_State *L)
 {
@@ -2123,216 +2806,218 @@ void HandleCallbackError(lua_State* L, bool stop, int msgDepth = -1)
 		fprintf(stderr, "Lua thread bombed out: %s\n", errmsg);
 #endif
 
-		// If stop flag is true, destruct the lua engine immediately.
+		// If stop flag is true, destruct the script's lua state immediately.
 		// else it will be destructed later at the next frame boundary when callback errors are detected.
 		if (stop)
 		{
-			FCEU_LuaStop();
+			LuaStopScript(luaCur);
 		}
 		luaCallbackErrorCounter++;
 	}
 }
 
 
-// the purpose of this structure is to provide a way of
-// QUICKLY determining whether a memory address range has a hook associated with it,
-// with a bias toward fast rejection because the majority of addresses will not be hooked.
-// (it must not use any part of Lua or perform any per-script operations,
-//  otherwise it would definitely be too slow.)
-// calculating the regions when a hook is added/removed may be slow,
-// but this is an intentional tradeoff to obtain a high speed of checking during later execution
-struct TieredRegion
+static const X6502_MemHook::Type memHookCpuType[LUAMEMHOOK_COUNT] =
 {
-	template<unsigned int maxGap>
-	struct Region
-	{
-		struct Island
-		{
-			unsigned int start;
-			unsigned int end;
-#ifdef NEED_MINGW_HACKS
-			bool Contains(unsigned int address, int size) const { return address < end && address+size > start; }
-#else
-			__forceinline bool Contains(unsigned int address, int size) const { return address < end && address+size > start; }
-#endif
-		};
-		std::vector<Island> islands;
+	X6502_MemHook::Write,
+	X6502_MemHook::Read,
+	X6502_MemHook::Exec,
+};
 
-		void Calculate(const std::vector<unsigned int>& bytes)
-		{
-			islands.clear();
+static void (*const memHookCpuFunc[LUAMEMHOOK_COUNT])(unsigned int address, unsigned int value, void *userData) =
+{
+	luaWriteMemHook,
+	luaReadMemHook,
+	luaExecMemHook,
+};
 
-			unsigned int lastEnd = ~0;
+// Installs the CPU hook of each type that has callbacks. Removing one while a
+// callback runs would free it under the CPU's hook walk, so that waits until
+// the next frame boundary.
+static void UpdateMemHookInstall(bool allowRemove)
+{
+	for (int i = 0; i < LUAMEMHOOK_COUNT; i++)
+	{
+		bool wanted = numMemHooksOfType[i] > 0;
 
-			std::vector<unsigned int>::const_iterator iter = bytes.begin();
-			std::vector<unsigned int>::const_iterator end = bytes.end();
-			for(; iter != end; ++iter)
-			{
-				unsigned int addr = *iter;
-				if(addr < lastEnd || addr > lastEnd + (long long)maxGap)
-				{
-					islands.push_back(Island());
-					islands.back().start = addr;
-				}
-				islands.back().end = addr+1;
-				lastEnd = addr+1;
-			}
+		if (wanted && !memHookInstalled[i])
+		{
+			X6502_MemHook::Add(memHookCpuType[i], memHookCpuFunc[i], nullptr);
+			memHookInstalled[i] = true;
 		}
-		bool Contains(unsigned int address, int size) const
+		else if (!wanted && memHookInstalled[i] && allowRemove && (memHookDepth == 0))
 		{
-			for (size_t i = 0; i != islands.size(); ++i)
-			{
-				if (islands[i].Contains(address, size))
-					return true;
-			}
-			return false;
+			X6502_MemHook::Remove(memHookCpuType[i], memHookCpuFunc[i], nullptr);
+			memHookInstalled[i] = false;
 		}
-	};
+	}
+}
 
-	Region<0xFFFFFFFF> broad;
-	Region<0x1000> mid;
-	Region<0> narrow;
+static void ReleaseMemHookRef(int ref)
+{
+	std::map<int, unsigned int> &refCount = luaCur->hooks->refCount;
+	std::map<int, unsigned int>::iterator it = refCount.find(ref);
 
-	void Calculate(std::vector<unsigned int>& bytes)
+	if (it != refCount.end() && --it->second == 0)
 	{
-		std::sort(bytes.begin(), bytes.end());
-
-		broad.Calculate(bytes);
-		mid.Calculate(bytes);
-		narrow.Calculate(bytes);
+		refCount.erase(it);
+		if (L)
+			luaL_unref(L, LUA_REGISTRYINDEX, ref);
 	}
+}
+
+static void MergeMemHookWord(int hookType, unsigned int w)
+{
+	uint32 bits = 0;
 
-	TieredRegion()
+	for (size_t n = 0; n < luaScripts.size(); n++)
+		bits |= luaScripts[n]->hooks->bits[hookType][w];
+
+	memHookBits[hookType][w] = bits;
+}
+
+// Sets a hook of the current script, ref is the callback's registry
+// reference, or LUA_NOREF to clear the address
+static void SetMemHook(LuaMemHookType hookType, unsigned int addr, int ref)
+{
+	LuaMemHooks *hooks = luaCur->hooks;
+	uint32 &word = hooks->bits[hookType][addr >> 5];
+	uint32 bit = 1u << (addr & 31);
+
+	if (word & bit)
 	{
-		std::vector <unsigned int> temp;
-		Calculate(temp);
+		ReleaseMemHookRef(hooks->func[hookType][addr]);
+		hooks->count[hookType]--;
+		numMemHooksOfType[hookType]--;
+		word &= ~bit;
 	}
-
-	__forceinline int NotEmpty()
+	if (ref != LUA_NOREF)
 	{
-		return broad.islands.size();
+		hooks->func[hookType][addr] = ref;
+		hooks->refCount[ref]++;
+		hooks->count[hookType]++;
+		numMemHooksOfType[hookType]++;
+		word |= bit;
 	}
+	MergeMemHookWord(hookType, addr >> 5);
+}
+
+// Forgets every hook of the current script, the references go with its Lua state
+static void ClearMemHooks(void)
+{
+	LuaMemHooks *hooks = luaCur->hooks;
 
-	// note: it is illegal to call this if NotEmpty() returns 0
-	__forceinline bool Contains(unsigned int address, int size)
+	memset(hooks->bits, 0, sizeof(hooks->bits));
+	hooks->refCount.clear();
+
+	for (int i = 0; i < LUAMEMHOOK_COUNT; i++)
 	{
-		return broad.islands[0].Contains(address,size) &&
-		       mid.Contains(address,size) &&
-			   narrow.Contains(address,size);
-	}
-};
-TieredRegion hookedRegions [LUAMEMHOOK_COUNT];
+		numMemHooksOfType[i] -= hooks->count[i];
+		hooks->count[i] = 0;
 
+		for (unsigned int w = 0; w < (MEMHOOK_ADDRESSES >> 5); w++)
+			MergeMemHookWord(i, w);
+	}
+}
 
-static void CalculateMemHookRegions(LuaMemHookType hookType)
+static void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, unsigned int value, int ref)
 {
-	std::vector<unsigned int> hookedBytes;
-//	std::map<int, LuaContextInfo*>::iterator iter = luaContextInfo.begin();
-//	std::map<int, LuaContextInfo*>::iterator end = luaContextInfo.end();
-//	while(iter != end)
-//	{
-//		LuaContextInfo& info = *iter->second;
-		if(/*info.*/ numMemHooks)
+	FCEU_StageScope stage(FCEU_STAGE_LUA);
+	FCEU_CountAdd(FCEU_COUNTER_LUA_HOOKS, 1);
+
+	if (LuaOverBudget())
+	{
+		luaBudgetSkips++;
+		return;
+	}
+	if( (L != nullptr) && (luaCallbackErrorCounter == 0) )
+	{
+#ifdef USE_INFO_STACK
+		infoStack.insert(infoStack.begin(), &info);
+		struct Scope { ~Scope(){ infoStack.erase(infoStack.begin()); } } scope;
+#endif
+		LuaUsageScope usageScope;
+		luaUsageHookCalls++;
+
+		lua_settop(L, 0);
+		lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+
+		bool wasRunning = (luaRunning!=0) /*info.running*/;
+		luaRunning /*info.running*/ = true;
+		memHookDepth++;
+		//RefreshScriptSpeedStatus();
+		lua_pushinteger(L, address);
+		lua_pushinteger(L, size);
+		lua_pushinteger(L, value);
+		int errorcode = lua_pcall(L, 3, 0, 0);
+		memHookDepth--;
+		luaRunning /*info.running*/ = wasRunning;
+		//RefreshScriptSpeedStatus();
+		if (errorcode)
 		{
-//			lua_State* L = info.L;
-			if(L)
-			{
-				lua_settop(L, 0);
-				lua_getfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[hookType]);
-				lua_pushnil(L);
-				while(lua_next(L, -2))
-				{
-					if(lua_isfunction(L, -1))
-					{
-						unsigned int addr = lua_tointeger(L, -2);
-						hookedBytes.push_back(addr);
-					}
-					lua_pop(L, 1);
-				}
-				lua_settop(L, 0);
-			}
+			// Defer Lua destruction until x6502 memory hooks can fully return.
+			HandleCallbackError(L, false);
 		}
-//		++iter;
-//	}
-	hookedRegions[hookType].Calculate(hookedBytes);
+		if (L)
+			lua_settop(L, 0);
+	}
 }
-
-static void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, unsigned int value, LuaMemHookType hookType)
+// Each script that hooked a byte of the access gets it, at its first hooked byte
+static void CallScriptMemHooks(unsigned int address, int size, unsigned int value, LuaMemHookType hookType)
 {
-//	std::map<int, LuaContextInfo*>::iterator iter = luaContextInfo.begin();
-//	std::map<int, LuaContextInfo*>::iterator end = luaContextInfo.end();
-//	while(iter != end)
-//	{
-//		LuaContextInfo& info = *iter->second;
-		if(/*info.*/ numMemHooks)
+	for (size_t n = 0; n < luaScripts.size(); n++)
+	{
+		LuaScript *s = luaScripts[n];
+		const uint32 *bits = s->hooks->bits[hookType];
+
+		for (unsigned int i = address; i != address+size; i++)
 		{
-//			lua_State* L = info.L;
-			if( (L != nullptr) && (luaCallbackErrorCounter == 0) )
+			if ((i < MEMHOOK_ADDRESSES) && (bits[i >> 5] & (1u << (i & 31))))
 			{
-#ifdef USE_INFO_STACK
-				infoStack.insert(infoStack.begin(), &info);
-				struct Scope { ~Scope(){ infoStack.erase(infoStack.begin()); } } scope;
-#endif
-				lua_settop(L, 0);
-				lua_getfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[hookType]);
-				for(unsigned int i = address; i != address+size; i++)
-				{
-					lua_rawgeti(L, -1, i);
-					if (lua_isfunction(L, -1))
-					{
-						bool wasRunning = (luaRunning!=0) /*info.running*/;
-						luaRunning /*info.running*/ = true;
-						//RefreshScriptSpeedStatus();
-						lua_pushinteger(L, address);
-						lua_pushinteger(L, size);
-						lua_pushinteger(L, value);
-						int errorcode = lua_pcall(L, 3, 0, 0);
-						luaRunning /*info.running*/ = wasRunning;
-						//RefreshScriptSpeedStatus();
-						if (errorcode)
-						{
-							// Defer Lua destruction until x6502 memory hooks can fully return.
-							HandleCallbackError(L, false);
-							//int uid = iter->first;
-							//HandleCallbackError(L,info,uid,true);
-						}
-						break;
-					}
-					else
-					{
-						lua_pop(L,1);
-					}
-				}
-				lua_settop(L, 0);
+				LuaScriptScope scope(s);
+				CallRegisteredLuaMemHook_LuaMatch(address, size, value, s->hooks->func[hookType][i]);
+				break;
 			}
 		}
-//		++iter;
-//	}
+		// the script may have stopped in its hook, the next one is in its slot then
+		if (n >= luaScripts.size() || luaScripts[n] != s)
+			n--;
+	}
 }
+
 void CallRegisteredLuaMemHook(unsigned int address, int size, unsigned int value, LuaMemHookType hookType)
 {
-	// performance critical! (called VERY frequently)
-	// I suggest timing a large number of calls to this function in Release if you change anything in here,
-	// before and after, because even the most innocent change can make it become 30% to 400% slower.
-	// a good amount to test is: 100000000 calls with no hook set, and another 100000000 with a hook set.
-	// (on my system that consistently took 200 ms total in the former case and 350 ms total in the latter case)
-	if(hookedRegions[hookType].NotEmpty())
+	// performance critical! (called on every access of the hooked type)
+	// an address nobody hooked costs one bit test, keep any Lua call out of that path.
+	const uint32 *bits = memHookBits[hookType];
+
+	for(unsigned int i = address; i != address+size; i++)
 	{
-		//if((hookType <= LUAMEMHOOK_EXEC) && (address >= 0xE00000))
-		//	address |= 0xFF0000; // account for mirroring of RAM
-		if(hookedRegions[hookType].Contains(address, size))
-			CallRegisteredLuaMemHook_LuaMatch(address, size, value, hookType); // something has hooked this specific address
+		if ((i < MEMHOOK_ADDRESSES) && (bits[i >> 5] & (1u << (i & 31))))
+		{
+			CallScriptMemHooks(address, size, value, hookType);
+			return;
+		}
 	}
 }
 
-void CallRegisteredLuaFunctions(LuaCallID calltype)
+static void CallScriptFunction(LuaCallID calltype)
 {
-	assert((unsigned int)calltype < (unsigned int)LUACALL_COUNT);
 	const char* idstring = luaCallIDStrings[calltype];
 
 	if (!L)
 		return;
 
+	// the once a frame callbacks are the ones a budget holds back
+	if (((calltype == LUACALL_BEFOREEMULATION) || (calltype == LUACALL_AFTEREMULATION)) && LuaOverBudget())
+	{
+		luaBudgetSkips++;
+		return;
+	}
+
+	FCEU_CountAdd(FCEU_COUNTER_LUA_HOOKS, 1);
+	LuaUsageScope usageScope;
+
 	lua_settop(L, 0);
 	lua_getfield(L, LUA_REGISTRYINDEX, idstring);
 
@@ -2349,6 +3034,18 @@ void CallRegisteredLuaFunctions(LuaCallID calltype)
 	}
 }
 
+void CallRegisteredLuaFunctions(LuaCallID calltype)
+{
+	assert((unsigned int)calltype < (unsigned int)LUACALL_COUNT);
+
+	if (luaScripts.empty())
+		return;
+
+	FCEU_StageScope stage(FCEU_STAGE_LUA);
+
+	LuaForEachScript([calltype]() { CallScriptFunction(calltype); });
+}
+
 void ForceExecuteLuaFrameFunctions()
 {
 	FCEU_LuaFrameBoundary();
@@ -2366,35 +3063,35 @@ void TaseditorManualFunction()
 	CallRegisteredLuaFunctions(LUACALL_TASEDITOR_MANUAL);
 }
 
+// Whether a running script has a LUACALL_TASEDITOR_MANUAL function
+static bool LuaScriptsHaveManualFunction()
+{
+	LuaScriptSync();
+	for (size_t n = 0; n < luaScripts.size(); n++)
+	{
+		lua_State *S = luaScripts[n]->L;
+
+		if (!S)
+			continue;
+		lua_getfield(S, LUA_REGISTRYINDEX, luaCallIDStrings[LUACALL_TASEDITOR_MANUAL]);
+		bool found = lua_isfunction(S, -1);
+		lua_pop(S, 1);
+		if (found)
+			return true;
+	}
+	return false;
+}
+
 #ifdef __WIN_DRIVER__
 void TaseditorDisableManualFunctionIfNeeded()
 {
-	if (L)
-	{
-		// check if LUACALL_TASEDITOR_MANUAL function is not nil
-		lua_getfield(L, LUA_REGISTRYINDEX, luaCallIDStrings[LUACALL_TASEDITOR_MANUAL]);
-		if (!lua_isfunction(L, -1))
-			taseditor_lua.disableRunFunction();
-		lua_pop(L, 1);
-	} else taseditor_lua.disableRunFunction();
+	if (!LuaScriptsHaveManualFunction())
+		taseditor_lua.disableRunFunction();
 }
 #elif __QT_DRIVER__
 void TaseditorDisableManualFunctionIfNeeded()
 {
-	if (L)
-	{
-		// check if LUACALL_TASEDITOR_MANUAL function is not nil
-		lua_getfield(L, LUA_REGISTRYINDEX, luaCallIDStrings[LUACALL_TASEDITOR_MANUAL]);
-		if (!lua_isfunction(L, -1))
-		{
-			if (taseditor_lua != nullptr)
-			{
-				taseditor_lua->disableRunFunction();
-			}
-		}
-		lua_pop(L, 1);
-	}
-	else
+	if (!LuaScriptsHaveManualFunction())
 	{
 		if (taseditor_lua != nullptr)
 		{
@@ -2431,33 +3128,26 @@ static int memory_registerHook(lua_State* L, LuaMemHookType hookType, int defaul
 		luaL_checktype(L, funcIdx, LUA_TFUNCTION);
 	lua_settop(L,funcIdx);
 
-	// get the address-to-callback table for this hook type of the current script
-	lua_getfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[hookType]);
-
-	// count how many callback functions we'll be displacing
-	int numFuncsAfter = clearing ? 0 : size;
-	int numFuncsBefore = 0;
-	for(unsigned int i = addr; i != addr+size; i++)
+	// one registry reference for the function, shared by all its addresses
+	int ref = LUA_NOREF;
+	if(!clearing)
 	{
-		lua_rawgeti(L, -1, i);
-		if(lua_isfunction(L, -1))
-			numFuncsBefore++;
-		lua_pop(L,1);
+		lua_pushvalue(L, funcIdx);
+		ref = luaL_ref(L, LUA_REGISTRYINDEX);
 	}
 
-	// put the callback function in the address slots
+	// put the callback function in the address slots, the CPU only has 16 bit addresses
 	for(unsigned int i = addr; i != addr+size; i++)
 	{
-		lua_pushvalue(L, -2);
-		lua_rawseti(L, -2, i);
+		if(i < MEMHOOK_ADDRESSES)
+			SetMemHook(hookType, i, ref);
 	}
 
-	// adjust the count of active hooks
-	//LuaContextInfo& info = GetCurrentInfo();
-	/*info.*/ numMemHooks += numFuncsAfter - numFuncsBefore;
+	// none of the addresses took it
+	if((ref != LUA_NOREF) && (luaCur->hooks->refCount.find(ref) == luaCur->hooks->refCount.end()))
+		luaL_unref(L, LUA_REGISTRYINDEX, ref);
 
-	// re-cache regions of hooked memory across all scripts
-	CalculateMemHookRegions(hookType);
+	UpdateMemHookInstall(true);
 
 	//StopScriptIfFinished(luaStateToUIDMap[L]);
 	return 0;
@@ -3083,9 +3773,6 @@ static int savestate_create_aliased(lua_State *L, bool newnumbering) {
 		}
 		else
 		{
-			char* tmp = tempnam(NULL, "snlua");
-			ss->filename = tmp;
-			free(tmp);
 			ss->anonymous = true;
 		}
 
@@ -3156,14 +3843,37 @@ static int savestate_save(lua_State *L) {
 		return 0;
 	}
 
-	if(ss->data) delete ss->data;
-	ss->data = new EMUFILE_MEMORY();
-
-//	printf("saving %s\n", filename);
-
 	// Save states are very expensive. They take time.
 	numTries--;
 
+	if (ss->anonymous && FCEUMOV_Mode(MOVIEMODE_INACTIVE) && !luaNetPlayActive())
+	{
+		size_t size = FCEUSS_SnapshotSize();
+
+		if (ss->data)
+		{
+			delete ss->data;
+			ss->data = 0;
+		}
+		if (!ss->snapshot || ss->snapshotSize != size)
+		{
+			ss->releaseSnapshot();
+			ss->snapshot = luaSnapshotAlloc(size + LUA_SNAPSHOT_BACKBUF);
+			ss->snapshotSize = size;
+		}
+		FCEUSS_Snapshot(ss->snapshot, size);
+		memcpy(ss->snapshot + size, XBackBuf, LUA_SNAPSHOT_BACKBUF);
+		return 0;
+	}
+	ss->releaseSnapshot();
+
+	// saving again writes over the buffer the last save grew
+	if(!ss->data) ss->data = new EMUFILE_MEMORY();
+	ss->data->set_len(0);
+	ss->data->unfail();
+
+//	printf("saving %s\n", filename);
+
 	FCEUSS_SaveMS(ss->data,Z_NO_COMPRESSION);
 	ss->data->fseek(0,SEEK_SET);
 	return 0;
@@ -3192,6 +3902,17 @@ static int savestate_load(lua_State *L) {
 
 	numTries--;
 
+	if (ss->snapshot)
+	{
+		// made for another game when the size is off, ignored as a bad state would be
+		if (FCEUSS_Restore(ss->snapshot, ss->snapshotSize))
+		{
+			memcpy(XBackBuf, ss->snapshot + ss->snapshotSize, LUA_SNAPSHOT_BACKBUF);
+			FCEUSS_NotifyLoad(true);
+		}
+		return 0;
+	}
+
 	/*if (!ss->data) {
 		luaL_error(L, "Invalid savestate.load data");
 		return 0;
@@ -3199,8 +3920,36 @@ static int savestate_load(lua_State *L) {
 	if (FCEUSS_LoadFP(ss->data,SSLOADPARAM_NOBACKUP))
 		ss->data->fseek(0,SEEK_SET);
 
-	return 0;
+	return 0;
+
+}
+
+// string savestate.hash(object state)
+//
+//   Hash of the state's contents, for telling apart the states a search
+//   reached. nil for a state never saved.
+static int savestate_hash(lua_State *L) {
+
+	LuaSaveState *ss = (LuaSaveState *)lua_touserdata(L, 1);
+	uint64 hash;
+	char str[24];
 
+	if (!ss) {
+		luaL_error(L, "Invalid savestate.hash object");
+		return 0;
+	}
+	if (ss->snapshot)
+		hash = FCEU_XXH64(ss->snapshot, ss->snapshotSize, 0);
+	else if (ss->data)
+		hash = FCEU_XXH64(ss->data->buf(), ss->data->size(), 0);
+	else
+	{
+		lua_pushnil(L);
+		return 1;
+	}
+	snprintf(str, sizeof(str), "%016llX", (unsigned long long)hash);
+	lua_pushstring(L, str);
+	return 1;
 }
 
 static int savestate_registersave(lua_State *L) {
@@ -3243,7 +3992,7 @@ static int savestate_loadscriptdata(lua_State *L) {
 			fclose(luaSaveFile);
 
 			lua_settop(L, 0);
-			saveData.LoadRecord(L, LUA_DATARECORDKEY, (unsigned int)-1);
+			saveData.LoadRecord(L, luaCur->recordKey, (unsigned int)-1);
 			return lua_gettop(L);
 		}
 	}
@@ -3532,15 +4281,25 @@ static int movie_isfromsavestate (lua_State *L) {
 #define LUA_SCREEN_WIDTH    256
 #define LUA_SCREEN_HEIGHT   240
 
-// Common code by the gui library: make sure the screen array is ready
-static void gui_prepare() {
+// Starts the frame's drawing if this is its first
+static void gui_begin() {
 	if (!gui_data)
 		gui_data = (uint8*) FCEU_dmalloc(LUA_SCREEN_WIDTH*LUA_SCREEN_HEIGHT*4);
 	if (gui_used != GUI_USED_SINCE_LAST_DISPLAY)
+	{
 		memset(gui_data, 0, LUA_SCREEN_WIDTH*LUA_SCREEN_HEIGHT*4);
+		gui_commands.clear();
+		gui_layer_used = false;
+	}
 	gui_used = GUI_USED_SINCE_LAST_DISPLAY;
 }
 
+// Common code by the gui library: make sure the screen array is ready
+static void gui_prepare() {
+	gui_begin();
+	gui_layer_used = true;
+}
+
 // pixform for lua graphics
 #define BUILD_PIXEL_ARGB8888(A,R,G,B) (((int) (A) << 24) | ((int) (R) << 16) | ((int) (G) << 8) | (int) (B))
 #define DECOMPOSE_PIXEL_ARGB8888(PIX,A,R,G,B) { (A) = ((PIX) >> 24) & 0xff; (R) = ((PIX) >> 16) & 0xff; (G) = ((PIX) >> 8) & 0xff; (B) = (PIX) & 0xff; }
@@ -3719,7 +4478,20 @@ static void gui_fillbox_internal(int x1, int y1, int x2, int y2, uint32 colour)
 		y2 = LUA_SCREEN_HEIGHT - 1;
 
 	//gui_prepare();
+	if (LUA_PIXEL_A(colour) == 0 || x1 > x2 || y1 > y2)
+		return;
+
 	int ix, iy;
+	if (LUA_PIXEL_A(colour) == 255)
+	{
+		// opaque, a plain fill of each row
+		for (iy = y1; iy <= y2; iy++)
+		{
+			uint32 *row = (uint32*) &gui_data[(iy*LUA_SCREEN_WIDTH+x1)*4];
+			std::fill(row, row + (x2 - x1 + 1), colour);
+		}
+		return;
+	}
 	for (iy = y1; iy <= y2; iy++)
 	{
 		for (ix = x1; ix <= x2; ix++)
@@ -3729,6 +4501,76 @@ static void gui_fillbox_internal(int x1, int y1, int x2, int y2, uint32 colour)
 	}
 }
 
+// Whether n more commands can be kept for the video driver, rather than
+// drawn into gui_data
+static bool gui_can_record(size_t n)
+{
+	if (!gui_overlay)
+		return false;
+
+	gui_begin();
+
+	return !gui_layer_used && gui_commands.size() + n <= GUI_MAX_COMMANDS;
+}
+
+// Keeps a filled rect (corners inclusive) or a line, after gui_can_record
+static void gui_record(int x1, int y1, int x2, int y2, uint32 colour, bool line)
+{
+	if (LUA_PIXEL_A(colour) == 0)
+		return;
+
+	if (!line)
+	{
+		if (x1 > x2)
+			std::swap(x1, x2);
+		if (y1 > y2)
+			std::swap(y1, y2);
+		if (x2 < 0 || y2 < 0 || x1 >= LUA_SCREEN_WIDTH || y1 >= LUA_SCREEN_HEIGHT)
+			return;
+		x1 = std::max(x1, 0);
+		y1 = std::max(y1, 0);
+		x2 = std::min(x2, LUA_SCREEN_WIDTH - 1);
+		y2 = std::min(y2, LUA_SCREEN_HEIGHT - 1);
+	}
+
+	LuaGuiCommand cmd;
+	cmd.x1 = x1; cmd.y1 = y1;
+	cmd.x2 = x2; cmd.y2 = y2;
+	cmd.colour = colour;
+	cmd.line = line;
+	gui_commands.push_back(cmd);
+}
+
+// Draws the kept commands into gui_data, under what is there already
+static void gui_flatten()
+{
+	if (gui_commands.empty())
+		return;
+
+	std::vector<uint32> above;
+	if (gui_layer_used)
+	{
+		above.assign((uint32*) gui_data, (uint32*) gui_data + LUA_SCREEN_WIDTH*LUA_SCREEN_HEIGHT);
+		memset(gui_data, 0, LUA_SCREEN_WIDTH*LUA_SCREEN_HEIGHT*4);
+	}
+
+	for (size_t i = 0; i < gui_commands.size(); i++)
+	{
+		const LuaGuiCommand &cmd = gui_commands[i];
+		if (cmd.line)
+			gui_drawline_internal(cmd.x1, cmd.y1, cmd.x2, cmd.y2, true, cmd.colour);
+		else
+			gui_fillbox_internal(cmd.x1, cmd.y1, cmd.x2, cmd.y2, cmd.colour);
+	}
+	gui_commands.clear();
+
+	for (size_t i = 0; i < above.size(); i++)
+	{
+		blend32((uint32*) &gui_data[i*4], above[i]);
+	}
+	gui_layer_used = true;
+}
+
 enum
 {
 	GUI_COLOUR_CLEAR
@@ -3963,6 +4805,12 @@ static int gui_pixel(lua_State *L) {
 //	if (!gui_check_boundary(x, y))
 //		luaL_error(L,"bad coordinates");
 
+	if (gui_can_record(1))
+	{
+		gui_record(x, y, x, y, colour, false);
+		return 0;
+	}
+
 	gui_prepare();
 
 	gui_drawpixel_internal(x, y, colour);
@@ -3983,6 +4831,9 @@ static int gui_getpixel(lua_State *L) {
 	if (!gui_check_boundary(x, y))
 		luaL_error(L,"bad coordinates. Use 0-%d x 0-%d", LUA_SCREEN_WIDTH - 1, LUA_SCREEN_HEIGHT - 1);
 
+	// the kept commands are part of the picture too
+	gui_flatten();
+
 	if (!gui_data) {
 		// Return all 0s, including for alpha.
 		// If alpha == 0, there was no color data for that spot
@@ -4051,6 +4902,39 @@ static int emu_getscreenpixel(lua_State *L) {
 
 }
 
+// exact, perceptual = emu.framehash()
+//
+// 64-bit hashes of the emulator screen as hex strings, see framehash.h.
+// Returns nil when no game is loaded.
+static int emu_framehash(lua_State *L) {
+
+	uint64 exact, perceptual;
+	char str[24];
+
+	if (!FCEUI_GetFrameHash(&exact, &perceptual)) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	sprintf(str, "%016llx", (unsigned long long)exact);
+	lua_pushstring(L, str);
+	sprintf(str, "%016llx", (unsigned long long)perceptual);
+	lua_pushstring(L, str);
+	return 2;
+}
+
+// int emu.framehashdistance(hash1, hash2)
+//
+// Number of bits that differ between two perceptual hashes from emu.framehash().
+static int emu_framehashdistance(lua_State *L) {
+
+	uint64 a = strtoull(luaL_checkstring(L,1), NULL, 16);
+	uint64 b = strtoull(luaL_checkstring(L,2), NULL, 16);
+
+	lua_pushinteger(L, FCEUI_FrameHashDistance(a, b));
+	return 1;
+}
+
 // gui.line(x1,y1,x2,y2,color,skipFirst)
 static int gui_line(lua_State *L) {
 
@@ -4063,6 +4947,16 @@ static int gui_line(lua_State *L) {
 	color = gui_optcolour(L,5,LUA_BUILD_PIXEL(255, 255, 255, 255));
 	int skipFirst = lua_toboolean(L,6);
 
+	// far off lines are left to gui_drawline_internal, which clips them
+	bool nearby = std::min(std::min(x1, x2), std::min(y1, y2)) >= -4096 &&
+	              std::max(std::max(x1, x2), std::max(y1, y2)) <= 4096;
+
+	if (!skipFirst && nearby && gui_can_record(1))
+	{
+		gui_record(x2, y2, x1, y1, color, x1 != x2 && y1 != y2);
+		return 0;
+	}
+
 	gui_prepare();
 
 	gui_drawline_internal(x2, y2, x1, y1, !skipFirst, color);
@@ -4089,6 +4983,23 @@ static int gui_box(lua_State *L) {
 	if (y1 > y2)
 		std::swap(y1, y2);
 
+	if (gui_can_record(5))
+	{
+		// the outline's sides, then the inside
+		gui_record(x1, y1, x2, y1, outlinecolor, false);
+		if (y2 > y1)
+			gui_record(x1, y2, x2, y2, outlinecolor, false);
+		if ((y2 - y1) >= 2)
+		{
+			gui_record(x1, y1+1, x1, y2-1, outlinecolor, false);
+			if (x2 > x1)
+				gui_record(x2, y1+1, x2, y2-1, outlinecolor, false);
+		}
+		if ((x2 - x1) >= 2 && (y2 - y1) >= 2)
+			gui_record(x1+1, y1+1, x2-1, y2-1, fillcolor, false);
+		return 0;
+	}
+
 	gui_prepare();
 
 	gui_drawbox_internal(x1, y1, x2, y2, outlinecolor);
@@ -5540,6 +6451,86 @@ static int taseditor_clearinputchanges(lua_State *L)
 	return 0;
 }
 
+// table taseditor.evaluatebranches(int frame, table addresses)
+// replays every Branch to the frame and returns {[branch] = {values}} with one byte per address, Branches that can't reach the frame are left out
+static int taseditor_evaluatebranches(lua_State *L)
+{
+	int frame = luaL_checkinteger(L, 1);
+	std::vector<int> addresses;
+	luaL_checktype(L, 2, LUA_TTABLE);
+	int max_index = luaL_getn(L, 2);
+	for (int i = 1; i <= max_index; i++)
+	{
+		lua_rawgeti(L, 2, i);
+		addresses.push_back(lua_tointeger(L, -1));
+		lua_pop(L, 1);
+	}
+	std::vector<int> branches;
+	std::vector<std::vector<uint8>> values;
+#ifdef __QT_DRIVER__
+	if (taseditor_lua != nullptr)
+	{
+		taseditor_lua->evaluatebranches(frame, addresses, branches, values);
+	}
+#endif
+	lua_newtable(L);
+	for (size_t i = 0; i < branches.size(); ++i)
+	{
+		lua_createtable(L, values[i].size(), 0);
+		for (size_t j = 0; j < values[i].size(); ++j)
+		{
+			lua_pushinteger(L, values[i][j]);
+			lua_rawseti(L, -2, j + 1);
+		}
+		lua_rawseti(L, -2, branches[i]);
+	}
+	return 1;
+}
+
+// int taseditor.setinputrange(int frame, table input [, string name])
+// input is indexed by joypad (0 = commands, 1-4 = players), each entry is a table of numbers or a string of bytes
+static int taseditor_setinputrange(lua_State *L)
+{
+	int frame = luaL_checkinteger(L, 1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	const char* name = lua_isnil(L, 3) ? NULL : lua_tostring(L, 3);
+	std::vector<int> joypads;
+	std::vector<std::vector<uint8>> columns;
+	for (int joy = 0; joy <= 4; joy++)
+	{
+		lua_rawgeti(L, 2, joy);
+		if (lua_type(L, -1) == LUA_TSTRING)
+		{
+			size_t len;
+			const uint8* data = (const uint8*)lua_tolstring(L, -1, &len);
+			joypads.push_back(joy);
+			columns.push_back(std::vector<uint8>(data, data + len));
+		}
+		else if (lua_istable(L, -1))
+		{
+			int max_index = luaL_getn(L, -1);
+			joypads.push_back(joy);
+			columns.push_back(std::vector<uint8>(max_index));
+			for (int i = 1; i <= max_index; i++)
+			{
+				lua_rawgeti(L, -1, i);
+				columns.back()[i - 1] = lua_tointeger(L, -1);
+				lua_pop(L, 1);
+			}
+		}
+		lua_pop(L, 1);
+	}
+#ifdef __QT_DRIVER__
+	if (taseditor_lua != nullptr)
+	{
+		lua_pushinteger(L, taseditor_lua->setinputrange(frame, joypads, columns, name ? name : ""));
+		return 1;
+	}
+#endif
+	lua_pushinteger(L, -1);
+	return 1;
+}
+
 // CDLog functions library
 
 static int cdl_loadcdlog(lua_State *L)
@@ -6222,6 +7213,9 @@ static const struct luaL_reg emulib [] = {
 	{"softreset", emu_softreset},
 	{"speedmode", emu_speedmode},
 	{"frameadvance", emu_frameadvance},
+	{"loopframes", emu_loopframes},
+	{"advancetoinputpoll", emu_advancetoinputpoll},
+	{"searchinput", emu_searchinput},
 	{"paused", emu_paused},
 	{"pause", emu_pause},
 	{"unpause", emu_unpause},
@@ -6240,6 +7234,8 @@ static const struct luaL_reg emulib [] = {
 	{"addgamegenie", emu_addgamegenie},
 	{"delgamegenie", emu_delgamegenie},
 	{"getscreenpixel", emu_getscreenpixel},
+	{"framehash", emu_framehash},
+	{"framehashdistance", emu_framehashdistance},
 	{"readonly", movie_getreadonly},
 	{"setreadonly", movie_setreadonly},
 	{"getdir", emu_getdir},
@@ -6266,6 +7262,7 @@ static const struct luaL_reg memorylib [] = {
 
 	{"readbyte", memory_readbyte},
 	{"readbyterange", memory_readbyterange},
+	{"newbuffer", memory_newbuffer},
 	{"readbytesigned", memory_readbytesigned},
 	{"readbyteunsigned", memory_readbyte},	// alternate naming scheme for unsigned
 	{"readword", memory_readword},
@@ -6275,6 +7272,9 @@ static const struct luaL_reg memorylib [] = {
 	{"legacywritebyte", legacymemory_writebyte},
 	{"getregister", memory_getregister},
 	{"setregister", memory_setregister},
+#ifdef __FCEU_LUAJIT__
+	{"ffiview", memory_ffiview},
+#endif
 
 	// memory hooks
 	{"registerwrite", memory_registerwrite},
@@ -6333,6 +7333,7 @@ static const struct luaL_reg savestatelib[] = {
 	{"save", savestate_save},
 	{"persist", savestate_persist},
 	{"load", savestate_load},
+	{"hash", savestate_hash},
 
 	{"registersave", savestate_registersave},
 	{"registerload", savestate_registerload},
@@ -6452,6 +7453,8 @@ static const struct luaL_reg taseditorlib[] = {
 	{"submitdeleteframes", taseditor_submitdeleteframes},
 	{"applyinputchanges", taseditor_applyinputchanges},
 	{"clearinputchanges", taseditor_clearinputchanges},
+	{"setinputrange", taseditor_setinputrange},
+	{"evaluatebranches", taseditor_evaluatebranches},
 	{NULL,NULL}
 };
 
@@ -6490,18 +7493,19 @@ void CallExitFunction()
 		HandleCallbackError(L, true);
 }
 
-void FCEU_LuaFrameBoundary()
+// Resumes the current script's main thread up to its next frame advance
+static void LuaScriptFrameBoundary()
 {
-	//printf("Lua Frame\n");
-
 	// HA!
 	if (L == nullptr)
 	{
 		return;
 	}
+	LuaUsageEndFrame();
+
 	if (luaCallbackErrorCounter > 0)
 	{
-		FCEU_LuaStop();
+		LuaStopScript(luaCur);
 		return;
 	}
 	if (!luaRunning)
@@ -6509,17 +7513,39 @@ void FCEU_LuaFrameBoundary()
 		return;
 	}
 
+	// emu.advancetoinputpoll() sleeps on through the lag frames
+	if (luaInputPollWaiting && FCEUI_GetLagged())
+	{
+		luaInputPollSkipped++;
+		if (--luaInputPollFrames > 0)
+		{
+			return;
+		}
+	}
+
 	// Our function needs calling
 	lua_settop(L,0);
 	lua_getfield(L, LUA_REGISTRYINDEX, frameAdvanceThread);
 	lua_State *thread = lua_tothread(L,1);
 
+	int resumeArgs = 0;
+	if (luaInputPollWaiting)
+	{
+		lua_pushinteger(thread, luaInputPollSkipped);
+		resumeArgs = 1;
+		luaInputPollWaiting = false;
+	}
+
 	// Lua calling C must know that we're busy inside a frame boundary
 	frameBoundary = TRUE;
 	frameAdvanceWaiting = FALSE;
 
 	numTries = 1000;
-	int result = lua_resume(thread, 0);
+	int result;
+	{
+		LuaUsageScope usageScope;
+		result = lua_resume(thread, resumeArgs);
+	}
 
 	if (result == LUA_YIELD) {
 		// Okay, we're fine with that.
@@ -6557,6 +7583,16 @@ void FCEU_LuaFrameBoundary()
 	if (!frameAdvanceWaiting) {
 		FCEU_LuaOnStop();
 	}
+}
+
+void FCEU_LuaFrameBoundary()
+{
+	//printf("Lua Frame\n");
+
+	// hook types the scripts stopped using during the frame
+	UpdateMemHookInstall(true);
+
+	LuaForEachScript(LuaScriptFrameBoundary);
 
 #ifndef __WIN_DRIVER__
 	if (exitScheduled)
@@ -6572,21 +7608,50 @@ void FCEU_LuaFrameBoundary()
 }
 
 
+// Takes a stopped script off the dispatcher
+static void LuaRemoveScript(LuaScript *s)
+{
+	luaScripts.erase(std::find(luaScripts.begin(), luaScripts.end(), s));
+
+	if (luaCur == s)
+	{
+		luaCur = NULL;
+		L = NULL;
+		luaRunning = FALSE;
+		frameAdvanceWaiting = FALSE;
+		luaLoopFrames = 0;
+		luaInputPollWaiting = false;
+		luaCallbackErrorCounter = 0;
+		luaUsageTicks = 0;
+		luaUsageDepth = 0;
+		luaBudgetTicks = 0;
+		luaBudgetSkips = 0;
+		info_print = NULL;
+		info_onstart = NULL;
+		info_onstop = NULL;
+	}
+	delete s->hooks;
+	delete s;
+
+	if (luaScripts.empty())
+		luaSnapshotPoolClear();
+}
+
 /**
- * Loads and runs the given Lua script.
- * The emulator MUST be paused for this function to be
- * called. Otherwise, all frame boundary assumptions go out the window.
+ * Starts a script next to the ones running. The primary one is the script
+ * FCEU_LoadLuaCode runs, it takes the place of every other and its
+ * registersave data keeps the savestate record key of a single script.
  *
- * Returns true on success, false on failure.
+ * Returns the script's id, 0 on failure.
  */
-int FCEU_LoadLuaCode(const char *filename, const char *arg) 
+static int LuaStartScript(const char *filename, const char *arg, bool primary)
 {
 	if (!DemandLua())
 	{
 		return 0;
 	}
 
-	if (filename != luaScriptName)
+	if (primary && (filename != luaScriptName))
 	{
 		if (luaScriptName) free(luaScriptName);
 		luaScriptName = strdup(filename);
@@ -6602,7 +7667,19 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg)
 	}
 
 	//stop any lua we might already have had running
-	FCEU_LuaStop();
+	if (primary)
+		FCEU_LuaStop();
+
+	LuaScript *script = new LuaScript();
+	script->id = luaNextScriptId++;
+	script->name = filename;
+	script->recordKey = primary ? LUA_DATARECORDKEY : CalcCRC32(0, (uint8*)filename, strlen(filename));
+	script->hooks = new LuaMemHooks();
+	script->exitErrorCount = 8;
+	script->transparencyModifier = 255;
+	luaScripts.push_back(script);
+
+	LuaScriptScope scope(script);
 
 	//Reinit the error count
 	luaexiterrorcount = 8;
@@ -6631,6 +7708,9 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg)
 
 		luaL_register(L, "emu", emulib); // added for better cross-emulator compatibility
 		luaL_register(L, "FCEU", emulib); // kept for backward compatibility
+		// byte buffer metatable, the methods are looked up in it by __index
+		luaL_newmetatable(L, LUA_BYTEBUFFER);
+		luaL_register(L, NULL, bytebuffermeta);
 		luaL_register(L, "memory", memorylib);
 		luaL_register(L, "ppu", ppulib);
 		luaL_register(L, "rom", romlib);
@@ -6645,7 +7725,9 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg)
 		luaL_register(L, "debugger", debuggerlib);
 		luaL_register(L, "cdlog", cdloglib);
 		luaL_register(L, "taseditor", taseditorlib);
+#ifndef __FCEU_LUAJIT__
 		luaL_register(L, "bit", bit_funcs); // LuaBitOp library
+#endif // LuaJIT has it built in, and compiles its calls inline
 		lua_settop(L, 0);
 
 		// register a few utility functions outside of libraries (in the global namespace)
@@ -6675,16 +7757,12 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg)
 
 		luabitop_validate(L);
 
-		// push arrays for storing hook functions in
-		for(int i = 0; i < LUAMEMHOOK_COUNT; i++)
-		{
-			lua_newtable(L);
-			lua_setfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[i]);
-		}
-
-		X6502_MemHook::Add( X6502_MemHook::Read , luaReadMemHook , nullptr );
-		X6502_MemHook::Add( X6502_MemHook::Write, luaWriteMemHook, nullptr );
-		X6502_MemHook::Add( X6502_MemHook::Exec , luaExecMemHook , nullptr );
+#ifdef __FCEU_LUAJIT__
+		// the script still runs if the FFI is missing, without memory.view
+		if (luaL_dostring(L, luaFFIViewInit))
+			FCEU_printf("Lua: unable to set up memory.view: %s\n", lua_tostring(L, -1));
+		lua_settop(L, 0);
+#endif
 	}
 
 	// We make our thread NOW because we want it at the bottom of the stack.
@@ -6704,9 +7782,10 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg)
 		fprintf(stderr, "Failed to compile file: %s\n", lua_tostring(L,-1));
 #endif
 
-		// Wipe the stack. Our thread
-		if (L)
-			lua_settop(L,0);
+		// Our thread goes with the state
+		lua_close(L);
+		L = NULL;
+		LuaRemoveScript(script);
 		return 0; // Oh shit.
 	}
 #ifdef __WIN_DRIVER__
@@ -6723,7 +7802,12 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg)
 	// Initialize settings
 	luaRunning = TRUE;
 	skipRerecords = FALSE;
-	numMemHooks = 0;
+	luaLoopFrames = 0;
+	luaInputPollWaiting = false;
+	memset(&luaUsage, 0, sizeof(luaUsage));
+	luaUsageTicks = 0;
+	luaUsageHookCalls = 0;
+	ClearMemHooks(); // the CPU hooks are installed as the script registers memory hooks
 	transparencyModifier = 255; // opaque
 
 	//wasPaused = FCEUI_EmulationPaused();
@@ -6750,10 +7834,28 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg)
 		info_onstart(info_uid);
 
 	// And run it right now. :)
-	FCEU_LuaFrameBoundary();
+	UpdateMemHookInstall(true);
+	LuaScriptFrameBoundary();
 
 	// We're done.
-	return 1;
+	return script->id;
+}
+
+/**
+ * Loads and runs the given Lua script in place of the running ones.
+ * The emulator MUST be paused for this function to be
+ * called. Otherwise, all frame boundary assumptions go out the window.
+ *
+ * Returns true on success, false on failure.
+ */
+int FCEU_LoadLuaCode(const char *filename, const char *arg) 
+{
+	return LuaStartScript(filename, arg, true) ? 1 : 0;
+}
+
+int FCEU_LuaAddScript(const char *filename, const char *arg)
+{
+	return LuaStartScript(filename, arg, false);
 }
 
 /**
@@ -6786,23 +7888,20 @@ void FCEU_ReloadLuaCode()
 }
 
 
-/**
- * Terminates a running Lua script by killing the whole Lua engine.
- *
- * Always safe to call, except from within a lua call itself (duh).
- *
- */
-void FCEU_LuaStop() {
-
-	if (!CheckLua())
-		return;
+// Terminates a script by killing its Lua state
+static void LuaStopScript(LuaScript *s)
+{
+	LuaScriptScope scope(s);
 
 	//already killed
-	if (!L) return;
+	if (!L)
+	{
+		LuaRemoveScript(s);
+		return;
+	}
 
-	X6502_MemHook::Remove( X6502_MemHook::Read , luaReadMemHook , nullptr );
-	X6502_MemHook::Remove( X6502_MemHook::Write, luaWriteMemHook, nullptr );
-	X6502_MemHook::Remove( X6502_MemHook::Exec , luaExecMemHook , nullptr );
+	ClearMemHooks();
+	UpdateMemHookInstall(true);
 
 	// Since the script is exiting, we want to prevent an infinite loop.
 	// CallExitFunction() > HandleCallbackError() > FCEU_LuaStop() > CallExitFunction() ...
@@ -6817,9 +7916,9 @@ void FCEU_LuaStop() {
 	//already killed (after multiple errors)
 	if (!L) return;
 
-	/*info.*/numMemHooks = 0;
-	for(int i = 0; i < LUAMEMHOOK_COUNT; i++)
-		CalculateMemHookRegions((LuaMemHookType)i);
+	// anything the exit function registered
+	ClearMemHooks();
+	UpdateMemHookInstall(true);
 
 	//sometimes iup uninitializes com
 	//MBG TODO - test whether this is really necessary. i dont think it is
@@ -6836,6 +7935,60 @@ void FCEU_LuaStop() {
 	lua_close(L); // this invokes our garbage collectors for us
 	L = NULL;
 	FCEU_LuaOnStop();
+	LuaRemoveScript(s);
+}
+
+/**
+ * Terminates the running Lua scripts by killing their Lua engines.
+ *
+ * Always safe to call, except from within a lua call itself (duh).
+ *
+ */
+void FCEU_LuaStop() {
+
+	if (!CheckLua())
+		return;
+
+	while (!luaScripts.empty())
+		LuaStopScript(luaScripts.back());
+}
+
+void FCEU_LuaStopScript(int id)
+{
+	LuaScript *s = LuaFindScript(id);
+
+	if (s)
+		LuaStopScript(s);
+}
+
+void FCEU_LuaSetScriptBudget(int id, double us)
+{
+	LuaScript *s = LuaFindScript(id);
+
+	if (!s)
+		return;
+
+	LuaScriptScope scope(s);
+	luaBudgetTicks = (us > 0) ? (uint64)(us * (double)FCEUD_GetTimeFreq() / 1000000.0) : 0;
+	luaUsage.budgetUs = (us > 0) ? us : 0;
+}
+
+void FCEU_LuaGetScripts(std::vector<LuaScriptStatus> &scripts)
+{
+	scripts.clear();
+
+	LuaScriptSync();
+	for (size_t n = 0; n < luaScripts.size(); n++)
+	{
+		const LuaScript *s = luaScripts[n];
+		LuaScriptStatus status;
+
+		status.id = s->id;
+		status.name = s->name;
+		status.running = s->L && s->running;
+		status.usage = s->usage;
+		scripts.push_back(status);
+	}
 }
 
 /**
@@ -6844,7 +7997,7 @@ void FCEU_LuaStop() {
  */
 int FCEU_LuaRunning() {
 	// FIXME: return false when no callback functions are registered.
-	return (int) (L != NULL); // should return true if callback functions are active.
+	return (int) !luaScripts.empty(); // should return true if callback functions are active.
 }
 
 /**
@@ -6897,7 +8050,15 @@ uint8 FCEU_LuaReadJoypad(int which, uint8 joyl) {
  */
 bool FCEU_LuaRerecordCountSkip() {
 	// FIXME: return true if (there are any active callback functions && skipRerecords)
-	return L && luaRunning && skipRerecords;
+	LuaScriptSync();
+	for (size_t n = 0; n < luaScripts.size(); n++)
+	{
+		const LuaScript *s = luaScripts[n];
+
+		if (s->L && s->running && s->skipRerecords)
+			return true;
+	}
+	return false;
 }
 
 /**
@@ -6906,7 +8067,8 @@ bool FCEU_LuaRerecordCountSkip() {
  *
  * Currently we only support 256x* resolutions.
  */
-void FCEU_LuaGui(uint8 *XBuf)
+// Runs the current script's gui.register function
+static void LuaScriptGui()
 {
 	if (!L/* || !luaRunning*/)
 		return;
@@ -6935,6 +8097,15 @@ void FCEU_LuaGui(uint8 *XBuf)
 
 	// And wreak the stack
 	lua_settop(L, 0);
+}
+
+void FCEU_LuaGui(uint8 *XBuf)
+{
+	if (luaScripts.empty())
+		return;
+
+	// every script draws into the one gui
+	LuaForEachScript(LuaScriptGui);
 
 	if (gui_used == GUI_CLEAR)
 		return;
@@ -6942,12 +8113,20 @@ void FCEU_LuaGui(uint8 *XBuf)
 	if (gui_used == GUI_USED_SINCE_LAST_FRAME && !FCEUI_EmulationPaused())
 	{
 		memset(gui_data, 0, LUA_SCREEN_WIDTH*LUA_SCREEN_HEIGHT*4);
+		gui_commands.clear();
+		gui_layer_used = false;
 		gui_used = GUI_CLEAR;
 		return;
 	}
 
 	gui_used = GUI_USED_SINCE_LAST_FRAME;
 
+	// the video driver draws it, see FCEU_LuaGetGuiOverlay
+	if (gui_overlay)
+		return;
+
+	gui_flatten();
+
 	int x, y;
 
 	for (y = 0; y < LUA_SCREEN_HEIGHT; y++)
@@ -6988,9 +8167,33 @@ void FCEU_LuaGui(uint8 *XBuf)
 	return;
 }
 
+void FCEU_LuaSetGuiOverlay(bool enable)
+{
+	if (gui_overlay == enable)
+		return;
+
+	// what is left of the last frame is blended into XBuf from now on
+	if (!enable)
+		gui_flatten();
+
+	gui_overlay = enable;
+}
+
+bool FCEU_LuaGetGuiOverlay(const LuaGuiCommand **commands, int *count, const uint32 **layer)
+{
+	if (!gui_overlay || gui_used == GUI_CLEAR || !gui_data)
+		return false;
+
+	*commands = gui_commands.empty() ? NULL : &gui_commands[0];
+	*count = (int) gui_commands.size();
+	*layer = gui_layer_used ? (const uint32*) gui_data : NULL;
+	return true;
+}
 
 lua_State* FCEU_GetLuaState() {
-	return L;
+	if (L)
+		return L;
+	return luaScripts.empty() ? NULL : luaScripts.front()->L;
 }
 char* FCEU_GetLuaScriptName() {
 	return luaScriptName;
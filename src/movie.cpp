@@ -14,6 +14,7 @@
 #include "cart.h"
 #include "fds.h"
 #include "vsuni.h"
+#include "context.h"
 #ifdef _S9XLUA_H
 #include "fceulua.h"
 #endif
@@ -22,6 +23,11 @@
 #include "utils/xstring.h"
 #include <sstream>
 #include <algorithm>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #ifdef CREATE_AVI
 #include "drivers/videolog/nesvideos-piece.h"
@@ -56,6 +62,10 @@ extern int RAMInitSeed;
 #include <climits>
 #include <cstdarg>
 #include <zlib.h>
+#include <sys/stat.h>
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -69,6 +79,7 @@ std::vector<string> subtitleMessages;	//Messages of subtitles
 
 bool subtitlesOnAVI = false;
 bool autoMovieBackup = false; //Toggle that determines if movies should be backed up automatically before altering them
+bool movieBinaryCache = true;	//Keep a binary copy of long text movies next to them, in <movie>.bin, so they load with one read
 bool freshMovie = false;	  //True when a movie loads, false when movie is altered.  Used to determine if a movie has been altered since opening
 bool movieFromPoweron = true;
 
@@ -108,6 +119,15 @@ int frame_display = 0;
 int rerecord_display = 0;
 bool fullSaveStateLoads = false;	//Option for loading a savestates full contents in read+write mode instead of up to the frame count in the savestate (useful as a recovery option)
 int movieRecordMode = 0;			//Option for various movie recording modes such as TRUNCATE (normal), OVERWRITE etc.
+int movieRAMInitOverride = -1;		//RAMInitOption the movies loaded play with instead of their own, -1 for theirs (desync bisection)
+
+//----seek index: snapshots taken every few frames of playback, so that seeking only replays the frames after the nearest one
+static std::map<int, std::vector<uint8> > seekIndex;
+static int seekIndexInterval = 0;			//frames between snapshots as configured, 0 = no index
+static int seekIndexSpacing = 0;			//the interval after thinning the index to fit the memory limit
+static size_t seekIndexMemoryLimit = 0;
+static size_t seekIndexMemoryUsage = 0;
+static bool seekIndexOnTimeline = false;	//the console is on the timeline of the movie, as played from its beginning
 
 SFORMAT FCEUMOV_STATEINFO[]={
 	{ &currFrameCounter, 4|FCEUSTATE_RLSB, "FCNT"},
@@ -331,6 +351,37 @@ bool MovieRecord::parseBinary(MovieData* md, EMUFILE* is)
 	return true;
 }
 
+//decodes one record as written by dumpBinary() and returns the end of it
+const uint8* MovieRecord::parseBinary(MovieData* md, const uint8* data)
+{
+	commands = *data++;
+
+	if(md->fourscore)
+	{
+		memcpy(&joysticks,data,4);
+		data += 4;
+	}
+	else
+	{
+		for(int port=0;port<2;port++)
+		{
+			if(md->ports[port] == SI_GAMEPAD)
+				joysticks[port] = *data++;
+			else if(md->ports[port] == SI_ZAPPER)
+			{
+				zappers[port].x = data[0];
+				zappers[port].y = data[1];
+				zappers[port].b = data[2];
+				zappers[port].bogo = data[3];
+				zappers[port].zaphit = FCEU_de64lsb((uint8*)data+4);
+				data += 12;
+			}
+		}
+	}
+
+	return data;
+}
+
 
 void MovieRecord::dumpBinary(MovieData* md, EMUFILE* os, int index)
 {
@@ -463,6 +514,13 @@ void MovieData::installValue(std::string& key, std::string& val)
 		comments.push_back(mbstowcs(val));
 	else if (key == "subtitle")
 		subtitles.push_back(val); //mbstowcs(val));
+	else if (key == "checkpoint")
+	{
+		int frame;
+		unsigned long long hash;
+		if (sscanf(val.c_str(), "%d %llx", &frame, &hash) == 2 && frame >= 0)
+			checkpoints[frame] = hash;
+	}
 	else if(key == "savestate")
 	{
 		int len = Base64StringToBytesLength(val);
@@ -515,6 +573,9 @@ int MovieData::dump(EMUFILE *os, bool binary, bool seekToCurrFramePos)
 	for(uint32 i=0;i<subtitles.size();i++)
 		os->fprintf("subtitle %s\n" , subtitles[i].c_str() );
 
+	for(std::map<int,uint64>::const_iterator it=checkpoints.begin();it!=checkpoints.end();++it)
+		os->fprintf("checkpoint %d %016llx\n" , it->first, (unsigned long long)it->second );
+
 	if(binary)
 		os->fprintf("binary 1\n" );
 
@@ -554,6 +615,116 @@ int MovieData::dump(EMUFILE *os, bool binary, bool seekToCurrFramePos)
 	return end-start;
 }
 
+static void ResetSeekIndex(bool onTimeline)
+{
+	seekIndex.clear();
+	seekIndexSpacing = seekIndexInterval;
+	seekIndexMemoryUsage = 0;
+	seekIndexOnTimeline = onTimeline;
+}
+
+void FCEUMOV_SetSeekIndex(int framesBetweenSnapshots, size_t memoryLimit)
+{
+	if (framesBetweenSnapshots < 0)
+		framesBetweenSnapshots = 0;
+	if (framesBetweenSnapshots == seekIndexInterval && memoryLimit == seekIndexMemoryLimit)
+		return;
+	seekIndexInterval = framesBetweenSnapshots;
+	seekIndexMemoryLimit = memoryLimit;
+	ResetSeekIndex(seekIndexOnTimeline);
+}
+
+size_t FCEUMOV_GetSeekIndexMemoryUsage(void)
+{
+	return seekIndexMemoryUsage;
+}
+
+//called before the input of every frame, while the console is between two frames
+void FCEUMOV_UpdateSeekIndex(void)
+{
+	if (seekIndexInterval <= 0 || (seekIndex.empty() && !seekIndexOnTimeline))
+		return;
+
+	if (movieMode == MOVIEMODE_RECORD)
+	{
+		//the input from this frame on may change, so may the frames after it
+		std::map<int, std::vector<uint8> >::iterator it = seekIndex.upper_bound(currFrameCounter);
+		while (it != seekIndex.end())
+		{
+			seekIndexMemoryUsage -= it->second.size();
+			seekIndex.erase(it++);
+		}
+	}
+	if (!seekIndexOnTimeline || (movieMode != MOVIEMODE_PLAY && movieMode != MOVIEMODE_RECORD))
+		return;
+	if (currFrameCounter % seekIndexSpacing || seekIndex.count(currFrameCounter))
+		return;
+
+	std::vector<uint8> &snapshot = seekIndex[currFrameCounter];
+	snapshot.resize(FCEUSS_SnapshotSize());
+	if (!FCEUSS_Snapshot(&snapshot[0], snapshot.size()))
+	{
+		seekIndex.erase(currFrameCounter);
+		return;
+	}
+	seekIndexMemoryUsage += snapshot.size();
+
+	//over the limit: drop every other snapshot, the index keeps covering the whole movie at twice the spacing
+	while (seekIndexMemoryUsage > seekIndexMemoryLimit && seekIndex.size() > 1)
+	{
+		std::map<int, std::vector<uint8> >::iterator it = seekIndex.begin();
+		while (it != seekIndex.end())
+		{
+			if ((it->first / seekIndexSpacing) & 1)
+			{
+				seekIndexMemoryUsage -= it->second.size();
+				seekIndex.erase(it++);
+			} else
+				++it;
+		}
+		seekIndexSpacing *= 2;
+	}
+}
+
+int FCEUMOV_SeekToFrame(int frame)
+{
+	if (!FCEUMOV_Mode(MOVIEMODE_PLAY|MOVIEMODE_FINISHED) || frame < 0 || frame > (int)currMovieData.records.size())
+		return -1;
+
+	//the nearest snapshot before the frame, so that at least one frame is emulated and the picture is current
+	std::map<int, std::vector<uint8> >::iterator it = seekIndex.lower_bound(frame);
+	if (it != seekIndex.begin())
+		--it;
+	else if (it != seekIndex.end() && it->first != frame)
+		it = seekIndex.end();
+	bool useSnapshot = (it != seekIndex.end());
+
+	//going on from the current frame is cheaper, if the console is on the timeline
+	if (seekIndexOnTimeline && currFrameCounter <= frame && (!useSnapshot || currFrameCounter >= it->first))
+		useSnapshot = false;
+	else if (!useSnapshot)
+		return -1;
+
+	if (useSnapshot)
+	{
+		if (!FCEUSS_Restore(&it->second[0], it->second.size()))
+			return -1;
+		FCEU::Context::invalidateCurrent();
+		currFrameCounter = it->first;
+		seekIndexOnTimeline = true;
+	}
+	if (movieMode == MOVIEMODE_FINISHED && currFrameCounter < (int)currMovieData.records.size())
+		movieMode = MOVIEMODE_PLAY;
+
+	int replayed = 0;
+	while (currFrameCounter < frame && movieMode == MOVIEMODE_PLAY)
+	{
+		FCEUI_EmulateOffscreen();
+		replayed++;
+	}
+	return replayed;
+}
+
 int FCEUMOV_GetFrame(void)
 {
 	return currFrameCounter;
@@ -604,7 +775,160 @@ bool FCEUMOV_Mode(int modemask)
 	return FCEUMOV_Mode((EMOVIEMODE)modemask);
 }
 
-static void LoadFM2_binarychunk(MovieData& movieData, EMUFILE* fp, int size)
+//Reads the movie through a buffer rather than a character at a time from the
+//stream. At most size bytes are read, and the stream is left just after the
+//last one the parser used, where the TAS Editor project data continues.
+class FM2Reader
+{
+public:
+	FM2Reader(EMUFILE* fp, int size)
+		: fp(fp), start(fp->ftell()), left(std::max(size,0)), pos(0), len(0), consumed(0)
+	{
+	}
+
+	~FM2Reader()
+	{
+		fp->fseek(start+consumed,SEEK_SET);
+	}
+
+	int get()
+	{
+		if(pos == len && !refill())
+			return -1;
+		consumed++;
+		return (uint8)buf[pos++];
+	}
+
+	//only after a get() that returned a character
+	void unget()
+	{
+		pos--;
+		consumed--;
+	}
+
+	int consumedCount() { return consumed; }
+
+	//bytes left to parse, buffered or not, as far as the stream goes
+	int available()
+	{
+		int curr = fp->ftell();
+		fp->fseek(0,SEEK_END);
+		int end = fp->ftell();
+		fp->fseek(curr,SEEK_SET);
+		return (len-pos) + std::min<int>(left, end-curr);
+	}
+
+	//hands out count bytes in one piece, copying what is buffered and
+	//reading the rest straight from the stream; returns the bytes got
+	int read(uint8* dst, int count)
+	{
+		int buffered = std::min(count, len-pos);
+		memcpy(dst, buf+pos, buffered);
+		pos += buffered;
+		int direct = 0;
+		if(count > buffered)
+		{
+			direct = fp->fread(dst+buffered, std::min(count-buffered, left));
+			left -= direct;
+		}
+		consumed += buffered+direct;
+		return buffered+direct;
+	}
+
+private:
+	bool refill()
+	{
+		len = pos = 0;
+		if(left > 0)
+			len = fp->fread(buf, std::min<int>(sizeof(buf), left));
+		left -= len;
+		return len > 0;
+	}
+
+	EMUFILE* fp;
+	int start, left;
+	int pos, len, consumed;
+	char buf[64*1024];
+};
+
+//extracts a decimal uint the way templateIntegerDecFromIstream() does
+template<typename T> static T FM2ReadDec(FM2Reader& rd)
+{
+	T ret = 0;
+	bool pre = true;
+
+	for(;;)
+	{
+		int c = rd.get();
+		if(c == -1) return ret;
+		int d = c - '0';
+		if((d<0 || d>9))
+		{
+			if(!pre)
+				break;
+		}
+		else
+		{
+			pre = false;
+			ret *= 10;
+			ret += d;
+		}
+	}
+	rd.unget();
+	return ret;
+}
+
+//MovieRecord::parseJoy() on the reader
+static uint8 FM2ReadJoy(FM2Reader& rd)
+{
+	uint8 joystate = 0;
+	for(int i=0;i<8;i++)
+	{
+		int c = rd.get();
+		joystate <<= 1;
+		joystate |= ((c=='.'||c==' ')?0:1);
+	}
+	return joystate;
+}
+
+//MovieRecord::parse() on the reader
+static void FM2ReadRecord(MovieData& md, MovieRecord& rec, FM2Reader& rd)
+{
+	rec.commands = FM2ReadDec<uint32>(rd);
+	rd.get(); //eat the pipe
+
+	if(md.fourscore)
+	{
+		for(int i=0;i<4;i++)
+		{
+			rec.joysticks[i] = FM2ReadJoy(rd);
+			rd.get(); //eat the pipe
+		}
+	}
+	else
+	{
+		for(int port=0;port<2;port++)
+		{
+			if(md.ports[port] == SI_GAMEPAD)
+				rec.joysticks[port] = FM2ReadJoy(rd);
+			else if(md.ports[port] == SI_ZAPPER)
+			{
+				rec.zappers[port].x = FM2ReadDec<uint32>(rd);
+				rec.zappers[port].y = FM2ReadDec<uint32>(rd);
+				rec.zappers[port].b = FM2ReadDec<uint32>(rd);
+				rec.zappers[port].bogo = FM2ReadDec<uint32>(rd);
+				rec.zappers[port].zaphit = FM2ReadDec<uint64>(rd);
+			}
+
+			rd.get(); //eat the pipe
+		}
+	}
+
+	//(no fcexp data is logged right now)
+	rd.get(); //eat the pipe
+}
+
+static void LoadFM2_binarychunk(MovieData& movieData, FM2Reader& rd)
 {
 	int recordsize = 1; //1 for the command
 	if(movieData.fourscore)
@@ -621,24 +945,21 @@ static void LoadFM2_binarychunk(MovieData& movieData, EMUFILE* fp, int size)
 		}
 	}
 
-	//find out how much remains in the file
-	int curr = fp->ftell();
-	fp->fseek(0,SEEK_END);
-	int end = fp->ftell();
-	int flen = end-curr;
-	fp->fseek(curr,SEEK_SET);
-
 	//the amount todo is the min of the limiting size we received and the remaining contents of the file
-	int todo = std::min<int>(size, flen);
-
-	int numRecords = todo/recordsize;
+	int numRecords = rd.available()/recordsize;
 	if (movieData.loadFrameCount!=-1 && movieData.loadFrameCount<numRecords)
 		numRecords=movieData.loadFrameCount;
 
+	//read all records at once and decode them from memory
+	std::vector<uint8> data((size_t)numRecords*recordsize);
+	if(numRecords)
+		numRecords = rd.read(&data[0], numRecords*recordsize)/recordsize;
+
 	movieData.records.resize(numRecords);
+	const uint8* p = numRecords ? &data[0] : NULL;
 	for(int i=0;i<numRecords;i++)
 	{
-		movieData.records[i].parseBinary(&movieData,fp);
+		p = movieData.records[i].parseBinary(&movieData,p);
 	}
 }
 
@@ -673,6 +994,7 @@ bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader)
 	if(memcmp(buf,"version 3",9))
 		return false;
 
+	FM2Reader rd(fp, size);
 	std::string key,value;
 	enum {
 		NEWLINE, KEY, SEPARATOR, VALUE, RECORD, COMMENT, SUBTITLE
@@ -680,10 +1002,10 @@ bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader)
 	bool bail = false;
 	bool iswhitespace, isrecchar, isnewline;
 	int c;
+	int firstRecordAt = 0;
 	for(;;)
 	{
-		if(size--<=0) goto bail;
-		c = fp->fgetc();
+		c = rd.get();
 		if(c == -1)
 			goto bail;
 		iswhitespace = (c==' '||c=='\t');
@@ -691,7 +1013,7 @@ bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader)
 		isnewline = (c==10||c==13);
 		if(isrecchar && movieData.binaryFlag && !stopAfterHeader)
 		{
-			LoadFM2_binarychunk(movieData, fp, size);
+			LoadFM2_binarychunk(movieData, rd);
 			return true;
 		} else if (isnewline && static_cast<size_t>(movieData.loadFrameCount) == movieData.records.size())
 			// exit prematurely if loaded the specified amound of records
@@ -713,11 +1035,16 @@ bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader)
 				dorecord:
 				if (stopAfterHeader) return true;
 				int currcount = movieData.records.size();
+				if (currcount == 0)
+					firstRecordAt = rd.consumedCount();
+				else if (currcount == 1)
+				{
+					//the records that follow are about as long as the first one
+					int linelen = std::max(rd.consumedCount() - firstRecordAt, 1);
+					movieData.records.reserve(currcount + 1 + rd.available()/linelen);
+				}
 				movieData.records.resize(currcount+1);
-				int preparse = fp->ftell();
-				movieData.records[currcount].parse(&movieData, fp);
-				int postparse = fp->ftell();
-				size -= (postparse-preparse);
+				FM2ReadRecord(movieData, movieData.records[currcount], rd);
 				state = NEWLINE;
 				break;
 			}
@@ -760,6 +1087,94 @@ bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader)
 	return true;
 }
 
+static const char movieCacheMagic[8] = {'F','M','2','B','I','N','0','1'};
+static const int movieCacheMinFrames = 5*60*60;	//five minutes worth; shorter movies parse fast enough
+
+static bool MovieCacheStamp(const std::string& fname, uint64& size, int64& mtime)
+{
+	struct stat st;
+	if(stat(fname.c_str(), &st) != 0)
+		return false;
+	size = (uint64)st.st_size;
+	mtime = (int64)st.st_mtime;
+	return true;
+}
+
+//The cache holds the size and modification time of the movie it was made
+//from, its frame count, then the movie as MovieData::dump() writes it in
+//binary form.
+static bool LoadMovieCache(MovieData& movieData, const std::string& fname, uint64 size, int64 mtime)
+{
+	EMUFILE_FILE* is = FCEUD_UTF8_fstream(fname + ".bin", "rb");
+	if(!is)
+		return false;
+
+	char magic[8];
+	uint64 cachedSize, cachedTime;
+	uint32 count;
+	bool ok = !is->fail() && is->fread(magic,8) == 8 && !memcmp(magic,movieCacheMagic,8)
+		&& read64le(&cachedSize,is) && read64le(&cachedTime,is) && read32le(&count,is)
+		&& cachedSize == size && cachedTime == (uint64)mtime
+		&& LoadFM2(movieData, is, is->size() - is->ftell(), false)
+		&& movieData.binaryFlag && movieData.records.size() == count;
+	delete is;
+
+	if(!ok)
+	{
+		movieData = MovieData();
+		return false;
+	}
+
+	//it was loaded from a text movie, and saves back to one
+	movieData.binaryFlag = false;
+	return true;
+}
+
+static void SaveMovieCache(MovieData& movieData, const std::string& fname, uint64 size, int64 mtime)
+{
+	std::string cacheName = fname + ".bin";
+	std::string tempName = cacheName + ".tmp";
+
+	EMUFILE_FILE* os = FCEUD_UTF8_fstream(tempName, "wb");
+	if(!os)
+		return;
+	bool ok = !os->fail();
+	if(ok)
+	{
+		os->fwrite(movieCacheMagic,8);
+		write64le(size,os);
+		write64le((uint64)mtime,os);
+		write32le((uint32)movieData.records.size(),os);
+		movieData.dump(os, true);
+		ok = !os->fail();
+	}
+	delete os;
+
+	remove(cacheName.c_str());
+	if(!ok || rename(tempName.c_str(), cacheName.c_str()) != 0)
+		remove(tempName.c_str());
+}
+
+//LoadFM2() of a whole movie, from its binary cache when that is current
+static bool LoadFM2Cached(MovieData& movieData, FCEUFILE* fp)
+{
+	uint64 size;
+	int64 mtime;
+
+	if(!movieBinaryCache || fp->isArchive() || !MovieCacheStamp(fp->filename, size, mtime))
+		return LoadFM2(movieData, fp->stream, fp->size, false);
+
+	if(LoadMovieCache(movieData, fp->filename, size, mtime))
+		return true;
+
+	if(!LoadFM2(movieData, fp->stream, fp->size, false))
+		return false;
+
+	if(!movieData.binaryFlag && movieData.getNumRecords() >= movieCacheMinFrames)
+		SaveMovieCache(movieData, fp->filename, size, mtime);
+	return true;
+}
+
 static const char *GetMovieModeStr()
 {
 	if (movieMode == MOVIEMODE_INACTIVE)
@@ -797,13 +1212,360 @@ static const char *GetMovieRecordModeStr()
 	}
 }
 
-static EMUFILE *openRecordingMovie(const char* fname)
+//the recording movie is written by a background thread, so that the frame
+//that records never waits for the disk. MovieFileWriter keeps what is
+//written to it in memory and hands it over as a whole every
+//MOVIE_WRITE_BATCH_FRAMES frames and on fflush(). when the whole movie is
+//dumped again (rerecords, switching to playback), it goes to a temporary
+//file that is renamed over the movie, so that a crash leaves either the old
+//or the new one. every movieCheckpointFrames frames the file is also synced
+//to disk. errors are reported by FCEUMOV_UpdateWrites.
+#define MOVIE_WRITE_BATCH_FRAMES 60
+
+int movieCheckpointFrames = 600;
+
+struct MovieWriteTarget
+{
+	std::string fn;
+	FILE *fp;
+};
+
+struct MovieWriteOp
+{
+	enum Type { WRITE, REPLACE, TRUNCATE, SYNC, CLOSE } type;
+	MovieWriteTarget *target;
+	long offset;
+	std::vector<uint8> data;
+};
+
+static std::mutex movieWriteMutex;
+static std::condition_variable movieWriteCond;
+static std::deque<MovieWriteOp*> movieWriteQueue;
+static bool movieWriteBusy = false;
+static std::thread *movieWriter = NULL;
+static bool movieWriterQuit = false;
+static std::string movieWriteError;		//file that could not be written, reported once
+
+static bool ExecMovieWrite(MovieWriteOp *op)
+{
+	MovieWriteTarget *t = op->target;
+
+	switch(op->type)
+	{
+	case MovieWriteOp::WRITE:
+		if(!t->fp)
+			return false;
+		if(fseek(t->fp, op->offset, SEEK_SET) != 0)
+			return false;
+		if(!op->data.empty() && fwrite(&op->data[0], 1, op->data.size(), t->fp) != op->data.size())
+			return false;
+		//in the system's hands, it outlives a crash of the emulator
+		return fflush(t->fp) == 0;
+
+	case MovieWriteOp::REPLACE:
+	{
+		std::string temp = t->fn + ".tmp";
+		FILE *fp = FCEUD_UTF8fopen(temp, "wb");
+		if(!fp)
+			return false;
+		bool ok = op->data.empty() || fwrite(&op->data[0], 1, op->data.size(), fp) == op->data.size();
+		ok &= FCEU_SyncFile(fp);
+		ok &= fclose(fp) == 0;
+		if(!ok)
+		{
+			remove(temp.c_str());
+			return false;
+		}
+		if(t->fp)
+			fclose(t->fp);
+	#ifdef WIN32
+		//rename does not replace a file there
+		remove(t->fn.c_str());
+	#endif
+		ok = rename(temp.c_str(), t->fn.c_str()) == 0;
+		t->fp = FCEUD_UTF8fopen(t->fn, "r+b");
+		return ok && t->fp;
+	}
+
+	case MovieWriteOp::TRUNCATE:
+		if(!t->fp || fflush(t->fp) != 0)
+			return false;
+	#ifdef _MSC_VER
+		return _chsize(_fileno(t->fp), op->offset) == 0;
+	#else
+		return ftruncate(fileno(t->fp), op->offset) == 0;
+	#endif
+
+	case MovieWriteOp::SYNC:
+		return t->fp && FCEU_SyncFile(t->fp);
+
+	case MovieWriteOp::CLOSE:
+	{
+		bool ok = !t->fp || fclose(t->fp) == 0;
+		delete t;
+		return ok;
+	}
+	}
+	return true;
+}
+
+static void MovieWriterLoop(void)
+{
+	std::unique_lock<std::mutex> lock(movieWriteMutex);
+
+	for(;;)
+	{
+		if(movieWriteQueue.empty())
+		{
+			if(movieWriterQuit)
+				break;
+			movieWriteCond.wait(lock);
+			continue;
+		}
+		MovieWriteOp *op = movieWriteQueue.front();
+		movieWriteQueue.pop_front();
+		movieWriteBusy = true;
+
+		lock.unlock();
+		std::string fn = op->target->fn;
+		bool ok = ExecMovieWrite(op);
+		delete op;
+		lock.lock();
+
+		if(!ok && movieWriteError.empty())
+			movieWriteError = fn;
+		movieWriteBusy = false;
+		movieWriteCond.notify_all();
+	}
+}
+
+static void QueueMovieWrite(MovieWriteOp *op)
 {
+	std::lock_guard<std::mutex> lock(movieWriteMutex);
+
+	if(!movieWriter)
+	{
+		movieWriterQuit = false;
+		movieWriter = new std::thread(MovieWriterLoop);
+	}
+	movieWriteQueue.push_back(op);
+	movieWriteCond.notify_all();
+}
+
+void FCEUMOV_FlushWrites(void)
+{
+	std::unique_lock<std::mutex> lock(movieWriteMutex);
+
+	while(!movieWriteQueue.empty() || movieWriteBusy)
+		movieWriteCond.wait(lock);
+}
+
+void FCEUMOV_UpdateWrites(void)
+{
+	std::string fn;
+	{
+		std::lock_guard<std::mutex> lock(movieWriteMutex);
+		if(movieWriteError.empty())
+			return;
+		fn.swap(movieWriteError);
+	}
+	FCEU_PrintError("Error writing movie file %s", fn.c_str());
+}
+
+void FCEUMOV_StopWrites(void)
+{
+	if(osRecordingMovie)
+		osRecordingMovie->fflush();
+	{
+		std::lock_guard<std::mutex> lock(movieWriteMutex);
+		if(!movieWriter)
+			return;
+		movieWriterQuit = true;
+		movieWriteCond.notify_all();
+	}
+	movieWriter->join();
+	delete movieWriter;
+	movieWriter = NULL;
+	FCEUMOV_UpdateWrites();
+}
+
+class MovieFileWriter : public EMUFILE
+{
+	MovieWriteTarget *target;
+	std::vector<uint8> pending;		//written since the last hand over, from pendingOffset on
+	long pendingOffset;
+	long pos, len;
+	bool replacing;					//pending is the whole file, to replace it with
+
+	void handOver(void)
+	{
+		if(pending.empty() && !replacing)
+			return;
+		MovieWriteOp *op = new MovieWriteOp();
+		op->type = replacing ? MovieWriteOp::REPLACE : MovieWriteOp::WRITE;
+		op->target = target;
+		op->offset = pendingOffset;
+		op->data.swap(pending);
+		QueueMovieWrite(op);
+		replacing = false;
+		pendingOffset = pos;
+	}
+
+	void queue(MovieWriteOp::Type type, long offset)
+	{
+		MovieWriteOp *op = new MovieWriteOp();
+		op->type = type;
+		op->target = target;
+		op->offset = offset;
+		QueueMovieWrite(op);
+	}
+
+public:
+	//opens the file now, unless it is to be replaced as a whole with what is
+	//written first, which the writer thread does once it is handed over
+	MovieFileWriter(const char *fn, bool replace)
+		: pendingOffset(0), pos(0), len(0), replacing(replace)
+	{
+		target = new MovieWriteTarget();
+		target->fn = fn;
+		target->fp = NULL;
+		if(!replace)
+		{
+			//the writer may still have this file open
+			FCEUMOV_FlushWrites();
+			target->fp = FCEUD_UTF8fopen(fn, "wb");
+			failbit = !target->fp;
+		}
+	}
+
+	virtual ~MovieFileWriter()
+	{
+		handOver();
+		queue(MovieWriteOp::CLOSE, 0);
+	}
+
+	const std::string& filename() const { return target->fn; }
+
+	//what is written from here on replaces the whole file
+	void rewrite(void)
+	{
+		pending.clear();
+		pendingOffset = pos = len = 0;
+		replacing = true;
+	}
+
+	void sync(void)
+	{
+		handOver();
+		queue(MovieWriteOp::SYNC, 0);
+	}
+
+	virtual FILE *get_fp() { return NULL; }
+	virtual EMUFILE* memwrap() { return NULL; }
+
+	virtual int fprintf(const char *format, ...)
+	{
+		char buf[1024];
+		va_list argptr;
+		va_start(argptr, format);
+		int amt = vsnprintf(buf, sizeof(buf), format, argptr);
+		va_end(argptr);
+		if(amt < 0)
+			return amt;
+		if(amt < (int)sizeof(buf))
+		{
+			fwrite(buf, amt);
+			return amt;
+		}
+		std::vector<char> big(amt + 1);
+		va_start(argptr, format);
+		vsnprintf(&big[0], big.size(), format, argptr);
+		va_end(argptr);
+		fwrite(&big[0], amt);
+		return amt;
+	}
+
+	virtual int fgetc() { failbit = true; return -1; }
+	virtual size_t _fread(const void *ptr, size_t bytes) { failbit = true; return 0; }
+
+	virtual int fputc(int c)
+	{
+		uint8 b = (uint8)c;
+		fwrite(&b, 1);
+		return c;
+	}
+
+	virtual void fwrite(const void *ptr, size_t bytes)
+	{
+		//over or right after what is pending goes into it, anything else
+		//starts anew
+		long end = pendingOffset + (long)pending.size();
+		if(!replacing && (pos < pendingOffset || pos > end))
+		{
+			handOver();
+			pendingOffset = end = pos;
+		}
+		if(replacing && pos > end)
+			pending.resize(pos, 0);
+
+		size_t at = pos - pendingOffset;
+		if(at + bytes > pending.size())
+			pending.resize(at + bytes);
+		memcpy(&pending[at], ptr, bytes);
+		pos += bytes;
+		if(pos > len)
+			len = pos;
+		if(!replacing && pending.size() >= 0x10000)
+			handOver();
+	}
+
+	virtual int fseek(long int offset, int origin)
+	{
+		switch(origin)
+		{
+		case SEEK_SET: pos = offset; break;
+		case SEEK_CUR: pos += offset; break;
+		case SEEK_END: pos = len + offset; break;
+		}
+		if(pos < 0)
+			pos = 0;
+		return 0;
+	}
+
+	virtual long int ftell() { return pos; }
+	virtual size_t size() { return len; }
+	virtual void fflush() { handOver(); }
+
+	virtual void truncate(size_t length)
+	{
+		if(replacing)
+		{
+			if(pending.size() > length)
+				pending.resize(length);
+		}
+		else
+		{
+			handOver();
+			queue(MovieWriteOp::TRUNCATE, (long)length);
+		}
+		len = length;
+	}
+};
+
+//with replace, the movie already being written is rewritten as a whole
+static EMUFILE *openRecordingMovie(const char* fname, bool replace = false)
+{
+	MovieFileWriter *writer = static_cast<MovieFileWriter*>(osRecordingMovie);
+	if (replace && writer && writer->filename() == fname)
+	{
+		writer->rewrite();
+		return osRecordingMovie;
+	}
 	if (osRecordingMovie)
 		delete osRecordingMovie;
 
-	osRecordingMovie = FCEUD_UTF8_fstream(fname, "wb");
-	if (!osRecordingMovie || osRecordingMovie->fail()) {
+	osRecordingMovie = new MovieFileWriter(fname, replace);
+	if (osRecordingMovie->fail()) {
 		FCEU_PrintError("Error opening movie output file: %s", fname);
 		return NULL;
 	}
@@ -830,7 +1592,7 @@ static void RedumpWholeMovieFile(bool justToggledRecording = false)
 	bool recording = (movieMode == MOVIEMODE_RECORD);
 	assert((NULL != osRecordingMovie) == (recording != justToggledRecording) && "osRecordingMovie should be consistent with movie mode!");
 
-	if (NULL == openRecordingMovie(curMovieFilename.c_str()))
+	if (NULL == openRecordingMovie(curMovieFilename.c_str(), true))
 		return;
 
 	currMovieData.dump(osRecordingMovie, false/*currMovieData.binaryFlag*/, recording);
@@ -894,6 +1656,8 @@ void FCEUI_StopMovie()
 	if (suppressMovieStop)
 		return;
 
+	ResetSeekIndex(false);
+
 	if (movieMode == MOVIEMODE_PLAY || movieMode == MOVIEMODE_FINISHED)
 		StopPlayback();
 	else if (movieMode == MOVIEMODE_RECORD)
@@ -1042,6 +1806,9 @@ bool FCEUI_LoadMovie(const char *fname, bool _read_only, int _pauseframe)
 
 	currMovieData = MovieData();
 
+	//the movie may be one still being written
+	FCEUMOV_FlushWrites();
+
 	curMovieFilename.assign(fname);
 	FCEUFILE *fp = FCEU_fopen(fname,0,"rb",0);
 	if (!fp) return false;
@@ -1062,11 +1829,11 @@ bool FCEUI_LoadMovie(const char *fname, bool _read_only, int _pauseframe)
 	AddRecentMovieFile(name.c_str());
 #endif
 
-	LoadFM2(currMovieData, fp->stream, fp->size, false);
+	LoadFM2Cached(currMovieData, fp);
 	LoadSubtitles(currMovieData);
 	delete fp;
 
-	RAMInitOption = currMovieData.RAMInitOption;
+	RAMInitOption = movieRAMInitOverride >= 0 ? movieRAMInitOverride : currMovieData.RAMInitOption;
 	RAMInitSeed = currMovieData.RAMInitSeed;
 
 	freshMovie = true;	//Movie has been loaded, so it must be unaltered
@@ -1109,6 +1876,7 @@ bool FCEUI_LoadMovie(const char *fname, bool _read_only, int _pauseframe)
 	pauseframe = _pauseframe;
 	movie_readonly = _read_only;
 	movieMode = MOVIEMODE_PLAY;
+	ResetSeekIndex(true);
 	if (movieMode != MOVIEMODE_TASEDITOR)
 		currRerecordCount = currMovieData.rerecordCount;
 
@@ -1180,11 +1948,13 @@ void FCEUI_SaveMovie(const char *fname, EMOVIE_FLAG flags, std::wstring author)
 
 	//we are going to go ahead and dump the header. from now on we will only be appending frames
 	currMovieData.dump(osRecordingMovie, false);
+	osRecordingMovie->fflush();
 
 	movieMode = MOVIEMODE_RECORD;
 	movie_readonly = false;
 	if (movieMode != MOVIEMODE_TASEDITOR)
 		currRerecordCount = 0;
+	ResetSeekIndex(true);
 
 	FCEU_DispMessage("Movie recording started.",0);
 }
@@ -1313,6 +2083,12 @@ void FCEUMOV_AddInputState()
 			currMovieData.records.push_back(mr);
 
 		mr.dump(&currMovieData, osRecordingMovie, currFrameCounter);	// to disk
+
+		MovieFileWriter *writer = static_cast<MovieFileWriter*>(osRecordingMovie);
+		if (movieCheckpointFrames > 0 && (currFrameCounter + 1) % movieCheckpointFrames == 0)
+			writer->sync();
+		else if ((currFrameCounter + 1) % MOVIE_WRITE_BATCH_FRAMES == 0)
+			writer->fflush();
 	}
 
 	currFrameCounter++;
@@ -1433,6 +2209,8 @@ static bool load_successful = false;
 bool FCEUMOV_ReadState(EMUFILE* is, uint32 size)
 {
 	load_successful = false;
+	//a loaded state may come from another timeline, even when its movie matches
+	seekIndexOnTimeline = false;
 
 	if (!movie_readonly)
 	{
@@ -1968,7 +2746,7 @@ std::string FCEUI_GetMovieName(void)
 bool FCEUI_MovieGetInfo(FCEUFILE* fp, MOVIE_INFO& info, bool skipFrameCount)
 {
 	MovieData md;
-	if(!LoadFM2(md, fp->stream, fp->size, skipFrameCount))
+	if(skipFrameCount ? !LoadFM2(md, fp->stream, fp->size, true) : !LoadFM2Cached(md, fp))
 		return false;
 
 	info.movie_version = md.version;
@@ -96,6 +96,17 @@ inline bool FCEUMOV_IsLoaded() { return (FCEUMOV_Mode(MOVIEMODE_PLAY|MOVIEMODE_R
 
 bool FCEUMOV_ShouldPause(void);
 int FCEUMOV_GetFrame(void);
+
+//seek index for movie playback. every framesBetweenSnapshots frames of playback from the
+//beginning of the movie a snapshot is kept in memory, up to memoryLimit bytes; past the
+//limit the index is thinned to every other snapshot. 0 frames turns the index off.
+void FCEUMOV_SetSeekIndex(int framesBetweenSnapshots, size_t memoryLimit);
+size_t FCEUMOV_GetSeekIndexMemoryUsage(void);
+void FCEUMOV_UpdateSeekIndex(void);
+//moves movie playback to the frame: restores the nearest snapshot before it, or goes on from
+//the current frame, and replays the movie input from there without output. returns the number
+//of frames replayed, or -1 when the frame can't be reached (no movie playing, no snapshot).
+int FCEUMOV_SeekToFrame(int frame);
 int FCEUI_GetLagCount(void);
 bool FCEUI_GetLagged(void);
 void FCEUI_SetLagFlag(bool value);
@@ -111,6 +122,12 @@ bool FCEUMOV_FromPoweron();
 void FCEUMOV_CreateCleanMovie();
 void FCEUMOV_ClearCommands();
 
+//the recording movie is written in the background: wait for what is
+//queued, report write errors (once per frame), and stop the writer at exit
+void FCEUMOV_FlushWrites(void);
+void FCEUMOV_UpdateWrites(void);
+void FCEUMOV_StopWrites(void);
+
 class MovieData;
 class MovieRecord
 {
@@ -168,6 +185,7 @@ public:
 
 	void parse(MovieData* md, EMUFILE* is);
 	bool parseBinary(MovieData* md, EMUFILE* is);
+	const uint8* parseBinary(MovieData* md, const uint8* data);
 	void dump(MovieData* md, EMUFILE* os, int index);
 	void dumpBinary(MovieData* md, EMUFILE* os, int index);
 	void parseJoy(EMUFILE* is, uint8& joystate);
@@ -198,6 +216,8 @@ public:
 	std::vector<MovieRecord> records;
 	std::vector<std::wstring> comments;
 	std::vector<std::string> subtitles;
+	//RAM hashes known good runs reach after that many frames, "checkpoint <frame> <hash>" lines; see FCEU_MovieVerify
+	std::map<int,uint64> checkpoints;
 	//this is the RERECORD COUNT. please rename variable.
 	int rerecordCount;
 	FCEU_Guid guid;
@@ -281,8 +301,11 @@ extern bool subtitlesOnAVI;
 extern bool freshMovie;
 extern bool movie_readonly;
 extern bool autoMovieBackup;
+extern bool movieBinaryCache;
+extern int movieCheckpointFrames;	//frames between syncs of the recording movie to disk, 0 for none
 extern bool fullSaveStateLoads;
 extern int movieRecordMode;
+extern int movieRAMInitOverride;
 extern int input_display;
 
 //--------------------------------------------------
@@ -0,0 +1,729 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// movieverify.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "git.h"
+#include "file.h"
+#include "movie.h"
+#include "emufile.h"
+#include "framehash.h"
+#include "romscan.h"
+#include "x6502.h"
+#include "movieverify.h"
+#include "workerpool.h"
+#include "utils/endian.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+extern bool LoadFM2(MovieData &movieData, EMUFILE *fp, int size, bool stopAfterHeader);
+
+FCEU_MovieVerifyResult::FCEU_MovieVerifyResult()
+	: romMatches(false), frames(0), lagFrames(0), ramHash(0), frameHash(0),
+	  checkpoints(0), mismatches(0), desyncFrame(-1)
+{
+}
+
+bool FCEU_MovieVerifyResult::passed(void) const
+{
+	return error.empty() && romMatches && mismatches == 0;
+}
+
+uint64 FCEU_MovieVerifyRamHash(void)
+{
+	return RAM ? FCEU_XXH64(RAM, 0x800, 0) : 0;
+}
+
+static bool FileExists(const std::string &path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 && !(st.st_mode & S_IFDIR);
+}
+
+// the ROM index by checksum, then romFilename next to the movie, which
+// movies usually store without the extension
+static std::string FindRom(const std::string &movie, const MovieData &md)
+{
+	static const char *extensions[] = { "", ".nes", ".zip", ".unf", ".unif", ".fds", ".nsf", ".gz", ".7z" };
+
+	FCEU_RomScanEntry entry;
+	if (FCEU_RomIndexFindMD5(md.romChecksum.data, entry))
+		return entry.inner.empty() ? entry.path : entry.path + "|" + entry.inner;
+
+	if (md.romFilename.empty())
+		return "";
+
+	std::string dir;
+	size_t sep = movie.find_last_of("/\\");
+	if (sep != std::string::npos)
+		dir = movie.substr(0, sep + 1);
+
+	for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++)
+	{
+		std::string path = dir + md.romFilename + extensions[i];
+		if (FileExists(path))
+			return path;
+	}
+	return "";
+}
+
+// the header says which ROM the movie wants
+static bool LoadMovieHeader(const char *movie, MovieData &md, std::string &error)
+{
+	FCEUFILE *fp = FCEU_fopen(movie, 0, "rb", 0);
+	if (!fp)
+	{
+		error = "cannot open movie";
+		return false;
+	}
+	bool isMovie = LoadFM2(md, fp->stream, fp->size, true);
+	delete fp;
+	if (!isMovie)
+	{
+		error = "not an FM2 movie";
+		return false;
+	}
+	return true;
+}
+
+bool FCEU_VerifyMovie(const char *movie, const char *rom, int interval, FCEU_MovieVerifyResult &result)
+{
+	result = FCEU_MovieVerifyResult();
+	result.movie = movie;
+
+	MovieData md;
+	if (!LoadMovieHeader(movie, md, result.error))
+		return false;
+
+	result.rom = (rom && *rom) ? rom : FindRom(movie, md);
+	if (result.rom.empty())
+	{
+		result.error = "ROM not found";
+		return false;
+	}
+
+	FCEUI_StopMovie();
+	if (!FCEUI_LoadGame(result.rom.c_str(), 1, true))
+	{
+		result.error = "cannot load ROM";
+		return false;
+	}
+	result.romMatches = (memcmp(GameInfo->MD5.data, md.romChecksum.data, MD5DATA::size) == 0);
+
+	bool computeOnly = FCEUI_GetComputeOnly();
+	FCEUI_SetComputeOnly(true);
+
+	FCEUI_LoadMovie(movie, true, 0);
+	if (!FCEUMOV_Mode(MOVIEMODE_PLAY))
+	{
+		result.error = "cannot play movie";
+		FCEUI_SetComputeOnly(computeOnly);
+		FCEUI_CloseGame();
+		return false;
+	}
+
+	// a checkpoint holds the hash after that many frames, and the movie
+	// ends after its last record, before the driver input takes over
+	const std::map<int, uint64> &checkpoints = currMovieData.checkpoints;
+	std::map<int, uint64>::const_iterator cp = checkpoints.begin();
+	int length = currMovieData.getNumRecords();
+
+	for (;;)
+	{
+		for (; cp != checkpoints.end() && cp->first <= currFrameCounter; ++cp)
+		{
+			if (cp->first != currFrameCounter)
+				continue;
+			result.checkpoints++;
+			if (cp->second != FCEU_MovieVerifyRamHash())
+			{
+				if (result.mismatches++ == 0)
+					result.desyncFrame = currFrameCounter;
+			}
+		}
+		if (interval > 0 && currFrameCounter % interval == 0)
+			result.hashes.push_back(std::make_pair(currFrameCounter, FCEU_MovieVerifyRamHash()));
+
+		if (currFrameCounter >= length || !FCEUMOV_Mode(MOVIEMODE_PLAY))
+			break;
+
+		// the last frame is drawn, for the frame hash
+		if (currFrameCounter == length - 1)
+			FCEUI_SetComputeOnly(false);
+
+		uint8 *gfx = NULL;
+		int32 *sound = NULL;
+		int32 ssize = 0;
+		FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+	}
+
+	result.frames = currFrameCounter;
+	result.lagFrames = FCEUI_GetLagCount();
+	result.ramHash = FCEU_MovieVerifyRamHash();
+	if (length == 0 || !FCEUI_GetFrameHash(&result.frameHash, NULL))
+		result.frameHash = 0;
+
+	FCEUI_StopMovie();
+	FCEUI_SetComputeOnly(computeOnly);
+	FCEUI_CloseGame();
+	return result.passed();
+}
+
+//----------------------------------------------------------------------------
+// Workers
+
+#ifdef FCEU_WORKER_POOL
+static void PutString(EMUFILE &os, const std::string &s)
+{
+	write32le((uint32)s.size(), &os);
+	os.fwrite(s.data(), s.size());
+}
+
+static bool GetString(EMUFILE &is, std::string &s)
+{
+	uint32 len;
+	if (!read32le(&len, &is) || len > is.size() - is.ftell())
+		return false;
+	s.resize(len);
+	return len == 0 || is.fread(&s[0], len) == len;
+}
+
+static void PackResult(const FCEU_MovieVerifyResult &r, EMUFILE &os)
+{
+	PutString(os, r.rom);
+	PutString(os, r.error);
+	write32le((uint32)r.romMatches, &os);
+	write32le((uint32)r.frames, &os);
+	write32le((uint32)r.lagFrames, &os);
+	write64le(r.ramHash, &os);
+	write64le(r.frameHash, &os);
+	write32le((uint32)r.checkpoints, &os);
+	write32le((uint32)r.mismatches, &os);
+	write32le((uint32)r.desyncFrame, &os);
+	write32le((uint32)r.hashes.size(), &os);
+	for (size_t i = 0; i < r.hashes.size(); i++)
+	{
+		write32le((uint32)r.hashes[i].first, &os);
+		write64le(r.hashes[i].second, &os);
+	}
+}
+
+static bool UnpackResult(EMUFILE &is, FCEU_MovieVerifyResult &r)
+{
+	uint32 romMatches, frames, lagFrames, checkpoints, mismatches, desyncFrame, count;
+
+	if (!GetString(is, r.rom) || !GetString(is, r.error))
+		return false;
+	if (!read32le(&romMatches, &is) || !read32le(&frames, &is) || !read32le(&lagFrames, &is)
+		|| !read64le(&r.ramHash, &is) || !read64le(&r.frameHash, &is)
+		|| !read32le(&checkpoints, &is) || !read32le(&mismatches, &is) || !read32le(&desyncFrame, &is)
+		|| !read32le(&count, &is) || count > (is.size() - is.ftell()) / 12)
+		return false;
+
+	r.romMatches = romMatches != 0;
+	r.frames = (int)frames;
+	r.lagFrames = (int)lagFrames;
+	r.checkpoints = (int)checkpoints;
+	r.mismatches = (int)mismatches;
+	r.desyncFrame = (int)desyncFrame;
+	r.hashes.resize(count);
+	for (uint32 i = 0; i < count; i++)
+	{
+		uint32 frame;
+		if (!read32le(&frame, &is) || !read64le(&r.hashes[i].second, &is))
+			return false;
+		r.hashes[i].first = (int)frame;
+	}
+	return true;
+}
+
+// one forked copy of the emulator per movie, at most jobs at a time; the
+// movies whose worker could not be started are left in pending
+static void VerifyInWorkers(const std::vector<std::string> &movies, std::vector<size_t> &pending, const char *rom,
+	int jobs, int interval, std::vector<FCEU_MovieVerifyResult> &results)
+{
+	FCEU_RunInWorkers(pending, jobs,
+		[&](size_t index, std::vector<uint8> &reply)
+		{
+			FCEU_MovieVerifyResult result;
+			FCEU_VerifyMovie(movies[index].c_str(), rom, interval, result);
+			EMUFILE_MEMORY os(&reply);
+			PackResult(result, os);
+		},
+		[&](size_t index, const std::vector<uint8> &reply, const std::string &error)
+		{
+			FCEU_MovieVerifyResult &result = results[index];
+			std::vector<u8> data(reply);
+			EMUFILE_MEMORY is(&data);
+			if (!error.empty() || !UnpackResult(is, result))
+			{
+				result = FCEU_MovieVerifyResult();
+				result.movie = movies[index];
+				result.error = error.empty() ? "worker failed" : error;
+			}
+		});
+}
+#endif
+
+int FCEUI_VerifyMovies(const std::vector<std::string> &movies, const char *rom, int jobs, int interval,
+	std::vector<FCEU_MovieVerifyResult> &results)
+{
+	std::vector<size_t> pending;
+
+	results.assign(movies.size(), FCEU_MovieVerifyResult());
+	for (size_t i = 0; i < movies.size(); i++)
+	{
+		results[i].movie = movies[i];
+		pending.push_back(i);
+	}
+
+	if (jobs <= 0)
+		jobs = std::max(1, (int)std::thread::hardware_concurrency());
+
+#ifdef FCEU_WORKER_POOL
+	VerifyInWorkers(movies, pending, rom, jobs, interval, results);
+#endif
+
+	// no workers here, replay the rest one after another
+	for (size_t i = 0; i < pending.size(); i++)
+		FCEU_VerifyMovie(movies[pending[i]].c_str(), rom, interval, results[pending[i]]);
+
+	int failed = 0;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		if (!results[i].passed())
+			failed++;
+	}
+	return failed;
+}
+
+//----------------------------------------------------------------------------
+// Desync bisection
+
+// most instructions traced in a frame, a frame has about 30000
+static const size_t DESYNC_TRACE_MAX = 1 << 20;
+
+// RAM differences kept
+static const size_t DESYNC_RAM_DIFFS = 64;
+
+// hashes a worker writes at once
+static const size_t DESYNC_HASH_BLOCK = 64;
+
+FCEU_DesyncRun::FCEU_DesyncRun()
+	: newPPU(-1), ramInit(-1)
+{
+}
+
+FCEU_DesyncResult::FCEU_DesyncResult()
+	: frames(0), desyncFrame(-1), instruction(-1), traceStart(0)
+{
+}
+
+// what the frames are compared by: the RAM, seeded with the CPU registers
+static uint64 DesyncStateHash(void)
+{
+	uint8 regs[7] = { (uint8)X.PC, (uint8)(X.PC >> 8), X.A, X.X, X.Y, X.S, X.P };
+	return FCEU_XXH64(RAM, 0x800, FCEU_XXH64(regs, sizeof(regs), 0));
+}
+
+static void DesyncTraceHook(unsigned int address, unsigned int value, void *userData)
+{
+	std::vector<FCEU_DesyncStep> &trace = *(std::vector<FCEU_DesyncStep> *)userData;
+	if (trace.size() >= DESYNC_TRACE_MAX)
+		return;
+
+	FCEU_DesyncStep step;
+	step.pc = address;
+	step.a = X.A;
+	step.x = X.X;
+	step.y = X.Y;
+	step.s = X.S;
+	step.p = X.P;
+	step.cycle = timestampbase + timestamp;
+	step.ramHash = FCEU_XXH64(RAM, 0x800, 0);
+	trace.push_back(step);
+}
+
+static bool SameStep(const FCEU_DesyncStep &a, const FCEU_DesyncStep &b)
+{
+	return a.pc == b.pc && a.a == b.a && a.x == b.x && a.y == b.y && a.s == b.s && a.p == b.p &&
+		a.cycle == b.cycle && a.ramHash == b.ramHash;
+}
+
+// loads the game and starts playing movie from its start under run
+static bool StartDesyncRun(const char *movie, const std::string &rom, const FCEU_DesyncRun &run, std::string &error)
+{
+	FCEUI_StopMovie();
+	if (run.newPPU >= 0 && (newppu != 0) != (run.newPPU != 0))
+		FCEU_TogglePPU();
+	if (!FCEUI_LoadGame(rom.c_str(), 1, true))
+	{
+		error = "cannot load ROM";
+		return false;
+	}
+
+	movieRAMInitOverride = run.ramInit;
+	FCEUI_LoadMovie(movie, true, 0);
+	movieRAMInitOverride = -1;
+	if (!FCEUMOV_Mode(MOVIEMODE_PLAY))
+	{
+		error = "cannot play movie";
+		FCEUI_CloseGame();
+		return false;
+	}
+	return true;
+}
+
+// false once the movie has ended
+static bool PlayDesyncFrame(void)
+{
+	if (currFrameCounter >= currMovieData.getNumRecords() || !FCEUMOV_Mode(MOVIEMODE_PLAY))
+		return false;
+
+	uint8 *gfx = NULL;
+	int32 *sound = NULL;
+	int32 ssize = 0;
+	FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+	return true;
+}
+
+// plays run up to the end of frame, tracing the instructions of that frame,
+// and takes the RAM it ends with
+static bool TraceDesyncRun(const char *movie, const std::string &rom, const FCEU_DesyncRun &run, int frame,
+	std::vector<FCEU_DesyncStep> &trace, std::vector<uint8> &ram, std::string &error)
+{
+	if (!StartDesyncRun(movie, rom, run, error))
+		return false;
+	while (currFrameCounter < frame - 1 && PlayDesyncFrame()) {}
+
+	if (frame > 0 && currFrameCounter == frame - 1)
+	{
+		X6502_MemHook::Add(X6502_MemHook::Exec, DesyncTraceHook, &trace);
+		PlayDesyncFrame();
+		X6502_MemHook::Remove(X6502_MemHook::Exec, DesyncTraceHook, &trace);
+	}
+	ram.assign(RAM, RAM + 0x800);
+	return true;
+}
+
+// the hashes of run a, one per frame from power on
+struct DesyncHashes
+{
+	std::vector<uint64> hashes;
+	size_t next;
+#ifdef FCEU_WORKER_POOL
+	FCEU_StreamWorker worker;   // playing it, not started when it was played here
+	std::vector<u8> pending;
+#endif
+
+	DesyncHashes()
+		: next(0)
+	{
+	}
+
+	bool get(uint64 &hash)
+	{
+#ifdef FCEU_WORKER_POOL
+		while (next >= hashes.size() && worker.read(pending))
+		{
+			size_t whole = pending.size() / sizeof(uint64);
+			hashes.resize(whole);
+			memcpy(hashes.data(), pending.data(), whole * sizeof(uint64));
+			pending.erase(pending.begin(), pending.begin() + whole * sizeof(uint64));
+			next = 0;
+		}
+#endif
+		if (next >= hashes.size())
+			return false;
+		hash = hashes[next++];
+		return true;
+	}
+
+	// false when the worker failed; one still playing is not needed any more,
+	// the runs went apart
+	bool finish(void)
+	{
+#ifdef FCEU_WORKER_POOL
+		return worker.finish();
+#else
+		return true;
+#endif
+	}
+};
+
+#ifdef FCEU_WORKER_POOL
+// plays run in a forked copy of the emulator, which writes the hashes of
+// the frames as it goes; false when it could not be started
+static bool StartHashWorker(const char *movie, const std::string &rom, const FCEU_DesyncRun &run, DesyncHashes &hashes)
+{
+	return hashes.worker.start([&](FCEU_StreamWorker &worker)
+	{
+		std::string error;
+		if (!StartDesyncRun(movie, rom, run, error))
+			return false;
+
+		std::vector<uint64> block;
+		for (;;)
+		{
+			block.push_back(DesyncStateHash());
+			bool more = PlayDesyncFrame();
+			if (block.size() == DESYNC_HASH_BLOCK || !more)
+			{
+				if (!worker.write(block.data(), block.size() * sizeof(uint64)))
+					return false;
+				block.clear();
+			}
+			if (!more)
+				return true;
+		}
+	});
+}
+#endif
+
+bool FCEUI_BisectDesync(const char *movie, const char *rom, const FCEU_DesyncRun &a, const FCEU_DesyncRun &b,
+	int window, FCEU_DesyncResult &result)
+{
+	result = FCEU_DesyncResult();
+	result.movie = movie;
+
+	MovieData md;
+	if (!LoadMovieHeader(movie, md, result.error))
+		return false;
+	result.rom = (rom && *rom) ? rom : FindRom(movie, md);
+	if (result.rom.empty())
+	{
+		result.error = "ROM not found";
+		return false;
+	}
+
+	// put back afterwards
+	int realNewPPU = newppu;
+	int realRAMInit = RAMInitOption;
+	bool computeOnly = FCEUI_GetComputeOnly();
+	FCEUI_SetComputeOnly(true);
+
+	DesyncHashes hashesA;
+	bool started = false;
+#ifdef FCEU_WORKER_POOL
+	started = StartHashWorker(movie, result.rom, a, hashesA);
+#endif
+	if (!started && StartDesyncRun(movie, result.rom, a, result.error))
+	{
+		do
+			hashesA.hashes.push_back(DesyncStateHash());
+		while (PlayDesyncFrame());
+		started = true;
+	}
+
+	if (started && StartDesyncRun(movie, result.rom, b, result.error))
+	{
+		for (int frame = 0; ; frame++)
+		{
+			uint64 hash;
+			if (!hashesA.get(hash))
+				break;
+			if (hash != DesyncStateHash())
+			{
+				result.desyncFrame = frame;
+				break;
+			}
+			result.frames = frame;
+			if (!PlayDesyncFrame())
+				break;
+		}
+	}
+	if (!hashesA.finish() && result.error.empty())
+		result.error = "run a failed";
+
+	std::vector<FCEU_DesyncStep> traceA, traceB;
+	std::vector<uint8> ramA, ramB;
+	if (result.error.empty() && result.desyncFrame >= 0 &&
+		TraceDesyncRun(movie, result.rom, a, result.desyncFrame, traceA, ramA, result.error) &&
+		TraceDesyncRun(movie, result.rom, b, result.desyncFrame, traceB, ramB, result.error))
+	{
+		size_t n = std::min(traceA.size(), traceB.size());
+		size_t i = 0;
+		while (i < n && SameStep(traceA[i], traceB[i]))
+			i++;
+		if (i < traceA.size() || i < traceB.size())
+		{
+			size_t start = i > (size_t)window ? i - window : 0;
+			size_t end = i + window + 1;
+			result.instruction = (int)i;
+			result.traceStart = (int)start;
+			result.traceA.assign(traceA.begin() + std::min(start, traceA.size()), traceA.begin() + std::min(end, traceA.size()));
+			result.traceB.assign(traceB.begin() + std::min(start, traceB.size()), traceB.begin() + std::min(end, traceB.size()));
+		}
+		for (size_t addr = 0; addr < ramA.size() && result.ram.size() < DESYNC_RAM_DIFFS; addr++)
+		{
+			if (ramA[addr] == ramB[addr])
+				continue;
+			FCEU_DesyncRamDiff diff;
+			diff.address = (uint16)addr;
+			diff.a = ramA[addr];
+			diff.b = ramB[addr];
+			result.ram.push_back(diff);
+		}
+	}
+
+	FCEUI_StopMovie();
+	FCEUI_CloseGame();
+	if (newppu != realNewPPU)
+		FCEU_TogglePPU();
+	RAMInitOption = realRAMInit;
+	FCEUI_SetComputeOnly(computeOnly);
+	return result.error.empty();
+}
+
+//----------------------------------------------------------------------------
+// Report
+
+static std::string JsonString(const std::string &s)
+{
+	std::string out = "\"";
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		unsigned char c = s[i];
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if (c < 0x20)
+		{
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", c);
+			out += buf;
+		}
+		else
+			out += c;
+	}
+	return out + "\"";
+}
+
+static std::string JsonHash(uint64 hash)
+{
+	char buf[24];
+	snprintf(buf, sizeof(buf), "\"%016llx\"", (unsigned long long)hash);
+	return buf;
+}
+
+std::string FCEU_MovieVerifyReport(const std::vector<FCEU_MovieVerifyResult> &results)
+{
+	std::string json = "{\n  \"movies\": [";
+	int passed = 0;
+	char buf[256];
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const FCEU_MovieVerifyResult &r = results[i];
+		const char *status = !r.error.empty() ? "error" : r.mismatches ? "desync" : !r.romMatches ? "rom_mismatch" : "ok";
+
+		if (r.passed())
+			passed++;
+
+		json += i ? ",\n    {" : "\n    {";
+		json += "\"movie\": " + JsonString(r.movie);
+		json += ", \"rom\": " + JsonString(r.rom);
+		json += std::string(", \"status\": \"") + status + "\"";
+		if (!r.error.empty())
+			json += ", \"error\": " + JsonString(r.error);
+		snprintf(buf, sizeof(buf), ", \"rom_matches\": %s, \"frames\": %d, \"lag_frames\": %d",
+			r.romMatches ? "true" : "false", r.frames, r.lagFrames);
+		json += buf;
+		json += ", \"ram_hash\": " + JsonHash(r.ramHash);
+		json += ", \"frame_hash\": " + JsonHash(r.frameHash);
+		snprintf(buf, sizeof(buf), ", \"checkpoints\": %d, \"mismatches\": %d, \"desync_frame\": %d",
+			r.checkpoints, r.mismatches, r.desyncFrame);
+		json += buf;
+		if (!r.hashes.empty())
+		{
+			json += ", \"hashes\": [";
+			for (size_t j = 0; j < r.hashes.size(); j++)
+			{
+				snprintf(buf, sizeof(buf), "%s[%d, ", j ? ", " : "", r.hashes[j].first);
+				json += buf + JsonHash(r.hashes[j].second) + "]";
+			}
+			json += "]";
+		}
+		json += "}";
+	}
+
+	snprintf(buf, sizeof(buf), "\n  ],\n  \"passed\": %d,\n  \"failed\": %d\n}\n", passed, (int)results.size() - passed);
+	return json + buf;
+}
+
+static std::string JsonDesyncRun(const FCEU_DesyncRun &run)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "{\"new_ppu\": %d, \"ram_init\": %d}", run.newPPU, run.ramInit);
+	return buf;
+}
+
+static std::string JsonDesyncTrace(const std::vector<FCEU_DesyncStep> &trace)
+{
+	std::string json = "[";
+	char buf[128];
+
+	for (size_t i = 0; i < trace.size(); i++)
+	{
+		const FCEU_DesyncStep &s = trace[i];
+		snprintf(buf, sizeof(buf), "%s\n    \"%04X A:%02X X:%02X Y:%02X S:%02X P:%02X CYC:%llu RAM:%016llx\"",
+			i ? "," : "", s.pc, s.a, s.x, s.y, s.s, s.p, (unsigned long long)s.cycle, (unsigned long long)s.ramHash);
+		json += buf;
+	}
+	return json + (trace.empty() ? "]" : "\n  ]");
+}
+
+std::string FCEU_DesyncReport(const FCEU_DesyncResult &result, const FCEU_DesyncRun &a, const FCEU_DesyncRun &b)
+{
+	const char *status = !result.error.empty() ? "error" : result.desyncFrame >= 0 ? "desync" : "match";
+	std::string json = "{\n  \"movie\": " + JsonString(result.movie);
+	char buf[192];
+
+	json += ",\n  \"rom\": " + JsonString(result.rom);
+	json += std::string(",\n  \"status\": \"") + status + "\"";
+	if (!result.error.empty())
+		json += ",\n  \"error\": " + JsonString(result.error);
+	json += ",\n  \"run_a\": " + JsonDesyncRun(a);
+	json += ",\n  \"run_b\": " + JsonDesyncRun(b);
+	snprintf(buf, sizeof(buf), ",\n  \"frames\": %d,\n  \"desync_frame\": %d,\n  \"instruction\": %d,\n  \"trace_start\": %d",
+		result.frames, result.desyncFrame, result.instruction, result.traceStart);
+	json += buf;
+	json += ",\n  \"trace_a\": " + JsonDesyncTrace(result.traceA);
+	json += ",\n  \"trace_b\": " + JsonDesyncTrace(result.traceB);
+
+	json += ",\n  \"ram\": [";
+	for (size_t i = 0; i < result.ram.size(); i++)
+	{
+		snprintf(buf, sizeof(buf), "%s{\"address\": \"%04X\", \"a\": %d, \"b\": %d}",
+			i ? ", " : "", result.ram[i].address, result.ram[i].a, result.ram[i].b);
+		json += buf;
+	}
+	return json + "]\n}\n";
+}
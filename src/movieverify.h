@@ -0,0 +1,136 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// movieverify.h
+
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ *  Movie verification. Every movie is replayed from its start in compute-only
+ *  mode as fast as the host runs, on the ROM given or else the one the ROM
+ *  index (romscan.h) or the movie's directory has with the movie's
+ *  romChecksum. Where the platform can fork, the movies run in worker
+ *  processes, several at a time, so a crashing movie only loses its own entry.
+ *
+ *  A movie can carry "checkpoint <frame> <hash>" header lines with the RAM
+ *  hash a known good run has after that many frames. The first checkpoint
+ *  that does not match is reported as the desync.
+ */
+
+struct FCEU_MovieVerifyResult
+{
+	std::string movie;
+	std::string rom;        // ROM it was played on, "" if none was found
+	std::string error;      // why it could not be played, "" when it was
+	bool   romMatches;      // the ROM has the movie's romChecksum
+	int    frames;          // frames of the movie played
+	int    lagFrames;       // FCEUI_GetLagCount() at the end
+	uint64 ramHash;         // FCEU_MovieVerifyRamHash() at the end
+	uint64 frameHash;       // FCEUI_GetFrameHash() of the last frame
+	int    checkpoints;     // checkpoints compared
+	int    mismatches;      // of which did not match
+	int    desyncFrame;     // first one that did not match, -1 for none
+	std::vector<std::pair<int, uint64> > hashes;   // every interval frames, when asked for
+
+	FCEU_MovieVerifyResult();
+
+	// played to the end, on the right ROM, and every checkpoint matched
+	bool passed(void) const;
+};
+
+// XXH64 of the 2 KiB of CPU RAM, the hash checkpoints hold
+uint64 FCEU_MovieVerifyRamHash(void);
+
+// Replays one movie on the running core. rom may be "" to look it up.
+// interval > 0 also records the RAM hash every interval frames. The game and
+// movie loaded before are closed. Returns result.passed().
+bool FCEU_VerifyMovie(const char *movie, const char *rom, int interval, FCEU_MovieVerifyResult &result);
+
+// Verifies movies, jobs at a time (0 for one per core), and returns the
+// number that did not pass. results has one entry per movie, in order.
+int FCEUI_VerifyMovies(const std::vector<std::string> &movies, const char *rom, int jobs, int interval,
+	std::vector<FCEU_MovieVerifyResult> &results);
+
+// JSON report of results, with the pass and fail counts
+std::string FCEU_MovieVerifyReport(const std::vector<FCEU_MovieVerifyResult> &results);
+
+/*
+ *  Desync bisection. A movie is played under two settings (new or old PPU,
+ *  RAM init) and the RAM and CPU registers of both runs are hashed after
+ *  every frame. Where the platform can fork, run a plays in a worker in
+ *  lockstep with run b here, otherwise it is played first. The first frame
+ *  the hashes differ after is then played again in both runs with every
+ *  instruction's registers, cycle and RAM hash traced, and the two traces
+ *  are compared up to the first instruction that differs.
+ */
+
+struct FCEU_DesyncRun
+{
+	int newPPU;             // 1 new PPU, 0 old, -1 as set now
+	int ramInit;            // RAMInitOption, -1 for the movie's
+
+	FCEU_DesyncRun();
+};
+
+// the state before an instruction
+struct FCEU_DesyncStep
+{
+	uint16 pc;
+	uint8  a, x, y, s, p;
+	uint64 cycle;           // since power on
+	uint64 ramHash;
+};
+
+struct FCEU_DesyncRamDiff
+{
+	uint16 address;
+	uint8  a, b;
+};
+
+struct FCEU_DesyncResult
+{
+	std::string movie;
+	std::string rom;
+	std::string error;      // why it could not be played, "" when it was
+	int    frames;          // frames both runs agreed after
+	int    desyncFrame;     // first frame whose end differs (0: at power on), -1 for none
+	int    instruction;     // in that frame, of the first step that differs, -1 for none
+	int    traceStart;      // of traceA[0] and traceB[0] in that frame
+	std::vector<FCEU_DesyncStep> traceA, traceB;    // the window around instruction
+	std::vector<FCEU_DesyncRamDiff> ram;            // after desyncFrame, the first 64
+
+	FCEU_DesyncResult();
+};
+
+// Plays movie under run a and run b to the first difference. rom may be ""
+// to look it up. window steps before and after the first instruction that
+// differs are kept. The game and movie loaded before are closed, the PPU
+// and RAM init settings are put back. Returns false when there is no
+// result (result.error) and true otherwise, with or without a desync.
+bool FCEUI_BisectDesync(const char *movie, const char *rom, const FCEU_DesyncRun &a, const FCEU_DesyncRun &b,
+	int window, FCEU_DesyncResult &result);
+
+// JSON report of a bisection
+std::string FCEU_DesyncReport(const FCEU_DesyncResult &result, const FCEU_DesyncRun &a, const FCEU_DesyncRun &b);
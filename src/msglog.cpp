@@ -0,0 +1,343 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// msglog.cpp
+//
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "msglog.h"
+#include "driver.h"
+
+#define MSGLOG_SLOTS      256   // of each thread's ring
+#define MSGLOG_SLOT_TEXT  240
+#define MSGLOG_POLL_MS    10    // the logger looks at the rings this often
+
+// A message takes as many slots as its text needs, all but the last have
+// more set. seq orders the messages of all the threads.
+struct MsgLogSlot
+{
+	uint64 seq;
+	uint16 len;
+	uint8  more;
+	char   text[MSGLOG_SLOT_TEXT];
+};
+
+struct MsgLogRing
+{
+	MsgLogSlot slots[MSGLOG_SLOTS];
+	std::atomic<uint32> head;   // advanced by the thread
+	std::atomic<uint32> tail;   // advanced by the logger
+
+	// rate limit, a bucket of messages refilled at the rate
+	double tokens;
+	std::chrono::steady_clock::time_point refilled;
+
+	MsgLogRing *next;
+};
+
+static thread_local MsgLogRing *threadRing = nullptr;
+static thread_local bool isLogThread = false;
+
+// every thread that ever logged; never shrinks, so what a thread queued
+// before it ended still goes out
+static std::atomic<MsgLogRing*> ringList(nullptr);
+static std::mutex ringListMutex;
+
+static std::atomic<bool> logEnabled(false);
+static std::atomic<int> logRate(1000);
+static std::atomic<uint64> logSeq(0);
+
+static std::atomic<uint64> statQueued(0);
+static std::atomic<uint64> statWritten(0);
+static std::atomic<uint64> statDroppedFull(0);
+static std::atomic<uint64> statDroppedRate(0);
+static uint64 droppedReported = 0;
+
+static std::mutex logMutex;
+static std::condition_variable logCond;     // wakes the logger early
+static std::condition_variable logDrained;  // after each look at the rings
+static std::thread *logThread = NULL;
+static bool logQuit = false;
+static std::atomic<bool> logWake(false);
+
+static MsgLogRing *NewRing(void)
+{
+	MsgLogRing *ring = new MsgLogRing;
+
+	ring->head = 0;
+	ring->tail = 0;
+	ring->tokens = logRate.load();
+	ring->refilled = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(ringListMutex);
+
+	ring->next = ringList.load();
+	ringList.store(ring, std::memory_order_release);
+
+	return ring;
+}
+
+// Hands the queued messages over, oldest first. Only the logger thread, or
+// the thread stopping it once it is gone, runs this.
+static void MsgLogDrain(void)
+{
+	std::string msg;
+
+	for (;;)
+	{
+		MsgLogRing *oldest = NULL;
+		uint64 oldestSeq = 0;
+
+		for (MsgLogRing *ring = ringList.load(std::memory_order_acquire); ring; ring = ring->next)
+		{
+			uint32 tail = ring->tail.load(std::memory_order_relaxed);
+
+			if (tail == ring->head.load(std::memory_order_acquire))
+				continue;
+
+			uint64 seq = ring->slots[tail % MSGLOG_SLOTS].seq;
+
+			if (!oldest || seq < oldestSeq)
+			{
+				oldest = ring;
+				oldestSeq = seq;
+			}
+		}
+		if (!oldest)
+			break;
+
+		uint32 tail = oldest->tail.load(std::memory_order_relaxed);
+		const MsgLogSlot *slot;
+
+		msg.clear();
+		do
+		{
+			slot = &oldest->slots[tail % MSGLOG_SLOTS];
+			msg.append(slot->text, slot->len);
+			tail++;
+		} while (slot->more);
+
+		oldest->tail.store(tail, std::memory_order_release);
+
+		FCEUD_Message(msg.c_str());
+		statWritten++;
+	}
+
+	uint64 dropped = statDroppedFull.load() + statDroppedRate.load();
+
+	if (dropped != droppedReported)
+	{
+		char line[96];
+		snprintf(line, sizeof(line), "[%llu log messages dropped]\n", (unsigned long long)(dropped - droppedReported));
+		droppedReported = dropped;
+		FCEUD_Message(line);
+	}
+}
+
+static void MsgLogLoop(void)
+{
+	isLogThread = true;
+
+	std::unique_lock<std::mutex> lock(logMutex);
+
+	for (;;)
+	{
+		logCond.wait_for(lock, std::chrono::milliseconds(MSGLOG_POLL_MS), []{ return logQuit || logWake.load(); });
+		logWake = false;
+
+		bool quit = logQuit;
+
+		lock.unlock();
+		MsgLogDrain();
+		lock.lock();
+
+		logDrained.notify_all();
+
+		if (quit)
+			break;
+	}
+}
+
+void FCEU_SetAsyncMsgLog(bool enable, int rate)
+{
+	logRate = rate > 0 ? rate : 0;
+
+	if (!enable)
+	{
+		FCEU_MsgLogStop();
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(logMutex);
+
+	if (!logThread)
+	{
+		logQuit = false;
+		logThread = new std::thread(MsgLogLoop);
+	}
+	logEnabled = true;
+}
+
+bool FCEU_AsyncMsgLogEnabled(void)
+{
+	return logEnabled.load(std::memory_order_relaxed);
+}
+
+bool FCEU_MsgLogPut(const char *text)
+{
+	if (!logEnabled.load(std::memory_order_relaxed) || isLogThread)
+		return false;
+
+	MsgLogRing *ring = threadRing;
+
+	if (!ring)
+		ring = threadRing = NewRing();
+
+	int rate = logRate.load(std::memory_order_relaxed);
+
+	if (rate)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double>(now - ring->refilled).count();
+
+		ring->refilled = now;
+		ring->tokens += elapsed * rate;
+		if (ring->tokens > rate)
+			ring->tokens = rate;
+
+		if (ring->tokens < 1.0)
+		{
+			statDroppedRate++;
+			return true;
+		}
+		ring->tokens -= 1.0;
+	}
+
+	size_t len = strlen(text);
+	uint32 count = len ? (uint32)((len + MSGLOG_SLOT_TEXT - 1) / MSGLOG_SLOT_TEXT) : 1;
+	uint32 head = ring->head.load(std::memory_order_relaxed);
+	uint32 tail = ring->tail.load(std::memory_order_acquire);
+
+	if (count > MSGLOG_SLOTS - (head - tail))
+	{
+		statDroppedFull++;
+		return true;
+	}
+	uint64 seq = logSeq.fetch_add(1, std::memory_order_relaxed);
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		MsgLogSlot &slot = ring->slots[(head + i) % MSGLOG_SLOTS];
+		size_t n = len - i * MSGLOG_SLOT_TEXT;
+
+		if (n > MSGLOG_SLOT_TEXT)
+			n = MSGLOG_SLOT_TEXT;
+
+		memcpy(slot.text, text + i * MSGLOG_SLOT_TEXT, n);
+		slot.len  = (uint16)n;
+		slot.more = (i + 1 < count);
+		slot.seq  = seq;
+	}
+	ring->head.store(head + count, std::memory_order_release);
+
+	// past half full, the logger is woken instead of left to its next look
+	if (head + count - tail > MSGLOG_SLOTS / 2 && !logWake.exchange(true))
+		logCond.notify_one();
+
+	statQueued++;
+	return true;
+}
+
+void FCEU_MsgLogFlush(void)
+{
+	if (isLogThread)
+		return;
+
+	// where each thread had got to
+	std::vector<std::pair<MsgLogRing*, uint32> > marks;
+
+	for (MsgLogRing *ring = ringList.load(std::memory_order_acquire); ring; ring = ring->next)
+	{
+		marks.push_back(std::make_pair(ring, ring->head.load(std::memory_order_acquire)));
+	}
+
+	std::unique_lock<std::mutex> lock(logMutex);
+
+	if (!logThread)
+		return;
+
+	logWake = true;
+	logCond.notify_one();
+
+	logDrained.wait(lock, [&]
+	{
+		if (!logThread)
+			return true;
+
+		for (size_t i = 0; i < marks.size(); i++)
+		{
+			if ((int32)(marks[i].first->tail.load(std::memory_order_acquire) - marks[i].second) < 0)
+				return false;
+		}
+		return true;
+	});
+}
+
+void FCEU_MsgLogStop(void)
+{
+	std::thread *thread;
+
+	logEnabled = false;
+	{
+		std::lock_guard<std::mutex> lock(logMutex);
+
+		thread = logThread;
+		if (!thread)
+			return;
+
+		logQuit = true;
+		logCond.notify_one();
+	}
+	thread->join();
+	delete thread;
+
+	// what was put while the logger finished
+	MsgLogDrain();
+
+	std::lock_guard<std::mutex> lock(logMutex);
+
+	logThread = NULL;
+	logDrained.notify_all();
+}
+
+void FCEU_MsgLogGetStats(FCEU_MsgLogStats *stats)
+{
+	stats->queued      = statQueued.load();
+	stats->written     = statWritten.load();
+	stats->droppedFull = statDroppedFull.load();
+	stats->droppedRate = statDroppedRate.load();
+}
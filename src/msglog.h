@@ -0,0 +1,65 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// msglog.h
+
+#pragma once
+
+#include "types.h"
+
+/*
+ *  Asynchronous message log. While it is on, FCEU_printf() only copies its
+ *  formatted message into a ring of the calling thread, and a logger thread
+ *  hands the messages to FCEUD_Message() in the order they were logged.
+ *  Each ring has a single writer, so putting a message takes no lock. The
+ *  rings are bounded and never block: a message that does not fit, or that
+ *  comes over the thread's rate limit, is dropped and counted, and the
+ *  logger says how many were dropped once it has caught up.
+ *
+ *  Errors are not queued: FCEU_PrintError() waits for the queued messages
+ *  to go out before it shows the error, so the two stay in order.
+ *
+ *  The log is off unless the frontend turns it on. FCEUD_Message() is then
+ *  called from the logger thread and has to be safe to call there.
+ */
+
+struct FCEU_MsgLogStats
+{
+	uint64 queued;          // messages put into the rings
+	uint64 written;         // handed to FCEUD_Message()
+	uint64 droppedFull;     // the ring had no room for
+	uint64 droppedRate;     // over the rate limit
+};
+
+// rate is the messages a second each thread may log, 0 for no limit.
+// Turning it off hands over what is queued first.
+void FCEU_SetAsyncMsgLog(bool enable, int rate = 1000);
+bool FCEU_AsyncMsgLogEnabled(void);
+
+// Queues a formatted message. False when the log is off (or this is the
+// logger thread), then the caller has to print it itself.
+bool FCEU_MsgLogPut(const char *text);
+
+// Waits until the messages queued so far have been handed over
+void FCEU_MsgLogFlush(void);
+
+// Hands over the rest and stops the logger thread
+void FCEU_MsgLogStop(void);
+
+void FCEU_MsgLogGetStats(FCEU_MsgLogStats *stats);
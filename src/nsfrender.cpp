@@ -0,0 +1,284 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// nsfrender.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "git.h"
+#include "movie.h"
+#include "nsf.h"
+#include "wave.h"
+#include "nsfrender.h"
+#include "workerpool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// samples this close to zero count as silence, the sound filters take the
+// DC offset out once a track stops
+static const int32 SILENCE_LEVEL = 8;
+
+FCEU_NSFRenderResult::FCEU_NSFRenderResult()
+	: track(0), frames(0), samples(0), silent(false)
+{
+}
+
+FCEU_NSFRenderSettings::FCEU_NSFRenderSettings()
+	: rate(48000), quality(1), seconds(150), silence(0)
+{
+}
+
+// "out.wav" -> "out-07.wav", the digits as wide as the track count needs
+static std::string TrackOutput(const std::string &output, int track, int tracks)
+{
+	char number[16];
+	snprintf(number, sizeof(number), "-%0*d", tracks >= 100 ? 3 : 2, track);
+
+	size_t dot = output.find_last_of('.');
+	size_t sep = output.find_last_of("/\\");
+	if (dot == std::string::npos || (sep != std::string::npos && dot < sep))
+		return output + number;
+	return output.substr(0, dot) + number + output.substr(dot);
+}
+
+// Loads nsf, returns its track count or 0 when it is not an NSF
+static int LoadNSF(const char *nsf)
+{
+	FCEUI_StopMovie();
+	if (!FCEUI_LoadGame(nsf, 1, true))
+		return 0;
+	if (GameInfo->type != GIT_NSF)
+	{
+		FCEUI_CloseGame();
+		return 0;
+	}
+	uint8 name[4], artist[4], copyright[4];
+	return FCEUI_NSFGetInfo(name, artist, copyright, sizeof(name));
+}
+
+bool FCEU_RenderNSFTrack(const char *nsf, int track, const char *output, const FCEU_NSFRenderSettings &settings,
+	FCEU_NSFRenderResult &result)
+{
+	// output may be result.output itself
+	std::string path = output;
+	result = FCEU_NSFRenderResult();
+	result.track = track;
+	result.output = path;
+
+	int tracks = LoadNSF(nsf);
+	if (tracks == 0)
+	{
+		result.error = "cannot load NSF";
+		return false;
+	}
+	if (track < 1 || track > tracks)
+	{
+		result.error = "no such track";
+		FCEUI_CloseGame();
+		return false;
+	}
+
+	// the wave header takes the rate, so it is set before recording starts
+	int rate = FSettings.SndRate;
+	int quality = FSettings.soundq;
+	FCEUI_Sound(settings.rate);
+	FCEUI_SetSoundQuality(settings.quality);
+	FCEUI_NSFChange(track - FCEUI_NSFChange(0));
+
+	bool computeOnly = FCEUI_GetComputeOnly();
+	FCEUI_SetComputeOnly(false);
+
+	if (!FCEUI_BeginWaveRecord(path.c_str()))
+	{
+		result.error = "cannot write output";
+		FCEUI_SetComputeOnly(computeOnly);
+		FCEUI_Sound(rate);
+		FCEUI_SetSoundQuality(quality);
+		FCEUI_CloseGame();
+		return false;
+	}
+
+	const double total = settings.seconds * settings.rate;
+	const double silenceLimit = settings.silence * settings.rate;
+	bool started = false;
+	uint32 quiet = 0;
+
+	while (result.samples < total)
+	{
+		uint8 *gfx = NULL;
+		int32 *sound = NULL;
+		int32 ssize = 0;
+
+		// skip 1 still makes the sound, only the picture is left out
+		FCEUI_Emulate(&gfx, &sound, &ssize, 1);
+		result.frames++;
+		result.samples += ssize;
+
+		// silence only counts once the track has made a sound
+		for (int32 i = 0; i < ssize; i++)
+		{
+			if (sound[i] > SILENCE_LEVEL || sound[i] < -SILENCE_LEVEL)
+			{
+				started = true;
+				quiet = 0;
+			}
+			else if (started)
+				quiet++;
+		}
+		if (silenceLimit > 0 && started && quiet >= silenceLimit)
+		{
+			result.silent = true;
+			break;
+		}
+	}
+
+	FCEUI_EndWaveRecord();
+	FCEUI_SetComputeOnly(computeOnly);
+	FCEUI_Sound(rate);
+	FCEUI_SetSoundQuality(quality);
+	FCEUI_CloseGame();
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// Workers
+
+#ifdef FCEU_WORKER_POOL
+// what a worker sends back; the output name and track are known already
+struct NSFWorkerReply
+{
+	int32  frames;
+	uint32 samples;
+	uint8  silent;
+	char   error[64];
+};
+
+// one forked copy of the emulator per track, at most jobs at a time; the
+// tracks whose worker could not be started are left in pending
+static void RenderInWorkers(const char *nsf, const FCEU_NSFRenderSettings &settings, int jobs,
+	std::vector<size_t> &pending, std::vector<FCEU_NSFRenderResult> &results)
+{
+	FCEU_RunInWorkers(pending, jobs,
+		[&](size_t index, std::vector<uint8> &data)
+		{
+			FCEU_NSFRenderResult result;
+			FCEU_RenderNSFTrack(nsf, results[index].track, results[index].output.c_str(), settings, result);
+
+			NSFWorkerReply reply;
+			memset(&reply, 0, sizeof(reply));
+			reply.frames = result.frames;
+			reply.samples = result.samples;
+			reply.silent = result.silent;
+			strncpy(reply.error, result.error.c_str(), sizeof(reply.error) - 1);
+			data.assign((const uint8 *)&reply, (const uint8 *)&reply + sizeof(reply));
+		},
+		[&](size_t index, const std::vector<uint8> &data, const std::string &error)
+		{
+			FCEU_NSFRenderResult &result = results[index];
+			NSFWorkerReply reply;
+			if (!error.empty() || data.size() != sizeof(reply))
+			{
+				result.error = error.empty() ? "worker failed" : error;
+				return;
+			}
+			memcpy(&reply, &data[0], sizeof(reply));
+			reply.error[sizeof(reply.error) - 1] = 0;
+			result.frames = reply.frames;
+			result.samples = reply.samples;
+			result.silent = reply.silent != 0;
+			result.error = reply.error;
+		});
+}
+#endif
+
+int FCEUI_RenderNSF(const char *nsf, int track, const char *output, const FCEU_NSFRenderSettings &settings,
+	int jobs, std::vector<FCEU_NSFRenderResult> &results)
+{
+	results.clear();
+
+	int tracks = LoadNSF(nsf);
+	if (tracks == 0)
+		return -1;
+	FCEUI_CloseGame();
+	if (track < 0 || track > tracks)
+		return -1;
+
+	std::vector<size_t> pending;
+	int first = track ? track : 1;
+	int last = track ? track : tracks;
+	for (int t = first; t <= last; t++)
+	{
+		FCEU_NSFRenderResult result;
+		result.track = t;
+		result.output = track ? std::string(output) : TrackOutput(output, t, tracks);
+		pending.push_back(results.size());
+		results.push_back(result);
+	}
+
+	if (jobs <= 0)
+		jobs = std::max(1, (int)std::thread::hardware_concurrency());
+
+#ifdef FCEU_WORKER_POOL
+	// a single track is not worth a process
+	if (pending.size() > 1 && jobs > 1)
+		RenderInWorkers(nsf, settings, jobs, pending, results);
+#endif
+
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		FCEU_NSFRenderResult &result = results[pending[i]];
+		FCEU_RenderNSFTrack(nsf, result.track, result.output.c_str(), settings, result);
+	}
+
+	int failed = 0;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		if (!results[i].error.empty())
+			failed++;
+	}
+	return failed;
+}
+
+std::string FCEU_NSFRenderReport(const std::vector<FCEU_NSFRenderResult> &results)
+{
+	std::string report;
+	char buf[64];
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const FCEU_NSFRenderResult &r = results[i];
+
+		snprintf(buf, sizeof(buf), "track %d: ", r.track);
+		report += buf + r.output;
+		if (!r.error.empty())
+			report += ": " + r.error;
+		else
+		{
+			snprintf(buf, sizeof(buf), ", %u samples%s", r.samples, r.silent ? ", ended on silence" : "");
+			report += buf;
+		}
+		report += "\n";
+	}
+	return report;
+}
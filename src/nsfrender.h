@@ -0,0 +1,74 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// nsfrender.h
+
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+/*
+ *  NSF rendering. Each track is played from its start with the picture
+ *  skipped, as fast as the host runs, and its sound is written to a WAV file
+ *  through the sound recorder of wave.cpp. A track ends after the seconds
+ *  asked for, or earlier once it has been silent for the silence seconds.
+ *  Where the platform can fork, the tracks render in worker processes,
+ *  several at a time.
+ */
+
+struct FCEU_NSFRenderResult
+{
+	int         track;          // 1 based
+	std::string output;
+	std::string error;          // why it was not rendered, "" when it was
+	int         frames;         // frames played
+	uint32      samples;        // samples written
+	bool        silent;         // ended early on silence
+
+	FCEU_NSFRenderResult();
+};
+
+struct FCEU_NSFRenderSettings
+{
+	int    rate;                // sample rate, 48000 by default
+	int    quality;             // FCEUI_SetSoundQuality(), 1 by default
+	double seconds;             // length of each track, 150 by default
+	double silence;             // end a track after this much silence, 0 for never
+
+	FCEU_NSFRenderSettings();
+};
+
+// Renders one track of nsf to output on the running core. The game loaded
+// before is closed. Returns result.error.empty().
+bool FCEU_RenderNSFTrack(const char *nsf, int track, const char *output, const FCEU_NSFRenderSettings &settings,
+	FCEU_NSFRenderResult &result);
+
+// Renders track (0 for all of them) of nsf, jobs tracks at a time (0 for one
+// per core). With all tracks each output is named after output with the
+// track number added before the extension, "out.wav" giving "out-01.wav" and
+// on. Returns the number of tracks that failed, or -1 when nsf is not an NSF
+// or has no such track.
+int FCEUI_RenderNSF(const char *nsf, int track, const char *output, const FCEU_NSFRenderSettings &settings,
+	int jobs, std::vector<FCEU_NSFRenderResult> &results);
+
+// One line per track, for the command line
+std::string FCEU_NSFRenderReport(const std::vector<FCEU_NSFRenderResult> &results);
@@ -29,6 +29,7 @@
 #endif
 
 #include "palette.h"
+#include "startuptime.h"
 #include "palettes/palettes.h"
 
 #ifndef M_PI
@@ -175,8 +176,14 @@ int bisqwit_clamp(int v) { return v<0 ? 0 : v>255 ? 255 : v; }
 // Calculate the luma and chroma by emulating the relevant circuits:
 int bisqwit_wave(int p, int color) { return (color+p+8)%12 < 6; }
 
-static void ApplyDeemphasisBisqwit(int entry, u8& r, u8& g, u8& b)
+//the scale factors only depend on the entry, so they are worked out once for
+//all 512 entries; -1 for a channel that stays as it is.
+static float bisqwit_scales[64*8][3];
+static bool bisqwit_scales_valid = false;
+
+static void CalculateDeemphasisBisqwit(int entry, float scale[3])
 {
+	scale[0] = scale[1] = scale[2] = -1.f;
 	if(entry<64) return;
 	int myr=0, myg=0, myb=0;
 	// The input value is a NES color index (with de-emphasis bits).
@@ -200,7 +207,7 @@ static void ApplyDeemphasisBisqwit(int entry, u8& r, u8& g, u8& b)
 	//fceux alteration: two passes
 	//1st pass calculates bisqwit's base color
 	//2nd pass calculates it with deemph
-	//finally, we'll do something dumb: find a 'scale factor' between them and apply it to the input palette. (later, we could pregenerate the scale factors)
+	//finally, we'll do something dumb: find a 'scale factor' between them and apply it to the input palette.
 	//whatever, it gets the job done.
 	for(int pass=0;pass<2;pass++)
 	{
@@ -238,13 +245,9 @@ static void ApplyDeemphasisBisqwit(int entry, u8& r, u8& g, u8& b)
 		if(pass==0) myr = rt, myg = gt, myb = bt;
 		else
 		{
-			float rscale = (float)rt / myr;
-			float gscale = (float)gt / myg;
-			float bscale = (float)bt / myb;
-			#define BCLAMP(x) ((x)<0?0:((x)>255?255:(x)))
-			if(myr!=0) r = (u8)(BCLAMP(r*rscale));
-			if(myg!=0) g = (u8)(BCLAMP(g*gscale));
-			if(myb!=0) b = (u8)(BCLAMP(b*bscale));
+			if(myr!=0) scale[0] = (float)rt / myr;
+			if(myg!=0) scale[1] = (float)gt / myg;
+			if(myb!=0) scale[2] = (float)bt / myb;
 		}
 	}
 
@@ -252,6 +255,22 @@ static void ApplyDeemphasisBisqwit(int entry, u8& r, u8& g, u8& b)
 
 }
 
+static void ApplyDeemphasisBisqwit(int entry, u8& r, u8& g, u8& b)
+{
+	if(!bisqwit_scales_valid)
+	{
+		for(int x=0;x<64*8;x++)
+			CalculateDeemphasisBisqwit(x,bisqwit_scales[x]);
+		bisqwit_scales_valid = true;
+	}
+	const float *scale = bisqwit_scales[entry];
+
+	#define BCLAMP(x) ((x)<0?0:((x)>255?255:(x)))
+	if(scale[0]>=0) r = (u8)(BCLAMP(r*scale[0]));
+	if(scale[1]>=0) g = (u8)(BCLAMP(g*scale[1]));
+	if(scale[2]>=0) b = (u8)(BCLAMP(b*scale[2]));
+}
+
 //classic algorithm
 FCEU_MAYBE_UNUSED
 static void ApplyDeemphasisClassic(int entry, u8& r, u8& g, u8& b)
@@ -280,6 +299,8 @@ static void ApplyDeemphasisClassic(int entry, u8& r, u8& g, u8& b)
 
 static void ApplyDeemphasisComplete(pal* pal512)
 {
+	FCEU_StartupPhase phase("palette_deemphasis");
+
 	//for each deemph level beyond 0
 	for(int i=0,idx=0;i<8;i++)
 	{
@@ -450,6 +471,8 @@ static void CalculatePalette(void)
  	if(!ntsccol_enable)
 		return;
 
+	FCEU_StartupPhase phase("palette_ntsc");
+
 	int x,z;
 	int r,g,b;
 	double s,luma,theta;
@@ -499,6 +522,8 @@ void FCEU_ResetPalette(void)
 {
 	if(GameInfo)
 	{
+		FCEU_StartupPhase phase("palette");
+
 		ChoosePalette();
 		WritePalette();
 	}
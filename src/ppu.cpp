@@ -36,11 +36,24 @@
 #include "input.h"
 #include "driver.h"
 #include "debug.h"
+#include "stageprof.h"
 		 
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
 
+#if !defined(NOSSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define PPU_SSE2
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#define PPU_SSSE3
+#include <tmmintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PPU_NEON
+#include <arm_neon.h>
+#endif
+
 #define VBlankON    (PPU[0] & 0x80)	//Generate VBlank NMI
 #define Sprite16    (PPU[0] & 0x20)	//Sprites 8x16/8x8
 #define BGAdrHI     (PPU[0] & 0x10)	//BG pattern adr $0000/$1000
@@ -322,6 +335,37 @@ static void makeppulut(void) {
 	}
 }
 
+//Writes the 8 pixels of a background tile row. pixdata holds one 4-bit
+//palette index per pixel (from ppulut1/2/3), lowest nibble first.
+static INLINE void ExpandTilePixels(uint8 *P, const uint8 *S, uint32 pixdata) {
+#if defined(PPU_SSSE3)
+	__m128i idx = _mm_unpacklo_epi8(_mm_cvtsi32_si128(pixdata & 0x0F0F0F0F),
+									_mm_cvtsi32_si128((pixdata >> 4) & 0x0F0F0F0F));
+	__m128i pal = _mm_loadu_si128((const __m128i*)S);
+	_mm_storel_epi64((__m128i*)P, _mm_shuffle_epi8(pal, idx));
+#elif defined(PPU_NEON)
+	uint8x8x2_t idx = vzip_u8(vcreate_u8(pixdata & 0x0F0F0F0F), vcreate_u8((pixdata >> 4) & 0x0F0F0F0F));
+	uint8x8x2_t pal = { { vld1_u8(S), vld1_u8(S + 8) } };
+	vst1_u8(P, vtbl2_u8(pal, idx.val[0]));
+#else
+	P[0] = S[pixdata & 0xF];
+	pixdata >>= 4;
+	P[1] = S[pixdata & 0xF];
+	pixdata >>= 4;
+	P[2] = S[pixdata & 0xF];
+	pixdata >>= 4;
+	P[3] = S[pixdata & 0xF];
+	pixdata >>= 4;
+	P[4] = S[pixdata & 0xF];
+	pixdata >>= 4;
+	P[5] = S[pixdata & 0xF];
+	pixdata >>= 4;
+	P[6] = S[pixdata & 0xF];
+	pixdata >>= 4;
+	P[7] = S[pixdata & 0xF];
+#endif
+}
+
 static int ppudead = 1;
 static int kook = 0;
 int fceuindbg = 0;
@@ -359,6 +403,41 @@ static int deempcnt[8];
 void (*GameHBIRQHook)(void), (*GameHBIRQHook2)(void);
 void (*PPU_hook)(uint32 A);
 
+static int32 hbIRQPending = 0;		//GameHBIRQHook calls not made yet
+static int32 hbIRQDeadline = 0;	//make them once this many are pending
+
+void FCEUPPU_SetHBIRQDeadline(int32 lines) {
+	//a generous cap keeps the catch up short for boards that go idle
+	if (lines > 0x1000)
+		lines = 0x1000;
+	hbIRQDeadline = lines;
+}
+
+void FCEUPPU_FlushHBIRQ(void) {
+	int32 lines = hbIRQPending;
+
+	hbIRQPending = 0;
+	hbIRQDeadline = 0;
+	if (GameHBIRQHook)
+		while (lines--)
+			GameHBIRQHook();
+}
+
+//For a fresh start or a loaded state, which already holds the counters
+void FCEUPPU_DiscardHBIRQ(void) {
+	hbIRQPending = 0;
+	hbIRQDeadline = 0;
+}
+
+static INLINE void CallHBIRQHook(void) {
+	if (hbIRQPending < hbIRQDeadline) {
+		hbIRQPending++;
+		return;
+	}
+	FCEUPPU_FlushHBIRQ();
+	GameHBIRQHook();
+}
+
 uint8 vtoggle = 0;
 uint8 XOffset = 0;
 uint8 SpriteDMA = 0; // $4014 / Writing $xx copies 256 bytes by reading from $xx00-$xxFF and writing to $2004 (OAM data)
@@ -366,6 +445,7 @@ uint8 SpriteDMA = 0; // $4014 / Writing $xx copies 256 bytes by reading from $xx
 uint32 TempAddr = 0, RefreshAddr = 0, DummyRead = 0, NTRefreshAddr = 0;
 
 static int maxsprites = 8;
+static bool spriteLinesDirty = true;	//OAM changed since BuildSpriteLines
 
 //scanline is equal to the current visible scanline we're on.
 int scanline;
@@ -382,6 +462,7 @@ uint8 UPALRAM[0x03];//for 0x4/0x8/0xC addresses in palette, the ones in
 #define VRAMADR(V)          &VPage[(V) >> 10][(V)]
 
 uint8* MMC5BGVRAMADR(uint32 A);
+uint8** MMC5BGVBanks(void);
 
 uint8 READPAL_MOTHEROFALL(uint32 A)
 {
@@ -395,6 +476,44 @@ uint8 READPAL_MOTHEROFALL(uint32 A)
 		return READPAL(A & 0x1F);
 }
 
+//$0000-$3EFF by 256 byte page, for the default read and write: base[A] is the
+//byte at A (biased like VPage), and bit is the page's 1K bank in ram, the
+//PPUCHRRAM or PPUNTARAM mask that says whether it can be written.
+struct PPUPAGE {
+	uint8 *base;
+	uint8 *ram;
+	uint8 bit;
+};
+
+static PPUPAGE ppuPages[0x3F];
+static bool ppuPagesDirty = true;
+
+void FCEUPPU_PagesChanged(void) {
+	ppuPagesDirty = true;
+}
+
+static void BuildPPUPages(void) {
+	for (int x = 0; x < 0x20; x++) {
+		ppuPages[x].base = VPage[x >> 2];
+		ppuPages[x].ram = &PPUCHRRAM;
+		ppuPages[x].bit = 1 << (x >> 2);
+	}
+	//$3000-$3EFF mirrors $2000-$2EFF
+	for (int x = 0x20; x < 0x3F; x++) {
+		int n = (x >> 2) & 3;
+		ppuPages[x].base = vnapage[n] - ((x & ~3) << 8);
+		ppuPages[x].ram = &PPUNTARAM;
+		ppuPages[x].bit = 1 << n;
+	}
+	ppuPagesDirty = false;
+}
+
+static INLINE PPUPAGE &GetPPUPage(uint32 A) {
+	if (ppuPagesDirty)
+		BuildPPUPages();
+	return ppuPages[A >> 8];
+}
+
 //this duplicates logic which is embedded in the ppu rendering code
 //which figures out where to get CHR data from depending on various hack modes
 //mostly involving mmc5.
@@ -419,8 +538,10 @@ int FCEUPPU_GetAttr(int ntnum, int xt, int yt) {
 	int refreshaddr = xt + yt * 32;
 	if (MMC5Hack && MMC5HackCHRMode == 1)
 		return (MMC5HackExNTARAMPtr[refreshaddr & 0x3ff] & 0xC0) >> 6;
-	else
-		return (vnapage[ntnum][attraddr] & (3 << temp)) >> temp;
+	else {
+		uint32 A = 0x2000 + (ntnum << 10) + attraddr;
+		return (GetPPUPage(A).base[A] & (3 << temp)) >> temp;
+	}
 }
 
 //new ppu-----
@@ -429,15 +550,16 @@ inline void FFCEUX_PPUWrite_Default(uint32 A, uint8 V) {
 
 	if (PPU_hook) PPU_hook(A);
 
-	if (tmp < 0x2000) {
-		if (PPUCHRRAM & (1 << (tmp >> 10)))
-			VPage[tmp >> 10][tmp] = V;
-	} else if (tmp < 0x3F00) {
-		if (QTAIHack && (qtaintramreg & 1)) {
+	if (tmp < 0x3F00) {
+		if (QTAIHack && (qtaintramreg & 1) && tmp >= 0x2000) {
 			QTAINTRAM[((((tmp & 0xF00) >> 10) >> ((qtaintramreg >> 1)) & 1) << 10) | (tmp & 0x3FF)] = V;
 		} else {
-			if (PPUNTARAM & (1 << ((tmp & 0xF00) >> 10)))
-				vnapage[((tmp & 0xF00) >> 10)][tmp & 0x3FF] = V;
+			PPUPAGE &page = GetPPUPage(tmp);
+			if (*page.ram & page.bit) {
+				page.base[tmp] = V;
+				if (tmp < 0x2000)
+					CHRPageVersion[tmp >> 10]++;
+			}
 		}
 	} else {
 		if (!(tmp & 3)) {
@@ -530,10 +652,8 @@ uint8 FASTCALL FFCEUX_PPURead_Default(uint32 A) {
 
 	if (PPU_hook) PPU_hook(A);
 
-	if (tmp < 0x2000) {
-		return VPage[tmp >> 10][tmp];
-	} else if (tmp < 0x3F00) {
-		return vnapage[(tmp >> 10) & 0x3][tmp & 0x3FF];
+	if (tmp < 0x3F00) {
+		return GetPPUPage(tmp).base[tmp];
 	} else {
 		uint8 ret;
 		if (!(tmp & 3)) {
@@ -555,6 +675,30 @@ void (*FFCEUX_PPUWrite)(uint32 A, uint8 V) = 0;
 
 #define CALL_PPUWRITE(A, V) (FFCEUX_PPUWrite ? FFCEUX_PPUWrite(A, V) : FFCEUX_PPUWrite_Default(A, V))
 
+void FCEUPPU_ReadRange(uint32 A, uint8 *out, uint32 count) {
+	if (!FFCEUX_PPURead) {
+		memset(out, 0, count);
+		return;
+	}
+	//with the default read and no hook whole pages can be copied
+	bool direct = (FFCEUX_PPURead == FFCEUX_PPURead_Default) && !PPU_hook;
+
+	while (count > 0) {
+		uint32 n = 1;
+
+		if (direct && A < 0x3F00) {
+			n = 0x100 - (A & 0xFF);
+			if (n > count) n = count;
+			memcpy(out, GetPPUPage(A).base + A, n);
+		} else {
+			*out = FFCEUX_PPURead(A);
+		}
+		A += n;
+		out += n;
+		count -= n;
+	}
+}
+
 //whether to use the new ppu
 int newppu = 0;
 
@@ -891,6 +1035,7 @@ static DECLFW(B2004) {
 			V &= 0xE3;
 		SPRAM[PPU[3]] = V;
 		PPU[3] = (PPU[3] + 1) & 0xFF;
+		spriteLinesDirty = true;
 	} else {
 		if (PPUSPL >= 8) {
 			if (PPU[3] >= 8)
@@ -900,6 +1045,7 @@ static DECLFW(B2004) {
 		}
 		PPU[3]++;
 		PPUSPL++;
+		spriteLinesDirty = true;
 	}
 }
 
@@ -974,8 +1120,10 @@ static DECLFW(B2007) {
 	} else {
 		PPUGenLatch = V;
 		if (tmp < 0x2000) {
-			if (PPUCHRRAM & (1 << (tmp >> 10)))
+			if (PPUCHRRAM & (1 << (tmp >> 10))) {
 				VPage[tmp >> 10][tmp] = V;
+				CHRPageVersion[tmp >> 10]++;
+			}
 		} else if (tmp < 0x3F00) {
 			if (QTAIHack && (qtaintramreg & 1)) {
 				QTAINTRAM[((((tmp & 0xF00) >> 10) >> ((qtaintramreg >> 1)) & 1) << 10) | (tmp & 0x3FF)] = V;
@@ -1005,6 +1153,27 @@ static DECLFW(B4014) {
 	uint32 t = V << 8;
 	int x;
 
+	//A page of RAM or ROM is copied without going through the handlers, in
+	//the 512 cycles and to the same sprite bytes as the loop below
+	const uint8 *src = (BWrite[0x2004] == B2004) ? X6502_DMASource(t, 256) : NULL;
+	if (src) {
+		X6502_DMAStall(512);
+		if (PPU[3] == 0 && (newppu || PPUSPL == 0)) {
+			memcpy(SPRAM, src, 256);
+			spriteLinesDirty = true;
+			if (newppu)
+				for (x = 2; x < 256; x += 4)
+					SPRAM[x] &= 0xE3;
+			PPUGenLatch = src[255];
+		} else {
+			for (x = 0; x < 256; x++)
+				B2004(0x2004, src[x]);
+		}
+		X.DB = src[255];
+		SpriteDMA = V;
+		return;
+	}
+
 	for (x = 0; x < 256; x++)
 		X6502_DMW(0x2004, X6502_DMR(t + x));
 	SpriteDMA = V;
@@ -1046,6 +1215,10 @@ void FCEUPPU_LineUpdate(void) {
 	}
 }
 
+bool FCEUPPU_StatusSteady(void) {
+	return newppu || !Pline;
+}
+
 static bool rendersprites = true, renderbg = true;
 
 void FCEUI_SetRenderPlanes(bool sprites, bool bg) {
@@ -1160,25 +1333,42 @@ static void RefreshLine(int lastpixel) {
 	//This high-level graphics MMC5 emulation code was written for MMC5 carts in "CL" mode.
 	//It's probably not totally correct for carts in "SL" mode.
 
+	//The mode, the split and the bank set are looked up once for the part of
+	//the line drawn here, so that each tile is only fetched.
 #define PPUT_MMC5
 	if (MMC5Hack && geniestage != 1) {
+		uint8 **mmc5bgbanks = MMC5BGVBanks();
+
 		if (MMC5HackCHRMode == 0 && (MMC5HackSPMode & 0x80)) {
-			int tochange = MMC5HackSPMode & 0x1F;
-			tochange -= firsttile;
-			for (X1 = firsttile; X1 < lasttile; X1++) {
-				if ((tochange <= 0 && MMC5HackSPMode & 0x40) || (tochange > 0 && !(MMC5HackSPMode & 0x40))) {
-					#define PPUT_MMC5SP
+			//the split region is the tiles left of the target, or from it on
+			int target = MMC5HackSPMode & 0x1F;
+			bool right = (MMC5HackSPMode & 0x40) != 0;
+			int split = target < firsttile ? firsttile : (target > lasttile ? lasttile : target);
+
+			X1 = firsttile;
+			if (right) {
+				for (; X1 < split; X1++) {
 					#include "pputile.inc"
-					#undef PPUT_MMC5SP
-				} else {
+				}
+			} else {
+				#define PPUT_MMC5SP
+				for (; X1 < split; X1++) {
+					#include "pputile.inc"
+				}
+				#undef PPUT_MMC5SP
+			}
+			if (right) {
+				#define PPUT_MMC5SP
+				for (; X1 < lasttile; X1++) {
+					#include "pputile.inc"
+				}
+				#undef PPUT_MMC5SP
+			} else {
+				for (; X1 < lasttile; X1++) {
 					#include "pputile.inc"
 				}
-				tochange--;
 			}
 		} else if (MMC5HackCHRMode == 1 && (MMC5HackSPMode & 0x80)) {
-			int tochange = MMC5HackSPMode & 0x1F;
-			tochange -= firsttile;
-
 			#define PPUT_MMC5SP
 			#define PPUT_MMC5CHR1
 			for (X1 = firsttile; X1 < lasttile; X1++) {
@@ -1229,7 +1419,21 @@ static void RefreshLine(int lastpixel) {
 			}
 			#undef PPU_VRC5FETCH
 		} else {
-			for (X1 = firsttile; X1 < lasttile; X1++) {
+			X1 = firsttile;
+			// Compute-only mode: nothing looks at the pixels of a line without
+			// sprite 0, so only advance the VRAM address over its visible tiles.
+			// Tiles 32 and 33 are the prefetch for the next line and always run.
+			if (computeOnlyMode && sphitx == 0x100 && !debug_loggingCD && !InputScanlineHookActive()) {
+				for (; X1 < lasttile && X1 < 32; X1++) {
+					if (X1 >= 2)
+						P += 8;
+					if ((RefreshAddr & 0x1f) == 0x1f)
+						RefreshAddr ^= 0x41F;
+					else
+						RefreshAddr++;
+				}
+			}
+			for (; X1 < lasttile; X1++) {
 				#include "pputile.inc"
 			}
 		}
@@ -1312,6 +1516,8 @@ static void Fixit1(void) {
 
 void MMC5_hb(int);		//Ugh ugh ugh.
 static void DoLine(void) {
+	FCEU_StageScope stage(FCEU_STAGE_PPU_LINE);
+
 	if (scanline >= 240 && scanline != totalscanlines) {
 		X6502_Run(256 + 69);
 		scanline++;
@@ -1328,43 +1534,49 @@ static void DoLine(void) {
 	X6502_Run(256);
 	EndRL();
 
-	if (!renderbg) {// User asked to not display background data.
-		uint32 tem;
-		uint8 col;
-		if (gNoBGFillColor == 0xFF)
-			col = READPAL(0);
-		else col = gNoBGFillColor;
-		tem = col | (col << 8) | (col << 16) | (col << 24);
-		tem |= 0x40404040; 
-		FCEU_dwmemset(target, tem, 256);
-	}
+	// Compute-only mode has no use for the picture. Background fetches, sprite 0 hit
+	// and the mapper PPU hooks were already handled by EndRL(), the rest is pixel output.
+	if (computeOnlyMode) {
+		spork = 0;
+	} else {
+		if (!renderbg) {// User asked to not display background data.
+			uint32 tem;
+			uint8 col;
+			if (gNoBGFillColor == 0xFF)
+				col = READPAL(0);
+			else col = gNoBGFillColor;
+			tem = col | (col << 8) | (col << 16) | (col << 24);
+			tem |= 0x40404040; 
+			FCEU_dwmemset(target, tem, 256);
+		}
 
-	if (SpriteON)
-		CopySprites(target);
+		if (SpriteON)
+			CopySprites(target);
 
-	//greyscale handling (mask some bits off the color) ? ? ?
-	if (ScreenON || SpriteON)
-	{
-		if (PPU[1] & 0x01) {
-			for (x = 63; x >= 0; x--)
-				*(uint32*)&target[x << 2] = (*(uint32*)&target[x << 2]) & 0x30303030;
+		//greyscale handling (mask some bits off the color) ? ? ?
+		if (ScreenON || SpriteON)
+		{
+			if (PPU[1] & 0x01) {
+				for (x = 63; x >= 0; x--)
+					*(uint32*)&target[x << 2] = (*(uint32*)&target[x << 2]) & 0x30303030;
+			}
 		}
-	}
 
-	//some pathetic attempts at deemph
-	if ((PPU[1] >> 5) == 0x7) {
-		for (x = 63; x >= 0; x--)
-			*(uint32*)&target[x << 2] = ((*(uint32*)&target[x << 2]) & 0x3f3f3f3f) | 0xc0c0c0c0;
-	} else if (PPU[1] & 0xE0)
-		for (x = 63; x >= 0; x--)
-			*(uint32*)&target[x << 2] = (*(uint32*)&target[x << 2]) | 0x40404040;
-	else
-		for (x = 63; x >= 0; x--)
-			*(uint32*)&target[x << 2] = ((*(uint32*)&target[x << 2]) & 0x3f3f3f3f) | 0x80808080;
+		//some pathetic attempts at deemph
+		if ((PPU[1] >> 5) == 0x7) {
+			for (x = 63; x >= 0; x--)
+				*(uint32*)&target[x << 2] = ((*(uint32*)&target[x << 2]) & 0x3f3f3f3f) | 0xc0c0c0c0;
+		} else if (PPU[1] & 0xE0)
+			for (x = 63; x >= 0; x--)
+				*(uint32*)&target[x << 2] = (*(uint32*)&target[x << 2]) | 0x40404040;
+		else
+			for (x = 63; x >= 0; x--)
+				*(uint32*)&target[x << 2] = ((*(uint32*)&target[x << 2]) & 0x3f3f3f3f) | 0x80808080;
 
-	//write the actual deemph
-	for (x = 63; x >= 0; x--)
-		*(uint32*)&dtarget[x << 2] = ((PPU[1]>>5)<<0)|((PPU[1]>>5)<<8)|((PPU[1]>>5)<<16)|((PPU[1]>>5)<<24);
+		//write the actual deemph
+		for (x = 63; x >= 0; x--)
+			*(uint32*)&dtarget[x << 2] = ((PPU[1]>>5)<<0)|((PPU[1]>>5)<<8)|((PPU[1]>>5)<<16)|((PPU[1]>>5)<<24);
+	}
 
 	sphitx = 0x100;
 
@@ -1375,7 +1587,7 @@ static void DoLine(void) {
 		X6502_Run(6);
 		Fixit2();
 		X6502_Run(4);
-		GameHBIRQHook();
+		CallHBIRQHook();
 		X6502_Run(85 - 16 - 10);
 	} else {
 		X6502_Run(6);	// Tried 65, caused problems with Slalom(maybe others)
@@ -1384,7 +1596,7 @@ static void DoLine(void) {
 
 		// A semi-hack for Star Trek: 25th Anniversary
 		if (GameHBIRQHook && (ScreenON || SpriteON) && ((PPU[0] & 0x38) != 0x18))
-			GameHBIRQHook();
+			CallHBIRQHook();
 	}
 
 	DEBUG(FCEUD_UpdateNTView(scanline, 0));
@@ -1417,15 +1629,40 @@ void FCEUI_DisableSpriteLimitation(int a) {
 }
 
 static uint8 numsprites, SpriteBlurp;
+
+//The sprites in range of each line, in OAM order, so FetchSpriteData looks
+//them up instead of testing all 64. A sprite at Y 255 reaches line 270.
+//Built again on the next line fetched after OAM or the sprite height changes.
+#define SPRITE_LINES (256 + 16)
+static uint8 spriteLineCount[SPRITE_LINES];
+static uint8 spriteLineList[SPRITE_LINES][64];
+static uint8 spriteLinesHeight;
+
+void FCEUPPU_OAMChanged(void) {
+	spriteLinesDirty = true;
+}
+
+static void BuildSpriteLines(uint8 H) {
+	const SPR *spr = (const SPR*)SPRAM;
+
+	memset(spriteLineCount, 0, sizeof(spriteLineCount));
+	for (int n = 0; n < 64; n++) {
+		for (int line = spr[n].y; line < spr[n].y + H; line++)
+			spriteLineList[line][spriteLineCount[line]++] = n;
+	}
+	spriteLinesHeight = H;
+	spriteLinesDirty = false;
+}
+
 static void FetchSpriteData(void) {
 	uint8 ns, sb;
 	SPR *spr;
 	uint8 H;
-	int n;
+	int n, k, count;
+	const uint8 *list;
 	int vofs;
 	uint8 P0 = PPU[0];
 
-	spr = (SPR*)SPRAM;
 	H = 8;
 
 	ns = sb = 0;
@@ -1433,9 +1670,23 @@ static void FetchSpriteData(void) {
 	vofs = (uint32)(P0 & 0x8 & (((P0 & 0x20) ^ 0x20) >> 2)) << 9;
 	H += (P0 & 0x20) >> 2;
 
+	if (spriteLinesDirty || spriteLinesHeight != H)
+		BuildSpriteLines(H);
+	if ((uint32)scanline < SPRITE_LINES) {
+		list = spriteLineList[scanline];
+		count = spriteLineCount[scanline];
+	} else {
+		list = NULL;
+		count = 0;
+	}
+
+	//MMC5 fetches sprites from its own bank set, whatever their size
+	uint8 **sprbanks = (MMC5Hack && geniestage != 1) ? MMC5SPRVPage : VPage;
+
 	if (!PPU_hook)
-		for (n = 63; n >= 0; n--, spr++) {
-			if ((uint32)(scanline - spr->y) >= H) continue;
+		for (k = 0; k < count; k++) {
+			n = 63 - list[k];
+			spr = (SPR*)SPRAM + list[k];
 			if (ns < maxsprites) {
 				if (n == 63) sb = 1;
 
@@ -1462,11 +1713,7 @@ static void FetchSpriteData(void) {
 						vadr += t & 8;
 					}
 
-					/* Fix this geniestage hack */
-					if (MMC5Hack && geniestage != 1)
-						C = MMC5SPRVRAMADR(vadr);
-					else
-						C = VRAMADR(vadr);
+					C = &sprbanks[vadr >> 10][vadr];
 
 					if (SpriteON)
 						RENDER_LOGP(C);
@@ -1487,8 +1734,9 @@ static void FetchSpriteData(void) {
 			}
 		}
 	else
-		for (n = 63; n >= 0; n--, spr++) {
-			if ((uint32)(scanline - spr->y) >= H) continue;
+		for (k = 0; k < count; k++) {
+			n = 63 - list[k];
+			spr = (SPR*)SPRAM + list[k];
 
 			if (ns < maxsprites) {
 				if (n == 63) sb = 1;
@@ -1686,7 +1934,42 @@ static void CopySprites(uint8 *target) {
 	if(PPU[1] & 0x04)
 		start = 0;
 
-	for(int i=start;i<256;i++)
+	int i=start;
+#if defined(PPU_SSE2) || defined(PPU_NEON)
+	//the clipped left column leaves half a block to do one pixel at a time
+	for(;i&15;i++)
+	{
+		uint8 t = sprlinebuf[i];
+		if(!(t&0x80))
+			if (!(t & 0x40) || (P[i] & 0x40))
+				P[i] = t;
+	}
+
+	//same test as below, 16 pixels at a time
+	for(;i<256;i+=16)
+	{
+#if defined(PPU_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i bit6 = _mm_set1_epi8(0x40);
+		__m128i t = _mm_loadu_si128((const __m128i*)(sprlinebuf + i));
+		__m128i bg = _mm_loadu_si128((const __m128i*)(P + i));
+		__m128i opaque = _mm_cmpeq_epi8(_mm_and_si128(t, _mm_set1_epi8((char)0x80)), zero);
+		__m128i front = _mm_cmpeq_epi8(_mm_and_si128(t, bit6), zero);
+		__m128i bgclear = _mm_cmpeq_epi8(_mm_and_si128(bg, bit6), bit6);
+		__m128i take = _mm_and_si128(opaque, _mm_or_si128(front, bgclear));
+		_mm_storeu_si128((__m128i*)(P + i), _mm_or_si128(_mm_and_si128(take, t), _mm_andnot_si128(take, bg)));
+#else
+		uint8x16_t t = vld1q_u8(sprlinebuf + i);
+		uint8x16_t bg = vld1q_u8(P + i);
+		uint8x16_t opaque = vmvnq_u8(vtstq_u8(t, vdupq_n_u8(0x80)));
+		uint8x16_t front = vmvnq_u8(vtstq_u8(t, vdupq_n_u8(0x40)));
+		uint8x16_t bgclear = vtstq_u8(bg, vdupq_n_u8(0x40));
+		vst1q_u8(P + i, vbslq_u8(vandq_u8(opaque, vorrq_u8(front, bgclear)), t, bg));
+#endif
+	}
+#endif
+
+	for(;i<256;i++)
 	{
 		uint8 t = sprlinebuf[i];
 		if(!(t&0x80))
@@ -1738,6 +2021,8 @@ void FCEUPPU_Power(void) {
 	FCEU_MemoryRand(NTARAM, 0x800, true);
 	FCEU_MemoryRand(PALRAM, 0x20, true);
 	FCEU_MemoryRand(SPRAM, 0x100, true);
+	spriteLinesDirty = true;
+	ppuPagesDirty = true;
 	// palettes can only store values up to $3F, and PALRAM X4/X8/XC are mirrors of X0 for rendering purposes (UPALRAM is used for $2007 readback)
 	for (x = 0; x < 0x20; ++x) PALRAM[x] &= 0x3F;
 	UPALRAM[0] = PALRAM[0x04];
@@ -1746,6 +2031,7 @@ void FCEUPPU_Power(void) {
 	PALRAM[0x0C] = PALRAM[0x08] = PALRAM[0x04] = PALRAM[0x00];
 	PALRAM[0x1C] = PALRAM[0x18] = PALRAM[0x14] = PALRAM[0x10];
 	FCEUPPU_Reset();
+	FCEUPPU_DiscardHBIRQ();
 
 	for (x = 0x2000; x < 0x4000; x += 8) {
 		ARead[x] = A200x;
@@ -1765,10 +2051,19 @@ void FCEUPPU_Power(void) {
 		ARead[x + 7] = A2007;
 		BWrite[x + 7] = B2007;
 	}
+	UpdateCartReadPages(0x2000, 0x3FFF);
 	BWrite[0x4014] = B4014;
+	UpdateCartWritePages(0x2000, 0x4014);
 }
 
 int FCEUPPU_Loop(int skip) {
+	// the old PPU leaves the picture out in compute-only mode, neither draws
+	// while the PPU is waking up
+	if (GameInfo->type != GIT_NSF) {
+		bool drawn = !ppudead && (newppu || !computeOnlyMode);
+		FCEU_CountAdd(drawn ? FCEU_COUNTER_LINES_RENDERED : FCEU_COUNTER_LINES_SKIPPED, 240);
+	}
+
 	if ((newppu) && (GameInfo->type != GIT_NSF)) {
 		int FCEUX_PPU_Loop(int skip);
 		return FCEUX_PPU_Loop(skip);
@@ -1797,7 +2092,7 @@ int FCEUPPU_Loop(int skip) {
 				TriggerNMI();
 		}
 		X6502_Run((scanlines_per_frame - 242) * (256 + 85) - 12);
-		if (overclock_enabled && vblankscanlines) {
+		if (overclock_enabled && vblankscanlines && FCEU_OverclockNow()) {
 			if (!DMC_7bit || !skip_7bit_overclocking) {
 				overclocking = 1;
 				X6502_Run(vblankscanlines * (256 + 85) - 12);
@@ -1812,7 +2107,7 @@ int FCEUPPU_Loop(int skip) {
 
 			if (ScreenON || SpriteON) {
 				if (GameHBIRQHook && ((PPU[0] & 0x38) != 0x18))
-					GameHBIRQHook();
+					CallHBIRQHook();
 				if (PPU_hook)
 					for (x = 0; x < 42; x++) {
 						PPU_hook(0x2000); PPU_hook(0);
@@ -1847,7 +2142,7 @@ int FCEUPPU_Loop(int skip) {
 				X6502_Run(256);
 				for (scanline = 0; scanline < 240; scanline++) {
 					if (ScreenON || SpriteON)
-						GameHBIRQHook();
+						CallHBIRQHook();
 					if (scanline == y && SpriteON) PPU_status |= 0x40;
 					X6502_Run((scanline == 239) ? 85 : (256 + 85));
 				}
@@ -1876,6 +2171,10 @@ int FCEUPPU_Loop(int skip) {
 
 				DoLine();
 
+				// with lagOverclock only a frame that has not read input gets them
+				if (scanline == normalscanlines && totalscanlines > normalscanlines && !FCEU_OverclockNow())
+					totalscanlines = normalscanlines;
+
 				if (scanline < normalscanlines || scanline == totalscanlines)
 					overclocking = 0;
 				else {
@@ -1903,7 +2202,6 @@ int FCEUPPU_Loop(int skip) {
 
 	#ifdef FRAMESKIP
 	if (skip) {
-		FCEU_PutImageDummy();
 		return(0);
 	} else
 	#endif
@@ -1919,6 +2217,10 @@ static uint16 TempAddrT, RefreshAddrT;
 void FCEUPPU_LoadState(int version) {
 	TempAddr = TempAddrT;
 	RefreshAddr = RefreshAddrT;
+	// CHR RAM came back with the state, and OAM
+	FCEU_CHRPagesChanged();
+	spriteLinesDirty = true;
+	ppuPagesDirty = true;
 }
 
 SFORMAT FCEUPPU_STATEINFO[] = {
@@ -1995,7 +2297,9 @@ const int kLineTime = 341;
 const int kFetchTime = 2;
 
 void runppu(int x) {
-	ppur.status.cycle = (ppur.status.cycle + x) % ppur.status.end_cycle;
+	ppur.status.cycle += x;
+	if (ppur.status.cycle >= ppur.status.end_cycle)
+		ppur.status.cycle %= ppur.status.end_cycle;
 	if (!new_ppu_reset) // if resetting, suspend CPU until the first frame
 	{
 		X6502_Run(x);
@@ -2211,6 +2515,16 @@ int FCEUX_PPU_Loop(int skip) {
 
 			oamcount = oamcounts[renderslot];
 
+			//one bit per tile that has part of a sprite on it, so the pixel loop
+			//only walks the sprite list where there is something to find
+			uint32 spritetiles = 0;
+			for (int s = 0; s < oamcount; s++) {
+				const int x = oams[renderslot][s][3];
+				spritetiles |= 1u << (x >> 3);
+				if (x + 7 < 256)
+					spritetiles |= 1u << ((x + 7) >> 3);
+			}
+
 			//the main scanline rendering loop:
 			//32 times, we will fetch a tile and then render 8 pixels.
 			//two of those tiles were read in the last scanline.
@@ -2233,6 +2547,23 @@ int FCEUX_PPU_Loop(int skip) {
 					//check all the conditions that can cause things to render in these 8px
 					const bool renderspritenow = SpriteON && (xt > 0 || SpriteLeft8);
 					const bool renderbgnow = ScreenON && (xt > 0 || BGLeft8);
+					const bool spritesnow = (spritetiles >> xt) & 1;
+
+					//according to qeed's doc, use palette 0 or $2006's value if it is & 0x3Fxx
+					//(nothing below runs the ppu, so this holds for all 8 pixels)
+					uint8 blankpixel = 0;
+					uint8 blankcolor = blank;
+					if (!ScreenON && !SpriteON)
+					{
+						// if there's anything wrong with how we're doing this, someone please chime in
+						int addr = ppur.get_2007access();
+						if ((addr & 0x3F00) == 0x3F00)
+						{
+							blankpixel = addr & 0x1F;
+						}
+						blankcolor = READPAL_MOTHEROFALL(blankpixel);
+					}
+
 					for (int xp = 0; xp < 8; xp++, rasterpos++, g_rasterpos++) {
 						//bg pos is different from raster pos due to its offsetability.
 						//so adjust for that here
@@ -2240,20 +2571,8 @@ int FCEUX_PPU_Loop(int skip) {
 						const int bgpx = bgpos & 7;
 						const int bgtile = bgpos >> 3;
 
-						uint8 pixel = 0;
-						uint8 pixelcolor = blank;
-
-						//according to qeed's doc, use palette 0 or $2006's value if it is & 0x3Fxx
-						if (!ScreenON && !SpriteON)
-						{
-							// if there's anything wrong with how we're doing this, someone please chime in
-							int addr = ppur.get_2007access();
-							if ((addr & 0x3F00) == 0x3F00)
-							{
-								pixel = addr & 0x1F;
-							}
-							pixelcolor = READPAL_MOTHEROFALL(pixel);
-						}
+						uint8 pixel = blankpixel;
+						uint8 pixelcolor = blankcolor;
 
 						//generate the BG data
 						if (renderbgnow) {
@@ -2265,7 +2584,7 @@ int FCEUX_PPU_Loop(int skip) {
 
 						//look for a sprite to be drawn
 						bool havepixel = false;
-						for (int s = 0; s < oamcount; s++) {
+						for (int s = 0; spritesnow && s < oamcount; s++) {
 							uint8* oam = oams[renderslot][s];
 							int x = oam[3];
 							if (rasterpos >= x && rasterpos < x + 8) {
@@ -2447,7 +2766,7 @@ int FCEUX_PPU_Loop(int skip) {
 					//kirby requires deferring this til somewhere in sprite [2,5..
 					//if (PPUON && GameHBIRQHook) {
 					if (GameHBIRQHook) {
-						GameHBIRQHook();
+						CallHBIRQHook();
 					}
 				}
 
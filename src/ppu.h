@@ -4,11 +4,24 @@ void FCEUPPU_Power(void);
 int FCEUPPU_Loop(int skip);
 
 void FCEUPPU_LineUpdate();
+//True when $2002 reads cannot change until the CPU returns to the PPU,
+//that is outside the part of a line being drawn
+bool FCEUPPU_StatusSteady(void);
 void FCEUPPU_SetVideoSystem(int w);
 
 extern void (*PPU_hook)(uint32 A);
 extern void (*GameHBIRQHook)(void), (*GameHBIRQHook2)(void);
 
+//GameHBIRQHook is called on every rendered line unless the board schedules
+//its next event. After each call (or IRQ register write) a board whose hook
+//only counts lines can report how many calls would change nothing visible;
+//the PPU then only counts them and makes them all before the next one that
+//matters. The deadline has to be set again after every call.
+//Flush before reading or changing anything the hook counts.
+void FCEUPPU_SetHBIRQDeadline(int32 lines);
+void FCEUPPU_FlushHBIRQ(void);
+void FCEUPPU_DiscardHBIRQ(void);
+
 int newppu_get_scanline();
 int newppu_get_dot();
 void newppu_hacky_emergency_reset();
@@ -21,6 +34,14 @@ extern uint8 PPUCHRRAM;
 void FCEUPPU_SaveState(void);
 void FCEUPPU_LoadState(int version);
 uint32 FCEUPPU_PeekAddress();
+//For OAM changed other than through $2004, $4014, power and state loads: editors.
+void FCEUPPU_OAMChanged(void);
+//For VPage or vnapage changed other than through cart.cpp: the default PPU
+//read and write look them up in a table by 256 byte page.
+void FCEUPPU_PagesChanged(void);
+//count bytes from A on as FFCEUX_PPURead sees them, a page at a time when
+//nothing hooks the reads
+void FCEUPPU_ReadRange(uint32 A, uint8 *out, uint32 count);
 uint8* FCEUPPU_GetCHR(uint32 vadr, uint32 refreshaddr);
 int FCEUPPU_GetAttr(int ntnum, int xt, int yt);
 void ppu_getScroll(int &xpos, int &ypos);
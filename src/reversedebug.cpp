@@ -0,0 +1,483 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// reversedebug.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "debug.h"
+#include "git.h"
+#include "input.h"
+#include "movie.h"
+#include "netplay.h"
+#include "state.h"
+#include "x6502.h"
+#include "reversedebug.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#ifdef __FCEU_QNETWORK_ENABLE__
+extern bool NetPlayActive(void);
+#endif
+
+extern uint8 joy[4];
+extern bool justLagged;
+
+bool fceuReverseDebugTarget = false;
+bool fceuReverseDebugFastForward = false;
+
+struct ReverseSnap
+{
+	uint64 frame;          // taken at the start of it
+	uint64 instr;          // total_instructions then
+	int    frameCounter;   // the counters the frontend shows, outside of the snapshot
+	bool   justLagged;
+	std::vector<uint8> data;
+};
+
+struct ReverseFrame
+{
+	uint64 instr;          // total_instructions at the start of the frame
+	uint8  joy[4];         // the pads as the game saw them
+};
+
+static bool   enabled = false;
+static int    interval = 30;
+static size_t budget = 64 << 20;
+
+// frames[i] is frame firstFrame + i, the last one is curFrame; the first
+// snapshot is always taken at the start of firstFrame
+static std::deque<ReverseSnap>  snaps;
+static std::deque<ReverseFrame> frames;
+static uint64 firstFrame = 0;
+static uint64 curFrame = 0;
+static size_t snapBytes = 0;
+static std::vector<uint8> spare;   // buffer of the last snapshot dropped
+
+enum
+{
+	REQUEST_NONE = 0,
+	REQUEST_STEP,
+	REQUEST_CONTINUE,
+};
+
+static int    request = REQUEST_NONE;
+static uint64 requestFrom;         // total_instructions when it was made
+static uint64 requestDelta;        // delta_instructions then
+
+static uint64 target;              // while fceuReverseDebugTarget
+static int    targetBp;
+static bool   replayInput = false; // the pads come from the log until the frame ends
+static uint64 replayFrame;
+
+static bool   scanning = false;    // looking for the last breakpoint hit before scanLimit
+static uint64 scanLimit;
+static bool   scanHit;
+static uint64 scanHitInstr;
+static int    scanHitBp;
+
+static bool   restoring = false;   // a restore of our own, not one that drops the history
+
+static FCEU_ReverseDebugStats stats;
+
+//--------------------------------------------------------------------------
+static bool Recordable(void)
+{
+	// replaying has to come out the way it went: nothing else may feed
+	// the frames input or run them again behind our back
+	if (!enabled || !GameInfo || (GameInfo->type == GIT_NSF) || (GameInfo->type == GIT_VSUNI))
+		return false;
+	if (!FCEUMOV_Mode(MOVIEMODE_INACTIVE) || FCEUnetplay || FCEUI_GetRunAhead())
+		return false;
+#ifdef __FCEU_QNETWORK_ENABLE__
+	if (NetPlayActive())
+		return false;
+#endif
+	return true;
+}
+
+static size_t MemoryUsed(void)
+{
+	return snapBytes + snaps.size() * sizeof(ReverseSnap) + frames.size() * sizeof(ReverseFrame);
+}
+
+static void DropSnap(std::deque<ReverseSnap>::iterator it)
+{
+	snapBytes -= it->data.capacity();
+	if (it->data.capacity() > spare.capacity())
+		spare.swap(it->data);
+	snaps.erase(it);
+}
+
+static void Trim(void)
+{
+	while ((MemoryUsed() > budget) && (snaps.size() > 1))
+	{
+		DropSnap(snaps.begin());
+
+		while (firstFrame < snaps.front().frame)
+		{
+			frames.pop_front();
+			firstFrame++;
+		}
+	}
+}
+
+static bool TakeSnap(void)
+{
+	size_t size = FCEUSS_SnapshotSize();
+	ReverseSnap snap;
+
+	snap.data.swap(spare);
+	snap.data.resize(size);
+
+	if (!FCEUSS_Snapshot(snap.data.data(), size))
+		return false;
+
+	snap.frame = curFrame;
+	snap.instr = total_instructions;
+	snap.frameCounter = currFrameCounter;
+	snap.justLagged = justLagged;
+
+	snapBytes += snap.data.capacity();
+	snaps.push_back(std::move(snap));
+	return true;
+}
+
+static void RestoreSnap(const ReverseSnap &snap)
+{
+	restoring = true;
+	FCEUSS_Restore(snap.data.data(), snap.data.size());
+	restoring = false;
+
+	total_instructions = snap.instr;
+	currFrameCounter = snap.frameCounter;
+	justLagged = snap.justLagged;
+}
+
+//runs the logged frames [from, to) off screen with their input
+static void ReplayFrames(uint64 from, uint64 to, uint64 until = ~0ULL)
+{
+	replayInput = true;
+
+	for (uint64 f = from; (f < to) && (total_instructions < until); f++)
+	{
+		replayFrame = f;
+		FCEUI_EmulateOffscreen();
+		stats.framesReplayed++;
+	}
+}
+
+//the last breakpoint hit before requestFrom, snapshot by snapshot back
+static bool ScanBack(uint64 &to, int &bp)
+{
+	if (!numWPs)
+		return false;
+
+	int k = (int)snaps.size() - 1;
+	uint64 end = curFrame + 1;
+
+	while ((k >= 0) && (snaps[k].instr >= requestFrom))
+	{
+		end = snaps[k].frame;
+		k--;
+	}
+	scanning = true;
+	scanLimit = requestFrom;
+	scanHit = false;
+
+	for (; (k >= 0) && !scanHit; k--)
+	{
+		RestoreSnap(snaps[k]);
+		ReplayFrames(snaps[k].frame, end, requestFrom);
+		end = snaps[k].frame;
+	}
+	scanning = false;
+
+	if (scanHit)
+	{
+		to = scanHitInstr;
+		bp = scanHitBp;
+	}
+	return scanHit;
+}
+
+static void Diverged(void)
+{
+	FCEU_printf("Reverse debugging: the replay did not come out as recorded, history dropped.\n");
+	FCEU_ReverseDebugReset();
+	BreakHit(BREAK_TYPE_STEP);
+}
+
+//puts the machine at the start of the frame to, so that the frame breaks
+//when it is about to run it
+static void GoTo(uint64 to, int bp)
+{
+	size_t f = frames.size() - 1;
+
+	while ((f > 0) && (frames[f].instr > to))
+		f--;
+
+	uint64 frame = firstFrame + f;
+	int g = (int)snaps.size() - 1;
+
+	while ((g > 0) && (snaps[g].frame > frame))
+		g--;
+
+	RestoreSnap(snaps[g]);
+
+	fceuReverseDebugFastForward = true;
+	ReplayFrames(snaps[g].frame, frame);
+	fceuReverseDebugFastForward = false;
+
+	if (total_instructions != frames[f].instr)
+	{
+		Diverged();
+		return;
+	}
+
+	// what came after is gone over again, the new history starts here
+	frames.resize(f + 1);
+	while (snaps.back().frame > frame)
+		DropSnap(snaps.end() - 1);
+
+	curFrame = frame;
+	replayFrame = frame;
+	replayInput = true;
+
+	target = to;
+	targetBp = bp;
+	fceuReverseDebugTarget = true;
+}
+
+static void Replay(void)
+{
+	auto start = std::chrono::steady_clock::now();
+	int req = request;
+	uint64 to = requestFrom - 1;
+	int bp = BREAK_TYPE_STEP;
+
+	request = REQUEST_NONE;
+
+	if ((req == REQUEST_CONTINUE) && !ScanBack(to, bp))
+	{
+		// nothing hit in all of the history, go to the start of it
+		to = snaps.front().instr;
+	}
+	GoTo(to, bp);
+
+	stats.replays++;
+	stats.lastReplayMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	stats.totalReplayMs += stats.lastReplayMs;
+}
+
+//--------------------------------------------------------------------------
+void FCEU_ReverseDebugFrameStart(void)
+{
+	if (!Recordable())
+	{
+		if (!frames.empty() || request || fceuReverseDebugTarget)
+			FCEU_ReverseDebugReset();
+		return;
+	}
+
+	if (!frames.empty())
+	{
+		memcpy(frames.back().joy, joy, sizeof(joy));
+	}
+	replayInput = false;
+
+	if (fceuReverseDebugTarget)
+	{
+		// the frame ended before the instruction came
+		Diverged();
+	}
+	if (request)
+	{
+		Replay();
+		return;
+	}
+
+	curFrame++;
+	if (frames.empty())
+		firstFrame = curFrame;
+
+	ReverseFrame frame;
+	frame.instr = total_instructions;
+	memset(frame.joy, 0, sizeof(frame.joy));
+	frames.push_back(frame);
+
+	if (snaps.empty() || (curFrame - snaps.back().frame >= (uint64)interval))
+	{
+		if (!TakeSnap())
+		{
+			FCEU_ReverseDebugReset();
+			return;
+		}
+	}
+	Trim();
+}
+
+void FCEU_ReverseDebugInput(uint8 *pads)
+{
+	if (replayInput)
+	{
+		memcpy(pads, frames[replayFrame - firstFrame].joy, sizeof(joy));
+	}
+}
+
+bool FCEU_ReverseDebugReplaying(void)
+{
+	return replayInput;
+}
+
+bool FCEU_ReverseDebugCycle(void)
+{
+	if (total_instructions != target)
+		return false;
+
+	fceuReverseDebugTarget = false;
+
+	// the instructions gone back over no longer count as run
+	uint64 back = requestFrom - target;
+	delta_instructions = (requestDelta > back) ? requestDelta - back : 0;
+
+	BreakHit(targetBp);
+	return true;
+}
+
+bool FCEU_ReverseDebugBreakFilter(int bp_num)
+{
+	if (scanning)
+	{
+		if ((bp_num >= 0) && (total_instructions < scanLimit))
+		{
+			scanHit = true;
+			scanHitInstr = total_instructions;
+			scanHitBp = bp_num;
+		}
+		return false;
+	}
+	return !request && !fceuReverseDebugTarget && !fceuReverseDebugFastForward;
+}
+
+//--------------------------------------------------------------------------
+void FCEU_ReverseDebugReset(void)
+{
+	if (restoring)
+		return;
+
+	snaps.clear();
+	frames.clear();
+	snapBytes = 0;
+	std::vector<uint8>().swap(spare);
+
+	request = REQUEST_NONE;
+	replayInput = false;
+	scanning = false;
+	fceuReverseDebugTarget = false;
+	fceuReverseDebugFastForward = false;
+}
+
+void FCEUI_SetReverseDebug(bool enable)
+{
+	enabled = enable;
+	if (!enabled)
+		FCEU_ReverseDebugReset();
+}
+
+bool FCEUI_GetReverseDebug(void)
+{
+	return enabled;
+}
+
+void FCEUI_SetReverseDebugInterval(int frames)
+{
+	interval = std::max(1, frames);
+}
+
+int FCEUI_GetReverseDebugInterval(void)
+{
+	return interval;
+}
+
+void FCEUI_SetReverseDebugBudget(size_t bytes)
+{
+	budget = bytes;
+	Trim();
+}
+
+size_t FCEUI_GetReverseDebugBudget(void)
+{
+	return budget;
+}
+
+bool FCEUI_ReverseDebugCanStep(void)
+{
+	if (!Recordable() || snaps.empty() || request || fceuReverseDebugTarget)
+		return false;
+
+	return total_instructions > snaps.front().instr;
+}
+
+static bool RequestBack(int req)
+{
+	if (!FCEUI_ReverseDebugCanStep())
+		return false;
+
+	request = req;
+	requestFrom = total_instructions;
+	requestDelta = delta_instructions;
+
+	// nothing else may stop the rest of this frame
+	DebuggerState &dbgstate = FCEUI_Debugger();
+	dbgstate.step = false;
+	dbgstate.stepout = false;
+	dbgstate.runline = false;
+	watchpoint[64].address = 0;
+	watchpoint[64].flags = 0;
+
+	FCEUI_SetEmulationPaused(0);
+	return true;
+}
+
+bool FCEUI_ReverseStep(void)
+{
+	return RequestBack(REQUEST_STEP);
+}
+
+bool FCEUI_ReverseContinue(void)
+{
+	return RequestBack(REQUEST_CONTINUE);
+}
+
+void FCEUI_ReverseDebugGetStats(FCEU_ReverseDebugStats &out)
+{
+	out = stats;
+	out.memoryUsed = MemoryUsed();
+	out.memoryBudget = budget;
+	out.snapshots = (int)snaps.size();
+	out.historyFrames = frames.size();
+	out.oldestInstruction = snaps.empty() ? 0 : snaps.front().instr;
+}
@@ -0,0 +1,103 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// reversedebug.h
+
+#pragma once
+
+#include "types.h"
+
+/*
+ *  Reverse debugging. While enabled, a flat snapshot is taken at the start
+ *  of every Nth frame and the gamepad input of every frame is logged, both
+ *  kept within a memory budget by dropping the oldest. Going back to an
+ *  earlier instruction restores the newest snapshot before it and runs the
+ *  logged frames again in the lean CPU loop, then the frame the instruction
+ *  is in with the debugger on, stopping when total_instructions reaches it.
+ *
+ *  A request made while stopped at a break lets the rest of that frame run
+ *  without breaking, since the CPU cannot be restored in the middle of the
+ *  PPU loop; the replay happens at the start of the next one. Replayed
+ *  frames get their gamepad input from the log and run no Lua callbacks,
+ *  so the other input devices and anything a script does in a frame are
+ *  not played back. History is dropped when the machine changes in a way
+ *  the log does not cover: a savestate or snapshot load, power, reset, a
+ *  reset of the instruction counter or a new game. It is only recorded
+ *  with no movie, netplay or run-ahead, and not for NSF or VS games.
+ *
+ *  Everything but the hooks has to be called with the emulator locked.
+ */
+
+struct FCEU_ReverseDebugStats
+{
+	uint64 replays;           // reverse steps and continues done
+	uint64 framesReplayed;    // frames run again by them, scans included
+	double lastReplayMs;      // restore, scan and replay of the last one
+	double totalReplayMs;
+	size_t memoryUsed;        // snapshots and input log
+	size_t memoryBudget;
+	int    snapshots;
+	uint64 historyFrames;     // frames back the oldest snapshot is
+	uint64 oldestInstruction; // total_instructions at that snapshot
+};
+
+void FCEUI_SetReverseDebug(bool enable);
+bool FCEUI_GetReverseDebug(void);
+
+// Frames between snapshots, 1 or more; the fewer, the shorter a replay
+void FCEUI_SetReverseDebugInterval(int frames);
+int  FCEUI_GetReverseDebugInterval(void);
+
+void   FCEUI_SetReverseDebugBudget(size_t bytes);
+size_t FCEUI_GetReverseDebugBudget(void);
+
+// Back to the instruction before the current one, or to the last
+// breakpoint hit before it, the oldest one in the history when there is
+// none. False when there is no history to go to. Either unpauses the
+// emulator and it breaks again once there.
+bool FCEUI_ReverseStep(void);
+bool FCEUI_ReverseContinue(void);
+bool FCEUI_ReverseDebugCanStep(void);
+
+void FCEUI_ReverseDebugGetStats(FCEU_ReverseDebugStats &out);
+
+// Drops the history, the emulator goes on recording a new one
+void FCEU_ReverseDebugReset(void);
+
+// From FCEUI_Emulate, before the input of the frame is read
+void FCEU_ReverseDebugFrameStart(void);
+
+// From FCEU_UpdateInput, the pads replayed frames were played with
+void FCEU_ReverseDebugInput(uint8 *joy);
+
+// True while frames are being replayed; the pads are not sampled again
+// at the strobe then
+bool FCEU_ReverseDebugReplaying(void);
+
+// Set while DebugCycle() has to call FCEU_ReverseDebugCycle() on every
+// instruction, and while the debugger can leave the CPU in the lean loop
+extern bool fceuReverseDebugTarget;
+extern bool fceuReverseDebugFastForward;
+
+// True when it broke at the instruction being gone back to
+bool FCEU_ReverseDebugCycle(void);
+
+// From BreakHit(), false when the break is not for the user to see: it
+// comes from a frame being finished or replayed on the way back
+bool FCEU_ReverseDebugBreakFilter(int bp_num);
@@ -0,0 +1,355 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// romcache.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "emufile.h"
+#include "framehash.h"
+#include "file.h"
+#include "romcache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <direct.h>
+#endif
+
+#define ROMCACHE_MAGIC    "FCEURC01"
+#define ARCHIVEINDEX_MAGIC "FCEUAI01"
+#define ROMCACHE_MAXSTR   4096
+#define ARCHIVEINDEX_MAXFILES 1000000
+
+// An append only log of records, the last one for a key winning
+template<typename T>
+struct CacheLog
+{
+	const char *file;
+	const char *magic;
+	bool loaded;
+	std::map<std::string, T> entries;
+	size_t records; //in the file, superseded ones included
+
+	CacheLog(const char *f, const char *m) : file(f), magic(m), loaded(false), records(0) {}
+};
+
+static bool cacheEnabled = false;
+static CacheLog<FCEU_RomCacheEntry> romLog("index.dat", ROMCACHE_MAGIC);
+static CacheLog<ArchiveScanRecord> archiveLog("archives.dat", ARCHIVEINDEX_MAGIC);
+
+FCEU_RomCacheEntry::FCEU_RomCacheEntry()
+	: hashed(false), crc32(0), archiveCount(-1), archiveIndex(0)
+{
+	memset(header, 0, sizeof(header));
+	memset(md5, 0, sizeof(md5));
+}
+
+void FCEUI_SetRomCache(bool enable)
+{
+	cacheEnabled = enable;
+}
+
+bool FCEUI_GetRomCache(void)
+{
+	return cacheEnabled;
+}
+
+static std::string CacheDir(void)
+{
+	return std::string(FCEUI_GetBaseDirectory()) + PSS "romcache";
+}
+
+template<typename T>
+static std::string LogPath(const CacheLog<T> &log)
+{
+	return CacheDir() + PSS + log.file;
+}
+
+static bool MakeCacheDir(void)
+{
+	std::string dir = CacheDir();
+	struct stat st;
+
+	if (stat(dir.c_str(), &st) == 0)
+		return (st.st_mode & S_IFDIR) != 0;
+#ifdef WIN32
+	return _mkdir(dir.c_str()) == 0;
+#else
+	return mkdir(dir.c_str(), S_IRWXU) == 0;
+#endif
+}
+
+static void WriteString(EMUFILE &os, const std::string &str)
+{
+	os.write32le((u32)str.size());
+	os.fwrite(str.data(), str.size());
+}
+
+static bool ReadString(EMUFILE &is, std::string &str)
+{
+	u32 len;
+	if (is.read32le(&len) != 1 || len > ROMCACHE_MAXSTR)
+		return false;
+	str.resize(len);
+	return len == 0 || is.fread(&str[0], len) == len;
+}
+
+static void WriteRecord(EMUFILE &os, const std::string &key, const FCEU_RomCacheEntry &e)
+{
+	WriteString(os, key);
+	os.fputc(e.hashed ? 1 : 0);
+	os.fwrite(e.header, sizeof(e.header));
+	os.write32le(e.crc32);
+	os.fwrite(e.md5, sizeof(e.md5));
+	WriteString(os, e.image);
+	WriteString(os, e.filename);
+	os.write32le((s32)e.archiveCount);
+	os.write32le((s32)e.archiveIndex);
+}
+
+static bool ReadRecord(EMUFILE &is, std::string &key, FCEU_RomCacheEntry &e)
+{
+	s32 count, index;
+	int hashed;
+
+	if (!ReadString(is, key))
+		return false;
+	if ((hashed = is.fgetc()) < 0)
+		return false;
+	e.hashed = hashed != 0;
+	if (is.fread(e.header, sizeof(e.header)) != sizeof(e.header))
+		return false;
+	if (is.read32le(&e.crc32) != 1)
+		return false;
+	if (is.fread(e.md5, sizeof(e.md5)) != sizeof(e.md5))
+		return false;
+	if (!ReadString(is, e.image) || !ReadString(is, e.filename))
+		return false;
+	if (is.read32le(&count) != 1 || is.read32le(&index) != 1)
+		return false;
+	e.archiveCount = count;
+	e.archiveIndex = index;
+	return true;
+}
+
+static void WriteRecord(EMUFILE &os, const std::string &key, const ArchiveScanRecord &asr)
+{
+	WriteString(os, key);
+	os.write32le((s32)asr.type);
+	os.write32le((s32)asr.numFilesInArchive);
+	os.write32le((u32)asr.files.size());
+	for (size_t i = 0; i < asr.files.size(); i++)
+	{
+		const FCEUARCHIVEFILEINFO_ITEM &item = asr.files[i];
+		WriteString(os, item.name);
+		os.write32le(item.size);
+		os.write32le(item.index);
+		os.write32le(item.crc32);
+		os.write64le(item.dirPos);
+		os.write64le(item.fileNum);
+	}
+}
+
+static bool ReadRecord(EMUFILE &is, std::string &key, ArchiveScanRecord &asr)
+{
+	s32 type, numFiles;
+	u32 count;
+
+	if (!ReadString(is, key))
+		return false;
+	if (is.read32le(&type) != 1 || is.read32le(&numFiles) != 1 || is.read32le(&count) != 1)
+		return false;
+	if (count > ARCHIVEINDEX_MAXFILES)
+		return false;
+	asr.type = type;
+	asr.numFilesInArchive = numFiles;
+	asr.files.resize(count);
+	for (u32 i = 0; i < count; i++)
+	{
+		FCEUARCHIVEFILEINFO_ITEM &item = asr.files[i];
+		if (!ReadString(is, item.name))
+			return false;
+		if (is.read32le(&item.size) != 1 || is.read32le(&item.index) != 1 || is.read32le(&item.crc32) != 1)
+			return false;
+		if (is.read64le(&item.dirPos) != 1 || is.read64le(&item.fileNum) != 1)
+			return false;
+	}
+	return true;
+}
+
+template<typename T>
+static void RewriteLog(CacheLog<T> &log)
+{
+	std::string path = LogPath(log);
+	std::string temp = path + ".tmp";
+	{
+		EMUFILE_FILE os(temp, "wb");
+		if (os.fail())
+			return;
+		os.fwrite(log.magic, 8);
+		for (typename std::map<std::string, T>::const_iterator it = log.entries.begin(); it != log.entries.end(); ++it)
+			WriteRecord(os, it->first, it->second);
+		if (os.fail())
+			return;
+	}
+	remove(path.c_str());
+	if (rename(temp.c_str(), path.c_str()) == 0)
+		log.records = log.entries.size();
+}
+
+template<typename T>
+static void LoadLog(CacheLog<T> &log)
+{
+	char magic[8];
+
+	if (log.loaded)
+		return;
+	log.loaded = true;
+
+	EMUFILE_FILE is(LogPath(log), "rb");
+	if (is.fail() || is.fread(magic, 8) != 8 || memcmp(magic, log.magic, 8))
+		return;
+
+	std::string key;
+	T e;
+	//a record cut short by a crash ends the log
+	while (ReadRecord(is, key, e))
+	{
+		log.entries[key] = e;
+		log.records++;
+		e = T();
+	}
+
+	if (log.records > 2 * log.entries.size())
+		RewriteLog(log);
+}
+
+template<typename T>
+static bool FindLog(CacheLog<T> &log, const std::string &key, T &entry)
+{
+	LoadLog(log);
+
+	typename std::map<std::string, T>::const_iterator it = log.entries.find(key);
+	if (it == log.entries.end())
+		return false;
+	entry = it->second;
+	return true;
+}
+
+template<typename T>
+static void StoreLog(CacheLog<T> &log, const std::string &key, const T &entry)
+{
+	LoadLog(log);
+	log.entries[key] = entry;
+
+	if (!MakeCacheDir())
+		return;
+
+	std::string path = LogPath(log);
+	bool fresh = false;
+	{
+		FILE *fp = fopen(path.c_str(), "rb");
+		if (fp)
+			fclose(fp);
+		else
+			fresh = true;
+	}
+
+	EMUFILE_FILE os(path, "ab");
+	if (os.fail())
+		return;
+	if (fresh)
+		os.fwrite(log.magic, 8);
+	WriteRecord(os, key, entry);
+	log.records++;
+}
+
+bool FCEU_RomCacheKey(std::string &key, const std::string &path, const std::string &inner, int index)
+{
+	struct stat st;
+	char buf[64];
+
+	if (!cacheEnabled || stat(path.c_str(), &st) != 0)
+		return false;
+
+	snprintf(buf, sizeof(buf), "|%d|%llu|%lld", index, (unsigned long long)st.st_size, (long long)st.st_mtime);
+	key = path + "|" + inner + buf;
+	return true;
+}
+
+bool FCEU_RomCacheFind(const std::string &key, FCEU_RomCacheEntry &entry)
+{
+	if (!cacheEnabled || key.empty())
+		return false;
+	return FindLog(romLog, key, entry);
+}
+
+void FCEU_RomCacheStore(const std::string &key, const FCEU_RomCacheEntry &entry)
+{
+	if (!cacheEnabled || key.empty())
+		return;
+	StoreLog(romLog, key, entry);
+}
+
+bool FCEU_ArchiveIndexFind(const std::string &path, const char *reader, ArchiveScanRecord &asr)
+{
+	std::string key;
+
+	if (!FCEU_RomCacheKey(key, path, reader, -1))
+		return false;
+	return FindLog(archiveLog, key, asr);
+}
+
+void FCEU_ArchiveIndexStore(const std::string &path, const char *reader, const ArchiveScanRecord &asr)
+{
+	std::string key;
+
+	if (!FCEU_RomCacheKey(key, path, reader, -1))
+		return;
+	StoreLog(archiveLog, key, asr);
+}
+
+bool FCEU_RomCacheWriteImage(const std::string &key, FCEU_RomCacheEntry &entry, const uint8 *data, size_t size)
+{
+	char name[32];
+
+	if (!cacheEnabled || key.empty() || !MakeCacheDir())
+		return false;
+
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)FCEU_XXH64(key.data(), key.size(), 0));
+	std::string path = CacheDir() + PSS + name;
+	{
+		EMUFILE_FILE os(path, "wb");
+		if (os.fail())
+			return false;
+		os.fwrite(data, size);
+		if (os.fail())
+		{
+			remove(path.c_str());
+			return false;
+		}
+	}
+	entry.image = path;
+	return true;
+}
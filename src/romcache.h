@@ -0,0 +1,92 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// romcache.h
+
+#pragma once
+
+#include "types.h"
+
+#include <string>
+
+/*
+ *  ROM load cache, for batch jobs that switch ROMs thousands of times an
+ *  hour. Off by default, see FCEUI_SetRomCache().
+ *
+ *  An entry is keyed on the file opened (the archive for a ROM inside one),
+ *  the file inside it when one was asked for, its size and its modification
+ *  time, so touching or replacing the file makes a new key. It remembers:
+ *
+ *    - the iNES header, CRC32 and MD5 of the ROM, so a repeat iNESLoad()
+ *      does not hash PRG and CHR again;
+ *    - for gzip, zip and other archives, where the ROM came from in the
+ *      archive and a decompressed copy of it, which repeat loads map from
+ *      disk instead of scanning and inflating the archive.
+ *
+ *  Everything lives in <base>/romcache/: index.dat, an append only log of
+ *  entries with the last record for a key winning, and one .bin file per
+ *  decompressed copy. The log is read on first use and rewritten when more
+ *  than half of it is superseded records. Copies of files that changed since
+ *  are not removed; deleting the directory is always safe.
+ *
+ *  The archive index, archives.dat, is kept the same way. It lists the files
+ *  in each archive opened, keyed on the archive's path, size and time, so a
+ *  ROM pack of thousands of entries is only read through once; for zips it
+ *  has where each entry is in the central directory and its CRC32.
+ */
+
+struct ArchiveScanRecord;
+
+struct FCEU_RomCacheEntry
+{
+	// set by iNESLoad(), hashed is false until then
+	bool   hashed;
+	uint8  header[16];
+	uint32 crc32;
+	uint8  md5[16];
+
+	// set by FCEU_fopen() for compressed files, image is "" otherwise
+	std::string image;
+	std::string filename;      // name inside the archive
+	int    archiveCount;
+	int    archiveIndex;
+
+	FCEU_RomCacheEntry();
+};
+
+void FCEUI_SetRomCache(bool enable);
+bool FCEUI_GetRomCache(void);
+
+// Builds the key of a file about to be opened. inner and index name the
+// file inside an archive, "" and -1 for none. False when the cache is off
+// or the file can not be examined.
+bool FCEU_RomCacheKey(std::string &key, const std::string &path, const std::string &inner, int index);
+
+bool FCEU_RomCacheFind(const std::string &key, FCEU_RomCacheEntry &entry);
+
+// Adds or replaces the entry of key, in memory and in index.dat
+void FCEU_RomCacheStore(const std::string &key, const FCEU_RomCacheEntry &entry);
+
+// reader tells apart lists of the same archive made in different ways,
+// "scan" for FCEUD_ScanArchive() and "zip" for FCEU_ScanZip()
+bool FCEU_ArchiveIndexFind(const std::string &path, const char *reader, ArchiveScanRecord &asr);
+void FCEU_ArchiveIndexStore(const std::string &path, const char *reader, const ArchiveScanRecord &asr);
+
+// Writes a decompressed copy for key and records it in entry.image
+bool FCEU_RomCacheWriteImage(const std::string &key, FCEU_RomCacheEntry &entry, const uint8 *data, size_t size);
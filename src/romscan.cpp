@@ -0,0 +1,694 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// romscan.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "git.h"
+#include "ines.h"
+#include "emufile.h"
+#include "romscan.h"
+#include "utils/crc32.h"
+#include "utils/md5.h"
+#include "utils/parallel.h"
+#ifdef _SYSTEM_MINIZIP
+#ifdef __linux
+#include <minizip/unzip.h>
+#else // Apple Most Likely
+#include <unzip.h>
+#endif
+#else
+#include "utils/unzip.h"
+#endif
+
+#ifndef WIN32
+#include <zlib.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#define ROMINDEX_MAGIC    "FCEURI01"
+#define ROMINDEX_MAXSTR   4096
+#define ROMSCAN_MAXFILE   (64 << 20)
+
+bool iNESScan(const uint8 *data, size_t size, const char *name, FCEU_RomScanEntry &entry);
+bool UNIFScan(const uint8 *data, size_t size, FCEU_RomScanEntry &entry);
+extern BMAPPINGLocal bmap[];
+
+// entries of each file on disk; several for an archive, in archive order
+typedef std::map<std::string, std::vector<FCEU_RomScanEntry> > RomIndex;
+
+FCEU_RomScanEntry::FCEU_RomScanEntry()
+	: fileSize(0), fileTime(0), format(ROMSCAN_UNKNOWN), mapper(-1), submapper(0),
+	  prgSize(0), chrSize(0), prgRam(0), prgNvram(0), chrRam(0), chrNvram(0),
+	  mirroring(-1), battery(false), trainer(false), vsSystem(false), region(ROMSCAN_NTSC),
+	  inputfc(SIFC_UNSET), sides(0), crc32(0)
+{
+	input[0] = input[1] = SI_UNSET;
+	memset(md5, 0, sizeof(md5));
+}
+
+std::string FCEU_RomIndexPath(void)
+{
+	return std::string(FCEUI_GetBaseDirectory()) + PSS "romindex.dat";
+}
+
+static bool StatFile(const std::string &path, uint64 &size, int64 &mtime, bool *isDir = nullptr)
+{
+	struct stat st;
+
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+	size = (uint64)st.st_size;
+	mtime = (int64)st.st_mtime;
+	if (isDir)
+		*isDir = (st.st_mode & S_IFDIR) != 0;
+	return true;
+}
+
+static bool HasExtension(const std::string &name, const char *const *exts)
+{
+	size_t dot = name.rfind('.');
+	if (dot == std::string::npos)
+		return false;
+	for (; *exts; exts++)
+	{
+		if (!strcasecmp(name.c_str() + dot + 1, *exts))
+			return true;
+	}
+	return false;
+}
+
+static const char *const romExtensions[] = { "nes", "nez", "unf", "unif", "fds", "nsf", 0 };
+static const char *const scanExtensions[] = { "nes", "nez", "unf", "unif", "fds", "nsf", "zip", "gz", 0 };
+
+//----------------------------------------------------------------------------
+// Parsing
+
+static bool FDSScan(const uint8 *data, size_t size, FCEU_RomScanEntry &entry)
+{
+	size_t pos = 0;
+	int sides;
+
+	// same side count and hashing as SubLoad() in fds.cpp
+	if (size >= 16 && !memcmp(data, "FDS\x1a", 4))
+	{
+		sides = data[4];
+		pos = 16;
+	}
+	else if (size >= 15 && !memcmp(data + 1, "*NINTENDO-HVC*", 14))
+		sides = (size < 65500) ? 1 : (int)(size / 65500);
+	else
+		return false;
+
+	if (sides > 8) sides = 8;
+	if (sides < 1) sides = 1;
+
+	std::vector<uint8> disk(65500);
+	struct md5_context md5;
+	md5_starts(&md5);
+	for (int x = 0; x < sides; x++)
+	{
+		size_t n = (pos < size) ? std::min(size - pos, disk.size()) : 0;
+		memset(disk.data(), 0, disk.size());
+		memcpy(disk.data(), data + pos, n);
+		pos += n;
+		md5_update(&md5, disk.data(), disk.size());
+		entry.crc32 = CalcCRC32(entry.crc32, disk.data(), disk.size());
+	}
+	md5_finish(&md5, entry.md5);
+
+	entry.format = ROMSCAN_FDS;
+	entry.sides = sides;
+	entry.prgSize = sides * 65500;
+	return true;
+}
+
+static bool NSFScan(const uint8 *data, size_t size, FCEU_RomScanEntry &entry)
+{
+	if (size < 0x80 || memcmp(data, "NESM\x1a", 5))
+		return false;
+
+	// NSFLoad() leaves GameInfo->MD5 alone, so these are of the whole file
+	struct md5_context md5;
+	md5_starts(&md5);
+	md5_update(&md5, (uint8*)data, size);
+	md5_finish(&md5, entry.md5);
+	entry.crc32 = CalcCRC32(0, (uint8*)data, size);
+
+	entry.format = ROMSCAN_NSF;
+	entry.name.assign((const char*)data + 0x0E, strnlen((const char*)data + 0x0E, 31));
+	entry.sides = data[0x06];
+	entry.prgSize = (uint32)(size - 0x80);
+	if (data[0x7A] & 2)
+		entry.region = ROMSCAN_DUAL;
+	else if (data[0x7A] & 1)
+		entry.region = ROMSCAN_PAL;
+	return true;
+}
+
+bool FCEU_RomScanImage(const uint8 *data, size_t size, const char *name, FCEU_RomScanEntry &entry)
+{
+	// in the order FCEUI_LoadGameVirtual() tries the loaders
+	return iNESScan(data, size, name, entry) || NSFScan(data, size, entry) ||
+		UNIFScan(data, size, entry) || FDSScan(data, size, entry);
+}
+
+//----------------------------------------------------------------------------
+// Scanning
+
+static bool ReadFile(const std::string &path, std::vector<uint8> &data)
+{
+	FILE *fp = fopen(path.c_str(), "rb");
+	if (!fp)
+		return false;
+
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	bool ok = size >= 0 && size <= ROMSCAN_MAXFILE;
+	if (ok)
+	{
+		data.resize(size);
+		ok = fread(data.data(), 1, size, fp) == (size_t)size;
+	}
+	fclose(fp);
+	return ok;
+}
+
+static bool ReadGzip(const std::string &path, std::vector<uint8> &data)
+{
+	gzFile gz = gzopen(path.c_str(), "rb");
+	if (!gz)
+		return false;
+
+	uint8 buf[16384];
+	int n;
+	data.clear();
+	while ((n = gzread(gz, buf, sizeof(buf))) > 0 && data.size() <= ROMSCAN_MAXFILE)
+		data.insert(data.end(), buf, buf + n);
+	gzclose(gz);
+	return n == 0;
+}
+
+// Every ROM in a zip, in the order TryUnzip() looks at them
+static void ScanZip(const std::string &path, std::vector<FCEU_RomScanEntry> &out)
+{
+	unzFile zf = unzOpen(path.c_str());
+	if (!zf)
+		return;
+
+	for (int ret = unzGoToFirstFile(zf); ret == UNZ_OK; ret = unzGoToNextFile(zf))
+	{
+		char name[512];
+		unz_file_info info;
+
+		if (unzGetCurrentFileInfo(zf, &info, name, sizeof(name), 0, 0, 0, 0) != UNZ_OK)
+			break;
+		name[sizeof(name) - 1] = 0;
+		if (!HasExtension(name, romExtensions) || info.uncompressed_size > ROMSCAN_MAXFILE)
+			continue;
+		if (unzOpenCurrentFile(zf) != UNZ_OK)
+			continue;
+
+		std::vector<uint8> data(info.uncompressed_size);
+		int n = unzReadCurrentFile(zf, data.data(), (unsigned)data.size());
+		unzCloseCurrentFile(zf);
+
+		FCEU_RomScanEntry e;
+		if (n == (int)data.size() && FCEU_RomScanImage(data.data(), data.size(), name, e))
+		{
+			e.inner = name;
+			out.push_back(e);
+		}
+	}
+	unzClose(zf);
+}
+
+static void ScanFile(const std::string &path, std::vector<FCEU_RomScanEntry> &out)
+{
+	std::vector<uint8> data;
+
+	if (!ReadFile(path, data))
+		return;
+
+	if (data.size() >= 4 && !memcmp(data.data(), "PK\x03\x04", 4))
+	{
+		ScanZip(path, out);
+	}
+	else
+	{
+		if (data.size() >= 3 && data[0] == 0x1f && data[1] == 0x8b && data[2] == 0x08)
+		{
+			if (!ReadGzip(path, data))
+				return;
+		}
+
+		FCEU_RomScanEntry e;
+		if (FCEU_RomScanImage(data.data(), data.size(), path.c_str(), e))
+			out.push_back(e);
+	}
+}
+
+static void ListDirectory(const std::string &dir, std::vector<std::string> &files)
+{
+	std::vector<std::string> names;
+#ifdef WIN32
+	WIN32_FIND_DATAA fd;
+	HANDLE h = FindFirstFileA((dir + "\\*").c_str(), &fd);
+	if (h == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		names.push_back(fd.cFileName);
+	} while (FindNextFileA(h, &fd));
+	FindClose(h);
+#else
+	DIR *d = opendir(dir.c_str());
+	if (!d)
+		return;
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL)
+		names.push_back(ent->d_name);
+	closedir(d);
+#endif
+
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (names[i] == "." || names[i] == "..")
+			continue;
+
+		std::string path = dir + PSS + names[i];
+		uint64 size;
+		int64 mtime;
+		bool isDir;
+		if (!StatFile(path, size, mtime, &isDir))
+			continue;
+		if (isDir)
+			ListDirectory(path, files);
+		else if (HasExtension(names[i], scanExtensions))
+			files.push_back(path);
+	}
+}
+
+static std::string AbsolutePath(const char *dir)
+{
+#ifdef WIN32
+	char buf[MAX_PATH];
+	if (_fullpath(buf, dir, sizeof(buf)))
+		return buf;
+#else
+	char *real = realpath(dir, NULL);
+	if (real)
+	{
+		std::string path(real);
+		free(real);
+		return path;
+	}
+#endif
+	return dir;
+}
+
+//----------------------------------------------------------------------------
+// Index file
+
+static void WriteString(EMUFILE &os, const std::string &str)
+{
+	os.write32le((u32)str.size());
+	os.fwrite(str.data(), str.size());
+}
+
+static bool ReadString(EMUFILE &is, std::string &str)
+{
+	u32 len;
+	if (is.read32le(&len) != 1 || len > ROMINDEX_MAXSTR)
+		return false;
+	str.resize(len);
+	return len == 0 || is.fread(&str[0], len) == len;
+}
+
+static void WriteEntry(EMUFILE &os, const FCEU_RomScanEntry &e)
+{
+	WriteString(os, e.path);
+	WriteString(os, e.inner);
+	os.write64le(e.fileSize);
+	os.write64le((u64)e.fileTime);
+	os.fputc(e.format);
+	os.write32le((s32)e.mapper);
+	os.fputc(e.submapper);
+	WriteString(os, e.board);
+	WriteString(os, e.name);
+	os.write32le(e.prgSize);
+	os.write32le(e.chrSize);
+	os.write32le(e.prgRam);
+	os.write32le(e.prgNvram);
+	os.write32le(e.chrRam);
+	os.write32le(e.chrNvram);
+	os.fputc(e.mirroring & 0xFF);
+	os.fputc((e.battery ? 1 : 0) | (e.trainer ? 2 : 0) | (e.vsSystem ? 4 : 0));
+	os.fputc(e.region);
+	os.fputc(e.input[0] & 0xFF);
+	os.fputc(e.input[1] & 0xFF);
+	os.fputc(e.inputfc & 0xFF);
+	os.write16le((u16)e.sides);
+	os.write32le(e.crc32);
+	os.fwrite(e.md5, sizeof(e.md5));
+}
+
+static bool ReadEntry(EMUFILE &is, FCEU_RomScanEntry &e)
+{
+	u64 size, mtime;
+	u32 mapper;
+	u16 sides;
+	int b[8];
+
+	if (!ReadString(is, e.path) || !ReadString(is, e.inner))
+		return false;
+	if (is.read64le(&size) != 1 || is.read64le(&mtime) != 1)
+		return false;
+	if ((b[0] = is.fgetc()) < 0 || is.read32le(&mapper) != 1 || (b[1] = is.fgetc()) < 0)
+		return false;
+	if (!ReadString(is, e.board) || !ReadString(is, e.name))
+		return false;
+	if (is.read32le(&e.prgSize) != 1 || is.read32le(&e.chrSize) != 1 ||
+		is.read32le(&e.prgRam) != 1 || is.read32le(&e.prgNvram) != 1 ||
+		is.read32le(&e.chrRam) != 1 || is.read32le(&e.chrNvram) != 1)
+		return false;
+	for (int i = 2; i < 8; i++)
+	{
+		if ((b[i] = is.fgetc()) < 0)
+			return false;
+	}
+	if (is.read16le(&sides) != 1 || is.read32le(&e.crc32) != 1)
+		return false;
+	if (is.fread(e.md5, sizeof(e.md5)) != sizeof(e.md5))
+		return false;
+	if (b[0] > ROMSCAN_NSF || b[4] > ROMSCAN_DENDY)
+		return false;
+
+	e.fileSize = size;
+	e.fileTime = (int64)mtime;
+	e.format = b[0];
+	e.mapper = (s32)mapper;
+	e.submapper = b[1];
+	e.mirroring = (s8)b[2];
+	e.battery = (b[3] & 1) != 0;
+	e.trainer = (b[3] & 2) != 0;
+	e.vsSystem = (b[3] & 4) != 0;
+	e.region = b[4];
+	e.input[0] = (s8)b[5];
+	e.input[1] = (s8)b[6];
+	e.inputfc = (s8)b[7];
+	e.sides = sides;
+	return true;
+}
+
+static bool LoadIndex(const std::string &path, RomIndex &index)
+{
+	char magic[8];
+	u32 count;
+
+	index.clear();
+	EMUFILE_FILE is(path, "rb");
+	if (is.fail() || is.fread(magic, 8) != 8 || memcmp(magic, ROMINDEX_MAGIC, 8) || is.read32le(&count) != 1)
+		return false;
+
+	FCEU_RomScanEntry e;
+	for (u32 i = 0; i < count; i++)
+	{
+		if (!ReadEntry(is, e))
+		{
+			index.clear();
+			return false;
+		}
+		index[e.path].push_back(e);
+		e = FCEU_RomScanEntry();
+	}
+	return true;
+}
+
+static bool SaveIndex(const std::string &path, const RomIndex &index)
+{
+	std::string temp = path + ".tmp";
+	u32 count = 0;
+
+	for (RomIndex::const_iterator it = index.begin(); it != index.end(); ++it)
+		count += (u32)it->second.size();
+	{
+		EMUFILE_FILE os(temp, "wb");
+		if (os.fail())
+			return false;
+		os.fwrite(ROMINDEX_MAGIC, 8);
+		os.write32le(count);
+		for (RomIndex::const_iterator it = index.begin(); it != index.end(); ++it)
+		{
+			for (size_t i = 0; i < it->second.size(); i++)
+				WriteEntry(os, it->second[i]);
+		}
+		if (os.fail())
+		{
+			remove(temp.c_str());
+			return false;
+		}
+	}
+	remove(path.c_str());
+	return rename(temp.c_str(), path.c_str()) == 0;
+}
+
+int FCEUI_ScanRomLibrary(const char *dir, const char *indexPath, int threads)
+{
+	std::string root = AbsolutePath(dir);
+	std::string path = (indexPath && *indexPath) ? indexPath : FCEU_RomIndexPath();
+	uint64 size;
+	int64 mtime;
+	bool isDir;
+
+	if (!StatFile(root, size, mtime, &isDir) || !isDir)
+		return -1;
+
+	RomIndex index;
+	LoadIndex(path, index);
+
+	std::vector<std::string> files;
+	ListDirectory(root, files);
+
+	// files not changed since the last scan keep their entries
+	std::vector< std::vector<FCEU_RomScanEntry> > found(files.size());
+	std::vector<uint8> reused(files.size(), 0);
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		RomIndex::const_iterator it = index.find(files[i]);
+		if (it != index.end() && !it->second.empty() &&
+			StatFile(files[i], size, mtime) &&
+			it->second[0].fileSize == size && it->second[0].fileTime == mtime)
+		{
+			found[i] = it->second;
+			reused[i] = 1;
+		}
+	}
+
+	FCEU::parallelFor( (int)files.size(), [&](int i)
+	{
+		uint64 fileSize;
+		int64 fileTime;
+
+		if (reused[i] || !StatFile(files[i], fileSize, fileTime))
+			return;
+		ScanFile(files[i], found[i]);
+		for (size_t j = 0; j < found[i].size(); j++)
+		{
+			found[i][j].path = files[i];
+			found[i][j].fileSize = fileSize;
+			found[i][j].fileTime = fileTime;
+		}
+	}, threads );
+
+	// replace everything that was under root
+	std::string prefix = root + PSS;
+	for (RomIndex::iterator it = index.lower_bound(prefix); it != index.end() && !it->first.compare(0, prefix.size(), prefix); )
+		index.erase(it++);
+
+	int count = 0, parsed = 0;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (found[i].empty())
+			continue;
+		index[files[i]] = found[i];
+		count += (int)found[i].size();
+		if (!reused[i])
+			parsed += (int)found[i].size();
+	}
+
+	if (!SaveIndex(path, index))
+		return -1;
+
+	FCEU_printf("Scanned %s: %d ROMs in %d files, %d parsed, index %s\n",
+		root.c_str(), count, (int)files.size(), parsed, path.c_str());
+	return count;
+}
+
+//----------------------------------------------------------------------------
+// Lookups
+
+static std::mutex indexMutex;
+static RomIndex loadedIndex;
+static std::string loadedPath;
+static uint64 loadedSize = 0;
+static int64 loadedTime = -1;
+
+// rereads the default index after another scan, checking costs a stat;
+// the caller holds indexMutex
+static void RefreshIndex(void)
+{
+	std::string indexFile = FCEU_RomIndexPath();
+	uint64 size = 0;
+	int64 mtime = -1;
+	StatFile(indexFile, size, mtime);
+	if (indexFile != loadedPath || size != loadedSize || mtime != loadedTime)
+	{
+		LoadIndex(indexFile, loadedIndex);
+		loadedPath = indexFile;
+		loadedSize = size;
+		loadedTime = mtime;
+	}
+}
+
+bool FCEU_RomIndexFind(const std::string &path, FCEU_RomScanEntry &entry)
+{
+	std::string file = path, inner;
+	size_t bar = path.find('|');
+	if (bar != std::string::npos)
+	{
+		file = path.substr(0, bar);
+		inner = path.substr(bar + 1);
+	}
+
+	std::lock_guard<std::mutex> lock(indexMutex);
+	RefreshIndex();
+
+	uint64 size;
+	int64 mtime;
+	RomIndex::const_iterator it = loadedIndex.find(file);
+	if (it == loadedIndex.end() || it->second.empty())
+		return false;
+	if (!StatFile(file, size, mtime) || it->second[0].fileSize != size || it->second[0].fileTime != mtime)
+		return false;
+
+	for (size_t i = 0; i < it->second.size(); i++)
+	{
+		if (inner.empty() || it->second[i].inner == inner)
+		{
+			entry = it->second[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FCEU_RomIndexFindMD5(const uint8 md5[16], FCEU_RomScanEntry &entry)
+{
+	std::lock_guard<std::mutex> lock(indexMutex);
+	RefreshIndex();
+
+	for (RomIndex::const_iterator it = loadedIndex.begin(); it != loadedIndex.end(); ++it)
+	{
+		for (size_t i = 0; i < it->second.size(); i++)
+		{
+			const FCEU_RomScanEntry &e = it->second[i];
+			uint64 size;
+			int64 mtime;
+
+			if (memcmp(e.md5, md5, 16) || !StatFile(e.path, size, mtime) || e.fileSize != size || e.fileTime != mtime)
+				continue;
+			entry = e;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string FCEU_RomScanDescribe(const FCEU_RomScanEntry &e)
+{
+	static const char *regions[] = { "NTSC", "PAL", "NTSC/PAL", "Dendy" };
+	char buf[128];
+	std::string str;
+
+	switch (e.format)
+	{
+	case ROMSCAN_INES:
+	case ROMSCAN_NES20:
+		snprintf(buf, sizeof(buf), e.submapper ? "Mapper %d.%d" : "Mapper %d", e.mapper, e.submapper);
+		str = buf;
+		for (int i = 0; bmap[i].init; i++)
+		{
+			if (bmap[i].number == e.mapper)
+			{
+				str = str + " (" + bmap[i].name + ")";
+				break;
+			}
+		}
+		break;
+	case ROMSCAN_UNIF:
+		str = "UNIF " + e.board;
+		break;
+	case ROMSCAN_FDS:
+		snprintf(buf, sizeof(buf), "FDS, %d side%s", e.sides, (e.sides == 1) ? "" : "s");
+		str = buf;
+		break;
+	case ROMSCAN_NSF:
+		snprintf(buf, sizeof(buf), "NSF, %d songs", e.sides);
+		str = buf;
+		break;
+	default:
+		return "Unknown format";
+	}
+
+	if (e.format != ROMSCAN_FDS && e.format != ROMSCAN_NSF)
+	{
+		snprintf(buf, sizeof(buf), ", %u KiB PRG", e.prgSize / 1024);
+		str += buf;
+		if (e.chrSize)
+		{
+			snprintf(buf, sizeof(buf), ", %u KiB CHR", e.chrSize / 1024);
+			str += buf;
+		}
+	}
+	if (e.region >= 0 && e.region < 4)
+		str = str + ", " + regions[e.region];
+	if (e.vsSystem)
+		str += ", VS System";
+	if (e.battery)
+		str += ", battery";
+	snprintf(buf, sizeof(buf), ", CRC32 %08x", e.crc32);
+	str += buf;
+	return str;
+}
@@ -0,0 +1,117 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// romscan.h
+
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+/*
+ *  ROM library index. FCEUI_ScanRomLibrary() walks a directory, runs the
+ *  header parsers of ines.cpp and unif.cpp (plus the FDS and NSF headers)
+ *  over every ROM in it on a pool of threads, without loading anything into
+ *  the emulator, and merges what it finds into an index file, by default
+ *  <base>/romindex.dat. Frontends then look ROMs up with FCEU_RomIndexFind()
+ *  without opening them.
+ *
+ *  Plain files, gzip and zip archives are read; a zip gets one entry per ROM
+ *  in it. Files whose size and modification time match their entry are not
+ *  read again, so rescanning a library only parses what changed.
+ */
+
+enum ERomScanFormat
+{
+	ROMSCAN_UNKNOWN = 0,
+	ROMSCAN_INES,
+	ROMSCAN_NES20,
+	ROMSCAN_UNIF,
+	ROMSCAN_FDS,
+	ROMSCAN_NSF,
+};
+
+enum ERomScanRegion
+{
+	ROMSCAN_NTSC = 0,
+	ROMSCAN_PAL,
+	ROMSCAN_DUAL,
+	ROMSCAN_DENDY,
+};
+
+struct FCEU_RomScanEntry
+{
+	std::string path;       // file on disk
+	std::string inner;      // ROM inside the archive, "" for none
+	uint64 fileSize;
+	int64  fileTime;        // st_mtime of path
+
+	int    format;          // ERomScanFormat
+	int    mapper;          // iNES mapper after the database corrections, -1 if none
+	int    submapper;
+	std::string board;      // UNIF board name
+	std::string name;       // UNIF or NSF title
+	uint32 prgSize;         // bytes, as hashed by the loader
+	uint32 chrSize;
+	uint32 prgRam, prgNvram;   // NES 2.0 header, bytes
+	uint32 chrRam, chrNvram;
+	int    mirroring;       // iNES Mirroring value: 0 horizontal, 1 vertical, 2 four screen, -1 mapper controlled
+	bool   battery;
+	bool   trainer;
+	bool   vsSystem;
+	int    region;          // ERomScanRegion
+	int    input[2];        // ESI of each port, from the CRC or NES 2.0 tables
+	int    inputfc;         // ESIFC
+	int    sides;           // FDS disk sides, NSF songs
+	uint32 crc32;           // PRG and CHR, as CRC'ed by iNESLoad
+	uint8  md5[16];         // the MD5 the loader puts in GameInfo->MD5
+
+	FCEU_RomScanEntry();
+};
+
+// Default index path, <base>/romindex.dat
+std::string FCEU_RomIndexPath(void);
+
+// Scans dir and its subdirectories into the index at indexPath ("" for the
+// default) on threads threads (0 for one per core). Entries under dir for
+// files that are gone are dropped; the rest of the index is kept. Returns
+// the number of ROMs in dir, or -1 when dir can not be read or the index
+// can not be written.
+int FCEUI_ScanRomLibrary(const char *dir, const char *indexPath = "", int threads = 0);
+
+// Parses one ROM image already in memory. name is used the way iNESLoad()
+// uses it, to guess the region of iNES 1.0 images from "(E)" and the like.
+bool FCEU_RomScanImage(const uint8 *data, size_t size, const char *name, FCEU_RomScanEntry &entry);
+
+// Looks up a file in the default index, which is reread when it changes on
+// disk. path may be "archive|file in archive"; an archive by itself finds
+// its first ROM. Entries for files modified since the scan are not found.
+// Safe to call from any thread.
+bool FCEU_RomIndexFind(const std::string &path, FCEU_RomScanEntry &entry);
+
+// Looks up a ROM in the default index by the MD5 the loader computes, like
+// the romChecksum of a movie. The path of the entry found can be opened with
+// FCEU_fopen() as "archive|inner" when inner is set.
+bool FCEU_RomIndexFindMD5(const uint8 md5[16], FCEU_RomScanEntry &entry);
+
+// One line summary like "Mapper 4 (MMC3), 256 KiB PRG, 128 KiB CHR, NTSC,
+// battery, CRC32 1234abcd" for tooltips and dialogs
+std::string FCEU_RomScanDescribe(const FCEU_RomScanEntry &entry);
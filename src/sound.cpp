@@ -27,6 +27,7 @@
 #include "state.h"
 #include "wave.h"
 #include "debug.h"
+#include "stageprof.h"
 
 #include <cstdlib>
 #include <cstdio>
@@ -41,6 +42,9 @@ int32 WaveFinal[2048+512];
 
 EXPSOUND GameExpSound={0,0,0};
 
+// Sound rate requested by the driver while synthesis is suspended, -1 when not suspended.
+static int suspendedSndRate=-1;
+
 /*static*/ uint8 TriCount=0;
 static uint8 TriMode=0;
 
@@ -72,7 +76,7 @@ static uint8 SweepReload[2];
 static uint16 nreg=0;
 
 static uint8 fcnt=0;
-static int32 fhcnt=0;
+/*static*/ int32 fhcnt=0;
 static int32 fhinc=0;
 
 uint32 soundtsoffs=0;
@@ -128,11 +132,11 @@ static const uint32 PALDMCTable[0x10]=
 /*static*/ uint8 DMCBitCount=0;
 
 static uint32 DMCAddress=0;
-static int32 DMCSize=0;
+/*static*/ int32 DMCSize=0;
 static uint8 DMCShift=0;
 static uint8 SIRQStat=0;
 
-static char DMCHaveDMA=0;
+/*static*/ char DMCHaveDMA=0;
 static uint8 DMCDMABuf=0;
 /*static*/ char DMCHaveSample=0;
 
@@ -521,10 +525,20 @@ static INLINE void DMCDMA(void)
 {
   if(DMCSize && !DMCHaveDMA)
   {
-   X6502_DMR(0x8000+DMCAddress);
-   X6502_DMR(0x8000+DMCAddress);
-   X6502_DMR(0x8000+DMCAddress);
-   DMCDMABuf=X6502_DMR(0x8000+DMCAddress);
+   // three dummy reads and the fetch, read once where ROM has no side effect
+   const uint8 *src=X6502_DMASource(0x8000+DMCAddress,1);
+   if(src)
+   {
+    X6502_DMAStall(4);
+    DMCDMABuf=X.DB=*src;
+   }
+   else
+   {
+    X6502_DMR(0x8000+DMCAddress);
+    X6502_DMR(0x8000+DMCAddress);
+    X6502_DMR(0x8000+DMCAddress);
+    DMCDMABuf=X6502_DMR(0x8000+DMCAddress);
+   }
    DMCHaveDMA=1;
    DMCAddress=(DMCAddress+1)&0x7fff;
    DMCSize--;
@@ -630,18 +644,22 @@ static INLINE void RDoSQ(int x)		//Int x decides if this is Square Wave 1 or 2
    cf=(curfreq[x]+1)*2;
    rc=wlcount[x];
 
+   //output only changes at duty steps, so add whole runs at once
    while(V>0)
    {
+    int32 run=(rc>0 && rc<V)?rc:V;
+
     if(currdc<rthresh)
-     *D+=amp;
-    rc--;
+     for(int32 i=0;i<run;i++)
+      D[i]+=amp;
+    rc-=run;
     if(!rc)
     {
      rc=cf;
      currdc=(currdc+1)&7;
     }
-    V--;
-    D++;
+    V-=run;
+    D+=run;
    }
 
    RectDutyCount[x]=currdc;
@@ -783,11 +801,18 @@ static void RDoTriangle(void)
    WaveHi[V]+=cout;
  }
  else
-  for(V=ChannelBC[2];V<SOUNDTS;V++)
+  for(V=ChannelBC[2];V<SOUNDTS;)
   {
+    //the output level holds until the next step, add the whole run
+    uint32 run=SOUNDTS-V;
+    if(wlcount[2]>0 && (uint32)wlcount[2]<run) run=wlcount[2];
+
     //Modify volume based on channel volume modifiers
-	WaveHi[V]+=(tcout/256*FSettings.TriangleVolume)&(~0xFFFF);  // TODO OPTIMIZE ME!
-    wlcount[2]--;
+    int32 cout = (tcout/256*FSettings.TriangleVolume)&(~0xFFFF);
+    for(uint32 i=0;i<run;i++)
+     WaveHi[V+i]+=cout;
+    V+=run;
+    wlcount[2]-=run;
     if(!wlcount[2])
     {
      wlcount[2]=(PSG[0xa]|((PSG[0xb]&7)<<8))+1;
@@ -801,11 +826,15 @@ static void RDoTriangle(void)
  ChannelBC[2]=SOUNDTS;
 }
 
+static uint32 lqTcout=0;
+static int32 lqTriAcc=0;
+static int32 lqNoiseAcc=0;
+
 static void RDoTriangleNoisePCMLQ(void)
 {
-   static uint32 tcout=0;
-   static int32 triacc=0;
-   static int32 noiseacc=0;
+   uint32 &tcout=lqTcout;
+   int32 &triacc=lqTriAcc;
+   int32 &noiseacc=lqNoiseAcc;
 
    int32 V;
    int32 start,end;
@@ -972,10 +1001,15 @@ static void RDoNoise(void)
  }
 
  if(PSG[0xE]&0x80)  // "short" noise
-  for(V=ChannelBC[3];V<SOUNDTS;V++)
+  for(V=ChannelBC[3];V<SOUNDTS;)
   {
-   WaveHi[V]+=outo;
-   wlcount[3]--;
+   uint32 run=SOUNDTS-V;
+   if(wlcount[3]>0 && (uint32)wlcount[3]<run) run=wlcount[3];
+
+   for(uint32 i=0;i<run;i++)
+    WaveHi[V+i]+=outo;
+   V+=run;
+   wlcount[3]-=run;
    if(!wlcount[3])
    {
     uint8 feedback;
@@ -990,10 +1024,15 @@ static void RDoNoise(void)
    }
   }
  else
-  for(V=ChannelBC[3];V<SOUNDTS;V++)
+  for(V=ChannelBC[3];V<SOUNDTS;)
   {
-   WaveHi[V]+=outo;
-   wlcount[3]--;
+   uint32 run=SOUNDTS-V;
+   if(wlcount[3]>0 && (uint32)wlcount[3]<run) run=wlcount[3];
+
+   for(uint32 i=0;i<run;i++)
+    WaveHi[V+i]+=outo;
+   V+=run;
+   wlcount[3]-=run;
    if(!wlcount[3])
    {
     uint8 feedback;
@@ -1041,6 +1080,8 @@ int FlushEmulateSound(void)
 
   if(!soundtimestamp) return(0);
 
+  FCEU_StageScope stage(FCEU_STAGE_SOUND);
+
   if(!FSettings.SndRate)
   {
    left=0;
@@ -1106,6 +1147,7 @@ int FlushEmulateSound(void)
 
   FCEU_WriteWaveData(WaveFinal, end); /* This function will just return
 				    if sound recording is off. */
+  FCEU_CountAdd(FCEU_COUNTER_SOUND_SAMPLES, end);
   return(end);
 }
 
@@ -1274,10 +1316,110 @@ void SetSoundVariables(void)
 
 void FCEUI_Sound(int Rate)
 {
+	if(suspendedSndRate>=0)
+	{
+		// Applied when synthesis resumes
+		suspendedSndRate=Rate;
+		return;
+	}
 	FSettings.SndRate=Rate;
 	SetSoundVariables();
 }
 
+//Turns synthesis off the same way a sound rate of 0 does, without losing the
+//rate the driver asked for. APU timing (frame IRQ, DMC fetches) is unaffected.
+void FCEUSND_SuspendSynthesis(bool suspend)
+{
+	if(suspend)
+	{
+		if(suspendedSndRate>=0)
+			return;
+		suspendedSndRate=FSettings.SndRate;
+		FSettings.SndRate=0;
+	}
+	else
+	{
+		if(suspendedSndRate<0)
+			return;
+		FSettings.SndRate=suspendedSndRate;
+		suspendedSndRate=-1;
+
+		// Drop whatever was left from before synthesis stopped
+		memset(Wave,0,sizeof(Wave));
+		memset(WaveHi,0,sizeof(WaveHi));
+		soundtsoffs=0;
+	}
+	SetSoundVariables();
+}
+
+//Everything FlushEmulateSound carries into the next frame that savestates
+//leave out: the samples still in the wave buffers, the channel phases and
+//the filter history. WaveFinal is kept too, it still holds the frame that
+//has not been handed to the driver yet.
+struct SynthesisState
+{
+	int32 Wave[2048+512];
+	int32 WaveHi[40000];
+	int32 WaveFinal[2048+512];
+	uint32 ChannelBC[5];
+	uint32 soundtsoffs;
+	int32 inbuf;
+	int32 sqacc[2];
+	int32 RectDutyCount[2];
+	int32 wlcount[4];
+	int32 tristep;
+	uint32 lqTcout;
+	int32 lqTriAcc, lqNoiseAcc;
+	FCEU_FilterState filter;
+};
+static SynthesisState *savedSynthesis=NULL;
+
+void FCEUSND_SaveSynthesis(void)
+{
+	if(!savedSynthesis)
+		savedSynthesis=new SynthesisState;
+
+	memcpy(savedSynthesis->Wave,Wave,sizeof(Wave));
+	memcpy(savedSynthesis->WaveHi,WaveHi,sizeof(WaveHi));
+	memcpy(savedSynthesis->WaveFinal,WaveFinal,sizeof(WaveFinal));
+	memcpy(savedSynthesis->ChannelBC,ChannelBC,sizeof(ChannelBC));
+	savedSynthesis->soundtsoffs=soundtsoffs;
+	savedSynthesis->inbuf=inbuf;
+	memcpy(savedSynthesis->sqacc,sqacc,sizeof(sqacc));
+	memcpy(savedSynthesis->RectDutyCount,RectDutyCount,sizeof(RectDutyCount));
+	memcpy(savedSynthesis->wlcount,wlcount,sizeof(wlcount));
+	savedSynthesis->tristep=tristep;
+	savedSynthesis->lqTcout=lqTcout;
+	savedSynthesis->lqTriAcc=lqTriAcc;
+	savedSynthesis->lqNoiseAcc=lqNoiseAcc;
+	FCEU_GetFilterState(&savedSynthesis->filter);
+}
+
+void FCEUSND_RestoreSynthesis(void)
+{
+	if(!savedSynthesis)
+		return;
+
+	memcpy(Wave,savedSynthesis->Wave,sizeof(Wave));
+	memcpy(WaveHi,savedSynthesis->WaveHi,sizeof(WaveHi));
+	memcpy(WaveFinal,savedSynthesis->WaveFinal,sizeof(WaveFinal));
+	memcpy(ChannelBC,savedSynthesis->ChannelBC,sizeof(ChannelBC));
+	soundtsoffs=savedSynthesis->soundtsoffs;
+	inbuf=savedSynthesis->inbuf;
+	memcpy(sqacc,savedSynthesis->sqacc,sizeof(sqacc));
+	memcpy(RectDutyCount,savedSynthesis->RectDutyCount,sizeof(RectDutyCount));
+	memcpy(wlcount,savedSynthesis->wlcount,sizeof(wlcount));
+	tristep=savedSynthesis->tristep;
+	lqTcout=savedSynthesis->lqTcout;
+	lqTriAcc=savedSynthesis->lqTriAcc;
+	lqNoiseAcc=savedSynthesis->lqNoiseAcc;
+	FCEU_SetFilterState(&savedSynthesis->filter);
+
+	//expansion chips track how far they rendered on their own
+	if(FSettings.SndRate && FSettings.soundq>=1 && GameExpSound.HiSync)
+		GameExpSound.HiSync(soundtsoffs);
+}
+
 void FCEUI_SetLowPass(int q)
 {
 	FSettings.lowpass=q;
@@ -49,6 +49,13 @@ int FlushEmulateSound(void);
 extern int32 Wave[2048+512];
 extern int32 WaveFinal[2048+512];
 extern int32 WaveHi[];
+
+//Expansion chips hold their output between timer steps, so their high
+//quality fills add whole runs of WaveHi up to the next step
+static INLINE void WaveHiAddRun(int32 *D, int32 count, int32 value) {
+	for (int32 i = 0; i < count; i++)
+		D[i] += value;
+}
 extern uint32 soundtsinc;
 
 #ifdef WIN32
@@ -65,11 +72,36 @@ void SetNESSoundMap(void);
 void FrameSoundUpdate(void);
 
 void FCEUSND_Power(void);
+void FCEUSND_SuspendSynthesis(bool suspend);
+
+//Keeps the synthesis state that savestates leave out (wave buffers, channel
+//phases, filter history and the last frame's samples) across frames that are
+//emulated and then rolled back, so the sound carries on as if they never ran.
+//Expansion chips' own phase counters are not covered.
+void FCEUSND_SaveSynthesis(void);
+void FCEUSND_RestoreSynthesis(void);
 void FCEUSND_Reset(void);
 void FCEUSND_SaveState(void);
 void FCEUSND_LoadState(int version);
 
 void FCEU_SoundCPUHook(int);
+
+extern int32 fhcnt, DMCacc, DMCSize;
+extern char DMCHaveDMA;
+
+//Called once per instruction. Nearly always the frame counter and the DMC
+//timer just count down, so do that here and only make the call when one
+//of them expires or a DMC fetch is pending.
+static INLINE void FCEU_SoundCPUHookInline(int cycles)
+{
+	if(fhcnt > cycles*48 && DMCacc > cycles && !(DMCSize && !DMCHaveDMA))
+	{
+		fhcnt -= cycles*48;
+		DMCacc -= cycles;
+		return;
+	}
+	FCEU_SoundCPUHook(cycles);
+}
 void Write_IRQFM (uint32 A, uint8 V); //mbg merge 7/17/06 brought over from latest mmbuild
 
 void LogDPCM(int romaddress, int dpcmsize);
@@ -0,0 +1,348 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// stageprof.cpp
+//
+#include <stdio.h>
+#include <mutex>
+
+#include "types.h"
+#include "stageprof.h"
+#include "allocstats.h"
+#include "debug.h"
+#include "msglog.h"
+
+thread_local FCEU_StageThread *fceuStageThread = nullptr;
+
+static const char *stageNames[FCEU_STAGE_COUNT] =
+{
+	"frame", "cpu", "ppu_line", "sound", "blit", "lua", "rest"
+};
+
+std::atomic<uint64_t> fceuCounters[FCEU_COUNTER_COUNT];
+
+static const char *counterNames[FCEU_COUNTER_COUNT] =
+{
+	"instructions", "lines_rendered", "lines_skipped", "sound_samples",
+	"state_bytes", "compress_ns", "lua_hooks", "rest_commands"
+};
+
+// every thread that ever entered a stage; never shrinks, so the totals of
+// threads that are gone are kept
+static std::atomic<FCEU_StageThread*> threadList(nullptr);
+static std::mutex threadListMutex;
+
+static std::atomic<int> profileInterval(60);
+static std::atomic<uint64_t> frameCount(0);
+static std::atomic<uint64_t> sampledFrameCount(0);
+
+// the TSC rate is worked out against the steady clock over the whole run
+struct stageClockZero
+{
+	uint64_t ticks;
+	std::chrono::steady_clock::time_point time;
+
+	stageClockZero(void)
+	{
+		ticks = FCEU_StageTicks();
+		time  = std::chrono::steady_clock::now();
+	}
+};
+static stageClockZero clockZero;
+
+static double TicksPerSecond(void)
+{
+#ifdef FCEU_STAGE_TSC
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - clockZero.time).count();
+
+	if (sec < 0.001)
+	{
+		return 1.0e9;
+	}
+	return static_cast<double>(FCEU_StageTicks() - clockZero.ticks) / sec;
+#else
+	return 1.0e9;
+#endif
+}
+
+FCEU_StageThread *FCEU_StageThreadRegister(void)
+{
+	FCEU_StageThread *t = new FCEU_StageThread();
+
+	for (int i=0; i<FCEU_STAGE_COUNT; i++)
+	{
+		t->ticks[i].store(0, std::memory_order_relaxed);
+		t->calls[i].store(0, std::memory_order_relaxed);
+	}
+	t->stage  = -1;
+	t->since  = 0;
+	t->timing = true;
+
+	{
+		std::lock_guard<std::mutex> lock(threadListMutex);
+
+		t->next = threadList.load(std::memory_order_relaxed);
+		threadList.store(t, std::memory_order_release);
+	}
+	fceuStageThread = t;
+
+	return t;
+}
+
+FCEU_StageFrameScope::FCEU_StageFrameScope(void)
+{
+	int interval = profileInterval.load(std::memory_order_relaxed);
+	uint64_t frame = frameCount.fetch_add(1, std::memory_order_relaxed);
+
+	t = fceuStageThread;
+
+	if (t == nullptr)
+	{
+		t = FCEU_StageThreadRegister();
+	}
+	wasTiming = t->timing;
+	prev      = t->stage;
+	instructions = total_instructions;
+	sampled   = (interval > 0) && ((frame % interval) == 0);
+	t->timing = sampled;
+
+	if (sampled)
+	{
+		sampledFrameCount.fetch_add(1, std::memory_order_relaxed);
+
+		t->charge( FCEU_StageTicks() );
+		t->stage = FCEU_STAGE_FRAME;
+		t->calls[FCEU_STAGE_FRAME].store( t->calls[FCEU_STAGE_FRAME].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed );
+	}
+}
+
+FCEU_StageFrameScope::~FCEU_StageFrameScope(void)
+{
+	// a power on in the frame starts the instruction counter over
+	if (total_instructions >= instructions)
+	{
+		FCEU_CountAdd( FCEU_COUNTER_INSTRUCTIONS, total_instructions - instructions );
+	}
+	if (sampled)
+	{
+		t->charge( FCEU_StageTicks() );
+		t->stage = prev;
+	}
+	else
+	{
+		// what came before the frame is not charged for it
+		t->since = FCEU_StageTicks();
+	}
+	t->timing = wasTiming;
+}
+
+void FCEUI_SetStageProfileInterval(int interval)
+{
+	profileInterval.store( interval < 0 ? 0 : interval );
+}
+
+int FCEUI_GetStageProfileInterval(void)
+{
+	return profileInterval.load();
+}
+
+void FCEU_GetCounters(uint64_t counters[FCEU_COUNTER_COUNT])
+{
+	for (int i=0; i<FCEU_COUNTER_COUNT; i++)
+	{
+		counters[i] = fceuCounters[i].load(std::memory_order_relaxed);
+	}
+}
+
+const char *FCEU_CounterName(int counter)
+{
+	return (counter >= 0 && counter < FCEU_COUNTER_COUNT) ? counterNames[counter] : "";
+}
+
+static void SumStages(uint64_t ticks[FCEU_STAGE_COUNT], uint64_t calls[FCEU_STAGE_COUNT])
+{
+	for (int i=0; i<FCEU_STAGE_COUNT; i++)
+	{
+		ticks[i] = calls[i] = 0;
+	}
+	for (FCEU_StageThread *t = threadList.load(std::memory_order_acquire); t != nullptr; t = t->next)
+	{
+		for (int i=0; i<FCEU_STAGE_COUNT; i++)
+		{
+			ticks[i] += t->ticks[i].load(std::memory_order_relaxed);
+			calls[i] += t->calls[i].load(std::memory_order_relaxed);
+		}
+	}
+}
+
+std::string FCEU_StageProfilePrometheus(void)
+{
+	uint64_t ticks[FCEU_STAGE_COUNT], calls[FCEU_STAGE_COUNT];
+	double hz = TicksPerSecond();
+	std::string out;
+	char line[1024];
+
+	SumStages(ticks, calls);
+
+	out += "# HELP fceux_stage_seconds_total Time spent in each stage, without the stages nested in it.\n";
+	out += "# TYPE fceux_stage_seconds_total counter\n";
+	for (int i=0; i<FCEU_STAGE_COUNT; i++)
+	{
+		snprintf(line, sizeof(line), "fceux_stage_seconds_total{stage=\"%s\"} %.9f\n", stageNames[i], ticks[i] / hz);
+		out += line;
+	}
+	out += "# HELP fceux_stage_calls_total Times each stage was entered.\n";
+	out += "# TYPE fceux_stage_calls_total counter\n";
+	for (int i=0; i<FCEU_STAGE_COUNT; i++)
+	{
+		snprintf(line, sizeof(line), "fceux_stage_calls_total{stage=\"%s\"} %llu\n", stageNames[i], (unsigned long long)calls[i]);
+		out += line;
+	}
+	snprintf(line, sizeof(line),
+		"# HELP fceux_frames_total Frames emulated.\n"
+		"# TYPE fceux_frames_total counter\n"
+		"fceux_frames_total %llu\n"
+		"# HELP fceux_profiled_frames_total Frames whose stages were timed.\n"
+		"# TYPE fceux_profiled_frames_total counter\n"
+		"fceux_profiled_frames_total %llu\n",
+		(unsigned long long)frameCount.load(), (unsigned long long)sampledFrameCount.load());
+	out += line;
+	snprintf(line, sizeof(line),
+		"# HELP fceux_stage_profile_interval One frame in this many is timed, 0 for none.\n"
+		"# TYPE fceux_stage_profile_interval gauge\n"
+		"fceux_stage_profile_interval %d\n", profileInterval.load());
+	out += line;
+
+	uint64_t counters[FCEU_COUNTER_COUNT];
+	FCEU_GetCounters(counters);
+
+	out += "# HELP fceux_work_total Work done by each subsystem, see EFCEU_Counter.\n";
+	out += "# TYPE fceux_work_total counter\n";
+	for (int i=0; i<FCEU_COUNTER_COUNT; i++)
+	{
+		snprintf(line, sizeof(line), "fceux_work_total{counter=\"%s\"} %llu\n", counterNames[i], (unsigned long long)counters[i]);
+		out += line;
+	}
+
+	FCEU_FrameAllocStats allocs;
+	FCEU_GetFrameAllocStats(&allocs);
+
+	snprintf(line, sizeof(line),
+		"# HELP fceux_frame_allocations_total Heap allocations made by frames after warm-up.\n"
+		"# TYPE fceux_frame_allocations_total counter\n"
+		"fceux_frame_allocations_total %llu\n"
+		"# HELP fceux_frames_allocating_total Frames after warm-up that allocated.\n"
+		"# TYPE fceux_frames_allocating_total counter\n"
+		"fceux_frames_allocating_total %llu\n"
+		"# HELP fceux_frame_allocations_max Most heap allocations of one frame after warm-up.\n"
+		"# TYPE fceux_frame_allocations_max gauge\n"
+		"fceux_frame_allocations_max %llu\n",
+		(unsigned long long)allocs.allocations, (unsigned long long)allocs.framesAllocating,
+		(unsigned long long)allocs.maxPerFrame);
+	out += line;
+
+	FCEU_MemoryUsage mem;
+	if (FCEU_GetMemoryUsage(&mem))
+	{
+		snprintf(line, sizeof(line),
+			"# HELP fceux_resident_bytes Memory of the process in RAM.\n"
+			"# TYPE fceux_resident_bytes gauge\n"
+			"fceux_resident_bytes %llu\n"
+			"# HELP fceux_resident_anon_bytes Of which not shared with other processes running the same program.\n"
+			"# TYPE fceux_resident_anon_bytes gauge\n"
+			"fceux_resident_anon_bytes %llu\n"
+			"# HELP fceux_resident_peak_bytes Most memory the process had in RAM.\n"
+			"# TYPE fceux_resident_peak_bytes gauge\n"
+			"fceux_resident_peak_bytes %llu\n",
+			(unsigned long long)mem.resident, (unsigned long long)mem.residentAnon,
+			(unsigned long long)mem.residentPeak);
+		out += line;
+	}
+
+	FCEU_MsgLogStats log;
+	FCEU_MsgLogGetStats(&log);
+
+	snprintf(line, sizeof(line),
+		"# HELP fceux_log_messages_total Messages written through the asynchronous log.\n"
+		"# TYPE fceux_log_messages_total counter\n"
+		"fceux_log_messages_total %llu\n"
+		"# HELP fceux_log_dropped_total Messages the asynchronous log dropped, by reason.\n"
+		"# TYPE fceux_log_dropped_total counter\n"
+		"fceux_log_dropped_total{reason=\"full\"} %llu\n"
+		"fceux_log_dropped_total{reason=\"rate\"} %llu\n",
+		(unsigned long long)log.written, (unsigned long long)log.droppedFull,
+		(unsigned long long)log.droppedRate);
+	out += line;
+
+	return out;
+}
+
+std::string FCEU_StageProfileJson(void)
+{
+	uint64_t ticks[FCEU_STAGE_COUNT], calls[FCEU_STAGE_COUNT];
+	double hz = TicksPerSecond();
+	std::string out;
+	char line[256];
+
+	SumStages(ticks, calls);
+
+	snprintf(line, sizeof(line), "{\"frames\": %llu, \"profiled_frames\": %llu, \"interval\": %d, \"stages\": {",
+		(unsigned long long)frameCount.load(), (unsigned long long)sampledFrameCount.load(), profileInterval.load());
+	out += line;
+
+	for (int i=0; i<FCEU_STAGE_COUNT; i++)
+	{
+		snprintf(line, sizeof(line), "%s\"%s\": {\"seconds\": %.9f, \"calls\": %llu}", i ? ", " : "",
+			stageNames[i], ticks[i] / hz, (unsigned long long)calls[i]);
+		out += line;
+	}
+	uint64_t counters[FCEU_COUNTER_COUNT];
+	FCEU_GetCounters(counters);
+
+	out += "}, \"counters\": {";
+	for (int i=0; i<FCEU_COUNTER_COUNT; i++)
+	{
+		snprintf(line, sizeof(line), "%s\"%s\": %llu", i ? ", " : "", counterNames[i], (unsigned long long)counters[i]);
+		out += line;
+	}
+	FCEU_FrameAllocStats allocs;
+	FCEU_GetFrameAllocStats(&allocs);
+
+	snprintf(line, sizeof(line), "}, \"allocations\": {\"frames\": %llu, \"frames_allocating\": %llu, \"total\": %llu, \"max_per_frame\": %llu, \"last_frame\": %d}",
+		(unsigned long long)allocs.frames, (unsigned long long)allocs.framesAllocating,
+		(unsigned long long)allocs.allocations, (unsigned long long)allocs.maxPerFrame, allocs.lastFrame);
+	out += line;
+
+	FCEU_MemoryUsage mem;
+	FCEU_GetMemoryUsage(&mem);
+
+	snprintf(line, sizeof(line), ", \"memory\": {\"resident\": %llu, \"resident_anon\": %llu, \"resident_peak\": %llu}",
+		(unsigned long long)mem.resident, (unsigned long long)mem.residentAnon, (unsigned long long)mem.residentPeak);
+	out += line;
+
+	FCEU_MsgLogStats log;
+	FCEU_MsgLogGetStats(&log);
+
+	snprintf(line, sizeof(line), ", \"log\": {\"queued\": %llu, \"written\": %llu, \"dropped_full\": %llu, \"dropped_rate\": %llu}}",
+		(unsigned long long)log.queued, (unsigned long long)log.written,
+		(unsigned long long)log.droppedFull, (unsigned long long)log.droppedRate);
+	out += line;
+
+	return out;
+}
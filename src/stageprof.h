@@ -0,0 +1,211 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// stageprof.h
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define FCEU_STAGE_TSC
+#endif
+
+/*
+ *  Stage profiler. Unlike the FCEU_PROFILE_FUNC profiler of profiler.h this
+ *  one is always built and meant to be left on: it only counts time in a
+ *  fixed set of stages, into counters of the thread doing the work, with one
+ *  TSC read on each stage change and no locks. Time in a stage excludes the
+ *  stages nested in it, so CPU time is not also counted as PPU line time
+ *  and the stages of a frame add up to it.
+ *
+ *  Stages inside FCEUI_Emulate() run thousands of times a frame, so only
+ *  one frame in FCEUI_SetStageProfileInterval() is timed; stages outside
+ *  of frames are always timed. The totals go out in Prometheus text format
+ *  or JSON, with the work counters below.
+ */
+
+enum EFCEU_Stage
+{
+	FCEU_STAGE_FRAME = 0,   // FCEUI_Emulate(), less the stages below
+	FCEU_STAGE_CPU,         // X6502_Run()
+	FCEU_STAGE_PPU_LINE,    // rendering a scanline, old PPU
+	FCEU_STAGE_SOUND,       // FlushEmulateSound()
+	FCEU_STAGE_BLIT,        // Blit8ToHigh()
+	FCEU_STAGE_LUA,         // Lua frame and memory hooks
+	FCEU_STAGE_REST,        // REST API commands
+	FCEU_STAGE_COUNT
+};
+
+struct FCEU_StageThread
+{
+	// written by the owner only, relaxed atomics so readers never tear
+	std::atomic<uint64_t> ticks[FCEU_STAGE_COUNT];
+	std::atomic<uint64_t> calls[FCEU_STAGE_COUNT];
+
+	int      stage;        // current stage, -1 for none
+	uint64_t since;        // ticks when it was entered
+	bool     timing;       // false in the frames not sampled
+	FCEU_StageThread *next;
+
+	void charge(uint64_t now)
+	{
+		if (stage >= 0)
+		{
+			ticks[stage].store( ticks[stage].load(std::memory_order_relaxed) + (now - since), std::memory_order_relaxed );
+		}
+		since = now;
+	}
+};
+
+extern thread_local FCEU_StageThread *fceuStageThread;
+
+FCEU_StageThread *FCEU_StageThreadRegister(void);
+
+static inline uint64_t FCEU_StageTicks(void)
+{
+#ifdef FCEU_STAGE_TSC
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Counts its lifetime to stage
+class FCEU_StageScope
+{
+	public:
+	explicit FCEU_StageScope(int stage) : t(nullptr), prev(-1)
+	{
+		t = fceuStageThread;
+
+		if (t == nullptr)
+		{
+			t = FCEU_StageThreadRegister();
+		}
+		if (!t->timing)
+		{
+			t = nullptr;
+			return;
+		}
+		t->charge( FCEU_StageTicks() );
+		prev = t->stage;
+		t->stage = stage;
+		t->calls[stage].store( t->calls[stage].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed );
+	}
+
+	~FCEU_StageScope(void)
+	{
+		if (t != nullptr)
+		{
+			t->charge( FCEU_StageTicks() );
+			t->stage = prev;
+		}
+	}
+
+	FCEU_StageScope(const FCEU_StageScope &) = delete;
+	FCEU_StageScope& operator = (const FCEU_StageScope &) = delete;
+
+	private:
+	FCEU_StageThread *t;
+	int prev;
+};
+
+// Times one frame as FCEU_STAGE_FRAME, or turns timing off on this thread
+// for it when it is not sampled. Counts the instructions it runs either way.
+class FCEU_StageFrameScope
+{
+	public:
+	FCEU_StageFrameScope(void);
+	~FCEU_StageFrameScope(void);
+
+	FCEU_StageFrameScope(const FCEU_StageFrameScope &) = delete;
+	FCEU_StageFrameScope& operator = (const FCEU_StageFrameScope &) = delete;
+
+	private:
+	FCEU_StageThread *t;
+	bool sampled;
+	bool wasTiming;
+	int prev;
+	uint64_t instructions;
+};
+
+/*
+ *  Work counters. Unlike the stage times these count in every frame, to
+ *  give numbers that stay the same from run to run of the same input, for
+ *  comparing builds. They only ever go up.
+ */
+enum EFCEU_Counter
+{
+	FCEU_COUNTER_INSTRUCTIONS = 0,  // CPU instructions run in frames
+	FCEU_COUNTER_LINES_RENDERED,    // picture lines drawn
+	FCEU_COUNTER_LINES_SKIPPED,     // picture lines of frames not drawn
+	FCEU_COUNTER_SOUND_SAMPLES,     // sound samples synthesized
+	FCEU_COUNTER_STATE_BYTES,       // savestate bytes written by FCEUSS_SaveMS()
+	FCEU_COUNTER_COMPRESS_NS,       // nanoseconds compressing savestates
+	FCEU_COUNTER_LUA_HOOKS,         // Lua frame and memory hook calls
+	FCEU_COUNTER_REST_COMMANDS,     // REST API commands run
+	FCEU_COUNTER_COUNT
+};
+
+extern std::atomic<uint64_t> fceuCounters[FCEU_COUNTER_COUNT];
+
+static inline void FCEU_CountAdd(int counter, uint64_t n)
+{
+	fceuCounters[counter].fetch_add( n, std::memory_order_relaxed );
+}
+
+void FCEU_GetCounters(uint64_t counters[FCEU_COUNTER_COUNT]);
+const char *FCEU_CounterName(int counter);
+
+// Adds its lifetime in nanoseconds to counter
+class FCEU_CounterTimeScope
+{
+	public:
+	explicit FCEU_CounterTimeScope(int counter) : counter(counter), start(std::chrono::steady_clock::now()) {}
+
+	~FCEU_CounterTimeScope(void)
+	{
+		FCEU_CountAdd( counter, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() );
+	}
+
+	FCEU_CounterTimeScope(const FCEU_CounterTimeScope &) = delete;
+	FCEU_CounterTimeScope& operator = (const FCEU_CounterTimeScope &) = delete;
+
+	private:
+	int counter;
+	std::chrono::steady_clock::time_point start;
+};
+
+// Time one frame in interval, 0 for none; stages outside of frames are
+// timed either way. Default 60, about once a second.
+void FCEUI_SetStageProfileInterval(int interval);
+int  FCEUI_GetStageProfileInterval(void);
+
+// Stage totals so far in Prometheus text exposition format, or JSON
+std::string FCEU_StageProfilePrometheus(void);
+std::string FCEU_StageProfileJson(void);
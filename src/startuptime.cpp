@@ -0,0 +1,203 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// startuptime.cpp
+//
+#include <stdio.h>
+#include <string.h>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#include "startuptime.h"
+
+struct startupPhaseRecord
+{
+	const char *name;
+	int    depth;
+	int    calls;
+	double startMs;   // first start, from time zero
+	double ms;        // all calls
+};
+
+static std::mutex startupMutex;
+static FCEU::timeStampRecord zeroTime;
+static bool started  = false;
+static bool finished = false;
+static int  curDepth = 0;
+static const char *finishMark = NULL;
+static double finishMs = 0.0;
+static std::vector<startupPhaseRecord> phases;
+
+// caller holds startupMutex
+static void startLocked(void)
+{
+	if (!started)
+	{
+		zeroTime.readNew();
+		started = true;
+	}
+}
+
+static double sinceZero(FCEU::timeStampRecord t)
+{
+	return (t - zeroTime).toSeconds() * 1000.0;
+}
+
+void FCEU_StartupTimingStart(void)
+{
+	std::lock_guard<std::mutex> lock(startupMutex);
+
+	startLocked();
+}
+
+void FCEU_StartupTimingFinish(const char *mark)
+{
+	FCEU::timeStampRecord now;
+
+	now.readNew();
+
+	std::lock_guard<std::mutex> lock(startupMutex);
+
+	if (finished)
+	{
+		return;
+	}
+	startLocked();
+	finished   = true;
+	finishMark = mark;
+	finishMs   = sinceZero(now);
+}
+
+bool FCEU_StartupTimingFinished(void)
+{
+	std::lock_guard<std::mutex> lock(startupMutex);
+
+	return finished;
+}
+
+FCEU_StartupPhase::FCEU_StartupPhase(const char *phaseName)
+	: name(phaseName), depth(0), active(false)
+{
+	std::lock_guard<std::mutex> lock(startupMutex);
+
+	if (finished)
+	{
+		return;
+	}
+	startLocked();
+	depth  = curDepth++;
+	active = true;
+	start.readNew();
+}
+
+FCEU_StartupPhase::~FCEU_StartupPhase(void)
+{
+	end();
+}
+
+void FCEU_StartupPhase::end(void)
+{
+	FCEU::timeStampRecord now;
+
+	if (!active)
+	{
+		return;
+	}
+	now.readNew();
+	active = false;
+
+	std::lock_guard<std::mutex> lock(startupMutex);
+
+	curDepth--;
+
+	if (finished)
+	{
+		return;
+	}
+	double ms = (now - start).toSeconds() * 1000.0;
+
+	for (size_t i=0; i<phases.size(); i++)
+	{
+		if ( (phases[i].name == name) || (strcmp(phases[i].name, name) == 0) )
+		{
+			phases[i].calls++;
+			phases[i].ms += ms;
+			return;
+		}
+	}
+	startupPhaseRecord rec;
+
+	rec.name    = name;
+	rec.depth   = depth;
+	rec.calls   = 1;
+	rec.startMs = sinceZero(start);
+	rec.ms      = ms;
+
+	phases.push_back(rec);
+}
+
+std::string FCEU_StartupTimingReport(bool json)
+{
+	std::lock_guard<std::mutex> lock(startupMutex);
+	std::vector<startupPhaseRecord> sorted(phases);
+	std::string out;
+	char line[256];
+
+	// phases are recorded as they end, report them as they started
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const startupPhaseRecord &a, const startupPhaseRecord &b) { return a.startMs < b.startMs; });
+
+	if (json)
+	{
+		out = "{\n  \"phases\": [";
+
+		for (size_t i=0; i<sorted.size(); i++)
+		{
+			snprintf(line, sizeof(line), "%s\n    {\"name\": \"%s\", \"depth\": %d, \"calls\": %d, \"start_ms\": %.3f, \"ms\": %.3f}",
+				i ? "," : "", sorted[i].name, sorted[i].depth, sorted[i].calls, sorted[i].startMs, sorted[i].ms);
+			out += line;
+		}
+		if (finished)
+		{
+			snprintf(line, sizeof(line), "\n  ],\n  \"finish\": \"%s\",\n  \"total_ms\": %.3f\n}\n", finishMark, finishMs);
+		}
+		else
+		{
+			snprintf(line, sizeof(line), "\n  ],\n  \"finish\": null,\n  \"total_ms\": null\n}\n");
+		}
+		out += line;
+		return out;
+	}
+
+	out = "Startup timing:\n   start ms        ms  calls  phase\n";
+
+	for (size_t i=0; i<sorted.size(); i++)
+	{
+		snprintf(line, sizeof(line), "%10.3f %9.3f %6d  %*s%s\n", sorted[i].startMs, sorted[i].ms,
+			sorted[i].calls, 2 * sorted[i].depth, "", sorted[i].name);
+		out += line;
+	}
+	if (finished)
+	{
+		snprintf(line, sizeof(line), "%10.3f                   %s\n", finishMs, finishMark);
+		out += line;
+	}
+	return out;
+}
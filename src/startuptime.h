@@ -0,0 +1,67 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// startuptime.h
+
+#pragma once
+
+#include <string>
+
+#include "utils/timeStamp.h"
+
+/*
+ *  Startup timing. Marked phases of startup, like building the palette or
+ *  loading the ROM, are timed from the first FCEU_StartupTimingStart() until
+ *  FCEU_StartupTimingFinish(), which the frontends call once the first frame
+ *  is presented. Phases that run more than once, or nest in others, are
+ *  added up per name. Recording is always on, it costs a few clock reads;
+ *  the report is only printed when asked for (--benchmark-startup).
+ */
+
+// Sets time zero, the earlier the better. Later calls do nothing.
+void FCEU_StartupTimingStart(void);
+
+// Ends startup with a last mark, like "first_frame". Phases ending after
+// it are not recorded. Later calls do nothing.
+void FCEU_StartupTimingFinish(const char *mark);
+
+bool FCEU_StartupTimingFinished(void);
+
+// Text table, or JSON when json is set, of the phases and the final mark
+std::string FCEU_StartupTimingReport(bool json);
+
+// Times its own lifetime, or up to end(), as phase name. name must be a
+// string literal.
+class FCEU_StartupPhase
+{
+	public:
+	explicit FCEU_StartupPhase(const char *name);
+	~FCEU_StartupPhase(void);
+
+	FCEU_StartupPhase(const FCEU_StartupPhase &) = delete;
+	FCEU_StartupPhase& operator = (const FCEU_StartupPhase &) = delete;
+
+	void end(void);
+
+	private:
+	const char *name;
+	int depth;
+	bool active;
+	FCEU::timeStampRecord start;
+};
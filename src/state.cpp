@@ -34,10 +34,14 @@
 #include "movie.h"
 #include "ppu.h"
 #include "netplay.h"
+#include "reversedebug.h"
+#include "writejournal.h"
 #include "video.h"
 #include "input.h"
 #include "zlib.h"
 #include "driver.h"
+#include "allocstats.h"
+#include "stageprof.h"
 #ifdef _S9XLUA_H
 #include "fceulua.h"
 #endif
@@ -57,6 +61,11 @@
 //#include <unistd.h> //mbg merge 7/17/06 removed
 
 #include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
 #include <fstream>
 
 using namespace std;
@@ -71,6 +80,9 @@ static int StateShow;
 //tells the save system innards that we're loading the old format
 bool FCEU_state_loading_old_format = false;
 
+//tells GameStateRestore that the state comes from a flat snapshot
+bool FCEU_state_restoring_snapshot = false;
+
 std::string lastSavestateMade; //Stores the filename of the last savestate made (needed for UndoSavestate)
 bool undoSS = false;		  //This will be true if there is lastSavestateMade, it was made since ROM was loaded, a backup state for lastSavestateMade exists
 bool redoSS = false;		  //This will be true if UndoSaveState is run, will turn false when a new savestate is made
@@ -82,12 +94,34 @@ bool redoLS = false;		  //This will be true if a backupstate was loaded, meaning
 bool internalSaveLoad = false;
 
 bool backupSavestates = true;
+
+//The undo states are kept in memory and only go to their backup files when
+//FCEUSS_WriteBackups() asks, which closing the game does.
+struct BackupState
+{
+	std::vector<uint8> data;
+	bool snapshot;	//flat FCEUSS_Snapshot data, else a full savestate
+	bool valid;
+};
+static BackupState saveBackup;	//what lastSavestateMade held before it was overwritten
+static BackupState loadBackup;	//the state from before the last loadstate
+
+//the full state last written to a numbered slot, so that backing it up
+//before it is overwritten again doesn't have to read the file back. a slot
+//written in the background gets the compressed bytes once the write is
+//done, unless the shadow was changed since (slotShadowSerial moved on)
+static std::string slotShadowFn;
+static std::vector<uint8> slotShadow;
+static uint32 slotShadowSerial = 0;
+
 bool compressSavestates = true;  //By default FCEUX compresses savestates when a movie is inactive.
 
 // a temp memory stream. We'll be dumping some data here and then compress
 static EMUFILE_MEMORY memory_savestate;
 // temporary buffer for compressed data of a savestate
 static std::vector<uint8> compressed_buf;
+// what the last uncompressed FCEUSS_SaveMS() wrote
+static size_t lastSaveMSSize = 0;
 
 #define SFMDATA_SIZE (128)
 static SFORMAT SFMDATA[SFMDATA_SIZE];
@@ -144,6 +178,11 @@ static int SubWrite(EMUFILE* os, SFORMAT *sf)
 			sf++;
 			continue;
 		}
+		if(sf->s&FCEUSTATE_SNAPSHOTONLY)
+		{
+			sf++;
+			continue;
+		}
 
 		acc+=8;			//Description + size
 		acc+=sf->s&(~FCEUSTATE_FLAGS);
@@ -188,6 +227,70 @@ static int WriteStateChunk(EMUFILE* os, int type, SFORMAT *sf)
 	return (bsize+5);
 }
 
+//flat snapshots: the raw bytes of every registered region back to back, in
+//native byte order, without chunk headers or compression. the layout is only
+//valid for the running game, so snapshots must not outlive it.
+static size_t snapshotSize = 0;
+
+static size_t SubSnapshotSize(SFORMAT *sf)
+{
+	size_t acc=0;
+
+	for(;sf->v;sf++)
+	{
+		if(sf->s==~0u)		//Link to another struct
+			acc+=SubSnapshotSize((SFORMAT *)sf->v);
+		else if(!(sf->s&FCEUSTATE_NOSNAPSHOT))
+			acc+=sf->s&(~FCEUSTATE_FLAGS);
+	}
+	return acc;
+}
+
+static uint8 *SubSnapshot(uint8 *p, SFORMAT *sf)
+{
+	for(;sf->v;sf++)
+	{
+		if(sf->s==~0u)
+		{
+			p=SubSnapshot(p,(SFORMAT *)sf->v);
+			continue;
+		}
+		if(sf->s&FCEUSTATE_NOSNAPSHOT)
+			continue;
+		uint32 size=sf->s&(~FCEUSTATE_FLAGS);
+		void *src=(sf->s&FCEUSTATE_INDIRECT) ? *(void **)sf->v : sf->v;
+		memcpy(p,src,size);
+		p+=size;
+	}
+	return p;
+}
+
+static const uint8 *SubRestore(const uint8 *p, SFORMAT *sf)
+{
+	for(;sf->v;sf++)
+	{
+		if(sf->s==~0u)
+		{
+			p=SubRestore(p,(SFORMAT *)sf->v);
+			continue;
+		}
+		if(sf->s&FCEUSTATE_NOSNAPSHOT)
+			continue;
+		uint32 size=sf->s&(~FCEUSTATE_FLAGS);
+		void *dst=(sf->s&FCEUSTATE_INDIRECT) ? *(void **)sf->v : sf->v;
+		memcpy(dst,p,size);
+		p+=size;
+	}
+	return p;
+}
+
+//the same chunks FCEUSS_SaveMS writes, minus the movie and the back buffer
+static SFORMAT *SnapshotChunks[]=
+{
+	SFCPU, SFCPUC, FCEUPPU_STATEINFO, FCEU_NEWPPU_STATEINFO,
+	FCEUCTRL_STATEINFO, FCEUSND_STATEINFO, SFMDATA, 0
+};
+
 static SFORMAT *CheckS(SFORMAT *sf, uint32 tsize, char *desc)
 {
 	while(sf->v)
@@ -200,7 +303,7 @@ static SFORMAT *CheckS(SFORMAT *sf, uint32 tsize, char *desc)
 			sf++;
 			continue;
 		}
-		if(!memcmp(desc,sf->desc,4))
+		if(!(sf->s&FCEUSTATE_SNAPSHOTONLY) && !memcmp(desc,sf->desc,4))
 		{
 			if(tsize!=(sf->s&(~FCEUSTATE_FLAGS)))
 				return(0);
@@ -247,6 +350,155 @@ static int read_sfcpuc=0, read_snd=0;
 
 void FCEUD_BlitScreen(uint8 *XBuf); //mbg merge 7/17/06 YUCKY had to add
 void UpdateFCEUWindow(void);  //mbg merge 7/17/06 YUCKY had to add
+//layout chunk (0x20): the fields of the snapshot chunks in a fixed order,
+//little endian, after a table of their descriptions and sizes. the table is
+//built once per game, so a state saved with the same layout loads as one
+//copy per field without looking anything up; others are matched by
+//description as the tagged chunks are.
+#define STATE_LAYOUT_VERSION 3
+
+struct StateLayoutField
+{
+	SFORMAT *sf;
+	uint32 size;
+};
+
+static std::vector<StateLayoutField> layoutFields;
+static std::vector<uint8> layoutTable;	//version, count, then desc, size and chunk per field
+
+static void AddLayoutFields(SFORMAT *sf, uint8 chunk)
+{
+	for(;sf->v;sf++)
+	{
+		if(sf->s==~0u)
+		{
+			AddLayoutFields((SFORMAT *)sf->v,chunk);
+			continue;
+		}
+		if(sf->s&FCEUSTATE_SNAPSHOTONLY)
+			continue;
+
+		StateLayoutField f;
+		f.sf=sf;
+		f.size=sf->s&(~FCEUSTATE_FLAGS);
+		layoutFields.push_back(f);
+
+		uint8 entry[9];
+		memcpy(entry,sf->desc,4);
+		FCEU_en32lsb(entry+4,f.size);
+		entry[8]=chunk;
+		layoutTable.insert(layoutTable.end(),entry,entry+9);
+	}
+}
+
+static void BuildStateLayout(void)
+{
+	if(!layoutTable.empty())
+		return;
+
+	layoutTable.resize(8);
+	for(int i=0;SnapshotChunks[i];i++)
+		AddLayoutFields(SnapshotChunks[i],i);
+	FCEU_en32lsb(&layoutTable[0],STATE_LAYOUT_VERSION);
+	FCEU_en32lsb(&layoutTable[4],layoutFields.size());
+}
+
+static void ResetStateLayout(void)
+{
+	layoutFields.clear();
+	layoutTable.clear();
+}
+
+static int WriteLayoutChunk(EMUFILE* os)
+{
+	BuildStateLayout();
+
+	uint32 size=layoutTable.size();
+	for(size_t i=0;i<layoutFields.size();i++)
+		size+=layoutFields[i].size;
+
+	os->fputc(0x20);
+	write32le(size,os);
+	os->fwrite(&layoutTable[0],layoutTable.size());
+	for(size_t i=0;i<layoutFields.size();i++)
+	{
+		SFORMAT *sf=layoutFields[i].sf;
+		uint8 *v=(sf->s&FCEUSTATE_INDIRECT) ? *(uint8 **)sf->v : (uint8 *)sf->v;
+#ifdef FCEU_BIG_ENDIAN
+		if(sf->s&RLSB)
+			FlipByteOrder(v,layoutFields[i].size);
+#endif
+		os->fwrite(v,layoutFields[i].size);
+#ifdef FCEU_BIG_ENDIAN
+		if(sf->s&RLSB)
+			FlipByteOrder(v,layoutFields[i].size);
+#endif
+	}
+	return size+5;
+}
+
+static void LoadLayoutField(SFORMAT *sf, const uint8 *p, uint32 size)
+{
+	uint8 *v=(sf->s&FCEUSTATE_INDIRECT) ? *(uint8 **)sf->v : (uint8 *)sf->v;
+	memcpy(v,p,size);
+#ifdef FCEU_BIG_ENDIAN
+	if(sf->s&RLSB)
+		FlipByteOrder(v,size);
+#endif
+}
+
+static bool ReadLayoutChunk(EMUFILE* is, uint32 size, bool &read_cpuc, bool &read_sound)
+{
+	std::vector<uint8> buf(size);
+	if(size < 8 || is->fread(&buf[0],size) != size)
+		return false;
+	if(FCEU_de32lsb(&buf[0]) != STATE_LAYOUT_VERSION)
+		return false;
+
+	uint32 count=FCEU_de32lsb(&buf[4]);
+	if(count > (size-8)/9)
+		return false;
+	uint8 *table=&buf[8];
+	const uint8 *p=table+count*9;
+	const uint8 *end=&buf[0]+size;
+
+	BuildStateLayout();
+	if(layoutTable.size() == 8+count*9 && !memcmp(&layoutTable[8],table,count*9))
+	{
+		for(size_t i=0;i<layoutFields.size();i++)
+		{
+			if(end-p < (ptrdiff_t)layoutFields[i].size)
+				return false;
+			LoadLayoutField(layoutFields[i].sf,p,layoutFields[i].size);
+			p+=layoutFields[i].size;
+		}
+		read_cpuc=read_sound=true;
+		return true;
+	}
+
+	//saved with another layout, copy what still matches
+	int chunks=0;
+	while(SnapshotChunks[chunks]) chunks++;
+	for(uint32 i=0;i<count;i++,table+=9)
+	{
+		char desc[4];
+		memcpy(desc,table,4);
+		uint32 fsize=FCEU_de32lsb(table+4);
+		if(end-p < (ptrdiff_t)fsize)
+			return false;
+
+		SFORMAT *sf=table[8] < chunks ? CheckS(SnapshotChunks[table[8]],fsize,desc) : 0;
+		if(sf)
+		{
+			LoadLayoutField(sf,p,fsize);
+			if(SnapshotChunks[table[8]]==SFCPUC) read_cpuc=true;
+			if(SnapshotChunks[table[8]]==FCEUSND_STATEINFO) read_sound=true;
+		}
+		p+=fsize;
+	}
+	return true;
+}
+
 static bool ReadStateChunks(EMUFILE* is, int32 totalsize)
 {
 	int t;
@@ -286,6 +538,15 @@ static bool ReadStateChunks(EMUFILE* is, int32 totalsize)
 			if(!ReadStateChunk(is,SFMDATA,size)) 
 				ret=false; 
 			break;
+		case 0x20:
+			{
+				bool cpuc=false, sound=false;
+				if(!ReadLayoutChunk(is,size,cpuc,sound))
+					ret=false;
+				if(cpuc) read_sfcpuc=1;
+				if(sound) read_snd=1;
+			}
+			break;
 
 			// now it gets hackier:
 		case 5:
@@ -378,23 +639,39 @@ extern int geniestage;
 
 bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
 {
-	// reinit memory_savestate
-	// memory_savestate is global variable which already has its vector of bytes, so no need to allocate memory every time we use save/loadstate
-	memory_savestate.set_len(0);	// this also seeks to the beginning
-	memory_savestate.unfail();
+	bool compress = compressionLevel != Z_NO_COMPRESSION && (compressSavestates || FCEUMOV_Mode(MOVIEMODE_TASEDITOR));
+
+	// an uncompressed state for a memory stream is written straight into it,
+	// behind a header filled in at the end, rather than built up and copied
+	bool inPlace = !compress && (dynamic_cast<EMUFILE_MEMORY*>(outstream) || dynamic_cast<EMUFILE_SPAN*>(outstream));
+	long int start = 0;
 
 	EMUFILE* os = &memory_savestate;
 
+	if(inPlace)
+	{
+		uint8 header[16] = { 0 };
+		start = outstream->ftell();
+		outstream->fwrite((char*)header,16);
+		os = outstream;
+	}
+	else
+	{
+		// reinit memory_savestate
+		// memory_savestate is global variable which already has its vector of bytes, so no need to allocate memory every time we use save/loadstate
+		memory_savestate.set_len(0);	// this also seeks to the beginning
+		memory_savestate.unfail();
+	}
+
 	uint32 totalsize = 0;
 
+	X6502_FlushMapIRQ();
+	FCEUPPU_FlushHBIRQ();
 	FCEUPPU_SaveState();
 	FCEUSND_SaveState();
-	totalsize=WriteStateChunk(os,1,SFCPU);
-	totalsize+=WriteStateChunk(os,2,SFCPUC);
-	totalsize+=WriteStateChunk(os,3,FCEUPPU_STATEINFO);
-	totalsize+=WriteStateChunk(os,31,FCEU_NEWPPU_STATEINFO);
-	totalsize+=WriteStateChunk(os,4,FCEUCTRL_STATEINFO);
-	totalsize+=WriteStateChunk(os,5,FCEUSND_STATEINFO);
+	if(SPreSave) SPreSave();
+	totalsize=WriteLayoutChunk(os);
+	if(SPostSave) SPostSave();
 	if(FCEUMOV_Mode(MOVIEMODE_PLAY|MOVIEMODE_RECORD|MOVIEMODE_FINISHED))
 	{
 		totalsize+=WriteStateChunk(os,6,FCEUMOV_STATEINFO);
@@ -423,12 +700,8 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
 		totalsize += 5 + size;
 	}
 
-	if(SPreSave) SPreSave();
-	totalsize+=WriteStateChunk(os,0x10,SFMDATA);
-	if(SPostSave) SPostSave();
-
 	//save the length of the file
-	size_t len = memory_savestate.size();
+	size_t len = inPlace ? (size_t)(outstream->ftell() - start - 16) : memory_savestate.size();
 
 	//sanity check: len and totalsize should be the same
 	if(len != totalsize)
@@ -436,17 +709,36 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
 		FCEUD_PrintError("sanity violation: len != totalsize");
 		return false;
 	}
+	if(!compress)
+		lastSaveMSSize = 16 + len;
+
+	if(inPlace)
+	{
+		uint8 header[16]="FCSX";
+		FCEU_en32lsb(header+4, totalsize);
+		FCEU_en32lsb(header+8, FCEU_VERSION_NUMERIC);
+		FCEU_en32lsb(header+12, ~0u);
+
+		long int end = outstream->ftell();
+		outstream->fseek(start,SEEK_SET);
+		outstream->fwrite((char*)header,16);
+		outstream->fseek(end,SEEK_SET);
+		FCEU_CountAdd(FCEU_COUNTER_STATE_BYTES, 16 + len);
+		// a span too small for the state fails, what it holds is cut short
+		return !outstream->fail();
+	}
 
 	int error = Z_OK;
 	uint8* cbuf = (uint8*)memory_savestate.buf();
 	uLongf comprlen = ~0lu;
-	if(compressionLevel != Z_NO_COMPRESSION && (compressSavestates || FCEUMOV_Mode(MOVIEMODE_TASEDITOR)))
+	if(compress)
 	{
 		// worst case compression: zlib says "0.1% larger than sourceLen plus 12 bytes"
 		comprlen = (len>>9)+12 + len;
 		if (compressed_buf.size() < comprlen) compressed_buf.resize(comprlen);
 		cbuf = &compressed_buf[0];
 		// do compression
+		FCEU_CounterTimeScope compressTime(FCEU_COUNTER_COMPRESS_NS);
 		error = compress2(cbuf, &comprlen, (uint8*)memory_savestate.buf(), len, compressionLevel);
 	}
 
@@ -459,15 +751,247 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
 	//dump it to the destination file
 	outstream->fwrite((char*)header,16);
 	outstream->fwrite((char*)cbuf,comprlen==~0lu?totalsize:comprlen);
+	FCEU_CountAdd(FCEU_COUNTER_STATE_BYTES, 16 + (comprlen==~0lu?totalsize:comprlen));
 
 	return error == Z_OK;
 }
 
 
+size_t FCEUSS_SaveMSSizeHint(void)
+{
+	return lastSaveMSSize;
+}
+
+size_t FCEUSS_SnapshotSize(void)
+{
+	if(!snapshotSize)
+	{
+		for(int i=0;SnapshotChunks[i];i++)
+			snapshotSize+=SubSnapshotSize(SnapshotChunks[i]);
+	}
+	return snapshotSize;
+}
+
+bool FCEUSS_Snapshot(uint8 *buf, size_t size)
+{
+	if(!buf || size < FCEUSS_SnapshotSize())
+		return false;
+
+	X6502_FlushMapIRQ();
+	FCEUPPU_FlushHBIRQ();
+	FCEUPPU_SaveState();
+	FCEUSND_SaveState();
+
+	//the pre and post save hooks are left out, they only prepare the values
+	//kept in savestate files
+	uint8 *p=buf;
+	for(int i=0;SnapshotChunks[i];i++)
+		p=SubSnapshot(p,SnapshotChunks[i]);
+	return true;
+}
+
+bool FCEUSS_Restore(const uint8 *buf, size_t size)
+{
+	if(!buf || size != FCEUSS_SnapshotSize())
+		return false;
+
+	const uint8 *p=buf;
+	for(int i=0;SnapshotChunks[i];i++)
+		p=SubRestore(p,SnapshotChunks[i]);
+
+	//same fixups as FCEUSS_LoadFP, the snapshot always carries the sound chunk
+	extern int resetDMCacc;
+	resetDMCacc=0;
+
+	if(GameStateRestore)
+	{
+		FCEU_state_restoring_snapshot = true;
+		GameStateRestore(FCEU_VERSION_NUMERIC);
+		FCEU_state_restoring_snapshot = false;
+	}
+	X6502_DiscardMapIRQ();
+	FCEUPPU_DiscardHBIRQ();
+	FCEUPPU_LoadState(FCEU_VERSION_NUMERIC);
+	FCEUSND_LoadState(FCEU_VERSION_NUMERIC);
+
+	//the frames logged for reverse debugging no longer lead here
+	FCEU_ReverseDebugReset();
+	FCEU_ResetWriteJournal();
+	return true;
+}
+
+//compressed savestate files are compressed and written by a background
+//thread, from a copy of the uncompressed state, so the frame that saves
+//does not wait for zlib. the result is reported by FCEUSS_UpdateSaves,
+//which FCEUI_Emulate polls every frame and, while paused, every call.
+struct StateWrite
+{
+	std::string fn;
+	std::vector<uint8> state;	//as FCEUSS_SaveMS writes it uncompressed, then as written
+	int slot;					//-1 for a named file
+	uint32 shadowSerial;		//slotShadowSerial when it was queued
+	bool display_message;
+	bool ok;
+};
+
+static std::mutex stateWriteMutex;
+static std::condition_variable stateWriteCond;
+static std::deque<StateWrite*> stateWriteQueue;
+static std::vector<StateWrite*> stateWriteDone;
+static StateWrite *stateWriteBusy = NULL;
+static std::thread *stateWriter = NULL;
+static bool stateWriterQuit = false;
+
+//leaves the bytes of the file in w->state
+static bool WriteCompressedState(StateWrite *w)
+{
+	uLong len = w->state.size() - 16;
+	uLongf comprlen = (len>>9)+12 + len;
+	std::vector<uint8> file(16 + comprlen);
+	int error;
+	{
+		FCEU_CounterTimeScope compressTime(FCEU_COUNTER_COMPRESS_NS);
+		error = compress2(&file[16], &comprlen, &w->state[16], len, Z_DEFAULT_COMPRESSION);
+	}
+	if(error == Z_OK)
+	{
+		FCEU_en32lsb(&w->state[12], comprlen);
+		memcpy(&file[0], &w->state[0], 16);
+		file.resize(16 + comprlen);
+		w->state.swap(file);
+	}
+
+	FILE *fp = FCEUD_UTF8fopen(w->fn.c_str(), "wb");
+	if(!fp)
+		return false;
+	bool ok = fwrite(&w->state[0], 1, w->state.size(), fp) == w->state.size();
+	return (fclose(fp) == 0) && ok;
+}
+
+static void StateWriterLoop(void)
+{
+	std::unique_lock<std::mutex> lock(stateWriteMutex);
+
+	for(;;)
+	{
+		if(stateWriteQueue.empty())
+		{
+			if(stateWriterQuit)
+				break;
+			stateWriteCond.wait(lock);
+			continue;
+		}
+		stateWriteBusy = stateWriteQueue.front();
+		stateWriteQueue.pop_front();
+
+		lock.unlock();
+		stateWriteBusy->ok = WriteCompressedState(stateWriteBusy);
+		if(!stateWriteBusy->ok || stateWriteBusy->slot < 0)
+			stateWriteBusy->state.clear();
+		lock.lock();
+
+		stateWriteDone.push_back(stateWriteBusy);
+		stateWriteBusy = NULL;
+		stateWriteCond.notify_all();
+	}
+}
+
+static void StopStateWriter(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(stateWriteMutex);
+		if(!stateWriter)
+			return;
+		stateWriterQuit = true;
+		stateWriteCond.notify_all();
+	}
+	stateWriter->join();
+	delete stateWriter;
+	stateWriter = NULL;
+}
+
+static void QueueStateWrite(StateWrite *w)
+{
+	std::lock_guard<std::mutex> lock(stateWriteMutex);
+
+	if(!stateWriter)
+	{
+		//a process that exits without FCEUI_Kill still gets its saves
+		//written, and does not destroy stateWriteCond under the writer
+		static bool stopAtExit = false;
+		if(!stopAtExit)
+			stopAtExit = atexit(StopStateWriter) == 0;
+		stateWriterQuit = false;
+		stateWriter = new std::thread(StateWriterLoop);
+	}
+	stateWriteQueue.push_back(w);
+	stateWriteCond.notify_all();
+}
+
+static bool StateWritePending(const std::string &fn)
+{
+	std::lock_guard<std::mutex> lock(stateWriteMutex);
+
+	if(stateWriteBusy && stateWriteBusy->fn == fn)
+		return true;
+	for(size_t i=0;i<stateWriteQueue.size();i++)
+		if(stateWriteQueue[i]->fn == fn)
+			return true;
+	return false;
+}
+
+void FCEUSS_FlushSaves(void)
+{
+	std::unique_lock<std::mutex> lock(stateWriteMutex);
+
+	while(!stateWriteQueue.empty() || stateWriteBusy)
+		stateWriteCond.wait(lock);
+}
+
+void FCEUSS_UpdateSaves(void)
+{
+	std::vector<StateWrite*> done;
+	{
+		std::lock_guard<std::mutex> lock(stateWriteMutex);
+		if(stateWriteDone.empty())
+			return;
+		done.swap(stateWriteDone);
+	}
+
+	for(size_t i=0;i<done.size();i++)
+	{
+		StateWrite *w = done[i];
+		if(w->slot >= 0)
+		{
+			if(w->ok)
+				SaveStateStatus[w->slot] = 1;
+			if(w->ok && w->shadowSerial == slotShadowSerial)
+			{
+				slotShadowFn = w->fn;
+				slotShadow.swap(w->state);
+			}
+			if(w->display_message)
+				FCEU_DispMessage(w->ok ? "State %d saved." : "State %d save error.", 0, w->slot);
+		}
+		else if(!w->ok)
+			FCEU_PrintError("Error saving state %s", w->fn.c_str());
+		delete w;
+	}
+}
+
+void FCEUSS_StopSaves(void)
+{
+	StopStateWriter();
+	FCEUSS_UpdateSaves();
+}
+
 void FCEUSS_Save(const char *fname, bool display_message)
 {
 	EMUFILE* st = 0;
 	std::string fn;
+	//compressed files go to the background writer. while paused no frame
+	//waits for the save, it is written here and its result shown at once
+	bool background = FCEUMOV_Mode(MOVIEMODE_INACTIVE) && compressSavestates && !FCEUI_EmulationPaused();
 
 	if (geniestage==1)
 	{
@@ -478,13 +1002,18 @@ void FCEUSS_Save(const char *fname, bool display_message)
 
 	if(fname)	//If filename is given use it.
 	{
-		st = FCEUD_UTF8_fstream(fname, "wb");
 		fn.assign(fname);
+		if (StateWritePending(fn))
+			FCEUSS_FlushSaves();
+		if (!background)
+			st = FCEUD_UTF8_fstream(fname, "wb");
 	}
 	else		//Else, generate one
 	{
 		//FCEU_PrintError("daCurrentState=%d",CurrentState);
 		fn = FCEU_MakeFName(FCEUMKF_STATE,CurrentState,0);
+		if (StateWritePending(fn))
+			FCEUSS_FlushSaves();
 
 		//backup existing savestate first
 		if (CheckFileExists(fn.c_str()) && backupSavestates)	//adelikat:  If the files exists and we are allowed to make backup savestates
@@ -496,10 +1025,11 @@ void FCEUSS_Save(const char *fname, bool display_message)
 		else
 			undoSS = false;					//so backup made so lastSavestateMade does have a backup file, so no undo
 
-		st = FCEUD_UTF8_fstream(fn.c_str(),"wb");
+		if (!background)
+			st = FCEUD_UTF8_fstream(fn.c_str(),"wb");
 	}
 
-	if (st == NULL || st->get_fp() == NULL)
+	if (!background && (st == NULL || st->get_fp() == NULL))
 	{
 		if (display_message)
 			FCEU_DispMessage("State %d save error.", 0, CurrentState);
@@ -531,7 +1061,41 @@ void FCEUSS_Save(const char *fname, bool display_message)
 	}
 	#endif
 
-	if(FCEUMOV_Mode(MOVIEMODE_INACTIVE))
+	if(background)
+	{
+		StateWrite *w = new StateWrite;
+		EMUFILE_MEMORY ms(&w->state);
+		w->fn = fn;
+		w->slot = fname ? -1 : CurrentState;
+		w->display_message = display_message;
+		w->ok = false;
+		w->shadowSerial = 0;
+		FCEUSS_SaveMS(&ms,Z_NO_COMPRESSION);
+		if(!fname)
+		{
+			//the slot's shadow is what the writer compresses, until then
+			//a backup reads the file back
+			slotShadowFn.clear();
+			slotShadow.clear();
+			w->shadowSerial = ++slotShadowSerial;
+		}
+		QueueStateWrite(w);
+		redoSS = false;
+		return;
+	}
+
+	if(!fname)
+	{
+		//kept for the backup when the slot is overwritten
+		slotShadow.clear();
+		EMUFILE_MEMORY ms(&slotShadow);
+		FCEUSS_SaveMS(&ms,FCEUMOV_Mode(MOVIEMODE_INACTIVE) ? -1 : 0);
+		slotShadow.resize(ms.size());
+		slotShadowFn = fn;
+		slotShadowSerial++;
+		st->fwrite(&slotShadow[0],slotShadow.size());
+	}
+	else if(FCEUMOV_Mode(MOVIEMODE_INACTIVE))
 		FCEUSS_SaveMS(st,-1);
 	else
 		FCEUSS_SaveMS(st,0);
@@ -616,6 +1180,8 @@ int FCEUSS_LoadFP_old(EMUFILE* is, ENUM_SSLOADPARAMS params)
 	}
 	if(x)
 	{
+		X6502_DiscardMapIRQ();
+		FCEUPPU_DiscardHBIRQ();
 		FCEUPPU_LoadState(stateversion);
 		FCEUSND_LoadState(stateversion);
 		x=FCEUMOV_PostLoad();
@@ -650,6 +1216,9 @@ bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params)
 {
 	if(!is) return false;
 
+	FCEU_ReverseDebugReset();
+	FCEU_ResetWriteJournal();
+
 	//maybe make a backup savestate
 	bool backup = (params == SSLOADPARAM_BACKUP);
 	EMUFILE_MEMORY msBackupSavestate;
@@ -682,34 +1251,47 @@ bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params)
 	int stateversion  = FCEU_de32lsb(header + 8);
 	uint32_t comprlen = FCEU_de32lsb(header + 12);
 
-	// reinit memory_savestate
-	// memory_savestate is global variable which already has its vector of bytes, so no need to allocate memory every time we use save/loadstate
-	if ((memory_savestate.get_vec())->size() < totalsize)
-		(memory_savestate.get_vec())->resize(totalsize);
-	memory_savestate.set_len(totalsize);
-	memory_savestate.unfail();
-	memory_savestate.fseek(0, SEEK_SET);
+	// an uncompressed state already in memory is read where it is
+	const uint8* inPlace = (comprlen == ~0u) ? is->peek(totalsize) : NULL;
+	EMUFILE_SPAN inPlaceState(inPlace, inPlace ? totalsize : 0);
+	EMUFILE* ss = &memory_savestate;
 
-	if(comprlen != ~0u)
+	if(inPlace)
 	{
-		// the savestate is compressed: read from is to compressed_buf, then decompress from compressed_buf to memory_savestate.vec
-		if (compressed_buf.size() < comprlen) compressed_buf.resize(comprlen);
-		is->fread(&compressed_buf[0], comprlen);
-
-		uLongf uncomprlen = totalsize;
-		int error = uncompress(memory_savestate.buf(), &uncomprlen, &compressed_buf[0], comprlen);
-		if(error != Z_OK || uncomprlen != totalsize)
-			return false;	// we dont need to restore the backup here because we havent messed with the emulator state yet
+		is->fseek(totalsize, SEEK_CUR);
+		ss = &inPlaceState;
 	}
 	else
 	{
-		// the savestate is not compressed: just read from is to memory_savestate.vec
-		is->fread(memory_savestate.buf(), totalsize);
+		// reinit memory_savestate
+		// memory_savestate is global variable which already has its vector of bytes, so no need to allocate memory every time we use save/loadstate
+		if ((memory_savestate.get_vec())->size() < totalsize)
+			(memory_savestate.get_vec())->resize(totalsize);
+		memory_savestate.set_len(totalsize);
+		memory_savestate.unfail();
+		memory_savestate.fseek(0, SEEK_SET);
+
+		if(comprlen != ~0u)
+		{
+			// the savestate is compressed: read from is to compressed_buf, then decompress from compressed_buf to memory_savestate.vec
+			if (compressed_buf.size() < comprlen) compressed_buf.resize(comprlen);
+			is->fread(&compressed_buf[0], comprlen);
+
+			uLongf uncomprlen = totalsize;
+			int error = uncompress(memory_savestate.buf(), &uncomprlen, &compressed_buf[0], comprlen);
+			if(error != Z_OK || uncomprlen != totalsize)
+				return false;	// we dont need to restore the backup here because we havent messed with the emulator state yet
+		}
+		else
+		{
+			// the savestate is not compressed: just read from is to memory_savestate.vec
+			is->fread(memory_savestate.buf(), totalsize);
+		}
 	}
 
 	FCEUMOV_PreLoad();
 
-	bool x = (ReadStateChunks(&memory_savestate, totalsize) != 0);
+	bool x = (ReadStateChunks(ss, totalsize) != 0);
 
 	//mbg 5/24/08 - we don't support old states, so this shouldnt matter.
 	//if(read_sfcpuc && stateversion<9500)
@@ -721,6 +1303,8 @@ bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params)
 	}
 	if (x)
 	{
+		X6502_DiscardMapIRQ();
+		FCEUPPU_DiscardHBIRQ();
 		FCEUPPU_LoadState(stateversion);
 		FCEUSND_LoadState(stateversion);
 		x=FCEUMOV_PostLoad();
@@ -744,11 +1328,21 @@ void FCEUSS_SetLoadCallback( void (*cb)(bool) )
 	SPostLoad = cb;
 }
 
+void FCEUSS_NotifyLoad(bool success)
+{
+	if (SPostLoad != NULL)
+	{
+		SPostLoad(success);
+	}
+}
+
 bool FCEUSS_Load(const char *fname, bool display_message)
 {
 	fceuScopedPtr <EMUFILE> st; // fceuScopedPtr will auto delete the allocated EMUFILE at function return.
 	std::string fn;
 
+	FCEUSS_FlushSaves();
+
 	//mbg movie - this needs to be overhauled
 	////this fixes read-only toggle problems
 	//if(FCEUMOV_IsRecording()) {
@@ -860,6 +1454,7 @@ void FCEUSS_CheckStates(void)
 	FILE *st=NULL;
 	int ssel;
 
+	FCEUSS_FlushSaves();
 	for(ssel=0;ssel<10;ssel++)
 	{
 		st=FCEUD_UTF8fopen(FCEU_MakeFName(FCEUMKF_STATE,ssel,0),"rb");
@@ -890,6 +1485,8 @@ void ResetExState(void (*PreSave)(void), void (*PostSave)(void))
 	SPreSave = PreSave;
 	SPostSave = PostSave;
 	SFEXINDEX=0;
+	snapshotSize=0;
+	ResetStateLayout();
 }
 
 void AddExState(void *v, uint32 s, int type, const char *desc)
@@ -942,6 +1539,8 @@ void AddExState(void *v, uint32 s, int type, const char *desc)
 		}
 	}
 	SFMDATA[SFEXINDEX].v=0;		// End marker.
+	snapshotSize=0;
+	ResetStateLayout();
 }
 
 void FCEUI_SelectStateNext(int n)
@@ -1075,19 +1674,62 @@ string GenerateBackupSaveStateFn(const char *fname)
 }
 
 
+static bool ReadBackupFile(const char *fname, std::vector<uint8> &out)
+{
+	EMUFILE_FILE *fp = FCEUD_UTF8_fstream(fname, "rb");
+
+	if (!fp || !fp->get_fp())
+	{
+		delete fp;
+		return false;
+	}
+	out.resize(fp->size());
+	bool ok = out.empty() || fp->fread(&out[0], out.size()) == out.size();
+	delete fp;
+	return ok;
+}
+
+static bool WriteBackupFile(const char *fname, const std::vector<uint8> &data)
+{
+	EMUFILE_FILE *fp = FCEUD_UTF8_fstream(fname, "wb");
+
+	if (!fp || !fp->get_fp())
+	{
+		delete fp;
+		return false;
+	}
+	if (!data.empty())
+		fp->fwrite(&data[0], data.size());
+	bool ok = !fp->fail();
+	delete fp;
+	return ok;
+}
+
 void CreateBackupSaveState(const char *fname)
 {
-	string newFilename = GenerateBackupSaveStateFn(fname);	//Get backup savestate filename
-	if (CheckFileExists(newFilename.c_str()))				//See if backup already exists
-		remove(newFilename.c_str())	;						//If so, delete it
-	rename(fname,newFilename.c_str());						//Rename savestate to backup filename
+	//keep what the slot holds before it is overwritten
+	if (slotShadowFn == fname)
+		saveBackup.data = slotShadow;
+	else
+	{
+		FCEUSS_FlushSaves();
+		if (!ReadBackupFile(fname, saveBackup.data))
+		{
+			saveBackup.valid = false;
+			return;
+		}
+	}
+	saveBackup.snapshot = false;
+	saveBackup.valid = true;
 	undoSS = true;		//There is a backup savestate file to mast last loaded, so undo is possible
 }
 
 void SwapSaveState()
 {
+	FCEUSS_FlushSaves();
+
 	//--------------------------------------------------------------------------------------------
-	//Both files must exist
+	//There must be a last savestate and a backup of it
 	//--------------------------------------------------------------------------------------------
 
 	if (lastSavestateMade.empty())
@@ -1096,8 +1738,7 @@ void SwapSaveState()
 		FCEUI_printf("Undo savestate was attempted but unsuccessful because there was not a recently used savestate.\n");
 		return;		//If there is no last savestate, can't undo
 	}
-	string backup = GenerateBackupSaveStateFn(lastSavestateMade.c_str());	//Get filename of backup state
-	if (!CheckFileExists(backup.c_str()))
+	if (!saveBackup.valid)
 	{
 		FCEUI_DispMessage("Can't Undo",0);
 		FCEUI_printf("Undo savestate was attempted but unsuccessful because there was not a backup of the last used savestate.\n");
@@ -1105,14 +1746,30 @@ void SwapSaveState()
 	}
 
 	//--------------------------------------------------------------------------------------------
-	//So both exists, now swap the last savestate and its backup
+	//So both exist, now swap the last savestate and its backup
 	//--------------------------------------------------------------------------------------------
-	string temp = backup;					//Put backup filename in temp
-	temp.append("x");						//Add x
+	std::vector<uint8> current;
 
-	rename(backup.c_str(),temp.c_str());			//rename backup file to temp file
-	rename(lastSavestateMade.c_str(),backup.c_str());	//rename current as backup
-	rename(temp.c_str(),lastSavestateMade.c_str());		//rename backup as current
+	if (slotShadowFn == lastSavestateMade)
+		current.swap(slotShadow);
+	else if (!ReadBackupFile(lastSavestateMade.c_str(), current))
+	{
+		FCEUI_DispMessage("Can't Undo",0);
+		FCEUI_printf("Undo savestate was attempted but unsuccessful because %s could not be read.\n",lastSavestateMade.c_str());
+		return;
+	}
+	if (!WriteBackupFile(lastSavestateMade.c_str(), saveBackup.data))
+	{
+		FCEUI_DispMessage("Can't Undo",0);
+		FCEUI_printf("Undo savestate was attempted but unsuccessful because %s could not be written.\n",lastSavestateMade.c_str());
+		if (slotShadow.empty())
+			current.swap(slotShadow);
+		return;
+	}
+	slotShadowFn = lastSavestateMade;
+	slotShadow.swap(saveBackup.data);	//the file now holds the backup
+	slotShadowSerial++;
+	saveBackup.data.swap(current);		//and the backup what the file held
 
 	undoSS = true;	//Just in case, if this was run, then there is definately a last savestate and backup
 	if (redoSS)				//This was a redo function, so if run again it will be an undo again
@@ -1120,8 +1777,8 @@ void SwapSaveState()
 	else					//This was an undo function so next will be redo, so flag it
 		redoSS = true;
 
-	FCEUI_DispMessage("%s restored",0,backup.c_str());
-	FCEUI_printf("%s restored\n",backup.c_str());
+	FCEUI_DispMessage("%s restored",0,lastSavestateMade.c_str());
+	FCEUI_printf("%s restored\n",lastSavestateMade.c_str());
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -1147,49 +1804,63 @@ string GetBackupFileName()
 
 bool CheckBackupSaveStateExist()
 {
-	//This function simply checks to see if the backup loadstate exists, the backup loadstate is a special savestate
-	//That is made before loading any state, so that the user never loses his data
-	string filename = GetBackupFileName(); //Get backup savestate filename
-
-	//Check if this filename exists
-	fstream test;
-	test.open(filename.c_str(),fstream::in);
+	//The backup loadstate is a special savestate that is made before loading
+	//any state, so that the user never loses his data
+	return loadBackup.valid;
+}
 
-	if (test.fail())
+void BackupLoadState()
+{
+	if (FCEUMOV_Mode(MOVIEMODE_INACTIVE))
 	{
-		test.close();
-		return false;
+		size_t size = FCEUSS_SnapshotSize();
+
+		loadBackup.data.resize(size);
+		loadBackup.snapshot = true;
+		loadBackup.valid = size && FCEUSS_Snapshot(&loadBackup.data[0], size);
 	}
 	else
 	{
-		test.close();
-		return true;
+		//the movie has to come back with the state, which a snapshot leaves out
+		loadBackup.data.clear();
+		EMUFILE_MEMORY ms(&loadBackup.data);
+		loadBackup.snapshot = false;
+		loadBackup.valid = FCEUSS_SaveMS(&ms, Z_NO_COMPRESSION);
+		loadBackup.data.resize(ms.size());
 	}
+	undoLS = loadBackup.valid;
 }
 
-void BackupLoadState()
+static bool RestoreLoadBackup()
 {
-	string filename = GetBackupFileName();
-	internalSaveLoad = true;
-	FCEUSS_Save(filename.c_str());
-	internalSaveLoad = false;
-	undoLS = true;
+	if (!loadBackup.valid)
+		return false;
+
+	if (loadBackup.snapshot)
+	{
+		//taken without a movie, it can't be put under one
+		if (!FCEUMOV_Mode(MOVIEMODE_INACTIVE))
+			return false;
+
+		bool ok = FCEUSS_Restore(&loadBackup.data[0], loadBackup.data.size());
+		FCEUSS_NotifyLoad(ok);
+		return ok;
+	}
+	EMUFILE_MEMORY ms(&loadBackup.data);
+	return FCEUSS_LoadFP(&ms, SSLOADPARAM_NOBACKUP);
 }
 
 void LoadBackup()
 {
 	if (!undoLS) return;
-	string filename = GetBackupFileName();	//Get backup filename
-	if (CheckBackupSaveStateExist())
+	if (RestoreLoadBackup())
 	{
-		//internalSaveLoad = true;
-		FCEUSS_Load(filename.c_str());		//Load it
-		//internalSaveLoad = false;
+		FCEU_DispMessage("Backup state loaded.",0);
 		redoLS = true;						//Flag redoLoadState
 		undoLS = false;						//Flag that LoadBackup cannot be run again
 	}
 	else
-		FCEUI_DispMessage("Error: Could not load %s",0,filename.c_str());
+		FCEUI_DispMessage("Error: Could not load the backup state",0);
 }
 
 void RedoLoadState()
@@ -1204,6 +1875,41 @@ void RedoLoadState()
 	undoLS = true;		//Flag that LoadBackup can be run again
 }
 
+void FCEUSS_WriteBackups(void)
+{
+	if (saveBackup.valid && !lastSavestateMade.empty())
+		WriteBackupFile(GenerateBackupSaveStateFn(lastSavestateMade.c_str()).c_str(), saveBackup.data);
+
+	if (loadBackup.valid)
+	{
+		string filename = GetBackupFileName();
+
+		if (!loadBackup.snapshot)
+			WriteBackupFile(filename.c_str(), loadBackup.data);
+		else
+		{
+			//put the snapshot in place just long enough to save it as a full state
+			size_t size = FCEUSS_SnapshotSize();
+			std::vector<uint8> current(size);
+
+			if (size && FCEUSS_Snapshot(&current[0], size) &&
+			    FCEUSS_Restore(&loadBackup.data[0], loadBackup.data.size()))
+			{
+				EMUFILE_FILE *fp = FCEUD_UTF8_fstream(filename.c_str(), "wb");
+				if (fp && fp->get_fp())
+					FCEUSS_SaveMS(fp, -1);
+				delete fp;
+				FCEUSS_Restore(&current[0], size);
+			}
+		}
+	}
+	saveBackup.valid = false;
+	loadBackup.valid = false;
+	slotShadowFn.clear();
+	slotShadow.clear();
+	slotShadowSerial++;
+}
+
 //-----------------------------------------------------------------------------------------------------
 //-----------------------------------------------------------------------------------------------------
 //----------- Save State History ----------------
@@ -1211,6 +1917,121 @@ void RedoLoadState()
 //-----------------------------------------------------------------------------------------------------
 static StateRecorderConfigData stateRecorderConfig;
 
+// Delta coding for the state recorder. A state is stored as the XOR against a
+// base state (all zeros for key frames), written as pairs of
+// [varint zero run][varint literal length][literal bytes].
+// Zero gaps shorter than this are cheaper to keep inside a literal.
+#define DELTA_MIN_ZERO_RUN 4
+
+static void writeVarint(EMUFILE_MEMORY *em, size_t value)
+{
+	while (value >= 0x80)
+	{
+		em->fputc( static_cast<int>(value & 0x7F) | 0x80 );
+		value >>= 7;
+	}
+	em->fputc( static_cast<int>(value) );
+}
+
+static bool readVarint(const uint8 *&p, const uint8 *end, size_t &value)
+{
+	value = 0;
+	for (int shift=0; (p < end) && (shift < 64); shift += 7)
+	{
+		uint8 b = *p++;
+		value |= static_cast<size_t>(b & 0x7F) << shift;
+		if ((b & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static void encodeStateDelta(EMUFILE_MEMORY *em, const uint8 *base, const uint8 *cur, size_t size)
+{
+	static const uint8 zeros[256] = { 0 };
+	uint8 x[256];
+	size_t i = 0;
+
+	while (i < size)
+	{
+		size_t zeroStart = i;
+		while ((i < size) && (base ? (base[i] == cur[i]) : (cur[i] == 0)))
+		{
+			i++;
+		}
+		size_t litStart = i;
+		size_t zeroRun  = 0;
+
+		// Extend the literal until a long enough run of unchanged bytes
+		while ((i < size) && (zeroRun < DELTA_MIN_ZERO_RUN))
+		{
+			bool same = base ? (base[i] == cur[i]) : (cur[i] == 0);
+			zeroRun = same ? zeroRun + 1 : 0;
+			i++;
+		}
+		if (zeroRun >= DELTA_MIN_ZERO_RUN)
+		{
+			i -= zeroRun;
+		}
+		size_t litLen = i - litStart;
+
+		writeVarint(em, litStart - zeroStart);
+		writeVarint(em, litLen);
+
+		for (size_t j=0; j<litLen; j+=sizeof(x))
+		{
+			size_t n = std::min(sizeof(x), litLen - j);
+			const uint8 *b = base ? base + litStart + j : zeros;
+
+			for (size_t k=0; k<n; k++)
+			{
+				x[k] = b[k] ^ cur[litStart + j + k];
+			}
+			em->fwrite(x, n);
+		}
+	}
+}
+
+static bool decodeStateDelta(EMUFILE_MEMORY *em, const uint8 *base, uint8 *out, size_t size)
+{
+	const uint8 *p   = em->buf();
+	const uint8 *end = p + em->size();
+	size_t i = 0;
+
+	if (base)
+	{
+		memcpy(out, base, size);
+	}
+	else
+	{
+		memset(out, 0, size);
+	}
+
+	while (i < size)
+	{
+		size_t zeroRun, litLen;
+
+		if (!readVarint(p, end, zeroRun) || !readVarint(p, end, litLen))
+		{
+			return false;
+		}
+		if ((zeroRun > size - i) || (litLen > size - i - zeroRun) ||
+		    (litLen > static_cast<size_t>(end - p)))
+		{
+			return false;
+		}
+		i += zeroRun;
+
+		for (size_t k=0; k<litLen; k++)
+		{
+			out[i++] ^= *p++;
+		}
+	}
+	return true;
+}
+
 class StateRecorder
 {
 	public:
@@ -1224,6 +2045,10 @@ class StateRecorder
 
 				ringBuf.push_back(em);
 			}
+			snapInfo.resize(ringBufSize);
+			bufferedSize = 0;
+			keyIdx = -1;
+			deltaCount = 0;
 			ringStart = ringHead = ringTail = 0;
 			frameCounter = 0;
 			lastState = ringHead;
@@ -1238,6 +2063,15 @@ class StateRecorder
 				delete ringBuf[i];
 			}
 			ringBuf.clear();
+
+			for (size_t i=0; i<keyPool.size(); i++)
+			{
+				delete keyPool[i];
+			}
+			for (size_t i=0; i<slotPool.size(); i++)
+			{
+				delete slotPool[i];
+			}
 		}
 
 		void loadConfig( StateRecorderConfigData &config )
@@ -1286,7 +2120,12 @@ class StateRecorder
 
 			printf("ringBufSize:%i  framesPerSnap:%i\n", ringBufSize, framesPerSnap );
 
+			if (config.keyFrameInterval < 1)
+			{
+				config.keyFrameInterval = 1;
+			}
 			compressionLevel = config.compressionLevel;
+			keyFrameInterval = config.keyFrameInterval;
 			loadPauseTime    = config.loadPauseTimeSeconds;
 			pauseOnLoad      = config.pauseOnLoad;
 		}
@@ -1312,13 +2151,13 @@ class StateRecorder
 
 				if ( (frameCounter % framesPerSnap) == 0 )
 				{
-					EMUFILE_MEMORY *em = ringBuf[ ringHead ];
+					releaseSlot( ringHead );
 
-					em->set_len(0);
+					ringBuf[ ringHead ]->set_len(0);
 
-					FCEUSS_SaveMS( em, compressionLevel );
+					doSnap( ringHead );
 
-					//printf("Frame:%u  Save:%i  Size:%zu  Total:%zukB \n", frameCounter, ringHead, em->size(), dataSize() / 1024 );
+					//printf("Frame:%u  Save:%i  Size:%zu  Total:%zukB \n", frameCounter, ringHead, ringBuf[ ringHead ]->size(), dataSize() / 1024 );
 
 					lastState = ringHead;
 
@@ -1328,6 +2167,11 @@ class StateRecorder
 					{
 						ringStart = (ringHead + 1) % ringBufSize;
 					}
+					// Skip deltas whose key frame was just overwritten
+					while ( (ringStart != ringHead) && (snapInfo[ringStart].type == SNAP_EMPTY) )
+					{
+						ringStart = (ringStart + 1) % ringBufSize;
+					}
 				}
 			}
 		}
@@ -1355,11 +2199,10 @@ class StateRecorder
 			}
 			snapIdx = snapIdx % ringBufSize;
 
-			EMUFILE_MEMORY *em = ringBuf[ snapIdx ];
-
-			em->fseek(SEEK_SET, 0);
-
-			FCEUSS_LoadFP( em, SSLOADPARAM_NOBACKUP );
+			if (!restoreSnap( snapIdx ))
+			{
+				return -1;
+			}
 
 			frameCounter = lastLoadFrame = static_cast<unsigned int>(currFrameCounter);
 
@@ -1438,7 +2281,13 @@ class StateRecorder
 
 		size_t  dataSize(void)
 		{
-			return ringBuf.size() * ringBuf[0]->size();
+			size_t total = keyState.size() + curState.size();
+
+			for (size_t i=0; i<ringBuf.size(); i++)
+			{
+				total += ringBuf[i]->size();
+			}
+			return total;
 		}
 
 		size_t  ringBufferSize(void)
@@ -1449,12 +2298,209 @@ class StateRecorder
 		static int  lastState;
 	private:
 
-		void doSnap(void)
+		enum SnapType
+		{
+			SNAP_EMPTY = 0,
+			SNAP_FULL,	// FCEUSS_SaveMS output
+			SNAP_KEY,	// Flat snapshot, delta coded against zeros
+			SNAP_DELTA,	// Flat snapshot, delta coded against a key slot
+		};
+
+		struct SnapInfo
+		{
+			SnapType type;
+			int      base;	// Key slot a delta refers to
+			size_t   size;	// Flat snapshot size
+			bool     pooled;	// Slot holds a buffer of keyPool
+
+			SnapInfo(void) : type(SNAP_EMPTY), base(-1), size(0), pooled(false) {}
+		};
+
+		// Sizes the buffers once for a snapshot size, so that taking snapshots
+		// does not allocate afterwards. A key frame codes the whole state and
+		// goes to one of keyPool, while the buffer of its slot waits in slotPool.
+		void sizeBuffers( size_t size )
+		{
+			const size_t keyBufSize   = size + size / 2 + 64;	// worst case coding
+			const size_t deltaBufSize = std::max<size_t>( 0x1000, size / 4 );
+			const size_t numKeyBufs   = ringBufSize / keyFrameInterval + 2;
+
+			curState.reserve(size);
+			keyState.reserve(size);
+
+			keyPool.reserve(numKeyBufs);
+			slotPool.reserve(numKeyBufs);
+
+			for (size_t i=0; i<keyPool.size(); i++)
+			{
+				keyPool[i]->get_vec()->reserve(keyBufSize);
+			}
+			while (keyPool.size() + slotPool.size() < numKeyBufs)
+			{
+				keyPool.push_back( new EMUFILE_MEMORY( keyBufSize ) );
+			}
+			for (size_t i=0; i<ringBuf.size(); i++)
+			{
+				ringBuf[i]->get_vec()->reserve( snapInfo[i].pooled ? keyBufSize : deltaBufSize );
+			}
+			bufferedSize = size;
+
+			// this frame allocated on purpose
+			FCEU_FrameAllocReset();
+		}
+
+		void takeKeyBuffer( int idx )
+		{
+			if (snapInfo[idx].pooled || keyPool.empty())
+			{
+				return;
+			}
+			slotPool.push_back( ringBuf[idx] );
+			ringBuf[idx] = keyPool.back();
+			keyPool.pop_back();
+			ringBuf[idx]->set_len(0);
+			snapInfo[idx].pooled = true;
+		}
+
+		void returnKeyBuffer( int idx )
+		{
+			if (!snapInfo[idx].pooled || slotPool.empty())
+			{
+				return;
+			}
+			keyPool.push_back( ringBuf[idx] );
+			ringBuf[idx] = slotPool.back();
+			slotPool.pop_back();
+			ringBuf[idx]->set_len(0);
+			snapInfo[idx].pooled = false;
+		}
+
+		void releaseSlot( int idx )
+		{
+			if (idx == keyIdx)
+			{
+				keyIdx = -1;
+			}
+			if (snapInfo[idx].type == SNAP_KEY)
+			{
+				// Deltas made against this key follow it in the ring
+				for (int i=(idx + 1) % ringBufSize; i != idx; i = (i + 1) % ringBufSize)
+				{
+					if ( (snapInfo[i].type != SNAP_DELTA) || (snapInfo[i].base != idx) )
+					{
+						break;
+					}
+					snapInfo[i] = SnapInfo();
+					ringBuf[i]->set_len(0);
+				}
+			}
+			returnKeyBuffer(idx);
+			snapInfo[idx] = SnapInfo();
+		}
+
+		void doSnap( int idx )
+		{
+			SnapInfo &info = snapInfo[ idx ];
+
+			// Movie state is not part of a flat snapshot, so fall back to
+			// full states while a movie is active.
+			if ( (keyFrameInterval <= 1) || FCEUMOV_Mode(MOVIEMODE_PLAY|MOVIEMODE_RECORD|MOVIEMODE_FINISHED) )
+			{
+				FCEUSS_SaveMS( ringBuf[ idx ], compressionLevel );
+				info.type = SNAP_FULL;
+				keyIdx = -1;
+				return;
+			}
+
+			size_t size = FCEUSS_SnapshotSize();
+
+			if (size != bufferedSize)
+			{
+				sizeBuffers(size);
+			}
+			curState.resize(size);
+			FCEUSS_Snapshot( curState.data(), size );
+
+			if ( (keyIdx < 0) || (deltaCount >= keyFrameInterval - 1) || (keyState.size() != size) )
+			{
+				takeKeyBuffer(idx);
+				encodeStateDelta( ringBuf[ idx ], nullptr, curState.data(), size );
+				info.type = SNAP_KEY;
+				keyState.swap(curState);
+				keyIdx = idx;
+				deltaCount = 0;
+			}
+			else
+			{
+				encodeStateDelta( ringBuf[ idx ], keyState.data(), curState.data(), size );
+				info.type = SNAP_DELTA;
+				info.base = keyIdx;
+				deltaCount++;
+			}
+			info.size = size;
+		}
+
+		bool restoreSnap( int idx )
 		{
+			EMUFILE_MEMORY *em = ringBuf[ idx ];
+			const SnapInfo &info = snapInfo[ idx ];
+			bool ok = false;
+
+			switch (info.type)
+			{
+				case SNAP_FULL:
+					em->fseek(SEEK_SET, 0);
+					keyIdx = -1;
+					return FCEUSS_LoadFP( em, SSLOADPARAM_NOBACKUP );
+
+				case SNAP_KEY:
+					keyState.resize(info.size);
+					ok = decodeStateDelta( em, nullptr, keyState.data(), info.size );
+					keyIdx = ok ? idx : -1;
+					deltaCount = 0;
+					ok = ok && FCEUSS_Restore( keyState.data(), info.size );
+				break;
+
+				case SNAP_DELTA:
+					if ( (keyIdx != info.base) || (keyState.size() != info.size) )
+					{
+						keyState.resize(info.size);
+						if (!decodeStateDelta( ringBuf[info.base], nullptr, keyState.data(), info.size ))
+						{
+							keyIdx = -1;
+							return false;
+						}
+						keyIdx = info.base;
+					}
+					// Later snapshots continue on from the loaded one
+					deltaCount = (idx - info.base + ringBufSize) % ringBufSize;
+
+					curState.resize(info.size);
+					ok = decodeStateDelta( em, keyState.data(), curState.data(), info.size ) &&
+					     FCEUSS_Restore( curState.data(), info.size );
+				break;
 
+				default:
+				break;
+			}
+
+			if (ok && (SPostLoad != NULL))
+			{
+				SPostLoad(true);
+			}
+			return ok;
 		}
 
 		std::vector <EMUFILE_MEMORY*> ringBuf;
+		std::vector <EMUFILE_MEMORY*> keyPool;	// Free key frame buffers
+		std::vector <EMUFILE_MEMORY*> slotPool;	// Buffers of slots holding a key frame buffer
+		std::vector <SnapInfo> snapInfo;
+		std::vector <uint8> keyState;	// Decoded state of slot keyIdx
+		std::vector <uint8> curState;
+		size_t bufferedSize;	// Snapshot size the buffers are sized for
+		int  keyIdx;
+		int  deltaCount;
+		int  keyFrameInterval;
 		int  ringHead;
 		int  ringTail;
 		int  ringStart;
@@ -1537,6 +2583,17 @@ int FCEU_StateRecorderGetNumSnapsSaved(void)
 	return n;
 }
 
+size_t FCEU_StateRecorderGetDataSize(void)
+{
+	size_t n = 0;
+
+	if (stateRecorder != nullptr)
+	{
+		n = stateRecorder->dataSize();
+	}
+	return n;
+}
+
 int FCEU_StateRecorderLoadState(int snapIndex)
 {
 	int ret = -1;
@@ -1589,3 +2646,181 @@ int FCEU_StateRecorderSetConfigData(const StateRecorderConfigData &newConfig)
 	}
 	return 0;
 }
+
+//-----------------------------------------------------------------------------------------------------
+//-----------------------------------------------------------------------------------------------------
+//----------- Autosave Ring ----------------
+//-----------------------------------------------------------------------------------------------------
+//-----------------------------------------------------------------------------------------------------
+//The autosaves are flat snapshots in memory. The newest is kept whole, each
+//one before it is a delta against the one after it, so taking an autosave
+//only re-encodes the one that was newest. Their files are written by the
+//background state writer, for when the emulator doesn't get to close.
+struct AutosaveEntry
+{
+	std::vector<uint8> data;
+	bool valid;
+};
+static std::vector<AutosaveEntry> autosaveRing;
+static int autosaveHead = -1;
+static std::vector<uint8> autosavePrev;
+
+static bool DecodeAutosave(int slot, std::vector<uint8> &out)
+{
+	int n = (int)autosaveRing.size();
+	size_t size = FCEUSS_SnapshotSize();
+
+	if (slot < 0 || slot >= n || !autosaveRing[slot].valid || autosaveHead < 0)
+		return false;
+	if (autosaveRing[autosaveHead].data.size() != size)
+		return false;
+
+	out = autosaveRing[autosaveHead].data;
+
+	std::vector<uint8> tmp(size);
+	for (int s = autosaveHead; s != slot; )
+	{
+		s = (s + n - 1) % n;
+		if (!autosaveRing[s].valid)
+			return false;
+
+		EMUFILE_MEMORY em(&autosaveRing[s].data);
+		if (!decodeStateDelta(&em, &out[0], &tmp[0], size))
+			return false;
+		out.swap(tmp);
+	}
+	return true;
+}
+
+//the file gets the newest state for it; one still waiting in the queue is
+//replaced rather than waited for
+static void QueueAutosaveWrite(const char *fname)
+{
+	StateWrite *w = new StateWrite;
+	EMUFILE_MEMORY ms(&w->state);
+	w->fn = fname;
+	w->slot = -1;
+	w->display_message = false;
+	w->ok = false;
+	FCEUSS_SaveMS(&ms, Z_NO_COMPRESSION);
+	{
+		std::lock_guard<std::mutex> lock(stateWriteMutex);
+
+		for (size_t i=0;i<stateWriteQueue.size();i++)
+		{
+			if (stateWriteQueue[i]->fn == w->fn)
+			{
+				stateWriteQueue[i]->state.swap(w->state);
+				delete w;
+				return;
+			}
+		}
+	}
+	QueueStateWrite(w);
+}
+
+void FCEUSS_AutosaveReset(int count)
+{
+	autosaveRing.clear();
+	autosaveRing.resize(count > 0 ? count : 1);
+	for (size_t i=0;i<autosaveRing.size();i++)
+		autosaveRing[i].valid = false;
+	autosaveHead = -1;
+	autosavePrev.clear();
+}
+
+bool FCEUSS_Autosave(int slot, const char *fname)
+{
+	if (geniestage == 1)
+		return false;
+	if (slot < 0)
+		return false;
+	if (slot >= (int)autosaveRing.size())
+		FCEUSS_AutosaveReset(slot + 1);
+
+	int n = (int)autosaveRing.size();
+	int prev = (slot + n - 1) % n;
+	size_t size = FCEUSS_SnapshotSize();
+
+	//the one before this becomes a delta against it, and what came after
+	//it can't be rewound to any more
+	bool havePrev = (prev != slot) && DecodeAutosave(prev, autosavePrev);
+	if (havePrev)
+	{
+		for (int s = autosaveHead; s != prev; s = (s + n - 1) % n)
+			autosaveRing[s].valid = false;
+	}
+	else
+	{
+		for (int s = 0; s < n; s++)
+			autosaveRing[s].valid = false;
+	}
+
+	AutosaveEntry &e = autosaveRing[slot];
+	e.data.resize(size);
+	e.valid = size && FCEUSS_Snapshot(&e.data[0], size);
+	autosaveHead = e.valid ? slot : -1;
+
+	if (e.valid && havePrev)
+	{
+		AutosaveEntry &p = autosaveRing[prev];
+		p.data.clear();
+		EMUFILE_MEMORY em(&p.data);
+		encodeStateDelta(&em, &e.data[0], &autosavePrev[0], size);
+		p.data.resize(em.size());
+	}
+	else if (havePrev)
+		autosaveRing[prev].valid = false;
+
+	if (fname)
+	{
+		#ifdef _S9XLUA_H
+		//the script's save data goes along, which FCEUSS_Save looks after
+		if (FCEU_LuaRunning())
+		{
+			FCEUSS_Save(fname, false);
+			return e.valid;
+		}
+		#endif
+		QueueAutosaveWrite(fname);
+	}
+	return e.valid;
+}
+
+bool FCEUSS_AutosaveExists(int slot)
+{
+	return slot >= 0 && slot < (int)autosaveRing.size() && autosaveRing[slot].valid;
+}
+
+bool FCEUSS_LoadAutosave(int slot, const char *fname, bool display_message)
+{
+	if (!FCEUSS_AutosaveExists(slot))
+		return false;
+
+	//the movie and the script's save data are only in the file
+	bool fromFile = !FCEUMOV_Mode(MOVIEMODE_INACTIVE);
+	#ifdef _S9XLUA_H
+	fromFile = fromFile || FCEU_LuaRunning();
+	#endif
+	if (fromFile)
+		return fname && FCEUSS_Load(fname, display_message);
+
+	if (geniestage == 1)
+	{
+		if (display_message)
+			FCEU_DispMessage("Cannot load FCS in GG screen.",0);
+		return false;
+	}
+
+	std::vector<uint8> state;
+	bool ok = DecodeAutosave(slot, state) && FCEUSS_Restore(&state[0], state.size());
+	FCEUSS_NotifyLoad(ok);
+
+	if (ok && display_message && fname)
+	{
+		char szFilename[260]={0};
+		splitpath(fname, 0, 0, szFilename, 0);
+		FCEU_DispMessage("State %s loaded.", 0, szFilename);
+	}
+	return ok;
+}
@@ -28,13 +28,40 @@ enum ENUM_SSLOADPARAMS
 
 void FCEUSS_Save(const char *, bool display_message=true);
 bool FCEUSS_Load(const char *, bool display_message=true);
+
+//compressed state files are written in the background: wait for the
+//pending ones, show the messages of the finished ones (once per frame),
+//and stop the writer at exit
+void FCEUSS_FlushSaves(void);
+void FCEUSS_UpdateSaves(void);
+void FCEUSS_StopSaves(void);
 void FCEUSS_SetLoadCallback( void (*cb)(bool) );
 
  //zlib values: 0 (none) through 9 (max) or -1 (default)
 bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel);
 
+//bytes the last uncompressed FCEUSS_SaveMS() wrote, 0 before the first:
+//enough to reserve for the next one of the same game, short of movie data
+//growing in between. Writing into an empty EMUFILE_SPAN gives the exact size
+//as its size(), though FCEUSS_SaveMS() returns false as the span overflowed.
+size_t FCEUSS_SaveMSSizeHint(void);
+
 bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params);
 
+//flat in-memory snapshots for fast save/restore loops (tree search, rerecording).
+//no chunk headers, no compression and no movie data; a snapshot is only valid
+//for the game that was loaded when it was taken.
+size_t FCEUSS_SnapshotSize(void);
+bool FCEUSS_Snapshot(uint8 *buf, size_t size);
+bool FCEUSS_Restore(const uint8 *buf, size_t size);
+
+//tells the frontend a state was loaded, as FCEUSS_LoadFP does, after a
+//FCEUSS_Restore that stands in for a savestate load
+void FCEUSS_NotifyLoad(bool success);
+
+//set while GameStateRestore runs for FCEUSS_Restore
+extern bool FCEU_state_restoring_snapshot;
+
 extern int CurrentState;
 void FCEUSS_CheckStates(void);
 
@@ -59,8 +86,14 @@ void AddExState(void *v, uint32 s, int type, const char *desc);
 //void*v is actually a void** which will be indirected before reading
 #define FCEUSTATE_INDIRECT            0x40000000
 
+//the value is only kept in savestate files, flat snapshots leave it out
+#define FCEUSTATE_NOSNAPSHOT            0x20000000
+
+//the value is only kept in flat snapshots, savestate files leave it out
+#define FCEUSTATE_SNAPSHOTONLY            0x10000000
+
 //all FCEUSTATE flags together so that we can mask them out and get the size
-#define FCEUSTATE_FLAGS (FCEUSTATE_RLSB|FCEUSTATE_INDIRECT)
+#define FCEUSTATE_FLAGS (FCEUSTATE_RLSB|FCEUSTATE_INDIRECT|FCEUSTATE_NOSNAPSHOT|FCEUSTATE_SNAPSHOTONLY)
 
 void FCEU_DrawSaveStates(uint8 *XBuf);
 
@@ -79,6 +112,18 @@ extern bool redoLS;					 //redo savestate flag
 extern bool backupSavestates;		 //Whether or not to make backups, true by default
 bool CheckBackupSaveStateExist();	 //Checks if backupsavestate exists
 
+//the undo states above are kept in memory; this writes them to their backup
+//files (smb-bak.fc0 and smb.bak.fc0) and forgets them, closing the game calls it
+void FCEUSS_WriteBackups(void);
+
+//autosaves are kept in a ring of count slots in memory and written to their
+//files by the background state writer, so taking one never waits on the disk
+void FCEUSS_AutosaveReset(int count);
+bool FCEUSS_Autosave(int slot, const char *fname);
+bool FCEUSS_AutosaveExists(int slot);
+//restores from memory, or from the file when a movie or Lua script needs it
+bool FCEUSS_LoadAutosave(int slot, const char *fname, bool display_message=true);
+
 extern bool compressSavestates;		//Whether or not to compress non-movie savestates (by default, yes)
 
 struct StateRecorderConfigData
@@ -87,6 +132,7 @@ struct StateRecorderConfigData
 	float timeBetweenSnapsMinutes;
 	int   framesBetweenSnaps;
 	int   compressionLevel;
+	int   keyFrameInterval;
 	int   loadPauseTimeSeconds;
 
 	enum TimingType
@@ -108,6 +154,7 @@ struct StateRecorderConfigData
 		historyDurationMinutes = 15.0f;
 		timeBetweenSnapsMinutes = 3.0f / 60.0f;
 		compressionLevel = 0;
+		keyFrameInterval = 30;
 		loadPauseTimeSeconds = 3;
 		pauseOnLoad = TEMPORARY_PAUSE;
 		timingMode = FRAMES;
@@ -127,6 +174,7 @@ bool FCEU_StateRecorderIsEnabled(void);
 void FCEU_StateRecorderSetEnabled(bool enabled);
 int FCEU_StateRecorderGetMaxSnaps(void);
 int FCEU_StateRecorderGetNumSnapsSaved(void);
+size_t FCEU_StateRecorderGetDataSize(void);
 int FCEU_StateRecorderGetStateIndex(void);
 int FCEU_StateRecorderLoadState(int snapIndex);
 int FCEU_StateRecorderLoadPrevState(void);
@@ -30,14 +30,18 @@
 #include "utils/endian.h"
 #include "utils/memory.h"
 #include "utils/md5.h"
+#include "utils/crc32.h"
 #include "state.h"
 #include "file.h"
 #include "input.h"
 #include "driver.h"
+#include "romscan.h"
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <vector>
 
 typedef struct {
 	char ID[4];
@@ -640,3 +644,70 @@ init_ok:
 	currCartInfo = &UNIFCart;
 	return LOADER_OK;
 }
+
+// What UNIFLoad() would find out about an image in memory, without loading
+// it. Used by the ROM library scanner.
+bool UNIFScan(const uint8 *data, size_t size, FCEU_RomScanEntry &entry) {
+	std::vector<uint8> roms[32];
+
+	if (size < 0x20 || memcmp(data, "UNIF", 4))
+		return false;
+
+	entry.format = ROMSCAN_UNIF;
+	entry.mapper = -1;
+	entry.mirroring = -1;
+
+	// same chunks LoadUNIFChunks() acts on, the ones after a short one ignored
+	size_t pos = 0x20;
+	while (size - pos >= 8) {
+		const uint8 *id = data + pos;
+		uint32 len = id[4] | (id[5] << 8) | (id[6] << 16) | ((uint32)id[7] << 24);
+		pos += 8;
+		if (len > size - pos)
+			break;
+		const uint8 *chunk = data + pos;
+		pos += len;
+
+		if (!memcmp(id, "PRG", 3) || !memcmp(id, "CHR", 3)) {
+			int z = id[3] - '0';
+			if (z < 0 || z > 15)
+				continue;
+			if (id[0] == 'C')
+				z += 16;
+			roms[z].assign(chunk, chunk + len);
+			roms[z].resize(FixRomSize(len, (z < 16) ? 2048 : 8192), 0xFF);
+		} else if (!memcmp(id, "MAPR", 4)) {
+			entry.board.assign((const char*)chunk, strnlen((const char*)chunk, len));
+		} else if (!memcmp(id, "NAME", 4)) {
+			entry.name.assign((const char*)chunk, strnlen((const char*)chunk, std::min(len, (uint32)99)));
+		} else if (!memcmp(id, "TVCI", 4) && len >= 1) {
+			if (chunk[0] <= 2)
+				entry.region = chunk[0];
+		} else if (!memcmp(id, "BATR", 4) && len >= 1) {
+			entry.battery = true;
+		} else if (!memcmp(id, "MIRR", 4) && len == 1) {
+			static const int mirr[6] = { 0, 1, -1, -1, 2, -1 };
+			entry.mirroring = (chunk[0] < 6) ? mirr[chunk[0]] : -1;
+		} else if (!memcmp(id, "CTRL", 4) && len == 1) {
+			entry.input[0] = entry.input[1] = (chunk[0] & 1) ? SI_GAMEPAD : SI_NONE;
+			if (chunk[0] & 2)
+				entry.input[1] = SI_ZAPPER;
+		}
+	}
+
+	struct md5_context md5;
+	md5_starts(&md5);
+	entry.crc32 = 0;
+	for (int x = 0; x < 32; x++) {
+		if (roms[x].empty())
+			continue;
+		md5_update(&md5, roms[x].data(), roms[x].size());
+		entry.crc32 = CalcCRC32(entry.crc32, roms[x].data(), roms[x].size());
+		if (x < 16)
+			entry.prgSize += roms[x].size();
+		else
+			entry.chrSize += roms[x].size();
+	}
+	md5_finish(&md5, entry.md5);
+	return true;
+}
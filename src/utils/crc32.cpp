@@ -18,13 +18,178 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <string.h>
+
 #include "../types.h"
 #include "crc32.h"
 
 #include <zlib.h>
+
+// The ROM checksums are the zlib (IEEE 802.3) CRC. SSE4.2's crc32 instruction
+// computes the Castagnoli CRC instead, so on x86 the fast path folds with
+// carry-less multiplies (PCLMULQDQ), picked at run time. ARMv8 has the IEEE
+// CRC in its CRC32 instructions, used when the build targets them.
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(_MSC_VER))
+#define CRC32_PCLMUL 1
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CRC32_TARGET
+#else
+#include <cpuid.h>
+#define CRC32_TARGET __attribute__((target("sse2,pclmul")))
+#endif
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define CRC32_ARM 1
+#include <arm_acle.h>
+#endif
+
+#ifdef CRC32_PCLMUL
+// Folds whole 16 byte blocks, at least 64 bytes of them, into crc (not
+// inverted), as in Intel's "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction", with the bit reflected constants.
+CRC32_TARGET static uint32 CRC32Fold(uint32 crc, const uint8 *buf, size_t len)
+{
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+	const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+	const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	__m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+	x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+	buf += 64;
+	len -= 64;
+
+	// four 16 byte lanes at a time
+	while (len >= 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+
+		buf += 64;
+		len -= 64;
+	}
+
+	// the four lanes into one
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	while (len >= 16)
+	{
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)buf)), x5);
+		buf += 16;
+		len -= 16;
+	}
+
+	// 128 bits to 64
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, low32);
+	x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32
+	x2 = _mm_and_si128(x1, low32);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+	x2 = _mm_and_si128(x2, low32);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return (uint32)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+static bool CRC32HavePCLMUL(void)
+{
+	unsigned int ecx;
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 1);
+	ecx = (unsigned int)regs[2];
+#else
+	unsigned int eax, ebx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+#endif
+	return (ecx & (1 << 1)) != 0;
+}
+
+static const bool havePCLMUL = CRC32HavePCLMUL();
+#endif
+
+#ifdef CRC32_ARM
+static uint32 CRC32Arm(uint32 crc, const uint8 *buf, size_t len)
+{
+	crc = ~crc;
+	while (len && ((uintptr_t)buf & 7))
+	{
+		crc = __crc32b(crc, *buf++);
+		len--;
+	}
+	while (len >= 8)
+	{
+		uint64 v;
+		memcpy(&v, buf, 8);
+		crc = __crc32d(crc, v);
+		buf += 8;
+		len -= 8;
+	}
+	while (len--)
+	{
+		crc = __crc32b(crc, *buf++);
+	}
+	return ~crc;
+}
+#endif
+
 uint32 CalcCRC32(uint32 crc, uint8 *buf, uint32 len)
 {
- return(crc32(crc,buf,len));
+#if defined(CRC32_PCLMUL)
+	// below a few blocks the setup costs more than zlib's tables
+	if (havePCLMUL && len >= 256)
+	{
+		uint32 whole = len & ~15u;
+
+		crc = ~CRC32Fold(~crc, buf, whole);
+		buf += whole;
+		len -= whole;
+		return len ? (uint32)crc32(crc, buf, len) : crc;
+	}
+#elif defined(CRC32_ARM)
+	return CRC32Arm(crc, buf, len);
+#endif
+	return(crc32(crc,buf,len));
 }
 
 uint32 FCEUI_CRC32(uint32 crc, uint8 *buf, uint32 len)
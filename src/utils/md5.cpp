@@ -10,6 +10,7 @@
 
 #include <string.h>
 #include "../types.h"
+#include "endian.h"
 #include "md5.h"
 
 #define GET_UINT32(n,b,i)           \
@@ -38,10 +39,13 @@ void md5_starts( struct md5_context *ctx )
     ctx->state[3] = 0x10325476;
 }
 
-void md5_process( struct md5_context *ctx, uint8 data[64] )
+static void md5_process( struct md5_context *ctx, const uint8 *data )
 {
     uint32 A, B, C, D, X[16];
 
+#ifndef FCEU_BIG_ENDIAN
+    memcpy( X, data, 64 );
+#else
     GET_UINT32( X[0],  data,  0 );
     GET_UINT32( X[1],  data,  4 );
     GET_UINT32( X[2],  data,  8 );
@@ -58,12 +62,14 @@ void md5_process( struct md5_context *ctx, uint8 data[64] )
     GET_UINT32( X[13], data, 52 );
     GET_UINT32( X[14], data, 56 );
     GET_UINT32( X[15], data, 60 );
+#endif
 
-#define S(x,n) ((x << n) | ((x & 0xFFFFFFFF) >> (32 - n)))
+#define S(x,n) ((x << n) | (x >> (32 - n)))
 
+/* X[k] + t is added first, it does not wait on the previous step */
 #define P(a,b,c,d,k,s,t)        \
 {                   \
-    a += F(b,c,d) + X[k] + t; a = S(a,s) + b;     \
+    a += X[k] + t; a += F(b,c,d); a = S(a,s) + b;     \
 }
 
     A = ctx->state[0];
@@ -92,7 +98,12 @@ void md5_process( struct md5_context *ctx, uint8 data[64] )
 
 #undef F
 
-#define F(x,y,z) (y ^ (z & (x ^ y)))
+/* (x & z) | (y & ~z), the halves never overlap so they can be added */
+#undef P
+#define P(a,b,c,d,k,s,t)        \
+{                   \
+    a += X[k] + t; a += (c & ~d); a += (b & d); a = S(a,s) + b;     \
+}
 
     P( A, B, C, D,  1,  5, 0xF61E2562 );
     P( D, A, B, C,  6,  9, 0xC040B340 );
@@ -111,8 +122,12 @@ void md5_process( struct md5_context *ctx, uint8 data[64] )
     P( C, D, A, B,  7, 14, 0x676F02D9 );
     P( B, C, D, A, 12, 20, 0x8D2A4C8A );
 
-#undef F
-    
+#undef P
+#define P(a,b,c,d,k,s,t)        \
+{                   \
+    a += X[k] + t; a += F(b,c,d); a = S(a,s) + b;     \
+}
+
 #define F(x,y,z) (x ^ y ^ z)
 
     P( A, B, C, D,  5,  4, 0xFFFA3942 );
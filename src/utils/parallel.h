@@ -0,0 +1,60 @@
+// parallel.h
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace FCEU
+{
+	// Calls job(0) ... job(count-1) on up to maxThreads threads, the
+	// calling thread included, and returns when all calls are done. Jobs
+	// run in no particular order, so they must not depend on each other.
+	// Meant for batches of independent work like compressing savestates;
+	// the threads only live for one call.
+	static inline void parallelFor( int count, const std::function<void(int)> &job, int maxThreads = 0 )
+	{
+		int numThreads = maxThreads;
+
+		if (numThreads <= 0)
+		{
+			numThreads = std::thread::hardware_concurrency();
+		}
+		if (numThreads > count)
+		{
+			numThreads = count;
+		}
+		if (numThreads <= 1)
+		{
+			for (int i=0; i<count; i++)
+			{
+				job(i);
+			}
+			return;
+		}
+		std::atomic<int> next(0);
+
+		auto worker = [&]()
+		{
+			int i;
+
+			while ( (i = next.fetch_add(1)) < count )
+			{
+				job(i);
+			}
+		};
+		std::vector<std::thread> threads;
+
+		for (int i=1; i<numThreads; i++)
+		{
+			threads.emplace_back( worker );
+		}
+		worker();
+
+		for (size_t i=0; i<threads.size(); i++)
+		{
+			threads[i].join();
+		}
+	}
+};
@@ -0,0 +1,194 @@
+// pngenc.cpp
+//
+#include <string.h>
+
+#include "utils/pngenc.h"
+
+namespace FCEU
+{
+
+static void put32( uint8_t *p, uint32_t v )
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >>  8;
+	p[3] = v;
+}
+
+// Appends the length and type of a chunk, returns the offset of the type
+// so the CRC can be computed once the data is in place.
+static size_t beginChunk( std::vector<uint8_t> &out, const char *type, uint32_t size )
+{
+	size_t ofs = out.size();
+
+	out.resize( ofs + 8 );
+	put32( &out[ofs], size );
+	memcpy( &out[ofs+4], type, 4 );
+
+	return ofs + 4;
+}
+
+static void endChunk( std::vector<uint8_t> &out, size_t typeOfs )
+{
+	uLong crc = crc32( 0, &out[typeOfs], out.size() - typeOfs );
+	size_t ofs = out.size();
+
+	out.resize( ofs + 4 );
+	put32( &out[ofs], crc );
+}
+
+pngEncoder::pngEncoder(int level)
+{
+	memset( &zs, 0, sizeof(zs) );
+	zsInit  = false;
+	zsLevel = -1;
+	this->level = 1;
+
+	setCompressionLevel( level );
+}
+
+pngEncoder::~pngEncoder(void)
+{
+	if (zsInit)
+	{
+		deflateEnd( &zs );
+	}
+}
+
+void pngEncoder::setCompressionLevel(int level)
+{
+	if (level < 0) level = 0;
+	if (level > 9) level = 9;
+
+	this->level = level;
+}
+
+bool pngEncoder::deflateRows( std::vector<uint8_t> &out, const uint8_t *pix,
+		int rowBytes, int height, int pitch )
+{
+	if (zsInit && (zsLevel != level))
+	{
+		deflateEnd( &zs );
+		zsInit = false;
+	}
+	if (!zsInit)
+	{
+		memset( &zs, 0, sizeof(zs) );
+
+		if (deflateInit( &zs, level ) != Z_OK)
+		{
+			return false;
+		}
+		zsInit  = true;
+		zsLevel = level;
+	}
+	else if (deflateReset( &zs ) != Z_OK)
+	{
+		return false;
+	}
+
+	// Every row gets filter type 0 (None). The sub/up filters buy little on
+	// palette indices and cost a pass over the image.
+	row.resize( rowBytes + 1 );
+	row[0] = 0;
+
+	uLong  bound = deflateBound( &zs, (uLong)(rowBytes + 1) * height );
+	size_t start = out.size();
+
+	out.resize( start + bound );
+
+	zs.next_out  = &out[start];
+	zs.avail_out = bound;
+
+	for (int y=0; y<height; y++)
+	{
+		memcpy( &row[1], pix + (size_t)y * pitch, rowBytes );
+
+		zs.next_in  = &row[0];
+		zs.avail_in = rowBytes + 1;
+
+		if (deflate( &zs, (y == height-1) ? Z_FINISH : Z_NO_FLUSH ) == Z_STREAM_ERROR)
+		{
+			out.resize( start );
+			return false;
+		}
+		if (zs.avail_in != 0)
+		{
+			// deflateBound() is an upper bound, so this only happens
+			// on a broken zlib.
+			out.resize( start );
+			return false;
+		}
+	}
+	out.resize( start + (bound - zs.avail_out) );
+
+	return true;
+}
+
+bool pngEncoder::encode( std::vector<uint8_t> &out, const uint8_t *pix,
+		int width, int height, int pitch, int colorType,
+		const uint8_t *plte, int numColors )
+{
+	static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	size_t typeOfs;
+
+	out.clear();
+	out.insert( out.end(), signature, signature + 8 );
+
+	typeOfs = beginChunk( out, "IHDR", 13 );
+	{
+		uint8_t ihdr[13];
+
+		put32( &ihdr[0], width );
+		put32( &ihdr[4], height );
+		ihdr[8]  = 8;           // bit depth
+		ihdr[9]  = colorType;   // 2 = RGB triplet, 3 = indexed
+		ihdr[10] = 0;           // compression: deflate
+		ihdr[11] = 0;           // adaptive filter set
+		ihdr[12] = 0;           // no interlace
+
+		out.insert( out.end(), ihdr, ihdr + 13 );
+	}
+	endChunk( out, typeOfs );
+
+	if (plte)
+	{
+		typeOfs = beginChunk( out, "PLTE", numColors * 3 );
+		out.insert( out.end(), plte, plte + numColors * 3 );
+		endChunk( out, typeOfs );
+	}
+
+	typeOfs = beginChunk( out, "IDAT", 0 );
+
+	if (!deflateRows( out, pix, (colorType == 2) ? width * 3 : width, height, pitch ))
+	{
+		out.clear();
+		return false;
+	}
+	put32( &out[typeOfs-4], out.size() - typeOfs - 4 );
+	endChunk( out, typeOfs );
+
+	typeOfs = beginChunk( out, "IEND", 0 );
+	endChunk( out, typeOfs );
+
+	return true;
+}
+
+bool pngEncoder::encodeIndexed( std::vector<uint8_t> &out, const uint8_t *pix,
+		int width, int height, int pitch,
+		const uint8_t *rgb, int numColors )
+{
+	if ((numColors < 1) || (numColors > 256))
+	{
+		return false;
+	}
+	return encode( out, pix, width, height, pitch, 3, rgb, numColors );
+}
+
+bool pngEncoder::encodeRGB( std::vector<uint8_t> &out, const uint8_t *rgb,
+		int width, int height, int pitch )
+{
+	return encode( out, rgb, width, height, pitch, 2, NULL, 0 );
+}
+
+};
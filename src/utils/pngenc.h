@@ -0,0 +1,53 @@
+// pngenc.h
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <zlib.h>
+
+namespace FCEU
+{
+	// Writes PNG images into memory. Indexed images carry their own PLTE
+	// chunk and one byte per pixel, which for an NES frame is about a
+	// quarter of the size of the RGB encoding and much faster to deflate.
+	// The deflate stream is kept between images and only reset, so an
+	// encoder that lives as long as its caller does no allocation per
+	// image once the output vector has grown. An encoder is not thread
+	// safe; give each thread its own.
+	class pngEncoder
+	{
+		public:
+			pngEncoder(int level = 1);
+			~pngEncoder(void);
+
+			// zlib level, 0 (store) to 9. Out of range values are clamped.
+			void setCompressionLevel(int level);
+			int  getCompressionLevel(void){ return level; };
+
+			// 8-bit indexed image. pix holds height rows of width palette
+			// indices, pitch bytes apart. rgb holds numColors (1 to 256)
+			// packed R,G,B triplets. Returns false when deflate fails.
+			bool encodeIndexed( std::vector<uint8_t> &out, const uint8_t *pix,
+					int width, int height, int pitch,
+					const uint8_t *rgb, int numColors );
+
+			// 24-bit RGB image, rows of width packed R,G,B triplets.
+			bool encodeRGB( std::vector<uint8_t> &out, const uint8_t *rgb,
+					int width, int height, int pitch );
+
+		private:
+			bool encode( std::vector<uint8_t> &out, const uint8_t *pix,
+					int width, int height, int pitch, int colorType,
+					const uint8_t *plte, int numColors );
+			bool deflateRows( std::vector<uint8_t> &out, const uint8_t *pix,
+					int rowBytes, int height, int pitch );
+
+			z_stream zs;
+			bool     zsInit;
+			int      level;
+			int      zsLevel;
+
+			std::vector<uint8_t> row;
+	};
+};
@@ -24,6 +24,7 @@
 #include "file.h"
 #include "utils/memory.h"
 #include "utils/crc32.h"
+#include "utils/pngenc.h"
 #include "state.h"
 #include "movie.h"
 #include "palette.h"
@@ -138,19 +139,22 @@ int FCEU_InitVirtualVideo(void)
 	return 1;
 }
 
-#ifdef FRAMESKIP
+//FCEU_PutImage for a frame that is not shown
 void FCEU_PutImageDummy(void)
 {
 	ShowFPS();
 	if(GameInfo->type!=GIT_NSF)
 	{
+		//pausing or saving a state next still has the latest picture
+		if(!FCEUI_EmulationPaused())
+			memcpy(XBackBuf, XBuf, 256*256);
+
 		FCEU_DrawNTSCControlBars(XBuf);
 		FCEU_DrawSaveStates(XBuf);
 		FCEU_DrawMovies(XBuf);
 	}
 	if(guiMessage.howlong) guiMessage.howlong--; /* DrawMessage() */
 }
-#endif
 
 static int dosnapsave=0;
 void FCEUI_SaveSnapshot(void)
@@ -456,40 +460,6 @@ void FCEU_ResetMessages()
 }
 
 
-static int WritePNGChunk(FILE *fp, uint32 size, const char *type, uint8 *data)
-{
-	uint32 crc;
-
-	uint8 tempo[4];
-
-	tempo[0]=size>>24;
-	tempo[1]=size>>16;
-	tempo[2]=size>>8;
-	tempo[3]=size;
-
-	if(fwrite(tempo,4,1,fp)!=1)
-		return 0;
-	if(fwrite(type,4,1,fp)!=1)
-		return 0;
-
-	if(size)
-		if(fwrite(data,1,size,fp)!=size)
-			return 0;
-
-	crc=CalcCRC32(0,(uint8 *)type,4);
-	if(size)
-		crc=CalcCRC32(crc,data,size);
-
-	tempo[0]=crc>>24;
-	tempo[1]=crc>>16;
-	tempo[2]=crc>>8;
-	tempo[3]=crc;
-
-	if(fwrite(tempo,4,1,fp)!=1)
-		return 0;
-	return 1;
-}
-
 uint32 GetScreenPixel(int x, int y, bool usebackup) {
 
 	uint8 r,g,b;
@@ -518,197 +488,194 @@ int GetScreenPixelPalette(int x, int y, bool usebackup) {
 
 }
 
-int SaveSnapshot(void)
+// The snapshot encoder is shared by SaveSnapshot() and the Qt REST
+// screenshot command. Both only run with the emulator locked.
+static FCEU::pngEncoder snapEncoder(1);
+
+int FCEUI_GetPNGCompressionLevel(void)
 {
-	int totallines=FSettings.LastSLine-FSettings.FirstSLine+1;
-	int x,u,y;
-	FILE *pp=NULL;
-	uint8 *compmem=NULL;
-	uLongf compmemsize=(totallines*263+12)*3;
+	return snapEncoder.getCompressionLevel();
+}
 
-	if(!(compmem=(uint8 *)FCEU_malloc(compmemsize)))
-		return 0;
+void FCEUI_SetPNGCompressionLevel(int level)
+{
+	snapEncoder.setCompressionLevel(level);
+}
 
-	for (u = lastu; u < 99999; ++u)
+static void SnapshotColor(int key, uint8 pixel, uint8 *c)
+{
+	if(key>=256 && palo)
 	{
-		pp=FCEUD_UTF8fopen(FCEU_MakeFName(FCEUMKF_SNAP,u,"png").c_str(),"rb");
-		if(pp==NULL) break;
-		fclose(pp);
+		c[0]=palo[key-256+64].r;
+		c[1]=palo[key-256+64].g;
+		c[2]=palo[key-256+64].b;
 	}
-	lastu = u;
+	else
+		FCEUD_GetPalette(pixel,c,c+1,c+2);
+}
 
-	if(!(pp=FCEUD_UTF8fopen(FCEU_MakeFName(FCEUMKF_SNAP,u,"png").c_str(),"wb")))
-	{
-		free(compmem);
-		return 0;
-	}
+//encodes scanlines firstLine to lastLine of XBuf as a PNG. Every distinct
+//(pixel, deemph) pair in the frame gets a palette entry of its own, with the
+//same color ModernDeemphColorMap() would give it, so the result is an 8-bit
+//indexed image. A frame with more than 256 such pairs goes out as RGB.
+bool FCEU_EncodeSnapshotPNG(std::vector<uint8> &out, int firstLine, int lastLine)
+{
+	static uint8 plane[256*256];
+	int16 slot[256+512];
+	uint8 plte[256*3];
+	int totallines=lastLine-firstLine+1;
+	int numColors=0;
+	int i;
+
+	if(!XBuf || !XDBuf || totallines<=0)
+		return false;
 
+	memset(slot,0xFF,sizeof(slot));
+
+	const uint8 *src=XBuf+firstLine*256;
+	const uint8 *dsrc=XDBuf+firstLine*256;
+
+	for(i=0;i<totallines*256;i++)
 	{
-		static const uint8 header[8]={137,80,78,71,13,10,26,10};
-		if(fwrite(header,8,1,pp)!=1)
-			goto PNGerr;
+		uint8 pixel=src[i];
+		int key=dsrc[i] ? 256+(pixel&0x3F)+(dsrc[i]*64)-64 : pixel;
+
+		if(slot[key]<0)
+		{
+			if(numColors==256)
+				break;
+			SnapshotColor(key,pixel,plte+numColors*3);
+			slot[key]=numColors++;
+		}
+		plane[i]=(uint8)slot[key];
 	}
 
+	if(i==totallines*256)
+		return snapEncoder.encodeIndexed(out,plane,256,totallines,256,plte,numColors);
+
+	//too many colors for a palette
+	std::vector<uint8> rgb(totallines*256*3);
+	for(i=0;i<totallines*256;i++)
 	{
-		uint8 chunko[13];
+		uint8 pixel=src[i];
+		SnapshotColor(dsrc[i] ? 256+(pixel&0x3F)+(dsrc[i]*64)-64 : pixel,pixel,&rgb[i*3]);
+	}
+	return snapEncoder.encodeRGB(out,&rgb[0],256,totallines,256*3);
+}
 
-		chunko[0]=chunko[1]=chunko[3]=0;
-		chunko[2]=0x1;			// Width of 256
+static bool WriteSnapshotFile(FILE *pp)
+{
+	std::vector<uint8> png;
 
-		chunko[4]=chunko[5]=chunko[6]=0;
-		chunko[7]=totallines;			// Height
+	if(!FCEU_EncodeSnapshotPNG(png,FSettings.FirstSLine,FSettings.LastSLine))
+		return false;
 
-		chunko[8]=8;				// 8 bits per sample(24 bits per pixel)
-		chunko[9]=2;				// Color type; RGB triplet
-		chunko[10]=0;				// compression: deflate
-		chunko[11]=0;				// Basic adapative filter set(though none are used).
-		chunko[12]=0;				// No interlace.
+	return fwrite(&png[0],1,png.size(),pp)==png.size();
+}
 
-		if(!WritePNGChunk(pp,13,"IHDR",chunko))
-			goto PNGerr;
-	}
+int SaveSnapshot(void)
+{
+	int u;
+	FILE *pp=NULL;
 
+	for (u = lastu; u < 99999; ++u)
 	{
-		uint8 *tmp=XBuf+FSettings.FirstSLine*256;
-		uint8 *dest,*mal,*mork;
-
-		int bufsize = (256*3+1)*totallines;
-		if(!(mal=mork=dest=(uint8 *)FCEU_dmalloc(bufsize)))
-			goto PNGerr;
-		//   mork=dest=XBuf;
+		pp=FCEUD_UTF8fopen(FCEU_MakeFName(FCEUMKF_SNAP,u,"png").c_str(),"rb");
+		if(pp==NULL) break;
+		fclose(pp);
+	}
+	lastu = u;
 
-		for(y=0;y<totallines;y++)
-		{
-			*dest=0;			// No filter.
-			dest++;
-			for(x=256;x;x--)
-			{
-				u32 color = ModernDeemphColorMap(tmp,XBuf,1);
-				*dest++=(color>>0x10)&0xFF;
-				*dest++=(color>>0x08)&0xFF;
-				*dest++=(color>>0x00)&0xFF;
-				tmp++;
-			}
-		}
+	if(!(pp=FCEUD_UTF8fopen(FCEU_MakeFName(FCEUMKF_SNAP,u,"png").c_str(),"wb")))
+		return 0;
 
-		if(compress(compmem,&compmemsize,mork,bufsize)!=Z_OK)
-		{
-			if(mal) free(mal);
-			goto PNGerr;
-		}
-		if(mal) free(mal);
-		if(!WritePNGChunk(pp,compmemsize,"IDAT",compmem))
-			goto PNGerr;
+	if(!WriteSnapshotFile(pp))
+	{
+		fclose(pp);
+		return 0;
 	}
-	if(!WritePNGChunk(pp,0,"IEND",0))
-		goto PNGerr;
-
-	free(compmem);
 	fclose(pp);
 
 	return u+1;
-
-
-PNGerr:
-	if(compmem)
-		free(compmem);
-	if(pp)
-		fclose(pp);
-	return(0);
 }
 
 //overloaded SaveSnapshot for "Savesnapshot As" function
 int SaveSnapshot(char fileName[512])
 {
-	int totallines=FSettings.LastSLine-FSettings.FirstSLine+1;
-	int x,y;
 	FILE *pp=NULL;
-	uint8 *compmem=NULL;
-	uLongf compmemsize=totallines*263+12;
-
-	if(!(compmem=(uint8 *)FCEU_malloc(compmemsize)))
-		return 0;
 
 	if(!(pp=FCEUD_UTF8fopen(fileName,"wb")))
-	{
-		free(compmem);
 		return 0;
-	}
 
-	{
-		static uint8 header[8]={137,80,78,71,13,10,26,10};
-		if(fwrite(header,8,1,pp)!=1)
-			goto PNGerr;
-	}
-
-	{
-		uint8 chunko[13];
+	WriteSnapshotFile(pp);
+	fclose(pp);
 
-		chunko[0]=chunko[1]=chunko[3]=0;
-		chunko[2]=0x1;			// Width of 256
+	return 0;
+}
+FCEU_FrameChangeTracker::FCEU_FrameChangeTracker(void)
+{
+	prev = (uint8*)FCEU_dmalloc(256*240*2);
+	memset(prevPal,0,sizeof(prevPal));
+	memset(lineMask,0xFF,sizeof(lineMask));
+	valid = false;
+}
 
-		chunko[4]=chunko[5]=chunko[6]=0;
-		chunko[7]=totallines;			// Height
+FCEU_FrameChangeTracker::~FCEU_FrameChangeTracker(void)
+{
+	if(prev) free(prev);
+}
 
-		chunko[8]=8;				// bit depth
-		chunko[9]=3;				// Color type; indexed 8-bit
-		chunko[10]=0;				// compression: deflate
-		chunko[11]=0;				// Basic adapative filter set(though none are used).
-		chunko[12]=0;				// No interlace.
+int FCEU_FrameChangeTracker::update(const uint8 *pix, const uint8 *deemph)
+{
+	uint8 pal[(256+512)*3];
+	int changes=0;
+	int y;
 
-		if(!WritePNGChunk(pp,13,"IHDR",chunko))
-			goto PNGerr;
+	for(y=0;y<256;y++)
+		FCEUD_GetPalette(y,pal+y*3,pal+y*3+1,pal+y*3+2);
+	for(y=0;y<512;y++)
+	{
+		uint8 *c=pal+(256+y)*3;
+		c[0]=palo ? palo[y].r : 0;
+		c[1]=palo ? palo[y].g : 0;
+		c[2]=palo ? palo[y].b : 0;
 	}
 
+	if(!prev)
 	{
-		uint8 pdata[256*3];
-		for(x=0;x<256;x++)
-			FCEUD_GetPalette(x,pdata+x*3,pdata+x*3+1,pdata+x*3+2);
-		if(!WritePNGChunk(pp,256*3,"PLTE",pdata))
-			goto PNGerr;
+		memset(lineMask,0xFF,sizeof(lineMask));
+		return FCEU_FRAME_LINES_CHANGED|FCEU_FRAME_PALETTE_CHANGED;
 	}
 
+	if(!valid || memcmp(pal,prevPal,sizeof(pal)))
 	{
-		uint8 *tmp=XBuf+FSettings.FirstSLine*256;
-		uint8 *dest,*mal,*mork;
+		memcpy(prevPal,pal,sizeof(pal));
+		changes|=FCEU_FRAME_PALETTE_CHANGED;
+	}
 
-		if(!(mal=mork=dest=(uint8 *)FCEU_dmalloc((totallines<<8)+totallines)))
-			goto PNGerr;
-		//   mork=dest=XBuf;
+	memset(lineMask,0,sizeof(lineMask));
 
-		for(y=0;y<totallines;y++)
-		{
-			*dest=0;			// No filter.
-			dest++;
-			for(x=256;x;x--,tmp++,dest++)
-				*dest=*tmp;
-		}
+	for(y=0;y<240;y++)
+	{
+		uint8 *p=prev+y*256;
+		uint8 *d=prev+(240+y)*256;
 
-		if(compress(compmem,&compmemsize,mork,(totallines<<8)+totallines)!=Z_OK)
+		if(!valid || memcmp(p,pix+y*256,256) || memcmp(d,deemph+y*256,256))
 		{
-			if(mal) free(mal);
-			goto PNGerr;
+			memcpy(p,pix+y*256,256);
+			memcpy(d,deemph+y*256,256);
+			lineMask[y>>3]|=1<<(y&7);
+			changes|=FCEU_FRAME_LINES_CHANGED;
 		}
-		if(mal) free(mal);
-		if(!WritePNGChunk(pp,compmemsize,"IDAT",compmem))
-			goto PNGerr;
 	}
-	if(!WritePNGChunk(pp,0,"IEND",0))
-		goto PNGerr;
 
-	free(compmem);
-	fclose(pp);
-
-	return 0;
+	if(changes&FCEU_FRAME_PALETTE_CHANGED)
+		memset(lineMask,0xFF,sizeof(lineMask));
 
-
-PNGerr:
-	if(compmem)
-		free(compmem);
-	if(pp)
-		fclose(pp);
-	return(0);
+	valid=true;
+	return changes;
 }
+
 // called when another ROM is opened
 void ResetScreenshotsCounter()
 {
@@ -1,9 +1,15 @@
 #ifndef _VIDEO_H_
 #define _VIDEO_H_
+#include <vector>
+#include "types.h"
+
 int FCEU_InitVirtualVideo(void);
 void FCEU_KillVirtualVideo(void);
 int SaveSnapshot(void);
 int SaveSnapshot(char[]);
+bool FCEU_EncodeSnapshotPNG(std::vector<uint8> &out, int firstLine, int lastLine);
+int FCEUI_GetPNGCompressionLevel(void);
+void FCEUI_SetPNGCompressionLevel(int level);
 void ResetScreenshotsCounter();
 uint32 GetScreenPixel(int x, int y, bool usebackup);
 int GetScreenPixelPalette(int x, int y, bool usebackup);
@@ -23,6 +29,37 @@ extern xfbuf_t *XFBuf;
 
 extern int ClipSidesOffset;
 
+//Tells whether a frame looks different from the one passed before it, line
+//by line, so frontends can skip scaling, uploading and encoding frames that
+//did not change. Each consumer keeps its own tracker, since each sees its
+//own sequence of frames (frameskip, HUD recording on or off).
+#define FCEU_FRAME_LINES_CHANGED    0x01	//some lines differ, see lineChanged()
+#define FCEU_FRAME_PALETTE_CHANGED  0x02	//the RGB palette differs, every line is marked
+
+class FCEU_FrameChangeTracker
+{
+public:
+	FCEU_FrameChangeTracker(void);
+	~FCEU_FrameChangeTracker(void);
+
+	//compares 256x240 pix and its deemph plane with the previous call and
+	//keeps them for the next one. Returns FCEU_FRAME_* flags, 0 when the
+	//frame is an exact repeat. The first call reports everything changed.
+	int update(const uint8 *pix, const uint8 *deemph);
+
+	//makes the next update() report everything changed
+	void invalidate(void) { valid = false; }
+
+	bool lineChanged(int y) const { return (lineMask[y >> 3] >> (y & 7)) & 1; }
+
+	uint8 lineMask[240/8];
+
+private:
+	uint8 *prev;	//pixels then deemph, 256*240 each
+	uint8 prevPal[(256+512)*3];
+	bool valid;
+};
+
 struct GUIMESSAGE
 {
 	//countdown for gui messages
@@ -300,6 +300,13 @@ VSUNIENTRY VSUniGames[] =
 	{ 0 }
 };
 
+const VSUNIENTRY *FCEU_VSUniFind(uint64 md5partial) {
+	for (const VSUNIENTRY *vs = VSUniGames; vs->name; vs++)
+		if (md5partial == vs->md5partial)
+			return vs;
+	return NULL;
+}
+
 void FCEU_VSUniCheck(uint64 md5partial, int *MapperNo, uint8 *Mirroring) {
 	VSUNIENTRY *vs = VSUniGames;
 
@@ -17,6 +17,7 @@ typedef struct {
 
 void FCEU_VSUniPower(void);
 void FCEU_VSUniCheck(uint64 md5partial, int *, uint8 *);
+const VSUNIENTRY *FCEU_VSUniFind(uint64 md5partial);  /* Known VS game, without setting it up */
 void FCEU_VSUniDraw(uint8 *XBuf);
 
 void FCEU_VSUniToggleDIP(int);  /* For movies and netplay */
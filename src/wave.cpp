@@ -4,90 +4,547 @@
 #include "driver.h"
 #include "sound.h"
 #include "wave.h"
+#include "file.h"
+#include "utils/md5.h"
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//the samples of a recording are handed through a ring buffer to a writer
+//thread, which writes them in batches, so that a slow disk holds up the
+//writer and not the frame. the frame only waits when the ring is full, no
+//sample is ever dropped. names ending in .flac are encoded to FLAC by the
+//writer, anything else is written as 16 bit PCM .wav.
+
+static int waveBufferKB = 1024;
+static int waveBatchKB = 64;
+static int waveSync = FCEU_WAVE_SYNC_CLOSE;
 
 static FILE *soundlog=0;
 static long wsize;
+static bool waveFlac;
+static bool waveOk;
 
-/* Checking whether the file exists before wiping it out is left up to the
-   reader..err...I mean, the driver code, if it feels so inclined(I don't feel
-   so).
-*/
-void FCEU_WriteWaveData(int32 *Buffer, int Count)
+static std::mutex waveMutex;
+static std::condition_variable waveCond;
+static std::thread *waveWriter = NULL;
+static std::vector<int16> waveRing;
+static size_t waveHead, waveTail, waveUsed;	//head is written by the frame, tail by the writer
+static size_t waveBatch;
+static bool waveQuit;
+
+void FCEUI_SetWaveRecordBuffering(int bufferKB, int batchKB, int sync)
+{
+	waveBufferKB = bufferKB < 16 ? 16 : bufferKB;
+	waveBatchKB = batchKB < 1 ? 1 : batchKB;
+	waveSync = sync;
+}
+
+//----------------------------------------------------------------------------
+//FLAC, as the smallest encoder that does it: blocks of 4096 samples, each a
+//single mono subframe that is constant, one of the fixed predictors (orders
+//0 to 4, with a Rice coded residual) or verbatim, whichever is shortest.
+
+enum { FLAC_BLOCK = 4096, FLAC_MAX_ORDER = 4, FLAC_MAX_PARTITION_ORDER = 6, FLAC_MAX_RICE = 14 };
+
+static std::vector<int32> flacBlock;	//samples gathered for the next frame
+static std::vector<uint8> flacFrame;
+static uint32 flacFrames;
+static uint64 flacSamples;
+static uint32 flacMinFrame, flacMaxFrame;
+static md5_context flacMD5;
+static int flacRate;
+
+struct FlacBits
 {
-	//mbg merge 7/17/06 changed to alloca
- //int16 temp[Count];  /* Yay.  Is this the first use of this "feature" of C in FCE Ultra? */
- int16 *temp = (int16*)alloca(Count*2);
+	std::vector<uint8> &out;
+	uint64 acc;
+	int bits;
+
+	FlacBits(std::vector<uint8> &o) : out(o), acc(0), bits(0) {}
+
+	void put(uint32 v, int n)
+	{
+		if(n == 0)
+			return;
+		acc = (acc << n) | (n == 32 ? v : (v & ((1u << n) - 1)));
+		bits += n;
+		while(bits >= 8)
+		{
+			bits -= 8;
+			out.push_back((uint8)(acc >> bits));
+		}
+		acc &= (1u << bits) - 1;
+	}
 
- int16 *dest;
- int x;
+	void zeros(uint32 n)
+	{
+		for(; n >= 32; n -= 32)
+			put(0, 32);
+		put(0, n);
+	}
 
-#ifndef __WIN_DRIVER__
- if(!soundlog) return;
-#else
- if(!soundlog && !FCEUI_AviIsRecording()) return;
-#endif
+	void align(void)
+	{
+		if(bits)
+			put(0, 8 - bits);
+	}
+};
 
- dest=temp;
- x=Count;
+static uint8 FlacCRC8(const uint8 *p, size_t len)
+{
+	uint8 crc = 0;
+	while(len--)
+	{
+		crc ^= *p++;
+		for(int i = 0; i < 8; i++)
+			crc = (crc & 0x80) ? (uint8)((crc << 1) ^ 0x07) : (uint8)(crc << 1);
+	}
+	return crc;
+}
 
- //mbg 7/28/06 - we appear to be guaranteeing little endian
- while(x--)
- {
-  int16 tmp=*Buffer;
+static uint16 FlacCRC16(const uint8 *p, size_t len)
+{
+	uint16 crc = 0;
+	while(len--)
+	{
+		crc ^= (uint16)(*p++) << 8;
+		for(int i = 0; i < 8; i++)
+			crc = (crc & 0x8000) ? (uint16)((crc << 1) ^ 0x8005) : (uint16)(crc << 1);
+	}
+	return crc;
+}
 
-  *(uint8 *)dest=(((uint16)tmp)&255);
-  *(((uint8 *)dest)+1)=(((uint16)tmp)>>8);
-  dest++;
-  Buffer++;
- }
- if(soundlog)
-	 wsize+=fwrite(temp,1,Count*sizeof(int16),soundlog);
+static void FlacResidual(const int32 *x, int n, int order, std::vector<uint32> &u)
+{
+	u.resize(n);
+	for(int i = order; i < n; i++)
+	{
+		int32 r;
+		switch(order)
+		{
+			case 0: r = x[i]; break;
+			case 1: r = x[i] - x[i-1]; break;
+			case 2: r = x[i] - 2*x[i-1] + x[i-2]; break;
+			case 3: r = x[i] - 3*x[i-1] + 3*x[i-2] - x[i-3]; break;
+			default: r = x[i] - 4*x[i-1] + 6*x[i-2] - 4*x[i-3] + x[i-4]; break;
+		}
+		u[i] = ((uint32)r << 1) ^ (uint32)(r >> 31);	//zigzag, as Rice codes it
+	}
+}
 
+static uint64 FlacRiceBits(const uint32 *u, int n, int k)
+{
+	uint64 bits = (uint64)n * (k + 1);
+	for(int i = 0; i < n; i++)
+		bits += u[i] >> k;
+	return bits;
+}
+
+//best Rice parameter of a partition, around the one its mean suggests
+static int FlacRiceParam(const uint32 *u, int n, uint64 &bits)
+{
+	uint64 sum = 0;
+	for(int i = 0; i < n; i++)
+		sum += u[i];
+	int guess = 0;
+	while(guess < FLAC_MAX_RICE && ((uint64)n << (guess + 1)) <= sum)
+		guess++;
+
+	int best = guess;
+	bits = FlacRiceBits(u, n, guess);
+	for(int k = guess - 1; k <= guess + 1; k += 2)
+	{
+		if(k < 0 || k > FLAC_MAX_RICE)
+			continue;
+		uint64 b = FlacRiceBits(u, n, k);
+		if(b < bits)
+		{
+			bits = b;
+			best = k;
+		}
+	}
+	return best;
+}
+
+//length in bits of the residual at each partition order, the best kept
+static uint64 FlacPartitionBits(const std::vector<uint32> &u, int n, int order, int &bestPartOrder, std::vector<int> &params)
+{
+	uint64 best = ~(uint64)0;
+	std::vector<int> p;
+	for(int po = 0; po <= FLAC_MAX_PARTITION_ORDER; po++)
+	{
+		int parts = 1 << po;
+		if(n % parts || (n >> po) <= order)
+			break;
+		uint64 bits = 2 + 4;
+		p.clear();
+		for(int i = 0; i < parts; i++)
+		{
+			int start = i ? i * (n >> po) : order;
+			int end = (i + 1) * (n >> po);
+			uint64 b;
+			p.push_back(FlacRiceParam(&u[start], end - start, b));
+			bits += 4 + b;
+		}
+		if(bits < best)
+		{
+			best = bits;
+			bestPartOrder = po;
+			params = p;
+		}
+	}
+	return best;
+}
+
+static void FlacPutUTF8(FlacBits &bw, uint32 v)
+{
+	if(v < 0x80)
+	{
+		bw.put(v, 8);
+		return;
+	}
+	int n = v < 0x800 ? 2 : v < 0x10000 ? 3 : v < 0x200000 ? 4 : v < 0x4000000 ? 5 : 6;
+	bw.put(((0xFF00 >> n) & 0xFF) | (v >> (6 * (n - 1))), 8);
+	for(int i = n - 2; i >= 0; i--)
+		bw.put(0x80 | ((v >> (6 * i)) & 0x3F), 8);
+}
+
+static int FlacRateCode(int rate)
+{
+	switch(rate)
+	{
+		case 88200: return 1;
+		case 176400: return 2;
+		case 192000: return 3;
+		case 8000: return 4;
+		case 16000: return 5;
+		case 22050: return 6;
+		case 24000: return 7;
+		case 32000: return 8;
+		case 44100: return 9;
+		case 48000: return 10;
+		case 96000: return 11;
+	}
+	if(rate % 1000 == 0 && rate / 1000 < 256)
+		return 12;
+	if(rate < 65536)
+		return 13;
+	return 0;
+}
+
+static bool FlacWriteFrame(const int32 *x, int n)
+{
+	flacFrame.clear();
+	FlacBits bw(flacFrame);
+
+	int rateCode = FlacRateCode(flacRate);
+	bw.put(0x3FFE, 14);
+	bw.put(0, 1);
+	bw.put(0, 1);				//fixed block size
+	bw.put(n == FLAC_BLOCK ? 12 : 7, 4);
+	bw.put(rateCode, 4);
+	bw.put(0, 4);				//mono
+	bw.put(4, 3);				//16 bits
+	bw.put(0, 1);
+	FlacPutUTF8(bw, flacFrames);
+	if(n != FLAC_BLOCK)
+		bw.put(n - 1, 16);
+	if(rateCode == 12)
+		bw.put(flacRate / 1000, 8);
+	else if(rateCode == 13)
+		bw.put(flacRate, 16);
+	bw.put(FlacCRC8(&flacFrame[0], flacFrame.size()), 8);
+
+	bool constant = true;
+	for(int i = 1; i < n && constant; i++)
+		constant = x[i] == x[0];
+
+	if(constant)
+	{
+		bw.put(0, 8);
+		bw.put((uint32)x[0], 16);
+	}
+	else
+	{
+		//pick the predictor that codes shortest
+		std::vector<uint32> u;
+		std::vector<int> params, bestParams;
+		uint64 bestBits = (uint64)n * 16;
+		int bestOrder = -1, bestPartOrder = 0;
+		for(int order = 0; order <= FLAC_MAX_ORDER && order < n; order++)
+		{
+			int po = 0;
+			FlacResidual(x, n, order, u);
+			uint64 bits = order * 16 + FlacPartitionBits(u, n, order, po, params);
+			if(bits < bestBits)
+			{
+				bestBits = bits;
+				bestOrder = order;
+				bestPartOrder = po;
+				bestParams = params;
+			}
+		}
+
+		if(bestOrder < 0)
+		{
+			bw.put(1 << 1, 8);		//verbatim
+			for(int i = 0; i < n; i++)
+				bw.put((uint32)x[i], 16);
+		}
+		else
+		{
+			bw.put((8 | bestOrder) << 1, 8);
+			for(int i = 0; i < bestOrder; i++)
+				bw.put((uint32)x[i], 16);
+			FlacResidual(x, n, bestOrder, u);
+			bw.put(0, 2);
+			bw.put(bestPartOrder, 4);
+			int parts = 1 << bestPartOrder;
+			for(int i = 0; i < parts; i++)
+			{
+				int k = bestParams[i];
+				int start = i ? i * (n >> bestPartOrder) : bestOrder;
+				int end = (i + 1) * (n >> bestPartOrder);
+				bw.put(k, 4);
+				for(int j = start; j < end; j++)
+				{
+					bw.zeros(u[j] >> k);
+					bw.put(1, 1);
+					bw.put(u[j], k);
+				}
+			}
+		}
+	}
+	bw.align();
+	bw.put(FlacCRC16(&flacFrame[0], flacFrame.size()), 16);
+
+	uint32 size = flacFrame.size();
+	if(!flacFrames || size < flacMinFrame)
+		flacMinFrame = size;
+	if(size > flacMaxFrame)
+		flacMaxFrame = size;
+	flacFrames++;
+	flacSamples += n;
+	return fwrite(&flacFrame[0], 1, size, soundlog) == size;
+}
+
+static void FlacStreamInfo(std::vector<uint8> &out, const uint8 *md5)
+{
+	FlacBits bw(out);
+	bw.put(1, 1);				//last metadata block
+	bw.put(0, 7);				//STREAMINFO
+	bw.put(34, 24);
+	bw.put(FLAC_BLOCK, 16);
+	bw.put(FLAC_BLOCK, 16);
+	bw.put(flacMinFrame, 24);
+	bw.put(flacMaxFrame, 24);
+	bw.put(flacRate, 20);
+	bw.put(0, 3);				//1 channel
+	bw.put(15, 5);				//16 bits
+	bw.put((uint32)(flacSamples >> 32), 4);
+	bw.put((uint32)flacSamples, 32);
+	for(int i = 0; i < 16; i++)
+		bw.put(md5 ? md5[i] : 0, 8);
+}
+
+//----------------------------------------------------------------------------
+//writer thread
+
+static bool WriteWaveSamples(const int16 *s, size_t n)
+{
+	static std::vector<uint8> bytes;
+
+	//mbg 7/28/06 - we appear to be guaranteeing little endian
+	bytes.resize(n * 2);
+	for(size_t i = 0; i < n; i++)
+	{
+		bytes[i*2] = ((uint16)s[i]) & 255;
+		bytes[i*2+1] = ((uint16)s[i]) >> 8;
+	}
+
+	if(!waveFlac)
+	{
+		size_t written = fwrite(&bytes[0], 1, bytes.size(), soundlog);
+		wsize += written;
+		return written == bytes.size();
+	}
+
+	md5_update(&flacMD5, &bytes[0], bytes.size());
+	bool ok = true;
+	for(size_t i = 0; i < n; i++)
+	{
+		flacBlock.push_back(s[i]);
+		if(flacBlock.size() == FLAC_BLOCK)
+		{
+			ok &= FlacWriteFrame(&flacBlock[0], FLAC_BLOCK);
+			flacBlock.clear();
+		}
+	}
+	return ok;
+}
+
+static void PutLE32(FILE *fp, long s)
+{
+	fputc(s&0xFF,fp);
+	fputc((s>>8)&0xFF,fp);
+	fputc((s>>16)&0xFF,fp);
+	fputc((s>>24)&0xFF,fp);
+}
+
+//the sizes in the header are filled in once the length is known
+static bool FinishWaveFile(void)
+{
+	bool ok = true;
+	if(waveFlac)
+	{
+		if(!flacBlock.empty())
+			ok &= FlacWriteFrame(&flacBlock[0], flacBlock.size());
+		flacBlock.clear();
+
+		uint8 md5[16];
+		md5_finish(&flacMD5, md5);
+		std::vector<uint8> info;
+		FlacStreamInfo(info, md5);
+		fseek(soundlog,4,SEEK_SET);
+		ok &= fwrite(&info[0], 1, info.size(), soundlog) == info.size();
+	}
+	else
+	{
+		long s=ftell(soundlog)-8;
+		fseek(soundlog,4,SEEK_SET);
+		PutLE32(soundlog,s);
+
+		fseek(soundlog,0x28,SEEK_SET);
+		PutLE32(soundlog,wsize);
+	}
+	if(waveSync != FCEU_WAVE_SYNC_NONE)
+		ok &= FCEU_SyncFile(soundlog);
+	ok &= fclose(soundlog) == 0;
+	soundlog = 0;
+	return ok;
+}
+
+static void WaveWriterLoop(void)
+{
+	std::unique_lock<std::mutex> lock(waveMutex);
+
+	for(;;)
+	{
+		if(waveUsed < waveBatch && !waveQuit)
+		{
+			waveCond.wait(lock);
+			continue;
+		}
+		if(!waveUsed)
+			break;
+
+		//the frame does not touch the samples between tail and head, so
+		//they are written from the ring without the lock
+		size_t n = waveUsed;
+		if(n > waveRing.size() - waveTail)
+			n = waveRing.size() - waveTail;
+		const int16 *s = &waveRing[waveTail];
+
+		lock.unlock();
+		bool ok = WriteWaveSamples(s, n);
+		if(ok && waveSync == FCEU_WAVE_SYNC_BATCH)
+			ok = FCEU_SyncFile(soundlog);
+		lock.lock();
+
+		waveOk &= ok;
+		waveTail = (waveTail + n) % waveRing.size();
+		waveUsed -= n;
+		waveCond.notify_all();
+	}
+	lock.unlock();
+
+	bool ok = FinishWaveFile();
+	lock.lock();
+	waveOk &= ok;
+}
+
+//----------------------------------------------------------------------------
+
+/* Checking whether the file exists before wiping it out is left up to the
+   reader..err...I mean, the driver code, if it feels so inclined(I don't feel
+   so).
+*/
+void FCEU_WriteWaveData(int32 *Buffer, int Count)
+{
 	#ifdef __WIN_DRIVER__
 	if(FCEUI_AviIsRecording())
 	{
+		//mbg merge 7/17/06 changed to alloca
+		int16 *temp = (int16*)alloca(Count*2);
+		for(int x = 0; x < Count; x++)
+		{
+			int16 tmp=Buffer[x];
+			*(uint8 *)(temp+x)=(((uint16)tmp)&255);
+			*(((uint8 *)(temp+x))+1)=(((uint16)tmp)>>8);
+		}
 		FCEUI_AviSoundUpdate((void*)temp, Count);
 	}
 	#endif
+
+	if(!waveWriter)
+		return;
+
+	std::unique_lock<std::mutex> lock(waveMutex);
+	while(Count > 0)
+	{
+		//a full ring means the disk is behind by all of it, wait for room
+		while(waveUsed == waveRing.size())
+			waveCond.wait(lock);
+
+		size_t n = waveRing.size() - waveUsed;
+		if(n > waveRing.size() - waveHead)
+			n = waveRing.size() - waveHead;
+		if(n > (size_t)Count)
+			n = Count;
+		for(size_t i = 0; i < n; i++)
+			waveRing[waveHead + i] = (int16)Buffer[i];
+		waveHead = (waveHead + n) % waveRing.size();
+		waveUsed += n;
+		Buffer += n;
+		Count -= n;
+
+		if(waveUsed >= waveBatch)
+			waveCond.notify_all();
+	}
 }
 
 int FCEUI_EndWaveRecord()
 {
- long s;
-
- if(!soundlog) return 0;
- s=ftell(soundlog)-8;
- fseek(soundlog,4,SEEK_SET);
- fputc(s&0xFF,soundlog);
- fputc((s>>8)&0xFF,soundlog);
- fputc((s>>16)&0xFF,soundlog);
- fputc((s>>24)&0xFF,soundlog);
+	if(!waveWriter) return 0;
 
- fseek(soundlog,0x28,SEEK_SET);
- s=wsize;
- fputc(s&0xFF,soundlog);
- fputc((s>>8)&0xFF,soundlog);
- fputc((s>>16)&0xFF,soundlog);
- fputc((s>>24)&0xFF,soundlog);
+	{
+		std::lock_guard<std::mutex> lock(waveMutex);
+		waveQuit = true;
+		waveCond.notify_all();
+	}
+	waveWriter->join();
+	delete waveWriter;
+	waveWriter = NULL;
+	std::vector<int16>().swap(waveRing);
 
- fclose(soundlog);
- soundlog=0;
- return 1;
+	if(!waveOk)
+	{
+		FCEU_PrintError("Error writing the sound recording.");
+		return 0;
+	}
+	return 1;
 }
 
-
-bool FCEUI_BeginWaveRecord(const char *fn)
+static void WriteWaveHeader(void)
 {
  int r;
 
- if(!(soundlog=FCEUD_UTF8fopen(fn,"wb")))
-  return false;
- wsize=0;
-
-
  /* Write the header. */
  fputs("RIFF",soundlog);
  fseek(soundlog,4,SEEK_CUR);  // Skip size
@@ -105,15 +562,9 @@ bool FCEUI_BeginWaveRecord(const char *fn)
  fputc(0,soundlog);
 
  r=FSettings.SndRate;
- fputc(r&0xFF,soundlog);
- fputc((r>>8)&0xFF,soundlog);
- fputc((r>>16)&0xFF,soundlog);
- fputc((r>>24)&0xFF,soundlog);
+ PutLE32(soundlog,r);
  r<<=1;
- fputc(r&0xFF,soundlog);
- fputc((r>>8)&0xFF,soundlog);
- fputc((r>>16)&0xFF,soundlog);
- fputc((r>>24)&0xFF,soundlog);
+ PutLE32(soundlog,r);
  fputc(2,soundlog);
  fputc(0,soundlog);
  fputc(16,soundlog);
@@ -121,11 +572,51 @@ bool FCEUI_BeginWaveRecord(const char *fn)
 
  fputs("data",soundlog);
  fseek(soundlog,4,SEEK_CUR);
+}
+
+bool FCEUI_BeginWaveRecord(const char *fn)
+{
+	if(waveWriter)
+		FCEUI_EndWaveRecord();
+
+	if(!(soundlog=FCEUD_UTF8fopen(fn,"wb")))
+		return false;
+	wsize=0;
+
+	size_t len = strlen(fn);
+	waveFlac = len > 5 && !strcasecmp(fn + len - 5, ".flac");
+
+	if(waveFlac)
+	{
+		flacBlock.clear();
+		flacFrames = 0;
+		flacSamples = 0;
+		flacMinFrame = flacMaxFrame = 0;
+		flacRate = FSettings.SndRate;
+		md5_starts(&flacMD5);
+
+		//the stream info is written again with the lengths at the end
+		std::vector<uint8> info;
+		FlacStreamInfo(info, NULL);
+		fputs("fLaC",soundlog);
+		fwrite(&info[0], 1, info.size(), soundlog);
+	}
+	else
+		WriteWaveHeader();
+
+	waveRing.assign((size_t)waveBufferKB * 1024 / sizeof(int16), 0);
+	waveBatch = (size_t)waveBatchKB * 1024 / sizeof(int16);
+	if(waveBatch > waveRing.size() / 2)
+		waveBatch = waveRing.size() / 2;
+	waveHead = waveTail = waveUsed = 0;
+	waveQuit = false;
+	waveOk = true;
+	waveWriter = new std::thread(WaveWriterLoop);
 
- return true;
+	return true;
 }
 
 bool FCEUI_WaveRecordRunning(void)
 {
-	return (soundlog != NULL);
+	return (waveWriter != NULL);
 }
@@ -0,0 +1,260 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// workerpool.cpp
+//
+#include "types.h"
+#include "workerpool.h"
+
+#ifdef FCEU_WORKER_POOL
+#include <cerrno>
+#include <cstdio>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static bool WriteAll(int fd, const void *data, size_t size)
+{
+	const char *buf = (const char *)data;
+	size_t done = 0;
+	while (done < size)
+	{
+		ssize_t n = write(fd, buf + done, size - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		done += n;
+	}
+	return true;
+}
+
+// false at the end of the pipe
+static bool ReadSome(int fd, std::vector<uint8> &data)
+{
+	uint8 buf[4096];
+	for (;;)
+	{
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data.insert(data.end(), buf, buf + n);
+		return true;
+	}
+}
+
+static int WaitWorker(int pid)
+{
+	int status = 0;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+	return status;
+}
+
+static std::string WorkerError(int status)
+{
+	char error[64];
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+		return std::string();
+	if (WIFSIGNALED(status))
+		snprintf(error, sizeof(error), "worker killed by signal %d", WTERMSIG(status));
+	else
+		snprintf(error, sizeof(error), "worker failed");
+	return error;
+}
+
+//----------------------------------------------------------------------------
+// Pool
+
+struct PoolWorker
+{
+	pid_t pid;
+	int fd;
+	size_t index;
+	std::vector<uint8> data;
+};
+
+int FCEU_RunInWorkers(std::vector<size_t> &pending, int jobs,
+	const std::function<void(size_t index, std::vector<uint8> &reply)> &job,
+	const std::function<void(size_t index, const std::vector<uint8> &reply, const std::string &error)> &done)
+{
+	std::vector<PoolWorker> active;
+	std::vector<size_t> notStarted;
+	size_t next = 0;
+	int started = 0;
+
+	// whatever is buffered would be written again by every worker
+	fflush(stdout);
+	fflush(stderr);
+
+	while (next < pending.size() || !active.empty())
+	{
+		while (notStarted.empty() && next < pending.size() && (int)active.size() < jobs)
+		{
+			size_t index = pending[next];
+			int fd[2];
+			if (pipe(fd) != 0)
+			{
+				notStarted.push_back(index);
+				next++;
+				break;
+			}
+			pid_t pid = fork();
+			if (pid == 0)
+			{
+				close(fd[0]);
+				for (size_t i = 0; i < active.size(); i++)
+					close(active[i].fd);
+
+				std::vector<uint8> reply;
+				job(index, reply);
+				_exit(WriteAll(fd[1], reply.data(), reply.size()) ? 0 : 1);
+			}
+			close(fd[1]);
+			if (pid < 0)
+			{
+				close(fd[0]);
+				notStarted.push_back(index);
+				next++;
+				break;
+			}
+			PoolWorker worker;
+			worker.pid = pid;
+			worker.fd = fd[0];
+			worker.index = index;
+			active.push_back(worker);
+			started++;
+			next++;
+		}
+		if (active.empty())
+			break;
+
+		// the replies come back in any order, a worker is done when its pipe closes
+		std::vector<pollfd> fds(active.size());
+		for (size_t i = 0; i < active.size(); i++)
+		{
+			fds[i].fd = active[i].fd;
+			fds[i].events = POLLIN;
+			fds[i].revents = 0;
+		}
+		if (poll(&fds[0], fds.size(), -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			// read them in turn then, the reads block until each is done
+			for (size_t i = 0; i < fds.size(); i++)
+				fds[i].revents = POLLIN;
+		}
+
+		for (size_t i = active.size(); i-- > 0; )
+		{
+			if (!fds[i].revents)
+				continue;
+
+			PoolWorker &worker = active[i];
+			if (ReadSome(worker.fd, worker.data))
+				continue;
+
+			close(worker.fd);
+			done(worker.index, worker.data, WorkerError(WaitWorker(worker.pid)));
+			active.erase(active.begin() + i);
+		}
+	}
+
+	notStarted.insert(notStarted.end(), pending.begin() + next, pending.end());
+	pending.swap(notStarted);
+	return started;
+}
+
+//----------------------------------------------------------------------------
+// Stream
+
+FCEU_StreamWorker::FCEU_StreamWorker()
+	: pid(-1), fd(-1)
+{
+}
+
+FCEU_StreamWorker::~FCEU_StreamWorker()
+{
+	finish();
+}
+
+bool FCEU_StreamWorker::start(const std::function<bool(FCEU_StreamWorker &worker)> &job)
+{
+	int pipefd[2];
+	if (pid >= 0 || pipe(pipefd) != 0)
+		return false;
+
+	// whatever is buffered would be written again by the worker
+	fflush(stdout);
+	fflush(stderr);
+
+	pid_t child = fork();
+	if (child == 0)
+	{
+		close(pipefd[0]);
+		fd = pipefd[1];
+		_exit(job(*this) ? 0 : 1);
+	}
+	close(pipefd[1]);
+	if (child < 0)
+	{
+		close(pipefd[0]);
+		return false;
+	}
+	pid = child;
+	fd = pipefd[0];
+	return true;
+}
+
+bool FCEU_StreamWorker::write(const void *data, size_t size)
+{
+	return WriteAll(fd, data, size);
+}
+
+bool FCEU_StreamWorker::read(std::vector<uint8> &data)
+{
+	if (fd < 0)
+		return false;
+	if (ReadSome(fd, data))
+		return true;
+	close(fd);
+	fd = -1;
+	return false;
+}
+
+bool FCEU_StreamWorker::finish(void)
+{
+	if (pid < 0)
+		return true;
+	bool stopped = fd >= 0;
+	if (stopped)
+	{
+		kill(pid, SIGKILL);
+		close(fd);
+		fd = -1;
+	}
+
+	int status = WaitWorker(pid);
+	pid = -1;
+	return stopped || WorkerError(status).empty();
+}
+#endif
@@ -0,0 +1,88 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// workerpool.h
+
+#pragma once
+
+#include "types.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ *  Forked workers. The core holds one emulator per process, so the tools
+ *  that run many emulations at once (movie verification, desync bisection,
+ *  NSF rendering, input search and fuzzing, the test-ROM runner) each run
+ *  them in forked copies of the process. A worker sends its result back as
+ *  bytes over a pipe; one that crashes only loses its own result.
+ *
+ *  FCEU_WORKER_POOL is defined where the platform can fork. Elsewhere the
+ *  callers run the jobs here, one after another.
+ */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FCEU_WORKER_POOL
+#endif
+
+#ifdef FCEU_WORKER_POOL
+// Runs job(index, reply) for every index in pending, each in its own forked
+// worker, at most jobs at a time. done(index, reply, error) is called here
+// as each worker ends, in any order; error is empty when the worker exited
+// cleanly, else it says how it failed and reply may be cut short.
+// The indices whose worker could not be started are left in pending.
+// Returns the number of workers started.
+int FCEU_RunInWorkers(std::vector<size_t> &pending, int jobs,
+	const std::function<void(size_t index, std::vector<uint8> &reply)> &job,
+	const std::function<void(size_t index, const std::vector<uint8> &reply, const std::string &error)> &done);
+
+// A single forked worker whose output is read while it runs.
+class FCEU_StreamWorker
+{
+public:
+	FCEU_StreamWorker();
+	~FCEU_StreamWorker();
+
+	// Forks and runs job there, which sends its output with write().
+	// The worker fails when job returns false. false when it could not
+	// be started.
+	bool start(const std::function<bool(FCEU_StreamWorker &worker)> &job);
+
+	// In the worker: sends size bytes, false when the pipe is gone.
+	bool write(const void *data, size_t size);
+
+	// Appends what the worker sent since, waiting for some; false at its end.
+	bool read(std::vector<uint8> &data);
+
+	// Waits for the worker to end. One whose output was not read to the end
+	// is not needed any more and killed first; that does not count as a
+	// failure. false when the worker failed.
+	bool finish(void);
+
+	bool started(void) const { return pid >= 0; }
+
+private:
+	FCEU_StreamWorker(const FCEU_StreamWorker&) = delete;
+	FCEU_StreamWorker& operator=(const FCEU_StreamWorker&) = delete;
+
+	int pid;
+	int fd;
+};
+#endif
@@ -0,0 +1,269 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// writejournal.cpp
+//
+#include "types.h"
+#include "fceu.h"
+#include "cart.h"
+#include "movie.h"
+#include "x6502.h"
+#include "writejournal.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+
+// RAM once, then $6000-$7FFF
+#define JOURNAL_ADDRESSES (0x800 + 0x2000)
+
+bool FCEU_writeJournalActive = false;
+
+static int capMegabytes = 0;
+
+// 16 bytes. prev is how many writes back the previous one to the same
+// address is, 0 for none (or too far back to be held).
+struct JournalEntry
+{
+	uint32 prev;
+	uint32 cycle;                   // from the start of the chunk's frame
+	uint16 pc;
+	uint16 address;
+	uint16 bank;                    // 0xFFFF outside PRG ROM
+	uint8  oldValue;
+	uint8  newValue;
+};
+
+struct JournalChunk
+{
+	int    frame;
+	uint64 cycleBase;
+	uint64 firstSeq;                // sequence number of entries[0]
+	std::vector<JournalEntry> entries;
+};
+
+static std::deque<JournalChunk> chunks;
+static size_t heldWrites = 0;
+
+// sequence number of the next write, and one more than the one of the last
+// write to each address (0 for none)
+static uint64 nextSeq = 0;
+static uint64 lastWrite[JOURNAL_ADDRESSES];
+
+static int JournalIndex(uint32 A)
+{
+	if (A < 0x2000)
+		return A & 0x7FF;
+	if (A >= 0x6000 && A < 0x8000)
+		return 0x800 + (A - 0x6000);
+	return -1;
+}
+
+static uint64 CPUCycles(void)
+{
+	return timestampbase + (uint64)timestamp;
+}
+
+void FCEU_ResetWriteJournal(void)
+{
+	chunks.clear();
+	heldWrites = 0;
+	nextSeq = 0;
+	memset(lastWrite, 0, sizeof(lastWrite));
+}
+
+void FCEUI_SetWriteJournal(int megabytes)
+{
+	capMegabytes = megabytes > 0 ? megabytes : 0;
+	FCEU_writeJournalActive = capMegabytes > 0;
+	if (!FCEU_writeJournalActive)
+	{
+		FCEU_ResetWriteJournal();
+		chunks.shrink_to_fit();
+	}
+}
+
+int FCEUI_GetWriteJournal(void)
+{
+	return capMegabytes;
+}
+
+void FCEUI_ClearWriteJournal(void)
+{
+	FCEU_ResetWriteJournal();
+}
+
+size_t FCEUI_WriteJournalWrites(void)
+{
+	return heldWrites;
+}
+
+int FCEUI_WriteJournalFrames(void)
+{
+	return (int)chunks.size();
+}
+
+size_t FCEUI_WriteJournalBytes(void)
+{
+	return heldWrites * sizeof(JournalEntry) + chunks.size() * sizeof(JournalChunk) + sizeof(lastWrite);
+}
+
+bool FCEUI_WriteJournalCovers(uint32 A)
+{
+	return JournalIndex(A) >= 0;
+}
+
+uint8 *FCEU_WriteJournalCell(uint32 A)
+{
+	if (A < 0x2000)
+		return &RAM[A & 0x7FF];
+	if (A >= 0x6000 && A < 0x8000)
+		return &Page[A >> 11][A];
+	return NULL;
+}
+
+// Drops the oldest frames over the cap, keeping the one being recorded
+static void TrimJournal(void)
+{
+	size_t cap = (size_t)capMegabytes << 20;
+
+	while (chunks.size() > 1 && FCEUI_WriteJournalBytes() > cap)
+	{
+		heldWrites -= chunks.front().entries.size();
+		chunks.pop_front();
+	}
+}
+
+static JournalChunk &CurrentChunk(void)
+{
+	if (chunks.empty() || chunks.back().frame != currFrameCounter)
+	{
+		size_t reserve = chunks.empty() ? 0 : chunks.back().entries.size();
+
+		TrimJournal();
+		chunks.push_back(JournalChunk());
+		JournalChunk &chunk = chunks.back();
+		chunk.frame = currFrameCounter;
+		chunk.cycleBase = CPUCycles();
+		chunk.firstSeq = nextSeq;
+		chunk.entries.reserve(reserve);
+	}
+	return chunks.back();
+}
+
+void FCEU_WriteJournalRecord(uint16 pc, uint32 A, uint8 oldValue, uint8 newValue)
+{
+	int index = JournalIndex(A);
+	JournalChunk &chunk = CurrentChunk();
+	JournalEntry e;
+
+	uint64 back = lastWrite[index] ? nextSeq - (lastWrite[index] - 1) : 0;
+	e.prev = back <= 0xFFFFFFFF ? (uint32)back : 0;
+	e.cycle = (uint32)(CPUCycles() - chunk.cycleBase);
+	e.pc = pc;
+	e.address = index < 0x800 ? index : A;
+	e.bank = 0xFFFF;
+	if (pc >= 0x8000 && PRGptr[0])
+	{
+		ptrdiff_t ofs = &Page[pc >> 11][pc] - PRGptr[0];
+		if (ofs >= 0 && ofs < (ptrdiff_t)PRGsize[0])
+			e.bank = (uint16)(ofs >> 13);
+	}
+	e.oldValue = oldValue;
+	e.newValue = newValue;
+
+	chunk.entries.push_back(e);
+	heldWrites++;
+	lastWrite[index] = ++nextSeq;
+}
+
+static const JournalChunk *FindChunk(uint64 seq)
+{
+	if (chunks.empty() || seq < chunks.front().firstSeq)
+		return NULL;
+
+	std::deque<JournalChunk>::const_iterator it = std::upper_bound(chunks.begin(), chunks.end(), seq,
+		[](uint64 s, const JournalChunk &c) { return s < c.firstSeq; });
+	return &*(it - 1);
+}
+
+void FCEUI_WriteJournalLast(uint32 A, int count, std::vector<FCEU_JournalWrite> &writes)
+{
+	writes.clear();
+
+	int index = JournalIndex(A);
+	if (index < 0 || !lastWrite[index])
+		return;
+
+	uint64 seq = lastWrite[index] - 1;
+	while ((int)writes.size() < count)
+	{
+		const JournalChunk *chunk = FindChunk(seq);
+		if (!chunk)
+			break;
+
+		const JournalEntry &e = chunk->entries[seq - chunk->firstSeq];
+		FCEU_JournalWrite w;
+		w.cycle = chunk->cycleBase + e.cycle;
+		w.frame = chunk->frame;
+		w.pc = e.pc;
+		w.bank = e.bank == 0xFFFF ? -1 : e.bank;
+		w.address = e.address;
+		w.oldValue = e.oldValue;
+		w.newValue = e.newValue;
+		writes.push_back(w);
+
+		if (!e.prev || e.prev > seq)
+			break;
+		seq -= e.prev;
+	}
+}
+
+std::string FCEU_WriteJournalReport(uint32 A, int count)
+{
+	std::vector<FCEU_JournalWrite> writes;
+	std::string report;
+	char line[128];
+
+	if (!FCEU_writeJournalActive)
+		return "The write journal is off.\n";
+	if (!FCEUI_WriteJournalCovers(A))
+	{
+		snprintf(line, sizeof(line), "$%04X is not recorded, only RAM and $6000-$7FFF are.\n", A);
+		return line;
+	}
+
+	FCEUI_WriteJournalLast(A, count, writes);
+	snprintf(line, sizeof(line), "$%04X: the last %d write%s, of the %d frames held\n", A < 0x2000 ? A & 0x7FF : A,
+		(int)writes.size(), writes.size() == 1 ? "" : "s", FCEUI_WriteJournalFrames());
+	report = line;
+
+	for (size_t i = 0; i < writes.size(); i++)
+	{
+		const FCEU_JournalWrite &w = writes[i];
+		char bank[16] = "--";
+		if (w.bank >= 0)
+			snprintf(bank, sizeof(bank), "%02X", w.bank);
+		snprintf(line, sizeof(line), "frame %d cycle %llu  $%04X bank %s  $%02X -> $%02X\n",
+			w.frame, (unsigned long long)w.cycle, w.pc, bank, w.oldValue, w.newValue);
+		report += line;
+	}
+	return report;
+}
@@ -0,0 +1,85 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * Copyright notice for this file:
+ *  Copyright (C) 2002 Xodnizel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// writejournal.h
+
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+/*
+ *  Write journal. While it is on, every CPU write to RAM ($0000-$1FFF, kept
+ *  as $0000-$07FF) and to $6000-$7FFF is recorded with the cycle, the
+ *  instruction that made it and its PRG bank, and the value it replaced, so
+ *  that the code which changed an address can be found without setting a
+ *  write breakpoint and playing again.
+ *
+ *  Writes are kept in one chunk per frame, and the oldest frames are dropped
+ *  once the journal holds more than its cap. Each write links to the one
+ *  before it to the same address, so the last writers of an address are
+ *  found without going through the others.
+ *
+ *  Recording needs the CPU's instrumented loop, as the debugger does. The
+ *  journal is emptied when the game is closed or powered on, and when a
+ *  state is loaded: what it holds always led to the console as it is.
+ */
+
+struct FCEU_JournalWrite
+{
+	uint64 cycle;                   // CPU cycles since power on
+	int    frame;                   // frame counter of the frame it was made in
+	uint16 pc;                      // the instruction that wrote
+	int    bank;                    // 8K PRG ROM bank pc was in, -1 outside PRG ROM
+	uint16 address;
+	uint8  oldValue;
+	uint8  newValue;
+};
+
+// The cap in megabytes, 0 (the default) turns the journal off and drops
+// what it holds.
+void FCEUI_SetWriteJournal(int megabytes);
+int  FCEUI_GetWriteJournal(void);
+void FCEUI_ClearWriteJournal(void);
+
+// Writes and frames held, and the bytes they take
+size_t FCEUI_WriteJournalWrites(void);
+int    FCEUI_WriteJournalFrames(void);
+size_t FCEUI_WriteJournalBytes(void);
+
+// True for the addresses the journal records
+bool FCEUI_WriteJournalCovers(uint32 A);
+
+// The last count writes to A held in the journal, the latest first. Mirrors
+// of RAM are the same address.
+void FCEUI_WriteJournalLast(uint32 A, int count, std::vector<FCEU_JournalWrite> &writes);
+
+// One "frame cycle PC bank old -> new" line per write, after a line naming A
+std::string FCEU_WriteJournalReport(uint32 A, int count);
+
+//set while the journal is on, the CPU calls these around the writes it makes:
+//the byte A is kept in (NULL when it is not recorded), then the write made
+//by the instruction at pc
+extern bool FCEU_writeJournalActive;
+uint8 *FCEU_WriteJournalCell(uint32 A);
+void FCEU_WriteJournalRecord(uint16 pc, uint32 A, uint8 oldValue, uint8 newValue);
+
+void FCEU_ResetWriteJournal(void);
@@ -23,18 +23,57 @@
 #include "fceu.h"
 #include "debug.h"
 #include "sound.h"
+#include "cart.h"
+#include "stageprof.h"
+#include "guestprof.h"
+#include "ppu.h"
+#include "writejournal.h"
 #ifdef _S9XLUA_H
 #include "fceulua.h"
 #endif
 
 #include "x6502abbrev.h"
 
+#include <algorithm>
 #include <cstring>
+#include <vector>
 X6502 X;
 uint32 timestamp;
 uint32 soundtimestamp;
 void (*MapIRQHook)(int a);
 
+static int32 mapIRQPending = 0;		//cycles not passed to MapIRQHook yet
+static int32 mapIRQDeadline = 0;	//call MapIRQHook once this many are pending
+
+void X6502_SetMapIRQDeadline(int32 cycles)
+{
+ //a generous cap keeps the counts small for boards that go idle
+ if(cycles > 0x100000)
+  cycles = 0x100000;
+ mapIRQDeadline = cycles;
+}
+
+void X6502_FlushMapIRQ(void)
+{
+ int32 cycles = mapIRQPending;
+
+ mapIRQPending = 0;
+ mapIRQDeadline = 0;
+ if(cycles && MapIRQHook)
+  MapIRQHook(cycles);
+}
+
+static void IdleLoopReset(void);
+
+//For a fresh start or a loaded state, which already holds the counters
+void X6502_DiscardMapIRQ(void)
+{
+ mapIRQPending = 0;
+ mapIRQDeadline = 0;
+ //the loop being watched is gone as well
+ IdleLoopReset();
+}
+
 #define ADDCYC(x) \
 {                 \
  int __x=x;       \
@@ -156,32 +195,65 @@ void X6502_MemHook::Remove(enum X6502_MemHook::Type type, void (*func)(unsigned
 	}
 }
 
+// The memory accessors come in two flavours: X6502_RunLoop<false> only runs
+// while no memory hooks are registered, so it can skip looking for them.
+
+// Every opcode handler expands these, hundreds of copies in all, which is well
+// past where the compiler stops taking plain inline hints. An out of line
+// RdMem costs the lean loop about a tenth of its speed.
+#if defined(__GNUC__) || defined(__clang__)
+#define X6502_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define X6502_ALWAYS_INLINE __forceinline
+#else
+#define X6502_ALWAYS_INLINE inline
+#endif
+
 //normal memory read
-static INLINE uint8 RdMem(unsigned int A)
+template<bool hooked>
+static X6502_ALWAYS_INLINE uint8 RdMemT(unsigned int A)
 {
- _DB=ARead[A](A);
- if (readMemHook)
+ // Plain ROM/RAM is loaded directly, the handler is only called for I/O and mapper registers
+ uint8 *page = ReadPage[A >> 12];
+ _DB = page ? page[A] : ARead[A](A);
+ if (hooked && readMemHook)
  {
 	 readMemHook->call(A, _DB);
  }
  return(_DB);
 }
 
+// the instruction being run, for the write journal
+static uint16 journalPC;
+
 //normal memory write
-static INLINE void WrMem(unsigned int A, uint8 V)
+template<bool hooked>
+static X6502_ALWAYS_INLINE void WrMemT(unsigned int A, uint8 V)
 {
-	BWrite[A](A,V);
- 	if (writeMemHook)
+	// the journal keeps what the byte held and what it holds after the write
+	uint8 *cell = (hooked && FCEU_writeJournalActive) ? FCEU_WriteJournalCell(A) : NULL;
+	uint8 old = cell ? *cell : 0;
+
+	// Likewise PRG RAM is stored to directly, the handler is left for the rest
+	uint8 *page = WritePage[A >> 12];
+	if (page)
+		page[A] = V;
+	else
+		BWrite[A](A,V);
+	if (hooked && cell)
+		FCEU_WriteJournalRecord(journalPC, A, old, *cell);
+ 	if (hooked && writeMemHook)
  	{
  	        writeMemHook->call(A, V);
  	}
 	_DB = V;
 }
 
-static INLINE uint8 RdRAM(unsigned int A)
+template<bool hooked>
+static X6502_ALWAYS_INLINE uint8 RdRAMT(unsigned int A)
 {
   _DB=ARead[A](A);
-  if (readMemHook)
+  if (hooked && readMemHook)
   {
           readMemHook->call(A, _DB);
   }
@@ -190,16 +262,26 @@ static INLINE uint8 RdRAM(unsigned int A)
   return(_DB);
 }
 
-static INLINE void WrRAM(unsigned int A, uint8 V)
+template<bool hooked>
+static X6502_ALWAYS_INLINE void WrRAMT(unsigned int A, uint8 V)
 {
+	if (hooked && FCEU_writeJournalActive)
+		FCEU_WriteJournalRecord(journalPC, A, RAM[A], V);
 	RAM[A]=V;
- 	if (writeMemHook)
+ 	if (hooked && writeMemHook)
  	{
  	        writeMemHook->call(A, V);
  	}
 	_DB = V;
 }
 
+// The opcode macros below and ops.inc are only expanded inside X6502_RunLoop,
+// whose template argument selects the accessor flavour.
+#define RdMem(A)   RdMemT<instrumented>(A)
+#define WrMem(A,V) WrMemT<instrumented>(A,V)
+#define RdRAM(A)   RdRAMT<instrumented>(A)
+#define WrRAM(A,V) WrRAMT<instrumented>(A,V)
+
 uint8 X6502_DMR(uint32 A)
 {
  ADDCYC(1);
@@ -222,6 +304,18 @@ void X6502_DMW(uint32 A, uint8 V)
  _DB = V;
 }
 
+const uint8 *X6502_DMASource(uint32 A, int len)
+{
+ if (readMemHook || writeMemHook)
+  return NULL;
+ return FCEU_GetPlainMemPtr(A, len);
+}
+
+void X6502_DMAStall(int cycles)
+{
+ ADDCYC(cycles);
+}
+
 #define PUSH(V) \
 {       \
  uint8 VTMP=V;  \
@@ -238,19 +332,26 @@ static uint8 ZNTable[256];
 #define X_ZN(zort)      _P&=~(Z_FLAG|N_FLAG);_P|=ZNTable[zort]
 #define X_ZNT(zort)  _P|=ZNTable[zort]
 
+// The bytes of the instruction after the opcode. The decoded engine has them
+// at hand, its fetch only leaves them on the data bus.
+#define RdOp1() (decoded ? (_DB = (uint8)operand) : RdMem(_PC))
+#define RdOp2() (decoded ? (_DB = (uint8)(operand >> 8)) : RdMem(_PC))
+
 #define JR(cond);  \
 {    \
  if(cond)  \
  {  \
   uint32 tmp;  \
   int32 disp;  \
-  disp=(int8)RdMem(_PC);  \
+  disp=(int8)RdOp1();  \
   _PC++;  \
   ADDCYC(1);  \
   tmp=_PC;  \
   _PC+=disp;  \
   if((tmp^_PC)&0x100)  \
   ADDCYC(1);  \
+  if(!instrumented && disp<0 && idleSkip)  \
+   IdleLoop(tmp-2);  \
  }  \
  else _PC++;  \
 }
@@ -338,9 +439,9 @@ static uint8 ZNTable[256];
 /* Absolute */
 #define GetAB(target)   \
 {  \
- target=RdMem(_PC);  \
+ target=RdOp1();  \
  _PC++;  \
- target|=RdMem(_PC)<<8;  \
+ target|=RdOp2()<<8;  \
  _PC++;  \
 }
 
@@ -373,14 +474,14 @@ static uint8 ZNTable[256];
 /* Zero Page */
 #define GetZP(target)  \
 {  \
- target=RdMem(_PC);   \
+ target=RdOp1();   \
  _PC++;  \
 }
 
 /* Zero Page Indexed */
 #define GetZPI(target,i)  \
 {  \
- target=i+RdMem(_PC);  \
+ target=i+RdOp1();  \
  _PC++;  \
 }
 
@@ -388,7 +489,7 @@ static uint8 ZNTable[256];
 #define GetIX(target)  \
 {  \
  uint8 tmp;  \
- tmp=RdMem(_PC);  \
+ tmp=RdOp1();  \
  _PC++;  \
  tmp+=_X;  \
  target=RdRAM(tmp);  \
@@ -401,7 +502,7 @@ static uint8 ZNTable[256];
 {  \
  unsigned int rt;  \
  uint8 tmp;  \
- tmp=RdMem(_PC);  \
+ tmp=RdOp1();  \
  _PC++;  \
  rt=RdRAM(tmp);  \
  tmp++;  \
@@ -421,7 +522,7 @@ static uint8 ZNTable[256];
 {  \
  unsigned int rt;  \
  uint8 tmp;  \
- tmp=RdMem(_PC);  \
+ tmp=RdOp1();  \
  _PC++;  \
  rt=RdRAM(tmp);  \
  tmp++;  \
@@ -447,7 +548,7 @@ static uint8 ZNTable[256];
 #define RMW_ZP(op)  {uint8 A; uint8 x; GetZP(A); x=RdRAM(A); op; WrRAM(A,x); break; }
 #define RMW_ZPX(op) {uint8 A; uint8 x; GetZPI(A,_X); x=RdRAM(A); op; WrRAM(A,x); break;}
 
-#define LD_IM(op)  {uint8 x; x=RdMem(_PC); _PC++; op; break;}
+#define LD_IM(op)  {uint8 x; x=RdOp1(); _PC++; op; break;}
 #define LD_ZP(op)  {uint8 A; uint8 x; GetZP(A); x=RdRAM(A); op; break;}
 #define LD_ZPX(op)  {uint8 A; uint8 x; GetZPI(A,_X); x=RdRAM(A); op; break;}
 #define LD_ZPY(op)  {uint8 A; uint8 x; GetZPI(A,_Y); x=RdRAM(A); op; break;}
@@ -550,28 +651,365 @@ void X6502_Power(void)
  _count=_tcount=_IRQlow=_PC=_A=_X=_Y=_P=_PI=_DB=_jammed=0;
  _S=0xFD;
  timestamp=soundtimestamp=0;
+ X6502_DiscardMapIRQ();
  X6502_Reset();
  StackAddrBackup = -1;
 }
 
-void X6502_Run(int32 cycles)
+// True while anything wants to see every instruction or memory access:
+// breakpoints, stepping, trace or CD logging, Lua memory hooks, the write
+// journal, or the guest profiler.
+bool X6502_NeedsInstrumentation(void)
 {
-  if(PAL)
-   cycles*=15;    // 15*4=60
+#ifdef FCEUDEF_DEBUGGER
+	// asked first, it also refreshes the debugger's breakpoint index
+	if (DebugCycleNeeded())
+	{
+		return true;
+	}
+#endif
+	if (readMemHook || writeMemHook || execMemHook || FCEU_writeJournalActive)
+	{
+		return true;
+	}
+	return fceuGuestProfiling;
+}
+
+//--------------------------
+// Idle loop skipping. A short loop that only loads and compares values from
+// RAM or $2002 and branches back does the same thing on every pass until an
+// interrupt or the PPU changes something. Once three passes in a row left the
+// registers alike and took exactly the cycles the code adds up to, the rest
+// of the passes that fit before the next event are not run, only counted:
+// the end of this X6502_Run(), the mapper IRQ deadline, the frame counter or
+// the DMC timer. Everything comes out cycle for cycle as if they had been run.
+
+static bool idleSkip = false;
+static uint32 idleBranch;     //address of the branch being watched
+static uint32 idleTime;       //timestamp it was last taken at
+static uint32 idleDelta;      //cycles between the last two times
+static int32 idleCycles;      //of one pass, 0 when not idle, -1 not looked at yet
+static int32 idleInstructions;
+static int idleHits;
+static uint8 idleA, idleX, idleY, idleP;
+
+static void IdleLoopReset(void)
+{
+ idleBranch = ~0u;
+ idleHits = 0;
+}
+
+static int IdlePeek(uint32 A)
+{
+ uint8 *page = ReadPage[(A & 0xFFFF) >> 12];
+ return page ? page[A & 0xFFFF] : -1;
+}
+
+//Cycles one pass from target to the branch at branch takes, or 0 when the
+//loop does more than load and compare from RAM or a steady $2002
+static int32 IdleLoopCycles(uint32 target, uint32 branch, int32 &instructions)
+{
+ if(target > branch || branch - target > 16)
+  return 0;
+
+ int32 cycles = 0;
+ instructions = 1;
+ for(uint32 pc = target; pc < branch; instructions++)
+ {
+  int op = IdlePeek(pc);
+  int lo = IdlePeek(pc + 1);
+  int hi = IdlePeek(pc + 2);
+  if(op < 0)
+   return 0;
+  cycles += CycTable[op];
+
+  uint32 A;
+  switch(op)
+  {
+   case 0xEA:                 //NOP
+    pc++;
+    continue;
+   case 0x09: case 0x29: case 0xA0: case 0xA2: case 0xA9: case 0xC0: case 0xC9: case 0xE0:
+    pc += 2;                  //ORA AND LDY LDX LDA CPY CMP CPX immediate
+    continue;
+   case 0x05: case 0x24: case 0x25: case 0xA4: case 0xA5: case 0xA6: case 0xC4: case 0xC5: case 0xE4:
+    if(lo < 0)                //ORA BIT AND LDY LDA LDX CPY CMP CPX zero page
+     return 0;
+    pc += 2;
+    continue;
+   case 0x0D: case 0x2C: case 0x2D: case 0xAC: case 0xAD: case 0xAE: case 0xCC: case 0xCD: case 0xEC:
+    if(lo < 0 || hi < 0)      //the same absolute
+     return 0;
+    A = lo | (hi << 8);
+    if(A >= 0x2000 && !(A < 0x4000 && (A & 7) == 2 && FCEUPPU_StatusSteady()))
+     return 0;
+    pc += 3;
+    continue;
+  }
+  return 0;
+ }
+
+ //the branch itself, taken
+ int op = IdlePeek(branch);
+ if(op < 0)
+  return 0;
+ cycles += CycTable[op] + 1;
+ if(((branch + 2) ^ target) & 0x100)
+  cycles++;
+ return cycles;
+}
+
+//Called for every taken backward branch at branch, the cycles of the branch
+//already counted
+static void IdleLoop(uint32 branch)
+{
+ if(branch == idleBranch && _A == idleA && _X == idleX && _Y == idleY && _P == idleP)
+ {
+  uint32 delta = timestamp - idleTime;
+  if(delta == idleDelta)
+   idleHits++;
   else
-   cycles*=16;    // 16*4=64
+  {
+   idleDelta = delta;
+   idleHits = 1;
+  }
+ }
+ else
+ {
+  idleBranch = branch;
+  idleA = _A; idleX = _X; idleY = _Y; idleP = _P;
+  idleCycles = -1;
+  idleHits = 0;
+ }
+ idleTime = timestamp;
+
+ if(idleHits < 2 || _IRQlow)
+  return;
+ if(idleCycles < 0)
+  idleCycles = IdleLoopCycles(_PC, branch, idleInstructions);
+ if(idleCycles == 0 || (uint32)idleCycles != idleDelta)
+  return;
+
+ //the extra cycles of this branch reach the hooks with the next instruction,
+ //and one more pass is left as margin
+ int32 cycles = idleCycles;
+ int32 ahead = _tcount + cycles;
+ int32 passes = (_count - 1) / (cycles * 48);
+ if(MapIRQHook)
+  passes = std::min(passes, (mapIRQDeadline - mapIRQPending - ahead - 1) / cycles);
+ if(!overclocking)
+ {
+  if(DMCSize && !DMCHaveDMA)
+   return;
+  passes = std::min(passes, (fhcnt / 48 - ahead - 1) / cycles);
+  passes = std::min(passes, (DMCacc - ahead - 1) / cycles);
+ }
+ if(passes <= 0)
+  return;
+
+ cycles *= passes;
+ _count -= cycles * 48;
+ timestamp += cycles;
+ if(MapIRQHook)
+  mapIRQPending += cycles;
+ if(!overclocking)
+ {
+  soundtimestamp += cycles;
+  fhcnt -= cycles * 48;
+  DMCacc -= cycles;
+ }
+ total_instructions += (uint64)passes * idleInstructions;
+ delta_instructions += (uint64)passes * idleInstructions;
+ idleTime = timestamp;
+}
+
+void FCEUI_SetIdleSkip(bool enable)
+{
+ idleSkip = enable;
+ IdleLoopReset();
+}
+
+bool FCEUI_GetIdleSkip(void)
+{
+ return idleSkip;
+}
+
+//--------------------------
+// Decoded code cache. Instructions in PRG ROM are decoded once, opcode,
+// operand bytes and base cycles, and kept per 2K bank of the ROM in blocks
+// that end at a jump, branch, return or interrupt instruction. The lean loop
+// runs a block without fetching its bytes again: the handlers from ops.inc
+// are the same, with the operand fetches only setting the data bus, so every
+// other bus access and every cycle is as before. RAM, PRG RAM, pages read
+// through handlers and instructions that run into the next 4K page take the
+// normal fetch. PRGCodeBank[] follows setprg*() so a block always comes from
+// the bank mapped now, and the cache is dropped when chip 0 is set up again
+// or the ROM is written (FCEU_RomModified).
+
+static bool codeCache = false;
+
+struct X6502Code
+{
+ uint16 operand;
+ uint8 op;
+ uint8 cycles;
+ uint8 size;       //bytes, 0 when not decoded yet
+ uint8 blockLen;   //instructions in the block starting here, 0 when not decoded yet
+};
+
+// the 4K of ROM from the start of a 2K bank, by address within the page
+struct X6502CodePage
+{
+ X6502Code ins[0x1000];
+};
+
+static const uint8 CODE_BLOCK_MAX = 32;
+static const uint8 CODE_NO_BLOCK = 0xFF;  //the instruction runs into the next page
+
+static std::vector<X6502CodePage*> codePages;  //by PRGCodeBank[]
+static uint32 codeVersion = ~0u;
+static uint32 codeRomModifyCount;
+
+static const uint8 CodeSize[256] =
+{
+/*0x00*/ 1,2,1,2,2,2,2,2,1,2,1,2,3,3,3,3,
+/*0x10*/ 2,2,1,2,2,2,2,2,1,3,1,3,3,3,3,3,
+/*0x20*/ 3,2,1,2,2,2,2,2,1,2,1,2,3,3,3,3,
+/*0x30*/ 2,2,1,2,2,2,2,2,1,3,1,3,3,3,3,3,
+/*0x40*/ 1,2,1,2,2,2,2,2,1,2,1,2,3,3,3,3,
+/*0x50*/ 2,2,1,2,2,2,2,2,1,3,1,3,3,3,3,3,
+/*0x60*/ 1,2,1,2,2,2,2,2,1,2,1,2,3,3,3,3,
+/*0x70*/ 2,2,1,2,2,2,2,2,1,3,1,3,3,3,3,3,
+/*0x80*/ 2,2,2,2,2,2,2,2,1,2,1,2,3,3,3,3,
+/*0x90*/ 2,2,1,2,2,2,2,2,1,3,1,3,3,3,3,3,
+/*0xA0*/ 2,2,2,2,2,2,2,2,1,2,1,2,3,3,3,3,
+/*0xB0*/ 2,2,1,2,2,2,2,2,1,3,1,3,3,3,3,3,
+/*0xC0*/ 2,2,2,2,2,2,2,2,1,2,1,2,3,3,3,3,
+/*0xD0*/ 2,2,1,2,2,2,2,2,1,3,1,3,3,3,3,3,
+/*0xE0*/ 2,2,2,2,2,2,2,2,1,2,1,2,3,3,3,3,
+/*0xF0*/ 2,2,1,2,2,2,2,2,1,3,1,3,3,3,3,3,
+};
+
+//BRK, JSR, RTI, RTS, the JMPs, the branches and the jams
+static bool CodeEndsBlock(uint8 op)
+{
+ if((op & 0x1F) == 0x10 || op == 0x00 || op == 0x20 || op == 0x40 || op == 0x60 || op == 0x4C || op == 0x6C)
+  return true;
+ return (op & 0x0F) == 0x02 && !(op & 0x80 && op != 0x92 && op != 0xB2 && op != 0xD2 && op != 0xF2);
+}
+
+static void CodeCacheClear(void)
+{
+ for(size_t i = 0; i < codePages.size(); i++)
+  delete codePages[i];
+ codePages.clear();
+}
+
+//Drops what was decoded from a ROM that is gone or was written to
+static void CodeCacheCheck(void)
+{
+ uint32 modified = FCEU_GetRomModifyCount();
+
+ if(codeVersion == PRGCodeVersion && codeRomModifyCount == modified)
+  return;
+ CodeCacheClear();
+ codePages.resize(PRGsize[0] >> 11, NULL);
+ codeVersion = PRGCodeVersion;
+ codeRomModifyCount = modified;
+}
+
+//Decodes the block at addr of the page, returns its length
+static uint8 CodeDecodeBlock(X6502CodePage *page, int32 bank, uint32 addr)
+{
+ const uint8 *rom = PRGptr[0] + (bank << 11);
+ uint32 a = addr;
+ uint8 n = 0;
+
+ while(n < CODE_BLOCK_MAX)
+ {
+  uint8 op = rom[a];
+  uint8 size = CodeSize[op];
+
+  if(a + size > 0x1000)
+   break;
+
+  X6502Code &c = page->ins[a];
+  c.op = op;
+  c.cycles = CycTable[op];
+  c.size = size;
+  c.operand = (size > 1 ? rom[a + 1] : 0) | (size > 2 ? rom[a + 2] << 8 : 0);
+  n++;
+  a += size;
+  if(CodeEndsBlock(op))
+   break;
+ }
+ page->ins[addr].blockLen = n ? n : CODE_NO_BLOCK;
+ return page->ins[addr].blockLen;
+}
+
+void FCEUI_SetCodeCache(bool enable)
+{
+ codeCache = enable;
+ if(!enable)
+ {
+  CodeCacheClear();
+  codeVersion = ~0u;
+ }
+}
+
+bool FCEUI_GetCodeCache(void)
+{
+ return codeCache;
+}
+
+// One handler per opcode, generated from ops.inc: the switch is on a template
+// constant, so each instance keeps only its own case, with the addressing mode
+// and operation macros expanded for that opcode alone.
+// decoded=true is the decoded engine's, with the operand bytes passed in.
+template<bool instrumented, bool decoded, uint8 op>
+static X6502_ALWAYS_INLINE void X6502_Op(uint16 operand)
+{
+   switch(op)
+   {
+    #include "ops.inc"
+   }
+}
+
+// Expands X6502_OP(nn) for every opcode, nn being two hex digits.
+#define X6502_OPS16(h) \
+  X6502_OP(h##0) X6502_OP(h##1) X6502_OP(h##2) X6502_OP(h##3) \
+  X6502_OP(h##4) X6502_OP(h##5) X6502_OP(h##6) X6502_OP(h##7) \
+  X6502_OP(h##8) X6502_OP(h##9) X6502_OP(h##A) X6502_OP(h##B) \
+  X6502_OP(h##C) X6502_OP(h##D) X6502_OP(h##E) X6502_OP(h##F)
+#define X6502_OPS256 \
+  X6502_OPS16(0) X6502_OPS16(1) X6502_OPS16(2) X6502_OPS16(3) \
+  X6502_OPS16(4) X6502_OPS16(5) X6502_OPS16(6) X6502_OPS16(7) \
+  X6502_OPS16(8) X6502_OPS16(9) X6502_OPS16(A) X6502_OPS16(B) \
+  X6502_OPS16(C) X6502_OPS16(D) X6502_OPS16(E) X6502_OPS16(F)
+
+// instrumented=false is the lean loop, with no debugger, counter or hook
+// calls per instruction, and the only one to run decoded blocks. Both
+// dispatch to the same X6502_Op handlers.
+template<bool instrumented>
+static void X6502_RunLoop(void)
+{
+  uint64 instructions = 0;
 
-  _count+=cycles;
-extern int test; test++;
   while(_count>0)
   {
    int32 temp;
    uint8 b1;
 
+   // an interrupt's pushes are put down to the instruction it interrupted
+   if (instrumented)
+    journalPC = _PC;
+
    if(_IRQlow)
    {
     if(_IRQlow&FCEU_IQRESET)
     {
+     if(instrumented && fceuGuestProfiling)
+      FCEU_GuestProfileInterrupt(FCEU_GUESTPROF_RESET,_PC);
 	 DEBUG( if(debug_loggingCD) LogCDVectors(0xFFFC); )
      _PC=RdMem(0xFFFC);
      _PC|=RdMem(0xFFFD)<<8;
@@ -588,12 +1026,15 @@ extern int test; test++;
     {
      if(!_jammed)
      {
+      if(instrumented && fceuGuestProfiling)
+       FCEU_GuestProfileInterrupt(FCEU_GUESTPROF_NMI,_PC);
       ADDCYC(7);
       PUSH(_PC>>8);
       PUSH(_PC);
       PUSH((_P&~B_FLAG)|(U_FLAG));
       _P|=I_FLAG;
 	  DEBUG( if(debug_loggingCD) LogCDVectors(0xFFFA) );
+	  DEBUG( if(debugNMIStack < 0) debugNMIStack = _S );
       _PC=RdMem(0xFFFA);
       _PC|=RdMem(0xFFFB)<<8;
       _IRQlow&=~FCEU_IQNMI;
@@ -603,6 +1044,8 @@ extern int test; test++;
     {
      if(!(_PI&I_FLAG) && !_jammed)
      {
+      if(instrumented && fceuGuestProfiling)
+       FCEU_GuestProfileInterrupt(FCEU_GUESTPROF_IRQ,_PC);
       ADDCYC(7);
       PUSH(_PC>>8);
       PUSH(_PC);
@@ -617,37 +1060,143 @@ extern int test; test++;
     if(_count<=0)
     {
      _PI=_P;
-     return;
+     break;
      } //Should increase accuracy without a
               //major speed hit.
    }
 
+   if (instrumented)
+   {
 	//will probably cause a major speed decrease on low-end systems
-   DEBUG( DebugCycle() );
+    DEBUG( DebugCycle() );
+
+    IncrementInstructionsCounters();
+   }
+   else
+   {
+    instructions++;
+   }
+
+   if (!instrumented && codeCache)
+   {
+    int32 bank = PRGCodeBank[_PC >> 12];
+
+    if (bank >= 0)
+    {
+     uint32 page = _PC >> 12;
+     X6502CodePage *code = codePages[bank];
+
+     if (!code)
+      code = codePages[bank] = new X6502CodePage();
 
-   IncrementInstructionsCounters();
+     const X6502Code *c = &code->ins[_PC & 0xFFF];
+     uint8 n = c->blockLen;
+
+     if (!n)
+      n = CodeDecodeBlock(code, bank, _PC & 0xFFF);
+     if (n != CODE_NO_BLOCK)
+     {
+      // the same steps as below, up to an interrupt, the end of the
+      // block or a write that maps another bank in
+      for (;;)
+      {
+       _PI=_P;
+       _DB=c->op;
+       ADDCYC(c->cycles);
+
+       temp=_tcount;
+       _tcount=0;
+       if(MapIRQHook)
+       {
+        mapIRQPending+=temp;
+        if(mapIRQPending>=mapIRQDeadline)
+         X6502_FlushMapIRQ();
+       }
+
+       if (!overclocking)
+        FCEU_SoundCPUHookInline(temp);
+       _PC++;
+       #define X6502_OP(n) case 0x##n: X6502_Op<false,true,0x##n>(c->operand); break;
+       switch(c->op)
+       {
+        X6502_OPS256
+       }
+       #undef X6502_OP
+
+       if (--n == 0 || _IRQlow || _count <= 0 || PRGCodeBank[page] != bank)
+        break;
+       c += c->size;
+       instructions++;
+      }
+      continue;
+     }
+    }
+   }
 
    _PI=_P;
+   if (instrumented)
+    journalPC = _PC;
    b1=RdMem(_PC);
+   if(instrumented && fceuGuestProfiling)
+    FCEU_GuestProfileStep(_PC,b1);
 
    ADDCYC(CycTable[b1]);
 
    temp=_tcount;
    _tcount=0;
-   if(MapIRQHook) MapIRQHook(temp);
+   if(MapIRQHook)
+   {
+    mapIRQPending+=temp;
+    if(mapIRQPending>=mapIRQDeadline)
+     X6502_FlushMapIRQ();
+   }
    
    if (!overclocking)
-    FCEU_SoundCPUHook(temp);
-   if (execMemHook)
+    FCEU_SoundCPUHookInline(temp);
+   if (instrumented && execMemHook)
    {
            execMemHook->call(_PC, 0);
    }
    _PC++;
+   #define X6502_OP(n) case 0x##n: X6502_Op<instrumented,false,0x##n>(0); break;
    switch(b1)
    {
-    #include "ops.inc"
+    X6502_OPS256
    }
+   #undef X6502_OP
   }
+
+  if (!instrumented)
+  {
+   total_instructions += instructions;
+   delta_instructions += instructions;
+  }
+}
+
+void X6502_Run(int32 cycles)
+{
+  if(PAL)
+   cycles*=15;    // 15*4=60
+  else
+   cycles*=16;    // 16*4=64
+
+  _count+=cycles;
+extern int test; test++;
+  // Still paying off the last instruction; the new PPU calls this every dot
+  if(_count<=0)
+   return;
+
+  FCEU_StageScope stage(FCEU_STAGE_CPU);
+
+  if (codeCache)
+   CodeCacheCheck();
+
+  // Looked up once per call, so a breakpoint or hook registered meanwhile
+  // takes effect from the next call (at most a scanline later).
+  if (X6502_NeedsInstrumentation())
+   X6502_RunLoop<true>();
+  else
+   X6502_RunLoop<false>();
 }
 
 //--------------------------
@@ -666,12 +1215,12 @@ void FCEUI_GetIVectors(uint16 *reset, uint16 *irq, uint16 *nmi)
 {
  fceuindbg=1;
 
- *reset=RdMem(0xFFFC);
- *reset|=RdMem(0xFFFD)<<8;
- *nmi=RdMem(0xFFFA);
- *nmi|=RdMem(0xFFFB)<<8;
- *irq=RdMem(0xFFFE);
- *irq|=RdMem(0xFFFF)<<8;
+ *reset=RdMemT<true>(0xFFFC);
+ *reset|=RdMemT<true>(0xFFFD)<<8;
+ *nmi=RdMemT<true>(0xFFFA);
+ *nmi|=RdMemT<true>(0xFFFB)<<8;
+ *irq=RdMemT<true>(0xFFFE);
+ *irq|=RdMemT<true>(0xFFFF)<<8;
  fceuindbg=0;
 }
 
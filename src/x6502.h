@@ -64,6 +64,16 @@ extern int scanline;
 
 extern void (*MapIRQHook)(int a);
 
+//MapIRQHook is called with the cycles of every instruction unless the board
+//schedules its next event. After each call (or register access) a board
+//whose hook only counts cycles can report how many cycles may pass before
+//anything happens; the CPU then sums them up and makes one call when that
+//many have passed. The deadline has to be set again after every call.
+//Flush before reading or changing anything the hook counts.
+void X6502_SetMapIRQDeadline(int32 cycles);
+void X6502_FlushMapIRQ(void);
+void X6502_DiscardMapIRQ(void);
+
 #define NTSC_CPU (dendy ? 1773447.467 : 1789772.7272727272727272)
 #define PAL_CPU  1662607.125
 
@@ -87,11 +97,23 @@ void TriggerNMI2(void);
 uint8 X6502_DMR(uint32 A);
 void X6502_DMW(uint32 A, uint8 V);
 
+//The source of a DMA of len bytes from A when it can be copied straight
+//out of RAM or ROM, or NULL to read it byte by byte with X6502_DMR(): for
+//I/O and mapper registers, cheats, or while a memory hook watches the bus.
+//A copy then takes its cycles with X6502_DMAStall() and leaves the last
+//byte moved on the data bus, X.DB.
+const uint8 *X6502_DMASource(uint32 A, int len);
+void X6502_DMAStall(int cycles);
+
 void X6502_IRQBegin(int w);
 void X6502_IRQEnd(int w);
 
 int X6502_GetOpcodeCycles( int op );
 
+//True while breakpoints, stepping, trace or CD logging, Lua memory hooks, the
+//write journal or the guest profiler need to see every instruction
+bool X6502_NeedsInstrumentation(void);
+
 class X6502_MemHook
 {
 	public: